@@ -37,6 +37,23 @@
 #include "QpidException.h"
 #include "TypeTranslator.h"
 
+namespace {
+    // Set the content to the UTF-8 encoding of a managed String. The
+    // encoded bytes are copied from the pinned array straight into the
+    // message rather than through an intermediate std::string.
+    void SetUtf8Content(::qpid::messaging::Message & message, System::String ^ content)
+    {
+        array<unsigned char> ^ mbytes = System::Text::Encoding::UTF8->GetBytes(content);
+        if (mbytes->Length == 0)
+        {
+            message.setContent(std::string());
+            return;
+        }
+        pin_ptr<unsigned char> pBytes = &mbytes[0];
+        message.setContent((char *)pBytes, mbytes->Length);
+    }
+}
+
 namespace Org {
 namespace Apache {
 namespace Qpid {
@@ -74,7 +91,8 @@ namespace Messaging {
 
         try 
 		{
-            messagep = new ::qpid::messaging::Message(QpidMarshal::ToNative(theStr));
+            messagep = new ::qpid::messaging::Message();
+            SetUtf8Content(*messagep, theStr);
         } 
         catch (const ::qpid::types::Exception & error) 
 		{
@@ -132,7 +150,7 @@ namespace Messaging {
             else
             {
                 // Create a binary string message
-                messagep->setContent(QpidMarshal::ToNative(theValue->ToString()));
+                SetUtf8Content(*messagep, theValue->ToString());
             }
         } 
         catch (const ::qpid::types::Exception & error) 
@@ -303,6 +321,33 @@ namespace Messaging {
 		}
     }
 
+    System::Object ^ Message::GetProperty(System::String ^ name)
+    {
+        System::Object ^ result = nullptr;
+        System::Exception ^ newException = nullptr;
+
+        try 
+		{
+            // Translate just the one property, not the whole map
+            const ::qpid::types::Variant::Map & map = messagep->getProperties();
+            ::qpid::types::Variant::Map::const_iterator i = map.find(QpidMarshal::ToNative(name));
+            if (i != map.end())
+                result = TypeTranslator::NativeToManagedObject(i->second);
+        } 
+        catch (const ::qpid::types::Exception & error) 
+		{
+            String ^ errmsg = gcnew String(error.what());
+            newException    = gcnew QpidException(errmsg);
+        }
+
+		if (newException != nullptr) 
+		{
+	        throw newException;
+		}
+
+        return result;
+    }
+
 	// Content
 	void Message::SetContent(System::String ^ content)
     {
@@ -310,7 +355,7 @@ namespace Messaging {
 
         try 
 		{
-            messagep->setContent(QpidMarshal::ToNative(content));
+            SetUtf8Content(*messagep, content);
         } 
         catch (const ::qpid::types::Exception & error) 
 		{
@@ -280,6 +280,9 @@ namespace Messaging {
         //
         void Message::SetProperty(System::String ^ name, System::Object ^ value);
 
+        // Value of one property, nullptr if the message doesn't have it
+        System::Object ^ GetProperty(System::String ^ name);
+
         //
         // Properties
         //
@@ -289,9 +292,8 @@ namespace Messaging {
             System::Collections::Generic::Dictionary<
                     System::String^, System::Object^> ^ get ()
             {
-                ::qpid::types::Variant::Map map;
-
-                map = messagep->getProperties();
+                // Translated from the message's own map, without a copy
+                const ::qpid::types::Variant::Map & map = messagep->getProperties();
 
                 System::Collections::Generic::Dictionary<
                     System::String^, System::Object^> ^ dict =
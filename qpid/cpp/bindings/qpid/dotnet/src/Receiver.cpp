@@ -152,13 +152,19 @@ namespace Messaging {
 		{
             ::qpid::messaging::Duration dur((*durationp).Milliseconds);
         
-            ::qpid::messaging::Message tmpMsg;
+            // Receive straight into the managed message's native one
+            // rather than copying a received message into it
+            Message ^ newMessage = gcnew Message();
         
-            bool result = receiverp->Receiver::get(tmpMsg, dur);
+            bool result = receiverp->Receiver::get(*(newMessage->NativeMessage), dur);
         
             if (result)
             {
-                mmsgp = gcnew Message(tmpMsg);
+                mmsgp = newMessage;
+            }
+            else
+            {
+                delete newMessage;
             }
         
             return result;
@@ -196,12 +202,12 @@ namespace Messaging {
             // translate the duration
             ::qpid::messaging::Duration dur((*durationp).Milliseconds);
 
-            // get the message
-            ::qpid::messaging::Message msg = 
-                receiverp->::qpid::messaging::Receiver::get(dur);
+            // create a new managed message and receive straight into
+            // the native message embedded in it
+            newMessage = gcnew Message();
 
-            // create new managed message with received message embedded in it
-            newMessage = gcnew Message(msg);
+            if (!receiverp->::qpid::messaging::Receiver::get(*(newMessage->NativeMessage), dur))
+                throw ::qpid::messaging::NoMessageAvailable();
         } 
         catch (const ::qpid::types::Exception & error) 
         {
@@ -242,13 +248,19 @@ namespace Messaging {
         {
             ::qpid::messaging::Duration dur((*durationp).Milliseconds);
     
-            ::qpid::messaging::Message tmpMsg;
+            // Receive straight into the managed message's native one
+            // rather than copying a received message into it
+            Message ^ newMessage = gcnew Message();
         
-            bool result = receiverp->Receiver::fetch(tmpMsg, dur);
+            bool result = receiverp->Receiver::fetch(*(newMessage->NativeMessage), dur);
         
             if (result)
             {
-                mmsgp = gcnew Message(tmpMsg);
+                mmsgp = newMessage;
+            }
+            else
+            {
+                delete newMessage;
             }
         
             return result;
@@ -286,12 +298,12 @@ namespace Messaging {
             // translate the duration
             ::qpid::messaging::Duration dur((*durationp).Milliseconds);
 
-            // get the message
-            ::qpid::messaging::Message msg =
-                receiverp->::qpid::messaging::Receiver::fetch(dur);
+            // create a new managed message and receive straight into
+            // the native message embedded in it
+            newMessage = gcnew Message();
 
-            // create new managed message with received message embedded in it
-            newMessage = gcnew Message(msg);
+            if (!receiverp->::qpid::messaging::Receiver::fetch(*(newMessage->NativeMessage), dur))
+                throw ::qpid::messaging::NoMessageAvailable();
         } 
         catch (const ::qpid::types::Exception & error) 
         {
@@ -257,199 +257,95 @@ namespace Messaging {
     // Given a user Dictionary and a qpid map,
     //   extract the qpid elements and put them into the dictionary.
     //
-    void TypeTranslator::NativeToManaged(::qpid::types::Variant::Map & qpidMap,
-										 QpidMap ^ dict)
+    System::Object ^ TypeTranslator::NativeToManagedObject(const ::qpid::types::Variant & variant)
     {
-        // For each object in the message map, 
-        //  create a .NET object and add it to the dictionary.
-        for (::qpid::types::Variant::Map::const_iterator i = qpidMap.begin(); i != qpidMap.end(); ++i) {
-            // Get the name
-            System::String ^ elementName = gcnew String(i->first.c_str());
+        switch (variant.getType())
+        {
+        case ::qpid::types::VAR_BOOL:
+            return variant.asBool();
+
+        case ::qpid::types::VAR_UINT8:
+            return variant.asUint8();
+
+        case ::qpid::types::VAR_UINT16:
+            return variant.asUint16();
+
+        case ::qpid::types::VAR_UINT32:
+            return variant.asUint32();
+
+        case ::qpid::types::VAR_UINT64:
+            return variant.asUint64();
+
+        case ::qpid::types::VAR_INT8:
+            return variant.asInt8();
+
+        case ::qpid::types::VAR_INT16:
+            return variant.asInt16();
+
+        case ::qpid::types::VAR_INT32:
+            return variant.asInt32();
+
+        case ::qpid::types::VAR_INT64:
+            return variant.asInt64();
+
+        case ::qpid::types::VAR_FLOAT:
+            return variant.asFloat();
 
-            ::qpid::types::Variant     variant = i->second;
-            ::qpid::types::VariantType vType   = variant.getType();
+        case ::qpid::types::VAR_DOUBLE:
+            return variant.asDouble();
 
-            switch (vType)
+        case ::qpid::types::VAR_STRING:
+            return gcnew System::String(variant.asString().c_str());
+
+        case ::qpid::types::VAR_MAP:
             {
-            case ::qpid::types::VAR_VOID:
-                dict[elementName] = nullptr;
-                break;
-
-            case ::qpid::types::VAR_BOOL:
-                dict[elementName] = variant.asBool();
-                break;
-                
-            case ::qpid::types::VAR_UINT8:
-                dict[elementName] = variant.asUint8();
-                break;
-                
-            case ::qpid::types::VAR_UINT16:
-                dict[elementName] = variant.asUint16();
-                break;
-                
-            case ::qpid::types::VAR_UINT32:
-                dict[elementName] = variant.asUint32();
-                break;
-                
-            case ::qpid::types::VAR_UINT64:
-                dict[elementName] = variant.asUint64();
-                break;
-                
-            case ::qpid::types::VAR_INT8:
-                dict[elementName] = variant.asInt8();
-                break;
-                
-            case ::qpid::types::VAR_INT16:
-                dict[elementName] = variant.asInt16();
-                break;
-                
-            case ::qpid::types::VAR_INT32:
-                dict[elementName] = variant.asInt32();
-                break;
-                
-            case ::qpid::types::VAR_INT64:
-                dict[elementName] = variant.asInt64();
-                break;
-                
-            case ::qpid::types::VAR_FLOAT:
-                dict[elementName] = variant.asFloat();
-                break;
-                
-            case ::qpid::types::VAR_DOUBLE:
-                dict[elementName] = variant.asDouble();
-                break;
-                
-            case ::qpid::types::VAR_STRING:
-                {
-                    System::String ^ elementValue = gcnew System::String(variant.asString().c_str());
-                    dict[elementName] = elementValue;
-                    break;
-                }
-            case ::qpid::types::VAR_MAP:
-                {
-                    QpidMap ^ newDict = gcnew QpidMap();
+                QpidMap ^ newDict = gcnew QpidMap();
 
-                    NativeToManaged(variant.asMap(), newDict);
+                NativeToManaged(variant.asMap(), newDict);
 
-                    dict[elementName] = newDict;
-                    break;
-                }
+                return newDict;
+            }
 
-            case ::qpid::types::VAR_LIST:
-                {
-                    QpidList ^ newList = gcnew QpidList();
+        case ::qpid::types::VAR_LIST:
+            {
+                QpidList ^ newList = gcnew QpidList();
 
-                    NativeToManaged(variant.asList(), newList);
+                NativeToManaged(variant.asList(), newList);
 
-                    dict[elementName] = newList;
-                    break;
-                }
-                
-            case ::qpid::types::VAR_UUID:
-                {
-                    System::String ^ elementValue = gcnew System::String(variant.asUuid().str().c_str());
-                    System::Guid ^ newGuid = System::Guid(elementValue);
-                    dict[elementName] = newGuid;
-                }
-                break;
+                return newList;
+            }
+
+        case ::qpid::types::VAR_UUID:
+            {
+                System::String ^ elementValue = gcnew System::String(variant.asUuid().str().c_str());
+                System::Guid ^ newGuid = System::Guid(elementValue);
+                return newGuid;
             }
         }
+        return nullptr;
     }
 
 
-    void TypeTranslator::NativeToManaged(::qpid::types::Variant::List & qpidList, QpidList ^ managedList)
+    void TypeTranslator::NativeToManaged(const ::qpid::types::Variant::Map & qpidMap,
+										 QpidMap ^ dict)
+    {
+        // For each object in the message map, 
+        //  create a .NET object and add it to the dictionary.
+        // The elements are read in place; copying each Variant would
+        // also copy any map or list nested in it.
+        for (::qpid::types::Variant::Map::const_iterator i = qpidMap.begin(); i != qpidMap.end(); ++i) {
+            dict[gcnew String(i->first.c_str())] = NativeToManagedObject(i->second);
+        }
+    }
+
+
+    void TypeTranslator::NativeToManaged(const ::qpid::types::Variant::List & qpidList, QpidList ^ managedList)
     {
         // For each object in the qpidList 
         //  create a .NET object and add it to the managed List.
         for (::qpid::types::Variant::List::const_iterator i = qpidList.begin(); i != qpidList.end(); ++i) 
         {
-            ::qpid::types::Variant     variant = *i;
-            ::qpid::types::VariantType vType   = variant.getType();
-
-            switch (vType)
-            {
-            case ::qpid::types::VAR_VOID:
-                (*managedList).Add(nullptr);
-                break;
-
-            case ::qpid::types::VAR_BOOL:
-                (*managedList).Add(variant.asBool());
-                break;
-                
-            case ::qpid::types::VAR_UINT8:
-                (*managedList).Add(variant.asUint8());
-                break;
-                
-            case ::qpid::types::VAR_UINT16:
-                (*managedList).Add(variant.asUint16());
-                break;
-                
-            case ::qpid::types::VAR_UINT32:
-                (*managedList).Add(variant.asUint32());
-                break;
-                
-            case ::qpid::types::VAR_UINT64:
-                (*managedList).Add(variant.asUint64());
-                break;
-                
-            case ::qpid::types::VAR_INT8:
-                (*managedList).Add(variant.asInt8());
-                break;
-                
-            case ::qpid::types::VAR_INT16:
-                (*managedList).Add(variant.asInt16());
-                break;
-                
-            case ::qpid::types::VAR_INT32:
-                (*managedList).Add(variant.asInt32());
-                break;
-                
-            case ::qpid::types::VAR_INT64:
-                (*managedList).Add(variant.asInt64());
-                break;
-                
-            case ::qpid::types::VAR_FLOAT:
-                (*managedList).Add(variant.asFloat());
-                break;
-                
-            case ::qpid::types::VAR_DOUBLE:
-                (*managedList).Add(variant.asDouble());
-                break;
-                
-            case ::qpid::types::VAR_STRING:
-                {
-                    System::String ^ elementValue = gcnew System::String(variant.asString().c_str());
-                    (*managedList).Add(elementValue);
-                    break;
-                }
-            case ::qpid::types::VAR_MAP:
-                {
-                    QpidMap ^ newDict = gcnew QpidMap();
-
-                    NativeToManaged(variant.asMap(), newDict);
-
-                    (*managedList).Add(newDict);
-                    break;
-                }
-
-            case ::qpid::types::VAR_LIST:
-                {
-                    QpidList ^ newList = gcnew QpidList();
-
-                    NativeToManaged(variant.asList(), newList);
-
-                    (*managedList).Add(newList);
-                    break;
-                }
-                
-            case ::qpid::types::VAR_UUID:
-                {
-                    System::String ^ elementValue = gcnew System::String(variant.asUuid().str().c_str());
-                    System::Guid ^ newGuid = System::Guid(elementValue);
-                    (*managedList).Add(newGuid);
-                }
-                break;
-            }
+            (*managedList).Add(NativeToManagedObject(*i));
         }
     }
 }}}}
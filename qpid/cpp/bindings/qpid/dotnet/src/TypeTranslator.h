@@ -60,12 +60,16 @@ namespace Messaging {
 
         // The given object is a qpid map.
         // Add its elements to the managed Dictionary.
-        static void NativeToManaged(::qpid::types::Variant::Map & qpidMap,
+        static void NativeToManaged(const ::qpid::types::Variant::Map & qpidMap,
 									QpidMap ^ dict);
 
         // The given object is a qpid list.
         // Add its elements to the managed List.
-        static void NativeToManaged(::qpid::types::Variant::List & qpidList,
+        static void NativeToManaged(const ::qpid::types::Variant::List & qpidList,
 									QpidList ^ managedList);
+
+        // The given object is a qpid variant.
+        // Returns the managed object for it, nullptr for a void variant.
+        static System::Object ^ NativeToManagedObject(const ::qpid::types::Variant & qpidVariant);
     };
 }}}}
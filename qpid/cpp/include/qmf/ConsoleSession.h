@@ -65,6 +65,9 @@ namespace qmf {
          *                                 periodic background processing passes.
          *                                 Must not be greater than 60.  Larger numbers will cause fewer wake-ups but will
          *                                 increase the time it takes to shut down the process. [default: 5]
+         *    shared-schema-cache:{True,False} - If True:  Share one schema cache with the other sessions in the process
+         *                                       that ask for it, so a schema is fetched once for all their agents
+         *                                     - If False: Keep a schema cache for this session alone [default]
          */
         QMF_EXTERN ConsoleSession(qpid::messaging::Connection& conn, const std::string& options="");
 
@@ -117,15 +117,16 @@ namespace engine {
             SETUP_COMPLETE  = 15,
             STABLE          = 16,
             QUERY_COMPLETE  = 17,
-            METHOD_RESPONSE = 18
+            METHOD_RESPONSE = 18,
+            QUERY_PARTIAL   = 19        // Some of a query's results, see ConsoleSettings::queryBatchSize
         };
 
         EventKind kind;
         char*           name;           // ([DECLARE|DELETE]_QUEUE, [UN]BIND)
         char*           exchange;       // ([UN]BIND)
         char*           bindingKey;     // ([UN]BIND)
-        void*           context;        // (QUERY_COMPLETE, METHOD_RESPONSE)
-        QueryResponse*  queryResponse;  // (QUERY_COMPLETE)
+        void*           context;        // (QUERY_COMPLETE, QUERY_PARTIAL, METHOD_RESPONSE)
+        QueryResponse*  queryResponse;  // (QUERY_COMPLETE, QUERY_PARTIAL)
         MethodResponse* methodResponse; // (METHOD_RESPONSE)
     };
 
@@ -184,12 +185,16 @@ namespace engine {
         bool rcvEvents;
         bool rcvHeartbeats;
         bool userBindings;
+        // If not 0, a query's results are delivered in QUERY_PARTIAL events of
+        // this many objects as they arrive; QUERY_COMPLETE has the rest.
+        uint32_t queryBatchSize;
 
         ConsoleSettings() :
             rcvObjects(true),
             rcvEvents(true),
             rcvHeartbeats(true),
-            userBindings(false) {}
+            userBindings(false),
+            queryBatchSize(0) {}
     };
 
     class Console {
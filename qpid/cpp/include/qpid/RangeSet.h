@@ -240,9 +240,26 @@ template <class T> void RangeSet<T>::addRange(const Range<T>& r) {
 
 
 template <class T> void RangeSet<T>::addSet(const RangeSet<T>& s) {
-    typedef RangeSet<T>& (RangeSet<T>::*RangeSetRangeOp)(const Range<T>&);
-    std::for_each(s.ranges.begin(), s.ranges.end(),
-                  boost::bind((RangeSetRangeOp)&RangeSet<T>::operator+=, this, _1));
+    if (s.ranges.empty()) return;
+    if (s.ranges.size() == 1 || ranges.empty()) {
+        if (ranges.empty()) ranges = s.ranges;
+        else addRange(s.ranges.front());
+        return;
+    }
+    // Merge both sorted lists in one pass rather than inserting each
+    // range, which shifts the tail of a fragmented set every time.
+    Ranges merged;
+    merged.reserve(ranges.size() + s.ranges.size());
+    RangeIterator i = ranges.begin(), j = s.ranges.begin();
+    while (i != ranges.end() || j != s.ranges.end()) {
+        bool fromThis = j == s.ranges.end() || (i != ranges.end() && i->begin() < j->begin());
+        const Range<T>& r = fromThis ? *i++ : *j++;
+        if (!merged.empty() && merged.back().touching(r))
+            merged.back().merge(r);
+        else
+            merged.push_back(r);
+    }
+    ranges = merged;
 }
 
 template <class T> void RangeSet<T>::removeRange(const Range<T>& r) {
@@ -272,9 +289,31 @@ template <class T> void RangeSet<T>::removeRange(const Range<T>& r) {
 }
 
 template <class T> void RangeSet<T>::removeSet(const RangeSet<T>& r) {
-    std::for_each(
-        r.ranges.begin(), r.ranges.end(),
-        boost::bind(&RangeSet<T>::removeRange, this, _1));
+    if (r.ranges.size() <= 1 || ranges.empty()) {
+        if (!r.ranges.empty()) removeRange(r.ranges.front());
+        return;
+    }
+    // Walk both sorted lists once, keeping what r does not cover.
+    Ranges kept;
+    kept.reserve(ranges.size() + r.ranges.size());
+    RangeIterator j = r.ranges.begin();
+    for (RangeIterator i = ranges.begin(); i != ranges.end(); ++i) {
+        Range<T> current = *i;
+        while (j != r.ranges.end() && !(current.begin() < j->end()))
+            ++j;                // Wholly before current
+        while (!current.empty() && j != r.ranges.end() && j->begin() < current.end()) {
+            if (current.begin() < j->begin())
+                kept.push_back(Range<T>(current.begin(), j->begin()));
+            if (current.end() <= j->end()) {
+                current.begin(current.end()); // j may overlap the next range too
+            } else {
+                current.begin(j->end());
+                ++j;
+            }
+        }
+        if (!current.empty()) kept.push_back(current);
+    }
+    ranges = kept;
 }
 
 template <class T> Range<T> RangeSet<T>::toRange() const {
@@ -42,6 +42,24 @@ class QPID_COMMON_CLASS_EXTERN MapCodec
     static void   QPID_COMMON_EXTERN decode(const std::string&, ObjectType&);
     static size_t QPID_COMMON_EXTERN encodedSize(const ObjectType&);
     static const  QPID_COMMON_EXTERN std::string contentType;
+
+    /**
+     * Receives the entries of an encoded map one at a time, so that a
+     * few keys can be picked out of a large map without converting
+     * the rest.
+     */
+    class QPID_COMMON_CLASS_EXTERN Visitor
+    {
+      public:
+        QPID_COMMON_EXTERN virtual ~Visitor();
+        /** Return false to skip converting the value for key. */
+        QPID_COMMON_EXTERN virtual bool wants(const std::string& key);
+        /** Return false to stop decoding. */
+        virtual bool handle(const std::string& key, const qpid::types::Variant& value) = 0;
+    };
+
+    /** Pass each entry of the encoded map to visitor, in encoded order. */
+    static void   QPID_COMMON_EXTERN decode(const std::string&, Visitor&);
   private:
 };
 
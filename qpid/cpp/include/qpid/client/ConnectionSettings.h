@@ -127,6 +127,27 @@ struct QPID_CLIENT_CLASS_EXTERN ConnectionSettings {
      * settings. Used only when a client connects to the broker.
      */
     std::string sslCertName;
+    /**
+     * If true, ask the broker to deflate everything sent either way
+     * once the connection is open. Ignored if the broker or the
+     * transport does not support it, or a SASL security layer is in
+     * use.
+     */
+    bool compress;
+    /**
+     * If true, a frameset completed while the connection is still
+     * writing earlier ones is not written at once but with whatever
+     * else is sent before that write finishes. TCP connections only.
+     */
+    bool coalesceOutput;
+    /**
+     * If non-zero, a frameset completed within this many microseconds
+     * of the connection's last write waits until that long after it,
+     * unless a buffer's worth is waiting first, so that framesets from
+     * all sessions are written together. A frameset sent after a
+     * longer quiet time is written at once. TCP connections only.
+     */
+    uint32_t flushDelay;
 };
 
 }} // namespace qpid::client
@@ -44,6 +44,8 @@ public:
     Future() : complete(false) {}
     Future(const framing::SequenceNumber& id) : command(id), complete(false) {}
 
+    const framing::SequenceNumber& getCommandId() const { return command; }
+
     std::string getResult(SessionImpl& session) {
         if (result) return result->getResult(session);
         else throw Exception("Result not expected");
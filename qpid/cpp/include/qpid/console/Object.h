@@ -82,6 +82,10 @@ namespace console {
         bool isDeleted() const { return deleteTime != 0; }
         QPID_CONSOLE_EXTERN std::string getIndex() const;
         QPID_CONSOLE_EXTERN void mergeUpdate(const Object& updated);
+        /** Apply an update, as the constructor would decode it, in place:
+         * the attributes it carries replace those held, others are kept.
+         */
+        QPID_CONSOLE_EXTERN void update(framing::Buffer& buffer, bool prop, bool stat);
         const AttributeMap& getAttributes() const { return attributes; }
         QPID_CONSOLE_EXTERN void invokeMethod(const std::string name,
                                               const AttributeMap& args,
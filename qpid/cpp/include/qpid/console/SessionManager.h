@@ -35,6 +35,9 @@
 #include "qpid/sys/Mutex.h"
 #include "qpid/sys/Condition.h"
 #include "qpid/client/ConnectionSettings.h"
+#include <boost/shared_ptr.hpp>
+#include <list>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -61,9 +64,12 @@ class SessionManager
         bool userBindings;
         uint32_t methodTimeout;
         uint32_t getTimeout;
+        bool cacheObjects;
+        uint32_t maxCachedObjects;
 
         Settings() : rcvObjects(true), rcvEvents(true), rcvHeartbeats(true),
-                     userBindings(false), methodTimeout(20), getTimeout(20)
+                     userBindings(false), methodTimeout(20), getTimeout(20),
+                     cacheObjects(false), maxCachedObjects(0)
         {}
     };
 
@@ -80,6 +86,11 @@ class SessionManager
      * console client to control which object classes are received.  See the bindPackage
      * and bindClass methods.  If userBindings is false, the listener will receive
      * updates for all object classes.
+     *@param settings.cacheObjects Keep one copy of each object and apply its updates
+     * to it in place, so that the listener is given the object with all the properties
+     * and statistics known for it rather than only those the update carried.
+     *@param settings.maxCachedObjects If not zero, the most objects to keep; beyond it
+     * those least recently updated are dropped, and are rebuilt as they are next updated.
      */
     QPID_CONSOLE_EXTERN SessionManager(ConsoleListener* listener = 0,
                                        Settings settings = Settings());
@@ -197,6 +208,19 @@ private:
     Settings settings;
     NameVector bindingKeyList;
 
+    // Objects kept for settings.cacheObjects, by broker and id, and their
+    // keys from least to most recently updated.  Protected by cacheLock.
+    typedef std::pair<Broker*, ObjectId> CacheKey;
+    typedef std::list<CacheKey> CacheAge;
+    struct CachedObject {
+        boost::shared_ptr<Object> object;
+        CacheAge::iterator age;
+    };
+    typedef std::map<CacheKey, CachedObject> ObjectCache;
+    sys::Mutex cacheLock;
+    ObjectCache objectCache;
+    CacheAge cacheAge;
+
     void bindingKeys();
     void allBrokersStable();
     void startProtocol(Broker* broker);
@@ -211,6 +235,10 @@ private:
     void handleContentInd(Broker* broker, framing::Buffer& inBuffer, uint32_t sequence, bool prop, bool stat);
     void handleBrokerConnect(Broker* broker);
     void handleBrokerDisconnect(Broker* broker);
+    boost::shared_ptr<Object> cacheUpdate(Broker* broker, SchemaClass* schemaClass,
+                                          framing::Buffer& buffer, bool prop, bool stat);
+    void uncacheObject(Broker* broker, const ObjectId& objectId);
+    void uncacheBroker(Broker* broker);
 
 };
 
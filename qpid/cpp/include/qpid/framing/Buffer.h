@@ -22,6 +22,7 @@
 #include "qpid/Exception.h"
 #include "qpid/CommonImportExport.h"
 #include <boost/iterator/iterator_facade.hpp>
+#include <assert.h>
 
 #ifndef _Buffer_
 #define _Buffer_
@@ -79,9 +80,9 @@ class QPID_COMMON_CLASS_EXTERN Buffer
     QPID_COMMON_INLINE_EXTERN Iterator getIterator() { return Iterator(*this); }
     QPID_COMMON_INLINE_EXTERN char* getPointer() { return data; }
 
-    QPID_COMMON_EXTERN void putOctet(uint8_t i);
-    QPID_COMMON_EXTERN void putShort(uint16_t i);
-    QPID_COMMON_EXTERN void putLong(uint32_t i);
+    QPID_COMMON_INLINE_EXTERN void putOctet(uint8_t i);
+    QPID_COMMON_INLINE_EXTERN void putShort(uint16_t i);
+    QPID_COMMON_INLINE_EXTERN void putLong(uint32_t i);
     QPID_COMMON_EXTERN void putLongLong(uint64_t i);
     QPID_COMMON_EXTERN void putInt8(int8_t i);
     QPID_COMMON_EXTERN void putInt16(int16_t i);
@@ -91,9 +92,9 @@ class QPID_COMMON_CLASS_EXTERN Buffer
     QPID_COMMON_EXTERN void putDouble(double f);
     QPID_COMMON_EXTERN void putBin128(const uint8_t* b);
 
-    QPID_COMMON_EXTERN uint8_t  getOctet();
-    QPID_COMMON_EXTERN uint16_t getShort();
-    QPID_COMMON_EXTERN uint32_t getLong();
+    QPID_COMMON_INLINE_EXTERN uint8_t  getOctet();
+    QPID_COMMON_INLINE_EXTERN uint16_t getShort();
+    QPID_COMMON_INLINE_EXTERN uint32_t getLong();
     QPID_COMMON_EXTERN uint64_t getLongLong();
     QPID_COMMON_EXTERN int8_t   getInt8();
     QPID_COMMON_EXTERN int16_t  getInt16();
@@ -128,6 +129,51 @@ class QPID_COMMON_CLASS_EXTERN Buffer
     QPID_COMMON_EXTERN void dump(std::ostream&) const;
 };
 
+// The fixed width primitives are inline as generated encoders and
+// decoders make a call per field.
+
+inline void Buffer::putOctet(uint8_t i){
+    data[position++] = i;
+    assert(position <= size);
+}
+
+inline void Buffer::putShort(uint16_t i){
+    data[position++] = (uint8_t) (0xFF & (i >> 8));
+    data[position++] = (uint8_t) (0xFF & i);
+    assert(position <= size);
+}
+
+inline void Buffer::putLong(uint32_t i){
+    data[position++] = (uint8_t) (0xFF & (i >> 24));
+    data[position++] = (uint8_t) (0xFF & (i >> 16));
+    data[position++] = (uint8_t) (0xFF & (i >> 8));
+    data[position++] = (uint8_t) (0xFF & i);
+    assert(position <= size);
+}
+
+inline uint8_t Buffer::getOctet(){
+    uint8_t octet = static_cast<uint8_t>(data[position++]);
+    assert(position <= size);
+    return octet;
+}
+
+inline uint16_t Buffer::getShort(){
+    uint16_t hi = (unsigned char) data[position++];
+    hi = hi << 8;
+    hi |= (unsigned char) data[position++];
+    assert(position <= size);
+    return hi;
+}
+
+inline uint32_t Buffer::getLong(){
+    uint32_t a = (unsigned char) data[position++];
+    uint32_t b = (unsigned char) data[position++];
+    uint32_t c = (unsigned char) data[position++];
+    uint32_t d = (unsigned char) data[position++];
+    assert(position <= size);
+    return (a << 24) | (b << 16) | (c << 8) | d;
+}
+
 std::ostream& operator<<(std::ostream&, const Buffer&);
 
 }} // namespace qpid::framing
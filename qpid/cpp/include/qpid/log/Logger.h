@@ -15,9 +15,13 @@
 #include "qpid/log/Selector.h"
 #include "qpid/log/Options.h"
 #include "qpid/sys/Mutex.h"
+#include "qpid/sys/Monitor.h"
+#include "qpid/sys/Runnable.h"
+#include "qpid/sys/Thread.h"
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/noncopyable.hpp>
 #include <set>
+#include <vector>
 #include "qpid/CommonImportExport.h"
 
 namespace qpid {
@@ -32,6 +36,12 @@ namespace log {
  * formatting logging output. The actual outputting of log records
  * is handled by Logger::Output-derived classes instantiated by the
  * platform's sink-related options.
+ *
+ * With the log-async option, log() formats the record on the calling
+ * thread and queues it; a background thread writes queued records to
+ * the outputs in batches. At log-async-limit queued records further
+ * records are dropped (and counted) or, with log-async-block, the
+ * caller waits for the writer.
  */
 class QPID_COMMON_CLASS_EXTERN Logger : private boost::noncopyable {
   public:
@@ -77,6 +87,15 @@ class QPID_COMMON_CLASS_EXTERN Logger : private boost::noncopyable {
     /** Reset the log selectors */
     QPID_COMMON_EXTERN void reconfigure(const std::vector<std::string>& selectors);
 
+    /**
+     * Enable the QPID_LOG_FOR statements selected by s for the named
+     * objects only, in addition to those enabled by select().
+     */
+    QPID_COMMON_EXTERN void selectObjects(const Selector& s, const std::vector<std::string>& names);
+
+    /** True if the named object was passed to selectObjects. */
+    QPID_COMMON_EXTERN bool isSelected(const std::string& object);
+
     /** Add a statement. */
     QPID_COMMON_EXTERN void add(Statement& s);
 
@@ -92,6 +111,9 @@ class QPID_COMMON_CLASS_EXTERN Logger : private boost::noncopyable {
     /** Reset the logger. */
     QPID_COMMON_EXTERN void clear();
 
+    /** Number of records dropped because the async queue was full. */
+    QPID_COMMON_EXTERN uint64_t getDropped();
+
     /** Get the options used to configure the logger. */
     QPID_COMMON_INLINE_EXTERN const Options& getOptions() const { return options; }
 
@@ -100,15 +122,50 @@ class QPID_COMMON_CLASS_EXTERN Logger : private boost::noncopyable {
     typedef boost::ptr_vector<Output> Outputs;
     typedef std::set<Statement*> Statements;
 
+    struct Queued {
+        Statement statement;
+        std::string text;
+        Queued(const Statement& s, const std::string& t) : statement(s), text(t) {}
+    };
+    typedef std::vector<Queued> Queue;
+
+    class Writer : public sys::Runnable {
+        Logger& logger;
+      public:
+        Writer(Logger& l) : logger(l) {}
+        void run() { logger.writeQueued(); }
+    };
+
     sys::Mutex lock;
     inline void enable_unlocked(Statement* s);
+    void enqueue(const Statement&, const std::string&);
+    void writeQueued();
+    void stopWriter();
 
     Statements statements;
     Outputs outputs;
     Selector selector;
+    Selector objectSelector;
+    sys::Mutex objectLock;      // Guards objects only
+    std::set<std::string> objects;
     int flags;
     std::string prefix;
     Options options;
+
+    // Async mode, all guarded by queueLock. The writer is started by
+    // the first queued record in each process, so a daemon that forks
+    // after configure() gets its own.
+    sys::Monitor queueLock;
+    bool async;
+    size_t asyncLimit;
+    bool asyncBlock;
+    Queue queued;
+    Writer writer;
+    sys::Thread writerThread;
+    uint32_t writerPid;
+    bool stopping;
+    uint64_t dropped;
+    uint64_t droppedReported;
 };
 
 }} // namespace qpid::log
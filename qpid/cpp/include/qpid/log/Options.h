@@ -21,6 +21,7 @@
 #include "qpid/Options.h"
 #include "qpid/CommonImportExport.h"
 #include "qpid/log/SinkOptions.h"
+#include "qpid/sys/IntegerTypes.h"
 #include <iosfwd>
 #include <memory>
 
@@ -39,9 +40,14 @@ struct Options : public qpid::Options {
     std::string argv0;
     std::string name;
     std::vector<std::string> selectors;
+    std::vector<std::string> objects;         ///< Names for QPID_LOG_FOR
+    std::vector<std::string> objectSelectors; ///< Rules enabled for those only
     bool time, level, thread, source, function, hiresTs;
     bool trace;
     std::string prefix;
+    bool async;                 ///< Write from a background thread
+    uint32_t asyncLimit;        ///< Most records waiting for that thread
+    bool asyncBlock;            ///< Wait rather than drop at asyncLimit
     std::auto_ptr<SinkOptions> sinkOptions;
 };
 
@@ -62,9 +62,13 @@ struct Statement {
     int line;
     const char* function;
     Level level;
+    bool objectEnabled;         ///< Enabled for selected objects only, see QPID_LOG_FOR
 
     QPID_COMMON_EXTERN void log(const std::string& message);
 
+    /** True if logging is selected for the named object. */
+    QPID_COMMON_EXTERN static bool isSelected(const std::string& object);
+
     struct Initializer {
         QPID_COMMON_EXTERN Initializer(Statement& s);
         Statement& statement;
@@ -73,7 +77,7 @@ struct Statement {
 
 ///@internal static initializer for a Statement.
 #define QPID_LOG_STATEMENT_INIT(level) \
-    { 0, __FILE__, __LINE__,  BOOST_CURRENT_FUNCTION, (::qpid::log::level) }
+    { 0, __FILE__, __LINE__,  BOOST_CURRENT_FUNCTION, (::qpid::log::level), 0 }
 
 /**
  * Like QPID_LOG but computes an additional boolean test expression
@@ -113,6 +117,25 @@ struct Statement {
         FLAG = stmt_.enabled;                                   \
     } while(0)
 
+/**
+ * Like QPID_LOG but the message can also be enabled for particular
+ * objects only, e.g. one connection or one queue, by the --log-object
+ * and --log-object-enable options. OBJECT is a std::string naming the
+ * object; it is only evaluated when some object is selected for this
+ * statement, so a disabled statement still costs a single test.
+ * e.g.
+ * QPID_LOG_FOR(trace, name, "Message " << msg << " enqueued on " << name);
+ */
+#define QPID_LOG_FOR(LEVEL, OBJECT, MESSAGE)                            \
+    do {                                                                \
+        using ::qpid::log::Statement;                                   \
+        static Statement stmt_= QPID_LOG_STATEMENT_INIT(LEVEL);         \
+        static Statement::Initializer init_(stmt_);                     \
+        if (stmt_.enabled ||                                            \
+            (stmt_.objectEnabled && Statement::isSelected(OBJECT)))     \
+            stmt_.log(::qpid::Msg() << MESSAGE);                        \
+    } while(0)
+
 /**
  * Macro for log statements. Example of use:
  * @code
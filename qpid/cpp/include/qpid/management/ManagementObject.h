@@ -23,6 +23,7 @@
  */
 #include "qpid/CommonImportExport.h"
 
+#include "qpid/management/MapEncoder.h"
 #include "qpid/management/Mutex.h"
 #include "qpid/types/Variant.h"
 
@@ -74,6 +75,7 @@ public:
     QPID_COMMON_EXTERN bool operator==(const ObjectId &other) const;
     QPID_COMMON_EXTERN bool operator<(const ObjectId &other) const;
     QPID_COMMON_EXTERN void mapEncode(types::Variant::Map& map) const;
+    QPID_COMMON_EXTERN void mapEncode(MapEncoder& map) const;
     QPID_COMMON_EXTERN void mapDecode(const types::Variant::Map& map);
     QPID_COMMON_EXTERN operator types::Variant::Map() const;
     QPID_COMMON_INLINE_EXTERN uint32_t encodedSize() const { return 16; };
@@ -150,6 +152,12 @@ protected:
     bool             forcePublish;
 
     QPID_COMMON_EXTERN int  getThreadIndex();
+    /** Per-thread statistics are given whole cache lines so that threads
+     * updating the same object do not contend for them. */
+    QPID_COMMON_EXTERN static void* allocThreadStats(size_t size);
+    QPID_COMMON_EXTERN static void freeThreadStats(void* stats);
+    /** True for about one call in every, chosen at random per thread */
+    QPID_COMMON_EXTERN static bool sampleNext(uint32_t every);
     QPID_COMMON_EXTERN void writeTimestamps(std::string& buf) const;
     QPID_COMMON_EXTERN void readTimestamps(const std::string& buf);
     QPID_COMMON_EXTERN uint32_t writeTimestampsSize() const;
@@ -157,6 +165,12 @@ protected:
   public:
     QPID_COMMON_EXTERN static const uint8_t MD5_LEN = 16;
     QPID_COMMON_EXTERN static int maxThreads;
+    /**
+     * Counters of classes marked sampled="y" in their schema count
+     * one update in this many, scaled up, rather than every update.
+     * 1, the default, counts exactly.
+     */
+    QPID_COMMON_EXTERN static uint32_t sampleInterval;
     //typedef void (*writeSchemaCall_t) (qpid::framing::Buffer&);
     typedef void (*writeSchemaCall_t) (std::string&);
 
@@ -171,12 +185,21 @@ protected:
     virtual void mapEncodeValues(types::Variant::Map& map,
                                  bool includeProperties,
                                  bool includeStatistics) = 0;
+    /**
+     * As above, but onto the open map of @a map. The generated classes
+     * write their fields straight to it; this default goes through a
+     * Variant::Map.
+     */
+    QPID_COMMON_EXTERN virtual void mapEncodeValues(MapEncoder& map,
+                                                    bool includeProperties,
+                                                    bool includeStatistics);
     virtual void mapDecodeValues(const types::Variant::Map& map) = 0;
     virtual void doMethod(std::string&           methodName,
                           const types::Variant::Map& inMap,
                           types::Variant::Map& outMap,
                           const std::string& userId) = 0;
     QPID_COMMON_EXTERN void writeTimestamps(types::Variant::Map& map) const;
+    QPID_COMMON_EXTERN void writeTimestamps(MapEncoder& map) const;
     QPID_COMMON_EXTERN void readTimestamps(const types::Variant::Map& buf);
 
     /**
@@ -203,6 +226,7 @@ protected:
     inline  void setForcePublish(bool f) { forcePublish = f; }
     inline  bool getForcePublish() { return forcePublish; }
     QPID_COMMON_EXTERN void setUpdateTime();
+    inline  uint64_t getUpdateTime() { return updateTime; }
     QPID_COMMON_EXTERN void resourceDestroy();
     inline bool isDeleted() { return deleted; }
     inline void setFlags(uint32_t f) { flags = f; }
@@ -0,0 +1,104 @@
+#ifndef _Management_MapEncoder_
+#define _Management_MapEncoder_
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "qpid/CommonImportExport.h"
+#include "qpid/types/Uuid.h"
+#include "qpid/types/Variant.h"
+#include <string>
+#include <vector>
+
+namespace qpid {
+namespace management {
+
+class ObjectId;
+
+/**
+ * Writes AMQP 0-10 maps and lists straight onto the end of a string,
+ * in the form amqp_0_10::MapCodec and ListCodec give a Variant::Map or
+ * Variant::List holding the same values, but without building one.
+ *
+ * Open a map or list with begin..., add to it with put, and close it
+ * with end. Inside a map every value has a key; inside a list none
+ * does. The outermost map or list has no type code, as with the codecs.
+ */
+class MapEncoder
+{
+public:
+    /** Append to @a out, which is left as it is until then. */
+    QPID_COMMON_EXTERN MapEncoder(std::string& out);
+
+    QPID_COMMON_EXTERN void beginMap();
+    QPID_COMMON_EXTERN void beginMap(const std::string& key);
+    QPID_COMMON_EXTERN void beginList();
+    QPID_COMMON_EXTERN void beginList(const std::string& key);
+    /** Close the innermost open map or list. */
+    QPID_COMMON_EXTERN void end();
+
+    QPID_COMMON_EXTERN void put(const std::string& key, bool b);
+    QPID_COMMON_EXTERN void put(const std::string& key, uint8_t i);
+    QPID_COMMON_EXTERN void put(const std::string& key, uint16_t i);
+    QPID_COMMON_EXTERN void put(const std::string& key, uint32_t i);
+    QPID_COMMON_EXTERN void put(const std::string& key, uint64_t i);
+    QPID_COMMON_EXTERN void put(const std::string& key, int8_t i);
+    QPID_COMMON_EXTERN void put(const std::string& key, int16_t i);
+    QPID_COMMON_EXTERN void put(const std::string& key, int32_t i);
+    QPID_COMMON_EXTERN void put(const std::string& key, int64_t i);
+    QPID_COMMON_EXTERN void put(const std::string& key, float f);
+    QPID_COMMON_EXTERN void put(const std::string& key, double f);
+    /** As a Variant string with no encoding: binary. */
+    QPID_COMMON_EXTERN void put(const std::string& key, const std::string& s);
+    QPID_COMMON_EXTERN void put(const std::string& key, const char* s);
+    QPID_COMMON_EXTERN void put(const std::string& key, const types::Uuid& u);
+    /** As ObjectId::mapEncode would give it. */
+    QPID_COMMON_EXTERN void put(const std::string& key, const ObjectId& oid);
+    QPID_COMMON_EXTERN void put(const std::string& key, const types::Variant::Map& map);
+    QPID_COMMON_EXTERN void put(const std::string& key, const types::Variant::List& list);
+    QPID_COMMON_EXTERN void put(const std::string& key, const types::Variant& value);
+    /** Add a list element. */
+    QPID_COMMON_EXTERN void put(const types::Variant& value);
+
+    /** Number of values in the innermost open map or list. */
+    QPID_COMMON_EXTERN uint32_t count() const;
+    /** Number of maps and lists still open. */
+    size_t depth() const { return open.size(); }
+
+private:
+    struct Container {
+        size_t start;           // Of the size field
+        uint32_t count;
+        bool isMap;
+        Container(size_t s, bool m) : start(s), count(0), isMap(m) {}
+    };
+
+    std::string& out;
+    std::vector<Container> open;
+
+    void entry(const std::string* key);
+    void begin(const std::string* key, bool isMap);
+    void putUint8(uint8_t i);
+    void putUint16(uint16_t i);
+    void putUint32(uint32_t i);
+    void putUint64(uint64_t i);
+};
+
+}} // namespace qpid::management
+
+#endif
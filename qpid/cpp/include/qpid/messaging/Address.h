@@ -103,8 +103,11 @@ class AddressImpl;
  *   <td>link</td>
  *   <td>A nested map through which properties of the 'link' from
  *       sender/receiver to node can be configured. Current propeties
- *       are name, durable, realiability, x-declare, x-subscribe and
- *       x-bindings.
+ *       are name, durable, realiability, x-declare, x-subscribe,
+ *       x-bindings and x-credit. For receivers, x-credit is a map in
+ *       which mode 'adaptive' sizes the prefetch window from the
+ *       consumption rate (up to the capacity) and max-bytes limits
+ *       the bytes prefetched.
  *   </td>
  * </tr>
  * 
@@ -60,6 +60,19 @@ class QPID_MESSAGING_CLASS_EXTERN Connection : public qpid::messaging::Handle<Co
      *     sasl_min_ssf
      *     sasl_max_ssf
      *     transport
+     *     compress: true/false (deflate the connection in both
+     *       directions if the broker supports it)
+     *     coalesce_output: true/false (hold messages sent while the
+     *       connection is writing until that write is done, to write
+     *       them together)
+     *     flush_delay: microseconds (hold messages sent this soon
+     *       after the last write until this long after it, to write
+     *       them together)
+     *     address_cache: true/false (remember the types of existing
+     *       nodes for addresses that do not state one, so later
+     *       senders and receivers on them are created without asking
+     *       the broker; addresses with create or delete policies are
+     *       always resolved afresh)
      * 
      * Reconnect behaviour can be controlled through the following options:
      * 
@@ -70,6 +83,8 @@ class QPID_MESSAGING_CLASS_EXTERN Connection : public qpid::messaging::Handle<Co
      *     reconnect_interval_max: number of seconds (maximum delay between failed reconnection attempts)
      *     reconnect_interval: shorthand for setting the same reconnect_interval_min/max
      *     reconnect_urls: list of alternate urls to try when connecting
+     *     reconnect_standby: true/false (keep a connection open to one of the
+     *       other urls while connected, and fail over to it first)
      *
      *     The reconnect_interval is the time that the client waits
      *     for after a failed attempt to reconnect before retrying. It
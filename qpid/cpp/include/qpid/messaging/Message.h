@@ -164,6 +164,13 @@ class QPID_MESSAGING_CLASS_EXTERN Message
 
     /** Get the content as a std::string */
     QPID_MESSAGING_EXTERN std::string getContent() const;
+    /**
+     * Exchange the content of the message with the string passed
+     * in. Unlike setContent() and getContent() this does not copy,
+     * so large payloads can be handed to, or taken from, a message
+     * cheaply.
+     */
+    QPID_MESSAGING_EXTERN void swapContent(std::string&);
     /**
      * Get a const pointer to the start of the content data. The
      * memory pointed to is owned by the message. The getContentSize()
@@ -0,0 +1,48 @@
+#ifndef QPID_MESSAGING_MESSAGELISTENER_H
+#define QPID_MESSAGING_MESSAGELISTENER_H
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "qpid/messaging/ImportExport.h"
+
+namespace qpid {
+namespace messaging {
+
+class Message;
+
+/**   \ingroup messaging 
+ * Implement a subclass of MessageListener and set it on a Receiver
+ * to have messages pushed to it rather than fetched.
+ *
+ * received() is called from the dispatch thread of the receiver's
+ * session, started with Session::startDispatch(), one message at a
+ * time and in the order the messages arrived for that receiver.
+ */
+class QPID_MESSAGING_CLASS_EXTERN MessageListener
+{
+  public:
+    QPID_MESSAGING_EXTERN virtual ~MessageListener();
+    virtual void received(Message& message) = 0;
+};
+
+}} // namespace qpid::messaging
+
+#endif  /*!QPID_MESSAGING_MESSAGELISTENER_H*/
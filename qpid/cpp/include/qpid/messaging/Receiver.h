@@ -35,6 +35,7 @@ template <class> class PrivateImplRef;
 #endif
 
 class Message;
+class MessageListener;
 class ReceiverImpl;
 class Session;
 
@@ -114,6 +115,15 @@ class QPID_MESSAGING_CLASS_EXTERN Receiver : public qpid::messaging::Handle<Rece
      */
     QPID_MESSAGING_EXTERN uint32_t getUnsettled();
 
+    /**
+     * Sets a listener to which messages for this receiver are pushed
+     * by the session's dispatch thread (see
+     * Session::startDispatch()), instead of being returned by fetch()
+     * or get(). Passing 0 removes the listener. The listener must
+     * remain valid until it is removed or the receiver is closed.
+     */
+    QPID_MESSAGING_EXTERN void setListener(MessageListener* listener);
+
     /**
      * Cancels this receiver.
      */
@@ -27,6 +27,7 @@
 #include "qpid/sys/IntegerTypes.h"
 
 #include <string>
+#include <vector>
 
 namespace qpid {
 namespace messaging {
@@ -57,6 +58,16 @@ class QPID_MESSAGING_CLASS_EXTERN Sender : public qpid::messaging::Handle<Sender
      * available capacity (i.e. pending == capacity)
      */
     QPID_MESSAGING_EXTERN void send(const Message& message, bool sync=false);
+    /**
+     * Sends each of the messages in turn, as send(const Message&)
+     * would, but takes the sender's lock only once and flushes the
+     * session once for the whole batch.
+     *
+     * @param messages the messages to send, in order
+     * @param sync if true the call will block until the server
+     * confirms receipt of all the messages
+     */
+    QPID_MESSAGING_EXTERN void send(const std::vector<Message>& messages, bool sync=false);
     QPID_MESSAGING_EXTERN void close();
 
     /**
@@ -141,6 +141,21 @@ class QPID_MESSAGING_CLASS_EXTERN Session : public qpid::messaging::Handle<Sessi
      * available in time.
      */
     QPID_MESSAGING_EXTERN Receiver nextReceiver(Duration timeout=Duration::FOREVER);
+
+    /**
+     * Starts a thread that passes each message arriving for a
+     * receiver of this session with a listener (see
+     * Receiver::setListener()) to that listener. Messages for
+     * receivers without a listener are left for fetch() and
+     * nextReceiver(). Dispatch continues until stopDispatch() or
+     * close() is called.
+     */
+    QPID_MESSAGING_EXTERN void startDispatch();
+    /**
+     * Stops the dispatch thread, waiting for a listener that is
+     * running to return unless called from within a listener.
+     */
+    QPID_MESSAGING_EXTERN void stopDispatch();
     
     /**
      * Create a new sender through which messages can be sent to the
@@ -91,6 +91,14 @@ public:
     // Default copy constructor fine
 
     QPID_COMMON_EXTERN static AbsTime now();
+    /**
+     * The same clock as now() read only to the resolution of the
+     * scheduler tick (a few milliseconds at worst) where the platform
+     * can do that more cheaply; otherwise simply now(). For
+     * timestamps taken per message or per read that only need to be
+     * right to the millisecond, e.g. expiry and rate limits.
+     */
+    QPID_COMMON_EXTERN static AbsTime coarseNow();
     QPID_COMMON_EXTERN static AbsTime FarFuture();
     QPID_COMMON_EXTERN static AbsTime Epoch();
 
@@ -49,6 +49,11 @@ public:
     {}
 
     int fd;
+
+    // The fd of a handle, for code that submits IO on it directly
+    static int fdOf(const IOHandle& h) {
+        return h.impl->fd;
+    }
 };
 
 int toFd(const IOHandlePrivate* h);
@@ -166,6 +166,8 @@ class QPID_TYPES_CLASS_EXTERN Variant
     QPID_TYPES_EXTERN bool isEqualTo(const Variant& a) const;
 
     QPID_TYPES_EXTERN void reset();
+    /** Exchange values with @a other without copying either */
+    QPID_TYPES_EXTERN void swap(Variant& other);
   private:
     VariantImpl* impl;
 };
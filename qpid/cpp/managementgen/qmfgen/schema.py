@@ -29,6 +29,8 @@ except ImportError:
 
 class Hash:
   """ Manage the hash of an XML sub-tree """
+  hints = ['sampled']
+
   def __init__(self, node):
     self.md5Sum = _md5Obj()
     self._compute(node)
@@ -45,6 +47,9 @@ class Hash:
     self.md5Sum.update(node.nodeName)
 
     for idx in range(attrs.length):
+      # Code generation hints do not change the schema consoles see
+      if attrs.item(idx).nodeName in Hash.hints:
+        continue
       self.md5Sum.update(attrs.item(idx).nodeName)
       self.md5Sum.update(attrs.item(idx).nodeValue)
 
@@ -138,7 +143,27 @@ class SchemaType:
   def getName (self):
     return self.name
 
-  def genAccessor (self, stream, varName, changeFlag = None, optional = False):
+  def genSetChanged (self, stream, changeFlag):
+    if changeFlag == None:
+      return
+    if self.perThread:
+      # Only write the shared flag when it changes, so threads updating
+      # their own slots do not keep taking the object's cache line.
+      stream.write ("        if (!" + changeFlag + ")\n")
+      stream.write ("            " + changeFlag + " = true;\n")
+    else:
+      stream.write ("        " + changeFlag + " = true;\n")
+
+  def genSample (self, stream):
+    # Count one update in every sampleInterval, scaled up to estimate the rest
+    stream.write ("        uint32_t every = sampleInterval;\n")
+    stream.write ("        if (every > 1) {\n")
+    stream.write ("            if (!sampleNext(every)) return;\n")
+    stream.write ("            by *= every;\n")
+    stream.write ("        }\n")
+
+  def genAccessor (self, stream, varName, changeFlag = None, optional = False, sampled = False):
+    sampled = sampled and self.perThread
     if self.perThread:
       prefix = "getThreadStats()->"
       if self.style == "wm":
@@ -165,8 +190,7 @@ class SchemaType:
         stream.write ("            " + prefix + varName + "Min = val;\n")
         stream.write ("        if (" + prefix + varName + "Max < val)\n")
         stream.write ("            " + prefix + varName + "Max = val;\n")
-      if changeFlag != None:
-        stream.write ("        " + changeFlag + " = true;\n")
+      self.genSetChanged (stream, changeFlag)
       stream.write ("    }\n")
       if self.style != "mma":
         stream.write ("    inline " + self.asArg + " get_" + varName + "() {\n");
@@ -177,8 +201,7 @@ class SchemaType:
       if optional:
         stream.write ("    inline void clr_" + varName + "() {\n")
         stream.write ("        presenceMask[presenceByte_%s] &= ~presenceMask_%s;\n" % (varName, varName))
-        if changeFlag != None:
-          stream.write ("        " + changeFlag + " = true;\n")
+        self.genSetChanged (stream, changeFlag)
         stream.write ("    }\n")
         stream.write ("    inline bool isSet_" + varName + "() {\n")
         stream.write ("        return (presenceMask[presenceByte_%s] & presenceMask_%s) != 0;\n" % (varName, varName))
@@ -187,22 +210,24 @@ class SchemaType:
       stream.write ("    inline void inc_" + varName + " (" + self.asArg + " by = 1) {\n");
       if not self.perThread:
         stream.write ("        ::qpid::management::Mutex::ScopedLock mutex(accessLock);\n")
+      if sampled:
+        self.genSample (stream)
       stream.write ("        " + prefix + varName + " += by;\n")
       if self.style == "wm":
         stream.write ("        if (" + varName + "High < " + varName + ")\n")
         stream.write ("            " + varName + "High = " + varName + ";\n")
-      if changeFlag != None:
-        stream.write ("        " + changeFlag + " = true;\n")
+      self.genSetChanged (stream, changeFlag)
       stream.write ("    }\n");
       stream.write ("    inline void dec_" + varName + " (" + self.asArg + " by = 1) {\n");
       if not self.perThread:
         stream.write ("        ::qpid::management::Mutex::ScopedLock mutex(accessLock);\n")
+      if sampled:
+        self.genSample (stream)
       stream.write ("        " + prefix + varName + " -= by;\n")
       if self.style == "wm":
         stream.write ("        if (" + varName + "Low > " + varName + ")\n")
         stream.write ("            " + varName + "Low = " + varName + ";\n")
-      if changeFlag != None:
-        stream.write ("        " + changeFlag + " = true;\n")
+      self.genSetChanged (stream, changeFlag)
       stream.write ("    }\n");
 
   def genHiLoStatResets (self, stream, varName):
@@ -281,6 +306,33 @@ class SchemaType:
         stream.write(indent + mapName + "[\"" + key + "Avg\"] = " +
                      "(" + varName + "Count ? ::qpid::types::Variant(" + var_cast + ") : ::qpid::types::Variant(0));\n")
 
+  def genMapEncoder (self, stream, varName, indent="    ", key=None, mapName="_map"):
+    if key is None:
+      key = varName
+    if self.style != "mma":
+        var_cast = self.map.replace("#", varName)
+        stream.write(indent + mapName + ".put(\"" + key + "\", " + var_cast + ");\n")
+    if self.style == "wm":
+        var_cast_hi = self.map.replace("#", varName + "High")
+        var_cast_lo = self.map.replace("#", varName + "Low")
+        stream.write(indent + mapName + ".put(\"" + key + "High\", " + var_cast_hi + ");\n")
+        stream.write(indent + mapName + ".put(\"" + key + "Low\", " + var_cast_lo + ");\n")
+    if self.style == "mma":
+        var_cast = self.map.replace("#", varName + "Count")
+        stream.write(indent + mapName + ".put(\"" + key + "Count\", " + var_cast + ");\n")
+        var_cast_min = self.map.replace("#", varName + "Min")
+        var_cast_max = self.map.replace("#", varName + "Max")
+        var_cast_avg = self.map.replace("#", "(" + varName + "Total / " + varName + "Count)")
+        stream.write(indent + "if (" + varName + "Count) {\n")
+        stream.write(indent + "    " + mapName + ".put(\"" + key + "Min\", " + var_cast_min + ");\n")
+        stream.write(indent + "    " + mapName + ".put(\"" + key + "Max\", " + var_cast_max + ");\n")
+        stream.write(indent + "    " + mapName + ".put(\"" + key + "Avg\", " + var_cast_avg + ");\n")
+        stream.write(indent + "} else {\n")
+        stream.write(indent + "    " + mapName + ".put(\"" + key + "Min\", int32_t(0));\n")
+        stream.write(indent + "    " + mapName + ".put(\"" + key + "Max\", " + var_cast_max + ");\n")
+        stream.write(indent + "    " + mapName + ".put(\"" + key + "Avg\", int32_t(0));\n")
+        stream.write(indent + "}\n")
+
   def getReadCode (self, varName, bufName):
     result = self.decode.replace ("@", bufName).replace ("#", varName)
     return result
@@ -512,6 +564,15 @@ class SchemaProperty:
     if self.isOptional:
       stream.write("    }\n")
 
+  def genMapEncoder (self, stream):
+    indent = "    "
+    if self.isOptional:
+      stream.write("    if (presenceMask[presenceByte_%s] & presenceMask_%s) {\n" % (self.name, self.name))
+      indent = "        "
+    self.type.type.genMapEncoder (stream, self.name, indent)
+    if self.isOptional:
+      stream.write("    }\n")
+
 
   def __repr__(self):
     m = {}
@@ -583,8 +644,8 @@ class SchemaStatistic:
       stream.write (prefix + self.type.type.cpp + "  " + self.name + "Min;\n")
       stream.write (prefix + self.type.type.cpp + "  " + self.name + "Max;\n")
 
-  def genAccessor (self, stream):
-    self.type.type.genAccessor (stream, self.name, "instChanged")
+  def genAccessor (self, stream, sampled = False):
+    self.type.type.genAccessor (stream, self.name, "instChanged", sampled = sampled)
 
   def genHiLoStatResets (self, stream):
     self.type.type.genHiLoStatResets (stream, self.name)
@@ -686,6 +747,12 @@ class SchemaStatistic:
     else:
       self.type.type.genMap(stream, self.name)
 
+  def genMapEncoder (self, stream):
+    if self.type.type.perThread:
+      self.type.type.genMapEncoder(stream, "totals." + self.name, key=self.name)
+    else:
+      self.type.type.genMapEncoder(stream, self.name)
+
   def genInitialize (self, stream, prefix="", indent="    "):
     val = self.type.type.init
     if self.type.type.style != "mma":
@@ -1078,6 +1145,13 @@ class SchemaClass:
 
     attrs = node.attributes
     self.name = makeValidCppSymbol(attrs['name'].nodeValue)
+    # Counters of a sampled class may be sampled rather than counted
+    # exactly, see ManagementObject::sampleInterval
+    self.sampled = False
+    if attrs.get('sampled') != None:
+      if attrs['sampled'].nodeValue != 'y':
+        raise ValueError ("Expected 'y' in sampled attribute")
+      self.sampled = True
 
     children = node.childNodes
     for child in children:
@@ -1189,7 +1263,7 @@ class SchemaClass:
         config.genAccessor (stream)
     for inst in self.statistics:
       if inst.assign == None:
-        inst.genAccessor (stream)
+        inst.genAccessor (stream, self.sampled)
 
   def genAgentHeaderLocation (self, stream, variables):
     stream.write(variables["agentHeaderDir"])
@@ -1555,6 +1629,14 @@ class SchemaClass:
       for stat in self.statistics:
           stat.genMap (stream)
 
+  def genMapEncoderProperties(self, stream, variables):
+      for prop in self.properties:
+          prop.genMapEncoder (stream)
+
+  def genMapEncoderStatistics (self, stream, variables):
+      for stat in self.statistics:
+          stat.genMapEncoder (stream)
+
   def genMapDecodeProperties (self, stream, variables):
       for prop in self.properties:
           prop.genUnmap (stream)
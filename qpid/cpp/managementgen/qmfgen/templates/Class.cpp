@@ -64,8 +64,7 @@ uint8_t /*MGEN:Class.NameCap*/::md5Sum[MD5_LEN]   =
 {
 /*MGEN:IF(Class.ExistPerThreadStats)*/
     for (int idx = 0; idx < maxThreads; idx++)
-        if (perThreadStatsArray[idx] != 0)
-            delete perThreadStatsArray[idx];
+        freeThreadStats(perThreadStatsArray[idx]);
     delete[] perThreadStatsArray;
 /*MGEN:ENDIF*/
 }
@@ -318,6 +317,48 @@ void /*MGEN:Class.NameCap*/::mapEncodeValues (::qpid::types::Variant::Map& _map,
     }
 }
 
+void /*MGEN:Class.NameCap*/::mapEncodeValues (::qpid::management::MapEncoder& _map,
+                                              bool includeProperties,
+                                              bool includeStatistics)
+{
+    Mutex::ScopedLock mutex(accessLock);
+
+    if (includeProperties) {
+        configChanged = false;
+/*MGEN:Class.MapEncoderProperties*/
+    }
+
+    if (includeStatistics) {
+        instChanged = false;
+/*MGEN:IF(Class.ExistPerThreadAssign)*/
+        for (int idx = 0; idx < maxThreads; idx++) {
+            struct PerThreadStats* threadStats = perThreadStatsArray[idx];
+            if (threadStats != 0) {
+/*MGEN:Class.PerThreadAssign*/
+            }
+        }
+/*MGEN:ENDIF*/
+/*MGEN:IF(Class.ExistPerThreadStats)*/
+        struct PerThreadStats totals;
+        aggregatePerThreadStats(&totals);
+/*MGEN:ENDIF*/
+/*MGEN:Class.Assign*/
+
+/*MGEN:Class.MapEncoderStatistics*/
+
+    // Maintenance of hi-lo statistics
+/*MGEN:Class.HiLoStatResets*/
+/*MGEN:IF(Class.ExistPerThreadResets)*/
+        for (int idx = 0; idx < maxThreads; idx++) {
+            struct PerThreadStats* threadStats = perThreadStatsArray[idx];
+            if (threadStats != 0) {
+/*MGEN:Class.PerThreadHiLoStatResets*/
+            }
+        }
+/*MGEN:ENDIF*/
+    }
+}
+
 void /*MGEN:Class.NameCap*/::mapDecodeValues (const ::qpid::types::Variant::Map& _map)
 {
     ::qpid::types::Variant::Map::const_iterator _i;
@@ -24,6 +24,8 @@
 /*MGEN:Root.Disclaimer*/
 
 #include "qpid/management/ManagementObject.h"
+#include <limits>
+#include <new>
 
 namespace qpid {
     namespace management {
@@ -62,7 +64,7 @@ class /*MGEN:Class.NameCap*/ : public ::qpid::management::ManagementObject
         int idx = getThreadIndex();
         struct PerThreadStats* threadStats = perThreadStatsArray[idx];
         if (threadStats == 0) {
-            threadStats = new(PerThreadStats);
+            threadStats = new(allocThreadStats(sizeof(PerThreadStats))) PerThreadStats;
             perThreadStatsArray[idx] = threadStats;
 /*MGEN:Class.InitializePerThreadElements*/
         }
@@ -76,6 +78,9 @@ class /*MGEN:Class.NameCap*/ : public ::qpid::management::ManagementObject
     void mapEncodeValues(::qpid::types::Variant::Map& map,
                          bool includeProperties=true,
                          bool includeStatistics=true);
+    void mapEncodeValues(::qpid::management::MapEncoder& map,
+                         bool includeProperties=true,
+                         bool includeStatistics=true);
     void mapDecodeValues(const ::qpid::types::Variant::Map& map);
     void doMethod(std::string&           methodName,
                   const ::qpid::types::Variant::Map& inMap,
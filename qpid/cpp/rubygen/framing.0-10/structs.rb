@@ -479,7 +479,7 @@ void #{classname}::encodeStructBody(Buffer& #{buffer}) const
 {
 EOS
       if (execution_header?(s))
-        genl "encodeHeader(buffer);"
+        genl "ModelMethod::encodeHeader(buffer);"
       end
 
       if (is_packed(s))
@@ -511,7 +511,7 @@ void #{classname}::decodeStructBody(Buffer& #{buffer}, uint32_t /*size*/)
 {
 EOS
       if (execution_header?(s))
-        genl "decodeHeader(buffer);"
+        genl "ModelMethod::decodeHeader(buffer);"
       end
 
       if (is_packed(s))
@@ -540,7 +540,7 @@ uint32_t #{classname}::bodySize() const
     uint32_t total = 0;
 EOS
       if (execution_header?(s))
-        genl "total += headerSize();"
+        genl "total += ModelMethod::headerSize();"
       end
 
       if (is_packed(s))
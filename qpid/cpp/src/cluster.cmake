@@ -63,6 +63,15 @@ if (BUILD_CLUSTER)
   endif (HAVE_LIBCMAN AND HAVE_LIBCMAN_H)
 
   option(BUILD_CLUSTER_QUORUM "Include libcman quorum service integration" ${cluster_quorum_default})
+
+  # Optional zlib, to compress multicast client data
+  find_library(LIBZ z)
+  CHECK_INCLUDE_FILES (zlib.h HAVE_ZLIB_H)
+  if (LIBZ AND HAVE_ZLIB_H)
+    set (ZLIB_LIB ${LIBZ})
+  else (LIBZ AND HAVE_ZLIB_H)
+    set (HAVE_ZLIB_H OFF)
+  endif (LIBZ AND HAVE_ZLIB_H)
   if (BUILD_CLUSTER_QUORUM)
     if (NOT HAVE_LIBCMAN)
       message(FATAL_ERROR "libcman not found, install cman-devel or cmanlib-devel")
@@ -140,7 +149,7 @@ if (BUILD_CLUSTER)
       )
 
   add_library (cluster MODULE ${cluster_SOURCES})
-  target_link_libraries (cluster ${LIBCPG} ${CMAN_LIB} qpidbroker qpidclient ${Boost_FILESYSTEM_LIBRARY} ${Boost_SYSTEM_LIBRARY})
+  target_link_libraries (cluster ${LIBCPG} ${CMAN_LIB} ${ZLIB_LIB} qpidbroker qpidclient ${Boost_FILESYSTEM_LIBRARY} ${Boost_SYSTEM_LIBRARY})
   set_target_properties (cluster PROPERTIES PREFIX "")
   
   # Create a second shared library for linking with test executables,
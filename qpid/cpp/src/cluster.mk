@@ -32,6 +32,11 @@ else
 CMAN_SOURCES = qpid/cluster/Quorum_null.h
 endif
 
+# Optional zlib to compress multicast data
+if HAVE_ZLIB
+libz = -lz
+endif
+
 if HAVE_LIBCPG
 
 dmoduleexec_LTLIBRARIES += cluster.la
@@ -97,7 +102,7 @@ cluster_la_SOURCES =				\
   qpid/cluster/UpdateDataExchange.h		\
   qpid/cluster/UpdateDataExchange.cpp
 
-cluster_la_LIBADD=  -lcpg $(libcman) libqpidbroker.la libqpidclient.la
+cluster_la_LIBADD=  -lcpg $(libcman) $(libz) libqpidbroker.la libqpidclient.la
 cluster_la_CXXFLAGS = $(AM_CXXFLAGS) -fno-strict-aliasing
 cluster_la_LDFLAGS = $(PLUGINLDFLAGS)
 
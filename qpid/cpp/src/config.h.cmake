@@ -54,12 +54,20 @@
 
 #cmakedefine QPID_HAS_CLOCK_GETTIME
 
+#cmakedefine QPID_MESSAGE_POOL
+
+#cmakedefine QPID_HAS_PROBES
+#cmakedefine QPID_HAS_ALLOCATION_COUNTS
+#cmakedefine HAVE_SYS_SDT_H
+#cmakedefine HAVE_SYS_EVENTFD_H
+
 #cmakedefine BROKER_SASL_NAME "${BROKER_SASL_NAME}"
 #cmakedefine HAVE_SASL ${HAVE_SASL}
 
 #cmakedefine HAVE_OPENAIS_CPG_H ${HAVE_OPENAIS_CPG_H}
 #cmakedefine HAVE_COROSYNC_CPG_H ${HAVE_COROSYNC_CPG_H}
 #cmakedefine HAVE_LIBCMAN_H ${HAVE_LIBCMAN_H}
+#cmakedefine HAVE_ZLIB_H ${HAVE_ZLIB_H}
 #cmakedefine HAVE_LOG_AUTHPRIV
 #cmakedefine HAVE_LOG_FTP
 
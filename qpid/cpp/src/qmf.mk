@@ -108,9 +108,6 @@ libqmf2_la_SOURCES = 		\
   qmf/EventNotifierImpl.cpp	\
   qmf/PosixEventNotifier.cpp	\
   qmf/PosixEventNotifierImpl.cpp \
-  qmf/exceptions.cpp		\
-  qmf/Expression.cpp		\
-  qmf/Expression.h		\
   qmf/Hash.cpp			\
   qmf/Hash.h			\
   qmf/PrivateImplRef.h		\
@@ -96,6 +96,10 @@ ConsoleSessionImpl::ConsoleSessionImpl(Connection& c, const string& options) :
         iter = optMap.find("max-thread-wait-time");
         if (iter != optMap.end())
             maxThreadWaitTime = iter->second.asUint32();
+
+        iter = optMap.find("shared-schema-cache");
+        if (iter != optMap.end() && iter->second.asBool())
+            schemaCache = SchemaCache::shared();
     }
 
     if (maxThreadWaitTime > 60)
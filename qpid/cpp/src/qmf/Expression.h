@@ -21,6 +21,7 @@
  *
  */
 
+#include "qmf/ImportExport.h"
 #include "qpid/types/Variant.h"
 #include <string>
 #include <list>
@@ -48,10 +49,10 @@ namespace qmf {
     BOOL_FALSE    = 10
     };
 
-    class Expression {
+    class QMF_CLASS_EXTERN Expression {
     public:
-        Expression(const qpid::types::Variant::List& expr);
-        bool evaluate(const qpid::types::Variant::Map& data) const;
+        QMF_EXTERN Expression(const qpid::types::Variant::List& expr);
+        QMF_EXTERN bool evaluate(const qpid::types::Variant::Map& data) const;
     private:
         LogicalOp logicalOp;
         BooleanOp boolOp;
@@ -89,3 +89,16 @@ const Schema& SchemaCache::getSchema(const SchemaId& id, qpid::messaging::Durati
     throw QmfException("Schema lookup timed out");
 }
 
+
+namespace {
+    qpid::sys::Mutex sharedLock;
+    boost::shared_ptr<SchemaCache> sharedCache;
+}
+
+boost::shared_ptr<SchemaCache> SchemaCache::shared()
+{
+    qpid::sys::Mutex::ScopedLock l(sharedLock);
+    if (!sharedCache)
+        sharedCache.reset(new SchemaCache());
+    return sharedCache;
+}
@@ -42,6 +42,12 @@ namespace qmf {
         bool haveSchema(const SchemaId&) const;
         const Schema& getSchema(const SchemaId&, qpid::messaging::Duration) const;
 
+        /**
+         * The cache shared by the sessions that ask for it.  Schema ids carry
+         * the schema's hash, so one learned from any agent serves them all.
+         */
+        static boost::shared_ptr<SchemaCache> shared();
+
     private:
         mutable qpid::sys::Mutex lock;
         typedef std::map<SchemaId, Schema, SchemaIdCompare> SchemaMap;
@@ -44,16 +44,9 @@ namespace {
 
 const Object* QueryResponseImpl::getObject(uint32_t idx) const
 {
-    vector<ObjectPtr>::const_iterator iter = results.begin();
-
-    while (idx > 0) {
-        if (iter == results.end())
-            return 0;
-        iter++;
-        idx--;
-    }
-
-    return iter->get();
+    if (idx >= results.size())
+        return 0;
+    return results[idx].get();
 }
 
 #define STRING_REF(s) {if (!s.empty()) item.s = const_cast<char*>(s.c_str());}
@@ -75,7 +68,8 @@ BrokerEvent BrokerEventImpl::copy()
     return item;
 }
 
-BrokerProxyImpl::BrokerProxyImpl(BrokerProxy& pub, Console& _console) : publicObject(pub), console(_console)
+BrokerProxyImpl::BrokerProxyImpl(BrokerProxy& pub, Console& _console) :
+    publicObject(pub), console(_console), xmtFrontTaken(false)
 {
     stringstream qn;
     qpid::Address addr;
@@ -144,6 +138,30 @@ void BrokerProxyImpl::sendBufferLH(Buffer& buf, const string& destination, const
     xmtQueue.push_back(message);
 }
 
+//
+// Requests for the broker's own agent are added to the last message queued
+// for it, if that has not been taken for sending: the broker handles every
+// request in a message, so a burst of them costs one message. Only use this
+// for requests whose encoding is self-delimiting, which a method request's
+// arguments are not. Other agents handle one request per message.
+//
+void BrokerProxyImpl::sendBrokerRequestLH(Buffer& buf, const string& routingKey)
+{
+    if (!xmtQueue.empty() && !(xmtQueue.size() == 1 && xmtFrontTaken)) {
+        MessageImpl::Ptr last(xmtQueue.back());
+        uint32_t length = buf.getPosition();
+        if (last->routingKey == routingKey && last->destination == QMF_EXCHANGE &&
+            last->body.size() + length <= MA_BUFFER_SIZE) {
+            string more;
+            buf.reset();
+            buf.getRawData(more, length);
+            last->body += more;
+            return;
+        }
+    }
+    sendBufferLH(buf, QMF_EXCHANGE, routingKey);
+}
+
 void BrokerProxyImpl::handleRcvMessage(Message& message)
 {
     Buffer inBuffer(message.body, message.length);
@@ -160,6 +178,7 @@ bool BrokerProxyImpl::getXmtMessage(Message& item) const
     if (xmtQueue.empty())
         return false;
     item =  xmtQueue.front()->copy();
+    xmtFrontTaken = true;
     return true;
 }
 
@@ -168,6 +187,7 @@ void BrokerProxyImpl::popXmt()
     Mutex::ScopedLock _lock(lock);
     if (!xmtQueue.empty())
         xmtQueue.pop_front();
+    xmtFrontTaken = false;
 }
 
 bool BrokerProxyImpl::getEvent(BrokerEvent& event) const
@@ -204,7 +224,7 @@ const AgentProxy* BrokerProxyImpl::getAgent(uint32_t idx) const
 
 void BrokerProxyImpl::sendQuery(const Query& query, void* context, const AgentProxy* agent)
 {
-    SequenceContext::Ptr queryContext(new QueryContext(*this, context));
+    SequenceContext::Ptr queryContext(new QueryContext(*this, context, console.impl->settings.queryBatchSize));
     Mutex::ScopedLock _lock(lock);
     bool sent = false;
     if (agent != 0) {
@@ -239,7 +259,10 @@ bool BrokerProxyImpl::sendGetRequestLH(SequenceContext::Ptr queryContext, const
     Protocol::encodeHeader(outBuffer, Protocol::OP_GET_QUERY, sequence);
     query.impl->encode(outBuffer);
     key << "agent.1." << agent->impl->agentBank;
-    sendBufferLH(outBuffer, QMF_EXCHANGE, key.str());
+    if (key.str() == BROKER_AGENT_KEY)
+        sendBrokerRequestLH(outBuffer, key.str());
+    else
+        sendBufferLH(outBuffer, QMF_EXCHANGE, key.str());
     QPID_LOG(trace, "SENT GetQuery seq=" << sequence << " key=" << key.str());
     return true;
 }
@@ -390,6 +413,14 @@ BrokerEventImpl::Ptr BrokerProxyImpl::eventQueryComplete(void* context, QueryRes
     return event;
 }
 
+BrokerEventImpl::Ptr BrokerProxyImpl::eventQueryPartial(void* context, QueryResponsePtr response)
+{
+    BrokerEventImpl::Ptr event(new BrokerEventImpl(BrokerEvent::QUERY_PARTIAL));
+    event->context = context;
+    event->queryResponse = response;
+    return event;
+}
+
 BrokerEventImpl::Ptr BrokerProxyImpl::eventMethodResponse(void* context, MethodResponsePtr response)
 {
     BrokerEventImpl::Ptr event(new BrokerEventImpl(BrokerEvent::METHOD_RESPONSE));
@@ -527,7 +558,7 @@ void BrokerProxyImpl::handleSchemaResponse(Buffer& inBuffer, uint32_t seq)
             ft.setString("_class", AGENT_CLASS);
             ft.setString("_package", BROKER_PACKAGE);
             ft.encode(outBuffer);
-            sendBufferLH(outBuffer, QMF_EXCHANGE, BROKER_AGENT_KEY);
+            sendBrokerRequestLH(outBuffer, BROKER_AGENT_KEY);
             QPID_LOG(trace, "SENT GetQuery seq=" << sequence << " key=" << BROKER_AGENT_KEY);
         }
     } else if (kind == CLASS_EVENT) {
@@ -758,8 +789,17 @@ bool QueryContext::handleMessage(uint8_t opcode, uint32_t sequence, const string
     }
     else if (opcode == Protocol::OP_OBJECT_INDICATION) {
         object = broker.handleObjectIndication(buffer, sequence, true,  true);
-        if (object.get() != 0)
+        if (object.get() != 0) {
             queryResponse->impl->results.push_back(object);
+            if (batchSize && queryResponse->impl->results.size() >= batchSize) {
+                // Hand over what has arrived, rather than hold all of a
+                // large result until the last agent has answered
+                QueryResponsePtr partial(queryResponse);
+                queryResponse.reset(QueryResponseImpl::factory());
+                Mutex::ScopedLock _block(broker.lock);
+                broker.eventQueue.push_back(broker.eventQueryPartial(userContext, partial));
+            }
+        }
     }
     else {
         QPID_LOG(trace, "QueryContext::handleMessage invalid opcode: " << opcode);
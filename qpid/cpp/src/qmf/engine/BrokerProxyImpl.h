@@ -130,6 +130,7 @@ namespace engine {
         void startProtocol();
 
         void sendBufferLH(qpid::framing::Buffer& buf, const std::string& destination, const std::string& routingKey);
+        void sendBrokerRequestLH(qpid::framing::Buffer& buf, const std::string& routingKey);
         void handleRcvMessage(Message& message);
         bool getXmtMessage(Message& item) const;
         void popXmt();
@@ -162,6 +163,7 @@ namespace engine {
         bool topicBound;
         std::map<uint32_t, AgentProxyPtr> agentList;
         std::deque<MessageImpl::Ptr> xmtQueue;
+        mutable bool xmtFrontTaken;     // The front of xmtQueue is being sent
         std::deque<BrokerEventImpl::Ptr> eventQueue;
 
 #       define MA_BUFFER_SIZE 65536
@@ -172,6 +174,7 @@ namespace engine {
         BrokerEventImpl::Ptr eventSetupComplete();
         BrokerEventImpl::Ptr eventStable();
         BrokerEventImpl::Ptr eventQueryComplete(void* context, QueryResponsePtr response);
+        BrokerEventImpl::Ptr eventQueryPartial(void* context, QueryResponsePtr response);
         BrokerEventImpl::Ptr eventMethodResponse(void* context, MethodResponsePtr response);
 
         void handleBrokerResponse(qpid::framing::Buffer& inBuffer, uint32_t seq);
@@ -207,8 +210,8 @@ namespace engine {
     // QueryContext is used to track and handle responses associated with a single Get Query
     //
     struct QueryContext : public SequenceContext {
-        QueryContext(BrokerProxyImpl& b, void* u) :
-        broker(b), userContext(u), requestsOutstanding(0), queryResponse(QueryResponseImpl::factory()) {}
+        QueryContext(BrokerProxyImpl& b, void* u, uint32_t batch) :
+        broker(b), userContext(u), requestsOutstanding(0), batchSize(batch), queryResponse(QueryResponseImpl::factory()) {}
         virtual ~QueryContext() {}
         void reserve();
         void release();
@@ -218,6 +221,7 @@ namespace engine {
         BrokerProxyImpl& broker;
         void* userContext;
         uint32_t requestsOutstanding;
+        uint32_t batchSize;
         QueryResponsePtr queryResponse;
     };
 
@@ -50,6 +50,8 @@ template <class T> class BufferRefT {
     }
 
   private:
+    template <class U> friend class BufferRefT;
+
     boost::intrusive_ptr<RefCounted> counter;
     T* begin_;
     T* end_;
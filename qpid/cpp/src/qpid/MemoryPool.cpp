@@ -0,0 +1,95 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "qpid/MemoryPool.h"
+#include "qpid/sys/HugePages.h"
+#include "qpid/sys/Thread.h"
+#include <new>
+
+namespace qpid {
+
+#ifdef QPID_MESSAGE_POOL
+namespace {
+const size_t Granularity = 32;
+const size_t Classes = 32;      // Blocks of up to 1KB are pooled
+const size_t MaxFree = 256;     // Blocks kept per size class per thread
+
+struct Block { Block* next; };
+
+QPID_TSS Block* freeBlocks[Classes];
+QPID_TSS size_t freeCount[Classes];
+
+// Sizes of 0 wrap round to a class that is never pooled
+inline size_t sizeClass(size_t size) { return (size + Granularity - 1) / Granularity - 1; }
+}
+
+void* MemoryPool::allocate(size_t size)
+{
+    size_t c = sizeClass(size);
+    if (c >= Classes) return ::operator new(size);
+    Block* b = freeBlocks[c];
+    if (!b) {
+        void* block = sys::HugePages::allocate((c + 1) * Granularity);
+        return block ? block : ::operator new((c + 1) * Granularity);
+    }
+    freeBlocks[c] = b->next;
+    --freeCount[c];
+    return b;
+}
+
+void MemoryPool::release(void* block, size_t size)
+{
+    if (!block) return;
+    size_t c = sizeClass(size);
+    if (c >= Classes) {
+        ::operator delete(block);
+        return;
+    }
+    if (freeCount[c] >= MaxFree) {
+        if (!sys::HugePages::release(block, (c + 1) * Granularity))
+            ::operator delete(block);
+        return;
+    }
+    Block* b = static_cast<Block*>(block);
+    b->next = freeBlocks[c];
+    freeBlocks[c] = b;
+    ++freeCount[c];
+}
+
+#else
+
+void* MemoryPool::allocate(size_t size)
+{
+    return ::operator new(size);
+}
+
+void MemoryPool::release(void* block, size_t)
+{
+    ::operator delete(block);
+}
+
+#endif
+
+} // namespace qpid
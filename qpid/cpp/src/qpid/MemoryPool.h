@@ -0,0 +1,57 @@
+#ifndef QPID_MEMORYPOOL_H
+#define QPID_MEMORYPOOL_H
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/CommonImportExport.h"
+#include "qpid/sys/IntegerTypes.h"
+#include <stddef.h>
+
+namespace qpid {
+
+/**
+ * Per-thread free lists of small blocks, used by the operator new and
+ * delete of the objects created for every message transfer. A block
+ * released on another thread joins that thread's lists. Each list is
+ * bounded and blocks still listed when a thread exits are not
+ * reclaimed, so the pool is for long lived worker threads. New blocks
+ * come from huge pages when sys::HugePages has been configured.
+ *
+ * The pool is only built in when configured with the message pool
+ * option; otherwise allocate() and release() use the global heap.
+ */
+class MemoryPool {
+  public:
+    QPID_COMMON_EXTERN static void* allocate(size_t size);
+    QPID_COMMON_EXTERN static void release(void* block, size_t size);
+};
+
+/** Base for classes whose instances should be allocated from the pool */
+class PoolAllocated {
+  public:
+    static void* operator new(size_t size) { return MemoryPool::allocate(size); }
+    static void operator delete(void* block, size_t size) { MemoryPool::release(block, size); }
+};
+
+} // namespace qpid
+
+#endif  /*!QPID_MEMORYPOOL_H*/
@@ -28,6 +28,8 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 
+#include <deque>
+
 namespace fs=boost::filesystem;
 
 namespace {
@@ -46,17 +48,23 @@ bool isShlibName(const std::string& name) {
     return name.find (suffix()) == name.length() - suffix().length();
 }
 
+// Modules noted by deferModuleDir, next to load at the front
+std::deque<std::string> deferred;
+
 }
 
 namespace qpid {
 
 ModuleOptions::ModuleOptions(const std::string& defaultModuleDir)
-    : qpid::Options("Module options"), loadDir(defaultModuleDir), noLoad(false)
+    : qpid::Options("Module options"), loadDir(defaultModuleDir), noLoad(false), onDemand(false)
 {
     addOptions()
         ("module-dir",    optValue(loadDir, "DIR"),  "Load all shareable modules in this directory")
         ("load-module",   optValue(load,    "FILE"), "Specifies additional module(s) to be loaded")
-        ("no-module-dir", optValue(noLoad),          "Don't load modules from module directory");
+        ("no-module-dir", optValue(noLoad),          "Don't load modules from module directory")
+        ("module-on-demand", optValue(onDemand),
+         "Load modules from the module directory only when an exchange type or transport they provide is first used. "
+         "Options of such modules are not recognised; name a module with --load-module to set its options");
 }
 
 void tryShlib(const char* libname_, bool noThrow) {
@@ -71,9 +79,11 @@ void tryShlib(const char* libname_, bool noThrow) {
     }
 }
 
-void loadModuleDir (std::string dirname, bool isDefault)
+namespace {
+
+void listModuleDir (const std::string& dirname, bool isDefault, std::deque<std::string>& names)
 {
-    fs::path dirPath (dirname, fs::native);
+    fs::path dirPath (dirname);
 
     if (!fs::exists (dirPath))
     {
@@ -89,9 +99,34 @@ void loadModuleDir (std::string dirname, bool isDefault)
     fs::directory_iterator endItr;
     for (fs::directory_iterator itr (dirPath); itr != endItr; ++itr)
     {
-        if (!fs::is_directory(*itr) && isShlibName(itr->string()))
-            tryShlib (itr->string().data(), true);
+        if (!fs::is_directory(*itr) && isShlibName(itr->path().string()))
+            names.push_back (itr->path().string());
     }
 }
 
+}
+
+void loadModuleDir (std::string dirname, bool isDefault)
+{
+    std::deque<std::string> names;
+    listModuleDir (dirname, isDefault, names);
+    for (std::deque<std::string>::const_iterator i = names.begin(); i != names.end(); ++i)
+        tryShlib (i->data(), true);
+}
+
+void deferModuleDir (std::string dirname, bool isDefault)
+{
+    listModuleDir (dirname, isDefault, deferred);
+}
+
+bool loadDeferredModule (std::string& name)
+{
+    if (deferred.empty())
+        return false;
+    name = deferred.front();
+    deferred.pop_front();
+    tryShlib (name.data(), true);
+    return true;
+}
+
 } // namespace qpid
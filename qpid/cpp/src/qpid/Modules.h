@@ -33,12 +33,27 @@ struct ModuleOptions : public qpid::Options {
     std::string              loadDir;
     std::vector<std::string> load;
     bool                     noLoad;
+    bool                     onDemand;
     QPID_COMMON_EXTERN ModuleOptions(const std::string& defaultModuleDir);
 };
 
 QPID_COMMON_EXTERN void tryShlib(const char* libname, bool noThrow);
 QPID_COMMON_EXTERN void loadModuleDir (std::string dirname, bool isDefault);
 
+/**
+ * Note the modules in dirname without loading them. They are loaded
+ * one at a time, in directory order, by loadDeferredModule().
+ */
+QPID_COMMON_EXTERN void deferModuleDir (std::string dirname, bool isDefault);
+
+/**
+ * Load the next module noted by deferModuleDir(), setting name to its
+ * path. Modules that fail to load are skipped. Not thread safe: the
+ * caller serialises calls.
+ *@return false if no deferred modules remain.
+ */
+QPID_COMMON_EXTERN bool loadDeferredModule (std::string& name);
+
 } // namespace qpid
 
 #endif  /*!QPID_MODULES_H*/
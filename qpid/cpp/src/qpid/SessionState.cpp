@@ -119,10 +119,14 @@ void SessionState::senderRecord(const AMQFrame& f) {
     QPID_LOG(trace, getId() << ": sent cmd " << sender.sendPoint.command << ": " << *f.getBody());
 
     stateful = true;
-    if (timeout) sender.replayList.push_back(f);
-    sender.unflushedSize += f.encodedSize();
-    sender.bytesSinceKnownCompleted += f.encodedSize();
-    sender.replaySize += f.encodedSize();
+    uint32_t size = f.encodedSize();
+    if (timeout) {
+        sender.replayList.push_back(f);
+        sender.replaySizes.push_back(size);
+    }
+    sender.unflushedSize += size;
+    sender.bytesSinceKnownCompleted += size;
+    sender.replaySize += size;
     sender.incomplete += sender.sendPoint.command;
     sender.sendPoint.advance(f);
     if (config.replayHardLimit && config.replayHardLimit < sender.replaySize) 
@@ -153,18 +157,18 @@ void SessionState::senderConfirmed(const SessionPoint& confirmed) {
     if (confirmed > sender.sendPoint)
         throw InvalidArgumentException(QPID_MSG(getId() << ": confirmed < " << confirmed << " but only sent < " << sender.sendPoint));
     QPID_LOG(debug, getId() << ": sender confirmed point moved to " << confirmed);
-    ReplayList::iterator i = sender.replayList.begin();
-    while (i != sender.replayList.end() && sender.replayPoint.command < confirmed.command) {
-        sender.replayPoint.advance(*i);
+    while (!sender.replayList.empty() && sender.replayPoint.command < confirmed.command) {
+        sender.replayPoint.advance(sender.replayList.front());
         assert(sender.replayPoint <= sender.sendPoint);
-        sender.replaySize -= i->encodedSize();
+        uint32_t size = sender.replaySizes.front();
+        sender.replaySize -= size;
         if (sender.replayPoint > sender.flushPoint) 
-            sender.unflushedSize -= i->encodedSize();
-        ++i;
+            sender.unflushedSize -= size;
+        sender.replayList.pop_front();
+        sender.replaySizes.pop_front();
     }
     if (sender.replayPoint > sender.flushPoint)
         sender.flushPoint = sender.replayPoint;
-    sender.replayList.erase(sender.replayList.begin(), i);
     assert(sender.replayPoint.offset == 0);
 }
 
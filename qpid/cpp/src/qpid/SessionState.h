@@ -29,6 +29,7 @@
 #include <qpid/framing/FrameHandler.h>
 #include <boost/operators.hpp>
 #include <boost/range/iterator_range.hpp>
+#include <deque>
 #include <vector>
 #include <iosfwd>
 #include <qpid/CommonImportExport.h>
@@ -72,7 +73,8 @@ QPID_COMMON_EXTERN std::ostream& operator<<(std::ostream&, const SessionPoint&);
  * source-incompatbile API changes.
  */
 class SessionState {
-    typedef std::vector<framing::AMQFrame> ReplayList;
+    // Frames share their bodies with the copies sent to the output.
+    typedef std::deque<framing::AMQFrame> ReplayList;
 
   public:
 
@@ -205,6 +207,7 @@ class SessionState {
         SessionPoint flushPoint;    // Point of last flush
         SessionPoint sendPoint;     // Send from this point
         ReplayList replayList;      // Starts from replayPoint.
+        std::deque<uint32_t> replaySizes; // Encoded size of each frame in replayList.
         size_t unflushedSize;       // Un-flushed bytes in replay list.
         size_t replaySize;          // Total bytes in replay list.
         SequenceSet incomplete;     // Commands sent and not yet completed.
@@ -82,6 +82,12 @@ Acl::Acl (AclValues& av, Broker& b): aclValues(av), broker(&b), transferAcl(fals
    }
 
    bool Acl::authorise(const std::string& id, const Action& action, const ObjectType& objType, const std::string& ExchangeName, const std::string& RoutingKey)
+   {
+      bool memoisable;
+      return authorise(id, action, objType, ExchangeName, RoutingKey, memoisable);
+   }
+
+   bool Acl::authorise(const std::string& id, const Action& action, const ObjectType& objType, const std::string& ExchangeName, const std::string& RoutingKey, bool& memoisable)
    {
       boost::shared_ptr<AclData> dataLocal;
       {
@@ -91,6 +97,8 @@ Acl::Acl (AclValues& av, Broker& b): aclValues(av), broker(&b), transferAcl(fals
 
       // only use dataLocal here...
       AclResult aclreslt = dataLocal->lookup(id,action,objType,ExchangeName,RoutingKey);
+      // logged results raise an event each time so must be looked up each time
+      memoisable = aclreslt == ALLOW || aclreslt == DENY;
 
 	  return result(aclreslt, id, action, objType, ExchangeName);
    }
@@ -146,6 +154,8 @@ Acl::Acl (AclValues& av, Broker& b): aclValues(av), broker(&b), transferAcl(fals
         Mutex::ScopedLock locker(dataLock);
         data = d;
       }
+      // after the swap, so a caller seeing the new generation sees the new rules
+      generation.fetchAndAdd(1);
 	  transferAcl = data->transferAcl; // any transfer ACL
 
       if (data->transferAcl){
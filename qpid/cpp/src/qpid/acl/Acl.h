@@ -29,6 +29,7 @@
 #include "qpid/management/ManagementAgent.h"
 #include "qmf/org/apache/qpid/acl/Acl.h"
 #include "qpid/sys/Mutex.h"
+#include "qpid/sys/AtomicValue.h"
 
 #include <map>
 #include <string>
@@ -57,6 +58,7 @@ private:
    qmf::org::apache::qpid::acl::Acl* mgmtObject; // mgnt owns lifecycle
    qpid::management::ManagementAgent* agent;
    mutable qpid::sys::Mutex dataLock; 
+   qpid::sys::AtomicValue<uint32_t> generation;
 
 public:
    Acl (AclValues& av, broker::Broker& b);
@@ -68,6 +70,8 @@ public:
    // create specilied authorise methods for cases that need faster matching as needed.
    virtual bool authorise(const std::string& id, const Action& action, const ObjectType& objType, const std::string& name, std::map<Property, std::string>* params=0);
    virtual bool authorise(const std::string& id, const Action& action, const ObjectType& objType, const std::string& ExchangeName,const std::string& RoutingKey);
+   virtual bool authorise(const std::string& id, const Action& action, const ObjectType& objType, const std::string& ExchangeName,const std::string& RoutingKey, bool& memoisable);
+   virtual uint32_t getGeneration() { return generation.get(); }
 
    virtual ~Acl();
 private:
@@ -19,11 +19,39 @@
 #include "qpid/acl/AclData.h"
 #include "qpid/log/Statement.h"
 #include "qpid/sys/IntegerTypes.h"
+#include <boost/functional/hash.hpp>
 #include <boost/lexical_cast.hpp>
 
 namespace qpid {
 namespace acl {
 
+AclData::matcher::matcher(const std::string& value) :
+    text(value), wildcard(!value.empty() && value[value.size()-1] == '*')
+{
+    if (wildcard) text.erase(text.size()-1);
+}
+
+bool AclData::matcher::match(const std::string& value) const
+{
+    if (wildcard) return value.compare(0, text.size(), text) == 0;
+    else return value == text;
+}
+
+AclData::rule::rule(propertyMap& p) : log(false), logOnly(false), props(p),
+                                      hasName(false), hasRoutingKey(false)
+{
+    propertyMapItr i = props.find(acl::PROP_NAME);
+    if (i != props.end()) {
+        hasName = true;
+        name = matcher(i->second);
+    }
+    i = props.find(acl::PROP_ROUTINGKEY);
+    if (i != props.end()) {
+        hasRoutingKey = true;
+        routingKey = matcher(i->second);
+    }
+}
+
 AclData::AclData():decisionMode(qpid::acl::DENY),transferAcl(false),aclSource("UNKNOWN")
 {
 	for (unsigned int cnt=0; cnt< qpid::acl::ACTIONSIZE; cnt++){
@@ -79,7 +107,7 @@ AclResult AclData::lookup(const std::string& id, const Action& action, const Obj
 				for (propertyMapItr pMItr = i->props.begin(); (pMItr != i->props.end()) && match; pMItr++) {
 					//match name is exists first
 					if (pMItr->first == acl::PROP_NAME) {
-						if (matchProp(pMItr->second, name)){
+						if (i->name.match(name)){
 							QPID_LOG(debug, "ACL: name '" << name << "' matched with name '"
 								 << pMItr->second << "' given in the rule");
 					        }else{
@@ -166,64 +194,61 @@ AclResult AclData::lookup(const std::string& id, const Action& action, const Obj
 
 AclResult AclData::lookup(const std::string& id, const Action& action, const ObjectType& objType, const std::string& /*Exchange*/ name, const std::string& RoutingKey)
 {
+    std::string key;
+    key.reserve(id.size() + name.size() + RoutingKey.size() + 4);
+    key.append(id).push_back('\0');
+    key.push_back(char(action));
+    key.push_back(char(objType));
+    key.append(name).push_back('\0');
+    key.append(RoutingKey);
+    resultShard& shard = resultCache[boost::hash<std::string>()(key) % CACHE_SHARDS];
+    {
+        qpid::sys::Mutex::ScopedLock l(shard.lock);
+        boost::unordered_map<std::string, AclResult>::const_iterator i = shard.results.find(key);
+        if (i != shard.results.end()) {
+            QPID_LOG(debug, "ACL: Cached decision for id:" << id << " action:" << AclHelper::getActionStr((Action) action)
+                     << " objectType:" << AclHelper::getObjectTypeStr((ObjectType) objType) << " exchange name:" << name
+                     << " with routing key " << RoutingKey << " is " << AclHelper::getAclResultStr(i->second));
+            return i->second;
+        }
+    }
+    AclResult aclresult = lookupRules(id, action, objType, name, RoutingKey);
+    qpid::sys::Mutex::ScopedLock l(shard.lock);
+    if (shard.results.size() >= CACHE_SHARD_SIZE) shard.results.clear();
+    shard.results[key] = aclresult;
+    return aclresult;
+}
 
+AclResult AclData::lookupRules(const std::string& id, const Action& action, const ObjectType& objType, const std::string& name, const std::string& RoutingKey)
+{
 	QPID_LOG(debug, "ACL: Lookup for id:" << id << " action:" << AclHelper::getActionStr((Action) action)
 		 << " objectType:" << AclHelper::getObjectTypeStr((ObjectType) objType) << " exchange name:" << name
 		 << " with routing key " << RoutingKey);
 
-        AclResult aclresult = decisionMode;
-	
-	if (actionList[action] && actionList[action][objType]){
-	          AclData::actObjItr itrRule = actionList[action][objType]->find(id);
-		  
-                  if (itrRule == actionList[action][objType]->end())
-		       itrRule = actionList[action][objType]->find("*");
+	AclResult aclresult = decisionMode;
+	if (actionList[action] && actionList[action][objType]) {
+		AclData::actObjItr itrRule = actionList[action][objType]->find(id);
+		if (itrRule == actionList[action][objType]->end())
+			itrRule = actionList[action][objType]->find("*");
 
-		  if (itrRule != actionList[action][objType]->end() ) {
-			   
-                        QPID_LOG(debug, "ACL: checking the following rules for : " << itrRule->first );
-    
-			   //loop the vector
-    		        for (ruleSetItr i=itrRule->second.begin(); i<itrRule->second.end(); i++) {
-				QPID_LOG(debug, "ACL: checking rule " <<  i->toString());
-	                   
-					// loop the names looking for match
-					bool match =true;
-					for (propertyMapItr pMItr = i->props.begin(); (pMItr != i->props.end()) && match; pMItr++)
-					{
-                                                //match name is exists first
-						if (pMItr->first == acl::PROP_NAME){
-						     if (matchProp(pMItr->second, name)){  							     
-                                                         QPID_LOG(debug, "ACL: name '" << name << "' matched with name '"
-								  << pMItr->second << "' given in the rule");
-                                                             
-					             }else{
-                                                         match= false;
-                                                         QPID_LOG(debug, "ACL: name '" << name << "' didn't match with name '"
-							          << pMItr->second << "' given in the rule");
-                                                     }    
-						}else if (pMItr->first == acl::PROP_ROUTINGKEY){
-						     if (matchProp(pMItr->second, RoutingKey)){  
-							 QPID_LOG(debug, "ACL: name '" << name << "' matched with routing_key '"
-							          << pMItr->second << "' given in the rule");    
-					             }else{
-                                                         match= false;
-                                                         QPID_LOG(debug, "ACL: name '" << name << "' didn't match with routing_key '"
-							          << pMItr->second << "' given in the rule");
-                                                     } 
-						}
-					}
-					if (match){
-                                             aclresult = getACLResult(i->logOnly, i->log);
-					     QPID_LOG(debug,"Successful match, the decision is:" << AclHelper::getAclResultStr(aclresult));
-					     return aclresult;
-                                        }
-    		        }
-		  }
+		if (itrRule != actionList[action][objType]->end()) {
+			QPID_LOG(debug, "ACL: checking the following rules for : " << itrRule->first );
+
+			//loop the vector, only the name and routing key take part
+			for (ruleSetItr i = itrRule->second.begin(); i < itrRule->second.end(); i++) {
+				bool match = (!i->hasName || i->name.match(name)) &&
+					(!i->hasRoutingKey || i->routingKey.match(RoutingKey));
+				QPID_LOG(debug, "ACL: rule " << i->toString() << (match ? " matched" : " didn't match"));
+				if (match) {
+					aclresult = getACLResult(i->logOnly, i->log);
+					QPID_LOG(debug,"Successful match, the decision is:" << AclHelper::getAclResultStr(aclresult));
+					return aclresult;
+				}
+			}
+		}
 	}
 	QPID_LOG(debug,"No successful match, defaulting to the decision mode " << AclHelper::getAclResultStr(aclresult));
-        return aclresult;
-
+	return aclresult;
 }
 
 
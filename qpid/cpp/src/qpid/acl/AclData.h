@@ -21,6 +21,8 @@
  */
 
 #include "qpid/broker/AclModule.h"
+#include "qpid/sys/Mutex.h"
+#include <boost/unordered_map.hpp>
 #include <vector>
 #include <sstream>
 
@@ -34,6 +36,17 @@ public:
 
    typedef std::map<qpid::acl::Property, std::string> propertyMap;
    typedef propertyMap::const_iterator propertyMapItr;
+
+   /** A rule value compiled once, when the rule is loaded */
+   struct matcher {
+       std::string text;
+       bool wildcard;  // text was given with a trailing '*' which is stripped
+
+       matcher() : wildcard(false) {}
+       matcher(const std::string& value);
+       bool match(const std::string& value) const;
+   };
+
    struct rule {
 	  
 	   bool log;
@@ -42,9 +55,14 @@ public:
 	   // key value map
       //??
       propertyMap props;
+
+      // compiled name and routing key properties, if given
+      bool hasName;
+      bool hasRoutingKey;
+      matcher name;
+      matcher routingKey;
 	  
-	  
-	  rule (propertyMap& p):log(false),logOnly(false),props(p) {};
+	  rule (propertyMap& p);
 
 	  std::string toString () const {
 	  	std::ostringstream ruleStr;
@@ -77,6 +95,24 @@ public:
   
    AclData();
    virtual ~AclData();
+
+private:
+   /**
+    * Recent results of the exchange and routing key lookup, which
+    * runs for every published message when transfers are covered.
+    * The rules do not change once loaded (a reload builds a new
+    * AclData) so entries never go stale. Split in shards to spread
+    * the locking; a full shard is simply emptied.
+    */
+   struct resultShard {
+       qpid::sys::Mutex lock;
+       boost::unordered_map<std::string, AclResult> results;
+   };
+   static const size_t CACHE_SHARDS = 16;
+   static const size_t CACHE_SHARD_SIZE = 1024;
+   resultShard resultCache[CACHE_SHARDS];
+
+   AclResult lookupRules(const std::string& id, const Action& action, const ObjectType& objType, const std::string& name, const std::string& RoutingKey);
 };
     
 }} // namespace qpid::acl
@@ -20,6 +20,7 @@
 
 #include "qpid/management/Manageable.h"
 #include "qpid/management/ManagementObject.h"
+#include "qpid/management/MapEncoder.h"
 #include "qpid/log/Statement.h"
 #include "qpid/agent/ManagementAgentImpl.h"
 #include "qpid/amqp_0_10/Codecs.h"
@@ -30,6 +31,7 @@
 #include <iostream>
 #include <fstream>
 #include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
 
 using namespace qpid::client;
 using namespace qpid::framing;
@@ -1044,6 +1046,30 @@ struct MessageItem {
     MessageItem(const Variant::Map& h, const string& k) : headers(h), key(k) {}
 };
 
+namespace {
+/*
+ * Add the V2 data indication for @a object to the open list of @a list_,
+ * as the Variant::Map the query handlers build would encode.
+ */
+void mapEncodeObject(MapEncoder& list_, ManagementObject* object,
+                     bool includeProperties, bool includeStatistics)
+{
+    list_.beginMap();
+    list_.put("_object_id", object->getObjectId());
+    list_.beginMap("_schema_id");
+    list_.put("_package_name", object->getPackageName());
+    list_.put("_class_name", object->getClassName());
+    list_.put("_type", "_data");
+    list_.put("_hash", qpid::types::Uuid(object->getMd5Sum()));
+    list_.end();
+    object->writeTimestamps(list_);
+    list_.beginMap("_values");
+    object->mapEncodeValues(list_, includeProperties, includeStatistics);
+    list_.end();
+    list_.end();
+}
+}
+
 void ManagementAgentImpl::periodicProcessing()
 {
     string addr_key_base = "agent.ind.data.";
@@ -1061,50 +1087,37 @@ void ManagementAgentImpl::periodicProcessing()
         moveNewObjectsLH();
 
         //
-        //  Clear the been-here flag on all objects in the map.
+        //  Gather the objects to publish by class, in one pass over the
+        //  map: those changed or deleted since the last pass, or all of
+        //  them if all are to be published.
         //
+        typedef std::map<std::pair<string, string>, std::vector<ObjectMap::iterator> > ClassObjects;
+        ClassObjects changed;
         for (ObjectMap::iterator iter = managementObjects.begin();
              iter != managementObjects.end();
              iter++) {
             ManagementObject* object = iter->second.get();
-            object->setFlags(0);
-            if (publishAllData) {
+            if (publishAllData)
                 object->setForcePublish(true);
-            }
+            if (object->getConfigChanged() || object->getInstChanged() ||
+                object->getForcePublish() || object->isDeleted())
+                changed[std::make_pair(object->getPackageName(), object->getClassName())].push_back(iter);
         }
 
         publishAllData = false;
 
         //
-        //  Process the entire object map.
+        //  Encode each class's objects straight into the content of its
+        //  indications, at most maxV2ReplyObjs to a message.  Nothing is
+        //  sent until agentLock is released.
         //
-        uint32_t v2Objs = 0;
-
-        for (ObjectMap::iterator baseIter = managementObjects.begin();
-             baseIter != managementObjects.end();
-             baseIter++) {
-            ManagementObject* baseObject = baseIter->second.get();
-
-            //
-            //  Skip until we find a base object requiring a sent message.
-            //
-            if (baseObject->getFlags() == 1 ||
-                (!baseObject->getConfigChanged() &&
-                 !baseObject->getInstChanged() &&
-                 !baseObject->getForcePublish() &&
-                 !baseObject->isDeleted()))
-                continue;
-
-            std::string packageName = baseObject->getPackageName();
-            std::string className = baseObject->getClassName();
-
-            Variant::List list_;
+        for (ClassObjects::const_iterator i = changed.begin(); i != changed.end(); ++i) {
             std::stringstream addr_key;
             Variant::Map  headers;
 
             addr_key << addr_key_base;
-            addr_key << keyifyNameStr(packageName)
-                     << "." << keyifyNameStr(className)
+            addr_key << keyifyNameStr(i->first.first)
+                     << "." << keyifyNameStr(i->first.second)
                      << "." << vendorNameKey
                      << "." << productNameKey
                      << "." << instanceNameKey;
@@ -1114,52 +1127,44 @@ void ManagementAgentImpl::periodicProcessing()
             headers["qmf.content"] = "_data";
             headers["qmf.agent"] = name_address;
 
-            for (ObjectMap::iterator iter = baseIter;
-                 iter != managementObjects.end();
-                 iter++) {
-                ManagementObject* object = iter->second.get();
-                bool send_stats, send_props;
-                if (baseObject->isSameClass(*object) && object->getFlags() == 0) {
-                    object->setFlags(1);
-                    if (object->getConfigChanged() || object->getInstChanged())
-                        object->setUpdateTime();
-
-                    send_props = (object->getConfigChanged() || object->getForcePublish() || object->isDeleted());
-                    send_stats = (object->hasInst() && (object->getInstChanged() || object->getForcePublish()));
+            boost::shared_ptr<MessageItem> item;
+            boost::scoped_ptr<MapEncoder> list_;
+            uint32_t v2Objs = 0;
 
-                    if (send_stats || send_props) {
-                        Variant::Map map_;
-                        Variant::Map values;
-                        Variant::Map oid;
+            for (std::vector<ObjectMap::iterator>::const_iterator j = i->second.begin();
+                 j != i->second.end();
+                 ++j) {
+                ManagementObject* object = (*j)->second.get();
+                bool send_stats, send_props;
+                if (object->getConfigChanged() || object->getInstChanged())
+                    object->setUpdateTime();
 
-                        object->getObjectId().mapEncode(oid);
-                        map_["_object_id"] = oid;
-                        map_["_schema_id"] = mapEncodeSchemaId(object->getPackageName(),
-                                                               object->getClassName(),
-                                                               object->getMd5Sum());
-                        object->writeTimestamps(map_);
-                        object->mapEncodeValues(values, send_props, send_stats);
-                        map_["_values"] = values;
-                        list_.push_back(map_);
+                send_props = (object->getConfigChanged() || object->getForcePublish() || object->isDeleted());
+                send_stats = (object->hasInst() && (object->getInstChanged() || object->getForcePublish()));
 
-                        if (++v2Objs >= maxV2ReplyObjs) {
-                            v2Objs = 0;
-                            boost::shared_ptr<MessageItem> item(new MessageItem(headers, addr_key.str()));
-                            ListCodec::encode(list_, item->content);
-                            message_list.push_back(item);
-                            list_.clear();
-                        }
+                if (send_stats || send_props) {
+                    if (!item) {
+                        item.reset(new MessageItem(headers, addr_key.str()));
+                        list_.reset(new MapEncoder(item->content));
+                        list_->beginList();
                     }
+                    mapEncodeObject(*list_, object, send_props, send_stats);
 
-                    if (object->isDeleted())
-                        deleteList.push_back(iter->first);
-                    object->setForcePublish(false);
+                    if (++v2Objs >= maxV2ReplyObjs) {
+                        v2Objs = 0;
+                        list_->end();
+                        message_list.push_back(item);
+                        item.reset();
+                    }
                 }
+
+                if (object->isDeleted())
+                    deleteList.push_back((*j)->first);
+                object->setForcePublish(false);
             }
 
-            if (!list_.empty()) {
-                boost::shared_ptr<MessageItem> item(new MessageItem(headers, addr_key.str()));
-                ListCodec::encode(list_, item->content);
+            if (item) {
+                list_->end();
                 message_list.push_back(item);
             }
         }
@@ -1177,6 +1182,7 @@ void ManagementAgentImpl::periodicProcessing()
         connThreadBody.sendBuffer(item->content, "", item->headers, topicExchange, item->key, "amqp/list");
         QPID_LOG(trace, "SENT DataIndication");
     }
+    connThreadBody.flush();
 }
 
 
@@ -1225,6 +1231,7 @@ void ManagementAgentImpl::ConnectionThread::run()
                     if (shutdown)
                         return;
                     operational = true;
+                    pendingSends.clear();
                     agent.connected = true;
                     agent.startProtocol();
                     try {
@@ -1330,6 +1337,14 @@ void ManagementAgentImpl::ConnectionThread::sendMessage(Message msg,
         sys::Mutex::ScopedLock _lock(connLock);
         if (!operational)
             return;
+        while (!pendingSends.empty() && pendingSends.front().isComplete())
+            pendingSends.pop_front();
+        if (pendingSends.size() >= MAX_PENDING_SENDS) {
+            if (droppedSends++ % MAX_PENDING_SENDS == 0)
+                QPID_LOG(warning, "QMF Agent dropping messages, the broker is not keeping up (dropped "
+                         << droppedSends << " so far)");
+            return;
+        }
         s = subscriptions;
     }
 
@@ -1338,7 +1353,15 @@ void ManagementAgentImpl::ConnectionThread::sendMessage(Message msg,
     msg.getMessageProperties().getApplicationHeaders().setString("qmf.agent", agent.name_address);
     msg.getMessageProperties().setAppId("qmf2");
     try {
-        session.messageTransfer(arg::content=msg, arg::destination=exchange);
+        // Don't wait for the broker: a slow one would stall every thread
+        // that publishes, raises an event or answers a request.
+        Completion c = async(session).messageTransfer(arg::content=msg, arg::destination=exchange);
+        sys::Mutex::ScopedLock _lock(connLock);
+        pendingSends.push_back(c);
+        if (pendingSends.size() == MAX_PENDING_SENDS/2) {
+            sys::Mutex::ScopedUnlock _unlock(connLock);
+            session.flush();
+        }
     } catch(exception& e) {
         QPID_LOG(error, "Exception caught in sendMessage: " << e.what());
         // Bounce the connection
@@ -1357,6 +1380,20 @@ void ManagementAgentImpl::ConnectionThread::bindToBank(uint32_t brokerBank, uint
                          arg::bindingKey=key.str());
 }
 
+void ManagementAgentImpl::ConnectionThread::flush()
+{
+    {
+        sys::Mutex::ScopedLock _lock(connLock);
+        if (!operational || pendingSends.empty())
+            return;
+    }
+    try {
+        session.flush();
+    } catch(exception& e) {
+        QPID_LOG(debug, "Exception caught in flush: " << e.what());
+    }
+}
+
 void ManagementAgentImpl::ConnectionThread::close()
 {
     ConnectionThread::shared_ptr s;
@@ -214,11 +214,17 @@ class ManagementAgentImpl : public ManagementAgent, public client::MessageListen
         mutable sys::Mutex   connLock;
         bool              shutdown;
         bool              sleeping;
+        // Transfers sent but not yet known to be complete, oldest first.
+        // Sends are dropped rather than queued behind a slow broker once
+        // there are MAX_PENDING_SENDS.  Protected by connLock.
+        std::deque<client::Completion> pendingSends;
+        uint64_t          droppedSends;
+        static const size_t MAX_PENDING_SENDS = 1000;
         void run();
     public:
         ConnectionThread(ManagementAgentImpl& _agent) :
             operational(false), agent(_agent),
-            shutdown(false), sleeping(false) {}
+            shutdown(false), sleeping(false), droppedSends(0) {}
         ~ConnectionThread();
         void sendBuffer(qpid::framing::Buffer& buf,
                         uint32_t               length,
@@ -235,6 +241,8 @@ class ManagementAgentImpl : public ManagementAgent, public client::MessageListen
                          const std::string&     exchange,
                          const std::string&     routingKey);
         void bindToBank(uint32_t brokerBank, uint32_t agentBank);
+        /** Ask the broker to report which sends it has completed */
+        void flush();
         void close();
         bool isSleeping() const;
     };
@@ -19,13 +19,16 @@
  *
  */
 #include "qpid/amqp_0_10/Codecs.h"
+#include "qpid/amqp_0_10/MapView.h"
 #include "qpid/framing/Array.h"
 #include "qpid/framing/Buffer.h"
 #include "qpid/framing/FieldTable.h"
 #include "qpid/framing/FieldValue.h"
 #include "qpid/framing/List.h"
+#include "qpid/framing/reply_exceptions.h"
 #include "qpid/log/Statement.h"
 #include <algorithm>
+#include <cstring>
 #include <functional>
 #include <limits>
 
@@ -51,16 +54,34 @@ template <class T, class U, class F> void convert(const T& from, U& to, F f)
     std::transform(from.begin(), from.end(), std::inserter(to, to.begin()), f);
 }
 
-Variant::Map::value_type toVariantMapEntry(const FieldTable::value_type& in);
 FieldTable::value_type toFieldTableEntry(const Variant::Map::value_type& in);
 Variant toVariant(boost::shared_ptr<FieldValue> in);
 boost::shared_ptr<FieldValue> toFieldValue(const Variant& in);
 
-template <class T, class U, class F> void translate(boost::shared_ptr<FieldValue> in, U& u, F f) 
+// Converted values are swapped into place rather than copied, as
+// copying a nested map or list copies everything under it.
+void toVariants(const FieldTable& from, Variant::Map& to)
+{
+    for (FieldTable::const_iterator i = from.begin(); i != from.end(); ++i) {
+        Variant value(toVariant(i->second));
+        to.insert(to.end(), Variant::Map::value_type(i->first, Variant()))->second.swap(value);
+    }
+}
+
+template <class T> void toVariants(const T& from, Variant::List& to)
+{
+    for (typename T::const_iterator i = from.begin(); i != from.end(); ++i) {
+        Variant value(toVariant(*i));
+        to.push_back(Variant());
+        to.back().swap(value);
+    }
+}
+
+template <class T, class U> void translate(boost::shared_ptr<FieldValue> in, U& u) 
 {
     T t;
     getEncodedValue<T>(in, t);
-    convert(t, u, f);
+    toVariants(t, u);
 }
 
 template <class T, class U, class F> T* toFieldValueCollection(const U& u, F f) 
@@ -170,16 +191,16 @@ Variant toVariant(boost::shared_ptr<FieldValue> in)
 
       case 0xa8:
         out = Variant::Map();
-        translate<FieldTable>(in, out.asMap(), &toVariantMapEntry);
+        translate<FieldTable>(in, out.asMap());
         break;
 
       case 0xa9:
         out = Variant::List();
-        translate<List>(in, out.asList(), &toVariant);
+        translate<List>(in, out.asList());
         break;
       case 0xaa: //convert amqp0-10 array into variant list
         out = Variant::List();
-        translate<Array>(in, out.asList(), &toVariant);
+        translate<Array>(in, out.asList());
         break;
 
       default:
@@ -245,28 +266,139 @@ boost::shared_ptr<FieldValue> toFieldValue(const Variant& in)
     return out;
 }
 
-Variant::Map::value_type toVariantMapEntry(const FieldTable::value_type& in)
-{
-    return Variant::Map::value_type(in.first, toVariant(in.second));
-}
-
 FieldTable::value_type toFieldTableEntry(const Variant::Map::value_type& in)
 {
     return FieldTable::value_type(in.first, toFieldValue(in.second));
 }
 
-struct EncodeBuffer
+/**
+ * Writes the AMQP 0-10 encoding of a Variant map or list straight
+ * into a string in one pass, without first building the equivalent
+ * FieldTable or List. The size of each map or list is not known until
+ * its contents are written, so a placeholder is reserved and patched
+ * afterwards. The output is byte for byte what the FieldTable based
+ * encoding produces.
+ */
+class StreamEncoder
 {
-    char* data;
-    Buffer buffer;
+  public:
+    StreamEncoder(std::string& d) : data(d) { data.clear(); }
+
+    void encode(const Variant::Map& map)
+    {
+        size_t size = reserveSize();
+        putLong(map.size());
+        for (Variant::Map::const_iterator i = map.begin(); i != map.end(); ++i) {
+            if (i->first.size() > std::numeric_limits<uint8_t>::max())
+                throw Exception(QPID_MSG("Could not encode string of " << i->first.size() << " bytes as uint8_t string."));
+            putOctet(i->first.size());
+            data.append(i->first);
+            encode(i->second);
+        }
+        patchSize(size);
+    }
 
-    EncodeBuffer(size_t size) : data(new char[size]), buffer(data, size) {}
-    ~EncodeBuffer() { delete[] data; }
+    void encode(const Variant::List& list)
+    {
+        size_t size = reserveSize();
+        putLong(list.size());
+        for (Variant::List::const_iterator i = list.begin(); i != list.end(); ++i) {
+            encode(*i);
+        }
+        patchSize(size);
+    }
+
+  private:
+    std::string& data;
 
-    template <class T> void encode(T& t) { t.encode(buffer); }
+    void putOctet(uint8_t i) { data.push_back(char(i)); }
+    void putShort(uint16_t i) { putOctet(i >> 8); putOctet(i); }
+    void putLong(uint32_t i) { putShort(i >> 16); putShort(i); }
+    void putLongLong(uint64_t i) { putLong(i >> 32); putLong(i); }
+
+    size_t reserveSize()
+    {
+        size_t position = data.size();
+        putLong(0);
+        return position;
+    }
 
-    void getData(std::string& s) { 
-        s.assign(data, buffer.getSize()); 
+    void patchSize(size_t position)
+    {
+        uint32_t size = data.size() - position - 4;
+        for (size_t i = 0; i < 4; ++i)
+            data[position + i] = char(size >> (24 - 8*i));
+    }
+
+    void putString(const std::string& value, uint8_t code, bool large)
+    {
+        putOctet(code);
+        if (large) putLong(value.size());
+        else putShort(value.size());
+        data.append(value);
+    }
+
+    void encode(const std::string& value, const std::string& encoding)
+    {
+        bool large = value.size() > std::numeric_limits<uint16_t>::max();
+        if (encoding.empty() || encoding == amqp0_10_binary || encoding == binary) {
+            putString(value, large ? 0xa0 : 0x90, large);
+        } else if (encoding == utf8) {
+            if (large)
+                throw Exception(QPID_MSG("Could not encode utf8 character string - too long (" << value.size() << " bytes)"));
+            putString(value, 0x95, false);
+        } else if (encoding == utf16) {
+            if (large)
+                throw Exception(QPID_MSG("Could not encode utf16 character string - too long (" << value.size() << " bytes)"));
+            putString(value, 0x96, false);
+        } else if (encoding == iso885915) {
+            if (large)
+                throw Exception(QPID_MSG("Could not encode iso-8859-15 character string - too long (" << value.size() << " bytes)"));
+            putString(value, 0x94, false);
+        } else {
+            // the encoding was not recognised
+            QPID_LOG(warning, "Unknown byte encoding: [" << encoding << "], encoding as vbin32.");
+            putString(value, 0xa0, true);
+        }
+    }
+
+    void encode(const Variant& in)
+    {
+        switch (in.getType()) {
+          case VAR_VOID: putOctet(0xf0); break;
+          case VAR_BOOL: putOctet(0x08); putOctet(in.asBool()); break;
+          case VAR_UINT8: putOctet(0x02); putOctet(in.asUint8()); break;
+          case VAR_UINT16: putOctet(0x12); putShort(in.asUint16()); break;
+          case VAR_UINT32: putOctet(0x22); putLong(in.asUint32()); break;
+          case VAR_UINT64: putOctet(0x32); putLongLong(in.asUint64()); break;
+          case VAR_INT8: putOctet(0x01); putOctet(in.asInt8()); break;
+          case VAR_INT16: putOctet(0x11); putShort(in.asInt16()); break;
+          case VAR_INT32: putOctet(0x21); putLong(in.asInt32()); break;
+          case VAR_INT64: putOctet(0x31); putLongLong(in.asInt64()); break;
+          case VAR_FLOAT: {
+              float f = in.asFloat();
+              uint32_t bits;
+              ::memcpy(&bits, &f, sizeof(bits));
+              putOctet(0x23);
+              putLong(bits);
+              break;
+          }
+          case VAR_DOUBLE: {
+              double d = in.asDouble();
+              uint64_t bits;
+              ::memcpy(&bits, &d, sizeof(bits));
+              putOctet(0x33);
+              putLongLong(bits);
+              break;
+          }
+          case VAR_STRING: encode(in.asString(), in.getEncoding()); break;
+          case VAR_UUID:
+            putOctet(0x48);
+            data.append(reinterpret_cast<const char*>(in.asUuid().data()), qpid::types::Uuid::SIZE);
+            break;
+          case VAR_MAP: putOctet(0xa8); encode(in.asMap()); break;
+          case VAR_LIST: putOctet(0xa9); encode(in.asList()); break;
+        }
     }
 };
 
@@ -280,33 +412,40 @@ struct DecodeBuffer
     
 };
 
-template <class T, class U, class F> void _encode(const U& value, std::string& data, F f)
-{
-    T t;
-    convert(value, t, f);
-    EncodeBuffer buffer(t.encodedSize());
-    buffer.encode(t);
-    buffer.getData(data);
-}
-
-template <class T, class U, class F> void _decode(const std::string& data, U& value, F f)
+template <class T, class U> void _decode(const std::string& data, U& value)
 {
     T t;
     DecodeBuffer buffer(data);
     buffer.decode(t);
-    convert(t, value, f);
+    toVariants(t, value);
 }
 
 void MapCodec::encode(const Variant::Map& value, std::string& data)
 {
-    _encode<FieldTable>(value, data, &toFieldTableEntry);
+    StreamEncoder(data).encode(value);
 }
 
 void MapCodec::decode(const std::string& data, Variant::Map& value)
 {
-    _decode<FieldTable>(data, value, &toVariantMapEntry);
+    _decode<FieldTable>(data, value);
 }
 
+// Values the visitor does not want are stepped over in place, only
+// those it wants are decoded.
+void MapCodec::decode(const std::string& data, Visitor& visitor)
+{
+    MapView map(data);
+    std::string key;
+    for (MapView::Cursor i(map); i.next();) {
+        key.assign(i.keyData(), i.keySize());
+        if (visitor.wants(key) && !visitor.handle(key, i.value().toVariant())) return;
+    }
+}
+
+MapCodec::Visitor::~Visitor() {}
+
+bool MapCodec::Visitor::wants(const std::string&) { return true; }
+
 size_t MapCodec::encodedSize(const Variant::Map& value)
 {
     std::string encoded;
@@ -316,12 +455,12 @@ size_t MapCodec::encodedSize(const Variant::Map& value)
 
 void ListCodec::encode(const Variant::List& value, std::string& data)
 {
-    _encode<List>(value, data, &toFieldValue);
+    StreamEncoder(data).encode(value);
 }
 
 void ListCodec::decode(const std::string& data, Variant::List& value)
 {
-    _decode<List>(data, value, &toVariant);
+    _decode<List>(data, value);
 }
 
 size_t ListCodec::encodedSize(const Variant::List& value)
@@ -338,7 +477,7 @@ void translate(const Variant::Map& from, FieldTable& to)
 
 void translate(const FieldTable& from, Variant::Map& to)
 {
-    convert(from, to, &toVariantMapEntry);
+    toVariants(from, to);
 }
 
 const std::string ListCodec::contentType("amqp/list");
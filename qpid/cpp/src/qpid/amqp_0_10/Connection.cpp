@@ -23,18 +23,60 @@
 #include "qpid/amqp_0_10/exceptions.h"
 #include "qpid/framing/AMQFrame.h"
 #include "qpid/framing/Buffer.h"
+#include "qpid/framing/ConnectionHeartbeatBody.h"
 #include "qpid/framing/ProtocolInitiation.h"
+#include "qpid/framing/SessionCompletedBody.h"
+#include "qpid/framing/SessionFlushBody.h"
+#include "qpid/framing/SessionKnownCompletedBody.h"
+#include "qpid/sys/AtomicValue.h"
 
 namespace qpid {
 namespace amqp_0_10 {
 
 using sys::Mutex;
 
+namespace {
+sys::AtomicValue<uint64_t> totalBuffered;
+
+/**
+ * Controls that only report or ask for state and do not take a command
+ * id, so sending them ahead of queued message transfers changes nothing
+ * but their latency.
+ */
+bool canOvertake(const framing::AMQFrame& f)
+{
+    const framing::AMQMethodBody* m = f.getMethod();
+    return m && (m->isA<framing::SessionCompletedBody>() ||
+                 m->isA<framing::SessionKnownCompletedBody>() ||
+                 m->isA<framing::SessionFlushBody>() ||
+                 m->isA<framing::ConnectionHeartbeatBody>());
+}
+
+/**
+ * Any other method, e.g. session.attached or message.flow. Controls
+ * queued after one of these must not overtake it.
+ */
+bool isBarrier(const framing::AMQFrame& f)
+{
+    const framing::AMQMethodBody* m = f.getMethod();
+    return m && !m->isContentBearing() && !canOvertake(f);
+}
+
+bool startsFrameset(const framing::AMQFrame& f)
+{
+    return f.getBof() && f.getBos();
+}
+}
+
 Connection::Connection(sys::OutputControl& o, const std::string& id, bool _isClient)
-    : pushClosed(false), popClosed(false), output(o), identifier(id), initialized(false),
-      isClient(_isClient), buffered(0), version(0,10)
+    : barriers(0), pushClosed(false), popClosed(false), output(o), identifier(id),
+      initialized(false), isClient(_isClient), buffered(0), version(0,10)
 {}
 
+Connection::~Connection() {
+    totalBuffered -= buffered;
+}
+
 void Connection::setInputHandler(std::auto_ptr<sys::ConnectionInputHandler> c) {
     connection = c;
 }
@@ -48,13 +90,13 @@ size_t  Connection::decode(const char* buffer, size_t size) {
             if(!(pi==version))
                 throw Exception(QPID_MSG("Unsupported version: " << pi
                                          << " supported version " << version));
-            QPID_LOG(trace, "RECV " << identifier << " INIT(" << pi << ")");
+            QPID_LOG_FOR(trace, identifier, "RECV " << identifier << " INIT(" << pi << ")");
         }
         initialized = true;
     }
     framing::AMQFrame frame;
     while(frame.decode(in)) {
-        QPID_LOG(trace, "RECV [" << identifier << "]: " << frame);
+        QPID_LOG_FOR(trace, identifier, "RECV [" << identifier << "]: " << frame);
          connection->received(frame);
     }
     return in.getPosition();
@@ -66,7 +108,7 @@ bool Connection::canEncode() {
         Mutex::ScopedUnlock u(frameQueueLock);
         connection->doOutput();
     }
-    return !popClosed && ((!isClient && !initialized) || !frameQueue.empty());
+    return !popClosed && ((!isClient && !initialized) || !frameQueue.empty() || !controlQueue.empty());
 }
 
 bool Connection::isClosed() const {
@@ -75,38 +117,66 @@ bool Connection::isClosed() const {
 }
 
 size_t  Connection::encode(const char* buffer, size_t size) {
+    size_t workBarriers;
     {   // Swap frameQueue data into workQueue to avoid holding lock while we encode.
         Mutex::ScopedLock l(frameQueueLock);
         if (popClosed) return 0; // Can't pop any more frames.
-        assert(workQueue.empty());
+        assert(workQueue.empty() && workControls.empty());
         workQueue.swap(frameQueue);
+        workControls.swap(controlQueue);
+        workBarriers = barriers;
+        barriers = 0;
     }
     framing::Buffer out(const_cast<char*>(buffer), size);
     if (!isClient && !initialized) {
         framing::ProtocolInitiation pi(getVersion());
         pi.encode(out);
         initialized = true;
-        QPID_LOG(trace, "SENT " << identifier << " INIT(" << pi << ")");
+        QPID_LOG_FOR(trace, identifier, "SENT " << identifier << " INIT(" << pi << ")");
     }
     size_t frameSize=0;
     size_t encoded=0;
-    while (!workQueue.empty() && ((frameSize=workQueue.front().encodedSize()) <= out.available())) {
-        workQueue.front().encode(out);
-        QPID_LOG(trace, "SENT [" << identifier << "]: " << workQueue.front());
-        workQueue.pop_front();
+    for (;;) {
+        // Controls go out as soon as no barrier is ahead of them, but
+        // never inside another frameset
+        FrameQueue& queue = !workControls.empty() && !workBarriers &&
+            (workQueue.empty() || startsFrameset(workQueue.front())) ? workControls : workQueue;
+        if (queue.empty() || (frameSize=queue.front().encodedSize()) > out.available()) break;
+        if (&queue == &workQueue && isBarrier(queue.front())) --workBarriers;
+        queue.front().encode(out);
+        QPID_LOG_FOR(trace, identifier, "SENT [" << identifier << "]: " << queue.front());
+        queue.pop_front();
         encoded += frameSize;
-        if (workQueue.empty() && out.available() > 0) connection->doOutput();
+        if (workQueue.empty() && workControls.empty() && out.available() > 0) {
+            // Let output limits see that these frames have been taken
+            {
+                Mutex::ScopedLock l(frameQueueLock);
+                buffered -= encoded;
+            }
+            totalBuffered -= encoded;
+            encoded = 0;
+            connection->doOutput();
+        }
     }
     assert(workQueue.empty() || workQueue.front().encodedSize() <= size);
-    if (!workQueue.empty() && workQueue.front().encodedSize() > size)
+    if ((!workQueue.empty() && workQueue.front().encodedSize() > size) ||
+        (!workControls.empty() && workControls.front().encodedSize() > size))
         throw InternalErrorException(QPID_MSG("Frame too large for buffer."));
     {
         Mutex::ScopedLock l(frameQueueLock);
         buffered -= encoded;
-        // Put back any frames we did not encode.
+        totalBuffered -= encoded;
+        // Put back any frames we did not encode. Controls must still go
+        // ahead of any barrier sent meanwhile.
+        if (barriers)
+            frameQueue.insert(frameQueue.begin(), workControls.begin(), workControls.end());
+        else
+            controlQueue.insert(controlQueue.begin(), workControls.begin(), workControls.end());
+        workControls.clear();
         frameQueue.insert(frameQueue.begin(), workQueue.begin(), workQueue.end());
         workQueue.clear();
-        if (frameQueue.empty() && pushClosed)
+        barriers += workBarriers;
+        if (frameQueue.empty() && controlQueue.empty() && pushClosed)
             popClosed = true;
     }
     return out.getPosition();
@@ -130,9 +200,21 @@ void  Connection::closed() {
 void Connection::send(framing::AMQFrame& f) {
     {
         Mutex::ScopedLock l(frameQueueLock);
-	if (!pushClosed)
-            frameQueue.push_back(f);
+	if (!pushClosed) {
+            if (canOvertake(f)) {
+                controlQueue.push_back(f);
+            } else {
+                if (isBarrier(f)) {
+                    // Controls already queued keep their place before it
+                    frameQueue.insert(frameQueue.end(), controlQueue.begin(), controlQueue.end());
+                    controlQueue.clear();
+                    ++barriers;
+                }
+                frameQueue.push_back(f);
+            }
+        }
         buffered += f.encodedSize();
+        totalBuffered += f.encodedSize();
     }
     activateOutput();
 }
@@ -150,4 +232,8 @@ size_t Connection::getBuffered() const {
     return buffered;
 }
 
+uint64_t Connection::getTotalBuffered() {
+    return totalBuffered.get();
+}
+
 }} // namespace qpid::amqp_0_10
@@ -47,6 +47,10 @@ class Connection  : public sys::ConnectionCodec,
 
     FrameQueue frameQueue;
     FrameQueue workQueue;
+    // Completions and heartbeats, which may overtake queued message transfers
+    FrameQueue controlQueue;
+    FrameQueue workControls;
+    size_t barriers;            // Frames in frameQueue that controls must not overtake
     bool pushClosed, popClosed;
     mutable sys::Mutex frameQueueLock;
     sys::OutputControl& output;
@@ -59,6 +63,7 @@ class Connection  : public sys::ConnectionCodec,
 
   public:
     QPID_BROKER_EXTERN Connection(sys::OutputControl&, const std::string& id, bool isClient);
+    QPID_BROKER_EXTERN ~Connection();
     QPID_BROKER_EXTERN void setInputHandler(std::auto_ptr<sys::ConnectionInputHandler> c);
     size_t decode(const char* buffer, size_t size);
     size_t encode(const char* buffer, size_t size);
@@ -72,6 +77,8 @@ class Connection  : public sys::ConnectionCodec,
     void send(framing::AMQFrame&);
     framing::ProtocolVersion getVersion() const;
     size_t getBuffered() const;
+    /** Bytes waiting to be written, summed over all connections */
+    QPID_BROKER_EXTERN static uint64_t getTotalBuffered();
 
     /** Used by cluster code to set a special version on "update" connections. */
     // FIXME aconway 2009-07-30: find a cleaner mechanism for this.
@@ -0,0 +1,159 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "qpid/amqp_0_10/MapView.h"
+#include "qpid/framing/Buffer.h"
+#include "qpid/framing/FieldValue.h"
+#include "qpid/framing/reply_exceptions.h"
+#include "qpid/Msg.h"
+#include <cstring>
+
+using qpid::framing::IllegalArgumentException;
+
+namespace qpid {
+namespace amqp_0_10 {
+
+// In Codecs.cpp
+qpid::types::Variant toVariant(boost::shared_ptr<framing::FieldValue> in);
+
+namespace {
+uint32_t getUInt(const char* p, uint32_t width)
+{
+    uint32_t value = 0;
+    while (width--) value = (value << 8) | uint8_t(*p++);
+    return value;
+}
+
+void notEnough()
+{
+    throw IllegalArgumentException(QPID_MSG("Not enough data for map."));
+}
+
+/** Width of the size prefix and total encoded size of the value of the given type at p */
+void valueSize(uint8_t type, const char* p, const char* end, uint32_t& prefix, uint32_t& size)
+{
+    prefix = 0;
+    size = 0;
+    if (type == 0xa8 || type == 0xa9 || type == 0xaa) {
+        prefix = 4;             // Map, list or array
+    } else {
+        uint8_t lenType = type >> 4;
+        if (lenType <= 7) size = 1 << lenType;
+        else if (lenType <= 0xa) prefix = 1 << (lenType - 8);
+        else if (lenType == 0xc) size = 5;
+        else if (lenType == 0xd) size = 9;
+        else if (lenType == 0xf) size = 0;
+        else throw IllegalArgumentException(QPID_MSG("Unknown map value type: " << (int)type));
+    }
+    if (prefix) {
+        if (uint32_t(end - p) < prefix) notEnough();
+        size = prefix + getUInt(p, prefix);
+    }
+    if (uint32_t(end - p) < size) notEnough();
+}
+}
+
+bool ValueView::isString() const
+{
+    uint8_t lenType = code >> 4;
+    return lenType >= 0x8 && lenType <= 0xa && !(code == 0xa8 || code == 0xa9 || code == 0xaa);
+}
+
+std::string ValueView::asString() const
+{
+    if (!isString())
+        throw IllegalArgumentException(QPID_MSG("Map value of type " << (int)code << " is not a string"));
+    return std::string(data(), size());
+}
+
+MapView ValueView::asMap() const
+{
+    if (!isMap())
+        throw IllegalArgumentException(QPID_MSG("Map value of type " << (int)code << " is not a map"));
+    return MapView(bytes, length);
+}
+
+qpid::types::Variant ValueView::toVariant() const
+{
+    if (!bytes) return qpid::types::Variant();
+    // The type code is the byte before the value
+    framing::Buffer buffer(const_cast<char*>(bytes - 1), length + 1);
+    boost::shared_ptr<framing::FieldValue> value(new framing::FieldValue);
+    value->decode(buffer);
+    return amqp_0_10::toVariant(value);
+}
+
+MapView::MapView(const char* b, uint32_t size) : bytes(b), length(size), entries(0)
+{
+    init();
+}
+
+MapView::MapView(const std::string& encoded) : bytes(encoded.data()), length(encoded.size()), entries(0)
+{
+    init();
+}
+
+void MapView::init()
+{
+    if (length < 8) notEnough();
+    uint32_t size = getUInt(bytes, 4);
+    if (size > length - 4) notEnough();
+    length = size + 4;
+    entries = getUInt(bytes + 4, 4);
+}
+
+bool MapView::find(const std::string& key, ValueView& value) const
+{
+    bool found = false;
+    for (Cursor i(*this); i.next();) {
+        if (i.keyIs(key)) {
+            value = i.value();
+            found = true;
+        }
+    }
+    return found;
+}
+
+MapView::Cursor::Cursor(const MapView& map)
+    : position(map.bytes + 8), end(map.bytes + map.length), remaining(map.entries), key(0), keyLength(0)
+{}
+
+bool MapView::Cursor::next()
+{
+    if (position >= end || !remaining) return false;
+    --remaining;
+    keyLength = uint8_t(*position++);
+    if (uint32_t(end - position) < uint32_t(keyLength) + 1) notEnough();
+    key = position;
+    position += keyLength;
+    uint8_t code = uint8_t(*position++);
+    uint32_t prefix, size;
+    valueSize(code, position, end, prefix, size);
+    current = ValueView(code, position, prefix, size);
+    position += size;
+    return true;
+}
+
+bool MapView::Cursor::keyIs(const std::string& k) const
+{
+    return k.size() == keyLength && ::memcmp(k.data(), key, keyLength) == 0;
+}
+
+}} // namespace qpid::amqp_0_10
@@ -0,0 +1,122 @@
+#ifndef QPID_AMQP_0_10_MAPVIEW_H
+#define QPID_AMQP_0_10_MAPVIEW_H
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/CommonImportExport.h"
+#include "qpid/sys/IntegerTypes.h"
+#include "qpid/types/Variant.h"
+#include <string>
+
+namespace qpid {
+namespace amqp_0_10 {
+
+class MapView;
+
+/**
+ * A value in an AMQP 0-10 encoded map, referring to the encoded bytes
+ * rather than holding a decoded copy. The bytes must outlive the view.
+ */
+class ValueView
+{
+  public:
+    ValueView() : code(0xf0), bytes(0), prefix(0), length(0) {}
+    ValueView(uint8_t c, const char* b, uint32_t p, uint32_t l) : code(c), bytes(b), prefix(p), length(l) {}
+
+    /** The AMQP 0-10 type code */
+    uint8_t getCode() const { return code; }
+    /** The bytes of the value, without any size prefix */
+    const char* data() const { return bytes + prefix; }
+    uint32_t size() const { return length - prefix; }
+
+    /** True for binary, character strings and encoded structs */
+    QPID_COMMON_EXTERN bool isString() const;
+    bool isMap() const { return code == 0xa8; }
+
+    /** Copy of a string value, throws if not isString() */
+    QPID_COMMON_EXTERN std::string asString() const;
+    /** View of a nested map, throws if not isMap() */
+    QPID_COMMON_EXTERN MapView asMap() const;
+    /** Decoded copy of the value, as MapCodec::decode would produce */
+    QPID_COMMON_EXTERN qpid::types::Variant toVariant() const;
+
+  private:
+    uint8_t code;
+    const char* bytes;          // Start of the encoded value, after the type code
+    uint32_t prefix;            // Width of the size prefix, if any
+    uint32_t length;            // Encoded size including the prefix
+};
+
+/**
+ * An AMQP 0-10 encoded map that is read in place. Finding or stepping
+ * through entries allocates nothing; copies are made only by the
+ * ValueView accessors that return them. The encoded bytes must outlive
+ * the view and any values taken from it.
+ */
+class MapView
+{
+  public:
+    /** @param bytes the encoded map, starting with its 4 byte size */
+    QPID_COMMON_EXTERN MapView(const char* bytes, uint32_t size);
+    QPID_COMMON_EXTERN MapView(const std::string& encoded);
+
+    /** Number of entries the encoding claims to hold */
+    uint32_t count() const { return entries; }
+
+    /**
+     * Find the value for key, the last one if it occurs more than once.
+     *@return false if there is no such key.
+     */
+    QPID_COMMON_EXTERN bool find(const std::string& key, ValueView& value) const;
+
+    /** Steps through the entries in encoded order */
+    class Cursor
+    {
+      public:
+        QPID_COMMON_EXTERN Cursor(const MapView& map);
+        /** Move to the next entry, @return false if there are no more */
+        QPID_COMMON_EXTERN bool next();
+        const char* keyData() const { return key; }
+        uint8_t keySize() const { return keyLength; }
+        QPID_COMMON_EXTERN bool keyIs(const std::string& k) const;
+        const ValueView& value() const { return current; }
+
+      private:
+        const char* position;
+        const char* end;
+        uint32_t remaining;
+        const char* key;
+        uint8_t keyLength;
+        ValueView current;
+    };
+
+  private:
+    const char* bytes;
+    uint32_t length;
+    uint32_t entries;
+
+    void init();
+};
+
+}} // namespace qpid::amqp_0_10
+
+#endif  /*!QPID_AMQP_0_10_MAPVIEW_H*/
@@ -90,7 +90,7 @@ void SessionHandler::handleIn(AMQFrame& f) {
                 return; // Ignore duplicates.
             if (getState()->receiverNeedKnownCompleted())
                 sendCompletion();
-            getInHandler()->handle(f);
+            handleInData(f);
         }
     }
     catch(const SessionException& e) {
@@ -102,6 +102,11 @@ class QPID_COMMON_CLASS_EXTERN SessionHandler : public framing::AMQP_AllOperatio
     QPID_COMMON_EXTERN virtual void handleIn(framing::AMQFrame&);
     QPID_COMMON_EXTERN virtual void handleOut(framing::AMQFrame&);
 
+    /** Pass on a frame that handleIn() accepted for the attached session.
+     * Subclasses that know their session type can call it directly.
+     */
+    virtual void handleInData(framing::AMQFrame& f) { getInHandler()->handle(f); }
+
     framing::ChannelHandler channel;
 
   private:
@@ -22,6 +22,7 @@
 
 
 #include "qpid/RefCounted.h"
+#include "qpid/sys/IntegerTypes.h"
 #include <boost/shared_ptr.hpp>
 #include <map>
 #include <set>
@@ -61,6 +62,12 @@ public:
        std::map<acl::Property, std::string>* params=0)=0;
    virtual bool authorise(const std::string& id, const acl::Action& action, const acl::ObjectType& objType, const std::string& ExchangeName, 
        const std::string& RoutingKey)=0;
+   // as above, also setting memoisable if the caller may reuse the result
+   // until getGeneration() changes (it may not if the rule asks for logging)
+   virtual bool authorise(const std::string& id, const acl::Action& action, const acl::ObjectType& objType, const std::string& ExchangeName, 
+       const std::string& RoutingKey, bool& memoisable)=0;
+   // incremented each time the rules are reloaded
+   virtual uint32_t getGeneration()=0;
    // create specilied authorise methods for cases that need faster matching as needed.
 
    virtual ~AclModule() {};
@@ -23,6 +23,7 @@
  */
 
 #include <boost/intrusive_ptr.hpp>
+#include <string>
 
 #include "qpid/broker/BrokerImportExport.h"
 #include "qpid/sys/AtomicValue.h"
@@ -99,6 +100,7 @@ class AsyncCompletion
     mutable qpid::sys::AtomicValue<uint32_t> completionsNeeded;
     mutable qpid::sys::Monitor callbackLock;
     bool inCallback, active;
+    std::string error;
 
     void invokeCallback(bool sync) {
         qpid::sys::Mutex::ScopedLock l(callbackLock);
@@ -152,6 +154,23 @@ class AsyncCompletion
         }
     }
 
+    /** Called by a completer that failed, before its finishCompleter().
+     * Only the first error is kept.
+     */
+    void setError(const std::string& e)
+    {
+        qpid::sys::Mutex::ScopedLock l(callbackLock);
+        if (error.empty()) error = e;
+    }
+
+    /** The error given by a failed completer, empty if none failed.
+     */
+    std::string getError() const
+    {
+        qpid::sys::Mutex::ScopedLock l(callbackLock);
+        return error;
+    }
+
     /** called by initiator before any calls to startCompleter can be done.
      */
     void begin()
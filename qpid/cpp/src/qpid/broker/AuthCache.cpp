@@ -0,0 +1,77 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/broker/AuthCache.h"
+#include "qpid/sys/Sha256.h"
+#include "qpid/types/Uuid.h"
+
+namespace qpid {
+namespace broker {
+
+namespace {
+std::string randomSalt()
+{
+    types::Uuid salt(true);
+    return std::string(reinterpret_cast<const char*>(salt.data()), salt.size());
+}
+}
+
+AuthCache::AuthCache() : salt(randomSalt()) {}
+
+std::string AuthCache::digest(const std::string& attempt) const
+{
+    return sys::sha256(salt + attempt);
+}
+
+bool AuthCache::find(const std::string& attempt, std::string& uid)
+{
+    std::string key(digest(attempt));
+    sys::Mutex::ScopedLock l(lock);
+    Entries::iterator i = entries.find(key);
+    if (i == entries.end()) return false;
+    if (i->second.expires < sys::AbsTime::now()) {
+        entries.erase(i);
+        return false;
+    }
+    uid = i->second.uid;
+    return true;
+}
+
+void AuthCache::insert(const std::string& attempt, const std::string& uid,
+                       size_t limit, sys::Duration ttl)
+{
+    if (!limit) return;
+    std::string key(digest(attempt));
+    sys::AbsTime now = sys::AbsTime::now();
+    sys::Mutex::ScopedLock l(lock);
+    if (entries.size() >= limit && !entries.count(key)) {
+        for (Entries::iterator i = entries.begin(); i != entries.end();) {
+            if (i->second.expires < now) entries.erase(i++);
+            else ++i;
+        }
+        if (entries.size() >= limit) entries.erase(entries.begin());
+    }
+    Entry& e = entries[key];
+    e.uid = uid;
+    e.expires = sys::AbsTime(now, ttl);
+}
+
+}} // namespace qpid::broker
@@ -0,0 +1,72 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_BROKER_AUTHCACHE_H
+#define QPID_BROKER_AUTHCACHE_H
+
+#include "qpid/broker/BrokerImportExport.h"
+#include "qpid/sys/Mutex.h"
+#include "qpid/sys/Time.h"
+#include <map>
+#include <string>
+
+namespace qpid {
+namespace broker {
+
+/**
+ * Users recently authenticated by a mechanism that completed in one step
+ * from the client's initial response, e.g. PLAIN. An attempt holds that
+ * response along with everything else the outcome depended on, so only
+ * an identical attempt matches.
+ *
+ * Attempts are kept only as a SHA-256 digest salted with a random value
+ * chosen when the cache is created, never as the credentials themselves.
+ */
+class AuthCache
+{
+  public:
+    QPID_BROKER_EXTERN AuthCache();
+
+    /** Set uid to the user authenticated by attempt, if that is remembered */
+    QPID_BROKER_EXTERN bool find(const std::string& attempt, std::string& uid);
+    /**
+     * Remember that attempt authenticated uid for ttl. When limit entries
+     * are held the expired ones are dropped first.
+     */
+    QPID_BROKER_EXTERN void insert(const std::string& attempt, const std::string& uid,
+                                   size_t limit, sys::Duration ttl);
+
+  private:
+    struct Entry {
+        std::string uid;
+        sys::AbsTime expires;
+    };
+    typedef std::map<std::string, Entry> Entries;
+
+    const std::string salt;
+    sys::Mutex lock;
+    Entries entries;
+
+    std::string digest(const std::string& attempt) const;
+};
+
+}} // namespace qpid::broker
+
+#endif  /*!QPID_BROKER_AUTHCACHE_H*/
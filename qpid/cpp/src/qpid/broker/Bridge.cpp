@@ -19,6 +19,7 @@
  *
  */
 #include "qpid/broker/Bridge.h"
+#include "qpid/broker/Broker.h"
 #include "qpid/broker/FedOps.h"
 #include "qpid/broker/ConnectionState.h"
 #include "qpid/broker/Connection.h"
@@ -29,6 +30,7 @@
 #include "qpid/management/ManagementAgent.h"
 #include "qpid/framing/Uuid.h"
 #include "qpid/log/Statement.h"
+#include <algorithm>
 #include <iostream>
 
 using qpid::framing::FieldTable;
@@ -74,8 +76,14 @@ void Bridge::create(Connection& c)
 {
     connState = &c;
     conn = &c;
+    const Broker::Options& opts = link->getBroker()->getOptions();
     FieldTable options;
-    if (args.i_sync) options.setInt("qpid.sync_frequency", args.i_sync);
+    if (args.i_sync)
+        options.setInt("qpid.sync_frequency", args.i_sync);
+    else if (opts.federationCredit || opts.federationByteCredit)
+        // A window is only replenished as transfers are completed, so
+        // have the source ask for completion regularly.
+        options.setInt("qpid.sync_frequency", opts.federationCredit ? std::max(opts.federationCredit/2, 1u) : 100);
     SessionHandler& sessionHandler = c.getChannel(id);
     if (args.i_srcIsLocal) {
         if (args.i_dynamic)
@@ -98,8 +106,7 @@ void Bridge::create(Connection& c)
     if (args.i_srcIsLocal) sessionHandler.getSession()->disableReceiverTracking();
     if (args.i_srcIsQueue) {        
         peer->getMessage().subscribe(args.i_src, args.i_dest, args.i_sync ? 0 : 1, 0, false, "", 0, options);
-        peer->getMessage().flow(args.i_dest, 0, 0xFFFFFFFF);
-        peer->getMessage().flow(args.i_dest, 1, 0xFFFFFFFF);
+        setFlow();
         QPID_LOG(debug, "Activated route from queue " << args.i_src << " to " << args.i_dest);
     } else {
         FieldTable queueSettings;
@@ -125,9 +132,8 @@ void Bridge::create(Connection& c)
         peer->getQueue().declare(queueName, "", false, durable, true, autoDelete, queueSettings);
         if (!args.i_dynamic)
             peer->getExchange().bind(queueName, args.i_src, args.i_key, FieldTable());
-        peer->getMessage().subscribe(queueName, args.i_dest, 1, 0, false, "", 0, FieldTable());
-        peer->getMessage().flow(args.i_dest, 0, 0xFFFFFFFF);
-        peer->getMessage().flow(args.i_dest, 1, 0xFFFFFFFF);
+        peer->getMessage().subscribe(queueName, args.i_dest, 1, 0, false, "", 0, options);
+        setFlow();
 
         if (args.i_dynamic) {
             Exchange::shared_ptr exchange = link->getBroker()->getExchanges().get(args.i_src);
@@ -142,6 +148,24 @@ void Bridge::create(Connection& c)
     if (args.i_srcIsLocal) sessionHandler.getSession()->enableReceiverTracking();
 }
 
+void Bridge::setFlow()
+{
+    const Broker::Options& opts = link->getBroker()->getOptions();
+    if (opts.federationCredit || opts.federationByteCredit)
+        peer->getMessage().setFlowMode(args.i_dest, 1 /*window*/);
+    peer->getMessage().flow(args.i_dest, 0, opts.federationCredit ? opts.federationCredit : 0xFFFFFFFF);
+    peer->getMessage().flow(args.i_dest, 1, opts.federationByteCredit ? opts.federationByteCredit : 0xFFFFFFFF);
+}
+
+void Bridge::forwarded(uint64_t bytes)
+{
+    if (mgmtObject) {
+        mgmtObject->inc_msgsForwarded();
+        mgmtObject->inc_bytesForwarded(bytes);
+    }
+    link->forwarded(bytes);
+}
+
 void Bridge::cancel(Connection&)
 {
     if (resetProxy()) {
@@ -274,16 +298,39 @@ void Bridge::propagateBinding(const string& key, const string& tagList,
              }
          }
          string newTagList(tagList + string(tagList.empty() ? "" : ",") + localTag);
+         const string& newOrigin(origin.empty() ? localTag : origin);
 
          bindArgs.setString(qpidFedOp, op);
          bindArgs.setString(qpidFedTags, newTagList);
-         if (origin.empty())
-             bindArgs.setString(qpidFedOrigin, localTag);
-         else
-             bindArgs.setString(qpidFedOrigin, origin);
+         bindArgs.setString(qpidFedOrigin, newOrigin);
+
+         // The peer keeps a set of origins per key, so only the last of a
+         // run of binds and unbinds for a key and origin needs sending.
+         bool first;
+         {
+             sys::Mutex::ScopedLock l(pendingLock);
+             first = pendingBindings.empty();
+             pendingBindings[key + '\0' + newOrigin] = PendingBinding(key, bindArgs);
+         }
+         if (first)
+             conn->requestIOProcessing(boost::bind(&Bridge::ioThreadPropagateBindings, this));
+    }
+}
 
-         conn->requestIOProcessing(boost::bind(&Bridge::ioThreadPropagateBinding, this,
-                                               queueName, args.i_src, key, bindArgs));
+void Bridge::ioThreadPropagateBindings()
+{
+    PendingBindings bindings;
+    {
+        sys::Mutex::ScopedLock l(pendingLock);
+        bindings.swap(pendingBindings);
+    }
+    if (bindings.empty()) return;
+    if (resetProxy()) {
+        for (PendingBindings::iterator i = bindings.begin(); i != bindings.end(); ++i)
+            peer->getExchange().bind(queueName, args.i_src, i->second.key, i->second.args);
+    } else {
+        QPID_LOG(error, "Cannot propagate binding for dynamic bridge as session has been detached, deleting dynamic bridge");
+        destroy();
     }
 }
 
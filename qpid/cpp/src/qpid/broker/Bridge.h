@@ -32,7 +32,10 @@
 #include "qmf/org/apache/qpid/broker/ArgsLinkBridge.h"
 #include "qmf/org/apache/qpid/broker/Bridge.h"
 
+#include "qpid/sys/Mutex.h"
+
 #include <boost/function.hpp>
+#include <map>
 #include <memory>
 
 namespace qpid {
@@ -60,6 +63,10 @@ public:
     bool isDurable() { return args.i_durable; }
 
     bool isSessionReady() const;
+    framing::ChannelId getChannelId() const { return id; }
+
+    /** Count a message carried by the bridge's session. */
+    void forwarded(uint64_t bytes);
 
     management::ManagementObject* GetManagementObject() const;
     management::Manageable::status_t ManagementMethod(uint32_t methodId,
@@ -93,6 +100,17 @@ private:
     std::auto_ptr<framing::AMQP_ServerProxy::Session> session;
     std::auto_ptr<framing::AMQP_ServerProxy>          peer;
 
+    /** A binding operation waiting for the IO thread to send it. */
+    struct PendingBinding {
+        std::string key;
+        framing::FieldTable args;
+        PendingBinding() {}
+        PendingBinding(const std::string& k, const framing::FieldTable& a) : key(k), args(a) {}
+    };
+    // By key and origin: a later bind or unbind of the same key for the
+    // same origin replaces an earlier one not yet sent.
+    typedef std::map<std::string, PendingBinding> PendingBindings;
+
     Link* link;
     framing::ChannelId          id;
     qmf::org::apache::qpid::broker::ArgsLinkBridge args;
@@ -103,8 +121,12 @@ private:
     mutable uint64_t  persistenceId;
     ConnectionState* connState;
     Connection* conn;
+    sys::Mutex pendingLock;
+    PendingBindings pendingBindings;
 
     bool resetProxy();
+    void ioThreadPropagateBindings();
+    void setFlow();
 };
 
 
@@ -27,6 +27,7 @@
 #include "qpid/broker/MessageStoreModule.h"
 #include "qpid/broker/NullMessageStore.h"
 #include "qpid/broker/RecoveryManagerImpl.h"
+#include "qpid/broker/ReplyToExchange.h"
 #include "qpid/broker/SaslAuthenticator.h"
 #include "qpid/broker/SecureConnectionFactory.h"
 #include "qpid/broker/TopicExchange.h"
@@ -45,6 +46,7 @@
 #include "qmf/org/apache/qpid/broker/ArgsBrokerSetLogLevel.h"
 #include "qmf/org/apache/qpid/broker/ArgsBrokerSetTimestampConfig.h"
 #include "qmf/org/apache/qpid/broker/ArgsBrokerGetTimestampConfig.h"
+#include "qmf/org/apache/qpid/broker/ArgsBrokerGetAllocationCounts.h"
 #include "qmf/org/apache/qpid/broker/EventExchangeDeclare.h"
 #include "qmf/org/apache/qpid/broker/EventExchangeDelete.h"
 #include "qmf/org/apache/qpid/broker/EventQueueDeclare.h"
@@ -65,6 +67,7 @@
 #include "qpid/framing/Uuid.h"
 #include "qpid/sys/ProtocolFactory.h"
 #include "qpid/sys/Poller.h"
+#include "qpid/sys/HugePages.h"
 #include "qpid/sys/Dispatcher.h"
 #include "qpid/sys/Thread.h"
 #include "qpid/sys/Time.h"
@@ -73,6 +76,7 @@
 #include "qpid/sys/TimeoutHandler.h"
 #include "qpid/sys/SystemInfo.h"
 #include "qpid/Address.h"
+#include "qpid/Modules.h"
 #include "qpid/StringUtils.h"
 #include "qpid/Url.h"
 #include "qpid/Version.h"
@@ -80,6 +84,7 @@
 #include <boost/bind.hpp>
 #include <boost/format.hpp>
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 
@@ -108,27 +113,62 @@ Broker::Options::Options(const std::string& name) :
     noDataDir(0),
     port(DEFAULT_PORT),
     workerThreads(5),
+    partitionWorkers(false),
+    workerAffinity(false),
+    workerNuma(false),
+    hugePages("no"),
+    workerEdgeTriggered(false),
+    timerWheel(false),
+    dispatchBatch(1),
+    outputQuantum(0),
+    connectionOutputLimit(0),
     maxConnections(500),
     connectionBacklog(10),
     enableMgmt(1),
     mgmtPubInterval(10),
+    mgmtPubSlices(10),
+    mgmtMinLifetime(0),
+    mgmtEventRate(0),
+    mgmtStatsSample(1),
     queueCleanInterval(60*10),//10 minutes
+    queueForecastInterval(0),
     auth(SaslAuthenticator::available()),
     realm("QPID"),
+    authCacheSize(1000),
+    authCacheTtl(0),
+    federationCredit(0),
+    federationByteCredit(0),
+    federationLinkStreams(1),
     replayFlushLimit(0),
     replayHardLimit(0),
     queueLimit(100*1048576/*100M default limit*/),
     tcpNoDelay(false),
+    tcpListeners(1),
+    unixSocket(false),
+    busyPollPort(0),
+    busyPollThreads(0),
+    busyPollUsecs(50),
     requireEncrypted(false),
     maxSessionRate(0),
+    maxConnectionRate(0),
+    maxUserRate(0),
     asyncQueueEvents(false),     // Must be false in a cluster.
+    queueEventPartitions(1),
     qmf2Support(true),
     qmf1Support(true),
     queueFlowStopRatio(80),
     queueFlowResumeRatio(70),
     queueThresholdEventRatio(80),
     defaultMsgGroup("qpid.no-group"),
-    timestampRcvMsgs(false)     // set the 0.10 timestamp delivery property
+    timestampRcvMsgs(false),    // set the 0.10 timestamp delivery property
+    recoveryContentLimit(0),
+    contentPrefetch(16),
+    memoryFlowStopSize(0),
+    memoryFlowResumeSize(0),
+    memorySpillSize(0),
+    memorySpillWindow(64),
+    memorySpillReceiveSize(0),
+    lightweightTempQueues(false)
 {
     int c = sys::SystemInfo::concurrency();
     workerThreads=c+1;
@@ -145,28 +185,100 @@ Broker::Options::Options(const std::string& name) :
         ("no-data-dir", optValue(noDataDir), "Don't use a data directory.  No persistent configuration will be loaded or stored")
         ("port,p", optValue(port,"PORT"), "Tells the broker to listen on PORT")
         ("worker-threads", optValue(workerThreads, "N"), "Sets the broker thread pool size")
+        ("worker-partitioned", optValue(partitionWorkers, "yes|no"),
+         "Give each worker thread its own set of connections to poll, idle workers take over events from busy ones")
+        ("worker-affinity", optValue(workerAffinity, "yes|no"), "Bind each worker thread to a CPU")
+        ("worker-numa", optValue(workerNuma, "yes|no"),
+         "Give each NUMA node its own share of the worker threads and connections, binding the workers to the node's CPUs and IO buffers to the node")
+        ("huge-pages", optValue(hugePages, "no|2M|1G"),
+         "Allocate IO buffers and pooled message memory from explicit huge pages of this size, falling back to the heap when none are left")
+        ("worker-edge-triggered", optValue(workerEdgeTriggered, "yes|no"),
+         "Keep connections armed in the poller between events and take events from it in batches")
+        ("timer-wheel", optValue(timerWheel, "yes|no"), "Schedule broker timer tasks on a timing wheel rather than a heap")
+        ("dispatch-batch", optValue(dispatchBatch, "N"), "Maximum number of messages a consumer takes from a queue each time it is given the chance to")
+        ("output-quantum", optValue(outputQuantum, "BYTES"),
+         "Share each connection's output between its consumers by turns of this many bytes rather than a message batch each (0 disables)")
+        ("connection-output-limit", optValue(connectionOutputLimit, "BYTES"),
+         "Leave messages on their queues while a connection has more than this many bytes waiting to be written (0 means no limit)")
+        ("paging-dir", optValue(pagingDir, "DIR"), "Directory for the page files of paged queues and spilled message content (defaults to the data directory, or /tmp if there is none)")
         ("max-connections", optValue(maxConnections, "N"), "Sets the maximum allowed connections")
         ("connection-backlog", optValue(connectionBacklog, "N"), "Sets the connection backlog limit for the server socket")
         ("mgmt-enable,m", optValue(enableMgmt,"yes|no"), "Enable Management")
         ("mgmt-qmf2", optValue(qmf2Support,"yes|no"), "Enable broadcast of management information over QMF v2")
         ("mgmt-qmf1", optValue(qmf1Support,"yes|no"), "Enable broadcast of management information over QMF v1")
         ("mgmt-pub-interval", optValue(mgmtPubInterval, "SECONDS"), "Management Publish Interval")
+        ("mgmt-pub-slices", optValue(mgmtPubSlices, "N"),
+         "Spread the object updates of each management publish interval over N evenly spaced parts")
+        ("mgmt-min-lifetime", optValue(mgmtMinLifetime, "MSECS"),
+         "Publish connection and session management objects only once they have existed this long or are queried; "
+         "those closed sooner are not reported (0 publishes all)")
+        ("mgmt-event-rate", optValue(mgmtEventRate, "N"),
+         "Publish at most N management events per second, holding back the rest (0 means no limit)")
+        ("mgmt-stats-sample", optValue(mgmtStatsSample, "N"),
+         "Count the binding, subscription and connection statistics of one message or frame in N and report "
+         "scaled estimates (1 counts exactly)")
         ("queue-purge-interval", optValue(queueCleanInterval, "SECONDS"),
          "Interval between attempts to purge any expired messages from queues")
+        ("queue-forecast-interval", optValue(queueForecastInterval, "SECONDS"),
+         "Publish the smoothed rates, time to drain and time to limit of busy queues to the qpid.forecast "
+         "exchange at this interval (0 means never)")
         ("auth", optValue(auth, "yes|no"), "Enable authentication, if disabled all incoming connections will be trusted")
         ("realm", optValue(realm, "REALM"), "Use the given realm when performing authentication")
+        ("auth-cache-ttl", optValue(authCacheTtl, "SECONDS"),
+         "Remember successful single step authentications (e.g. PLAIN) for up to 60 SECONDS, so a client reconnecting "
+         "with the same credentials is accepted without another SASL exchange (0 disables)")
+        ("auth-cache-size", optValue(authCacheSize, "N"), "Remember at most N authentications")
+        ("federation-credit", optValue(federationCredit, "N"),
+         "Give federation bridges a window of N messages the source may send ahead of their completion (0 means no limit)")
+        ("federation-byte-credit", optValue(federationByteCredit, "BYTES"),
+         "Give federation bridges a window of this many bytes the source may send ahead of their completion (0 means no limit)")
+        ("federation-link-streams", optValue(federationLinkStreams, "N"),
+         "Open N connections for each inter-broker link and spread its bridges across them")
         ("default-queue-limit", optValue(queueLimit, "BYTES"), "Default maximum size for queues (in bytes)")
         ("tcp-nodelay", optValue(tcpNoDelay), "Set TCP_NODELAY on TCP connections")
+        ("tcp-listeners", optValue(tcpListeners, "N"),
+         "Number of sockets listening on each TCP address, sharing the port so that several worker threads accept connections at once")
+        ("unix-socket", optValue(unixSocket, "yes|no"),
+         "Also listen on a Unix domain socket named for the port, for clients on this host that connect with "
+         "protocol 'unix'. They may authenticate with EXTERNAL as the user their process runs as")
+        ("busy-poll-port", optValue(busyPollPort, "PORT"),
+         "Also listen on PORT, serving connections accepted there on dedicated busy polling threads")
+        ("busy-poll-threads", optValue(busyPollThreads, "N"),
+         "Number of threads, each bound to a CPU, that serve the busy-poll-port (0 disables it)")
+        ("busy-poll-usecs", optValue(busyPollUsecs, "USECS"),
+         "How long busy polling threads and their sockets spin waiting for data before blocking")
         ("require-encryption", optValue(requireEncrypted), "Only accept connections that are encrypted")
         ("known-hosts-url", optValue(knownHosts, "URL or 'none'"), "URL to send as 'known-hosts' to clients ('none' implies empty list)")
         ("sasl-config", optValue(saslConfigPath, "DIR"), "gets sasl config info from nonstandard location")
         ("max-session-rate", optValue(maxSessionRate, "MESSAGES/S"), "Sets the maximum message rate per session (0=unlimited)")
+        ("max-connection-rate", optValue(maxConnectionRate, "MESSAGES/S"),
+         "Sets the maximum message rate shared by all sessions of a connection (0=unlimited)")
+        ("max-user-rate", optValue(maxUserRate, "MESSAGES/S"),
+         "Sets the maximum message rate shared by all sessions of an authenticated user (0=unlimited)")
         ("async-queue-events", optValue(asyncQueueEvents, "yes|no"), "Set Queue Events async, used for services like replication")
+        ("queue-event-partitions", optValue(queueEventPartitions, "N"),
+         "Split async queue events by queue into N streams that listeners may process in parallel")
         ("default-flow-stop-threshold", optValue(queueFlowStopRatio, "PERCENT"), "Percent of queue's maximum capacity at which flow control is activated.")
         ("default-flow-resume-threshold", optValue(queueFlowResumeRatio, "PERCENT"), "Percent of queue's maximum capacity at which flow control is de-activated.")
         ("default-event-threshold-ratio", optValue(queueThresholdEventRatio, "%age of limit"), "The ratio of any specified queue limit at which an event will be raised")
         ("default-message-group", optValue(defaultMsgGroup, "GROUP-IDENTIFER"), "Group identifier to assign to messages delivered to a message group queue that do not contain an identifier.")
-        ("enable-timestamp", optValue(timestampRcvMsgs, "yes|no"), "Add current time to each received message.");
+        ("enable-timestamp", optValue(timestampRcvMsgs, "yes|no"), "Add current time to each received message.")
+        ("recovery-content-limit", optValue(recoveryContentLimit, "BYTES"),
+         "Recover only the headers of stored messages with more content than this; their content is loaded from the store when they are first delivered (0 recovers all content)")
+        ("content-prefetch", optValue(contentPrefetch, "N"),
+         "Read the content of messages released to the store back into memory on IO threads up to N messages ahead of each queue's consumers (0 disables)")
+        ("memory-flow-stop-size", optValue(memoryFlowStopSize, "BYTES"),
+         "Withhold credit from all producers while queued messages, IO buffers and unwritten output together exceed this many bytes (0 disables)")
+        ("memory-flow-resume-size", optValue(memoryFlowResumeSize, "BYTES"),
+         "Return credit to producers once broker memory use falls below this many bytes (0 means the stop size)")
+        ("memory-spill-size", optValue(memorySpillSize, "BYTES"),
+         "Move the content of messages deep in their queues to files in the paging directory while queued message content exceeds this many bytes (0 disables)")
+        ("memory-spill-window", optValue(memorySpillWindow, "N"),
+         "Number of messages at the head of each queue whose content is never spilled")
+        ("memory-spill-receive-size", optValue(memorySpillReceiveSize, "BYTES"),
+         "Write the content of non-persistent messages declaring more than this many bytes of content to files in the paging directory as it is received (0 disables)")
+        ("lightweight-temp-queues", optValue(lightweightTempQueues, "yes|no"),
+         "Create exclusive auto-delete queues without a management object or the default size limit");
 }
 
 const std::string empty;
@@ -175,10 +287,19 @@ const std::string amq_topic("amq.topic");
 const std::string amq_fanout("amq.fanout");
 const std::string amq_match("amq.match");
 const std::string qpid_management("qpid.management");
+const std::string qpid_forecast("qpid.forecast");
 const std::string knownHostsNone("none");
+const uint32_t MAX_AUTH_CACHE_TTL(60);
 
 Broker::Broker(const Broker::Options& conf) :
-    poller(new Poller),
+    poller(conf.partitionWorkers || conf.workerAffinity || conf.workerEdgeTriggered || conf.workerNuma ?
+           new Poller(conf.partitionWorkers ? conf.workerThreads : 1, conf.workerAffinity,
+                      conf.workerEdgeTriggered, 0, conf.workerNuma) :
+           new Poller),
+    busyPoller(conf.busyPollThreads > 0 ?
+               new Poller(conf.busyPollThreads, true, false, conf.busyPollUsecs * sys::TIME_USEC) :
+               0),
+    timer(conf.timerWheel ? sys::Timer::WHEEL : sys::Timer::HEAP),
     config(conf),
     managementAgent(conf.enableMgmt ? new ManagementAgent(conf.qmf1Support,
                                                           conf.qmf2Support)
@@ -197,20 +318,43 @@ Broker::Broker(const Broker::Options& conf) :
             conf.replayHardLimit*1024),
         *this),
     queueCleaner(queues, &timer),
-    queueEvents(poller,!conf.asyncQueueEvents),
+    queueForecast(queues),
+    queueEvents(poller,!conf.asyncQueueEvents, conf.queueEventPartitions),
+    memoryAccountant(new MemoryAccountant(this, conf.memoryFlowStopSize, conf.memoryFlowResumeSize)),
+    contentSpill(new ContentSpill(this, getPagingDir(), conf.memorySpillSize, conf.memorySpillWindow)),
+    contentPrefetch(new ContentPrefetch(conf.contentPrefetch)),
+    rateLimits(conf.maxConnectionRate, conf.maxUserRate),
     recovery(true),
     inCluster(false),
     clusterUpdatee(false),
     expiryPolicy(new ExpiryPolicy),
     connectionCounter(conf.maxConnections),
+    allocationWindowStart(sys::AbsTime::now()),
     getKnownBrokers(boost::bind(&Broker::getKnownBrokersImpl, this)),
     deferDelivery(boost::bind(&Broker::deferDeliveryImpl, this, _1, _2))
 {
+    sys::AllocationCounts::snapshot(allocationWindow);
+    if (conf.authCacheTtl > MAX_AUTH_CACHE_TTL)
+        throw Exception(QPID_MSG("--auth-cache-ttl is at most " << MAX_AUTH_CACHE_TTL << " seconds"));
+    if (conf.hugePages != "no") {
+        size_t pageSize = sys::HugePages::parseSize(conf.hugePages);
+        if (!pageSize)
+            throw Exception(QPID_MSG("Invalid huge page size: " << conf.hugePages << " (use no, 2M or 1G)"));
+        if (sys::HugePages::configure(pageSize)) {
+            QPID_LOG(notice, "Allocating IO buffers and pooled message memory from " << conf.hugePages << " huge pages");
+        } else {
+            QPID_LOG(warning, "Huge pages are not supported on this platform, using the heap");
+        }
+    }
     try {
     if (conf.enableMgmt) {
         QPID_LOG(info, "Management enabled");
         managementAgent->configure(dataDir.isEnabled() ? dataDir.getPath() : string(),
-                                   conf.mgmtPubInterval, this, conf.workerThreads + 3);
+                                   conf.mgmtPubInterval, this, conf.workerThreads + 3,
+                                   conf.mgmtPubSlices);
+        managementAgent->setMinLifetime(conf.mgmtMinLifetime * sys::TIME_MSEC);
+        managementAgent->setEventRate(conf.mgmtEventRate);
+        managementAgent->setStatsSampling(conf.mgmtStatsSample);
         managementAgent->setName("apache.org", "qpidd");
         _qmf::Package packageInitializer(managementAgent.get());
 
@@ -269,7 +413,8 @@ Broker::Broker(const Broker::Options& conf) :
         // The cluster plug-in will setRecovery(false) on all but the first
         // broker to join a cluster.
         if (getRecovery()) {
-            RecoveryManagerImpl recoverer(queues, exchanges, links, dtxManager);
+            RecoveryManagerImpl recoverer(queues, exchanges, links, dtxManager,
+                                          conf.recoveryContentLimit);
             store->recover(recoverer);
         }
         else {
@@ -283,6 +428,9 @@ Broker::Broker(const Broker::Options& conf) :
     declareStandardExchange(amq_topic, TopicExchange::typeName);
     declareStandardExchange(amq_fanout, FanOutExchange::typeName);
     declareStandardExchange(amq_match, HeadersExchange::typeName);
+    // Never durable and not declarable, so registered directly
+    exchanges.registerExchange(Exchange::shared_ptr(
+        new ReplyToExchange(ReplyToExchange::address, vhostObject.get(), this)));
 
     if(conf.enableMgmt) {
         exchanges.declare(qpid_management, ManagementTopicExchange::typeName);
@@ -328,6 +476,21 @@ Broker::Broker(const Broker::Options& conf) :
     if (conf.queueCleanInterval) {
         queueCleaner.start(conf.queueCleanInterval * qpid::sys::TIME_SEC);
     }
+    if (conf.queueForecastInterval && inCluster) {
+        // Published from each broker's own timer, so not cluster safe
+        QPID_LOG(warning, "Queue forecasts are not published by clustered brokers");
+    } else if (conf.queueForecastInterval) {
+        Exchange::shared_ptr forecasts = exchanges.declare(qpid_forecast, TopicExchange::typeName).first;
+        queueForecast.start(timer, conf.queueForecastInterval * qpid::sys::TIME_SEC, forecasts);
+    }
+    memoryAccountant->start(timer, qpid::sys::TIME_SEC);
+    if (conf.memorySpillSize)
+        contentSpill->start(timer, 100 * qpid::sys::TIME_MSEC, poller);
+    if (contentPrefetch->isEnabled())
+        contentPrefetch->start(poller);
+    if (conf.maxSessionRate || conf.maxConnectionRate || conf.maxUserRate)
+        rateLimits.start(timer, 50 * qpid::sys::TIME_MSEC);
+    heartbeats.start(timer);
 
     //initialize known broker urls (TODO: add support for urls for other transports (SSL, RDMA)):
     if (conf.knownHosts.empty()) {
@@ -378,6 +541,11 @@ void Broker::setStore () {
     links.setStore      (store.get());
 }
 
+std::string Broker::getPagingDir() {
+    if (!config.pagingDir.empty()) return config.pagingDir;
+    return dataDir.isEnabled() ? dataDir.getPath() : std::string("/tmp");
+}
+
 void Broker::run() {
     if (config.workerThreads > 0) {
         QPID_LOG(notice, "Broker running");
@@ -385,6 +553,12 @@ void Broker::run() {
         int numIOThreads = config.workerThreads;
         std::vector<Thread> t(numIOThreads-1);
 
+        // Busy polling threads serve only their own poller
+        std::auto_ptr<Dispatcher> busy(busyPoller ? new Dispatcher(busyPoller) : 0);
+        std::vector<Thread> b(busyPoller ? config.busyPollThreads : 0);
+        for (size_t i=0; i<b.size(); ++i)
+            b[i] = Thread(*busy);
+
         // Run n-1 io threads
         for (int i=0; i<numIOThreads-1; ++i)
             t[i] = Thread(d);
@@ -396,6 +570,9 @@ void Broker::run() {
         for (int i=0; i<numIOThreads-1; ++i) {
             t[i].join();
         }
+        for (size_t i=0; i<b.size(); ++i) {
+            b[i].join();
+        }
     } else {
         throw Exception((boost::format("Invalid value for worker-threads: %1%") % config.workerThreads).str());
     }
@@ -406,10 +583,17 @@ void Broker::shutdown() {
     // call any function that is not async-signal safe.
     // Any unsafe shutdown actions should be done in the destructor.
     poller->shutdown();
+    if (busyPoller) busyPoller->shutdown();
 }
 
 Broker::~Broker() {
     shutdown();
+    memoryAccountant->stop();
+    contentSpill->stop();
+    contentPrefetch->stop();
+    rateLimits.stop();
+    queueForecast.stop();
+    heartbeats.stop();
     queueEvents.shutdown();
     finalize();                 // Finalize any plugins.
     if (config.auth)
@@ -451,7 +635,8 @@ Manageable::status_t Broker::ManagementMethod (uint32_t methodId,
         string transport = hp.i_transport.empty() ? TCP_TRANSPORT : hp.i_transport;
         QPID_LOG (debug, "Broker::connect() " << hp.i_host << ":" << hp.i_port << "; transport=" << transport <<
                         "; durable=" << (hp.i_durable?"T":"F") << "; authMech=\"" << hp.i_authMechanism << "\"");
-        if (!getProtocolFactory(transport)) {
+        if (!getProtocolFactory(transport) &&
+            !loadModuleFor(boost::bind(&Broker::hasProtocolFactory, this, transport))) {
             QPID_LOG(error, "Transport '" << transport << "' not supported");
             return  Manageable::STATUS_NOT_IMPLEMENTED;
         }
@@ -515,6 +700,12 @@ Manageable::status_t Broker::ManagementMethod (uint32_t methodId,
           status = setTimestampConfig(a.i_receive, getManagementExecutionContext());
           break;
         }
+    case _qmf::Broker::METHOD_GETALLOCATIONCOUNTS:
+        {
+          _qmf::ArgsBrokerGetAllocationCounts& a = dynamic_cast<_qmf::ArgsBrokerGetAllocationCounts&>(args);
+          status = getAllocationCounts(a.i_reset, a.o_counts, getManagementExecutionContext());
+          break;
+        }
    default:
         QPID_LOG (debug, "Broker ManagementMethod not implemented: id=" << methodId << "]");
         status = Manageable::STATUS_NOT_IMPLEMENTED;
@@ -758,6 +949,38 @@ Manageable::status_t Broker::setTimestampConfig(const bool receive,
     return Manageable::STATUS_OK;
 }
 
+Manageable::status_t Broker::getAllocationCounts(bool reset, qpid::types::Variant::Map& counts,
+                                                 const ConnectionState* context)
+{
+    std::string name;   // none needed for broker
+    std::string userId = context->getUserId();
+    if (acl && !acl->authorise(userId, acl::ACT_ACCESS, acl::OBJ_BROKER, name, NULL)) {
+        throw framing::UnauthorizedAccessException(QPID_MSG("ACL denied broker allocation counts request from " << userId));
+    }
+    if (!sys::AllocationCounts::enabled()) return Manageable::STATUS_NOT_IMPLEMENTED;
+
+    sys::AllocationCounts::Snapshot current;
+    sys::AllocationCounts::snapshot(current);
+    sys::AbsTime now = sys::AbsTime::now();
+    sys::Mutex::ScopedLock l(allocationWindowLock);
+    uint64_t messages = current.messages - allocationWindow.messages;
+    counts["seconds"] = double(sys::Duration(allocationWindowStart, now))/sys::TIME_SEC;
+    counts["messages"] = messages;
+    for (int i = 0; i < sys::allocation::SITES; ++i) {
+        uint64_t allocations = current.allocations[i] - allocationWindow.allocations[i];
+        qpid::types::Variant::Map site;
+        site["allocations"] = allocations;
+        site["bytes"] = current.bytes[i] - allocationWindow.bytes[i];
+        if (messages) site["perMessage"] = double(allocations)/messages;
+        counts[sys::AllocationCounts::name(sys::allocation::Site(i))] = site;
+    }
+    if (reset) {
+        allocationWindow = current;
+        allocationWindowStart = now;
+    }
+    return Manageable::STATUS_OK;
+}
+
 void Broker::setLogLevel(const std::string& level)
 {
     QPID_LOG(notice, "Changing log level to " << level);
@@ -778,6 +1001,7 @@ std::string Broker::getLogLevel()
 }
 
 boost::shared_ptr<ProtocolFactory> Broker::getProtocolFactory(const std::string& name) const {
+    sys::RWlock::ScopedRlock l(protocolFactoriesLock);
     ProtocolFactoryMap::const_iterator i
         = name.empty() ? protocolFactories.begin() : protocolFactories.find(name);
     if (i == protocolFactories.end()) return boost::shared_ptr<ProtocolFactory>();
@@ -793,12 +1017,36 @@ uint16_t Broker::getPort(const std::string& name) const  {
     }
 }
 
+bool Broker::hasProtocolFactory(const std::string& name) const {
+    return getProtocolFactory(name).get() != 0;
+}
+
+bool Broker::loadModuleFor(const boost::function<bool()>& available) {
+    sys::Mutex::ScopedLock l(moduleLock);
+    std::string module;
+    while (!available()) {
+        Plugin::Plugins before(Plugin::getPlugins());
+        if (!loadDeferredModule(module))
+            return false;
+        Plugin::Plugins added;
+        for (Plugin::Plugins::const_iterator i = Plugin::getPlugins().begin(); i != Plugin::getPlugins().end(); ++i)
+            if (std::find(before.begin(), before.end(), *i) == before.end())
+                added.push_back(*i);
+        std::for_each(added.begin(), added.end(), boost::bind(&Plugin::earlyInitialize, _1, boost::ref(*this)));
+        std::for_each(added.begin(), added.end(), boost::bind(&Plugin::initialize, _1, boost::ref(*this)));
+        QPID_LOG(info, "Loaded module on demand: " << module);
+    }
+    return true;
+}
+
 void Broker::registerProtocolFactory(const std::string& name, ProtocolFactory::shared_ptr protocolFactory) {
+    sys::RWlock::ScopedWlock l(protocolFactoriesLock);
     protocolFactories[name] = protocolFactory;
     Url::addProtocol(name);
 }
 
 void Broker::accept() {
+    sys::RWlock::ScopedRlock l(protocolFactoriesLock);
     for (ProtocolFactoryMap::const_iterator i = protocolFactories.begin(); i != protocolFactories.end(); i++) {
         i->second->accept(poller, factory.get());
     }
@@ -810,6 +1058,8 @@ void Broker::connect(
     sys::ConnectionCodec::Factory* f)
 {
     boost::shared_ptr<ProtocolFactory> pf = getProtocolFactory(transport);
+    if (!pf && loadModuleFor(boost::bind(&Broker::hasProtocolFactory, this, transport)))
+        pf = getProtocolFactory(transport);
     if (pf) pf->connect(poller, host, port, f ? f : factory.get(), failed);
     else throw NoSuchTransportException(QPID_MSG("Unsupported transport type: " << transport));
 }
@@ -33,7 +33,13 @@
 #include "qpid/broker/LinkRegistry.h"
 #include "qpid/broker/SessionManager.h"
 #include "qpid/broker/QueueCleaner.h"
+#include "qpid/broker/QueueForecast.h"
 #include "qpid/broker/QueueEvents.h"
+#include "qpid/broker/ContentPrefetch.h"
+#include "qpid/broker/ContentSpill.h"
+#include "qpid/broker/MemoryAccountant.h"
+#include "qpid/broker/RateLimits.h"
+#include "qpid/broker/HeartbeatSweep.h"
 #include "qpid/broker/Vhost.h"
 #include "qpid/broker/System.h"
 #include "qpid/broker/ExpiryPolicy.h"
@@ -47,6 +53,7 @@
 #include "qpid/framing/FrameHandler.h"
 #include "qpid/framing/OutputHandler.h"
 #include "qpid/framing/ProtocolInitiation.h"
+#include "qpid/sys/AllocationCounts.h"
 #include "qpid/sys/Runnable.h"
 #include "qpid/sys/Timer.h"
 #include "qpid/types/Variant.h"
@@ -100,22 +107,50 @@ public:
         std::string dataDir;
         uint16_t port;
         int workerThreads;
+        bool partitionWorkers;
+        bool workerAffinity;
+        bool workerNuma;
+        std::string hugePages;
+        bool workerEdgeTriggered;
+        bool timerWheel;
+        uint16_t dispatchBatch;
+        uint32_t outputQuantum;
+        uint32_t connectionOutputLimit;
+        std::string pagingDir;
         int maxConnections;
         int connectionBacklog;
         bool enableMgmt;
         uint16_t mgmtPubInterval;
+        uint16_t mgmtPubSlices;
+        uint32_t mgmtMinLifetime;
+        uint32_t mgmtEventRate;
+        uint32_t mgmtStatsSample;
         uint16_t queueCleanInterval;
+        uint16_t queueForecastInterval;
         bool auth;
         std::string realm;
+        uint32_t authCacheSize;
+        uint32_t authCacheTtl;
+        uint32_t federationCredit;
+        uint32_t federationByteCredit;
+        uint32_t federationLinkStreams;
         size_t replayFlushLimit;
         size_t replayHardLimit;
         uint queueLimit;
         bool tcpNoDelay;
+        uint32_t tcpListeners;
+        bool unixSocket;
+        uint16_t busyPollPort;
+        int busyPollThreads;
+        uint32_t busyPollUsecs;
         bool requireEncrypted;
         std::string knownHosts;
         std::string saslConfigPath;
         uint32_t maxSessionRate;
+        uint32_t maxConnectionRate;
+        uint32_t maxUserRate;
         bool asyncQueueEvents;
+        uint32_t queueEventPartitions;
         bool qmf2Support;
         bool qmf1Support;
         uint queueFlowStopRatio;    // producer flow control: on
@@ -123,6 +158,14 @@ public:
         uint16_t queueThresholdEventRatio;
         std::string defaultMsgGroup;
         bool timestampRcvMsgs;
+        uint64_t recoveryContentLimit;
+        uint32_t contentPrefetch;
+        uint64_t memoryFlowStopSize;
+        uint64_t memoryFlowResumeSize;
+        uint64_t memorySpillSize;
+        uint32_t memorySpillWindow;
+        uint64_t memorySpillReceiveSize;
+        bool lightweightTempQueues;
 
       private:
         std::string getHome();
@@ -169,12 +212,16 @@ public:
                                             const ConnectionState* context);
     Manageable::status_t setTimestampConfig(const bool receive,
                                             const ConnectionState* context);
+    Manageable::status_t getAllocationCounts(bool reset, qpid::types::Variant::Map& counts,
+                                             const ConnectionState* context);
     boost::shared_ptr<sys::Poller> poller;
+    boost::shared_ptr<sys::Poller> busyPoller;
     sys::Timer timer;
     std::auto_ptr<sys::Timer> clusterTimer;
     Options config;
     std::auto_ptr<management::ManagementAgent> managementAgent;
     ProtocolFactoryMap protocolFactories;
+    mutable sys::RWlock protocolFactoriesLock;
     std::auto_ptr<MessageStore> store;
     AclModule* acl;
     DataDir dataDir;
@@ -189,7 +236,13 @@ public:
     Vhost::shared_ptr            vhostObject;
     System::shared_ptr           systemObject;
     QueueCleaner queueCleaner;
+    QueueForecast queueForecast;
     QueueEvents queueEvents;
+    boost::shared_ptr<MemoryAccountant> memoryAccountant;
+    boost::shared_ptr<ContentSpill> contentSpill;
+    boost::shared_ptr<ContentPrefetch> contentPrefetch;
+    RateLimits rateLimits;
+    HeartbeatSweep heartbeats;
     std::vector<Url> knownBrokers;
     std::vector<Url> getKnownBrokersImpl();
     bool deferDeliveryImpl(const std::string& queue,
@@ -199,6 +252,12 @@ public:
     bool inCluster, clusterUpdatee;
     boost::intrusive_ptr<ExpiryPolicy> expiryPolicy;
     ConnectionCounter connectionCounter;
+    sys::Mutex allocationWindowLock;
+    sys::AllocationCounts::Snapshot allocationWindow; // Counts when the window began
+    sys::AbsTime allocationWindowStart;
+    sys::Mutex moduleLock;
+
+    bool hasProtocolFactory(const std::string& name) const;
 
   public:
     virtual ~Broker();
@@ -233,8 +292,15 @@ public:
     LinkRegistry& getLinks() { return links; }
     DtxManager& getDtxManager() { return dtxManager; }
     DataDir& getDataDir() { return dataDir; }
+    /** @return the directory in which paged queues keep their page files */
+    QPID_BROKER_EXTERN std::string getPagingDir();
     Options& getOptions() { return config; }
     QueueEvents& getQueueEvents() { return queueEvents; }
+    const boost::shared_ptr<MemoryAccountant>& getMemoryAccountant() { return memoryAccountant; }
+    const boost::shared_ptr<ContentSpill>& getContentSpill() { return contentSpill; }
+    const boost::shared_ptr<ContentPrefetch>& getContentPrefetch() { return contentPrefetch; }
+    RateLimits& getRateLimits() { return rateLimits; }
+    HeartbeatSweep& getHeartbeats() { return heartbeats; }
 
     void setExpiryPolicy(const boost::intrusive_ptr<ExpiryPolicy>& e) { expiryPolicy = e; }
     boost::intrusive_ptr<ExpiryPolicy> getExpiryPolicy() { return expiryPolicy; }
@@ -274,9 +340,20 @@ public:
 
     boost::shared_ptr<sys::ProtocolFactory> getProtocolFactory(const std::string& name = TCP_TRANSPORT) const;
 
+    /**
+     * Load modules deferred by --module-on-demand, one at a time, until
+     * available() returns true, initialising the plugins each one adds.
+     *@return false if no deferred module made available() true.
+     */
+    QPID_BROKER_EXTERN bool loadModuleFor(const boost::function<bool()>& available);
+
     /** Expose poller so plugins can register their descriptors. */
     boost::shared_ptr<sys::Poller> getPoller();
 
+    /** Poller served by the dedicated busy polling threads, null
+     * unless busy-poll-threads is set. */
+    boost::shared_ptr<sys::Poller> getBusyPoller() { return busyPoller; }
+
     boost::shared_ptr<sys::ConnectionCodec::Factory> getConnectionFactory() { return factory; }
     void setConnectionFactory(boost::shared_ptr<sys::ConnectionCodec::Factory> f) { factory = f; }
 
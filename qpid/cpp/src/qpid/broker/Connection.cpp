@@ -56,29 +56,6 @@ namespace _qmf = qmf::org::apache::qpid::broker;
 namespace qpid {
 namespace broker {
 
-struct ConnectionTimeoutTask : public sys::TimerTask {
-    sys::Timer& timer;
-    Connection& connection;
-
-    ConnectionTimeoutTask(uint16_t hb, sys::Timer& t, Connection& c) :
-        TimerTask(Duration(hb*2*TIME_SEC),"ConnectionTimeout"),
-        timer(t),
-        connection(c)
-    {}
-
-    void touch() {
-        restart();
-    }
-
-    void fire() {
-        // If we get here then we've not received any traffic in the timeout period
-        // Schedule closing the connection for the io thread
-        QPID_LOG(error, "Connection " << connection.getMgmtId()
-                 << " timed out: closing");
-        connection.abort();
-    }
-};
-
 Connection::Connection(ConnectionOutputHandler* out_,
                        Broker& broker_, const
                        std::string& mgmtId_,
@@ -88,6 +65,8 @@ Connection::Connection(ConnectionOutputHandler* out_,
                        bool shadow_,
                        bool delayManagement) :
     ConnectionState(out_, broker_),
+    lastChannelId(0),
+    lastChannel(0),
     securitySettings(external),
     adapter(*this, isLink_, shadow_),
     isLink(isLink_),
@@ -96,13 +75,17 @@ Connection::Connection(ConnectionOutputHandler* out_,
     mgmtObject(0),
     links(broker_.getLinks()),
     agent(0),
-    timer(broker_.getTimer()),
     errorListener(0),
     objectId(objectId_),
     shadow(shadow_),
     outboundTracker(*this)
 {
     outboundTracker.wrap(out);
+    // Output budgets depend on how fast this broker's socket drains,
+    // which cluster members cannot agree on
+    const Broker::Options& opts = broker.getOptions();
+    if ((opts.outputQuantum || opts.connectionOutputLimit) && !broker.isInCluster())
+        outputTasks.setByteBudget(opts.outputQuantum, opts.connectionOutputLimit, out);
     if (isLink)
         links.notifyConnection(mgmtId, this);
     // In a cluster, allow adding the management object to be delayed.
@@ -120,7 +103,7 @@ void Connection::addManagementObject() {
             // TODO set last bool true if system connection
             mgmtObject = new _qmf::Connection(agent, this, parent, mgmtId, !isLink, false);
             mgmtObject->set_shadow(shadow);
-            agent->addObject(mgmtObject, objectId);
+            agent->addDeferredObject(mgmtObject, objectId);
         }
         ConnectionState::setUrl(mgmtId);
     }
@@ -143,12 +126,9 @@ Connection::~Connection()
             agent->raiseEvent(_qmf::EventClientDisconnect(mgmtId, ConnectionState::getUserId()));
     }
     if (isLink)
-        links.notifyClosed(mgmtId);
+        links.notifyClosed(mgmtId, this);
 
-    if (heartbeatTimer)
-        heartbeatTimer->cancel();
-    if (timeoutTimer)
-        timeoutTimer->cancel();
+    broker.getHeartbeats().remove(*this);
 
     if (!isShadow()) broker.getConnectionCounter().dec_connectionCount();
 }
@@ -261,7 +241,7 @@ string Connection::getAuthCredentials()
 void Connection::notifyConnectionForced(const string& text)
 {
     if (isLink)
-        links.notifyConnectionForced(mgmtId, text);
+        links.notifyConnectionForced(mgmtId, this, text);
 }
 
 void Connection::setUserId(const string& userId)
@@ -289,23 +269,18 @@ void Connection::setUserProxyAuth(bool b)
 void Connection::close(connection::CloseCode code, const string& text)
 {
     QPID_LOG_IF(error, code != connection::CLOSE_CODE_NORMAL, "Connection " << mgmtId << " closed by error: " << text << "(" << code << ")");
-    if (heartbeatTimer)
-        heartbeatTimer->cancel();
-    if (timeoutTimer)
-        timeoutTimer->cancel();
+    broker.getHeartbeats().remove(*this);
     adapter.close(code, text);
     //make sure we delete dangling pointers from outputTasks before deleting sessions
     outputTasks.removeAll();
+    lastChannel = 0;
     channels.clear();
     getOutput().close();
 }
 
 // Send a close to the client but keep the channels. Used by cluster.
 void Connection::sendClose() {
-    if (heartbeatTimer)
-        heartbeatTimer->cancel();
-    if (timeoutTimer)
-        timeoutTimer->cancel();
+    broker.getHeartbeats().remove(*this);
     adapter.close(connection::CLOSE_CODE_NORMAL, "OK");
     getOutput().close();
 }
@@ -315,10 +290,7 @@ void Connection::idleOut(){}
 void Connection::idleIn(){}
 
 void Connection::closed(){ // Physically closed, suspend open sessions.
-    if (heartbeatTimer)
-        heartbeatTimer->cancel();
-    if (timeoutTimer)
-        timeoutTimer->cancel();
+    broker.getHeartbeats().remove(*this);
     try {
         while (!channels.empty())
             ptr_map_ptr(channels.begin())->handleDetach();
@@ -369,16 +341,20 @@ void Connection::sendHeartbeat() {
 }
 
 void Connection::closeChannel(uint16_t id) {
+    if (lastChannel && lastChannelId == id) lastChannel = 0;
     ChannelMap::iterator i = channels.find(id);
     if (i != channels.end()) channels.erase(i);
 }
 
 SessionHandler& Connection::getChannel(ChannelId id) {
+    if (lastChannel && lastChannelId == id) return *lastChannel;
     ChannelMap::iterator i=channels.find(id);
     if (i == channels.end()) {
         i = channels.insert(id, new SessionHandler(*this, id)).first;
     }
-    return *ptr_map_ptr(i);
+    lastChannelId = id;
+    lastChannel = ptr_map_ptr(i);
+    return *lastChannel;
 }
 
 ManagementObject* Connection::GetManagementObject(void) const
@@ -410,50 +386,33 @@ void Connection::setSecureConnection(SecureConnection* s)
     adapter.setSecureConnection(s);
 }
 
-struct ConnectionHeartbeatTask : public sys::TimerTask {
-    sys::Timer& timer;
-    Connection& connection;
-    ConnectionHeartbeatTask(uint16_t hb, sys::Timer& t, Connection& c) :
-        TimerTask(Duration(hb*TIME_SEC), "ConnectionHeartbeat"),
-        timer(t),
-        connection(c)
-    {}
-
-    void fire() {
-        // Setup next firing
-        setupNextFire();
-        timer.add(this);
-
-        // Send Heartbeat
-        connection.sendHeartbeat();
-    }
-};
-
 void Connection::abort()
 {
     // Make sure that we don't try to send a heartbeat as we're
     // aborting the connection
-    if (heartbeatTimer)
-        heartbeatTimer->cancel();
+    broker.getHeartbeats().remove(*this);
+
+    out.abort();
+}
 
+void Connection::timedOut()
+{
+    // Called from the HeartbeatSweep, which has already forgotten us.
+    // Schedule closing the connection for the io thread
+    QPID_LOG(error, "Connection " << getMgmtId() << " timed out: closing");
     out.abort();
 }
 
 void Connection::setHeartbeatInterval(uint16_t heartbeat)
 {
     setHeartbeat(heartbeat);
-    if (heartbeat > 0 && !isShadow()) {
-        heartbeatTimer = new ConnectionHeartbeatTask(heartbeat, timer, *this);
-        timer.add(heartbeatTimer);
-        timeoutTimer = new ConnectionTimeoutTask(heartbeat, timer, *this);
-        timer.add(timeoutTimer);
-    }
+    if (heartbeat > 0 && !isShadow())
+        broker.getHeartbeats().add(*this, heartbeat);
 }
 
 void Connection::restartTimeout()
 {
-    if (timeoutTimer)
-        timeoutTimer->touch();
+    active = 1;
 }
 
 bool Connection::isOpen() { return adapter.isOpen(); }
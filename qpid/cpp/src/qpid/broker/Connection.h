@@ -43,6 +43,7 @@
 #include "qpid/management/Manageable.h"
 #include "qpid/ptr_map.h"
 #include "qpid/sys/AggregateOutput.h"
+#include "qpid/sys/AtomicValue.h"
 #include "qpid/sys/ConnectionInputHandler.h"
 #include "qpid/sys/ConnectionOutputHandler.h"
 #include "qpid/sys/SecuritySettings.h"
@@ -61,7 +62,6 @@ namespace broker {
 class Broker;
 class LinkRegistry;
 class SecureConnection;
-struct ConnectionTimeoutTask;
 
 class Connection : public sys::ConnectionInputHandler,
                    public ConnectionState,
@@ -134,6 +134,10 @@ class Connection : public sys::ConnectionInputHandler,
     void sendHeartbeat();
     void restartTimeout();
     void abort();
+    /** Called by HeartbeatSweep when nothing was received for too long */
+    void timedOut();
+    /** @return true if a frame arrived since the last call, for HeartbeatSweep */
+    bool takeActivity() { return active.boolCompareAndSwap(1, 0); }
 
     template <class F> void eachSessionHandler(F f) {
         for (ChannelMap::iterator i = channels.begin(); i != channels.end(); ++i)
@@ -168,6 +172,10 @@ class Connection : public sys::ConnectionInputHandler,
     typedef std::vector<boost::shared_ptr<Queue> >::iterator queue_iterator;
 
     ChannelMap channels;
+    // Most frames arrive on the channel of the frame before, so
+    // getChannel() checks the last one it returned before the map.
+    framing::ChannelId lastChannelId;
+    SessionHandler* lastChannel;
     qpid::sys::SecuritySettings securitySettings;
     ConnectionHandler adapter;
     const bool isLink;
@@ -178,9 +186,7 @@ class Connection : public sys::ConnectionInputHandler,
     qmf::org::apache::qpid::broker::Connection* mgmtObject;
     LinkRegistry& links;
     management::ManagementAgent* agent;
-    sys::Timer& timer;
-    boost::intrusive_ptr<sys::TimerTask> heartbeatTimer;
-    boost::intrusive_ptr<ConnectionTimeoutTask> timeoutTimer;
+    sys::AtomicValue<uint32_t> active; // Set on every frame received
     ErrorListener* errorListener;
     uint64_t objectId;
     bool shadow;
@@ -20,6 +20,10 @@
  *
  */
 
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
 #include "qpid/SaslFactory.h"
 #include "qpid/broker/ConnectionHandler.h"
 #include "qpid/broker/Connection.h"
@@ -30,6 +34,9 @@
 #include "qpid/framing/enum.h"
 #include "qpid/log/Statement.h"
 #include "qpid/sys/SecurityLayer.h"
+#ifdef HAVE_ZLIB_H
+#include "qpid/sys/zlib/DeflateLayer.h"
+#endif
 #include "qpid/broker/AclModule.h"
 #include "qmf/org/apache/qpid/broker/EventClientConnectFail.h"
 
@@ -50,6 +57,8 @@ const std::string SESSION_FLOW_CONTROL("qpid.session_flow");
 const std::string CLIENT_PROCESS_NAME("qpid.client_process");
 const std::string CLIENT_PID("qpid.client_pid");
 const std::string CLIENT_PPID("qpid.client_ppid");
+const std::string QPID_COMPRESS("qpid.compress");
+const std::string DEFLATE("deflate");
 const int SESSION_FLOW_CONTROL_VER = 1;
 const std::string SPACE(" ");
 }
@@ -84,7 +93,7 @@ void ConnectionHandler::handle(framing::AMQFrame& frame)
         if (method && handle(*method)) {
             // This is a connection control frame, nothing more to do.
         } else if (isOpen()) {
-            handler->connection.getChannel(frame.getChannel()).in(frame);
+            handler->connection.getChannel(frame.getChannel()).receive(frame);
         } else {
             handler->proxy.close(
                 connection::CLOSE_CODE_FRAMING_ERROR,
@@ -109,13 +118,16 @@ ConnectionHandler::ConnectionHandler(Connection& connection, bool isClient, bool
 ConnectionHandler::Handler::Handler(Connection& c, bool isClient, bool isShadow) :
     proxy(c.getOutput()),
     connection(c), serverMode(!isClient), secured(0),
-    isOpen(false)
+    isOpen(false), compress(false)
 {
     if (serverMode) {
         FieldTable properties;
         Array mechanisms(0x95);
 
         properties.setString(QPID_FED_TAG, connection.getBroker().getFederationTag());
+#ifdef HAVE_ZLIB_H
+        properties.setString(QPID_COMPRESS, DEFLATE);
+#endif
 
         authenticator = SaslAuthenticator::createAuthenticator(c, isShadow);
         authenticator->getMechanisms(mechanisms);
@@ -176,6 +188,9 @@ void ConnectionHandler::Handler::startOk(const ConnectionStartOkBody& body)
     if (clientProperties.getAsInt(SESSION_FLOW_CONTROL) == SESSION_FLOW_CONTROL_VER) {
         connection.setClientThrottling();
     }
+#ifdef HAVE_ZLIB_H
+    compress = clientProperties.getAsString(QPID_COMPRESS) == DEFLATE;
+#endif
 
     if (connection.getMgmtObject() != 0) {
         string procName = clientProperties.getAsString(CLIENT_PROCESS_NAME);
@@ -226,6 +241,13 @@ void ConnectionHandler::Handler::open(const string& /*virtualHost*/,
     //install security layer if one has been negotiated:
     if (secured) {
         std::auto_ptr<SecurityLayer> sl = authenticator->getSecurityLayer(connection.getFrameMax());
+#ifdef HAVE_ZLIB_H
+        //compression takes the place of a layer only when SASL has not negotiated one
+        if (!sl.get() && compress) {
+            sl.reset(new sys::zlib::DeflateLayer(connection.getFrameMax()));
+            QPID_LOG(debug, "Connection is compressed");
+        }
+#endif
         if (sl.get()) secured->activateSecurityLayer(sl);
     }
 
@@ -61,6 +61,7 @@ class ConnectionHandler : public framing::FrameHandler
         std::auto_ptr<SaslAuthenticator> authenticator;
         SecureConnection* secured;
         bool isOpen;
+        bool compress;          // The client asked for its connection to be deflated
 
         Handler(Connection& connection, bool isClient, bool isShadow=false);
         ~Handler();
@@ -29,6 +29,8 @@
 #include "qpid/management/Manageable.h"
 #include "qpid/Url.h"
 #include "qpid/broker/Broker.h"
+#include "qpid/broker/TokenBucket.h"
+#include <boost/shared_ptr.hpp>
 
 namespace qpid {
 namespace broker {
@@ -50,7 +52,10 @@ class ConnectionState : public ConnectionToken, public management::Manageable
         federationLink(true),
         clientSupportsThrottling(false),
         clusterOrderOut(0)
-    {}
+    {
+        if (uint32_t rate = b.getOptions().maxConnectionRate)
+            rateBucket.reset(new TokenBucket(rate));
+    }
 
     virtual ~ConnectionState () {}
 
@@ -79,6 +84,9 @@ class ConnectionState : public ConnectionToken, public management::Manageable
     void setClientThrottling(bool set=true) { clientSupportsThrottling = set; }
     bool getClientThrottling() const { return clientSupportsThrottling; }
 
+    /** Message rate limit shared by the connection's sessions, 0 if unlimited */
+    const boost::shared_ptr<TokenBucket>& getRateBucket() const { return rateBucket; }
+
     Broker& getBroker() { return broker; }
 
     Broker& broker;
@@ -114,6 +122,7 @@ class ConnectionState : public ConnectionToken, public management::Manageable
     std::vector<Url> knownHosts;
     bool clientSupportsThrottling;
     framing::FrameHandler* clusterOrderOut;
+    boost::shared_ptr<TokenBucket> rateBucket;
 };
 
 }}
@@ -36,6 +36,10 @@ class Consumer {
     // inListeners allows QueueListeners to efficiently track if this instance is registered
     // for notifications without having to search its containers
     bool inListeners;
+    // listed is set while QueueListeners still holds an entry for this
+    // instance; removal only clears inListeners and the entry is
+    // dropped lazily
+    bool listed;
     // the name is generated by broker and is unique within broker scope.  It is not
     // provided or known by the remote Consumer.
     const std::string name;
@@ -43,9 +47,14 @@ class Consumer {
     typedef boost::shared_ptr<Consumer> shared_ptr;
 
     framing::SequenceNumber position;
+    // Where a browser left off, as a hint for Messages::browse()
+    size_t cursor;
+    // Queue::scanGeneration() when position was last set; while it is
+    // unchanged nothing before position can have become consumable
+    uint32_t scanGeneration;
 
     Consumer(const std::string& _name, bool preAcquires = true)
-      : acquires(preAcquires), inListeners(false), name(_name), position(0) {}
+      : acquires(preAcquires), inListeners(false), listed(false), name(_name), position(0), cursor(0), scanGeneration(0) {}
     bool preAcquires() const { return acquires; }
     const std::string& getName() const { return name; }
 
@@ -53,6 +62,8 @@ class Consumer {
     virtual void notify() = 0;
     virtual bool filter(boost::intrusive_ptr<Message>) { return true; }
     virtual bool accept(boost::intrusive_ptr<Message>) { return true; }
+    /** Give back what accept() took for a message that is then not delivered */
+    virtual void unaccept(boost::intrusive_ptr<Message>) {}
     virtual OwnershipToken* getSession() = 0;
     virtual ~Consumer(){}
     friend class QueueListeners;
@@ -0,0 +1,74 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/broker/ContentPrefetch.h"
+#include "qpid/broker/Message.h"
+#include "qpid/broker/Queue.h"
+#include "qpid/log/Statement.h"
+#include <boost/bind.hpp>
+
+namespace qpid {
+namespace broker {
+
+ContentPrefetch::ContentPrefetch(uint32_t d) : depth(d)
+{
+    if (depth)
+        QPID_LOG(info, "Reading released message content from the store up to " << depth
+                 << " messages ahead of consumers");
+}
+
+ContentPrefetch::~ContentPrefetch()
+{
+    stop();
+}
+
+void ContentPrefetch::start(const boost::shared_ptr<sys::Poller>& poller)
+{
+    loads.reset(new Loads(boost::bind(&ContentPrefetch::loadBatch, this, _1), poller));
+    loads->start();
+}
+
+void ContentPrefetch::stop()
+{
+    if (loads.get()) loads->stop();
+}
+
+void ContentPrefetch::load(const boost::shared_ptr<Queue>& queue, const boost::intrusive_ptr<Message>& msg)
+{
+    // Never read the store on the caller's thread, it holds the queue's lock
+    if (loads.get()) loads->push(Load(queue, msg));
+}
+
+ContentPrefetch::Loads::Batch::const_iterator ContentPrefetch::loadBatch(const Loads::Batch& batch)
+{
+    for (Loads::Batch::const_iterator i = batch.begin(); i != batch.end(); ++i) {
+        try {
+            i->second->prefetchContent(*i->first);
+        } catch (const std::exception& e) {
+            // Delivery reads the content itself if it is still released
+            QPID_LOG(warning, "Failed to prefetch message content on " << i->first->getName()
+                     << ": " << e.what());
+        }
+    }
+    return batch.end();
+}
+
+}} // namespace qpid::broker
@@ -0,0 +1,79 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_BROKER_CONTENTPREFETCH_H
+#define QPID_BROKER_CONTENTPREFETCH_H
+
+#include "qpid/broker/BrokerImportExport.h"
+#include "qpid/RefCounted.h"
+#include "qpid/sys/PollableQueue.h"
+#include <boost/intrusive_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <memory>
+#include <utility>
+
+namespace qpid {
+namespace sys {
+class Poller;
+}
+namespace broker {
+
+class Message;
+class Queue;
+
+/**
+ * Reads the content of messages that were released to the store back
+ * into memory before consumers reach them.
+ *
+ * As consumers take messages, each queue with a store hands the
+ * released messages up to a depth ahead of them to load(). The
+ * content is read on the poller's threads, a whole message in one
+ * store read, so dispatch normally finds it in memory instead of
+ * reading it from the store a frame at a time.
+ */
+class ContentPrefetch
+{
+  public:
+    /** A depth of 0 disables prefetching */
+    QPID_BROKER_EXTERN ContentPrefetch(uint32_t depth);
+    QPID_BROKER_EXTERN ~ContentPrefetch();
+
+    QPID_BROKER_EXTERN void start(const boost::shared_ptr<sys::Poller>& poller);
+    QPID_BROKER_EXTERN void stop();
+
+    bool isEnabled() const { return depth; }
+    uint32_t getDepth() const { return depth; }
+
+    /** Read the content of @a msg on @a queue back on an IO thread, does nothing until started */
+    QPID_BROKER_EXTERN void load(const boost::shared_ptr<Queue>& queue, const boost::intrusive_ptr<Message>& msg);
+
+  private:
+    typedef std::pair<boost::shared_ptr<Queue>, boost::intrusive_ptr<Message> > Load;
+    typedef sys::PollableQueue<Load> Loads;
+
+    const uint32_t depth;
+    std::auto_ptr<Loads> loads;
+
+    Loads::Batch::const_iterator loadBatch(const Loads::Batch& batch);
+};
+
+}} // namespace qpid::broker
+
+#endif  /*!QPID_BROKER_CONTENTPREFETCH_H*/
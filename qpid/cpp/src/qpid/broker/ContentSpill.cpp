@@ -0,0 +1,177 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/broker/ContentSpill.h"
+#include "qpid/broker/Broker.h"
+#include "qpid/broker/Message.h"
+#include "qpid/broker/Queue.h"
+#include "qpid/framing/Buffer.h"
+#include "qpid/sys/MemoryMappedFile.h"
+#include "qpid/log/Statement.h"
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+namespace qpid {
+namespace broker {
+
+using qpid::sys::MemoryMappedFile;
+
+struct ContentSpill::Segment
+{
+    MemoryMappedFile file;
+    size_t used;
+
+    Segment(const std::string& directory, size_t size) : file(directory, size), used(0) {}
+};
+
+ContentSpill::Extent::Extent(const boost::shared_ptr<Segment>& s, char* d, size_t n,
+                             const boost::shared_ptr<sys::AtomicValue<uint64_t> >& t)
+    : segment(s), data(d), size(n), total(t)
+{
+    *total += size;
+}
+
+ContentSpill::Extent::~Extent()
+{
+    *total -= size;
+}
+
+void ContentSpill::Extent::read(std::string& out) const
+{
+    out.assign(data, size);
+}
+
+void ContentSpill::Extent::read(std::string& out, size_t offset, size_t n) const
+{
+    assert(offset <= size);
+    out.assign(data + offset, std::min(n, size - offset));
+}
+
+void ContentSpill::Extent::encode(framing::Buffer& buffer) const
+{
+    buffer.putRawData(reinterpret_cast<const uint8_t*>(data), size);
+}
+
+void ContentSpill::Extent::fill(size_t offset, const char* in, size_t n)
+{
+    assert(offset + n <= size);
+    ::memcpy(data + offset, in, n);
+}
+
+ContentSpill::ContentSpill(Broker* b, const std::string& d, uint64_t s, uint32_t w)
+    : broker(b), directory(d), spillSize(s), window(std::max(w, uint32_t(2))),
+      spilledBytes(new sys::AtomicValue<uint64_t>()), timer(0)
+{
+    if (spillSize)
+        QPID_LOG(info, "Spilling message content to " << directory << " beyond " << spillSize
+                 << " bytes, keeping " << window << " messages at the head of each queue");
+}
+
+ContentSpill::~ContentSpill()
+{
+    stop();
+}
+
+void ContentSpill::start(sys::Timer& t, sys::Duration period, const boost::shared_ptr<sys::Poller>& poller)
+{
+    restores.reset(new Restores(boost::bind(&ContentSpill::restoreBatch, this, _1), poller));
+    restores->start();
+    timer = &t;
+    task = new Task(*this, period);
+    timer->add(task);
+}
+
+void ContentSpill::stop()
+{
+    if (task) task->cancel();
+    if (restores.get()) restores->stop();
+}
+
+ContentSpill::Task::Task(ContentSpill& p, sys::Duration d) : sys::TimerTask(d, "ContentSpill"), parent(p) {}
+
+void ContentSpill::Task::fire()
+{
+    parent.check();
+    setupNextFire();
+    parent.timer->add(this);
+}
+
+ContentSpill::ExtentPtr ContentSpill::write(const std::string& content)
+{
+    ExtentPtr extent = reserve(content.size());
+    // The space is ours alone, copy without the lock
+    extent->fill(0, content.data(), content.size());
+    return extent;
+}
+
+ContentSpill::ExtentPtr ContentSpill::reserve(size_t size)
+{
+    sys::Mutex::ScopedLock l(lock);
+    if (!current || current->file.getSize() - current->used < size) {
+        current.reset(new Segment(directory, std::max(size, size_t(SEGMENT_SIZE))));
+    }
+    char* data = current->file.getData() + current->used;
+    current->used += size;
+    return ExtentPtr(new Extent(current, data, size, spilledBytes));
+}
+
+void ContentSpill::restore(const boost::intrusive_ptr<Message>& msg)
+{
+    if (restores.get()) restores->push(msg);
+    else msg->restoreContent();
+}
+
+ContentSpill::Restores::Batch::const_iterator ContentSpill::restoreBatch(const Restores::Batch& batch)
+{
+    for (Restores::Batch::const_iterator i = batch.begin(); i != batch.end(); ++i) {
+        (*i)->restoreContent();
+    }
+    return batch.end();
+}
+
+void ContentSpill::check()
+{
+    if (!spillSize || !broker) return;
+    uint64_t messages = broker->getMemoryAccountant()->getMessageBytes();
+    uint64_t spilled = getSpilledBytes();
+    if (messages <= spilled + spillSize) return;
+    uint64_t excess = messages - spilled - spillSize;
+    std::vector<boost::intrusive_ptr<Message> > batch;
+    broker->getQueues().eachQueue(boost::bind(&ContentSpill::collect, this, _1, boost::ref(excess), boost::ref(batch)));
+    try {
+        for (std::vector<boost::intrusive_ptr<Message> >::iterator i = batch.begin(); i != batch.end(); ++i) {
+            (*i)->spillContent(*this);
+        }
+    } catch (const std::exception& e) {
+        QPID_LOG(error, "Failed to spill message content to " << directory << ": " << e.what());
+    }
+    QPID_LOG(debug, "Message content spilled: " << getSpilledBytes() << " bytes");
+}
+
+void ContentSpill::collect(const boost::shared_ptr<Queue>& queue, uint64_t& excess,
+                           std::vector<boost::intrusive_ptr<Message> >& batch)
+{
+    if (excess) excess -= std::min(excess, queue->collectSpillable(window, MIN_CONTENT, excess, batch));
+}
+
+}} // namespace qpid::broker
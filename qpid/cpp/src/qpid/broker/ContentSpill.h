@@ -0,0 +1,157 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_BROKER_CONTENTSPILL_H
+#define QPID_BROKER_CONTENTSPILL_H
+
+#include "qpid/broker/BrokerImportExport.h"
+#include "qpid/sys/AtomicValue.h"
+#include "qpid/sys/Mutex.h"
+#include "qpid/sys/PollableQueue.h"
+#include "qpid/sys/Timer.h"
+#include <boost/intrusive_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace qpid {
+namespace framing {
+class Buffer;
+}
+namespace sys {
+class Poller;
+}
+namespace broker {
+
+class Broker;
+class Message;
+class Queue;
+
+/**
+ * Moves the content of queued messages out of memory when the broker
+ * holds more message content than the spill size, without needing a
+ * store.
+ *
+ * Each pass takes messages lying more than a window of messages
+ * behind the head of their queue and writes their content into
+ * segments of memory mapped files in the paging directory, which the
+ * system can write back and reclaim. As consumers take messages from
+ * the head, each queue asks for the content of the message half a
+ * window ahead to be read back in on an IO thread, so it is normally
+ * in memory again by the time it is delivered. A message that is
+ * delivered while spilled is sent straight from its segment.
+ *
+ * A segment is removed once all the content written to it has been
+ * restored or its messages have gone.
+ */
+class ContentSpill
+{
+    struct Segment;
+
+  public:
+    /** Content written to a segment, released with the last reference */
+    class Extent : private boost::noncopyable
+    {
+      public:
+        ~Extent();
+        size_t getSize() const { return size; }
+        void read(std::string& out) const;
+        /** Read up to @a n bytes from @a offset */
+        void read(std::string& out, size_t offset, size_t n) const;
+        void encode(framing::Buffer& buffer) const;
+        /** Copy @a n bytes into the extent at @a offset */
+        void fill(size_t offset, const char* in, size_t n);
+      private:
+        boost::shared_ptr<Segment> segment;
+        char* data;
+        size_t size;
+        boost::shared_ptr<sys::AtomicValue<uint64_t> > total;
+
+        Extent(const boost::shared_ptr<Segment>&, char*, size_t,
+               const boost::shared_ptr<sys::AtomicValue<uint64_t> >&);
+      friend class ContentSpill;
+    };
+    typedef boost::shared_ptr<Extent> ExtentPtr;
+
+    /** Messages with less content than this are not worth spilling */
+    static const uint64_t MIN_CONTENT = 4096;
+    static const size_t SEGMENT_SIZE = 16*1024*1024;
+
+    /** A spillSize of 0 disables spilling */
+    QPID_BROKER_EXTERN ContentSpill(Broker* broker, const std::string& directory,
+                                    uint64_t spillSize, uint32_t window);
+    QPID_BROKER_EXTERN ~ContentSpill();
+
+    /** Check for memory pressure every period, restore content on the poller's threads */
+    QPID_BROKER_EXTERN void start(sys::Timer& timer, sys::Duration period,
+                                  const boost::shared_ptr<sys::Poller>& poller);
+    QPID_BROKER_EXTERN void stop();
+
+    bool isEnabled() const { return spillSize; }
+    uint32_t getWindow() const { return window; }
+    /** Content currently held in segments rather than in memory */
+    uint64_t getSpilledBytes() const { return spilledBytes->get(); }
+
+    /** Copy @a content into a segment */
+    QPID_BROKER_EXTERN ExtentPtr write(const std::string& content);
+
+    /** Claim @a size bytes of a segment, to be filled by the caller */
+    QPID_BROKER_EXTERN ExtentPtr reserve(size_t size);
+
+    /** Read the content of @a msg back into memory, on an IO thread once started */
+    QPID_BROKER_EXTERN void restore(const boost::intrusive_ptr<Message>& msg);
+
+    /** Spill content from deep queues if message memory exceeds the spill size */
+    QPID_BROKER_EXTERN void check();
+
+  private:
+    class Task : public sys::TimerTask
+    {
+      public:
+        Task(ContentSpill& parent, sys::Duration period);
+        void fire();
+      private:
+        ContentSpill& parent;
+    };
+
+    typedef sys::PollableQueue<boost::intrusive_ptr<Message> > Restores;
+
+    Broker* broker;
+    const std::string directory;
+    const uint64_t spillSize;
+    const uint32_t window;
+    boost::shared_ptr<sys::AtomicValue<uint64_t> > spilledBytes;
+
+    sys::Mutex lock;
+    boost::shared_ptr<Segment> current;     // Segment being written
+    sys::Timer* timer;
+    boost::intrusive_ptr<sys::TimerTask> task;
+    std::auto_ptr<Restores> restores;
+
+    void collect(const boost::shared_ptr<Queue>& queue, uint64_t& excess,
+                 std::vector<boost::intrusive_ptr<Message> >& batch);
+    Restores::Batch::const_iterator restoreBatch(const Restores::Batch& batch);
+};
+
+}} // namespace qpid::broker
+
+#endif  /*!QPID_BROKER_CONTENTSPILL_H*/
@@ -33,6 +33,13 @@ namespace qpid {
 	    virtual Message& getMessage() = 0;
 	    
             virtual void deliverTo(const boost::shared_ptr<Queue>& queue) = 0;
+            /**
+             * Called around the deliverTo() calls for a message routed
+             * to several queues. Deliveries may be deferred until
+             * endBatch().
+             */
+            virtual void beginBatch() {}
+            virtual void endBatch() {}
             virtual uint64_t contentSize() { return 0; }
             virtual ~Deliverable(){}
         };
@@ -21,19 +21,58 @@
 
 #include "qpid/broker/DeliverableMessage.h"
 #include "qpid/broker/Queue.h"
+#include "qpid/log/Statement.h"
 
 using namespace qpid::broker;
 
-DeliverableMessage::DeliverableMessage(const boost::intrusive_ptr<Message>& _msg) : msg(_msg)
+DeliverableMessage::DeliverableMessage(const boost::intrusive_ptr<Message>& _msg) :
+    msg(_msg), batching(false)
 {
 }
 
+DeliverableMessage::~DeliverableMessage()
+{
+    // Don't leave the message half delivered if the batch was cut short
+    if (batching) endBatch();
+}
+
 void DeliverableMessage::deliverTo(const boost::shared_ptr<Queue>& queue)
 {
-    queue->deliver(msg);    
+    if (queue->isPartitioned()) {
+        deliverTo(queue->partitionFor(*msg));
+        return;
+    }
+    if (batching) {
+        if (queue->prepareDelivery(msg))
+            pending.push_back(queue);
+    } else {
+        queue->deliver(msg);
+    }
     delivered = true;
 }
 
+void DeliverableMessage::beginBatch()
+{
+    batching = true;
+}
+
+void DeliverableMessage::endBatch()
+{
+    batching = false;
+    std::vector<boost::shared_ptr<Queue> > queues;
+    queues.swap(pending);
+    // Consumers are only notified once the message is on every queue.
+    // It is enqueued on each of them already, so one failing must not
+    // keep it from the rest.
+    for (std::vector<boost::shared_ptr<Queue> >::iterator i = queues.begin(); i != queues.end(); ++i) {
+        try {
+            (*i)->completeDelivery(msg);
+        } catch (const std::exception& e) {
+            QPID_LOG(error, "Failed to complete delivery to " << (*i)->getName() << ": " << e.what());
+        }
+    }
+}
+
 Message& DeliverableMessage::getMessage()
 {
     return *msg;
@@ -26,17 +26,24 @@
 #include "qpid/broker/Message.h"
 
 #include <boost/intrusive_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
 
 namespace qpid {
     namespace broker {
         class QPID_BROKER_CLASS_EXTERN DeliverableMessage : public Deliverable{
             boost::intrusive_ptr<Message> msg;
+            // Batched delivery: queues waiting for completeDelivery()
+            bool batching;
+            std::vector<boost::shared_ptr<Queue> > pending;
         public:
             QPID_BROKER_EXTERN DeliverableMessage(const boost::intrusive_ptr<Message>& msg);
             QPID_BROKER_EXTERN virtual void deliverTo(const boost::shared_ptr<Queue>& queue);
+            QPID_BROKER_EXTERN virtual void beginBatch();
+            QPID_BROKER_EXTERN virtual void endBatch();
             QPID_BROKER_EXTERN Message& getMessage();
             QPID_BROKER_EXTERN uint64_t contentSize();
-            virtual ~DeliverableMessage(){}
+            QPID_BROKER_EXTERN virtual ~DeliverableMessage();
         };
     }
 }
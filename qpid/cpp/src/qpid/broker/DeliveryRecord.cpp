@@ -38,15 +38,32 @@ DeliveryRecord::DeliveryRecord(const QueuedMessage& _msg,
                                bool accepted, 
                                bool _windowing,
                                uint32_t _credit) : msg(_msg), 
+                                                  queue(_queue), 
+                                                  tag(new std::string(_tag)),
+                                                  credit(msg.payload ? msg.payload->getRequiredCredit() : _credit),
+                                                  acquired(_acquired),
+                                                  acceptExpected(!accepted),
+                                                  cancelled(false),
+                                                  completed(false),
+                                                  ended(accepted && acquired),
+                                                  windowing(_windowing)
+{}
+
+DeliveryRecord::DeliveryRecord(const QueuedMessage& _msg, 
+                               const Queue::shared_ptr& _queue, 
+                               const Tag& _tag,
+                               bool _acquired,
+                               bool accepted, 
+                               bool _windowing) : msg(_msg), 
                                                   queue(_queue), 
                                                   tag(_tag),
+                                                  credit(msg.payload ? msg.payload->getRequiredCredit() : 0),
                                                   acquired(_acquired),
                                                   acceptExpected(!accepted),
                                                   cancelled(false),
                                                   completed(false),
                                                   ended(accepted && acquired),
-                                                  windowing(_windowing),
-                                                  credit(msg.payload ? msg.payload->getRequiredCredit() : _credit)
+                                                  windowing(_windowing)
 {}
 
 bool DeliveryRecord::setEnded()
@@ -79,7 +96,7 @@ void DeliveryRecord::deliver(framing::FrameHandler& h, DeliveryId deliveryId, ui
     }
     msg.payload->adjustTtl();
 
-    framing::AMQFrame method((framing::MessageTransferBody(framing::ProtocolVersion(), tag, acceptExpected ? 0 : 1, acquired ? 0 : 1)));
+    framing::AMQFrame method((framing::MessageTransferBody(framing::ProtocolVersion(), *tag, acceptExpected ? 0 : 1, acquired ? 0 : 1)));
     method.setEof(false);
     h.handle(method);
     msg.payload->sendHeader(h, framesize);
@@ -153,7 +170,7 @@ uint32_t DeliveryRecord::getCredit() const
 }
 
 void DeliveryRecord::acquire(DeliveryIds& results) {
-    if (queue->acquire(msg, tag)) {
+    if (queue->acquire(msg, *tag)) {
         acquired = true;
         results.push_back(id);
         if (!acceptExpected) {
@@ -167,15 +184,31 @@ void DeliveryRecord::acquire(DeliveryIds& results) {
 
 void DeliveryRecord::cancel(const std::string& cancelledTag) 
 {
-    if (tag == cancelledTag)
+    if (*tag == cancelledTag)
         cancelled = true;
 }
 
+namespace {
+/** @return the first record with an id no less than id */
+DeliveryRecords::iterator seek(DeliveryRecords& records, DeliveryId id)
+{
+    if (records.empty()) return records.end();
+    // Ids are allocated in sequence, so a record is never further from
+    // the front than its id, and unless records have been removed out
+    // of order it is exactly that far.
+    int32_t offset = id - records.front().getId();
+    if (offset <= 0) return records.begin();
+    if (size_t(offset) < records.size() && records[offset].getId() == id) return records.begin() + offset;
+    size_t limit = std::min(size_t(offset), records.size());
+    return lower_bound(records.begin(), records.begin() + limit, id);
+}
+}
+
 AckRange DeliveryRecord::findRange(DeliveryRecords& records, DeliveryId first, DeliveryId last)
 {
-    DeliveryRecords::iterator start = lower_bound(records.begin(), records.end(), first);
+    DeliveryRecords::iterator start = seek(records, first);
     // Find end - position it just after the last record in range
-    DeliveryRecords::iterator end = lower_bound(records.begin(), records.end(), last);
+    DeliveryRecords::iterator end = seek(records, last);
     if (end != records.end() && end->getId() == last) ++end;
     return AckRange(start, end);
 }
@@ -187,7 +220,7 @@ namespace broker {
 std::ostream& operator<<(std::ostream& out, const DeliveryRecord& r) 
 {
     out << "{" << "id=" << r.id.getValue();
-    out << ", tag=" << r.tag << "}";
+    out << ", tag=" << *r.tag << "}";
     out << ", queue=" << r.queue->getName() << "}";
     return out;
 }
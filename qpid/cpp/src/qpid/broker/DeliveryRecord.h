@@ -31,6 +31,7 @@
 #include "qpid/broker/QueuedMessage.h"
 #include "qpid/broker/DeliveryId.h"
 #include "qpid/broker/Message.h"
+#include <boost/shared_ptr.hpp>
 
 namespace qpid {
 namespace broker {
@@ -44,16 +45,15 @@ struct AckRange;
  */
 class DeliveryRecord
 {
+  public:
+    /** Consumer name, shared by all the records of one consumer */
+    typedef boost::shared_ptr<const std::string> Tag;
+
+  private:
     QueuedMessage msg;
     mutable boost::shared_ptr<Queue> queue;
-    std::string tag;    // name of consumer
+    Tag tag;
     DeliveryId id;
-    bool acquired : 1;
-    bool acceptExpected : 1;
-    bool cancelled : 1;
-    bool completed : 1;
-    bool ended : 1;
-    bool windowing : 1;
 
     /**
      * Record required credit on construction as the pointer to the
@@ -64,6 +64,13 @@ class DeliveryRecord
      */
     uint32_t credit;
 
+    bool acquired : 1;
+    bool acceptExpected : 1;
+    bool cancelled : 1;
+    bool completed : 1;
+    bool ended : 1;
+    bool windowing : 1;
+
   public:
     QPID_BROKER_EXTERN DeliveryRecord(const QueuedMessage& msg,
                                       const boost::shared_ptr<Queue>& queue, 
@@ -73,6 +80,12 @@ class DeliveryRecord
                                       bool windowing,
                                       uint32_t credit=0       // Only used if msg is empty.
     );
+    QPID_BROKER_EXTERN DeliveryRecord(const QueuedMessage& msg,
+                                      const boost::shared_ptr<Queue>& queue, 
+                                      const Tag& tag,
+                                      bool acquired,
+                                      bool accepted,
+                                      bool windowing);
     
     bool coveredBy(const framing::SequenceSet* const range) const { return range->contains(id); }
     
@@ -97,7 +110,7 @@ class DeliveryRecord
     bool isWindowing() const { return windowing; }
     
     uint32_t getCredit() const;
-    const std::string& getTag() const { return tag; }
+    const std::string& getTag() const { return *tag; }
 
     void deliver(framing::FrameHandler& h, DeliveryId deliveryId, uint16_t framesize);
     void setId(DeliveryId _id) { id = _id; }
@@ -34,9 +34,22 @@ namespace _qmf = qmf::org::apache::qpid::broker;
 namespace 
 {
     const std::string qpidExclusiveBinding("qpid.exclusive-binding");
+    const size_t MIN_ROUTE_SHARDS = 16;
 }
 
-DirectExchange::DirectExchange(const string& _name, Manageable* _parent, Broker* b) : Exchange(_name, _parent, b)
+DirectExchange::RouteTable::RouteTable(size_t shardCount) :
+    shards(shardCount, boost::shared_ptr<const RouteShard>(new RouteShard)), keys(0)
+{}
+
+size_t DirectExchange::RouteTable::shardOf(const string& key) const
+{
+    return boost::hash<string>()(key) % shards.size();
+}
+
+DirectExchange::DirectExchange(const string& _name, Manageable* _parent, Broker* b) :
+    Exchange(_name, _parent, b),
+    routeTable(new RouteTable(MIN_ROUTE_SHARDS)),
+    batching(false)
 {
     if (mgmtExchange != 0)
         mgmtExchange->set_type(typeName);
@@ -44,7 +57,9 @@ DirectExchange::DirectExchange(const string& _name, Manageable* _parent, Broker*
 
 DirectExchange::DirectExchange(const string& _name, bool _durable,
                                const FieldTable& _args, Manageable* _parent, Broker* b) :
-    Exchange(_name, _durable, _args, _parent, b)
+    Exchange(_name, _durable, _args, _parent, b),
+    routeTable(new RouteTable(MIN_ROUTE_SHARDS)),
+    batching(false)
 {
     if (mgmtExchange != 0)
         mgmtExchange->set_type(typeName);
@@ -75,6 +90,7 @@ bool DirectExchange::bind(Queue::shared_ptr queue, const string& routingKey, con
                  << " (origin=" << fedOrigin << ")");
 
         if (bk.queues.add_unless(b, MatchQueue(queue))) {
+            updateRoute(routingKey, bk.queues.snapshot());
             b->startManagement();
             propagate = bk.fedBinding.addOrigin(queue->getName(), fedOrigin);
             if (mgmtExchange != 0) {
@@ -141,6 +157,9 @@ bool DirectExchange::unbind(Queue::shared_ptr queue, const string& routingKey, c
             }
             if (bk.queues.empty()) {
                 bindings.erase(routingKey);
+                updateRoute(routingKey, Queues::ConstPtr());
+            } else {
+                updateRoute(routingKey, bk.queues.snapshot());
             }
         } else {
             return false;
@@ -155,15 +174,76 @@ bool DirectExchange::unbind(Queue::shared_ptr queue, const string& routingKey, c
 
 void DirectExchange::route(Deliverable& msg, const string& routingKey, const FieldTable* /*args*/)
 {
+    static const ConstBindingList noBindings;
     PreRoute pr(msg, this);
-    ConstBindingList b;
+    boost::shared_ptr<const RouteTable> table;
     {
-        Mutex::ScopedLock l(lock);
-        b = bindings[routingKey].queues.snapshot();
+        Mutex::ScopedLock l(routeTableLock);
+        table = routeTable;
     }
-    doRoute(msg, b);
+    const RouteShard& shard = table->shardFor(routingKey);
+    RouteShard::const_iterator i = shard.find(routingKey);
+    // Each key's bindings are kept as an immutable list, routed from
+    // in place so that the common case of one queue takes no copies
+    doRoute(msg, i == shard.end() ? noBindings : i->second);
 }
 
+void DirectExchange::updateRoute(const string& routingKey, Queues::ConstPtr queues)
+{
+    // Note: lock held by caller, so no other writer can replace the table
+    if (batching) return;
+    boost::shared_ptr<RouteTable> table(new RouteTable(*routeTable));
+    size_t s = table->shardOf(routingKey);
+    boost::shared_ptr<RouteShard> shard(new RouteShard(*table->shards[s]));
+    if (queues && !queues->empty()) {
+        Queues::ConstPtr& entry = (*shard)[routingKey];
+        if (!entry) ++table->keys;
+        entry = queues;
+    } else if (shard->erase(routingKey)) {
+        --table->keys;
+    }
+    table->shards[s] = shard;
+    size_t shardCount = table->shards.size();
+    if (table->keys > shardCount * shardCount)
+        table = buildRouteTable(shardCount * 2);
+    Mutex::ScopedLock l(routeTableLock);
+    routeTable = table;
+}
+
+/** A table of all the bindings, expects lock to be held */
+boost::shared_ptr<DirectExchange::RouteTable> DirectExchange::buildRouteTable(size_t shardCount)
+{
+    boost::shared_ptr<RouteTable> table(new RouteTable(shardCount));
+    std::vector<boost::shared_ptr<RouteShard> > shards(shardCount);
+    for (size_t s = 0; s < shardCount; ++s) shards[s].reset(new RouteShard);
+    for (Bindings::iterator i = bindings.begin(); i != bindings.end(); ++i) {
+        Queues::ConstPtr queues = i->second.queues.snapshot();
+        if (queues && !queues->empty()) {
+            (*shards[table->shardOf(i->first)])[i->first] = queues;
+            ++table->keys;
+        }
+    }
+    table->shards.assign(shards.begin(), shards.end());
+    return table;
+}
+
+void DirectExchange::beginBindingBatch()
+{
+    Mutex::ScopedLock l(lock);
+    batching = true;
+}
+
+void DirectExchange::endBindingBatch()
+{
+    Mutex::ScopedLock l(lock);
+    if (!batching) return;
+    batching = false;
+    size_t shardCount = MIN_ROUTE_SHARDS;
+    while (bindings.size() > shardCount * shardCount) shardCount *= 2;
+    boost::shared_ptr<RouteTable> table = buildRouteTable(shardCount);
+    Mutex::ScopedLock rl(routeTableLock);
+    routeTable = table;
+}
 
 bool DirectExchange::isBound(Queue::shared_ptr queue, const string* const routingKey, const FieldTable* const)
 {
@@ -28,6 +28,9 @@
 #include "qpid/framing/FieldTable.h"
 #include "qpid/sys/CopyOnWriteArray.h"
 #include "qpid/sys/Mutex.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace qpid {
 namespace broker {
@@ -41,6 +44,26 @@ class DirectExchange : public virtual Exchange {
     Bindings bindings;
     qpid::sys::Mutex lock;
 
+    // Read-only snapshot of the bindings used by route(), so routing
+    // never waits on lock. The keys are spread over shards, with about
+    // as many shards as keys in each. A change copies only its key's
+    // shard and the list of shards, so it costs about the square root of
+    // the number of keys.
+    typedef boost::unordered_map<std::string, Queues::ConstPtr> RouteShard;
+    struct RouteTable {
+        std::vector<boost::shared_ptr<const RouteShard> > shards;
+        size_t keys;
+        RouteTable(size_t shardCount);
+        const RouteShard& shardFor(const std::string& key) const { return *shards[shardOf(key)]; }
+        size_t shardOf(const std::string& key) const;
+    };
+    boost::shared_ptr<const RouteTable> routeTable;
+    qpid::sys::Mutex routeTableLock; // guards only the routeTable pointer
+    bool batching;  // routeTable is not updated until endBindingBatch()
+
+    void updateRoute(const std::string& routingKey, Queues::ConstPtr queues);
+    boost::shared_ptr<RouteTable> buildRouteTable(size_t shardCount);
+
 public:
     static const std::string typeName;
         
@@ -67,6 +90,8 @@ public:
     QPID_BROKER_EXTERN virtual ~DirectExchange();
 
     virtual bool supportsDynamicBinding() { return true; }
+    void beginBindingBatch();
+    void endBindingBatch();
 };
 
 }}
@@ -23,14 +23,14 @@
 #include "qpid/framing/reply_exceptions.h"
 #include "qpid/log/Statement.h"
 #include "qpid/sys/Timer.h"
-#include "qpid/ptr_map.h"
 
 #include <boost/format.hpp>
+#include <boost/functional/hash.hpp>
 #include <iostream>
 
 using boost::intrusive_ptr;
+using boost::shared_ptr;
 using qpid::sys::Mutex;
-using qpid::ptr_map_ptr;
 using namespace qpid::broker;
 using namespace qpid::framing;
 
@@ -45,7 +45,7 @@ void DtxManager::start(const std::string& xid, DtxBuffer::shared_ptr ops)
 
 void DtxManager::join(const std::string& xid, DtxBuffer::shared_ptr ops)
 {
-    getWork(xid)->add(ops);
+    find(xid)->add(ops);
 }
 
 void DtxManager::recover(const std::string& xid, std::auto_ptr<TPCTransactionContext> txn, DtxBuffer::shared_ptr ops)
@@ -57,7 +57,7 @@ bool DtxManager::prepare(const std::string& xid)
 {
     QPID_LOG(debug, "preparing: " << xid);
     try {
-        return getWork(xid)->prepare();
+        return find(xid)->prepare();
     } catch (DtxTimeoutException& e) {
         remove(xid);
         throw e;
@@ -68,7 +68,7 @@ bool DtxManager::commit(const std::string& xid, bool onePhase)
 {
     QPID_LOG(debug, "committing: " << xid);
     try {
-        bool result = getWork(xid)->commit(onePhase);
+        bool result = find(xid)->commit(onePhase);
         remove(xid);
         return result;
     } catch (DtxTimeoutException& e) {
@@ -81,7 +81,7 @@ void DtxManager::rollback(const std::string& xid)
 {
     QPID_LOG(debug, "rolling back: " << xid);
     try {
-        getWork(xid)->rollback();
+        find(xid)->rollback();
         remove(xid);
     } catch (DtxTimeoutException& e) {
         remove(xid);
@@ -89,47 +89,66 @@ void DtxManager::rollback(const std::string& xid)
     }
 }
 
-DtxWorkRecord* DtxManager::getWork(const std::string& xid)
+DtxManager::Shard& DtxManager::shardFor(const std::string& xid)
 {
-    Mutex::ScopedLock locker(lock);
-    WorkMap::iterator i = work.find(xid);
-    if (i == work.end()) {
+    return shards[boost::hash<std::string>()(xid) % SHARDS];
+}
+
+// The record is kept alive by the returned pointer, so it can be used
+// without holding the lock even if the branch is removed meanwhile.
+shared_ptr<DtxWorkRecord> DtxManager::find(const std::string& xid)
+{
+    Shard& shard = shardFor(xid);
+    Mutex::ScopedLock locker(shard.lock);
+    WorkMap::iterator i = shard.work.find(xid);
+    if (i == shard.work.end()) {
         throw NotFoundException(QPID_MSG("Unrecognised xid " << xid));
     }
-    return ptr_map_ptr(i);
+    return i->second;
+}
+
+DtxWorkRecord* DtxManager::getWork(const std::string& xid)
+{
+    return find(xid).get();
 }
 
 bool DtxManager::exists(const std::string& xid) {
-    Mutex::ScopedLock locker(lock);
-    return  work.find(xid) != work.end();
+    Shard& shard = shardFor(xid);
+    Mutex::ScopedLock locker(shard.lock);
+    return shard.work.find(xid) != shard.work.end();
 }
 
 void DtxManager::remove(const std::string& xid)
 {
-    Mutex::ScopedLock locker(lock);
-    WorkMap::iterator i = work.find(xid);
-    if (i == work.end()) {
+    shared_ptr<DtxWorkRecord> record;   // Destroyed after the lock is released
+    Shard& shard = shardFor(xid);
+    Mutex::ScopedLock locker(shard.lock);
+    WorkMap::iterator i = shard.work.find(xid);
+    if (i == shard.work.end()) {
         throw NotFoundException(QPID_MSG("Unrecognised xid " << xid));
     } else {
-        work.erase(i);
+        record = i->second;
+        shard.work.erase(i);
     }
 }
 
 DtxWorkRecord* DtxManager::createWork(const std::string& xid)
 {
-    Mutex::ScopedLock locker(lock);
-    WorkMap::iterator i = work.find(xid);
-    if (i != work.end()) {
+    Shard& shard = shardFor(xid);
+    Mutex::ScopedLock locker(shard.lock);
+    WorkMap::iterator i = shard.work.find(xid);
+    if (i != shard.work.end()) {
         throw NotAllowedException(QPID_MSG("Xid " << xid << " is already known (use 'join' to add work to an existing xid)"));
     } else {
-        std::string ncxid = xid; // Work around const correctness problems in ptr_map.
-        return ptr_map_ptr(work.insert(ncxid, new DtxWorkRecord(ncxid, store)).first);
+        shared_ptr<DtxWorkRecord> record(new DtxWorkRecord(xid, store));
+        shard.work[xid] = record;
+        return record.get();
     }
 }
 
 void DtxManager::setTimeout(const std::string& xid, uint32_t secs)
 {
-    DtxWorkRecord* record = getWork(xid);
+    shared_ptr<DtxWorkRecord> record = find(xid);
     intrusive_ptr<DtxTimeout> timeout = record->getTimeout();
     if (timeout.get()) {
         if (timeout->timeout == secs) return;//no need to do anything further if timeout hasn't changed
@@ -142,18 +161,26 @@ void DtxManager::setTimeout(const std::string& xid, uint32_t secs)
 
 uint32_t DtxManager::getTimeout(const std::string& xid)
 {
-    intrusive_ptr<DtxTimeout> timeout = getWork(xid)->getTimeout();
+    intrusive_ptr<DtxTimeout> timeout = find(xid)->getTimeout();
     return !timeout ? 0 : timeout->timeout;
 }
 
 void DtxManager::timedout(const std::string& xid)
 {
-    Mutex::ScopedLock locker(lock);
-    WorkMap::iterator i = work.find(xid);
-    if (i == work.end()) {
+    shared_ptr<DtxWorkRecord> record;
+    {
+        Shard& shard = shardFor(xid);
+        Mutex::ScopedLock locker(shard.lock);
+        WorkMap::iterator i = shard.work.find(xid);
+        if (i != shard.work.end())
+            record = i->second;
+    }
+    if (!record) {
         QPID_LOG(warning, "Transaction timeout failed: no record for xid");
     } else {
-        ptr_map_ptr(i)->timedout();
+        // The store abort is done without the lock, so other branches in
+        // the same table are not held up by it.
+        record->timedout();
         //TODO: do we want to have a timed task to cleanup, or can we rely on an explicit completion?
         //timer.add(intrusive_ptr<TimerTask>(new DtxCleanup(60*30/*30 mins*/, *this, xid)));
     }
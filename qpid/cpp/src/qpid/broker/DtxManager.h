@@ -21,19 +21,27 @@
 #ifndef _DtxManager_
 #define _DtxManager_
 
-#include <boost/ptr_container/ptr_map.hpp>
+#include <map>
+#include <boost/shared_ptr.hpp>
 #include "qpid/broker/DtxBuffer.h"
 #include "qpid/broker/DtxWorkRecord.h"
 #include "qpid/broker/TransactionalStore.h"
 #include "qpid/framing/amqp_types.h"
 #include "qpid/sys/Mutex.h"
-#include "qpid/ptr_map.h"
 
 namespace qpid {
 namespace broker {
 
 class DtxManager{
-    typedef boost::ptr_map<std::string, DtxWorkRecord> WorkMap;
+    typedef std::map<std::string, boost::shared_ptr<DtxWorkRecord> > WorkMap;
+
+    // Branches are spread over a fixed number of tables by xid, each with
+    // its own lock, so work on one branch does not hold up the others.
+    struct Shard {
+        WorkMap work;
+        qpid::sys::Mutex lock;
+    };
+    static const size_t SHARDS = 32;
 
     struct DtxCleanup : public sys::TimerTask
     {
@@ -44,11 +52,12 @@ class DtxManager{
         void fire();
     };
 
-    WorkMap work;
+    Shard shards[SHARDS];
     TransactionalStore* store;
-    qpid::sys::Mutex lock;
     qpid::sys::Timer* timer;
 
+    Shard& shardFor(const std::string& xid);
+    boost::shared_ptr<DtxWorkRecord> find(const std::string& xid);
     void remove(const std::string& xid);
     DtxWorkRecord* createWork(const std::string& xid);
 
@@ -69,8 +78,9 @@ public:
 
     // Used by cluster for replication.
     template<class F> void each(F f) const {
-        for (WorkMap::const_iterator i = work.begin(); i != work.end(); ++i)
-            f(*ptr_map_ptr(i));
+        for (size_t s = 0; s < SHARDS; ++s)
+            for (WorkMap::const_iterator i = shards[s].work.begin(); i != shards[s].work.end(); ++i)
+                f(*i->second);
     }
     DtxWorkRecord* getWork(const std::string& xid);
     bool exists(const std::string& xid);
@@ -0,0 +1,110 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "qpid/broker/DuplicateIndex.h"
+#include <boost/functional/hash.hpp>
+#include <algorithm>
+
+namespace qpid {
+namespace broker {
+
+namespace {
+// About ten bits an id, for a false positive rate near 1% when full
+uint64_t filterBits(size_t capacity)
+{
+    uint64_t bits = 1024;
+    while (bits < uint64_t(capacity) * 10) bits <<= 1;
+    return bits;
+}
+}
+
+DuplicateIndex::DuplicateIndex(size_t c, sys::Duration w)
+    : capacity(std::max(c, size_t(1))), window(w), current(0), rotated(sys::AbsTime::now()),
+      mask(filterBits(capacity) - 1)
+{
+    filters[0].resize((mask + 1) / 64);
+    filters[1].resize((mask + 1) / 64);
+}
+
+bool DuplicateIndex::inFilter(const Filter& filter, uint64_t h1, uint64_t h2) const
+{
+    for (size_t i = 0; i < HASHES; ++i) {
+        uint64_t bit = (h1 + i * h2) & mask;
+        if (!(filter[bit / 64] & (uint64_t(1) << (bit % 64)))) return false;
+    }
+    return true;
+}
+
+void DuplicateIndex::expire(sys::AbsTime now)
+{
+    if (sys::Duration(rotated, now) >= window) {
+        current ^= 1;
+        std::fill(filters[current].begin(), filters[current].end(), 0);
+        rotated = now;
+    }
+    while (!entries.empty() && sys::Duration(entries.back().time, now) >= window) {
+        index.erase(entries.back().id);
+        entries.pop_back();
+    }
+}
+
+DuplicateIndex::Result DuplicateIndex::check(const std::string& id, sys::AbsTime now)
+{
+    uint64_t h1 = boost::hash<std::string>()(id);
+    // Derive the second hash by mixing the first, odd so every probe differs
+    uint64_t h2 = ((h1 >> 32) ^ (h1 * 0x9e3779b97f4a7c15ULL)) | 1;
+
+    sys::Mutex::ScopedLock l(lock);
+    expire(now);
+    Result result = UNSEEN;
+    if (inFilter(filters[0], h1, h2) || inFilter(filters[1], h1, h2)) {
+        if (index.find(id) != index.end()) return DUPLICATE;
+        result = FALSE_POSITIVE;
+    }
+    Filter& filter = filters[current];
+    for (size_t i = 0; i < HASHES; ++i) {
+        uint64_t bit = (h1 + i * h2) & mask;
+        filter[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+    entries.push_front(Entry(id, now));
+    index[id] = entries.begin();
+    if (index.size() > capacity) {
+        index.erase(entries.back().id);
+        entries.pop_back();
+    }
+    return result;
+}
+
+void DuplicateIndex::forget(const std::string& id)
+{
+    sys::Mutex::ScopedLock l(lock);
+    Index::iterator i = index.find(id);
+    if (i == index.end()) return;
+    entries.erase(i->second);
+    index.erase(i);
+}
+
+size_t DuplicateIndex::size() const
+{
+    sys::Mutex::ScopedLock l(lock);
+    return index.size();
+}
+
+}} // namespace qpid::broker
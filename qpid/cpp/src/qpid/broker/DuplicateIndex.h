@@ -0,0 +1,100 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_BROKER_DUPLICATEINDEX_H
+#define QPID_BROKER_DUPLICATEINDEX_H
+
+#include "qpid/broker/BrokerImportExport.h"
+#include "qpid/sys/Mutex.h"
+#include "qpid/sys/Time.h"
+#include <boost/unordered_map.hpp>
+#include <list>
+#include <string>
+#include <vector>
+
+namespace qpid {
+namespace broker {
+
+/**
+ * Remembers the ids of recent messages so that a queue can drop those
+ * a producer sends again, e.g. when it replays after failing over.
+ *
+ * An id counts as a duplicate if it was seen less than the window ago
+ * and is still among the last capacity ids seen, so memory is bounded
+ * whatever the rate. Each id is first looked up in a bloom filter,
+ * which answers most checks of new ids without touching the exact
+ * index. The filter has two generations, swapped every window, so it
+ * forgets old ids rather than filling up.
+ *
+ * Only messages delivered outside a transaction are checked; a
+ * transactional publish is rolled back, not replayed, on failover.
+ */
+class DuplicateIndex
+{
+  public:
+    enum Result {
+        UNSEEN,             // Not in the filter
+        FALSE_POSITIVE,     // In the filter but not, or no longer, in the index
+        DUPLICATE
+    };
+
+    QPID_BROKER_EXTERN DuplicateIndex(size_t capacity, sys::Duration window);
+
+    /** Check @a id and record it if it is not a duplicate */
+    QPID_BROKER_EXTERN Result check(const std::string& id, sys::AbsTime now = sys::AbsTime::now());
+    /**
+     * Drop @a id, recorded by check() for a message that was then not
+     * enqueued, so that a resend of it is accepted. It stays in the
+     * filter, so the resend is counted as a false positive.
+     */
+    QPID_BROKER_EXTERN void forget(const std::string& id);
+
+    size_t getCapacity() const { return capacity; }
+    QPID_BROKER_EXTERN size_t size() const;
+
+  private:
+    struct Entry {
+        std::string id;
+        sys::AbsTime time;
+        Entry(const std::string& i, sys::AbsTime t) : id(i), time(t) {}
+    };
+    typedef std::list<Entry> Entries;       // Newest first
+    typedef boost::unordered_map<std::string, Entries::iterator> Index;
+    typedef std::vector<uint64_t> Filter;
+
+    static const size_t HASHES = 4;
+
+    mutable sys::Mutex lock;
+    const size_t capacity;
+    const sys::Duration window;
+    Entries entries;
+    Index index;
+    Filter filters[2];
+    size_t current;                 // Generation being added to
+    sys::AbsTime rotated;
+    const uint64_t mask;            // Filter bits - 1
+
+    bool inFilter(const Filter&, uint64_t h1, uint64_t h2) const;
+    void expire(sys::AbsTime now);
+};
+
+}} // namespace qpid::broker
+
+#endif  /*!QPID_BROKER_DUPLICATEINDEX_H*/
@@ -30,6 +30,8 @@
 #include "qpid/log/Statement.h"
 #include "qpid/management/ManagementAgent.h"
 #include "qpid/sys/ExceptionHolder.h"
+#include "qpid/sys/Probe.h"
+#include <boost/bind.hpp>
 #include <stdexcept>
 
 using namespace qpid::broker;
@@ -48,28 +50,34 @@ namespace
     const std::string qpidMsgSequence("qpid.msg_sequence");
     const std::string qpidSequenceCounter("qpid.sequence_counter");
     const std::string qpidIVE("qpid.ive");
+    const std::string qpidLatencyHistogram("qpid.latency_histogram");
     const std::string QPID_MANAGEMENT("qpid.management");
 }
 
 
 Exchange::PreRoute::PreRoute(Deliverable& msg, Exchange* _p):parent(_p) {
+    QPID_PROBE(message_routed, &msg.getMessage(), parent);
     if (parent){
-        if (parent->sequence || parent->ive) parent->sequenceLock.lock();
-
+        if (parent->routeLatency.get()) start = qpid::sys::AbsTime::now();
+        // Publishers take numbers without serialising on the exchange, so
+        // concurrently routed messages may reach a queue out of sequence
         if (parent->sequence){
-            parent->sequenceNo++;
-            msg.getMessage().insertCustomProperty(qpidMsgSequence,parent->sequenceNo);
+            msg.getMessage().insertCustomProperty(qpidMsgSequence, ++parent->sequenceNo);
         }
         if (parent->ive) {
+            parent->sequenceLock.lock();
             parent->lastMsg =  &( msg.getMessage());
         }
     }
 }
 
 Exchange::PreRoute::~PreRoute(){
-    if (parent && (parent->sequence || parent->ive)){
+    if (parent && parent->ive){
         parent->sequenceLock.unlock();
     }
+    if (parent && parent->routeLatency.get()) {
+        parent->routeLatency->record(qpid::sys::Duration(start, qpid::sys::AbsTime::now()));
+    }
 }
 
 namespace {
@@ -81,7 +89,7 @@ class  ExInfo {
   public:
     enum Type { NONE, SESSION, CONNECTION, OTHER };
 
-    ExInfo(string exchange) : type(NONE), exchange(exchange) {}
+    ExInfo(const string& exchange) : type(NONE), exchange(exchange) {}
     void store(Type type_, const qpid::sys::ExceptionHolder& exception_, const boost::shared_ptr<Queue>& queue) {
         QPID_LOG(warning, "Exchange " << exchange << " cannot deliver to  queue "
                  <<  queue->getName() << ": " << exception_.what());
@@ -97,12 +105,12 @@ class  ExInfo {
 
   private:
     Type type;
-    string exchange;
+    const string& exchange;     // Outlives the routing of a message, so need not be copied
     qpid::sys::ExceptionHolder exception;
 };
 }
 
-void Exchange::doRoute(Deliverable& msg, ConstBindingList b)
+void Exchange::doRoute(Deliverable& msg, const ConstBindingList& b)
 {
     int count = 0;
 
@@ -114,6 +122,8 @@ void Exchange::doRoute(Deliverable& msg, ConstBindingList b)
 
 
         ExInfo error(getName()); // Save exception to throw at the end.
+        bool batch = b->size() > 1;
+        if (batch) msg.beginBatch();
         for(std::vector<Binding::shared_ptr>::const_iterator i = b->begin(); i != b->end(); i++, count++) {
             try {
                 msg.deliverTo((*i)->queue);
@@ -130,6 +140,7 @@ void Exchange::doRoute(Deliverable& msg, ConstBindingList b)
                 error.store(ExInfo::OTHER, qpid::sys::ExceptionHolder(new Exception(e.what())), (*i)->queue);
             }
         }
+        if (batch) msg.endBatch();
         error.raise();
     }
 
@@ -197,7 +208,7 @@ Exchange::Exchange(const string& _name, bool _durable, const qpid::framing::Fiel
     sequence = _args.get(qpidMsgSequence);
     if (sequence) {
         QPID_LOG(debug, "Configured exchange " <<  _name  << " with Msg sequencing");
-        args.setInt64(std::string(qpidSequenceCounter), sequenceNo);
+        args.setInt64(std::string(qpidSequenceCounter), sequenceNo.get());
     }
 
     ive = _args.get(qpidIVE);
@@ -206,10 +217,21 @@ Exchange::Exchange(const string& _name, bool _durable, const qpid::framing::Fiel
             throw framing::NotImplementedException("Cannot use Initial Value Exchanges in a cluster");
         QPID_LOG(debug, "Configured exchange " <<  _name  << " with Initial Value");
     }
+
+    if (_args.get(qpidLatencyHistogram)) {
+        routeLatency.reset(new qpid::sys::LatencyHistogram);
+        if (mgmtExchange != 0) {
+            routeLatencyExport = new qpid::sys::LatencyHistogramExport(
+                *routeLatency, boost::bind(&_qmf::Exchange::set_routeLatency, mgmtExchange, _1), broker->getTimer());
+            broker->getTimer().add(routeLatencyExport);
+        }
+        QPID_LOG(debug, "Configured exchange " <<  _name  << " with a routing time histogram");
+    }
 }
 
 Exchange::~Exchange ()
 {
+    if (routeLatencyExport) routeLatencyExport->cancel();
     if (mgmtExchange != 0)
         mgmtExchange->resourceDestroy ();
 }
@@ -262,7 +284,7 @@ void Exchange::encode(Buffer& buffer) const
     buffer.putOctet(durable);
     buffer.putShortString(getType());
     if (args.isSet(qpidSequenceCounter))
-        args.setInt64(std::string(qpidSequenceCounter),sequenceNo);
+        args.setInt64(std::string(qpidSequenceCounter),sequenceNo.get());
     buffer.put(args);
     buffer.putShortString(alternate.get() ? alternate->getName() : string(""));
 }
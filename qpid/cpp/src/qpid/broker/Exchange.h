@@ -28,6 +28,8 @@
 #include "qpid/broker/MessageStore.h"
 #include "qpid/broker/PersistableExchange.h"
 #include "qpid/framing/FieldTable.h"
+#include "qpid/sys/AtomicValue.h"
+#include "qpid/sys/LatencyHistogram.h"
 #include "qpid/sys/Mutex.h"
 #include "qpid/management/Manageable.h"
 #include "qmf/org/apache/qpid/broker/Exchange.h"
@@ -70,10 +72,12 @@ private:
 protected:
     mutable qpid::framing::FieldTable args;
     bool sequence;
-    mutable qpid::sys::Mutex sequenceLock;
-    int64_t sequenceNo;
+    qpid::sys::AtomicValue<int64_t> sequenceNo;
+    mutable qpid::sys::Mutex sequenceLock;  // Held while routing on an initial value exchange
     bool ive;
     boost::intrusive_ptr<Message> lastMsg;
+    std::auto_ptr<qpid::sys::LatencyHistogram> routeLatency;
+    boost::intrusive_ptr<qpid::sys::TimerTask> routeLatencyExport;
 
     class PreRoute{
     public:
@@ -81,11 +85,12 @@ protected:
         ~PreRoute();
     private:
         Exchange* parent;
+        qpid::sys::AbsTime start;
     };
 
     typedef boost::shared_ptr<const std::vector<boost::shared_ptr<qpid::broker::Exchange::Binding> > > ConstBindingList;
     typedef boost::shared_ptr<      std::vector<boost::shared_ptr<qpid::broker::Exchange::Binding> > > BindingList;
-    void doRoute(Deliverable& msg, ConstBindingList b);
+    void doRoute(Deliverable& msg, const ConstBindingList& b);
     void routeIVE();
 
 
@@ -226,6 +231,15 @@ public:
      */
     void recoveryComplete(ExchangeRegistry& exchanges);
 
+    /**
+     * Bracket the addition of many bindings at once, e.g. on recovery.
+     * In between, an exchange may leave new bindings out of what
+     * route() reads and build that once in endBindingBatch(). Ending a
+     * batch that was not begun does nothing.
+     */
+    virtual void beginBindingBatch() {}
+    virtual void endBindingBatch() {}
+
     bool routeWithAlternate(Deliverable& message);
 
     void destroy() { destroyed = true; }
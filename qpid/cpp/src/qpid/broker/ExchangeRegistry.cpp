@@ -20,6 +20,7 @@
  */
 
 #include "qpid/broker/ExchangeRegistry.h"
+#include "qpid/broker/Broker.h"
 #include "qpid/broker/DirectExchange.h"
 #include "qpid/broker/FanOutExchange.h"
 #include "qpid/broker/HeadersExchange.h"
@@ -27,6 +28,7 @@
 #include "qpid/management/ManagementDirectExchange.h"
 #include "qpid/management/ManagementTopicExchange.h"
 #include "qpid/framing/reply_exceptions.h"
+#include <boost/functional/hash.hpp>
 
 using namespace qpid::broker;
 using namespace qpid::sys;
@@ -41,9 +43,13 @@ pair<Exchange::shared_ptr, bool> ExchangeRegistry::declare(const string& name, c
 
 pair<Exchange::shared_ptr, bool> ExchangeRegistry::declare(const string& name, const string& type,
                                                            bool durable, const FieldTable& args){
-    RWlock::ScopedWlock locker(lock);
-    ExchangeMap::iterator i =  exchanges.find(name);
-    if (i == exchanges.end()) {
+    // A module deferred by --module-on-demand may provide the type
+    if (broker && !isKnownType(type))
+        broker->loadModuleFor(boost::bind(&ExchangeRegistry::isKnownType, this, type));
+    Shard& shard = shardFor(name);
+    RWlock::ScopedWlock locker(shard.lock);
+    ExchangeMap::iterator i =  shard.exchanges.find(name);
+    if (i == shard.exchanges.end()) {
         Exchange::shared_ptr exchange;
 
         if (type == TopicExchange::typeName){
@@ -59,14 +65,17 @@ pair<Exchange::shared_ptr, bool> ExchangeRegistry::declare(const string& name, c
         }else if (type == ManagementTopicExchange::typeName) {
             exchange = Exchange::shared_ptr(new ManagementTopicExchange(name, durable, args, parent, broker));
         }else{
-            FunctionMap::iterator i =  factory.find(type);
-            if (i == factory.end()) {
-                throw UnknownExchangeTypeException();
-            } else {
-                exchange = i->second(name, durable, args, parent, broker);
+            FactoryFunction f;
+            {
+                RWlock::ScopedRlock l(factoryLock);
+                FunctionMap::const_iterator i =  factory.find(type);
+                if (i == factory.end())
+                    throw UnknownExchangeTypeException();
+                f = i->second;
             }
+            exchange = f(name, durable, args, parent, broker);
         }
-        exchanges[name] = exchange;
+        shard.exchanges[name] = exchange;
         return std::pair<Exchange::shared_ptr, bool>(exchange, true);
     } else {
         return std::pair<Exchange::shared_ptr, bool>(i->second, false);
@@ -79,31 +88,50 @@ void ExchangeRegistry::destroy(const string& name){
          (name == "amq.direct" || name == "amq.fanout" || name == "amq.topic" || name == "amq.match")) ||
         name == "qpid.management")
         throw framing::NotAllowedException(QPID_MSG("Cannot delete default exchange: '" << name << "'"));
-    RWlock::ScopedWlock locker(lock);
-    ExchangeMap::iterator i =  exchanges.find(name);
-    if (i != exchanges.end()) {
+    Shard& shard = shardFor(name);
+    RWlock::ScopedWlock locker(shard.lock);
+    ExchangeMap::iterator i =  shard.exchanges.find(name);
+    if (i != shard.exchanges.end()) {
         i->second->destroy();
-        exchanges.erase(i);
+        shard.exchanges.erase(i);
     }
 }
 
 Exchange::shared_ptr ExchangeRegistry::get(const string& name){
-    RWlock::ScopedRlock locker(lock);
-    ExchangeMap::iterator i =  exchanges.find(name);
-    if (i == exchanges.end())
+    Shard& shard = shardFor(name);
+    RWlock::ScopedRlock locker(shard.lock);
+    ExchangeMap::iterator i =  shard.exchanges.find(name);
+    if (i == shard.exchanges.end())
         throw framing::NotFoundException(QPID_MSG("Exchange not found: " << name));
     return i->second;
 }
 
 bool ExchangeRegistry::registerExchange(const Exchange::shared_ptr& ex) {
-    return exchanges.insert(ExchangeMap::value_type(ex->getName(), ex)).second;
+    Shard& shard = shardFor(ex->getName());
+    RWlock::ScopedWlock locker(shard.lock);
+    return shard.exchanges.insert(ExchangeMap::value_type(ex->getName(), ex)).second;
+}
+
+ExchangeRegistry::Shard& ExchangeRegistry::shardFor(const string& name) {
+    return shards[boost::hash<string>()(name) % SHARDS];
 }
 
 void ExchangeRegistry::registerType(const std::string& type, FactoryFunction f)
 {
+    RWlock::ScopedWlock l(factoryLock);
     factory[type] = f;
 }
 
+bool ExchangeRegistry::isKnownType(const std::string& type) const
+{
+    if (type == TopicExchange::typeName || type == DirectExchange::typeName ||
+        type == FanOutExchange::typeName || type == HeadersExchange::typeName ||
+        type == ManagementDirectExchange::typeName || type == ManagementTopicExchange::typeName)
+        return true;
+    RWlock::ScopedRlock l(factoryLock);
+    return factory.find(type) != factory.end();
+}
+
 
 namespace
 {
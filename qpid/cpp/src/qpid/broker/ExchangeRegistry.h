@@ -69,22 +69,37 @@ class ExchangeRegistry{
 
     QPID_BROKER_EXTERN void registerType(const std::string& type, FactoryFunction);
 
+    /** True if type is built in or registered by a plugin */
+    QPID_BROKER_EXTERN bool isKnownType(const std::string& type) const;
+
     /** Call f for each exchange in the registry. */
     template <class F> void eachExchange(F f) const {
-        qpid::sys::RWlock::ScopedRlock l(lock);
-        for (ExchangeMap::const_iterator i = exchanges.begin(); i != exchanges.end(); ++i)
-            f(i->second);
+        for (size_t s = 0; s < SHARDS; ++s) {
+            qpid::sys::RWlock::ScopedRlock l(shards[s].lock);
+            for (ExchangeMap::const_iterator i = shards[s].exchanges.begin(); i != shards[s].exchanges.end(); ++i)
+                f(i->second);
+        }
     }
         
   private:
     typedef std::map<std::string, Exchange::shared_ptr> ExchangeMap;
     typedef std::map<std::string, FactoryFunction > FunctionMap;
 
-    ExchangeMap exchanges;
+    // Exchanges are spread over a fixed number of tables by name, each
+    // with its own lock, as queues are in QueueRegistry.
+    struct Shard {
+        ExchangeMap exchanges;
+        mutable qpid::sys::RWlock lock;
+    };
+    static const size_t SHARDS = 16;
+
+    Shard shards[SHARDS];
     FunctionMap factory;
-    mutable qpid::sys::RWlock lock;
+    mutable qpid::sys::RWlock factoryLock;
     management::Manageable* parent;
     Broker* broker;
+
+    Shard& shardFor(const std::string& name);
 };
 
 }} // namespace qpid::broker
@@ -28,11 +28,11 @@ namespace broker {
 ExpiryPolicy::~ExpiryPolicy() {}
 
 bool ExpiryPolicy::hasExpired(Message& m) {
-    return m.getExpiration() < sys::AbsTime::now();
+    return m.getExpiration() < sys::AbsTime::coarseNow();
 }
 
 sys::AbsTime ExpiryPolicy::getCurrentTime() {
-    return sys::AbsTime::now();
+    return sys::AbsTime::coarseNow();
 }
 
 }} // namespace qpid::broker
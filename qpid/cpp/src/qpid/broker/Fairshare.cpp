@@ -82,13 +82,15 @@ bool Fairshare::setState(uint p, uint c)
     return true;
 }
 
-bool Fairshare::findFrontLevel(uint& p, PriorityLevels& messages)
+bool Fairshare::findFrontLevel(uint& p, PriorityLevels&)
 {
-    const uint start = p = currentLevel();
-    do {
-        if (!messages[p].empty()) return true;
-    } while ((p = nextLevel()) != start);
-    return false;
+    p = currentLevel();
+    if (isOccupied(p)) return true;
+    //go straight to the level that repeated calls to nextLevel() would reach
+    bool found = nextOccupiedLevel(p);
+    if (found) priority = p;
+    count = 1;
+    return found;
 }
 
 
@@ -44,9 +44,14 @@ bool FifoDistributor::allocate(const std::string&, const QueuedMessage& )
     return true;
 }
 
+bool FifoDistributor::canAllocate(const std::string&, const QueuedMessage& )
+{
+    return true;
+}
+
 bool FifoDistributor::nextBrowsableMessage( Consumer::shared_ptr& c, QueuedMessage& next )
 {
-    if (!messages.empty() && messages.next(c->position, next))
+    if (!messages.empty() && messages.browse(c->position, next, c->cursor))
         return true;
     return false;
 }
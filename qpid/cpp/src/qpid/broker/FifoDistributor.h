@@ -46,6 +46,7 @@ class FifoDistributor : public MessageDistributor
 
     bool nextConsumableMessage( Consumer::shared_ptr& consumer, QueuedMessage& next );
     bool allocate(const std::string& consumer, const QueuedMessage& target);
+    bool canAllocate(const std::string& consumer, const QueuedMessage& target);
     bool nextBrowsableMessage( Consumer::shared_ptr& consumer, QueuedMessage& next );
     void query(qpid::types::Variant::Map&) const;
 
@@ -19,6 +19,7 @@
  *
  */
 #include "qpid/broker/HeadersExchange.h"
+#include "qpid/framing/Buffer.h"
 #include "qpid/framing/FieldValue.h"
 #include "qpid/framing/reply_exceptions.h"
 #include "qpid/log/Statement.h"
@@ -30,10 +31,6 @@ using namespace qpid::framing;
 using namespace qpid::sys;
 namespace _qmf = qmf::org::apache::qpid::broker;
 
-// TODO aconway 2006-09-20: More efficient matching algorithm.
-// The current search algorithm really sucks.
-// Fieldtables are heavy, maybe use shared_ptr to do handle-body.
-
 using namespace qpid::broker;
 
 namespace {
@@ -55,7 +52,9 @@ namespace {
 }
 
 HeadersExchange::HeadersExchange(const string& _name, Manageable* _parent, Broker* b) :
-    Exchange(_name, _parent, b)
+    Exchange(_name, _parent, b),
+    index(new MatchIndex(Bindings::ConstPtr())),
+    batching(false)
 {
     if (mgmtExchange != 0)
         mgmtExchange->set_type (typeName);
@@ -63,7 +62,9 @@ HeadersExchange::HeadersExchange(const string& _name, Manageable* _parent, Broke
 
 HeadersExchange::HeadersExchange(const std::string& _name, bool _durable,
                                  const FieldTable& _args, Manageable* _parent, Broker* b) :
-    Exchange(_name, _durable, _args, _parent, b)
+    Exchange(_name, _durable, _args, _parent, b),
+    index(new MatchIndex(Bindings::ConstPtr())),
+    batching(false)
 {
     if (mgmtExchange != 0)
         mgmtExchange->set_type (typeName);
@@ -120,6 +121,7 @@ bool HeadersExchange::bind(Queue::shared_ptr queue, const string& bindingKey, co
             Binding::shared_ptr binding (new Binding (bindingKey, queue, this, extra_args));
             BoundKey bk(binding);
             if (bindings.add_unless(bk, MatchArgs(queue, &extra_args))) {
+                rebuildIndex();
                 binding->startManagement();
                 propagate = bk.fedBinding.addOrigin(queue->getName(), fedOrigin);
                 if (mgmtExchange != 0) {
@@ -175,6 +177,7 @@ bool HeadersExchange::unbind(Queue::shared_ptr queue, const string& bindingKey,
         propagate = modifier.shouldPropagate;
         if (modifier.shouldUnbind) {
             if (bindings.remove_if(match_key)) {
+                rebuildIndex();
                 if (mgmtExchange != 0) {
                     mgmtExchange->dec_bindingCount();
                 }
@@ -207,17 +210,42 @@ void HeadersExchange::route(Deliverable& msg, const string& /*routingKey*/, cons
     PreRoute pr(msg, this);
 
     BindingList b(new std::vector<boost::shared_ptr<qpid::broker::Exchange::Binding> >);
-    Bindings::ConstPtr p = bindings.snapshot();
-    if (p.get()) {
-        for (std::vector<BoundKey>::const_iterator i = p->begin(); i != p->end(); ++i) {
-            if (match((*i).binding->args, *args)) {
-                b->push_back((*i).binding);
-            }
-        }
+    boost::shared_ptr<const MatchIndex> current;
+    {
+        Mutex::ScopedLock l(indexLock);
+        current = index;
     }
+    current->route(*args, b);
     doRoute(msg, b);
 }
 
+void HeadersExchange::rebuildIndex()
+{
+    // Note: lock held by caller
+    if (!batching) buildIndex();
+}
+
+void HeadersExchange::buildIndex()
+{
+    boost::shared_ptr<const MatchIndex> rebuilt(new MatchIndex(bindings.snapshot()));
+    Mutex::ScopedLock l(indexLock);
+    index = rebuilt;
+}
+
+void HeadersExchange::beginBindingBatch()
+{
+    Mutex::ScopedLock l(lock);
+    batching = true;
+}
+
+void HeadersExchange::endBindingBatch()
+{
+    Mutex::ScopedLock l(lock);
+    if (!batching) return;
+    batching = false;
+    buildIndex();
+}
+
 
 bool HeadersExchange::isBound(Queue::shared_ptr queue, const string* const, const FieldTable* const args)
 {
@@ -263,6 +291,14 @@ namespace
         return  bind.getType() == 0xf0 || bind == msg;
     }
 
+    // Values are equal exactly when their encodings are
+    std::string encoded(FieldValue& value) {
+        std::string bytes(value.encodedSize(), '\0');
+        Buffer buffer(&bytes[0], bytes.size());
+        value.encode(buffer);
+        return bytes;
+    }
+
 }
 
 
@@ -314,6 +350,62 @@ bool HeadersExchange::equal(const FieldTable& a, const FieldTable& b) {
     return true;
 }
 
+//---------
+HeadersExchange::MatchIndex::MatchIndex(Bindings::ConstPtr p)
+{
+    if (!p.get()) return;
+    for (std::vector<BoundKey>::const_iterator i = p->begin(); i != p->end(); ++i) {
+        const FieldTable& args = i->binding->args;
+        std::string what = getMatch(&args);
+        if (what != all && what != any) continue;
+        Compiled c;
+        c.binding = i->binding;
+        c.any = what == any;
+        c.required = 0;
+        size_t n = compiled.size();
+        for (FieldTable::ValueMap::const_iterator j = args.begin(); j != args.end(); ++j) {
+            if (j->first == x_match) continue;
+            ++c.required;
+            HeaderIndex& h = headers[j->first];
+            if (!j->second || j->second->getType() == 0xf0)
+                h.present.push_back(n);
+            else
+                h.values[encoded(*j->second)].push_back(n);
+        }
+        if (c.required == 0 && !c.any)
+            unconditional.push_back(n);
+        compiled.push_back(c);
+    }
+}
+
+void HeadersExchange::MatchIndex::route(const FieldTable& args, BindingList& b) const
+{
+    std::map<size_t, size_t> hits; // binding -> headers matched
+    for (FieldTable::ValueMap::const_iterator i = args.begin(); i != args.end(); ++i) {
+        Headers::const_iterator h = headers.find(i->first);
+        if (h == headers.end()) continue;
+        for (std::vector<size_t>::const_iterator j = h->second.present.begin(); j != h->second.present.end(); ++j)
+            ++hits[*j];
+        if (i->second && !h->second.values.empty()) {
+            std::map<std::string, std::vector<size_t> >::const_iterator v = h->second.values.find(encoded(*i->second));
+            if (v != h->second.values.end()) {
+                for (std::vector<size_t>::const_iterator j = v->second.begin(); j != v->second.end(); ++j)
+                    ++hits[*j];
+            }
+        }
+    }
+    // Deliver in binding order, as a scan of the bindings would
+    std::vector<size_t> matched(unconditional);
+    for (std::map<size_t, size_t>::const_iterator i = hits.begin(); i != hits.end(); ++i) {
+        const Compiled& c = compiled[i->first];
+        if (c.any || i->second == c.required)
+            matched.push_back(i->first);
+    }
+    std::sort(matched.begin(), matched.end());
+    for (std::vector<size_t>::const_iterator i = matched.begin(); i != matched.end(); ++i)
+        b->push_back(compiled[*i].binding);
+}
+
 //---------
 HeadersExchange::MatchArgs::MatchArgs(Queue::shared_ptr q, const qpid::framing::FieldTable* a) : queue(q), args(a) {}
 
@@ -21,6 +21,7 @@
 #ifndef _HeadersExchange_
 #define _HeadersExchange_
 
+#include <map>
 #include <vector>
 #include "qpid/broker/BrokerImportExport.h"
 #include "qpid/broker/Exchange.h"
@@ -28,6 +29,7 @@
 #include "qpid/sys/CopyOnWriteArray.h"
 #include "qpid/sys/Mutex.h"
 #include "qpid/broker/Queue.h"
+#include <boost/shared_ptr.hpp>
 
 namespace qpid {
 namespace broker {
@@ -74,6 +76,40 @@ class HeadersExchange : public virtual Exchange {
     Bindings bindings;
     qpid::sys::Mutex lock;
 
+    // The bindings compiled into an index on the header names and
+    // values they match, so that the cost of routing depends on the
+    // headers in the message rather than on the number of bindings.
+    class MatchIndex
+    {
+      public:
+        MatchIndex(Bindings::ConstPtr bindings);
+        void route(const qpid::framing::FieldTable& headers, BindingList& b) const;
+
+      private:
+        struct Compiled
+        {
+            Binding::shared_ptr binding;
+            bool any;           // x-match any, otherwise all
+            size_t required;    // headers in the binding
+        };
+        struct HeaderIndex
+        {
+            std::vector<size_t> present;    // bindings matching any value
+            std::map<std::string, std::vector<size_t> > values; // by encoded value
+        };
+        typedef std::map<std::string, HeaderIndex> Headers;
+
+        std::vector<Compiled> compiled;
+        std::vector<size_t> unconditional; // x-match all with no headers
+        Headers headers;
+    };
+    boost::shared_ptr<const MatchIndex> index;
+    qpid::sys::Mutex indexLock; // guards only the index pointer
+    bool batching;  // index is not rebuilt until endBindingBatch()
+
+    void rebuildIndex();
+    void buildIndex();
+
     static std::string getMatch(const framing::FieldTable* args);
 
   protected:
@@ -109,6 +145,8 @@ class HeadersExchange : public virtual Exchange {
     QPID_BROKER_EXTERN virtual ~HeadersExchange();
 
     virtual bool supportsDynamicBinding() { return true; }
+    void beginBindingBatch();
+    void endBindingBatch();
 
     static QPID_BROKER_EXTERN bool match(const qpid::framing::FieldTable& bindArgs, const qpid::framing::FieldTable& msgArgs);
     static bool equal(const qpid::framing::FieldTable& bindArgs, const qpid::framing::FieldTable& msgArgs);
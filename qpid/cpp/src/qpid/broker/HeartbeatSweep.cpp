@@ -0,0 +1,105 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/broker/HeartbeatSweep.h"
+#include "qpid/broker/Connection.h"
+#include "qpid/log/Statement.h"
+
+namespace qpid {
+namespace broker {
+
+HeartbeatSweep::HeartbeatSweep() : ticks(0), timer(0) {}
+
+HeartbeatSweep::~HeartbeatSweep()
+{
+    stop();
+}
+
+void HeartbeatSweep::start(sys::Timer& t)
+{
+    timer = &t;
+    task = new Task(*this);
+    timer->add(task);
+}
+
+void HeartbeatSweep::stop()
+{
+    if (task) task->cancel();
+}
+
+HeartbeatSweep::Task::Task(HeartbeatSweep& p) : sys::TimerTask(sys::TIME_SEC, "HeartbeatSweep"), parent(p) {}
+
+void HeartbeatSweep::Task::fire()
+{
+    parent.tick();
+    setupNextFire();
+    parent.timer->add(this);
+}
+
+void HeartbeatSweep::add(Connection& connection, uint16_t interval)
+{
+    sys::Mutex::ScopedLock l(lock);
+    Entry& e = entries[&connection];
+    e.interval = interval;
+    e.due = ticks + interval;
+    e.idle = false;
+    slots[e.due % SLOTS].insert(&connection);
+}
+
+void HeartbeatSweep::remove(Connection& connection)
+{
+    sys::Mutex::ScopedLock l(lock);
+    // Leaves the connection in its slot, tick() drops it from there.
+    entries.erase(&connection);
+}
+
+void HeartbeatSweep::tick()
+{
+    sys::Mutex::ScopedLock l(lock);
+    uint32_t now = ++ticks;
+    Slot due;
+    due.swap(slots[now % SLOTS]);
+    // Connections remove themselves under lock before they are
+    // deleted, so those with an entry are safe to use here.
+    for (Slot::iterator i = due.begin(); i != due.end(); ++i) {
+        Entries::iterator j = entries.find(*i);
+        if (j == entries.end()) continue;
+        Entry& e = j->second;
+        if (e.due % SLOTS != now % SLOTS) continue; // Re-added since, to another slot
+        if (e.due != now) {                        // A later turn of the wheel
+            slots[now % SLOTS].insert(*i);
+            continue;
+        }
+        Connection* connection = *i;
+        bool idle = !connection->takeActivity();
+        if (idle && e.idle) {
+            entries.erase(j);
+            connection->timedOut();
+            continue;
+        }
+        e.idle = idle;
+        e.due = now + e.interval;
+        slots[e.due % SLOTS].insert(connection);
+        connection->sendHeartbeat();
+    }
+}
+
+}} // namespace qpid::broker
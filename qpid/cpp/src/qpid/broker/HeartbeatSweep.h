@@ -0,0 +1,96 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_BROKER_HEARTBEATSWEEP_H
+#define QPID_BROKER_HEARTBEATSWEEP_H
+
+#include "qpid/broker/BrokerImportExport.h"
+#include "qpid/sys/Mutex.h"
+#include "qpid/sys/Timer.h"
+#include <boost/intrusive_ptr.hpp>
+#include <map>
+#include <set>
+
+namespace qpid {
+namespace broker {
+
+class Connection;
+
+/**
+ * Heartbeats and liveness checks for all connections that negotiated
+ * a heartbeat, driven by a single timer task.
+ *
+ * Connections sit in a wheel of one second slots, each in the slot of
+ * its next check. Every second the task visits the slot that is due,
+ * sends those connections a heartbeat and closes any that received
+ * nothing since the check before last, i.e. for at least twice the
+ * interval. Receiving a frame only sets a flag on the connection, so
+ * the cost of a tick depends on how many connections are due, not on
+ * traffic.
+ */
+class HeartbeatSweep
+{
+  public:
+    QPID_BROKER_EXTERN HeartbeatSweep();
+    QPID_BROKER_EXTERN ~HeartbeatSweep();
+
+    QPID_BROKER_EXTERN void start(sys::Timer& timer);
+    QPID_BROKER_EXTERN void stop();
+
+    /** Check connection every interval seconds from now on */
+    QPID_BROKER_EXTERN void add(Connection& connection, uint16_t interval);
+    /** Forget connection, which must be called before it is deleted */
+    QPID_BROKER_EXTERN void remove(Connection& connection);
+
+    /** Check the connections in the next slot */
+    QPID_BROKER_EXTERN void tick();
+
+  private:
+    class Task : public sys::TimerTask
+    {
+      public:
+        Task(HeartbeatSweep& parent);
+        void fire();
+      private:
+        HeartbeatSweep& parent;
+    };
+
+    struct Entry {
+        uint16_t interval;
+        uint32_t due;           // Tick of the next check
+        bool idle;              // Nothing was received before the last check
+    };
+
+    static const uint32_t SLOTS = 64;
+
+    typedef std::map<Connection*, Entry> Entries;
+    typedef std::set<Connection*> Slot;
+
+    sys::Mutex lock;
+    Entries entries;
+    Slot slots[SLOTS];
+    uint32_t ticks;
+    sys::Timer* timer;
+    boost::intrusive_ptr<sys::TimerTask> task;
+};
+
+}} // namespace qpid::broker
+
+#endif  /*!QPID_BROKER_HEARTBEATSWEEP_H*/
@@ -34,9 +34,9 @@ void LegacyLVQ::setNoBrowse(bool b)
 
 bool LegacyLVQ::remove(const framing::SequenceNumber& position, QueuedMessage& message)
 {
-    Ordering::iterator i = messages.find(position);
-    if (i != messages.end() && i->second.payload == message.payload) {
-        message = i->second;
+    Ordering::iterator i = seek(position);
+    if (i != messages.end() && i->node->message.payload == message.payload) {
+        message = i->node->message;
         erase(i);
         return true;
     } else {
@@ -47,7 +47,17 @@ bool LegacyLVQ::remove(const framing::SequenceNumber& position, QueuedMessage& m
 bool LegacyLVQ::next(const framing::SequenceNumber& position, QueuedMessage& message)
 {
     if (MessageMap::next(position, message)) {
-        if (!noBrowse) index.erase(getKey(message));
+        if (!noBrowse) unindex(getKey(message));
+        return true;
+    } else {
+        return false;
+    }
+}
+
+bool LegacyLVQ::browse(const framing::SequenceNumber& position, QueuedMessage& message, size_t& cursor)
+{
+    if (MessageMap::browse(position, message, cursor)) {
+        if (!noBrowse) unindex(getKey(message));
         return true;
     } else {
         return false;
@@ -58,20 +68,19 @@ bool LegacyLVQ::push(const QueuedMessage& added, QueuedMessage& removed)
 {
     //Hack to disable LVQ behaviour on cluster update:
     if (broker && broker->isClusterUpdatee()) {
-        messages[added.position] = added;
+        append(added, false);
         return false;
     } else {
         return MessageMap::push(added, removed);
     }
 }
 
-const QueuedMessage& LegacyLVQ::replace(const QueuedMessage& original, const QueuedMessage& update)
+void LegacyLVQ::replace(Node& node, const QueuedMessage& update)
 { 
     //add the new message into the original position of the replaced message
-    Ordering::iterator i = messages.find(original.position);
-    i->second = update;
-    i->second.position = original.position;
-    return i->second;
+    framing::SequenceNumber position = node.message.position;
+    node.message = update;
+    node.message.position = position;
 }
 
 void LegacyLVQ::removeIf(Predicate p)
@@ -42,6 +42,7 @@ class LegacyLVQ : public MessageMap
     LegacyLVQ(const std::string& key, bool noBrowse = false, Broker* broker = 0);
     bool remove(const framing::SequenceNumber&, QueuedMessage&);
     bool next(const framing::SequenceNumber&, QueuedMessage&);
+    bool browse(const framing::SequenceNumber&, QueuedMessage&, size_t& cursor);
     bool push(const QueuedMessage& added, QueuedMessage& removed);
     void removeIf(Predicate);
     void setNoBrowse(bool);
@@ -52,7 +53,7 @@ class LegacyLVQ : public MessageMap
     bool noBrowse;
     Broker* broker;
 
-    const QueuedMessage& replace(const QueuedMessage&, const QueuedMessage&);
+    void replace(Node&, const QueuedMessage&);
 };
 }} // namespace qpid::broker
 
@@ -23,9 +23,11 @@
 #include "qpid/broker/LinkRegistry.h"
 #include "qpid/broker/Broker.h"
 #include "qpid/broker/Connection.h"
+#include "qpid/broker/SessionState.h"
 #include "qmf/org/apache/qpid/broker/EventBrokerLinkUp.h"
 #include "qmf/org/apache/qpid/broker/EventBrokerLinkDown.h"
 #include "boost/bind.hpp"
+#include "boost/functional/hash.hpp"
 #include "qpid/log/Statement.h"
 #include "qpid/framing/enum.h"
 #include "qpid/framing/reply_exceptions.h"
@@ -55,7 +57,8 @@ Link::Link(LinkRegistry*  _links,
            string&        _username,
            string&        _password,
            Broker*        _broker,
-           Manageable*    parent)
+           Manageable*    parent,
+           Link*          _primary)
     : links(_links), store(_store), host(_host), port(_port),
       transport(_transport),
       durable(_durable),
@@ -67,7 +70,8 @@ Link::Link(LinkRegistry*  _links,
       updateUrls(false),
       channelCounter(1),
       connection(0),
-      agent(0)
+      agent(0),
+      primary(_primary)
 {
     if (parent != 0 && broker != 0)
     {
@@ -79,6 +83,13 @@ Link::Link(LinkRegistry*  _links,
         }
     }
     setStateLH(STATE_WAITING);
+
+    if (!primary && broker) {
+        for (uint32_t i = 1; i < broker->getOptions().federationLinkStreams; ++i)
+            streams.push_back(Link::shared_ptr(new Link(links, 0, _host, _port, _transport, false,
+                                                        _authMechanism, _username, _password,
+                                                        broker, 0, this)));
+    }
 }
 
 Link::~Link ()
@@ -185,8 +196,15 @@ void Link::destroy ()
         Mutex::ScopedLock mutex(lock);
 
         QPID_LOG (info, "Inter-broker link to " << host << ":" << port << " removed by management");
-        if (connection)
-            connection->close(CLOSE_CODE_CONNECTION_FORCED, "closed by management");
+        if (connection) {
+            // A stream is destroyed from the IO thread of its primary's connection
+            if (primary)
+                connection->requestIOProcessing(boost::bind(&Connection::close, connection,
+                                                            CLOSE_CODE_CONNECTION_FORCED,
+                                                            string("closed by management")));
+            else
+                connection->close(CLOSE_CODE_CONNECTION_FORCED, "closed by management");
+        }
 
         setStateLH(STATE_CLOSED);
 
@@ -206,7 +224,10 @@ void Link::destroy ()
     for (Bridges::iterator i = toDelete.begin(); i != toDelete.end(); i++)
         (*i)->destroy();
     toDelete.clear();
-    links->destroy (host, port);
+    for (Streams::iterator i = streams.begin(); i != streams.end(); ++i)
+        (*i)->destroy();
+    if (!primary)
+        links->destroy (host, port);
 }
 
 void Link::add(Bridge::shared_ptr bridge)
@@ -238,6 +259,38 @@ void Link::cancel(Bridge::shared_ptr bridge)
     if (!cancellations.empty()) {
         connection->requestIOProcessing (boost::bind(&Link::ioThreadProcessing, this));
     }
+    for (Streams::iterator i = streams.begin(); i != streams.end(); ++i)
+        (*i)->cancel(bridge);
+}
+
+Link* Link::select(const std::string& bridgeKey)
+{
+    // Keep a bridge on the same stream across restarts so its messages
+    // stay in order.
+    size_t n = boost::hash<std::string>()(bridgeKey) % (streams.size() + 1);
+    return n ? streams[n - 1].get() : this;
+}
+
+bool Link::isConnecting()
+{
+    Mutex::ScopedLock mutex(lock);
+    return state == STATE_CONNECTING;
+}
+
+Link* Link::connecting()
+{
+    for (Streams::iterator i = streams.begin(); i != streams.end(); ++i)
+        if ((*i)->isConnecting()) return i->get();
+    return this;
+}
+
+Link* Link::streamFor(Connection* c)
+{
+    for (Streams::iterator i = streams.begin(); i != streams.end(); ++i) {
+        Mutex::ScopedLock mutex((*i)->lock);
+        if ((*i)->connection == c) return i->get();
+    }
+    return this;
 }
 
 void Link::ioThreadProcessing()
@@ -266,6 +319,8 @@ void Link::ioThreadProcessing()
         for (Bridges::iterator i = created.begin(); i != created.end(); ++i) {
             active.push_back(*i);
             (*i)->create(*connection);
+            SessionState* session = connection->getChannel((*i)->getChannelId()).getSession();
+            if (session) session->setBridge(*i);
         }
         created.clear();
     }
@@ -277,6 +332,16 @@ void Link::ioThreadProcessing()
     }
 }
 
+void Link::forwarded(uint64_t bytes)
+{
+    if (primary) {
+        primary->forwarded(bytes);
+    } else if (mgmtObject) {
+        mgmtObject->inc_msgsForwarded();
+        mgmtObject->inc_bytesForwarded(bytes);
+    }
+}
+
 void Link::setConnection(Connection* c)
 {
     Mutex::ScopedLock mutex(lock);
@@ -285,6 +350,18 @@ void Link::setConnection(Connection* c)
 }
 
 void Link::maintenanceVisit ()
+{
+    // Streams connect one at a time so that LinkRegistry can tell which
+    // of them a new connection belongs to.
+    bool pending = false;
+    for (Streams::iterator i = streams.begin(); i != streams.end(); ++i)
+        pending = (*i)->isConnecting() || pending;
+    pending = visit(!pending) || pending;
+    for (Streams::iterator i = streams.begin(); i != streams.end(); ++i)
+        pending = (*i)->visit(!pending) || pending;
+}
+
+bool Link::visit(bool mayConnect)
 {
     Mutex::ScopedLock mutex(lock);
 
@@ -294,7 +371,7 @@ void Link::maintenanceVisit ()
         updateUrls = false;
     }
 
-    if (state == STATE_WAITING)
+    if (state == STATE_WAITING && mayConnect)
     {
         visitCount++;
         if (visitCount >= currentInterval)
@@ -311,6 +388,7 @@ void Link::maintenanceVisit ()
     }
     else if (state == STATE_OPERATIONAL && (!active.empty() || !created.empty() || !cancellations.empty()) && connection != 0)
         connection->requestIOProcessing (boost::bind(&Link::ioThreadProcessing, this));
+    return state == STATE_CONNECTING;
 }
 
 void Link::reconnect(const qpid::Address& a)
@@ -325,11 +403,20 @@ void Link::reconnect(const qpid::Address& a)
         errorString << "Failed over to " << a;
         mgmtObject->set_lastError(errorString.str());
     }
+    // Streams follow on their next connection attempt
+    for (Streams::iterator i = streams.begin(); i != streams.end(); ++i) {
+        Mutex::ScopedLock l((*i)->lock);
+        (*i)->host = host;
+        (*i)->port = port;
+        (*i)->transport = transport;
+    }
 }
 
 bool Link::tryFailover()
 {
     Address next;
+    if (primary)
+        return false;   // Streams fail over with their primary
     if (urls.next(next) &&
         (next.host != host || next.port != port || next.protocol != transport)) {
         links->changeAddress(Address(transport, host, port), next);
@@ -348,6 +435,10 @@ bool Link::hideManagement() const {
 
 uint Link::nextChannel()
 {
+    // Bridge queue names on the peer are made from the channel, so
+    // streams share their primary's counter.
+    if (primary)
+        return primary->nextChannel();
     Mutex::ScopedLock mutex(lock);
 
     return channelCounter++;
@@ -418,6 +509,8 @@ uint32_t Link::encodedSize() const
 
 ManagementObject* Link::GetManagementObject (void) const
 {
+    if (primary)
+        return primary->GetManagementObject();
     return (ManagementObject*) mgmtObject;
 }
 
@@ -474,14 +567,18 @@ Manageable::status_t Link::ManagementMethod (uint32_t op, Args& args, string& te
 
 void Link::setPassive(bool passive)
 {
-    Mutex::ScopedLock mutex(lock);
-    if (passive) {
-        setStateLH(STATE_PASSIVE);
-    } else {
-        if (state == STATE_PASSIVE) {
-            setStateLH(STATE_WAITING);
+    {
+        Mutex::ScopedLock mutex(lock);
+        if (passive) {
+            setStateLH(STATE_PASSIVE);
         } else {
-            QPID_LOG(warning, "Ignoring attempt to activate non-passive link");
+            if (state == STATE_PASSIVE) {
+                setStateLH(STATE_WAITING);
+            } else {
+                QPID_LOG(warning, "Ignoring attempt to activate non-passive link");
+            }
         }
     }
+    for (Streams::iterator i = streams.begin(); i != streams.end(); ++i)
+        (*i)->setPassive(passive);
 }
@@ -71,6 +71,13 @@ namespace qpid {
             Connection* connection;
             management::ManagementAgent* agent;
 
+            // Extra connections to the same peer, opened when
+            // federation-link-streams is above 1. Each bridge is given
+            // to one of the streams (or this link) for its lifetime.
+            typedef std::vector<boost::shared_ptr<Link> > Streams;
+            Streams streams;
+            Link* primary;     // The link owning this stream, 0 if this is not a stream
+
             static const int STATE_WAITING     = 1;
             static const int STATE_CONNECTING  = 2;
             static const int STATE_OPERATIONAL = 3;
@@ -82,6 +89,8 @@ namespace qpid {
 
             void setStateLH (int newState);
             void startConnectionLH();        // Start the IO Connection
+            bool visit(bool mayConnect);     // Maintenance for this link or stream alone
+            bool isConnecting();
             void destroy();                  // Called when mgmt deletes this link
             void ioThreadProcessing();       // Called on connection's IO thread by request
             bool tryFailover();              // Called during maintenance visit
@@ -100,7 +109,8 @@ namespace qpid {
                  std::string&       username,
                  std::string&       password,
                  Broker*       broker,
-                 management::Manageable* parent = 0);
+                 management::Manageable* parent = 0,
+                 Link*         primary = 0);
             virtual ~Link();
 
             std::string getHost() { return host; }
@@ -110,6 +120,9 @@ namespace qpid {
             uint nextChannel();
             void add(Bridge::shared_ptr);
             void cancel(Bridge::shared_ptr);
+            Link* select(const std::string& bridgeKey); // The stream to carry a new bridge
+            Link* connecting();              // The stream a new connection belongs to
+            Link* streamFor(Connection*);    // The stream using a connection
 
             void established();              // Called when connection is created
             void closed(int, std::string);   // Called when connection goes away
@@ -121,6 +134,7 @@ namespace qpid {
             std::string getPassword()      { return password; }
             Broker* getBroker()       { return broker; }
 
+            void forwarded(uint64_t bytes);  // Called by bridges for each message
             void notifyConnectionForced(const std::string text);
             void setPassive(bool p);
 
@@ -193,12 +193,13 @@ pair<Bridge::shared_ptr, bool> LinkRegistry::declare(std::string& host,
         args.i_dynamic    = dynamic;
         args.i_sync       = sync;
 
+        Link* link = l->second->select(bridgeKey);
         bridge = Bridge::shared_ptr
-            (new Bridge (l->second.get(), l->second->nextChannel(),
+            (new Bridge (link, link->nextChannel(),
                          boost::bind(&LinkRegistry::destroy, this,
                                      host, port, src, dest, key), args));
         bridges[bridgeKey] = bridge;
-        l->second->add(bridge);
+        link->add(bridge);
         return std::pair<Bridge::shared_ptr, bool>(bridge, true);
     }
     return std::pair<Bridge::shared_ptr, bool>(b->second, false);
@@ -276,25 +277,26 @@ void LinkRegistry::notifyConnection(const std::string& key, Connection* c)
 {
     Link::shared_ptr link = findLink(key);
     if (link) {
-        link->established();
-        link->setConnection(c);
-        c->setUserId(str(format("%1%@%2%") % link->getUsername() % realm));
+        Link* stream = link->connecting();
+        stream->established();
+        stream->setConnection(c);
+        c->setUserId(str(format("%1%@%2%") % stream->getUsername() % realm));
     }
 }
 
-void LinkRegistry::notifyClosed(const std::string& key)
+void LinkRegistry::notifyClosed(const std::string& key, Connection* c)
 {
     Link::shared_ptr link = findLink(key);
     if (link) {
-        link->closed(0, "Closed by peer");
+        link->streamFor(c)->closed(0, "Closed by peer");
     }
 }
 
-void LinkRegistry::notifyConnectionForced(const std::string& key, const std::string& text)
+void LinkRegistry::notifyConnectionForced(const std::string& key, Connection* c, const std::string& text)
 {
     Link::shared_ptr link = findLink(key);
     if (link) {
-        link->notifyConnectionForced(text);
+        link->streamFor(c)->notifyConnectionForced(text);
     }
 }
 
@@ -128,8 +128,8 @@ namespace broker {
         MessageStore* getStore() const;
 
         void notifyConnection (const std::string& key, Connection* c);
-        void notifyClosed     (const std::string& key);
-        void notifyConnectionForced    (const std::string& key, const std::string& text);
+        void notifyClosed     (const std::string& key, Connection* c);
+        void notifyConnectionForced    (const std::string& key, Connection* c, const std::string& text);
         std::string getAuthMechanism   (const std::string& key);
         std::string getAuthCredentials (const std::string& key);
         std::string getAuthIdentity    (const std::string& key);
@@ -0,0 +1,196 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/broker/MemoryAccountant.h"
+#include "qpid/broker/Broker.h"
+#include "qpid/broker/Message.h"
+#include "qpid/broker/Queue.h"
+#include "qpid/broker/QueuedMessage.h"
+#include "qpid/amqp_0_10/Connection.h"
+#include "qpid/sys/AsynchIOHandler.h"
+#include "qpid/log/Statement.h"
+#include "qmf/org/apache/qpid/broker/Broker.h"
+#include <boost/bind.hpp>
+
+namespace qpid {
+namespace broker {
+
+namespace _qmf = qmf::org::apache::qpid::broker;
+
+MemoryAccountant::MemoryAccountant(Broker* b, uint64_t stop, uint64_t resume)
+    : broker(b), stopSize(stop), resumeSize(resume && resume < stop ? resume : stop),
+      flowStoppedCount(0), reportedCount(0), timer(0)
+{
+    if (stopSize)
+        QPID_LOG(info, "Broker memory flow control: stop at " << stopSize << " bytes, resume at " << resumeSize << " bytes");
+}
+
+MemoryAccountant::~MemoryAccountant()
+{
+    stop();
+    sys::Mutex::ScopedLock l(lock);
+    release(pending);
+}
+
+void MemoryAccountant::start(sys::Timer& t, sys::Duration period)
+{
+    timer = &t;
+    task = new Task(*this, period);
+    timer->add(task);
+}
+
+void MemoryAccountant::stop()
+{
+    if (task) task->cancel();
+}
+
+MemoryAccountant::Task::Task(MemoryAccountant& p, sys::Duration d) : sys::TimerTask(d, "MemoryAccountant"), parent(p) {}
+
+void MemoryAccountant::Task::fire()
+{
+    parent.sample();
+    setupNextFire();
+    parent.timer->add(this);
+}
+
+void MemoryAccountant::enqueued(const QueuedMessage& msg)
+{
+    if (msg.payload->addAccountedQueue() == 1)
+        messageBytes += msg.payload->contentSize();
+    if (!stopSize) return;
+    if (!isFlowStopped()) checkStop();
+    if (isFlowStopped() && !(broker && broker->isClusterUpdatee())) {
+        sys::Mutex::ScopedLock l(lock);
+        // Checked again under the lock as checkResume() may have released pending messages since
+        if (!isFlowStopped()) return;
+        msg.payload->getIngressCompletion().startCompleter();    // don't complete until flow resumes
+        boost::intrusive_ptr<Message>& held = pending[Key(msg.queue, msg.position)];
+        if (held) held->getIngressCompletion().finishCompleter();   // left by a deleted queue
+        held = msg.payload;
+    }
+}
+
+void MemoryAccountant::dequeued(const QueuedMessage& msg)
+{
+    remove(msg);
+    if (!stopSize) return;
+    if (isFlowStopped()) {
+        sys::Mutex::ScopedLock l(lock);
+        // A message leaving its queue cannot be held any longer
+        Pending::iterator i = pending.find(Key(msg.queue, msg.position));
+        if (i != pending.end()) {
+            i->second->getIngressCompletion().finishCompleter();
+            pending.erase(i);
+        }
+    }
+    checkResume();
+}
+
+void MemoryAccountant::queueDeleted(Queue& queue)
+{
+    queue.eachMessage(boost::bind(&MemoryAccountant::remove, this, _1));
+    if (!stopSize) return;
+    Pending released;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        for (Pending::iterator i = pending.begin(); i != pending.end();) {
+            if (i->first.first == &queue) {
+                released.insert(*i);
+                pending.erase(i++);
+            } else {
+                ++i;
+            }
+        }
+    }
+    release(released);
+    checkResume();
+}
+
+// The content is counted until the message leaves the last of its queues
+void MemoryAccountant::remove(const QueuedMessage& msg)
+{
+    if (msg.payload->removeAccountedQueue() != 0) return;
+    uint64_t size = msg.payload->contentSize();
+    if (messageBytes.fetchAndSub(size) < size) {
+        messageBytes += size;
+        QPID_LOG(error, "Broker memory accounting underflow on dequeue from " << msg.queue);
+    }
+}
+
+void MemoryAccountant::checkStop()
+{
+    if (getTotal() <= stopSize) return;
+    sys::Mutex::ScopedLock l(lock);
+    if (isFlowStopped()) return;
+    flowStopped.boolCompareAndSwap(0, 1);
+    ++flowStoppedCount;
+    QPID_LOG(notice, "Broker memory use of " << getTotal() << " bytes has reached " << stopSize
+             << " (messages " << getMessageBytes() << ", IO buffers " << getIoBytes()
+             << ", output " << getOutputBytes() << "). Producer flow control activated.");
+}
+
+void MemoryAccountant::checkResume()
+{
+    if (!isFlowStopped() || getTotal() >= resumeSize) return;
+    Pending released;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        if (!isFlowStopped()) return;
+        flowStopped.boolCompareAndSwap(1, 0);
+        released.swap(pending);
+    }
+    QPID_LOG(notice, "Broker memory use has fallen below " << resumeSize << " bytes. Producer flow control deactivated.");
+    release(released);
+}
+
+void MemoryAccountant::release(Pending& messages)
+{
+    for (Pending::iterator i = messages.begin(); i != messages.end(); ++i) {
+        try {
+            i->second->getIngressCompletion().finishCompleter();
+        } catch (...) {}
+    }
+    messages.clear();
+}
+
+void MemoryAccountant::sample()
+{
+    sys::AsynchIOHandler::BufferPoolStats stats;
+    sys::AsynchIOHandler::getBufferPoolStats(stats);
+    ioBytes = stats.bytesAllocated;
+    outputBytes = amqp_0_10::Connection::getTotalBuffered();
+    if (stopSize) {
+        if (isFlowStopped()) checkResume();
+        else checkStop();
+    }
+
+    _qmf::Broker* mgmtObject = broker ? static_cast<_qmf::Broker*>(broker->GetManagementObject()) : 0;
+    if (mgmtObject) {
+        sys::Mutex::ScopedLock l(lock);
+        mgmtObject->set_msgMemory(getMessageBytes());
+        mgmtObject->set_outputMemory(getOutputBytes());
+        mgmtObject->set_memoryFlowStopped(isFlowStopped());
+        mgmtObject->inc_memoryFlowStoppedCount(flowStoppedCount - reportedCount);
+        reportedCount = flowStoppedCount;
+    }
+}
+
+}} // namespace qpid::broker
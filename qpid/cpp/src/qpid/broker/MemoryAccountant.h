@@ -0,0 +1,121 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_BROKER_MEMORYACCOUNTANT_H
+#define QPID_BROKER_MEMORYACCOUNTANT_H
+
+#include "qpid/broker/BrokerImportExport.h"
+#include "qpid/broker/QueueObserver.h"
+#include "qpid/framing/SequenceNumber.h"
+#include "qpid/sys/AtomicValue.h"
+#include "qpid/sys/Mutex.h"
+#include "qpid/sys/Timer.h"
+#include <boost/intrusive_ptr.hpp>
+#include <map>
+
+namespace qpid {
+namespace broker {
+
+class Broker;
+class Message;
+class Queue;
+
+/**
+ * Broker wide view of the memory held by messages on queues, IO
+ * buffers and frames waiting to be written to connections.
+ *
+ * Observes every queue. When the total passes the stop size, newly
+ * enqueued messages have their completion withheld, as QueueFlowLimit
+ * does for a single queue, so producers run out of credit. They are
+ * completed once the total falls below the resume size.
+ *
+ * Message bytes are counted on every enqueue and dequeue, once for
+ * each message however many queues it is on. The IO
+ * buffer and output backlog figures are sampled periodically, as
+ * reading them takes locks.
+ */
+class MemoryAccountant : public QueueObserver
+{
+  public:
+    /** A stopSize of 0 disables flow control, the totals are still kept */
+    QPID_BROKER_EXTERN MemoryAccountant(Broker* broker, uint64_t stopSize, uint64_t resumeSize);
+    QPID_BROKER_EXTERN ~MemoryAccountant();
+
+    /** Begin sampling IO and output memory every period */
+    QPID_BROKER_EXTERN void start(sys::Timer& timer, sys::Duration period);
+    QPID_BROKER_EXTERN void stop();
+
+    QPID_BROKER_EXTERN void enqueued(const QueuedMessage&);
+    QPID_BROKER_EXTERN void dequeued(const QueuedMessage&);
+    void acquired(const QueuedMessage&) {}
+    void requeued(const QueuedMessage&) {}
+
+    /**
+     * The messages left on a deleted queue are never dequeued: releases
+     * them, along with any of the queue's messages still held.
+     */
+    QPID_BROKER_EXTERN void queueDeleted(Queue& queue);
+
+    uint64_t getMessageBytes() const { return messageBytes.get(); }
+    uint64_t getIoBytes() const { return ioBytes.get(); }
+    uint64_t getOutputBytes() const { return outputBytes.get(); }
+    uint64_t getTotal() const { return getMessageBytes() + getIoBytes() + getOutputBytes(); }
+    bool isFlowStopped() const { return flowStopped.get(); }
+
+    /** Sample IO and output memory and update management */
+    QPID_BROKER_EXTERN void sample();
+
+  private:
+    class Task : public sys::TimerTask
+    {
+      public:
+        Task(MemoryAccountant& parent, sys::Duration period);
+        void fire();
+      private:
+        MemoryAccountant& parent;
+    };
+
+    typedef std::pair<const Queue*, framing::SequenceNumber> Key;
+    typedef std::map<Key, boost::intrusive_ptr<Message> > Pending;
+
+    Broker* broker;
+    const uint64_t stopSize;
+    const uint64_t resumeSize;
+    sys::AtomicValue<uint64_t> messageBytes;
+    sys::AtomicValue<uint64_t> ioBytes;
+    sys::AtomicValue<uint64_t> outputBytes;
+    sys::AtomicValue<uint32_t> flowStopped;
+
+    sys::Mutex lock;
+    Pending pending;            // Messages whose completion is withheld
+    uint32_t flowStoppedCount;
+    uint32_t reportedCount;     // Part of flowStoppedCount passed to management
+    sys::Timer* timer;
+    boost::intrusive_ptr<sys::TimerTask> task;
+
+    void checkStop();
+    void checkResume();
+    void remove(const QueuedMessage&);
+    void release(Pending& messages);
+};
+
+}} // namespace qpid::broker
+
+#endif  /*!QPID_BROKER_MEMORYACCOUNTANT_H*/
@@ -21,8 +21,8 @@
 
 #include "qpid/broker/Message.h"
 #include "qpid/broker/Queue.h"
-#include "qpid/broker/ExchangeRegistry.h"
 #include "qpid/broker/ExpiryPolicy.h"
+#include "qpid/broker/MessageStore.h"
 #include "qpid/StringUtils.h"
 #include "qpid/framing/frame_functors.h"
 #include "qpid/framing/FieldTable.h"
@@ -32,7 +32,9 @@
 #include "qpid/framing/TypeFilter.h"
 #include "qpid/framing/reply_exceptions.h"
 #include "qpid/log/Statement.h"
+#include "qpid/sys/StripedLocks.h"
 
+#include <limits>
 #include <time.h>
 
 using boost::intrusive_ptr;
@@ -48,15 +50,30 @@ namespace broker {
 
 TransferAdapter Message::TRANSFER;
 
+namespace {
+sys::StripedLocks<sys::Monitor> callbackLocks;
+}
+
 Message::Message(const framing::SequenceNumber& id) :
-    frames(id), persistenceId(0), redelivered(false), loaded(false),
-    staged(false), forcePersistentPolicy(false), publisher(0), adapter(0),
-    expiration(FAR_FUTURE), dequeueCallback(0),
-    inCallback(false), requiredCredit(0), isManagementMessage(false), copyHeaderOnWrite(false)
+    frames(id), persistenceId(0), publisher(0), expiration(FAR_FUTURE), enqueueTime(0),
+    accountedQueues(0),
+    requiredCredit(0), redelivered(false), loaded(false), staged(false),
+    forcePersistentPolicy(false), isManagementMessage(false), copyHeaderOnWrite(false)
 {}
 
 Message::~Message() {}
 
+Message::Extras& Message::getExtras()
+{
+    if (!extras.get()) extras.reset(new Extras);
+    return *extras;
+}
+
+sys::Monitor& Message::callbackLock() const
+{
+    return callbackLocks.get(this);
+}
+
 void Message::forcePersistent()
 {
     sys::Mutex::ScopedLock l(lock);
@@ -81,14 +98,6 @@ std::string Message::getExchangeName() const
     return getAdapter().getExchange(frames);
 }
 
-const boost::shared_ptr<Exchange> Message::getExchange(ExchangeRegistry& registry) const
-{
-    if (!exchange) {
-        exchange = registry.get(getExchangeName());
-    }
-    return exchange;
-}
-
 bool Message::isImmediate() const
 {
     return getAdapter().isImmediate(frames);
@@ -129,36 +138,51 @@ uint32_t Message::getRequiredCredit()
     return requiredCredit;
 }
 
+// The frame walks below hold the lock, as spillContent() and
+// releaseContent() may remove content frames meanwhile. It is recursive,
+// so a store may encode the message while releaseContent() stages it.
 void Message::encode(framing::Buffer& buffer) const
 {
+    sys::Mutex::ScopedLock l(lock);
     //encode method and header frames
     EncodeFrame f1(buffer);
     frames.map_if(f1, TypeFilter2<METHOD_BODY, HEADER_BODY>());
 
     //then encode the payload of each content frame
-    framing::EncodeBody f2(buffer);
-    frames.map_if(f2, TypeFilter<CONTENT_BODY>());
+    encodeContent(buffer);
 }
 
 void Message::encodeContent(framing::Buffer& buffer) const
 {
-    //encode the payload of each content frame
-    EncodeBody f2(buffer);
-    frames.map_if(f2, TypeFilter<CONTENT_BODY>());
+    ContentSpill::ExtentPtr content;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        if (extras.get()) content = extras->spilled;
+        if (!content) {
+            //encode the payload of each content frame
+            EncodeBody f2(buffer);
+            frames.map_if(f2, TypeFilter<CONTENT_BODY>());
+            return;
+        }
+    }
+    content->encode(buffer);
 }
 
 uint32_t Message::encodedSize() const
 {
+    sys::Mutex::ScopedLock l(lock);
     return encodedHeaderSize() + encodedContentSize();
 }
 
 uint32_t Message::encodedContentSize() const
 {
+    sys::Mutex::ScopedLock l(lock);
     return  frames.getContentSize();
 }
 
 uint32_t Message::encodedHeaderSize() const
 {
+    sys::Mutex::ScopedLock l(lock);
     //add up the size for all method and header frames in the frameset
     SumFrameSize sum;
     frames.map_if(sum, TypeFilter2<METHOD_BODY, HEADER_BODY>());
@@ -218,14 +242,89 @@ void Message::releaseContent()
             store->stage(pmsg);
             staged = true;
         }
-        //ensure required credit is cached before content frames are released
+        //ensure required credit and content size are cached before content frames are released
         getRequiredCredit();
+        contentSize();
         //remove any content frames from the frameset
         frames.remove(TypeFilter<CONTENT_BODY>());
         setContentReleased();
     }
 }
 
+bool Message::spillContent(ContentSpill& spill)
+{
+    //ensure required credit and content size are cached before content frames are removed
+    getRequiredCredit();
+    contentSize();
+    sys::Mutex::ScopedLock l(lock);
+    if (hasSpilled() || staged || isContentReleased() || getPersistenceId() || !frames.isComplete()) return false;
+    std::string content;
+    frames.getContent(content);
+    if (content.empty()) return false;
+    getExtras().spilled = spill.write(content);
+    frames.remove(TypeFilter<CONTENT_BODY>());
+    return true;
+}
+
+void Message::setSpilledContent(const ContentSpill::ExtentPtr& content)
+{
+    sys::Mutex::ScopedLock l(lock);
+    getExtras().spilled = content;
+    //there are no content frames to add up, count the spilled content instead
+    frames.setContentSize(content->getSize());
+    SumBodySize sum;
+    frames.map_if(sum, TypeFilter<HEADER_BODY>());
+    requiredCredit = sum.getSize() + content->getSize();
+}
+
+void Message::restoreContent()
+{
+    sys::Mutex::ScopedLock l(lock);
+    if (!hasSpilled()) return;
+    AMQFrame frame((AMQContentBody()));
+    extras->spilled->read(frame.castBody<AMQContentBody>()->getData());
+    frame.setFirstSegment(false);
+    frames.append(frame);
+    extras->spilled.reset();
+}
+
+bool Message::isContentSpilled() const
+{
+    sys::Mutex::ScopedLock l(lock);
+    return hasSpilled();
+}
+
+bool Message::isContentInStore() const
+{
+    sys::Mutex::ScopedLock l(lock);
+    return isContentReleased() && !frames.isComplete();
+}
+
+void Message::prefetchContent(const Queue& queue)
+{
+    uint64_t size;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        if (!store || !isContentReleased() || frames.isComplete()) return;
+        size = contentSize();
+    }
+    //the store reads at most 4GB at a time, leave anything bigger to delivery
+    if (!size || size > std::numeric_limits<uint32_t>::max()) return;
+    AMQFrame frame((AMQContentBody()));
+    intrusive_ptr<const PersistableMessage> pmsg(this);
+    std::string& data = frame.castBody<AMQContentBody>()->getData();
+    store->loadContent(queue, pmsg, data, 0, size);
+    if (data.size() != size) {
+        QPID_LOG(warning, "Prefetched " << data.size() << " bytes of content for a message of "
+                 << size << " bytes, leaving it to be loaded on delivery");
+        return;
+    }
+    frame.setFirstSegment(false);
+    sys::Mutex::ScopedLock l(lock);
+    //delivery may have released it again, or another prefetch got there first
+    if (isContentReleased() && !frames.isComplete()) frames.append(frame);
+}
+
 void Message::destroy()
 {
     if (staged) {
@@ -270,6 +369,16 @@ void Message::sendContent(const Queue& queue, framing::FrameHandler& out, uint16
             morecontent = getContentFrame(queue, frame, maxContentSize, offset);
             out.handle(frame);
         }
+    } else if (hasSpilled()) {
+        //not read back ahead of delivery, send it from the spill a frame at a time
+        uint16_t maxContentSize = maxFrameSize - AMQFrame::frameOverhead();
+        const ContentSpill::Extent& content = *extras->spilled;
+        SendContent f(out, maxFrameSize, (content.getSize() + maxContentSize - 1) / maxContentSize);
+        for (size_t offset = 0; offset < content.getSize(); offset += maxContentSize) {
+            AMQFrame frame((AMQContentBody()));
+            content.read(frame.castBody<AMQContentBody>()->getData(), offset, maxContentSize);
+            f(frame);
+        }
     } else {
         Count c;
         frames.map_if(c, TypeFilter<CONTENT_BODY>());
@@ -282,6 +391,12 @@ void Message::sendContent(const Queue& queue, framing::FrameHandler& out, uint16
 void Message::sendHeader(framing::FrameHandler& out, uint16_t /*maxFrameSize*/) const
 {
     sys::Mutex::ScopedLock l(lock);
+    //encode the message properties once for every consumer the body
+    //is sent to, and for the copies made when delivery properties
+    //change; only while the body is still ours alone, as the handlers
+    //encode it without the lock
+    const AMQHeaderBody* header = frames.getHeaders();
+    if (header && !copyHeaderOnWrite) header->cacheEncoding();
     Relay f(out);
     frames.map_if(f, TypeFilter<HEADER_BODY>());
     //as frame (and pointer to body) has now been passed to handler,
@@ -293,16 +408,13 @@ void Message::sendHeader(framing::FrameHandler& out, uint16_t /*maxFrameSize*/)
 // 0-8/0-9 message differences.
 MessageAdapter& Message::getAdapter() const
 {
-    if (!adapter) {
-        if(frames.isA<MessageTransferBody>()) {
-            adapter = &TRANSFER;
-        } else {
-            const AMQMethodBody* method = frames.getMethod();
-            if (!method) throw Exception("Can't adapt message with no method");
-            else throw Exception(QPID_MSG("Can't adapt message based on " << *method));
-        }
+    if (frames.isA<MessageTransferBody>()) {
+        return TRANSFER;
+    } else {
+        const AMQMethodBody* method = frames.getMethod();
+        if (!method) throw Exception("Can't adapt message with no method");
+        else throw Exception(QPID_MSG("Can't adapt message based on " << *method));
     }
-    return *adapter;
 }
 
 uint64_t Message::contentSize() const
@@ -411,14 +523,17 @@ void Message::computeExpiration(const boost::intrusive_ptr<ExpiryPolicy>& e)
 void Message::adjustTtl()
 {
     sys::Mutex::ScopedLock l(lock);
-    DeliveryProperties* props = getModifiableProperties<DeliveryProperties>();
-    if (props->getTtl()) {
+    const DeliveryProperties* props = getProperties<DeliveryProperties>();
+    if (props && props->getTtl()) {
         if (expiration < FAR_FUTURE) {
             sys::AbsTime current(
-                expiryPolicy ? expiryPolicy->getCurrentTime() : sys::AbsTime::now());
+                expiryPolicy ? expiryPolicy->getCurrentTime() : sys::AbsTime::coarseNow());
             sys::Duration ttl(current, getExpiration());
             // convert from ns to ms; set to 1 if expired
-            props->setTtl(int64_t(ttl) >= 1000000 ? int64_t(ttl)/1000000 : 1);
+            uint64_t remaining = int64_t(ttl) >= 1000000 ? int64_t(ttl)/1000000 : 1;
+            // only copy a header already sent if the ttl has changed
+            if (remaining != props->getTtl())
+                getModifiableProperties<DeliveryProperties>()->setTtl(remaining);
         }
     }
 }
@@ -426,7 +541,9 @@ void Message::adjustTtl()
 void Message::setRedelivered()
 {
     sys::Mutex::ScopedLock l(lock);
-    getModifiableProperties<framing::DeliveryProperties>()->setRedelivered(true);
+    const DeliveryProperties* props = getProperties<DeliveryProperties>();
+    if (!props || !props->getRedelivered())
+        getModifiableProperties<framing::DeliveryProperties>()->setRedelivered(true);
 }
 
 void Message::insertCustomProperty(const std::string& key, int64_t value)
@@ -453,6 +570,12 @@ void Message::setExchange(const std::string& exchange)
     getModifiableProperties<DeliveryProperties>()->setExchange(exchange);
 }
 
+void Message::setReplyTo(const framing::ReplyTo& replyTo)
+{
+    sys::Mutex::ScopedLock l(lock);
+    getModifiableProperties<MessageProperties>()->setReplyTo(replyTo);
+}
+
 void Message::clearApplicationHeadersFlag()
 {
     sys::Mutex::ScopedLock l(lock);
@@ -485,21 +608,40 @@ struct ScopedSet {
 }
 
 void Message::allDequeuesComplete() {
-    ScopedSet ss(callbackLock, inCallback);
-    MessageCallback* cb = dequeueCallback;
+    Extras* x;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        x = extras.get();
+    }
+    if (!x) return;             // No callback was ever set
+    ScopedSet ss(callbackLock(), x->inCallback);
+    MessageCallback* cb = x->dequeueCallback;
     if (cb && *cb) (*cb)(intrusive_ptr<Message>(this));
 }
 
 void Message::setDequeueCompleteCallback(MessageCallback& cb) {
-    sys::Mutex::ScopedLock l(callbackLock);
-    while (inCallback) callbackLock.wait();
-    dequeueCallback = &cb;
+    Extras* x;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        x = &getExtras();
+    }
+    sys::Monitor& m = callbackLock();
+    sys::Mutex::ScopedLock l(m);
+    while (x->inCallback) m.wait();
+    x->dequeueCallback = &cb;
 }
 
 void Message::resetDequeueCompleteCallback() {
-    sys::Mutex::ScopedLock l(callbackLock);
-    while (inCallback) callbackLock.wait();
-    dequeueCallback = 0;
+    Extras* x;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        x = extras.get();
+    }
+    if (!x) return;
+    sys::Monitor& m = callbackLock();
+    sys::Mutex::ScopedLock l(m);
+    while (x->inCallback) m.wait();
+    x->dequeueCallback = 0;
 }
 
 uint8_t Message::getPriority() const {
@@ -23,9 +23,12 @@
  */
 
 #include "qpid/broker/BrokerImportExport.h"
+#include "qpid/broker/ContentSpill.h"
 #include "qpid/broker/PersistableMessage.h"
 #include "qpid/broker/MessageAdapter.h"
 #include "qpid/framing/amqp_types.h"
+#include "qpid/MemoryPool.h"
+#include "qpid/sys/AtomicValue.h"
 #include "qpid/sys/Monitor.h"
 #include "qpid/sys/Time.h"
 #include <boost/function.hpp>
@@ -41,6 +44,7 @@ namespace framing {
 class AMQBody;
 class AMQHeaderBody;
 class FieldTable;
+class ReplyTo;
 class SequenceNumber;
 }
 
@@ -52,7 +56,7 @@ class MessageStore;
 class Queue;
 class ExpiryPolicy;
 
-class Message : public PersistableMessage {
+class Message : public PersistableMessage, public PoolAllocated {
 public:
     typedef boost::function<void (const boost::intrusive_ptr<Message>&)> MessageCallback;
 
@@ -73,7 +77,6 @@ public:
     QPID_BROKER_EXTERN uint64_t contentSize() const;
 
     QPID_BROKER_EXTERN std::string getRoutingKey() const;
-    const boost::shared_ptr<Exchange> getExchange(ExchangeRegistry&) const;
     QPID_BROKER_EXTERN std::string getExchangeName() const;
     bool isImmediate() const;
     QPID_BROKER_EXTERN const framing::FieldTable* getApplicationHeaders() const;
@@ -88,14 +91,27 @@ public:
     sys::AbsTime getExpiration() const { return expiration; }
     void setExpiration(sys::AbsTime exp) { expiration = exp; }
     void adjustTtl();
-    void setRedelivered();
+    QPID_BROKER_EXTERN void setRedelivered();
     QPID_BROKER_EXTERN void insertCustomProperty(const std::string& key, int64_t value);
     QPID_BROKER_EXTERN void insertCustomProperty(const std::string& key, const std::string& value);
     QPID_BROKER_EXTERN void removeCustomProperty(const std::string& key);
     void setExchange(const std::string&);
+    void setReplyTo(const framing::ReplyTo&);
     void clearApplicationHeadersFlag();
     /** set the timestamp delivery property to the current time-of-day */
     QPID_BROKER_EXTERN void setTimestamp();
+    /** Note @a now as the time the message was enqueued, unless a time has been noted already */
+    void setEnqueueTime(sys::AbsTime now) { enqueueTime.boolCompareAndSwap(0, sys::Duration(sys::EPOCH, now)); }
+    /** Time from the noted enqueue time to @a now; 0 if none has been noted */
+    sys::Duration timeSinceEnqueued(sys::AbsTime now) const {
+        int64_t t = enqueueTime.get();
+        return t ? sys::Duration(sys::EPOCH, now) - t : 0;
+    }
+    /** Counts the queues MemoryAccountant has seen the message enqueued
+     * on, so that its content is counted once however many there are.
+     * Each returns the new count. */
+    uint32_t addAccountedQueue() { return ++accountedQueues; }
+    uint32_t removeAccountedQueue() { return --accountedQueues; }
 
     framing::FrameSet& getFrames() { return frames; }
     const framing::FrameSet& getFrames() const { return frames; }
@@ -153,9 +169,25 @@ public:
     void releaseContent(MessageStore* s);//deprecated, use 'setStore(store); releaseContent();' instead
     void destroy();
 
+    /**
+     * Move the content into @a spill, keeping the headers. Does
+     * nothing, returning false, if the content has already been
+     * released or staged, or the message has been stored.
+     */
+    QPID_BROKER_EXTERN bool spillContent(ContentSpill& spill);
+    /** Take content that was written to the spill as it was received */
+    QPID_BROKER_EXTERN void setSpilledContent(const ContentSpill::ExtentPtr& content);
+    /** Read spilled content back into memory */
+    QPID_BROKER_EXTERN void restoreContent();
+    QPID_BROKER_EXTERN bool isContentSpilled() const;
+    /** True if the content was released and has not been read back from the store */
+    QPID_BROKER_EXTERN bool isContentInStore() const;
+    /** Read released content back from the store in a single read, ahead of delivery */
+    QPID_BROKER_EXTERN void prefetchContent(const Queue& queue);
+
     bool getContentFrame(const Queue& queue, framing::AMQFrame& frame, uint16_t maxContentSize, uint64_t offset) const;
     QPID_BROKER_EXTERN void sendContent(const Queue& queue, framing::FrameHandler& out, uint16_t maxFrameSize) const;
-    void sendHeader(framing::FrameHandler& out, uint16_t maxFrameSize) const;
+    QPID_BROKER_EXTERN void sendHeader(framing::FrameHandler& out, uint16_t maxFrameSize) const;
 
     QPID_BROKER_EXTERN bool isContentLoaded() const;
 
@@ -173,33 +205,47 @@ public:
     bool getIsManagementMessage() const;
     void setIsManagementMessage(bool b);
   private:
+    /**
+     * State few messages need, kept apart so that it costs the others
+     * only a pointer. Created under lock and kept until the message is
+     * destroyed.
+     */
+    struct Extras {
+        ContentSpill::ExtentPtr spilled;    // Content while it is out of memory
+        MessageCallback* dequeueCallback;
+        bool inCallback;
+        Extras() : dequeueCallback(0), inCallback(false) {}
+    };
+
     MessageAdapter& getAdapter() const;
     void allDequeuesComplete();
+    /** Expects lock to be held */
+    Extras& getExtras();
+    /** Expects lock to be held */
+    bool hasSpilled() const { return extras.get() && extras->spilled; }
+    /** Shared with other messages; guards the dequeue callback */
+    sys::Monitor& callbackLock() const;
 
     mutable sys::Mutex lock;
     framing::FrameSet frames;
-    mutable boost::shared_ptr<Exchange> exchange;
     mutable uint64_t persistenceId;
-    bool redelivered;
-    bool loaded;
-    bool staged;
-    bool forcePersistentPolicy; // used to force message as durable, via a broker policy
     ConnectionToken* publisher;
-    mutable MessageAdapter* adapter;
     qpid::sys::AbsTime expiration;
     boost::intrusive_ptr<ExpiryPolicy> expiryPolicy;
+    sys::AtomicValue<int64_t> enqueueTime; // Nanoseconds since the epoch, 0 if none
+    sys::AtomicValue<uint32_t> accountedQueues;
+    std::auto_ptr<Extras> extras;
 
     static TransferAdapter TRANSFER;
 
-    mutable boost::intrusive_ptr<Message> empty;
-
-    sys::Monitor callbackLock;
-    MessageCallback* dequeueCallback;
-    bool inCallback;
-
     uint32_t requiredCredit;
+    // Flags kept together so they pack into the padding after requiredCredit
+    bool redelivered;
+    bool loaded;
+    bool staged;
+    bool forcePersistentPolicy; // used to force message as durable, via a broker policy
     bool isManagementMessage;
-      mutable bool copyHeaderOnWrite;
+    mutable bool copyHeaderOnWrite;
 
     /**
      * Expects lock to be held
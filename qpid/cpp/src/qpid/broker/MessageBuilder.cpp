@@ -24,7 +24,12 @@
 #include "qpid/broker/MessageStore.h"
 #include "qpid/broker/NullMessageStore.h"
 #include "qpid/framing/AMQFrame.h"
+#include "qpid/framing/MessageProperties.h"
 #include "qpid/framing/reply_exceptions.h"
+#include "qpid/log/Statement.h"
+#include "qpid/sys/AllocationCounts.h"
+#include "qpid/sys/Probe.h"
+#include <limits>
 
 using boost::intrusive_ptr;
 using namespace qpid::broker;
@@ -36,11 +41,12 @@ namespace
     const std::string QPID_MANAGEMENT("qpid.management");
 }
 
-MessageBuilder::MessageBuilder(MessageStore* const _store) :
-    state(DORMANT), store(_store) {}
+MessageBuilder::MessageBuilder(MessageStore* const _store, ContentSpill* _spill, uint64_t _spillSize) :
+    state(DORMANT), store(_store), spill(_spill), spillSize(_spillSize), spilledBytes(0) {}
 
 void MessageBuilder::handle(AMQFrame& frame)
 {
+    QPID_ALLOCATION_SITE(message);
     uint8_t type = frame.getBody()->type();
     switch(state) {
     case METHOD:
@@ -68,20 +74,79 @@ void MessageBuilder::handle(AMQFrame& frame)
     default:
         throw CommandInvalidException(QPID_MSG("Invalid frame sequence for message (state=" << state << ")"));
     }
-    message->getFrames().append(frame);
+    if (spilled && type == CONTENT_BODY) {
+        spillFrame(frame);
+    } else {
+        message->getFrames().append(frame);
+        if (type == HEADER_BODY) reserveSpill();
+    }
+    if (frame.getEof() && frame.getEos()) {
+        if (spilled) {
+            if (spilledBytes == spilled->getSize()) message->setSpilledContent(spilled);
+            else unspill(true);
+        }
+        QPID_PROBE(message_received, message.get(), message->getFrames().getContentSize());
+        QPID_ALLOCATION_MESSAGE();
+    }
 }
 
 void MessageBuilder::end()
 {
     message = 0;
     state = DORMANT;
+    spilled.reset();
+    spilledBytes = 0;
+}
+
+void MessageBuilder::reserveSpill()
+{
+    if (!spill || !spillSize) return;
+    const MessageProperties* properties = message->getFrames().getHeaderProperties<MessageProperties>();
+    if (!properties || !properties->hasContentLength()) return;
+    uint64_t length = properties->getContentLength();
+    if (length <= spillSize || length > std::numeric_limits<size_t>::max() || message->isPersistent()) return;
+    try {
+        spilled = spill->reserve(length);
+    } catch (const std::exception& e) {
+        QPID_LOG(warning, "Holding content of " << length << " bytes in memory, could not spill it: " << e.what());
+    }
+}
+
+void MessageBuilder::spillFrame(AMQFrame& frame)
+{
+    const std::string& data = frame.castBody<AMQContentBody>()->getData();
+    if (data.size() > spilled->getSize() - spilledBytes) {
+        //more content than the header declared, keep it all in frames
+        unspill(false);
+        message->getFrames().append(frame);
+    } else {
+        spilled->fill(spilledBytes, data.data(), data.size());
+        spilledBytes += data.size();
+    }
+}
+
+void MessageBuilder::unspill(bool last)
+{
+    AMQFrame frame((AMQContentBody()));
+    std::string& data = frame.castBody<AMQContentBody>()->getData();
+    spilled->read(data);
+    data.resize(spilledBytes);
+    frame.setFirstSegment(false);
+    frame.setLastSegment(last);
+    frame.setLastFrame(last);
+    message->getFrames().append(frame);
+    spilled.reset();
+    spilledBytes = 0;
 }
 
 void MessageBuilder::start(const SequenceNumber& id)
 {
+    QPID_ALLOCATION_SITE(message);
     message = intrusive_ptr<Message>(new Message(id));
     message->setStore(store);
     state = METHOD;
+    spilled.reset();
+    spilledBytes = 0;
 }
 
 namespace {
@@ -22,6 +22,7 @@
 #define _MessageBuilder_
 
 #include "qpid/broker/BrokerImportExport.h"
+#include "qpid/broker/ContentSpill.h"
 #include "qpid/framing/FrameHandler.h"
 #include "qpid/framing/SequenceNumber.h"
 #include "qpid/RefCounted.h"
@@ -35,7 +36,14 @@ namespace qpid {
 
         class QPID_BROKER_CLASS_EXTERN MessageBuilder : public framing::FrameHandler{
         public:
-            QPID_BROKER_EXTERN MessageBuilder(MessageStore* const store);
+            /**
+             * If @a spill is given, the content of non-persistent
+             * messages declaring more than @a spillSize bytes of
+             * content is written to it as it arrives instead of being
+             * held in frames.
+             */
+            QPID_BROKER_EXTERN MessageBuilder(MessageStore* const store,
+                                              ContentSpill* spill = 0, uint64_t spillSize = 0);
             QPID_BROKER_EXTERN void handle(framing::AMQFrame& frame);
             boost::intrusive_ptr<Message> getMessage() { return message; }
             QPID_BROKER_EXTERN void start(const framing::SequenceNumber& id);
@@ -45,8 +53,15 @@ namespace qpid {
             State state;
             boost::intrusive_ptr<Message> message;
             MessageStore* const store;
+            ContentSpill* const spill;
+            const uint64_t spillSize;
+            ContentSpill::ExtentPtr spilled;
+            size_t spilledBytes;
 
             void checkType(uint8_t expected, uint8_t actual);
+            void reserveSpill();
+            void spillFrame(framing::AMQFrame& frame);
+            void unspill(bool last);
         };
     }
 }
@@ -24,6 +24,8 @@
 namespace qpid {
 namespace broker {
 
+MessageDeque::MessageDeque() : popped(0) {}
+
 size_t MessageDeque::size()
 {
     return messages.size();
@@ -57,7 +59,10 @@ bool MessageDeque::find(const framing::SequenceNumber& position, QueuedMessage&
     Deque::iterator i = seek(position);
     if (i != messages.end() && i->position == position) {
         message = *i;
-        if (remove) messages.erase(i);
+        if (remove) {
+            if (i == messages.begin()) ++popped;
+            messages.erase(i);
+        }
         return true;
     } else {
         return false;
@@ -92,6 +97,26 @@ bool MessageDeque::next(const framing::SequenceNumber& position, QueuedMessage&
     }
 }
 
+bool MessageDeque::browse(const framing::SequenceNumber& position, QueuedMessage& message, size_t& cursor)
+{
+    // The cursor is one past the last message browsed, counting from
+    // the first message ever held. Use it if it still follows position.
+    size_t i = cursor > popped ? cursor - popped : 0;
+    if (i > messages.size() ||
+        (i > 0 && position < messages[i-1].position) ||
+        (i < messages.size() && messages[i].position <= position)) {
+        i = messages.empty() ? 0 : seek(position+1) - messages.begin();
+    }
+    if (i < messages.size()) {
+        message = messages[i];
+        cursor = popped + i + 1;
+        return true;
+    } else {
+        cursor = popped + i;
+        return false;
+    }
+}
+
 QueuedMessage& MessageDeque::front()
 {
     return messages.front();
@@ -101,6 +126,7 @@ void MessageDeque::pop()
 {
     if (!messages.empty()) {
         messages.pop_front();
+        ++popped;
     }
 }
 
@@ -111,6 +137,7 @@ bool MessageDeque::pop(QueuedMessage& out)
     } else {
         out = front();
         messages.pop_front();
+        ++popped;
         return true;
     }
 }
@@ -121,20 +148,36 @@ bool MessageDeque::push(const QueuedMessage& added, QueuedMessage& /*not needed*
     return false;//adding a message never causes one to be removed for deque
 }
 
+void MessageDeque::append(const std::deque<QueuedMessage>& added, std::deque<QueuedMessage>& /*not needed*/)
+{
+    messages.insert(messages.end(), added.begin(), added.end());
+}
+
 void MessageDeque::foreach(Functor f)
 {
     std::for_each(messages.begin(), messages.end(), f);
 }
 
+/**
+ * One pass whatever is removed: a leading run is dropped from the front
+ * as pop() would, and the messages kept after it are shifted down over
+ * any later gaps, rather than erased from the middle one at a time.
+ */
 void MessageDeque::removeIf(Predicate p)
 {
-    for (Deque::iterator i = messages.begin(); i != messages.end();) {
-        if (p(*i)) {
-            i = messages.erase(i);
-        } else {
-            ++i;
+    size_t size = messages.size();
+    size_t run = 0;
+    while (run < size && p(messages[run])) ++run;
+    size_t kept = run < size ? run + 1 : size;
+    for (size_t i = kept; i < size; ++i) {
+        if (!p(messages[i])) {
+            if (i != kept) messages[kept] = messages[i];
+            ++kept;
         }
     }
+    messages.erase(messages.begin() + kept, messages.end());
+    messages.erase(messages.begin(), messages.begin() + run);
+    popped += run;
 }
 
 }} // namespace qpid::broker
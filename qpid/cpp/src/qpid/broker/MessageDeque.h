@@ -34,6 +34,7 @@ namespace broker {
 class MessageDeque : public Messages
 {
   public:
+    MessageDeque();
     size_t size();
     bool empty();
 
@@ -41,11 +42,13 @@ class MessageDeque : public Messages
     bool remove(const framing::SequenceNumber&, QueuedMessage&);
     bool find(const framing::SequenceNumber&, QueuedMessage&);
     bool next(const framing::SequenceNumber&, QueuedMessage&);
+    bool browse(const framing::SequenceNumber&, QueuedMessage&, size_t& cursor);
 
     QueuedMessage& front();
     void pop();
     bool pop(QueuedMessage&);
     bool push(const QueuedMessage& added, QueuedMessage& removed);
+    void append(const std::deque<QueuedMessage>& added, std::deque<QueuedMessage>& removed);
 
     void foreach(Functor);
     void removeIf(Predicate);
@@ -53,6 +56,9 @@ class MessageDeque : public Messages
   private:
     typedef std::deque<QueuedMessage> Deque;
     Deque messages;
+    // Messages ever taken from the front, so that a browse cursor
+    // counted from the first message stays valid as the queue drains
+    size_t popped;
 
     Deque::iterator seek(const framing::SequenceNumber&);
     bool find(const framing::SequenceNumber&, QueuedMessage&, bool remove);
@@ -59,6 +59,12 @@ class MessageDistributor
     virtual bool allocate( const std::string& consumer,
                            const QueuedMessage& target) = 0;
 
+    /** As allocate(), but only says whether ownership would be permitted,
+     * without assigning it.
+     */
+    virtual bool canAllocate( const std::string& consumer,
+                              const QueuedMessage& target) = 0;
+
     /** Determine the next message available for browsing by the consumer
      * @param consumer the consumer that is browsing the queue
      * @param next set to the next message that the consumer may browse.
@@ -67,6 +73,12 @@ class MessageDistributor
     virtual bool nextBrowsableMessage( Consumer::shared_ptr& consumer,
                                        QueuedMessage& next ) = 0;
 
+    /** Count of changes that may have made messages consumable that were
+     * not before, e.g. a group becoming free.  Consumers that skipped
+     * messages rescan from the front when it moves.
+     */
+    virtual uint32_t ownershipChanges() const { return 0; }
+
     /** hook to add any interesting management state to the status map */
     virtual void query(qpid::types::Variant::Map&) const = 0;
 };
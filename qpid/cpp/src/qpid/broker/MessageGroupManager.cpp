@@ -25,6 +25,8 @@
 #include "qpid/broker/Queue.h"
 #include "qpid/broker/MessageGroupManager.h"
 
+#include <algorithm>
+
 using namespace qpid::broker;
 
 namespace {
@@ -53,103 +55,149 @@ const std::string MessageGroupManager::getGroupId( const QueuedMessage& qm ) con
 }
 
 
+bool MessageGroupManager::GroupState::nextAvailable( framing::SequenceNumber& next ) const
+{
+    // acquired members are normally at the front, and few
+    for (MemberFifo::const_iterator m = members.begin(); m != members.end(); ++m) {
+        if (!m->acquired) {
+            next = m->position;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+MessageGroupManager::GroupState::MemberFifo::iterator
+MessageGroupManager::GroupState::find( const framing::SequenceNumber& position )
+{
+    MemberFifo::iterator m = std::lower_bound( members.begin(), members.end(), position );
+    assert( m != members.end() && m->position == position );
+    return m;
+}
+
+
+MessageGroupManager::GroupState& MessageGroupManager::groupOf( const QueuedMessage& qm )
+{
+    PositionMap::iterator p = positions.find( qm.position );
+    if (p != positions.end()) return *(p->second);
+    GroupMap::iterator gs = messageGroups.find( getGroupId(qm) );
+    assert( gs != messageGroups.end() );
+    return gs->second;
+}
+
+
+/** (re)file the group on the free list or its owner's list, by its oldest available msg */
+void MessageGroupManager::post( GroupState& state )
+{
+    if (state.ready) {
+        state.ready->erase( state.readyAt );
+        state.ready = 0;
+    }
+    framing::SequenceNumber next;
+    if (state.nextAvailable( next )) {
+        GroupFifo& fifo = state.owned() ? consumers[state.owner].ready : freeGroups;
+        state.readyAt = fifo.insert( GroupFifo::value_type( next, &state ) ).first;
+        state.ready = &fifo;
+    }
+}
+
+
+void MessageGroupManager::own( GroupState& state, const std::string& owner )
+{
+    state.owner = owner;
+    consumers[owner].owned++;
+    post( state );
+}
+
+
+void MessageGroupManager::disown( GroupState& state )
+{
+    Consumers::iterator consumer = consumers.find( state.owner );
+    assert( consumer != consumers.end() );
+    state.owner.clear();
+    ++disowned;
+    post( state );
+    if (--consumer->second.owned == 0) {
+        assert( consumer->second.ready.empty() );
+        consumers.erase( consumer );
+    }
+}
+
+
 void MessageGroupManager::enqueued( const QueuedMessage& qm )
 {
-    // @todo KAG optimization - store reference to group state in QueuedMessage
-    // issue: const-ness??
     std::string group( getGroupId(qm) );
     GroupState &state(messageGroups[group]);
-    state.members.push_back(qm.position);
+    state.members.push_back(Member(qm.position));
+    positions[qm.position] = &state;
     uint32_t total = state.members.size();
     QPID_LOG( trace, "group queue " << qName <<
               ": added message to group id=" << group << " total=" << total );
     if (total == 1) {
         // newly created group, no owner
         state.group = group;
-        assert(freeGroups.find(qm.position) == freeGroups.end());
-        freeGroups[qm.position] = &state;
     }
+    if (!state.ready) post(state);
 }
 
 
 void MessageGroupManager::acquired( const QueuedMessage& qm )
 {
-    // @todo KAG  avoid lookup: retrieve direct reference to group state from QueuedMessage
-    // issue: const-ness??
-    std::string group( getGroupId(qm) );
-    GroupMap::iterator gs = messageGroups.find( group );
-    assert( gs != messageGroups.end() );
-    GroupState& state( gs->second );
+    GroupState& state( groupOf(qm) );
+    state.find( qm.position )->acquired = true;
     state.acquired += 1;
+    if (state.ready && state.readyAt->first == qm.position) post(state);
     QPID_LOG( trace, "group queue " << qName <<
-              ": acquired message in group id=" << group << " acquired=" << state.acquired );
+              ": acquired message in group id=" << state.group << " acquired=" << state.acquired );
 }
 
 
 void MessageGroupManager::requeued( const QueuedMessage& qm )
 {
-    // @todo KAG  avoid lookup: retrieve direct reference to group state from QueuedMessage
-    // issue: const-ness??
-    std::string group( getGroupId(qm) );
-    GroupMap::iterator gs = messageGroups.find( group );
-    assert( gs != messageGroups.end() );
-    GroupState& state( gs->second );
+    GroupState& state( groupOf(qm) );
     assert( state.acquired != 0 );
+    state.find( qm.position )->acquired = false;
     state.acquired -= 1;
     if (state.acquired == 0 && state.owned()) {
         QPID_LOG( trace, "group queue " << qName <<
-                  ": consumer name=" << state.owner << " released group id=" << gs->first);
+                  ": consumer name=" << state.owner << " released group id=" << state.group);
         disown(state);
+    } else {
+        post(state);
     }
     QPID_LOG( trace, "group queue " << qName <<
-              ": requeued message to group id=" << group << " acquired=" << state.acquired );
+              ": requeued message to group id=" << state.group << " acquired=" << state.acquired );
 }
 
 
 void MessageGroupManager::dequeued( const QueuedMessage& qm )
 {
-    // @todo KAG  avoid lookup: retrieve direct reference to group state from QueuedMessage
-    // issue: const-ness??
-    std::string group( getGroupId(qm) );
-    GroupMap::iterator gs = messageGroups.find( group );
-    assert( gs != messageGroups.end() );
-    GroupState& state( gs->second );
+    GroupState& state( groupOf(qm) );
     assert( state.members.size() != 0 );
-    assert( state.acquired != 0 );
-    state.acquired -= 1;
 
-    // likely to be at or near begin() if dequeued in order
-    bool reFreeNeeded = false;
-    if (state.members.front() == qm.position) {
-        if (!state.owned()) {
-            // will be on the freeGroups list if mgmt is dequeueing rather than a consumer!
-            // if on freelist, it is indexed by first member, which is about to be removed!
-            unFree(state);
-            reFreeNeeded = true;
-        }
-        state.members.pop_front();
-    } else {
-        GroupState::PositionFifo::iterator pos = state.members.begin() + 1;
-        GroupState::PositionFifo::iterator end = state.members.end();
-        while (pos != end) {
-            if (*pos == qm.position) {
-                state.members.erase(pos);
-                break;
-            }
-            ++pos;
-        }
+    // will not have been acquired if mgmt is dequeueing rather than a consumer
+    GroupState::MemberFifo::iterator member = state.find( qm.position );
+    if (member->acquired) {
+        assert( state.acquired != 0 );
+        state.acquired -= 1;
     }
+    state.members.erase( member );
+    positions.erase( qm.position );
 
     uint32_t total = state.members.size();
+    std::string group( state.group );
     if (total == 0) {
-        QPID_LOG( trace, "group queue " << qName << ": deleting group id=" << gs->first);
-        messageGroups.erase( gs );
+        QPID_LOG( trace, "group queue " << qName << ": deleting group id=" << group);
+        if (state.owned()) disown(state);
+        else post(state);
+        messageGroups.erase( group );
     } else if (state.acquired == 0 && state.owned()) {
         QPID_LOG( trace, "group queue " << qName <<
-                  ": consumer name=" << state.owner << " released group id=" << gs->first);
-        disown(state);
-    } else if (reFreeNeeded) {
+                  ": consumer name=" << state.owner << " released group id=" << group);
         disown(state);
+    } else {
+        post(state);
     }
     QPID_LOG( trace, "group queue " << qName <<
               ": dequeued message from group id=" << group << " total=" << total );
@@ -205,60 +253,60 @@ bool MessageGroupManager::nextConsumableMessage( Consumer::shared_ptr& c, Queued
     if (messages.empty())
         return false;
 
-    if (!freeGroups.empty()) {
-        framing::SequenceNumber nextFree = freeGroups.begin()->first;
-        if (nextFree < c->position) {  // next free group's msg is older than current position
-            bool ok = messages.find(nextFree, next);
-            (void) ok; assert( ok );
-        } else {
-            if (!messages.next( c->position, next ))
-                return false;           // shouldn't happen - should find nextFree
-        }
-    } else {  // no free groups available
-#if 0
-        if (consumers[c->getName()] == 0) {  // and none currently owned
-            return false;       // so nothing available to consume
+    // Scan from the consumer's position, as the queue does for a
+    // selector: the next msg is either the head of a free group or of a
+    // group this consumer owns.  A free group older than the position is
+    // taken first so that groups are still handed out oldest first.
+    framing::SequenceNumber start( c->position );
+    GroupFifo::iterator candidate = freeGroups.begin();
+    bool found = candidate != freeGroups.end();
+    if (found && !(start < candidate->first)) {
+        start = candidate->first;
+        --start;
+    }
+    Consumers::iterator consumer = consumers.find( c->getName() );
+    if (consumer != consumers.end() && !consumer->second.ready.empty()) {
+        GroupFifo& ready( consumer->second.ready );
+        GroupFifo::iterator owned = ready.upper_bound( start );
+        if (owned == ready.end() && !found)
+            owned = ready.begin();  // only requeued msgs behind the position remain
+        if (owned != ready.end() && (!found || owned->first < candidate->first)) {
+            candidate = owned;
+            found = true;
         }
-#endif
-        if (!messages.next( c->position, next ))
-            return false;
     }
+    if (!found)
+        return false;
 
-    do {
-        // @todo KAG  avoid lookup: retrieve direct reference to group state from QueuedMessage
-        std::string group( getGroupId( next ) );
-        GroupMap::iterator gs = messageGroups.find( group );
-        assert( gs != messageGroups.end() );
-        GroupState& state( gs->second );
-        if (!state.owned() || state.owner == c->getName()) {
-            return true;
-        }
-    } while (messages.next( next.position, next ));
-    return false;
+    bool ok = messages.find(candidate->first, next);
+    (void) ok; assert( ok );
+    return ok;
 }
 
 
 bool MessageGroupManager::allocate(const std::string& consumer, const QueuedMessage& qm)
 {
-    // @todo KAG avoid lookup: retrieve direct reference to group state from QueuedMessage
-    std::string group( getGroupId(qm) );
-    GroupMap::iterator gs = messageGroups.find( group );
-    assert( gs != messageGroups.end() );
-    GroupState& state( gs->second );
+    GroupState& state( groupOf(qm) );
 
     if (!state.owned()) {
         own( state, consumer );
         QPID_LOG( trace, "group queue " << qName <<
-                  ": consumer name=" << consumer << " has acquired group id=" << gs->first);
+                  ": consumer name=" << consumer << " has acquired group id=" << state.group);
         return true;
     }
     return state.owner == consumer;
 }
 
+bool MessageGroupManager::canAllocate(const std::string& consumer, const QueuedMessage& qm)
+{
+    GroupState& state( groupOf(qm) );
+    return !state.owned() || state.owner == consumer;
+}
+
 bool MessageGroupManager::nextBrowsableMessage( Consumer::shared_ptr& c, QueuedMessage& next )
 {
     // browse: allow access to any available msg, regardless of group ownership (?ok?)
-    if (!messages.empty() && messages.next(c->position, next))
+    if (!messages.empty() && messages.browse(c->position, next, c->cursor))
         return true;
     return false;
 }
@@ -372,9 +420,9 @@ void MessageGroupManager::getState(qpid::framing::FieldTable& state ) const
         group.setString(GROUP_OWNER, g->second.owner);
         group.setInt(GROUP_ACQUIRED_CT, g->second.acquired);
         framing::Array positions(TYPE_CODE_UINT32);
-        for (GroupState::PositionFifo::const_iterator p = g->second.members.begin();
+        for (GroupState::MemberFifo::const_iterator p = g->second.members.begin();
              p != g->second.members.end(); ++p)
-            positions.push_back(framing::Array::ValuePtr(new IntegerValue( *p )));
+            positions.push_back(framing::Array::ValuePtr(new IntegerValue( p->position )));
         group.setArray(GROUP_POSITIONS, positions);
         groupState.push_back(framing::Array::ValuePtr(new FieldTableValue(group)));
     }
@@ -389,8 +437,10 @@ void MessageGroupManager::setState(const qpid::framing::FieldTable& state)
 {
     using namespace qpid::framing;
     messageGroups.clear();
-    //consumers.clear();
+    positions.clear();
+    consumers.clear();
     freeGroups.clear();
+    ++disowned;
 
     framing::Array groupState(TYPE_CODE_MAP);
 
@@ -427,16 +477,19 @@ void MessageGroupManager::setState(const qpid::framing::FieldTable& state)
             return;
         }
 
-        for (Array::const_iterator p = positions.begin(); p != positions.end(); ++p)
-            state.members.push_back((*p)->getIntegerValue<uint32_t, 4>());
-        messageGroups[state.group] = state;
-        if (state.owned())
-            //consumers[state.owner]++;
-            ;
-        else {
-            assert(state.members.size());
-            freeGroups[state.members.front()] = &messageGroups[state.group];
+        GroupState& restored = messageGroups[state.group];
+        restored = state;
+        for (Array::const_iterator p = positions.begin(); p != positions.end(); ++p) {
+            framing::SequenceNumber position((*p)->getIntegerValue<uint32_t, 4>());
+            restored.members.push_back(Member(position));
+            // only acquired msgs are missing from the queue
+            QueuedMessage qm;
+            restored.members.back().acquired = !messages.find(position, qm);
+            this->positions[position] = &restored;
         }
+        if (restored.owned())
+            consumers[restored.owner].owned++;
+        post(restored);
     }
 
     QPID_LOG(debug, "Queue \"" << qName << "\": message group state replicated, key =" << groupIdHeader)
@@ -26,6 +26,10 @@
 
 #include "qpid/broker/StatefulQueueObserver.h"
 #include "qpid/broker/MessageDistributor.h"
+#include "qpid/framing/SequenceNumber.h"
+#include <boost/unordered_map.hpp>
+#include <deque>
+#include <map>
 
 
 namespace qpid {
@@ -43,53 +47,60 @@ class MessageGroupManager : public StatefulQueueObserver, public MessageDistribu
     Messages& messages;                 // parent Queue's in memory message container
     const std::string qName;            // name of parent queue (for logs)
 
+    struct GroupState;
+    typedef std::map<framing::SequenceNumber, GroupState *> GroupFifo;
+
+    struct Member {
+        framing::SequenceNumber position;
+        bool acquired;
+
+        Member(const framing::SequenceNumber& p) : position(p), acquired(false) {}
+        bool operator<(const framing::SequenceNumber& p) const { return position < p; }
+    };
+
     struct GroupState {
-        typedef std::deque<framing::SequenceNumber> PositionFifo;
+        typedef std::deque<Member> MemberFifo;
 
         std::string group;  // group identifier
         std::string owner;  // consumer with outstanding acquired messages
         uint32_t acquired;  // count of outstanding acquired messages
-        //uint32_t total;     // count of enqueued messages in this group
-        PositionFifo members;   // msgs belonging to this group
+        MemberFifo members;   // msgs belonging to this group, in position order
+        GroupFifo* ready;     // free or owner's list, if a member is available
+        GroupFifo::iterator readyAt;
 
-        GroupState() : acquired(0) {}
+        GroupState() : acquired(0), ready(0) {}
         bool owned() const {return !owner.empty();}
+        bool nextAvailable(framing::SequenceNumber&) const;
+        MemberFifo::iterator find(const framing::SequenceNumber&);
+    };
+    typedef boost::unordered_map<std::string, GroupState> GroupMap;
+    typedef boost::unordered_map<uint32_t, GroupState *> PositionMap;
+
+    // groups owned by a consumer, ready ones ordered by oldest available msg
+    struct ConsumerGroups {
+        GroupFifo ready;
+        uint32_t owned;
+
+        ConsumerGroups() : owned(0) {}
     };
-    typedef std::map<std::string, struct GroupState> GroupMap;
-    //typedef std::map<std::string, uint32_t> Consumers;  // count of owned groups
-    typedef std::map<framing::SequenceNumber, struct GroupState *> GroupFifo;
+    typedef boost::unordered_map<std::string, ConsumerGroups> Consumers;
 
     // note: update getState()/setState() when changing this object's state implementation
     GroupMap messageGroups; // index: group name
+    PositionMap positions;  // index: msg position
     GroupFifo freeGroups;   // ordered by oldest free msg
-    //Consumers consumers;    // index: consumer name
+    Consumers consumers;    // index: consumer name
+    uint32_t disowned;      // groups released, see ownershipChanges()
 
     static const std::string qpidMessageGroupKey;
     static const std::string qpidSharedGroup;   // if specified, one group can be consumed by multiple receivers
     static const std::string qpidMessageGroupTimestamp;
 
     const std::string getGroupId( const QueuedMessage& qm ) const;
-    void unFree( const GroupState& state )
-    {
-        GroupFifo::iterator pos = freeGroups.find( state.members.front() );
-        assert( pos != freeGroups.end() && pos->second == &state );
-        freeGroups.erase( pos );
-    }
-    void own( GroupState& state, const std::string& owner )
-    {
-        state.owner = owner;
-        //consumers[state.owner]++;
-        unFree( state );
-    }
-    void disown( GroupState& state )
-    {
-        //assert(consumers[state.owner]);
-        //consumers[state.owner]--;
-        state.owner.clear();
-        assert(state.members.size());
-        assert(freeGroups.find(state.members.front()) == freeGroups.end());
-        freeGroups[state.members.front()] = &state;
-    }
+    GroupState& groupOf( const QueuedMessage& qm );
+    void post( GroupState& state );
+    void own( GroupState& state, const std::string& owner );
+    void disown( GroupState& state );
 
  public:
 
@@ -101,7 +112,7 @@ class MessageGroupManager : public StatefulQueueObserver, public MessageDistribu
     MessageGroupManager(const std::string& header, const std::string& _qName,
                         Messages& container, unsigned int _timestamp=0 )
       : StatefulQueueObserver(std::string("MessageGroupManager:") + header),
-      groupIdHeader( header ), timestamp(_timestamp), messages(container), qName(_qName) {}
+      groupIdHeader( header ), timestamp(_timestamp), messages(container), qName(_qName), disowned(0) {}
     void enqueued( const QueuedMessage& qm );
     void acquired( const QueuedMessage& qm );
     void requeued( const QueuedMessage& qm );
@@ -114,8 +125,10 @@ class MessageGroupManager : public StatefulQueueObserver, public MessageDistribu
     // MessageDistributor iface
     bool nextConsumableMessage(Consumer::shared_ptr& c, QueuedMessage& next);
     bool allocate(const std::string& c, const QueuedMessage& qm);
+    bool canAllocate(const std::string& c, const QueuedMessage& qm);
     bool nextBrowsableMessage(Consumer::shared_ptr& c, QueuedMessage& next);
     void query(qpid::types::Variant::Map&) const;
+    uint32_t ownershipChanges() const { return disowned; }
 
     bool match(const qpid::types::Variant::Map*, const QueuedMessage&) const;
 };
@@ -20,11 +20,77 @@
  */
 #include "qpid/broker/MessageMap.h"
 #include "qpid/broker/QueuedMessage.h"
+#include <boost/functional/hash.hpp>
+#include <algorithm>
 
 namespace qpid {
 namespace broker {
 namespace {
 const std::string EMPTY;
+const size_t INITIAL_BUCKETS = 16;
+}
+
+MessageMap::Node::Node(const QueuedMessage& m, const std::string& k, size_t h) :
+    message(m), key(k), hash(h), indexed(false) {}
+
+MessageMap::KeyIndex::KeyIndex() : buckets(INITIAL_BUCKETS), count(0) {}
+
+MessageMap::Node* MessageMap::KeyIndex::find(const std::string& key, size_t hash) const
+{
+    for (size_t i = home(hash); buckets[i]; i = (i + 1) & (buckets.size() - 1)) {
+        if (buckets[i]->hash == hash && buckets[i]->key == key) return buckets[i];
+    }
+    return 0;
+}
+
+void MessageMap::KeyIndex::insert(Node* node)
+{
+    if (2 * (count + 1) > buckets.size()) grow();
+    size_t i = home(node->hash);
+    while (buckets[i]) i = (i + 1) & (buckets.size() - 1);
+    buckets[i] = node;
+    node->indexed = true;
+    ++count;
+}
+
+void MessageMap::KeyIndex::erase(Node* node)
+{
+    const size_t mask = buckets.size() - 1;
+    size_t i = home(node->hash);
+    while (buckets[i] != node) {
+        if (!buckets[i]) return;
+        i = (i + 1) & mask;
+    }
+    node->indexed = false;
+    --count;
+    //shift back any later entries whose probe sequence passes through the gap
+    for (size_t j = (i + 1) & mask; buckets[j]; j = (j + 1) & mask) {
+        size_t k = home(buckets[j]->hash);
+        if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+            buckets[i] = buckets[j];
+            i = j;
+        }
+    }
+    buckets[i] = 0;
+}
+
+void MessageMap::KeyIndex::grow()
+{
+    std::vector<Node*> old(buckets.size() * 2);
+    old.swap(buckets);
+    count = 0;
+    for (std::vector<Node*>::iterator i = old.begin(); i != old.end(); ++i) {
+        if (*i) insert(*i);
+    }
+}
+
+MessageMap::MessageMap(const std::string& k) : key(k), count(0), popped(0) {}
+
+MessageMap::~MessageMap()
+{
+    for (Ordering::iterator i = messages.begin(); i != messages.end(); ++i) {
+        delete i->node;
+    }
 }
 
 std::string MessageMap::getKey(const QueuedMessage& message)
@@ -36,29 +102,32 @@ std::string MessageMap::getKey(const QueuedMessage& message)
 
 size_t MessageMap::size()
 {
-    return messages.size();
+    return count;
 }
 
 bool MessageMap::empty()
 {
-    return messages.empty();
+    return count == 0;
 }
 
 void MessageMap::reinsert(const QueuedMessage& message)
 {
     std::string key = getKey(message);
-    Index::iterator i = index.find(key);
-    if (i == index.end()) {
-        index[key] = message;
-        messages[message.position] = message;
+    size_t hash = boost::hash_value(key);
+    if (!index.find(key, hash)) {
+        Node* node = new Node(message, key, hash);
+        index.insert(node);
+        messages.insert(std::lower_bound(messages.begin(), messages.end(), message.position, &before),
+                        Entry(message.position, node));
+        ++count;
     } //else message has already been replaced
 }
 
 bool MessageMap::remove(const framing::SequenceNumber& position, QueuedMessage& message)
 {
-    Ordering::iterator i = messages.find(position);
+    Ordering::iterator i = seek(position);
     if (i != messages.end()) {
-        message = i->second;
+        message = i->node->message;
         erase(i);
         return true;
     } else {
@@ -68,9 +137,9 @@ bool MessageMap::remove(const framing::SequenceNumber& position, QueuedMessage&
 
 bool MessageMap::find(const framing::SequenceNumber& position, QueuedMessage& message)
 {
-    Ordering::iterator i = messages.find(position);
+    Ordering::iterator i = seek(position);
     if (i != messages.end()) {
-        message = i->second;
+        message = i->node->message;
         return true;
     } else {
         return false;
@@ -83,9 +152,10 @@ bool MessageMap::next(const framing::SequenceNumber& position, QueuedMessage& me
         message = front();
         return true;
     } else {
-        Ordering::iterator i = messages.lower_bound(position+1);
+        Ordering::iterator i = std::lower_bound(messages.begin(), messages.end(), position+1, &before);
+        while (i != messages.end() && !i->node) ++i;
         if (i != messages.end()) {
-            message = i->second;
+            message = i->node->message;
             return true;
         } else {
             return false;
@@ -93,9 +163,30 @@ bool MessageMap::next(const framing::SequenceNumber& position, QueuedMessage& me
     }
 }
 
+bool MessageMap::browse(const framing::SequenceNumber& position, QueuedMessage& message, size_t& cursor)
+{
+    // The cursor is one past the last entry browsed, counting from the
+    // first entry ever held. Use it if it still follows position.
+    size_t i = cursor > popped ? cursor - popped : 0;
+    if (i > messages.size() ||
+        (i > 0 && position < messages[i-1].position) ||
+        (i < messages.size() && messages[i].position <= position)) {
+        i = std::lower_bound(messages.begin(), messages.end(), position+1, &before) - messages.begin();
+    }
+    while (i < messages.size() && !messages[i].node) ++i;
+    if (i < messages.size()) {
+        message = messages[i].node->message;
+        cursor = popped + i + 1;
+        return true;
+    } else {
+        cursor = popped + i;
+        return false;
+    }
+}
+
 QueuedMessage& MessageMap::front()
 {
-    return messages.begin()->second;
+    return messages.front().node->message;
 }
 
 void MessageMap::pop()
@@ -106,35 +197,41 @@ void MessageMap::pop()
 
 bool MessageMap::pop(QueuedMessage& out)
 {
-    Ordering::iterator i = messages.begin();
-    if (i != messages.end()) {
-        out = i->second;
-        erase(i);
+    if (!messages.empty()) {
+        out = front();
+        erase(messages.begin());
         return true;
     } else {
         return false;
     }
 }
 
-const QueuedMessage& MessageMap::replace(const QueuedMessage& original, const QueuedMessage& update)
+void MessageMap::replace(Node& node, const QueuedMessage& update)
 {
-    messages.erase(original.position);
-    messages[update.position] = update;
-    return update;
+    //the update takes the place of the original at the back of the queue
+    seek(node.message.position)->node = 0;
+    node.message = update;
+    messages.push_back(Entry(update.position, &node));
+    tidy();
 }
 
 bool MessageMap::push(const QueuedMessage& added, QueuedMessage& removed)
 {
-    std::pair<Index::iterator, bool> result = index.insert(Index::value_type(getKey(added), added));
-    if (result.second) {
+    std::string key = getKey(added);
+    size_t hash = boost::hash_value(key);
+    Node* node = index.find(key, hash);
+    if (!node) {
         //there was no previous message for this key; nothing needs to
         //be removed, just add the message into its correct position
-        messages[added.position] = added;
+        node = new Node(added, key, hash);
+        index.insert(node);
+        messages.push_back(Entry(added.position, node));
+        ++count;
         return false;
     } else {
         //there is already a message with that key which needs to be replaced
-        removed = result.first->second;
-        result.first->second = replace(result.first->second, added);
+        removed = node->message;
+        replace(*node, added);
         return true;
     }
 }
@@ -142,25 +239,76 @@ bool MessageMap::push(const QueuedMessage& added, QueuedMessage& removed)
 void MessageMap::foreach(Functor f)
 {
     for (Ordering::iterator i = messages.begin(); i != messages.end(); ++i) {
-        f(i->second);
+        if (i->node) f(i->node->message);
     }
 }
 
 void MessageMap::removeIf(Predicate p)
 {
-    for (Ordering::iterator i = messages.begin(); i != messages.end(); i++) {
-        if (p(i->second)) {
-            erase(i);
+    for (Ordering::iterator i = messages.begin(); i != messages.end(); ++i) {
+        if (i->node && p(i->node->message)) {
+            kill(i);
         }
     }
+    tidy();
+}
+
+MessageMap::Ordering::iterator MessageMap::seek(const framing::SequenceNumber& position)
+{
+    Ordering::iterator i = std::lower_bound(messages.begin(), messages.end(), position, &before);
+    if (i != messages.end() && i->position == position && i->node) return i;
+    else return messages.end();
+}
+
+void MessageMap::append(const QueuedMessage& message, bool indexed)
+{
+    std::string key = getKey(message);
+    Node* node = new Node(message, key, boost::hash_value(key));
+    if (indexed) index.insert(node);
+    messages.push_back(Entry(message.position, node));
+    ++count;
+}
+
+void MessageMap::unindex(const std::string& key)
+{
+    Node* node = index.find(key, boost::hash_value(key));
+    if (node) index.erase(node);
+}
+
+bool MessageMap::before(const Entry& e, const framing::SequenceNumber& position)
+{
+    return e.position < position;
+}
+
+bool MessageMap::isGap(const Entry& e)
+{
+    return !e.node;
 }
 
 void MessageMap::erase(Ordering::iterator i)
 {
-    index.erase(getKey(i->second));
-    messages.erase(i);
+    kill(i);
+    tidy();
 }
 
-MessageMap::MessageMap(const std::string& k) : key(k) {}
+void MessageMap::kill(Ordering::iterator i)
+{
+    if (i->node->indexed) index.erase(i->node);
+    delete i->node;
+    i->node = 0;
+    --count;
+}
+
+void MessageMap::tidy()
+{
+    while (!messages.empty() && !messages.front().node) {
+        messages.pop_front();
+        ++popped;
+    }
+    while (!messages.empty() && !messages.back().node) messages.pop_back();
+    if (messages.size() > 2 * count + INITIAL_BUCKETS) {
+        messages.erase(std::remove_if(messages.begin(), messages.end(), &isGap), messages.end());
+    }
+}
 
 }} // namespace qpid::broker
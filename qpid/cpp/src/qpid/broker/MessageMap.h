@@ -22,9 +22,11 @@
  *
  */
 #include "qpid/broker/Messages.h"
+#include "qpid/broker/QueuedMessage.h"
 #include "qpid/framing/SequenceNumber.h"
-#include <map>
+#include <deque>
 #include <string>
+#include <vector>
 
 namespace qpid {
 namespace broker {
@@ -33,12 +35,18 @@ namespace broker {
  * Provides a last value queue behaviour, whereby a messages replace
  * any previous message with the same value for a defined property
  * (i.e. the key).
+ *
+ * Each message is held in a node found by key through an open
+ * addressing hash table; a replacement reuses the node of the message
+ * it replaces. Nodes are ordered by position in a deque, where removed
+ * or replaced messages leave a gap that is discarded once it reaches
+ * either end, or once gaps outnumber messages.
  */
 class MessageMap : public Messages
 {
   public:
     MessageMap(const std::string& key);
-    virtual ~MessageMap() {}
+    virtual ~MessageMap();
 
     size_t size();
     bool empty();
@@ -47,6 +55,7 @@ class MessageMap : public Messages
     virtual bool remove(const framing::SequenceNumber&, QueuedMessage&);
     bool find(const framing::SequenceNumber&, QueuedMessage&);
     virtual bool next(const framing::SequenceNumber&, QueuedMessage&);
+    virtual bool browse(const framing::SequenceNumber&, QueuedMessage&, size_t& cursor);
 
     QueuedMessage& front();
     void pop();
@@ -57,15 +66,65 @@ class MessageMap : public Messages
     virtual void removeIf(Predicate);
 
   protected:
-    typedef std::map<std::string, QueuedMessage> Index;
-    typedef std::map<framing::SequenceNumber, QueuedMessage> Ordering;
+    struct Node
+    {
+        QueuedMessage message;
+        const std::string key;
+        const size_t hash;
+        bool indexed;
+
+        Node(const QueuedMessage&, const std::string& key, size_t hash);
+    };
+
+    struct Entry
+    {
+        framing::SequenceNumber position;
+        Node* node;             // null once the message has gone
+
+        Entry(const framing::SequenceNumber& p, Node* n) : position(p), node(n) {}
+    };
+    typedef std::deque<Entry> Ordering;
+
+    /**
+     * Open addressing (linear probing) hash table of the nodes that
+     * currently hold the last value for their key.
+     */
+    class KeyIndex
+    {
+      public:
+        KeyIndex();
+        Node* find(const std::string&, size_t hash) const;
+        void insert(Node*);
+        void erase(Node*);
+      private:
+        std::vector<Node*> buckets;
+        size_t count;
+
+        size_t home(size_t hash) const { return hash & (buckets.size() - 1); }
+        void grow();
+    };
+
     const std::string key;
-    Index index;
+    KeyIndex index;
     Ordering messages;
+    size_t count;
+    size_t popped;              // Entries ever dropped from the front, see browse()
 
     std::string getKey(const QueuedMessage&);
-    virtual const QueuedMessage& replace(const QueuedMessage&, const QueuedMessage&);
+    /** @return the entry of the message at position, or messages.end() */
+    Ordering::iterator seek(const framing::SequenceNumber&);
+    /** add a message at the back, optionally indexing it by key */
+    void append(const QueuedMessage&, bool indexed);
+    /** stop the message at position being replaced by later messages with the same key */
+    void unindex(const std::string& key);
     void erase(Ordering::iterator);
+    virtual void replace(Node&, const QueuedMessage&);
+
+  private:
+    void kill(Ordering::iterator);
+    void tidy();
+    static bool before(const Entry&, const framing::SequenceNumber&);
+    static bool isGap(const Entry&);
 };
 }} // namespace qpid::broker
 
@@ -21,7 +21,9 @@
  * under the License.
  *
  */
+#include "qpid/broker/QueuedMessage.h"
 #include <boost/function.hpp>
+#include <deque>
 
 namespace qpid {
 namespace framing {
@@ -76,6 +78,16 @@ class Messages
      * @return true if there is another message, false otherwise.
      */
     virtual bool next(const framing::SequenceNumber&, QueuedMessage&) = 0;
+    /**
+     * As next(), for a browser that keeps a cursor between calls. An
+     * implementation may use the cursor to find the next message
+     * without searching for the position; a stale cursor must cost
+     * no more than that search. The default ignores the cursor.
+     */
+    virtual bool browse(const framing::SequenceNumber& position, QueuedMessage& message, size_t& /*cursor*/)
+    {
+        return next(position, message);
+    }
     /**
      * Note: Caller is responsible for ensuring that there is a front
      * (e.g. empty() returns false)
@@ -83,6 +95,14 @@ class Messages
      * @return the next message to be delivered
      */
     virtual QueuedMessage& front() = 0;
+    /**
+     * Note: Caller is responsible for ensuring that there is a front
+     * (e.g. empty() returns false)
+     *
+     * @return the message a ring queue replaces first: the earliest
+     * of the lowest priority held. The default is front().
+     */
+    virtual QueuedMessage& oldest() { return front(); }
     /**
      * Removes the front message
      */
@@ -100,6 +120,19 @@ class Messages
      * will be passed out via the second parameter.
      */
     virtual bool push(const QueuedMessage& added, QueuedMessage& removed) = 0;
+    /**
+     * Appends a batch of messages, in position order and after any
+     * already held, as if each were pushed in turn; used to load
+     * recovered messages in bulk. Any removed to make way for them are
+     * added to the second parameter. The default pushes each message.
+     */
+    virtual void append(const std::deque<QueuedMessage>& added, std::deque<QueuedMessage>& removed)
+    {
+        for (std::deque<QueuedMessage>::const_iterator i = added.begin(); i != added.end(); ++i) {
+            QueuedMessage r;
+            if (push(*i, r)) removed.push_back(r);
+        }
+    }
 
     /**
      * Apply the functor to each message held
@@ -0,0 +1,371 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "qpid/broker/PagedQueue.h"
+#include "qpid/broker/ExpiryPolicy.h"
+#include "qpid/broker/Message.h"
+#include "qpid/framing/Buffer.h"
+#include "qpid/framing/FieldTable.h"
+#include "qpid/sys/MemoryMappedFile.h"
+#include "qpid/sys/Time.h"
+#include "qpid/log/Statement.h"
+#include <algorithm>
+
+namespace qpid {
+namespace broker {
+
+using qpid::framing::Buffer;
+using qpid::framing::SequenceNumber;
+using qpid::sys::MemoryMappedFile;
+
+const std::string PagedQueue::pagingKey("qpid.paging");
+const std::string PagedQueue::maxPagesLoadedKey("qpid.max_pages_loaded");
+const std::string PagedQueue::pageFactorKey("qpid.page_factor");
+
+namespace {
+const uint DEFAULT_MAX_PAGES_LOADED = 4;
+// Unless qpid.page_factor says otherwise, each page is a 1MB file, so a
+// deep queue needs few mappings
+const size_t DEFAULT_PAGE_SIZE = 1024 * 1024;
+
+// Each message is preceded by its encoded size, position,
+// redelivered flag and expiration (nanoseconds since the epoch, or 0)
+const size_t RECORD_HEADER_SIZE = 4 + 4 + 1 + 8;
+
+size_t recordSize(const QueuedMessage& m)
+{
+    return RECORD_HEADER_SIZE + m.payload->encodedSize();
+}
+
+bool isStored(const QueuedMessage& m)
+{
+    return m.payload->getPersistenceId();
+}
+
+void reduce(size_t& used, size_t size)
+{
+    used = used > size ? used - size : 0;
+}
+
+// Mapping may fail (e.g. the paging directory is full); the caller then
+// keeps the page in memory rather than leave the queue half updated
+bool map(boost::shared_ptr<MemoryMappedFile>& file, const std::string& directory, size_t size)
+{
+    try {
+        file.reset(new MemoryMappedFile(directory, size));
+        return true;
+    } catch (const std::exception& e) {
+        QPID_LOG(warning, "Keeping page in memory: " << e.what());
+        return false;
+    }
+}
+}
+
+PagedQueue::Page::Page() : count(0), used(0), isLoaded(true) {}
+
+PagedQueue::PagedQueue(const std::string& d, uint m, size_t s, const boost::intrusive_ptr<ExpiryPolicy>& e) :
+    directory(d), maxLoaded(m ? m : 1), pageSize(s), expiryPolicy(e), count(0), loaded(0), queue(0) {}
+
+PagedQueue::~PagedQueue() {}
+
+size_t PagedQueue::size()
+{
+    return count;
+}
+
+bool PagedQueue::empty()
+{
+    return count == 0;
+}
+
+void PagedQueue::reinsert(const QueuedMessage& message)
+{
+    if (!queue) queue = message.queue;
+    Pages::iterator i = findPage(message.position);
+    if (i == pages.end()) {
+        i = pages.insert(Pages::value_type(message.position, Page())).first;
+        ++loaded;
+    } else if (message.position < i->first) {
+        //pages are keyed by their first position, so move the front page back
+        Page moved = load(i);
+        pages.erase(i);
+        i = pages.insert(Pages::value_type(message.position, moved)).first;
+    }
+    Page& page = load(i);
+    page.messages.insert(lower_bound(page.messages.begin(), page.messages.end(), message), message);
+    page.used += recordSize(message);
+    ++page.count;
+    ++count;
+}
+
+bool PagedQueue::find(const SequenceNumber& position, QueuedMessage& message, bool remove)
+{
+    Pages::iterator i = findPage(position);
+    if (i == pages.end() || position < i->first) return false;
+    Page& page = load(i);
+    QueuedMessage comp;
+    comp.position = position;
+    Deque::iterator j = lower_bound(page.messages.begin(), page.messages.end(), comp);
+    if (j == page.messages.end() || j->position != position) return false;
+    message = *j;
+    if (remove) {
+        reduce(page.used, recordSize(*j));
+        page.messages.erase(j);
+        --page.count;
+        --count;
+        if (!page.count) erase(i);
+    }
+    return true;
+}
+
+bool PagedQueue::remove(const SequenceNumber& position, QueuedMessage& message)
+{
+    return find(position, message, true);
+}
+
+bool PagedQueue::find(const SequenceNumber& position, QueuedMessage& message)
+{
+    return find(position, message, false);
+}
+
+bool PagedQueue::next(const SequenceNumber& position, QueuedMessage& message)
+{
+    QueuedMessage comp;
+    comp.position = position;
+    for (Pages::iterator i = findPage(position); i != pages.end(); ++i) {
+        Page& page = load(i);
+        Deque::iterator j = upper_bound(page.messages.begin(), page.messages.end(), comp);
+        if (j != page.messages.end()) {
+            message = *j;
+            return true;
+        }
+    }
+    return false;
+}
+
+QueuedMessage& PagedQueue::front()
+{
+    return load(pages.begin()).messages.front();
+}
+
+void PagedQueue::pop()
+{
+    Pages::iterator i = pages.begin();
+    if (i == pages.end()) return;
+    Page& page = load(i);
+    reduce(page.used, recordSize(page.messages.front()));
+    page.messages.pop_front();
+    --page.count;
+    --count;
+    if (!page.count) erase(i);
+}
+
+bool PagedQueue::pop(QueuedMessage& out)
+{
+    if (empty()) return false;
+    out = front();
+    pop();
+    return true;
+}
+
+bool PagedQueue::push(const QueuedMessage& added, QueuedMessage& /*not populated*/)
+{
+    if (!queue) queue = added.queue;
+    size_t size = recordSize(added);
+    Pages::iterator tail = pages.end();
+    if (!pages.empty() && (--tail)->second.used + size > pageSize) tail = pages.end();
+    if (tail == pages.end()) {
+        tail = pages.insert(pages.end(), Pages::value_type(added.position, Page()));
+        if (loaded < maxLoaded || isStored(added)) {
+            ++loaded;
+        } else {
+            tail->second.isLoaded = false;
+        }
+    } else if (isStored(added)) {
+        load(tail);
+    }
+    append(tail->second, added);
+    return false;//adding a message never causes one to be removed for paged queues
+}
+
+void PagedQueue::foreach(Functor f)
+{
+    for (Pages::iterator i = pages.begin(); i != pages.end(); ++i) {
+        Page& page = load(i);
+        std::for_each(page.messages.begin(), page.messages.end(), f);
+    }
+}
+
+void PagedQueue::removeIf(Predicate p)
+{
+    for (Pages::iterator i = pages.begin(); i != pages.end();) {
+        Page& page = load(i);
+        for (Deque::iterator j = page.messages.begin(); j != page.messages.end();) {
+            if (p(*j)) {
+                reduce(page.used, recordSize(*j));
+                j = page.messages.erase(j);
+                --page.count;
+                --count;
+            } else {
+                ++j;
+            }
+        }
+        if (page.count) ++i;
+        else erase(i++);
+    }
+    readAhead();
+}
+
+PagedQueue::Pages::iterator PagedQueue::findPage(const SequenceNumber& position)
+{
+    Pages::iterator i = pages.upper_bound(position);
+    if (i != pages.begin()) --i;
+    return i;
+}
+
+PagedQueue::Page& PagedQueue::load(Pages::iterator i)
+{
+    Page& page = i->second;
+    if (!page.isLoaded) {
+        //make room by unloading the pages furthest from the front
+        for (Pages::reverse_iterator j = pages.rbegin(); loaded >= maxLoaded && j != pages.rend(); ++j) {
+            unload(j->second);
+        }
+        size_t offset = 0;
+        for (size_t n = 0; n < page.count; ++n) {
+            page.messages.push_back(decode(page.file->getData(), offset));
+        }
+        page.isLoaded = true;
+        ++loaded;
+    }
+    return page;
+}
+
+bool PagedQueue::unload(Page& page)
+{
+    if (!page.isLoaded) return true;
+    if (std::find_if(page.messages.begin(), page.messages.end(), &isStored) != page.messages.end()) {
+        return false;
+    }
+    //messages may have changed size while loaded, so recalculate
+    page.used = 0;
+    for (Deque::iterator i = page.messages.begin(); i != page.messages.end(); ++i) {
+        page.used += recordSize(*i);
+    }
+    if ((!page.file || page.file->getSize() < page.used) &&
+        !map(page.file, directory, std::max(pageSize, page.used))) {
+        return false;
+    }
+    size_t offset = 0;
+    for (Deque::iterator i = page.messages.begin(); i != page.messages.end(); ++i) {
+        encode(*i, page.file->getData() + offset);
+        offset += recordSize(*i);
+    }
+    page.messages.clear();
+    page.isLoaded = false;
+    --loaded;
+    QPID_LOG(debug, "Paged out " << page.count << " messages (" << page.used << " bytes)");
+    return true;
+}
+
+void PagedQueue::readAhead()
+{
+    uint n = 0;
+    for (Pages::iterator i = pages.begin(); i != pages.end() && n < maxLoaded; ++i, ++n) {
+        load(i);
+    }
+}
+
+void PagedQueue::append(Page& page, const QueuedMessage& message)
+{
+    size_t size = recordSize(message);
+    if (!page.isLoaded && !page.file && !map(page.file, directory, std::max(pageSize, size))) {
+        //nothing is paged out yet, so just hold the new page in memory
+        page.isLoaded = true;
+        ++loaded;
+    }
+    if (page.isLoaded) {
+        page.messages.push_back(message);
+    } else {
+        encode(message, page.file->getData() + page.used);
+    }
+    page.used += size;
+    ++page.count;
+    ++count;
+}
+
+void PagedQueue::erase(Pages::iterator i)
+{
+    bool atFront = i == pages.begin();
+    if (i->second.isLoaded) --loaded;
+    pages.erase(i);
+    //as consumers drain the front, bring the pages behind it back in
+    if (atFront) readAhead();
+}
+
+void PagedQueue::encode(const QueuedMessage& message, char* data) const
+{
+    sys::AbsTime expiration = message.payload->getExpiration();
+    Buffer buffer(data, recordSize(message));
+    buffer.putLong(message.payload->encodedSize());
+    buffer.putLong(message.position);
+    buffer.putOctet(message.payload->getRedelivered());
+    buffer.putLongLong(expiration < sys::FAR_FUTURE ? int64_t(sys::Duration(sys::EPOCH, expiration)) : 0);
+    message.payload->encode(buffer);
+}
+
+QueuedMessage PagedQueue::decode(char* data, size_t& offset) const
+{
+    Buffer header(data + offset, RECORD_HEADER_SIZE);
+    uint32_t size = header.getLong();
+    QueuedMessage message(queue);
+    message.position = header.getLong();
+    bool redelivered = header.getOctet();
+    int64_t expiration = header.getLongLong();
+
+    Buffer body(data + offset + RECORD_HEADER_SIZE, size);
+    message.payload = new Message();
+    message.payload->decodeHeader(body);
+    message.payload->decodeContent(body);
+    if (redelivered) message.payload->redeliver();
+    if (expiration) {
+        message.payload->setExpiration(sys::AbsTime(sys::EPOCH, expiration));
+        message.payload->setExpiryPolicy(expiryPolicy);
+    }
+    offset += RECORD_HEADER_SIZE + size;
+    return message;
+}
+
+std::auto_ptr<Messages> PagedQueue::create(const framing::FieldTable& settings, const std::string& directory,
+                                           const boost::intrusive_ptr<ExpiryPolicy>& expiryPolicy)
+{
+    std::auto_ptr<Messages> result;
+    if (settings.get(pagingKey)) {
+        int maxLoaded = settings.getAsInt(maxPagesLoadedKey);
+        int factor = settings.getAsInt(pageFactorKey);
+        result = std::auto_ptr<Messages>(
+            new PagedQueue(directory, maxLoaded > 0 ? maxLoaded : DEFAULT_MAX_PAGES_LOADED,
+                           factor > 0 ? factor * MemoryMappedFile::getPageSize() : DEFAULT_PAGE_SIZE,
+                           expiryPolicy));
+    }
+    return result;
+}
+
+}} // namespace qpid::broker
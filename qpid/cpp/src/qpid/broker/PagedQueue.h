@@ -0,0 +1,134 @@
+#ifndef QPID_BROKER_PAGEDQUEUE_H
+#define QPID_BROKER_PAGEDQUEUE_H
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "qpid/broker/BrokerImportExport.h"
+#include "qpid/broker/Messages.h"
+#include "qpid/broker/QueuedMessage.h"
+#include "qpid/framing/SequenceNumber.h"
+#include <boost/intrusive_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace qpid {
+namespace sys {
+class MemoryMappedFile;
+}
+namespace framing {
+class FieldTable;
+}
+namespace broker {
+
+class ExpiryPolicy;
+
+/**
+ * FIFO queue that holds its messages in pages of a fixed encoded
+ * size, only a bounded number of which are kept in memory. The rest
+ * are encoded into memory mapped files in a local directory, so no
+ * store is needed. Pages are loaded in order ahead of consumers as
+ * the pages at the front are drained; browsing or removing a message
+ * from an unloaded page loads it on demand, unloading the page
+ * furthest from the front if the limit has been reached.
+ *
+ * Messages that have been enqueued in a store are never paged out,
+ * as the store already holds their content; pages containing them
+ * stay loaded.
+ */
+class PagedQueue : public Messages
+{
+  public:
+    QPID_BROKER_EXTERN PagedQueue(const std::string& directory, uint maxLoaded, size_t pageSize,
+                                  const boost::intrusive_ptr<ExpiryPolicy>& expiryPolicy);
+    QPID_BROKER_EXTERN ~PagedQueue();
+
+    size_t size();
+    bool empty();
+
+    void reinsert(const QueuedMessage&);
+    bool remove(const framing::SequenceNumber&, QueuedMessage&);
+    bool find(const framing::SequenceNumber&, QueuedMessage&);
+    bool next(const framing::SequenceNumber&, QueuedMessage&);
+
+    QueuedMessage& front();
+    void pop();
+    bool pop(QueuedMessage&);
+    bool push(const QueuedMessage& added, QueuedMessage& removed);
+
+    void foreach(Functor);
+    void removeIf(Predicate);
+
+    /** @return the number of pages currently held in memory */
+    uint getLoadedPages() const { return loaded; }
+    /** @return the total number of pages */
+    size_t getPages() const { return pages.size(); }
+
+    static const std::string pagingKey;
+    static const std::string maxPagesLoadedKey;
+    static const std::string pageFactorKey;
+
+    /**
+     * @return a PagedQueue if the settings ask for paging, otherwise
+     * an empty pointer
+     */
+    QPID_BROKER_EXTERN static std::auto_ptr<Messages> create(const framing::FieldTable& settings,
+                                          const std::string& directory,
+                                          const boost::intrusive_ptr<ExpiryPolicy>& expiryPolicy);
+  private:
+    typedef std::deque<QueuedMessage> Deque;
+
+    struct Page
+    {
+        Deque messages;
+        boost::shared_ptr<sys::MemoryMappedFile> file;
+        size_t count;       // messages held, whether loaded or not
+        size_t used;        // bytes those messages occupy when encoded
+        bool isLoaded;
+
+        Page();
+    };
+    typedef std::map<framing::SequenceNumber, Page> Pages;
+
+    const std::string directory;
+    const uint maxLoaded;
+    const size_t pageSize;
+    const boost::intrusive_ptr<ExpiryPolicy> expiryPolicy;
+    Pages pages;
+    size_t count;
+    uint loaded;
+    Queue* queue;
+
+    Pages::iterator findPage(const framing::SequenceNumber&);
+    bool find(const framing::SequenceNumber&, QueuedMessage&, bool remove);
+    Page& load(Pages::iterator);
+    bool unload(Page&);
+    void readAhead();
+    void append(Page&, const QueuedMessage&);
+    void erase(Pages::iterator);
+    void encode(const QueuedMessage&, char*) const;
+    QueuedMessage decode(char*, size_t&) const;
+};
+}} // namespace qpid::broker
+
+#endif  /*!QPID_BROKER_PAGEDQUEUE_H*/
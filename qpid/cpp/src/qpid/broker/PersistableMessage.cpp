@@ -22,6 +22,7 @@
 
 #include "qpid/broker/PersistableMessage.h"
 #include "qpid/broker/MessageStore.h"
+#include "qpid/sys/StripedLocks.h"
 #include <iostream>
 
 using namespace qpid::broker;
@@ -31,8 +32,23 @@ namespace broker {
 
 class MessageStore;
 
+namespace {
+sys::StripedLocks<sys::Mutex> asyncDequeueLocks;
+sys::StripedLocks<sys::Mutex> storeLocks;
+}
+
 PersistableMessage::~PersistableMessage() {}
 
+sys::Mutex& PersistableMessage::asyncDequeueLock() const
+{
+    return asyncDequeueLocks.get(this);
+}
+
+sys::Mutex& PersistableMessage::storeLock() const
+{
+    return storeLocks.get(this);
+}
+
 PersistableMessage::PersistableMessage() :
     asyncDequeueCounter(0),
     store(0)
@@ -42,7 +58,7 @@ void PersistableMessage::flush()
 {
     syncList copy;
     {
-        sys::ScopedLock<sys::Mutex> l(storeLock);
+        sys::ScopedLock<sys::Mutex> l(storeLock());
 	if (store) {
 	    copy = synclist;
 	} else {
@@ -81,7 +97,7 @@ bool PersistableMessage::isStoredOnQueue(PersistableQueue::shared_ptr queue){
 
 void PersistableMessage::addToSyncList(PersistableQueue::shared_ptr queue, MessageStore* _store) { 
     if (_store){
-        sys::ScopedLock<sys::Mutex> l(storeLock);
+        sys::ScopedLock<sys::Mutex> l(storeLock());
         store = _store;
         boost::weak_ptr<PersistableQueue> q(queue);
         synclist.push_back(q);
@@ -94,14 +110,14 @@ void PersistableMessage::enqueueAsync(PersistableQueue::shared_ptr queue, Messag
 }
 
 bool PersistableMessage::isDequeueComplete() { 
-    sys::ScopedLock<sys::Mutex> l(asyncDequeueLock);
+    sys::ScopedLock<sys::Mutex> l(asyncDequeueLock());
     return asyncDequeueCounter == 0;
 }
     
 void PersistableMessage::dequeueComplete() { 
     bool notify = false;
     {
-        sys::ScopedLock<sys::Mutex> l(asyncDequeueLock);
+        sys::ScopedLock<sys::Mutex> l(asyncDequeueLock());
         if (asyncDequeueCounter > 0) {
             if (--asyncDequeueCounter == 0) {
                 notify = true;
@@ -113,7 +129,7 @@ void PersistableMessage::dequeueComplete() {
 
 void PersistableMessage::dequeueAsync(PersistableQueue::shared_ptr queue, MessageStore* _store) { 
     if (_store){
-        sys::ScopedLock<sys::Mutex> l(storeLock);
+        sys::ScopedLock<sys::Mutex> l(storeLock());
         store = _store;
         boost::weak_ptr<PersistableQueue> q(queue);
         synclist.push_back(q);
@@ -122,7 +138,7 @@ void PersistableMessage::dequeueAsync(PersistableQueue::shared_ptr queue, Messag
 }
 
 void PersistableMessage::dequeueAsync() { 
-    sys::ScopedLock<sys::Mutex> l(asyncDequeueLock);
+    sys::ScopedLock<sys::Mutex> l(asyncDequeueLock());
     asyncDequeueCounter++; 
 }
 
@@ -30,6 +30,7 @@
 #include "qpid/broker/Persistable.h"
 #include "qpid/framing/amqp_types.h"
 #include "qpid/sys/Mutex.h"
+#include "qpid/sys/Probe.h"
 #include "qpid/broker/PersistableQueue.h"
 #include "qpid/broker/AsyncCompletion.h"
 
@@ -44,8 +45,9 @@ class MessageStore;
 class PersistableMessage : public Persistable
 {
     typedef std::list< boost::weak_ptr<PersistableQueue> > syncList;
-    sys::Mutex asyncDequeueLock;
-    sys::Mutex storeLock;
+    // Striped rather than held per message; see StripedLocks
+    sys::Mutex& asyncDequeueLock() const;
+    sys::Mutex& storeLock() const;
 
     /**
      * "Ingress" messages == messages sent _to_ the broker.
@@ -119,7 +121,15 @@ class PersistableMessage : public Persistable
     QPID_BROKER_INLINE_EXTERN AsyncCompletion& getIngressCompletion() { return ingressCompletion; }
 
     QPID_BROKER_INLINE_EXTERN void enqueueStart() { ingressCompletion.startCompleter(); }
-    QPID_BROKER_INLINE_EXTERN void enqueueComplete() { ingressCompletion.finishCompleter(); }
+    QPID_BROKER_INLINE_EXTERN void enqueueComplete() {
+        QPID_PROBE(store_enqueued, this, 0);
+        ingressCompletion.finishCompleter();
+    }
+    /** As enqueueComplete(), for an enqueue the store could not carry out */
+    QPID_BROKER_INLINE_EXTERN void enqueueFailed(const std::string& error) {
+        ingressCompletion.setError(error);
+        ingressCompletion.finishCompleter();
+    }
 
     QPID_BROKER_EXTERN void enqueueAsync(PersistableQueue::shared_ptr queue,
                                          MessageStore* _store);
@@ -27,48 +27,73 @@
 namespace qpid {
 namespace broker {
 
+namespace {
+const uint BITS = 64;
+
+uint highestBit(uint64_t bits)
+{
+#if defined(__GNUC__)
+    return BITS - 1 - __builtin_clzll(bits);
+#else
+    uint b = 0;
+    while (bits >>= 1) ++b;
+    return b;
+#endif
+}
+
+uint lowestBit(uint64_t bits)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    uint b = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        ++b;
+    }
+    return b;
+#endif
+}
+}
+
 PriorityQueue::PriorityQueue(int l) : 
     levels(l),
     messages(levels, Deque()),
+    occupied((levels + BITS - 1) / BITS, 0),
+    count(0),
     frontLevel(0), haveFront(false), cached(false) {}
 
 size_t PriorityQueue::size()
 {
-    size_t total(0);
-    for (int i = 0; i < levels; ++i) {
-        total += messages[i].size();
-    }
-    return total;
+    return count;
 }
 
 bool PriorityQueue::empty()
 {
-    for (int i = 0; i < levels; ++i) {
-        if (!messages[i].empty()) return false;
-    }
-    return true;
+    return count == 0;
 }
 
 void PriorityQueue::reinsert(const QueuedMessage& message)
 {
     uint p = getPriorityLevel(message);
     messages[p].insert(lower_bound(messages[p].begin(), messages[p].end(), message), message);
+    added(message, p);
     clearCache();
 }
 
 bool PriorityQueue::find(const framing::SequenceNumber& position, QueuedMessage& message, bool remove)
 {
-    QueuedMessage comp;
-    comp.position = position;
-    for (int i = 0; i < levels; ++i) {
-        if (!messages[i].empty()) {
-            unsigned long diff = position.getValue() - messages[i].front().position.getValue();
-            long maxEnd = diff < messages[i].size() ? diff : messages[i].size();        
-            Deque::iterator l = lower_bound(messages[i].begin(),messages[i].begin()+maxEnd,comp);
+    //each level is in position order, so only occupied levels need a
+    //binary search; no per-message index is kept
+    for (uint w = 0; w < occupied.size(); ++w) {
+        for (uint64_t bits = occupied[w]; bits; bits &= bits - 1) {
+            uint i = w * BITS + lowestBit(bits);
+            Deque::iterator l = locate(i, position);
             if (l != messages[i].end() && l->position == position) {
                 message = *l;
                 if (remove) {
                     messages[i].erase(l);
+                    removed(message, i);
                     clearCache();
                 }
                 return true;
@@ -78,6 +103,16 @@ bool PriorityQueue::find(const framing::SequenceNumber& position, QueuedMessage&
     return false;
 }
 
+PriorityQueue::Deque::iterator PriorityQueue::locate(uint i, const framing::SequenceNumber& position)
+{
+    QueuedMessage comp;
+    comp.position = position;
+    if (position < messages[i].front().position) return messages[i].begin();
+    unsigned long diff = position.getValue() - messages[i].front().position.getValue();
+    long maxEnd = diff < messages[i].size() ? diff+1 : messages[i].size();
+    return lower_bound(messages[i].begin(),messages[i].begin()+maxEnd,comp);
+}
+
 bool PriorityQueue::remove(const framing::SequenceNumber& position, QueuedMessage& message)
 {
     return find(position, message, true);
@@ -90,25 +125,20 @@ bool PriorityQueue::find(const framing::SequenceNumber& position, QueuedMessage&
 
 bool PriorityQueue::next(const framing::SequenceNumber& position, QueuedMessage& message)
 {
-    QueuedMessage match;
-    match.position = position+1;
-    Deque::iterator lowest;
+    //the next message is the earliest successor across the occupied levels
+    framing::SequenceNumber after(position);
+    ++after;
     bool found = false;
-    for (int i = 0; i < levels; ++i) {
-        Deque::iterator m = lower_bound(messages[i].begin(), messages[i].end(), match); 
-        if (m != messages[i].end()) {
-            if (m->position == match.position) {
-                message = *m;
-                return true;
-            } else if (!found || m->position < lowest->position) {
-                lowest = m;
+    for (uint w = 0; w < occupied.size(); ++w) {
+        for (uint64_t bits = occupied[w]; bits; bits &= bits - 1) {
+            uint i = w * BITS + lowestBit(bits);
+            Deque::iterator l = locate(i, after);
+            if (l != messages[i].end() && (!found || l->position < message.position)) {
+                message = *l;
                 found = true;
             }
         }
     }
-    if (found) {
-        message = *lowest;
-    }
     return found;
 }
 
@@ -126,6 +156,7 @@ bool PriorityQueue::pop(QueuedMessage& message)
     if (checkFront()) {
         message = messages[frontLevel].front();
         messages[frontLevel].pop_front();
+        removed(message, frontLevel);
         clearCache();
         return true;
     } else {
@@ -133,15 +164,25 @@ bool PriorityQueue::pop(QueuedMessage& message)
     }
 }
 
+QueuedMessage& PriorityQueue::oldest()
+{
+    for (uint w = 0; w < occupied.size(); ++w) {
+        if (occupied[w]) return messages[w * BITS + lowestBit(occupied[w])].front();
+    }
+    throw qpid::framing::InternalErrorException(QPID_MSG("No message available"));
+}
+
 void PriorityQueue::pop()
 {
     QueuedMessage dummy;
     pop(dummy);
 }
 
-bool PriorityQueue::push(const QueuedMessage& added, QueuedMessage& /*not needed*/)
+bool PriorityQueue::push(const QueuedMessage& message, QueuedMessage& /*not needed*/)
 {
-    messages[getPriorityLevel(added)].push_back(added);
+    uint p = getPriorityLevel(message);
+    messages[p].push_back(message);
+    added(message, p);
     clearCache();
     return false;//adding a message never causes one to be removed for deque
 }
@@ -158,7 +199,9 @@ void PriorityQueue::removeIf(Predicate p)
     for (int priority = 0; priority < levels; ++priority) {
         for (Deque::iterator i = messages[priority].begin(); i != messages[priority].end();) {
             if (p(*i)) {
+                QueuedMessage message = *i;
                 i = messages[priority].erase(i);
+                removed(message, priority);
                 clearCache();
             } else {
                 ++i;
@@ -167,6 +210,18 @@ void PriorityQueue::removeIf(Predicate p)
     }
 }
 
+void PriorityQueue::added(const QueuedMessage& message, uint level)
+{
+    occupied[level / BITS] |= uint64_t(1) << (level % BITS);
+    ++count;
+}
+
+void PriorityQueue::removed(const QueuedMessage& message, uint level)
+{
+    if (messages[level].empty()) occupied[level / BITS] &= ~(uint64_t(1) << (level % BITS));
+    --count;
+}
+
 uint PriorityQueue::getPriorityLevel(const QueuedMessage& m) const
 {
     uint priority = m.payload->getPriority();
@@ -182,15 +237,33 @@ void PriorityQueue::clearCache()
     cached = false;
 }
 
-bool PriorityQueue::findFrontLevel(uint& l, PriorityLevels& m)
+bool PriorityQueue::findFrontLevel(uint& l, PriorityLevels&)
 {
-    for (int p = levels-1; p >= 0; --p) {
-        if (!m[p].empty()) {
-            l = p;
-            return true;
-        }
+    return highestOccupiedBelow(levels, l);
+}
+
+bool PriorityQueue::isOccupied(uint level) const
+{
+    return occupied[level / BITS] & (uint64_t(1) << (level % BITS));
+}
+
+bool PriorityQueue::nextOccupiedLevel(uint& p) const
+{
+    return highestOccupiedBelow(p, p) || highestOccupiedBelow(levels, p);
+}
+
+bool PriorityQueue::highestOccupiedBelow(uint limit, uint& level) const
+{
+    if (!limit) return false;
+    uint w = (limit - 1) / BITS;
+    uint64_t bits = occupied[w];
+    if (limit % BITS) bits &= (uint64_t(1) << (limit % BITS)) - 1;
+    while (!bits) {
+        if (!w) return false;
+        bits = occupied[--w];
     }
-    return false;
+    level = w * BITS + highestBit(bits);
+    return true;
 }
 
 bool PriorityQueue::checkFront()
@@ -22,6 +22,7 @@
  *
  */
 #include "qpid/broker/Messages.h"
+#include "qpid/framing/SequenceNumber.h"
 #include "qpid/sys/IntegerTypes.h"
 #include <deque>
 #include <vector>
@@ -48,6 +49,7 @@ class PriorityQueue : public Messages
     bool next(const framing::SequenceNumber&, QueuedMessage&);
 
     QueuedMessage& front();
+    QueuedMessage& oldest();
     void pop();
     bool pop(QueuedMessage&);
     bool push(const QueuedMessage& added, QueuedMessage& removed);
@@ -59,18 +61,32 @@ class PriorityQueue : public Messages
     typedef std::deque<QueuedMessage> Deque;
     typedef std::vector<Deque> PriorityLevels;
     virtual bool findFrontLevel(uint& p, PriorityLevels&);
+    bool isOccupied(uint level) const;
+    /**
+     * Sets p to the highest non-empty level below p or, failing
+     * that, the highest non-empty level.
+     *
+     * @return false if all levels are empty
+     */
+    bool nextOccupiedLevel(uint& p) const;
 
     const int levels;
   private:
     PriorityLevels messages;
+    std::vector<uint64_t> occupied; // one bit per non-empty level
+    size_t count;
     uint frontLevel;
     bool haveFront;
     bool cached;
     
     bool find(const framing::SequenceNumber&, QueuedMessage&, bool remove);
+    Deque::iterator locate(uint level, const framing::SequenceNumber&);
     uint getPriorityLevel(const QueuedMessage&) const;
     void clearCache();
     bool checkFront();
+    bool highestOccupiedBelow(uint limit, uint& level) const;
+    void added(const QueuedMessage&, uint level);
+    void removed(const QueuedMessage&, uint level);
 };
 
 }} // namespace qpid::broker
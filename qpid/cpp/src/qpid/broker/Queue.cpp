@@ -28,6 +28,7 @@
 #include "qpid/broker/LegacyLVQ.h"
 #include "qpid/broker/MessageDeque.h"
 #include "qpid/broker/MessageMap.h"
+#include "qpid/broker/PagedQueue.h"
 #include "qpid/broker/MessageStore.h"
 #include "qpid/broker/NullMessageStore.h"
 #include "qpid/broker/QueueRegistry.h"
@@ -43,16 +44,19 @@
 #include "qpid/framing/FieldTable.h"
 #include "qpid/sys/ClusterSafe.h"
 #include "qpid/sys/Monitor.h"
+#include "qpid/sys/Probe.h"
 #include "qpid/sys/Time.h"
 #include "qpid/types/Variant.h"
 #include "qmf/org/apache/qpid/broker/ArgsQueuePurge.h"
 #include "qmf/org/apache/qpid/broker/ArgsQueueReroute.h"
 
 #include <iostream>
+#include <sstream>
 #include <algorithm>
 #include <functional>
 
 #include <boost/bind.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/intrusive_ptr.hpp>
 
 
@@ -82,12 +86,30 @@ const std::string qpidPersistLastNode("qpid.persist_last_node");
 const std::string qpidVQMatchProperty("qpid.LVQ_key");
 const std::string qpidQueueEventGeneration("qpid.queue_event_generation");
 const std::string qpidAutoDeleteTimeout("qpid.auto_delete_timeout");
+const std::string qpidSplitEnqueueLock("qpid.split_enqueue_lock");
+const std::string qpidLatencyHistogram("qpid.latency_histogram");
+const std::string qpidPartitions("qpid.partitions");
+const std::string qpidPartitionKey("qpid.partition_key");
+const std::string qpidDeliveryTime("qpid.delivery_time");
 //following feature is not ready for general use as it doesn't handle
 //the case where a message is enqueued on more than one queue well enough:
 const std::string qpidInsertSequenceNumbers("qpid.insert_sequence_numbers");
+const std::string qpidDuplicateWindow("qpid.duplicate_window");
+const std::string qpidDuplicateIndexSize("qpid.duplicate_index_size");
+const std::string qpidMessageGroupKey("qpid.group_header_key");
+const uint32_t DEFAULT_DUPLICATE_INDEX_SIZE = 100000;
 
 const int ENQUEUE_ONLY=1;
 const int ENQUEUE_AND_DEQUEUE=2;
+
+bool getMessageId(const Message& msg, std::string& id)
+{
+    const MessageProperties* properties = msg.getProperties<MessageProperties>();
+    if (!properties || !properties->hasMessageId()) return false;
+    const Uuid& uuid = properties->getMessageId();
+    id.assign(reinterpret_cast<const char*>(uuid.data()), uuid.size());
+    return true;
+}
 }
 
 Queue::Queue(const string& _name, bool _autodelete,
@@ -106,18 +128,32 @@ Queue::Queue(const string& _name, bool _autodelete,
     persistLastNode(false),
     inLastNodeFailure(false),
     messages(new MessageDeque()),
+    splitEnqueueLock(false),
+    transferPending(false),
+    requeues(0),
+    batchRecovery(false),
     persistenceId(0),
     policyExceeded(false),
     mgmtObject(0),
     eventMode(0),
+    notifyingObservers(false),
     insertSeqNo(0),
     broker(b),
     deleted(false),
     barrier(*this),
     autoDeleteTimeout(0),
-    allocator(new FifoDistributor( *messages ))
+    allocator(new FifoDistributor( *messages )),
+    spill(0),
+    spilling(false),
+    prefetch(0)
 {
-    if (parent != 0 && broker != 0) {
+    if (broker != 0 && broker->getContentSpill()->isEnabled()) {
+        spill = broker->getContentSpill().get();
+    }
+    if (broker != 0 && store != 0 && broker->getContentPrefetch()->isEnabled()) {
+        prefetch = broker->getContentPrefetch().get();
+    }
+    if (parent != 0 && broker != 0 && !isLightweight()) {
         ManagementAgent* agent = broker->getManagementAgent();
 
         if (agent != 0) {
@@ -129,6 +165,10 @@ Queue::Queue(const string& _name, bool _autodelete,
 
 Queue::~Queue()
 {
+    if (timeInQueueExport) timeInQueueExport->cancel();
+    if (scheduledTask) scheduledTask->cancel();
+    for (Partitions::iterator i = partitions.begin(); i != partitions.end(); ++i)
+        (*i)->mgmtObject = 0;
     if (mgmtObject != 0)
         mgmtObject->resourceDestroy();
 }
@@ -147,15 +187,47 @@ bool Queue::isLocal(boost::intrusive_ptr<Message>& msg)
     return noLocal && (isLocalTo(owner, msg) || isLocalTo(exclusive, msg));
 }
 
+/**
+ * An exclusive auto-delete queue, typically an RPC client's reply queue,
+ * that the broker has been told to keep light: it is not managed and
+ * has only the limits it was declared with.
+ */
+bool Queue::isLightweight() const
+{
+    return broker && owner && autodelete && broker->getOptions().lightweightTempQueues;
+}
+
 bool Queue::isExcluded(boost::intrusive_ptr<Message>& msg)
 {
     return traceExclude.size() && msg->isExcluded(traceExclude);
 }
 
+bool Queue::isDuplicate(boost::intrusive_ptr<Message>& msg)
+{
+    std::string id;
+    if (!duplicates.get() || !getMessageId(*msg, id)) return false;
+    DuplicateIndex::Result result = duplicates->check(id);
+    if (mgmtObject != 0) {
+        mgmtObject->inc_duplicateChecks();
+        if (result == DuplicateIndex::FALSE_POSITIVE) mgmtObject->inc_duplicateFalsePositives();
+        if (result == DuplicateIndex::DUPLICATE) mgmtObject->inc_msgDuplicates();
+    }
+    return result == DuplicateIndex::DUPLICATE;
+}
+
 void Queue::deliver(boost::intrusive_ptr<Message> msg){
+    if (isPartitioned()) {
+        partitionFor(*msg)->deliver(msg);
+        return;
+    }
+    if (prepareDelivery(msg))
+        completeDelivery(msg);
+}
+
+bool Queue::prepareDelivery(boost::intrusive_ptr<Message>& msg){
     // Check for deferred delivery in a cluster.
     if (broker && broker->deferDelivery(name, msg))
-        return;
+        return false;
     if (msg->isImmediate() && getConsumerCount() == 0) {
         if (alternateExchange) {
             DeliverableMessage deliverable(msg);
@@ -167,11 +239,27 @@ void Queue::deliver(boost::intrusive_ptr<Message> msg){
     } else if (isExcluded(msg)) {
         //drop message
         QPID_LOG(info, "Dropping excluded message from " << getName());
+    } else if (isDuplicate(msg)) {
+        //drop message
+        QPID_LOG(debug, "Dropping duplicate message from " << getName());
     } else {
-        enqueue(0, msg);
-        push(msg);
-        QPID_LOG(debug, "Message " << msg << " enqueued on " << name);
+        try {
+            enqueue(0, msg);
+        } catch (...) {
+            // Not enqueued (e.g. rejected by the queue's policy), so a
+            // resend must not be taken for a duplicate
+            std::string id;
+            if (duplicates.get() && getMessageId(*msg, id)) duplicates->forget(id);
+            throw;
+        }
+        return true;
     }
+    return false;
+}
+
+void Queue::completeDelivery(boost::intrusive_ptr<Message>& msg){
+    push(msg);
+    QPID_LOG_FOR(debug, name, "Message " << msg << " enqueued on " << name);
 }
 
 void Queue::recoverPrepared(boost::intrusive_ptr<Message>& msg)
@@ -182,7 +270,13 @@ void Queue::recoverPrepared(boost::intrusive_ptr<Message>& msg)
 void Queue::recover(boost::intrusive_ptr<Message>& msg){
     if (policy.get()) policy->recoverEnqueued(msg);
 
-    push(msg, true);
+    if (!batchRecovery) {
+        push(msg, true);
+    } else if (!schedule(msg)) {
+        Mutex::ScopedLock locker(messageLock);
+        recovered.push_back(QueuedMessage(this, msg, ++sequence));
+        if (insertSeqNo) msg->insertCustomProperty(seqNoKey, sequence);
+    }
     if (store){
         // setup synclist for recovered messages, so they don't get re-stored on lastNodeFailure
         msg->addToSyncList(shared_from_this(), store);
@@ -199,6 +293,39 @@ void Queue::recover(boost::intrusive_ptr<Message>& msg){
     }
 }
 
+void Queue::beginRecoveryBatch()
+{
+    Mutex::ScopedLock locker(messageLock);
+    batchRecovery = !dynamic_cast<RingQueuePolicy*>(policy.get());
+}
+
+void Queue::endRecoveryBatch()
+{
+    QueueListeners::NotificationSet copy;
+    {
+        Mutex::ScopedLock locker(messageLock);
+        if (!batchRecovery) return;
+        batchRecovery = false;
+        std::deque<QueuedMessage> batch;
+        batch.swap(recovered);
+        std::deque<QueuedMessage> removed;
+        messages->append(batch, removed);
+        for (std::deque<QueuedMessage>::iterator i = batch.begin(); i != batch.end(); ++i) {
+            QPID_PROBE(message_enqueued, i->payload.get(), this);
+            observeEnqueue(*i, locker);
+        }
+        // As in append(), the store is not told of these until
+        // recovery is complete
+        for (std::deque<QueuedMessage>::iterator i = removed.begin(); i != removed.end(); ++i) {
+            observeAcquire(*i, locker);
+            pendingDequeues.push_back(*i);
+        }
+        listeners.populate(copy);
+    }
+    copy.notify();
+    notifyObservers();
+}
+
 void Queue::process(boost::intrusive_ptr<Message>& msg){
     push(msg);
     if (mgmtObject != 0){
@@ -225,8 +352,10 @@ void Queue::requeue(const QueuedMessage& msg){
             }
         }
         observeRequeue(msg, locker);
+        indexExpiry(msg, locker);
     }
     copy.notify();
+    notifyObservers();
 }
 
 bool Queue::acquireMessageAt(const SequenceNumber& position, QueuedMessage& message)
@@ -235,10 +364,10 @@ bool Queue::acquireMessageAt(const SequenceNumber& position, QueuedMessage& mess
     assertClusterSafe();
     QPID_LOG(debug, "Attempting to acquire message at " << position);
     if (acquire(position, message, locker)) {
-        QPID_LOG(debug, "Acquired message at " << position << " from " << name);
+        QPID_LOG_FOR(debug, name, "Acquired message at " << position << " from " << name);
         return true;
     } else {
-        QPID_LOG(debug, "Could not acquire message at " << position << " from " << name << "; no message at that position");
+        QPID_LOG_FOR(debug, name, "Could not acquire message at " << position << " from " << name << "; no message at that position");
         return false;
     }
 }
@@ -250,16 +379,16 @@ bool Queue::acquire(const QueuedMessage& msg, const std::string& consumer)
     QPID_LOG(debug, consumer << " attempting to acquire message at " << msg.position);
 
     if (!allocator->allocate( consumer, msg )) {
-        QPID_LOG(debug, "Not permitted to acquire msg at " << msg.position << " from '" << name);
+        QPID_LOG_FOR(debug, name, "Not permitted to acquire msg at " << msg.position << " from '" << name);
         return false;
     }
 
     QueuedMessage copy(msg);
     if (acquire( msg.position, copy, locker)) {
-        QPID_LOG(debug, "Acquired message at " << msg.position << " from " << name);
+        QPID_LOG_FOR(debug, name, "Acquired message at " << msg.position << " from " << name);
         return true;
     }
-    QPID_LOG(debug, "Could not acquire message at " << msg.position << " from " << name << "; no message at that position");
+    QPID_LOG_FOR(debug, name, "Could not acquire message at " << msg.position << " from " << name << "; no message at that position");
     return false;
 }
 
@@ -279,76 +408,127 @@ void Queue::notifyListener()
 bool Queue::getNextMessage(QueuedMessage& m, Consumer::shared_ptr& c)
 {
     checkNotDeleted();
+    bool found = false;
     if (c->preAcquires()) {
         switch (consumeNextMessage(m, c)) {
           case CONSUMED:
-            return true;
+            found = true;
+            break;
           case CANT_CONSUME:
+          case NO_MATCH:
             notifyListener();//let someone else try
           case NO_MESSAGES:
           default:
-            return false;
+            break;
         }
     } else {
-        return browseNextMessage(m, c);
+        found = browseNextMessage(m, c);
     }
+    dequeueDisplaced();
+    notifyObservers();
+    return found;
 }
 
 Queue::ConsumeCode Queue::consumeNextMessage(QueuedMessage& m, Consumer::shared_ptr& c)
 {
+    Mutex::ScopedLock locker(messageLock);
+    return consumeNextMessage(m, c, locker);
+}
+
+Queue::ConsumeCode Queue::consumeNextMessage(QueuedMessage& m, Consumer::shared_ptr& c,
+                                             const Mutex::ScopedLock& locker)
+{
+    if (splitEnqueueLock) transferIncoming(locker);
     while (true) {
-        Mutex::ScopedLock locker(messageLock);
         QueuedMessage msg;
 
         if (!allocator->nextConsumableMessage(c, msg)) { // no next available
-            QPID_LOG(debug, "No messages available to dispatch to consumer " <<
-                     c->getName() << " on queue '" << name << "'");
+            QPID_LOG_FOR(debug, name, "No messages available to dispatch to consumer " <<
+                         c->getName() << " on queue '" << name << "'");
             listeners.addListener(c);
             return NO_MESSAGES;
         }
 
         if (msg.payload->hasExpired()) {
-            QPID_LOG(debug, "Message expired from queue '" << name << "'");
+            QPID_LOG_FOR(debug, name, "Message expired from queue '" << name << "'");
             c->position = msg.position;
             acquire( msg.position, msg, locker);
-            dequeue( 0, msg );
+            dequeueMessage( 0, msg );
             continue;
         }
 
         // a message is available for this consumer - can the consumer use it?
 
-        if (c->filter(msg.payload)) {
-            if (c->accept(msg.payload)) {
-                bool ok = allocator->allocate( c->getName(), msg );  // inform allocator
-                (void) ok; assert(ok);
-                ok = acquire( msg.position, msg, locker);
-                (void) ok; assert(ok);
-                m = msg;
-                c->position = m.position;
-                return CONSUMED;
-            } else {
-                //message(s) are available but consumer hasn't got enough credit
-                QPID_LOG(debug, "Consumer can't currently accept message from '" << name << "'");
-                return CANT_CONSUME;
+        if (!c->filter(msg.payload)) {
+            //consumer doesn't want this message, look further back for one it does
+            SequenceNumber scanned(msg.position);
+            // The consumer's last scan rejected everything up to its
+            // position; resume from there unless a requeue or a change
+            // of group ownership may have made one of those available
+            uint32_t generation = scanGeneration();
+            if (c->scanGeneration == generation && scanned < c->position) scanned = c->position;
+            c->scanGeneration = generation;
+            if (!nextMatchingMessage(c, msg, scanned, locker)) {
+                QPID_LOG_FOR(debug, name, "Consumer doesn't want any message from '" << name << "'");
+                // Pass on what this consumer skipped, but only once per
+                // arrival so that selective consumers don't wake each
+                // other forever
+                bool skippedNew = c->position < scanned;
+                c->position = scanned;
+                listeners.addListener(c);
+                return skippedNew ? NO_MATCH : NO_MESSAGES;
             }
+        }
+        if (c->accept(msg.payload)) {
+            // Only now does the consumer own the message's group, if any
+            bool ok = allocator->allocate( c->getName(), msg );  // inform allocator
+            (void) ok; assert(ok);
+            ok = acquire( msg.position, msg, locker);
+            (void) ok; assert(ok);
+            m = msg;
+            c->position = m.position;
+            c->scanGeneration = scanGeneration();
+            restoreAhead(m.position, locker);
+            prefetchAhead(m.position, locker);
+            return CONSUMED;
         } else {
-            //consumer will never want this message
-            QPID_LOG(debug, "Consumer doesn't want message from '" << name << "'");
-            c->position = msg.position;
+            //message(s) are available but consumer hasn't got enough credit
+            QPID_LOG_FOR(debug, name, "Consumer can't currently accept message from '" << name << "'");
             return CANT_CONSUME;
         }
     }
 }
 
+uint32_t Queue::scanGeneration() const
+{
+    return requeues + allocator->ownershipChanges();
+}
+
+bool Queue::nextMatchingMessage(Consumer::shared_ptr& c, QueuedMessage& msg, SequenceNumber& scanned,
+                                const Mutex::ScopedLock&)
+{
+    QueuedMessage candidate;
+    while (messages->next(scanned, candidate)) {
+        scanned = candidate.position;
+        if (!candidate.payload->hasExpired() && c->filter(candidate.payload) &&
+            allocator->canAllocate(c->getName(), candidate)) {
+            msg = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
 bool Queue::browseNextMessage(QueuedMessage& m, Consumer::shared_ptr& c)
 {
     while (true) {
         Mutex::ScopedLock locker(messageLock);
+        if (splitEnqueueLock) transferIncoming(locker);
         QueuedMessage msg;
 
         if (!allocator->nextBrowsableMessage(c, msg)) { // no next available
-            QPID_LOG(debug, "No browsable messages available for consumer " <<
-                     c->getName() << " on queue '" << name << "'");
+            QPID_LOG_FOR(debug, name, "No browsable messages available for consumer " <<
+                         c->getName() << " on queue '" << name << "'");
             listeners.addListener(c);
             return false;
         }
@@ -358,21 +538,69 @@ bool Queue::browseNextMessage(QueuedMessage& m, Consumer::shared_ptr& c)
                 //consumer wants the message
                 c->position = msg.position;
                 m = msg;
+                restoreAhead(m.position, locker);
                 return true;
             } else {
                 //browser hasn't got enough credit for the message
-                QPID_LOG(debug, "Browser can't currently accept message from '" << name << "'");
+                QPID_LOG_FOR(debug, name, "Browser can't currently accept message from '" << name << "'");
                 return false;
             }
         } else {
             //consumer will never want this message, continue seeking
-            QPID_LOG(debug, "Browser skipping message from '" << name << "'");
+            QPID_LOG_FOR(debug, name, "Browser skipping message from '" << name << "'");
             c->position = msg.position;
         }
     }
     return false;
 }
 
+void Queue::restoreAhead(const SequenceNumber& position, const Mutex::ScopedLock&)
+{
+    if (!spilling || !spill) return;
+    SequenceNumber ahead(position + spill->getWindow() / 2);
+    if (spillPosition < ahead) return;  // nothing that far back has been spilled
+    QueuedMessage msg;
+    if (messages->next(ahead, msg) && msg.payload->isContentSpilled()) {
+        spill->restore(msg.payload);
+    }
+}
+
+void Queue::prefetchAhead(const SequenceNumber& position, const Mutex::ScopedLock&)
+{
+    if (!prefetch) return;
+    // Each message is looked at once, as it comes within the depth
+    SequenceNumber end(position + prefetch->getDepth());
+    SequenceNumber next(prefetchPosition < position ? position : prefetchPosition);
+    QueuedMessage msg;
+    while (next < end && messages->next(next, msg) && !(end < msg.position)) {
+        next = msg.position;
+        if (msg.payload->isContentInStore()) prefetch->load(shared_from_this(), msg.payload);
+    }
+    prefetchPosition = next;
+}
+
+uint64_t Queue::collectSpillable(uint32_t window, uint64_t minContent, uint64_t max,
+                                 std::vector<boost::intrusive_ptr<Message> >& batch)
+{
+    Mutex::ScopedLock locker(messageLock);
+    if (messages->size() <= window) return 0;
+    SequenceNumber position(messages->front().position + window);
+    if (spilling && position < spillPosition) position = spillPosition;
+    uint64_t collected = 0;
+    QueuedMessage msg;
+    while (collected < max && messages->next(position, msg)) {
+        position = msg.position;
+        uint64_t size = msg.payload->contentSize();
+        if (size >= minContent && !msg.payload->isContentSpilled()) {
+            batch.push_back(msg.payload);
+            collected += size;
+        }
+    }
+    spillPosition = position;
+    spilling = true;
+    return collected;
+}
+
 void Queue::removeListener(Consumer::shared_ptr c)
 {
     QueueListeners::NotificationSet set;
@@ -390,6 +618,7 @@ bool Queue::dispatch(Consumer::shared_ptr c)
 {
     QueuedMessage msg(this);
     if (getNextMessage(msg, c)) {
+        QPID_PROBE(message_dispatched, msg.payload.get(), this);
         c->deliver(msg);
         return true;
     } else {
@@ -397,6 +626,44 @@ bool Queue::dispatch(Consumer::shared_ptr c)
     }
 }
 
+size_t Queue::dispatch(Consumer::shared_ptr c, size_t max)
+{
+    if (max <= 1 || !c->preAcquires()) return dispatch(c) ? 1 : 0;
+
+    checkNotDeleted();
+    std::vector<QueuedMessage> batch;
+    batch.reserve(max);
+    ConsumeCode code = NO_MESSAGES;
+    {
+        Mutex::ScopedLock locker(messageLock);
+        while (batch.size() < max) {
+            QueuedMessage msg(this);
+            code = consumeNextMessage(msg, c, locker);
+            if (code != CONSUMED) break;
+            batch.push_back(msg);
+        }
+    }
+    if (code == CANT_CONSUME || code == NO_MATCH) notifyListener();//let someone else try
+    dequeueDisplaced();
+    notifyObservers();
+    std::vector<QueuedMessage>::iterator i = batch.begin();
+    try {
+        for (; i != batch.end(); ++i) {
+            QPID_PROBE(message_dispatched, i->payload.get(), this);
+            c->deliver(*i);
+        }
+    } catch (...) {
+        //put back the failed message and anything after it, last first
+        //so that the original order is kept, with the consumer's credit
+        for (std::vector<QueuedMessage>::reverse_iterator r = batch.rbegin(); r.base() != i; ++r) {
+            c->unaccept(r->payload);
+            requeue(*r);
+        }
+        throw;
+    }
+    return batch.size();
+}
+
 bool Queue::find(SequenceNumber pos, QueuedMessage& msg) const {
 
     Mutex::ScopedLock locker(messageLock);
@@ -429,11 +696,14 @@ void Queue::consume(Consumer::shared_ptr c, bool requestExclusive){
         }
     }
     Mutex::ScopedLock locker(messageLock);
-    for (Observers::const_iterator i = observers.begin(); i != observers.end(); ++i) {
-        try{
-            (*i)->consumerAdded(*c);
-        } catch (const std::exception& e) {
-            QPID_LOG(warning, "Exception on notification of new consumer for queue " << getName() << ": " << e.what());
+    const Observers* all[] = { &observers, &deferredObservers };
+    for (size_t s = 0; s < 2; ++s) {
+        for (Observers::const_iterator i = all[s]->begin(); i != all[s]->end(); ++i) {
+            try{
+                (*i)->consumerAdded(*c);
+            } catch (const std::exception& e) {
+                QPID_LOG(warning, "Exception on notification of new consumer for queue " << getName() << ": " << e.what());
+            }
         }
     }
 }
@@ -448,30 +718,74 @@ void Queue::cancel(Consumer::shared_ptr c){
             mgmtObject->dec_consumerCount ();
     }
     Mutex::ScopedLock locker(messageLock);
-    for (Observers::const_iterator i = observers.begin(); i != observers.end(); ++i) {
-        try{
-            (*i)->consumerRemoved(*c);
-        } catch (const std::exception& e) {
-            QPID_LOG(warning, "Exception on notification of removed consumer for queue " << getName() << ": " << e.what());
+    const Observers* all[] = { &observers, &deferredObservers };
+    for (size_t s = 0; s < 2; ++s) {
+        for (Observers::const_iterator i = all[s]->begin(); i != all[s]->end(); ++i) {
+            try{
+                (*i)->consumerRemoved(*c);
+            } catch (const std::exception& e) {
+                QPID_LOG(warning, "Exception on notification of removed consumer for queue " << getName() << ": " << e.what());
+            }
         }
     }
 }
 
 QueuedMessage Queue::get(){
-    Mutex::ScopedLock locker(messageLock);
     QueuedMessage msg(this);
-    if (messages->pop(msg))
-        observeAcquire(msg, locker);
+    {
+        Mutex::ScopedLock locker(messageLock);
+        if (splitEnqueueLock) transferIncoming(locker);
+        if (messages->pop(msg))
+            observeAcquire(msg, locker);
+    }
+    dequeueDisplaced();
+    notifyObservers();
     return msg;
 }
 
-bool collect_if_expired(std::deque<QueuedMessage>& expired, QueuedMessage& message)
+namespace {
+typedef std::multimap<AbsTime, SequenceNumber> ExpiryIndex;
+
+void indexIfExpiring(ExpiryIndex* index, const QueuedMessage& message)
 {
-    if (message.payload->hasExpired()) {
-        expired.push_back(message);
-        return true;
-    } else {
-        return false;
+    AbsTime expiration = message.payload->getExpiration();
+    if (expiration < FAR_FUTURE)
+        index->insert(ExpiryIndex::value_type(expiration, message.position));
+}
+}
+
+void Queue::indexExpiry(const QueuedMessage& msg, const Mutex::ScopedLock&)
+{
+    indexIfExpiring(&expiryIndex, msg);
+}
+
+/**
+ * Removes the messages in the index whose expiration has passed, so the
+ * cost follows the number expiring rather than the depth of the
+ * queue. The message's expiry policy still decides whether it has
+ * expired; entries it declines are kept for a later sweep.
+ */
+void Queue::collectExpired(std::deque<QueuedMessage>& expired, const Mutex::ScopedLock&)
+{
+    AbsTime now = AbsTime::now();
+    ExpiryIndex::iterator i = expiryIndex.begin();
+    while (i != expiryIndex.end() && i->first < now) {
+        QueuedMessage message;
+        if (messages->find(i->second, message)) {
+            if (!message.payload->hasExpired()) {
+                ++i;
+                continue;
+            }
+            messages->remove(i->second, message);
+            expired.push_back(message);
+        }
+        expiryIndex.erase(i++);
+    }
+    // Entries left behind by consumed messages are only otherwise dropped
+    // once they expire, so rebuild the index when they dominate it.
+    if (expiryIndex.size() > 2 * messages->size()) {
+        expiryIndex.clear();
+        messages->foreach(boost::bind(&indexIfExpiring, &expiryIndex, _1));
     }
 }
 
@@ -490,7 +804,7 @@ void Queue::purgeExpired(qpid::sys::Duration lapse)
         std::deque<QueuedMessage> expired;
         {
             Mutex::ScopedLock locker(messageLock);
-            messages->removeIf(boost::bind(&collect_if_expired, boost::ref(expired), _1));
+            collectExpired(expired, locker);
         }
 
         for (std::deque<QueuedMessage>::const_iterator i = expired.begin();
@@ -501,6 +815,9 @@ void Queue::purgeExpired(qpid::sys::Duration lapse)
             }
             dequeue( 0, *i );
         }
+        if (mgmtObject != 0)
+            mgmtObject->set_msgExpiredLastSweep(expired.size());
+        notifyObservers();
     }
 }
 
@@ -586,7 +903,7 @@ namespace {
     struct Collector {
         const uint32_t maxMatches;
         MessageFilter& filter;
-        std::deque<QueuedMessage> matches;
+        std::vector<QueuedMessage> matches;
         Collector(MessageFilter& filter, uint32_t max)
             : maxMatches(max), filter(filter) {}
         bool operator() (QueuedMessage& qm)
@@ -622,24 +939,62 @@ namespace {
 uint32_t Queue::purge(const uint32_t purge_request, boost::shared_ptr<Exchange> dest,
                       const qpid::types::Variant::Map *filter)
 {
+    if (isPartitioned()) {
+        uint32_t purged = 0;
+        for (Partitions::iterator i = partitions.begin(); i != partitions.end(); ++i) {
+            purged += (*i)->purge(purge_request ? purge_request - purged : 0, dest, filter);
+            if (purge_request && purged >= purge_request) break;
+        }
+        return purged;
+    }
     std::auto_ptr<MessageFilter> mf(MessageFilter::create(filter));
     Collector c(*mf.get(), purge_request);
+    collect(c);
 
-    Mutex::ScopedLock locker(messageLock);
-    messages->removeIf( boost::bind<bool>(boost::ref(c), _1) );
-    for (std::deque<QueuedMessage>::iterator qmsg = c.matches.begin();
-         qmsg != c.matches.end(); ++qmsg) {
-        // Update observers and message state:
-        observeAcquire(*qmsg, locker);
-        dequeue(0, *qmsg);
-        // now reroute if necessary
-        if (dest.get()) {
+    // now reroute if necessary
+    if (dest.get()) {
+        for (std::vector<QueuedMessage>::iterator qmsg = c.matches.begin();
+             qmsg != c.matches.end(); ++qmsg) {
             assert(qmsg->payload);
             DeliverableMessage dmsg(qmsg->payload);
             dest->routeWithAlternate(dmsg);
         }
     }
-    return c.matches.size();
+    dequeueBatch(0, c.matches);
+    uint32_t purged = c.matches.size();
+
+    // Messages held for their delivery time are on the queue too, though
+    // its observers have not yet seen them
+    std::vector<boost::intrusive_ptr<Message> > held;
+    {
+        Mutex::ScopedLock locker(messageLock);
+        for (Scheduled::iterator i = scheduled.begin();
+             i != scheduled.end() && (!purge_request || purged + held.size() < purge_request);) {
+            if (mf->match(QueuedMessage(this, i->second, 0))) {
+                held.push_back(i->second);
+                if (policy.get()) policy->enqueueAborted(i->second);
+                scheduled.erase(i++);
+            } else {
+                ++i;
+            }
+        }
+        if (!held.empty()) scheduleTask(locker);
+    }
+    for (std::vector<boost::intrusive_ptr<Message> >::iterator i = held.begin(); i != held.end(); ++i) {
+        if (dest.get()) {
+            DeliverableMessage dmsg(*i);
+            dest->routeWithAlternate(dmsg);
+        }
+        QueuedMessage qm(this, *i, 0);
+        if (isStoreDequeue(qm)) {
+            ScopedUse u(barrier);
+            if (!u.acquired) continue;
+            (*i)->dequeueAsync(shared_from_this(), store);
+            boost::intrusive_ptr<PersistableMessage> pmsg = boost::static_pointer_cast<PersistableMessage>(*i);
+            store->dequeue(0, pmsg, *this);
+        }
+    }
+    return purged + held.size();
 }
 
 uint32_t Queue::move(const Queue::shared_ptr destq, uint32_t qty,
@@ -647,20 +1002,71 @@ uint32_t Queue::move(const Queue::shared_ptr destq, uint32_t qty,
 {
     std::auto_ptr<MessageFilter> mf(MessageFilter::create(filter));
     Collector c(*mf.get(), qty);
+    collect(c);
 
+    // Enqueued on the destination before they are dequeued here
+    std::vector<boost::intrusive_ptr<Message> > moved;
+    moved.reserve(c.matches.size());
+    for (std::vector<QueuedMessage>::iterator qmsg = c.matches.begin();
+         qmsg != c.matches.end(); ++qmsg) {
+        assert(qmsg->payload);
+        moved.push_back(qmsg->payload);
+    }
+    destq->deliverBatch(moved);
+    dequeueBatch(0, c.matches);
+    return c.matches.size();
+}
+
+/**
+ * Removes the messages the collector matches in one pass and updates
+ * observers, leaving the store dequeue to the caller so that it can
+ * be made in a batch outside messageLock.
+ */
+template <class C> void Queue::collect(C& c)
+{
     Mutex::ScopedLock locker(messageLock);
     messages->removeIf( boost::bind<bool>(boost::ref(c), _1) );
-
-    for (std::deque<QueuedMessage>::iterator qmsg = c.matches.begin();
+    for (typename std::vector<QueuedMessage>::iterator qmsg = c.matches.begin();
          qmsg != c.matches.end(); ++qmsg) {
-        // Update observers and message state:
         observeAcquire(*qmsg, locker);
-        dequeue(0, *qmsg);
-        // and move to destination Queue.
-        assert(qmsg->payload);
-        destq->deliver(qmsg->payload);
     }
-    return c.matches.size();
+}
+
+/**
+ * As deliver() for each message, but with one acquisition of
+ * messageLock and one notification of listeners for the lot.
+ */
+void Queue::deliverBatch(std::vector<boost::intrusive_ptr<Message> >& msgs)
+{
+    if (isPartitioned() || splitEnqueueLock) {
+        for (std::vector<boost::intrusive_ptr<Message> >::iterator i = msgs.begin(); i != msgs.end(); ++i)
+            deliver(*i);
+        return;
+    }
+    std::vector<boost::intrusive_ptr<Message> > accepted;
+    accepted.reserve(msgs.size());
+    for (std::vector<boost::intrusive_ptr<Message> >::iterator i = msgs.begin(); i != msgs.end(); ++i) {
+        if (prepareDelivery(*i) && !schedule(*i)) accepted.push_back(*i);
+    }
+    QueueListeners::NotificationSet copy;
+    std::vector<QueuedMessage> replaced;
+    {
+        Mutex::ScopedLock locker(messageLock);
+        for (std::vector<boost::intrusive_ptr<Message> >::iterator i = accepted.begin(); i != accepted.end(); ++i) {
+            QPID_PROBE(message_enqueued, i->get(), this);
+            QueuedMessage qm(this, *i, ++sequence);
+            if (insertSeqNo) (*i)->insertCustomProperty(seqNoKey, sequence);
+            QueuedMessage removed;
+            if (messages->push(qm, removed)) {
+                observeAcquire(removed, locker);
+                replaced.push_back(removed);
+            }
+            observeEnqueue(qm, locker);
+        }
+        listeners.populate(copy);
+    }
+    copy.notify();
+    dequeueBatch(0, replaced);
 }
 
 /** Acquire the front (oldest) message from the in-memory queue.
@@ -689,20 +1095,43 @@ bool Queue::acquire(const qpid::framing::SequenceNumber& position, QueuedMessage
 }
 
 void Queue::push(boost::intrusive_ptr<Message>& msg, bool isRecovery){
+    if (!schedule(msg)) append(msg, isRecovery);
+}
+
+void Queue::append(boost::intrusive_ptr<Message>& msg, bool isRecovery){
     assertClusterSafe();
+    QPID_PROBE(message_enqueued, msg.get(), this);
+    if (splitEnqueueLock && !isRecovery) {
+        stage(msg);
+        return;
+    }
     QueueListeners::NotificationSet copy;
     QueuedMessage removed;
     bool dequeueRequired = false;
+    QueuedMessage qm;
+    Consumer::shared_ptr direct;
     {
         Mutex::ScopedLock locker(messageLock);
-        QueuedMessage qm(this, msg, ++sequence);
+        qm = QueuedMessage(this, msg, ++sequence);
         if (insertSeqNo) msg->insertCustomProperty(seqNoKey, sequence);
 
-        dequeueRequired = messages->push(qm, removed);
-        if (dequeueRequired)
-            observeAcquire(removed, locker);
-        listeners.populate(copy);
-        observeEnqueue(qm, locker);
+        if (!isRecovery && (direct = handoff(qm, locker))) {
+            observeEnqueue(qm, locker);
+            observeAcquire(qm, locker);
+            ++dequeueSincePurge;
+        } else {
+            dequeueRequired = messages->push(qm, removed);
+            if (dequeueRequired)
+                observeAcquire(removed, locker);
+            listeners.populate(copy);
+            observeEnqueue(qm, locker);
+        }
+    }
+    if (direct) {
+        QPID_PROBE(message_dispatched, msg.get(), this);
+        notifyObservers();
+        direct->deliver(qm);
+        return;
     }
     copy.notify();
     if (dequeueRequired) {
@@ -714,6 +1143,188 @@ void Queue::push(boost::intrusive_ptr<Message>& msg, bool isRecovery){
             dequeue(0, removed);
         }
     }
+    notifyObservers();
+}
+
+/**
+ * Lock elision for request/response traffic: when a message is
+ * published on the connection of the only consumer of an exclusive
+ * queue, while that consumer waits on the empty queue, the publishing
+ * thread is also the consumer's IO thread. The message is then handed
+ * to the consumer as acquired, without entering the queue's message
+ * container or scheduling the consumer's output.
+ * @return the consumer to deliver to, if the message can be handed off
+ */
+Consumer::shared_ptr Queue::handoff(const QueuedMessage& qm, const Mutex::ScopedLock&)
+{
+    Consumer::shared_ptr c;
+    if ((!owner && !exclusive) || splitEnqueueLock || !messages->empty()) return c;
+    c = listeners.soleConsumer();
+    // An expired message is left to the queue, which drops it as usual.
+    // Allocation is checked before accept() takes credit, and made after.
+    if (!c || !c->getSession() || !c->getSession()->isLocal(qm.payload->getPublisher()) ||
+        qm.payload->hasExpired() || !c->filter(qm.payload) ||
+        !allocator->canAllocate(c->getName(), qm) || !c->accept(qm.payload)) {
+        return Consumer::shared_ptr();
+    }
+    bool ok = allocator->allocate(c->getName(), qm);
+    (void) ok; assert(ok);
+    listeners.removeListener(c);
+    c->position = qm.position;
+    return c;
+}
+
+/**
+ * Enqueue path used when qpid.split_enqueue_lock is set: the message
+ * is appended to the incoming list under enqueueLock only. The first
+ * producer to find no transfer pending takes messageLock and moves
+ * everything staged so far onto the queue, so concurrent producers do
+ * not serialise on messageLock and consumers pick up whole batches.
+ */
+void Queue::stage(boost::intrusive_ptr<Message>& msg)
+{
+    bool transfer = false;
+    {
+        Mutex::ScopedLock locker(enqueueLock);
+        QueuedMessage qm(this, msg, ++sequence);
+        if (insertSeqNo) msg->insertCustomProperty(seqNoKey, sequence);
+        incoming.push_back(qm);
+        if (!transferPending) transfer = transferPending = true;
+    }
+    if (transfer) {
+        QueueListeners::NotificationSet copy;
+        {
+            Mutex::ScopedLock locker(messageLock);
+            transferIncoming(locker);
+            listeners.populate(copy);
+        }
+        copy.notify();
+        dequeueDisplaced();
+        notifyObservers();
+    }
+}
+
+/**
+ * Moves staged messages onto the queue's message container,
+ * expects messageLock to be held. Messages the moves displace are
+ * left for dequeueDisplaced().
+ */
+void Queue::transferIncoming(const Mutex::ScopedLock& locker)
+{
+    std::deque<QueuedMessage> batch;
+    {
+        Mutex::ScopedLock l(enqueueLock);
+        batch.swap(incoming);
+        transferPending = false;
+    }
+    for (std::deque<QueuedMessage>::iterator i = batch.begin(); i != batch.end(); ++i) {
+        QueuedMessage removed;
+        if (messages->push(*i, removed)) {
+            observeAcquire(removed, locker);
+            displaced.push_back(removed);
+        }
+        observeEnqueue(*i, locker);
+    }
+}
+
+/**
+ * Dequeues the messages transferIncoming() displaced, which it leaves
+ * to be done without messageLock, as append() does. Observers are left
+ * to the caller's notifyObservers().
+ */
+void Queue::dequeueDisplaced()
+{
+    if (!splitEnqueueLock) return;
+    std::vector<QueuedMessage> batch;
+    {
+        Mutex::ScopedLock locker(messageLock);
+        batch.swap(displaced);
+    }
+    for (std::vector<QueuedMessage>::iterator i = batch.begin(); i != batch.end(); ++i)
+        dequeueMessage(0, *i);
+}
+
+namespace {
+class ScheduledDeliveryTask : public qpid::sys::TimerTask
+{
+  public:
+    ScheduledDeliveryTask(AbsTime due, const Queue::shared_ptr& q)
+        : TimerTask(due, "ScheduledDelivery"), queue(q) {}
+
+    void fire()
+    {
+        Queue::shared_ptr q = queue.lock();
+        if (q) q->releaseScheduled();
+    }
+
+  private:
+    boost::weak_ptr<Queue> queue;
+};
+}
+
+/**
+ * Holds the message aside if it carries a delivery time that has not
+ * yet come. Messages without the header cost one header lookup.
+ */
+bool Queue::schedule(boost::intrusive_ptr<Message>& msg)
+{
+    const MessageProperties* props = msg->getProperties<MessageProperties>();
+    if (!props || !props->hasApplicationHeaders()) return false;
+    int64_t due = props->getApplicationHeaders().getAsInt64(qpidDeliveryTime);
+    if (due <= 0) return false;
+    if (broker && broker->isInCluster()) {
+        // Each broker would release it by its own clock, so not cluster safe
+        if (!deliveryTimeIgnored.boolCompareAndSwap(0, 1)) return false;
+        QPID_LOG(warning, "Queue " << name << ": " << qpidDeliveryTime
+                 << " is ignored by clustered brokers, messages are delivered at once");
+        return false;
+    }
+    AbsTime dueTime(EPOCH, due * TIME_MSEC);
+    if (!(AbsTime::now() < dueTime)) return false;
+
+    Mutex::ScopedLock locker(messageLock);
+    bool earliest = scheduled.empty() || dueTime < scheduled.begin()->first;
+    scheduled.insert(Scheduled::value_type(dueTime, msg));
+    if (earliest) scheduleTask(locker);
+    QPID_LOG_FOR(debug, name, "Message " << msg << " scheduled for delivery on " << name << " at " << dueTime);
+    return true;
+}
+
+/** (Re)arms the timer task for the earliest scheduled message */
+void Queue::scheduleTask(const Mutex::ScopedLock&)
+{
+    if (scheduledTask) scheduledTask->cancel();
+    scheduledTask = 0;
+    if (scheduled.empty() || !broker) return;
+    scheduledTask = new ScheduledDeliveryTask(scheduled.begin()->first, shared_from_this());
+    broker->getTimer().add(scheduledTask);
+}
+
+void Queue::releaseScheduled()
+{
+    releaseScheduled(AbsTime::now());
+}
+
+void Queue::releaseScheduled(AbsTime until)
+{
+    std::vector<boost::intrusive_ptr<Message> > due;
+    {
+        Mutex::ScopedLock locker(messageLock);
+        Scheduled::iterator end = scheduled.upper_bound(until);
+        for (Scheduled::iterator i = scheduled.begin(); i != end; ++i)
+            due.push_back(i->second);
+        scheduled.erase(scheduled.begin(), end);
+        scheduleTask(locker);
+    }
+    // Appended as if they had just arrived, so they follow what is already queued
+    for (std::vector<boost::intrusive_ptr<Message> >::iterator i = due.begin(); i != due.end(); ++i)
+        append(*i);
+}
+
+uint32_t Queue::getScheduledCount() const
+{
+    Mutex::ScopedLock locker(messageLock);
+    return scheduled.size();
 }
 
 void isEnqueueComplete(uint32_t* result, const QueuedMessage& message)
@@ -730,20 +1341,51 @@ uint32_t Queue::getEnqueueCompleteMessageCount() const
     return count;
 }
 
+uint32_t Queue::getEnqueueCount() const
+{
+    if (isPartitioned()) {
+        uint32_t count = 0;
+        for (Partitions::const_iterator i = partitions.begin(); i != partitions.end(); ++i)
+            count += (*i)->getEnqueueCount();
+        return count;
+    }
+    Mutex::ScopedLock locker(splitEnqueueLock ? enqueueLock : messageLock);
+    return sequence.getValue();
+}
+
 uint32_t Queue::getMessageCount() const
 {
+    if (isPartitioned()) {
+        uint32_t count = 0;
+        for (Partitions::const_iterator i = partitions.begin(); i != partitions.end(); ++i)
+            count += (*i)->getMessageCount();
+        return count;
+    }
     Mutex::ScopedLock locker(messageLock);
-    return messages->size();
+    uint32_t count = messages->size();
+    if (splitEnqueueLock) {
+        Mutex::ScopedLock l(enqueueLock);
+        count += incoming.size();
+    }
+    return count;
 }
 
 uint32_t Queue::getConsumerCount() const
 {
+    if (isPartitioned()) {
+        uint32_t count = 0;
+        for (Partitions::const_iterator i = partitions.begin(); i != partitions.end(); ++i)
+            count += (*i)->getConsumerCount();
+        return count;
+    }
     Mutex::ScopedLock locker(consumerLock);
     return consumerCount;
 }
 
 bool Queue::canAutoDelete() const
 {
+    if (isPartitioned())
+        return autodelete && !owner && !getConsumerCount();
     Mutex::ScopedLock locker(consumerLock);
     return autodelete && !consumerCount && !owner;
 }
@@ -828,6 +1470,14 @@ void Queue::enqueueAborted(boost::intrusive_ptr<Message> msg)
 
 // return true if store exists,
 bool Queue::dequeue(TransactionContext* ctxt, const QueuedMessage& msg)
+{
+    bool stored = dequeueMessage(ctxt, msg);
+    notifyObservers();
+    return stored;
+}
+
+/** As dequeue(), but leaves deferred observers to the caller, as it may hold messageLock */
+bool Queue::dequeueMessage(TransactionContext* ctxt, const QueuedMessage& msg)
 {
     ScopedUse u(barrier);
     if (!u.acquired) return false;
@@ -839,28 +1489,65 @@ bool Queue::dequeue(TransactionContext* ctxt, const QueuedMessage& msg)
             observeDequeue(msg, locker);
         }
     }
+    if (isStoreDequeue(msg)) {
+        msg.payload->dequeueAsync(shared_from_this(), store); //increment to async counter -- for message sent to more than one queue
+        boost::intrusive_ptr<PersistableMessage> pmsg = boost::static_pointer_cast<PersistableMessage>(msg.payload);
+        store->dequeue(ctxt, pmsg, *this);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * The store dequeues are made one by one, as dequeue() would, in the
+ * order the queue's state was updated; without a transaction they are
+ * asynchronous and the store may batch them itself.
+ */
+void Queue::dequeueBatch(TransactionContext* ctxt, const std::vector<QueuedMessage>& msgs)
+{
+    ScopedUse u(barrier);
+    if (!u.acquired) return;
+
+    std::vector<const QueuedMessage*> stored;
+    {
+        Mutex::ScopedLock locker(messageLock);
+        for (std::vector<QueuedMessage>::const_iterator i = msgs.begin(); i != msgs.end(); ++i) {
+            if (!isEnqueued(*i)) continue;
+            if (!ctxt) {
+                observeDequeue(*i, locker);
+            }
+            if (isStoreDequeue(*i)) stored.push_back(&*i);
+        }
+    }
+    for (std::vector<const QueuedMessage*>::const_iterator i = stored.begin(); i != stored.end(); ++i) {
+        const QueuedMessage& msg = **i;
+        msg.payload->dequeueAsync(shared_from_this(), store);
+        boost::intrusive_ptr<PersistableMessage> pmsg = boost::static_pointer_cast<PersistableMessage>(msg.payload);
+        store->dequeue(ctxt, pmsg, *this);
+    }
+    notifyObservers();
+}
+
+bool Queue::isStoreDequeue(const QueuedMessage& msg)
+{
     // This check prevents messages which have been forced persistent on one queue from dequeuing
     // from another on which no forcing has taken place and thus causing a store error.
     bool fp = msg.payload->isForcedPersistent();
-    if (!fp || (fp && msg.payload->isStoredOnQueue(shared_from_this()))) {
-        if ((msg.payload->isPersistent() || msg.payload->checkContentReleasable()) && store) {
-            msg.payload->dequeueAsync(shared_from_this(), store); //increment to async counter -- for message sent to more than one queue
-            boost::intrusive_ptr<PersistableMessage> pmsg = boost::static_pointer_cast<PersistableMessage>(msg.payload);
-            store->dequeue(ctxt, pmsg, *this);
-            return true;
-        }
-    }
-    return false;
+    return (!fp || msg.payload->isStoredOnQueue(shared_from_this())) &&
+        (msg.payload->isPersistent() || msg.payload->checkContentReleasable()) && store;
 }
 
 void Queue::dequeueCommitted(const QueuedMessage& msg)
 {
-    Mutex::ScopedLock locker(messageLock);
-    observeDequeue(msg, locker);
-    if (mgmtObject != 0) {
-        mgmtObject->inc_msgTxnDequeues();
-        mgmtObject->inc_byteTxnDequeues(msg.payload->contentSize());
+    {
+        Mutex::ScopedLock locker(messageLock);
+        observeDequeue(msg, locker);
+        if (mgmtObject != 0) {
+            mgmtObject->inc_msgTxnDequeues();
+            mgmtObject->inc_byteTxnDequeues(msg.payload->contentSize());
+        }
     }
+    notifyObservers();
 }
 
 /**
@@ -872,7 +1559,7 @@ void Queue::popAndDequeue(const Mutex::ScopedLock& held)
     if (!messages->empty()) {
         QueuedMessage msg = messages->front();
         pop(held);
-        dequeue(0, msg);
+        dequeueMessage(0, msg);
     }
 }
 
@@ -880,10 +1567,11 @@ void Queue::popAndDequeue(const Mutex::ScopedLock& held)
  * Updates policy and management when a message has been dequeued,
  * expects messageLock to be held
  */
-void Queue::observeDequeue(const QueuedMessage& msg, const Mutex::ScopedLock&)
+void Queue::observeDequeue(const QueuedMessage& msg, const Mutex::ScopedLock& l)
 {
     if (policy.get()) policy->dequeued(msg);
     mgntDeqStats(msg.payload);
+    if (timeInQueue.get()) timeInQueue->record(msg.payload->timeSinceEnqueued(AbsTime::now()));
     for (Observers::const_iterator i = observers.begin(); i != observers.end(); ++i) {
         try{
             (*i)->dequeued(msg);
@@ -891,13 +1579,15 @@ void Queue::observeDequeue(const QueuedMessage& msg, const Mutex::ScopedLock&)
             QPID_LOG(warning, "Exception on notification of dequeue for queue " << getName() << ": " << e.what());
         }
     }
+    deferEvent(ObserverEvent::DEQUEUED, msg, l);
 }
 
 /** updates queue observers when a message has become unavailable for transfer,
  * expects messageLock to be held
  */
-void Queue::observeAcquire(const QueuedMessage& msg, const Mutex::ScopedLock&)
+void Queue::observeAcquire(const QueuedMessage& msg, const Mutex::ScopedLock& l)
 {
+    if (policy.get()) policy->acquired(msg);
     for (Observers::const_iterator i = observers.begin(); i != observers.end(); ++i) {
         try{
             (*i)->acquired(msg);
@@ -905,13 +1595,16 @@ void Queue::observeAcquire(const QueuedMessage& msg, const Mutex::ScopedLock&)
             QPID_LOG(warning, "Exception on notification of message removal for queue " << getName() << ": " << e.what());
         }
     }
+    deferEvent(ObserverEvent::ACQUIRED, msg, l);
 }
 
 /** updates queue observers when a message has become re-available for transfer,
  * expects messageLock to be held
  */
-void Queue::observeRequeue(const QueuedMessage& msg, const Mutex::ScopedLock&)
+void Queue::observeRequeue(const QueuedMessage& msg, const Mutex::ScopedLock& l)
 {
+    ++requeues;
+    if (policy.get()) policy->requeued(msg);
     for (Observers::const_iterator i = observers.begin(); i != observers.end(); ++i) {
         try{
             (*i)->requeued(msg);
@@ -919,6 +1612,53 @@ void Queue::observeRequeue(const QueuedMessage& msg, const Mutex::ScopedLock&)
             QPID_LOG(warning, "Exception on notification of message requeue for queue " << getName() << ": " << e.what());
         }
     }
+    deferEvent(ObserverEvent::REQUEUED, msg, l);
+}
+
+void Queue::deferEvent(ObserverEvent::Type type, const QueuedMessage& msg, const Mutex::ScopedLock&)
+{
+    if (!deferredObservers.empty()) observerEvents.push_back(ObserverEvent(type, msg));
+}
+
+/**
+ * Only one thread delivers at a time, taking batches until none are
+ * left, so deferred observers see events in order. Events raised by
+ * an observer itself are picked up by the same loop.
+ */
+void Queue::notifyObservers()
+{
+    if (deferredObservers.empty()) return;
+    {
+        Mutex::ScopedLock locker(messageLock);
+        if (notifyingObservers || observerEvents.empty()) return;
+        notifyingObservers = true;
+    }
+    std::vector<ObserverEvent> events;
+    while (true) {
+        events.clear();
+        {
+            Mutex::ScopedLock locker(messageLock);
+            events.swap(observerEvents);
+            if (events.empty()) {
+                notifyingObservers = false;
+                return;
+            }
+        }
+        for (std::vector<ObserverEvent>::iterator e = events.begin(); e != events.end(); ++e) {
+            for (Observers::const_iterator i = deferredObservers.begin(); i != deferredObservers.end(); ++i) {
+                try {
+                    switch (e->type) {
+                      case ObserverEvent::ENQUEUED: (*i)->enqueued(e->message); break;
+                      case ObserverEvent::ACQUIRED: (*i)->acquired(e->message); break;
+                      case ObserverEvent::REQUEUED: (*i)->requeued(e->message); break;
+                      case ObserverEvent::DEQUEUED: (*i)->dequeued(e->message); break;
+                    }
+                } catch (const std::exception& ex) {
+                    QPID_LOG(warning, "Exception on deferred notification for queue " << getName() << ": " << ex.what());
+                }
+            }
+        }
+    }
 }
 
 void Queue::create(const FieldTable& _settings)
@@ -975,6 +1715,9 @@ void Queue::configureImpl(const FieldTable& _settings)
         FieldTable copy(_settings);
         copy.erase(QueuePolicy::typeKey);
         setPolicy(QueuePolicy::createQueuePolicy(getName(), copy));
+    } else if (isLightweight() && !_settings.isSet(QueuePolicy::maxCountKey) &&
+               !_settings.isSet(QueuePolicy::maxSizeKey)) {
+        setPolicy(std::auto_ptr<QueuePolicy>());
     } else {
         setPolicy(QueuePolicy::createQueuePolicy(getName(), _settings));
     }
@@ -982,6 +1725,9 @@ void Queue::configureImpl(const FieldTable& _settings)
         ThresholdAlerts::observe(*this, *(broker->getManagementAgent()), _settings, broker->getOptions().queueThresholdEventRatio);
     }
 
+    splitEnqueueLock = _settings.get(qpidSplitEnqueueLock);
+    if (splitEnqueueLock) QPID_LOG(debug, "Configured queue " << getName() << " with separate enqueue lock");
+
     //set this regardless of owner to allow use of no-local with exclusive consumers also
     noLocal = _settings.get(qpidNoLocal);
     QPID_LOG(debug, "Configured queue " << getName() << " with no-local=" << noLocal);
@@ -999,6 +1745,15 @@ void Queue::configureImpl(const FieldTable& _settings)
         QPID_LOG(debug, "Configured queue " <<  getName() << " as Legacy Last Value Queue");
         messages = LegacyLVQ::updateOrReplace(messages, qpidVQMatchProperty, false, broker);
         allocator = boost::shared_ptr<MessageDistributor>(new FifoDistributor( *messages ));
+    } else if (_settings.get(PagedQueue::pagingKey)) {
+        QPID_LOG(debug, "Configured queue " <<  getName() << " as paged queue");
+        if (Fairshare::create(_settings).get())
+            QPID_LOG(warning, "Queue " << getName() << " is paged, so its priority settings are ignored");
+        if (_settings.isSet(qpidMessageGroupKey))
+            QPID_LOG(warning, "Queue " << getName() << " is paged, so its message group settings are ignored");
+        messages = PagedQueue::create(_settings, broker ? broker->getPagingDir() : std::string("/tmp"),
+                                      broker ? broker->getExpiryPolicy() : boost::intrusive_ptr<ExpiryPolicy>());
+        allocator = boost::shared_ptr<MessageDistributor>(new FifoDistributor( *messages ));
     } else {
         std::auto_ptr<Messages> m = Fairshare::create(_settings);
         if (m.get()) {
@@ -1033,26 +1788,197 @@ void Queue::configureImpl(const FieldTable& _settings)
     if (autoDeleteTimeout)
         QPID_LOG(debug, "Configured queue " << getName() << " with qpid.auto_delete_timeout=" << autoDeleteTimeout);
 
+    if (_settings.get(qpidLatencyHistogram) && !timeInQueue.get()) {
+        timeInQueue.reset(new sys::LatencyHistogram);
+        if (mgmtObject != 0 && broker) {
+            timeInQueueExport = new sys::LatencyHistogramExport(
+                *timeInQueue, boost::bind(&_qmf::Queue::set_timeInQueue, mgmtObject, _1), broker->getTimer());
+            broker->getTimer().add(timeInQueueExport);
+        }
+        QPID_LOG(debug, "Configured queue " << getName() << " with a time in queue histogram");
+    }
+
+    uint32_t duplicateWindow = getIntegerSetting(_settings, qpidDuplicateWindow);
+    if (duplicateWindow && broker && broker->isInCluster()) {
+        // The window is kept by each broker's own clock, so not cluster safe
+        QPID_LOG(warning, "Queue " << getName() << ": " << qpidDuplicateWindow
+                 << " is ignored by clustered brokers, duplicates are not dropped");
+    } else if (duplicateWindow && !duplicates.get()) {
+        uint32_t size = getIntegerSetting(_settings, qpidDuplicateIndexSize);
+        duplicates.reset(new DuplicateIndex(size ? size : DEFAULT_DUPLICATE_INDEX_SIZE,
+                                            duplicateWindow * sys::TIME_SEC));
+        QPID_LOG(debug, "Configured queue " << getName() << " to drop duplicates within " << duplicateWindow
+                 << "s, indexing up to " << duplicates->getCapacity() << " message ids");
+    }
+
+    uint32_t partitionCount = getIntegerSetting(_settings, qpidPartitions);
+    if (partitionCount > 1 && partitions.empty()) {
+        if (store) {
+            QPID_LOG(warning, "Ignoring " << qpidPartitions << " for durable queue " << getName());
+        } else {
+            partition(partitionCount, _settings);
+        }
+    }
+
     if (mgmtObject != 0) {
         mgmtObject->set_arguments(ManagementAgent::toMap(_settings));
     }
 
     QueueFlowLimit::observe(*this, _settings);
+    if (broker) addObserver(broker->getMemoryAccountant());
+}
+
+namespace {
+// Messages taken from a deleted queue for its alternate exchange at a time
+const uint32_t REROUTE_BATCH = 1000;
+// Batches between progress reports for a background reroute
+const uint32_t REROUTE_REPORT = 100;
+}
+
+namespace qpid {
+namespace broker {
+/**
+ * Reroutes the messages of a deleted queue to its alternate exchange
+ * a batch at a time from the broker timer, so that deleting a deep
+ * queue doesn't hold up the thread that deleted it.
+ */
+class RerouteTask : public qpid::sys::TimerTask
+{
+  public:
+    RerouteTask(Timer& t, const Queue::shared_ptr& q, uint32_t count)
+        : TimerTask(Duration(TIME_MSEC), "Reroute"), timer(t), queue(q), total(count), batches(0) {}
+
+    void fire()
+    {
+        if (queue->rerouteToAlternate(REROUTE_BATCH)) {
+            if (++batches % REROUTE_REPORT == 0) {
+                QPID_LOG(info, "Rerouted " << batches * REROUTE_BATCH << " of about " << total
+                         << " messages from deleted queue " << queue->getName());
+            }
+            setupNextFire();
+            timer.add(this);
+        } else {
+            QPID_LOG(info, "Finished rerouting messages from deleted queue " << queue->getName());
+            queue->finishDestroy();
+        }
+    }
+
+  private:
+    Timer& timer;
+    Queue::shared_ptr queue;
+    const uint32_t total;
+    uint32_t batches;
+};
+}} // namespace qpid::broker
+
+void Queue::partition(uint32_t count, const FieldTable& _settings)
+{
+    partitionKey = _settings.getAsString(qpidPartitionKey);
+    FieldTable copy(_settings);
+    copy.erase(qpidPartitions);
+    copy.erase(qpidPartitionKey);
+    for (uint32_t i = 0; i < count; ++i) {
+        std::ostringstream partitionName;
+        partitionName << name << ".partition." << i;
+        Queue::shared_ptr p(new Queue(partitionName.str(), false, 0, 0, 0, broker));
+        p->configure(copy);
+        p->mgmtObject = mgmtObject;     // Partitions count as this queue
+        p->partitionOf = shared_from_this();
+        partitions.push_back(p);
+    }
+    QPID_LOG(debug, "Configured queue " << getName() << " with " << count << " partitions"
+             << (partitionKey.empty() ? std::string() : " keyed by " + partitionKey));
+}
+
+Queue::shared_ptr Queue::partitionFor(const Message& msg)
+{
+    assert(isPartitioned());
+    size_t n = partitions.size();
+    if (!partitionKey.empty()) {
+        const FieldTable* headers = msg.getApplicationHeaders();
+        std::string key = headers ? headers->getAsString(partitionKey) : std::string();
+        if (!key.empty()) return partitions[boost::hash<std::string>()(key) % n];
+    }
+    // Pass over partitions nobody consumes from while others have consumers
+    uint32_t start = nextPartition.fetchAndAdd(1);
+    for (size_t i = 0; i < n; ++i) {
+        const Queue::shared_ptr& p = partitions[(start + i) % n];
+        if (p->getConsumerCount()) return p;
+    }
+    return partitions[start % n];
+}
+
+Queue::shared_ptr Queue::partitionForConsumer()
+{
+    assert(isPartitioned());
+    Partitions::iterator least = partitions.begin();
+    uint32_t fewest = (*least)->getConsumerCount();
+    for (Partitions::iterator i = least + 1; i != partitions.end() && fewest; ++i) {
+        uint32_t count = (*i)->getConsumerCount();
+        if (count < fewest) {
+            least = i;
+            fewest = count;
+        }
+    }
+    return *least;
 }
 
 void Queue::destroyed()
 {
+    for (Partitions::iterator i = partitions.begin(); i != partitions.end(); ++i) {
+        Queue::shared_ptr p = *i;
+        if (alternateExchange.get()) {
+            p->alternateExchange = alternateExchange;
+            while (p->rerouteToAlternate(REROUTE_BATCH)) {}
+            p->alternateExchange.reset();
+        }
+        p->mgmtObject = 0;
+        broker->getMemoryAccountant()->queueDeleted(*p);
+        p->notifyDeleted();
+    }
     unbind(broker->getExchanges());
+    // Messages not yet due go the way of the rest
+    releaseScheduled(FAR_FUTURE);
     if (alternateExchange.get()) {
+        uint32_t count = getMessageCount();
+        if (count > REROUTE_BATCH && !broker->isInCluster()) {
+            // Consumers must see the queue as deleted before its messages go
+            notifyDeleted();
+            QPID_LOG(info, "Rerouting " << count << " messages from deleted queue " << name
+                     << " to " << alternateExchange->getName() << " in the background");
+            broker->getTimer().add(new RerouteTask(broker->getTimer(), shared_from_this(), count));
+            return;
+        }
+        while (rerouteToAlternate(REROUTE_BATCH)) {}
+    }
+    finishDestroy();
+}
+
+bool Queue::rerouteToAlternate(uint32_t max)
+{
+    std::vector<QueuedMessage> batch;
+    bool more;
+    {
         Mutex::ScopedLock locker(messageLock);
-        while(!messages->empty()){
-            DeliverableMessage msg(messages->front().payload);
-            alternateExchange->routeWithAlternate(msg);
-            popAndDequeue(locker);
+        batch.reserve(std::min(size_t(max), messages->size()));
+        while (batch.size() < max && !messages->empty()) {
+            batch.push_back(messages->front());
+            pop(locker);
         }
-        alternateExchange->decAlternateUsers();
+        more = !messages->empty();
+    }
+    // Route without holding messageLock; each message is routed before it is dequeued
+    for (std::vector<QueuedMessage>::iterator i = batch.begin(); i != batch.end(); ++i) {
+        DeliverableMessage msg(i->payload);
+        alternateExchange->routeWithAlternate(msg);
     }
+    dequeueBatch(0, batch);
+    return more;
+}
 
+void Queue::finishDestroy()
+{
+    if (alternateExchange.get()) alternateExchange->decAlternateUsers();
     if (store) {
         barrier.destroy();
         store->flush(*this);
@@ -1060,6 +1986,7 @@ void Queue::destroyed()
         store = 0;//ensure we make no more calls to the store for this queue
     }
     if (autoDeleteTask) autoDeleteTask = boost::intrusive_ptr<TimerTask>();
+    if (broker) broker->getMemoryAccountant()->queueDeleted(*this);
     notifyDeleted();
 }
 
@@ -1310,6 +2237,7 @@ void Queue::query(qpid::types::Variant::Map& results) const
 
 void Queue::setPosition(SequenceNumber n) {
     Mutex::ScopedLock locker(messageLock);
+    Mutex::ScopedLock l(enqueueLock);
     sequence = n;
 }
 
@@ -1345,7 +2273,7 @@ void Queue::insertSequenceNumbers(const std::string& key)
 /** updates queue observers and state when a message has become available for transfer,
  * expects messageLock to be held
  */
-void Queue::observeEnqueue(const QueuedMessage& m, const Mutex::ScopedLock&)
+void Queue::observeEnqueue(const QueuedMessage& m, const Mutex::ScopedLock& l)
 {
     for (Observers::iterator i = observers.begin(); i != observers.end(); ++i) {
         try {
@@ -1354,10 +2282,14 @@ void Queue::observeEnqueue(const QueuedMessage& m, const Mutex::ScopedLock&)
             QPID_LOG(warning, "Exception on notification of enqueue for queue " << getName() << ": " << e.what());
         }
     }
+    deferEvent(ObserverEvent::ENQUEUED, m, l);
     if (policy.get()) {
         policy->enqueued(m);
     }
+    indexExpiry(m, l);
     mgntEnqStats(m.payload);
+    // A message on several queues is timed from the first of them
+    if (timeInQueue.get()) m.payload->setEnqueueTime(AbsTime::now());
 }
 
 void Queue::updateEnqueued(const QueuedMessage& m)
@@ -1368,8 +2300,11 @@ void Queue::updateEnqueued(const QueuedMessage& m)
         if (policy.get()) {
             policy->recoverEnqueued(payload);
         }
-        Mutex::ScopedLock locker(messageLock);
-        observeEnqueue(m, locker);
+        {
+            Mutex::ScopedLock locker(messageLock);
+            observeEnqueue(m, locker);
+        }
+        notifyObservers();
     } else {
         QPID_LOG(warning, "Queue informed of enqueued message that has no payload");
     }
@@ -1394,7 +2329,8 @@ void Queue::checkNotDeleted()
 void Queue::addObserver(boost::shared_ptr<QueueObserver> observer)
 {
     Mutex::ScopedLock locker(messageLock);
-    observers.insert(observer);
+    if (observer->isDeferred()) deferredObservers.insert(observer);
+    else observers.insert(observer);
 }
 
 void Queue::flush()
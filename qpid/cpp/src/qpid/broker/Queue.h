@@ -35,6 +35,8 @@
 
 #include "qpid/framing/FieldTable.h"
 #include "qpid/sys/AtomicValue.h"
+#include "qpid/sys/LatencyHistogram.h"
+#include "qpid/broker/DuplicateIndex.h"
 #include "qpid/sys/Monitor.h"
 #include "qpid/sys/Timer.h"
 #include "qpid/management/Manageable.h"
@@ -44,17 +46,21 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/intrusive_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/weak_ptr.hpp>
 
 #include <list>
 #include <vector>
 #include <memory>
 #include <deque>
+#include <map>
 #include <set>
 #include <algorithm>
 
 namespace qpid {
 namespace broker {
 class Broker;
+class ContentPrefetch;
+class ContentSpill;
 class MessageStore;
 class QueueEvents;
 class QueueRegistry;
@@ -90,7 +96,7 @@ class Queue : public boost::enable_shared_from_this<Queue>,
     };
 
     typedef std::set< boost::shared_ptr<QueueObserver> > Observers;
-    enum ConsumeCode {NO_MESSAGES=0, CANT_CONSUME=1, CONSUMED=2};
+    enum ConsumeCode {NO_MESSAGES=0, CANT_CONSUME=1, CONSUMED=2, NO_MATCH=3};
 
 
     const std::string name;
@@ -106,10 +112,31 @@ class Queue : public boost::enable_shared_from_this<Queue>,
     std::vector<std::string> traceExclude;
     QueueListeners listeners;
     std::auto_ptr<Messages> messages;
+    /** Positions of messages with a TTL, earliest expiration first. Entries
+     * for messages that have since left the queue are dropped lazily. */
+    typedef std::multimap<sys::AbsTime, framing::SequenceNumber> ExpiryIndex;
+    ExpiryIndex expiryIndex;
     std::deque<QueuedMessage> pendingDequeues;//used to avoid dequeuing during recovery
     mutable qpid::sys::Mutex consumerLock;
     mutable qpid::sys::Monitor messageLock;
     mutable qpid::sys::Mutex ownershipLock;
+    /** When set, push() stages messages in 'incoming' under
+     * enqueueLock; they are transferred to 'messages' in batches by
+     * whichever thread next holds messageLock. */
+    bool splitEnqueueLock;
+    mutable qpid::sys::Mutex enqueueLock;
+    std::deque<QueuedMessage> incoming;
+    bool transferPending;
+    /** Messages displaced by a transfer, to be dequeued once
+     * messageLock is released (see dequeueDisplaced()) */
+    std::vector<QueuedMessage> displaced;
+    /** Bumped on each requeue; with the allocator's ownershipChanges()
+     * tells a filtering consumer when it must rescan from the front */
+    uint32_t requeues;
+    /** Between beginRecoveryBatch() and endRecoveryBatch(), recovered
+     * messages wait here and are loaded onto 'messages' all at once. */
+    bool batchRecovery;
+    std::deque<QueuedMessage> recovered;
     mutable uint64_t persistenceId;
     framing::FieldTable settings;
     std::auto_ptr<QueuePolicy> policy;
@@ -122,6 +149,15 @@ class Queue : public boost::enable_shared_from_this<Queue>,
     sys::AtomicValue<uint32_t> dequeueSincePurge; // Count dequeues since last purge.
     int eventMode;
     Observers observers;
+    Observers deferredObservers;            // Told of events after messageLock is released
+    struct ObserverEvent {
+        enum Type { ENQUEUED, ACQUIRED, REQUEUED, DEQUEUED };
+        Type type;
+        QueuedMessage message;
+        ObserverEvent(Type t, const QueuedMessage& m) : type(t), message(m) {}
+    };
+    std::vector<ObserverEvent> observerEvents;  // Not yet given to deferredObservers
+    bool notifyingObservers;                // Set while a thread is delivering observerEvents
     bool insertSeqNo;
     std::string seqNoKey;
     Broker* broker;
@@ -130,17 +166,50 @@ class Queue : public boost::enable_shared_from_this<Queue>,
     int autoDeleteTimeout;
     boost::intrusive_ptr<qpid::sys::TimerTask> autoDeleteTask;
     boost::shared_ptr<MessageDistributor> allocator;
+    std::auto_ptr<sys::LatencyHistogram> timeInQueue;
+    boost::intrusive_ptr<sys::TimerTask> timeInQueueExport;
+    std::auto_ptr<DuplicateIndex> duplicates;   // Set by qpid.duplicate_window, except in a cluster
+    ContentSpill* spill;
+    bool spilling;                          // Set once content has been taken for spilling
+    framing::SequenceNumber spillPosition;  // Last message looked at for spilling
+    ContentPrefetch* prefetch;              // Set if there is a store to prefetch from
+    framing::SequenceNumber prefetchPosition;   // Last message looked at for prefetching
+    typedef std::vector<boost::shared_ptr<Queue> > Partitions;
+    Partitions partitions;                  // Set once, by configure()
+    std::string partitionKey;               // Header whose value picks the partition
+    sys::AtomicValue<uint32_t> nextPartition;
+    boost::weak_ptr<Queue> partitionOf;     // The partitioned queue this is one partition of
+    /** Messages held back until their qpid.delivery_time, earliest first */
+    typedef std::multimap<sys::AbsTime, boost::intrusive_ptr<Message> > Scheduled;
+    Scheduled scheduled;
+    boost::intrusive_ptr<sys::TimerTask> scheduledTask;  // Due at scheduled.begin()
+    sys::AtomicValue<uint32_t> deliveryTimeIgnored;      // Warned that a cluster ignores it
 
     void push(boost::intrusive_ptr<Message>& msg, bool isRecovery=false);
+    void stage(boost::intrusive_ptr<Message>& msg);
+    void append(boost::intrusive_ptr<Message>& msg, bool isRecovery=false);
+    template <class C> void collect(C& collector);
+    Consumer::shared_ptr handoff(const QueuedMessage& qm, const sys::Mutex::ScopedLock& held);
+    bool schedule(boost::intrusive_ptr<Message>& msg);
+    void scheduleTask(const sys::Mutex::ScopedLock& held);
+    void releaseScheduled(sys::AbsTime until);
+    void transferIncoming(const sys::Mutex::ScopedLock& held);
+    void dequeueDisplaced();
+    uint32_t scanGeneration() const;
     void setPolicy(std::auto_ptr<QueuePolicy> policy);
     bool getNextMessage(QueuedMessage& msg, Consumer::shared_ptr& c);
     ConsumeCode consumeNextMessage(QueuedMessage& msg, Consumer::shared_ptr& c);
+    ConsumeCode consumeNextMessage(QueuedMessage& msg, Consumer::shared_ptr& c,
+                                   const sys::Mutex::ScopedLock& held);
+    bool nextMatchingMessage(Consumer::shared_ptr& c, QueuedMessage& msg, framing::SequenceNumber& scanned,
+                             const sys::Mutex::ScopedLock& held);
     bool browseNextMessage(QueuedMessage& msg, Consumer::shared_ptr& c);
     void notifyListener();
 
     void removeListener(Consumer::shared_ptr);
 
     bool isExcluded(boost::intrusive_ptr<Message>& msg);
+    bool isDuplicate(boost::intrusive_ptr<Message>& msg);
 
     /** update queue observers, stats, policy, etc when the messages' state changes. Lock
      * must be held by caller */
@@ -148,6 +217,16 @@ class Queue : public boost::enable_shared_from_this<Queue>,
     void observeAcquire(const QueuedMessage& msg, const sys::Mutex::ScopedLock& lock);
     void observeRequeue(const QueuedMessage& msg, const sys::Mutex::ScopedLock& lock);
     void observeDequeue(const QueuedMessage& msg, const sys::Mutex::ScopedLock& lock);
+    void deferEvent(ObserverEvent::Type type, const QueuedMessage& msg, const sys::Mutex::ScopedLock& lock);
+    bool dequeueMessage(TransactionContext* ctxt, const QueuedMessage& msg);
+
+    /** maintain the expiry index - assumes messageLock held */
+    void indexExpiry(const QueuedMessage& msg, const sys::Mutex::ScopedLock& held);
+    void collectExpired(std::deque<QueuedMessage>& expired, const sys::Mutex::ScopedLock& held);
+    /** ask for spilled content half a window ahead of @a position to be read back - assumes messageLock held */
+    void restoreAhead(const framing::SequenceNumber& position, const sys::Mutex::ScopedLock& held);
+    /** ask for released content up to the prefetch depth ahead of @a position to be read back - assumes messageLock held */
+    void prefetchAhead(const framing::SequenceNumber& position, const sys::Mutex::ScopedLock& held);
 
     /** modify the Queue's message container - assumes messageLock held */
     void pop(const sys::Mutex::ScopedLock& held);           // acquire front msg
@@ -159,6 +238,7 @@ class Queue : public boost::enable_shared_from_this<Queue>,
     void forcePersistent(QueuedMessage& msg);
     int getEventMode();
     void configureImpl(const qpid::framing::FieldTable& settings);
+    void partition(uint32_t count, const qpid::framing::FieldTable& settings);
 
     inline void mgntEnqStats(const boost::intrusive_ptr<Message>& msg)
     {
@@ -185,6 +265,12 @@ class Queue : public boost::enable_shared_from_this<Queue>,
 
     void checkNotDeleted();
     void notifyDeleted();
+    /** Route up to max messages to the alternate exchange; true if more remain */
+    bool rerouteToAlternate(uint32_t max);
+    /** Last steps of destroyed(), once the messages have been rerouted */
+    void finishDestroy();
+
+    friend class RerouteTask;
 
   public:
 
@@ -202,6 +288,14 @@ class Queue : public boost::enable_shared_from_this<Queue>,
 
     /** allow the Consumer to consume or browse the next available message */
     QPID_BROKER_EXTERN bool dispatch(Consumer::shared_ptr);
+    /**
+     * Allow a Consumer that acquires messages to consume up to max
+     * messages, selected under a single hold of the message lock and
+     * then delivered in order.
+     *
+     * @return the number of messages delivered
+     */
+    QPID_BROKER_EXTERN size_t dispatch(Consumer::shared_ptr, size_t max);
 
     /** allow the Consumer to acquire a message that it has browsed.
      * @param msg - message to be acquired.
@@ -244,6 +338,18 @@ class Queue : public boost::enable_shared_from_this<Queue>,
      * enqueued if persistent then process it.
      */
     QPID_BROKER_EXTERN void deliver(boost::intrusive_ptr<Message> msg);
+    /**
+     * First half of deliver(), used when delivering a message to
+     * several queues at once. Records the message as enqueued, making
+     * the usual (possibly asynchronous) store enqueue. Returns true if
+     * the message must then be passed to completeDelivery().
+     */
+    QPID_BROKER_EXTERN bool prepareDelivery(boost::intrusive_ptr<Message>& msg);
+    /**
+     * Second half of deliver(): makes a message prepared with
+     * prepareDelivery() available to consumers.
+     */
+    QPID_BROKER_EXTERN void completeDelivery(boost::intrusive_ptr<Message>& msg);
     /**
      * Dispatches the messages immediately to a consumer if
      * one is available or stores it for later if not.
@@ -260,6 +366,15 @@ class Queue : public boost::enable_shared_from_this<Queue>,
      * Used during recovery to add stored messages back to the queue
      */
     QPID_BROKER_EXTERN void recover(boost::intrusive_ptr<Message>& msg);
+    /**
+     * Bracket the recovery of many messages at once. In between, the
+     * messages recovered are held aside, and are loaded onto the queue
+     * and reported to its observers in endRecoveryBatch(). Ending a
+     * batch that was not begun does nothing. Ring queues, whose policy
+     * needs the messages in place as they are recovered, ignore this.
+     */
+    QPID_BROKER_EXTERN void beginRecoveryBatch();
+    QPID_BROKER_EXTERN void endRecoveryBatch();
 
     QPID_BROKER_EXTERN void consume(Consumer::shared_ptr c,
                                     bool exclusive = false);
@@ -270,11 +385,38 @@ class Queue : public boost::enable_shared_from_this<Queue>,
                    const ::qpid::types::Variant::Map *filter=0);
     QPID_BROKER_EXTERN void purgeExpired(sys::Duration);
 
+    /**
+     * A message with a qpid.delivery_time header, in milliseconds
+     * since the epoch, that is still in the future is held aside from
+     * the queue's messages until then. It is enqueued, and stored if
+     * durable, on arrival, so it is held again after recovery, but it
+     * is not counted or visible to consumers and browsers before it is
+     * due, though purge() removes it. One timer task per queue, for the
+     * earliest due message, releases them. Clustered brokers ignore the
+     * header, as each would release the message by its own clock.
+     */
+    QPID_BROKER_EXTERN void releaseScheduled();
+    QPID_BROKER_EXTERN uint32_t getScheduledCount() const;
+
+    /**
+     * Add to @a batch messages with at least @a minContent bytes of
+     * content that lie more than @a window messages behind the head
+     * and have not been spilled, until @a max bytes have been
+     * added. Carries on from the last message looked at in an earlier
+     * call, so each message is considered once.
+     * @return the bytes of content added
+     */
+    QPID_BROKER_EXTERN uint64_t collectSpillable(uint32_t window, uint64_t minContent, uint64_t max,
+                                                 std::vector<boost::intrusive_ptr<Message> >& batch);
+
     //move qty # of messages to destination Queue destq
     uint32_t move(const Queue::shared_ptr destq, uint32_t qty,
                   const qpid::types::Variant::Map *filter=0);
+    QPID_BROKER_EXTERN void deliverBatch(std::vector<boost::intrusive_ptr<Message> >& msgs);
 
     QPID_BROKER_EXTERN uint32_t getMessageCount() const;
+    /** Messages ever enqueued, wrapping at 2^32 */
+    QPID_BROKER_EXTERN uint32_t getEnqueueCount() const;
     QPID_BROKER_EXTERN uint32_t getEnqueueCompleteMessageCount() const;
     QPID_BROKER_EXTERN uint32_t getConsumerCount() const;
     inline const std::string& getName() const { return name; }
@@ -301,6 +443,11 @@ class Queue : public boost::enable_shared_from_this<Queue>,
      * dequeue from store (only done once messages is acknowledged)
      */
     QPID_BROKER_EXTERN bool dequeue(TransactionContext* ctxt, const QueuedMessage &msg);
+    /**
+     * dequeue several acknowledged messages, checking and updating the
+     * queue's state for all of them under a single hold of its lock
+     */
+    QPID_BROKER_EXTERN void dequeueBatch(TransactionContext* ctxt, const std::vector<QueuedMessage>& msgs);
     /**
      * Inform the queue that a previous transactional dequeue
      * committed.
@@ -323,6 +470,7 @@ class Queue : public boost::enable_shared_from_this<Queue>,
      * accepted it).
      */
     bool isEnqueued(const QueuedMessage& msg);
+    bool isStoreDequeue(const QueuedMessage& msg);
 
     /**
      * Acquires the next available (oldest) message
@@ -337,6 +485,23 @@ class Queue : public boost::enable_shared_from_this<Queue>,
     void setAlternateExchange(boost::shared_ptr<Exchange> exchange);
     boost::shared_ptr<Exchange> getAlternateExchange();
     bool isLocal(boost::intrusive_ptr<Message>& msg);
+    bool isLightweight() const;
+
+    /**
+     * A queue declared with qpid.partitions=N holds no messages and
+     * has no consumers of its own. It owns N unregistered partitions
+     * that share its management object. Messages go to the partition
+     * picked by the hash of the qpid.partition_key header, when one is
+     * configured and set, which keeps each key in order. Otherwise
+     * they go round robin over the partitions that have consumers.
+     * Each subscription is given the partition with the fewest
+     * consumers. Limits and other arguments apply per partition.
+     */
+    bool isPartitioned() const { return !partitions.empty(); }
+    QPID_BROKER_EXTERN boost::shared_ptr<Queue> partitionFor(const Message& msg);
+    QPID_BROKER_EXTERN boost::shared_ptr<Queue> partitionForConsumer();
+    /** The partitioned queue this queue is a partition of, if any */
+    boost::shared_ptr<Queue> getPartitioned() const { return partitionOf.lock(); }
 
     //PersistableQueue support:
     uint64_t getPersistenceId() const;
@@ -375,8 +540,15 @@ class Queue : public boost::enable_shared_from_this<Queue>,
     /** Apply f to each Observer on the queue */
     template <class F> void eachObserver(F f) {
         std::for_each<Observers::iterator, F>(observers.begin(), observers.end(), f);
+        std::for_each<Observers::iterator, F>(deferredObservers.begin(), deferredObservers.end(), f);
     }
 
+    /**
+     * Deliver the events held for deferred observers. Must not be
+     * called with messageLock held. See QueueObserver.
+     */
+    QPID_BROKER_EXTERN void notifyObservers();
+
     /** Set the position sequence number  for the next message on the queue.
      * Must be >= the current sequence number.
      * Used by cluster to replicate queues.
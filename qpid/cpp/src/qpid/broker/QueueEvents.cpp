@@ -23,19 +23,26 @@
 #include "qpid/broker/QueueObserver.h"
 #include "qpid/Exception.h"
 #include "qpid/log/Statement.h"
+#include <algorithm>
 
 namespace qpid {
 namespace broker {
 
-QueueEvents::QueueEvents(const boost::shared_ptr<sys::Poller>& poller, bool isSync) : 
-    eventQueue(boost::bind(&QueueEvents::handle, this, _1), poller), enabled(true), sync(isSync) 
+QueueEvents::QueueEvents(const boost::shared_ptr<sys::Poller>& poller, bool isSync, uint32_t partitions) : 
+    enabled(true), sync(isSync) 
 {
-    if (!sync) eventQueue.start();
+    for (uint32_t i = 0; i < std::max(partitions, uint32_t(1)); ++i) {
+        eventQueues.push_back(new EventQueue(boost::bind(&QueueEvents::handle, this, _1), poller));
+        if (!sync) eventQueues.back().start();
+    }
 }
 
 QueueEvents::~QueueEvents() 
 {
-    if (!sync) eventQueue.stop();
+    if (!sync) {
+        for (EventQueues::iterator i = eventQueues.begin(); i != eventQueues.end(); ++i)
+            i->stop();
+    }
 }
 
 void QueueEvents::enqueued(const QueuedMessage& m)
@@ -43,10 +50,9 @@ void QueueEvents::enqueued(const QueuedMessage& m)
     if (enabled) {
         Event enq(ENQUEUE, m);
         if (sync) {
-            for (Listeners::iterator j = listeners.begin(); j != listeners.end(); j++) 
-                j->second(enq);
+            notify(enq);
         } else {
-            eventQueue.push(enq);
+            push(enq);
         }
     }
 }
@@ -56,19 +62,39 @@ void QueueEvents::dequeued(const QueuedMessage& m)
     if (enabled) {
         Event deq(DEQUEUE, m);
         if (sync) {
-            for (Listeners::iterator j = listeners.begin(); j != listeners.end(); j++) 
-                j->second(deq);
+            notify(deq);
         } else {
-            eventQueue.push(Event(DEQUEUE, m));
+            push(deq);
         }
     }
 }
 
+void QueueEvents::push(const Event& event)
+{
+    // Partition by queue so each queue's events stay in order
+    size_t partition = (reinterpret_cast<size_t>(event.msg.queue) / sizeof(void*)) % eventQueues.size();
+    eventQueues[partition].push(event);
+}
+
+void QueueEvents::notify(const Event& event)
+{
+    for (Listeners::iterator j = listeners.begin(); j != listeners.end(); j++) {
+        if (j->second.queues.empty() || j->second.queues.count(event.msg.queue->getName()))
+            j->second.callback(event);
+    }
+}
+
 void QueueEvents::registerListener(const std::string& id, const EventListener& listener)
 {
-    qpid::sys::Mutex::ScopedLock l(lock);
+    registerListener(id, listener, QueueNames());
+}
+
+void QueueEvents::registerListener(const std::string& id, const EventListener& listener, const QueueNames& queues)
+{
+    qpid::sys::RWlock::ScopedWlock l(lock);
     if (listeners.find(id) == listeners.end()) {
-        listeners[id] = listener;
+        listeners[id].callback = listener;
+        listeners[id].queues = queues;
     } else {
         throw Exception(QPID_MSG("Event listener already registered for '" << id << "'"));
     }
@@ -76,7 +102,7 @@ void QueueEvents::registerListener(const std::string& id, const EventListener& l
 
 void QueueEvents::unregisterListener(const std::string& id)
 {
-    qpid::sys::Mutex::ScopedLock l(lock);
+    qpid::sys::RWlock::ScopedWlock l(lock);
     if (listeners.find(id) == listeners.end()) {
         throw Exception(QPID_MSG("No event listener registered for '" << id << "'"));
     } else {
@@ -86,18 +112,19 @@ void QueueEvents::unregisterListener(const std::string& id)
 
 QueueEvents::EventQueue::Batch::const_iterator
 QueueEvents::handle(const EventQueue::Batch& events) {
-    qpid::sys::Mutex::ScopedLock l(lock);
+    qpid::sys::RWlock::ScopedRlock l(lock);
     for (EventQueue::Batch::const_iterator i = events.begin(); i != events.end(); ++i) {
-        for (Listeners::iterator j = listeners.begin(); j != listeners.end(); j++) {
-             j->second(*i);
-        }
+        notify(*i);
     }
     return events.end();
 }
 
 void QueueEvents::shutdown()
 {
-    if (!sync && !eventQueue.empty() && !listeners.empty()) eventQueue.shutdown();
+    if (sync || listeners.empty()) return;
+    for (EventQueues::iterator i = eventQueues.begin(); i != eventQueues.end(); ++i) {
+        if (!i->empty()) i->shutdown();
+    }
 }
 
 void QueueEvents::enable()
@@ -27,8 +27,10 @@
 #include "qpid/sys/Mutex.h"
 #include "qpid/sys/PollableQueue.h"
 #include <map>
+#include <set>
 #include <string>
 #include <boost/function.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 
 namespace qpid {
 namespace broker {
@@ -38,6 +40,11 @@ namespace broker {
  * events have occured; allows listeners to register for notification
  * of this. The notification happens asynchronously, in a separate
  * thread.
+ *
+ * Asynchronous events can be split across several partitions by
+ * queue. Each partition is processed on its own, so listeners may be
+ * called from several threads at once, but the events of any one
+ * queue are always delivered in order.
  */
 class QueueEvents
 {
@@ -53,13 +60,19 @@ class QueueEvents
     };
 
     typedef boost::function<void (Event)> EventListener;
+    typedef std::set<std::string> QueueNames;
 
-    QPID_BROKER_EXTERN QueueEvents(const boost::shared_ptr<sys::Poller>& poller, bool isSync = false);
+    QPID_BROKER_EXTERN QueueEvents(const boost::shared_ptr<sys::Poller>& poller, bool isSync = false,
+                                   uint32_t partitions = 1);
     QPID_BROKER_EXTERN ~QueueEvents();
     QPID_BROKER_EXTERN void enqueued(const QueuedMessage&);
     QPID_BROKER_EXTERN void dequeued(const QueuedMessage&);
     QPID_BROKER_EXTERN void registerListener(const std::string& id,
                                              const EventListener&);
+    /** Register a listener that only sees events for the named queues */
+    QPID_BROKER_EXTERN void registerListener(const std::string& id,
+                                             const EventListener&,
+                                             const QueueNames& queues);
     QPID_BROKER_EXTERN void unregisterListener(const std::string& id);
     void enable();
     void disable();
@@ -69,15 +82,23 @@ class QueueEvents
     QPID_BROKER_EXTERN bool isSync();
   private:
     typedef qpid::sys::PollableQueue<Event> EventQueue;
-    typedef std::map<std::string, EventListener> Listeners;
+    typedef boost::ptr_vector<EventQueue> EventQueues;
+    struct Listener
+    {
+        EventListener callback;
+        QueueNames queues;  // Empty for all queues
+    };
+    typedef std::map<std::string, Listener> Listeners;
 
-    EventQueue eventQueue;
+    EventQueues eventQueues;
     Listeners listeners;
     volatile bool enabled;
-    qpid::sys::Mutex lock;//protect listeners from concurrent access
+    qpid::sys::RWlock lock;//protect listeners from concurrent access
     bool sync;
     
     EventQueue::Batch::const_iterator handle(const EventQueue::Batch& e);
+    void notify(const Event&);
+    void push(const Event&);
 
 };
 }} // namespace qpid::broker
@@ -31,12 +31,19 @@
 
 #include "qmf/org/apache/qpid/broker/Queue.h"
 
+#include <algorithm>
 #include <sstream>
 
 using namespace qpid::broker;
 using namespace qpid::framing;
 
 namespace {
+    /** once flow resumes, each dequeue completes at least this many held
+     * msgs, or this fraction of them if more
+     */
+    const size_t RELEASE_MIN = 2;
+    const size_t RELEASE_FRACTION = 8;
+
     /** ensure that the configured flow control stop and resume values are
      * valid with respect to the maximum queue capacity, and each other
      */
@@ -95,7 +102,7 @@ QueueFlowLimit::QueueFlowLimit(Queue *_queue,
     : StatefulQueueObserver(std::string("QueueFlowLimit")), queue(_queue), queueName("<unknown>"),
       flowStopCount(_flowStopCount), flowResumeCount(_flowResumeCount),
       flowStopSize(_flowStopSize), flowResumeSize(_flowResumeSize),
-      flowStopped(false), count(0), size(0), queueMgmtObj(0), broker(0)
+      flowStopped(false), count(0), size(0), held(0), queueMgmtObj(0), broker(0)
 {
     uint32_t maxCount(0);
     uint64_t maxSize(0);
@@ -123,16 +130,14 @@ QueueFlowLimit::QueueFlowLimit(Queue *_queue,
 QueueFlowLimit::~QueueFlowLimit()
 {
     sys::Mutex::ScopedLock l(indexLock);
-    if (!index.empty()) {
-        // we're gone - release all pending msgs
-        for (std::map<framing::SequenceNumber, boost::intrusive_ptr<Message> >::iterator itr = index.begin();
-             itr != index.end(); ++itr)
-            if (itr->second)
-                try {
-                    itr->second->getIngressCompletion().finishCompleter();
-                } catch (...) {}    // ignore - not safe for a destructor to throw.
-        index.clear();
-    }
+    // we're gone - release all pending msgs
+    for (Held::iterator itr = index.begin(); itr != index.end(); ++itr)
+        if (itr->second)
+            try {
+                itr->second->getIngressCompletion().finishCompleter();
+            } catch (...) {}    // ignore - not safe for a destructor to throw.
+    index.clear();
+    held = 0;
 }
 
 
@@ -157,18 +162,14 @@ void QueueFlowLimit::enqueued(const QueuedMessage& msg)
         }
     }
 
-    if (flowStopped || !index.empty()) {
+    if (flowStopped || held) {
         // ignore flow control if we are populating the queue due to cluster replication:
         if (broker && broker->isClusterUpdatee()) {
             QPID_LOG(trace, "Queue \"" << queueName << "\": ignoring flow control for msg pos=" << msg.position);
             return;
         }
         QPID_LOG(trace, "Queue \"" << queueName << "\": setting flow control for msg pos=" << msg.position);
-        msg.payload->getIngressCompletion().startCompleter();    // don't complete until flow resumes
-        bool unique;
-        unique = index.insert(std::pair<framing::SequenceNumber, boost::intrusive_ptr<Message> >(msg.position, msg.payload)).second;
-        // Like this to avoid tripping up unused variable warning when NDEBUG set
-        if (!unique) assert(unique);
+        hold(msg);
     }
 }
 
@@ -200,23 +201,55 @@ void QueueFlowLimit::dequeued(const QueuedMessage& msg)
         QPID_LOG(info, "Queue \"" << queueName << "\": has drained below the flow control resume level. Producer flow control deactivated." );
     }
 
-    if (!index.empty()) {
-        if (!flowStopped) {
-            // flow enabled - release all pending msgs
-            for (std::map<framing::SequenceNumber, boost::intrusive_ptr<Message> >::iterator itr = index.begin();
-                 itr != index.end(); ++itr)
-                if (itr->second)
-                    itr->second->getIngressCompletion().finishCompleter();
-            index.clear();
-        } else {
-            // even if flow controlled, we must release this msg as it is being dequeued
-            std::map<framing::SequenceNumber, boost::intrusive_ptr<Message> >::iterator itr = index.find(msg.position);
-            if (itr != index.end()) {       // this msg is flow controlled, release it:
-                msg.payload->getIngressCompletion().finishCompleter();
-                index.erase(itr);
-            }
+    if (held) {
+        // even if flow controlled, we must release this msg as it is being dequeued
+        release(msg.position);
+        // flow enabled - release a share of the pending msgs for each one
+        // that leaves, so producers resume at the rate the queue drains
+        if (!flowStopped)
+            releaseOldest(std::max(RELEASE_MIN, held / RELEASE_FRACTION));
+    }
+}
+
+void QueueFlowLimit::hold(const QueuedMessage& msg)
+{
+    assert(index.empty() || index.back().first < msg.position);
+    msg.payload->getIngressCompletion().startCompleter();    // don't complete until flow resumes
+    index.push_back(Held::value_type(msg.position, msg.payload));
+    ++held;
+}
+
+namespace {
+bool positionLess(const std::pair<SequenceNumber, boost::intrusive_ptr<Message> >& slot, SequenceNumber position)
+{
+    return slot.first < position;
+}
+}
+
+void QueueFlowLimit::release(SequenceNumber position)
+{
+    Held::iterator itr = std::lower_bound(index.begin(), index.end(), position, positionLess);
+    if (itr != index.end() && itr->first == position && itr->second) {
+        itr->second->getIngressCompletion().finishCompleter();
+        itr->second = 0;
+        --held;
+    }
+    while (!index.empty() && !index.front().second)
+        index.pop_front();
+}
+
+void QueueFlowLimit::releaseOldest(size_t n)
+{
+    while (n && !index.empty()) {
+        if (index.front().second) {
+            index.front().second->getIngressCompletion().finishCompleter();
+            --held;
+            --n;
         }
+        index.pop_front();
     }
+    while (!index.empty() && !index.front().second)
+        index.pop_front();
 }
 
 
@@ -344,11 +377,10 @@ void QueueFlowLimit::getState(qpid::framing::FieldTable& state ) const
     state.clear();
 
     framing::SequenceSet ss;
-    if (!index.empty()) {
+    if (held) {
         /* replicate the set of messages pending flow control */
-        for (std::map<framing::SequenceNumber, boost::intrusive_ptr<Message> >::const_iterator itr = index.begin();
-             itr != index.end(); ++itr) {
-            ss.add(itr->first);
+        for (Held::const_iterator itr = index.begin(); itr != index.end(); ++itr) {
+            if (itr->second) ss.add(itr->first);
         }
         framing::Array seqs(TYPE_CODE_UINT32);
         typedef boost::function<void(framing::SequenceNumber, framing::SequenceNumber)> arrayBuilder;
@@ -364,6 +396,7 @@ void QueueFlowLimit::setState(const qpid::framing::FieldTable& state)
 {
     sys::Mutex::ScopedLock l(indexLock);
     index.clear();
+    held = 0;
 
     framing::SequenceSet fcmsg;
     framing::Array seqArray(TYPE_CODE_UINT32);
@@ -379,15 +412,15 @@ void QueueFlowLimit::setState(const qpid::framing::FieldTable& state)
             for (SequenceNumber seq = first; seq <= last; ++seq) {
                 QueuedMessage msg;
                 queue->find(seq, msg);   // fyi: may not be found if msg is acquired & unacked
-                bool unique;
-                unique = index.insert(std::pair<framing::SequenceNumber, boost::intrusive_ptr<Message> >(seq, msg.payload)).second;
-                // Like this to avoid tripping up unused variable warning when NDEBUG set
-                if (!unique) assert(unique);
+                if (msg.payload) {
+                    index.push_back(Held::value_type(seq, msg.payload));
+                    ++held;
+                }
             }
         }
     }
 
-    flowStopped = index.size() != 0;
+    flowStopped = !fcmsg.empty();
     if (queueMgmtObj) {
         queueMgmtObj->set_flowStopped(isFlowControlActive());
     }
@@ -21,6 +21,7 @@
 #ifndef _QueueFlowLimit_
 #define _QueueFlowLimit_
 
+#include <deque>
 #include <list>
 #include <set>
 #include <iostream>
@@ -52,6 +53,11 @@ class Broker;
  * is not used.  If both byte and msg count thresholds are set, then
  * passing _either_ level may turn flow control ON, but _both_ must be
  * below level before flow control will be turned OFF.
+ *
+ * Messages enqueued while flow control is ON are held incomplete, so
+ * their producers get no more credit. Once it is OFF they are
+ * completed a share at a time as the queue drains, oldest first,
+ * rather than all at once.
  */
  class QueueFlowLimit : public StatefulQueueObserver
 {
@@ -98,6 +104,7 @@ class Broker;
     uint64_t getFlowResumeSize() const { return flowResumeSize; }
 
     uint32_t getFlowCount() const { return count; }
+    size_t getHeldCount() const { return held; }
     uint64_t getFlowSize() const { return size; }
     bool isFlowControlActive() const { return flowStopped; }
     bool monitorFlowControl() const { return flowStopCount || flowStopSize; }
@@ -112,8 +119,11 @@ class Broker;
     friend QPID_BROKER_EXTERN std::ostream& operator<<(std::ostream&, const QueueFlowLimit&);
 
  protected:
-    // msgs waiting for flow to become available.
-    std::map<framing::SequenceNumber, boost::intrusive_ptr<Message> > index;
+    // msgs waiting for flow to become available, in enqueue order. The
+    // slot of a msg dequeued while waiting is cleared rather than erased.
+    typedef std::deque<std::pair<framing::SequenceNumber, boost::intrusive_ptr<Message> > > Held;
+    Held index;
+    size_t held;                // msgs in index
     mutable qpid::sys::Mutex indexLock;
 
     _qmfBroker::Queue *queueMgmtObj;
@@ -124,6 +134,11 @@ class Broker;
                    uint32_t flowStopCount, uint32_t flowResumeCount,
                    uint64_t flowStopSize,  uint64_t flowResumeSize);
     static QPID_BROKER_EXTERN QueueFlowLimit *createLimit(Queue *queue, const qpid::framing::FieldTable& settings);
+
+  private:
+    void hold(const QueuedMessage&);
+    void release(framing::SequenceNumber position);
+    void releaseOldest(size_t n);
 };
 
 }}
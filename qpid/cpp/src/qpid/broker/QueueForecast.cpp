@@ -0,0 +1,233 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/broker/QueueForecast.h"
+#include "qpid/broker/DeliverableMessage.h"
+#include "qpid/broker/Exchange.h"
+#include "qpid/broker/Message.h"
+#include "qpid/broker/Queue.h"
+#include "qpid/broker/QueuePolicy.h"
+#include "qpid/broker/QueueRegistry.h"
+#include "qpid/amqp_0_10/Codecs.h"
+#include "qpid/framing/AMQFrame.h"
+#include "qpid/framing/MessageTransferBody.h"
+#include "qpid/log/Statement.h"
+#include "qpid/types/Variant.h"
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace qpid {
+namespace broker {
+
+using namespace qpid::framing;
+using qpid::types::Variant;
+
+const std::string QueueForecast::ROUTING_KEY("queue.forecast");
+
+namespace {
+const std::string NAME("name");
+const std::string DEPTH("depth");
+const std::string BYTES("bytes");
+const std::string ENQUEUE_RATE("enqueueRate");
+const std::string DEQUEUE_RATE("dequeueRate");
+const std::string TIME_TO_DRAIN("timeToDrain");
+const std::string TIME_TO_LIMIT("timeToLimit");
+const std::string CONTENT_TYPE("amqp/list");
+
+// Rates below this, in messages per second, count as idle
+const double IDLE = 0.01;
+
+void collect(std::vector<Queue::shared_ptr>& copy, Queue::shared_ptr q)
+{
+    copy.push_back(q);
+}
+
+/** Seconds for remaining to be used up at rate, negative if never */
+double timeFor(double remaining, double rate)
+{
+    return rate > 0 ? std::max(remaining, 0.0) / rate : -1;
+}
+}
+
+QueueForecast::Estimate::Estimate()
+    : depth(0), bytes(0), enqueueRate(0), dequeueRate(0), byteRate(0), timeToDrain(-1), timeToLimit(-1)
+{}
+
+QueueForecast::QueueForecast(QueueRegistry& q)
+    : queues(q), generation(0), last(sys::EPOCH), window(10), timer(0)
+{}
+
+QueueForecast::~QueueForecast()
+{
+    stop();
+}
+
+void QueueForecast::start(sys::Timer& t, sys::Duration period, boost::shared_ptr<Exchange> e)
+{
+    timer = &t;
+    exchange = e;
+    window = 10.0 * period / sys::TIME_SEC;
+    task = new Task(*this, period);
+    timer->add(task);
+    QPID_LOG(info, "Queue forecasts published every " << period / sys::TIME_MSEC << "ms"
+             << (exchange ? " to " + exchange->getName() : std::string()));
+}
+
+void QueueForecast::stop()
+{
+    if (task) task->cancel();
+}
+
+QueueForecast::Task::Task(QueueForecast& p, sys::Duration d) : sys::TimerTask(d, "QueueForecast"), parent(p) {}
+
+void QueueForecast::Task::fire()
+{
+    parent.sample(sys::AbsTime::now());
+    setupNextFire();
+    parent.timer->add(this);
+}
+
+void QueueForecast::sample(sys::AbsTime now)
+{
+    // Copy the queues so the registry is not locked while they are read
+    std::vector<Queue::shared_ptr> copy;
+    queues.eachQueue(boost::bind(&collect, boost::ref(copy), _1));
+
+    Variant::List batch;
+    std::vector<std::string> messages;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        double elapsed = last == sys::EPOCH ? 0 : double(sys::Duration(last, now)) / sys::TIME_SEC;
+        last = now;
+        // Exponential smoothing that does not depend on the sampling period
+        double alpha = elapsed > 0 ? 1 - std::exp(-elapsed / window) : 0;
+        ++generation;
+        for (std::vector<Queue::shared_ptr>::const_iterator i = copy.begin(); i != copy.end(); ++i) {
+            const Queue& queue = **i;
+            State& state = states[queue.getName()];
+            Estimate& e = state.estimate;
+            uint32_t enqueued = queue.getEnqueueCount();
+            uint32_t depth = queue.getMessageCount();
+            const QueuePolicy* policy = (*i)->getPolicy();
+            uint64_t bytes = policy && policy->getMaxSize() ? policy->getCurrentQueueSize() : 0;
+            bool known = state.generation != 0;
+            state.generation = generation;
+            if (known && elapsed > 0) {
+                double in = uint32_t(enqueued - state.enqueued); // Counts wrap
+                double out = std::max(in - (double(depth) - double(e.depth)), 0.0);
+                double grown = double(bytes) - double(e.bytes);
+                if (state.sampled) {
+                    e.enqueueRate += alpha * (in / elapsed - e.enqueueRate);
+                    e.dequeueRate += alpha * (out / elapsed - e.dequeueRate);
+                    e.byteRate += alpha * (grown / elapsed - e.byteRate);
+                } else {
+                    e.enqueueRate = in / elapsed;
+                    e.dequeueRate = out / elapsed;
+                    e.byteRate = grown / elapsed;
+                    state.sampled = true;
+                }
+            }
+            state.enqueued = enqueued;
+            e.depth = depth;
+            e.bytes = bytes;
+            if (!state.sampled) continue;
+
+            double growth = e.enqueueRate - e.dequeueRate;
+            e.timeToDrain = depth ? timeFor(depth, -growth) : 0;
+            e.timeToLimit = -1;
+            if (policy && policy->getMaxCount() && growth > 0)
+                e.timeToLimit = timeFor(double(policy->getMaxCount()) - depth, growth);
+            if (policy && policy->getMaxSize() && e.byteRate > 0) {
+                double t = timeFor(double(policy->getMaxSize()) - double(bytes), e.byteRate);
+                if (e.timeToLimit < 0 || t < e.timeToLimit) e.timeToLimit = t;
+            }
+
+            // Report busy queues, and each queue once more as it goes idle
+            bool busy = depth || e.enqueueRate >= IDLE || e.dequeueRate >= IDLE;
+            if (exchange && (busy || state.reported)) {
+                Variant::Map entry;
+                entry[NAME] = queue.getName();
+                entry[DEPTH] = depth;
+                if (policy && policy->getMaxSize()) entry[BYTES] = bytes;
+                entry[ENQUEUE_RATE] = e.enqueueRate;
+                entry[DEQUEUE_RATE] = e.dequeueRate;
+                if (e.timeToDrain >= 0) entry[TIME_TO_DRAIN] = e.timeToDrain;
+                if (e.timeToLimit >= 0) entry[TIME_TO_LIMIT] = e.timeToLimit;
+                batch.push_back(entry);
+                if (batch.size() == BATCH) {
+                    messages.push_back(std::string());
+                    amqp_0_10::ListCodec::encode(batch, messages.back());
+                    batch.clear();
+                }
+            }
+            state.reported = busy;
+        }
+        // Forget deleted queues
+        for (States::iterator i = states.begin(); i != states.end();) {
+            if (i->second.generation != generation) states.erase(i++);
+            else ++i;
+        }
+    }
+    if (!batch.empty()) {
+        messages.push_back(std::string());
+        amqp_0_10::ListCodec::encode(batch, messages.back());
+    }
+    std::for_each(messages.begin(), messages.end(), boost::bind(&QueueForecast::publish, this, _1));
+}
+
+bool QueueForecast::get(const std::string& queue, Estimate& estimate) const
+{
+    sys::Mutex::ScopedLock l(lock);
+    States::const_iterator i = states.find(queue);
+    if (i == states.end() || !i->second.sampled) return false;
+    estimate = i->second.estimate;
+    return true;
+}
+
+void QueueForecast::publish(const std::string& content)
+{
+    boost::intrusive_ptr<Message> msg(new Message());
+    AMQFrame method((MessageTransferBody(ProtocolVersion(), exchange->getName(), 0, 0)));
+    AMQFrame header((AMQHeaderBody()));
+    AMQFrame body((AMQContentBody(content)));
+    method.setEof(false);
+    header.setBof(false);
+    header.setEof(false);
+    body.setBof(false);
+    msg->getFrames().append(method);
+    msg->getFrames().append(header);
+    MessageProperties* props = msg->getFrames().getHeaders()->get<MessageProperties>(true);
+    props->setContentLength(content.size());
+    props->setContentType(CONTENT_TYPE);
+    msg->getFrames().getHeaders()->get<DeliveryProperties>(true)->setRoutingKey(ROUTING_KEY);
+    msg->getFrames().append(body);
+
+    DeliverableMessage deliverable(msg);
+    try {
+        exchange->route(deliverable, ROUTING_KEY, 0);
+    } catch (const std::exception& e) {
+        QPID_LOG(warning, "Could not publish queue forecasts: " << e.what());
+    }
+}
+
+}} // namespace qpid::broker
@@ -0,0 +1,126 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_BROKER_QUEUEFORECAST_H
+#define QPID_BROKER_QUEUEFORECAST_H
+
+#include "qpid/broker/BrokerImportExport.h"
+#include "qpid/sys/Mutex.h"
+#include "qpid/sys/Time.h"
+#include "qpid/sys/Timer.h"
+#include <boost/intrusive_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <map>
+#include <string>
+
+namespace qpid {
+namespace broker {
+
+class Exchange;
+class QueueRegistry;
+
+/**
+ * Smoothed enqueue and dequeue rates for every queue, with the time
+ * each queue would take to drain or to reach its policy limit at those
+ * rates.
+ *
+ * The estimates are taken from counts the queues already keep, once a
+ * period on the timer, so nothing is added to the enqueue or dequeue
+ * path. After each sample, the estimates for queues that are busy, or
+ * have just become idle, are published to an exchange as AMQP 0-10
+ * lists of maps, many queues to a message, for consumers such as
+ * autoscalers that would otherwise poll every queue object over QMF.
+ */
+class QueueForecast
+{
+  public:
+    /** Routing key of the published estimates */
+    static QPID_BROKER_EXTERN const std::string ROUTING_KEY;
+    /** Most queues reported in one message */
+    static const size_t BATCH = 1000;
+
+    struct Estimate
+    {
+        uint32_t depth;
+        uint64_t bytes;             // Only known for queues with a size limit
+        double enqueueRate;         // Messages per second
+        double dequeueRate;
+        double byteRate;            // Net growth in bytes per second
+        double timeToDrain;         // Seconds, negative if not draining
+        double timeToLimit;         // Seconds, negative if no limit will be reached
+        Estimate();
+    };
+
+    QPID_BROKER_EXTERN QueueForecast(QueueRegistry& queues);
+    QPID_BROKER_EXTERN ~QueueForecast();
+
+    /**
+     * Sample every period, smoothing over ten periods, and publish to
+     * exchange if it is set.
+     */
+    QPID_BROKER_EXTERN void start(sys::Timer& timer, sys::Duration period,
+                                  boost::shared_ptr<Exchange> exchange);
+    QPID_BROKER_EXTERN void stop();
+
+    /** Update and publish the estimates, as if sampled at now */
+    QPID_BROKER_EXTERN void sample(sys::AbsTime now);
+    /** @return false if queue has not yet been sampled twice */
+    QPID_BROKER_EXTERN bool get(const std::string& queue, Estimate& estimate) const;
+
+    /** Smoothing window, in seconds, used by sample() */
+    void setWindow(double seconds) { window = seconds; }
+
+  private:
+    class Task : public sys::TimerTask
+    {
+      public:
+        Task(QueueForecast& parent, sys::Duration period);
+        void fire();
+      private:
+        QueueForecast& parent;
+    };
+
+    struct State
+    {
+        Estimate estimate;
+        uint32_t enqueued;          // Enqueue count when last sampled
+        uint64_t generation;        // Last sample that saw the queue
+        bool sampled;               // Rates are known
+        bool reported;              // Published by the last sample
+        State() : enqueued(0), generation(0), sampled(false), reported(false) {}
+    };
+    typedef std::map<std::string, State> States;
+
+    QueueRegistry& queues;
+    mutable sys::Mutex lock;
+    States states;
+    uint64_t generation;
+    sys::AbsTime last;
+    double window;
+    boost::shared_ptr<Exchange> exchange;
+    sys::Timer* timer;
+    boost::intrusive_ptr<sys::TimerTask> task;
+
+    void publish(const std::string& content);
+};
+
+}} // namespace qpid::broker
+
+#endif  /*!QPID_BROKER_QUEUEFORECAST_H*/
@@ -28,9 +28,9 @@ void QueueListeners::addListener(Consumer::shared_ptr c)
 {
     if (!c->inListeners) {
         if (c->acquires) {
-            add(consumers, c);
+            add(consumers, staleConsumers, c);
         } else {
-            add(browsers, c);
+            add(browsers, staleBrowsers, c);
         }
         c->inListeners = true;
     }
@@ -39,51 +39,90 @@ void QueueListeners::addListener(Consumer::shared_ptr c)
 void QueueListeners::removeListener(Consumer::shared_ptr c)
 {
     if (c->inListeners) {
+        c->inListeners = false;
         if (c->acquires) {
-            remove(consumers, c);
+            remove(consumers, staleConsumers, c);
         } else {
-            remove(browsers, c);
+            remove(browsers, staleBrowsers, c);
         }
-        c->inListeners = false;
     }
 }
 
 void QueueListeners::populate(NotificationSet& set)
 {
-    if (consumers.size()) {
-        set.consumer = consumers.front();
+    // Wake the longest waiting consumer only; stale entries left by
+    // removeListener() are discarded on the way
+    while (!consumers.empty()) {
+        Consumer::shared_ptr c = consumers.front();
         consumers.pop_front();
-        set.consumer->inListeners = false;
-    } else {
-        // Don't swap the deques, hang on to the memory allocated.
-        set.browsers = browsers;
-        browsers.clear();
-        for (Listeners::iterator i = set.browsers.begin(); i != set.browsers.end(); i++)
+        c->listed = false;
+        if (c->inListeners) {
+            c->inListeners = false;
+            set.consumer = c;
+            break;
+        }
+        --staleConsumers;
+    }
+    // Browsers don't compete for messages, so all of them are woken.
+    // Don't swap the deques, hang on to the memory allocated.
+    for (Listeners::iterator i = browsers.begin(); i != browsers.end(); i++) {
+        (*i)->listed = false;
+        if ((*i)->inListeners) {
             (*i)->inListeners = false;
+            set.browsers.push_back(*i);
+        }
+    }
+    browsers.clear();
+    staleBrowsers = 0;
+}
+
+void QueueListeners::add(Listeners& listeners, size_t& stale, Consumer::shared_ptr c)
+{
+    if (c->listed) {
+        // still holds the entry left behind by removeListener(), reuse it
+        --stale;
+    } else {
+        listeners.push_back(c);
+        c->listed = true;
     }
 }
 
-void QueueListeners::add(Listeners& listeners, Consumer::shared_ptr c)
+void QueueListeners::remove(Listeners& listeners, size_t& stale, Consumer::shared_ptr)
 {
-    listeners.push_back(c);
+    ++stale;
+    if (stale > listeners.size() - stale) compact(listeners, stale);
 }
 
-void QueueListeners::remove(Listeners& listeners, Consumer::shared_ptr c)
+void QueueListeners::compact(Listeners& listeners, size_t& stale)
 {
-    Listeners::iterator i = std::find(listeners.begin(), listeners.end(), c);
-    if (i != listeners.end()) listeners.erase(i);
+    Listeners::iterator j = listeners.begin();
+    for (Listeners::iterator i = listeners.begin(); i != listeners.end(); ++i) {
+        if ((*i)->inListeners) *j++ = *i;
+        else (*i)->listed = false;
+    }
+    listeners.erase(j, listeners.end());
+    stale = 0;
 }
 
 void QueueListeners::NotificationSet::notify()
 {
     if (consumer) consumer->notify();
-    else std::for_each(browsers.begin(), browsers.end(), boost::mem_fn(&Consumer::notify));
+    std::for_each(browsers.begin(), browsers.end(), boost::mem_fn(&Consumer::notify));
 }
 
 bool QueueListeners::contains(Consumer::shared_ptr c) const {
     return c->inListeners;
 }
 
+Consumer::shared_ptr QueueListeners::soleConsumer() const
+{
+    if (consumers.size() - staleConsumers == 1 && browsers.size() == staleBrowsers) {
+        for (Listeners::const_iterator i = consumers.begin(); i != consumers.end(); ++i)
+            if ((*i)->inListeners) return *i;
+    }
+    return Consumer::shared_ptr();
+}
+
 void QueueListeners::ListenerSet::notifyAll()
 {
     std::for_each(listeners.begin(), listeners.end(), boost::mem_fn(&Consumer::notify));
@@ -91,8 +130,10 @@ void QueueListeners::ListenerSet::notifyAll()
 
 void QueueListeners::snapshot(ListenerSet& set)
 {
-    set.listeners.insert(set.listeners.end(), consumers.begin(), consumers.end());
-    set.listeners.insert(set.listeners.end(), browsers.begin(), browsers.end());
+    for (Listeners::iterator i = consumers.begin(); i != consumers.end(); ++i)
+        if ((*i)->inListeners) set.listeners.push_back(*i);
+    for (Listeners::iterator i = browsers.begin(); i != browsers.end(); ++i)
+        if ((*i)->inListeners) set.listeners.push_back(*i);
 }
 
 }} // namespace qpid::broker
@@ -36,6 +36,12 @@ namespace broker {
  * listeners to be notified. NotificationSet::notify() may then be
  * called outside of any lock that protects the QueueListeners
  * instance from concurrent access.
+ *
+ * Each notification wakes every waiting browser but only the longest
+ * waiting consumer, so a message published to a queue shared by many
+ * idle consumers wakes just one of them. Removal is O(1): the entry is
+ * marked and skipped, and the containers are compacted once stale
+ * entries outnumber live ones.
  */
 class QueueListeners
 {
@@ -61,24 +67,32 @@ class QueueListeners
       friend class QueueListeners;
     };
 
+    QueueListeners() : staleConsumers(0), staleBrowsers(0) {}
     void addListener(Consumer::shared_ptr);    
     void removeListener(Consumer::shared_ptr);    
     void populate(NotificationSet&);
     void snapshot(ListenerSet&);
     bool contains(Consumer::shared_ptr c) const;
+    /** The only listener, if that is a consumer rather than a browser */
+    Consumer::shared_ptr soleConsumer() const;
     void notifyAll();
 
     template <class F> void eachListener(F f) {
-        std::for_each(browsers.begin(), browsers.end(), f);
-        std::for_each(consumers.begin(), consumers.end(), f);
+        for (Listeners::iterator i = browsers.begin(); i != browsers.end(); ++i)
+            if ((*i)->inListeners) f(*i);
+        for (Listeners::iterator i = consumers.begin(); i != consumers.end(); ++i)
+            if ((*i)->inListeners) f(*i);
     }
 
   private:
     Listeners consumers;
     Listeners browsers;
+    size_t staleConsumers;
+    size_t staleBrowsers;
 
-    void add(Listeners&, Consumer::shared_ptr);
-    void remove(Listeners&, Consumer::shared_ptr);
+    void add(Listeners&, size_t& stale, Consumer::shared_ptr);
+    void remove(Listeners&, size_t& stale, Consumer::shared_ptr);
+    void compact(Listeners&, size_t& stale);
 
 };
 }} // namespace qpid::broker
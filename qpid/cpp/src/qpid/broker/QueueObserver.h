@@ -56,19 +56,36 @@ class Consumer;
  *
  * "Dequeued" - a message is no longer queued.  At this point, the queue no longer tracks
  * the message, and the broker considers the consumer's transaction complete.
+ *
+ * By default the Queue holds its messageLock while it calls these methods, so an observer
+ * sees each event in step with the queue but adds its cost to the queue's critical
+ * section. An observer whose isDeferred() returns true is instead told of events after
+ * the lock is released. For such an observer:
+ *
+ * - every enqueued, acquired, requeued and dequeued event is delivered, in the order the
+ *   queue made them, and never from two threads at once;
+ * - events may be delivered in batches, by whichever thread next finishes an enqueue,
+ *   dispatch, requeue, dequeue, purge or move on the queue, so the observer may lag the
+ *   queue's state and must not be relied on to veto or hold back the operation itself;
+ * - consumerAdded() and consumerRemoved() are still called under the lock.
+ *
+ * A StatefulQueueObserver that is deferred must have Queue::notifyObservers() called
+ * before its getState() is taken, so that the captured state includes every event.
  */
 class QueueObserver
 {
   public:
     virtual ~QueueObserver() {}
 
-    // note: the Queue will hold the messageLock while calling these methods!
+    // note: unless isDeferred(), the Queue will hold the messageLock while calling these methods!
     virtual void enqueued(const QueuedMessage&) = 0;
     virtual void dequeued(const QueuedMessage&) = 0;
     virtual void acquired(const QueuedMessage&) = 0;
     virtual void requeued(const QueuedMessage&) = 0;
     virtual void consumerAdded( const Consumer& ) {};
     virtual void consumerRemoved( const Consumer& ) {};
+    /** Must return the same value for the life of the observer */
+    virtual bool isDeferred() const { return false; }
  private:
 };
 }} // namespace qpid::broker
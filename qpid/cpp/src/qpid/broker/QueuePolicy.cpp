@@ -105,6 +105,10 @@ void QueuePolicy::dequeued(const QueuedMessage& m)
     dequeued(m.payload->contentSize());
 }
 
+void QueuePolicy::acquired(const QueuedMessage&) {}
+
+void QueuePolicy::requeued(const QueuedMessage&) {}
+
 bool QueuePolicy::isEnqueued(const QueuedMessage&)
 {
     return true;
@@ -210,7 +214,7 @@ bool FlowToDiskPolicy::checkLimit(boost::intrusive_ptr<Message> m)
 
 RingQueuePolicy::RingQueuePolicy(const std::string& _name, 
                                  uint32_t _maxCount, uint64_t _maxSize, const std::string& _type) : 
-    QueuePolicy(_name, _maxCount, _maxSize, _type), strict(_type == RING_STRICT) {}
+    QueuePolicy(_name, _maxCount, _maxSize, _type), queue(0), strict(_type == RING_STRICT) {}
 
 bool before(const QueuedMessage& a, const QueuedMessage& b)
 {
@@ -222,25 +226,46 @@ bool before(const QueuedMessage& a, const QueuedMessage& b)
 
 void RingQueuePolicy::enqueued(const QueuedMessage& m)
 {
-    //need to insert in correct location based on position
-    queue.insert(lower_bound(queue.begin(), queue.end(), m, before), m);
+    //the message itself is held by the queue's container
+    queue = m.queue;
 }
 
 void RingQueuePolicy::dequeued(const QueuedMessage& m)
 {
-    //find and remove m from queue
-    if (find(m, pendingDequeues, true) || find(m, queue, true)) {
+    //a replaced message is no longer counted once it has been dequeued
+    if (find(m, pendingDequeues, true) || findAcquired(m, true) || isAvailable(m)) {
         //now update count and size
         QueuePolicy::dequeued(m);
     }
 }
 
+void RingQueuePolicy::acquired(const QueuedMessage& m)
+{
+    //consumers mostly acquire in order, so this is usually an append
+    if (acquiredMessages.empty() || before(acquiredMessages.back(), m)) {
+        acquiredMessages.push_back(m);
+    } else {
+        acquiredMessages.insert(lower_bound(acquiredMessages.begin(), acquiredMessages.end(), m, before), m);
+    }
+}
+
+void RingQueuePolicy::requeued(const QueuedMessage& m)
+{
+    findAcquired(m, true);
+}
+
 bool RingQueuePolicy::isEnqueued(const QueuedMessage& m)
 {
     //for non-strict ring policy, a message can be replaced (and
     //therefore dequeued) before it is accepted or released by
     //subscriber; need to detect this
-    return find(m, pendingDequeues, false) || find(m, queue, false); 
+    return find(m, pendingDequeues, false) || findAcquired(m, false) || isAvailable(m);
+}
+
+bool RingQueuePolicy::isAvailable(const QueuedMessage& m)
+{
+    QueuedMessage available;
+    return queue && queue->getMessages().find(m.position, available) && available.payload == m.payload;
 }
 
 bool RingQueuePolicy::checkLimit(boost::intrusive_ptr<Message> m)
@@ -264,13 +289,27 @@ bool RingQueuePolicy::checkLimit(boost::intrusive_ptr<Message> m)
     // replacing the first message is sufficient. If we've exceeded
     // maxSize, we need to pop enough messages to get the space we
     // need.
+    //
+    // The oldest message is either the oldest still available on the
+    // queue or the oldest acquired by a consumer but not yet dequeued.
 
     unsigned int haveSpace = getMaxSize() - getCurrentQueueSize();
 
     do {
-        QueuedMessage oldest  = queue.front();
-        if (oldest.queue->acquireMessageAt(oldest.position, oldest) || !strict) {
-            queue.pop_front();
+        qpid::broker::Messages* held = queue ? &queue->getMessages() : 0;
+        bool haveAvailable = held && !held->empty();
+        if (!haveAvailable && acquiredMessages.empty()) {
+            QPID_LOG(debug, "Ring policy could not be triggered in " << name
+                     << ": no message held that could be removed");
+            return false;
+        }
+        bool wasAcquired = !haveAvailable ||
+            (!acquiredMessages.empty() && before(acquiredMessages.front(), held->oldest()));
+        QueuedMessage oldest = wasAcquired ? acquiredMessages.front() : held->oldest();
+        if ((!wasAcquired && oldest.queue->acquireMessageAt(oldest.position, oldest)) || !strict) {
+            //acquiring the message recorded it as acquired; it now
+            //awaits the dequeue instead
+            findAcquired(oldest, true);
             pendingDequeues.push_back(oldest);
             QPID_LOG(debug, "Ring policy triggered in " << name 
                      << ": removed message " << oldest.position << " to make way for new message");
@@ -307,6 +346,16 @@ bool RingQueuePolicy::find(const QueuedMessage& m, Messages& q, bool remove)
     return false;
 }
 
+bool RingQueuePolicy::findAcquired(const QueuedMessage& m, bool remove)
+{
+    Messages::iterator i = lower_bound(acquiredMessages.begin(), acquiredMessages.end(), m, before);
+    if (i != acquiredMessages.end() && i->payload == m.payload) {
+        if (remove) acquiredMessages.erase(i);
+        return true;
+    }
+    return false;
+}
+
 std::auto_ptr<QueuePolicy> QueuePolicy::createQueuePolicy(uint32_t maxCount, uint64_t maxSize, const std::string& type)
 {
     return createQueuePolicy("<unspecified>", maxCount, maxSize, type);
@@ -45,10 +45,10 @@ class QueuePolicy
     bool policyExceeded;
 
 
-  protected:
+  public:
+    /** Bytes held, only counted when there is a size limit */
     uint64_t getCurrentQueueSize() const { return size; } 
 
-  public:
     typedef std::deque<QueuedMessage> Messages;
     static QPID_BROKER_EXTERN const std::string maxCountKey;
     static QPID_BROKER_EXTERN const std::string maxSizeKey;
@@ -64,6 +64,8 @@ class QueuePolicy
     QPID_BROKER_EXTERN void enqueueAborted(boost::intrusive_ptr<Message> msg);
     virtual void enqueued(const QueuedMessage&);
     virtual void dequeued(const QueuedMessage&);
+    virtual void acquired(const QueuedMessage&);
+    virtual void requeued(const QueuedMessage&);
     virtual bool isEnqueued(const QueuedMessage&);
     QPID_BROKER_EXTERN void update(qpid::framing::FieldTable& settings);
     uint32_t getMaxCount() const { return maxCount; }
@@ -99,21 +101,32 @@ class FlowToDiskPolicy : public QueuePolicy
     bool checkLimit(boost::intrusive_ptr<Message> msg);
 };
 
+/**
+ * Replaces the oldest messages to make room for new ones. The messages
+ * available on the queue are found in the queue's own container; the
+ * policy only tracks those acquired and not yet dequeued, which it may
+ * also replace unless strict.
+ */
 class RingQueuePolicy : public QueuePolicy
 {
   public:
     RingQueuePolicy(const std::string& name, uint32_t maxCount, uint64_t maxSize, const std::string& type = RING);
     void enqueued(const QueuedMessage&);
     void dequeued(const QueuedMessage&);
+    void acquired(const QueuedMessage&);
+    void requeued(const QueuedMessage&);
     bool isEnqueued(const QueuedMessage&);
     bool checkLimit(boost::intrusive_ptr<Message> msg);
     void getPendingDequeues(Messages& result);
   private:
     Messages pendingDequeues;
-    Messages queue;
+    Messages acquiredMessages;  // in ring order, usually the unacknowledged few
+    Queue* queue;
     const bool strict;
 
     bool find(const QueuedMessage&, Messages&, bool remove);
+    bool findAcquired(const QueuedMessage&, bool remove);
+    bool isAvailable(const QueuedMessage&);
 };
 
 }}
@@ -23,6 +23,7 @@
 #include "qpid/broker/QueueEvents.h"
 #include "qpid/broker/Exchange.h"
 #include "qpid/log/Statement.h"
+#include <boost/functional/hash.hpp>
 #include <sstream>
 #include <assert.h>
 
@@ -45,47 +46,81 @@ QueueRegistry::declare(const string& declareName, bool durable,
                                         definition from persistente
                                         record*/)
 {
-    RWlock::ScopedWlock locker(lock);
-    string name = declareName.empty() ? generateName() : declareName;
-    assert(!name.empty());
-    QueueMap::iterator i =  queues.find(name);
+    for (;;) {
+        string name = declareName.empty() ? generateName() : declareName;
+        assert(!name.empty());
+        Shard& shard = shardFor(name);
+        if (!durable) {
+            // Without a store record to create, a transient queue is built
+            // and configured outside the shard lock. Should another queue
+            // of the same name be added meanwhile, that one is kept.
+            {
+                RWlock::ScopedRlock locker(shard.lock);
+                QueueMap::iterator i = shard.queues.find(name);
+                if (i != shard.queues.end()) {
+                    if (!declareName.empty()) return std::pair<Queue::shared_ptr, bool>(i->second, false);
+                    continue;
+                }
+            }
+            Queue::shared_ptr queue(new Queue(name, autoDelete, 0, owner, parent, broker));
+            if (alternate) queue->setAlternateExchange(alternate);
+            if (!recovering) queue->create(arguments);
+            else queue->configure(arguments);
 
-    if (i == queues.end()) {
-        Queue::shared_ptr queue(new Queue(name, autoDelete, durable ? store : 0, owner, parent, broker));
-        if (alternate) {
-            queue->setAlternateExchange(alternate);//need to do this *before* create
-            alternate->incAlternateUsers();
+            RWlock::ScopedWlock locker(shard.lock);
+            std::pair<QueueMap::iterator, bool> added = shard.queues.insert(QueueMap::value_type(name, queue));
+            if (added.second) {
+                if (alternate) alternate->incAlternateUsers();
+                if (lastNode) queue->setLastNodeFailure();
+                return std::pair<Queue::shared_ptr, bool>(queue, true);
+            } else if (!declareName.empty()) {
+                return std::pair<Queue::shared_ptr, bool>(added.first->second, false);
+            }
+            continue;
         }
-        if (!recovering) {
-            //apply settings & create persistent record if required
-            queue->create(arguments);
-        } else {
-            //i.e. recovering a queue for which we already have a persistent record
-            queue->configure(arguments);
-        }
-        queues[name] = queue;
-        if (lastNode) queue->setLastNodeFailure();
+        RWlock::ScopedWlock locker(shard.lock);
+        QueueMap::iterator i =  shard.queues.find(name);
 
-        return std::pair<Queue::shared_ptr, bool>(queue, true);
-    } else {
-        return std::pair<Queue::shared_ptr, bool>(i->second, false);
+        if (i == shard.queues.end()) {
+            Queue::shared_ptr queue(new Queue(name, autoDelete, durable ? store : 0, owner, parent, broker));
+            if (alternate) {
+                queue->setAlternateExchange(alternate);//need to do this *before* create
+                alternate->incAlternateUsers();
+            }
+            if (!recovering) {
+                //apply settings & create persistent record if required
+                queue->create(arguments);
+            } else {
+                //i.e. recovering a queue for which we already have a persistent record
+                queue->configure(arguments);
+            }
+            shard.queues[name] = queue;
+            if (lastNode) queue->setLastNodeFailure();
+
+            return std::pair<Queue::shared_ptr, bool>(queue, true);
+        } else if (!declareName.empty()) {
+            return std::pair<Queue::shared_ptr, bool>(i->second, false);
+        }
+        // A queue was declared explicitly with the generated name, try another
     }
 }
 
-void QueueRegistry::destroyLH (const string& name){
-    queues.erase(name);
+QueueRegistry::Shard& QueueRegistry::shardFor(const string& name) {
+    return shards[boost::hash<string>()(name) % SHARDS];
 }
 
 void QueueRegistry::destroy (const string& name){
-    RWlock::ScopedWlock locker(lock);
-    destroyLH (name);
+    Shard& shard = shardFor(name);
+    RWlock::ScopedWlock locker(shard.lock);
+    shard.queues.erase(name);
 }
 
 Queue::shared_ptr QueueRegistry::find(const string& name){
-    RWlock::ScopedRlock locker(lock);
-    QueueMap::iterator i = queues.find(name);
+    Shard& shard = shardFor(name);
+    RWlock::ScopedRlock locker(shard.lock);
+    QueueMap::iterator i = shard.queues.find(name);
     
-    if (i == queues.end()) {
+    if (i == shard.queues.end()) {
         return Queue::shared_ptr();
     } else {
         return i->second;
@@ -93,15 +128,9 @@ Queue::shared_ptr QueueRegistry::find(const string& name){
 }
 
 string QueueRegistry::generateName(){
-    string name;
-    do {
-        std::stringstream ss;
-        ss << "tmp_" << counter++;
-        name = ss.str();
-        // Thread safety: Private function, only called with lock held
-        // so this is OK.
-    } while(queues.find(name) != queues.end());
-    return name;
+    std::stringstream ss;
+    ss << "tmp_" << counter.fetchAndAdd(1);
+    return ss.str();
 }
 
 void QueueRegistry::setStore (MessageStore* _store)
@@ -115,13 +144,16 @@ MessageStore* QueueRegistry::getStore() const {
 
 void QueueRegistry::updateQueueClusterState(bool _lastNode)
 {
-    RWlock::ScopedRlock locker(lock);
-    for (QueueMap::iterator i = queues.begin(); i != queues.end(); i++) {
-        if (_lastNode){
-            i->second->setLastNodeFailure();
-        } else {
-            i->second->clearLastNodeFailure();
+    // Set first so that queues declared in tables already visited see it
+    lastNode = _lastNode;
+    for (size_t s = 0; s < SHARDS; ++s) {
+        RWlock::ScopedRlock locker(shards[s].lock);
+        for (QueueMap::iterator i = shards[s].queues.begin(); i != shards[s].queues.end(); i++) {
+            if (_lastNode){
+                i->second->setLastNodeFailure();
+            } else {
+                i->second->clearLastNodeFailure();
+            }
         }
     }
-    lastNode = _lastNode;
 }
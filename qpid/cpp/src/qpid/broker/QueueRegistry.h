@@ -22,6 +22,7 @@
 #define _QueueRegistry_
 
 #include "qpid/broker/BrokerImportExport.h"
+#include "qpid/sys/AtomicValue.h"
 #include "qpid/sys/Mutex.h"
 #include "qpid/management/Manageable.h"
 #include "qpid/framing/FieldTable.h"
@@ -82,9 +83,10 @@ class QueueRegistry {
     QPID_BROKER_EXTERN void destroy(const std::string& name);
     template <class Test> bool destroyIf(const std::string& name, Test test)
     {
-        qpid::sys::RWlock::ScopedWlock locker(lock);
+        Shard& shard = shardFor(name);
+        qpid::sys::RWlock::ScopedWlock locker(shard.lock);
         if (test()) {
-            destroyLH (name);
+            shard.queues.erase(name);
             return true;
         } else {
             return false;
@@ -97,7 +99,8 @@ class QueueRegistry {
     QPID_BROKER_EXTERN boost::shared_ptr<Queue> find(const std::string& name);
 
     /**
-     * Generate unique queue name.
+     * Generate a queue name. Names are unique among generated names;
+     * declare() skips any that have been taken by an explicit declare.
      */
     std::string generateName();
 
@@ -118,9 +121,11 @@ class QueueRegistry {
 
     /** Call f for each queue in the registry. */
     template <class F> void eachQueue(F f) const {
-        qpid::sys::RWlock::ScopedRlock l(lock);
-        for (QueueMap::const_iterator i = queues.begin(); i != queues.end(); ++i)
-            f(i->second);
+        for (size_t s = 0; s < SHARDS; ++s) {
+            qpid::sys::RWlock::ScopedRlock l(shards[s].lock);
+            for (QueueMap::const_iterator i = shards[s].queues.begin(); i != shards[s].queues.end(); ++i)
+                f(i->second);
+        }
     }
 	
 	/**
@@ -131,17 +136,25 @@ class QueueRegistry {
     
 private:
     typedef std::map<std::string, boost::shared_ptr<Queue> > QueueMap;
-    QueueMap queues;
-    mutable qpid::sys::RWlock lock;
-    int counter;
+
+    // Queues are spread over a fixed number of tables by name, each
+    // with its own lock, so declaring or deleting one queue only holds
+    // up lookups of the queues that share its table.
+    struct Shard {
+        QueueMap queues;
+        mutable qpid::sys::RWlock lock;
+    };
+    static const size_t SHARDS = 64;
+
+    Shard shards[SHARDS];
+    qpid::sys::AtomicValue<uint32_t> counter;
     MessageStore* store;
     QueueEvents* events;
     management::Manageable* parent;
     bool lastNode; //used to set mode on queue declare
     Broker* broker;
 
-    //destroy impl that assumes lock is already held:
-    void destroyLH (const std::string& name);
+    QPID_BROKER_EXTERN Shard& shardFor(const std::string& name);
 };
 
     
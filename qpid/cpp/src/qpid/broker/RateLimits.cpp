@@ -0,0 +1,127 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/broker/RateLimits.h"
+#include "qpid/broker/ConnectionState.h"
+#include "qpid/broker/SessionState.h"
+#include "qpid/log/Statement.h"
+#include <boost/bind.hpp>
+
+namespace qpid {
+namespace broker {
+
+RateLimits::RateLimits(uint32_t c, uint32_t u) : connectionRate(c), userRate(u), timer(0)
+{
+    if (connectionRate)
+        QPID_LOG(info, "Producer rate limited to " << connectionRate << " messages/s per connection");
+    if (userRate)
+        QPID_LOG(info, "Producer rate limited to " << userRate << " messages/s per user");
+}
+
+RateLimits::~RateLimits()
+{
+    stop();
+}
+
+void RateLimits::start(sys::Timer& t, sys::Duration period)
+{
+    timer = &t;
+    task = new Task(*this, period);
+    timer->add(task);
+}
+
+void RateLimits::stop()
+{
+    if (task) task->cancel();
+}
+
+RateLimits::Task::Task(RateLimits& p, sys::Duration d) : sys::TimerTask(d, "RateLimits"), parent(p) {}
+
+void RateLimits::Task::fire()
+{
+    parent.tick();
+    setupNextFire();
+    parent.timer->add(this);
+}
+
+boost::shared_ptr<TokenBucket> RateLimits::getUserBucket(const std::string& user)
+{
+    boost::shared_ptr<TokenBucket> bucket;
+    if (!userRate) return bucket;
+    sys::Mutex::ScopedLock l(lock);
+    boost::weak_ptr<TokenBucket>& entry = users[user];
+    bucket = entry.lock();
+    if (!bucket) {
+        bucket.reset(new TokenBucket(userRate));
+        entry = bucket;
+    }
+    return bucket;
+}
+
+void RateLimits::stalled(SessionState& session)
+{
+    sys::Mutex::ScopedLock l(lock);
+    waiting.insert(&session);
+}
+
+void RateLimits::closed(SessionState& session)
+{
+    sys::Mutex::ScopedLock l(lock);
+    waiting.erase(&session);
+    requested.erase(&session);
+}
+
+void RateLimits::tick()
+{
+    sys::Mutex::ScopedLock l(lock);
+    // Sessions remove themselves under lock before they are deleted,
+    // so those still waiting are safe to use here.
+    for (Sessions::iterator i = waiting.begin(); i != waiting.end();) {
+        SessionState* session = *i;
+        if (!session->isAttached()) {
+            ++i;                // Credit is reissued when it attaches again
+            continue;
+        }
+        waiting.erase(i++);
+        if (requested.insert(session).second)
+            session->getConnection().requestIOProcessing(boost::bind(&RateLimits::sendCredit, this, session));
+    }
+    for (Users::iterator i = users.begin(); i != users.end();) {
+        if (i->second.expired()) users.erase(i++);
+        else ++i;
+    }
+}
+
+void RateLimits::sendCredit(SessionState* session)
+{
+    {
+        sys::Mutex::ScopedLock l(lock);
+        // A session is deleted on its connection's IO thread, which is
+        // this thread, so if it is still known here it stays valid.
+        if (!requested.erase(session)) return;
+    }
+    if (session->isAttached() && !session->processSendCredit(0)) {
+        QPID_LOG(debug, session->getId() << ": Still no producer credit to send");
+        stalled(*session);
+    }
+}
+
+}} // namespace qpid::broker
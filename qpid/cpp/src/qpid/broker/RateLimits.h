@@ -0,0 +1,100 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_BROKER_RATELIMITS_H
+#define QPID_BROKER_RATELIMITS_H
+
+#include "qpid/broker/BrokerImportExport.h"
+#include "qpid/broker/TokenBucket.h"
+#include "qpid/sys/Mutex.h"
+#include "qpid/sys/Timer.h"
+#include <boost/intrusive_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <map>
+#include <set>
+#include <string>
+
+namespace qpid {
+namespace broker {
+
+class SessionState;
+
+/**
+ * Producer rate limits shared between sessions: the per-user buckets
+ * and a single timer that returns credit to stalled sessions.
+ *
+ * A session that runs out of credit registers itself with stalled().
+ * Every period the timer asks the IO thread of each stalled session's
+ * connection to send it more credit, so no session holds a timer task
+ * of its own and credit is never computed on the timer thread.
+ */
+class RateLimits
+{
+  public:
+    /** Rates are in messages per second, 0 for no limit */
+    QPID_BROKER_EXTERN RateLimits(uint32_t connectionRate, uint32_t userRate);
+    QPID_BROKER_EXTERN ~RateLimits();
+
+    QPID_BROKER_EXTERN void start(sys::Timer& timer, sys::Duration period);
+    QPID_BROKER_EXTERN void stop();
+
+    uint32_t getConnectionRate() const { return connectionRate; }
+    uint32_t getUserRate() const { return userRate; }
+
+    /** @return the bucket shared by all sessions of user, or 0 if there is no user limit */
+    QPID_BROKER_EXTERN boost::shared_ptr<TokenBucket> getUserBucket(const std::string& user);
+
+    /** Send credit to session from its IO thread on the next tick */
+    QPID_BROKER_EXTERN void stalled(SessionState& session);
+    /** Forget session, which must be called before it is deleted */
+    QPID_BROKER_EXTERN void closed(SessionState& session);
+
+    /** Request credit for the stalled sessions and drop unused user buckets */
+    QPID_BROKER_EXTERN void tick();
+
+  private:
+    class Task : public sys::TimerTask
+    {
+      public:
+        Task(RateLimits& parent, sys::Duration period);
+        void fire();
+      private:
+        RateLimits& parent;
+    };
+
+    typedef std::map<std::string, boost::weak_ptr<TokenBucket> > Users;
+    typedef std::set<SessionState*> Sessions;
+
+    const uint32_t connectionRate;
+    const uint32_t userRate;
+    sys::Mutex lock;
+    Users users;
+    Sessions waiting;           // Stalled, to be sent credit on the next tick
+    Sessions requested;         // Credit requested from the IO thread
+    sys::Timer* timer;
+    boost::intrusive_ptr<sys::TimerTask> task;
+
+    void sendCredit(SessionState* session);
+};
+
+}} // namespace qpid::broker
+
+#endif  /*!QPID_BROKER_RATELIMITS_H*/
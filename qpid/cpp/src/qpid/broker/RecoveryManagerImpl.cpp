@@ -27,6 +27,7 @@
 #include "qpid/broker/RecoveredEnqueue.h"
 #include "qpid/broker/RecoveredDequeue.h"
 #include "qpid/framing/reply_exceptions.h"
+#include "qpid/log/Statement.h"
 
 using boost::dynamic_pointer_cast;
 using boost::intrusive_ptr;
@@ -35,17 +36,52 @@ using std::string;
 namespace qpid {
 namespace broker {
 
+namespace {
+/** Counts one recovered object and adds the time of its scope to the phase */
+class PhaseTimer {
+    RecoveryManagerImpl::Phase& phase;
+    sys::AbsTime begin;
+  public:
+    PhaseTimer(RecoveryManagerImpl::Phase& p) : phase(p), begin(sys::AbsTime::now()) { ++phase.count; }
+    ~PhaseTimer() { phase.time += sys::Duration(begin, sys::AbsTime::now()); }
+};
+}
+
+std::ostream& operator<<(std::ostream& o, const RecoveryManagerImpl::Phase& p) {
+    return o << p.count << " (" << p.time / sys::TIME_MSEC << "ms)";
+}
+
 RecoveryManagerImpl::RecoveryManagerImpl(QueueRegistry& _queues, ExchangeRegistry& _exchanges, LinkRegistry& _links,
-                                         DtxManager& _dtxMgr)
-    : queues(_queues), exchanges(_exchanges), links(_links), dtxMgr(_dtxMgr) {}
+                                         DtxManager& _dtxMgr, uint64_t _contentLimit)
+    : queues(_queues), exchanges(_exchanges), links(_links), dtxMgr(_dtxMgr),
+      contentLimit(_contentLimit), start(sys::AbsTime::now())
+{
+    exchanges.eachExchange(boost::bind(&Exchange::beginBindingBatch, _1));
+}
 
-RecoveryManagerImpl::~RecoveryManagerImpl() {}
+RecoveryManagerImpl::~RecoveryManagerImpl()
+{
+    // In case the store failed, or does not say, before completing recovery
+    endBindingBatches();
+    endRecoveryBatches();
+}
+
+void RecoveryManagerImpl::endBindingBatches()
+{
+    exchanges.eachExchange(boost::bind(&Exchange::endBindingBatch, _1));
+}
+
+void RecoveryManagerImpl::endRecoveryBatches()
+{
+    queues.eachQueue(boost::bind(&Queue::endRecoveryBatch, _1));
+}
 
 class RecoverableMessageImpl : public RecoverableMessage
 {
     intrusive_ptr<Message> msg;
+    uint64_t contentLimit;
 public:
-    RecoverableMessageImpl(const intrusive_ptr<Message>& _msg);
+    RecoverableMessageImpl(const intrusive_ptr<Message>& _msg, uint64_t _contentLimit = 0);
     ~RecoverableMessageImpl() {};
     void setPersistenceId(uint64_t id);
     void setRedelivered();
@@ -76,8 +112,10 @@ class RecoverableExchangeImpl : public RecoverableExchange
 {
     Exchange::shared_ptr exchange;
     QueueRegistry& queues;
+    RecoveryManagerImpl::Phase& phase;
 public:
-    RecoverableExchangeImpl(Exchange::shared_ptr _exchange, QueueRegistry& _queues) : exchange(_exchange), queues(_queues) {}
+    RecoverableExchangeImpl(Exchange::shared_ptr _exchange, QueueRegistry& _queues, RecoveryManagerImpl::Phase& _phase)
+        : exchange(_exchange), queues(_queues), phase(_phase) {}
     void setPersistenceId(uint64_t id);
     void bind(const std::string& queue, const std::string& routingKey, qpid::framing::FieldTable& args);
 };
@@ -103,9 +141,11 @@ public:
 
 RecoverableExchange::shared_ptr RecoveryManagerImpl::recoverExchange(framing::Buffer& buffer)
 {
+    PhaseTimer t(exchangePhase);
     Exchange::shared_ptr e = Exchange::decode(exchanges, buffer);
     if (e) {
-        return RecoverableExchange::shared_ptr(new RecoverableExchangeImpl(e, queues));
+        e->beginBindingBatch();
+        return RecoverableExchange::shared_ptr(new RecoverableExchangeImpl(e, queues, bindingPhase));
     } else {
         return RecoverableExchange::shared_ptr();
     }
@@ -113,7 +153,9 @@ RecoverableExchange::shared_ptr RecoveryManagerImpl::recoverExchange(framing::Bu
 
 RecoverableQueue::shared_ptr RecoveryManagerImpl::recoverQueue(framing::Buffer& buffer)
 {
+    PhaseTimer t(queuePhase);
     Queue::shared_ptr queue = Queue::restore(queues, buffer);
+    queue->beginRecoveryBatch();
     try {
         Exchange::shared_ptr exchange = exchanges.getDefault();
         if (exchange) {
@@ -128,14 +170,16 @@ RecoverableQueue::shared_ptr RecoveryManagerImpl::recoverQueue(framing::Buffer&
 
 RecoverableMessage::shared_ptr RecoveryManagerImpl::recoverMessage(framing::Buffer& buffer)
 {
+    PhaseTimer t(messagePhase);
     boost::intrusive_ptr<Message> message(new Message());
     message->decodeHeader(buffer);
-    return RecoverableMessage::shared_ptr(new RecoverableMessageImpl(message));
+    return RecoverableMessage::shared_ptr(new RecoverableMessageImpl(message, contentLimit));
 }
 
 RecoverableTransaction::shared_ptr RecoveryManagerImpl::recoverTransaction(const std::string& xid, 
                                                                            std::auto_ptr<TPCTransactionContext> txn)
 {
+    PhaseTimer t(txPhase);
     DtxBuffer::shared_ptr buffer(new DtxBuffer());
     dtxMgr.recover(xid, txn, buffer);
     return RecoverableTransaction::shared_ptr(new RecoverableTransactionImpl(buffer));
@@ -143,6 +187,7 @@ RecoverableTransaction::shared_ptr RecoveryManagerImpl::recoverTransaction(const
 
 RecoverableConfig::shared_ptr RecoveryManagerImpl::recoverConfig(framing::Buffer& buffer)
 {
+    PhaseTimer t(configPhase);
     string kind;
 
     buffer.getShortString (kind);
@@ -156,21 +201,35 @@ RecoverableConfig::shared_ptr RecoveryManagerImpl::recoverConfig(framing::Buffer
 
 void RecoveryManagerImpl::recoveryComplete()
 {
+    sys::AbsTime tables = sys::AbsTime::now();
+    endBindingBatches();
+    endRecoveryBatches();
+    sys::AbsTime notify = sys::AbsTime::now();
     //notify all queues and exchanges
     queues.eachQueue(boost::bind(&Queue::recoveryComplete, _1, boost::ref(exchanges)));
     exchanges.eachExchange(boost::bind(&Exchange::recoveryComplete, _1, boost::ref(exchanges)));
+    sys::AbsTime end = sys::AbsTime::now();
+    QPID_LOG(notice, "Recovered exchanges " << exchangePhase << ", queues " << queuePhase
+             << ", bindings " << bindingPhase << ", messages " << messagePhase
+             << ", links and bridges " << configPhase << ", transactions " << txPhase
+             << "; routing tables and queues built in " << sys::Duration(tables, notify) / sys::TIME_MSEC
+             << "ms, completion in " << sys::Duration(notify, end) / sys::TIME_MSEC
+             << "ms; total " << sys::Duration(start, end) / sys::TIME_MSEC << "ms");
 }
 
-RecoverableMessageImpl:: RecoverableMessageImpl(const intrusive_ptr<Message>& _msg) : msg(_msg)
+RecoverableMessageImpl:: RecoverableMessageImpl(const intrusive_ptr<Message>& _msg, uint64_t _contentLimit)
+    : msg(_msg), contentLimit(_contentLimit)
 {
     if (!msg->isPersistent()) {
         msg->forcePersistent(); // set so that message will get dequeued from store.
     }
 }
 
-bool RecoverableMessageImpl::loadContent(uint64_t /*available*/)
+bool RecoverableMessageImpl::loadContent(uint64_t available)
 {
-    return true;
+    // Content left in the store is loaded on delivery: Queue::recover()
+    // releases the content of any message that has none loaded.
+    return !contentLimit || available <= contentLimit;
 }
 
 void RecoverableMessageImpl::decodeContent(framing::Buffer& buffer)
@@ -240,6 +299,7 @@ void RecoverableExchangeImpl::bind(const string& queueName,
                                    const string& key,
                                    framing::FieldTable& args)
 {
+    PhaseTimer t(phase);
     Queue::shared_ptr queue = queues.find(queueName);
     exchange->bind(queue, key, &args);
     queue->bound(exchange->getName(), key, args);
@@ -27,18 +27,44 @@
 #include "qpid/broker/QueueRegistry.h"
 #include "qpid/broker/LinkRegistry.h"
 #include "qpid/broker/RecoveryManager.h"
+#include "qpid/sys/Time.h"
 
 namespace qpid {
 namespace broker {
 
     class RecoveryManagerImpl : public RecoveryManager{
+    public:
+        /** Number of objects recovered of one kind, and the time it took */
+        struct Phase {
+            uint64_t count;
+            int64_t time;       // Nanoseconds
+            Phase() : count(0), time(0) {}
+        };
+
+    private:
         QueueRegistry& queues;
         ExchangeRegistry& exchanges;
         LinkRegistry& links;
         DtxManager& dtxMgr;
+        uint64_t contentLimit;
+        sys::AbsTime start;
+        Phase exchangePhase, queuePhase, bindingPhase, messagePhase, configPhase, txPhase;
+
+        void endBindingBatches();
+        void endRecoveryBatches();
+
     public:
+        /**
+         * Messages with more than @a contentLimit bytes of content are
+         * recovered without it and load it from the store when needed;
+         * 0 means always recover the content.
+         *
+         * Exchanges build the tables route() reads once, on
+         * recoveryComplete(), rather than on every recovered binding,
+         * and queues load their recovered messages then too.
+         */
         RecoveryManagerImpl(QueueRegistry& queues, ExchangeRegistry& exchanges, LinkRegistry& links,
-                            DtxManager& dtxMgr);
+                            DtxManager& dtxMgr, uint64_t contentLimit = 0);
         ~RecoveryManagerImpl();
 
         RecoverableExchange::shared_ptr recoverExchange(framing::Buffer& buffer);
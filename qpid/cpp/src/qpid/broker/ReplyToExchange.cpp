@@ -0,0 +1,99 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "qpid/broker/ReplyToExchange.h"
+#include "qpid/broker/Queue.h"
+#include "qpid/framing/reply_exceptions.h"
+#include "qpid/log/Statement.h"
+
+using namespace qpid::broker;
+using namespace qpid::framing;
+using namespace qpid::sys;
+namespace _qmf = qmf::org::apache::qpid::broker;
+
+ReplyToExchange::ReplyToExchange(const std::string& _name, Manageable* _parent, Broker* b) :
+    Exchange(_name, _parent, b)
+{
+    if (mgmtExchange != 0)
+        mgmtExchange->set_type (typeName);
+}
+
+bool ReplyToExchange::bind(Queue::shared_ptr queue, const std::string& /*key*/, const FieldTable* /*args*/)
+{
+    throw NotAllowedException(QPID_MSG("Cannot bind " << queue->getName() << " to " << getName()
+                                       << "; subscribe to it as a queue instead"));
+}
+
+bool ReplyToExchange::unbind(Queue::shared_ptr, const std::string&, const FieldTable*)
+{
+    return false;
+}
+
+bool ReplyToExchange::isBound(Queue::shared_ptr, const std::string* const, const FieldTable* const)
+{
+    return false;
+}
+
+Queue::shared_ptr ReplyToExchange::find(const std::string& key) const
+{
+    Mutex::ScopedLock l(lock);
+    Queues::const_iterator i = queues.find(key);
+    return i == queues.end() ? Queue::shared_ptr() : i->second.lock();
+}
+
+void ReplyToExchange::route(Deliverable& msg, const std::string& routingKey, const FieldTable* /*args*/)
+{
+    PreRoute pr(msg, this);
+    Queue::shared_ptr queue = find(routingKey);
+    if (queue) {
+        msg.deliverTo(queue);
+    } else {
+        QPID_LOG(debug, "No requester for reply to " << routingKey << ", dropping it");
+    }
+
+    if (mgmtExchange != 0) {
+        mgmtExchange->inc_msgReceives  ();
+        mgmtExchange->inc_byteReceives (msg.contentSize ());
+        if (queue) {
+            mgmtExchange->inc_msgRoutes  ();
+            mgmtExchange->inc_byteRoutes (msg.contentSize ());
+        } else {
+            mgmtExchange->inc_msgDrops  ();
+            mgmtExchange->inc_byteDrops (msg.contentSize ());
+        }
+    }
+}
+
+void ReplyToExchange::add(const std::string& key, Queue::shared_ptr queue)
+{
+    Mutex::ScopedLock l(lock);
+    queues[key] = queue;
+}
+
+void ReplyToExchange::remove(const std::string& key)
+{
+    Mutex::ScopedLock l(lock);
+    queues.erase(key);
+}
+
+ReplyToExchange::~ReplyToExchange() {}
+
+const std::string ReplyToExchange::typeName("reply-to");
+const std::string ReplyToExchange::address("qpid.reply-to");
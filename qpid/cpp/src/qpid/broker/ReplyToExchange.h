@@ -0,0 +1,80 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef _ReplyToExchange_
+#define _ReplyToExchange_
+
+#include <map>
+#include "qpid/broker/BrokerImportExport.h"
+#include "qpid/broker/Exchange.h"
+#include "qpid/framing/FieldTable.h"
+#include "qpid/sys/Mutex.h"
+#include <boost/weak_ptr.hpp>
+
+namespace qpid {
+namespace broker {
+
+/**
+ * The broker's direct reply-to address. A session that subscribes to
+ * the pseudo-queue of the same name is given a private reply queue,
+ * known only to that session and this exchange, and registered here
+ * under a generated key. Requests the session publishes with a
+ * reply-to of this exchange and no routing key have the key filled
+ * in, so replies route straight to the requester's queue without
+ * anything being declared, bound or torn down for the call.
+ *
+ * Nothing can be bound to the exchange; replies for a session that
+ * has gone are dropped.
+ */
+class ReplyToExchange : public virtual Exchange {
+    typedef std::map<std::string, boost::weak_ptr<Queue> > Queues;
+    Queues queues;
+    mutable qpid::sys::Mutex lock;
+
+    boost::shared_ptr<Queue> find(const std::string& key) const;
+  public:
+    static const std::string typeName;
+    static const std::string address;
+
+    QPID_BROKER_EXTERN ReplyToExchange(const std::string& name,
+                                       management::Manageable* parent = 0, Broker* broker = 0);
+
+    virtual std::string getType() const { return typeName; }
+
+    virtual bool bind(boost::shared_ptr<Queue> queue, const std::string& routingKey,
+                      const qpid::framing::FieldTable* args);
+    virtual bool unbind(boost::shared_ptr<Queue> queue, const std::string& routingKey,
+                        const qpid::framing::FieldTable* args);
+    virtual bool isBound(boost::shared_ptr<Queue> queue, const std::string* const routingKey,
+                         const qpid::framing::FieldTable* const args);
+
+    QPID_BROKER_EXTERN virtual void route(Deliverable& msg, const std::string& routingKey,
+                                          const qpid::framing::FieldTable* args);
+
+    /** Route replies with routing key @a key to @a queue */
+    QPID_BROKER_EXTERN void add(const std::string& key, boost::shared_ptr<Queue> queue);
+    QPID_BROKER_EXTERN void remove(const std::string& key);
+
+    QPID_BROKER_EXTERN virtual ~ReplyToExchange();
+};
+
+}}
+
+#endif
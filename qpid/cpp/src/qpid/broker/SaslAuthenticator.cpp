@@ -27,7 +27,10 @@
 #include "qpid/log/Statement.h"
 #include "qpid/framing/reply_exceptions.h"
 #include "qpid/sys/SecuritySettings.h"
+#include "qpid/broker/AuthCache.h"
+#include "qpid/sys/Time.h"
 #include <boost/format.hpp>
+#include <sstream>
 
 #if HAVE_SASL
 #include <sasl/sasl.h>
@@ -66,15 +69,23 @@ public:
 
 
 
+namespace {
+
+AuthCache authCache;
+
+}
+
 class CyrusAuthenticator : public SaslAuthenticator
 {
     sasl_conn_t *sasl_conn;
     Connection& connection;
     framing::AMQP_ClientProxy::Connection client;
     const bool encrypt;
+    bool cached;
 
     void processAuthenticationStep(int code, const char *challenge, unsigned int challenge_len);
     bool getUsername(std::string& uid);
+    std::string cacheKey(const std::string& mechanism, const std::string& response);
 
 public:
     CyrusAuthenticator(Connection& connection, bool encrypt);
@@ -217,7 +228,7 @@ std::auto_ptr<SecurityLayer> NullAuthenticator::getSecurityLayer(uint16_t)
 #if HAVE_SASL
 
 CyrusAuthenticator::CyrusAuthenticator(Connection& c, bool _encrypt) : 
-    sasl_conn(0), connection(c), client(c.getOutput()), encrypt(_encrypt)
+    sasl_conn(0), connection(c), client(c.getOutput()), encrypt(_encrypt), cached(false)
 {
     init();
 }
@@ -376,6 +387,15 @@ void CyrusAuthenticator::getMechanisms(Array& mechanisms)
     }
 }
 
+std::string CyrusAuthenticator::cacheKey(const string& mechanism, const string& response)
+{
+    SecuritySettings external = connection.getExternalSecuritySettings();
+    std::ostringstream key;
+    key << mechanism << '\0' << connection.getBroker().getOptions().realm << '\0'
+        << encrypt << '\0' << external.ssf << '\0' << external.nodict << '\0' << external.authid << '\0' << response;
+    return key.str();
+}
+
 void CyrusAuthenticator::start(const string& mechanism, const string* response)
 {
     const char *challenge;
@@ -383,15 +403,41 @@ void CyrusAuthenticator::start(const string& mechanism, const string* response)
     
     // This should be at same debug level as mech list in getMechanisms().
     QPID_LOG(info, "SASL: Starting authentication with mechanism: " << mechanism);
+    qmf::org::apache::qpid::broker::Connection* cnxMgmt = connection.getMgmtObject();
+    const Broker::Options& opts = connection.getBroker().getOptions();
+    std::string key;
+    if (opts.authCacheSize && opts.authCacheTtl && response) {
+        key = cacheKey(mechanism, *response);
+        std::string uid;
+        if (authCache.find(key, uid)) {
+            QPID_LOG(info, connection.getMgmtId() << " SASL: Authentication succeeded for: " << uid << " (cached)");
+            cached = true;
+            connection.setUserId(uid);
+            client.tune(framing::CHANNEL_MAX, connection.getFrameMax(), 0, connection.getHeartbeatMax());
+            if ( cnxMgmt ) 
+                cnxMgmt->set_saslMechanism(mechanism);
+            return;
+        }
+    }
+
     int code = sasl_server_start(sasl_conn,
                                  mechanism.c_str(),
                                  (response ? response->c_str() : 0), (response ? response->size() : 0),
                                  &challenge, &challenge_len);
     
     processAuthenticationStep(code, challenge, challenge_len);
-    qmf::org::apache::qpid::broker::Connection* cnxMgmt = connection.getMgmtObject();
     if ( cnxMgmt ) 
         cnxMgmt->set_saslMechanism(mechanism);
+
+    // Remember it only if no security layer was negotiated, as a cached
+    // authentication cannot provide one.
+    const void* ssf(0);
+    std::string uid;
+    if (SASL_OK == code && !key.empty() &&
+        sasl_getprop(sasl_conn, SASL_SSF, &ssf) == SASL_OK && !*static_cast<const unsigned*>(ssf) &&
+        getUsername(uid)) {
+        authCache.insert(key, uid, opts.authCacheSize, opts.authCacheTtl*sys::TIME_SEC);
+    }
 }
         
 void CyrusAuthenticator::step(const string& response)
@@ -454,6 +500,12 @@ void CyrusAuthenticator::processAuthenticationStep(int code, const char *challen
 
 std::auto_ptr<SecurityLayer> CyrusAuthenticator::getSecurityLayer(uint16_t maxFrameSize)
 {
+    if (cached) {
+        qmf::org::apache::qpid::broker::Connection* cnxMgmt = connection.getMgmtObject();
+        if ( cnxMgmt ) 
+            cnxMgmt->set_saslSsf(0);
+        return std::auto_ptr<SecurityLayer>();
+    }
 
     const void* value(0);
     int result = sasl_getprop(sasl_conn, SASL_SSF, &value);
@@ -0,0 +1,612 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/broker/Selector.h"
+#include "qpid/broker/Message.h"
+#include "qpid/framing/DeliveryProperties.h"
+#include "qpid/framing/FieldTable.h"
+#include "qpid/framing/FieldValue.h"
+#include "qpid/framing/MessageProperties.h"
+#include "qpid/framing/reply_exceptions.h"
+#include "qpid/Msg.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace qpid {
+namespace broker {
+namespace selector {
+
+using framing::FieldTable;
+using framing::FieldValue;
+using framing::DeliveryProperties;
+using framing::MessageProperties;
+
+enum Truth { NO, YES, UNKNOWN };
+
+Truth truth(bool b) { return b ? YES : NO; }
+
+/** A value in an expression; NONE stands for a missing header */
+struct Value
+{
+    enum Type { NONE, BOOLEAN, EXACT, APPROX, STRING };
+
+    Type type;
+    bool b;
+    int64_t i;
+    double d;
+    std::string s;
+
+    Value() : type(NONE), b(false), i(0), d(0) {}
+    static Value boolean(bool v) { Value x; x.type = BOOLEAN; x.b = v; return x; }
+    static Value exact(int64_t v) { Value x; x.type = EXACT; x.i = v; return x; }
+    static Value approx(double v) { Value x; x.type = APPROX; x.d = v; return x; }
+    static Value string(const std::string& v) { Value x; x.type = STRING; x.s = v; return x; }
+
+    bool isNumeric() const { return type == EXACT || type == APPROX; }
+    double number() const { return type == EXACT ? double(i) : d; }
+};
+
+enum Op { EQ, NE, LT, LE, GT, GE };
+
+template <class T> bool test(Op op, const T& x, const T& y)
+{
+    switch (op) {
+      case EQ: return x == y;
+      case NE: return x != y;
+      case LT: return x < y;
+      case LE: return x <= y;
+      case GT: return x > y;
+      case GE: return x >= y;
+    }
+    return false;
+}
+
+/** Numbers compare in full; strings and booleans only for equality */
+Truth compare(const Value& a, Op op, const Value& b)
+{
+    if (a.type == Value::NONE || b.type == Value::NONE) return UNKNOWN;
+    if (a.isNumeric() && b.isNumeric()) {
+        if (a.type == Value::EXACT && b.type == Value::EXACT) return truth(test(op, a.i, b.i));
+        return truth(test(op, a.number(), b.number()));
+    }
+    if (a.type != b.type || (op != EQ && op != NE)) return UNKNOWN;
+    bool equal = a.type == Value::STRING ? a.s == b.s : a.b == b.b;
+    return truth(op == EQ ? equal : !equal);
+}
+
+class Operand
+{
+  public:
+    virtual ~Operand() {}
+    virtual Value eval(const Message&) const = 0;
+};
+
+class Literal : public Operand
+{
+    const Value value;
+  public:
+    Literal(const Value& v) : value(v) {}
+    Value eval(const Message&) const { return value; }
+};
+
+/**
+ * An application header or, failing that, one of the message
+ * properties a selector may name.
+ */
+class Header : public Operand
+{
+    enum Property { NO_PROPERTY, ROUTING_KEY, CORRELATION_ID, CONTENT_TYPE, PRIORITY };
+
+    const std::string name;
+    Property property;
+
+    Value convert(const FieldValue& v) const
+    {
+        try {
+            switch (v.getType()) {
+              case 0x08: return Value::boolean(v.get<int>() != 0);
+              case 0x23: return Value::approx(v.get<float>());
+              case 0x33: return Value::approx(v.get<double>());
+            }
+            if (v.convertsTo<std::string>()) return Value::string(v.get<std::string>());
+            if (v.convertsTo<int64_t>()) return Value::exact(v.get<int64_t>());
+        } catch (const framing::InvalidConversionException&) {}
+        return Value();
+    }
+
+    Value propertyValue(const Message& msg) const
+    {
+        if (property == ROUTING_KEY || property == PRIORITY) {
+            const DeliveryProperties* dp = msg.getProperties<DeliveryProperties>();
+            if (property == PRIORITY)
+                return Value::exact(dp && dp->hasPriority() ? dp->getPriority() : 4);
+            if (dp && dp->hasRoutingKey()) return Value::string(dp->getRoutingKey());
+        } else if (property != NO_PROPERTY) {
+            const MessageProperties* mp = msg.getProperties<MessageProperties>();
+            if (property == CORRELATION_ID && mp && mp->hasCorrelationId())
+                return Value::string(mp->getCorrelationId());
+            if (property == CONTENT_TYPE && mp && mp->hasContentType())
+                return Value::string(mp->getContentType());
+        }
+        return Value();
+    }
+
+  public:
+    Header(const std::string& n) : name(n), property(NO_PROPERTY)
+    {
+        if (name == "routing_key") property = ROUTING_KEY;
+        else if (name == "correlation_id") property = CORRELATION_ID;
+        else if (name == "content_type") property = CONTENT_TYPE;
+        else if (name == "priority") property = PRIORITY;
+    }
+
+    Value eval(const Message& msg) const
+    {
+        const MessageProperties* mp = msg.getProperties<MessageProperties>();
+        if (mp && mp->hasApplicationHeaders()) {
+            FieldTable::ValuePtr v = mp->getApplicationHeaders().get(name);
+            if (v) return convert(*v);
+        }
+        return propertyValue(msg);
+    }
+};
+
+typedef boost::shared_ptr<Operand> OperandPtr;
+typedef boost::shared_ptr<Condition> ConditionPtr;
+
+class Condition
+{
+  public:
+    virtual ~Condition() {}
+    virtual Truth eval(const Message&) const = 0;
+};
+
+class And : public Condition
+{
+    const ConditionPtr left, right;
+  public:
+    And(ConditionPtr l, ConditionPtr r) : left(l), right(r) {}
+    Truth eval(const Message& msg) const
+    {
+        Truth a = left->eval(msg);
+        if (a == NO) return NO;
+        Truth b = right->eval(msg);
+        if (b == NO) return NO;
+        return a == YES && b == YES ? YES : UNKNOWN;
+    }
+};
+
+class Or : public Condition
+{
+    const ConditionPtr left, right;
+  public:
+    Or(ConditionPtr l, ConditionPtr r) : left(l), right(r) {}
+    Truth eval(const Message& msg) const
+    {
+        Truth a = left->eval(msg);
+        if (a == YES) return YES;
+        Truth b = right->eval(msg);
+        if (b == YES) return YES;
+        return a == NO && b == NO ? NO : UNKNOWN;
+    }
+};
+
+class Not : public Condition
+{
+    const ConditionPtr condition;
+  public:
+    Not(ConditionPtr c) : condition(c) {}
+    Truth eval(const Message& msg) const
+    {
+        Truth a = condition->eval(msg);
+        return a == UNKNOWN ? UNKNOWN : truth(a == NO);
+    }
+};
+
+class Comparison : public Condition
+{
+    const Op op;
+    const OperandPtr left, right;
+  public:
+    Comparison(Op o, OperandPtr l, OperandPtr r) : op(o), left(l), right(r) {}
+    Truth eval(const Message& msg) const { return compare(left->eval(msg), op, right->eval(msg)); }
+};
+
+class IsNull : public Condition
+{
+    const OperandPtr operand;
+  public:
+    IsNull(OperandPtr o) : operand(o) {}
+    Truth eval(const Message& msg) const { return truth(operand->eval(msg).type == Value::NONE); }
+};
+
+/** A boolean header or literal standing alone as a condition */
+class IsTrue : public Condition
+{
+    const OperandPtr operand;
+  public:
+    IsTrue(OperandPtr o) : operand(o) {}
+    Truth eval(const Message& msg) const
+    {
+        Value v = operand->eval(msg);
+        return v.type == Value::BOOLEAN ? truth(v.b) : UNKNOWN;
+    }
+};
+
+class In : public Condition
+{
+    const OperandPtr operand;
+    const std::vector<Value> values;
+  public:
+    In(OperandPtr o, const std::vector<Value>& v) : operand(o), values(v) {}
+    Truth eval(const Message& msg) const
+    {
+        Value v = operand->eval(msg);
+        if (v.type == Value::NONE) return UNKNOWN;
+        for (std::vector<Value>::const_iterator i = values.begin(); i != values.end(); ++i)
+            if (compare(v, EQ, *i) == YES) return YES;
+        return NO;
+    }
+};
+
+class Like : public Condition
+{
+    static const int ANY_SEQUENCE = -1;   // %
+    static const int ANY_CHARACTER = -2;  // _
+
+    const OperandPtr operand;
+    std::vector<int> pattern;             // Characters, or one of the wildcards
+
+    bool match(const std::string& s) const
+    {
+        size_t p = 0, i = 0;
+        size_t retryP = std::string::npos, retryI = 0;
+        while (i < s.size()) {
+            if (p < pattern.size() && pattern[p] == ANY_SEQUENCE) {
+                retryP = p++;
+                retryI = i;
+            } else if (p < pattern.size() &&
+                       (pattern[p] == ANY_CHARACTER || pattern[p] == (unsigned char) s[i])) {
+                ++p;
+                ++i;
+            } else if (retryP != std::string::npos) {
+                // Let the last % take one more character
+                p = retryP + 1;
+                i = ++retryI;
+            } else {
+                return false;
+            }
+        }
+        while (p < pattern.size() && pattern[p] == ANY_SEQUENCE) ++p;
+        return p == pattern.size();
+    }
+
+  public:
+    Like(OperandPtr o, const std::string& text, int escape) : operand(o)
+    {
+        for (std::string::const_iterator i = text.begin(); i != text.end(); ++i) {
+            if (*i == escape && i + 1 != text.end()) pattern.push_back((unsigned char) *++i);
+            else if (*i == '%') pattern.push_back(ANY_SEQUENCE);
+            else if (*i == '_') pattern.push_back(ANY_CHARACTER);
+            else pattern.push_back((unsigned char) *i);
+        }
+    }
+
+    Truth eval(const Message& msg) const
+    {
+        Value v = operand->eval(msg);
+        return v.type == Value::STRING ? truth(match(v.s)) : UNKNOWN;
+    }
+};
+
+/**
+ * Recursive descent parser for
+ *
+ *   or        := and (OR and)*
+ *   and       := not (AND not)*
+ *   not       := NOT not | predicate
+ *   predicate := '(' or ')'
+ *              | operand ( op operand | IS [NOT] NULL | [NOT] LIKE string [ESCAPE string]
+ *                        | [NOT] IN '(' literal (',' literal)* ')'
+ *                        | [NOT] BETWEEN operand AND operand )?
+ *   operand   := identifier | "quoted identifier" | 'string' | [-]number | TRUE | FALSE
+ */
+class Parser
+{
+    enum TokenType { END, IDENTIFIER, QUOTED_IDENTIFIER, STRING, EXACT, APPROX, SYMBOL };
+
+    const std::string& text;
+    size_t position;
+    size_t start;            // Of the current token
+    TokenType type;
+    std::string token;
+
+    void fail(const std::string& what)
+    {
+        throw framing::InvalidArgumentException(
+            QPID_MSG("Invalid selector \"" << text << "\": " << what << " at position " << start));
+    }
+
+    std::string quoted(char quote)
+    {
+        std::string value;
+        for (++position; position < text.size(); ++position) {
+            if (text[position] == quote) {
+                if (position + 1 < text.size() && text[position + 1] == quote) ++position;
+                else {
+                    ++position;
+                    return value;
+                }
+            }
+            value += text[position];
+        }
+        fail("unterminated quote");
+        return value;
+    }
+
+    void next()
+    {
+        while (position < text.size() && std::isspace((unsigned char) text[position])) ++position;
+        start = position;
+        token.clear();
+        if (position == text.size()) {
+            type = END;
+            return;
+        }
+        char c = text[position];
+        if (std::isalpha((unsigned char) c) || c == '_' || c == '$') {
+            while (position < text.size() &&
+                   (std::isalnum((unsigned char) text[position]) || std::strchr("_$.", text[position]))) {
+                token += text[position++];
+            }
+            type = IDENTIFIER;
+        } else if (c == '\'') {
+            token = quoted(c);
+            type = STRING;
+        } else if (c == '"') {
+            token = quoted(c);
+            type = QUOTED_IDENTIFIER;
+        } else if (std::isdigit((unsigned char) c) ||
+                   (c == '.' && position + 1 < text.size() && std::isdigit((unsigned char) text[position + 1]))) {
+            type = EXACT;
+            while (position < text.size()) {
+                char d = text[position];
+                if (d == '.' || d == 'e' || d == 'E') {
+                    type = APPROX;
+                    if ((d == 'e' || d == 'E') && position + 1 < text.size() &&
+                        (text[position + 1] == '+' || text[position + 1] == '-')) {
+                        token += text[position++];
+                    }
+                } else if (!std::isdigit((unsigned char) d)) {
+                    break;
+                }
+                token += text[position++];
+            }
+        } else {
+            static const char* symbols[] = { "<>", "<=", ">=", "!=", "=", "<", ">", "(", ")", ",", "-", 0 };
+            for (const char** s = symbols; *s; ++s) {
+                size_t n = std::strlen(*s);
+                if (text.compare(position, n, *s) == 0) {
+                    token = *s;
+                    position += n;
+                    type = SYMBOL;
+                    return;
+                }
+            }
+            fail("unexpected character");
+        }
+    }
+
+    static bool isKeyword(const std::string& word)
+    {
+        static const char* keywords[] = { "AND", "OR", "NOT", "IS", "NULL", "LIKE", "ESCAPE",
+                                          "IN", "BETWEEN", "TRUE", "FALSE", 0 };
+        for (const char** k = keywords; *k; ++k)
+            if (equalsIgnoreCase(word, *k)) return true;
+        return false;
+    }
+
+    static bool equalsIgnoreCase(const std::string& word, const char* keyword)
+    {
+        size_t n = std::strlen(keyword);
+        if (word.size() != n) return false;
+        for (size_t i = 0; i < n; ++i)
+            if (std::toupper((unsigned char) word[i]) != keyword[i]) return false;
+        return true;
+    }
+
+    bool keyword(const char* k) const { return type == IDENTIFIER && equalsIgnoreCase(token, k); }
+    bool symbol(const char* s) const { return type == SYMBOL && token == s; }
+
+    void expectKeyword(const char* k)
+    {
+        if (!keyword(k)) fail(std::string("expected ") + k);
+        next();
+    }
+
+    void expectSymbol(const char* s)
+    {
+        if (!symbol(s)) fail(std::string("expected '") + s + "'");
+        next();
+    }
+
+    bool comparison(Op& op) const
+    {
+        if (type != SYMBOL) return false;
+        if (token == "=") op = EQ;
+        else if (token == "<>" || token == "!=") op = NE;
+        else if (token == "<") op = LT;
+        else if (token == "<=") op = LE;
+        else if (token == ">") op = GT;
+        else if (token == ">=") op = GE;
+        else return false;
+        return true;
+    }
+
+    Value literal()
+    {
+        Value v;
+        bool negative = false;
+        if (symbol("-")) {
+            negative = true;
+            next();
+            if (type != EXACT && type != APPROX) fail("expected a number");
+        }
+        if (type == STRING) v = Value::string(token);
+        else if (type == EXACT) v = Value::exact((negative ? -1 : 1) * std::strtoll(token.c_str(), 0, 10));
+        else if (type == APPROX) v = Value::approx((negative ? -1 : 1) * std::strtod(token.c_str(), 0));
+        else if (keyword("TRUE")) v = Value::boolean(true);
+        else if (keyword("FALSE")) v = Value::boolean(false);
+        else fail("expected a value");
+        next();
+        return v;
+    }
+
+    OperandPtr operand()
+    {
+        if (type == QUOTED_IDENTIFIER || (type == IDENTIFIER && !isKeyword(token))) {
+            OperandPtr header(new Header(token));
+            next();
+            return header;
+        }
+        return OperandPtr(new Literal(literal()));
+    }
+
+    ConditionPtr predicate()
+    {
+        if (symbol("(")) {
+            next();
+            ConditionPtr c = disjunction();
+            expectSymbol(")");
+            return c;
+        }
+        OperandPtr left = operand();
+        Op op;
+        if (comparison(op)) {
+            next();
+            return ConditionPtr(new Comparison(op, left, operand()));
+        }
+        if (keyword("IS")) {
+            next();
+            bool negated = keyword("NOT");
+            if (negated) next();
+            expectKeyword("NULL");
+            ConditionPtr c(new IsNull(left));
+            return negated ? ConditionPtr(new Not(c)) : c;
+        }
+        bool negated = keyword("NOT");
+        if (negated) next();
+        ConditionPtr c;
+        if (keyword("LIKE")) {
+            next();
+            if (type != STRING) fail("expected a pattern");
+            std::string pattern = token;
+            next();
+            int escape = -1;
+            if (keyword("ESCAPE")) {
+                next();
+                if (type != STRING || token.size() != 1) fail("expected an escape character");
+                escape = (unsigned char) token[0];
+                next();
+            }
+            c.reset(new Like(left, pattern, escape));
+        } else if (keyword("IN")) {
+            next();
+            expectSymbol("(");
+            std::vector<Value> values;
+            values.push_back(literal());
+            while (symbol(",")) {
+                next();
+                values.push_back(literal());
+            }
+            expectSymbol(")");
+            c.reset(new In(left, values));
+        } else if (keyword("BETWEEN")) {
+            next();
+            OperandPtr low = operand();
+            expectKeyword("AND");
+            OperandPtr high = operand();
+            c.reset(new And(ConditionPtr(new Comparison(GE, left, low)),
+                            ConditionPtr(new Comparison(LE, left, high))));
+        } else if (negated) {
+            fail("expected LIKE, IN or BETWEEN");
+        } else {
+            return ConditionPtr(new IsTrue(left));
+        }
+        return negated ? ConditionPtr(new Not(c)) : c;
+    }
+
+    ConditionPtr negation()
+    {
+        if (keyword("NOT")) {
+            next();
+            return ConditionPtr(new Not(negation()));
+        }
+        return predicate();
+    }
+
+    ConditionPtr conjunction()
+    {
+        ConditionPtr c = negation();
+        while (keyword("AND")) {
+            next();
+            c.reset(new And(c, negation()));
+        }
+        return c;
+    }
+
+    ConditionPtr disjunction()
+    {
+        ConditionPtr c = conjunction();
+        while (keyword("OR")) {
+            next();
+            c.reset(new Or(c, conjunction()));
+        }
+        return c;
+    }
+
+  public:
+    Parser(const std::string& t) : text(t), position(0), start(0), type(END) {}
+
+    ConditionPtr parse()
+    {
+        next();
+        if (type == END) fail("empty expression");
+        ConditionPtr c = disjunction();
+        if (type != END) fail("unexpected '" + token + "'");
+        return c;
+    }
+};
+
+} // namespace selector
+
+Selector::Selector(const std::string& e) : expression(e), condition(selector::Parser(e).parse()) {}
+
+Selector::~Selector() {}
+
+bool Selector::filter(const Message& msg) const
+{
+    return condition->eval(msg) == selector::YES;
+}
+
+}} // namespace qpid::broker
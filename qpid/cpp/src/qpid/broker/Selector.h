@@ -0,0 +1,67 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_BROKER_SELECTOR_H
+#define QPID_BROKER_SELECTOR_H
+
+#include "qpid/broker/BrokerImportExport.h"
+#include <boost/shared_ptr.hpp>
+#include <string>
+
+namespace qpid {
+namespace broker {
+
+class Message;
+
+namespace selector {
+class Condition;
+}
+
+/**
+ * A subscription's message selector: the JMS subset of SQL-92
+ * conditional expressions, over application headers and the message
+ * properties routing_key, correlation_id, content_type and priority.
+ * For example
+ *
+ *   colour IN ('red', 'green') AND (weight > 2.5 OR "x-urgent")
+ *
+ * The expression is parsed once into a tree that is evaluated against
+ * each message, looking up only the headers it names. As in SQL,
+ * comparisons involving a missing header are unknown, and only
+ * messages for which the whole expression is true are selected.
+ */
+class Selector
+{
+  public:
+    /** @exception framing::InvalidArgumentException if @a expression is not valid */
+    QPID_BROKER_EXTERN Selector(const std::string& expression);
+    QPID_BROKER_EXTERN ~Selector();
+
+    QPID_BROKER_EXTERN bool filter(const Message& msg) const;
+    const std::string& getExpression() const { return expression; }
+
+  private:
+    const std::string expression;
+    boost::shared_ptr<selector::Condition> condition;
+};
+
+}} // namespace qpid::broker
+
+#endif  /*!QPID_BROKER_SELECTOR_H*/
@@ -26,6 +26,8 @@
 #include "qpid/broker/DtxTimeout.h"
 #include "qpid/broker/Message.h"
 #include "qpid/broker/Queue.h"
+#include "qpid/broker/ReplyToExchange.h"
+#include "qpid/broker/Selector.h"
 #include "qpid/broker/SessionContext.h"
 #include "qpid/broker/SessionOutputException.h"
 #include "qpid/broker/TxAccept.h"
@@ -36,16 +38,21 @@
 #include "qpid/framing/IsInSequenceSet.h"
 #include "qpid/log/Statement.h"
 #include "qpid/sys/ClusterSafe.h"
+#include "qpid/sys/Probe.h"
 #include "qpid/ptr_map.h"
 #include "qpid/broker/AclModule.h"
 
 #include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/format.hpp>
 
 #include <iostream>
 #include <sstream>
 #include <algorithm>
 #include <functional>
+#include <map>
+#include <vector>
 
 #include <assert.h>
 
@@ -74,9 +81,19 @@ SemanticState::SemanticState(DeliveryAdapter& da, SessionContext& ss)
       userID(getSession().getConnection().getUserId()),
       userName(getSession().getConnection().getUserId().substr(0,getSession().getConnection().getUserId().find('@'))),
       isDefaultRealm(userID.find('@') != std::string::npos && getSession().getBroker().getOptions().realm == userID.substr(userID.find('@')+1,userID.size())),
-      closeComplete(false)
+      closeComplete(false),
+      publishAclGeneration(0),
+      creditDispatch(*this),
+      replenishing(0)
 {}
 
+namespace {
+ReplyToExchange& replyTo(Broker& broker)
+{
+    return dynamic_cast<ReplyToExchange&>(*broker.getExchanges().get(ReplyToExchange::address));
+}
+}
+
 SemanticState::~SemanticState() {
     closed();
 }
@@ -91,16 +108,35 @@ void SemanticState::closed() {
             dtxBuffer->fail();
         }
         recover(true);
+        presettled.clear();
 
         //now unsubscribe, which may trigger queue deletion and thus
         //needs to occur after the requeueing of unacked messages
         for (ConsumerImplMap::iterator i = consumers.begin(); i != consumers.end(); i++) {
             unsubscribe(i->second);
         }
+        if (session.isAttached())
+            session.getConnection().outputTasks.removeOutputTask(&creditDispatch);
+        if (replyQueue) {
+            replyTo(session.getBroker()).remove(replyQueue->getName());
+            replyQueue->destroyed();
+        }
         closeComplete = true;
     }
 }
 
+Queue::shared_ptr SemanticState::getReplyQueue()
+{
+    if (!replyQueue) {
+        // Known only to this session and the exchange: not registered,
+        // managed or stored, and the generated name doubles as its key
+        replyQueue.reset(new Queue(ReplyToExchange::address + "." + Uuid(true).str(), false, 0,
+                                   &session, 0, &session.getBroker()));
+        replyTo(session.getBroker()).add(replyQueue->getName(), replyQueue);
+    }
+    return replyQueue;
+}
+
 bool SemanticState::exists(const string& consumerTag){
     return consumers.find(consumerTag) != consumers.end();
 }
@@ -116,9 +152,11 @@ void SemanticState::consume(const string& tag,
     // "tag" is only guaranteed to be unique to this session (see AMQP 0-10 Message.subscribe, destination).
     // Create a globally unique name so the broker can identify individual consumers
     std::string name = session.getSessionId().str() + SEPARATOR + tag;
+    if (queue->isPartitioned()) queue = queue->partitionForConsumer();
     ConsumerImpl::shared_ptr c(new ConsumerImpl(this, name, queue, ackRequired, acquire, exclusive, tag, resumeId, resumeTtl, arguments));
     queue->consume(c, exclusive);//may throw exception
     consumers[tag] = c;
+    if (c->isAutoReplenish()) ++replenishing;
 }
 
 bool SemanticState::cancel(const string& tag)
@@ -126,6 +164,14 @@ bool SemanticState::cancel(const string& tag)
     ConsumerImplMap::iterator i = consumers.find(tag);
     if (i != consumers.end()) {
         cancel(i->second);
+        if (i->second->isAutoReplenish()) --replenishing;
+        if (!presettled.empty()) {
+            ConsumerImpl* c = i->second.get();
+            std::deque<PresettledCredit>::iterator kept = presettled.begin();
+            for (std::deque<PresettledCredit>::iterator j = presettled.begin(); j != presettled.end(); ++j)
+                if (j->consumer != c) *kept++ = *j;
+            presettled.erase(kept, presettled.end());
+        }
         consumers.erase(i);
         //should cancel all unacked messages for this consumer so that
         //they are not redelivered on recovery
@@ -265,6 +311,10 @@ void SemanticState::record(const DeliveryRecord& delivery)
 }
 
 const std::string QPID_SYNC_FREQUENCY("qpid.sync_frequency");
+const std::string APACHE_SELECTOR("x-apache-selector");
+const std::string QPID_AUTO_REPLENISH("qpid.auto_replenish");
+const std::string QPID_OUTPUT_WEIGHT("qpid.output_weight");
+const std::string QPID_LOW_LATENCY("qpid.low_latency");
 
 SemanticState::ConsumerImpl::ConsumerImpl(SemanticState* _parent,
                                           const string& _name,
@@ -285,20 +335,28 @@ SemanticState::ConsumerImpl::ConsumerImpl(SemanticState* _parent,
     ackExpected(ack),
     acquire(_acquire),
     blocked(true),
+    creditPending(false),
     windowing(true),
     windowActive(false),
     exclusive(_exclusive),
     resumeId(_resumeId),
-    tag(_tag),
+    tag(new std::string(_tag)),
     resumeTtl(_resumeTtl),
     arguments(_arguments),
     msgCredit(0),
     byteCredit(0),
     notifyEnabled(true),
     syncFrequency(_arguments.getAsInt(QPID_SYNC_FREQUENCY)),
+    autoReplenish(_arguments.getAsInt(QPID_AUTO_REPLENISH) != 0),
+    outputWeight(std::max(_arguments.getAsInt(QPID_OUTPUT_WEIGHT), 1)),
+    lowLatency(_arguments.getAsInt(QPID_LOW_LATENCY) != 0),
+    // A cluster update replicates the unacked DeliveryRecords, so keep them there
+    settled(_acquire && !ack && !(parent && parent->session.getBroker().isInCluster())),
     deliveryCount(0),
     mgmtObject(0)
 {
+    std::string expression = _arguments.getAsString(APACHE_SELECTOR);
+    if (!expression.empty()) selector.reset(new Selector(expression));
     if (parent != 0 && queue.get() != 0 && queue->GetManagementObject() !=0)
     {
         ManagementAgent* agent = parent->session.getBroker().getManagementAgent();
@@ -337,12 +395,14 @@ OwnershipToken* SemanticState::ConsumerImpl::getSession()
 bool SemanticState::ConsumerImpl::deliver(QueuedMessage& msg)
 {
     assertClusterSafe();
-    allocateCredit(msg.payload);
-    DeliveryRecord record(msg, queue, getTag(), acquire, !ackExpected, windowing);
+    DeliveryRecord record(msg, queue, tag, acquire, !ackExpected, windowing);
     bool sync = syncFrequency && ++deliveryCount >= syncFrequency;
     if (sync) deliveryCount = 0;//reset
     parent->deliver(record, sync);
-    if (windowing || ackExpected || !acquire) {
+    QPID_PROBE(message_delivered, msg.payload.get(), queue.get());
+    if (windowing && settled) {
+        parent->recordPresettled(*this, record);
+    } else if (windowing || ackExpected || !acquire) {
         parent->record(record);
     }
     if (acquire && !ackExpected) {  // auto acquire && auto accept
@@ -353,9 +413,9 @@ bool SemanticState::ConsumerImpl::deliver(QueuedMessage& msg)
     return true;
 }
 
-bool SemanticState::ConsumerImpl::filter(intrusive_ptr<Message>)
+bool SemanticState::ConsumerImpl::filter(intrusive_ptr<Message> msg)
 {
-    return true;
+    return !selector || selector->filter(*msg);
 }
 
 bool SemanticState::ConsumerImpl::accept(intrusive_ptr<Message> msg)
@@ -366,10 +426,21 @@ bool SemanticState::ConsumerImpl::accept(intrusive_ptr<Message> msg)
     // remain on queue's listener list for possible smaller messages
     // in future.
     //
-    blocked = !(filter(msg) && checkCredit(msg));
+    blocked = !checkCredit(msg);
+    //credit is taken here rather than on delivery, as a queue may
+    //accept a batch of messages for a consumer before delivering any
+    if (!blocked) allocateCredit(msg);
     return !blocked;
 }
 
+void SemanticState::ConsumerImpl::unaccept(intrusive_ptr<Message> msg)
+{
+    assertClusterSafe();
+    if (msgCredit != 0xFFFFFFFF) msgCredit++;
+    if (byteCredit != 0xFFFFFFFF) byteCredit += msg->getRequiredCredit();
+    blocked = false;
+}
+
 namespace {
 struct ConsumerName {
     const SemanticState::ConsumerImpl& consumer;
@@ -418,6 +489,8 @@ SemanticState::ConsumerImpl::~ConsumerImpl()
 
 void SemanticState::disable(ConsumerImpl::shared_ptr c)
 {
+    if (c->setCreditPending(false))
+        creditChanged.erase(std::remove(creditChanged.begin(), creditChanged.end(), c.get()), creditChanged.end());
     c->disableNotify();
     if (session.isAttached())
         session.getConnection().outputTasks.removeOutputTask(c.get());
@@ -428,6 +501,9 @@ void SemanticState::unsubscribe(ConsumerImpl::shared_ptr c)
     Queue::shared_ptr queue = c->getQueue();
     if(queue) {
         queue->cancel(c);
+        // Consumers of a partition count towards the queue it partitions
+        Queue::shared_ptr partitioned = queue->getPartitioned();
+        if (partitioned) queue = partitioned;
         if (queue->canAutoDelete() && !queue->hasExclusiveOwner()) {
             Queue::tryAutoDelete(session.getBroker(), queue);
         }
@@ -442,10 +518,10 @@ void SemanticState::cancel(ConsumerImpl::shared_ptr c)
 
 void SemanticState::handle(intrusive_ptr<Message> msg) {
     if (txBuffer.get()) {
-        TxPublish* deliverable(new TxPublish(msg));
-        TxOp::shared_ptr op(deliverable);
+        // One allocation for the op and its reference count
+        boost::shared_ptr<TxPublish> deliverable(boost::make_shared<TxPublish>(msg));
         route(msg, *deliverable);
-        txBuffer->enlist(op);
+        txBuffer->enlist(deliverable);
     } else {
         DeliverableMessage deliverable(msg);
         route(msg, deliverable);
@@ -469,6 +545,49 @@ namespace
 const std::string nullstring;
 }
 
+namespace
+{
+// A session publishing to more distinct destinations than this starts its memo afresh
+const size_t MAX_PUBLISH_ACL = 1024;
+}
+
+bool SemanticState::authorisePublish(AclModule& acl, const std::string& exchange, const std::string& routingKey)
+{
+    // read before the lookup, so a reload racing with it just forces another lookup
+    uint32_t generation = acl.getGeneration();
+    if (generation != publishAclGeneration) {
+        publishAcl.clear();
+        publishAclGeneration = generation;
+    }
+    std::string key(exchange);
+    key.push_back('\0');
+    key.append(routingKey);
+    PublishAcl::const_iterator i = publishAcl.find(key);
+    if (i != publishAcl.end()) return i->second;
+
+    bool memoisable = false;
+    bool allowed = acl.authorise(getSession().getConnection().getUserId(), acl::ACT_PUBLISH, acl::OBJ_EXCHANGE,
+                                 exchange, routingKey, memoisable);
+    if (memoisable) {
+        if (publishAcl.size() >= MAX_PUBLISH_ACL) publishAcl.clear();
+        publishAcl[key] = allowed;
+    }
+    return allowed;
+}
+
+/**
+ * A request with a reply-to of the direct reply-to address and no key
+ * gets the key of this session's reply queue.
+ */
+void SemanticState::directReplyTo(Message& msg)
+{
+    const MessageProperties* props = msg.getProperties<MessageProperties>();
+    if (props && props->hasReplyTo() && props->getReplyTo().getExchange() == ReplyToExchange::address
+        && props->getReplyTo().getRoutingKey().empty()) {
+        msg.setReplyTo(ReplyTo(ReplyToExchange::address, replyQueue->getName()));
+    }
+}
+
 void SemanticState::route(intrusive_ptr<Message> msg, Deliverable& strategy) {
     msg->computeExpiration(getSession().getBroker().getExpiryPolicy());
 
@@ -476,6 +595,7 @@ void SemanticState::route(intrusive_ptr<Message> msg, Deliverable& strategy) {
     if (!cacheExchange || cacheExchange->getName() != exchangeName || cacheExchange->isDestroyed())
         cacheExchange = session.getBroker().getExchanges().get(exchangeName);
     cacheExchange->setProperties(msg);
+    if (replyQueue) directReplyTo(*msg);
 
     /* verify the userid if specified: */
     std::string id =
@@ -489,7 +609,7 @@ void SemanticState::route(intrusive_ptr<Message> msg, Deliverable& strategy) {
     AclModule* acl = getSession().getBroker().getAcl();
     if (acl && acl->doTransferAcl())
     {
-        if (!acl->authorise(getSession().getConnection().getUserId(),acl::ACT_PUBLISH,acl::OBJ_EXCHANGE,exchangeName, msg->getRoutingKey() ))
+        if (!authorisePublish(*acl, exchangeName, msg->getRoutingKey()))
             throw UnauthorizedAccessException(QPID_MSG(userID << " cannot publish to " <<
                                                exchangeName << " with routing-key " << msg->getRoutingKey()));
     }
@@ -512,20 +632,61 @@ void SemanticState::route(intrusive_ptr<Message> msg, Deliverable& strategy) {
 
 void SemanticState::requestDispatch()
 {
+    bool added = false;
     for (ConsumerImplMap::iterator i = consumers.begin(); i != consumers.end(); i++)
-        i->second->requestDispatch();
+        added = i->second->addToOutput() || added;
+    if (added) session.getConnection().outputTasks.activateOutput();
 }
 
 void SemanticState::ConsumerImpl::requestDispatch()
 {
-    assertClusterSafe();
-    if (blocked) {
-        parent->session.getConnection().outputTasks.addOutputTask(this);
+    if (addToOutput())
         parent->session.getConnection().outputTasks.activateOutput();
-        blocked = false;
+}
+
+bool SemanticState::ConsumerImpl::addToOutput()
+{
+    assertClusterSafe();
+    if (!blocked) return false;
+    parent->session.getConnection().outputTasks.addOutputTask(this);
+    blocked = false;
+    return true;
+}
+
+/**
+ * Credit from message.flow or auto-replenishment is applied at once,
+ * but the consumer is only handed to the output tasks on the next
+ * output cycle. Many flow commands in one read then cost a single
+ * output activation rather than one each.
+ */
+void SemanticState::requestCreditDispatch(ConsumerImpl& c)
+{
+    if (c.setCreditPending(true)) return;
+    creditChanged.push_back(&c);
+    if (creditChanged.size() == 1) {
+        session.getConnection().outputTasks.addOutputTask(&creditDispatch);
+        session.getConnection().outputTasks.activateOutput();
     }
 }
 
+void SemanticState::dispatchCredit()
+{
+    std::vector<ConsumerImpl*> changed;
+    changed.swap(creditChanged);
+    for (std::vector<ConsumerImpl*>::iterator i = changed.begin(); i != changed.end(); ++i) {
+        (*i)->setCreditPending(false);
+        // Added consumers run later in the same output cycle
+        (*i)->addToOutput();
+    }
+}
+
+void SemanticState::replenish(DeliveryRecord& delivery)
+{
+    ConsumerImplMap::iterator i = consumers.find(delivery.getTag());
+    if (i != consumers.end() && i->second->replenish(delivery))
+        requestCreditDispatch(*i->second);
+}
+
 bool SemanticState::complete(DeliveryRecord& delivery)
 {
     ConsumerImplMap::iterator i = consumers.find(delivery.getTag());
@@ -539,13 +700,43 @@ void SemanticState::ConsumerImpl::complete(DeliveryRecord& delivery)
 {
     if (!delivery.isComplete()) {
         delivery.complete();
-        if (windowing && windowActive) {
-            if (msgCredit != 0xFFFFFFFF) msgCredit++;
-            if (byteCredit != 0xFFFFFFFF) byteCredit += delivery.getCredit();
-        }
+        restoreWindow(delivery.getCredit());
+    }
+}
+
+void SemanticState::ConsumerImpl::restoreWindow(uint32_t credit)
+{
+    if (windowing && windowActive) {
+        if (msgCredit != 0xFFFFFFFF) msgCredit++;
+        if (byteCredit != 0xFFFFFFFF) byteCredit += credit;
     }
 }
 
+void SemanticState::recordPresettled(ConsumerImpl& consumer, const DeliveryRecord& delivery)
+{
+    presettled.push_back(PresettledCredit(delivery.getId(), delivery.getCredit(), &consumer));
+}
+
+void SemanticState::completePresettled(const SequenceSet& commands)
+{
+    // Both are in id order, so one pass restores the credit
+    IsInSequenceSet isInSet(commands);
+    std::deque<PresettledCredit>::iterator kept = presettled.begin();
+    for (std::deque<PresettledCredit>::iterator i = presettled.begin(); i != presettled.end(); ++i) {
+        if (isInSet(i->id)) i->consumer->restoreWindow(i->credit);
+        else *kept++ = *i;
+    }
+    presettled.erase(kept, presettled.end());
+}
+
+bool SemanticState::ConsumerImpl::replenish(const DeliveryRecord& delivery)
+{
+    if (windowing || !autoReplenish) return false;
+    if (msgCredit != 0xFFFFFFFF) msgCredit++;
+    if (byteCredit != 0xFFFFFFFF) byteCredit += delivery.getCredit();
+    return true;
+}
+
 void SemanticState::recover(bool requeue)
 {
     if(requeue){
@@ -603,7 +794,7 @@ void SemanticState::addByteCredit(const std::string& destination, uint32_t value
 {
     ConsumerImpl::shared_ptr c = find(destination);
     c->addByteCredit(value);
-    c->requestDispatch();
+    requestCreditDispatch(*c);
 }
 
 
@@ -611,7 +802,7 @@ void SemanticState::addMessageCredit(const std::string& destination, uint32_t va
 {
     ConsumerImpl::shared_ptr c = find(destination);
     c->addMessageCredit(value);
-    c->requestDispatch();
+    requestCreditDispatch(*c);
 }
 
 void SemanticState::flush(const std::string& destination)
@@ -663,6 +854,11 @@ void SemanticState::ConsumerImpl::addMessageCredit(uint32_t value)
     }
 }
 
+size_t SemanticState::ConsumerImpl::dispatchBatch()
+{
+    return parent->session.getBroker().getOptions().dispatchBatch;
+}
+
 bool SemanticState::ConsumerImpl::haveCredit()
 {
     if (msgCredit && byteCredit) {
@@ -675,7 +871,7 @@ bool SemanticState::ConsumerImpl::haveCredit()
 
 void SemanticState::ConsumerImpl::flush()
 {
-    while(haveCredit() && queue->dispatch(shared_from_this()))
+    while(haveCredit() && queue->dispatch(shared_from_this(), dispatchBatch()))
         ;
     msgCredit = 0;
     byteCredit = 0;
@@ -740,7 +936,7 @@ void SemanticState::reject(DeliveryId first, DeliveryId last)
 bool SemanticState::ConsumerImpl::doOutput()
 {
     try {
-        return haveCredit() && queue->dispatch(shared_from_this());
+        return haveCredit() && queue->dispatch(shared_from_this(), dispatchBatch());
     } catch (const SessionException& e) {
         throw SessionOutputException(e, parent->session.getChannel());
     }
@@ -791,6 +987,42 @@ isInSequenceSetAnd(const SequenceSet& s, Predicate p) {
     return IsInSequenceSetAnd<Predicate>(s,p);
 }
 
+namespace {
+/**
+ * Collects the messages accepted from each queue so that every queue
+ * dequeues its share of an accept in one call.
+ */
+class AcceptBatch
+{
+    typedef std::map<Queue*, std::pair<Queue::shared_ptr, std::vector<QueuedMessage> > > Queues;
+    typedef boost::function<void(DeliveryRecord&)> Replenish;
+    Queues queues;
+    Replenish replenish;
+
+  public:
+    AcceptBatch(Replenish r) : replenish(r) {}
+
+    // As DeliveryRecord::accept() without a transaction, but deferring the dequeue
+    bool accept(DeliveryRecord& record)
+    {
+        if (record.isAcquired() && !record.isEnded()) {
+            Queues::mapped_type& entry = queues[record.getQueue().get()];
+            if (!entry.first) entry.first = record.getQueue();
+            entry.second.push_back(record.getMessage());
+            record.setEnded();
+            if (replenish) replenish(record);
+        }
+        return record.isRedundant();
+    }
+
+    void dequeue()
+    {
+        for (Queues::iterator i = queues.begin(); i != queues.end(); ++i)
+            i->second.first->dequeueBatch(0, i->second.second);
+    }
+};
+}
+
 void SemanticState::accepted(const SequenceSet& commands) {
     assertClusterSafe();
     if (txBuffer.get()) {
@@ -814,22 +1046,33 @@ void SemanticState::accepted(const SequenceSet& commands) {
                                              bind(&DeliveryRecord::setEnded, _1)));
             unacked.erase(removed, unacked.end());
         }
-    } else {
+    } else if (!commands.empty()) {
+        // unacked is ordered by id, so only the records between the
+        // first and last accepted ids need to be visited
+        DeliveryId last = commands.back();
+        --last; // back() is one past the end of the set
+        AckRange range = findRange(commands.front(), last);
+        // Only look up the consumer of each record if one may want its credit back
+        AcceptBatch batch(replenishing ? boost::bind(&SemanticState::replenish, this, _1)
+                          : boost::function<void(DeliveryRecord&)>());
         DeliveryRecords::iterator removed =
-            remove_if(unacked.begin(), unacked.end(),
+            remove_if(range.start, range.end,
                       isInSequenceSetAnd(commands,
-                                         bind(&DeliveryRecord::accept, _1,
-                                              (TransactionContext*) 0)));
-        unacked.erase(removed, unacked.end());
+                                         bind(&AcceptBatch::accept, boost::ref(batch), _1)));
+        unacked.erase(removed, range.end);
+        batch.dequeue();
     }
 }
 
 void SemanticState::completed(const SequenceSet& commands) {
-    DeliveryRecords::iterator removed =
-        remove_if(unacked.begin(), unacked.end(),
-                  isInSequenceSetAnd(commands,
-                                     bind(&SemanticState::complete, this, _1)));
-    unacked.erase(removed, unacked.end());
+    if (!presettled.empty()) completePresettled(commands);
+    if (!unacked.empty()) {
+        DeliveryRecords::iterator removed =
+            remove_if(unacked.begin(), unacked.end(),
+                      isInSequenceSetAnd(commands,
+                                         bind(&SemanticState::complete, this, _1)));
+        unacked.erase(removed, unacked.end());
+    }
     requestDispatch();
 }
 
@@ -846,8 +1089,12 @@ void SemanticState::detached()
 {
     for (ConsumerImplMap::iterator i = consumers.begin(); i != consumers.end(); i++) {
         i->second->disableNotify();
+        i->second->setCreditPending(false);
         session.getConnection().outputTasks.removeOutputTask(i->second.get());
     }
+    // attached() hands every consumer to the output tasks again
+    creditChanged.clear();
+    session.getConnection().outputTasks.removeOutputTask(&creditDispatch);
 }
 
 }} // namespace qpid::broker
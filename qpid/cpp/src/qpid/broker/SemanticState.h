@@ -40,10 +40,13 @@
 #include "qpid/broker/AclModule.h"
 #include "qmf/org/apache/qpid/broker/Subscription.h"
 
+#include <deque>
 #include <list>
 #include <map>
 #include <vector>
 
+#include <boost/unordered_map.hpp>
+
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/intrusive_ptr.hpp>
 #include <boost/cast.hpp>
@@ -52,6 +55,7 @@ namespace qpid {
 namespace broker {
 
 class SessionContext;
+class Selector;
 
 /**
  *
@@ -79,23 +83,30 @@ class SemanticState : private boost::noncopyable {
         const bool ackExpected;
         const bool acquire;
         bool blocked;
+        bool creditPending;     // Queued for SemanticState::dispatchCredit()
         bool windowing;
         bool windowActive;
         bool exclusive;
         std::string resumeId;
-        const std::string tag;  // <destination> from AMQP 0-10 Message.subscribe command
+        const DeliveryRecord::Tag tag;  // <destination> from AMQP 0-10 Message.subscribe command
         uint64_t resumeTtl;
         framing::FieldTable arguments;
         uint32_t msgCredit;
         uint32_t byteCredit;
         bool notifyEnabled;
         const int syncFrequency;
+        const bool autoReplenish;
+        const uint32_t outputWeight;
+        const bool lowLatency;
+        const bool settled;     // Deliveries need no accept or release
         int deliveryCount;
         qmf::org::apache::qpid::broker::Subscription* mgmtObject;
+        boost::shared_ptr<Selector> selector;
 
         bool checkCredit(boost::intrusive_ptr<Message>& msg);
         void allocateCredit(boost::intrusive_ptr<Message>& msg);
         bool haveCredit();
+        size_t dispatchBatch();
 
       public:
         typedef boost::shared_ptr<ConsumerImpl> shared_ptr;
@@ -110,6 +121,7 @@ class SemanticState : private boost::noncopyable {
         bool deliver(QueuedMessage& msg);
         bool filter(boost::intrusive_ptr<Message> msg);
         bool accept(boost::intrusive_ptr<Message> msg);
+        void unaccept(boost::intrusive_ptr<Message> msg);
 
         void disableNotify();
         void enableNotify();
@@ -117,6 +129,9 @@ class SemanticState : private boost::noncopyable {
         bool isNotifyEnabled() const;
 
         void requestDispatch();
+        /** Add to the connection's output tasks if blocked, without activating output.
+         *@return true if added */
+        bool addToOutput();
 
         void setWindowMode();
         void setCreditMode();
@@ -125,11 +140,20 @@ class SemanticState : private boost::noncopyable {
         void flush();
         void stop();
         void complete(DeliveryRecord&);
+        /** Restore the window credit of a completed delivery */
+        void restoreWindow(uint32_t credit);
+        /** Restore the credit of an accepted delivery if in auto-replenish credit mode.
+         *@return true if credit was restored */
+        bool replenish(const DeliveryRecord&);
         boost::shared_ptr<Queue> getQueue() const { return queue; }
         bool isBlocked() const { return blocked; }
         bool setBlocked(bool set) { std::swap(set, blocked); return set; }
+        bool setCreditPending(bool set) { std::swap(set, creditPending); return set; }
+        bool isAutoReplenish() const { return autoReplenish; }
 
         bool doOutput();
+        uint32_t getOutputWeight() const { return outputWeight; }
+        bool isLowLatency() const { return lowLatency; }
 
         bool isAckExpected() const { return ackExpected; }
         bool isAcquire() const { return acquire; }
@@ -138,7 +162,7 @@ class SemanticState : private boost::noncopyable {
         uint32_t getMsgCredit() const { return msgCredit; }
         uint32_t getByteCredit() const { return byteCredit; }
         std::string getResumeId() const { return resumeId; };
-        const std::string& getTag() const { return tag; }
+        const std::string& getTag() const { return *tag; }
         uint64_t getResumeTtl() const { return resumeTtl; }
         const framing::FieldTable& getArguments() const { return arguments; }
 
@@ -154,6 +178,17 @@ class SemanticState : private boost::noncopyable {
   private:
     typedef std::map<std::string, ConsumerImpl::shared_ptr> ConsumerImplMap;
 
+    /** Output task that applies the credit changes queued since the last output */
+    class CreditDispatch : public sys::OutputTask
+    {
+        SemanticState& parent;
+      public:
+        CreditDispatch(SemanticState& p) : parent(p) {}
+        bool doOutput() { parent.dispatchCredit(); return false; }
+    };
+
+    typedef boost::unordered_map<std::string, bool> PublishAcl; // exchange and routing key -> allowed
+
     SessionContext& session;
     DeliveryAdapter& deliveryAdapter;
     ConsumerImplMap consumers;
@@ -165,14 +200,35 @@ class SemanticState : private boost::noncopyable {
     DtxBufferMap suspendedXids;
     framing::SequenceSet accumulatedAck;
     boost::shared_ptr<Exchange> cacheExchange;
+    boost::shared_ptr<Queue> replyQueue;
     const bool authMsg;
     const std::string userID;
     const std::string userName;
     const bool isDefaultRealm;
     bool closeComplete;
+    PublishAcl publishAcl;
+    uint32_t publishAclGeneration;
+    std::vector<ConsumerImpl*> creditChanged;
+    CreditDispatch creditDispatch;
+    uint32_t replenishing;      // Consumers in auto-replenish mode
+
+    /**
+     * The window credit a pre-settled delivery holds until the peer
+     * completes it. Kept instead of a DeliveryRecord, as nothing else
+     * about the delivery is needed once it is sent.
+     */
+    struct PresettledCredit {
+        DeliveryId id;
+        uint32_t credit;
+        ConsumerImpl* consumer;
+        PresettledCredit(DeliveryId i, uint32_t c, ConsumerImpl* p) : id(i), credit(c), consumer(p) {}
+    };
+    std::deque<PresettledCredit> presettled; // In delivery id order
 
     void route(boost::intrusive_ptr<Message> msg, Deliverable& strategy);
+    void directReplyTo(Message& msg);
     void checkDtxTimeout();
+    bool authorisePublish(AclModule& acl, const std::string& exchange, const std::string& routingKey);
 
     bool complete(DeliveryRecord&);
     AckRange findRange(DeliveryId first, DeliveryId last);
@@ -180,6 +236,11 @@ class SemanticState : private boost::noncopyable {
     void cancel(ConsumerImpl::shared_ptr);
     void unsubscribe(ConsumerImpl::shared_ptr);
     void disable(ConsumerImpl::shared_ptr);
+    void requestCreditDispatch(ConsumerImpl&);
+    void dispatchCredit();
+    void replenish(DeliveryRecord&);
+    void recordPresettled(ConsumerImpl&, const DeliveryRecord&);
+    void completePresettled(const framing::SequenceSet& commands);
 
   public:
 
@@ -200,6 +261,12 @@ class SemanticState : private boost::noncopyable {
      */
     boost::shared_ptr<Queue> getQueue(const std::string& name) const;
 
+    /**
+     * The queue behind this session's subscriptions to the direct
+     * reply-to address (see ReplyToExchange), created on first use.
+     */
+    boost::shared_ptr<Queue> getReplyQueue();
+
     bool exists(const std::string& consumerTag);
 
     void consume(const std::string& destination,
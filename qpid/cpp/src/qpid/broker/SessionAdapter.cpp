@@ -18,6 +18,7 @@
 #include "qpid/broker/SessionAdapter.h"
 #include "qpid/broker/Connection.h"
 #include "qpid/broker/Queue.h"
+#include "qpid/broker/ReplyToExchange.h"
 #include "qpid/Exception.h"
 #include "qpid/framing/reply_exceptions.h"
 #include "qpid/framing/enum.h"
@@ -410,7 +411,7 @@ SessionAdapter::MessageHandlerImpl::subscribe(const string& queueName,
              throw UnauthorizedAccessException(QPID_MSG("ACL denied Queue subscribe request from " << getConnection().getUserId()));
     }
 
-    Queue::shared_ptr queue = getQueue(queueName);
+    Queue::shared_ptr queue = queueName == ReplyToExchange::address ? state.getReplyQueue() : getQueue(queueName);
     if(!destination.empty() && state.exists(destination))
         throw NotAllowedException(QPID_MSG("Consumer tags must be unique"));
 
@@ -80,6 +80,7 @@ void SessionHandler::detaching()
 }
 
 FrameHandler* SessionHandler::getInHandler() { return session.get() ? &session->in : 0; }
+void SessionHandler::handleInData(framing::AMQFrame& f) { session->receive(f); }
 qpid::SessionState* SessionHandler::getState() { return session.get(); }
 
 void SessionHandler::readyToSend() {
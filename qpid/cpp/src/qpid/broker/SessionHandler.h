@@ -65,6 +65,9 @@ class SessionHandler : public amqp_0_10::SessionHandler {
         return clusterOrderProxy.get() ? *clusterOrderProxy : proxy;
     }
 
+    /** Entry point for incoming frames, bypassing the in handler chain. */
+    void receive(framing::AMQFrame& f) { amqp_0_10::SessionHandler::handleIn(f); }
+
     virtual void handleDetach();
     void attached(const std::string& name);//used by 'pushing' inter-broker bridges
     void attachAs(const std::string& name);//used by 'pulling' inter-broker bridges
@@ -73,6 +76,7 @@ class SessionHandler : public amqp_0_10::SessionHandler {
     virtual void setState(const std::string& sessionName, bool force);
     virtual qpid::SessionState* getState();
     virtual framing::FrameHandler* getInHandler();
+    virtual void handleInData(framing::AMQFrame& f);
     virtual void connectionException(framing::connection::CloseCode code, const std::string& msg);
     virtual void channelException(framing::session::DetachCode, const std::string& msg);
     virtual void executionException(framing::execution::ErrorCode, const std::string& msg);
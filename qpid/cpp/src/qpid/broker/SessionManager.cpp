@@ -27,6 +27,7 @@
 #include "qpid/memory.h"
 
 #include <boost/bind.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/range.hpp>
 
 #include <algorithm>
@@ -44,21 +45,40 @@ SessionManager::SessionManager(const SessionState::Configuration& c, Broker& b)
     : config(c), broker(b) {}
 
 SessionManager::~SessionManager() {
-    detached.clear();           // Must clear before destructor as session dtor will call forget()
+    for (size_t s = 0; s < SHARDS; ++s) {
+        Detached detached;
+        {
+            Mutex::ScopedLock l(shards[s].lock);
+            detached.swap(shards[s].detached);
+        }
+        for (Detached::iterator i = detached.begin(); i != detached.end(); ++i) {
+            i->second.expiry->cancel();
+            delete i->second.session;
+        }
+    }
+}
+
+SessionManager::Shard& SessionManager::shardFor(const SessionId& id) {
+    size_t hash = 0;
+    boost::hash_combine(hash, id.getUserId());
+    boost::hash_combine(hash, id.getName());
+    return shards[hash % SHARDS];
 }
 
 std::auto_ptr<SessionState>  SessionManager::attach(SessionHandler& h, const SessionId& id, bool/*force*/) {
-    Mutex::ScopedLock l(lock);
-    eraseExpired();             // Clean up expired table
-    std::pair<Attached::iterator, bool> insert = attached.insert(id);
+    Shard& shard = shardFor(id);
+    Mutex::ScopedLock l(shard.lock);
+    std::pair<Attached::iterator, bool> insert = shard.attached.insert(id);
     if (!insert.second)
         throw SessionBusyException(QPID_MSG("Session already attached: " << id));
-    Detached::iterator i = std::find(detached.begin(), detached.end(), id);
+    Detached::iterator i = shard.detached.find(id);
     std::auto_ptr<SessionState> state;
-    if (i == detached.end())  
+    if (i == shard.detached.end())  
         state.reset(new SessionState(broker, h, id, config));
     else {
-        state.reset(detached.release(i).release());
+        i->second.expiry->cancel();
+        state.reset(i->second.session);
+        shard.detached.erase(i);
         state->attach(h);
     }
     return state;
@@ -66,39 +86,46 @@ std::auto_ptr<SessionState>  SessionManager::attach(SessionHandler& h, const Ses
 }
 
 void  SessionManager::detach(std::auto_ptr<SessionState> session) {
-    Mutex::ScopedLock l(lock);
-    attached.erase(session->getId());
+    Shard& shard = shardFor(session->getId());
+    Mutex::ScopedLock l(shard.lock);
+    shard.attached.erase(session->getId());
     session->detach();
     if (session->getTimeout() > 0) {
-    session->expiry = AbsTime(now(),session->getTimeout()*TIME_SEC);
-    if (session->mgmtObject != 0)
-        session->mgmtObject->set_expireTime ((uint64_t) Duration (EPOCH, session->expiry));
-        detached.push_back(session.release()); // In expiry order
-    eraseExpired();
-}
+        session->expiry = AbsTime(now(),session->getTimeout()*TIME_SEC);
+        if (session->mgmtObject != 0)
+            session->mgmtObject->set_expireTime ((uint64_t) Duration (EPOCH, session->expiry));
+        DetachedSession& d = shard.detached[session->getId()];
+        d.expiry = new Expiry(*this, session->getId(), session->getTimeout()*TIME_SEC);
+        d.session = session.release();
+        broker.getTimer().add(d.expiry);
+    }
 }
 
 void SessionManager::forget(const SessionId& id) {
-    Mutex::ScopedLock l(lock);
-    attached.erase(id);
+    Shard& shard = shardFor(id);
+    Mutex::ScopedLock l(shard.lock);
+    shard.attached.erase(id);
 }
 
-void SessionManager::eraseExpired() {
-    // Called with lock held.
-    if (!detached.empty()) {
-        // This used to use a more elegant invocation of std::lower_bound
-        // but violated the strict weak ordering rule which Visual Studio
-        // enforced. See QPID-1424 for more info should you be tempted to
-        // replace the loop with something more elegant.
-        AbsTime now = AbsTime::now();
-        Detached::iterator keep = detached.begin();
-        while ((keep != detached.end()) && ((*keep).expiry < now))
-            keep++;
-        if (detached.begin() != keep) {
-            QPID_LOG(debug, "Expiring sessions: " << log::formatList(detached.begin(), keep));
-            detached.erase(detached.begin(), keep);
-        }
+void SessionManager::expire(const SessionId& id, TimerTask* expiry) {
+    std::auto_ptr<SessionState> expired;
+    {
+        Shard& shard = shardFor(id);
+        Mutex::ScopedLock l(shard.lock);
+        Detached::iterator i = shard.detached.find(id);
+        // The session may have been resumed, and detached again, since this was scheduled
+        if (i == shard.detached.end() || i->second.expiry.get() != expiry) return;
+        expired.reset(i->second.session);
+        shard.detached.erase(i);
     }
+    QPID_LOG(debug, "Expiring session: " << id);
+}
+
+SessionManager::Expiry::Expiry(SessionManager& m, const SessionId& i, Duration timeout)
+    : TimerTask(timeout, "SessionExpiry"), manager(m), id(i) {}
+
+void SessionManager::Expiry::fire() {
+    manager.expire(id, this);
 }
 
 }} // namespace qpid::broker
@@ -25,14 +25,14 @@
 #include <qpid/SessionState.h>
 #include <qpid/sys/Time.h>
 #include <qpid/sys/Mutex.h>
+#include <qpid/sys/Timer.h>
 #include <qpid/RefCounted.h>
 
+#include <map>
 #include <set>
-#include <vector>
 #include <memory>
 
 #include <boost/noncopyable.hpp>
-#include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/intrusive_ptr.hpp>
 
 namespace qpid {
@@ -64,14 +64,35 @@ class SessionManager : private boost::noncopyable {
     const qpid::SessionState::Configuration& getSessionConfig() const { return config; }
 
   private:
-    typedef boost::ptr_vector<SessionState> Detached; // Sorted in expiry order.
+    // Each detached session has its own timer task to expire it.
+    struct Expiry : public sys::TimerTask {
+        SessionManager& manager;
+        const SessionId id;
+        Expiry(SessionManager& manager, const SessionId& id, sys::Duration timeout);
+        void fire();
+    };
+
+    struct DetachedSession {
+        SessionState* session;  // Owned by the manager
+        boost::intrusive_ptr<sys::TimerTask> expiry;
+    };
+    typedef std::map<SessionId, DetachedSession> Detached;
     typedef std::set<SessionId> Attached;
 
-    void eraseExpired();             
+    // Sessions are spread over a fixed number of tables by id, each with
+    // its own lock, so attaching or detaching one session does not hold
+    // up the others.
+    struct Shard {
+        sys::Mutex lock;
+        Detached detached;
+        Attached attached;
+    };
+    static const size_t SHARDS = 32;
 
-    sys::Mutex lock;
-    Detached detached;
-    Attached attached;
+    Shard& shardFor(const SessionId& id);
+    void expire(const SessionId& id, sys::TimerTask* expiry);
+
+    Shard shards[SHARDS];
     qpid::SessionState::Configuration config;
     Broker& broker;
 };
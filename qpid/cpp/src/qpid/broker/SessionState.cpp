@@ -19,12 +19,15 @@
  *
  */
 #include "qpid/broker/SessionState.h"
+#include "qpid/broker/Bridge.h"
 #include "qpid/broker/Broker.h"
 #include "qpid/broker/ConnectionState.h"
 #include "qpid/broker/DeliveryRecord.h"
 #include "qpid/broker/SessionManager.h"
 #include "qpid/broker/SessionHandler.h"
 #include "qpid/broker/RateFlowcontrol.h"
+#include "qpid/broker/RateLimits.h"
+#include "qpid/broker/TokenBucket.h"
 #include "qpid/sys/ClusterSafe.h"
 #include "qpid/sys/Timer.h"
 #include "qpid/framing/AMQContentBody.h"
@@ -60,14 +63,23 @@ SessionState::SessionState(
       broker(b), handler(&h),
       semanticState(*this, *this),
       adapter(semanticState),
-      msgBuilder(&broker.getStore()),
+      msgBuilder(&broker.getStore(), broker.getContentSpill().get(), broker.getOptions().memorySpillReceiveSize),
       mgmtObject(0),
       rateFlowcontrol(0),
       asyncCommandCompleter(new AsyncCommandCompleter(this))
 {
+    ingressFailed = false;
+    ConnectionState& c = handler->getConnection();
+    connectionRate = c.getRateBucket();
+    userRate = broker.getRateLimits().getUserBucket(c.getUserId());
+    // A session can never send faster than any limit it shares
     uint32_t maxRate = broker.getOptions().maxSessionRate;
+    if (connectionRate && (!maxRate || connectionRate->getRate() < maxRate))
+        maxRate = connectionRate->getRate();
+    if (userRate && (!maxRate || userRate->getRate() < maxRate))
+        maxRate = userRate->getRate();
     if (maxRate) {
-        if (handler->getConnection().getClientThrottling()) {
+        if (c.getClientThrottling()) {
             rateFlowcontrol.reset(new RateFlowcontrol(maxRate));
         } else {
             QPID_LOG(warning, getId() << ": Unable to flow control client - client doesn't support");
@@ -90,7 +102,7 @@ void SessionState::addManagementObject() {
             mgmtObject->clr_expireTime();
             if (rateFlowcontrol)
                 mgmtObject->set_maxClientRate(rateFlowcontrol->getRate());
-            agent->addObject(mgmtObject);
+            agent->addDeferredObject(mgmtObject);
         }
     }
 }
@@ -101,8 +113,8 @@ SessionState::~SessionState() {
     if (mgmtObject != 0)
         mgmtObject->resourceDestroy ();
 
-    if (flowControlTimer)
-        flowControlTimer->cancel();
+    if (rateFlowcontrol)
+        broker.getRateLimits().closed(*this);
 }
 
 AMQP_ClientProxy& SessionState::getProxy() {
@@ -142,6 +154,7 @@ void SessionState::disableOutput()
 void SessionState::attach(SessionHandler& h) {
     QPID_LOG(debug, getId() << ": attached on broker.");
     handler = &h;
+    ingressFailed = false;
     if (mgmtObject != 0)
     {
         mgmtObject->set_attached (1);
@@ -221,30 +234,6 @@ void SessionState::handleCommand(framing::AMQMethodBody* method, const SequenceN
     }
 }
 
-struct ScheduledCreditTask : public sys::TimerTask {
-    sys::Timer& timer;
-    SessionState& sessionState;
-    ScheduledCreditTask(const qpid::sys::Duration& d, sys::Timer& t,
-                        SessionState& s) :
-        TimerTask(d,"ScheduledCredit"),
-        timer(t),
-        sessionState(s)
-    {}
-
-    void fire() {
-        // This is the best we can currently do to avoid a destruction/fire race
-        sessionState.getConnection().requestIOProcessing(boost::bind(&ScheduledCreditTask::sendCredit, this));
-    }
-
-    void sendCredit() {
-        if ( !sessionState.processSendCredit(0) ) {
-            QPID_LOG(warning, sessionState.getId() << ": Reschedule sending credit");
-            setupNextFire();
-            timer.add(this);
-        }
-    }
-};
-
 void SessionState::handleContent(AMQFrame& frame, const SequenceNumber& id)
 {
     if (frame.getBof() && frame.getBos()) //start of frameset
@@ -263,6 +252,7 @@ void SessionState::handleContent(AMQFrame& frame, const SequenceNumber& id)
             msg->setTimestamp();
         msg->setPublisher(&getConnection());
         msg->getIngressCompletion().begin();
+        if (boost::shared_ptr<Bridge> b = bridge.lock()) b->forwarded(msg->contentSize());
         semanticState.handle(msg);
         msgBuilder.end();
         IncompleteIngressMsgXfer xfer(this, msg);
@@ -273,11 +263,7 @@ void SessionState::handleContent(AMQFrame& frame, const SequenceNumber& id)
     if (rateFlowcontrol && frame.getBof() && frame.getBos()) {
         if ( !processSendCredit(1) ) {
             QPID_LOG(debug, getId() << ": Schedule sending credit");
-            sys::Timer& timer = getBroker().getTimer();
-            // Use heuristic for scheduled credit of time for 50 messages, but not longer than 500ms
-            sys::Duration d = std::min(sys::TIME_SEC * 50 / rateFlowcontrol->getRate(), 500 * sys::TIME_MSEC);
-            flowControlTimer = new ScheduledCreditTask(d, timer, *this);
-            timer.add(flowControlTimer);
+            broker.getRateLimits().stalled(*this);
         }
     }
 }
@@ -293,8 +279,8 @@ bool SessionState::processSendCredit(uint32_t msgs)
         getClusterOrderProxy().getMessage().stop("");
         return true;
     }
-    AbsTime now = AbsTime::now();
-    uint32_t sendCredit = rateFlowcontrol->receivedMessage(now, msgs);
+    AbsTime now = AbsTime::coarseNow();
+    uint32_t sendCredit = takeSharedCredit(now, rateFlowcontrol->receivedMessage(now, msgs));
     if (mgmtObject) mgmtObject->dec_clientCredit(msgs);
     if ( sendCredit>0 ) {
         QPID_LOG(debug, getId() << ": send producer credit " << sendCredit);
@@ -307,6 +293,20 @@ bool SessionState::processSendCredit(uint32_t msgs)
     }
 }
 
+// Limit credit to what the connection and user limits allow
+uint32_t SessionState::takeSharedCredit(const AbsTime& now, uint32_t credit)
+{
+    if (credit && connectionRate)
+        credit = connectionRate->take(now, credit);
+    if (credit && userRate) {
+        uint32_t granted = userRate->take(now, credit);
+        if (connectionRate && granted < credit)
+            connectionRate->giveBack(credit - granted);
+        credit = granted;
+    }
+    return credit;
+}
+
 void SessionState::sendAcceptAndCompletion()
 {
     if (!accepted.empty()) {
@@ -323,7 +323,8 @@ void SessionState::sendAcceptAndCompletion()
  */
 void SessionState::completeRcvMsg(SequenceNumber id,
                                   bool requiresAccept,
-                                  bool requiresSync)
+                                  bool requiresSync,
+                                  const std::string& error)
 {
     // Mark this as a cluster-unsafe scope since it can be called in
     // journal threads or connection threads as part of asynchronous
@@ -332,6 +333,16 @@ void SessionState::completeRcvMsg(SequenceNumber id,
 
     bool callSendCompletion = false;
     receiverCompleted(id);
+    if (!error.empty()) {
+        // The publisher learns of the failure from the exception, not an
+        // accept. Execution sync and completion end with the session.
+        if (!ingressFailed) {
+            ingressFailed = true;
+            handler->handleException(InternalErrorException(
+                QPID_MSG("Message " << id << " could not be stored: " << error)));
+        }
+        return;
+    }
     if (requiresAccept)
         // will cause msg's seq to appear in the next message.accept we send.
         accepted.add(id);
@@ -379,6 +390,7 @@ void SessionState::deliver(DeliveryRecord& msg, bool sync)
     SequenceNumber commandId = senderGetCommandPoint().command;
     msg.deliver(getProxy().getHandler(), commandId, maxFrameSize);
     assert(senderGetCommandPoint() == SessionPoint(commandId+1, 0)); // Delivery has moved sendPoint.
+    if (boost::shared_ptr<Bridge> b = bridge.lock()) b->forwarded(msg.getMessage().payload->contentSize());
     if (sync) {
         AMQP_ClientProxy::Execution& p(getProxy().getExecution());
         Proxy::ScopedSync s(p);
@@ -407,7 +419,11 @@ void SessionState::readyToSend() {
         // See comment on getClusterOrderProxy() in .h file
         getClusterOrderProxy().getMessage().setFlowMode("", 0);
         getClusterOrderProxy().getMessage().flow("", 0, credit);
-        rateFlowcontrol->sentCredit(AbsTime::now(), credit);
+        AbsTime now = AbsTime::coarseNow();
+        rateFlowcontrol->sentCredit(now, credit);
+        // Initial credit is not refused, it is paid off from later refills
+        if (connectionRate) connectionRate->charge(now, credit);
+        if (userRate) userRate->charge(now, credit);
         if (mgmtObject) mgmtObject->inc_clientCredit(credit);
     }
 }
@@ -467,6 +483,7 @@ SessionState::IncompleteIngressMsgXfer::clone()
 void SessionState::IncompleteIngressMsgXfer::completed(bool sync)
 {
     if (pending) completerContext->deletePendingMessage(id);
+    std::string error = msg->getIngressCompletion().getError();
     if (!sync) {
         /** note well: this path may execute in any thread.  It is safe to access
          * the scheduledCompleterContext, since *this has a shared pointer to it.
@@ -474,13 +491,13 @@ void SessionState::IncompleteIngressMsgXfer::completed(bool sync)
          */
         session = 0;
         QPID_LOG(debug, ": async completion callback scheduled for msg seq=" << id);
-        completerContext->scheduleMsgCompletion(id, requiresAccept, requiresSync);
+        completerContext->scheduleMsgCompletion(id, requiresAccept, requiresSync, error);
     } else {
         // this path runs directly from the ac->end() call in handleContent() above,
         // so *session is definately valid.
         if (session->isAttached()) {
             QPID_LOG(debug, ": receive completed for msg seq=" << id);
-            session->completeRcvMsg(id, requiresAccept, requiresSync);
+            session->completeRcvMsg(id, requiresAccept, requiresSync, error);
         }
     }
     completerContext = boost::intrusive_ptr<AsyncCommandCompleter>();
@@ -537,12 +554,13 @@ void SessionState::AsyncCommandCompleter::flushPendingMessages()
  */
 void SessionState::AsyncCommandCompleter::scheduleMsgCompletion(SequenceNumber cmd,
                                                                 bool requiresAccept,
-                                                                bool requiresSync)
+                                                                bool requiresSync,
+                                                                const std::string& error)
 {
     qpid::sys::ScopedLock<qpid::sys::Mutex> l(completerLock);
 
     if (session && isAttached) {
-        MessageInfo msg(cmd, requiresAccept, requiresSync);
+        MessageInfo msg(cmd, requiresAccept, requiresSync, error);
         completedMsgs.push_back(msg);
         if (completedMsgs.size() == 1) {
             session->getConnection().requestIOProcessing(boost::bind(&schedule,
@@ -563,7 +581,7 @@ void SessionState::AsyncCommandCompleter::completeCommands()
     if (session && session->isAttached()) {
         for (std::vector<MessageInfo>::iterator msg = completedMsgs.begin();
              msg != completedMsgs.end(); ++msg) {
-            session->completeRcvMsg(msg->cmd, msg->requiresAccept, msg->requiresSync);
+            session->completeRcvMsg(msg->cmd, msg->requiresAccept, msg->requiresSync, msg->error);
         }
     }
     completedMsgs.clear();
@@ -39,6 +39,8 @@
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/intrusive_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 
 #include <set>
 #include <vector>
@@ -56,12 +58,14 @@ class TimerTask;
 
 namespace broker {
 
+class Bridge;
 class Broker;
 class ConnectionState;
 class Message;
 class SessionHandler;
 class SessionManager;
 class RateFlowcontrol;
+class TokenBucket;
 
 /**
  * Broker-side session state includes session's handler chains, which
@@ -95,6 +99,9 @@ class SessionState : public qpid::SessionState,
 
     Broker& getBroker();
 
+    /** Same as in.handle() without the indirection, for SessionHandler */
+    void receive(framing::AMQFrame& f) { SessionState::handleIn(f); }
+
     void setTimeout(uint32_t seconds);
 
     /** OutputControl **/
@@ -133,13 +140,20 @@ class SessionState : public qpid::SessionState,
     // belonging to inter-broker bridges
     void addManagementObject();
 
+    // Set on the session carrying an inter-broker bridge, which counts
+    // the messages the session receives (pull) or delivers (push).
+    void setBridge(const boost::shared_ptr<Bridge>& b) { bridge = b; }
+
   private:
     void handleCommand(framing::AMQMethodBody* method, const framing::SequenceNumber& id);
     void handleContent(framing::AMQFrame& frame, const framing::SequenceNumber& id);
 
     // indicate that the given ingress msg has been completely received by the
     // broker, and the msg's message.transfer command can be considered completed.
-    void completeRcvMsg(SequenceNumber id, bool requiresAccept, bool requiresSync);
+    // A non-empty error means the msg could not be stored: it is not accepted,
+    // and the session ends with an execution exception.
+    void completeRcvMsg(SequenceNumber id, bool requiresAccept, bool requiresSync,
+                        const std::string& error = std::string());
 
     void handleIn(framing::AMQFrame& frame);
     void handleOut(framing::AMQFrame& frame);
@@ -149,6 +163,7 @@ class SessionState : public qpid::SessionState,
     void handleOutLast(framing::AMQFrame& frame);
 
     void sendAcceptAndCompletion();
+    uint32_t takeSharedCredit(const sys::AbsTime& now, uint32_t credit);
 
     /**
      * If commands are sent based on the local time (e.g. in timers), they don't have
@@ -167,15 +182,18 @@ class SessionState : public qpid::SessionState,
     MessageBuilder msgBuilder;
     qmf::org::apache::qpid::broker::Session* mgmtObject;
     qpid::framing::SequenceSet accepted;
+    boost::weak_ptr<Bridge> bridge;
 
     // State used for producer flow control (rate limited)
     qpid::sys::Mutex rateLock;
     boost::scoped_ptr<RateFlowcontrol> rateFlowcontrol;
-    boost::intrusive_ptr<sys::TimerTask> flowControlTimer;
+    boost::shared_ptr<TokenBucket> connectionRate;  // Shared with the connection's other sessions
+    boost::shared_ptr<TokenBucket> userRate;        // Shared with the user's other sessions
 
     // sequence numbers for pending received Execution.Sync commands
     std::queue<SequenceNumber> pendingExecutionSyncs;
     bool currentCommandComplete;
+    bool ingressFailed;     // an execution exception has been raised for a failed msg
 
     /** This class provides a context for completing asynchronous commands in a thread
      * safe manner.  Asynchronous commands save their completion state in this class.
@@ -195,8 +213,9 @@ class SessionState : public qpid::SessionState,
             SequenceNumber cmd; // message.transfer command id
             bool requiresAccept;
             bool requiresSync;
-        MessageInfo(SequenceNumber c, bool a, bool s)
-        : cmd(c), requiresAccept(a), requiresSync(s) {}
+            std::string error;  // set if the msg could not be stored
+        MessageInfo(SequenceNumber c, bool a, bool s, const std::string& e)
+        : cmd(c), requiresAccept(a), requiresSync(s), error(e) {}
         };
         std::vector<MessageInfo> completedMsgs;
         // If an ingress message does not require a Sync, we need to
@@ -221,7 +240,8 @@ class SessionState : public qpid::SessionState,
         /** schedule the processing of a completed ingress message.transfer command */
         void scheduleMsgCompletion(SequenceNumber cmd,
                                    bool requiresAccept,
-                                   bool requiresSync);
+                                   bool requiresSync,
+                                   const std::string& error);
         void cancel();  // called by SessionState destructor.
         void attached();  // called by SessionState on attach()
         void detached();  // called by SessionState on detach()
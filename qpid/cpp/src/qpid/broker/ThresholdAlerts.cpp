@@ -96,7 +96,8 @@ void ThresholdAlerts::enqueued(const QueuedMessage& m)
             //tracking, and so we need to avoid recursing
             if (isThresholdEvent(m.payload)) return;
             lastAlert = qpid::sys::now();
-            agent.raiseEvent(qmf::org::apache::qpid::broker::EventQueueThresholdExceeded(name, count, size));
+            agent.raiseEvent(qmf::org::apache::qpid::broker::EventQueueThresholdExceeded(name, count, size),
+                             qpid::management::ManagementAgent::SEV_DEFAULT, name);
             QPID_LOG(info, "Threshold event triggered for " << name << ", count=" << count << ", size=" << size);
         }
     }
@@ -52,6 +52,8 @@ class ThresholdAlerts : public QueueObserver
     void dequeued(const QueuedMessage&);
     void acquired(const QueuedMessage&) {};
     void requeued(const QueuedMessage&) {};
+    /** Raising an event may enqueue on this very queue, so it is done outside messageLock */
+    bool isDeferred() const { return true; }
 
     static void observe(Queue& queue, qpid::management::ManagementAgent& agent,
                         const uint64_t countThreshold,
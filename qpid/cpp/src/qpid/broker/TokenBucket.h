@@ -0,0 +1,92 @@
+#ifndef broker_TokenBucket_h
+#define broker_TokenBucket_h
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/sys/Mutex.h"
+#include "qpid/sys/Time.h"
+#include "qpid/sys/IntegerTypes.h"
+
+#include <algorithm>
+
+namespace qpid {
+namespace broker {
+
+// Message rate limit that may be shared by several sessions.
+//
+// Tokens accumulate at rate per second up to one second's worth.
+// take() grants as many of the requested tokens as are available;
+// charge() takes tokens whether or not they are there, leaving a debt
+// that later refills must pay off before take() grants any more.
+//
+// Tokens are kept in units of 1/TIME_SEC so that refills between
+// frequent calls are not lost to rounding.
+class TokenBucket {
+    const uint32_t rate; // tokens per second
+    const int64_t capacity;
+    int64_t tokens;
+    qpid::sys::AbsTime refilled;
+    qpid::sys::Mutex lock;
+
+    void refill(const qpid::sys::AbsTime& t) {
+        int64_t d = qpid::sys::Duration(refilled, t);
+        if (d <= 0) return;
+        refilled = t;
+        // Once the bucket would be full the elapsed time no longer matters
+        if (d >= qpid::sys::TIME_SEC) tokens = capacity;
+        else tokens = std::min(capacity, tokens + rate * d);
+    }
+
+public:
+    TokenBucket(uint32_t r, const qpid::sys::AbsTime& t = qpid::sys::AbsTime::now()) :
+        rate(r),
+        capacity(int64_t(r) * qpid::sys::TIME_SEC),
+        tokens(capacity),
+        refilled(t)
+    {}
+
+    uint32_t getRate() const { return rate; }
+
+    uint32_t take(const qpid::sys::AbsTime& t, uint32_t wanted) {
+        qpid::sys::Mutex::ScopedLock l(lock);
+        refill(t);
+        int64_t whole = tokens / qpid::sys::TIME_SEC;
+        uint32_t granted = whole > 0 ? uint32_t(std::min(whole, int64_t(wanted))) : 0;
+        tokens -= int64_t(granted) * qpid::sys::TIME_SEC;
+        return granted;
+    }
+
+    void charge(const qpid::sys::AbsTime& t, uint32_t n) {
+        qpid::sys::Mutex::ScopedLock l(lock);
+        refill(t);
+        tokens -= int64_t(n) * qpid::sys::TIME_SEC;
+    }
+
+    void giveBack(uint32_t n) {
+        qpid::sys::Mutex::ScopedLock l(lock);
+        tokens = std::min(capacity, tokens + int64_t(n) * qpid::sys::TIME_SEC);
+    }
+};
+
+}}
+
+#endif // broker_TokenBucket_h
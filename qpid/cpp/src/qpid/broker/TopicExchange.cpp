@@ -42,6 +42,14 @@ namespace
 {
 const std::string STAR("*");
 const std::string HASH("#");
+const std::string qpidRouteCacheSize("qpid.route_cache_size");
+const size_t defaultRouteCacheSize(1000);
+
+size_t routeCacheSize(const FieldTable& args)
+{
+    int size = args.getAsInt(qpidRouteCacheSize);
+    return size > 0 ? size_t(size) : defaultRouteCacheSize;
+}
 }
 
 // iterator for federation ReOrigin bind operation
@@ -201,10 +209,99 @@ string TopicExchange::normalize(const string& pattern) {
     return normal;
 }
 
+bool TopicExchange::match(const string& pattern, const string& routingKey) {
+    return matchTokens(TokenIterator(pattern), TokenIterator(routingKey));
+}
+
+// Same matching rules as BindingNode::iterateMatch() for a single pattern
+bool TopicExchange::matchTokens(TokenIterator pattern, TokenIterator key) {
+    while (!pattern.finished()) {
+        if (pattern.match1('#')) {
+            pattern.next();
+            if (pattern.finished())
+                return true;
+            // try the rest of the pattern after each number of skipped tokens
+            while (!key.finished()) {
+                if (matchTokens(pattern, key))
+                    return true;
+                key.next();
+            }
+            return false;
+        }
+        if (key.finished())
+            return false;
+        if (!pattern.match1('*') && !key.match(pattern.token))
+            return false;
+        pattern.next();
+        key.next();
+    }
+    return key.finished();
+}
+
+bool TopicExchange::RouteCache::get(const string& routingKey, BindingList& b)
+{
+    RWlock::ScopedRlock l(lock);
+    EntryMap::iterator i = entries.find(routingKey);
+    if (i == entries.end())
+        return false;
+    if (!i->second->used.get()) i->second->used.boolCompareAndSwap(0, 1);
+    b = i->second->bindings;
+    return true;
+}
+
+void TopicExchange::RouteCache::put(const string& routingKey, const BindingList& b)
+{
+    RWlock::ScopedWlock l(lock);
+    EntryMap::iterator i = entries.find(routingKey);
+    if (i == entries.end()) {
+        if (entries.size() >= capacity) evict();
+        i = entries.insert(EntryMap::value_type(routingKey, boost::shared_ptr<Entry>(new Entry))).first;
+    }
+    i->second->bindings = b;
+    i->second->used = 1;
+}
+
+// Note well: write lock held by caller
+void TopicExchange::RouteCache::evict()
+{
+    // Every entry passed is unmarked, so this ends within one sweep
+    while (true) {
+        if (hand == entries.end()) hand = entries.begin();
+        if (hand == entries.end()) return;
+        if (hand->second->used.get()) {
+            hand->second->used = 0;
+            ++hand;
+        } else {
+            entries.erase(hand++);
+            return;
+        }
+    }
+}
+
+void TopicExchange::RouteCache::invalidate(const string& pattern)
+{
+    RWlock::ScopedWlock l(lock);
+    for (EntryMap::iterator i = entries.begin(); i != entries.end();) {
+        if (TopicExchange::match(pattern, i->first)) {
+            if (hand == i) ++hand;
+            entries.erase(i++);
+        } else {
+            ++i;
+        }
+    }
+}
+
+size_t TopicExchange::RouteCache::size()
+{
+    RWlock::ScopedRlock l(lock);
+    return entries.size();
+}
+
 
 TopicExchange::TopicExchange(const string& _name, Manageable* _parent, Broker* b)
     : Exchange(_name, _parent, b),
-      nBindings(0)
+      nBindings(0),
+      routeCache(defaultRouteCacheSize)
 {
     if (mgmtExchange != 0)
         mgmtExchange->set_type (typeName);
@@ -213,7 +310,8 @@ TopicExchange::TopicExchange(const string& _name, Manageable* _parent, Broker* b
 TopicExchange::TopicExchange(const std::string& _name, bool _durable,
                              const FieldTable& _args, Manageable* _parent, Broker* b) :
     Exchange(_name, _durable, _args, _parent, b),
-    nBindings(0)
+    nBindings(0),
+    routeCache(routeCacheSize(_args))
 {
     if (mgmtExchange != 0)
         mgmtExchange->set_type (typeName);
@@ -221,7 +319,6 @@ TopicExchange::TopicExchange(const std::string& _name, bool _durable,
 
 bool TopicExchange::bind(Queue::shared_ptr queue, const string& routingKey, const FieldTable* args)
 {
-    ClearCache cc(&cacheLock,&bindingCache); // clear the cache on function exit.
     string fedOp(args ? args->getAsString(qpidFedOp) : fedOpBind);
     string fedTags(args ? args->getAsString(qpidFedTags) : "");
     string fedOrigin(args ? args->getAsString(qpidFedOrigin) : "");
@@ -246,6 +343,7 @@ bool TopicExchange::bind(Queue::shared_ptr queue, const string& routingKey, cons
             binding->startManagement();
             bk->bindingVector.push_back(binding);
             nBindings++;
+            routeCache.invalidate(routingPattern);
             propagate = bk->fedBinding.addOrigin(queue->getName(), fedOrigin);
             if (mgmtExchange != 0) {
                 mgmtExchange->inc_bindingCount();
@@ -282,7 +380,6 @@ bool TopicExchange::bind(Queue::shared_ptr queue, const string& routingKey, cons
         }
     }
 
-    cc.clearCache(); // clear the cache before we IVE route.
     routeIVE();
     if (propagate)
         propagateFedOp(routingKey, fedTags, fedOp, fedOrigin);
@@ -295,7 +392,6 @@ bool TopicExchange::unbind(Queue::shared_ptr queue, const string& constRoutingKe
     QPID_LOG(debug, "Unbinding key [" << constRoutingKey << "] from queue " << queue->getName()
              << " on exchange " << getName() << " origin=" << fedOrigin << ")" );
 
-    ClearCache cc(&cacheLock,&bindingCache); // clear the cache on function exit.
     RWlock::ScopedWlock l(lock);
     string routingKey = normalize(constRoutingKey);
     BindingKey* bk = getQueueBinding(queue, routingKey);
@@ -322,6 +418,7 @@ bool TopicExchange::deleteBinding(Queue::shared_ptr queue,
     qv.erase(q);
     assert(nBindings > 0);
     nBindings--;
+    routeCache.invalidate(routingKey);
 
     if(qv.empty()) {
         bindingTree.removeBindingKey(routingKey);
@@ -354,23 +451,23 @@ void TopicExchange::route(Deliverable& msg, const string& routingKey, const Fiel
 {
     // Note: PERFORMANCE CRITICAL!!!
     BindingList b;
-    std::map<std::string, BindingList>::iterator it;
-    {  // only lock the cache for read
-       RWlock::ScopedRlock cl(cacheLock);
-       it = bindingCache.find(routingKey);
-       if (it != bindingCache.end()) {
-           b = it->second;
-       }
-    }
+    bool hit = routeCache.get(routingKey, b);
     PreRoute pr(msg, this);
-    if (!b.get())  // no cache hit
+    if (!hit)
     {
         RWlock::ScopedRlock l(lock);
     	b = BindingList(new std::vector<boost::shared_ptr<qpid::broker::Exchange::Binding> >);
         BindingsFinderIter bindingsFinder(b);
         bindingTree.iterateMatch(routingKey, bindingsFinder);
-        RWlock::ScopedWlock cwl(cacheLock);
-        bindingCache[routingKey] = b; // update cache
+        // Still holding the read lock so no bind/unbind can invalidate
+        // this entry before it is cached
+        routeCache.put(routingKey, b);
+    }
+    if (mgmtExchange != 0) {
+        if (hit)
+            mgmtExchange->inc_routeCacheHits();
+        else
+            mgmtExchange->inc_routeCacheMisses();
     }
     doRoute(msg, b);
 }
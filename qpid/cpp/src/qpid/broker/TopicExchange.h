@@ -26,6 +26,7 @@
 #include "qpid/broker/BrokerImportExport.h"
 #include "qpid/broker/Exchange.h"
 #include "qpid/framing/FieldTable.h"
+#include "qpid/sys/AtomicValue.h"
 #include "qpid/sys/Monitor.h"
 #include "qpid/broker/Queue.h"
 
@@ -135,27 +136,38 @@ class TopicExchange : public virtual Exchange {
     BindingNode bindingTree;
     unsigned long nBindings;
     qpid::sys::RWlock lock;     // protects bindingTree and nBindings
-    qpid::sys::RWlock cacheLock;     // protects cache
-    std::map<std::string, BindingList> bindingCache; // cache of matched routes.
-    class ClearCache {
-    private:
-        qpid::sys::RWlock* cacheLock;
-        std::map<std::string, BindingList>* bindingCache;
-	bool cleared; 
-    public:
-        ClearCache(qpid::sys::RWlock* l, std::map<std::string, BindingList>* bc): cacheLock(l),
-             bindingCache(bc),cleared(false) {};
-        void clearCache() {
-             qpid::sys::RWlock::ScopedWlock l(*cacheLock);
-             if (!cleared) {
-                 bindingCache->clear();
-                 cleared =true;
-             }
-        };
-        ~ClearCache(){ 
-	     clearCache();
+
+    // Bounded cache of routing key -> matched bindings.  Entries
+    // are invalidated selectively as patterns are bound and unbound.
+    // Hits only take a read lock and mark the entry as used; when full,
+    // a clock hand sweeps the entries clearing those marks and evicts
+    // the first it finds unmarked (approximately the least recently used).
+    class RouteCache {
+      public:
+        RouteCache(size_t capacity) : capacity(capacity), hand(entries.end()) {}
+        bool get(const std::string& routingKey, BindingList& b);
+        void put(const std::string& routingKey, const BindingList& b);
+        // remove entries for routing keys matching normalized pattern
+        void invalidate(const std::string& pattern);
+        size_t size();
+
+      private:
+        struct Entry {
+            BindingList bindings;
+            qpid::sys::AtomicValue<uint32_t> used;
         };
+        typedef std::map<std::string, boost::shared_ptr<Entry> > EntryMap;
+
+        qpid::sys::RWlock lock;
+        const size_t capacity;
+        EntryMap entries;
+        EntryMap::iterator hand;    // next entry the clock looks at
+
+        void evict();
     };
+    RouteCache routeCache;
+
+    static bool matchTokens(TokenIterator pattern, TokenIterator key);
     BindingKey *getQueueBinding(Queue::shared_ptr queue, const std::string& pattern);
     bool deleteBinding(Queue::shared_ptr queue,
                        const std::string& routingKey,
@@ -170,6 +182,9 @@ class TopicExchange : public virtual Exchange {
 
     static QPID_BROKER_EXTERN std::string normalize(const std::string& pattern);
 
+    /** true if routingKey matches the normalized binding pattern */
+    static QPID_BROKER_EXTERN bool match(const std::string& pattern, const std::string& routingKey);
+
     QPID_BROKER_EXTERN TopicExchange(const std::string& name,
                                      management::Manageable* parent = 0, Broker* broker = 0);
     QPID_BROKER_EXTERN TopicExchange(const std::string& _name,
@@ -48,7 +48,7 @@ void TxBuffer::rollback()
     ops.clear();
 }
 
-void TxBuffer::enlist(TxOp::shared_ptr op)
+void TxBuffer::enlist(const TxOp::shared_ptr& op)
 {
     ops.push_back(op);
 }
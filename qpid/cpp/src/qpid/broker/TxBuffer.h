@@ -69,7 +69,7 @@ namespace qpid {
             /**
              * Adds an operation to the transaction.
              */
-            QPID_BROKER_EXTERN void enlist(TxOp::shared_ptr op);
+            QPID_BROKER_EXTERN void enlist(const TxOp::shared_ptr& op);
 
             /**
              * Requests that all ops are prepared. This should
@@ -25,16 +25,13 @@
 using boost::intrusive_ptr;
 using namespace qpid::broker;
 
-TxPublish::TxPublish(intrusive_ptr<Message> _msg) : msg(_msg) {}
+TxPublish::TxPublish(intrusive_ptr<Message> _msg) : msg(_msg), prepared(0) {}
 
 bool TxPublish::prepare(TransactionContext* ctxt) throw()
 {
     try{
-        while (!queues.empty()) {
-            prepare(ctxt, queues.front());
-            prepared.push_back(queues.front());
-            queues.pop_front();
-        }
+        for (; prepared < queues.size(); ++prepared)
+            prepare(ctxt, queues[prepared]);
         return true;
     }catch(const std::exception& e){
         QPID_LOG(error, "Failed to prepare: " << e.what());
@@ -47,7 +44,7 @@ bool TxPublish::prepare(TransactionContext* ctxt) throw()
 void TxPublish::commit() throw()
 {
     try {
-        for_each(prepared.begin(), prepared.end(), Commit(msg));
+        for_each(queues.begin(), queues.begin() + prepared, Commit(msg));
         if (msg->isContentReleaseRequested()) {
             // NOTE: The log messages in this section are used for flow-to-disk testing (which checks the log for the
             // presence of these messages). Do not change these without also checking these tests.
@@ -70,7 +67,7 @@ void TxPublish::commit() throw()
 void TxPublish::rollback() throw()
 {
     try {
-        for_each(prepared.begin(), prepared.end(), Rollback(msg));
+        for_each(queues.begin(), queues.begin() + prepared, Rollback(msg));
     } catch (const std::exception& e) {
         QPID_LOG(error, "Failed to complete rollback: " << e.what());
     } catch(...) {
@@ -80,6 +77,10 @@ void TxPublish::rollback() throw()
 }
 
 void TxPublish::deliverTo(const boost::shared_ptr<Queue>& queue){
+    if (queue->isPartitioned()) {
+        deliverTo(queue->partitionFor(*msg));
+        return;
+    }
     if (!queue->isLocal(msg)) {
         queues.push_back(queue);
         delivered = true;
@@ -29,7 +29,7 @@
 
 #include <algorithm>
 #include <functional>
-#include <list>
+#include <vector>
 
 #include <boost/intrusive_ptr.hpp>
 
@@ -60,9 +60,14 @@ class QPID_BROKER_CLASS_EXTERN TxPublish : public TxOp, public Deliverable{
         void operator()(const boost::shared_ptr<Queue>& queue);
     };
 
+    typedef std::vector<boost::shared_ptr<Queue> > Queues;
+
     boost::intrusive_ptr<Message> msg;
-    std::list<boost::shared_ptr<Queue> > queues;
-    std::list<boost::shared_ptr<Queue> > prepared;
+    // The queues delivered to; the first prepared of them have been
+    // enqueued in the store. One vector rather than a list per state
+    // keeps large transactions to one small allocation per message.
+    Queues queues;
+    size_t prepared;
 
     void prepare(TransactionContext* ctxt, boost::shared_ptr<Queue>);
 
@@ -82,8 +87,9 @@ class QPID_BROKER_CLASS_EXTERN TxPublish : public TxOp, public Deliverable{
     QPID_BROKER_EXTERN uint64_t contentSize();
 
     boost::intrusive_ptr<Message> getMessage() const { return msg; }
-    const std::list<boost::shared_ptr<Queue> >& getQueues() const { return queues; }
-    const std::list<boost::shared_ptr<Queue> >& getPrepared() const { return prepared; }
+    /** Queues not yet prepared */
+    Queues getQueues() const { return Queues(queues.begin() + prepared, queues.end()); }
+    Queues getPrepared() const { return Queues(queues.begin(), queues.begin() + prepared); }
 };
 }
 }
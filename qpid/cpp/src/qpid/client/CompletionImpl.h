@@ -39,6 +39,7 @@ public:
     bool isComplete() { return future.isComplete(*session); }
     void wait() { future.wait(*session); }
     std::string getResult() { return future.getResult(*session); }
+    framing::SequenceNumber getCommandId() const { return future.getCommandId(); }
 
 protected:
     Future future;
@@ -19,6 +19,10 @@
  *
  */
 
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
 #include "qpid/client/ConnectionHandler.h"
 
 #include "qpid/SaslFactory.h"
@@ -31,6 +35,9 @@
 #include "qpid/log/Helpers.h"
 #include "qpid/log/Statement.h"
 #include "qpid/sys/SystemInfo.h"
+#ifdef HAVE_ZLIB_H
+#include "qpid/sys/zlib/DeflateLayer.h"
+#endif
 
 using namespace qpid::client;
 using namespace qpid::framing;
@@ -58,6 +65,8 @@ const std::string SESSION_FLOW_CONTROL("qpid.session_flow");
 const std::string CLIENT_PROCESS_NAME("qpid.client_process");
 const std::string CLIENT_PID("qpid.client_pid");
 const std::string CLIENT_PPID("qpid.client_ppid");
+const std::string QPID_COMPRESS("qpid.compress");
+const std::string DEFLATE("deflate");
 const int SESSION_FLOW_CONTROL_VER = 1;
 }
 
@@ -81,7 +90,7 @@ void ConnectionHandler::Adapter::handle(qpid::framing::AMQFrame& f)
 
 ConnectionHandler::ConnectionHandler(const ConnectionSettings& s, ProtocolVersion& v, Bounds& b)
     : StateManager(NOT_STARTED), ConnectionSettings(s), outHandler(*this, b), proxy(outHandler),
-      errorCode(CLOSE_CODE_NORMAL), version(v)
+      errorCode(CLOSE_CODE_NORMAL), version(v), compressible(false), compressing(false)
 {
     insist = true;
 
@@ -225,10 +234,17 @@ void intersection(const std::vector<std::string>& a, const std::vector<std::stri
 
 }
 
-void ConnectionHandler::start(const FieldTable& /*serverProps*/, const Array& mechanisms, const Array& /*locales*/)
+void ConnectionHandler::start(const FieldTable& serverProps, const Array& mechanisms, const Array& /*locales*/)
 {
     checkState(NOT_STARTED, INVALID_STATE_START);
     setState(NEGOTIATING);
+#ifdef HAVE_ZLIB_H
+    compressing = compress && compressible && serverProps.getAsString(QPID_COMPRESS) == DEFLATE;
+#else
+    (void) serverProps;
+#endif
+    if (compressing) properties.setString(QPID_COMPRESS, DEFLATE);
+    else properties.erase(QPID_COMPRESS);
     sasl = SaslFactory::getInstance().create( username,
                                               password,
                                               service,
@@ -311,6 +327,11 @@ void ConnectionHandler::openOk ( const Array& knownBrokers )
         securityLayer = sasl->getSecurityLayer(maxFrameSize);
         operUserId = sasl->getUserId();
     }
+#ifdef HAVE_ZLIB_H
+    //as on the broker, compression is used only if SASL has no layer
+    if (!securityLayer.get() && compressing)
+        securityLayer.reset(new sys::zlib::DeflateLayer(maxFrameSize));
+#endif
     setState(OPEN);
     QPID_LOG(debug, "Known-brokers for connection: " << log::formatList(knownBrokersUrls));
 }
@@ -80,6 +80,8 @@ class ConnectionHandler : private StateManager,
     std::auto_ptr<qpid::sys::SecurityLayer> securityLayer;
     boost::intrusive_ptr<qpid::sys::TimerTask> rcvTimeoutTask;
     std::string operUserId;
+    bool compressible;          // The connector can install a layer to deflate
+    bool compressing;           // Compression was agreed with the broker
 
     void checkState(STATES s, const std::string& msg);
 
@@ -122,6 +124,8 @@ public:
     bool isClosing() const;
 
     std::auto_ptr<qpid::sys::SecurityLayer> getSecurityLayer();
+    /** Ask for compression only if @a b, i.e. the connector can apply it */
+    void setCompressible(bool b) { compressible = b; }
     void setRcvTimeoutTask(boost::intrusive_ptr<qpid::sys::TimerTask>);
 
     CloseListener onClose;
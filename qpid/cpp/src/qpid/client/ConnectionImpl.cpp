@@ -68,19 +68,28 @@ Timer& theTimer() {
 
 struct IOThreadOptions : public qpid::Options {
     int maxIOThreads;
+    bool affinity;
+    bool pin;
 
     IOThreadOptions(int c) :
         Options("IO threading options"),
-        maxIOThreads(c)
+        maxIOThreads(c),
+        affinity(false),
+        pin(false)
     {
         addOptions()
-            ("max-iothreads", optValue(maxIOThreads, "N"), "Maximum number of io threads to use");
+            ("max-iothreads", optValue(maxIOThreads, "N"), "Maximum number of io threads to use")
+            ("iothread-affinity", optValue(affinity, "yes|no"),
+             "Spread connections over the io threads so each connection is normally served by the same thread")
+            ("pin-iothreads", optValue(pin, "yes|no"), "Bind each io thread to a CPU");
     }
 };
 
 // IO threads
 class IOThread {
     int maxIOThreads;
+    bool affinity;
+    bool pin;
     int ioThreads;
     int connections;
     Mutex threadLock;
@@ -92,8 +101,10 @@ public:
         ScopedLock<Mutex> l(threadLock);
         ++connections;
         if (!poller_)
-            poller_.reset(new Poller);
-        if (ioThreads < connections && ioThreads < maxIOThreads) {
+            poller_.reset(affinity || pin ? new Poller(affinity ? maxIOThreads : 1, pin) : new Poller);
+        // With affinity each thread serves its own share of the
+        // connections, so all of them are needed from the start
+        while ((affinity || ioThreads < connections) && ioThreads < maxIOThreads) {
             QPID_LOG(debug, "Created IO thread: " << ioThreads);
             ++ioThreads;
             t.push_back( Thread(poller_.get()) );
@@ -119,6 +130,9 @@ public:
         options.parse(0, 0, QPIDC_CONF_FILE, true);
         maxIOThreads = (options.maxIOThreads != -1) ?
             options.maxIOThreads : 1;
+        if (maxIOThreads < 1) maxIOThreads = 1;
+        affinity = options.affinity;
+        pin = options.pin;
     }
 
     // We can't destroy threads one-by-one as the only
@@ -179,6 +193,10 @@ boost::shared_ptr<ConnectionImpl> ConnectionImpl::create(framing::ProtocolVersio
     return instance;
 }
 
+Timer& ConnectionImpl::timer() {
+    return theTimer();
+}
+
 ConnectionImpl::ConnectionImpl(framing::ProtocolVersion v, const ConnectionSettings& settings)
     : Bounds(settings.maxFrameSize * settings.bounds),
       handler(settings, v, *this),
@@ -258,6 +276,7 @@ void ConnectionImpl::open()
     connector.reset(Connector::create(protocol, theIO().poller(), version, handler, this));
     connector->setInputHandler(&handler);
     connector->setShutdownHandler(this);
+    handler.setCompressible(connector->supportsSecurityLayer());
     try {
         std::string p = boost::lexical_cast<std::string>(port);
         connector->connect(host, p);
@@ -38,6 +38,10 @@
 #include <boost/enable_shared_from_this.hpp>
 
 namespace qpid {
+namespace sys {
+class Timer;
+}
+
 namespace client {
 
 class Connector;
@@ -81,6 +85,8 @@ class ConnectionImpl : public Bounds,
   public:
     static void init();
     static boost::shared_ptr<ConnectionImpl> create(framing::ProtocolVersion version, const ConnectionSettings& settings);
+    /** The timer all client connections share */
+    static sys::Timer& timer();
     ~ConnectionImpl();
     
     void open();
@@ -41,7 +41,10 @@ ConnectionSettings::ConnectionSettings() :
     service(qpid::saslName),
     minSsf(0),
     maxSsf(256),
-    sslCertName("")
+    sslCertName(""),
+    compress(false),
+    coalesceOutput(false),
+    flushDelay(0)
 {}
 
 ConnectionSettings::~ConnectionSettings() {}
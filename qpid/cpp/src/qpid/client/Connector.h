@@ -74,6 +74,8 @@ class Connector : public framing::OutputHandler
     virtual const std::string& getIdentifier() const = 0;
 
     virtual void activateSecurityLayer(std::auto_ptr<qpid::sys::SecurityLayer>);
+    /** True if activateSecurityLayer() applies the layer rather than ignoring it */
+    virtual bool supportsSecurityLayer() const { return false; }
 
     virtual const qpid::sys::SecuritySettings* getSecuritySettings() = 0;
 };
@@ -45,7 +45,9 @@ ScopedDivert::~ScopedDivert()
     demuxer.remove(dest); 
 }
 
-Demux::Demux() : defaultQueue(new Queue()) {}
+const sys::Duration Demux::QUEUE_SPIN(20*sys::TIME_USEC);
+
+Demux::Demux() : defaultQueue(new Queue(QUEUE_SPIN)) {}
 
 Demux::~Demux() { close(sys::ExceptionHolder(new ClosedException())); }
 
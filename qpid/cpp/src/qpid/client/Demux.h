@@ -50,6 +50,9 @@ public:
     typedef sys::BlockingQueue<framing::FrameSet::shared_ptr> Queue;
     typedef boost::shared_ptr<Queue> QueuePtr;
 
+    /** How long a thread popping from an empty queue spins before blocking */
+    QPID_CLIENT_EXTERN static const sys::Duration QUEUE_SPIN;
+
     QPID_CLIENT_EXTERN Demux();
     QPID_CLIENT_EXTERN ~Demux();
     
@@ -69,7 +72,7 @@ private:
         Condition condition;
         QueuePtr queue;
 
-        Record(const std::string& n, Condition c) : name(n), condition(c), queue(new Queue()) {}
+        Record(const std::string& n, Condition c) : name(n), condition(c), queue(new Queue(QUEUE_SPIN)) {}
     };
 
     sys::Mutex lock;
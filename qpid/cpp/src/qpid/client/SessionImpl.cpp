@@ -221,6 +221,12 @@ framing::SequenceNumber SessionImpl::getCompleteUpTo()
     return --firstIncomplete;
 }
 
+framing::SequenceNumber SessionImpl::getFirstIncompleteOut()
+{
+    Lock l(state);
+    return incompleteOut.empty() ? nextOut : incompleteOut.front();
+}
+
 struct MarkCompleted 
 {
     const SequenceNumber& id;
@@ -416,15 +422,20 @@ void SessionImpl::sendContent(const MethodContent& content)
             headerp->get<DeliveryProperties>(true)->clearExchangeFlag();
     }
     header.setFirstSegment(false);
-    uint64_t data_length = content.getData().length();
+    ConstBufferRef ref = content.getDataRef();
+    uint64_t data_length = ref.begin() ? ref.end() - ref.begin() : content.getData().length();
     if(data_length > 0){
         header.setLastSegment(false);
         handleOut(header);   
         /*Note: end of frame marker included in overhead but not in size*/
         const uint32_t frag_size = maxFrameSize - AMQFrame::frameOverhead(); 
 
+        // Share the content if it is already refcounted, otherwise
+        // copy it once; fragments share that copy
+        boost::intrusive_ptr<AMQContentBody> body(ref.begin() ? new AMQContentBody(ref)
+                                                  : new AMQContentBody(content.getData()));
         if(data_length < frag_size){
-            AMQFrame frame((AMQContentBody(content.getData())));
+            AMQFrame frame(body);
             frame.setFirstSegment(false);
             handleOut(frame);
         }else{
@@ -432,8 +443,7 @@ void SessionImpl::sendContent(const MethodContent& content)
             uint32_t remaining = data_length - offset;
             while (remaining > 0) {
                 uint32_t length = remaining > frag_size ? frag_size : remaining;
-                string frag(content.getData().substr(offset, length));
-                AMQFrame frame((AMQContentBody(frag)));
+                AMQFrame frame(boost::intrusive_ptr<AMQBody>(new AMQContentBody(body->slice(offset, length))));
                 frame.setFirstSegment(false);
                 frame.setLastSegment(true);
                 if (offset > 0) {
@@ -105,6 +105,9 @@ public:
     bool isComplete(const framing::SequenceNumber& id);
     bool isCompleteUpTo(const framing::SequenceNumber& id);
     framing::SequenceNumber getCompleteUpTo();
+    /** The first command sent that is not yet complete, or the next
+     * command to be sent if all are */
+    QPID_CLIENT_EXTERN framing::SequenceNumber getFirstIncompleteOut();
     void waitForCompletion(const framing::SequenceNumber& id);
     void sendCompletion();
     void sendFlush();
@@ -0,0 +1,291 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/client/Connector.h"
+
+#include "qpid/client/Bounds.h"
+#include "qpid/client/ConnectionImpl.h"
+#include "qpid/client/ConnectionSettings.h"
+#include "qpid/log/Statement.h"
+#include "qpid/framing/AMQFrame.h"
+#include "qpid/framing/InitiationHandler.h"
+#include "qpid/framing/ProtocolInitiation.h"
+#include "qpid/sys/Codec.h"
+#include "qpid/sys/Poller.h"
+#include "qpid/sys/SecurityLayer.h"
+#include "qpid/sys/ShutdownHandler.h"
+#include "qpid/sys/shm/ShmIO.h"
+#include "qpid/Msg.h"
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <deque>
+
+namespace qpid {
+namespace client {
+
+using namespace qpid::sys;
+using namespace qpid::framing;
+
+/**
+ * Connects to a broker on the same host through shared memory. The
+ * host in the address is ignored; the port picks the broker.
+ */
+class ShmConnector : public Connector, public sys::Codec
+{
+    typedef std::deque<framing::AMQFrame> Frames;
+
+    const uint16_t maxFrameSize;
+    sys::Mutex lock;
+    Frames frames;
+    size_t lastEof; // Position after last EOF in frames
+    uint64_t currentSize;
+    Bounds* bounds;
+
+    framing::ProtocolVersion version;
+    bool initiated;
+    bool initiationSent;
+    bool closed;
+
+    sys::ShutdownHandler* shutdownHandler;
+    framing::InputHandler* input;
+
+    sys::shm::AsynchIO* aio;
+    sys::Poller::shared_ptr poller;
+    std::auto_ptr<qpid::sys::SecurityLayer> securityLayer;
+    std::string identifier;
+
+    ~ShmConnector();
+
+    // Callbacks from shm::AsynchIO
+    size_t readable(sys::shm::AsynchIO&, const char* data, size_t size);
+    size_t writable(sys::shm::AsynchIO&, char* space, size_t size);
+    void disconnected(sys::shm::AsynchIO&);
+
+    void connect(const std::string& host, const std::string& port);
+    void close();
+    void send(framing::AMQFrame& frame);
+    void abort();
+
+    void setInputHandler(framing::InputHandler* handler);
+    void setShutdownHandler(sys::ShutdownHandler* handler);
+    sys::ShutdownHandler* getShutdownHandler() const;
+    framing::OutputHandler* getOutputHandler();
+    const std::string& getIdentifier() const;
+    void activateSecurityLayer(std::auto_ptr<qpid::sys::SecurityLayer>);
+    const qpid::sys::SecuritySettings* getSecuritySettings() { return 0; }
+
+    size_t decode(const char* buffer, size_t size);
+    size_t encode(const char* buffer, size_t size);
+    bool canEncode();
+
+public:
+    ShmConnector(Poller::shared_ptr,
+                 framing::ProtocolVersion pVersion,
+                 const ConnectionSettings&,
+                 ConnectionImpl*);
+};
+
+// Static constructor which registers connector here
+namespace {
+    Connector* create(Poller::shared_ptr p, framing::ProtocolVersion v, const ConnectionSettings& s, ConnectionImpl* c) {
+        return new ShmConnector(p, v, s, c);
+    }
+
+    struct StaticInit {
+        StaticInit() {
+            Connector::registerFactory("shm", &create);
+        };
+    } init;
+}
+
+ShmConnector::ShmConnector(Poller::shared_ptr p,
+                           ProtocolVersion ver,
+                           const ConnectionSettings& settings,
+                           ConnectionImpl* cimpl)
+    : maxFrameSize(settings.maxFrameSize),
+      lastEof(0),
+      currentSize(0),
+      bounds(cimpl),
+      version(ver),
+      initiated(false),
+      initiationSent(false),
+      closed(true),
+      shutdownHandler(0),
+      input(0),
+      aio(0),
+      poller(p)
+{
+    QPID_LOG(debug, "ShmConnector created for " << version);
+}
+
+ShmConnector::~ShmConnector() {
+    close();
+}
+
+void ShmConnector::connect(const std::string& /*host*/, const std::string& port) {
+    Mutex::ScopedLock l(lock);
+    assert(closed);
+    aio = shm::AsynchIO::connect(
+        boost::lexical_cast<uint16_t>(port),
+        boost::bind(&ShmConnector::readable, this, _1, _2, _3),
+        boost::bind(&ShmConnector::writable, this, _1, _2, _3),
+        boost::bind(&ShmConnector::disconnected, this, _1));
+    identifier = QPID_MSG("[" << aio->getIdentifier() << "]");
+    closed = false;
+    aio->start(poller);
+}
+
+void ShmConnector::close() {
+    Mutex::ScopedLock l(lock);
+    if (!closed) {
+        closed = true;
+        if (aio)
+            aio->queueWriteClose();
+    }
+}
+
+void ShmConnector::abort() {
+    close();
+}
+
+void ShmConnector::disconnected(shm::AsynchIO&) {
+    {
+    Mutex::ScopedLock l(lock);
+    closed = true;
+    aio->queueForDeletion();
+    aio = 0;
+    }
+    if (shutdownHandler)
+        shutdownHandler->shutdown();
+}
+
+void ShmConnector::setInputHandler(InputHandler* handler){
+    input = handler;
+}
+
+void ShmConnector::setShutdownHandler(ShutdownHandler* handler){
+    shutdownHandler = handler;
+}
+
+OutputHandler* ShmConnector::getOutputHandler() {
+    return this;
+}
+
+sys::ShutdownHandler* ShmConnector::getShutdownHandler() const {
+    return shutdownHandler;
+}
+
+const std::string& ShmConnector::getIdentifier() const {
+    return identifier;
+}
+
+void ShmConnector::send(AMQFrame& frame) {
+    Mutex::ScopedLock l(lock);
+    frames.push_back(frame);
+    //only ask to write if this is the end of a frameset or if we
+    //already have a buffers worth of data
+    currentSize += frame.encodedSize();
+    bool notifyWrite = false;
+    if (frame.getEof()) {
+        lastEof = frames.size();
+        notifyWrite = true;
+    } else {
+        notifyWrite = (currentSize >= maxFrameSize);
+    }
+    if (notifyWrite && !closed) aio->notifyPendingWrite();
+}
+
+// Called in IO thread.
+size_t ShmConnector::writable(shm::AsynchIO&, char* space, size_t size) {
+    if (!initiationSent) {
+        ProtocolInitiation init(version);
+        framing::Buffer out(space, size);
+        init.encode(out);
+        initiationSent = true;
+        return out.getPosition();
+    }
+    Codec* codec = securityLayer.get() ? (Codec*) securityLayer.get() : (Codec*) this;
+    return codec->canEncode() ? codec->encode(space, size) : 0;
+}
+
+// Called in IO thread.
+bool ShmConnector::canEncode()
+{
+    Mutex::ScopedLock l(lock);
+    //have at least one full frameset or a whole buffers worth of data
+    return lastEof || currentSize >= maxFrameSize;
+}
+
+// Called in IO thread.
+size_t ShmConnector::encode(const char* buffer, size_t size)
+{
+    framing::Buffer out(const_cast<char*>(buffer), size);
+    size_t bytesWritten(0);
+    {
+        Mutex::ScopedLock l(lock);
+        while (!frames.empty() && out.available() >= frames.front().encodedSize() ) {
+            frames.front().encode(out);
+            QPID_LOG(trace, "SENT " << identifier << ": " << frames.front());
+            frames.pop_front();
+            if (lastEof) --lastEof;
+        }
+        bytesWritten = size - out.available();
+        currentSize -= bytesWritten;
+    }
+    if (bounds) bounds->reduce(bytesWritten);
+    return bytesWritten;
+}
+
+// Called in IO thread.
+size_t ShmConnector::readable(shm::AsynchIO&, const char* data, size_t size) {
+    Codec* codec = securityLayer.get() ? (Codec*) securityLayer.get() : (Codec*) this;
+    return codec->decode(data, size);
+}
+
+size_t ShmConnector::decode(const char* buffer, size_t size)
+{
+    framing::Buffer in(const_cast<char*>(buffer), size);
+    if (!initiated) {
+        framing::ProtocolInitiation protocolInit;
+        if (!protocolInit.decode(in)) return 0;
+        QPID_LOG(debug, "RECV " << identifier << " INIT(" << protocolInit << ")");
+        if(!(protocolInit==version)){
+            throw Exception(QPID_MSG("Unsupported version: " << protocolInit
+                                     << " supported version " << version));
+        }
+        initiated = true;
+    }
+    AMQFrame frame;
+    while(frame.decode(in)){
+        QPID_LOG(trace, "RECV " << identifier << ": " << frame);
+        input->received(frame);
+    }
+    return size - in.available();
+}
+
+void ShmConnector::activateSecurityLayer(std::auto_ptr<qpid::sys::SecurityLayer> sl)
+{
+    securityLayer = sl;
+    securityLayer->init(this);
+}
+
+}} // namespace qpid::client
@@ -32,6 +32,7 @@
 #include "qpid/sys/Dispatcher.h"
 #include "qpid/sys/Poller.h"
 #include "qpid/sys/SecurityLayer.h"
+#include "qpid/sys/Timer.h"
 #include "qpid/Msg.h"
 
 #include <iostream>
@@ -51,6 +52,13 @@ struct TCPConnector::Buff : public AsynchIO::BufferBase {
     ~Buff() { delete [] bytes;}
 };
 
+struct TCPConnector::FlushTask : public sys::TimerTask {
+    TCPConnector& connector;
+
+    FlushTask(Duration delay, TCPConnector& c) : TimerTask(delay, "OutputFlush"), connector(c) {}
+    void fire() { connector.flush(); }
+};
+
 // Static constructor which registers connector here
 namespace {
     Connector* create(Poller::shared_ptr p, framing::ProtocolVersion v, const ConnectionSettings& s, ConnectionImpl* c) {
@@ -69,9 +77,13 @@ TCPConnector::TCPConnector(Poller::shared_ptr p,
                      const ConnectionSettings& settings,
                      ConnectionImpl* cimpl)
     : maxFrameSize(settings.maxFrameSize),
+      coalesceOutput(settings.coalesceOutput),
+      flushDelay(settings.flushDelay * TIME_USEC),
       lastEof(0),
       currentSize(0),
       bounds(cimpl),
+      writing(false),
+      lastWrite(EPOCH),
       version(ver),
       initiated(false),
       closed(true),
@@ -140,12 +152,18 @@ void TCPConnector::connectFailed(const std::string& msg) {
 }
 
 void TCPConnector::close() {
+    boost::intrusive_ptr<TimerTask> task;
+    {
     Mutex::ScopedLock l(lock);
     if (!closed) {
         closed = true;
         if (aio)
             aio->queueWriteClose();
     }
+    task.swap(flushTask);
+    }
+    // Not under the lock, as this waits for the task if it is firing
+    if (task) task->cancel();
 }
 
 void TCPConnector::socketClosed(AsynchIO&, const Socket&) {
@@ -199,7 +217,7 @@ void TCPConnector::send(AMQFrame& frame) {
     currentSize += frame.encodedSize();
     if (frame.getEof()) {
         lastEof = frames.size();
-        notifyWrite = true;
+        notifyWrite = flushNow();
     } else {
         notifyWrite = (currentSize >= maxFrameSize);
     }
@@ -218,6 +236,34 @@ void TCPConnector::send(AMQFrame& frame) {
     }
 }
 
+// Called with the lock held when a frameset is complete: whether to
+// wake the IO thread to write it now, or leave it for more to join.
+bool TCPConnector::flushNow()
+{
+    if (currentSize >= maxFrameSize) return true;
+    // The IO thread calls writebuff again once its write is done
+    if (coalesceOutput && writing) return false;
+    if (flushDelay) {
+        if (flushTask) return false;
+        Duration quiet(lastWrite, AbsTime::now());
+        if (quiet < flushDelay) {
+            flushTask = new FlushTask(flushDelay - quiet, *this);
+            ConnectionImpl::timer().add(flushTask);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Called in timer thread.
+void TCPConnector::flush()
+{
+    Mutex::ScopedLock l(lock);
+    flushTask = 0;
+    if (!closed && lastEof) aio->notifyPendingWrite();
+}
+
+// Called in IO thread, only when it has written all it was given.
 void TCPConnector::writebuff(AsynchIO& /*aio*/) 
 {
     // It's possible to be disconnected and be writable
@@ -225,16 +271,21 @@ void TCPConnector::writebuff(AsynchIO& /*aio*/)
         return;
 
     Codec* codec = securityLayer.get() ? (Codec*) securityLayer.get() : (Codec*) this;
+    bool encoded = false;
     if (codec->canEncode()) {
         std::auto_ptr<AsynchIO::BufferBase> buffer = std::auto_ptr<AsynchIO::BufferBase>(aio->getQueuedBuffer());
         if (!buffer.get()) buffer = std::auto_ptr<AsynchIO::BufferBase>(new Buff(maxFrameSize));
 
-        size_t encoded = codec->encode(buffer->bytes, buffer->byteCount);
-
         buffer->dataStart = 0;
-        buffer->dataCount = encoded;
+        buffer->dataCount = codec->encode(buffer->bytes, buffer->byteCount);
+        encoded = buffer->dataCount > 0;
         aio->queueWrite(buffer.release());
     }
+    if (coalesceOutput || flushDelay) {
+        Mutex::ScopedLock l(lock);
+        writing = encoded;
+        if (encoded && flushDelay) lastWrite = AbsTime::now();
+    }
 }
 
 // Called in IO thread.
@@ -33,7 +33,9 @@
 #include "qpid/sys/SecurityLayer.h"
 #include "qpid/sys/Socket.h"
 #include "qpid/sys/Thread.h"
+#include "qpid/sys/Time.h"
 
+#include <boost/intrusive_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 #include <deque>
@@ -41,6 +43,10 @@
 
 namespace qpid {
 
+namespace sys {
+    class TimerTask;
+}
+
 namespace framing {
     class InitiationHandler;
 }
@@ -51,14 +57,20 @@ class TCPConnector : public Connector, public sys::Codec
 {
     typedef std::deque<framing::AMQFrame> Frames;
     struct Buff;
+    struct FlushTask;
 
     const uint16_t maxFrameSize;
+    const bool coalesceOutput;
+    const sys::Duration flushDelay;
 
     sys::Mutex lock;
     Frames frames; // Outgoing frame queue
     size_t lastEof; // Position after last EOF in frames
     uint64_t currentSize;
     Bounds* bounds;
+    bool writing;               // A buffer is queued that the IO thread has not written
+    sys::AbsTime lastWrite;
+    boost::intrusive_ptr<sys::TimerTask> flushTask;
 
     framing::ProtocolVersion version;
     bool initiated;
@@ -90,12 +102,16 @@ class TCPConnector : public Connector, public sys::Codec
     framing::OutputHandler* getOutputHandler();
     const std::string& getIdentifier() const;
     void activateSecurityLayer(std::auto_ptr<qpid::sys::SecurityLayer>);
+    bool supportsSecurityLayer() const { return true; }
     const qpid::sys::SecuritySettings* getSecuritySettings() { return 0; }
 
     size_t decode(const char* buffer, size_t size);
     size_t encode(const char* buffer, size_t size);
     bool canEncode();
 
+    bool flushNow();
+    void flush();
+
 protected:
     virtual ~TCPConnector();
     void connect(const std::string& host, const std::string& port);
@@ -0,0 +1,70 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/client/TCPConnector.h"
+#include "qpid/sys/Poller.h"
+#include "qpid/sys/SecuritySettings.h"
+#include "qpid/sys/SocketAddress.h"
+
+namespace qpid {
+namespace client {
+
+using namespace qpid::sys;
+using namespace qpid::framing;
+
+/**
+ * Connects to a broker on the same host through the Unix domain socket
+ * it listens on alongside its TCP port. The host in the address is
+ * ignored. The broker knows which user is connecting, so EXTERNAL is
+ * offered to authenticate as that user with no further exchange.
+ */
+class UnixConnector : public TCPConnector
+{
+    sys::SecuritySettings securitySettings;
+
+    void connect(const std::string& /*host*/, const std::string& port) {
+        TCPConnector::connect(SocketAddress::localName(port), "");
+    }
+
+    const sys::SecuritySettings* getSecuritySettings() { return &securitySettings; }
+
+  public:
+    UnixConnector(Poller::shared_ptr p, ProtocolVersion v, const ConnectionSettings& s, ConnectionImpl* c) :
+        TCPConnector(p, v, s, c)
+    {
+        securitySettings.authid = "peer"; // Non-empty to enable EXTERNAL; the broker knows who we are
+    }
+};
+
+// Static constructor which registers connector here
+namespace {
+    Connector* create(Poller::shared_ptr p, framing::ProtocolVersion v, const ConnectionSettings& s, ConnectionImpl* c) {
+        return new UnixConnector(p, v, s, c);
+    }
+
+    struct StaticInit {
+        StaticInit() {
+            Connector::registerFactory("unix", &create);
+        };
+    } init;
+}
+
+}} // namespace qpid::client
@@ -92,6 +92,8 @@ const std::string DURABLE("durable");
 const std::string X_DECLARE("x-declare");
 const std::string X_SUBSCRIBE("x-subscribe");
 const std::string X_BINDINGS("x-bindings");
+const std::string X_CREDIT("x-credit");
+const std::string MAX_BYTES("max-bytes");
 const std::string EXCHANGE("exchange");
 const std::string QUEUE("queue");
 const std::string KEY("key");
@@ -117,6 +119,9 @@ const std::string AT_MOST_ONCE("at-most-once");
 const std::string AT_LEAST_ONCE("at-least-once");
 const std::string EXACTLY_ONCE("exactly-once");
 
+//credit modes
+const std::string ADAPTIVE("adaptive");
+
 //receiver modes:
 const std::string BROWSE("browse");
 const std::string CONSUME("consume");
@@ -133,6 +138,10 @@ const std::string WILDCARD_ANY("#");
 const std::string PREFIX_AMQ("amq.");
 const std::string PREFIX_QPID("qpid.");
 
+//the broker's direct reply-to address: an exchange to send replies
+//to, a queue private to the session to receive them from
+const std::string DIRECT_REPLY_TO("qpid.reply-to");
+
 const Verifier verifier;
 }
 
@@ -270,6 +279,7 @@ class QueueSink : public Queue, public MessageSink
   private:
 };
 bool isQueue(qpid::client::Session session, const qpid::messaging::Address& address);
+bool isDirectReplyTo(const qpid::messaging::Address& address);
 bool isTopic(qpid::client::Session session, const qpid::messaging::Address& address);
 
 bool in(const Variant& value, const std::vector<std::string>& choices)
@@ -384,14 +394,26 @@ bool AddressResolution::is_reliable(const Address& address)
               list_of<std::string>(AT_LEAST_ONCE)(EXACTLY_ONCE));
 }
 
-std::string checkAddressType(qpid::client::Session session, const Address& address)
+bool AddressResolution::is_adaptive(const Address& address)
+{
+    return (Opt(address)/LINK/X_CREDIT/MODE).str() == ADAPTIVE;
+}
+
+uint32_t AddressResolution::byte_credit(const Address& address)
+{
+    Opt bytes(address);
+    bytes/LINK/X_CREDIT/MAX_BYTES;
+    return bytes.value ? bytes.value->asUint32() : 0xFFFFFFFF;
+}
+
+std::string checkAddressType(qpid::client::Session session, const Address& address, NodeCache* nodes)
 {
     verifier.verify(address);
     if (address.getName().empty()) {
         throw MalformedAddress("Name cannot be null");
     }
     std::string type = (Opt(address)/NODE/TYPE).str();
-    if (type.empty()) {
+    if (type.empty() && !(nodes && nodes->getType(address.getName(), type))) {
         ExchangeBoundResult result = session.exchangeBound(arg::exchange=address.getName(), arg::queue=address.getName());
         if (result.getQueueNotFound() && result.getExchangeNotFound()) {
             //neither a queue nor an exchange exists with that name; treat it as a queue
@@ -399,9 +421,11 @@ std::string checkAddressType(qpid::client::Session session, const Address& addre
         } else if (result.getExchangeNotFound()) {
             //name refers to a queue
             type = QUEUE_ADDRESS;
+            if (nodes) nodes->setType(address.getName(), type);
         } else if (result.getQueueNotFound()) {
             //name refers to an exchange
             type = TOPIC_ADDRESS;
+            if (nodes) nodes->setType(address.getName(), type);
         } else {
             //both a queue and exchange exist for that name
             throw ResolutionError("Ambiguous address, please specify queue or topic as node type");
@@ -410,12 +434,70 @@ std::string checkAddressType(qpid::client::Session session, const Address& addre
     return type;
 }
 
+bool NodeCache::getType(const std::string& name, std::string& type) const
+{
+    sys::Mutex::ScopedLock l(lock);
+    Nodes::const_iterator i = nodes.find(name);
+    if (i == nodes.end()) return false;
+    type = i->second.type;
+    return true;
+}
+
+void NodeCache::setType(const std::string& name, const std::string& type)
+{
+    sys::Mutex::ScopedLock l(lock);
+    nodes[name].type = type;
+}
+
+bool NodeCache::getExchangeType(const std::string& name, std::string& exchangeType) const
+{
+    sys::Mutex::ScopedLock l(lock);
+    Nodes::const_iterator i = nodes.find(name);
+    if (i == nodes.end() || i->second.exchangeType.empty()) return false;
+    exchangeType = i->second.exchangeType;
+    return true;
+}
+
+void NodeCache::setExchangeType(const std::string& name, const std::string& exchangeType)
+{
+    sys::Mutex::ScopedLock l(lock);
+    Node& node = nodes[name];
+    node.type = TOPIC_ADDRESS;
+    node.exchangeType = exchangeType;
+}
+
+void NodeCache::forget(const std::string& name)
+{
+    sys::Mutex::ScopedLock l(lock);
+    nodes.erase(name);
+}
+
+void NodeCache::clear()
+{
+    sys::Mutex::ScopedLock l(lock);
+    nodes.clear();
+}
+
+AddressResolution::AddressResolution(boost::shared_ptr<NodeCache> n) : nodes(n) {}
+
+NodeCache* AddressResolution::cacheFor(const Address& address) const
+{
+    //a node this client may delete or create must be looked up afresh
+    if (!nodes || !getOption(address, DELETE).isVoid() || !getOption(address, CREATE).isVoid()) return 0;
+    return nodes.get();
+}
+
 std::auto_ptr<MessageSource> AddressResolution::resolveSource(qpid::client::Session session,
                                                               const Address& address)
 {
-    std::string type = checkAddressType(session, address);
+    NodeCache* cache = cacheFor(address);
+    std::string type = isDirectReplyTo(address) ? QUEUE_ADDRESS : checkAddressType(session, address, cache);
     if (type == TOPIC_ADDRESS) {
-        std::string exchangeType = sync(session).exchangeQuery(address.getName()).getType();
+        std::string exchangeType;
+        if (!(cache && cache->getExchangeType(address.getName(), exchangeType))) {
+            exchangeType = sync(session).exchangeQuery(address.getName()).getType();
+            if (cache && !exchangeType.empty()) cache->setExchangeType(address.getName(), exchangeType);
+        }
         std::auto_ptr<MessageSource> source(new Subscription(address, exchangeType));
         QPID_LOG(debug, "treating source address as topic: " << address);
         return source;
@@ -432,7 +514,7 @@ std::auto_ptr<MessageSource> AddressResolution::resolveSource(qpid::client::Sess
 std::auto_ptr<MessageSink> AddressResolution::resolveSink(qpid::client::Session session,
                                                           const qpid::messaging::Address& address)
 {
-    std::string type = checkAddressType(session, address);
+    std::string type = checkAddressType(session, address, cacheFor(address));
     if (type == TOPIC_ADDRESS) {
         std::auto_ptr<MessageSink> sink(new ExchangeSink(address));
         QPID_LOG(debug, "treating target address as topic: " << address);
@@ -644,7 +726,10 @@ Address AddressResolution::convert(const qpid::framing::ReplyTo& rt)
 
 qpid::framing::ReplyTo AddressResolution::convert(const Address& address)
 {
-    if (address.getType() == QUEUE_ADDRESS || address.getType().empty()) {
+    if (isDirectReplyTo(address)) {
+        //the broker fills in the key for the sending session
+        return ReplyTo(DIRECT_REPLY_TO, EMPTY_STRING);
+    } else if (address.getType() == QUEUE_ADDRESS || address.getType().empty()) {
         return ReplyTo(EMPTY_STRING, address.getName());
     } else if (address.getType() == TOPIC_ADDRESS) {
         return ReplyTo(address.getName(), address.getSubject());
@@ -654,6 +739,12 @@ qpid::framing::ReplyTo AddressResolution::convert(const Address& address)
     }
 }
 
+bool isDirectReplyTo(const qpid::messaging::Address& address)
+{
+    return address.getName() == DIRECT_REPLY_TO && address.getSubject().empty()
+        && (Opt(address)/NODE/TYPE).str().empty();
+}
+
 bool isQueue(qpid::client::Session session, const qpid::messaging::Address& address) 
 {
     return address.getType() == QUEUE_ADDRESS || 
@@ -974,6 +1065,10 @@ Verifier::Verifier()
     link[X_SUBSCRIBE] = true;
     link[X_DECLARE] = true;
     link[X_BINDINGS] = true;
+    Variant::Map credit;
+    credit[MODE] = true;
+    credit[MAX_BYTES] = true;
+    link[X_CREDIT] = credit;
     defined[LINK] = link;
 }
 void Verifier::verify(const Address& address) const
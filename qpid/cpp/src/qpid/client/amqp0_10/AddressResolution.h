@@ -22,6 +22,9 @@
  *
  */
 #include "qpid/client/Session.h"
+#include "qpid/sys/Mutex.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace qpid {
 
@@ -39,6 +42,32 @@ namespace amqp0_10 {
 class MessageSource;
 class MessageSink;
 
+/**
+ * Node types learned from the broker, shared by the sessions of a
+ * connection so that the type of an existing node is only queried
+ * once. Cleared when the connection fails over.
+ */
+class NodeCache
+{
+  public:
+    bool getType(const std::string& name, std::string& type) const;
+    void setType(const std::string& name, const std::string& type);
+    bool getExchangeType(const std::string& name, std::string& exchangeType) const;
+    void setExchangeType(const std::string& name, const std::string& exchangeType);
+    void forget(const std::string& name);
+    void clear();
+  private:
+    struct Node
+    {
+        std::string type;
+        std::string exchangeType;
+    };
+    typedef boost::unordered_map<std::string, Node> Nodes;
+
+    mutable qpid::sys::Mutex lock;
+    Nodes nodes;
+};
+
 /**
  * Maps from a generic Address and optional Filter to an AMQP 0-10
  * MessageSource which will then be used by a ReceiverImpl instance
@@ -47,6 +76,12 @@ class MessageSink;
 class AddressResolution
 {
   public:
+    /**
+     *@param nodes if set, node types are looked up there before the
+     * broker is asked, and added to it after
+     */
+    AddressResolution(boost::shared_ptr<NodeCache> nodes = boost::shared_ptr<NodeCache>());
+
     std::auto_ptr<MessageSource> resolveSource(qpid::client::Session session,
                                                const qpid::messaging::Address& address);
     
@@ -57,7 +92,14 @@ class AddressResolution
     static qpid::framing::ReplyTo convert(const qpid::messaging::Address&);
     static bool is_unreliable(const qpid::messaging::Address& address);
     static bool is_reliable(const qpid::messaging::Address& address);
+    /** True if link/x-credit/mode is 'adaptive' */
+    static bool is_adaptive(const qpid::messaging::Address& address);
+    /** Byte credit from link/x-credit/max-bytes, unlimited if not set */
+    static uint32_t byte_credit(const qpid::messaging::Address& address);
   private:
+    boost::shared_ptr<NodeCache> nodes;
+
+    NodeCache* cacheFor(const qpid::messaging::Address& address) const;
 };
 }}} // namespace qpid::client::amqp0_10
 
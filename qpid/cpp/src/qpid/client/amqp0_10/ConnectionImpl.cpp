@@ -65,13 +65,19 @@ std::string asString(const std::vector<std::string>& v) {
 ConnectionImpl::ConnectionImpl(const std::string& url, const Variant::Map& options) :
     replaceUrls(false), reconnect(false), timeout(-1), limit(-1),
     minReconnectInterval(3), maxReconnectInterval(60),
-    retries(0), reconnectOnLimitExceeded(true)
+    retries(0), reconnectOnLimitExceeded(true),
+    standby(false), standbyOpening(false), standbyOpener(*this)
 {
     setOptions(options);
     urls.insert(urls.begin(), url);
     QPID_LOG(debug, "Created connection " << url << " with " << options);
 }
 
+ConnectionImpl::~ConnectionImpl()
+{
+    closeStandby();
+}
+
 void ConnectionImpl::setOptions(const Variant::Map& options)
 {
     for (Variant::Map::const_iterator i = options.begin(); i != options.end(); ++i) {
@@ -120,6 +126,12 @@ void ConnectionImpl::setOption(const std::string& name, const Variant& value)
         settings.heartbeat = value;
     } else if (name == "tcp-nodelay" || name == "tcp_nodelay") {
         settings.tcpNoDelay = value;
+    } else if (name == "compress") {
+        settings.compress = value;
+    } else if (name == "coalesce-output" || name == "coalesce_output") {
+        settings.coalesceOutput = value;
+    } else if (name == "flush-delay" || name == "flush_delay") {
+        settings.flushDelay = value;
     } else if (name == "locale") {
         settings.locale = value.asString();
     } else if (name == "max-channels" || name == "max_channels") {
@@ -134,6 +146,11 @@ void ConnectionImpl::setOption(const std::string& name, const Variant& value)
         settings.sslCertName = value.asString();
     } else if (name == "x-reconnect-on-limit-exceeded" || name == "x_reconnect_on_limit_exceeded") {
         reconnectOnLimitExceeded = value;
+    } else if (name == "reconnect-standby" || name == "reconnect_standby") {
+        standby = value;
+    } else if (name == "address-cache" || name == "address_cache") {
+        if (!value.asBool()) nodes.reset();
+        else if (!nodes) nodes.reset(new NodeCache());
     } else {
         throw qpid::messaging::MessagingException(QPID_MSG("Invalid option: " << name << " not recognised"));
     }
@@ -152,6 +169,7 @@ void ConnectionImpl::close()
         session.close();
     }
     detach();
+    closeStandby();
 }
 
 void ConnectionImpl::detach()
@@ -271,6 +289,7 @@ void ConnectionImpl::mergeUrls(const std::vector<Url>& more, const sys::Mutex::S
 bool ConnectionImpl::tryConnect()
 {
     sys::Mutex::ScopedLock l(lock);
+    if (useStandby(l)) return true;
     for (std::vector<std::string>::const_iterator i = urls.begin(); i != urls.end(); ++i) {
         try {
             QPID_LOG(info, "Trying to connect to " << *i << "...");
@@ -279,8 +298,11 @@ bool ConnectionImpl::tryConnect()
             if (url.getPass().size()) settings.password = url.getPass();
             connection.open(url, settings);
             QPID_LOG(info, "Connected to " << *i);
+            current = *i;
             mergeUrls(connection.getInitialBrokers(), l);
-            return resetSessions(l);
+            if (!resetSessions(l)) return false;
+            startStandby(l);
+            return true;
         } catch (const qpid::TransportFailure& e) {
             QPID_LOG(info, "Failed to connect to " << *i << ": " << e.what());
         }
@@ -288,12 +310,101 @@ bool ConnectionImpl::tryConnect()
     return false;
 }
 
+boost::shared_ptr<NodeCache> ConnectionImpl::getNodeCache() const
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    return nodes;
+}
+
+bool ConnectionImpl::useStandby(const sys::Mutex::ScopedLock& l)
+{
+    if (!standbyConnection.isOpen()) return false;
+    QPID_LOG(info, "Failing over to standby connection to " << standbyUrl);
+    connection = standbyConnection;
+    standbyConnection = qpid::client::Connection();
+    current = standbyUrl;
+    mergeUrls(connection.getInitialBrokers(), l);
+    if (!resetSessions(l)) return false;
+    startStandby(l);
+    return true;
+}
+
+void ConnectionImpl::startStandby(const sys::Mutex::ScopedLock&)
+{
+    if (!standby || standbyOpening || standbyConnection.isOpen() || urls.size() < 2) return;
+    // a previous opener has finished, it clears standbyOpening last
+    if (standbyThread) standbyThread.join();
+    standbyOpening = true;
+    standbyThread = qpid::sys::Thread(standbyOpener);
+}
+
+void ConnectionImpl::openStandby()
+{
+    std::string target;
+    qpid::client::ConnectionSettings s;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        for (std::vector<std::string>::const_iterator i = urls.begin(); i != urls.end(); ++i) {
+            if (*i != current) {
+                target = *i;
+                break;
+            }
+        }
+        s = settings;
+    }
+    // connect without the lock so the application is not held up
+    qpid::client::Connection c;
+    if (!target.empty()) {
+        try {
+            Url url(target);
+            if (url.getUser().size()) s.username = url.getUser();
+            if (url.getPass().size()) s.password = url.getPass();
+            c.open(url, s);
+            QPID_LOG(info, "Opened standby connection to " << target);
+        } catch (const std::exception& e) {
+            QPID_LOG(info, "Failed to open standby connection to " << target << ": " << e.what());
+        }
+    }
+    sys::Mutex::ScopedLock l(lock);
+    if (c.isOpen()) {
+        if (standby && connection.isOpen()) {
+            standbyConnection = c;
+            standbyUrl = target;
+        } else {
+            c.close();
+        }
+    }
+    standbyOpening = false;
+}
+
+void ConnectionImpl::closeStandby()
+{
+    qpid::sys::Thread opener;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        opener = standbyThread;
+        standbyThread = qpid::sys::Thread();
+    }
+    if (opener) opener.join();
+    sys::Mutex::ScopedLock l(lock);
+    if (standbyConnection.isOpen()) standbyConnection.close();
+    standbyConnection = qpid::client::Connection();
+}
+
 bool ConnectionImpl::resetSessions(const sys::Mutex::ScopedLock& )
 {
     try {
         qpid::sys::Mutex::ScopedLock l(lock);
+        //the broker failed over to may not have the same nodes
+        if (nodes) nodes->clear();
+        //re-establish every session before waiting on any of them
+        std::vector<qpid::client::Session> pending;
         for (Sessions::iterator i = sessions.begin(); i != sessions.end(); ++i) {
-            getImplPtr(i->second)->setSession(connection.newSession(i->first));
+            pending.push_back(connection.newSession(i->first));
+            getImplPtr(i->second)->setSession(pending.back(), false);
+        }
+        for (std::vector<qpid::client::Session>::iterator i = pending.begin(); i != pending.end(); ++i) {
+            i->sync();
         }
         return true;
     } catch (const qpid::TransportFailure&) {
@@ -26,7 +26,10 @@
 #include "qpid/client/Connection.h"
 #include "qpid/client/ConnectionSettings.h"
 #include "qpid/sys/Mutex.h"
+#include "qpid/sys/Runnable.h"
 #include "qpid/sys/Semaphore.h"
+#include "qpid/sys/Thread.h"
+#include <boost/shared_ptr.hpp>
 #include <map>
 #include <vector>
 
@@ -38,10 +41,13 @@ namespace amqp0_10 {
 
 class SessionImpl;
 
+class NodeCache;
+
 class ConnectionImpl : public qpid::messaging::ConnectionImpl
 {
   public:
     ConnectionImpl(const std::string& url, const qpid::types::Variant::Map& options);
+    ~ConnectionImpl();
     void open();
     void reopen();
     bool isOpen() const;
@@ -53,9 +59,19 @@ class ConnectionImpl : public qpid::messaging::ConnectionImpl
     void setOption(const std::string& name, const qpid::types::Variant& value);
     bool backoff();
     std::string getAuthenticatedUsername();
+    /** The node types shared by this connection's sessions, unset unless address-cache is on */
+    boost::shared_ptr<NodeCache> getNodeCache() const;
   private:
     typedef std::map<std::string, qpid::messaging::Session> Sessions;
 
+    struct StandbyOpener : qpid::sys::Runnable
+    {
+        ConnectionImpl& impl;
+
+        StandbyOpener(ConnectionImpl& i) : impl(i) {}
+        void run() { impl.openStandby(); }
+    };
+
     mutable qpid::sys::Mutex lock;//used to protect data structures
     qpid::sys::Semaphore semaphore;//used to coordinate reconnection
     Sessions sessions;
@@ -70,11 +86,24 @@ class ConnectionImpl : public qpid::messaging::ConnectionImpl
     int64_t maxReconnectInterval;
     int32_t retries;
     bool reconnectOnLimitExceeded;
+    boost::shared_ptr<NodeCache> nodes;
+    std::string current;  // the url connected to
+    //standby connection, kept open to another url to fail over to
+    bool standby;
+    qpid::client::Connection standbyConnection;
+    std::string standbyUrl;
+    bool standbyOpening;
+    StandbyOpener standbyOpener;
+    qpid::sys::Thread standbyThread;
 
     void setOptions(const qpid::types::Variant::Map& options);
     void connect(const qpid::sys::AbsTime& started);
     bool tryConnect();
     bool resetSessions(const sys::Mutex::ScopedLock&); // dummy parameter indicates call with lock held.
+    bool useStandby(const sys::Mutex::ScopedLock&);
+    void startStandby(const sys::Mutex::ScopedLock&);
+    void openStandby();
+    void closeStandby();
     void mergeUrls(const std::vector<Url>& more, const sys::Mutex::ScopedLock&);
 };
 }}} // namespace qpid::client::amqp0_10
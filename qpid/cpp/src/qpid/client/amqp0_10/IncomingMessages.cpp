@@ -34,6 +34,7 @@
 #include "qpid/framing/MessageProperties.h"
 #include "qpid/framing/MessageTransferBody.h"
 #include "qpid/framing/enum.h"
+#include <algorithm>
 
 namespace qpid {
 namespace client {
@@ -65,42 +66,23 @@ struct GetAny : IncomingMessages::Handler
     }
 };
 
-struct MatchAndTrack
+template <class T> struct RefersTo
 {
-    const std::string destination;
-    SequenceSet ids;
+    const T* target;
 
-    MatchAndTrack(const std::string& d) : destination(d) {}
+    RefersTo(const T* t) : target(t) {}
 
-    bool operator()(boost::shared_ptr<qpid::framing::FrameSet> command)
-    {
-        if (command->as<MessageTransferBody>()->getDestination() == destination) {
-            ids.add(command->getId());
-            return true;
-        } else {
-            return false;
-        }
-    }
+    template <class A> bool operator()(const A& arrival) const { return arrival.second == target; }
 };
 
-struct Match
+/** Has the message of this arrival already been taken from its queue? */
+template <class A> bool stale(const A& arrival)
 {
-    const std::string destination;
-    uint32_t matched;
-
-    Match(const std::string& d) : destination(d), matched(0) {}
-
-    bool operator()(boost::shared_ptr<qpid::framing::FrameSet> command)
-    {
-        if (command->as<MessageTransferBody>()->getDestination() == destination) {
-            ++matched;
-            return true;
-        } else {
-            return false;
-        }
-    }
-};
+    return arrival.second->second.empty() || arrival.first < arrival.second->second.front().position;
 }
+}
+
+IncomingMessages::IncomingMessages() : nextPosition(0), count(0) {}
 
 void IncomingMessages::setSession(qpid::client::AsyncSession s)
 {
@@ -110,16 +92,16 @@ void IncomingMessages::setSession(qpid::client::AsyncSession s)
     acceptTracker.reset();
 }
 
-bool IncomingMessages::get(Handler& handler, Duration timeout)
+bool IncomingMessages::get(const std::string& destination, Handler& handler, Duration timeout)
 {
     {
         sys::Mutex::ScopedLock l(lock);
-        //search through received list for any transfer of interest:
-        for (FrameSetQueue::iterator i = received.begin(); i != received.end(); i++)
-        {
-            MessageTransfer transfer(*i, *this);
+        //check the received queue for this destination:
+        Destinations::iterator i = received.find(destination);
+        if (i != received.end() && !i->second.empty()) {
+            MessageTransfer transfer(i->second.front().content, *this);
             if (handler.accept(transfer)) {
-                received.erase(i);
+                pop(i->second, l);
                 return true;
             }
         }
@@ -130,14 +112,89 @@ bool IncomingMessages::get(Handler& handler, Duration timeout)
 
 bool IncomingMessages::getNextDestination(std::string& destination, Duration timeout)
 {
-    sys::Mutex::ScopedLock l(lock);
+    {
+        sys::Mutex::ScopedLock l(lock);
+        Destinations::value_type* next = nextArrival(l);
+        if (next) {
+            destination = next->first;
+            return true;
+        }
+    }
     //if there is not already a received message, we must wait for one
-    if (received.empty() && !wait(timeout)) return false;
-    //else we have a message in received; return the corresponding destination
-    destination = received.front()->as<MessageTransferBody>()->getDestination();
+    if (!wait(timeout)) return false;
+    sys::Mutex::ScopedLock l(lock);
+    Destinations::value_type* next = nextArrival(l);
+    if (!next) return false; // taken by another thread meanwhile
+    destination = next->first;
     return true;
 }
 
+void IncomingMessages::listen(const std::string& destination, bool on)
+{
+    sys::Mutex::ScopedLock l(lock);
+    if (on) {
+        listened.insert(destination);
+        Destinations::iterator i = received.find(destination);
+        if (i != received.end() && !i->second.empty()) listenedReady.push_back(destination);
+    } else {
+        listened.erase(destination);
+    }
+}
+
+bool IncomingMessages::dispatch(Handler& handler, Duration timeout)
+{
+    {
+        sys::Mutex::ScopedLock l(lock);
+        //serve listened destinations with received messages in turn
+        while (!listenedReady.empty()) {
+            std::string destination = listenedReady.front();
+            listenedReady.pop_front();
+            Destinations::iterator i = received.find(destination);
+            if (i == received.end() || i->second.empty() || !listened.count(destination)) continue;
+            MessageTransfer transfer(i->second.front().content, *this);
+            if (handler.accept(transfer)) {
+                pop(i->second, l);
+                if (!i->second.empty()) listenedReady.push_back(destination);
+                return true;
+            }
+        }
+    }
+    //none waiting, check incoming:
+    return process(&handler, timeout);
+}
+
+void IncomingMessages::push(FrameSetPtr content, const sys::Mutex::ScopedLock&)
+{
+    const std::string& destination = content->as<MessageTransferBody>()->getDestination();
+    Destinations::iterator i = received.find(destination);
+    if (i == received.end()) {
+        i = received.insert(Destinations::value_type(destination, FrameSetQueue())).first;
+    }
+    i->second.push_back(Received(nextPosition, content));
+    arrivals.push_back(Arrival(nextPosition++, &*i));
+    ++count;
+    if (i->second.size() == 1 && listened.count(destination)) listenedReady.push_back(destination);
+}
+
+IncomingMessages::FrameSetPtr IncomingMessages::pop(FrameSetQueue& queue, const sys::Mutex::ScopedLock&)
+{
+    FrameSetPtr content = queue.front().content;
+    queue.pop_front();
+    --count;
+    //drop arrivals whose messages were taken by get(), once they
+    //outnumber the messages still waiting
+    if (arrivals.size() > 2 * count + 64) {
+        arrivals.erase(std::remove_if(arrivals.begin(), arrivals.end(), stale<Arrival>), arrivals.end());
+    }
+    return content;
+}
+
+IncomingMessages::Destinations::value_type* IncomingMessages::nextArrival(const sys::Mutex::ScopedLock&)
+{
+    while (!arrivals.empty() && stale(arrivals.front())) arrivals.pop_front();
+    return arrivals.empty() ? 0 : arrivals.front().second;
+}
+
 void IncomingMessages::accept()
 {
     sys::Mutex::ScopedLock l(lock);
@@ -156,10 +213,14 @@ void IncomingMessages::releaseAll()
     {
         //first process any received messages...
         sys::Mutex::ScopedLock l(lock);
-        while (!received.empty()) {
-            retrieve(received.front(), 0);
-            received.pop_front();
+        for (Destinations::iterator i = received.begin(); i != received.end(); ++i) {
+            for (FrameSetQueue::iterator j = i->second.begin(); j != i->second.end(); ++j) {
+                retrieve(j->content, 0);
+            }
         }
+        received.clear();
+        arrivals.clear();
+        count = 0;
     }
     //then pump out any available messages from incoming queue...
     GetAny handler;
@@ -174,12 +235,21 @@ void IncomingMessages::releasePending(const std::string& destination)
     //first pump all available messages from incoming to received...
     while (process(0, 0)) ;
 
-    //now remove all messages for this destination from received list, recording their ids...
+    //now remove the received queue for this destination, recording the ids...
     sys::Mutex::ScopedLock l(lock);
-    MatchAndTrack match(destination);
-    for (FrameSetQueue::iterator i = received.begin(); i != received.end(); i = match(*i) ? received.erase(i) : ++i) ;
+    SequenceSet ids;
+    Destinations::iterator i = received.find(destination);
+    if (i != received.end()) {
+        for (FrameSetQueue::iterator j = i->second.begin(); j != i->second.end(); ++j) {
+            ids.add(j->content->getId());
+        }
+        count -= i->second.size();
+        arrivals.erase(std::remove_if(arrivals.begin(), arrivals.end(), RefersTo<Destinations::value_type>(&*i)),
+                       arrivals.end());
+        received.erase(i);
+    }
     //now release those messages
-    session.messageRelease(match.ids);
+    session.messageRelease(ids);
 }
 
 /**
@@ -204,7 +274,7 @@ bool IncomingMessages::process(Handler* handler, qpid::sys::Duration duration)
                     //received message for another destination, keep for later
                     QPID_LOG(debug, "Pushed " << *content->getMethod() << " to received queue");
                     sys::Mutex::ScopedLock l(lock);
-                    received.push_back(content);
+                    push(content, l);
                 }
             } else {
                 //TODO: handle other types of commands (e.g. message-accept, message-flow etc)
@@ -223,7 +293,7 @@ bool IncomingMessages::wait(qpid::sys::Duration duration)
         if (content->isA<MessageTransferBody>()) {
             QPID_LOG(debug, "Pushed " << *content->getMethod() << " to received queue");
             sys::Mutex::ScopedLock l(lock);
-            received.push_back(content);
+            push(content, l);
             return true;
         } else {
             //TODO: handle other types of commands (e.g. message-accept, message-flow etc)
@@ -249,7 +319,7 @@ uint32_t IncomingMessages::available()
     while (process(0, 0)) {}
     //return the count of received messages
     sys::Mutex::ScopedLock l(lock);
-    return received.size();
+    return count;
 }
 
 uint32_t IncomingMessages::available(const std::string& destination)
@@ -257,9 +327,10 @@ uint32_t IncomingMessages::available(const std::string& destination)
     //first pump all available messages from incoming to received...
     while (process(0, 0)) {}
 
-    //count all messages for this destination from received list
+    //return the count of messages received for this destination
     sys::Mutex::ScopedLock l(lock);
-    return std::for_each(received.begin(), received.end(), Match(destination)).matched;
+    Destinations::const_iterator i = received.find(destination);
+    return i == received.end() ? 0 : i->second.size();
 }
 
 void populate(qpid::messaging::Message& message, FrameSet& command);
@@ -356,7 +427,12 @@ void populate(qpid::messaging::Message& message, FrameSet& command)
     //e.g. for rejecting.
     MessageImplAccess::get(message).setInternalId(command.getId());
         
-    message.setContent(command.getContent());
+    //share the body of a single content frame; otherwise assemble
+    //the frames straight into the message
+    qpid::messaging::MessageImpl& impl = MessageImplAccess::get(message);
+    ConstBufferRef ref = command.getContentRef();
+    impl.setBytes(ref);
+    if (!ref.begin()) command.getContent(impl.getBytes());
 
     populateHeaders(message, command.getHeaders());
 }
@@ -22,7 +22,10 @@
  *
  */
 #include <string>
+#include <deque>
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
 #include "qpid/client/AsyncSession.h"
 #include "qpid/framing/SequenceSet.h"
 #include "qpid/sys/BlockingQueue.h"
@@ -44,6 +47,12 @@ namespace amqp0_10 {
 
 /**
  * Queue of incoming messages.
+ *
+ * Messages taken off the session's queue that were not wanted by the
+ * caller are kept in a queue per destination, so that a receiver
+ * finds its messages without looking at any other receiver's. The
+ * order they arrived in across destinations is kept in a separate
+ * list for getNextDestination().
  */
 class IncomingMessages
 {
@@ -68,9 +77,18 @@ class IncomingMessages
         virtual bool accept(MessageTransfer& transfer) = 0;
     };
 
+    IncomingMessages();
     void setSession(qpid::client::AsyncSession session);
-    bool get(Handler& handler, qpid::sys::Duration timeout);
+    bool get(const std::string& destination, Handler& handler, qpid::sys::Duration timeout);
     bool getNextDestination(std::string& destination, qpid::sys::Duration timeout);
+    /** Mark a destination as one whose messages go to dispatch() */
+    void listen(const std::string& destination, bool on);
+    /**
+     * Offer the next message for a listened destination to the
+     * handler, taking messages already received first. Messages for
+     * other destinations are kept for get().
+     */
+    bool dispatch(Handler& handler, qpid::sys::Duration timeout);
     void accept();
     void accept(qpid::framing::SequenceNumber id, bool cumulative);
     void releaseAll();
@@ -82,17 +100,35 @@ class IncomingMessages
     uint32_t available();
     uint32_t available(const std::string& destination);
   private:
-    typedef std::deque<FrameSetPtr> FrameSetQueue;
+    struct Received
+    {
+        uint64_t position;      // in the order of arrival across destinations
+        FrameSetPtr content;
+
+        Received(uint64_t p, FrameSetPtr c) : position(p), content(c) {}
+    };
+    typedef std::deque<Received> FrameSetQueue;
+    typedef boost::unordered_map<std::string, FrameSetQueue> Destinations;
+    /** An arrival; stale once its message has been taken some other way */
+    typedef std::pair<uint64_t, Destinations::value_type*> Arrival;
 
     sys::Mutex lock;
     qpid::client::AsyncSession session;
     boost::shared_ptr< sys::BlockingQueue<FrameSetPtr> > incoming;
-    FrameSetQueue received;
+    Destinations received;
+    std::deque<Arrival> arrivals;
+    boost::unordered_set<std::string> listened;
+    std::deque<std::string> listenedReady; // listened destinations that may have messages in received
+    uint64_t nextPosition;
+    uint32_t count;             // messages in all of received
     AcceptTracker acceptTracker;
 
     bool process(Handler*, qpid::sys::Duration);
     bool wait(qpid::sys::Duration);
     void retrieve(FrameSetPtr, qpid::messaging::Message*);
+    void push(FrameSetPtr, const sys::Mutex::ScopedLock&);
+    FrameSetPtr pop(FrameSetQueue&, const sys::Mutex::ScopedLock&);
+    Destinations::value_type* nextArrival(const sys::Mutex::ScopedLock&);
 
 };
 }}} // namespace qpid::client::amqp0_10
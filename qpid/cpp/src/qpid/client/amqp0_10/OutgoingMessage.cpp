@@ -21,6 +21,9 @@
 #include "qpid/client/amqp0_10/OutgoingMessage.h"
 #include "qpid/client/amqp0_10/AddressResolution.h"
 #include "qpid/amqp_0_10/Codecs.h"
+#include "qpid/client/CompletionImpl.h"
+#include "qpid/client/MessageImpl.h"
+#include "qpid/client/PrivateImplRef.h"
 #include "qpid/types/Variant.h"
 #include "qpid/messaging/Address.h"
 #include "qpid/messaging/Message.h"
@@ -49,8 +52,9 @@ const std::string X_CONTENT_ENCODING("x-amqp-0-10.content-encoding");
 
 void OutgoingMessage::convert(const qpid::messaging::Message& from)
 {
-    //TODO: need to avoid copying as much as possible
-    message.setData(from.getContent());
+    //share the content with the message rather than copying it;
+    //the transfer's frames then refer to the same buffer
+    qpid::client::MessageImpl::get(message)->setData(MessageImplAccess::get(from).getBytesRef());
     message.getMessageProperties().setContentType(from.getContentType());
     message.getMessageProperties().setCorrelationId(from.getCorrelationId());
     message.getMessageProperties().setUserId(from.getUserId());
@@ -101,4 +105,9 @@ std::string OutgoingMessage::getSubject() const
     return message.getMessageProperties().getApplicationHeaders().getAsString(SUBJECT);
 }
 
+qpid::framing::SequenceNumber OutgoingMessage::getCommandId() const
+{
+    return PrivateImplRef<Completion>::get(status)->getCommandId();
+}
+
 }}} // namespace qpid::client::amqp0_10
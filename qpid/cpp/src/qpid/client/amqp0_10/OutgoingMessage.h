@@ -23,6 +23,7 @@
  */
 #include "qpid/client/Completion.h"
 #include "qpid/client/Message.h"
+#include "qpid/framing/SequenceNumber.h"
 
 namespace qpid {
 namespace messaging {
@@ -39,6 +40,8 @@ struct OutgoingMessage
     void convert(const qpid::messaging::Message&);
     void setSubject(const std::string& subject);
     std::string getSubject() const;
+    /** The id of the transfer command that last sent the message */
+    qpid::framing::SequenceNumber getCommandId() const;
 };
 
 
@@ -25,6 +25,7 @@
 #include "qpid/messaging/exceptions.h"
 #include "qpid/messaging/Receiver.h"
 #include "qpid/messaging/Session.h"
+#include <algorithm>
 
 namespace qpid {
 namespace client {
@@ -34,16 +35,68 @@ using qpid::messaging::NoMessageAvailable;
 using qpid::messaging::Receiver;
 using qpid::messaging::Duration;
 
+namespace {
+// Waits shorter than this mean the message was already prefetched;
+// longer ones are taken as a round trip to the broker, up to a cap so
+// that an idle queue does not inflate the estimate
+const sys::Duration MIN_RTT_SAMPLE(10 * sys::TIME_USEC);
+const sys::Duration MAX_RTT_SAMPLE(100 * sys::TIME_MSEC);
+}
+
+const uint32_t ReceiverImpl::MIN_CREDIT;
+const uint32_t ReceiverImpl::DEFAULT_MAX_CREDIT;
+
 void ReceiverImpl::received(qpid::messaging::Message&)
 {
     //TODO: should this be configurable
     sys::Mutex::ScopedLock l(lock);
-    if (capacity && --window <= capacity/2) {
+    ++consumed;
+    if (credit && --window <= credit/2) {
+        if (adaptive) adjustCredit(l);
         session.sendCompletion();
-        window = capacity;
+        window = credit;
     }
 }
 
+uint32_t ReceiverImpl::maxCredit() const
+{
+    return adaptive && !capacity ? DEFAULT_MAX_CREDIT : capacity;
+}
+
+/**
+ * Size the window to cover twice what the application consumed in a
+ * round trip over the last interval. While the window is what limits
+ * consumption this doubles it on every adjustment.
+ */
+void ReceiverImpl::adjustCredit(const sys::Mutex::ScopedLock& l)
+{
+    sys::AbsTime now = sys::AbsTime::now();
+    int64_t elapsed = sys::Duration(rateStart, now);
+    if (elapsed <= 0) return;
+    uint64_t target = uint64_t(consumed) * 2 * int64_t(rtt) / elapsed;
+    target = std::min(std::max(target, uint64_t(MIN_CREDIT)), uint64_t(maxCredit()));
+    if (target > credit) {
+        session.messageFlow(destination, CREDIT_UNIT_MESSAGE, target - credit);
+        credit = target;
+        rateStart = now;
+        consumed = 0;
+    } else if (target < credit / 4) {
+        //credit can't be withdrawn, so restart the flow with less
+        credit = target;
+        session.messageStop(destination);
+        startFlow(l);
+    } else {
+        rateStart = now;
+        consumed = 0;
+    }
+}
+
+void ReceiverImpl::noteRoundTrip(sys::Duration sample)
+{
+    sys::Mutex::ScopedLock l(lock);
+    rtt = (7 * int64_t(rtt) + std::min(int64_t(sample), int64_t(MAX_RTT_SAMPLE))) / 8;
+}
+
 qpid::messaging::Message ReceiverImpl::get(qpid::messaging::Duration timeout)
 {
     qpid::messaging::Message result;
@@ -98,14 +151,26 @@ void ReceiverImpl::setCapacity(uint32_t c)
     execute1<SetCapacity>(c);
 }
 
+void ReceiverImpl::setListener(qpid::messaging::MessageListener* l)
+{
+    {
+        sys::Mutex::ScopedLock lk(lock);
+        if (state == CANCELLED) return;
+        listener = l;
+    }
+    parent->listen(*this, l);
+}
+
 void ReceiverImpl::startFlow(const sys::Mutex::ScopedLock&)
 {
-    if (capacity > 0) {
+    if (credit > 0) {
         session.messageSetFlowMode(destination, FLOW_MODE_WINDOW);
-        session.messageFlow(destination, CREDIT_UNIT_MESSAGE, capacity);
+        session.messageFlow(destination, CREDIT_UNIT_MESSAGE, credit);
         session.messageFlow(destination, CREDIT_UNIT_BYTE, byteCredit);
-        window = capacity;
+        window = credit;
     }
+    rateStart = sys::AbsTime::now();
+    consumed = 0;
 }
 
 void ReceiverImpl::init(qpid::client::AsyncSession s, AddressResolution& resolver)
@@ -146,8 +211,11 @@ uint32_t ReceiverImpl::getUnsettled()
 ReceiverImpl::ReceiverImpl(SessionImpl& p, const std::string& name,
                            const qpid::messaging::Address& a) :
 
-    parent(&p), destination(name), address(a), byteCredit(0xFFFFFFFF),
-    state(UNRESOLVED), capacity(0), window(0) {}
+    parent(&p), destination(name), address(a),
+    byteCredit(AddressResolution::byte_credit(a)),
+    adaptive(AddressResolution::is_adaptive(a)),
+    state(UNRESOLVED), capacity(0), listener(0), window(0), credit(adaptive ? MIN_CREDIT : 0),
+    rateStart(sys::AbsTime::now()), consumed(0), rtt(sys::TIME_MSEC) {}
 
 bool ReceiverImpl::getImpl(qpid::messaging::Message& message, qpid::messaging::Duration timeout)
 {
@@ -155,7 +223,13 @@ bool ReceiverImpl::getImpl(qpid::messaging::Message& message, qpid::messaging::D
         sys::Mutex::ScopedLock l(lock);
         if (state == CANCELLED) return false;
     }
-    return parent->get(*this, message, timeout);
+    if (!adaptive) return parent->get(*this, message, timeout);
+
+    sys::AbsTime start = sys::AbsTime::now();
+    if (!parent->get(*this, message, timeout)) return false;
+    sys::Duration waited(start, sys::AbsTime::now());
+    if (waited > MIN_RTT_SAMPLE) noteRoundTrip(waited);
+    return true;
 }
 
 bool ReceiverImpl::fetchImpl(qpid::messaging::Message& message, qpid::messaging::Duration timeout)
@@ -164,10 +238,10 @@ bool ReceiverImpl::fetchImpl(qpid::messaging::Message& message, qpid::messaging:
         sys::Mutex::ScopedLock l(lock);
         if (state == CANCELLED) return false;
 
-        if (capacity == 0 || state != STARTED) {
+        if (credit == 0 || state != STARTED) {
             session.messageSetFlowMode(destination, FLOW_MODE_CREDIT);
             session.messageFlow(destination, CREDIT_UNIT_MESSAGE, 1);
-            session.messageFlow(destination, CREDIT_UNIT_BYTE, 0xFFFFFFFF);
+            session.messageFlow(destination, CREDIT_UNIT_BYTE, byteCredit);
         }
     }
     if (getImpl(message, timeout)) {
@@ -179,7 +253,9 @@ bool ReceiverImpl::fetchImpl(qpid::messaging::Message& message, qpid::messaging:
             if (state == CANCELLED) return false; // Might have been closed during get.
             s = sync(session);
         }
+        sys::AbsTime start = sys::AbsTime::now();
         s.messageFlush(destination);
+        if (adaptive) noteRoundTrip(sys::Duration(start, sys::AbsTime::now()));
         {
             sys::Mutex::ScopedLock l(lock);
             startFlow(l); //reallocate credit
@@ -210,6 +286,7 @@ void ReceiverImpl::setCapacityImpl(uint32_t c)
     sys::Mutex::ScopedLock l(lock);
     if (c != capacity) {
         capacity = c;
+        credit = adaptive ? std::min(std::max(credit, MIN_CREDIT), maxCredit()) : capacity;
         if (state == STARTED) {
             session.messageStop(destination);
             startFlow(l);
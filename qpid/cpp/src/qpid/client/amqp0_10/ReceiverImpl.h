@@ -28,6 +28,7 @@
 #include "qpid/client/amqp0_10/SessionImpl.h"
 #include "qpid/messaging/Duration.h"
 #include "qpid/sys/Mutex.h"
+#include "qpid/sys/Time.h"
 #include <boost/intrusive_ptr.hpp>
 #include <memory>
 
@@ -40,6 +41,15 @@ class MessageSource;
 
 /**
  * A receiver implementation based on an AMQP 0-10 subscription.
+ *
+ * By default the message credit window is fixed at the capacity. If
+ * the address sets link/x-credit/mode to 'adaptive', the window
+ * instead tracks the rate at which the application consumes messages
+ * times the round trip to the broker, between MIN_CREDIT and the
+ * capacity (or DEFAULT_MAX_CREDIT when no capacity is set). It grows
+ * whenever the application finds nothing prefetched and shrinks when
+ * much more is buffered than is consumed in a round trip. In either
+ * mode link/x-credit/max-bytes bounds the bytes prefetched.
  */
 class ReceiverImpl : public qpid::messaging::ReceiverImpl
 {
@@ -60,6 +70,7 @@ class ReceiverImpl : public qpid::messaging::ReceiverImpl
     void stop();
     const std::string& getName() const;
     void setCapacity(uint32_t);
+    void setListener(qpid::messaging::MessageListener*);
     uint32_t getCapacity();
     uint32_t getAvailable();
     uint32_t getUnsettled();
@@ -67,12 +78,16 @@ class ReceiverImpl : public qpid::messaging::ReceiverImpl
     qpid::messaging::Session getSession() const;
     bool isClosed() const;
 
+    static const uint32_t MIN_CREDIT = 2;
+    static const uint32_t DEFAULT_MAX_CREDIT = 1000;
+
   private:
     mutable sys::Mutex lock;
     boost::intrusive_ptr<SessionImpl> parent;
     const std::string destination;
     const qpid::messaging::Address address;
     const uint32_t byteCredit;
+    const bool adaptive;
     State state;
 
     std::auto_ptr<MessageSource> source;
@@ -80,8 +95,17 @@ class ReceiverImpl : public qpid::messaging::ReceiverImpl
     qpid::client::AsyncSession session;
     qpid::messaging::MessageListener* listener;
     uint32_t window;
+    uint32_t credit;            // current message window, the capacity unless adaptive
+
+    //adaptive credit state
+    sys::AbsTime rateStart;     // start of the current rate measurement
+    uint32_t consumed;          // messages handed to the application since then
+    sys::Duration rtt;          // smoothed round trip to the broker
 
     void startFlow(const sys::Mutex::ScopedLock&); // Dummy param, call with lock held
+    void adjustCredit(const sys::Mutex::ScopedLock&);
+    void noteRoundTrip(sys::Duration);
+    uint32_t maxCredit() const;
     //implementation of public facing methods
     bool fetchImpl(qpid::messaging::Message& message, qpid::messaging::Duration timeout);
     bool getImpl(qpid::messaging::Message& message, qpid::messaging::Duration timeout);
@@ -24,6 +24,8 @@
 #include "AddressResolution.h"
 #include "OutgoingMessage.h"
 #include "qpid/messaging/Session.h"
+#include "qpid/client/SessionBase_0_10Access.h"
+#include "qpid/client/SessionImpl.h"
 
 namespace qpid {
 namespace client {
@@ -46,6 +48,13 @@ void SenderImpl::send(const qpid::messaging::Message& message, bool sync)
     if (sync) parent->sync(true);
 }
 
+void SenderImpl::send(const std::vector<qpid::messaging::Message>& messages, bool sync)
+{
+    SendBatch f(*this, &messages);
+    while (f.next < messages.size()) parent->execute(f);
+    if (sync) parent->sync(true);
+}
+
 void SenderImpl::close()
 {
     execute<Close>();
@@ -95,6 +104,16 @@ void SenderImpl::init(qpid::client::AsyncSession s, AddressResolution& resolver)
 void SenderImpl::waitForCapacity() 
 {
     sys::Mutex::ScopedLock l(lock);
+    waitForCapacity(l);
+    //flush periodically and check for conmpleted sends
+    if (++window > (capacity / 4)) {//TODO: make this configurable?
+        checkPendingSends(true, l);
+        window = 0;
+    }
+}
+
+void SenderImpl::waitForCapacity(const sys::Mutex::ScopedLock& l)
+{
     //TODO: add option to throw exception rather than blocking?
     if (!unreliable && capacity <=
         (flushed ? checkPendingSends(false, l) : outgoing.size()))
@@ -106,16 +125,16 @@ void SenderImpl::waitForCapacity()
         session.sync();
         checkPendingSends(false, l);
     }
-    //flush periodically and check for conmpleted sends
-    if (++window > (capacity / 4)) {//TODO: make this configurable?
-        checkPendingSends(true, l);
-        window = 0;
-    }
 }
 
 void SenderImpl::sendImpl(const qpid::messaging::Message& m)
 {
     sys::Mutex::ScopedLock l(lock);
+    sendImpl(m, l);
+}
+
+void SenderImpl::sendImpl(const qpid::messaging::Message& m, const sys::Mutex::ScopedLock&)
+{
     std::auto_ptr<OutgoingMessage> msg(new OutgoingMessage());
     msg->convert(m);
     msg->setSubject(m.getSubject().empty() ? address.getSubject() : m.getSubject());
@@ -126,12 +145,39 @@ void SenderImpl::sendImpl(const qpid::messaging::Message& m)
 void SenderImpl::sendUnreliable(const qpid::messaging::Message& m)
 {
     sys::Mutex::ScopedLock l(lock);
+    sendUnreliable(m, l);
+}
+
+void SenderImpl::sendUnreliable(const qpid::messaging::Message& m, const sys::Mutex::ScopedLock&)
+{
     OutgoingMessage msg;
     msg.convert(m);
     msg.setSubject(m.getSubject().empty() ? address.getSubject() : m.getSubject());
     sink->send(session, name, msg);
 }
 
+void SenderImpl::sendBatchImpl(const std::vector<qpid::messaging::Message>& messages, size_t& next)
+{
+    sys::Mutex::ScopedLock l(lock);
+    while (next < messages.size()) {
+        const qpid::messaging::Message& m = messages[next];
+        if (unreliable) {
+            ++next;
+            sendUnreliable(m, l);
+        } else {
+            waitForCapacity(l);
+            //once sendImpl has recorded the message in outgoing it
+            //is replayed after any failure, so a retry must start
+            //with the next one
+            ++next;
+            sendImpl(m, l);
+        }
+    }
+    //one flush for the batch instead of one every capacity/4 messages
+    checkPendingSends(true, l);
+    window = 0;
+}
+
 void SenderImpl::replay(const sys::Mutex::ScopedLock&)
 {
     for (OutgoingMessages::iterator i = outgoing.begin(); i != outgoing.end(); ++i) {
@@ -153,8 +199,14 @@ uint32_t SenderImpl::checkPendingSends(bool flush, const sys::Mutex::ScopedLock&
     } else {
         flushed = false;
     }
-    while (!outgoing.empty() && outgoing.front().status.isComplete()) {
-        outgoing.pop_front();
+    if (!outgoing.empty()) {
+        // Everything sent before the session's first incomplete
+        // command is complete and can be released in one step
+        framing::SequenceNumber firstIncomplete =
+            SessionBase_0_10Access(session).get()->getFirstIncompleteOut();
+        OutgoingMessages::iterator i = outgoing.begin();
+        while (i != outgoing.end() && i->getCommandId() < firstIncomplete) ++i;
+        outgoing.erase(outgoing.begin(), i);
     }
     return outgoing.size();
 }
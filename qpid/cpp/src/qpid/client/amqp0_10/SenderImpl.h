@@ -27,6 +27,7 @@
 #include "qpid/client/AsyncSession.h"
 #include "qpid/client/amqp0_10/SessionImpl.h"
 #include <memory>
+#include <vector>
 #include <boost/intrusive_ptr.hpp>
 #include <boost/ptr_container/ptr_deque.hpp>
 
@@ -49,6 +50,7 @@ class SenderImpl : public qpid::messaging::SenderImpl
     SenderImpl(SessionImpl& parent, const std::string& name, 
                const qpid::messaging::Address& address);
     void send(const qpid::messaging::Message&, bool sync);
+    void send(const std::vector<qpid::messaging::Message>&, bool sync);
     void close();
     void setCapacity(uint32_t);
     uint32_t getCapacity();
@@ -81,10 +83,14 @@ class SenderImpl : public qpid::messaging::SenderImpl
     uint32_t checkPendingSends(bool flush, const sys::Mutex::ScopedLock&);
     void replay(const sys::Mutex::ScopedLock&); 
     void waitForCapacity();
+    void waitForCapacity(const sys::Mutex::ScopedLock&);
 
     //logic for application visible methods:
     void sendImpl(const qpid::messaging::Message&);
     void sendUnreliable(const qpid::messaging::Message&);
+    void sendImpl(const qpid::messaging::Message&, const sys::Mutex::ScopedLock&);
+    void sendUnreliable(const qpid::messaging::Message&, const sys::Mutex::ScopedLock&);
+    void sendBatchImpl(const std::vector<qpid::messaging::Message>&, size_t& next);
     void closeImpl();
 
 
@@ -128,6 +134,15 @@ class SenderImpl : public qpid::messaging::SenderImpl
         }
     };
 
+    struct SendBatch : Command
+    {
+        const std::vector<qpid::messaging::Message>* messages;
+        size_t next;        // first message not yet recorded for replay
+
+        SendBatch(SenderImpl& i, const std::vector<qpid::messaging::Message>* m) : Command(i), messages(m), next(0) {}
+        void operator()() { impl.sendBatchImpl(*messages, next); }
+    };
+
     struct Close : Command
     {
         Close(SenderImpl& i) : Command(i) {}
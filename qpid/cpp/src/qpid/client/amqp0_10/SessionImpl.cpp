@@ -33,6 +33,7 @@
 #include "qpid/messaging/Connection.h"
 #include "qpid/messaging/Message.h"
 #include "qpid/messaging/MessageImpl.h"
+#include "qpid/messaging/MessageListener.h"
 #include "qpid/messaging/Sender.h"
 #include "qpid/messaging/Receiver.h"
 #include "qpid/messaging/Session.h"
@@ -56,7 +57,13 @@ namespace amqp0_10 {
 typedef qpid::sys::Mutex::ScopedLock ScopedLock;
 typedef qpid::sys::Mutex::ScopedUnlock ScopedUnlock;
 
-SessionImpl::SessionImpl(ConnectionImpl& c, bool t) : connection(&c), transactional(t) {}
+SessionImpl::SessionImpl(ConnectionImpl& c, bool t) :
+    connection(&c), resolver(c.getNodeCache()), transactional(t), dispatcher(*this), dispatching(false) {}
+
+SessionImpl::~SessionImpl()
+{
+    stopDispatch();
+}
 
 void SessionImpl::checkError()
 {
@@ -126,6 +133,7 @@ void SessionImpl::acknowledge(qpid::messaging::Message& m, bool cumulative)
 
 void SessionImpl::close()
 {
+    stopDispatch();
     if (hasError()) {
         ScopedLock l(lock);
         senders.clear();
@@ -172,7 +180,7 @@ template <class T> void getFreeKey(std::string& key, T& map)
 }
 
 
-void SessionImpl::setSession(qpid::client::Session s)
+void SessionImpl::setSession(qpid::client::Session s, bool syncNow)
 {
     ScopedLock l(lock);
     session = s;
@@ -184,7 +192,7 @@ void SessionImpl::setSession(qpid::client::Session s)
     for (Senders::iterator i = senders.begin(); i != senders.end(); ++i) {
         getImplPtr<Sender, SenderImpl>(i->second)->init(session, resolver);
     }
-    session.sync();
+    if (syncNow) session.sync();
 }
 
 struct SessionImpl::CreateReceiver : Command
@@ -314,6 +322,23 @@ bool SessionImpl::accept(ReceiverImpl* receiver,
     }
 }
 
+bool SessionImpl::dispatchTo(qpid::messaging::MessageListener** listener,
+                             qpid::messaging::Message* message,
+                             IncomingMessages::MessageTransfer& transfer)
+{
+    boost::intrusive_ptr<ReceiverImpl> receiver;
+    {
+        ScopedLock l(listenerLock);
+        Listeners::const_iterator i = listeners.find(transfer.getDestination());
+        if (i == listeners.end()) return false;
+        receiver = i->second.first;
+        *listener = i->second.second;
+    }
+    transfer.retrieve(message);
+    receiver->received(*message);
+    return true;
+}
+
 qpid::sys::Duration adjust(qpid::messaging::Duration timeout)
 {
     uint64_t ms = timeout.getMilliseconds();
@@ -324,15 +349,88 @@ qpid::sys::Duration adjust(qpid::messaging::Duration timeout)
     }
 }
 
-bool SessionImpl::getIncoming(IncomingMessages::Handler& handler, qpid::messaging::Duration timeout)
+bool SessionImpl::getIncoming(const std::string& destination, IncomingMessages::Handler& handler,
+                              qpid::messaging::Duration timeout)
 {
-    return incoming.get(handler, adjust(timeout));
+    return incoming.get(destination, handler, adjust(timeout));
 }
 
 bool SessionImpl::get(ReceiverImpl& receiver, qpid::messaging::Message& message, qpid::messaging::Duration timeout)
 {
     IncomingMessageHandler handler(boost::bind(&SessionImpl::accept, this, &receiver, &message, _1));
-    return getIncoming(handler, timeout);
+    return getIncoming(receiver.getName(), handler, timeout);
+}
+
+namespace {
+// How often an idle dispatch thread checks whether it has been stopped
+const qpid::sys::Duration DISPATCH_POLL = 100*qpid::sys::TIME_MSEC;
+}
+
+void SessionImpl::listen(ReceiverImpl& receiver, qpid::messaging::MessageListener* listener)
+{
+    {
+        ScopedLock l(listenerLock);
+        if (listener) listeners[receiver.getName()] = Listener(&receiver, listener);
+        else listeners.erase(receiver.getName());
+    }
+    incoming.listen(receiver.getName(), listener != 0);
+}
+
+bool SessionImpl::isDispatching()
+{
+    ScopedLock l(lock);
+    return dispatching;
+}
+
+void SessionImpl::dispatch()
+{
+    while (isDispatching()) {
+        try {
+            qpid::messaging::MessageListener* listener = 0;
+            qpid::messaging::Message message;
+            IncomingMessageHandler handler(boost::bind(&SessionImpl::dispatchTo, this, &listener, &message, _1));
+            // the listener is called with no lock held so it may use the session
+            if (incoming.dispatch(handler, DISPATCH_POLL)) listener->received(message);
+        } catch (const TransportFailure&) {
+            reconnect();
+        } catch (const std::exception& e) {
+            QPID_LOG(error, "Stopped dispatching messages on session: " << e.what());
+            ScopedLock l(lock);
+            dispatching = false;
+        }
+    }
+}
+
+void SessionImpl::startDispatch()
+{
+    qpid::sys::Thread previous;
+    {
+        ScopedLock l(lock);
+        if (dispatching) return;
+        previous = dispatchThread;
+        dispatchThread = qpid::sys::Thread();
+    }
+    // reap a thread that stopped itself after an error
+    if (previous && previous != qpid::sys::Thread::current()) previous.join();
+    ScopedLock l(lock);
+    if (dispatching) return;
+    dispatching = true;
+    dispatchThread = qpid::sys::Thread(dispatcher);
+}
+
+void SessionImpl::stopDispatch()
+{
+    qpid::sys::Thread thread;
+    {
+        ScopedLock l(lock);
+        dispatching = false;
+        // a listener may stop dispatch from the dispatch thread itself,
+        // leave that thread to be reaped by a later start or stop
+        if (!dispatchThread || dispatchThread == qpid::sys::Thread::current()) return;
+        thread = dispatchThread;
+        dispatchThread = qpid::sys::Thread();
+    }
+    thread.join();
 }
 
 bool SessionImpl::nextReceiver(qpid::messaging::Receiver& receiver, qpid::messaging::Duration timeout)
@@ -497,6 +595,11 @@ void SessionImpl::releaseImpl(qpid::messaging::Message& m)
 
 void SessionImpl::receiverCancelled(const std::string& name)
 {
+    {
+        ScopedLock l(listenerLock);
+        listeners.erase(name);
+    }
+    incoming.listen(name, false);
     ScopedLock l(lock);
     receivers.erase(name);
     session.sync();
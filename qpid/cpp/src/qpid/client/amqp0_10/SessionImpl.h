@@ -29,6 +29,8 @@
 #include "qpid/client/amqp0_10/AddressResolution.h"
 #include "qpid/client/amqp0_10/IncomingMessages.h"
 #include "qpid/sys/Mutex.h"
+#include "qpid/sys/Runnable.h"
+#include "qpid/sys/Thread.h"
 #include "qpid/framing/reply_exceptions.h"
 #include <boost/intrusive_ptr.hpp>
 
@@ -38,6 +40,7 @@ namespace messaging {
 class Address;
 class Connection;
 class Message;
+class MessageListener;
 class Receiver;
 class Sender;
 class Session;
@@ -58,6 +61,7 @@ class SessionImpl : public qpid::messaging::SessionImpl
 {
   public:
     SessionImpl(ConnectionImpl&, bool transactional);
+    ~SessionImpl();
     void commit();
     void rollback();
     void acknowledge(bool sync);
@@ -75,12 +79,16 @@ class SessionImpl : public qpid::messaging::SessionImpl
     bool nextReceiver(qpid::messaging::Receiver& receiver, qpid::messaging::Duration timeout);
     qpid::messaging::Receiver nextReceiver(qpid::messaging::Duration timeout);
 
+    void startDispatch();
+    void stopDispatch();
+
     qpid::messaging::Connection getConnection() const;
     void checkError();
     bool hasError();
 
     bool get(ReceiverImpl& receiver, qpid::messaging::Message& message, qpid::messaging::Duration timeout);
 
+    void listen(ReceiverImpl& receiver, qpid::messaging::MessageListener* listener);
     void releasePending(const std::string& destination);
     void receiverCancelled(const std::string& name);
     void senderCancelled(const std::string& name);
@@ -91,7 +99,9 @@ class SessionImpl : public qpid::messaging::SessionImpl
     uint32_t getUnsettledAcks();
     uint32_t getUnsettledAcks(const std::string& destination);
 
-    void setSession(qpid::client::Session);
+    /** Use a new session, re-subscribing receivers and re-sending
+     * unsettled messages; if syncNow is false the caller must sync it */
+    void setSession(qpid::client::Session, bool syncNow = true);
 
     template <class T> bool execute(T& f)
     {
@@ -120,6 +130,16 @@ class SessionImpl : public qpid::messaging::SessionImpl
   private:
     typedef std::map<std::string, qpid::messaging::Receiver> Receivers;
     typedef std::map<std::string, qpid::messaging::Sender> Senders;
+    typedef std::pair<boost::intrusive_ptr<ReceiverImpl>, qpid::messaging::MessageListener*> Listener;
+    typedef std::map<std::string, Listener> Listeners;
+
+    struct Dispatcher : qpid::sys::Runnable
+    {
+        SessionImpl& impl;
+
+        Dispatcher(SessionImpl& i) : impl(i) {}
+        void run() { impl.dispatch(); }
+    };
 
     mutable qpid::sys::Mutex lock;
     boost::intrusive_ptr<ConnectionImpl> connection;
@@ -130,9 +150,20 @@ class SessionImpl : public qpid::messaging::SessionImpl
     Senders senders;
     const bool transactional;
 
+    qpid::sys::Mutex listenerLock; // taken inside the IncomingMessages lock, take no other lock while held
+    Listeners listeners;
+    Dispatcher dispatcher;
+    qpid::sys::Thread dispatchThread;
+    bool dispatching;
+
     bool accept(ReceiverImpl*, qpid::messaging::Message*, IncomingMessages::MessageTransfer&);
-    bool getIncoming(IncomingMessages::Handler& handler, qpid::messaging::Duration timeout);
+    bool getIncoming(const std::string& destination, IncomingMessages::Handler& handler,
+                     qpid::messaging::Duration timeout);
     bool getNextReceiver(qpid::messaging::Receiver* receiver, IncomingMessages::MessageTransfer& transfer);
+    bool dispatchTo(qpid::messaging::MessageListener** listener, qpid::messaging::Message* message,
+                    IncomingMessages::MessageTransfer& transfer);
+    void dispatch();
+    bool isDispatching();
     void reconnect();
     bool backoff();
 
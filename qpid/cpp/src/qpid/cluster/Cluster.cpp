@@ -60,10 +60,46 @@
  * cluster::ExpiryPolicy uses cluster time.
  *
  * ClusterTimer implements periodic timed events in the cluster context.
+ * Each task is owned by one member, chosen by a hash of its name.
  * Used for:
  * - periodic management events.
  * - DTX transaction timeouts.
  *
+ *
+ * DELIVERY THREADS
+ *
+ * Delivery is a pipeline of three stages, each of which may run on a
+ * different thread at the same time:
+ *  - the CPG dispatch thread copies delivered events (Cluster::deliver)
+ *  - deliverEventQueue decodes data events into frames (deliveredEvent)
+ *  - deliverFrameQueue executes frames in cluster order (deliveredFrame)
+ *
+ * Only the last stage runs broker code, and it must run one frame at
+ * a time. Members stay identical only if they execute frames in the
+ * same order. Two connections are rarely independent: the queues a
+ * message reaches are not known until its exchange has routed it.
+ * They also share state assigned in delivery order, such as message
+ * and queue positions, management object ids, frame sequence numbers
+ * checked by ErrorCheck and ClusterTimer events. Work moved off the
+ * frame thread must not depend on, or change, any of that.
+ *
+ * For the same reason every member holds every queue: the cluster adds
+ * availability, not capacity. Giving queues to a subset of members
+ * would need routing, acquisition and update decisions to differ
+ * between members, and a member without a queue could not check the
+ * results that ErrorCheck compares. That is a different replication
+ * model (e.g. a primary with backups per queue), not a mode of this one.
+ *
+ * The cluster also uses a single CPG group. Splitting traffic over
+ * several groups, by queue or by connection, would give each group its
+ * own order but no order between groups, so members could execute the
+ * same frames in different interleavings. Ordering only declarations
+ * and bindings across groups is not enough: a message routed on one
+ * group and a purge, delete or consume on another change the same
+ * queue, and which groups a frame touches is again only known after
+ * routing. Faster replication should come from filling each CPG
+ * message (see Multicaster) rather than from more groups.
+ *
  * <h1>CLUSTER PROTOCOL OVERVIEW</h1>
  *
  * Messages sent to/from CPG are called Events.
@@ -199,7 +235,7 @@ namespace _qmf = ::qmf::org::apache::qpid::cluster;
  * Currently use SVN revision to avoid clashes with versions from
  * different branches.
  */
-const uint32_t Cluster::CLUSTER_VERSION = 1159329;
+const uint32_t Cluster::CLUSTER_VERSION = 1159332;
 
 struct ClusterDispatcher : public framing::AMQP_AllOperations::ClusterHandler {
     qpid::cluster::Cluster& cluster;
@@ -255,7 +291,7 @@ Cluster::Cluster(const ClusterSettings& set, broker::Broker& b) :
     clusterId(true),
     mAgent(0),
     expiryPolicy(new ExpiryPolicy(*this)),
-    mcast(cpg, poller, boost::bind(&Cluster::leave, this)),
+    mcast(cpg, poller, boost::bind(&Cluster::leave, this), settings),
     dispatcher(cpg, poller, boost::bind(&Cluster::leave, this)),
     deliverEventQueue(boost::bind(&Cluster::deliveredEvent, this, _1),
                       boost::bind(&Cluster::leave, this),
@@ -338,6 +374,7 @@ void Cluster::initialize() {
         _qmf::Package  packageInit(mAgent);
         mgmtObject = new _qmf::Cluster (mAgent, this, &broker,name,myUrl.str());
         mAgent->addObject (mgmtObject);
+        mcast.setManagementObject(mgmtObject);
     }
 
     // Run initMapCompleted immediately to process the initial configuration
@@ -432,14 +469,23 @@ void Cluster::deliver(
     int msg_len)
 {
     MemberId from(nodeid, pid);
+    if (from == self) mcast.delivered();
     framing::Buffer buf(static_cast<char*>(msg), msg_len);
-    Event e(Event::decodeCopy(from, buf));
-    deliverEvent(e);
+    // The Multicaster may pack several events into one message
+    while (buf.available()) {
+        deliverEvent(Event::decodeCopy(from, buf));
+    }
 }
 
-void Cluster::deliverEvent(const Event& e) { deliverEventQueue.push(e); }
+void Cluster::deliverEvent(const Event& e) {
+    if (mgmtObject) mgmtObject->inc_deliverEvents();
+    deliverEventQueue.push(e);
+}
 
-void Cluster::deliverFrame(const EventFrame& e) { deliverFrameQueue.push(e); }
+void Cluster::deliverFrame(const EventFrame& e) {
+    if (mgmtObject) mgmtObject->inc_deliverFrames();
+    deliverFrameQueue.push(e);
+}
 
 const ClusterUpdateOfferBody* castUpdateOffer(const framing::AMQBody* body) {
     return  (body && body->getMethod() &&
@@ -456,6 +502,7 @@ const ClusterConnectionAnnounceBody* castAnnounce( const framing::AMQBody *body)
 // Handler for deliverEventQueue.
 // This thread decodes frames from events.
 void Cluster::deliveredEvent(const Event& e) {
+    if (mgmtObject) mgmtObject->inc_decodedEvents();
     if (e.isCluster()) {
         EventFrame ef(e, e.getFrame());
         // Stop the deliverEventQueue on update offers.
@@ -474,7 +521,7 @@ void Cluster::deliveredEvent(const Event& e) {
         if (e.isControl())
             deliverFrame(EventFrame(e, e.getFrame()));
         else {
-            try { decoder.decode(e, e.getData()); }
+            try { decoder.decode(e); }
             catch (const Exception& ex) {
                 // Close a connection that is sending us invalid data.
                 QPID_LOG(error, *this << " aborting connection "
@@ -501,6 +548,7 @@ void Cluster::flagError(
 // Handler for deliverFrameQueue.
 // This thread executes the main logic.
 void Cluster::deliveredFrame(const EventFrame& efConst) {
+    if (mgmtObject) mgmtObject->inc_processedFrames();
     Mutex::ScopedLock l(lock);
     sys::ClusterSafeScope css; // Don't trigger cluster-safe asserts.
     if (state == LEFT) return;
@@ -745,7 +793,6 @@ void Cluster::becomeElder(Lock&) {
     QPID_LOG(info, *this << " became the elder, active for links.");
     elder = true;
     broker.getLinks().setPassive(false);
-    timer->becomeElder();
 
     clockTimer.add(new ClusterClockTask(*this, clockTimer, settings.clockInterval));
 }
@@ -1083,6 +1130,9 @@ void Cluster::memberUpdate(Lock& l) {
     }
     lastAliveCount = aliveCount;
 
+    // Share cluster timer tasks between the members.
+    timer->setMembers(map.getMembers());
+
     // Close connections belonging to members that have left the cluster.
     ConnectionMap::iterator i = connections.begin();
     while (i != connections.end()) {
@@ -1154,15 +1204,15 @@ void Cluster::errorCheck(const MemberId& from, uint8_t type, framing::SequenceNu
         error.respondNone(from, type, frameSeq);
 }
 
-void Cluster::timerWakeup(const MemberId& , const std::string& name, Lock&) {
+void Cluster::timerWakeup(const MemberId& from, const std::string& name, Lock&) {
     if (state >= CATCHUP) // Pre catchup our timer isn't set up.
-        timer->deliverWakeup(name);
+        timer->deliverWakeup(from, name);
 }
 
-void Cluster::timerDrop(const MemberId& , const std::string& name, Lock&) {
+void Cluster::timerDrop(const MemberId& from, const std::string& name, Lock&) {
     QPID_LOG(debug, "Cluster timer drop " << map.getFrameSeq() << ": " << name)
         if (state >= CATCHUP) // Pre catchup our timer isn't set up.
-            timer->deliverDrop(name);
+            timer->deliverDrop(from, name);
 }
 
 bool Cluster::isElder() const {
@@ -1184,8 +1234,7 @@ void Cluster::deliverToQueue(const std::string& queue, const std::string& messag
 }
 
 sys::AbsTime Cluster::getClusterTime() {
-    Mutex::ScopedLock l(lock);
-    return clusterTime;
+    return AbsTime(EPOCH, clusterTime.get());
 }
 
 // This method is called during update on the updatee to set the initial cluster time.
@@ -1196,11 +1245,12 @@ void Cluster::clock(const uint64_t time) {
 
 // called when broadcast message received
 void Cluster::clock(const uint64_t time, Lock&) {
-    clusterTime = AbsTime(EPOCH, time);
+    // Only written here, under the lock, so the swap always succeeds
+    clusterTime.valueCompareAndSwap(clusterTime.get(), time);
     AbsTime now = AbsTime::now();
 
     if (!elder) {
-      clusterTimeOffset = Duration(now, clusterTime);
+      clusterTimeOffset = Duration(now, AbsTime(EPOCH, time));
     }
 }
 
@@ -42,6 +42,7 @@
 #include "qpid/Url.h"
 #include "qpid/broker/Broker.h"
 #include "qpid/management/Manageable.h"
+#include "qpid/sys/AtomicValue.h"
 #include "qpid/sys/Monitor.h"
 
 #include <boost/bind.hpp>
@@ -311,7 +312,8 @@ class Cluster : private Cpg::Handler, public management::Manageable {
     UpdateReceiver updateReceiver;
     ClusterTimer* timer;
     sys::Timer clockTimer;
-    sys::AbsTime clusterTime;
+    // Nanoseconds since the epoch, read without the lock for every message with a TTL
+    sys::AtomicValue<int64_t> clusterTime;
     sys::Duration clusterTimeOffset;
     broker::AclModule* acl;
 
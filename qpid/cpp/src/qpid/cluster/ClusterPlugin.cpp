@@ -74,6 +74,15 @@ struct ClusterOptions : public Options {
             ("cluster-size", optValue(settings.size, "N"), "Wait for N cluster members before allowing clients to connect.")
             ("cluster-clock-interval", optValue(settings.clockInterval,"N"), "How often to broadcast the current time to the cluster nodes, in milliseconds. A value between 5 and 1000 is recommended.")
             ("cluster-read-max", optValue(settings.readMax,"N"), "Experimental: flow-control limit  reads per connection. 0=no limit.")
+            ("cluster-mcast-delay", optValue(settings.mcastDelay,"USECS"),
+             "Hold multicast events for up to USECS so they go out in fewer, larger CPG messages. 0=send at once.")
+            ("cluster-mcast-max-bytes", optValue(settings.mcastMaxBytes,"BYTES"),
+             "Largest CPG message to pack multicast events into, a held message is sent as soon as it is this big.")
+            ("cluster-mcast-queue-max", optValue(settings.mcastQueueMax,"BYTES"),
+             "Stop reading from local connections while more than BYTES are waiting to be multicast. "
+             "Takes effect through cluster-read-max, which must not be 0. 0=no limit.")
+            ("cluster-compress-min", optValue(settings.compressMin,"BYTES"),
+             "Deflate client data of at least BYTES before multicasting it. 0=never compress.")
             ;
     }
 };
@@ -33,11 +33,16 @@ struct ClusterSettings {
     std::string url;
     bool quorum;
     size_t readMax;
+    uint32_t mcastDelay;
+    size_t mcastMaxBytes;
+    size_t mcastQueueMax;
+    size_t compressMin;
     std::string username, password, mechanism;
     size_t size;
     uint16_t clockInterval;
 
-    ClusterSettings() : quorum(false), readMax(10), size(1), clockInterval(10)
+    ClusterSettings() : quorum(false), readMax(10), mcastDelay(0), mcastMaxBytes(64*1024),
+                        mcastQueueMax(0), compressMin(0), size(1), clockInterval(10)
     {}
   
     Url getUrl(uint16_t port) const {
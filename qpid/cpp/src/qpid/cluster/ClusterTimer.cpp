@@ -24,6 +24,7 @@
 #include "qpid/log/Statement.h"
 #include "qpid/framing/ClusterTimerWakeupBody.h"
 #include "qpid/framing/ClusterTimerDropBody.h"
+#include <iterator>
 
 namespace qpid {
 namespace cluster {
@@ -53,6 +54,16 @@ using sys::TimerTask;
 //
 
 
+namespace {
+// Same on every member, unlike std::hash
+uint32_t hashName(const std::string& name) {
+    uint32_t h = 2166136261u;   // FNV-1a
+    for (std::string::const_iterator i = name.begin(); i != name.end(); ++i)
+        h = (h ^ uint8_t(*i)) * 16777619u;
+    return h;
+}
+}
+
 ClusterTimer::ClusterTimer(Cluster& c) : cluster(c) {
     // Allow more generous overrun threshold with cluster as we
     // have to do a CPG round trip before executing the task.
@@ -62,81 +73,121 @@ ClusterTimer::ClusterTimer(Cluster& c) : cluster(c) {
 
 ClusterTimer::~ClusterTimer() {}
 
+// Called with lock held.
+MemberId ClusterTimer::owner(const std::string& name) const {
+    if (members.empty()) return MemberId();
+    MemberSet::const_iterator i = members.begin();
+    std::advance(i, hashName(name) % members.size());
+    return *i;
+}
+
+// Called with lock held.
+bool ClusterTimer::isOwner(const Map::iterator& i) const {
+    return !members.empty() && owner(i->first) == cluster.getId();
+}
+
+// Called with lock held. Only the owner activates the task with the
+// Timer base class, and only once while it is waiting there.
+void ClusterTimer::activate(const intrusive_ptr<TimerTask>& t) {
+    if (!active.insert(t.get()).second) return;
+    QPID_LOG(trace, "Owner activating cluster timer task " << t->getName());
+    Timer::add(t);
+}
+
+// Timer thread: the base Timer has let go of t. True if t is still
+// the current task for its name and we own it.
+bool ClusterTimer::deactivate(const intrusive_ptr<TimerTask>& t) {
+    sys::Mutex::ScopedLock l(lock);
+    active.erase(t.get());
+    Map::iterator i = map.find(t->getName());
+    return i != map.end() && i->second == t && isOwner(i);
+}
+
 // Initialization or deliver thread.
 void ClusterTimer::add(intrusive_ptr<TimerTask> task)
 {
     QPID_LOG(trace, "Adding cluster timer task " << task->getName());
+    sys::Mutex::ScopedLock l(lock);
     Map::iterator i = map.find(task->getName());
     if (i != map.end())
         throw Exception(QPID_MSG("Task already exists with name " << task->getName()));
-    map[task->getName()] = task;
-
-    // Only the elder actually activates the task with the Timer base class.
-    if (cluster.isElder()) {
-        QPID_LOG(trace, "Elder activating cluster timer task " << task->getName());
-        Timer::add(task);
-    }
+    i = map.insert(Map::value_type(task->getName(), task)).first;
+    if (isOwner(i)) activate(task);
 }
 
 // Timer thread
 void ClusterTimer::fire(intrusive_ptr<TimerTask> t) {
-    // Elder mcasts wakeup on fire, task is not fired until deliverWakeup
-    if (cluster.isElder()) {
+    // Owner mcasts wakeup on fire, task is not fired until deliverWakeup
+    if (deactivate(t)) {
         QPID_LOG(trace, "Sending cluster timer wakeup " << t->getName());
         cluster.getMulticast().mcastControl(
             framing::ClusterTimerWakeupBody(framing::ProtocolVersion(), t->getName()),
             cluster.getId());
     }
     else
-        QPID_LOG(trace, "Cluster timer task fired, but not elder " << t->getName());
+        QPID_LOG(trace, "Cluster timer task fired, but not owner " << t->getName());
 }
 
 // Timer thread
 void ClusterTimer::drop(intrusive_ptr<TimerTask> t) {
-    // Elder mcasts drop, task is droped in deliverDrop
-    if (cluster.isElder()) {
+    // Owner mcasts drop, task is droped in deliverDrop
+    if (deactivate(t)) {
         QPID_LOG(trace, "Sending cluster timer drop " << t->getName());
         cluster.getMulticast().mcastControl(
             framing::ClusterTimerDropBody(framing::ProtocolVersion(), t->getName()),
             cluster.getId());
     }
     else
-        QPID_LOG(trace, "Cluster timer task dropped, but not on elder " << t->getName());
+        QPID_LOG(trace, "Cluster timer task dropped, but not owner " << t->getName());
+}
+
+// Deliver thread, with lock held.
+bool ClusterTimer::isCurrent(const MemberId& from, const std::string& name, const char* what) {
+    // The sender owned the task when it sent, but a membership change
+    // since then may have given it to a member that will send again.
+    MemberId o = owner(name);
+    if (from == o) return true;
+    QPID_LOG(debug, "Cluster timer " << what << " for " << name << " from " << from
+             << " ignored, owner is " << o);
+    return false;
 }
 
 // Deliver thread
-void ClusterTimer::deliverWakeup(const std::string& name) {
+void ClusterTimer::deliverWakeup(const MemberId& from, const std::string& name) {
     QPID_LOG(trace, "Cluster timer wakeup delivered for " << name);
-    Map::iterator i = map.find(name);
-    if (i == map.end())
-        throw Exception(QPID_MSG("Cluster timer wakeup non-existent task " << name));
-    else {
-        intrusive_ptr<TimerTask> t = i->second;
+    intrusive_ptr<TimerTask> t;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        if (!isCurrent(from, name, "wakeup")) return;
+        Map::iterator i = map.find(name);
+        if (i == map.end())
+            throw Exception(QPID_MSG("Cluster timer wakeup non-existent task " << name));
+        t = i->second;
         map.erase(i);
-        // Move the nextFireTime so readyToFire() is true. This is to ensure we
-        // don't get an error if the fired task calls setupNextFire()
-        t->setFired();
-        Timer::fire(t);
     }
+    // Move the nextFireTime so readyToFire() is true. This is to ensure we
+    // don't get an error if the fired task calls setupNextFire()
+    t->setFired();
+    Timer::fire(t);
 }
 
 // Deliver thread
-void ClusterTimer::deliverDrop(const std::string& name) {
+void ClusterTimer::deliverDrop(const MemberId& from, const std::string& name) {
     QPID_LOG(trace, "Cluster timer drop delivered for " << name);
+    sys::Mutex::ScopedLock l(lock);
+    if (!isCurrent(from, name, "drop")) return;
     Map::iterator i = map.find(name);
     if (i == map.end())
         throw Exception(QPID_MSG("Cluster timer drop non-existent task " << name));
-    else {
-        intrusive_ptr<TimerTask> t = i->second;
-        map.erase(i);
-    }
+    map.erase(i);
 }
 
-// Deliver thread
-void ClusterTimer::becomeElder() {
-    for (Map::iterator i = map.begin(); i != map.end(); ++i) {
-        Timer::add(i->second);
-    }
+// Deliver thread, or update thread while delivery is stalled.
+void ClusterTimer::setMembers(const MemberSet& m) {
+    sys::Mutex::ScopedLock l(lock);
+    members = m;
+    for (Map::iterator i = map.begin(); i != map.end(); ++i)
+        if (isOwner(i)) activate(i->second);
 }
 
 }}
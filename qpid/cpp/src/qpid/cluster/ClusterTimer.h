@@ -22,8 +22,12 @@
  *
  */
 
+#include "qpid/cluster/types.h"
+#include "qpid/cluster/MemberSet.h"
 #include "qpid/sys/Timer.h"
+#include "qpid/sys/Mutex.h"
 #include <map>
+#include <set>
 
 namespace qpid {
 namespace cluster {
@@ -33,8 +37,15 @@ class Cluster;
 /**
  * Timer implementation that executes tasks consistently in the
  * deliver thread across a cluster. Task is not executed when timer
- * fires, instead the elder multicasts a wakeup. The task is executed
- * when the wakeup is delivered.
+ * fires, instead the task's owner multicasts a wakeup. The task is
+ * executed when the wakeup is delivered.
+ *
+ * Tasks are shared out between the cluster members by a hash of the
+ * task name, so timer traffic is spread over the members rather
+ * than sent by the elder alone. Ownership is worked out again from
+ * the delivered membership, so all members agree on it: a wakeup or
+ * drop from a member that no longer owns the task is ignored, and
+ * the new owner activates the task itself.
  */
 class ClusterTimer : public sys::Timer {
   public:
@@ -43,9 +54,10 @@ class ClusterTimer : public sys::Timer {
 
     void add(boost::intrusive_ptr<sys::TimerTask> task);
 
-    void deliverWakeup(const std::string& name);
-    void deliverDrop(const std::string& name);
-    void becomeElder();
+    void deliverWakeup(const MemberId&, const std::string& name);
+    void deliverDrop(const MemberId&, const std::string& name);
+    /** Share out tasks between a new set of members. */
+    void setMembers(const MemberSet&);
 
   protected:
     void fire(boost::intrusive_ptr<sys::TimerTask> task);
@@ -53,8 +65,19 @@ class ClusterTimer : public sys::Timer {
 
   private:
     typedef std::map<std::string, boost::intrusive_ptr<sys::TimerTask> > Map;
+    typedef std::set<sys::TimerTask*> Active;
+
+    MemberId owner(const std::string& name) const;
+    bool isOwner(const Map::iterator&) const;
+    void activate(const boost::intrusive_ptr<sys::TimerTask>&);
+    bool deactivate(const boost::intrusive_ptr<sys::TimerTask>&);
+    bool isCurrent(const MemberId&, const std::string& name, const char* what);
+
+    mutable sys::Mutex lock;
     Cluster& cluster;
     Map map;
+    MemberSet members;
+    Active active;              // Added to the base Timer, not yet popped.
 };
 
 
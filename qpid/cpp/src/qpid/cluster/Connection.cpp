@@ -108,7 +108,10 @@ Connection::Connection(Cluster& c, sys::ConnectionOutputHandler& out,
     secureConnection(0)
 {
     if (isLocalClient()) {
-        giveReadCredit(cluster.getSettings().readMax); // Flow control
+        // Flow control, not through giveReadCredit() as no reference
+        // to this connection can be taken yet
+        if (cluster.getSettings().readMax)
+            releaseReadCredit(cluster.getSettings().readMax);
         // Delay adding the connection to the management map until announce()
         connectionCtor.delayManagement = true;
     }
@@ -149,7 +152,13 @@ void Connection::init() {
 // connection layer to continue reading.
 void Connection::giveReadCredit(int credit) {
     if (cluster.getSettings().readMax && credit)
-        output.giveReadCredit(credit);
+        cluster.getMulticast().whenUncongested(
+            boost::bind(&Connection::releaseReadCredit, ConnectionPtr(this), credit));
+}
+
+// Credit held back while the multicast queue was too deep.
+void Connection::releaseReadCredit(int credit) {
+    output.giveReadCredit(credit);
 }
 
 void Connection::announce(
@@ -20,6 +20,7 @@
  */
 #include "qpid/cluster/Decoder.h"
 #include "qpid/cluster/EventFrame.h"
+#include "qpid/cluster/Event.h"
 #include "qpid/framing/ClusterConnectionDeliverCloseBody.h"
 #include "qpid/framing/Buffer.h"
 #include "qpid/framing/AMQFrame.h"
@@ -28,15 +29,19 @@
 namespace qpid {
 namespace cluster {
 
-void Decoder::decode(const EventHeader& eh, const char* data) {
+void Decoder::decode(const Event& eh) {
     sys::Mutex::ScopedLock l(lock);
     assert(eh.getType() == DATA); // Only handle connection data events.
-    const char* cp = static_cast<const char*>(data);
-    framing::Buffer buf(const_cast<char*>(cp), eh.getSize());
-    framing::FrameDecoder& decoder = map[eh.getConnectionId()];
-    if (decoder.decode(buf)) {  // Decoded a frame
+    framing::Buffer buf(const_cast<char*>(eh.getData()), eh.getSize());
+    ConstBufferRef shared(eh.getDataRef());
+    if (!last || lastId != eh.getConnectionId()) {
+        lastId = eh.getConnectionId();
+        last = &map[lastId];
+    }
+    framing::FrameDecoder& decoder = *last;
+    if (decoder.decode(buf, shared)) {  // Decoded a frame
         framing::AMQFrame frame(decoder.getFrame());
-        while (decoder.decode(buf)) {
+        while (decoder.decode(buf, shared)) {
             callback(EventFrame(eh, frame));
             frame = decoder.getFrame();
         }
@@ -54,6 +59,7 @@ void Decoder::decode(const EventHeader& eh, const char* data) {
 
 void Decoder::erase(const ConnectionId& c) {
     sys::Mutex::ScopedLock l(lock);
+    if (last && lastId == c) last = 0;
     map.erase(c);
 }
 
@@ -32,7 +32,7 @@ namespace qpid {
 namespace cluster {
 
 struct EventFrame;
-class EventHeader;
+class Event;
 
 /**
  * A map of decoders for connections.
@@ -42,8 +42,9 @@ class Decoder
   public:
     typedef boost::function<void(const EventFrame&)> FrameHandler;
 
-    Decoder(FrameHandler fh) : callback(fh) {}
-    void decode(const EventHeader& eh, const char* data);
+    Decoder(FrameHandler fh) : last(0), callback(fh) {}
+    /** Decode a data event. Content is shared with the event's buffer, not copied. */
+    void decode(const Event& e);
     void erase(const ConnectionId&);
     framing::FrameDecoder& get(const ConnectionId& c);
 
@@ -51,6 +52,9 @@ class Decoder
     typedef std::map<ConnectionId, framing::FrameDecoder> Map;
     sys::Mutex lock;
     Map map;
+    // Events tend to come in runs from one connection
+    ConnectionId lastId;
+    framing::FrameDecoder* last;
     void process(const EventFrame&);
     FrameHandler callback;
 };
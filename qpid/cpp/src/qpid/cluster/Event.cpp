@@ -24,7 +24,12 @@
 #include "qpid/framing/Buffer.h"
 #include "qpid/framing/AMQFrame.h"
 #include "qpid/RefCountedBuffer.h"
+#include "qpid/Exception.h"
+#include "qpid/Msg.h"
 #include "qpid/assert.h"
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
 #include <ostream>
 #include <iterator>
 #include <algorithm>
@@ -35,6 +40,13 @@ namespace cluster {
 using framing::Buffer;
 using framing::AMQFrame;
 
+namespace {
+// Set in the type octet of an event with a deflated payload. The
+// payload is then the inflated size followed by the deflate stream.
+const uint8_t COMPRESSED_FLAG = 0x80;
+const size_t INFLATED_SIZE = sizeof(uint32_t);
+}
+
 const size_t EventHeader::HEADER_SIZE =
     sizeof(uint8_t) +  // type
     sizeof(uint64_t) + // connection pointer only, CPG provides member ID.
@@ -42,7 +54,7 @@ const size_t EventHeader::HEADER_SIZE =
     ;
 
 EventHeader::EventHeader(EventType t, const ConnectionId& c,  size_t s)
-    : type(t), connectionId(c), size(s) {}
+    : type(t), connectionId(c), size(s), compressed(false) {}
 
 
 Event::Event() {}
@@ -53,7 +65,9 @@ Event::Event(EventType t, const ConnectionId& c,  size_t s)
 
 void EventHeader::decode(const MemberId& m, framing::Buffer& buf) {
     QPID_ASSERT(buf.available() >= HEADER_SIZE);
-    type = (EventType)buf.getOctet();
+    uint8_t t = buf.getOctet();
+    compressed = t & COMPRESSED_FLAG;
+    type = (EventType)(t & ~COMPRESSED_FLAG);
     QPID_ASSERT(type == DATA || type == CONTROL);
     connectionId = ConnectionId(m, buf.getLongLong());
     size = buf.getLong();
@@ -63,8 +77,53 @@ Event Event::decodeCopy(const MemberId& m, framing::Buffer& buf) {
     Event e;
     e.decode(m, buf);           // Header
     QPID_ASSERT(buf.available() >= e.size);
-    e.store = RefCountedBuffer::create(e.size + HEADER_SIZE);
-    memcpy(e.getData(), buf.getPointer() + buf.getPosition(), e.size);
+    const char* data = buf.getPointer() + buf.getPosition();
+    buf.setPosition(buf.getPosition() + e.size);
+    if (!e.compressed) {
+        e.store = RefCountedBuffer::create(e.size + HEADER_SIZE);
+        memcpy(e.getData(), data, e.size);
+        return e;
+    }
+#ifdef HAVE_ZLIB_H
+    QPID_ASSERT(e.size >= INFLATED_SIZE);
+    Buffer header(const_cast<char*>(data), INFLATED_SIZE);
+    size_t expect = header.getLong();
+    uLongf inflated = expect;
+    e.store = RefCountedBuffer::create(expect + HEADER_SIZE);
+    if (uncompress(reinterpret_cast<Bytef*>(e.getData()), &inflated,
+                   reinterpret_cast<const Bytef*>(data) + INFLATED_SIZE,
+                   e.size - INFLATED_SIZE) != Z_OK || inflated != expect)
+        throw Exception(QPID_MSG("Corrupt compressed cluster event from " << m));
+    e.size = expect;
+    e.compressed = false;
+    return e;
+#else
+    throw Exception(QPID_MSG("Compressed cluster event from " << m
+                             << ", this broker was built without zlib"));
+#endif
+}
+
+Event Event::data(const char* data, size_t size, const ConnectionId& id, size_t compressMin) {
+#ifdef HAVE_ZLIB_H
+    if (compressMin && size >= compressMin) {
+        uLongf deflated = compressBound(size);
+        Event e(DATA, id, INFLATED_SIZE + deflated);
+        Buffer header(e.getData(), INFLATED_SIZE);
+        header.putLong(size);
+        if (compress2(reinterpret_cast<Bytef*>(e.getData()) + INFLATED_SIZE, &deflated,
+                      reinterpret_cast<const Bytef*>(data), size, Z_BEST_SPEED) == Z_OK &&
+            INFLATED_SIZE + deflated < size)
+        {
+            e.size = INFLATED_SIZE + deflated;
+            e.compressed = true;
+            return e;
+        }
+    }
+#else
+    (void) compressMin;
+#endif
+    Event e(DATA, id, size);
+    memcpy(e.getData(), data, size);
     return e;
 }
 
@@ -86,7 +145,7 @@ iovec Event::toIovec() const {
 }
 
 void EventHeader::encode(Buffer& b) const {
-    b.putOctet(type);
+    b.putOctet(compressed ? type | COMPRESSED_FLAG : type);
     b.putLongLong(connectionId.getNumber());
     b.putLong(size);
 }
@@ -59,6 +59,8 @@ class EventHeader {
     bool isCluster() const { return connectionId.getNumber() == 0; }
     bool isConnection() const { return connectionId.getNumber() != 0; }
     bool isControl() const { return type == CONTROL; }
+    /** True if the payload is deflated, only until decodeCopy inflates it. */
+    bool isCompressed() const { return compressed; }
 
   protected:
     static const size_t HEADER_SIZE;
@@ -66,6 +68,7 @@ class EventHeader {
     EventType type;
     ConnectionId connectionId;
     size_t size;
+    bool compressed;
 };
 
 /**
@@ -78,9 +81,19 @@ class Event : public EventHeader {
     /** Create an event with a buffer that can hold size bytes plus an event header. */
     Event(EventType t, const ConnectionId& c, size_t);
 
-    /** Create an event copied from delivered data. */
+    /**
+     * Create an event copied from delivered data, inflating a
+     * compressed payload. Moves buf past the event.
+     */
     static Event decodeCopy(const MemberId& m, framing::Buffer&);
 
+    /**
+     * Create a data event copied from data. The payload is deflated
+     * if compressMin is not 0, size is at least compressMin and
+     * deflating makes it smaller.
+     */
+    static Event data(const char* data, size_t size, const ConnectionId&, size_t compressMin=0);
+
     /** Create a control event. */
     static Event control(const framing::AMQBody&, const ConnectionId&);
 
@@ -90,6 +103,11 @@ class Event : public EventHeader {
     // Data excluding header.
     char* getData() { return store.begin() + HEADER_SIZE; }
     const char* getData() const { return store.begin() + HEADER_SIZE; }
+    /** Data excluding header, as a reference that keeps the event's store alive. */
+    ConstBufferRef getDataRef() const {
+        ConstBufferRef r(store);
+        return r.sub_buffer(getData(), getData() + size);
+    }
 
     // Store including header
     char* getStore() { return store.begin(); }
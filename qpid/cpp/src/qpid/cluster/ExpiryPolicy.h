@@ -40,7 +40,13 @@ namespace cluster {
 class Cluster;
 
 /**
- * Cluster expiry policy
+ * Cluster expiry policy.
+ *
+ * Messages expire against cluster time, which only moves when the
+ * elder multicasts a clock update. Every member sees each update at
+ * the same point in the event stream, so all of them expire the same
+ * messages without an event per message: each clock update settles
+ * expiry for every message whose time has passed.
  */
 class ExpiryPolicy : public broker::ExpiryPolicy
 {
@@ -22,6 +22,7 @@
 #include "qpid/cluster/Multicaster.h"
 #include "qpid/cluster/Cpg.h"
 #include "qpid/cluster/Cluster.h"
+#include "qpid/cluster/ClusterSettings.h"
 #include "qpid/log/Statement.h"
 #include "qpid/framing/AMQBody.h"
 #include "qpid/framing/AMQFrame.h"
@@ -29,13 +30,40 @@
 namespace qpid {
 namespace cluster {
 
+namespace {
+// Most events packed into one CPG message
+const size_t MAX_IOVECS = 64;
+}
+
+// Ends a hold when it has waited for cluster-mcast-delay
+class Multicaster::FlushTask : public sys::TimerTask {
+    Multicaster& mcast;
+    uint32_t held;
+  public:
+    FlushTask(Multicaster& m, uint32_t h) :
+        sys::TimerTask(m.maxDelay, "ClusterMcastFlush"), mcast(m), held(h) {}
+    void fire() { mcast.flush(held); }
+};
+
 Multicaster::Multicaster(Cpg& cpg_, 
                          const boost::shared_ptr<sys::Poller>& poller,
-                         boost::function<void()> onError_) :
+                         boost::function<void()> onError_,
+                         const ClusterSettings& settings) :
     onError(onError_), cpg(cpg_), 
     queue(boost::bind(&Multicaster::sendMcast, this, _1), poller),
-    ready(false), bypass(true)
-{}
+    ready(false), bypass(true),
+    maxDelay(settings.mcastDelay * sys::TIME_USEC),
+    maxBytes(settings.mcastMaxBytes),
+    queueMax(settings.mcastQueueMax),
+    compressMin(settings.compressMin),
+    queuedBytes(0), holding(false), flushing(false), holds(0),
+    timer(settings.mcastDelay ? new sys::Timer : 0),
+    mgmtObject(0)
+{
+#ifndef HAVE_ZLIB_H
+    QPID_LOG_IF(warning, compressMin, "Built without zlib, ignoring cluster-compress-min");
+#endif
+}
 
 void Multicaster::mcastControl(const framing::AMQBody& body, const ConnectionId& id) {
     mcast(Event::control(body, id));
@@ -46,50 +74,155 @@ void Multicaster::mcastControl(const framing::AMQFrame& frame, const ConnectionI
 }
 
 void Multicaster::mcastBuffer(const char* data, size_t size, const ConnectionId& id) {
-    Event e(DATA, id, size);
-    memcpy(e.getData(), data, size);
+    Event e(Event::data(data, size, id, compressMin));
+    if (mgmtObject) {
+        mgmtObject->inc_mcastDataBytes(size);
+        mgmtObject->inc_mcastDataWireBytes(e.getSize());
+    }
     mcast(e);
 }
 
 void Multicaster::mcast(const Event& e) {
+    bool full = false;
+    uint32_t held = 0;
     {
         sys::Mutex::ScopedLock l(lock);
         if (!ready && e.isConnection()) {
             holdingQueue.push_back(e);
             return;
         }
+        if (!bypass) {
+            queuedBytes += e.getStoreSize();
+            if (mgmtObject) mgmtObject->inc_mcastBytesQueued(e.getStoreSize());
+            full = holding && queuedBytes >= maxBytes;
+            held = holds;
+        }
     }
     QPID_LOG_IF(trace, e.isControl() && Cluster::loggable(e.getFrame()), "MCAST " << e);
     if (bypass) {               // direct, don't queue
         iovec iov = e.toIovec();
-        while (!cpg.mcast(&iov, 1))
+        while (!send(&iov, 1))
             ;
     }
-    else
+    else {
         queue.push(e);
+        if (full) flush(held);
+    }
 }
 
 Multicaster::PollableEventQueue::Batch::const_iterator Multicaster::sendMcast(const PollableEventQueue::Batch& values) {
     try {
         PollableEventQueue::Batch::const_iterator i = values.begin();
         while( i != values.end()) {
-            iovec iov = i->toIovec();
-            if (!cpg.mcast(&iov, 1)) {
+            // Pack as many events as fit into one message
+            PollableEventQueue::Batch::const_iterator j = i;
+            size_t bytes = 0;
+            ioVector.clear();
+            do {
+                ioVector.push_back(j->toIovec());
+                bytes += j->getStoreSize();
+                ++j;
+            } while (j != values.end() && ioVector.size() < MAX_IOVECS &&
+                     bytes + j->getStoreSize() <= maxBytes);
+            if (j == values.end() && bytes < maxBytes && hold())
+                break;
+            if (!send(&ioVector[0], ioVector.size())) {
                 // cpg didn't send because of CPG flow control.
+                if (mgmtObject) mgmtObject->inc_cpgFlowStops();
                 break; 
             }
-            ++i;
+            sent(bytes, ioVector.size());
+            i = j;
         }
         return i;
     }
     catch (const std::exception& e) {
         QPID_LOG(critical, "Multicast error: " << e.what());
+        {
+            sys::Mutex::ScopedLock l(lock);
+            holding = false;
+        }
         queue.stop();
         onError();
         return values.end();
     }
 }
 
+// Called in the dispatch thread with a message that is not full: stop
+// the queue until the message fills up or the delay is over.
+bool Multicaster::hold() {
+    sys::Mutex::ScopedLock l(lock);
+    if (!timer.get() || flushing) {
+        flushing = false;
+        return false;
+    }
+    holding = true;
+    queue.stop();
+    timer->add(new FlushTask(*this, ++holds));
+    return true;
+}
+
+void Multicaster::flush(uint32_t held) {
+    sys::Mutex::ScopedLock l(lock);
+    if (!holding || held != holds) return;
+    holding = false;
+    flushing = true;
+    queue.start();
+}
+
+// Remember when each message is sent, CPG delivers our own messages
+// back to us in the same order.
+bool Multicaster::send(const iovec* iov, int n) {
+    {
+        sys::Mutex::ScopedLock l(lock);
+        sendTimes.push_back(sys::AbsTime::now());
+    }
+    if (cpg.mcast(iov, n)) return true;
+    sys::Mutex::ScopedLock l(lock);
+    sendTimes.pop_back();
+    return false;
+}
+
+void Multicaster::delivered() {
+    sys::AbsTime sentAt;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        if (sendTimes.empty()) return;
+        sentAt = sendTimes.front();
+        sendTimes.pop_front();
+    }
+    if (mgmtObject)
+        mgmtObject->set_mcastLatency(sys::Duration(sentAt, sys::AbsTime::now()));
+}
+
+void Multicaster::sent(size_t bytes, size_t events) {
+    if (mgmtObject) {
+        mgmtObject->inc_mcastBytesSent(bytes);
+        mgmtObject->inc_mcastMessages();
+        mgmtObject->inc_mcastEvents(events);
+    }
+    Callbacks ready;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        queuedBytes -= bytes;
+        if (uncongested.empty() || queuedBytes > queueMax/2) return;
+        ready.swap(uncongested);
+    }
+    for (Callbacks::iterator i = ready.begin(); i != ready.end(); ++i)
+        (*i)();
+}
+
+void Multicaster::whenUncongested(const boost::function<void()>& f) {
+    {
+        sys::Mutex::ScopedLock l(lock);
+        if (queueMax && queuedBytes > queueMax) {
+            uncongested.push_back(f);
+            return;
+        }
+    }
+    f();
+}
+
 void Multicaster::start() {
     queue.start();
     bypass = false;
@@ -26,8 +26,12 @@
 #include "qpid/cluster/Event.h"
 #include "qpid/sys/PollableQueue.h"
 #include "qpid/sys/Mutex.h"
+#include "qpid/sys/Timer.h"
+#include "qmf/org/apache/qpid/cluster/Cluster.h"
 #include <boost/shared_ptr.hpp>
 #include <deque>
+#include <memory>
+#include <vector>
 
 namespace qpid {
 
@@ -38,6 +42,7 @@ class Poller;
 namespace cluster {
 
 class Cpg;
+struct ClusterSettings;
 
 /**
  * Multicast to the cluster. Shared, thread safe object.
@@ -53,6 +58,14 @@ class Cpg;
  *
  * Multicaster is created in bypass+holding mode, they are disabled by
  * start and setReady respectively.
+ *
+ * Queued events are packed into CPG messages of up to
+ * cluster-mcast-max-bytes. With cluster-mcast-delay a final message
+ * that is not full is held back for up to that long, in case more
+ * events arrive to fill it.
+ *
+ * Client data of at least cluster-compress-min bytes is deflated
+ * before it is queued.
  */
 class Multicaster
 {
@@ -60,7 +73,8 @@ class Multicaster
     /** Starts in initializing mode. */
     Multicaster(Cpg& cpg_,
                 const boost::shared_ptr<sys::Poller>&,
-                boost::function<void()> onError
+                boost::function<void()> onError,
+                const ClusterSettings&
     );
     void mcastControl(const framing::AMQBody& controlBody, const ConnectionId&);
     void mcastControl(const framing::AMQFrame& controlFrame, const ConnectionId&);
@@ -72,11 +86,29 @@ class Multicaster
     /** Switch to ready mode, release held messages. */
     void setReady();
 
+    /**
+     * Call f now, or, if more than cluster-mcast-queue-max bytes are
+     * waiting to be multicast, once half of them have been sent.
+     */
+    void whenUncongested(const boost::function<void()>& f);
+
+    /** Called in the CPG deliver thread for each message this member sent. */
+    void delivered();
+
+    /** Count multicast traffic and its delay. */
+    void setManagementObject(qmf::org::apache::qpid::cluster::Cluster* m) { mgmtObject = m; }
+
   private:
     typedef sys::PollableQueue<Event> PollableEventQueue;
     typedef std::deque<Event> PlainEventQueue;
+    typedef std::vector<boost::function<void()> > Callbacks;
+    class FlushTask;
 
     PollableEventQueue::Batch::const_iterator sendMcast(const PollableEventQueue::Batch& );
+    bool hold();
+    void flush(uint32_t held);
+    void sent(size_t bytes, size_t events);
+    bool send(const iovec*, int);
 
     sys::Mutex lock;
     boost::function<void()> onError;
@@ -86,6 +118,18 @@ class Multicaster
     PlainEventQueue holdingQueue;
     std::vector<struct ::iovec> ioVector;
     bool bypass;
+    const sys::Duration maxDelay;
+    const size_t maxBytes;
+    const size_t queueMax;
+    const size_t compressMin;
+    size_t queuedBytes;         // pushed onto queue and not yet sent
+    bool holding;               // queue stopped to fill a message
+    bool flushing;              // send the next message even if not full
+    uint32_t holds;             // identifies the current hold
+    Callbacks uncongested;
+    std::deque<sys::AbsTime> sendTimes; // messages not yet delivered back
+    std::auto_ptr<sys::Timer> timer;
+    qmf::org::apache::qpid::cluster::Cluster* mgmtObject;
 };
 }} // namespace qpid::cluster
 
@@ -601,7 +601,7 @@ class TxOpUpdater : public broker::TxOpConstVisitor, public MessageUpdater {
         proxy.txAccept(txAccept.getAcked());
     }
 
-    typedef std::list<Queue::shared_ptr> QueueList;
+    typedef std::vector<Queue::shared_ptr> QueueList;
 
     void copy(const QueueList& l, Array& a) {
         for (QueueList::const_iterator i = l.begin(); i!=l.end(); ++i)
@@ -65,6 +65,17 @@ class ExpiryPolicy;
 
 /**
  * A client that updates the contents of a local broker to a remote one using AMQP.
+ *
+ * The update is a snapshot: the updater and updatee stop delivering
+ * cluster events at the update offer, and the updater sends its whole
+ * state from this thread. Other members carry on. Events delivered
+ * meanwhile are queued on both brokers and replayed once the update
+ * is done, so the updater's own clients wait for the full copy. An
+ * incremental snapshot would need the updater to keep delivering while
+ * it copies. Queues, sessions and delivery records then change under
+ * the copy, and the updatee would have to tell which replayed events
+ * the copy already reflects. The update protocol carries no position
+ * to do that, so the copy is taken with delivery stalled.
  */
 class UpdateClient : public sys::Runnable {
   public:
@@ -92,6 +92,11 @@ void Object::AttributeMap::addMap(const string& key, const FieldTable& val)
 
 Object::Object(Broker* b, SchemaClass* s, framing::Buffer& buffer, bool prop, bool stat) :
     broker(b), schema(s), pendingMethod(0)
+{
+    update(buffer, prop, stat);
+}
+
+void Object::update(framing::Buffer& buffer, bool prop, bool stat)
 {
     currentTime = buffer.getLongLong();
     createTime = buffer.getLongLong();
@@ -147,9 +152,14 @@ string Object::getIndex() const
     return result;
 }
 
-void Object::mergeUpdate(const Object& /*updated*/)
+void Object::mergeUpdate(const Object& updated)
 {
-    // TODO
+    currentTime = updated.currentTime;
+    createTime = updated.createTime;
+    deleteTime = updated.deleteTime;
+    for (AttributeMap::const_iterator iter = updated.attributes.begin();
+         iter != updated.attributes.end(); iter++)
+        attributes[iter->first] = iter->second;
 }
 
 void Object::invokeMethod(const string name, const AttributeMap& args, MethodResponse& result)
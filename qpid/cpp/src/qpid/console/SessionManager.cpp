@@ -69,14 +69,17 @@ Broker* SessionManager::addBroker(client::ConnectionSettings& settings)
 
 void SessionManager::delBroker(Broker* broker)
 {
-    Mutex::ScopedLock l(brokerListLock);
-    for (vector<Broker*>::iterator iter = brokers.begin();
-         iter != brokers.end(); iter++)
-        if (*iter == broker) {
-            brokers.erase(iter);
-            delete broker;
+    {
+        Mutex::ScopedLock l(brokerListLock);
+        vector<Broker*>::iterator iter = brokers.begin();
+        while (iter != brokers.end() && *iter != broker)
+            iter++;
+        if (iter == brokers.end())
             return;
-        }
+        brokers.erase(iter);
+        delete broker;
+    }
+    uncacheBroker(broker);
 }
 
 void SessionManager::getPackages(NameVector& packageNames)
@@ -480,25 +483,88 @@ void SessionManager::handleContentInd(Broker* broker, Buffer& buffer, uint32_t s
             return;
     }
 
-    Object object(broker, schemaClass, buffer, prop, stat);
+    boost::shared_ptr<Object> object;
+    if (settings.cacheObjects)
+        object = cacheUpdate(broker, schemaClass, buffer, prop, stat);
+    else
+        object.reset(new Object(broker, schemaClass, buffer, prop, stat));
 
     if (prop && className == "agent" && packageName == "org.apache.qpid.broker")
-        broker->updateAgent(object);
+        broker->updateAgent(*object);
 
     {
         Mutex::ScopedLock l(lock);
         if (syncSequenceList.count(sequence) == 1) {
-            if (!object.isDeleted())
-                getResult.push_back(object);
+            if (!object->isDeleted())
+                getResult.push_back(*object);
             return;
         }
     }
 
     if (listener) {
         if (prop)
-            listener->objectProps(*broker, object);
+            listener->objectProps(*broker, *object);
         if (stat)
-            listener->objectStats(*broker, object);
+            listener->objectStats(*broker, *object);
+    }
+
+    if (settings.cacheObjects && object->isDeleted())
+        uncacheObject(broker, object->getObjectId());
+}
+
+boost::shared_ptr<Object> SessionManager::cacheUpdate(Broker* broker, SchemaClass* schemaClass,
+                                                      Buffer& buffer, bool prop, bool stat)
+{
+    // The object's id follows its three timestamps
+    buffer.record();
+    buffer.getLongLong();
+    buffer.getLongLong();
+    buffer.getLongLong();
+    CacheKey key(broker, ObjectId(buffer));
+    buffer.restore();
+
+    Mutex::ScopedLock l(cacheLock);
+    ObjectCache::iterator iter = objectCache.find(key);
+    if (iter != objectCache.end() && iter->second.object->getSchema() == schemaClass) {
+        iter->second.object->update(buffer, prop, stat);
+        cacheAge.splice(cacheAge.end(), cacheAge, iter->second.age);
+        return iter->second.object;
+    }
+
+    boost::shared_ptr<Object> object(new Object(broker, schemaClass, buffer, prop, stat));
+    if (iter != objectCache.end()) {
+        // Its class has changed, so nothing held for it still applies
+        iter->second.object = object;
+        cacheAge.splice(cacheAge.end(), cacheAge, iter->second.age);
+        return object;
+    }
+    if (settings.maxCachedObjects != 0 && objectCache.size() >= settings.maxCachedObjects) {
+        objectCache.erase(cacheAge.front());
+        cacheAge.pop_front();
+    }
+    CachedObject& cached(objectCache[key]);
+    cached.object = object;
+    cached.age = cacheAge.insert(cacheAge.end(), key);
+    return object;
+}
+
+void SessionManager::uncacheObject(Broker* broker, const ObjectId& objectId)
+{
+    Mutex::ScopedLock l(cacheLock);
+    ObjectCache::iterator iter = objectCache.find(CacheKey(broker, objectId));
+    if (iter != objectCache.end()) {
+        cacheAge.erase(iter->second.age);
+        objectCache.erase(iter);
+    }
+}
+
+void SessionManager::uncacheBroker(Broker* broker)
+{
+    Mutex::ScopedLock l(cacheLock);
+    ObjectCache::iterator iter = objectCache.lower_bound(CacheKey(broker, ObjectId()));
+    while (iter != objectCache.end() && iter->first.first == broker) {
+        cacheAge.erase(iter->second.age);
+        objectCache.erase(iter++);
     }
 }
 
@@ -23,6 +23,7 @@
  */
 #include "qpid/framing/amqp_types.h"
 #include "qpid/RefCounted.h"
+#include "qpid/MemoryPool.h"
 #include "qpid/framing/BodyFactory.h"
 #include <boost/intrusive_ptr.hpp>
 #include <ostream>
@@ -46,7 +47,7 @@ struct AMQBodyConstVisitor {
     virtual void visit(const AMQMethodBody&) = 0;
 };
 
-class QPID_COMMON_CLASS_EXTERN AMQBody : public RefCounted {
+class QPID_COMMON_CLASS_EXTERN AMQBody : public RefCounted, public PoolAllocated {
   public:
     AMQBody() {}
     QPID_COMMON_EXTERN virtual ~AMQBody();
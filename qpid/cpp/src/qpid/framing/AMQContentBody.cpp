@@ -20,20 +20,73 @@
  */
 #include "qpid/framing/AMQContentBody.h"
 #include <iostream>
+#include <algorithm>
+#include <assert.h>
 
-qpid::framing::AMQContentBody::AMQContentBody(){
+namespace {
+const uint32_t NONE = 0;
+const uint32_t COPYING = 1;
+const uint32_t COPIED = 2;
 }
 
-qpid::framing::AMQContentBody::AMQContentBody(const string& _data) : data(_data){
+qpid::framing::AMQContentBody::AMQContentBody() : materialized(NONE){
+}
+
+qpid::framing::AMQContentBody::AMQContentBody(const string& _data) : data(_data), materialized(NONE){
+}
+
+qpid::framing::AMQContentBody::AMQContentBody(const ConstBufferRef& _ref) : ref(_ref), materialized(NONE){
+}
+
+qpid::framing::AMQContentBody::AMQContentBody(const AMQContentBody& body)
+    : AMQBody(body), ref(body.ref), materialized(NONE){
+    if (!ref.begin()) data = body.data;
+}
+
+// Bodies that share content are read from several threads. The first
+// to want a string copy makes it; any other waits the short time that
+// takes rather than every body sharing one lock.
+const qpid::framing::string& qpid::framing::AMQContentBody::materialize() const{
+    if (materialized.get() != COPIED) {
+        if (materialized.boolCompareAndSwap(NONE, COPYING)) {
+            data.assign(ref.begin(), ref.end());
+            materialized.boolCompareAndSwap(COPYING, COPIED);
+        } else {
+            while (materialized.get() != COPIED) ;
+        }
+    }
+    return data;
+}
+
+qpid::framing::string& qpid::framing::AMQContentBody::getData(){
+    if (ref.begin()) {
+        materialize();
+        ref = ConstBufferRef();
+        materialized = NONE;
+    }
+    return data;
+}
+
+qpid::ConstBufferRef qpid::framing::AMQContentBody::slice(uint32_t offset, uint32_t size) const{
+    const char* start = ref.begin() ? ref.begin() : data.data();
+    assert(offset + size <= encodedSize());
+    return ConstBufferRef(boost::intrusive_ptr<RefCounted>(const_cast<AMQContentBody*>(this)),
+                          start + offset, start + offset + size);
 }
 
 uint32_t qpid::framing::AMQContentBody::encodedSize() const{
-    return data.size();
+    return ref.begin() ? ref.end() - ref.begin() : data.size();
 }
 void qpid::framing::AMQContentBody::encode(Buffer& buffer) const{
-    buffer.putRawData(data);
+    if (ref.begin()) {
+        buffer.putRawData(reinterpret_cast<const uint8_t*>(ref.begin()), ref.end() - ref.begin());
+    } else {
+        buffer.putRawData(data);
+    }
 }
 void qpid::framing::AMQContentBody::decode(Buffer& buffer, uint32_t _size){
+    ref = ConstBufferRef();
+    materialized = NONE;
     buffer.getRawData(data, _size);
 }
 
@@ -41,6 +94,10 @@ void qpid::framing::AMQContentBody::print(std::ostream& out) const
 {
     out << "content (" << encodedSize() << " bytes)";
     const size_t max = 32;
-    out << " " << data.substr(0, max);
-    if (data.size() > max) out << "...";
+    if (ref.begin()) {
+        out << " " << string(ref.begin(), std::min(ref.end(), ref.begin() + max));
+    } else {
+        out << " " << data.substr(0, max);
+    }
+    if (encodedSize() > max) out << "...";
 }
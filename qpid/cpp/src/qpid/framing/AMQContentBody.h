@@ -21,6 +21,8 @@
 #include "qpid/framing/amqp_types.h"
 #include "qpid/framing/AMQBody.h"
 #include "qpid/framing/Buffer.h"
+#include "qpid/BufferRef.h"
+#include "qpid/sys/AtomicValue.h"
 #include "qpid/CommonImportExport.h"
 
 #ifndef _AMQContentBody_
@@ -31,15 +33,34 @@ namespace framing {
 
 class QPID_COMMON_CLASS_EXTERN AMQContentBody :  public AMQBody
 {
-    string data;
+    mutable string data;
+    /** If set, the content is held by another refcounted body and
+     * data is only populated, once, if getData() is called. */
+    ConstBufferRef ref;
+    /** Whether data holds the copy: NONE, COPYING or COPIED */
+    mutable sys::AtomicValue<uint32_t> materialized;
+
+    QPID_COMMON_EXTERN const string& materialize() const;
 
 public:
     QPID_COMMON_EXTERN AMQContentBody();
     QPID_COMMON_EXTERN AMQContentBody(const string& data);
+    /** Create a body that shares, rather than copies, its content */
+    QPID_COMMON_EXTERN AMQContentBody(const ConstBufferRef& ref);
+    /** A copy of a body that shares its content shares it too */
+    QPID_COMMON_EXTERN AMQContentBody(const AMQContentBody& body);
     inline virtual ~AMQContentBody(){}
     inline uint8_t type() const { return CONTENT_BODY; };
-    inline const string& getData() const { return data; }
-    inline string& getData() { return data; }
+    /** Safe to call from several threads at once, as encode() is */
+    inline const string& getData() const { return ref.begin() ? materialize() : data; }
+    /** Stops sharing the content, as the caller may modify it */
+    QPID_COMMON_EXTERN string& getData();
+    /**
+     * Return a reference to size bytes of this body's content
+     * starting at offset, which keeps this body alive. The content
+     * must not be modified while references are held.
+     */
+    QPID_COMMON_EXTERN ConstBufferRef slice(uint32_t offset, uint32_t size) const;
     QPID_COMMON_EXTERN uint32_t encodedSize() const;
     QPID_COMMON_EXTERN void encode(Buffer& buffer) const;
     QPID_COMMON_EXTERN void decode(Buffer& buffer, uint32_t size);
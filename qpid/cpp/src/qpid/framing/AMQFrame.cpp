@@ -25,6 +25,7 @@
 #include "qpid/framing/BodyFactory.h"
 #include "qpid/framing/MethodBodyFactory.h"
 #include "qpid/Msg.h"
+#include "qpid/sys/AllocationCounts.h"
 
 #include <boost/format.hpp>
 #include <iostream>
@@ -82,7 +83,18 @@ void AMQFrame::encode(Buffer& buffer) const
 }
 
 bool AMQFrame::decode(Buffer& buffer)
+{
+    return decode(buffer, 0);
+}
+
+bool AMQFrame::decode(Buffer& buffer, const ConstBufferRef& shared)
+{
+    return decode(buffer, &shared);
+}
+
+bool AMQFrame::decode(Buffer& buffer, const ConstBufferRef* shared)
 {    
+    QPID_ALLOCATION_SITE(framing);
     if(buffer.available() < frameOverhead())
         return false;
     buffer.record();
@@ -129,7 +141,16 @@ bool AMQFrame::decode(Buffer& buffer)
           break;
       }
       case HEADER_BODY: body =  BodyFactory::create<AMQHeaderBody>(); break;
-      case CONTENT_BODY: body = BodyFactory::create<AMQContentBody>(); break;
+      case CONTENT_BODY:
+        if (shared && 2 * size_t(body_size) >= size_t(shared->end() - shared->begin())) {
+            const char* start = buffer.getPointer() + buffer.getPosition();
+            ConstBufferRef content(*shared);
+            body = new AMQContentBody(content.sub_buffer(start, start + body_size));
+            buffer.setPosition(buffer.getPosition() + body_size);
+            return true;
+        }
+        body = BodyFactory::create<AMQContentBody>();
+        break;
       case HEARTBEAT_BODY: body = BodyFactory::create<AMQHeartbeatBody>(); break;
       default:
 	throw IllegalArgumentException(QPID_MSG("Invalid frame type " << type));
@@ -66,6 +66,13 @@ class QPID_COMMON_CLASS_EXTERN AMQFrame : public AMQDataBlock
 
     QPID_COMMON_EXTERN void encode(Buffer& buffer) const; 
     QPID_COMMON_EXTERN bool decode(Buffer& buffer); 
+    /**
+     * Decode as above from a buffer whose bytes are held by shared.
+     * A content body of at least half the size of shared refers to
+     * its bytes there instead of copying them. Smaller ones are
+     * copied so they do not keep a much larger buffer alive.
+     */
+    QPID_COMMON_EXTERN bool decode(Buffer& buffer, const ConstBufferRef& shared);
     QPID_COMMON_EXTERN uint32_t encodedSize() const;
 
     // 0-10 terminology: first/last frame (in segment) first/last segment (in assembly)
@@ -99,6 +106,7 @@ class QPID_COMMON_CLASS_EXTERN AMQFrame : public AMQDataBlock
 
   private:
     void init();
+    bool decode(Buffer& buffer, const ConstBufferRef* shared);
 
     boost::intrusive_ptr<AMQBody> body;
     uint16_t channel : 16;
@@ -23,14 +23,33 @@
 #include "qpid/log/Statement.h"
 
 uint32_t qpid::framing::AMQHeaderBody::encodedSize() const {
-    return properties.encodedSize();
+    if (!encodedMessageProperties) return properties.encodedSize();
+    const DeliveryProperties* dp = get<DeliveryProperties>();
+    return encodedMessageProperties->size() + (dp ? dp->encodedSize() : 0);
 }
 
 void qpid::framing::AMQHeaderBody::encode(Buffer& buffer) const {
-    properties.encode(buffer);
+    if (!encodedMessageProperties) {
+        properties.encode(buffer);
+        return;
+    }
+    // Same order as Properties::encode()
+    buffer.putRawData(*encodedMessageProperties);
+    const DeliveryProperties* dp = get<DeliveryProperties>();
+    if (dp) dp->encode(buffer);
+}
+
+void qpid::framing::AMQHeaderBody::cacheEncoding() const {
+    const MessageProperties* mp = get<MessageProperties>();
+    if (encodedMessageProperties || !mp) return;
+    std::string* encoded = new std::string(mp->encodedSize(), '\0');
+    encodedMessageProperties.reset(encoded);
+    Buffer buffer(&(*encoded)[0], encoded->size());
+    mp->encode(buffer);
 }
 
 void qpid::framing::AMQHeaderBody::decode(Buffer& buffer, uint32_t size) {
+    encodedMessageProperties.reset();
     uint32_t limit = buffer.available() - size;
     while (buffer.available() > limit + 2) {
         uint32_t len = buffer.getLong();
@@ -28,8 +28,10 @@
 #include "qpid/framing/MessageProperties.h"
 #include "qpid/CommonImportExport.h"
 #include <iostream>
+#include <string>
 
 #include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
 
 
 namespace qpid {
@@ -78,6 +80,15 @@ class QPID_COMMON_CLASS_EXTERN AMQHeaderBody :  public AMQBody
 
     Properties properties;
 
+    // Encoded message properties, shared with copies of this body
+    // until either modifies them.
+    mutable boost::shared_ptr<const std::string> encodedMessageProperties;
+
+    // Delivery properties are encoded afresh each time, everything
+    // else invalidates the cached encoding when modified.
+    void modified(const DeliveryProperties*) {}
+    template <class T> void modified(const T*) { encodedMessageProperties.reset(); }
+
 public:
 
     inline uint8_t type() const { return HEADER_BODY; }
@@ -89,7 +100,16 @@ public:
     QPID_COMMON_EXTERN void print(std::ostream& out) const;
     QPID_COMMON_EXTERN void accept(AMQBodyConstVisitor&) const;
 
+    /**
+     * Keep the encoded message properties so that encoding this body,
+     * and copies of it that only modify the delivery properties, just
+     * copies them. Call it before the body is shared with other
+     * threads: encode() and encodedSize() read the cache unlocked.
+     */
+    QPID_COMMON_EXTERN void cacheEncoding() const;
+
     template <class T> T* get(bool create) {
+        modified(static_cast<T*>(0));
         boost::optional<T>& p=properties.OptProps<T>::props;
         if (create && !p) p=T();
         return p.get_ptr();
@@ -100,6 +120,7 @@ public:
     }
 
     template <class T> void erase() {
+        modified(static_cast<T*>(0));
         properties.OptProps<T>::props.reset();
     }
 
@@ -50,27 +50,6 @@ void Buffer::reset(){
 
 ///////////////////////////////////////////////////
 
-void Buffer::putOctet(uint8_t i){
-    data[position++] = i;
-    assert(position <= size);
-}
-
-void Buffer::putShort(uint16_t i){
-    uint16_t b = i;
-    data[position++] = (uint8_t) (0xFF & (b >> 8));
-    data[position++] = (uint8_t) (0xFF & b);
-    assert(position <= size);
-}
-
-void Buffer::putLong(uint32_t i){
-    uint32_t b = i;
-    data[position++] = (uint8_t) (0xFF & (b >> 24));
-    data[position++] = (uint8_t) (0xFF & (b >> 16));
-    data[position++] = (uint8_t) (0xFF & (b >> 8));
-    data[position++] = (uint8_t) (0xFF & b);
-    assert(position <= size);
-}
-
 void Buffer::putLongLong(uint64_t i){
     uint32_t hi = i >> 32;
     uint32_t lo = i;
@@ -120,33 +99,6 @@ void Buffer::putBin128(const uint8_t* b){
     position += 16;
 }
 
-uint8_t Buffer::getOctet(){ 
-    uint8_t octet = static_cast<uint8_t>(data[position++]);
-    assert(position <= size);
-    return octet;
-}
-
-uint16_t Buffer::getShort(){ 
-    uint16_t hi = (unsigned char) data[position++];
-    hi = hi << 8;
-    hi |= (unsigned char) data[position++];
-    assert(position <= size);
-    return hi;
-}
-
-uint32_t Buffer::getLong(){ 
-    uint32_t a = (unsigned char) data[position++];
-    uint32_t b = (unsigned char) data[position++];
-    uint32_t c = (unsigned char) data[position++];
-    uint32_t d = (unsigned char) data[position++];
-    assert(position <= size);
-    a = a << 24;
-    a |= b << 16;
-    a |= c << 8;
-    a |= d;
-    return a;
-}
-
 uint64_t Buffer::getLongLong(){
     uint64_t hi = getLong();
     uint64_t lo = getLong();
@@ -22,6 +22,7 @@
 #include "qpid/framing/Buffer.h"
 #include "qpid/log/Statement.h"
 #include "qpid/framing/reply_exceptions.h"
+#include "qpid/sys/Probe.h"
 #include <algorithm>
 #include <string.h>
 
@@ -41,30 +42,45 @@ void append(std::vector<char>& bytes, Buffer& buffer, size_t n) {
 }
 
 bool FrameDecoder::decode(Buffer& buffer) {
+    return decode(buffer, 0);
+}
+
+bool FrameDecoder::decode(Buffer& buffer, const ConstBufferRef& shared) {
+    return decode(buffer, &shared);
+}
+
+bool FrameDecoder::decode(Buffer& buffer, const ConstBufferRef* shared) {
     if (buffer.available() == 0) return false;
     if (fragment.empty()) {
-        if (frame.decode(buffer)) // Decode from buffer
+        // Decode in place from buffer
+        if (shared ? frame.decode(buffer, *shared) : frame.decode(buffer)) {
+            QPID_PROBE(frame_decoded, this, frame.encodedSize());
             return true;
-        else                    // Store fragment
-            append(fragment, buffer, buffer.available());
-        }
-    else {                      // Already have a fragment
-        // Get enough data to decode the frame size.
-        if (fragment.size() < AMQFrame::DECODE_SIZE_MIN) {
-            append(fragment, buffer, AMQFrame::DECODE_SIZE_MIN - fragment.size());
-        }
-        if (fragment.size() >= AMQFrame::DECODE_SIZE_MIN) {
-            uint16_t size = AMQFrame::decodeSize(&fragment[0]);
-            if (size <= fragment.size())
-                throw FramingErrorException(QPID_MSG("Frame size " << size << " is too small."));
-            append(fragment, buffer, size-fragment.size());
-            Buffer b(&fragment[0], fragment.size());
-            if (frame.decode(b)) {
-                assert(b.available() == 0);
-                fragment.clear();
-                return true;
-            }
         }
+        // Store fragment. If the frame header is here, make room for
+        // the whole frame so the fragment is grown only once.
+        if (buffer.available() >= AMQFrame::DECODE_SIZE_MIN)
+            fragment.reserve(AMQFrame::decodeSize(buffer.getPointer() + buffer.getPosition()));
+        append(fragment, buffer, buffer.available());
+        return false;
+    }
+    // Already have a fragment, get enough data to decode the frame size.
+    if (fragment.size() < AMQFrame::DECODE_SIZE_MIN) {
+        append(fragment, buffer, AMQFrame::DECODE_SIZE_MIN - fragment.size());
+        if (fragment.size() < AMQFrame::DECODE_SIZE_MIN) return false;
+    }
+    uint16_t size = AMQFrame::decodeSize(&fragment[0]);
+    if (size <= fragment.size())
+        throw FramingErrorException(QPID_MSG("Frame size " << size << " is too small."));
+    fragment.reserve(size);
+    append(fragment, buffer, size-fragment.size());
+    if (fragment.size() < size) return false;
+    Buffer b(&fragment[0], fragment.size());
+    if (frame.decode(b)) {
+        assert(b.available() == 0);
+        fragment.clear();
+        QPID_PROBE(frame_decoded, this, frame.encodedSize());
+        return true;
     }
     return false;
 }
@@ -36,6 +36,12 @@ class FrameDecoder
 {
   public:
     QPID_COMMON_EXTERN bool decode(Buffer& buffer);
+    /**
+     * Decode as above from a buffer whose bytes are held by shared.
+     * Content in a frame that is not split across calls may refer to
+     * shared rather than be copied, see AMQFrame::decode.
+     */
+    QPID_COMMON_EXTERN bool decode(Buffer& buffer, const ConstBufferRef& shared);
     const AMQFrame& getFrame() const { return frame; }
     AMQFrame& getFrame() { return frame; }
 
@@ -43,6 +49,8 @@ class FrameDecoder
     std::pair<const char*, size_t> getFragment() const;
 
   private:
+    bool decode(Buffer& buffer, const ConstBufferRef* shared);
+
     std::vector<char> fragment;
     AMQFrame frame;
 
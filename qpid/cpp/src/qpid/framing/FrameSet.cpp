@@ -89,6 +89,12 @@ uint64_t FrameSet::getContentSize() const
 	return contentSize;
 }
 
+void FrameSet::setContentSize(uint64_t size)
+{
+    contentSize = size;
+    recalculateSize = false;
+}
+
 void FrameSet::getContent(std::string& out) const {
     out.clear();
     out.reserve(getContentSize());
@@ -98,6 +104,17 @@ void FrameSet::getContent(std::string& out) const {
     }
 }
 
+qpid::ConstBufferRef FrameSet::getContentRef() const {
+    const AMQContentBody* body = 0;
+    for(Frames::const_iterator i = parts.begin(); i != parts.end(); i++) {
+        if (i->getBody()->type() == CONTENT_BODY) {
+            if (body) return ConstBufferRef();
+            body = i->castBody<AMQContentBody>();
+        }
+    }
+    return body ? body->slice(0, body->encodedSize()) : ConstBufferRef();
+}
+
 std::string FrameSet::getContent() const {
     std::string out;
     getContent(out);
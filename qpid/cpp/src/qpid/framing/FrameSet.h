@@ -23,6 +23,7 @@
 #include "qpid/framing/amqp_framing.h"
 #include "qpid/framing/AMQFrame.h"
 #include "qpid/framing/SequenceNumber.h"
+#include "qpid/BufferRef.h"
 #include "qpid/CommonImportExport.h"
 
 #ifndef _FrameSet_
@@ -51,9 +52,17 @@ public:
     QPID_COMMON_EXTERN bool isComplete() const;
 
     QPID_COMMON_EXTERN uint64_t getContentSize() const;
+    /** Record the size of content that is held outside the frames */
+    QPID_COMMON_EXTERN void setContentSize(uint64_t size);
 
     QPID_COMMON_EXTERN void getContent(std::string&) const;
     QPID_COMMON_EXTERN std::string getContent() const;
+    /**
+     * If the content is held in a single frame, return a reference
+     * that shares that frame's body instead of copying it. Otherwise
+     * return an empty reference and the caller must use getContent().
+     */
+    QPID_COMMON_EXTERN ConstBufferRef getContentRef() const;
 
     bool isContentBearing() const;
 
@@ -23,6 +23,7 @@
 
 #include <string>
 #include "qpid/framing/AMQHeaderBody.h"
+#include "qpid/BufferRef.h"
 
 namespace qpid {
 namespace framing {
@@ -34,6 +35,8 @@ public:
     //TODO: rethink this interface
     virtual AMQHeaderBody getHeader() const = 0;
     virtual const std::string& getData() const = 0;
+    /** Shared content, if any; when set it is sent in place of getData() */
+    virtual ConstBufferRef getDataRef() const { return ConstBufferRef(); }
 };
 
 }}
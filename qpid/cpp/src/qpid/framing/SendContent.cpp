@@ -51,7 +51,8 @@ void qpid::framing::SendContent::operator()(const AMQFrame& f)
 
 void qpid::framing::SendContent::sendFragment(const AMQContentBody& body, uint32_t offset, uint16_t size, bool first, bool last) const
 {
-    AMQFrame fragment((AMQContentBody(body.getData().substr(offset, size))));
+    // The fragment references the original body rather than copying it
+    AMQFrame fragment(boost::intrusive_ptr<AMQBody>(new AMQContentBody(body.slice(offset, size))));
     setFlags(fragment, first, last);
     handler.handle(fragment);
 }
@@ -35,23 +35,42 @@ AMQHeaderBody TransferContent::getHeader() const
     return header;
 }
 
+void TransferContent::materialize() const {
+    data.assign(ref.begin(), ref.end());
+    ref = ConstBufferRef();
+}
+
 const std::string& TransferContent::getData() const {
+    if (ref.begin()) materialize();
     return data;
 }
 
 std::string& TransferContent::getData() {
+    if (ref.begin()) materialize();
     return data;
 }
 
+ConstBufferRef TransferContent::getDataRef() const {
+    return ref;
+}
+
 void TransferContent::setData(const std::string& _data)
 {
+    ref = ConstBufferRef();
     data = _data;
     header.get<MessageProperties>(true)->setContentLength(data.size());
 }
 
+void TransferContent::setData(const ConstBufferRef& _ref)
+{
+    ref = _ref;
+    data.clear();
+    header.get<MessageProperties>(true)->setContentLength(ref.end() - ref.begin());
+}
+
 void TransferContent::appendData(const std::string& _data)
 {
-    data += _data;
+    getData() += _data;
     header.get<MessageProperties>(true)->setContentLength(data.size());
 }
 
@@ -71,6 +90,7 @@ void TransferContent::populate(const FrameSet& frameset)
     if (h) {
         header = *h;
     }
+    ref = ConstBufferRef();
     frameset.getContent(data);
 }
 
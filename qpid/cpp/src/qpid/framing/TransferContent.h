@@ -35,7 +35,12 @@ namespace framing {
 class QPID_COMMON_CLASS_EXTERN TransferContent : public MethodContent
 {
     AMQHeaderBody header;
-    std::string data;
+    mutable std::string data;
+    /** If set, the content is shared with another refcounted
+     * buffer and data is only populated if getData() is called. */
+    mutable ConstBufferRef ref;
+
+    void materialize() const;
 public:
     QPID_COMMON_EXTERN	TransferContent(const std::string& data = std::string(), const std::string& key=std::string());
 
@@ -43,6 +48,10 @@ public:
     QPID_COMMON_EXTERN AMQHeaderBody getHeader() const;
 
     QPID_COMMON_EXTERN void setData(const std::string&);
+    /** Share, rather than copy, the content. It must not be modified
+     * while this reference is held. */
+    QPID_COMMON_EXTERN void setData(const ConstBufferRef&);
+    QPID_COMMON_EXTERN ConstBufferRef getDataRef() const;
     QPID_COMMON_EXTERN const std::string& getData() const;
     QPID_COMMON_EXTERN std::string& getData();
 
@@ -19,6 +19,7 @@
 #include "qpid/framing/Uuid.h"
 
 #include "qpid/sys/uuid.h"
+#include "qpid/sys/UuidGenerator.h"
 #include "qpid/Exception.h"
 #include "qpid/framing/Buffer.h"
 #include "qpid/framing/reply_exceptions.h"
@@ -50,7 +51,7 @@ void Uuid::assign(const uint8_t* data) {
 }
 
 void Uuid::generate() {
-    uuid_generate(c_array());
+    sys::UuidGenerator::generate(c_array());
 }
 
 void Uuid::clear() {
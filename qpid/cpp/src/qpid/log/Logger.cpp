@@ -20,6 +20,7 @@
 #include "qpid/log/Options.h"
 #include "qpid/log/SinkOptions.h"
 #include "qpid/memory.h"
+#include "qpid/sys/SystemInfo.h"
 #include "qpid/sys/Thread.h"
 #include "qpid/sys/Time.h"
 #include "qpid/DisableExceptionLogging.h"
@@ -42,13 +43,17 @@ typedef sys::Mutex::ScopedLock ScopedLock;
 
 inline void Logger::enable_unlocked(Statement* s) {
     s->enabled=selector.isEnabled(s->level, s->function);
+    s->objectEnabled=!s->enabled && objectSelector.isEnabled(s->level, s->function);
 }
 
 Logger& Logger::instance() {
     return boost::details::pool::singleton_default<Logger>::instance();
 }
 
-Logger::Logger() : flags(0) {
+Logger::Logger() :
+    flags(0), async(false), asyncLimit(0), asyncBlock(false), writer(*this),
+    writerPid(0), stopping(false), dropped(0), droppedReported(0)
+{
     // Disable automatic logging in Exception constructors to avoid
     // re-entrant use of logger singleton if there is an error in
     // option parsing.
@@ -62,7 +67,9 @@ Logger::Logger() : flags(0) {
     configure(opts);
 }
 
-Logger::~Logger() {}
+Logger::~Logger() {
+    stopWriter();
+}
 
 void Logger::select(const Selector& s) {
     ScopedLock l(lock);
@@ -71,6 +78,22 @@ void Logger::select(const Selector& s) {
                   boost::bind(&Logger::enable_unlocked, this, _1));
 }
 
+void Logger::selectObjects(const Selector& s, const std::vector<std::string>& names) {
+    ScopedLock l(lock);
+    {
+        ScopedLock o(objectLock);
+        objects = std::set<std::string>(names.begin(), names.end());
+    }
+    objectSelector = names.empty() ? Selector() : s;
+    std::for_each(statements.begin(), statements.end(),
+                  boost::bind(&Logger::enable_unlocked, this, _1));
+}
+
+bool Logger::isSelected(const std::string& object) {
+    ScopedLock l(objectLock);
+    return objects.find(object) != objects.end();
+}
+
 Logger::Output::Output()  {}
 Logger::Output::~Output() {}
 
@@ -99,6 +122,10 @@ void Logger::log(const Statement& s, const std::string& msg) {
         os << " ";
     os << msg << endl;
     std::string formatted=os.str();
+    if (async) {
+        enqueue(s, formatted);
+        return;
+    }
     {
         ScopedLock l(lock);
         std::for_each(outputs.begin(), outputs.end(),
@@ -106,6 +133,89 @@ void Logger::log(const Statement& s, const std::string& msg) {
     }
 }
 
+void Logger::enqueue(const Statement& s, const std::string& formatted) {
+    {
+        sys::Monitor::ScopedLock l(queueLock);
+        while (async) {
+            uint32_t pid = sys::SystemInfo::getProcessId();
+            if (writerPid != pid) {
+                if (writerPid) queued.clear(); // The parent's writer has these
+                writerPid = pid;
+                writerThread = sys::Thread(writer);
+            }
+            if (queued.size() < asyncLimit) {
+                queued.push_back(Queued(s, formatted));
+                if (queued.size() == 1) queueLock.notifyAll();
+                return;
+            }
+            if (!asyncBlock) {
+                ++dropped;
+                return;
+            }
+            queueLock.wait();
+        }
+    }
+    // The writer was stopped by configure() meanwhile.
+    ScopedLock l(lock);
+    std::for_each(outputs.begin(), outputs.end(),
+                  boost::bind(&Output::log, _1, s, formatted));
+}
+
+namespace {
+Statement droppedStatement = QPID_LOG_STATEMENT_INIT(warning);
+}
+
+void Logger::writeQueued() {
+    Queue batch;
+    sys::Monitor::ScopedLock l(queueLock);
+    for (;;) {
+        while (queued.empty() && !stopping) queueLock.wait();
+        if (queued.empty()) return;
+        batch.swap(queued);
+        queueLock.notifyAll();  // Room for blocked callers
+        uint64_t lost = dropped - droppedReported;
+        droppedReported = dropped;
+        {
+            sys::Monitor::ScopedUnlock u(queueLock);
+            {
+                ScopedLock o(lock);
+                for (Queue::const_iterator i = batch.begin(); i != batch.end(); ++i)
+                    std::for_each(outputs.begin(), outputs.end(),
+                                  boost::bind(&Output::log, _1, i->statement, i->text));
+            }
+            batch.clear();
+            if (lost) {
+                std::ostringstream msg;
+                msg << "Dropped " << lost << " log messages, log-async-limit reached";
+                log(droppedStatement, msg.str());
+            }
+        }
+    }
+}
+
+void Logger::stopWriter() {
+    sys::Thread t;
+    {
+        sys::Monitor::ScopedLock l(queueLock);
+        async = false;
+        // A writer started before fork() does not exist in this process.
+        if (writerPid == sys::SystemInfo::getProcessId()) t = writerThread;
+        writerThread = sys::Thread();
+        writerPid = 0;
+        if (!t) return;
+        stopping = true;
+        queueLock.notifyAll();
+    }
+    t.join();
+    sys::Monitor::ScopedLock l(queueLock);
+    stopping = false;
+}
+
+uint64_t Logger::getDropped() {
+    sys::Monitor::ScopedLock l(queueLock);
+    return dropped;
+}
+
 void Logger::output(std::auto_ptr<Output> out) {
     ScopedLock l(lock);
     outputs.push_back(out.release());
@@ -113,6 +223,7 @@ void Logger::output(std::auto_ptr<Output> out) {
 
 void Logger::clear() {
     select(Selector());         // locked
+    selectObjects(Selector(), std::vector<std::string>()); // locked
     format(0);                  // locked
     ScopedLock l(lock);
     outputs.clear();
@@ -146,6 +257,7 @@ void Logger::add(Statement& s) {
 }
 
 void Logger::configure(const Options& opts) {
+    stopWriter();               // Flushes queued records to the old outputs
     options = opts;
     clear();
     Options o(opts);
@@ -153,8 +265,18 @@ void Logger::configure(const Options& opts) {
         o.selectors.push_back("trace+");
     format(o);
     select(Selector(o));
+    Selector objectRules;
+    for (std::vector<std::string>::const_iterator i = o.objectSelectors.begin();
+         i != o.objectSelectors.end(); ++i)
+        objectRules.enable(*i);
+    if (o.objectSelectors.empty()) objectRules.enable("trace+");
+    selectObjects(objectRules, o.objects);
     setPrefix(opts.prefix);
     options.sinkOptions->setup(this);
+    sys::Monitor::ScopedLock l(queueLock);
+    asyncLimit = std::max(opts.asyncLimit, 1u);
+    asyncBlock = opts.asyncBlock;
+    async = opts.async;
 }
 
 void Logger::reconfigure(const std::vector<std::string>& selectors) {
@@ -40,6 +40,9 @@ Options::Options(const std::string& argv0_, const std::string& name_) :
     function(false),
     hiresTs(false),
     trace(false),
+    async(false),
+    asyncLimit(10000),
+    asyncBlock(false),
     sinkOptions (SinkOptions::create(argv0_))
 {
     selectors.push_back("notice+");
@@ -61,6 +64,14 @@ Options::Options(const std::string& argv0_, const std::string& name_) :
           "\t'--log-enable debug:framing' "
           "logs debug messages from the framing namespace. "
           "This option can be used multiple times").c_str())
+        ("log-object", optValue(objects, "NAME"),
+         "Enables the messages selected by --log-object-enable for the object "
+         "NAME only, e.g. a connection id or a queue name. "
+         "This option can be used multiple times")
+        ("log-object-enable", optValue(objectSelectors, "RULE"),
+         "Enables logging for selected levels and components, in the form of "
+         "--log-enable, for the objects named by --log-object only. "
+         "Defaults to 'trace+'. This option can be used multiple times")
         ("log-time", optValue(time, "yes|no"), "Include time in log messages")
         ("log-level", optValue(level,"yes|no"), "Include severity level in log messages")
         ("log-source", optValue(source,"yes|no"), "Include source file:line in log messages")
@@ -68,6 +79,9 @@ Options::Options(const std::string& argv0_, const std::string& name_) :
         ("log-function", optValue(function,"yes|no"), "Include function signature in log messages")
         ("log-hires-timestamp", optValue(hiresTs,"yes|no"), "Use unformatted hi-res timestamp in log messages")
         ("log-prefix", optValue(prefix,"STRING"), "Prefix to append to all log messages")
+        ("log-async", optValue(async,"yes|no"), "Write log messages from a background thread instead of the thread that logs them")
+        ("log-async-limit", optValue(asyncLimit,"N"), "Most log messages waiting for the background thread when log-async is enabled")
+        ("log-async-block", optValue(asyncBlock,"yes|no"), "When log-async-limit is reached, wait for the background thread rather than drop the message")
         ;
     add(*sinkOptions);
 }
@@ -77,6 +91,8 @@ Options::Options(const Options &o) :
     argv0(o.argv0),
     name(o.name),
     selectors(o.selectors),
+    objects(o.objects),
+    objectSelectors(o.objectSelectors),
     time(o.time),
     level(o.level),
     thread(o.thread),
@@ -85,6 +101,9 @@ Options::Options(const Options &o) :
     hiresTs(o.hiresTs),
     trace(o.trace),
     prefix(o.prefix),
+    async(o.async),
+    asyncLimit(o.asyncLimit),
+    asyncBlock(o.asyncBlock),
     sinkOptions (SinkOptions::create(o.argv0))
 {
     *sinkOptions = *o.sinkOptions;
@@ -95,6 +114,8 @@ Options& Options::operator=(const Options& x) {
         argv0 = x.argv0;
         name = x.name;
         selectors = x.selectors;
+        objects = x.objects;
+        objectSelectors = x.objectSelectors;
         time = x.time;
         level= x.level;
         thread = x.thread;
@@ -103,6 +124,9 @@ Options& Options::operator=(const Options& x) {
         hiresTs = x.hiresTs;
         trace = x.trace;
         prefix = x.prefix;
+        async = x.async;
+        asyncLimit = x.asyncLimit;
+        asyncBlock = x.asyncBlock;
         *sinkOptions = *x.sinkOptions;
     }
     return *this;
@@ -18,6 +18,7 @@
 
 #include "qpid/log/Statement.h"
 #include "qpid/log/Logger.h"
+#include "qpid/sys/AllocationCounts.h"
 #include <boost/bind.hpp>
 #include <stdexcept>
 #include <algorithm>
@@ -51,9 +52,14 @@ std::string quote(const std::string& str) {
 }
 
 void Statement::log(const std::string& message) {
+    QPID_ALLOCATION_SITE(logging);
     Logger::instance().log(*this, quote(message));
 }
 
+bool Statement::isSelected(const std::string& object) {
+    return Logger::instance().isSelected(object);
+}
+
 Statement::Initializer::Initializer(Statement& s) : statement(s) {
     Logger::instance().add(s);
 }
@@ -27,17 +27,27 @@
 #include "qpid/management/ManagementAgent.h"
 #include "qpid/management/ManagementObject.h"
 #include "qpid/broker/DeliverableMessage.h"
+#include "qpid/broker/Queue.h"
 #include "qpid/log/Statement.h"
 #include <qpid/broker/Message.h>
 #include "qpid/framing/MessageTransferBody.h"
+#include "qpid/sys/AllocationCounts.h"
 #include "qpid/sys/Time.h"
 #include "qpid/sys/Thread.h"
+#include "qpid/sys/AsynchIO.h"
+#include "qpid/sys/AsynchIOHandler.h"
+#include "qpid/sys/HugePages.h"
 #include "qpid/broker/ConnectionState.h"
 #include "qpid/broker/AclModule.h"
 #include "qpid/types/Variant.h"
 #include "qpid/types/Uuid.h"
 #include "qpid/framing/List.h"
 #include "qpid/amqp_0_10/Codecs.h"
+#include "qpid/amqp_0_10/MapView.h"
+#include "qmf/Expression.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <list>
 #include <iostream>
 #include <fstream>
@@ -104,6 +114,41 @@ static Variant::Map mapEncodeSchemaId(const string& pname,
     return map_;
 }
 
+static void mapEncodeSchemaId(MapEncoder& map_,
+                              const string& pname,
+                              const string& cname,
+                              const string& type,
+                              const uint8_t *md5Sum)
+{
+    map_.beginMap("_schema_id");
+    map_.put("_package_name", pname);
+    map_.put("_class_name", cname);
+    map_.put("_type", type);
+    map_.put("_hash", qpid::types::Uuid(md5Sum));
+    map_.end();
+}
+
+/*
+ * Add the V2 data indication for @a object to the open list of @a list_,
+ * as the Variant::Map the query handlers build would encode.
+ */
+static void mapEncodeObject(MapEncoder& list_, ManagementObject* object,
+                            bool includeProperties, bool includeStatistics)
+{
+    list_.beginMap();
+    list_.put("_object_id", object->getObjectId());
+    mapEncodeSchemaId(list_,
+                      object->getPackageName(),
+                      object->getClassName(),
+                      "_data",
+                      object->getMd5Sum());
+    object->writeTimestamps(list_);
+    list_.beginMap("_values");
+    object->mapEncodeValues(list_, includeProperties, includeStatistics);
+    list_.end();
+    list_.end();
+}
+
 
 ManagementAgent::RemoteAgent::~RemoteAgent ()
 {
@@ -114,12 +159,19 @@ ManagementAgent::RemoteAgent::~RemoteAgent ()
     }
 }
 
+const uint32_t ManagementAgent::MIN_SUBSCRIPTION_INTERVAL(1000);
+const uint32_t ManagementAgent::DEFAULT_SUBSCRIPTION_DURATION(300);
+const size_t ManagementAgent::MAX_PENDING_EVENTS(10000);
+
 ManagementAgent::ManagementAgent (const bool qmfV1, const bool qmfV2) :
-    threadPoolSize(1), interval(10), broker(0), timer(0),
+    threadPoolSize(1), publishSlices(1), publishSlice(0), acceptedReported(0),
+    minLifetime(0), interval(10), broker(0), timer(0),
     startTime(sys::now()),
     suppressed(false), disallowAllV1Methods(false),
     vendorNameKey(defaultVendorName), productNameKey(defaultProductName),
     qmf1Support(qmfV1), qmf2Support(qmfV2), maxReplyObjs(100),
+    eventFlushScheduled(false), eventRate(0), eventWindowStart(sys::EPOCH),
+    eventsInWindow(0), eventsDropped(0),
     msgBuffer(MA_BUFFER_SIZE)
 {
     nextObjectId   = 1;
@@ -127,6 +179,7 @@ ManagementAgent::ManagementAgent (const bool qmfV1, const bool qmfV2) :
     bootSequence   = 1;
     nextRemoteBank = 10;
     nextRequestSequence = 1;
+    nextSubscriptionId = 1;
     clientWasAdded = false;
     attrMap["_vendor"] = defaultVendorName;
     attrMap["_product"] = defaultProductName;
@@ -154,14 +207,18 @@ ManagementAgent::~ManagementAgent ()
             delete object;
         }
         managementObjects.clear();
+        objectsByClass.clear();
+        objectsByV1Id.clear();
     }
 }
 
 void ManagementAgent::configure(const string& _dataDir, uint16_t _interval,
-                                qpid::broker::Broker* _broker, int _threads)
+                                qpid::broker::Broker* _broker, int _threads,
+                                uint16_t _slices)
 {
     dataDir        = _dataDir;
     interval       = _interval;
+    publishSlices  = _slices ? _slices : 1;
     broker         = _broker;
     threadPoolSize = _threads;
     ManagementObject::maxThreads = threadPoolSize;
@@ -210,7 +267,7 @@ void ManagementAgent::configure(const string& _dataDir, uint16_t _interval,
 void ManagementAgent::pluginsInitialized() {
     // Do this here so cluster plugin has the chance to set up the timer.
     timer          = &broker->getClusterTimer();
-    timer->add(new Periodic(*this, interval));
+    timer->add(new Periodic(*this, publishPeriod()));
 }
 
 
@@ -305,7 +362,7 @@ void ManagementAgent::registerEvent (const string&  packageName,
 }
 
 // Deprecated:  V1 objects
-ObjectId ManagementAgent::addObject(ManagementObject* object, uint64_t persistId, bool persistent)
+ObjectId ManagementAgent::assignV1Id(ManagementObject* object, uint64_t persistId, bool persistent)
 {
     uint16_t sequence;
     uint64_t objectNum;
@@ -317,7 +374,12 @@ ObjectId ManagementAgent::addObject(ManagementObject* object, uint64_t persistId
     objId.setV2Key(*object);   // let object generate the v2 key
 
     object->setObjectId(objId);
+    return objId;
+}
 
+ObjectId ManagementAgent::addObject(ManagementObject* object, uint64_t persistId, bool persistent)
+{
+    ObjectId objId = assignV1Id(object, persistId, persistent);
     {
         sys::Mutex::ScopedLock lock(addLock);
         newManagementObjects.push_back(object);
@@ -326,6 +388,22 @@ ObjectId ManagementAgent::addObject(ManagementObject* object, uint64_t persistId
     return objId;
 }
 
+ObjectId ManagementAgent::addDeferredObject(ManagementObject* object, uint64_t persistId)
+{
+    // Cluster members must all publish the same objects at the same time,
+    // which they would not if each held objects back by its own clock.
+    if (minLifetime == 0 || (broker && broker->isInCluster()))
+        return addObject(object, persistId);
+
+    ObjectId objId = assignV1Id(object, persistId, false);
+    {
+        sys::Mutex::ScopedLock lock(addLock);
+        deferredObjects.push_back(DeferredObject(object, sys::now()));
+    }
+    QPID_LOG(debug, "Management object (V1) added, deferred: " << objId.getV2Key());
+    return objId;
+}
+
 
 
 ObjectId ManagementAgent::addObject(ManagementObject* object,
@@ -352,48 +430,139 @@ ObjectId ManagementAgent::addObject(ManagementObject* object,
     return objId;
 }
 
-void ManagementAgent::raiseEvent(const ManagementEvent& event, severity_t severity)
+namespace {
+bool hasSubscribers(const qpid::broker::Exchange::shared_ptr& exchange)
+{
+    return exchange && exchange->isBound(qpid::broker::Queue::shared_ptr(), 0, 0);
+}
+}
+
+void ManagementAgent::raiseEvent(const ManagementEvent& event, severity_t severity, const std::string& source)
+{
+    PendingEvent pending;
+    // Without a broker there are no exchanges to check, leave that to sendBufferLH
+    pending.v1 = qmf1Support && (!broker || hasSubscribers(mExchange));
+    pending.v2 = qmf2Support && (!broker || hasSubscribers(v2Topic));
+    if (!pending.v1 && !pending.v2) return;
+
+    pending.packageName = event.getPackageName();
+    pending.eventName = event.getEventName();
+    pending.source = source;
+    ::memcpy(pending.md5Sum, event.getMd5Sum(), sizeof(pending.md5Sum));
+    pending.severity = (severity == SEV_DEFAULT) ? event.getSeverity() : (uint8_t) severity;
+    pending.timestamp = uint64_t(sys::Duration(sys::EPOCH, sys::now()));
+    if (pending.v1) event.encode(pending.v1Args);
+    if (pending.v2) event.mapEncode(pending.v2Values);
+
+    // Cluster members must publish in step with the events that cause
+    // them, so they and brokers not yet running publish straight away.
+    if (!timer || broker->isInCluster()) {
+        sys::Mutex::ScopedLock lock (userLock);
+        sendEventLH(pending);
+        return;
+    }
+
+    sys::Mutex::ScopedLock l(eventLock);
+    if (!source.empty()) {
+        for (std::list<PendingEvent>::iterator i = pendingEvents.begin(); i != pendingEvents.end(); ++i) {
+            if (i->source == source && i->eventName == pending.eventName && i->packageName == pending.packageName) {
+                *i = pending;
+                return;
+            }
+        }
+    }
+    if (pendingEvents.size() >= MAX_PENDING_EVENTS) {
+        ++eventsDropped;
+        return;
+    }
+    pendingEvents.push_back(pending);
+    if (!eventFlushScheduled) {
+        eventFlushScheduled = true;
+        timer->add(new EventFlush(*this, 0));
+    }
+}
+
+void ManagementAgent::flushEvents()
+{
+    std::list<PendingEvent> batch;
+    uint64_t dropped;
+    {
+        sys::Mutex::ScopedLock l(eventLock);
+        eventFlushScheduled = false;
+        size_t count = pendingEvents.size();
+        if (eventRate) {
+            sys::AbsTime now = sys::now();
+            if (sys::Duration(eventWindowStart, now) >= sys::TIME_SEC) {
+                eventWindowStart = now;
+                eventsInWindow = 0;
+            }
+            count = std::min(count, size_t(eventRate - eventsInWindow));
+            eventsInWindow += count;
+        }
+        std::list<PendingEvent>::iterator end = pendingEvents.begin();
+        std::advance(end, count);
+        batch.splice(batch.end(), pendingEvents, pendingEvents.begin(), end);
+        if (!pendingEvents.empty()) {
+            // Resume when the next second's allowance starts
+            eventFlushScheduled = true;
+            timer->add(new EventFlush(*this, sys::Duration(sys::now(), sys::AbsTime(eventWindowStart, sys::TIME_SEC))));
+        }
+        dropped = eventsDropped;
+        eventsDropped = 0;
+    }
+    if (dropped) {
+        QPID_LOG(warning, "Management events arrived faster than they could be published, " << dropped << " dropped");
+    }
+    sys::Mutex::ScopedLock lock (userLock);
+    for (std::list<PendingEvent>::const_iterator i = batch.begin(); i != batch.end(); ++i)
+        sendEventLH(*i);
+}
+
+ManagementAgent::EventFlush::EventFlush (ManagementAgent& _agent, sys::Duration delay)
+    : TimerTask (delay, "ManagementAgent::flushEvents"),
+      agent(_agent) {}
+
+void ManagementAgent::EventFlush::fire ()
+{
+    agent.flushEvents();
+}
+
+void ManagementAgent::sendEventLH(const PendingEvent& event)
 {
     static const std::string severityStr[] = {
         "emerg", "alert", "crit", "error", "warn",
         "note", "info", "debug"
     };
-    sys::Mutex::ScopedLock lock (userLock);
-    uint8_t sev = (severity == SEV_DEFAULT) ? event.getSeverity() : (uint8_t) severity;
+    uint8_t sev = event.severity;
 
-    if (qmf1Support) {
+    if (event.v1) {
         Buffer outBuffer(eventBuffer, MA_BUFFER_SIZE);
         uint32_t outLen;
 
         encodeHeader(outBuffer, 'e');
-        outBuffer.putShortString(event.getPackageName());
-        outBuffer.putShortString(event.getEventName());
-        outBuffer.putBin128(event.getMd5Sum());
-        outBuffer.putLongLong(uint64_t(sys::Duration(sys::EPOCH, sys::now())));
+        outBuffer.putShortString(event.packageName);
+        outBuffer.putShortString(event.eventName);
+        outBuffer.putBin128(event.md5Sum);
+        outBuffer.putLongLong(event.timestamp);
         outBuffer.putOctet(sev);
-        string sBuf;
-        event.encode(sBuf);
-        outBuffer.putRawData(sBuf);
+        outBuffer.putRawData(event.v1Args);
         outLen = MA_BUFFER_SIZE - outBuffer.available();
         outBuffer.reset();
         sendBufferLH(outBuffer, outLen, mExchange,
-                   "console.event.1.0." + event.getPackageName() + "." + event.getEventName());
-        QPID_LOG(debug, "SEND raiseEvent (v1) class=" << event.getPackageName() << "." << event.getEventName());
+                   "console.event.1.0." + event.packageName + "." + event.eventName);
+        QPID_LOG(debug, "SEND raiseEvent (v1) class=" << event.packageName << "." << event.eventName);
     }
 
-    if (qmf2Support) {
+    if (event.v2) {
         Variant::Map map_;
-        Variant::Map schemaId;
-        Variant::Map values;
         Variant::Map headers;
 
-        map_["_schema_id"] = mapEncodeSchemaId(event.getPackageName(),
-                                               event.getEventName(),
+        map_["_schema_id"] = mapEncodeSchemaId(event.packageName,
+                                               event.eventName,
                                                "_event",
-                                               event.getMd5Sum());
-        event.mapEncode(values);
-        map_["_values"] = values;
-        map_["_timestamp"] = uint64_t(sys::Duration(sys::EPOCH, sys::now()));
+                                               event.md5Sum);
+        map_["_values"] = event.v2Values;
+        map_["_timestamp"] = event.timestamp;
         map_["_severity"] = sev;
 
         headers["method"] = "indication";
@@ -402,8 +571,8 @@ void ManagementAgent::raiseEvent(const ManagementEvent& event, severity_t severi
         headers["qmf.agent"] = name_address;
 
         stringstream key;
-        key << "agent.ind.event." << keyifyNameStr(event.getPackageName())
-            << "." << keyifyNameStr(event.getEventName())
+        key << "agent.ind.event." << keyifyNameStr(event.packageName)
+            << "." << keyifyNameStr(event.eventName)
             << "." << severityStr[sev]
             << "." << vendorNameKey
             << "." << productNameKey;
@@ -416,23 +585,27 @@ void ManagementAgent::raiseEvent(const ManagementEvent& event, severity_t severi
         list_.push_back(map_);
         ListCodec::encode(list_, content);
         sendBufferLH(content, "", headers, "amqp/list", v2Topic, key.str());
-        QPID_LOG(debug, "SEND raiseEvent (v2) class=" << event.getPackageName() << "." << event.getEventName());
+        QPID_LOG(debug, "SEND raiseEvent (v2) class=" << event.packageName << "." << event.eventName);
     }
 }
 
-ManagementAgent::Periodic::Periodic (ManagementAgent& _agent, uint32_t _seconds)
-    : TimerTask (sys::Duration((_seconds ? _seconds : 1) * sys::TIME_SEC),
-                 "ManagementAgent::periodicProcessing"),
+ManagementAgent::Periodic::Periodic (ManagementAgent& _agent, sys::Duration period)
+    : TimerTask (period, "ManagementAgent::periodicProcessing"),
       agent(_agent) {}
 
 ManagementAgent::Periodic::~Periodic () {}
 
 void ManagementAgent::Periodic::fire ()
 {
-    agent.timer->add (new Periodic (agent, agent.interval));
+    agent.timer->add (new Periodic (agent, agent.publishPeriod()));
     agent.periodicProcessing ();
 }
 
+sys::Duration ManagementAgent::publishPeriod() const
+{
+    return sys::Duration((interval ? interval : 1) * sys::TIME_SEC / publishSlices);
+}
+
 void ManagementAgent::clientAdded (const string& routingKey)
 {
     sys::Mutex::ScopedLock lock(userLock);
@@ -487,6 +660,9 @@ void ManagementAgent::clusterUpdate() {
     moveNewObjectsLH();         // keep lists consistent with updater/updatee.
     moveDeletedObjectsLH();
     clientWasAdded = true;
+    // Start the next interval afresh, so that all members publish the same
+    // slices from here on.
+    publishSlice = 0;
     debugSnapshot("Cluster member joined");
 }
 
@@ -653,7 +829,8 @@ void ManagementAgent::sendBufferLH(const string& data,
 
 
 /** Objects that have been added since the last periodic poll are temporarily
- * saved in the newManagementObjects list.  This allows objects to be
+ * saved in the newManagementObjects list, or the deferredObjects list until
+ * they are old enough or @a all are wanted.  This allows objects to be
  * added without needing to block on the userLock (addLock is used instead).
  * These new objects need to be integrated into the object database
  * (managementObjects) *before* they can be properly managed.  This routine
@@ -664,9 +841,29 @@ void ManagementAgent::sendBufferLH(const string& data,
  * duplicate object ids.  To avoid clashes, don't put deleted objects
  * into the active object database.
  */
-void ManagementAgent::moveNewObjectsLH()
+void ManagementAgent::moveNewObjectsLH(bool all)
 {
     sys::Mutex::ScopedLock lock (addLock);
+    if (!deferredObjects.empty()) {
+        // Objects deleted while deferred were never published: drop them
+        // without a trace rather than report them as deleted
+        sys::AbsTime now = sys::now();
+        size_t dropped = 0;
+        std::deque<DeferredObject> young;
+        for (std::deque<DeferredObject>::iterator i = deferredObjects.begin();
+             i != deferredObjects.end(); ++i) {
+            if (i->object->isDeleted()) {
+                delete i->object;
+                ++dropped;
+            } else if (all || sys::Duration(i->added, now) >= minLifetime) {
+                newManagementObjects.push_back(i->object);
+            } else {
+                young.push_back(*i);
+            }
+        }
+        deferredObjects.swap(young);
+        QPID_LOG_IF(debug, dropped, "Dropped " << dropped << " short-lived management objects");
+    }
     while (!newManagementObjects.empty()) {
         ManagementObject *object = newManagementObjects.back();
         newManagementObjects.pop_back();
@@ -682,6 +879,7 @@ void ManagementAgent::moveNewObjectsLH()
                 // duplicate found.  It is OK if the old object has been marked
                 // deleted...
                 ManagementObject *oldObj = destIter->second;
+                unindexObjectLH(oldObj);
                 if (oldObj->isDeleted()) {
                     DeletedObject::shared_ptr dptr(new DeletedObject(oldObj, qmf1Support, qmf2Support));
                     pendingDeletedObjs[dptr->getKey()].push_back(dptr);
@@ -694,47 +892,103 @@ void ManagementAgent::moveNewObjectsLH()
                 }
             }
             managementObjects[oid] = object;
+            indexObjectLH(object);
+            addedObjects.push_back(oid);
         }
     }
 }
 
+void ManagementAgent::indexObjectLH(ManagementObject* object)
+{
+    const ObjectId& oid = object->getObjectId();
+    string v1Id;
+    oid.encode(v1Id);
+    objectsByClass[object->getClassName()].insert(oid);
+    objectsByV1Id[v1Id].insert(oid);
+}
+
+void ManagementAgent::unindexObjectLH(ManagementObject* object)
+{
+    const ObjectId& oid = object->getObjectId();
+    string v1Id;
+    oid.encode(v1Id);
+    ObjectIndex::iterator i = objectsByClass.find(object->getClassName());
+    if (i != objectsByClass.end()) {
+        i->second.erase(oid);
+        if (i->second.empty())
+            objectsByClass.erase(i);
+    }
+    i = objectsByV1Id.find(v1Id);
+    if (i != objectsByV1Id.end()) {
+        i->second.erase(oid);
+        if (i->second.empty())
+            objectsByV1Id.erase(i);
+    }
+}
+
 void ManagementAgent::periodicProcessing (void)
 {
 #define BUFSIZE   65536
 #define HEADROOM  4096
+    QPID_ALLOCATION_SITE(management);
     debugSnapshot("Management agent periodic processing");
     sys::Mutex::ScopedLock lock (userLock);
     uint32_t            contentSize;
     string              routingKey;
-    string sBuf;
-
-    uint64_t uptime = sys::Duration(startTime, sys::now());
-    static_cast<_qmf::Broker*>(broker->GetManagementObject())->set_uptime(uptime);
-
-    moveNewObjectsLH();
 
-    //
-    //  Clear the been-here flag on all objects in the map.
-    //
-    for (ManagementObjectMap::iterator iter = managementObjects.begin();
-         iter != managementObjects.end();
-         iter++) {
-        ManagementObject* object = iter->second;
-        object->setFlags(0);
-        if (clientWasAdded) {
-            object->setForcePublish(true);
-        }
+    bool lastSlice = publishSlice + 1 >= publishSlices;
+    if (publishSlice == 0) {
+        uint64_t uptime = sys::Duration(startTime, sys::now());
+        _qmf::Broker* brokerObject = static_cast<_qmf::Broker*>(broker->GetManagementObject());
+        brokerObject->set_uptime(uptime);
+
+        sys::AsynchIOHandler::BufferPoolStats bufferStats;
+        sys::AsynchIOHandler::getBufferPoolStats(bufferStats);
+        brokerObject->set_ioBuffersInUse(bufferStats.buffersInUse);
+        brokerObject->set_ioBuffersFree(bufferStats.buffersFree);
+        brokerObject->set_ioBufferMemory(bufferStats.bytesAllocated);
+        brokerObject->set_ioBuffersReleased(bufferStats.buffersReleased);
+        brokerObject->set_ioBuffersReleasedRemote(bufferStats.buffersReleasedRemote);
+
+        sys::HugePages::Stats hugePageStats;
+        sys::HugePages::getStats(hugePageStats);
+        brokerObject->set_hugePageSize(hugePageStats.pageSize);
+        brokerObject->set_hugePageMemory(hugePageStats.bytesMapped);
+        brokerObject->set_hugePageMemoryInUse(hugePageStats.bytesInUse);
+        brokerObject->set_hugePageFallbacks(hugePageStats.fallbacks);
+
+        sys::AsynchAcceptor::Stats acceptStats;
+        sys::AsynchAcceptor::getStats(acceptStats);
+        brokerObject->inc_connectionsAccepted(acceptStats.accepted - acceptedReported);
+        brokerObject->set_acceptBatchMax(acceptStats.largestBatch);
+        acceptedReported = acceptStats.accepted;
+    }
+
+    moveNewObjectsLH(false);
+
+    if (clientWasAdded) {
+        for (ManagementObjectMap::iterator iter = managementObjects.begin();
+             iter != managementObjects.end();
+             iter++)
+            iter->second->setForcePublish(true);
     }
-
     clientWasAdded = false;
 
+    // Subscriptions are served before deleted objects are dropped from the
+    // map, so that a subscriber sees the last of any it has been sent.
+    publishSubscriptionsLH(publishSlice == 0);
+
     // first send the pending deletes before sending updates.  This prevents a
     // "false delete" scenario: if an object was deleted then re-added during
     // the last poll cycle, it will have a delete entry and an active entry.
     // if we sent the active update first, _then_ the delete update, clients
     // would incorrectly think the object was deleted.  See QPID-2997
     //
-    bool objectsDeleted = moveDeletedObjectsLH();
+    // Finding the deleted objects takes a walk over the whole map, so it
+    // is done once an interval; a re-added object's delete entry is made
+    // as it is moved in, whichever slice it is.
+    //
+    bool objectsDeleted = publishSlice == 0 && moveDeletedObjectsLH();
     if (!pendingDeletedObjs.empty()) {
         // use a temporary copy of the pending deletes so dropping the lock when
         // the buffer is sent is safe.
@@ -851,124 +1105,178 @@ void ManagementAgent::periodicProcessing (void)
     }
 
     //
-    // Process the entire object map.  Remember: we drop the userLock each time we call
-    // sendBuffer().  This allows the managementObjects map to be altered during the
-    // sendBuffer() call, so always restart the search after a sendBuffer() call
+    // Gather the changed objects in this slice of the object map, and any
+    // added since the last one, by class. Only their ids are kept: the
+    // userLock is dropped each time an update is sent, and the objects may
+    // be deleted meanwhile.
     //
-    while (1) {
-        msgBuffer.reset();
-        Variant::List list_;
-        uint32_t pcount;
-        uint32_t scount;
-        uint32_t v1Objs, v2Objs;
-        ManagementObjectMap::iterator baseIter;
-        std::string packageName;
-        std::string className;
-
-        for (baseIter = managementObjects.begin();
-             baseIter != managementObjects.end();
-             baseIter++) {
-            ManagementObject* baseObject = baseIter->second;
-            //
-            //  Skip until we find a base object requiring processing...
-            //
-            if (baseObject->getFlags() == 0) {
-                packageName = baseObject->getPackageName();
-                className = baseObject->getClassName();
-                break;
-            }
+    typedef std::map<std::pair<std::string, std::string>, std::vector<ObjectId> > ClassObjects;
+    ClassObjects changed;
+    std::vector<ObjectId> added;
+    added.swap(addedObjects);
+    for (std::vector<ObjectId>::const_iterator i = added.begin(); i != added.end(); ++i) {
+        ManagementObjectMap::iterator iter = managementObjects.find(*i);
+        if (iter != managementObjects.end()) {
+            ManagementObject* object = iter->second;
+            changed[std::make_pair(object->getPackageName(), object->getClassName())].push_back(*i);
         }
+    }
+    ManagementObjectMap::iterator iter = publishSlice == 0 ?
+        managementObjects.begin() : managementObjects.upper_bound(publishCursor);
+    size_t share = (managementObjects.size() + publishSlices - 1) / publishSlices;
+    for (size_t n = 0;
+         iter != managementObjects.end() && (lastSlice || n < share);
+         ++iter, ++n) {
+        ManagementObject* object = iter->second;
+        publishCursor = iter->first;
+        if (object->isDeleted())
+            continue;   // Dealt with on the next periodic cycle
+        if (object->getConfigChanged() || object->getInstChanged() || object->getForcePublish())
+            changed[std::make_pair(object->getPackageName(), object->getClassName())].push_back(iter->first);
+    }
 
-        if (baseIter == managementObjects.end())
-            break;  // done - all objects processed
+    for (ClassObjects::const_iterator i = changed.begin(); i != changed.end(); ++i)
+        publishObjectsLH(i->first.first, i->first.second, i->second);
 
-        pcount = scount = 0;
-        v1Objs = 0;
-        v2Objs = 0;
-        list_.clear();
-        msgBuffer.reset();
+    if (objectsDeleted) deleteOrphanedAgentsLH();
 
-        for (ManagementObjectMap::iterator iter = baseIter;
-             iter != managementObjects.end();
-             iter++) {
-            msgBuffer.makeAvailable(HEADROOM); // Make sure there's buffer space
-            ManagementObject* baseObject = baseIter->second;
-            ManagementObject* object = iter->second;
-            bool send_stats, send_props;
-            if (baseObject->isSameClass(*object) && object->getFlags() == 0) {
-                object->setFlags(1);
-                if (object->getConfigChanged() || object->getInstChanged())
-                    object->setUpdateTime();
-
-                // skip any objects marked deleted since our first pass.  Deal with them
-                // on the next periodic cycle...
-                if (object->isDeleted()) {
-                    continue;
-                }
+    publishSlice = lastSlice ? 0 : publishSlice + 1;
+    if (!lastSlice)
+        return;
 
-                send_props = (object->getConfigChanged() || object->getForcePublish());
-                send_stats = (object->hasInst() && (object->getInstChanged() || object->getForcePublish()));
+    // heartbeat generation, once an interval
 
-                if (send_props && qmf1Support) {
-                    size_t pos = msgBuffer.getPosition();
-                    encodeHeader(msgBuffer, 'c');
-                    sBuf.clear();
-                    object->writeProperties(sBuf);
-                    msgBuffer.putRawData(sBuf);
-                    QPID_LOG(trace, "Changed V1 properties "
-                             << object->getObjectId().getV2Key()
-                             << " len=" << msgBuffer.getPosition()-pos);
-                    ++v1Objs;
-                }
+    if (qmf1Support) {
+#define BUFSIZE   65536
+        uint32_t            contentSize;
+        char                msgChars[BUFSIZE];
+        Buffer msgBuffer(msgChars, BUFSIZE);
+        encodeHeader(msgBuffer, 'h');
+        msgBuffer.putLongLong(uint64_t(sys::Duration(sys::EPOCH, sys::now())));
 
-                if (send_stats && qmf1Support) {
-                    size_t pos = msgBuffer.getPosition();
-                    encodeHeader(msgBuffer, 'i');
-                    sBuf.clear();
-                    object->writeStatistics(sBuf);
-                    msgBuffer.putRawData(sBuf);
-                    QPID_LOG(trace, "Changed V1 statistics "
-                             << object->getObjectId().getV2Key()
-                             << " len=" << msgBuffer.getPosition()-pos);
-                    ++v1Objs;
-                }
+        contentSize = BUFSIZE - msgBuffer.available ();
+        msgBuffer.reset ();
+        routingKey = "console.heartbeat.1.0";
+        sendBufferLH(msgBuffer, contentSize, mExchange, routingKey);
+        QPID_LOG(debug, "SEND HeartbeatInd to=" << routingKey);
+    }
 
-                if ((send_stats || send_props) && qmf2Support) {
-                    Variant::Map  map_;
-                    Variant::Map values;
-                    Variant::Map oid;
-
-                    object->getObjectId().mapEncode(oid);
-                    map_["_object_id"] = oid;
-                    map_["_schema_id"] = mapEncodeSchemaId(object->getPackageName(),
-                                                           object->getClassName(),
-                                                           "_data",
-                                                           object->getMd5Sum());
-                    object->writeTimestamps(map_);
-                    object->mapEncodeValues(values, send_props, send_stats);
-                    map_["_values"] = values;
-                    list_.push_back(map_);
-                    v2Objs++;
-                    QPID_LOG(trace, "Changed V2"
-                             << (send_stats? " statistics":"")
-                             << (send_props? " properties":"")
-                             << " map=" << map_);
-                }
+    if (qmf2Support) {
+        std::stringstream addr_key;
+
+        addr_key << "agent.ind.heartbeat." << vendorNameKey << "." << productNameKey;
+        if (!instanceNameKey.empty())
+            addr_key << "." << instanceNameKey;
+
+        Variant::Map map;
+        Variant::Map headers;
+
+        headers["method"] = "indication";
+        headers["qmf.opcode"] = "_agent_heartbeat_indication";
+        headers["qmf.agent"] = name_address;
+
+        map["_values"] = attrMap;
+        map["_values"].asMap()["_timestamp"] = uint64_t(sys::Duration(sys::EPOCH, sys::now()));
+        map["_values"].asMap()["_heartbeat_interval"] = interval;
+        map["_values"].asMap()["_epoch"] = bootSequence;
+
+        string content;
+        MapCodec::encode(map, content);
 
-                if (send_props) pcount++;
-                if (send_stats) scount++;
+        // Set TTL (in msecs) on outgoing heartbeat indications based on the interval
+        // time to prevent stale heartbeats from getting to the consoles.
+        sendBufferLH(content, "", headers, "amqp/map", v2Topic, addr_key.str(), interval * 2 * 1000);
 
-                object->setForcePublish(false);
+        QPID_LOG(debug, "SENT AgentHeartbeat name=" << name_address);
+    }
+}
 
-                if ((qmf1Support && (v1Objs >= maxReplyObjs)) ||
-                    (qmf2Support && (v2Objs >= maxReplyObjs)))
-                    break;  // have enough objects, send an indication...
+/*
+ * Publish updates for the objects in @a oids, all of one class, at most
+ * maxReplyObjs to a message.  Each object is looked up again after every
+ * message, as sending one drops the userLock.
+ */
+void ManagementAgent::publishObjectsLH(const std::string& packageName,
+                                       const std::string& className,
+                                       const std::vector<ObjectId>& oids)
+{
+    std::vector<ObjectId>::const_iterator next = oids.begin();
+    string sBuf;
+    string content;     // V2 indications, encoded as they are added
+    while (next != oids.end()) {
+        msgBuffer.reset();
+        content.clear();
+        MapEncoder list_(content);
+        list_.beginList();
+        uint32_t pcount = 0;
+        uint32_t scount = 0;
+        uint32_t v1Objs = 0;
+        uint32_t v2Objs = 0;
+
+        for (; next != oids.end(); ++next) {
+            if ((qmf1Support && (v1Objs >= maxReplyObjs)) ||
+                (qmf2Support && (v2Objs >= maxReplyObjs)))
+                break;  // have enough objects, send an indication...
+
+            ManagementObjectMap::iterator iter = managementObjects.find(*next);
+            if (iter == managementObjects.end())
+                continue;
+            ManagementObject* object = iter->second;
+            if (object->isDeleted())
+                continue;
+
+            bool send_props = (object->getConfigChanged() || object->getForcePublish());
+            bool send_stats = (object->hasInst() && (object->getInstChanged() || object->getForcePublish()));
+            if (!send_props && !send_stats)
+                continue;   // e.g. published already as a new object
+            if (object->getConfigChanged() || object->getInstChanged())
+                object->setUpdateTime();    // A forced update is no change
+            msgBuffer.makeAvailable(HEADROOM); // Make sure there's buffer space
+
+            if (send_props && qmf1Support) {
+                size_t pos = msgBuffer.getPosition();
+                encodeHeader(msgBuffer, 'c');
+                sBuf.clear();
+                object->writeProperties(sBuf);
+                msgBuffer.putRawData(sBuf);
+                QPID_LOG(trace, "Changed V1 properties "
+                         << object->getObjectId().getV2Key()
+                         << " len=" << msgBuffer.getPosition()-pos);
+                ++v1Objs;
+            }
+
+            if (send_stats && qmf1Support) {
+                size_t pos = msgBuffer.getPosition();
+                encodeHeader(msgBuffer, 'i');
+                sBuf.clear();
+                object->writeStatistics(sBuf);
+                msgBuffer.putRawData(sBuf);
+                QPID_LOG(trace, "Changed V1 statistics "
+                         << object->getObjectId().getV2Key()
+                         << " len=" << msgBuffer.getPosition()-pos);
+                ++v1Objs;
             }
+
+            if ((send_stats || send_props) && qmf2Support) {
+                size_t pos = content.size();
+                mapEncodeObject(list_, object, send_props, send_stats);
+                v2Objs++;
+                QPID_LOG(trace, "Changed V2"
+                         << (send_stats? " statistics":"")
+                         << (send_props? " properties":"")
+                         << " " << object->getObjectId().getV2Key()
+                         << " len=" << content.size()-pos);
+            }
+
+            if (send_props) pcount++;
+            if (send_stats) scount++;
+
+            object->setForcePublish(false);
         }
 
         if (pcount || scount) {
             if (qmf1Support) {
-                contentSize = BUFSIZE - msgBuffer.available();
+                uint32_t contentSize = msgBuffer.getPosition();
                 if (contentSize > 0) {
                     stringstream key;
                     key << "console.obj.1.0." << packageName << "." << className;
@@ -982,8 +1290,7 @@ void ManagementAgent::periodicProcessing (void)
             }
 
             if (qmf2Support) {
-                string content;
-                ListCodec::encode(list_, content);
+                list_.end();
                 if (content.length()) {
                     stringstream key;
                     Variant::Map  headers;
@@ -1007,54 +1314,151 @@ void ManagementAgent::periodicProcessing (void)
                 }
             }
         }
-    }  // end processing updates for all objects
-
-    if (objectsDeleted) deleteOrphanedAgentsLH();
-
-    // heartbeat generation
-
-    if (qmf1Support) {
-#define BUFSIZE   65536
-        uint32_t            contentSize;
-        char                msgChars[BUFSIZE];
-        Buffer msgBuffer(msgChars, BUFSIZE);
-        encodeHeader(msgBuffer, 'h');
-        msgBuffer.putLongLong(uint64_t(sys::Duration(sys::EPOCH, sys::now())));
-
-        contentSize = BUFSIZE - msgBuffer.available ();
-        msgBuffer.reset ();
-        routingKey = "console.heartbeat.1.0";
-        sendBufferLH(msgBuffer, contentSize, mExchange, routingKey);
-        QPID_LOG(debug, "SEND HeartbeatInd to=" << routingKey);
     }
+}
 
-    if (qmf2Support) {
-        std::stringstream addr_key;
-
-        addr_key << "agent.ind.heartbeat." << vendorNameKey << "." << productNameKey;
-        if (!instanceNameKey.empty())
-            addr_key << "." << instanceNameKey;
+/*
+ * Serve the subscriptions that are due, and drop those that have lapsed.
+ * When @a reaping, deleted objects are about to leave the map, so the
+ * subscriptions that are not due are sent those of them they hold.
+ */
+void ManagementAgent::publishSubscriptionsLH(bool reaping)
+{
+    sys::AbsTime now(sys::now());
+    std::vector<std::pair<uint64_t, bool> > work;   // Id, and deletes only
+    for (Subscriptions::iterator s = subscriptions.begin(); s != subscriptions.end(); ) {
+        if (now > s->second.expires) {
+            QPID_LOG(debug, "Subscription " << s->first << " lapsed");
+            subscriptions.erase(s++);
+            continue;
+        }
+        if (!(now < s->second.nextPublish))
+            work.push_back(std::make_pair(s->first, false));
+        else if (reaping && !s->second.published.empty())
+            work.push_back(std::make_pair(s->first, true));
+        ++s;
+    }
+    for (size_t w = 0; w < work.size(); ++w)
+        publishSubscriptionLH(work[w].first, work[w].second);
+}
 
-        Variant::Map map;
-        Variant::Map headers;
+/*
+ * Send subscription @a id the objects it selects that have changed since
+ * its last pass, in pages of at most maxReplyObjs.  The pages are all
+ * encoded before the first is sent, as sending drops the userLock.
+ */
+void ManagementAgent::publishSubscriptionLH(uint64_t id, bool deletesOnly)
+{
+    Subscriptions::iterator s = subscriptions.find(id);
+    if (s == subscriptions.end())
+        return;
+    Subscription& sub = s->second;
+
+    std::vector<ObjectId> candidates;
+    if (deletesOnly)
+        candidates.assign(sub.published.begin(), sub.published.end());
+    else if (sub.byObjectId)
+        candidates.push_back(sub.objectId);
+    else if (!sub.className.empty()) {
+        ObjectIndex::const_iterator cIter = objectsByClass.find(sub.className);
+        if (cIter != objectsByClass.end())
+            candidates.assign(cIter->second.begin(), cIter->second.end());
+    } else {
+        for (ManagementObjectMap::const_iterator iter = managementObjects.begin();
+             iter != managementObjects.end(); ++iter)
+            candidates.push_back(iter->first);
+    }
+
+    std::list<string> pages;
+    pages.push_back(string());
+    std::auto_ptr<MapEncoder> list_(new MapEncoder(pages.back()));
+    list_->beginList();
+    for (std::vector<ObjectId>::const_iterator c = candidates.begin(); c != candidates.end(); ++c) {
+        ManagementObjectMap::iterator iter = managementObjects.find(*c);
+        if (iter == managementObjects.end()) {
+            sub.published.erase(*c);
+            continue;
+        }
+        ManagementObject* object = iter->second;
+        if (!sub.packageName.empty() && object->getPackageName() != sub.packageName)
+            continue;
 
-        headers["method"] = "indication";
-        headers["qmf.opcode"] = "_agent_heartbeat_indication";
-        headers["qmf.agent"] = name_address;
+        if (object->isDeleted()) {
+            // Only a subscriber that was sent the object hears of its end
+            if (sub.published.erase(*c) == 0)
+                continue;
+            mapEncodeObject(*list_, object, true, false);
+        } else {
+            if (deletesOnly)
+                continue;
+            bool changed = object->getConfigChanged() || object->getInstChanged();
+            if (changed)
+                object->setUpdateTime();
+            else if (object->getUpdateTime() <= sub.lastPublish)
+                continue;   // Seen by the last pass, and no different now
 
-        map["_values"] = attrMap;
-        map["_values"].asMap()["_timestamp"] = uint64_t(sys::Duration(sys::EPOCH, sys::now()));
-        map["_values"].asMap()["_heartbeat_interval"] = interval;
-        map["_values"].asMap()["_epoch"] = bootSequence;
+            if (sub.predicate) {
+                Variant::Map values;
+                object->mapEncodeValues(values, true, true);
+                if (changed)
+                    object->setForcePublish(true);  // For the next broadcast
+                if (!sub.predicate->evaluate(values)) {
+                    sub.published.erase(*c);
+                    continue;
+                }
+                list_->beginMap();
+                list_->put("_object_id", object->getObjectId());
+                mapEncodeSchemaId(*list_,
+                                  object->getPackageName(),
+                                  object->getClassName(),
+                                  "_data",
+                                  object->getMd5Sum());
+                object->writeTimestamps(*list_);
+                list_->put("_values", values);
+                list_->end();
+            } else {
+                mapEncodeObject(*list_, object, true, true);
+                if (changed)
+                    object->setForcePublish(true);  // For the next broadcast
+            }
+            sub.published.insert(*c);
+        }
 
-        string content;
-        MapCodec::encode(map, content);
+        if (list_->count() >= maxReplyObjs) {
+            list_->end();
+            pages.push_back(string());
+            list_.reset(new MapEncoder(pages.back()));
+            list_->beginList();
+        }
+    }
+    bool lastEmpty = list_->count() == 0;
+    list_->end();
+    if (lastEmpty)
+        pages.pop_back();
 
-        // Set TTL (in msecs) on outgoing heartbeat indications based on the interval
-        // time to prevent stale heartbeats from getting to the consoles.
-        sendBufferLH(content, "", headers, "amqp/map", v2Topic, addr_key.str(), interval * 2 * 1000);
+    if (!deletesOnly) {
+        sub.lastPublish = sys::Duration(sys::EPOCH, sys::now());
+        sub.nextPublish = sys::AbsTime(sys::now(), sub.interval * sys::TIME_MSEC);
+    }
+    if (pages.empty())
+        return;
 
-        QPID_LOG(debug, "SENT AgentHeartbeat name=" << name_address);
+    // The subscription may be gone once the first page is sent
+    string cid(sub.cid);
+    string rte(sub.replyToEx);
+    string rtk(sub.replyToKey);
+    Variant::Map headers;
+    headers["method"] = "response";
+    headers["qmf.opcode"] = "_data_indication";
+    headers["qmf.content"] = "_data";
+    headers["qmf.agent"] = sub.agentName;
+    headers["partial"] = Variant();
+    std::list<string>::const_iterator last = --pages.end();
+    for (std::list<string>::const_iterator p = pages.begin(); p != pages.end(); ++p) {
+        if (p == last)
+            headers.erase("partial");
+        sendBufferLH(*p, cid, headers, "amqp/list", rte, rtk);   // UNLOCKS USERLOCK
+        QPID_LOG(debug, "SENT SubscriptionInd to=" << rte << "/" << rtk << " len=" << p->length());
     }
 }
 
@@ -1104,6 +1508,7 @@ void ManagementAgent::deleteObjectNowLH(const ObjectId& oid)
             v2key << "." << instanceNameKey;
     }
 
+    unindexObjectLH(object);
     object = 0;
     managementObjects.erase(oid);
 
@@ -1176,6 +1581,7 @@ bool ManagementAgent::dispatchCommand (Deliverable&      deliverable,
                                        const bool topic,
                                        int qmfVersion)
 {
+    QPID_ALLOCATION_SITE(management);
     sys::Mutex::ScopedLock lock (userLock);
     Message&  msg = ((DeliverableMessage&) deliverable).getMessage ();
 
@@ -1827,14 +2233,9 @@ void ManagementAgent::handleGetQueryLH(Buffer& inBuffer, const string& replyToKe
     std::list<ObjectId>matches;
 
     // build up a set of all objects to be dumped
-    for (ManagementObjectMap::iterator iter = managementObjects.begin();
-         iter != managementObjects.end();
-         iter++) {
-        ManagementObject* object = iter->second;
-        if (object->getClassName () == className) {
-            matches.push_back(object->getObjectId());
-        }
-    }
+    ObjectIndex::const_iterator cIter = objectsByClass.find(className);
+    if (cIter != objectsByClass.end())
+        matches.assign(cIter->second.begin(), cIter->second.end());
 
     // send them (as sendBufferLH drops the userLock)
     Buffer   outBuffer (outputBuffer, MA_BUFFER_SIZE);
@@ -1979,60 +2380,42 @@ void ManagementAgent::handleGetQueryLH(const string& body, const string& rte, co
             return;
         }
     } else {
-        // send class-based result.
-        Variant::List _list;
-        Variant::List _subList;
-        unsigned int objCount = 0;
+        // send class-based result, one page of maxReplyObjs objects at a
+        // time.  Sending drops the userLock, so each object is looked up
+        // again as it is encoded.
+        std::vector<ObjectId> matches;
+        ObjectIndex::const_iterator cIter = objectsByClass.find(className);
+        if (cIter != objectsByClass.end())
+            matches.assign(cIter->second.begin(), cIter->second.end());
 
-        for (ManagementObjectMap::iterator iter = managementObjects.begin();
-             iter != managementObjects.end();
-             iter++) {
+        string content;
+        MapEncoder _subList(content);
+        _subList.beginList();
+        headers["partial"] = Variant();
+        for (size_t m = 0; m < matches.size(); m++) {
+            ManagementObjectMap::iterator iter = managementObjects.find(matches[m]);
+            if (iter == managementObjects.end())
+                continue;
             ManagementObject* object = iter->second;
-            if (object->getClassName() == className &&
-                (packageName.empty() || object->getPackageName() == packageName)) {
-
-
-                if (!object->isDeleted()) {
-                    Variant::Map  map_;
-                    Variant::Map values;
-                    Variant::Map oidMap;
-
-                    if (object->getConfigChanged() || object->getInstChanged())
-                        object->setUpdateTime();
-
-                    object->writeTimestamps(map_);
-                    object->mapEncodeValues(values, true, true); // write both stats and properties
-                    iter->first.mapEncode(oidMap);
-
-                    map_["_values"] = values;
-                    map_["_object_id"] = oidMap;
-                    map_["_schema_id"] = mapEncodeSchemaId(object->getPackageName(),
-                                                           object->getClassName(),
-                                                           "_data",
-                                                           object->getMd5Sum());
-                    _subList.push_back(map_);
-                    if (++objCount >= maxReplyObjs) {
-                        objCount = 0;
-                        _list.push_back(_subList);
-                        _subList.clear();
-                    }
-                }
-            }
-        }
+            if (object->isDeleted() ||
+                (!packageName.empty() && object->getPackageName() != packageName))
+                continue;
 
-        if (_subList.size())
-            _list.push_back(_subList);
+            if (object->getConfigChanged() || object->getInstChanged())
+                object->setUpdateTime();
 
-        headers["partial"] = Variant();
-        string content;
-        while (_list.size() > 1) {
-            ListCodec::encode(_list.front().asList(), content);
-            sendBufferLH(content, cid, headers, "amqp/list", rte, rtk);
-            _list.pop_front();
-            QPID_LOG(debug, "SENT QueryResponse (partial, query by schema_id) to=" << rte << "/" << rtk << " len=" << content.length());
+            mapEncodeObject(_subList, object, true, true); // write both stats and properties
+            if (_subList.count() >= maxReplyObjs && m + 1 < matches.size()) {
+                _subList.end();
+                sendBufferLH(content, cid, headers, "amqp/list", rte, rtk);   // drops lock
+                QPID_LOG(debug, "SENT QueryResponse (partial, query by schema_id) to=" << rte << "/" << rtk << " len=" << content.length());
+                content.clear();
+                _subList.beginList();
+            }
         }
+
         headers.erase("partial");
-        ListCodec::encode(_list.size() ? _list.front().asList() : Variant::List(), content);
+        _subList.end();
         sendBufferLH(content, cid, headers, "amqp/list", rte, rtk);
         QPID_LOG(debug, "SENT QueryResponse (query by schema_id) to=" << rte << "/" << rtk << " len=" << content.length());
         return;
@@ -2071,6 +2454,151 @@ void ManagementAgent::handleLocateRequestLH(const string&, const string& rte, co
 }
 
 
+void ManagementAgent::handleSubscribeRequestLH(const string& body, const string& rte, const string& rtk, const string& cid, bool viaLocal)
+{
+    Variant::Map inMap;
+    Variant::Map::const_iterator i;
+
+    MapCodec::decode(body, inMap);
+    QPID_LOG(debug, "RECV SubscribeRequest: map=" << inMap << " seq=" << cid);
+
+    Subscription sub;
+    sub.cid = cid;
+    sub.replyToEx = rte;
+    sub.replyToKey = rtk;
+    sub.agentName = viaLocal ? "broker" : name_address;
+    sub.interval = interval * 1000;
+    sub.duration = DEFAULT_SUBSCRIPTION_DURATION;
+
+    try {
+        i = inMap.find("_query");
+        if (i == inMap.end() || i->second.getType() != qpid::types::VAR_MAP) {
+            sendExceptionLH(rte, rtk, cid, "_query element missing in SubscribeRequest", 1, viaLocal);
+            return;
+        }
+        const Variant::Map& query(i->second.asMap());
+
+        i = query.find("_what");
+        if (i == query.end() || i->second.getType() != qpid::types::VAR_STRING) {
+            sendExceptionLH(rte, rtk, cid, "_what element missing in Query", 1, viaLocal);
+            return;
+        }
+        if (i->second.asString() != "OBJECT") {
+            sendExceptionLH(rte, rtk, cid, "Subscription for _what => '" + i->second.asString() + "' not supported", 1, viaLocal);
+            return;
+        }
+
+        i = query.find("_schema_id");
+        if (i != query.end() && i->second.getType() == qpid::types::VAR_MAP) {
+            const Variant::Map& schemaIdMap(i->second.asMap());
+
+            Variant::Map::const_iterator s_iter = schemaIdMap.find("_class_name");
+            if (s_iter != schemaIdMap.end() && s_iter->second.getType() == qpid::types::VAR_STRING)
+                sub.className = s_iter->second.asString();
+
+            s_iter = schemaIdMap.find("_package_name");
+            if (s_iter != schemaIdMap.end() && s_iter->second.getType() == qpid::types::VAR_STRING)
+                sub.packageName = s_iter->second.asString();
+        }
+
+        i = query.find("_object_id");
+        if (i != query.end() && i->second.getType() == qpid::types::VAR_MAP) {
+            sub.objectId = ObjectId(i->second.asMap());
+            sub.byObjectId = true;
+        }
+
+        i = query.find("_where");
+        if (i != query.end())
+            sub.predicate.reset(new ::qmf::Expression(i->second.asList()));
+
+        i = inMap.find("_interval");
+        if (i != inMap.end())
+            sub.interval = i->second.asUint32();
+        if (sub.interval < MIN_SUBSCRIPTION_INTERVAL)
+            sub.interval = MIN_SUBSCRIPTION_INTERVAL;
+
+        i = inMap.find("_duration");
+        if (i != inMap.end())
+            sub.duration = i->second.asUint32();
+    } catch (const std::exception& e) {
+        sendExceptionLH(rte, rtk, cid, string("Invalid SubscribeRequest: ") + e.what(), 1, viaLocal);
+        return;
+    }
+
+    sys::AbsTime now(sys::now());
+    sub.expires = sys::AbsTime(now, sub.duration * sys::TIME_SEC);
+    sub.nextPublish = now;      // First pass on the next periodic cycle
+    uint64_t id = nextSubscriptionId++;
+    subscriptions[id] = sub;
+    sendSubscribeResponseLH(id, rte, rtk, cid, viaLocal);
+}
+
+
+void ManagementAgent::handleSubscribeRefreshLH(const string& body, const string& rte, const string& rtk, const string& cid, bool viaLocal)
+{
+    Variant::Map inMap;
+    Variant::Map::const_iterator i;
+
+    MapCodec::decode(body, inMap);
+    QPID_LOG(debug, "RECV SubscribeRefresh: map=" << inMap << " seq=" << cid);
+
+    try {
+        i = inMap.find("_subscription_id");
+        Subscriptions::iterator s = i == inMap.end() ?
+            subscriptions.end() : subscriptions.find(i->second.asUint64());
+        if (s == subscriptions.end()) {
+            sendExceptionLH(rte, rtk, cid, "Unknown subscription", 1, viaLocal);
+            return;
+        }
+        i = inMap.find("_duration");
+        if (i != inMap.end())
+            s->second.duration = i->second.asUint32();
+        s->second.expires = sys::AbsTime(sys::now(), s->second.duration * sys::TIME_SEC);
+        sendSubscribeResponseLH(s->first, rte, rtk, cid, viaLocal);
+    } catch (const std::exception& e) {
+        sendExceptionLH(rte, rtk, cid, string("Invalid SubscribeRefresh: ") + e.what(), 1, viaLocal);
+    }
+}
+
+
+void ManagementAgent::handleSubscribeCancelLH(const string& body)
+{
+    Variant::Map inMap;
+
+    MapCodec::decode(body, inMap);
+    QPID_LOG(debug, "RECV SubscribeCancel: map=" << inMap);
+
+    Variant::Map::const_iterator i = inMap.find("_subscription_id");
+    if (i == inMap.end())
+        return;
+    try {
+        subscriptions.erase(i->second.asUint64());
+    } catch (const std::exception&) {}
+}
+
+
+void ManagementAgent::sendSubscribeResponseLH(uint64_t id, const string& rte, const string& rtk, const string& cid, bool viaLocal)
+{
+    const Subscription& sub = subscriptions[id];
+    Variant::Map map;
+    Variant::Map headers;
+
+    headers["method"] = "response";
+    headers["qmf.opcode"] = "_subscribe_response";
+    headers["qmf.agent"] = viaLocal ? "broker" : name_address;
+
+    map["_subscription_id"] = id;
+    map["_interval"] = sub.interval;
+    map["_duration"] = sub.duration;
+
+    string content;
+    MapCodec::encode(map, content);
+    sendBufferLH(content, cid, headers, "amqp/map", rte, rtk);
+
+    QPID_LOG(debug, "SENT SubscribeResponse id=" << id << " replyTo=" << rte << "/" << rtk);
+}
+
+
 bool ManagementAgent::authorizeAgentMessageLH(Message& msg)
 {
     Buffer   inBuffer (inputBuffer, MA_BUFFER_SIZE);
@@ -2111,27 +2639,24 @@ bool ManagementAgent::authorizeAgentMessageLH(Message& msg)
         {
             methodReq = true;
 
-            // extract object id and method name
-
-            string body;
-            inBuffer.getRawData(body, bufferLen);
-            Variant::Map inMap;
-            MapCodec::decode(body, inMap);
-            Variant::Map::const_iterator oid, mid;
+            // extract object id and method name, reading the body in
+            // place as the method arguments are not needed here
 
             ObjectId objId;
 
-            if ((oid = inMap.find("_object_id")) == inMap.end() ||
-                (mid = inMap.find("_method_name")) == inMap.end()) {
-                QPID_LOG(warning,
-                         "Missing fields in QMF authorize req received.");
-                return false;
-            }
-
             try {
+                amqp_0_10::MapView inMap(inBuffer.getPointer(), bufferLen);
+                amqp_0_10::ValueView oid, mid;
+
+                if (!inMap.find("_object_id", oid) || !inMap.find("_method_name", mid)) {
+                    QPID_LOG(warning,
+                             "Missing fields in QMF authorize req received.");
+                    return false;
+                }
+
                 // coversions will throw if input is invalid.
-                objId = ObjectId(oid->second.asMap());
-                methodName = mid->second.getString();
+                objId = ObjectId(oid.toVariant().asMap());
+                methodName = mid.asString();
             } catch(exception& /*e*/) {
                 QPID_LOG(warning,
                          "Badly formatted QMF authorize req received.");
@@ -2272,6 +2797,12 @@ void ManagementAgent::dispatchAgentCommandLH(Message& msg, bool viaLocal)
             return handleGetQueryLH(body, rte, rtk, cid, viaLocal);
         else if (opcode == "_agent_locate_request")
             return handleLocateRequestLH(body, rte, rtk, cid);
+        else if (opcode == "_subscribe_request")
+            return handleSubscribeRequestLH(body, rte, rtk, cid, viaLocal);
+        else if (opcode == "_subscribe_refresh_indication")
+            return handleSubscribeRefreshLH(body, rte, rtk, cid, viaLocal);
+        else if (opcode == "_subscribe_cancel_indication")
+            return handleSubscribeCancelLH(body);
 
         QPID_LOG(warning, "Support for QMF Opcode [" << opcode << "] TBD!!!");
         return;
@@ -2466,13 +2997,13 @@ size_t ManagementAgent::validateEventSchema(Buffer& inBuffer)
 
 ManagementObjectMap::iterator ManagementAgent::numericFind(const ObjectId& oid)
 {
-    ManagementObjectMap::iterator iter = managementObjects.begin();
-    for (; iter != managementObjects.end(); iter++) {
-        if (oid.equalV1(iter->first))
-            break;
-    }
-
-    return iter;
+    string v1Id;
+    oid.encode(v1Id);
+    ObjectIndex::const_iterator i = objectsByV1Id.find(v1Id);
+    if (i == objectsByV1Id.end())
+        return managementObjects.end();
+    // The first in map order, should V1 ids clash.
+    return managementObjects.find(*i->second.begin());
 }
 
 void ManagementAgent::disallow(const string& className, const string& methodName, const string& message) {
@@ -2799,6 +3330,7 @@ void ManagementAgent::importDeletedObjects(const DeletedObjectList& inList)
     while (i != managementObjects.end()) {
         ManagementObject* object = i->second;
         if (object->isDeleted()) {
+            unindexObjectLH(object);
             delete object;
             managementObjects.erase(i++);
         }
@@ -2910,6 +3442,7 @@ bool ManagementAgent::moveDeletedObjectsLH() {
         DeletedObject::shared_ptr dptr(new DeletedObject(delObj, qmf1Support, qmf2Support));
 
         pendingDeletedObjs[dptr->getKey()].push_back(dptr);
+        unindexObjectLH(delObj);
         managementObjects.erase(iter->first);
         delete iter->second;
     }
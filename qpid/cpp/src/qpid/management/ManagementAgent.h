@@ -36,9 +36,17 @@
 #include <qpid/framing/AMQFrame.h>
 #include <qpid/framing/FieldValue.h>
 #include <qpid/framing/ResizableBuffer.h>
+#include <boost/shared_ptr.hpp>
 #include <memory>
 #include <string>
 #include <map>
+#include <set>
+#include <deque>
+#include <list>
+
+namespace qmf {
+class Expression;
+}
 
 namespace qpid {
 namespace broker {
@@ -69,9 +77,13 @@ public:
     ManagementAgent (const bool qmfV1, const bool qmfV2);
     virtual ~ManagementAgent ();
 
-    /** Called before plugins are initialized */
+    /**
+     * Called before plugins are initialized. Object updates are published
+     * in @a slices evenly spaced parts of each @a interval seconds.
+     */
     void configure       (const std::string& dataDir, uint16_t interval,
-                          qpid::broker::Broker* broker, int threadPoolSize);
+                          qpid::broker::Broker* broker, int threadPoolSize,
+                          uint16_t slices = 1);
     /** Called after plugins are initialized. */
     void pluginsInitialized();
 
@@ -85,6 +97,12 @@ public:
     const std::string& getAddress();
 
     void setInterval(uint16_t _interval) { interval = _interval; }
+    /** Objects added with addDeferredObject() are held back until they are this old */
+    void setMinLifetime(sys::Duration d) { minLifetime = d; }
+    /** Publish at most rate events per second, 0 for no limit */
+    void setEventRate(uint32_t rate) { eventRate = rate; }
+    /** Count statistics of sampled classes one update in every N */
+    void setStatsSampling(uint32_t every) { ManagementObject::sampleInterval = every ? every : 1; }
     void setExchange(qpid::broker::Exchange::shared_ptr mgmtExchange,
                      qpid::broker::Exchange::shared_ptr directExchange);
     void setExchangeV2(qpid::broker::Exchange::shared_ptr topicExchange,
@@ -105,8 +123,23 @@ public:
     QPID_BROKER_EXTERN ObjectId addObject   (ManagementObject*  object,
                                              const std::string& key,
                                              bool               persistent = false);
+    /**
+     * Like addObject, for objects that are often short-lived, such as
+     * connections and sessions. The object is not published until it
+     * has existed for the minimum lifetime, or a console queries the
+     * agent; if it is deleted before then, nothing of it is published.
+     */
+    QPID_BROKER_EXTERN ObjectId addDeferredObject(ManagementObject* object,
+                                                  uint64_t          persistId = 0);
+    /**
+     * Publish an event. Outside a cluster it is encoded now, only for
+     * the QMF versions that have subscribers, and published later from
+     * the timer. If source is not empty, a later event of the same
+     * class from the same source replaces one not yet published.
+     */
     QPID_BROKER_EXTERN void raiseEvent(const ManagementEvent& event,
-                                       severity_t severity = SEV_DEFAULT);
+                                       severity_t severity = SEV_DEFAULT,
+                                       const std::string& source = std::string());
     QPID_BROKER_EXTERN void clientAdded     (const std::string& routingKey);
 
     QPID_BROKER_EXTERN void clusterUpdate();
@@ -191,11 +224,19 @@ private:
     {
         ManagementAgent& agent;
 
-        Periodic (ManagementAgent& agent, uint32_t seconds);
+        Periodic (ManagementAgent& agent, sys::Duration period);
         virtual ~Periodic ();
         void fire ();
     };
 
+    struct EventFlush : public qpid::sys::TimerTask
+    {
+        ManagementAgent& agent;
+
+        EventFlush (ManagementAgent& agent, sys::Duration delay);
+        void fire ();
+    };
+
     //  Storage for tracking remote management agents, attached via the client
     //  management agent API.
     //
@@ -279,11 +320,46 @@ private:
     //
     ManagementObjectMap          managementObjects;
 
+    //
+    // Indexes on managementObjects, so that a query for one class or for
+    // a QMFv1 numeric id need not walk every object. Entries are made and
+    // removed with the object's entry in managementObjects.  Protected by
+    // userLock.
+    //
+    typedef std::map<std::string, std::set<ObjectId> > ObjectIndex;
+    ObjectIndex                  objectsByClass;  // By class name
+    ObjectIndex                  objectsByV1Id;   // By encoded V1 id
+
+    //
+    // Each periodicProcessing() publishes the changed objects in the next
+    // share of managementObjects, so that an interval's updates go out in
+    // publishSlices parts rather than in one burst.  Objects new since the
+    // last one are published straight away, wherever they fall. Protected
+    // by userLock.
+    //
+    uint16_t                     publishSlices;
+    uint16_t                     publishSlice;   // Next slice to publish
+    ObjectId                     publishCursor;  // Last object published
+    uint64_t                     acceptedReported; // Connections accepted as of the last update
+    std::vector<ObjectId>        addedObjects;
+
     //
     // Protected by addLock
     //
     ManagementObjectVector       newManagementObjects;
 
+    //
+    // Objects from addDeferredObject() not yet old enough to join
+    // newManagementObjects, oldest first.  Protected by addLock.
+    //
+    struct DeferredObject {
+        ManagementObject* object;
+        sys::AbsTime added;
+        DeferredObject(ManagementObject* o, sys::AbsTime t) : object(o), added(t) {}
+    };
+    std::deque<DeferredObject>   deferredObjects;
+    sys::Duration                minLifetime;
+
     framing::Uuid                uuid;
 
     //
@@ -337,6 +413,64 @@ private:
     typedef std::map<std::string, DeletedObjectList> PendingDeletedObjsMap;
     PendingDeletedObjsMap pendingDeletedObjs;
 
+    //
+    // QMFv2 subscriptions: a console asks for the objects a query selects,
+    // optionally filtered by a _where predicate, and is sent only those of
+    // them that change, no more often than the interval it asked for.  A
+    // subscription lapses unless it is refreshed within its duration.
+    // Protected by userLock.
+    //
+    struct Subscription {
+        std::string cid;            // Correlates the data indications
+        std::string replyToEx;
+        std::string replyToKey;
+        std::string agentName;
+        std::string packageName;    // Empty for any
+        std::string className;      // Empty for any
+        ObjectId objectId;          // Unset unless for one object
+        bool byObjectId;
+        boost::shared_ptr< ::qmf::Expression> predicate;
+        uint32_t interval;          // Milliseconds
+        uint32_t duration;          // Seconds
+        sys::AbsTime expires;
+        sys::AbsTime nextPublish;
+        uint64_t lastPublish;       // Of the last pass, in ns since the epoch
+        std::set<ObjectId> published;   // Sent, and matching when last seen
+        Subscription() : byObjectId(false), interval(0), duration(0), lastPublish(0) {}
+    };
+    typedef std::map<uint64_t, Subscription> Subscriptions;
+    Subscriptions subscriptions;
+    uint64_t nextSubscriptionId;
+
+    //
+    // Events raised but not yet published, oldest first, encoded for the
+    // QMF versions that had subscribers when they were raised. At most
+    // eventRate are published in each second. Protected by eventLock,
+    // which is never held while taking userLock.
+    //
+    struct PendingEvent {
+        std::string packageName;
+        std::string eventName;
+        std::string source;
+        uint8_t md5Sum[16];
+        uint8_t severity;
+        uint64_t timestamp;
+        bool v1;
+        bool v2;
+        std::string v1Args;
+        qpid::types::Variant::Map v2Values;
+    };
+    std::list<PendingEvent> pendingEvents;
+    sys::Mutex eventLock;
+    bool eventFlushScheduled;
+    uint32_t eventRate;
+    sys::AbsTime eventWindowStart;
+    uint32_t eventsInWindow;
+    uint64_t eventsDropped;
+    static const size_t MAX_PENDING_EVENTS;
+    static const uint32_t MIN_SUBSCRIPTION_INTERVAL;   // milliseconds
+    static const uint32_t DEFAULT_SUBSCRIPTION_DURATION;   // seconds
+
 #   define MA_BUFFER_SIZE 65536
     char inputBuffer[MA_BUFFER_SIZE];
     char outputBuffer[MA_BUFFER_SIZE];
@@ -345,6 +479,8 @@ private:
 
     void writeData ();
     void periodicProcessing (void);
+    void flushEvents();
+    void sendEventLH(const PendingEvent& event);
     void deleteObjectNowLH(const ObjectId& oid);
     void encodeHeader       (framing::Buffer& buf, uint8_t  opcode, uint32_t  seq = 0);
     bool checkHeader        (framing::Buffer& buf, uint8_t *opcode, uint32_t *seq);
@@ -370,8 +506,17 @@ private:
                       const std::string& exchange,
                       const std::string& routingKey,
                       uint64_t ttl_msec = 0);
-    void moveNewObjectsLH();
+    void moveNewObjectsLH(bool all = true);
+    ObjectId assignV1Id(ManagementObject* object, uint64_t persistId, bool persistent);
     bool moveDeletedObjectsLH();
+    void indexObjectLH(ManagementObject* object);
+    void unindexObjectLH(ManagementObject* object);
+    void publishObjectsLH(const std::string& packageName,
+                          const std::string& className,
+                          const std::vector<ObjectId>& oids);
+    sys::Duration publishPeriod() const;
+    void publishSubscriptionsLH(bool reaping);
+    void publishSubscriptionLH(uint64_t id, bool deletesOnly);
 
     bool authorizeAgentMessageLH(qpid::broker::Message& msg);
     void dispatchAgentCommandLH(qpid::broker::Message& msg, bool viaLocal=false);
@@ -408,6 +553,10 @@ private:
     void handleGetQueryLH       (const std::string& body, const std::string& replyToEx, const std::string& replyToKey, const std::string& cid, bool viaLocal);
     void handleMethodRequestLH  (const std::string& body, const std::string& replyToEx, const std::string& replyToKey, const std::string& cid, const qpid::broker::ConnectionToken* connToken, bool viaLocal);
     void handleLocateRequestLH  (const std::string& body, const std::string& replyToEx, const std::string &replyToKey, const std::string& cid);
+    void handleSubscribeRequestLH (const std::string& body, const std::string& replyToEx, const std::string& replyToKey, const std::string& cid, bool viaLocal);
+    void handleSubscribeRefreshLH (const std::string& body, const std::string& replyToEx, const std::string& replyToKey, const std::string& cid, bool viaLocal);
+    void handleSubscribeCancelLH  (const std::string& body);
+    void sendSubscribeResponseLH  (uint64_t id, const std::string& replyToEx, const std::string& replyToKey, const std::string& cid, bool viaLocal);
 
 
     size_t validateSchema(framing::Buffer&, uint8_t kind);
@@ -29,6 +29,7 @@
 #include <boost/lexical_cast.hpp>
 
 #include <stdlib.h>
+#include <string.h>
 
 using namespace std;
 using namespace qpid;
@@ -198,6 +199,15 @@ void ObjectId::mapEncode(types::Variant::Map& map) const
         map["_agent_epoch"] = agentEpoch;
 }
 
+void ObjectId::mapEncode(MapEncoder& map) const
+{
+    if (agentEpoch)
+        map.put("_agent_epoch", agentEpoch);
+    if (!agentName.empty())
+        map.put("_agent_name", agentName);
+    map.put("_object_name", v2Key);
+}
+
 // decode as v2-format map
 void ObjectId::mapDecode(const types::Variant::Map& map)
 {
@@ -264,6 +274,7 @@ void ManagementObject::resourceDestroy()
 }
 
 int ManagementObject::maxThreads = 1;
+uint32_t ManagementObject::sampleInterval = 1;
 int ManagementObject::nextThreadIndex = 0;
 
 void ManagementObject::writeTimestamps (string& buf) const
@@ -335,6 +346,23 @@ void ManagementObject::writeTimestamps (types::Variant::Map& map) const
     map["_delete_ts"] = destroyTime;
 }
 
+void ManagementObject::writeTimestamps (MapEncoder& map) const
+{
+    map.put("_update_ts", updateTime);
+    map.put("_create_ts", createTime);
+    map.put("_delete_ts", destroyTime);
+}
+
+void ManagementObject::mapEncodeValues(MapEncoder& map,
+                                       bool includeProperties,
+                                       bool includeStatistics)
+{
+    types::Variant::Map values;
+    mapEncodeValues(values, includeProperties, includeStatistics);
+    for (types::Variant::Map::const_iterator i = values.begin(); i != values.end(); ++i)
+        map.put(i->first, i->second);
+}
+
 void ManagementObject::readTimestamps (const types::Variant::Map& map)
 {
     types::Variant::Map::const_iterator i;
@@ -361,6 +389,36 @@ int ManagementObject::getThreadIndex() {
     return thisIndex;
 }
 
+bool ManagementObject::sampleNext(uint32_t every) {
+    // xorshift, so that counters updated together in a fixed order are
+    // not always sampled together or always skipped
+    static QPID_TSS uint32_t state = 0;
+    if (state == 0) state = uint32_t(reinterpret_cast<uintptr_t>(&state)) | 1;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state % every == 0;
+}
+
+namespace {
+const size_t CacheLineSize = 64;
+}
+
+void* ManagementObject::allocThreadStats(size_t size) {
+    // Round up to whole lines and keep the start of the allocation just
+    // before the aligned block so it can be freed.
+    size_t lines = (size + CacheLineSize - 1) / CacheLineSize;
+    char* raw = new char[lines * CacheLineSize + CacheLineSize + sizeof(char*)];
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw + sizeof(char*));
+    char* aligned = reinterpret_cast<char*>((start + CacheLineSize - 1) & ~(uintptr_t(CacheLineSize) - 1));
+    reinterpret_cast<char**>(aligned)[-1] = raw;
+    ::memset(aligned, 0, lines * CacheLineSize);
+    return aligned;
+}
+
+void ManagementObject::freeThreadStats(void* stats) {
+    if (stats) delete[] reinterpret_cast<char**>(stats)[-1];
+}
 
 // void ManagementObject::mapEncode(types::Variant::Map& map,
 //                                  bool includeProperties,
@@ -0,0 +1,291 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/management/MapEncoder.h"
+#include "qpid/management/ManagementObject.h"
+#include "qpid/amqp_0_10/Codecs.h"
+#include "qpid/Exception.h"
+#include "qpid/Msg.h"
+#include <limits>
+#include <string.h>
+
+using std::string;
+using namespace qpid::types;
+
+namespace qpid {
+namespace management {
+
+namespace {
+// AMQP 0-10 type codes, as amqp_0_10::MapCodec uses them; it writes
+// 8-bit integers as int8 and bin8, which decoders already expect.
+const uint8_t BOOL(0x08);
+const uint8_t UINT8(0x02);
+const uint8_t UINT16(0x12);
+const uint8_t UINT32(0x22);
+const uint8_t UINT64(0x32);
+const uint8_t INT8(0x01);
+const uint8_t INT16(0x11);
+const uint8_t INT32(0x21);
+const uint8_t INT64(0x31);
+const uint8_t FLOAT(0x23);
+const uint8_t DOUBLE(0x33);
+const uint8_t UUID(0x48);
+const uint8_t VBIN16(0x90);
+const uint8_t VBIN32(0xa0);
+const uint8_t MAP(0xa8);
+const uint8_t LIST(0xa9);
+
+// The size and count that start an encoded map or list
+const size_t HEADER_SIZE(8);
+}
+
+MapEncoder::MapEncoder(string& o) : out(o) {}
+
+void MapEncoder::putUint8(uint8_t i)
+{
+    out.push_back(static_cast<char>(i));
+}
+
+void MapEncoder::putUint16(uint16_t i)
+{
+    putUint8(i >> 8);
+    putUint8(i);
+}
+
+void MapEncoder::putUint32(uint32_t i)
+{
+    putUint16(i >> 16);
+    putUint16(i);
+}
+
+void MapEncoder::putUint64(uint64_t i)
+{
+    putUint32(i >> 32);
+    putUint32(i);
+}
+
+void MapEncoder::entry(const string* key)
+{
+    if (open.empty())
+        throw Exception("A value must be put in a map or list");
+    Container& c = open.back();
+    if (c.isMap) {
+        if (!key)
+            throw Exception("A value put in a map needs a key");
+        if (key->size() > std::numeric_limits<uint8_t>::max())
+            throw Exception(QPID_MSG("Map key too long: " << *key));
+        putUint8(key->size());
+        out.append(*key);
+    } else if (key) {
+        throw Exception(QPID_MSG("A value put in a list has no key: " << *key));
+    }
+    ++c.count;
+}
+
+void MapEncoder::begin(const string* key, bool isMap)
+{
+    if (!open.empty()) {
+        entry(key);
+        putUint8(isMap ? MAP : LIST);
+    }
+    open.push_back(Container(out.size(), isMap));
+    putUint32(0);               // Size and count, filled in by end()
+    putUint32(0);
+}
+
+void MapEncoder::beginMap() { begin(0, true); }
+void MapEncoder::beginMap(const string& key) { begin(&key, true); }
+void MapEncoder::beginList() { begin(0, false); }
+void MapEncoder::beginList(const string& key) { begin(&key, false); }
+
+void MapEncoder::end()
+{
+    if (open.empty())
+        throw Exception("No map or list to end");
+    const Container& c = open.back();
+    uint32_t size = out.size() - c.start - 4;
+    char header[HEADER_SIZE];
+    for (int i = 0; i < 4; ++i) {
+        header[i]     = static_cast<char>(size    >> (24 - 8*i));
+        header[4 + i] = static_cast<char>(c.count >> (24 - 8*i));
+    }
+    out.replace(c.start, HEADER_SIZE, header, HEADER_SIZE);
+    open.pop_back();
+}
+
+uint32_t MapEncoder::count() const
+{
+    return open.empty() ? 0 : open.back().count;
+}
+
+void MapEncoder::put(const string& key, bool b)
+{
+    entry(&key);
+    putUint8(BOOL);
+    putUint8(b ? 1 : 0);
+}
+
+void MapEncoder::put(const string& key, uint8_t i)
+{
+    entry(&key);
+    putUint8(UINT8);
+    putUint8(i);
+}
+
+void MapEncoder::put(const string& key, uint16_t i)
+{
+    entry(&key);
+    putUint8(UINT16);
+    putUint16(i);
+}
+
+void MapEncoder::put(const string& key, uint32_t i)
+{
+    entry(&key);
+    putUint8(UINT32);
+    putUint32(i);
+}
+
+void MapEncoder::put(const string& key, uint64_t i)
+{
+    entry(&key);
+    putUint8(UINT64);
+    putUint64(i);
+}
+
+void MapEncoder::put(const string& key, int8_t i)
+{
+    entry(&key);
+    putUint8(INT8);
+    putUint8(i);
+}
+
+void MapEncoder::put(const string& key, int16_t i)
+{
+    entry(&key);
+    putUint8(INT16);
+    putUint16(i);
+}
+
+void MapEncoder::put(const string& key, int32_t i)
+{
+    entry(&key);
+    putUint8(INT32);
+    putUint32(i);
+}
+
+void MapEncoder::put(const string& key, int64_t i)
+{
+    entry(&key);
+    putUint8(INT64);
+    putUint64(i);
+}
+
+void MapEncoder::put(const string& key, float f)
+{
+    uint32_t i;
+    ::memcpy(&i, &f, sizeof(i));
+    entry(&key);
+    putUint8(FLOAT);
+    putUint32(i);
+}
+
+void MapEncoder::put(const string& key, double f)
+{
+    uint64_t i;
+    ::memcpy(&i, &f, sizeof(i));
+    entry(&key);
+    putUint8(DOUBLE);
+    putUint64(i);
+}
+
+void MapEncoder::put(const string& key, const string& s)
+{
+    entry(&key);
+    if (s.size() > std::numeric_limits<uint16_t>::max()) {
+        putUint8(VBIN32);
+        putUint32(s.size());
+    } else {
+        putUint8(VBIN16);
+        putUint16(s.size());
+    }
+    out.append(s);
+}
+
+void MapEncoder::put(const string& key, const char* s)
+{
+    put(key, string(s));
+}
+
+void MapEncoder::put(const string& key, const Uuid& u)
+{
+    entry(&key);
+    putUint8(UUID);
+    out.append(reinterpret_cast<const char*>(u.data()), Uuid::SIZE);
+}
+
+void MapEncoder::put(const string& key, const ObjectId& oid)
+{
+    beginMap(key);
+    oid.mapEncode(*this);
+    end();
+}
+
+void MapEncoder::put(const string& key, const Variant::Map& map)
+{
+    entry(&key);
+    putUint8(MAP);
+    string encoded;
+    amqp_0_10::MapCodec::encode(map, encoded);
+    out.append(encoded);
+}
+
+void MapEncoder::put(const string& key, const Variant::List& list)
+{
+    entry(&key);
+    putUint8(LIST);
+    string encoded;
+    amqp_0_10::ListCodec::encode(list, encoded);
+    out.append(encoded);
+}
+
+namespace {
+// The type code and value the codecs give @a value
+void encodeValue(const Variant& value, string& out)
+{
+    string encoded;
+    amqp_0_10::ListCodec::encode(Variant::List(1, value), encoded);
+    out.append(encoded, HEADER_SIZE, string::npos);
+}
+}
+
+void MapEncoder::put(const string& key, const Variant& value)
+{
+    entry(&key);
+    encodeValue(value, out);
+}
+
+void MapEncoder::put(const Variant& value)
+{
+    entry(0);
+    encodeValue(value, out);
+}
+
+}} // namespace qpid::management
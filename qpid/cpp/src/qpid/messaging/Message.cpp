@@ -73,16 +73,17 @@ void Message::setProperty(const std::string& k, const qpid::types::Variant& v) {
 
 void Message::setContent(const std::string& c) { impl->setBytes(c); }
 void Message::setContent(const char* chars, size_t count) { impl->setBytes(chars, count); }
-std::string Message::getContent() const { return impl->getBytes(); }
+std::string Message::getContent() const { return std::string(impl->getBytesPtr(), impl->getBytesSize()); }
+void Message::swapContent(std::string& c) { impl->swapBytes(c); }
 
 const char* Message::getContentPtr() const
 {
-    return impl->getBytes().data();
+    return impl->getBytesPtr();
 }
 
 size_t Message::getContentSize() const
 {
-    return impl->getBytes().size();
+    return impl->getBytesSize();
 }
 
 EncodingException::EncodingException(const std::string& msg) : qpid::types::Exception(msg) {}
@@ -129,7 +130,7 @@ template <class C> struct MessageCodec
         std::string content;
         C::encode(map, content);
         message.setContentType(C::contentType);
-        message.setContent(content);
+        message.swapContent(content);
     }
 };
 
@@ -20,6 +20,7 @@
  */
 #include "MessageImpl.h"
 #include "qpid/messaging/Message.h"
+#include "qpid/framing/AMQContentBody.h"
 
 namespace qpid {
 namespace messaging {
@@ -59,10 +60,33 @@ Variant::Map& MessageImpl::getHeaders() { return headers; }
 void MessageImpl::setHeader(const std::string& key, const qpid::types::Variant& val) { headers[key] = val; }
 
 //should these methods be on MessageContent?
-void MessageImpl::setBytes(const std::string& c) { bytes = c; }
-void MessageImpl::setBytes(const char* chars, size_t count) { bytes.assign(chars, count); }
-const std::string& MessageImpl::getBytes() const { return bytes; }
-std::string& MessageImpl::getBytes() { return bytes; }
+void MessageImpl::setBytes(const std::string& c) { ref = qpid::ConstBufferRef(); bytes = c; }
+void MessageImpl::setBytes(const char* chars, size_t count) { ref = qpid::ConstBufferRef(); bytes.assign(chars, count); }
+void MessageImpl::setBytes(const qpid::ConstBufferRef& r) { ref = r; bytes.clear(); }
+const std::string& MessageImpl::getBytes() const { if (ref.begin()) materialize(); return bytes; }
+std::string& MessageImpl::getBytes() { if (ref.begin()) materialize(); return bytes; }
+void MessageImpl::swapBytes(std::string& c) { getBytes().swap(c); }
+
+void MessageImpl::materialize() const
+{
+    bytes.assign(ref.begin(), ref.end());
+    ref = qpid::ConstBufferRef();
+}
+
+qpid::ConstBufferRef MessageImpl::getBytesRef() const
+{
+    if (!ref.begin()) {
+        // Hand the bytes over to a content body, which copies of this
+        // message and the frames that send it can then all share
+        boost::intrusive_ptr<qpid::framing::AMQContentBody> body(new qpid::framing::AMQContentBody());
+        body->getData().swap(bytes);
+        ref = body->slice(0, body->encodedSize());
+    }
+    return ref;
+}
+
+const char* MessageImpl::getBytesPtr() const { return ref.begin() ? ref.begin() : bytes.data(); }
+size_t MessageImpl::getBytesSize() const { return ref.begin() ? ref.end() - ref.begin() : bytes.size(); }
 
 void MessageImpl::setInternalId(qpid::framing::SequenceNumber i) { internalId = i; }
 qpid::framing::SequenceNumber MessageImpl::getInternalId() { return internalId; }
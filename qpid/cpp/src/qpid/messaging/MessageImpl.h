@@ -24,6 +24,7 @@
 #include "qpid/messaging/Address.h"
 #include "qpid/types/Variant.h"
 #include "qpid/framing/SequenceNumber.h"
+#include "qpid/BufferRef.h"
 
 namespace qpid {
 namespace messaging {
@@ -42,7 +43,11 @@ struct MessageImpl
     bool redelivered;
     qpid::types::Variant::Map headers;
 
-    std::string bytes;
+    mutable std::string bytes;
+    /** If set, the content is shared with a refcounted buffer (the
+     * body of a received frame, or one the content was handed to for
+     * sending) and bytes is only populated when asked for. */
+    mutable qpid::ConstBufferRef ref;
 
     qpid::framing::SequenceNumber internalId;
 
@@ -66,10 +71,23 @@ struct MessageImpl
     void setBytes(const char* chars, size_t count);
     const std::string& getBytes() const;
     std::string& getBytes();
+    void swapBytes(std::string& bytes);
+    /** Share the content without copying; it must not be modified */
+    void setBytes(const qpid::ConstBufferRef& ref);
+    /**
+     * Return a reference to the content that can be held after this
+     * message changes or goes away, moving the content into a
+     * refcounted buffer first if it is not already in one.
+     */
+    qpid::ConstBufferRef getBytesRef() const;
+    const char* getBytesPtr() const;
+    size_t getBytesSize() const;
 
     void setInternalId(qpid::framing::SequenceNumber id);
     qpid::framing::SequenceNumber getInternalId();
 
+  private:
+    void materialize() const;
 };
 
 class Message;
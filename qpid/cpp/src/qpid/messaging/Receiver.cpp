@@ -34,6 +34,7 @@ Receiver::Receiver(const Receiver& s) : Handle<ReceiverImpl>() { PI::copy(*this,
 Receiver::~Receiver() { PI::dtor(*this); }
 Receiver& Receiver::operator=(const Receiver& s) { return PI::assign(*this, s); }
 bool Receiver::get(Message& message, Duration timeout) { return impl->get(message, timeout); }
+void Receiver::setListener(MessageListener* listener) { impl->setListener(listener); }
 Message Receiver::get(Duration timeout) { return impl->get(timeout); }
 bool Receiver::fetch(Message& message, Duration timeout) { return impl->fetch(message, timeout); }
 Message Receiver::fetch(Duration timeout) { return impl->fetch(timeout); }
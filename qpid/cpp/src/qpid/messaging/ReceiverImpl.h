@@ -42,6 +42,7 @@ class ReceiverImpl : public virtual qpid::RefCounted
     virtual uint32_t getCapacity() = 0;
     virtual uint32_t getAvailable() = 0;
     virtual uint32_t getUnsettled() = 0;
+    virtual void setListener(MessageListener* listener) = 0;
     virtual void close() = 0;
     virtual const std::string& getName() const = 0;
     virtual Session getSession() const = 0;
@@ -22,6 +22,7 @@
  *
  */
 #include "qpid/RefCounted.h"
+#include <vector>
 
 namespace qpid {
 namespace messaging {
@@ -34,6 +35,7 @@ class SenderImpl : public virtual qpid::RefCounted
   public:
     virtual ~SenderImpl() {}
     virtual void send(const Message& message, bool sync) = 0;
+    virtual void send(const std::vector<Message>& messages, bool sync) = 0;
     virtual void close() = 0;
     virtual void setCapacity(uint32_t) = 0;
     virtual uint32_t getCapacity() = 0;
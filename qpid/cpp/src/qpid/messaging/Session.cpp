@@ -44,6 +44,8 @@ void Session::acknowledgeUpTo(Message& m, bool s) { impl->acknowledge(m, true);
 void Session::reject(Message& m) { impl->reject(m); }
 void Session::release(Message& m) { impl->release(m); }
 void Session::close() { impl->close(); }
+void Session::startDispatch() { impl->startDispatch(); }
+void Session::stopDispatch() { impl->stopDispatch(); }
 
 Sender Session::createSender(const Address& address)
 {
@@ -50,6 +50,8 @@ class SessionImpl : public virtual qpid::RefCounted
     virtual Receiver createReceiver(const Address& address) = 0;
     virtual bool nextReceiver(Receiver& receiver, Duration timeout) = 0;
     virtual Receiver nextReceiver(Duration timeout) = 0;
+    virtual void startDispatch() = 0;
+    virtual void stopDispatch() = 0;
     virtual uint32_t getReceivable() = 0;
     virtual uint32_t getUnsettledAcks() = 0;
     virtual Sender getSender(const std::string& name) const = 0;
@@ -23,7 +23,9 @@
 #include "qpid/broker/Broker.h"
 #include "qpid/broker/DeliverableMessage.h"
 #include "qpid/broker/QueueEvents.h"
+#include "qpid/framing/AMQContentBody.h"
 #include "qpid/framing/AMQFrame.h"
+#include "qpid/framing/Buffer.h"
 #include "qpid/framing/FrameHandler.h"
 #include "qpid/framing/MessageTransferBody.h"
 #include "qpid/log/Statement.h"
@@ -52,10 +54,26 @@ void ReplicatingEventListener::handle(QueueEvents::Event event)
 
 namespace {
 const std::string EMPTY;
+// A sequence set encodes its ranges behind a 16 bit size
+const size_t MAX_RANGES(0xffff / 8);
 }
 
 void ReplicatingEventListener::deliverDequeueMessage(const QueuedMessage& dequeued)
 {
+    if (options.dequeueBatch > 1) {
+        SequenceSet full;
+        {
+            sys::Mutex::ScopedLock l(lock);
+            SequenceSet& positions = dequeues[dequeued.queue->getName()];
+            positions.add(dequeued.position);
+            if (positions.size() >= options.dequeueBatch || positions.rangesSize() >= MAX_RANGES) {
+                full.add(positions);
+                dequeues.erase(dequeued.queue->getName());
+            }
+        }
+        if (!full.empty()) deliverDequeueMessages(dequeued.queue->getName(), full);
+        return;
+    }
     FieldTable headers;
     headers.setString(REPLICATION_TARGET_QUEUE, dequeued.queue->getName());
     headers.setInt(REPLICATION_EVENT_TYPE, DEQUEUE);
@@ -66,6 +84,32 @@ void ReplicatingEventListener::deliverDequeueMessage(const QueuedMessage& dequeu
     route(msg);
 }
 
+void ReplicatingEventListener::deliverDequeueMessages(const std::string& queueName, const SequenceSet& positions)
+{
+    FieldTable headers;
+    headers.setString(REPLICATION_TARGET_QUEUE, queueName);
+    headers.setInt(REPLICATION_EVENT_TYPE, DEQUEUE);
+    headers.setInt(DEQUEUED_MESSAGE_COUNT, positions.size());
+    std::string content(positions.encodedSize(), '\0');
+    Buffer buffer(&content[0], content.size());
+    positions.encode(buffer);
+    boost::intrusive_ptr<Message> msg(createMessage(headers, content));
+    DeliveryProperties* props = msg->getFrames().getHeaders()->get<DeliveryProperties>(true);
+    props->setRoutingKey(queueName);
+    route(msg);
+}
+
+void ReplicatingEventListener::flushDequeues()
+{
+    Dequeues pending;
+    {
+        sys::Mutex::ScopedLock l(lock);
+        pending.swap(dequeues);
+    }
+    for (Dequeues::const_iterator i = pending.begin(); i != pending.end(); ++i)
+        deliverDequeueMessages(i->first, i->second);
+}
+
 void ReplicatingEventListener::deliverEnqueueMessage(const QueuedMessage& enqueued)
 {
     boost::intrusive_ptr<Message> msg(cloneMessage(*(enqueued.queue), enqueued.payload));
@@ -92,19 +136,29 @@ void ReplicatingEventListener::route(boost::intrusive_ptr<qpid::broker::Message>
 }
 
 
-boost::intrusive_ptr<Message> ReplicatingEventListener::createMessage(const FieldTable& headers)
+boost::intrusive_ptr<Message> ReplicatingEventListener::createMessage(const FieldTable& headers,
+                                                                     const std::string& content)
 {
     boost::intrusive_ptr<Message> msg(new Message());
     AMQFrame method((MessageTransferBody(ProtocolVersion(), EMPTY, 0, 0)));
     AMQFrame header((AMQHeaderBody()));
     header.setBof(false);
-    header.setEof(true);
+    header.setEof(content.empty());
     header.setBos(true);
     header.setEos(true);
     msg->getFrames().append(method);
     msg->getFrames().append(header);
+    if (!content.empty()) {
+        AMQFrame data((AMQContentBody(content)));
+        data.setBof(false);
+        data.setEof(true);
+        data.setBos(true);
+        data.setEos(true);
+        msg->getFrames().append(data);
+    }
     MessageProperties* props = msg->getFrames().getHeaders()->get<MessageProperties>(true);
     props->setApplicationHeaders(headers);
+    props->setContentLength(content.size());
     return msg;
 }
 
@@ -175,24 +229,53 @@ void ReplicatingEventListener::initialize(Plugin::Target& target)
             QueueEvents::EventListener callback = boost::bind(&ReplicatingEventListener::handle, this, _1);
             broker->getQueueEvents().registerListener(options.name, callback);
             QPID_LOG(info, "Registered replicating queue event listener");
+            if (options.dequeueBatch > 1) {
+                flushTask = new FlushTask(*this, broker->getTimer(), options.dequeueInterval * sys::TIME_MSEC);
+                broker->getTimer().add(flushTask);
+            }
         }
     }
 }
 
 void ReplicatingEventListener::earlyInitialize(Target&) {}
-void ReplicatingEventListener::shutdown() { queue.reset(); exchange.reset(); }
+
+void ReplicatingEventListener::shutdown()
+{
+    if (flushTask) {
+        flushTask->cancel();
+        flushDequeues();
+    }
+    queue.reset();
+    exchange.reset();
+}
+
+ReplicatingEventListener::FlushTask::FlushTask(ReplicatingEventListener& l, sys::Timer& t, sys::Duration interval) :
+    TimerTask(interval, "ReplicationDequeueFlush"), listener(l), timer(t) {}
+
+void ReplicatingEventListener::FlushTask::fire()
+{
+    listener.flushDequeues();
+    setupNextFire();
+    timer.add(this);
+}
 
 ReplicatingEventListener::PluginOptions::PluginOptions() : Options("Queue Replication Options"), 
                                                            exchangeType("direct"),
                                                            name("replicator"),
-                                                           createQueue(false)
+                                                           createQueue(false),
+                                                           dequeueBatch(1),
+                                                           dequeueInterval(100)
 {
     addOptions()
         ("replication-exchange-name", optValue(exchange, "EXCHANGE"), "Exchange to which events for other queues are routed")
         ("replication-exchange-type", optValue(exchangeType, "direct|topic etc"), "Type of exchange to use")
         ("replication-queue", optValue(queue, "QUEUE"), "Queue on which events for other queues are recorded")
         ("replication-listener-name", optValue(name, "NAME"), "name by which to register the replicating event listener")
-        ("create-replication-queue", optValue(createQueue), "if set, the replication will be created if it does not exist");
+        ("create-replication-queue", optValue(createQueue), "if set, the replication will be created if it does not exist")
+        ("replication-dequeue-batch", optValue(dequeueBatch, "N"),
+         "send the dequeue events of a queue in one message of up to N positions (1 sends each on its own)")
+        ("replication-dequeue-interval", optValue(dequeueInterval, "MS"),
+         "longest time a batched dequeue event is held before being sent");
 }
 
 static ReplicatingEventListener plugin;
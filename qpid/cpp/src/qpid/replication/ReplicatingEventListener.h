@@ -30,6 +30,10 @@
 #include "qpid/broker/QueueEvents.h"
 #include "qpid/framing/FieldTable.h"
 #include "qpid/framing/SequenceNumber.h"
+#include "qpid/framing/SequenceSet.h"
+#include "qpid/sys/Mutex.h"
+#include "qpid/sys/Timer.h"
+#include <map>
 
 namespace qpid {
 namespace replication {
@@ -55,20 +59,40 @@ class ReplicatingEventListener : public Plugin
         std::string exchangeType;
         std::string name;
         bool createQueue;
+        uint32_t dequeueBatch;
+        uint32_t dequeueInterval;
 
         PluginOptions();
     };
 
+    struct FlushTask : public qpid::sys::TimerTask
+    {
+        ReplicatingEventListener& listener;
+        qpid::sys::Timer& timer;
+
+        FlushTask(ReplicatingEventListener& listener, qpid::sys::Timer& timer, qpid::sys::Duration interval);
+        void fire();
+    };
+
+    // Dequeue events waiting to be sent as one message per queue
+    typedef std::map<std::string, qpid::framing::SequenceSet> Dequeues;
+
     PluginOptions options;    
     qpid::broker::Queue::shared_ptr queue;
     qpid::broker::Exchange::shared_ptr exchange;
+    qpid::sys::Mutex lock;
+    Dequeues dequeues;
+    boost::intrusive_ptr<qpid::sys::TimerTask> flushTask;
 
     void deliverDequeueMessage(const qpid::broker::QueuedMessage& enqueued);
+    void deliverDequeueMessages(const std::string& queueName, const qpid::framing::SequenceSet& positions);
+    void flushDequeues();
     void deliverEnqueueMessage(const qpid::broker::QueuedMessage& enqueued);
     void route(boost::intrusive_ptr<qpid::broker::Message>);
     void shutdown();
 
-    boost::intrusive_ptr<qpid::broker::Message> createMessage(const qpid::framing::FieldTable& headers);
+    boost::intrusive_ptr<qpid::broker::Message> createMessage(const qpid::framing::FieldTable& headers,
+                                                              const std::string& content = std::string());
     boost::intrusive_ptr<qpid::broker::Message> cloneMessage(qpid::broker::Queue& queue, 
                                                              boost::intrusive_ptr<qpid::broker::Message> original);
 };
@@ -122,6 +122,10 @@ void ReplicationExchange::handleDequeueEvent(const FieldTable* args, Deliverable
     std::string queueName = args->getAsString(REPLICATION_TARGET_QUEUE);
     Queue::shared_ptr queue = queues.find(queueName);
     if (queue) {
+        if (args->get(DEQUEUED_MESSAGE_COUNT)) {
+            handleDequeueBatch(*queue, msg);
+            return;
+        }
         SequenceNumber position(args->getAsInt(DEQUEUED_MESSAGE_POSITION));        
         QueuedMessage dequeued;
         if (queue->acquireMessageAt(position, dequeued)) {
@@ -147,6 +151,34 @@ void ReplicationExchange::handleDequeueEvent(const FieldTable* args, Deliverable
     }
 }
 
+void ReplicationExchange::handleDequeueBatch(Queue& queue, Deliverable& msg)
+{
+    std::string content;
+    msg.getMessage().getFrames().getContent(content);
+    Buffer buffer(const_cast<char*>(content.data()), content.size());
+    SequenceSet positions;
+    positions.decode(buffer);
+    uint32_t missing(0);
+    for (SequenceSet::iterator i = positions.begin(); i != positions.end(); ++i) {
+        QueuedMessage dequeued;
+        if (queue.acquireMessageAt(*i, dequeued)) queue.dequeue(0, dequeued);
+        else ++missing;
+    }
+    QPID_LOG(debug, "Processed replicated 'dequeue' events " << positions << " from " << queue.getName());
+    if (missing) {
+        QPID_LOG(warning, "Could not acquire " << missing << " of messages " << positions << " from " << queue.getName());
+    }
+    if (mgmtExchange != 0) {
+        if (missing < positions.size()) {
+            mgmtExchange->inc_msgRoutes();
+            mgmtExchange->inc_byteRoutes(msg.contentSize());
+        } else {
+            mgmtExchange->inc_msgDrops();
+            mgmtExchange->inc_byteDrops(msg.contentSize());
+        }
+    }
+}
+
 bool ReplicationExchange::isDuplicate(const FieldTable* args)
 {
     if (!args->get(REPLICATION_EVENT_SEQNO)) return false;
@@ -24,6 +24,7 @@
 #include "qpid/broker/Exchange.h"
 #include "qpid/framing/Buffer.h"
 #include "qpid/framing/SequenceNumber.h"
+#include "qpid/framing/SequenceSet.h"
 
 namespace qpid {
 
@@ -65,6 +66,7 @@ class ReplicationExchange : public qpid::broker::Exchange
     bool isDuplicate(const qpid::framing::FieldTable* args);
     void handleEnqueueEvent(const qpid::framing::FieldTable* args, qpid::broker::Deliverable& msg);
     void handleDequeueEvent(const qpid::framing::FieldTable* args, qpid::broker::Deliverable& msg);
+    void handleDequeueBatch(qpid::broker::Queue& queue, qpid::broker::Deliverable& msg);
     void encode(framing::Buffer& buffer) const;
 };
 }} // namespace qpid::replication
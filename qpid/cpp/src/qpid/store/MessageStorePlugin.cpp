@@ -27,6 +27,19 @@
 #include "qpid/Options.h"
 #include "qpid/DataDir.h"
 #include "qpid/log/Statement.h"
+#include "qpid/management/ManagementAgent.h"
+#include "qmf/org/apache/qpid/store/Package.h"
+#include "qpid/sys/AtomicValue.h"
+#include "qpid/sys/Monitor.h"
+#include "qpid/sys/Runnable.h"
+#include "qpid/sys/Thread.h"
+#include "qpid/sys/Time.h"
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <vector>
 
 /*
  * The MessageStore pointer given to the Broker points to static storage.
@@ -45,15 +58,200 @@ namespace {
 namespace qpid {
 namespace store {
 
+namespace _qmf = ::qmf::org::apache::qpid::store;
+
 static MessageStorePlugin static_instance_registers_plugin;
 
+/**
+ * Times a call into the storage provider, recording it when it goes out
+ * of scope.
+ */
+class MessageStorePlugin::Timer {
+  public:
+    Timer(MessageStorePlugin& p, Timed o) : plugin(p), op(o), start(sys::now()) {}
+    ~Timer() { plugin.record(op, sys::Duration(start, sys::now())); }
+  private:
+    MessageStorePlugin& plugin;
+    Timed op;
+    sys::AbsTime start;
+};
+
+/**
+ * Passes non-transactional enqueues and dequeues to the storage provider,
+ * in the order they are added, on its own thread. Operations that arrive
+ * while the provider is busy, or within the batch window of the first
+ * one, are handed over together, up to the batch size at a time.
+ */
+class MessageStorePlugin::AsyncWorker : public sys::Runnable {
+  public:
+    AsyncWorker(MessageStorePlugin& s, StorageProvider& p, size_t size,
+                sys::Duration w)
+        : store(s), provider(p), batchSize(size ? size : 1), window(w),
+          busy(false), stopped(false) { thread = sys::Thread(*this); }
+
+    void add(const StorageProvider::Operation& op) {
+        sys::Monitor::ScopedLock l(lock);
+        ops.push_back(op);
+        ++counts[op.queue];
+        if (ops.size() == 1 || ops.size() >= batchSize) lock.notifyAll();
+    }
+
+    void drain() {
+        sys::Monitor::ScopedLock l(lock);
+        while (busy || !ops.empty()) lock.wait();
+    }
+
+    /** Operations on @a queue queued or being stored. */
+    uint32_t outstanding(const broker::PersistableQueue& queue) {
+        sys::Monitor::ScopedLock l(lock);
+        Counts::const_iterator i = counts.find(&queue);
+        return i == counts.end() ? 0 : i->second;
+    }
+
+    void stop() {
+        {
+            sys::Monitor::ScopedLock l(lock);
+            if (stopped) return;
+            stopped = true;
+            lock.notifyAll();
+        }
+        thread.join();
+    }
+
+    void run() {
+        sys::Monitor::ScopedLock l(lock);
+        while (true) {
+            while (ops.empty() && !stopped) lock.wait();
+            if (ops.empty()) return;   // Stopped and drained.
+            if (window > 0 && ops.size() < batchSize) {
+                sys::AbsTime deadline(sys::now(), window);
+                while (ops.size() < batchSize && !stopped && lock.wait(deadline))
+                    ;
+            }
+            size_t n = std::min(ops.size(), batchSize);
+            StorageProvider::Operations batch(ops.begin(), ops.begin() + n);
+            ops.erase(ops.begin(), ops.begin() + n);
+            busy = true;
+            {
+                sys::Monitor::ScopedUnlock u(lock);
+                sys::AbsTime start = sys::now();
+                try { provider.enqueueDequeue(batch); }
+                catch (const std::exception& e) {
+                    QPID_LOG(error, "Message store plugin: asynchronous operation failed: "
+                             << e.what());
+                    for (size_t i = 0; i < batch.size(); ++i)
+                        StorageProvider::failed(batch[i], e.what());
+                }
+                // Each operation waited for the whole batch.
+                sys::Duration time(start, sys::now());
+                for (size_t i = 0; i < batch.size(); ++i)
+                    store.record(batch[i].enqueue ? ENQUEUE : DEQUEUE, time);
+            }
+            for (size_t i = 0; i < batch.size(); ++i) {
+                Counts::iterator c = counts.find(batch[i].queue);
+                if (--c->second == 0)
+                    counts.erase(c);
+            }
+            busy = false;
+            lock.notifyAll();
+        }
+    }
+
+  private:
+    MessageStorePlugin& store;
+    StorageProvider& provider;
+    const size_t batchSize;
+    const sys::Duration window;
+    sys::Monitor lock;
+    std::deque<StorageProvider::Operation> ops;
+    typedef std::map<const broker::PersistableQueue*, uint32_t> Counts;
+    Counts counts;
+    bool busy;
+    bool stopped;
+    sys::Thread thread;
+};
+
+namespace {
+
+// The recovered messages for one queue, in the order to put them on it.
+struct QueueRecovery {
+    broker::RecoverableQueue::shared_ptr queue;
+    std::vector<broker::RecoverableMessage::shared_ptr> messages;
+};
+
+// A recovered message with a prepared dtx operation on a queue.
+struct PreparedEntry {
+    QueueEntry entry;
+    broker::RecoverableQueue::shared_ptr queue;
+    broker::RecoverableMessage::shared_ptr msg;
+    PreparedEntry(const QueueEntry& e,
+                  const broker::RecoverableQueue::shared_ptr& q,
+                  const broker::RecoverableMessage::shared_ptr& m)
+        : entry(e), queue(q), msg(m) {}
+};
+
+// Fills whole queues, taking the next one not yet claimed each time.
+class QueueRecoverer : public sys::Runnable {
+    std::vector<QueueRecovery*>& work;
+    sys::AtomicValue<size_t>& next;
+public:
+    std::string error;
+    QueueRecoverer(std::vector<QueueRecovery*>& w, sys::AtomicValue<size_t>& n)
+        : work(w), next(n) {}
+    void run() {
+        try {
+            for (size_t i = next++; i < work.size(); i = next++) {
+                QueueRecovery& q = *work[i];
+                for (size_t m = 0; m < q.messages.size(); ++m)
+                    q.queue->recover(q.messages[m]);
+            }
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+    }
+};
+
+}
+
+MessageStorePlugin::MessageStorePlugin()
+    : mgmtObject(0), slow(60 * sys::TIME_SEC), broker(0) {}
+
+MessageStorePlugin::~MessageStorePlugin() {
+    if (worker.get()) worker->stop();
+}
+
+void
+MessageStorePlugin::drain()
+{
+    if (worker.get()) worker->drain();
+}
 
 MessageStorePlugin::StoreOptions::StoreOptions(const std::string& name) :
-    qpid::Options(name)
+    qpid::Options(name), async(false), batchSize(1), batchWindow(0),
+    recoveryThreads(1), slowThreshold(500)
 {
     addOptions()
         ("storage-provider", qpid::optValue(providerName, "PROVIDER"),
          "Name of the storage provider to use.")
+        ("storage-async", qpid::optValue(async),
+         "Pass non-transactional enqueues and dequeues to the storage provider "
+         "on a separate thread, so the thread routing a message does not wait "
+         "for it to be written. Always done for providers that write before "
+         "returning.")
+        ("storage-batch-size", qpid::optValue(batchSize, "N"),
+         "With --storage-async, pass up to N enqueues and dequeues, from all "
+         "sessions, to the storage provider together so they are stored in "
+         "one flush.")
+        ("storage-batch-window", qpid::optValue(batchWindow, "USEC"),
+         "With --storage-async, wait up to USEC microseconds for a batch to "
+         "fill before storing it.")
+        ("storage-recovery-threads", qpid::optValue(recoveryThreads, "N"),
+         "Put recovered messages back on their queues using up to N threads, "
+         "each filling whole queues.")
+        ("storage-slow-threshold", qpid::optValue(slowThreshold, "MSEC"),
+         "Log a summary, once a minute, of store operations that took longer "
+         "than MSEC milliseconds; 0 to log none.")
         ;
 }
 
@@ -98,7 +296,20 @@ MessageStorePlugin::earlyInitialize (qpid::Plugin::Target& target)
         provider = providers.begin();
     }
 
+    management::ManagementAgent* agent = broker->getManagementAgent();
+    if (agent != 0) {
+        _qmf::Package packageInit(agent);
+        mgmtObject = new _qmf::Store(agent, this, broker);
+        mgmtObject->set_provider(provider->first);
+        mgmtObject->set_slowThreshold(options.slowThreshold);
+        agent->addObject(mgmtObject);
+    }
+    provider->second->setInstrumentation(this);
+
     provider->second->activate(*this);
+    if (options.async || !provider->second->completesAsynchronously())
+        worker.reset(new AsyncWorker(*this, *provider->second, options.batchSize,
+                                     options.batchWindow * sys::TIME_USEC));
     NoopDeleter d;
     boost::shared_ptr<qpid::broker::MessageStore> sp(this, d);
     broker->setStore(sp);
@@ -123,9 +334,84 @@ MessageStorePlugin::initialize(qpid::Plugin::Target& target)
 void
 MessageStorePlugin::finalizeMe()
 {
+    if (worker.get()) worker->stop();
     finalize();              // Call finalizers on any Provider plugins
 }
 
+management::ManagementObject*
+MessageStorePlugin::GetManagementObject() const
+{
+    return mgmtObject;
+}
+
+void
+MessageStorePlugin::bytesWritten(uint64_t bytes)
+{
+    if (mgmtObject != 0)
+        mgmtObject->inc_bytesWritten(bytes);
+}
+
+void
+MessageStorePlugin::bytesRead(uint64_t bytes)
+{
+    if (mgmtObject != 0)
+        mgmtObject->inc_bytesRead(bytes);
+}
+
+void
+MessageStorePlugin::record(Timed op, sys::Duration time)
+{
+    uint64_t ns = time;
+    if (mgmtObject != 0) {
+        switch (op) {
+        case STAGE:
+            mgmtObject->inc_stages();
+            mgmtObject->set_stageLatency(ns);
+            break;
+        case ENQUEUE:
+            mgmtObject->inc_enqueues();
+            mgmtObject->set_enqueueLatency(ns);
+            break;
+        case DEQUEUE:
+            mgmtObject->inc_dequeues();
+            mgmtObject->set_dequeueLatency(ns);
+            break;
+        case FLUSH:
+            mgmtObject->inc_flushes();
+            mgmtObject->set_flushLatency(ns);
+            break;
+        case LOAD_CONTENT:
+            mgmtObject->inc_contentLoads();
+            mgmtObject->set_contentLoadLatency(ns);
+            break;
+        case COMMIT:
+            mgmtObject->inc_commits();
+            mgmtObject->set_commitLatency(ns);
+            break;
+        }
+        if (time < sys::TIME_MSEC)
+            mgmtObject->inc_latencyUnder1ms();
+        else if (time < 10 * sys::TIME_MSEC)
+            mgmtObject->inc_latencyUnder10ms();
+        else if (time < 100 * sys::TIME_MSEC)
+            mgmtObject->inc_latencyUnder100ms();
+        else if (time < sys::TIME_SEC)
+            mgmtObject->inc_latencyUnder1s();
+        else
+            mgmtObject->inc_latencyOver1s();
+    }
+
+    sys::Duration threshold = options.slowThreshold * sys::TIME_MSEC;
+    if (options.slowThreshold == 0 || time <= threshold)
+        return;
+    if (mgmtObject != 0)
+        mgmtObject->inc_slowOperations();
+    static const char* names[] = { "Store stage", "Store enqueue", "Store dequeue",
+                                   "Store flush", "Store content load", "Store commit" };
+    sys::Mutex::ScopedLock l(slowLock);
+    slow.overran(names[op], time - threshold, time);
+}
+
 void
 MessageStorePlugin::providerAvailable(const std::string name,
                                       StorageProvider *be)
@@ -150,6 +436,7 @@ void
 MessageStorePlugin::create(broker::PersistableQueue& queue,
                            const framing::FieldTable& args)
 {
+    drain();
     if (queue.getName().size() == 0)
     {
         QPID_LOG(error,
@@ -169,6 +456,7 @@ MessageStorePlugin::create(broker::PersistableQueue& queue,
 void
 MessageStorePlugin::destroy(broker::PersistableQueue& queue)
 {
+    drain();
     provider->second->destroy(queue);
 }
 
@@ -179,6 +467,7 @@ void
 MessageStorePlugin::create(const broker::PersistableExchange& exchange,
                            const framing::FieldTable& args)
 {
+    drain();
     if (exchange.getPersistenceId()) {
         THROW_STORE_EXCEPTION("Exchange already created: " + exchange.getName());
     }
@@ -191,6 +480,7 @@ MessageStorePlugin::create(const broker::PersistableExchange& exchange,
 void
 MessageStorePlugin::destroy(const broker::PersistableExchange& exchange)
 {
+    drain();
     provider->second->destroy(exchange);
 }
 
@@ -203,6 +493,7 @@ MessageStorePlugin::bind(const broker::PersistableExchange& exchange,
                          const std::string& key,
                          const framing::FieldTable& args)
 {
+    drain();
     provider->second->bind(exchange, queue, key, args);
 }
 
@@ -215,6 +506,7 @@ MessageStorePlugin::unbind(const broker::PersistableExchange& exchange,
                            const std::string& key,
                            const framing::FieldTable& args)
 {
+    drain();
     provider->second->unbind(exchange, queue, key, args);
 }
 
@@ -224,6 +516,7 @@ MessageStorePlugin::unbind(const broker::PersistableExchange& exchange,
 void
 MessageStorePlugin::create(const broker::PersistableConfig& config)
 {
+    drain();
     if (config.getPersistenceId()) {
         THROW_STORE_EXCEPTION("Config item already created: " +
                               config.getName());
@@ -237,6 +530,7 @@ MessageStorePlugin::create(const broker::PersistableConfig& config)
 void
 MessageStorePlugin::destroy(const broker::PersistableConfig& config)
 {
+    drain();
     provider->second->destroy(config);
 }
 
@@ -249,7 +543,9 @@ MessageStorePlugin::destroy(const broker::PersistableConfig& config)
 void
 MessageStorePlugin::stage(const boost::intrusive_ptr<broker::PersistableMessage>& msg)
 {
+    drain();
     if (msg->getPersistenceId() == 0 && !msg->isContentReleased()) {
+        Timer t(*this, STAGE);
         provider->second->stage(msg);
     }
 }
@@ -263,6 +559,7 @@ MessageStorePlugin::stage(const boost::intrusive_ptr<broker::PersistableMessage>
 void
 MessageStorePlugin::destroy(broker::PersistableMessage& msg)
 {
+    drain();
     if (msg.getPersistenceId())
         provider->second->destroy(msg);
 }
@@ -275,6 +572,7 @@ MessageStorePlugin::appendContent
   (const boost::intrusive_ptr<const broker::PersistableMessage>& msg,
    const std::string& data)
 {
+    drain();
     if (msg->getPersistenceId())
         provider->second->appendContent(msg, data);
     else
@@ -296,8 +594,11 @@ MessageStorePlugin::loadContent(const broker::PersistableQueue& queue,
                                 uint64_t offset,
                                 uint32_t length)
 {
-    if (msg->getPersistenceId())
+    drain();
+    if (msg->getPersistenceId()) {
+        Timer t(*this, LOAD_CONTENT);
         provider->second->loadContent(queue, msg, data, offset, length);
+    }
     else
         THROW_STORE_EXCEPTION("Cannot load content. Message not known to store!");
 }
@@ -318,6 +619,12 @@ MessageStorePlugin::enqueue(broker::TransactionContext* ctxt,
     if (queue.getPersistenceId() == 0) {
         THROW_STORE_EXCEPTION("Queue not created: " + queue.getName());
     }
+    if (worker.get() && !ctxt) {
+        worker->add(StorageProvider::Operation(true, msg, queue));
+        return;
+    }
+    drain();
+    Timer t(*this, ENQUEUE);
     provider->second->enqueue(ctxt, msg, queue);
 }
 
@@ -334,6 +641,12 @@ MessageStorePlugin::dequeue(broker::TransactionContext* ctxt,
                             const boost::intrusive_ptr<broker::PersistableMessage>& msg,
                             const broker::PersistableQueue& queue)
 {
+    if (worker.get() && !ctxt) {
+        worker->add(StorageProvider::Operation(false, msg, queue));
+        return;
+    }
+    drain();
+    Timer t(*this, DEQUEUE);
     provider->second->dequeue(ctxt, msg, queue);
 }
 
@@ -346,6 +659,8 @@ MessageStorePlugin::dequeue(broker::TransactionContext* ctxt,
 void
 MessageStorePlugin::flush(const broker::PersistableQueue& queue)
 {
+    drain();
+    Timer t(*this, FLUSH);
     provider->second->flush(queue);
 }
 
@@ -358,12 +673,15 @@ MessageStorePlugin::flush(const broker::PersistableQueue& queue)
 uint32_t
 MessageStorePlugin::outstandingQueueAIO(const broker::PersistableQueue& queue)
 {
-    return provider->second->outstandingQueueAIO(queue);
+    // Counted rather than drained, so polling never waits for the disk.
+    uint32_t queued = worker.get() ? worker->outstanding(queue) : 0;
+    return queued + provider->second->outstandingQueueAIO(queue);
 }
 
 std::auto_ptr<broker::TransactionContext>
 MessageStorePlugin::begin()
 {
+    // The transaction's own operations drain the queue before they start.
     return provider->second->begin();
 }
 
@@ -376,24 +694,29 @@ MessageStorePlugin::begin(const std::string& xid)
 void
 MessageStorePlugin::prepare(broker::TPCTransactionContext& ctxt)
 {
+    drain();
     provider->second->prepare(ctxt);
 }
 
 void
 MessageStorePlugin::commit(broker::TransactionContext& ctxt)
 {
+    drain();
+    Timer t(*this, COMMIT);
     provider->second->commit(ctxt);
 }
 
 void
 MessageStorePlugin::abort(broker::TransactionContext& ctxt)
 {
+    drain();
     provider->second->abort(ctxt);
 }
 
 void
 MessageStorePlugin::collectPreparedXids(std::set<std::string>& xids)
 {
+    drain();
     provider->second->collectPreparedXids(xids);
 }
 
@@ -420,7 +743,15 @@ MessageStorePlugin::recover(broker::RecoveryManager& recoverer)
     // <shuston@riverace.com>.
     provider->second->recoverMessages(recoverer, messages, messageQueueMap);
     provider->second->recoverTransactions(recoverer, dtxMap);
-    // Enqueue msgs where needed.
+
+    // Sort the entries by queue, keeping each queue's messages in the
+    // (persistence id) order the provider gave them, so that the queues
+    // can be filled independently. Prepared dtx operations are applied
+    // afterwards, once every message expected on a queue is there.
+    typedef std::map<uint64_t, QueueRecovery> QueueRecoveries;
+    QueueRecoveries perQueue;
+    std::vector<PreparedEntry> prepared;
+    size_t count = 0;
     for (MessageQueueMap::const_iterator i = messageQueueMap.begin();
          i != messageQueueMap.end();
          ++i) {
@@ -450,18 +781,53 @@ MessageStorePlugin::recover(broker::RecoveryManager& recoverer)
             // updated accordingly. First, though, restore a message that
             // is expected to be on a queue, including non-transacted
             // messages and those pending dequeue in a dtx.
-            if (j->tplStatus != QueueEntry::ADDING)
-                iQ->second->recover(msg);
-            switch(j->tplStatus) {
-            case QueueEntry::ADDING:
-                dtxMap[j->xid]->enqueue(iQ->second, msg);
-                break;
-            case QueueEntry::REMOVING:
-                dtxMap[j->xid]->dequeue(iQ->second, msg);
-                break;
-            default:
-                break;
+            if (j->tplStatus != QueueEntry::ADDING) {
+                QueueRecovery& q = perQueue[j->queueId];
+                q.queue = iQ->second;
+                q.messages.push_back(msg);
+                ++count;
             }
+            if (j->tplStatus != QueueEntry::NONE)
+                prepared.push_back(PreparedEntry(*j, iQ->second, msg));
+        }
+    }
+
+    std::vector<QueueRecovery*> work;
+    for (QueueRecoveries::iterator i = perQueue.begin(); i != perQueue.end(); ++i)
+        work.push_back(&i->second);
+    unsigned threads =
+        std::max(1u, std::min<unsigned>(options.recoveryThreads, work.size()));
+    sys::AtomicValue<size_t> next(0);
+    boost::ptr_vector<QueueRecoverer> recoverers;
+    std::vector<sys::Thread> running;
+    for (unsigned t = 0; t < threads; ++t)
+        recoverers.push_back(new QueueRecoverer(work, next));
+    for (unsigned t = 1; t < threads; ++t)
+        running.push_back(sys::Thread(recoverers[t]));
+    recoverers[0].run();
+    for (size_t t = 0; t < running.size(); ++t)
+        running[t].join();
+    for (unsigned t = 0; t < threads; ++t)
+        if (!recoverers[t].error.empty())
+            THROW_STORE_EXCEPTION("Error re-enqueueing recovered messages: " +
+                                  recoverers[t].error);
+    if (count)
+        QPID_LOG(info, "Message store plugin: re-enqueued " << count
+                 << " messages on " << work.size() << " queues using "
+                 << threads << " threads");
+
+    for (std::vector<PreparedEntry>::const_iterator i = prepared.begin();
+         i != prepared.end();
+         ++i) {
+        switch(i->entry.tplStatus) {
+        case QueueEntry::ADDING:
+            dtxMap[i->entry.xid]->enqueue(i->queue, i->msg);
+            break;
+        case QueueEntry::REMOVING:
+            dtxMap[i->entry.xid]->dequeue(i->queue, i->msg);
+            break;
+        default:
+            break;
         }
     }
 }
@@ -30,7 +30,13 @@
 #include "qpid/broker/PersistableMessage.h"
 #include "qpid/broker/PersistableQueue.h"
 #include "qpid/management/Manageable.h"
+#include "qpid/store/StorageProvider.h"
+#include "qpid/sys/Mutex.h"
+#include "qpid/sys/Time.h"
+#include "qpid/sys/TimerWarnings.h"
+#include "qmf/org/apache/qpid/store/Store.h"
 
+#include <memory>
 #include <string>
 
 using namespace qpid;
@@ -38,8 +44,6 @@ using namespace qpid;
 namespace qpid {
 namespace store {
 
-class StorageProvider;
-
 /**
  * @class MessageStorePlugin
  *
@@ -49,15 +53,39 @@ class StorageProvider;
  * unloading and persisting broker state (queues, bindings etc.).
  * Actual storage operations are carried out by a message store storage
  * provider that implements the qpid::store::StorageProvider interface.
+ *
+ * Non-transactional enqueues and dequeues for a provider that writes
+ * before returning are passed to it in order on a thread of their own,
+ * so that it does not hold up the caller (e.g. a connection's I/O thread
+ * or the cluster deliver thread); --storage-async does the same for any
+ * provider. The message still completes only when the provider has
+ * stored it. Any other operation on the store, other than starting a
+ * transaction, waits for the queued enqueues and dequeues to be done
+ * first.
+ *
+ * --storage-batch-size and --storage-batch-window let that thread group
+ * the enqueues and dequeues of all sessions and hand each group to the
+ * provider at once (StorageProvider::enqueueDequeue()), so a provider
+ * can store it in one flush and share the cost of the sync or database
+ * commit among all of its messages.
+ *
+ * Every call into the provider for a stage, enqueue, dequeue, flush,
+ * content load or commit is counted and timed, and published with the
+ * bytes the provider reports having written and read on an
+ * org.apache.qpid.store:Store management object. Calls slower than
+ * --storage-slow-threshold are summarised in the log once a minute, as
+ * the broker timer does for late tasks.
  */
 class MessageStorePlugin :
     public qpid::Plugin,
     public qpid::broker::MessageStore,        // Frontend classes
-    public qpid::Plugin::Target               // Provider target
-    // @TODO Need a mgmt story for this. Maybe allow r/o access to provider store info?    public qpid::management::Manageable
+    public qpid::Plugin::Target,              // Provider target
+    public qpid::management::Manageable,
+    public StorageProvider::Instrumentation
 {
   public:
-    MessageStorePlugin() : broker(0) {}
+    MessageStorePlugin();
+    ~MessageStorePlugin();
 
     /**
      * @name Methods inherited from qpid::Plugin
@@ -261,8 +289,15 @@ class MessageStorePlugin :
      */
     virtual void recover(broker::RecoveryManager& recoverer);
 
-    //    inline management::Manageable::status_t ManagementMethod (uint32_t, management::Args&, std::string&)
-    //        { return management::Manageable::STATUS_OK; }
+    virtual management::ManagementObject* GetManagementObject() const;
+
+    /**
+     * @name Methods inherited from StorageProvider::Instrumentation
+     */
+    //@{
+    virtual void bytesWritten(uint64_t bytes);
+    virtual void bytesRead(uint64_t bytes);
+    //@}
 
     // So storage provider can get the broker info.
     broker::Broker *getBroker() { return broker; }
@@ -272,9 +307,28 @@ class MessageStorePlugin :
     struct StoreOptions : public qpid::Options {
         StoreOptions(const std::string& name="Store Options");
         std::string providerName;
+        bool async;
+        size_t batchSize;
+        uint32_t batchWindow;
+        unsigned recoveryThreads;
+        uint32_t slowThreshold;
     };
     StoreOptions options;
 
+    /// The operations that are timed.
+    enum Timed { STAGE, ENQUEUE, DEQUEUE, FLUSH, LOAD_CONTENT, COMMIT };
+    class Timer;
+    /// Count one @a op that took @a time and log it if it was slow.
+    void record(Timed op, sys::Duration time);
+    qmf::org::apache::qpid::store::Store* mgmtObject; // mgnt owns lifecycle
+    sys::Mutex slowLock;
+    sys::TimerWarnings slow;
+
+    class AsyncWorker;
+    std::auto_ptr<AsyncWorker> worker;
+    /// Wait for queued asynchronous operations to finish.
+    void drain();
+
     typedef std::map<const std::string, StorageProvider*> ProviderMap;
     ProviderMap providers;
     ProviderMap::const_iterator provider;
@@ -26,6 +26,7 @@
 #include <stdexcept>
 #include <vector>
 #include "qpid/Exception.h"
+#include "qpid/log/Statement.h"
 #include "qpid/Plugin.h"
 #include "qpid/Options.h"
 #include "qpid/broker/MessageStore.h"
@@ -88,6 +89,33 @@ public:
         virtual const char *what() const throw() = 0;
     };
 
+    /**
+     * @class Instrumentation
+     *
+     * Where a provider reports the bytes it moves to and from its
+     * storage. MessageStorePlugin times every call it makes into the
+     * provider itself; the bytes are the one thing only the provider
+     * knows, so every provider must report them, from whichever thread
+     * does the I/O: reportWritten() for message records, configuration
+     * and transaction records as they are written, reportRead() for
+     * message content loaded back.
+     */
+    class Instrumentation
+    {
+    public:
+        virtual ~Instrumentation() {}
+        virtual void bytesWritten(uint64_t bytes) = 0;
+        virtual void bytesRead(uint64_t bytes) = 0;
+    };
+
+    StorageProvider() : instrumentation(0) {}
+
+    /**
+     * Set by MessageStorePlugin before activate() is called.
+     */
+    void setInstrumentation(Instrumentation* i) { instrumentation = i; }
+    Instrumentation* getInstrumentation() const { return instrumentation; }
+
     /**
      * @name Methods inherited from qpid::Plugin
      */
@@ -279,6 +307,71 @@ public:
                          const boost::intrusive_ptr<PersistableMessage>& msg,
                          const PersistableQueue& queue) = 0;
 
+    /**
+     * A non-transactional enqueue or dequeue, as grouped together by
+     * MessageStorePlugin for enqueueDequeue().
+     */
+    struct Operation {
+        bool enqueue;
+        boost::intrusive_ptr<PersistableMessage> msg;
+        const PersistableQueue* queue;
+
+        Operation(bool e,
+                  const boost::intrusive_ptr<PersistableMessage>& m,
+                  const PersistableQueue& q)
+            : enqueue(e), msg(m), queue(&q) {}
+    };
+    typedef std::vector<Operation> Operations;
+
+    /**
+     * Carries out a group of non-transactional enqueues and dequeues, in
+     * order. A provider that can store the whole group in one flush (one
+     * sync, one database transaction) should override this and complete
+     * each message only once that flush is done; the default just calls
+     * enqueue() or dequeue() for each operation in turn, settling any that
+     * throws with failed() so that the others still go ahead. An exception
+     * means that none of the operations was carried out; the caller then
+     * settles each of them with failed().
+     *
+     * @param ops the operations, oldest first
+     */
+    virtual void enqueueDequeue(const Operations& ops) {
+        for (Operations::const_iterator i = ops.begin(); i != ops.end(); ++i) {
+            try {
+                if (i->enqueue)
+                    enqueue(0, i->msg, *i->queue);
+                else
+                    dequeue(0, i->msg, *i->queue);
+            }
+            catch (const std::exception& e) {
+                QPID_LOG(error, "Storage provider: " << (i->enqueue ? "enqueue" : "dequeue")
+                         << " on " << i->queue->getName() << " failed: " << e.what());
+                failed(*i, e.what());
+            }
+        }
+    }
+
+    /**
+     * Settles an operation that could not be carried out: an enqueue
+     * completes with the error, which is raised to the publisher; a
+     * dequeue completes anyway, the message being left in the store.
+     */
+    static void failed(const Operation& op, const std::string& error) {
+        if (op.enqueue)
+            op.msg->enqueueFailed(error);
+        else
+            op.msg->dequeueComplete();
+    }
+
+    /**
+     * True if enqueue() and dequeue() outside a transaction only start
+     * the write and complete the message later from a thread of the
+     * provider's own. MessageStorePlugin passes the operations of a
+     * provider that stores them before returning to a thread of its own,
+     * so that no broker thread waits for the disk.
+     */
+    virtual bool completesAsynchronously() const { return false; }
+
     /**
      * Flushes all async messages to disk for the specified queue
      *
@@ -336,6 +429,17 @@ public:
     virtual void recoverTransactions(qpid::broker::RecoveryManager& recoverer,
                                      PreparedTransactionMap& dtxMap) = 0;
     //@}
+
+protected:
+    void reportWritten(uint64_t bytes) {
+        if (instrumentation) instrumentation->bytesWritten(bytes);
+    }
+    void reportRead(uint64_t bytes) {
+        if (instrumentation) instrumentation->bytesRead(bytes);
+    }
+
+private:
+    Instrumentation* instrumentation;
 };
 
 }} // namespace qpid::store
@@ -0,0 +1,166 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <qpid/log/Statement.h>
+#include <qpid/store/StoreException.h>
+#include <qpid/sys/StrError.h>
+#include "ConfigLog.h"
+#include "Record.h"
+
+namespace qpid {
+namespace store {
+namespace journal {
+
+ConfigLog::ConfigLog() : fd(-1), nextId(1), instrumentation(0)
+{
+}
+
+ConfigLog::~ConfigLog()
+{
+    close();
+}
+
+void
+ConfigLog::open(const std::string& p)
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    path = p;
+    std::string contents;
+    readFile(path, contents);
+    uint64_t at = 0;
+    RecordHeader header;
+    while (uint32_t length = checkRecord(contents.data() + at,
+                                         contents.size() - at,
+                                         header)) {
+        const char* payload = contents.data() + at + sizeof(header);
+        switch (header.type) {
+        case REC_CONFIG_ADD:
+            if (header.size > 0)
+                entries[header.id] =
+                    Entry(Kind(payload[0]), std::string(payload + 1, header.size - 1));
+            break;
+        case REC_CONFIG_REMOVE:
+            entries.erase(header.id);
+            break;
+        case REC_NEXT_ID:
+            if (header.id > nextId)
+                nextId = header.id;
+            break;
+        default:
+            break;
+        }
+        if (header.id >= nextId && header.type != REC_NEXT_ID)
+            nextId = header.id + 1;
+        at += length;
+    }
+    if (at < contents.size())
+        QPID_LOG(warning, "Journal store: ignoring " << (contents.size() - at)
+                 << " bytes after the last complete record in " << path);
+
+    // Rewrite just the live entries, then switch to the new file.
+    std::string compacted;
+    appendRecord(compacted, REC_NEXT_ID, nextId, 0, 0);
+    for (Entries::const_iterator i = entries.begin(); i != entries.end(); ++i) {
+        std::string payload(1, char(i->second.kind));
+        payload += i->second.data;
+        appendRecord(compacted, REC_CONFIG_ADD, i->first,
+                     payload.data(), payload.size());
+    }
+    std::string tmp = path + ".tmp";
+    int tfd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (tfd < 0)
+        THROW_STORE_EXCEPTION("Can't create " + tmp + ": " +
+                              qpid::sys::strError(errno));
+    try {
+        writeFully(tfd, compacted.data(), compacted.size(), 0);
+        if (::fdatasync(tfd) < 0)
+            THROW_STORE_EXCEPTION("Can't sync " + tmp + ": " +
+                                  qpid::sys::strError(errno));
+    }
+    catch (...) {
+        ::close(tfd);
+        throw;
+    }
+    ::close(tfd);
+    if (::rename(tmp.c_str(), path.c_str()) < 0)
+        THROW_STORE_EXCEPTION("Can't replace " + path + ": " +
+                              qpid::sys::strError(errno));
+    std::string::size_type slash = path.rfind('/');
+    syncDirectory(slash == std::string::npos ? "." : path.substr(0, slash));
+
+    fd = ::open(path.c_str(), O_WRONLY | O_APPEND);
+    if (fd < 0)
+        THROW_STORE_EXCEPTION("Can't open " + path + ": " +
+                              qpid::sys::strError(errno));
+}
+
+void
+ConfigLog::close()
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
+
+void
+ConfigLog::add(uint64_t id, Kind kind, const std::string& data)
+{
+    std::string payload(1, char(kind));
+    payload += data;
+    std::string record;
+    appendRecord(record, REC_CONFIG_ADD, id, payload.data(), payload.size());
+    qpid::sys::Mutex::ScopedLock l(lock);
+    append(record);
+    entries[id] = Entry(kind, data);
+    if (id >= nextId)
+        nextId = id + 1;
+}
+
+void
+ConfigLog::remove(uint64_t id)
+{
+    std::string record;
+    appendRecord(record, REC_CONFIG_REMOVE, id, 0, 0);
+    qpid::sys::Mutex::ScopedLock l(lock);
+    append(record);
+    entries.erase(id);
+}
+
+// Called with lock held.
+void
+ConfigLog::append(const std::string& records)
+{
+    if (fd < 0)
+        THROW_STORE_EXCEPTION("Journal store config file is not open");
+    writeFully(fd, records.data(), records.size(), -1);
+    if (::fdatasync(fd) < 0)
+        THROW_STORE_EXCEPTION("Can't sync " + path + ": " +
+                              qpid::sys::strError(errno));
+    if (instrumentation)
+        instrumentation->bytesWritten(records.size());
+}
+
+}}} // namespace qpid::store::journal
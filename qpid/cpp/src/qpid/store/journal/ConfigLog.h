@@ -0,0 +1,93 @@
+#ifndef QPID_STORE_JOURNAL_CONFIGLOG_H
+#define QPID_STORE_JOURNAL_CONFIGLOG_H
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <map>
+#include <string>
+#include <qpid/store/StorageProvider.h>
+#include <qpid/sys/IntegerTypes.h>
+#include <qpid/sys/Mutex.h>
+
+namespace qpid {
+namespace store {
+namespace journal {
+
+/**
+ * @class ConfigLog
+ *
+ * Holds the durable queues, exchanges, bindings and generic configuration
+ * in a single append-only file. Changes are rare, so each one is written
+ * and synced before returning. The file is rewritten with just the live
+ * entries each time it is opened.
+ */
+class ConfigLog {
+public:
+    enum Kind { QUEUE = 1, EXCHANGE, BINDING, CONFIG };
+
+    struct Entry {
+        Kind kind;
+        std::string data;
+        Entry(Kind k = CONFIG, const std::string& d = std::string())
+            : kind(k), data(d) {}
+    };
+    typedef std::map<uint64_t, Entry> Entries;
+
+    ConfigLog();
+    ~ConfigLog();
+
+    /**
+     * Read the entries in @a path, creating it if needed, and compact it.
+     */
+    void open(const std::string& path);
+    void close();
+
+    /** Where the bytes written are reported; may be 0. */
+    void instrument(StorageProvider::Instrumentation* i) { instrumentation = i; }
+
+    void add(uint64_t id, Kind kind, const std::string& data);
+    void remove(uint64_t id);
+
+    /** Live entries; only for use during recovery. */
+    const Entries& getEntries() const { return entries; }
+
+    /**
+     * First id above any ever handed out to a configuration entry, even
+     * one since removed. Ids are never reused so that journal records for
+     * a deleted queue can't be taken for a new queue's.
+     */
+    uint64_t getNextId() const { return nextId; }
+
+private:
+    qpid::sys::Mutex lock;
+    std::string path;
+    int fd;
+    Entries entries;
+    uint64_t nextId;
+    StorageProvider::Instrumentation* instrumentation;
+
+    void append(const std::string& records);
+};
+
+}}} // namespace qpid::store::journal
+
+#endif /* QPID_STORE_JOURNAL_CONFIGLOG_H */
@@ -0,0 +1,1364 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <new>
+#include <sstream>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <qpid/framing/Buffer.h>
+#include <qpid/log/Statement.h>
+#include <qpid/store/StoreException.h>
+#include <qpid/sys/AtomicValue.h>
+#include <qpid/sys/StrError.h>
+#include "Journal.h"
+
+namespace qpid {
+namespace store {
+namespace journal {
+
+namespace {
+
+// Direct writes are padded to this, and their buffers aligned on it.
+const uint64_t BlockSize = 4096;
+const size_t InitialChunkSize = 64 * 1024;
+const std::string SegmentPrefix("jrnl.");
+
+void
+encode(const PersistableMessage& msg, std::string& out)
+{
+    uint32_t size = msg.encodedSize();
+    uint32_t headerSize = msg.encodedHeaderSize();
+    out.resize(sizeof(headerSize) + size);
+    ::memcpy(&out[0], &headerSize, sizeof(headerSize));
+    qpid::framing::Buffer buffer(&out[sizeof(headerSize)], size);
+    msg.encode(buffer);
+}
+
+void
+readFully(int fd, char* data, size_t size, uint64_t offset)
+{
+    while (size > 0) {
+        ssize_t n = ::pread(fd, data, size, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            THROW_STORE_EXCEPTION("Journal read failed: " +
+                                  qpid::sys::strError(n < 0 ? errno : EIO));
+        data += n;
+        size -= n;
+        offset += n;
+    }
+}
+
+// What recovery needs from one record; payloads stay on disk.
+struct ScanOp {
+    uint16_t type;
+    uint64_t id;
+    uint64_t offset;
+    uint32_t size;
+    uint32_t headerSize;
+    uint64_t queueId;
+    uint64_t txnId;
+    std::string xid;
+};
+
+struct SegmentScan {
+    uint64_t seq;
+    std::string path;
+    std::vector<ScanOp> ops;
+    uint64_t torn;
+    std::string error;
+    SegmentScan() : seq(0), torn(0) {}
+};
+
+void
+scan(SegmentScan& s)
+{
+    std::string contents;
+    readFile(s.path, contents);
+    uint64_t at = 0;
+    RecordHeader header;
+    while (uint32_t length = checkRecord(contents.data() + at,
+                                         contents.size() - at,
+                                         header)) {
+        const char* payload = contents.data() + at + sizeof(header);
+        ScanOp op;
+        op.type = header.type;
+        op.id = header.id;
+        op.offset = at + sizeof(header);
+        op.size = header.size;
+        op.headerSize = 0;
+        op.queueId = op.txnId = 0;
+        bool keep = true;
+        switch (header.type) {
+        case REC_MESSAGE:
+            if (header.size < sizeof(uint32_t)) {
+                keep = false;
+                break;
+            }
+            ::memcpy(&op.headerSize, payload, sizeof(uint32_t));
+            op.offset += sizeof(uint32_t);
+            op.size -= sizeof(uint32_t);
+            break;
+        case REC_ENQUEUE:
+        case REC_DEQUEUE:
+            if (header.size < 2 * sizeof(uint64_t)) {
+                keep = false;
+                break;
+            }
+            ::memcpy(&op.queueId, payload, sizeof(uint64_t));
+            ::memcpy(&op.txnId, payload + sizeof(uint64_t), sizeof(uint64_t));
+            break;
+        case REC_PREPARE:
+            op.xid.assign(payload, header.size);
+            break;
+        case REC_COMMIT:
+        case REC_ABORT:
+            break;
+        case REC_TRANSACTION:
+            // Kept only so its id is not handed out again; what it did is
+            // applied as plain enqueues and dequeues, all in this segment.
+            s.ops.push_back(op);
+            for (uint32_t g = 0;
+                 g + sizeof(uint64_t) + 2 * sizeof(uint32_t) <= header.size; ) {
+                uint32_t type, count;
+                ::memcpy(&op.id, payload + g, sizeof(uint64_t));
+                g += sizeof(uint64_t);
+                ::memcpy(&type, payload + g, sizeof(uint32_t));
+                g += sizeof(uint32_t);
+                ::memcpy(&count, payload + g, sizeof(uint32_t));
+                g += sizeof(uint32_t);
+                op.type = type;
+                for (; count > 0 && g + sizeof(uint64_t) <= header.size;
+                     --count, g += sizeof(uint64_t)) {
+                    ::memcpy(&op.queueId, payload + g, sizeof(uint64_t));
+                    s.ops.push_back(op);
+                }
+            }
+            keep = false;
+            break;
+        default:
+            keep = false;
+            break;
+        }
+        if (keep)
+            s.ops.push_back(op);
+        if (keep && header.type == REC_ENQUEUE) {
+            // One record can cover the same message going onto more queues.
+            for (uint32_t q = 2 * sizeof(uint64_t);
+                 q + sizeof(uint64_t) <= header.size;
+                 q += sizeof(uint64_t)) {
+                ::memcpy(&op.queueId, payload + q, sizeof(uint64_t));
+                s.ops.push_back(op);
+            }
+        }
+        at += length;
+    }
+    s.torn = contents.size() - at;
+}
+
+class Scanner : public qpid::sys::Runnable {
+    std::vector<SegmentScan>& scans;
+    qpid::sys::AtomicValue<uint32_t>& next;
+public:
+    Scanner(std::vector<SegmentScan>& s, qpid::sys::AtomicValue<uint32_t>& n)
+        : scans(s), next(n) {}
+    void run() {
+        for (uint32_t i = next++; i < scans.size(); i = next++) {
+            try {
+                scan(scans[i]);
+            }
+            catch (const std::exception& e) {
+                scans[i].error = e.what();
+            }
+        }
+    }
+};
+
+struct LiveMessage {
+    uint64_t id;
+    int fd;
+    uint64_t segment;
+    uint64_t offset;
+    uint32_t size;
+    uint32_t headerSize;
+    qpid::broker::RecoverableMessage::shared_ptr msg;
+    bool operator<(const LiveMessage& o) const {
+        return segment < o.segment || (segment == o.segment && offset < o.offset);
+    }
+};
+
+// Decodes a run of live messages, read in file order.
+class Decoder : public qpid::sys::Runnable {
+    qpid::broker::RecoveryManager& recoverer;
+    std::vector<LiveMessage>& live;
+    size_t begin, end;
+public:
+    std::string error;
+    Decoder(qpid::broker::RecoveryManager& r, std::vector<LiveMessage>& l,
+            size_t b, size_t e)
+        : recoverer(r), live(l), begin(b), end(e) {}
+    void run() {
+        try {
+            std::vector<char> buffer;
+            for (size_t i = begin; i < end; ++i) {
+                LiveMessage& m = live[i];
+                // Read the header alone first; the content is read only if
+                // the broker wants it now rather than on first delivery.
+                buffer.resize(std::max<size_t>(m.headerSize, 1));
+                readFully(m.fd, &buffer[0], m.headerSize, m.offset);
+                qpid::framing::Buffer header(&buffer[0], m.headerSize);
+                m.msg = recoverer.recoverMessage(header);
+                m.msg->setPersistenceId(m.id);
+                uint32_t contentSize = m.size - m.headerSize;
+                if (m.msg->loadContent(contentSize)) {
+                    buffer.resize(std::max<size_t>(contentSize, 1));
+                    readFully(m.fd, &buffer[0], contentSize,
+                              m.offset + m.headerSize);
+                    qpid::framing::Buffer content(&buffer[0], contentSize);
+                    m.msg->decodeContent(content);
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+    }
+};
+
+// A live message being copied to the head of the journal.
+struct CompactCopy {
+    uint64_t id;
+    uint64_t offset;
+    uint32_t size;
+    uint32_t headerSize;
+    std::string encoded;
+};
+
+void
+eraseEnqueue(std::vector<std::pair<uint64_t, uint64_t> >& enqueues,
+             uint64_t queueId, uint64_t segment)
+{
+    for (std::vector<std::pair<uint64_t, uint64_t> >::iterator i = enqueues.begin();
+         i != enqueues.end();
+         ++i) {
+        if (i->first == queueId && (segment == 0 || i->second == segment)) {
+            enqueues.erase(i);
+            return;
+        }
+    }
+}
+
+// A compaction copy re-records the queues a message is already on; it
+// moves those enqueues to the new segment rather than adding to them.
+void
+addEnqueue(std::vector<std::pair<uint64_t, uint64_t> >& enqueues,
+           uint64_t queueId, uint64_t segment)
+{
+    for (std::vector<std::pair<uint64_t, uint64_t> >::iterator i = enqueues.begin();
+         i != enqueues.end();
+         ++i) {
+        if (i->first == queueId) {
+            i->second = segment;
+            return;
+        }
+    }
+    enqueues.push_back(std::make_pair(queueId, segment));
+}
+
+}
+
+/**
+ * @class ChunkBuffer
+ *
+ * Growable buffer for the records of one batch bound for one segment,
+ * aligned so it can be written with O_DIRECT.
+ */
+class ChunkBuffer {
+public:
+    char* data;
+    size_t size;
+
+    ChunkBuffer() : data(0), size(0), capacity(0) {}
+    ~ChunkBuffer() { ::free(data); }
+
+    char* extend(size_t n) {
+        if (size + n > capacity) {
+            size_t c = std::max(capacity * 2, InitialChunkSize);
+            while (c < size + n)
+                c *= 2;
+            void* p = 0;
+            if (::posix_memalign(&p, BlockSize, c) != 0)
+                throw std::bad_alloc();
+            if (size)
+                ::memcpy(p, data, size);
+            ::free(data);
+            data = static_cast<char*>(p);
+            capacity = c;
+        }
+        char* out = data + size;
+        size += n;
+        return out;
+    }
+
+private:
+    size_t capacity;
+};
+
+Journal::Journal()
+    : segmentSize(0), direct(false), current(0), durableBatch(0), nextId(1),
+      writerIdle(false), stopping(false), started(false), instrumentation(0),
+      liveBytes(0), compactRatio(0), compactor(*this)
+{
+}
+
+Journal::~Journal()
+{
+    stop();
+}
+
+std::string
+Journal::segmentPath(uint64_t seq) const
+{
+    std::ostringstream path;
+    path << dir << "/" << SegmentPrefix
+         << std::hex << std::setw(16) << std::setfill('0') << seq;
+    return path.str();
+}
+
+void
+Journal::open(const std::string& d, uint64_t size, bool dio)
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    dir = d;
+    segmentSize = size;
+    direct = dio;
+    if (::mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST)
+        THROW_STORE_EXCEPTION("Can't create " + dir + ": " +
+                              qpid::sys::strError(errno));
+    DIR* listing = ::opendir(dir.c_str());
+    if (!listing)
+        THROW_STORE_EXCEPTION("Can't read " + dir + ": " +
+                              qpid::sys::strError(errno));
+    while (struct dirent* entry = ::readdir(listing)) {
+        std::string name(entry->d_name);
+        if (name.compare(0, SegmentPrefix.size(), SegmentPrefix) != 0)
+            continue;
+        char* end = 0;
+        uint64_t seq = ::strtoull(name.c_str() + SegmentPrefix.size(), &end, 16);
+        if (seq == 0 || *end != '\0')
+            continue;
+        Segment& s = segments[seq];
+        s.readFd = ::open(segmentPath(seq).c_str(), O_RDONLY);
+        struct stat st;
+        if (s.readFd < 0 || ::fstat(s.readFd, &st) < 0) {
+            int err = errno;
+            ::closedir(listing);
+            THROW_STORE_EXCEPTION("Can't open " + segmentPath(seq) + ": " +
+                                  qpid::sys::strError(err));
+        }
+        s.size = st.st_size;
+        if (seq > current)
+            current = seq;
+    }
+    ::closedir(listing);
+}
+
+void
+Journal::recover(qpid::broker::RecoveryManager& recoverer,
+                 const std::set<uint64_t>& queues,
+                 unsigned threads,
+                 MessageMap& messageMap,
+                 MessageQueueMap& messageQueueMap,
+                 PreparedMap& preparedMap)
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+
+    // Scan the segments in parallel, keeping only what each record says.
+    std::vector<SegmentScan> scans(segments.size());
+    size_t n = 0;
+    for (Segments::const_iterator i = segments.begin(); i != segments.end(); ++i, ++n) {
+        scans[n].seq = i->first;
+        scans[n].path = segmentPath(i->first);
+    }
+    threads = std::max(1u, std::min<unsigned>(threads, scans.size()));
+    {
+        qpid::sys::AtomicValue<uint32_t> next(0);
+        Scanner scanner(scans, next);
+        std::vector<qpid::sys::Thread> running;
+        for (unsigned t = 1; t < threads; ++t)
+            running.push_back(qpid::sys::Thread(scanner));
+        scanner.run();
+        for (size_t t = 0; t < running.size(); ++t)
+            running[t].join();
+    }
+
+    // Apply the records in the order they were written.
+    typedef std::map<uint64_t, Transaction::shared_ptr> OpenTxns;
+    OpenTxns open;
+    uint64_t maxId = 0;
+    for (std::vector<SegmentScan>::const_iterator s = scans.begin(); s != scans.end(); ++s) {
+        if (!s->error.empty())
+            THROW_STORE_EXCEPTION(s->error);
+        if (s->torn)
+            QPID_LOG(warning, "Journal store: ignoring " << s->torn
+                     << " bytes after the last complete record in " << s->path);
+        for (std::vector<ScanOp>::const_iterator op = s->ops.begin(); op != s->ops.end(); ++op) {
+            maxId = std::max(maxId, op->id);
+            switch (op->type) {
+            case REC_MESSAGE: {
+                // A second record for a message is a compaction copy,
+                // followed by an enqueue for each queue it was still on.
+                // Those may be missing if compaction was interrupted, so
+                // the enqueues already read stand until they arrive; the
+                // segment holding them is kept as they still refer to it.
+                MessageInfo& info = messages[op->id];
+                info.segment = s->seq;
+                info.offset = op->offset;
+                info.size = op->size;
+                info.headerSize = op->headerSize;
+                break;
+            }
+            case REC_ENQUEUE:
+            case REC_DEQUEUE: {
+                bool enq = op->type == REC_ENQUEUE;
+                if (op->txnId) {
+                    Transaction::shared_ptr& t = open[op->txnId];
+                    if (!t)
+                        t.reset(new Transaction(op->txnId));
+                    t->ops.push_back(Transaction::Op(enq, op->id, op->queueId, s->seq));
+                    maxId = std::max(maxId, op->txnId);
+                    break;
+                }
+                Messages::iterator m = messages.find(op->id);
+                if (m == messages.end())
+                    break;
+                if (!enq)
+                    eraseEnqueue(m->second.enqueues, op->queueId, 0);
+                else if (queues.count(op->queueId))
+                    addEnqueue(m->second.enqueues, op->queueId, s->seq);
+                break;
+            }
+            case REC_PREPARE: {
+                Transaction::shared_ptr& t = open[op->id];
+                if (!t)
+                    t.reset(new Transaction(op->id));
+                t->xid = op->xid;
+                t->prepared = true;
+                t->prepareSegment = s->seq;
+                break;
+            }
+            case REC_COMMIT: {
+                OpenTxns::iterator t = open.find(op->id);
+                if (t == open.end())
+                    break;
+                const std::vector<Transaction::Op>& ops = t->second->ops;
+                for (std::vector<Transaction::Op>::const_iterator o = ops.begin(); o != ops.end(); ++o) {
+                    Messages::iterator m = messages.find(o->msgId);
+                    if (m == messages.end())
+                        continue;
+                    if (!o->enqueue)
+                        eraseEnqueue(m->second.enqueues, o->queueId, 0);
+                    else if (queues.count(o->queueId))
+                        m->second.enqueues.push_back(std::make_pair(o->queueId, o->segment));
+                }
+                open.erase(t);
+                break;
+            }
+            case REC_ABORT:
+                open.erase(op->id);
+                break;
+            }
+        }
+    }
+    scans.clear();
+
+    // Settled enqueues first, then what prepared transactions would change.
+    for (Messages::const_iterator m = messages.begin(); m != messages.end(); ++m) {
+        for (size_t e = 0; e < m->second.enqueues.size(); ++e)
+            messageQueueMap[m->first].push_back(QueueEntry(m->second.enqueues[e].first));
+    }
+    for (OpenTxns::iterator t = open.begin(); t != open.end(); ++t) {
+        Transaction::shared_ptr txn = t->second;
+        if (!txn->prepared)
+            continue;           // Never prepared, so it was rolled back
+        std::vector<Transaction::Op> kept;
+        for (std::vector<Transaction::Op>::const_iterator o = txn->ops.begin(); o != txn->ops.end(); ++o) {
+            Messages::iterator m = messages.find(o->msgId);
+            if (m == messages.end() || !queues.count(o->queueId))
+                continue;
+            std::vector<QueueEntry>& entries = messageQueueMap[o->msgId];
+            if (o->enqueue) {
+                m->second.enqueues.push_back(std::make_pair(o->queueId, o->segment));
+                entries.push_back(QueueEntry(o->queueId, QueueEntry::ADDING, txn->xid));
+            }
+            else {
+                for (std::vector<QueueEntry>::iterator e = entries.begin(); e != entries.end(); ++e) {
+                    if (e->queueId == o->queueId && e->tplStatus == QueueEntry::NONE) {
+                        e->tplStatus = QueueEntry::REMOVING;
+                        e->xid = txn->xid;
+                        break;
+                    }
+                }
+            }
+            kept.push_back(*o);
+        }
+        txn->ops.swap(kept);
+        Segments::iterator s = segments.find(txn->prepareSegment);
+        if (s != segments.end())
+            ++s->second.refs;
+        preparedMap[txn->xid] = txn;
+        preparedXids.insert(txn->xid);
+    }
+
+    // Count what is still live in each segment, and collect the messages.
+    std::vector<LiveMessage> live;
+    for (Messages::iterator m = messages.begin(); m != messages.end(); ) {
+        Messages::iterator i = m++;
+        MessageInfo& info = i->second;
+        if (info.enqueues.empty()) {
+            messageQueueMap.erase(i->first);
+            messages.erase(i);
+            continue;
+        }
+        Segment& seg = segments[info.segment];
+        ++seg.refs;
+        liveBytes += info.size;
+        for (size_t e = 0; e < info.enqueues.size(); ++e)
+            ++segments[info.enqueues[e].second].refs;
+        LiveMessage lm;
+        lm.id = i->first;
+        lm.fd = seg.readFd;
+        lm.segment = info.segment;
+        lm.offset = info.offset;
+        lm.size = info.size;
+        lm.headerSize = info.headerSize;
+        live.push_back(lm);
+    }
+
+    // Decode the live messages again, each thread reading a run in order.
+    std::sort(live.begin(), live.end());
+    threads = std::max(1u, std::min<unsigned>(threads, live.size()));
+    {
+        boost::ptr_vector<Decoder> decoders;
+        size_t per = live.size() / threads + 1;
+        for (size_t begin = 0; begin < live.size(); begin += per)
+            decoders.push_back(new Decoder(recoverer, live, begin,
+                                           std::min(begin + per, live.size())));
+        std::vector<qpid::sys::Thread> running;
+        for (size_t d = 1; d < decoders.size(); ++d)
+            running.push_back(qpid::sys::Thread(decoders[d]));
+        if (!decoders.empty())
+            decoders[0].run();
+        for (size_t t = 0; t < running.size(); ++t)
+            running[t].join();
+        for (size_t d = 0; d < decoders.size(); ++d)
+            if (!decoders[d].error.empty())
+                THROW_STORE_EXCEPTION(decoders[d].error);
+    }
+    for (std::vector<LiveMessage>::const_iterator m = live.begin(); m != live.end(); ++m)
+        messageMap[m->id] = m->msg;
+
+    if (maxId >= nextId)
+        nextId = maxId + 1;
+
+    QPID_LOG(notice, "Journal store: recovered " << live.size() << " messages and "
+             << preparedXids.size() << " prepared transactions from "
+             << segments.size() << " segments");
+
+    // New records go to a new segment; old ones with nothing live can go.
+    if (!started)
+        startThreads();
+    std::vector<std::string> paths;
+    std::vector<int> fds;
+    reclaim(paths, fds);
+    for (size_t i = 0; i < paths.size(); ++i)
+        ::unlink(paths[i].c_str());
+    for (size_t i = 0; i < fds.size(); ++i)
+        ::close(fds[i]);
+}
+
+void
+Journal::start()
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    if (!started)
+        startThreads();
+}
+
+void
+Journal::stop()
+{
+    {
+        qpid::sys::Mutex::ScopedLock l(lock);
+        if (started) {
+            stopping = true;
+            writerWake.notify();
+            compactWake.notify();
+        }
+    }
+    if (started) {
+        // The compactor first, as the writer must write what it appended.
+        if (compactorThread)
+            compactorThread.join();
+        writer.join();
+        started = false;
+    }
+    qpid::sys::Mutex::ScopedLock l(lock);
+    for (Segments::iterator i = segments.begin(); i != segments.end(); ++i) {
+        if (i->second.readFd >= 0 && i->second.readFd != i->second.fd)
+            ::close(i->second.readFd);
+        if (i->second.fd >= 0)
+            ::close(i->second.fd);
+        i->second.fd = i->second.readFd = -1;
+    }
+}
+
+uint64_t
+Journal::newId()
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    return nextId++;
+}
+
+void
+Journal::reserveIds(uint64_t next)
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    if (next > nextId)
+        nextId = next;
+}
+
+void
+Journal::stage(const boost::intrusive_ptr<PersistableMessage>& msg)
+{
+    std::string encoded;
+    if (!msg->getPersistenceId())
+        encode(*msg, encoded);
+    qpid::sys::Mutex::ScopedLock l(lock);
+    storeMessage(msg, encoded)->second.staged = true;
+}
+
+void
+Journal::destroy(uint64_t msgId)
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    Messages::iterator i = messages.find(msgId);
+    if (i == messages.end())
+        return;
+    i->second.staged = false;
+    dropIfUnused(i);
+}
+
+void
+Journal::enqueue(Transaction* txn,
+                 const boost::intrusive_ptr<PersistableMessage>& msg,
+                 uint64_t queueId)
+{
+    // Encode outside the lock; only the copy into the batch is serialized.
+    // A message routed to several queues in a transaction, as a fanout
+    // is, arrives here once per queue but is only encoded once.
+    bool known = msg->getPersistenceId() != 0;
+    if (txn && !known) {
+        qpid::sys::Mutex::ScopedLock l(lock);
+        known = !txn->deferred.empty() && txn->deferred.back().msg == msg;
+    }
+    std::string encoded;
+    if (!known)
+        encode(*msg, encoded);
+    qpid::sys::Mutex::ScopedLock l(lock);
+    if (txn) {
+        txn->deferred.push_back(Transaction::Deferred(true, msg, queueId));
+        txn->deferred.back().encoded.swap(encoded);
+        return;
+    }
+    appendEnqueue(0, msg, encoded, std::vector<uint64_t>(1, queueId));
+}
+
+void
+Journal::dequeue(Transaction* txn,
+                 const boost::intrusive_ptr<PersistableMessage>& msg,
+                 uint64_t queueId)
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    if (txn) {
+        txn->deferred.push_back(Transaction::Deferred(false, msg, queueId));
+        return;
+    }
+    uint64_t msgId = msg->getPersistenceId();
+    appendOp(REC_DEQUEUE, msgId, queueId, 0);
+    removeEnqueue(msgId, queueId, 0);
+    pending.completions.push_back(boost::bind(&PersistableMessage::dequeueComplete, msg));
+}
+
+void
+Journal::expunge(uint64_t queueId)
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    for (Messages::iterator m = messages.begin(); m != messages.end(); ) {
+        Messages::iterator i = m++;
+        std::vector<std::pair<uint64_t, uint64_t> >& enqueues = i->second.enqueues;
+        for (size_t e = 0; e < enqueues.size(); ) {
+            if (enqueues[e].first == queueId) {
+                release(enqueues[e].second);
+                enqueues.erase(enqueues.begin() + e);
+            }
+            else {
+                ++e;
+            }
+        }
+        dropIfUnused(i);
+    }
+}
+
+void
+Journal::loadContent(uint64_t msgId, std::string& data,
+                     uint64_t offset, uint32_t length)
+{
+    int fd;
+    uint64_t at;
+    {
+        qpid::sys::Mutex::ScopedLock l(lock);
+        Messages::iterator i = messages.find(msgId);
+        if (i == messages.end()) {
+            std::ostringstream oss;
+            oss << "Journal store: no content for message " << msgId;
+            THROW_STORE_EXCEPTION(oss.str());
+        }
+        waitFor(i->second.batch);
+        const MessageInfo& info = i->second;
+        uint64_t contentSize = info.size - info.headerSize;
+        if (offset >= contentSize) {
+            data.clear();
+            return;
+        }
+        length = std::min<uint64_t>(length, contentSize - offset);
+        at = info.offset + info.headerSize + offset;
+        // A dup keeps the file open for the read should the segment go.
+        fd = ::dup(segments[info.segment].readFd);
+        if (fd < 0)
+            THROW_STORE_EXCEPTION("Journal store: " + qpid::sys::strError(errno));
+    }
+    data.resize(length);
+    try {
+        if (length)
+            readFully(fd, &data[0], length, at);
+    }
+    catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    if (instrumentation)
+        instrumentation->bytesRead(length);
+}
+
+Transaction::shared_ptr
+Journal::begin(const std::string& xid)
+{
+    return Transaction::shared_ptr(new Transaction(newId(), xid));
+}
+
+void
+Journal::prepare(Transaction& txn)
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    appendDeferred(txn);
+    Location loc = append(REC_PREPARE, txn.id, txn.xid.data(), txn.xid.size());
+    ++segments[loc.segment].refs;
+    txn.prepared = true;
+    txn.prepareSegment = loc.segment;
+    preparedXids.insert(txn.xid);
+    waitFor(pending.number);
+}
+
+void
+Journal::commit(Transaction& txn)
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    if (!txn.prepared && !txn.deferred.empty()) {
+        appendTransaction(txn);
+        waitFor(pending.number);
+        return;
+    }
+    if (txn.ops.empty() && !txn.prepared)
+        return;
+    append(REC_COMMIT, txn.id, 0, 0);
+    for (std::vector<Transaction::Op>::const_iterator o = txn.ops.begin(); o != txn.ops.end(); ++o) {
+        if (!o->enqueue)
+            removeEnqueue(o->msgId, o->queueId, 0);
+    }
+    if (txn.prepared) {
+        release(txn.prepareSegment);
+        preparedXids.erase(txn.xid);
+        txn.prepared = false;
+    }
+    txn.ops.clear();
+    waitFor(pending.number);
+}
+
+void
+Journal::abort(Transaction& txn)
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    // Nothing held back was journalled, but each operation still completes.
+    for (std::vector<Transaction::Deferred>::const_iterator d = txn.deferred.begin();
+         d != txn.deferred.end();
+         ++d) {
+        pending.completions.push_back(
+            boost::bind(d->enqueue ? &PersistableMessage::enqueueComplete
+                                   : &PersistableMessage::dequeueComplete, d->msg));
+    }
+    if (!txn.deferred.empty()) {
+        txn.deferred.clear();
+        wake();
+    }
+    if (txn.ops.empty() && !txn.prepared)
+        return;
+    append(REC_ABORT, txn.id, 0, 0);
+    for (std::vector<Transaction::Op>::const_iterator o = txn.ops.begin(); o != txn.ops.end(); ++o) {
+        if (o->enqueue)
+            removeEnqueue(o->msgId, o->queueId, o->segment);
+    }
+    txn.ops.clear();
+    if (txn.prepared) {
+        release(txn.prepareSegment);
+        preparedXids.erase(txn.xid);
+        txn.prepared = false;
+        waitFor(pending.number);
+    }
+}
+
+void
+Journal::collectPreparedXids(std::set<std::string>& xids)
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    xids.insert(preparedXids.begin(), preparedXids.end());
+}
+
+void
+Journal::run()
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    while (true) {
+        while (pending.empty() && !stopping) {
+            writerIdle = true;
+            writerWake.wait(lock);
+        }
+        writerIdle = false;
+        if (pending.empty())
+            break;
+
+        // Take everything appended so far as one batch.
+        if (direct) {
+            for (size_t i = 0; i < pending.chunks.size(); ++i)
+                pad(pending.chunks[i]);
+        }
+        Batch batch;
+        batch.number = pending.number;
+        batch.chunks.swap(pending.chunks);
+        batch.completions.swap(pending.completions);
+        batch.releases.swap(pending.releases);
+        batch.newSegment = pending.newSegment;
+        pending.newSegment = false;
+        pending.number = batch.number + 1;
+        std::vector<int> fds;
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < batch.chunks.size(); ++i) {
+            fds.push_back(segments[batch.chunks[i].segment].fd);
+            bytes += batch.chunks[i].buffer->size;
+        }
+
+        std::string error;
+        {
+            qpid::sys::Mutex::ScopedUnlock u(lock);
+            try {
+                for (size_t i = 0; i < batch.chunks.size(); ++i) {
+                    const Chunk& c = batch.chunks[i];
+                    writeFully(fds[i], c.buffer->data, c.buffer->size, c.offset);
+                }
+                for (size_t i = 0; i < fds.size(); ++i) {
+                    if (::fdatasync(fds[i]) < 0)
+                        THROW_STORE_EXCEPTION("Journal sync failed: " +
+                                              qpid::sys::strError(errno));
+                }
+                if (batch.newSegment)
+                    syncDirectory(dir);
+            }
+            catch (const std::exception& e) {
+                error = e.what();
+            }
+        }
+        if (!error.empty()) {
+            QPID_LOG(critical, "Journal store: " << error);
+            failure = error;
+            durable.notifyAll();
+            break;
+        }
+
+        durableBatch = batch.number;
+        for (size_t i = 0; i < batch.releases.size(); ++i) {
+            Segments::iterator s = segments.find(batch.releases[i]);
+            if (s != segments.end() && s->second.refs > 0)
+                --s->second.refs;
+        }
+        std::vector<std::string> paths;
+        std::vector<int> closing;
+        reclaim(paths, closing);
+        durable.notifyAll();
+
+        qpid::sys::Mutex::ScopedUnlock u(lock);
+        if (instrumentation && bytes)
+            instrumentation->bytesWritten(bytes);
+        for (size_t i = 0; i < paths.size(); ++i) {
+            QPID_LOG(debug, "Journal store: removing " << paths[i]);
+            ::unlink(paths[i].c_str());
+        }
+        for (size_t i = 0; i < closing.size(); ++i)
+            ::close(closing[i]);
+        for (size_t i = 0; i < batch.completions.size(); ++i) {
+            try {
+                batch.completions[i]();
+            }
+            catch (const std::exception& e) {
+                QPID_LOG(error, "Journal store: completion failed: " << e.what());
+            }
+        }
+    }
+}
+
+// The methods below are called with lock held.
+
+void
+Journal::check()
+{
+    if (!failure.empty())
+        THROW_STORE_EXCEPTION("Journal store failed: " + failure);
+    if (!started)
+        THROW_STORE_EXCEPTION("Journal store not started");
+}
+
+void
+Journal::wake()
+{
+    if (writerIdle)
+        writerWake.notify();
+}
+
+void
+Journal::roll()
+{
+    uint64_t seq = current + 1;
+    std::string path = segmentPath(seq);
+    int flags = O_RDWR | O_CREAT | O_EXCL;
+    int fd = ::open(path.c_str(), flags | (direct ? O_DIRECT : 0), 0644);
+    if (fd < 0 && direct && errno == EINVAL) {
+        QPID_LOG(warning, "Journal store: " << dir
+                 << " does not support direct I/O; using buffered writes");
+        direct = false;
+        fd = ::open(path.c_str(), flags, 0644);
+    }
+    if (fd < 0)
+        THROW_STORE_EXCEPTION("Can't create " + path + ": " +
+                              qpid::sys::strError(errno));
+    Segment& s = segments[seq];
+    s.fd = fd;
+    s.readFd = direct ? ::open(path.c_str(), O_RDONLY) : fd;
+    if (s.readFd < 0)
+        THROW_STORE_EXCEPTION("Can't open " + path + ": " +
+                              qpid::sys::strError(errno));
+    s.lastBatch = pending.number;
+    current = seq;
+    pending.newSegment = true;
+}
+
+Journal::Location
+Journal::append(RecordType type, uint64_t id, const char* payload, uint32_t size)
+{
+    check();
+    uint32_t length = sizeof(RecordHeader) + size;
+    if (segments[current].size > 0 && segments[current].size + length > segmentSize)
+        roll();
+    Segment& seg = segments[current];
+    if (pending.chunks.empty() || pending.chunks.back().segment != current) {
+        Chunk c;
+        c.segment = current;
+        c.offset = seg.size;
+        c.buffer.reset(new ChunkBuffer);
+        pending.chunks.push_back(c);
+    }
+    writeRecord(pending.chunks.back().buffer->extend(length), type, id, payload, size);
+    Location loc = { current, seg.size };
+    seg.size += length;
+    seg.lastBatch = pending.number;
+    wake();
+    return loc;
+}
+
+Journal::Location
+Journal::appendOp(RecordType type, uint64_t msgId, uint64_t queueId, uint64_t txnId)
+{
+    char payload[2 * sizeof(uint64_t)];
+    ::memcpy(payload, &queueId, sizeof(uint64_t));
+    ::memcpy(payload + sizeof(uint64_t), &txnId, sizeof(uint64_t));
+    return append(type, msgId, payload, sizeof(payload));
+}
+
+void
+Journal::appendEnqueue(Transaction* txn,
+                       const boost::intrusive_ptr<PersistableMessage>& msg,
+                       const std::string& encoded,
+                       const std::vector<uint64_t>& queueIds)
+{
+    // Laid out as a single enqueue's payload, with the other queues after.
+    std::vector<uint64_t> payload(queueIds.size() + 1);
+    payload[0] = queueIds[0];
+    payload[1] = txn ? txn->id : 0;
+    std::copy(queueIds.begin() + 1, queueIds.end(), payload.begin() + 2);
+    Messages::iterator i = storeMessage(msg, encoded);
+    Location loc = append(REC_ENQUEUE, i->first,
+                          reinterpret_cast<const char*>(&payload[0]),
+                          payload.size() * sizeof(uint64_t));
+    for (size_t q = 0; q < queueIds.size(); ++q) {
+        ++segments[loc.segment].refs;
+        i->second.enqueues.push_back(std::make_pair(queueIds[q], loc.segment));
+        if (txn)
+            txn->ops.push_back(Transaction::Op(true, i->first, queueIds[q], loc.segment));
+        pending.completions.push_back(boost::bind(&PersistableMessage::enqueueComplete, msg));
+    }
+}
+
+void
+Journal::appendDeferred(Transaction& txn)
+{
+    std::vector<Transaction::Deferred> deferred;
+    deferred.swap(txn.deferred);
+    for (size_t d = 0; d < deferred.size(); ) {
+        const Transaction::Deferred& first = deferred[d];
+        if (!first.enqueue) {
+            uint64_t msgId = first.msg->getPersistenceId();
+            appendOp(REC_DEQUEUE, msgId, first.queueId, txn.id);
+            txn.ops.push_back(Transaction::Op(false, msgId, first.queueId, 0));
+            pending.completions.push_back(boost::bind(&PersistableMessage::dequeueComplete,
+                                                      first.msg));
+            ++d;
+            continue;
+        }
+        // Enqueues of one message in a row share a record.
+        std::vector<uint64_t> queueIds;
+        size_t e = d;
+        for (; e < deferred.size() && deferred[e].enqueue && deferred[e].msg == first.msg; ++e)
+            queueIds.push_back(deferred[e].queueId);
+        appendEnqueue(&txn, first.msg, first.encoded, queueIds);
+        d = e;
+    }
+}
+
+void
+Journal::appendTransaction(Transaction& txn)
+{
+    std::vector<Transaction::Deferred> deferred;
+    deferred.swap(txn.deferred);
+    std::vector<Messages::iterator> stored(deferred.size(), messages.end());
+    std::string payload;
+    for (size_t d = 0; d < deferred.size(); ) {
+        // A group is a run of enqueues, or of dequeues, of one message.
+        const Transaction::Deferred& first = deferred[d];
+        if (first.enqueue)
+            stored[d] = storeMessage(first.msg, first.encoded);
+        uint64_t msgId = first.msg->getPersistenceId();
+        uint32_t type = first.enqueue ? REC_ENQUEUE : REC_DEQUEUE;
+        uint32_t count = 0;
+        size_t e = d;
+        for (; e < deferred.size() && deferred[e].enqueue == first.enqueue &&
+                 deferred[e].msg == first.msg; ++e) {
+            stored[e] = stored[d];
+            ++count;
+        }
+        payload.append(reinterpret_cast<const char*>(&msgId), sizeof(msgId));
+        payload.append(reinterpret_cast<const char*>(&type), sizeof(type));
+        payload.append(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (; d < e; ++d)
+            payload.append(reinterpret_cast<const char*>(&deferred[d].queueId),
+                           sizeof(uint64_t));
+    }
+    Location loc = append(REC_TRANSACTION, txn.id, payload.data(), payload.size());
+    for (size_t d = 0; d < deferred.size(); ++d) {
+        const Transaction::Deferred& op = deferred[d];
+        if (op.enqueue) {
+            ++segments[loc.segment].refs;
+            stored[d]->second.enqueues.push_back(std::make_pair(op.queueId, loc.segment));
+            pending.completions.push_back(boost::bind(&PersistableMessage::enqueueComplete,
+                                                      op.msg));
+        }
+        else {
+            removeEnqueue(op.msg->getPersistenceId(), op.queueId, 0);
+            pending.completions.push_back(boost::bind(&PersistableMessage::dequeueComplete,
+                                                      op.msg));
+        }
+    }
+}
+
+Journal::Messages::iterator
+Journal::storeMessage(const boost::intrusive_ptr<PersistableMessage>& msg,
+                      const std::string& encoded)
+{
+    uint64_t id = msg->getPersistenceId();
+    if (id) {
+        Messages::iterator i = messages.find(id);
+        if (i == messages.end()) {
+            std::ostringstream oss;
+            oss << "Journal store: unknown message " << id;
+            THROW_STORE_EXCEPTION(oss.str());
+        }
+        return i;
+    }
+    id = nextId++;
+    Location loc = append(REC_MESSAGE, id, encoded.data(), encoded.size());
+    msg->setPersistenceId(id);
+    MessageInfo& info = messages[id];
+    info.segment = loc.segment;
+    info.offset = loc.offset + sizeof(RecordHeader) + sizeof(uint32_t);
+    info.size = encoded.size() - sizeof(uint32_t);
+    ::memcpy(&info.headerSize, encoded.data(), sizeof(uint32_t));
+    info.batch = pending.number;
+    ++segments[loc.segment].refs;
+    liveBytes += info.size;
+    return messages.find(id);
+}
+
+void
+Journal::removeEnqueue(uint64_t msgId, uint64_t queueId, uint64_t segment)
+{
+    Messages::iterator i = messages.find(msgId);
+    if (i == messages.end())
+        return;
+    std::vector<std::pair<uint64_t, uint64_t> >& enqueues = i->second.enqueues;
+    for (size_t e = 0; e < enqueues.size(); ++e) {
+        if (enqueues[e].first == queueId &&
+            (segment == 0 || enqueues[e].second == segment)) {
+            release(enqueues[e].second);
+            enqueues.erase(enqueues.begin() + e);
+            break;
+        }
+    }
+    dropIfUnused(i);
+}
+
+void
+Journal::dropIfUnused(Messages::iterator i)
+{
+    if (i->second.staged || !i->second.enqueues.empty())
+        return;
+    release(i->second.segment);
+    liveBytes -= i->second.size;
+    messages.erase(i);
+}
+
+void
+Journal::release(uint64_t segment)
+{
+    pending.releases.push_back(segment);
+    wake();
+}
+
+void
+Journal::waitFor(uint64_t batch)
+{
+    while (durableBatch < batch && failure.empty())
+        durable.wait(lock);
+    if (!failure.empty())
+        THROW_STORE_EXCEPTION("Journal store failed: " + failure);
+}
+
+void
+Journal::pad(Chunk& chunk)
+{
+    Segment& seg = segments[chunk.segment];
+    uint64_t end = chunk.offset + chunk.buffer->size;
+    uint64_t gap = (BlockSize - end % BlockSize) % BlockSize;
+    if (gap == 0)
+        return;
+    if (gap < sizeof(RecordHeader))
+        gap += BlockSize;
+    char* out = chunk.buffer->extend(gap);
+    ::memset(out, 0, gap);
+    RecordHeader header(REC_PAD, 0, gap - sizeof(RecordHeader));
+    header.checksum = checksum(header, out + sizeof(RecordHeader));
+    ::memcpy(out, &header, sizeof(header));
+    seg.size += gap;
+}
+
+void
+Journal::reclaim(std::vector<std::string>& paths, std::vector<int>& fds)
+{
+    while (!segments.empty()) {
+        Segments::iterator s = segments.begin();
+        if (s->first == current || s->second.refs > 0 ||
+            s->second.lastBatch > durableBatch)
+            break;
+        paths.push_back(segmentPath(s->first));
+        if (s->second.fd >= 0)
+            fds.push_back(s->second.fd);
+        if (s->second.readFd >= 0 && s->second.readFd != s->second.fd)
+            fds.push_back(s->second.readFd);
+        segments.erase(s);
+    }
+}
+
+void
+Journal::startThreads()
+{
+    roll();
+    started = true;
+    writer = qpid::sys::Thread(*this);
+    if (compactRatio)
+        compactorThread = qpid::sys::Thread(compactor);
+}
+
+bool
+Journal::needsCompaction() const
+{
+    // Enqueues of a prepared transaction can't be copied as settled ones.
+    if (segments.size() < 3 || !preparedXids.empty())
+        return false;
+    uint64_t total = 0;
+    for (Segments::const_iterator s = segments.begin(); s != segments.end(); ++s)
+        total += s->second.size;
+    return total > compactRatio * liveBytes + 2 * segmentSize;
+}
+
+void
+Journal::compactLoop()
+{
+    qpid::sys::Mutex::ScopedLock l(lock);
+    try {
+        while (!stopping && failure.empty()) {
+            if (needsCompaction() && compactOldest()) {
+                // Let the oldest segment go before judging the rest.
+                waitFor(pending.number);
+                continue;
+            }
+            compactWake.wait(lock, qpid::sys::AbsTime(qpid::sys::now(),
+                                                      qpid::sys::TIME_SEC));
+        }
+    }
+    catch (const std::exception& e) {
+        QPID_LOG(error, "Journal store: compaction stopped: " << e.what());
+    }
+}
+
+bool
+Journal::compactOldest()
+{
+    Segments::iterator oldest = segments.begin();
+    uint64_t seq = oldest->first;
+    if (seq == current)
+        return false;
+    std::vector<CompactCopy> copies;
+    for (Messages::const_iterator m = messages.begin(); m != messages.end(); ++m) {
+        if (m->second.segment != seq)
+            continue;
+        CompactCopy c;
+        c.id = m->first;
+        c.offset = m->second.offset;
+        c.size = m->second.size;
+        c.headerSize = m->second.headerSize;
+        copies.push_back(c);
+    }
+    if (copies.empty())
+        return false;
+
+    // Read them in file order without the lock. A dup keeps the file open.
+    int fd = ::dup(oldest->second.readFd);
+    if (fd < 0)
+        THROW_STORE_EXCEPTION("Journal store: " + qpid::sys::strError(errno));
+    uint64_t bytes = 0;
+    {
+        qpid::sys::Mutex::ScopedUnlock u(lock);
+        try {
+            for (size_t i = 0; i < copies.size(); ++i) {
+                CompactCopy& c = copies[i];
+                c.encoded.resize(sizeof(uint32_t) + c.size);
+                ::memcpy(&c.encoded[0], &c.headerSize, sizeof(uint32_t));
+                if (c.size)
+                    readFully(fd, &c.encoded[sizeof(uint32_t)], c.size, c.offset);
+                bytes += c.size;
+            }
+        }
+        catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+        if (instrumentation)
+            instrumentation->bytesRead(bytes);
+    }
+    if (stopping || !preparedXids.empty())
+        return false;
+
+    // Append a copy of each message still live where it was, then one
+    // enqueue for all the queues it is on, and release the old records.
+    size_t copied = 0;
+    for (size_t i = 0; i < copies.size(); ++i) {
+        const CompactCopy& c = copies[i];
+        Messages::iterator m = messages.find(c.id);
+        if (m == messages.end() || m->second.segment != seq || m->second.offset != c.offset)
+            continue;
+        MessageInfo& info = m->second;
+        Location loc = append(REC_MESSAGE, c.id, c.encoded.data(), c.encoded.size());
+        ++segments[loc.segment].refs;
+        release(info.segment);
+        info.segment = loc.segment;
+        info.offset = loc.offset + sizeof(RecordHeader) + sizeof(uint32_t);
+        info.batch = pending.number;
+        if (!info.enqueues.empty()) {
+            std::vector<uint64_t> payload(info.enqueues.size() + 1);
+            payload[0] = info.enqueues[0].first;
+            payload[1] = 0;
+            for (size_t q = 1; q < info.enqueues.size(); ++q)
+                payload[q + 1] = info.enqueues[q].first;
+            Location enq = append(REC_ENQUEUE, c.id,
+                                  reinterpret_cast<const char*>(&payload[0]),
+                                  payload.size() * sizeof(uint64_t));
+            for (size_t q = 0; q < info.enqueues.size(); ++q) {
+                release(info.enqueues[q].second);
+                info.enqueues[q].second = enq.segment;
+                ++segments[enq.segment].refs;
+            }
+        }
+        ++copied;
+    }
+    QPID_LOG(debug, "Journal store: compacted " << copied << " messages ("
+             << bytes << " bytes) out of " << segmentPath(seq));
+    return copied > 0;
+}
+
+}}} // namespace qpid::store::journal
@@ -0,0 +1,259 @@
+#ifndef QPID_STORE_JOURNAL_JOURNAL_H
+#define QPID_STORE_JOURNAL_JOURNAL_H
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/intrusive_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <qpid/broker/PersistableMessage.h>
+#include <qpid/broker/RecoveryManager.h>
+#include <qpid/store/StorageProvider.h>
+#include <qpid/sys/Condition.h>
+#include <qpid/sys/Mutex.h>
+#include <qpid/sys/Runnable.h>
+#include <qpid/sys/Thread.h>
+
+#include "Record.h"
+#include "Transaction.h"
+
+namespace qpid {
+namespace store {
+namespace journal {
+
+class ChunkBuffer;
+
+/**
+ * @class Journal
+ *
+ * Append-only message journal kept in a directory of fixed-size segment
+ * files. Callers append records under a lock into an in-memory batch; a
+ * single writer thread takes the whole batch, writes it and syncs it
+ * once, then runs the completions of every operation in it. Operations
+ * from all connections that arrive during one sync therefore share the
+ * next one.
+ *
+ * Each segment counts the live records in it: messages still on a queue
+ * or staged, enqueues not yet dequeued and prepared transactions. A
+ * segment is deleted once its count is zero and every older segment has
+ * gone, so a dequeue record can never outlive the enqueue it cancels.
+ * Counts only drop after the record that dropped them is on disk.
+ *
+ * One long lived message would otherwise keep every later segment too,
+ * so that recovery reads a log of any length. A compactor thread
+ * therefore copies the live messages of the oldest segment, with their
+ * enqueues, to the head of the journal once the segments hold more
+ * than a given multiple of the live message bytes. The copies release
+ * the oldest segment. The journal then stays within that multiple of
+ * the live data, and so does the time to recover it.
+ */
+class Journal : public qpid::sys::Runnable {
+public:
+    typedef std::map<std::string, Transaction::shared_ptr> PreparedMap;
+
+    Journal();
+    ~Journal();
+
+    /**
+     * Find the segments in @a dir, creating it if needed. Writes go to
+     * new segments of about @a segmentSize bytes; if @a direct they are
+     * opened O_DIRECT and each batch is padded to a whole block.
+     */
+    void open(const std::string& dir, uint64_t segmentSize, bool direct);
+
+    /**
+     * Rebuild the message state from the segments. They are scanned by
+     * up to @a threads threads, the records applied in order, and the
+     * live messages decoded again in parallel. Enqueues on queues not in
+     * @a queues are dropped.
+     */
+    void recover(qpid::broker::RecoveryManager& recoverer,
+                 const std::set<uint64_t>& queues,
+                 unsigned threads,
+                 MessageMap& messageMap,
+                 MessageQueueMap& messageQueueMap,
+                 PreparedMap& prepared);
+
+    /** Where the bytes written and read are reported; may be 0. */
+    void instrument(StorageProvider::Instrumentation* i) { instrumentation = i; }
+
+    /**
+     * Compact once the segments hold more than @a ratio times the live
+     * message bytes, plus two segments; 0 turns compaction off. Set
+     * before the journal starts.
+     */
+    void compactAbove(uint32_t ratio) { compactRatio = ratio; }
+
+    /** Start the writer on a fresh segment; does nothing if started. */
+    void start();
+    /** Write out everything pending and stop the writer. */
+    void stop();
+
+    /**
+     * Persistence ids for messages, transactions and configuration all
+     * come from here, so that none is ever reused.
+     */
+    uint64_t newId();
+    void reserveIds(uint64_t next);
+
+    void stage(const boost::intrusive_ptr<PersistableMessage>& msg);
+    void destroy(uint64_t msgId);
+    /**
+     * Under a transaction, enqueues and dequeues are held until it is
+     * prepared or committed. A one-phase commit journals them all as one
+     * record; on a prepare, enqueues of one message on several queues in
+     * a row, as a fanout gives, still share a record.
+     */
+    void enqueue(Transaction* txn,
+                 const boost::intrusive_ptr<PersistableMessage>& msg,
+                 uint64_t queueId);
+    void dequeue(Transaction* txn,
+                 const boost::intrusive_ptr<PersistableMessage>& msg,
+                 uint64_t queueId);
+    /** Forget all enqueues on a deleted queue. */
+    void expunge(uint64_t queueId);
+    void loadContent(uint64_t msgId, std::string& data,
+                     uint64_t offset, uint32_t length);
+
+    Transaction::shared_ptr begin(const std::string& xid = std::string());
+    void prepare(Transaction& txn);
+    void commit(Transaction& txn);
+    void abort(Transaction& txn);
+    void collectPreparedXids(std::set<std::string>& xids);
+
+    void run();
+
+private:
+    class Compactor : public qpid::sys::Runnable {
+        Journal& journal;
+    public:
+        Compactor(Journal& j) : journal(j) {}
+        void run() { journal.compactLoop(); }
+    };
+
+    struct Segment {
+        int fd;                 // For writing; -1 once recovered
+        int readFd;
+        uint64_t size;
+        uint32_t refs;
+        uint64_t lastBatch;     // Last batch holding records for this one
+        Segment() : fd(-1), readFd(-1), size(0), refs(0), lastBatch(0) {}
+    };
+    typedef std::map<uint64_t, Segment> Segments;
+
+    struct Chunk {
+        uint64_t segment;
+        uint64_t offset;
+        boost::shared_ptr<ChunkBuffer> buffer;
+    };
+
+    struct Batch {
+        uint64_t number;
+        std::vector<Chunk> chunks;
+        std::vector<boost::function<void()> > completions;
+        std::vector<uint64_t> releases;
+        bool newSegment;
+        Batch() : number(1), newSegment(false) {}
+        bool empty() const {
+            return chunks.empty() && completions.empty() && releases.empty();
+        }
+    };
+
+    struct MessageInfo {
+        uint64_t segment;
+        uint64_t offset;        // Of the encoded message in the segment
+        uint32_t size;
+        uint32_t headerSize;
+        uint64_t batch;         // Readable once this batch is durable
+        bool staged;
+        // Queue id and the segment its enqueue record is in
+        std::vector<std::pair<uint64_t, uint64_t> > enqueues;
+        MessageInfo() : segment(0), offset(0), size(0), headerSize(0),
+                        batch(0), staged(false) {}
+    };
+    typedef std::map<uint64_t, MessageInfo> Messages;
+
+    struct Location {
+        uint64_t segment;
+        uint64_t offset;
+    };
+
+    qpid::sys::Mutex lock;
+    qpid::sys::Condition writerWake;
+    qpid::sys::Condition durable;
+    qpid::sys::Condition compactWake;
+    std::string dir;
+    uint64_t segmentSize;
+    bool direct;
+    Segments segments;
+    uint64_t current;
+    Batch pending;
+    uint64_t durableBatch;
+    Messages messages;
+    std::set<std::string> preparedXids;
+    uint64_t nextId;
+    std::string failure;
+    bool writerIdle;
+    bool stopping;
+    bool started;
+    StorageProvider::Instrumentation* instrumentation;
+    qpid::sys::Thread writer;
+    uint64_t liveBytes;         // Encoded size of the messages kept
+    uint32_t compactRatio;
+    Compactor compactor;
+    qpid::sys::Thread compactorThread;
+
+    std::string segmentPath(uint64_t seq) const;
+    void check();
+    void wake();
+    void roll();
+    Location append(RecordType type, uint64_t id,
+                    const char* payload, uint32_t size);
+    Location appendOp(RecordType type, uint64_t msgId,
+                      uint64_t queueId, uint64_t txnId);
+    void appendEnqueue(Transaction* txn,
+                       const boost::intrusive_ptr<PersistableMessage>& msg,
+                       const std::string& encoded,
+                       const std::vector<uint64_t>& queueIds);
+    void appendDeferred(Transaction& txn);
+    void appendTransaction(Transaction& txn);
+    Messages::iterator storeMessage(const boost::intrusive_ptr<PersistableMessage>& msg,
+                                    const std::string& encoded);
+    void removeEnqueue(uint64_t msgId, uint64_t queueId, uint64_t segment);
+    void dropIfUnused(Messages::iterator i);
+    void release(uint64_t segment);
+    void waitFor(uint64_t batch);
+    void pad(Chunk& chunk);
+    void reclaim(std::vector<std::string>& paths, std::vector<int>& fds);
+    void startThreads();
+    bool needsCompaction() const;
+    void compactLoop();
+    bool compactOldest();
+};
+
+}}} // namespace qpid::store::journal
+
+#endif /* QPID_STORE_JOURNAL_JOURNAL_H */
@@ -0,0 +1,636 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <map>
+#include <set>
+#include <string>
+#include <errno.h>
+#include <sys/stat.h>
+#include <boost/bind.hpp>
+#include <qpid/DataDir.h>
+#include <qpid/broker/Broker.h>
+#include <qpid/broker/RecoverableConfig.h>
+#include <qpid/broker/RecoverableExchange.h>
+#include <qpid/broker/RecoverableQueue.h>
+#include <qpid/framing/Buffer.h>
+#include <qpid/framing/FieldTable.h>
+#include <qpid/log/Statement.h>
+#include <qpid/store/MessageStorePlugin.h>
+#include <qpid/store/StoreException.h>
+#include <qpid/store/StorageProvider.h>
+#include <qpid/sys/Mutex.h>
+#include <qpid/sys/StrError.h>
+
+#include "ConfigLog.h"
+#include "Journal.h"
+#include "Transaction.h"
+
+namespace qpid {
+namespace store {
+namespace journal {
+
+/**
+ * @class JournalProvider
+ *
+ * Implements a qpid::store::StorageProvider that keeps messages in a
+ * segmented, append-only journal on the local file system. Queues,
+ * exchanges, bindings and configuration are kept in a separate small
+ * file that is synced on every change.
+ */
+class JournalProvider : public qpid::store::StorageProvider
+{
+protected:
+    void finalizeMe();
+
+public:
+    JournalProvider();
+    ~JournalProvider();
+
+    virtual qpid::Options* getOptions() { return &options; }
+
+    virtual void earlyInitialize (Plugin::Target& target);
+    virtual void initialize(Plugin::Target& target);
+
+    /**
+     * Receive notification that this provider is the one that will actively
+     * handle provider storage for the target. If the provider is to be used,
+     * this method will be called after earlyInitialize() and before any
+     * recovery operations (recovery, in turn, precedes call to initialize()).
+     */
+    virtual void activate(MessageStorePlugin &store);
+
+    /**
+     * @name Methods inherited from qpid::broker::MessageStore
+     */
+    //@{
+    virtual void truncateInit(const bool pushDownStoreFiles = false);
+
+    virtual void create(PersistableQueue& queue,
+                        const qpid::framing::FieldTable& args);
+    virtual void destroy(PersistableQueue& queue);
+
+    virtual void create(const PersistableExchange& exchange,
+                        const qpid::framing::FieldTable& args);
+    virtual void destroy(const PersistableExchange& exchange);
+
+    virtual void bind(const PersistableExchange& exchange,
+                      const PersistableQueue& queue,
+                      const std::string& key,
+                      const qpid::framing::FieldTable& args);
+    virtual void unbind(const PersistableExchange& exchange,
+                        const PersistableQueue& queue,
+                        const std::string& key,
+                        const qpid::framing::FieldTable& args);
+
+    virtual void create(const PersistableConfig& config);
+    virtual void destroy(const PersistableConfig& config);
+
+    virtual void stage(const boost::intrusive_ptr<PersistableMessage>& msg);
+    virtual void destroy(PersistableMessage& msg);
+    virtual void appendContent(const boost::intrusive_ptr<const PersistableMessage>& msg,
+                               const std::string& data);
+    virtual void loadContent(const qpid::broker::PersistableQueue& queue,
+                             const boost::intrusive_ptr<const PersistableMessage>& msg,
+                             std::string& data,
+                             uint64_t offset,
+                             uint32_t length);
+
+    /**
+     * Enqueues and dequeues are journalled at once and completed when
+     * the batch they are written in has been synced.
+     */
+    virtual void enqueue(qpid::broker::TransactionContext* ctxt,
+                         const boost::intrusive_ptr<PersistableMessage>& msg,
+                         const PersistableQueue& queue);
+    virtual void dequeue(qpid::broker::TransactionContext* ctxt,
+                         const boost::intrusive_ptr<PersistableMessage>& msg,
+                         const PersistableQueue& queue);
+
+    /**
+     * Flushes all async messages to disk for the specified queue
+     *
+     * Note: this is a no-op for this provider; the journal writer syncs
+     * whatever is pending as soon as the previous sync is done.
+     */
+    virtual void flush(const PersistableQueue&) {}
+
+    /** The journal writer completes each operation once it is synced. */
+    virtual bool completesAsynchronously() const { return true; }
+
+    virtual uint32_t outstandingQueueAIO(const PersistableQueue&)
+        {return 0;}
+    //@}
+
+    /**
+     * @name Methods inherited from qpid::broker::TransactionalStore
+     */
+    //@{
+    virtual std::auto_ptr<qpid::broker::TransactionContext> begin();
+    virtual std::auto_ptr<qpid::broker::TPCTransactionContext> begin(const std::string& xid);
+    virtual void prepare(qpid::broker::TPCTransactionContext& txn);
+    virtual void commit(qpid::broker::TransactionContext& txn);
+    virtual void abort(qpid::broker::TransactionContext& txn);
+    virtual void collectPreparedXids(std::set<std::string>& xids);
+    //@}
+
+    virtual void recoverConfigs(qpid::broker::RecoveryManager& recoverer);
+    virtual void recoverExchanges(qpid::broker::RecoveryManager& recoverer,
+                                  ExchangeMap& exchangeMap);
+    virtual void recoverQueues(qpid::broker::RecoveryManager& recoverer,
+                               QueueMap& queueMap);
+    virtual void recoverBindings(qpid::broker::RecoveryManager& recoverer,
+                                 const ExchangeMap& exchangeMap,
+                                 const QueueMap& queueMap);
+    virtual void recoverMessages(qpid::broker::RecoveryManager& recoverer,
+                                 MessageMap& messageMap,
+                                 MessageQueueMap& messageQueueMap);
+    virtual void recoverTransactions(qpid::broker::RecoveryManager& recoverer,
+                                     PreparedTransactionMap& dtxMap);
+
+private:
+    struct ProviderOptions : public qpid::Options
+    {
+        std::string storeDir;
+        uint32_t segmentSize;
+        bool direct;
+        uint32_t recoveryThreads;
+        uint32_t compactRatio;
+
+        ProviderOptions(const std::string &name)
+            : qpid::Options(name),
+              segmentSize(16),
+              direct(false),
+              recoveryThreads(4),
+              compactRatio(4)
+        {
+            addOptions()
+                ("store-dir",
+                 qpid::optValue(storeDir, "DIR"),
+                 "Location to store message and configuration data "
+                 "(default uses data-dir if available)")
+                ("journal-segment-size",
+                 qpid::optValue(segmentSize, "MB"),
+                 "Size of each journal segment file; a segment is removed "
+                 "once nothing in it or any older segment is live")
+                ("journal-direct",
+                 qpid::optValue(direct),
+                 "Write journal segments with O_DIRECT, bypassing the page cache")
+                ("journal-recovery-threads",
+                 qpid::optValue(recoveryThreads, "N"),
+                 "Number of threads reading journal segments during recovery")
+                ("journal-compact-ratio",
+                 qpid::optValue(compactRatio, "N"),
+                 "Copy live messages out of the oldest segment once the "
+                 "segments hold more than N times the live message data, "
+                 "bounding the journal and its recovery time (0 disables)")
+                ;
+        }
+    };
+    ProviderOptions options;
+    ConfigLog config;
+    Journal journal;
+    Journal::PreparedMap recoveredTxns;
+
+    // Binding (exchange id, queue id, key) -> config entry id
+    typedef std::map<std::pair<std::pair<uint64_t, uint64_t>, std::string>, uint64_t>
+        Bindings;
+    Bindings bindings;
+    qpid::sys::Mutex bindingsLock;
+
+    static Bindings::key_type bindingKey(uint64_t exchangeId,
+                                         uint64_t queueId,
+                                         const std::string& key);
+    void add(ConfigLog::Kind kind, const qpid::broker::Persistable& p);
+    void removeBindings(bool forQueue, uint64_t id);
+    Transaction::shared_ptr getTransaction(qpid::broker::TransactionContext* ctxt);
+};
+
+static JournalProvider static_instance_registers_plugin;
+
+void
+JournalProvider::finalizeMe()
+{
+    journal.stop();
+    config.close();
+}
+
+JournalProvider::JournalProvider()
+    : options("Journal Store Provider options")
+{
+}
+
+JournalProvider::~JournalProvider()
+{
+}
+
+void
+JournalProvider::earlyInitialize(Plugin::Target &target)
+{
+    MessageStorePlugin *store = dynamic_cast<MessageStorePlugin *>(&target);
+    if (store) {
+        // Check the store dir option; if not specified, need to
+        // grab the broker's data dir.
+        if (options.storeDir.empty()) {
+            DataDir& dir = store->getBroker()->getDataDir();
+            if (dir.isEnabled()) {
+                options.storeDir = dir.getPath();
+            }
+            else {
+                QPID_LOG(error,
+                         "Journal store: --store-dir required if --no-data-dir specified");
+                return;
+            }
+        }
+        if (options.segmentSize == 0) {
+            QPID_LOG(error, "Journal store: --journal-segment-size must be at least 1");
+            return;
+        }
+        store->providerAvailable("JOURNAL", this);
+        store->addFinalizer(boost::bind(&JournalProvider::finalizeMe, this));
+    }
+}
+
+void
+JournalProvider::initialize(Plugin::Target& /*target*/)
+{
+    // Recovery normally starts the journal; this covers a broker that
+    // didn't recover.
+    journal.start();
+}
+
+void
+JournalProvider::activate(MessageStorePlugin& /*store*/)
+{
+    std::string dir = options.storeDir + "/journal";
+    if (::mkdir(options.storeDir.c_str(), 0755) < 0 && errno != EEXIST)
+        THROW_STORE_EXCEPTION("Can't create " + options.storeDir + ": " +
+                              qpid::sys::strError(errno));
+    config.instrument(getInstrumentation());
+    journal.instrument(getInstrumentation());
+    journal.compactAbove(options.compactRatio);
+    config.open(options.storeDir + "/config.jrnl");
+    journal.open(dir, uint64_t(options.segmentSize) * 1024 * 1024, options.direct);
+    journal.reserveIds(config.getNextId());
+    QPID_LOG(info, "Journal Provider is up; store in " << options.storeDir);
+}
+
+void
+JournalProvider::truncateInit(const bool /*pushDownStoreFiles*/)
+{
+}
+
+void
+JournalProvider::create(PersistableQueue& queue,
+                        const qpid::framing::FieldTable& /*args*/)
+{
+    add(ConfigLog::QUEUE, queue);
+}
+
+/**
+ * Destroy a durable queue, its bindings, and all record of the messages
+ * on it. Enqueues on it left in the journal are dropped on recovery
+ * since the queue id is gone and never reused.
+ */
+void
+JournalProvider::destroy(PersistableQueue& queue)
+{
+    removeBindings(true, queue.getPersistenceId());
+    config.remove(queue.getPersistenceId());
+    journal.expunge(queue.getPersistenceId());
+}
+
+void
+JournalProvider::create(const PersistableExchange& exchange,
+                        const qpid::framing::FieldTable& /*args*/)
+{
+    add(ConfigLog::EXCHANGE, exchange);
+}
+
+void
+JournalProvider::destroy(const PersistableExchange& exchange)
+{
+    removeBindings(false, exchange.getPersistenceId());
+    config.remove(exchange.getPersistenceId());
+}
+
+void
+JournalProvider::bind(const PersistableExchange& exchange,
+                      const PersistableQueue& queue,
+                      const std::string& key,
+                      const qpid::framing::FieldTable& args)
+{
+    std::string data(2 * sizeof(uint64_t) + 2 + key.size() + args.encodedSize(), '\0');
+    qpid::framing::Buffer buffer(&data[0], data.size());
+    buffer.putLongLong(exchange.getPersistenceId());
+    buffer.putLongLong(queue.getPersistenceId());
+    buffer.putMediumString(key);
+    args.encode(buffer);
+    uint64_t id = journal.newId();
+    config.add(id, ConfigLog::BINDING, data);
+    qpid::sys::Mutex::ScopedLock l(bindingsLock);
+    bindings[bindingKey(exchange.getPersistenceId(), queue.getPersistenceId(), key)] = id;
+}
+
+void
+JournalProvider::unbind(const PersistableExchange& exchange,
+                        const PersistableQueue& queue,
+                        const std::string& key,
+                        const qpid::framing::FieldTable& /*args*/)
+{
+    qpid::sys::Mutex::ScopedLock l(bindingsLock);
+    Bindings::iterator i =
+        bindings.find(bindingKey(exchange.getPersistenceId(), queue.getPersistenceId(), key));
+    if (i == bindings.end())
+        return;
+    config.remove(i->second);
+    bindings.erase(i);
+}
+
+void
+JournalProvider::create(const PersistableConfig& general)
+{
+    add(ConfigLog::CONFIG, general);
+}
+
+void
+JournalProvider::destroy(const PersistableConfig& general)
+{
+    config.remove(general.getPersistenceId());
+}
+
+void
+JournalProvider::stage(const boost::intrusive_ptr<PersistableMessage>& msg)
+{
+    journal.stage(msg);
+}
+
+void
+JournalProvider::destroy(PersistableMessage& msg)
+{
+    journal.destroy(msg.getPersistenceId());
+}
+
+/**
+ * The broker stages a whole message before releasing its content, so
+ * content is never appended.
+ */
+void
+JournalProvider::appendContent(const boost::intrusive_ptr<const PersistableMessage>& /*msg*/,
+                               const std::string& /*data*/)
+{
+    THROW_STORE_EXCEPTION("Journal store does not support appending content");
+}
+
+void
+JournalProvider::loadContent(const qpid::broker::PersistableQueue& /*queue*/,
+                             const boost::intrusive_ptr<const PersistableMessage>& msg,
+                             std::string& data,
+                             uint64_t offset,
+                             uint32_t length)
+{
+    // All messages are in one journal, so the queue isn't needed.
+    journal.loadContent(msg->getPersistenceId(), data, offset, length);
+}
+
+void
+JournalProvider::enqueue(qpid::broker::TransactionContext* ctxt,
+                         const boost::intrusive_ptr<PersistableMessage>& msg,
+                         const PersistableQueue& queue)
+{
+    Transaction::shared_ptr t = getTransaction(ctxt);
+    journal.enqueue(t.get(), msg, queue.getPersistenceId());
+}
+
+void
+JournalProvider::dequeue(qpid::broker::TransactionContext* ctxt,
+                         const boost::intrusive_ptr<PersistableMessage>& msg,
+                         const PersistableQueue& queue)
+{
+    Transaction::shared_ptr t = getTransaction(ctxt);
+    journal.dequeue(t.get(), msg, queue.getPersistenceId());
+}
+
+std::auto_ptr<qpid::broker::TransactionContext>
+JournalProvider::begin()
+{
+    std::auto_ptr<qpid::broker::TransactionContext> tc(new TransactionContext(journal.begin()));
+    return tc;
+}
+
+std::auto_ptr<qpid::broker::TPCTransactionContext>
+JournalProvider::begin(const std::string& xid)
+{
+    std::auto_ptr<qpid::broker::TPCTransactionContext> tc(new TPCTransactionContext(journal.begin(xid)));
+    return tc;
+}
+
+void
+JournalProvider::prepare(qpid::broker::TPCTransactionContext& txn)
+{
+    TPCTransactionContext *ctx = dynamic_cast<TPCTransactionContext*> (&txn);
+    if (ctx == 0)
+        throw qpid::broker::InvalidTransactionContextException();
+    journal.prepare(*ctx->getTransaction());
+}
+
+void
+JournalProvider::commit(qpid::broker::TransactionContext& txn)
+{
+    Transaction::shared_ptr t = getTransaction(&txn);
+    if (!t)
+        throw qpid::broker::InvalidTransactionContextException();
+    journal.commit(*t);
+}
+
+void
+JournalProvider::abort(qpid::broker::TransactionContext& txn)
+{
+    Transaction::shared_ptr t = getTransaction(&txn);
+    if (!t)
+        throw qpid::broker::InvalidTransactionContextException();
+    journal.abort(*t);
+}
+
+void
+JournalProvider::collectPreparedXids(std::set<std::string>& xids)
+{
+    journal.collectPreparedXids(xids);
+}
+
+void
+JournalProvider::recoverConfigs(qpid::broker::RecoveryManager& recoverer)
+{
+    const ConfigLog::Entries& entries = config.getEntries();
+    for (ConfigLog::Entries::const_iterator i = entries.begin(); i != entries.end(); ++i) {
+        if (i->second.kind != ConfigLog::CONFIG)
+            continue;
+        std::string data(i->second.data);
+        qpid::framing::Buffer buffer(&data[0], data.size());
+        broker::RecoverableConfig::shared_ptr c = recoverer.recoverConfig(buffer);
+        c->setPersistenceId(i->first);
+    }
+}
+
+void
+JournalProvider::recoverExchanges(qpid::broker::RecoveryManager& recoverer,
+                                  ExchangeMap& exchangeMap)
+{
+    const ConfigLog::Entries& entries = config.getEntries();
+    for (ConfigLog::Entries::const_iterator i = entries.begin(); i != entries.end(); ++i) {
+        if (i->second.kind != ConfigLog::EXCHANGE)
+            continue;
+        std::string data(i->second.data);
+        qpid::framing::Buffer buffer(&data[0], data.size());
+        broker::RecoverableExchange::shared_ptr exchange =
+            recoverer.recoverExchange(buffer);
+        exchange->setPersistenceId(i->first);
+        exchangeMap[i->first] = exchange;
+    }
+}
+
+void
+JournalProvider::recoverQueues(qpid::broker::RecoveryManager& recoverer,
+                               QueueMap& queueMap)
+{
+    const ConfigLog::Entries& entries = config.getEntries();
+    for (ConfigLog::Entries::const_iterator i = entries.begin(); i != entries.end(); ++i) {
+        if (i->second.kind != ConfigLog::QUEUE)
+            continue;
+        std::string data(i->second.data);
+        qpid::framing::Buffer buffer(&data[0], data.size());
+        broker::RecoverableQueue::shared_ptr queue = recoverer.recoverQueue(buffer);
+        queue->setPersistenceId(i->first);
+        queueMap[i->first] = queue;
+    }
+}
+
+void
+JournalProvider::recoverBindings(qpid::broker::RecoveryManager& /*recoverer*/,
+                                 const ExchangeMap& exchangeMap,
+                                 const QueueMap& queueMap)
+{
+    const ConfigLog::Entries& entries = config.getEntries();
+    std::vector<uint64_t> stale;
+    for (ConfigLog::Entries::const_iterator i = entries.begin(); i != entries.end(); ++i) {
+        if (i->second.kind != ConfigLog::BINDING)
+            continue;
+        std::string data(i->second.data);
+        qpid::framing::Buffer buffer(&data[0], data.size());
+        uint64_t exchangeId = buffer.getLongLong();
+        uint64_t queueId = buffer.getLongLong();
+        std::string key;
+        buffer.getMediumString(key);
+        qpid::framing::FieldTable args;
+        args.decode(buffer);
+        ExchangeMap::const_iterator exch = exchangeMap.find(exchangeId);
+        QueueMap::const_iterator queue = queueMap.find(queueId);
+        if (exch == exchangeMap.end() || queue == queueMap.end()) {
+            QPID_LOG(warning, "Journal store: dropping binding " << i->first
+                     << " to missing exchange or queue");
+            stale.push_back(i->first);
+            continue;
+        }
+        exch->second->bind(queue->second->getName(), key, args);
+        bindings[bindingKey(exchangeId, queueId, key)] = i->first;
+    }
+    for (size_t i = 0; i < stale.size(); ++i)
+        config.remove(stale[i]);
+}
+
+void
+JournalProvider::recoverMessages(qpid::broker::RecoveryManager& recoverer,
+                                 MessageMap& messageMap,
+                                 MessageQueueMap& messageQueueMap)
+{
+    // Only enqueues on queues that still exist are recovered.
+    std::set<uint64_t> validQueues;
+    const ConfigLog::Entries& entries = config.getEntries();
+    for (ConfigLog::Entries::const_iterator i = entries.begin(); i != entries.end(); ++i) {
+        if (i->second.kind == ConfigLog::QUEUE)
+            validQueues.insert(i->first);
+    }
+    journal.recover(recoverer,
+                    validQueues,
+                    options.recoveryThreads,
+                    messageMap,
+                    messageQueueMap,
+                    recoveredTxns);
+}
+
+void
+JournalProvider::recoverTransactions(qpid::broker::RecoveryManager& recoverer,
+                                     PreparedTransactionMap& dtxMap)
+{
+    for (Journal::PreparedMap::const_iterator i = recoveredTxns.begin();
+         i != recoveredTxns.end();
+         ++i) {
+        std::auto_ptr<qpid::broker::TPCTransactionContext> ctx(new TPCTransactionContext(i->second));
+        dtxMap[i->first] = recoverer.recoverTransaction(i->first, ctx);
+    }
+    recoveredTxns.clear();
+}
+
+////////////// Internal Methods
+
+JournalProvider::Bindings::key_type
+JournalProvider::bindingKey(uint64_t exchangeId,
+                            uint64_t queueId,
+                            const std::string& key)
+{
+    return Bindings::key_type(std::make_pair(exchangeId, queueId), key);
+}
+
+void
+JournalProvider::add(ConfigLog::Kind kind, const qpid::broker::Persistable& p)
+{
+    std::string data(p.encodedSize(), '\0');
+    qpid::framing::Buffer buffer(&data[0], data.size());
+    p.encode(buffer);
+    uint64_t id = journal.newId();
+    config.add(id, kind, data);
+    p.setPersistenceId(id);
+}
+
+void
+JournalProvider::removeBindings(bool forQueue, uint64_t id)
+{
+    qpid::sys::Mutex::ScopedLock l(bindingsLock);
+    for (Bindings::iterator i = bindings.begin(); i != bindings.end(); ) {
+        Bindings::iterator b = i++;
+        uint64_t owner = forQueue ? b->first.first.second : b->first.first.first;
+        if (owner == id) {
+            config.remove(b->second);
+            bindings.erase(b);
+        }
+    }
+}
+
+Transaction::shared_ptr
+JournalProvider::getTransaction(qpid::broker::TransactionContext* ctxt)
+{
+    if (TransactionContext* ctx = dynamic_cast<TransactionContext*>(ctxt))
+        return ctx->getTransaction();
+    if (TPCTransactionContext* tctx = dynamic_cast<TPCTransactionContext*>(ctxt))
+        return tctx->getTransaction();
+    return Transaction::shared_ptr();
+}
+
+}}} // namespace qpid::store::journal
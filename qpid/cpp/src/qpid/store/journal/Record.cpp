@@ -0,0 +1,159 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <qpid/store/StoreException.h>
+#include <qpid/sys/StrError.h>
+#include "Record.h"
+
+namespace qpid {
+namespace store {
+namespace journal {
+
+namespace {
+const uint32_t FnvBasis = 2166136261u;
+const uint32_t FnvPrime = 16777619u;
+
+inline uint32_t fnv(uint32_t hash, const char* data, size_t size)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ p[i]) * FnvPrime;
+    return hash;
+}
+}
+
+uint32_t
+checksum(const RecordHeader& header, const char* payload)
+{
+    RecordHeader h(header);
+    h.checksum = 0;
+    uint32_t hash = fnv(FnvBasis, reinterpret_cast<const char*>(&h), sizeof(h));
+    return fnv(hash, payload, header.size);
+}
+
+void
+writeRecord(char* out, RecordType type, uint64_t id,
+            const char* payload, uint32_t size)
+{
+    RecordHeader header(type, id, size);
+    if (size)
+        ::memcpy(out + sizeof(header), payload, size);
+    header.checksum = checksum(header, out + sizeof(header));
+    ::memcpy(out, &header, sizeof(header));
+}
+
+void
+appendRecord(std::string& out, RecordType type, uint64_t id,
+             const char* payload, uint32_t size)
+{
+    size_t at = out.size();
+    out.resize(at + sizeof(RecordHeader) + size);
+    writeRecord(&out[at], type, id, payload, size);
+}
+
+uint32_t
+checkRecord(const char* data, uint64_t available, RecordHeader& header)
+{
+    if (available < sizeof(header))
+        return 0;
+    ::memcpy(&header, data, sizeof(header));
+    if (header.magic != RecordHeader::MAGIC ||
+        header.size > available - sizeof(header))
+        return 0;
+    if (checksum(header, data + sizeof(header)) != header.checksum)
+        return 0;
+    return sizeof(header) + header.size;
+}
+
+void
+writeFully(int fd, const char* data, size_t size, int64_t offset)
+{
+    while (size > 0) {
+        ssize_t n = offset < 0 ? ::write(fd, data, size)
+                               : ::pwrite(fd, data, size, offset);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            THROW_STORE_EXCEPTION("Journal write failed: " +
+                                  qpid::sys::strError(errno));
+        }
+        data += n;
+        size -= n;
+        if (offset >= 0)
+            offset += n;
+    }
+}
+
+bool
+readFile(const std::string& path, std::string& out)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT)
+            return false;
+        THROW_STORE_EXCEPTION("Can't open " + path + ": " +
+                              qpid::sys::strError(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        int err = errno;
+        ::close(fd);
+        THROW_STORE_EXCEPTION("Can't stat " + path + ": " +
+                              qpid::sys::strError(err));
+    }
+    out.resize(st.st_size);
+    size_t got = 0;
+    while (got < out.size()) {
+        ssize_t n = ::pread(fd, &out[got], out.size() - got, got);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            int err = n < 0 ? errno : EIO;
+            ::close(fd);
+            THROW_STORE_EXCEPTION("Can't read " + path + ": " +
+                                  qpid::sys::strError(err));
+        }
+        got += n;
+    }
+    ::close(fd);
+    return true;
+}
+
+void
+syncDirectory(const std::string& dir)
+{
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd < 0 || ::fsync(fd) < 0) {
+        int err = errno;
+        if (fd >= 0)
+            ::close(fd);
+        THROW_STORE_EXCEPTION("Can't sync " + dir + ": " +
+                              qpid::sys::strError(err));
+    }
+    ::close(fd);
+}
+
+}}} // namespace qpid::store::journal
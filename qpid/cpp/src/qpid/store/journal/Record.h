@@ -0,0 +1,111 @@
+#ifndef QPID_STORE_JOURNAL_RECORD_H
+#define QPID_STORE_JOURNAL_RECORD_H
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <string>
+#include <qpid/sys/IntegerTypes.h>
+
+namespace qpid {
+namespace store {
+namespace journal {
+
+/**
+ * Types of record written to the journal files. Message records go in
+ * the segment files; configuration records go in the config file.
+ */
+enum RecordType {
+    REC_PAD = 1,        // Filler to the next block for direct writes
+    REC_MESSAGE,        // id = message; payload = header size + encoded
+    REC_ENQUEUE,        // id = message; payload = queue id + txn id
+                        //   [+ more queue ids, for one message routed
+                        //    to several queues]
+    REC_DEQUEUE,        // id = message; payload = queue id + txn id
+    REC_PREPARE,        // id = txn; payload = xid
+    REC_COMMIT,         // id = txn
+    REC_ABORT,          // id = txn
+    REC_CONFIG_ADD,     // id = object; payload = kind + encoded object
+    REC_CONFIG_REMOVE,  // id = object
+    REC_NEXT_ID,        // id = first persistence id not yet handed out
+    REC_TRANSACTION     // id = txn; payload = a committed one-phase
+                        //   transaction's operations, as groups of
+                        //   message id + type + count + queue ids
+};
+
+/**
+ * @struct RecordHeader
+ *
+ * Header at the start of every record. Records are written in host byte
+ * order; the files are local to the broker that wrote them. The checksum
+ * covers the header, with the checksum itself zero, and the payload, so
+ * a record torn by a crash is recognised and ends the scan of its file.
+ */
+struct RecordHeader {
+    static const uint32_t MAGIC = 0x4a444951;   // "QIDJ"
+
+    uint32_t magic;
+    uint16_t type;
+    uint16_t spare;
+    uint32_t size;          // Payload bytes following the header
+    uint32_t checksum;
+    uint64_t id;
+
+    RecordHeader(RecordType t = REC_PAD, uint64_t i = 0, uint32_t s = 0)
+        : magic(MAGIC), type(t), spare(0), size(s), checksum(0), id(i) {}
+};
+
+/** FNV-1a hash of a header and its payload. */
+uint32_t checksum(const RecordHeader& header, const char* payload);
+
+/**
+ * Write a complete record, computing its checksum, to @a out which must
+ * have room for sizeof(RecordHeader) + @a size bytes.
+ */
+void writeRecord(char* out, RecordType type, uint64_t id,
+                 const char* payload, uint32_t size);
+
+/** Append a complete record to @a out. */
+void appendRecord(std::string& out, RecordType type, uint64_t id,
+                  const char* payload, uint32_t size);
+
+/**
+ * Check the record at @a data, which has @a available bytes. Returns the
+ * total record length, or 0 if there is no complete, valid record there.
+ */
+uint32_t checkRecord(const char* data, uint64_t available, RecordHeader& header);
+
+/**
+ * @name File helpers shared by the journal and the config log. All throw
+ * qpid::store::StoreException on failure.
+ */
+//@{
+/** Write all of @a data at @a offset, or at the end if @a offset < 0. */
+void writeFully(int fd, const char* data, size_t size, int64_t offset);
+/** Read the whole of @a path into @a out. Returns false if it is missing. */
+bool readFile(const std::string& path, std::string& out);
+/** Sync the directory @a dir so entries created in it are durable. */
+void syncDirectory(const std::string& dir);
+//@}
+
+}}} // namespace qpid::store::journal
+
+#endif /* QPID_STORE_JOURNAL_RECORD_H */
@@ -0,0 +1,120 @@
+#ifndef QPID_STORE_JOURNAL_TRANSACTION_H
+#define QPID_STORE_JOURNAL_TRANSACTION_H
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <string>
+#include <vector>
+#include <boost/intrusive_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <qpid/broker/PersistableMessage.h>
+#include <qpid/broker/TransactionalStore.h>
+#include <qpid/sys/IntegerTypes.h>
+
+namespace qpid {
+namespace store {
+namespace journal {
+
+class Journal;
+
+/**
+ * @class Transaction
+ *
+ * The enqueues and dequeues done under one AMQP transaction. They are
+ * held here until the transaction ends: a one-phase commit journals them
+ * all as one record, which recovery applies whole or not at all. On a
+ * prepare each is journalled tagged with the transaction's id, and takes
+ * effect on recovery only if a commit record follows; the transaction is
+ * recovered as prepared if its prepare record made it to disk and no
+ * outcome did.
+ *
+ * The Journal's lock guards everything in here.
+ */
+class Transaction {
+public:
+    typedef boost::shared_ptr<Transaction> shared_ptr;
+
+    Transaction(uint64_t i, const std::string& x = std::string())
+        : id(i), xid(x), prepared(false), prepareSegment(0) {}
+
+    uint64_t getId() const { return id; }
+    const std::string& getXid() const { return xid; }
+
+private:
+    friend class Journal;
+
+    struct Op {
+        bool enqueue;
+        uint64_t msgId;
+        uint64_t queueId;
+        uint64_t segment;       // Where the enqueue/dequeue record is
+        Op(bool e, uint64_t m, uint64_t q, uint64_t s)
+            : enqueue(e), msgId(m), queueId(q), segment(s) {}
+    };
+
+    // An enqueue or dequeue not yet journalled
+    struct Deferred {
+        bool enqueue;
+        boost::intrusive_ptr<qpid::broker::PersistableMessage> msg;
+        std::string encoded;    // If the message is not yet stored
+        uint64_t queueId;
+        Deferred(bool e,
+                 const boost::intrusive_ptr<qpid::broker::PersistableMessage>& m,
+                 uint64_t q)
+            : enqueue(e), msg(m), queueId(q) {}
+    };
+
+    uint64_t id;
+    std::string xid;
+    std::vector<Op> ops;
+    std::vector<Deferred> deferred;
+    bool prepared;
+    uint64_t prepareSegment;
+};
+
+/**
+ * @class TransactionContext
+ *
+ * The broker's handle on a local transaction.
+ */
+class TransactionContext : public qpid::broker::TransactionContext {
+    Transaction::shared_ptr transaction;
+public:
+    TransactionContext(const Transaction::shared_ptr& t) : transaction(t) {}
+    const Transaction::shared_ptr& getTransaction() const { return transaction; }
+};
+
+/**
+ * @class TPCTransactionContext
+ *
+ * The broker's handle on a distributed transaction.
+ */
+class TPCTransactionContext : public qpid::broker::TPCTransactionContext {
+    Transaction::shared_ptr transaction;
+public:
+    TPCTransactionContext(const Transaction::shared_ptr& t) : transaction(t) {}
+    const Transaction::shared_ptr& getTransaction() const { return transaction; }
+};
+
+}}} // namespace qpid::store::journal
+
+#endif /* QPID_STORE_JOURNAL_TRANSACTION_H */
@@ -0,0 +1,135 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <qpid/log/Statement.h>
+
+#include "Flusher.h"
+#include "Messages.h"
+
+namespace qpid {
+namespace store {
+namespace ms_clfs {
+
+Flusher::Flusher(Messages& m) : messages(m), running(false), stopping(false)
+{
+}
+
+Flusher::~Flusher()
+{
+    stop();
+}
+
+void
+Flusher::start()
+{
+    qpid::sys::Monitor::ScopedLock l(lock);
+    if (running)
+        return;
+    running = true;
+    stopping = false;
+    thread = qpid::sys::Thread(*this);
+}
+
+void
+Flusher::stop()
+{
+    {
+        qpid::sys::Monitor::ScopedLock l(lock);
+        if (!running)
+            return;
+        stopping = true;
+        lock.notifyAll();
+    }
+    thread.join();
+    qpid::sys::Monitor::ScopedLock l(lock);
+    running = false;
+}
+
+void
+Flusher::add(const CLFS_LSN& lsn,
+             const boost::intrusive_ptr<qpid::broker::PersistableMessage>& msg,
+             uint64_t queueId,
+             bool enqueue)
+{
+    Op op;
+    op.lsn = lsn;
+    op.msg = msg;
+    op.queueId = queueId;
+    op.enqueue = enqueue;
+    qpid::sys::Monitor::ScopedLock l(lock);
+    ops.push_back(op);
+    ++perQueue[queueId];
+    if (ops.size() == 1)
+        lock.notifyAll();
+}
+
+uint32_t
+Flusher::outstanding(uint64_t queueId)
+{
+    qpid::sys::Monitor::ScopedLock l(lock);
+    std::map<uint64_t, uint32_t>::const_iterator i = perQueue.find(queueId);
+    return i == perQueue.end() ? 0 : i->second;
+}
+
+void
+Flusher::run()
+{
+    qpid::sys::Monitor::ScopedLock l(lock);
+    while (true) {
+        while (ops.empty() && !stopping)
+            lock.wait();
+        if (ops.empty())
+            return;     // Stopping, and everything is flushed.
+        std::vector<Op> batch;
+        batch.swap(ops);
+        {
+            qpid::sys::Monitor::ScopedUnlock u(lock);
+            // Records from different threads arrive out of order; flush
+            // through the latest one.
+            CLFS_LSN last = batch[0].lsn;
+            for (size_t i = 1; i < batch.size(); ++i)
+                if (::LsnLess(&last, &batch[i].lsn))
+                    last = batch[i].lsn;
+            try {
+                messages.flush(last);
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    if (batch[i].enqueue)
+                        batch[i].msg->enqueueComplete();
+                    else
+                        batch[i].msg->dequeueComplete();
+                }
+            }
+            catch (const std::exception& e) {
+                // The operations are left incomplete, as they're not stored.
+                QPID_LOG(error, "MSSQL-CLFS: message log flush failed: "
+                         << e.what());
+            }
+        }
+        for (size_t i = 0; i < batch.size(); ++i) {
+            std::map<uint64_t, uint32_t>::iterator q =
+                perQueue.find(batch[i].queueId);
+            if (q != perQueue.end() && --q->second == 0)
+                perQueue.erase(q);
+        }
+    }
+}
+
+}}}  // namespace qpid::store::ms_clfs
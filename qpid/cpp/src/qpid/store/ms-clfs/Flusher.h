@@ -0,0 +1,91 @@
+#ifndef QPID_STORE_MSCLFS_FLUSHER_H
+#define QPID_STORE_MSCLFS_FLUSHER_H
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <map>
+#include <vector>
+#include <windows.h>
+#include <clfsw32.h>
+#include <boost/intrusive_ptr.hpp>
+#include <qpid/broker/PersistableMessage.h>
+#include <qpid/sys/IntegerTypes.h>
+#include <qpid/sys/Monitor.h>
+#include <qpid/sys/Runnable.h>
+#include <qpid/sys/Thread.h>
+
+namespace qpid {
+namespace store {
+namespace ms_clfs {
+
+class Messages;
+
+/**
+ * @class Flusher
+ *
+ * Completes non-transactional enqueues and dequeues once their message log
+ * records are on disk. Those records are appended without forcing a flush;
+ * a thread of its own takes every operation waiting, flushes the log up to
+ * the latest of their records with one FlushToLsn() then completes them all.
+ * Operations recorded while a flush is in progress go in the next one.
+ */
+class Flusher : public qpid::sys::Runnable {
+public:
+    Flusher(Messages& m);
+    ~Flusher();
+
+    void start();
+    // Flush and complete any operations still waiting, then stop the thread.
+    void stop();
+
+    // Complete msg's enqueue onto (or dequeue from) a queue once the log
+    // is flushed through lsn.
+    void add(const CLFS_LSN& lsn,
+             const boost::intrusive_ptr<qpid::broker::PersistableMessage>& msg,
+             uint64_t queueId,
+             bool enqueue);
+
+    // How many operations on the specified queue are not yet on disk.
+    uint32_t outstanding(uint64_t queueId);
+
+    void run();
+
+private:
+    struct Op {
+        CLFS_LSN lsn;
+        boost::intrusive_ptr<qpid::broker::PersistableMessage> msg;
+        uint64_t queueId;
+        bool enqueue;
+    };
+
+    Messages& messages;
+    qpid::sys::Monitor lock;
+    std::vector<Op> ops;
+    std::map<uint64_t, uint32_t> perQueue;
+    bool running;
+    bool stopping;
+    qpid::sys::Thread thread;
+};
+
+}}}  // namespace qpid::store::ms_clfs
+
+#endif /* QPID_STORE_MSCLFS_FLUSHER_H */
@@ -137,7 +137,7 @@ Log::marshallingBufferSize()
 }
 
 CLFS_LSN
-Log::write(void* entry, uint32_t length, CLFS_LSN* prev)
+Log::write(void* entry, uint32_t length, CLFS_LSN* prev, bool force)
 {
     CLFS_WRITE_ENTRY desc;
     desc.Buffer = entry;
@@ -147,13 +147,25 @@ Log::write(void* entry, uint32_t length, CLFS_LSN* prev)
                                     &desc, 1,            // Buffer descriptor
                                     0, prev,             // Undo-Next, Prev
                                     0, 0,                // Reservation
-                                    CLFS_FLAG_FORCE_FLUSH,
+                                    force ? CLFS_FLAG_FORCE_FLUSH
+                                          : CLFS_FLAG_NO_FLAGS,
                                     &lsn,
                                     0);
     QPID_WINDOWS_CHECK_NOT(ok, 0);
     return lsn;
 }
 
+void
+Log::flush(const CLFS_LSN& upTo)
+{
+    CLFS_LSN flushed;
+    BOOL ok = ::FlushToLsn(marshal,
+                           const_cast<PCLFS_LSN>(&upTo),
+                           &flushed,
+                           0);
+    QPID_WINDOWS_CHECK_NOT(ok, 0);
+}
+
 // Get the current base LSN of the log.
 CLFS_LSN
 Log::getBase()
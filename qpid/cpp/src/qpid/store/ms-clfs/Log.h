@@ -64,7 +64,14 @@ public:
 
     virtual uint32_t marshallingBufferSize();
 
-    CLFS_LSN write(void* entry, uint32_t length, CLFS_LSN* prev = 0);
+    // Append a record. Unless force is set, the record is only in the
+    // marshalling area when this returns; it goes to disk when a buffer
+    // fills, a later forced write is made or flush() is called.
+    CLFS_LSN write(void* entry, uint32_t length, CLFS_LSN* prev = 0,
+                   bool force = true);
+
+    // Write out every record up to and including the indicated LSN.
+    void flush(const CLFS_LSN& upTo);
 
     // Get the current base LSN of the log.
     CLFS_LSN getBase();
@@ -51,6 +51,7 @@ using qpid::store::ms_sql::ADOException;
 using qpid::store::ms_sql::State;
 using qpid::store::ms_sql::VariantHelper;
 
+#include "Flusher.h"
 #include "Log.h"
 #include "Messages.h"
 #include "Transaction.h"
@@ -253,6 +254,9 @@ public:
      */
     virtual void flush(const PersistableQueue& queue) {};
 
+    /** The flusher completes each operation once its log record is flushed. */
+    virtual bool completesAsynchronously() const { return true; }
+
     /**
      * Returns the number of outstanding AIO's for a given queue
      *
@@ -262,7 +266,7 @@ public:
      * @param queue the name of the queue to check for outstanding AIO
      */
     virtual uint32_t outstandingQueueAIO(const PersistableQueue& queue)
-        {return 0;}
+        { return flusher.outstanding(queue.getPersistenceId()); }
     //@}
 
     /**
@@ -344,6 +348,8 @@ private:
     ProviderOptions options;
     std::string brokerDataDir;
     Messages messages;
+    // Completes non-transactional enqueues/dequeues once they're on disk.
+    Flusher flusher;
     // TransactionLog requires itself to have a shared_ptr reference to start.
     TransactionLog::shared_ptr transactions;
 
@@ -363,11 +369,12 @@ static MSSqlClfsProvider static_instance_registers_plugin;
 void
 MSSqlClfsProvider::finalizeMe()
 {
+    flusher.stop();
     dbState.reset();
 }
 
 MSSqlClfsProvider::MSSqlClfsProvider()
-    : options("MS SQL/CLFS Provider options")
+    : options("MS SQL/CLFS Provider options"), flusher(messages)
 {
     transactions = boost::make_shared<TransactionLog>();
 }
@@ -463,6 +470,7 @@ MSSqlClfsProvider::initialize(Plugin::Target& target)
 void
 MSSqlClfsProvider::activate(MessageStorePlugin &store)
 {
+    flusher.start();
     QPID_LOG(info, "MS SQL/CLFS Provider is up");
 }
 
@@ -780,6 +788,7 @@ MSSqlClfsProvider::loadContent(const qpid::broker::PersistableQueue& /*queue*/,
     // Message log keeps all messages in one log, so we don't need the
     // queue reference.
     messages.loadContent(msg->getPersistenceId(), data, offset, length);
+    reportRead(data.size());
 }
 
 /**
@@ -810,9 +819,15 @@ MSSqlClfsProvider::enqueue(qpid::broker::TransactionContext* ctxt,
     if (msgId == 0) {
         messages.add(msg);
         msgId = msg->getPersistenceId();
+        reportWritten(msg->encodedSize());
     }
-    messages.enqueue(msgId, queue.getPersistenceId(), t);
-    msg->enqueueComplete();
+    CLFS_LSN lsn = messages.enqueue(msgId, queue.getPersistenceId(), t);
+    // A transactional enqueue is on disk already; others complete when the
+    // flusher has written out the log up to them.
+    if (t.get() != 0)
+        msg->enqueueComplete();
+    else
+        flusher.add(lsn, msg, queue.getPersistenceId(), true);
 }
 
 /**
@@ -839,8 +854,12 @@ MSSqlClfsProvider::dequeue(qpid::broker::TransactionContext* ctxt,
         if (tctx)
             t = tctx->getTransaction();
     }
-    messages.dequeue(msg->getPersistenceId(), queue.getPersistenceId(), t);
-    msg->dequeueComplete();
+    CLFS_LSN lsn =
+        messages.dequeue(msg->getPersistenceId(), queue.getPersistenceId(), t);
+    if (t.get() != 0)
+        msg->dequeueComplete();
+    else
+        flusher.add(lsn, msg, queue.getPersistenceId(), false);
 }
 
 std::auto_ptr<qpid::broker::TransactionContext>
@@ -155,7 +155,7 @@ MessageLog::add(const boost::intrusive_ptr<qpid::broker::PersistableMessage>& ms
                  encodeBuff, entry.segmentLength);
     uint32_t entryLength = static_cast<uint32_t>(sizeof(entry));
     entryLength -= (MaxMessageContentLength - entry.segmentLength);
-    location = write(&entry, entryLength);
+    location = write(&entry, entryLength, 0, false);
     // Write any Message-Chunk records before setting the message's id.
     uint32_t sent = entry.segmentLength;
     uint32_t remaining = encodedMessageLength - entry.segmentLength;
@@ -166,7 +166,7 @@ MessageLog::add(const boost::intrusive_ptr<qpid::broker::PersistableMessage>& ms
                  encodeStage.get() + sent, chunk.segmentLength);
         entryLength = static_cast<uint32_t>(sizeof(chunk));
         entryLength -= (MaxMessageContentLength - chunk.segmentLength);
-        lastChunkLsn = write(&chunk, entryLength, &location);
+        lastChunkLsn = write(&chunk, entryLength, &location, false);
         sent += chunk.segmentLength;
         remaining -= chunk.segmentLength;
     }
@@ -178,7 +178,7 @@ MessageLog::deleteMessage(uint64_t messageId, uint64_t newFirstId)
 {
     MessageDelete deleteEntry;
     CLFS_LSN msgLsn = idToLsn(messageId);
-    write(&deleteEntry, sizeof(deleteEntry), &msgLsn);
+    write(&deleteEntry, sizeof(deleteEntry), &msgLsn, false);
     if (newFirstId != 0)
         moveTail(idToLsn(newFirstId));
 }
@@ -193,24 +193,24 @@ MessageLog::loadContent(uint64_t messageId,
 {
 }
 
-void
+CLFS_LSN
 MessageLog::recordEnqueue (uint64_t messageId,
                            uint64_t queueId,
                            uint64_t transactionId)
 {
     MessageEnqueue entry(queueId, transactionId);
     CLFS_LSN msgLsn = idToLsn(messageId);
-    write(&entry, sizeof(entry), &msgLsn);
+    return write(&entry, sizeof(entry), &msgLsn, transactionId != 0);
 }
 
-void
+CLFS_LSN
 MessageLog::recordDequeue (uint64_t messageId,
                            uint64_t queueId,
                            uint64_t transactionId)
 {
     MessageDequeue entry(queueId, transactionId);
     CLFS_LSN msgLsn = idToLsn(messageId);
-    write(&entry, sizeof(entry), &msgLsn);
+    return write(&entry, sizeof(entry), &msgLsn, transactionId != 0);
 }
 
 void
@@ -52,6 +52,8 @@ public:
     virtual uint32_t marshallingBufferSize();
 
     // Add the specified message to the log; Return the persistence Id.
+    // The message records are not flushed; a flush, or a forced write such
+    // as a transactional enqueue, after them does that.
     uint64_t add(const boost::intrusive_ptr<qpid::broker::PersistableMessage>& msg);
 
     // Write a Delete entry for messageId. If newFirstId is not 0, it is now
@@ -68,13 +70,16 @@ public:
     // Enqueue and dequeue operations track messages' transit across
     // queues; each operation may be associated with a transaction. If
     // the transactionId is 0 the operation is not associated with a
-    // transaction.
-    void recordEnqueue (uint64_t messageId,
-                        uint64_t queueId,
-                        uint64_t transactionId);
-    void recordDequeue (uint64_t messageId,
-                        uint64_t queueId,
-                        uint64_t transactionId);
+    // transaction, and its record is not flushed before returning; the
+    // caller must flush() up to the returned LSN before completing it.
+    // Transactional records are flushed before returning so they are
+    // safely ahead of the transaction's outcome in the transaction log.
+    CLFS_LSN recordEnqueue (uint64_t messageId,
+                            uint64_t queueId,
+                            uint64_t transactionId);
+    CLFS_LSN recordDequeue (uint64_t messageId,
+                            uint64_t queueId,
+                            uint64_t transactionId);
 
     // Recover the messages and their queueing records from the log.
     // @param recoverer  Recovery manager used to recreate broker objects from
@@ -57,7 +57,7 @@ Messages::add(const boost::intrusive_ptr<qpid::broker::PersistableMessage>& msg)
     }
 }
 
-void
+CLFS_LSN
 Messages::enqueue(uint64_t msgId, uint64_t queueId, Transaction::shared_ptr& t)
 {
     MessageInfo::shared_ptr p;
@@ -78,7 +78,7 @@ Messages::enqueue(uint64_t msgId, uint64_t queueId, Transaction::shared_ptr& t)
             t->enroll(msgId);
         }
         try {
-            log.recordEnqueue(msgId, queueId, transactionId);
+            return log.recordEnqueue(msgId, queueId, transactionId);
         }
         catch (...) {
             // Undo the record-keeping if the log wasn't written correctly.
@@ -90,7 +90,7 @@ Messages::enqueue(uint64_t msgId, uint64_t queueId, Transaction::shared_ptr& t)
     }
 }
 
-void
+CLFS_LSN
 Messages::dequeue(uint64_t msgId, uint64_t queueId, Transaction::shared_ptr& t)
 {
     MessageInfo::shared_ptr p;
@@ -119,8 +119,9 @@ Messages::dequeue(uint64_t msgId, uint64_t queueId, Transaction::shared_ptr& t)
             transactionId = t->getId();
             t->enroll(msgId);
         }
+        CLFS_LSN lsn;
         try {
-            log.recordDequeue(msgId, queueId, transactionId);
+            lsn = log.recordDequeue(msgId, queueId, transactionId);
         }
         catch (...) {
             // Undo the record-keeping if the log wasn't written correctly.
@@ -140,6 +141,7 @@ Messages::dequeue(uint64_t msgId, uint64_t queueId, Transaction::shared_ptr& t)
             if (p->where.empty())
                 remove(msgId);
         }
+        return lsn;
     }
 }
 
@@ -101,13 +101,18 @@ public:
     void add(const boost::intrusive_ptr<qpid::broker::PersistableMessage>& msg);
 
     // Add the specified queue to the message's list of places it is
-    // enqueued.
-    void enqueue(uint64_t msgId, uint64_t queueId, Transaction::shared_ptr& t);
+    // enqueued. Returns the LSN of the enqueue record, which is not yet
+    // flushed if there is no transaction.
+    CLFS_LSN enqueue(uint64_t msgId, uint64_t queueId, Transaction::shared_ptr& t);
 
     // Remove the specified queue from the message's list of places it is
     // enqueued. If there are no other queues holding the message, it is
-    // deleted.
-    void dequeue(uint64_t msgId, uint64_t queueId, Transaction::shared_ptr& t);
+    // deleted. Returns the LSN of the dequeue record, which is not yet
+    // flushed if there is no transaction.
+    CLFS_LSN dequeue(uint64_t msgId, uint64_t queueId, Transaction::shared_ptr& t);
+
+    // Write out the message log up to and including the indicated LSN.
+    void flush(const CLFS_LSN& upTo) { log.flush(upTo); }
 
     // Commit a previous provisional enqueue or dequeue of a particular message
     // actions under a specified transaction. If this results in the message's
@@ -23,6 +23,7 @@
  */
 
 #include <qpid/broker/TransactionalStore.h>
+#include <qpid/store/StorageProvider.h>
 #include <boost/shared_ptr.hpp>
 #include <string>
 
@@ -45,6 +46,7 @@ class AmqpTransaction : public qpid::broker::TransactionContext {
 
     boost::shared_ptr<DatabaseConnection> db;
     SqlTransaction sqlTrans;
+    qpid::store::StorageProvider::Operations deferred;
 
 public:
     AmqpTransaction(const boost::shared_ptr<DatabaseConnection>& _db);
@@ -55,6 +57,11 @@ public:
     void sqlBegin();
     void sqlCommit();
     void sqlAbort();
+
+    // One-phase enqueues and dequeues are held here until commit.
+    void defer(const qpid::store::StorageProvider::Operation& op)
+      { deferred.push_back(op); }
+    qpid::store::StorageProvider::Operations& deferredOps() { return deferred; }
 };
 
 /**
@@ -20,7 +20,10 @@
  */
 
 #include <stdlib.h>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 #include <windows.h>
 #include <qpid/broker/RecoverableQueue.h>
 #include <qpid/log/Statement.h>
@@ -53,6 +56,79 @@ const std::string TblMessage("tblMessage");
 const std::string TblMessageMap("tblMessageMap");
 const std::string TblQueue("tblQueue");
 const std::string TblTpl("tblTPL");
+
+// Write, then forget, a run of message map additions or removals.
+void writeMappings(qpid::store::ms_sql::MessageMapRecordset& rs,
+                   bool adding,
+                   qpid::store::ms_sql::MessageMapRecordset::Mappings& run)
+{
+    if (run.empty())
+        return;
+    if (adding)
+        rs.add(run);
+    else
+        rs.remove(run);
+    run.clear();
+}
+
+// Store a group of enqueues and dequeues, in order, on @a db. The caller
+// holds a transaction open on it around this and commits it. Returns the
+// size of the messages saved.
+uint64_t storeOperations(qpid::store::ms_sql::DatabaseConnection* db,
+                     const qpid::store::StorageProvider::Operations& ops)
+{
+    using namespace qpid::store::ms_sql;
+    typedef qpid::store::StorageProvider::Operations Operations;
+
+    // Save all the new messages together first, so that each mapping
+    // below has a persistence id to refer to. A message going to more
+    // than one queue is only saved once.
+    std::vector<boost::intrusive_ptr<qpid::broker::PersistableMessage> > newMsgs;
+    std::set<const qpid::broker::PersistableMessage*> seen;
+    uint64_t bytes = 0;
+    Operations::const_iterator i;
+    for (i = ops.begin(); i != ops.end(); ++i) {
+        if (i->enqueue && i->msg->getPersistenceId() == 0 &&
+            seen.insert(i->msg.get()).second) {
+            newMsgs.push_back(i->msg);
+            bytes += i->msg->encodedSize();
+        }
+    }
+    if (!newMsgs.empty()) {
+        MessageRecordset rsMessages;
+        rsMessages.openBatch(db, TblMessage);
+        rsMessages.add(newMsgs);
+    }
+
+    // Write the mappings a run of enqueues or of dequeues at a time, so
+    // that a dequeue and re-enqueue of a message on the same queue are
+    // still done in order.
+    MessageMapRecordset rsMap;
+    rsMap.open(db, TblMessageMap);
+    MessageMapRecordset::Mappings run;
+    bool adding = true;
+    for (i = ops.begin(); i != ops.end(); ++i) {
+        if (i->enqueue != adding) {
+            writeMappings(rsMap, adding, run);
+            adding = i->enqueue;
+        }
+        run.push_back(std::make_pair(i->msg->getPersistenceId(),
+                                     i->queue->getPersistenceId()));
+    }
+    writeMappings(rsMap, adding, run);
+    return bytes;
+}
+
+void completeOperations(const qpid::store::StorageProvider::Operations& ops)
+{
+    qpid::store::StorageProvider::Operations::const_iterator i;
+    for (i = ops.begin(); i != ops.end(); ++i) {
+        if (i->enqueue)
+            i->msg->enqueueComplete();
+        else
+            i->msg->dequeueComplete();
+    }
+}
 }
 
 namespace qpid {
@@ -228,6 +304,12 @@ public:
                          const boost::intrusive_ptr<PersistableMessage>& msg,
                          const PersistableQueue& queue);
 
+    /**
+     * Stores a group of non-transactional enqueues and dequeues in a
+     * single database transaction.
+     */
+    virtual void enqueueDequeue(const Operations& ops);
+
     /**
      * Flushes all async messages to disk for the specified queue
      *
@@ -630,6 +712,7 @@ MSSqlProvider::stage(const boost::intrusive_ptr<PersistableMessage>& msg)
         db->rollbackTransaction();
         throw ADOException("Error staging message", e, errs);
     }  
+    reportWritten(msg->encodedSize());
 }
 
 /**
@@ -667,7 +750,7 @@ MSSqlProvider::appendContent(const boost::intrusive_ptr<const PersistableMessage
     MessageRecordset rsMessages;
     try {
         db->beginTransaction();
-        rsMessages.open(db, TblMessage);
+        rsMessages.openCommands(db, TblMessage);
         rsMessages.append(msg, data);
         db->commitTransaction();
     }
@@ -676,6 +759,7 @@ MSSqlProvider::appendContent(const boost::intrusive_ptr<const PersistableMessage
         db->rollbackTransaction();
         throw ADOException("Error appending to message", e, errs);
     }  
+    reportWritten(data.size());
 }
 
 /**
@@ -698,13 +782,14 @@ MSSqlProvider::loadContent(const qpid::broker::PersistableQueue& /*queue*/,
     DatabaseConnection *db = initConnection();
     MessageRecordset rsMessages;
     try {
-        rsMessages.open(db, TblMessage);
-        rsMessages.loadContent(msg, data, offset, length);
+        rsMessages.openContent(db, TblMessage, msg, offset, length);
+        rsMessages.loadContent(data);
     }
     catch(_com_error &e) {
         std::string errs = db->getErrors();
         throw ADOException("Error loading message content", e, errs);
     }  
+    reportRead(data.size());
 }
 
 /**
@@ -734,10 +819,14 @@ MSSqlProvider::enqueue(qpid::broker::TransactionContext* ctxt,
     }
     else {
         (void)initState();     // Ensure this thread is initialized
-        // It's a transactional enqueue; if it's TPC, grab the xid.
+        // It's a transactional enqueue; if it's TPC, grab the xid. A
+        // one-phase transaction's enqueues are all stored on commit.
         AmqpTPCTransaction *tpcTxn = dynamic_cast<AmqpTPCTransaction*> (ctxt);
-        if (tpcTxn)
-            xid = tpcTxn->getXid();
+        if (tpcTxn == 0) {
+            atxn->defer(Operation(true, msg, queue));
+            return;
+        }
+        xid = tpcTxn->getXid();
         db = atxn->dbConn();
         try {
             atxn->sqlBegin();
@@ -749,10 +838,12 @@ MSSqlProvider::enqueue(qpid::broker::TransactionContext* ctxt,
 
     MessageRecordset rsMessages;
     MessageMapRecordset rsMap;
+    uint64_t bytes = 0;
     try {
         if (msg->getPersistenceId() == 0) {    // Message itself not yet saved
             rsMessages.open(db, TblMessage);
             rsMessages.add(msg);
+            bytes = msg->encodedSize();
         }
         rsMap.open(db, TblMessageMap);
         rsMap.add(msg->getPersistenceId(), queue.getPersistenceId(), xid);
@@ -769,6 +860,7 @@ MSSqlProvider::enqueue(qpid::broker::TransactionContext* ctxt,
             db->rollbackTransaction();
         throw ADOException("Error queuing message", e, errs);
     }
+    reportWritten(bytes);
     msg->enqueueComplete();
 }
 
@@ -799,10 +891,14 @@ MSSqlProvider::dequeue(qpid::broker::TransactionContext* ctxt,
     }
     else {
         (void)initState();     // Ensure this thread is initialized
-        // It's a transactional dequeue; if it's TPC, grab the xid.
+        // It's a transactional dequeue; if it's TPC, grab the xid. A
+        // one-phase transaction's dequeues are all stored on commit.
         AmqpTPCTransaction *tpcTxn = dynamic_cast<AmqpTPCTransaction*> (ctxt);
-        if (tpcTxn)
-            xid = tpcTxn->getXid();
+        if (tpcTxn == 0) {
+            atxn->defer(Operation(false, msg, queue));
+            return;
+        }
+        xid = tpcTxn->getXid();
         db = atxn->dbConn();
         try {
             atxn->sqlBegin();
@@ -851,6 +947,36 @@ MSSqlProvider::dequeue(qpid::broker::TransactionContext* ctxt,
     msg->dequeueComplete();
 }
 
+/**
+ * Stores a group of non-transactional enqueues and dequeues. They share
+ * one database transaction, so the cost of committing it is spread over
+ * every message in the group; none completes until it is committed.
+ *
+ * @param ops The enqueues and dequeues, oldest first.
+ */
+void
+MSSqlProvider::enqueueDequeue(const Operations& ops)
+{
+    DatabaseConnection *db = initConnection();
+    db->beginTransaction();
+    uint64_t bytes = 0;
+    try {
+        bytes = storeOperations(db, ops);
+        db->commitTransaction();
+    }
+    catch(ms_sql::Exception&) {
+        db->rollbackTransaction();
+        throw;
+    }
+    catch(_com_error &e) {
+        std::string errs = db->getErrors();
+        db->rollbackTransaction();
+        throw ADOException("Error storing messages", e, errs);
+    }
+    reportWritten(bytes);
+    completeOperations(ops);
+}
+
 std::auto_ptr<qpid::broker::TransactionContext>
 MSSqlProvider::begin()
 {
@@ -935,7 +1061,25 @@ MSSqlProvider::commit(qpid::broker::TransactionContext& txn)
         AmqpTransaction *p1txn = dynamic_cast<AmqpTransaction*> (&txn);
         if (p1txn == 0)
             throw qpid::broker::InvalidTransactionContextException();
-        p1txn->sqlCommit();
+        // Everything the transaction did goes to the database in one go.
+        Operations ops;
+        ops.swap(p1txn->deferredOps());
+        uint64_t bytes = 0;
+        try {
+            bytes = storeOperations(p1txn->dbConn(), ops);
+            p1txn->sqlCommit();
+        }
+        catch(ms_sql::Exception&) {
+            p1txn->sqlAbort();
+            throw;
+        }
+        catch(_com_error &e) {
+            std::string errs = p1txn->dbConn()->getErrors();
+            p1txn->sqlAbort();
+            throw ADOException("Error committing transaction", e, errs);
+        }
+        reportWritten(bytes);
+        completeOperations(ops);
         return;
     }
 
@@ -976,7 +1120,12 @@ MSSqlProvider::abort(qpid::broker::TransactionContext& txn)
         AmqpTransaction *p1txn = dynamic_cast<AmqpTransaction*> (&txn);
         if (p1txn == 0)
             throw qpid::broker::InvalidTransactionContextException();
+        // Nothing deferred was written; the broker still expects each
+        // operation to complete.
+        Operations ops;
+        ops.swap(p1txn->deferredOps());
         p1txn->sqlAbort();
+        completeOperations(ops);
         return;
     }
 
@@ -1148,8 +1297,10 @@ MSSqlProvider::recoverMessages(qpid::broker::RecoveryManager& recoverer,
     try {
         db = initConnection();
         MessageRecordset rsMessages;
-        rsMessages.open(db, TblMessage);
+        rsMessages.openPaged(db, TblMessage);
         rsMessages.recover(recoverer, messageMap);
+        // A server-side cursor keeps the connection busy until it's closed.
+        rsMessages.close();
 
         MessageMapRecordset rsMessageMaps;
         rsMessageMaps.open(db, TblMessageMap);
@@ -22,6 +22,7 @@
 #include <qpid/Exception.h>
 #include <qpid/log/Statement.h>
 #include <qpid/store/StorageProvider.h>
+#include <algorithm>
 
 #include "MessageMapRecordset.h"
 #include "BlobEncoder.h"
@@ -31,6 +32,10 @@
 
 namespace {
 inline void TESTHR(HRESULT x) {if FAILED(x) _com_issue_error(x);};
+
+// SQL Server allows at most 1000 rows in one VALUES list; deletes are
+// split up the same way to keep each statement a reasonable size.
+const size_t MaxRowsPerStatement = 1000;
 }
 
 namespace qpid {
@@ -77,6 +82,32 @@ MessageMapRecordset::add(uint64_t messageId,
     cmd->Execute(NULL, NULL, adCmdText | adExecuteNoRecords);
 }
 
+void
+MessageMapRecordset::add(const Mappings& mappings)
+{
+    _ConnectionPtr p = *dbConn;
+    for (size_t first = 0; first < mappings.size(); first += MaxRowsPerStatement) {
+        size_t last = std::min(mappings.size(), first + MaxRowsPerStatement);
+        std::ostringstream command;
+        command << "INSERT INTO " << tableName
+                << " (messageId, queueId) VALUES ";
+        for (size_t i = first; i < last; ++i) {
+            if (i != first)
+                command << ",";
+            command << "(" << mappings[i].first << ","
+                    << mappings[i].second << ")";
+        }
+        command << std::ends;
+
+        _CommandPtr cmd = NULL;
+        TESTHR(cmd.CreateInstance(__uuidof(Command)));
+        cmd->ActiveConnection = p;
+        cmd->CommandText = command.str().c_str();
+        cmd->CommandType = adCmdText;
+        cmd->Execute(NULL, NULL, adCmdText | adExecuteNoRecords);
+    }
+}
+
 void
 MessageMapRecordset::remove(uint64_t messageId, uint64_t queueId)
 {
@@ -98,6 +129,36 @@ MessageMapRecordset::remove(uint64_t messageId, uint64_t queueId)
     // message record from tblMessage.
 }
 
+void
+MessageMapRecordset::remove(const Mappings& mappings)
+{
+    _ConnectionPtr p = *dbConn;
+    for (size_t first = 0; first < mappings.size(); first += MaxRowsPerStatement) {
+        size_t last = std::min(mappings.size(), first + MaxRowsPerStatement);
+        std::ostringstream command;
+        command << "DELETE FROM " << tableName << " WHERE ";
+        for (size_t i = first; i < last; ++i) {
+            if (i != first)
+                command << " OR ";
+            command << "(queueId = " << mappings[i].second
+                    << " AND messageId = " << mappings[i].first << ")";
+        }
+        command << std::ends;
+
+        _CommandPtr cmd = NULL;
+        TESTHR(cmd.CreateInstance(__uuidof(Command)));
+        cmd->ActiveConnection = p;
+        cmd->CommandText = command.str().c_str();
+        cmd->CommandType = adCmdText;
+        _variant_t deletedRecords;
+        cmd->Execute(&deletedRecords, NULL, adCmdText | adExecuteNoRecords);
+        if ((long)deletedRecords != (long)(last - first))
+            throw ms_sql::Exception("Message does not exist in queue mapping");
+    }
+    // Trigger on deleting the mapping takes care of deleting orphaned
+    // message record from tblMessage.
+}
+
 void
 MessageMapRecordset::pendingRemove(uint64_t messageId,
                                    uint64_t queueId,
@@ -214,10 +275,9 @@ MessageMapRecordset::abortPrepared(const std::string& xid)
 void
 MessageMapRecordset::recover(MessageQueueMap& msgMap)
 {
-    openRs();
+    openPagedRs();
     if (rs->BOF && rs->EndOfFile)
         return;   // Nothing to do
-    rs->MoveFirst();
     MessageMap b;
     IADORecordBinding *piAdoRecordBinding;
     rs->QueryInterface(__uuidof(IADORecordBinding), 
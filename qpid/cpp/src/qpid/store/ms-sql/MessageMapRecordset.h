@@ -25,6 +25,8 @@
 #include <icrsint.h>
 #include "Recordset.h"
 #include <qpid/broker/RecoveryManager.h>
+#include <utility>
+#include <vector>
 
 namespace qpid {
 namespace store {
@@ -62,6 +64,9 @@ class MessageMapRecordset : public Recordset {
     void selectOnXid(const std::string& xid);
 
 public:
+    // Message id, queue id pairs for the batch operations.
+    typedef std::vector<std::pair<uint64_t, uint64_t> > Mappings;
+
     virtual void open(DatabaseConnection* conn, const std::string& table);
 
     // Add a new mapping
@@ -69,9 +74,15 @@ public:
              uint64_t queueId,
              const std::string& xid = "");
 
+    // Add a group of new mappings, with as few statements as possible.
+    void add(const Mappings& mappings);
+
     // Remove a specific mapping.
     void remove(uint64_t messageId, uint64_t queueId);
 
+    // Remove a group of mappings, with as few statements as possible.
+    void remove(const Mappings& mappings);
+
     // Mark the indicated message->queue entry pending removal. The entry
     // for the mapping is updated to indicate pending removal with the
     // specified xid.
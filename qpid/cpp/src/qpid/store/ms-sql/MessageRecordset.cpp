@@ -25,12 +25,21 @@
 #include "MessageRecordset.h"
 #include "BlobAdapter.h"
 #include "BlobEncoder.h"
+#include "DatabaseConnection.h"
 #include "VariantHelper.h"
 
 #include <boost/intrusive_ptr.hpp>
+#include <algorithm>
 
 class qpid::broker::PersistableMessage;
 
+namespace {
+inline void TESTHR(HRESULT x) {if FAILED(x) _com_issue_error(x);};
+
+// Bytes of a content blob copied out of ADO at a time.
+const long ContentChunkSize = 64 * 1024;
+}
+
 namespace qpid {
 namespace store {
 namespace ms_sql {
@@ -46,20 +55,56 @@ MessageRecordset::add(const boost::intrusive_ptr<qpid::broker::PersistableMessag
     msg->setPersistenceId(id);
 }
 
+void
+MessageRecordset::add(const std::vector<boost::intrusive_ptr<qpid::broker::PersistableMessage> >& msgs)
+{
+    if (msgs.empty())
+        return;
+    std::vector<boost::intrusive_ptr<qpid::broker::PersistableMessage> >::const_iterator i;
+    for (i = msgs.begin(); i != msgs.end(); ++i) {
+        BlobEncoder blob (*i);   // Marshall headers and content to a blob
+        rs->AddNew();
+        rs->Fields->GetItem("fieldTableBlob")->AppendChunk(blob);
+    }
+    rs->UpdateBatch(adAffectAll);
+    // The client cursor fetches each new identity value as part of the
+    // batch update; the records are still in the order they were added.
+    rs->MoveFirst();
+    for (i = msgs.begin(); i != msgs.end(); ++i) {
+        uint64_t id = rs->Fields->Item["persistenceId"]->Value;
+        (*i)->setPersistenceId(id);
+        rs->MoveNext();
+    }
+}
+
 void
 MessageRecordset::append(const boost::intrusive_ptr<const qpid::broker::PersistableMessage>& msg,
                          const std::string& data)
 {
-    // Look up the message by its Id
-    std::ostringstream filter;
-    filter << "persistenceId = " << msg->getPersistenceId() << std::ends;
-    rs->PutFilter (VariantHelper<std::string>(filter.str()));
-    if (rs->RecordCount == 0) {
+    // .WRITE with a null offset appends on the server, so the rest of the
+    // message is neither fetched nor rewritten.
+    std::ostringstream command;
+    command << "UPDATE " << tableName
+            << " SET fieldTableBlob.WRITE(?, NULL, NULL)"
+            << " WHERE persistenceId = " << msg->getPersistenceId() << std::ends;
+    _CommandPtr cmd = NULL;
+    _ParameterPtr content = NULL;
+    TESTHR(cmd.CreateInstance(__uuidof(Command)));
+    _ConnectionPtr p = *dbConn;
+    cmd->ActiveConnection = p;
+    cmd->CommandText = command.str().c_str();
+    cmd->CommandType = adCmdText;
+    TESTHR(content.CreateInstance(__uuidof(Parameter)));
+    content->Name = "@content";
+    content->Type = adLongVarBinary;
+    content->Size = data.size();
+    content->Direction = adParamInput;
+    content->Value = BlobEncoder(data);
+    cmd->Parameters->Append(content);
+    _variant_t updatedRecords;
+    cmd->Execute(&updatedRecords, NULL, adCmdText | adExecuteNoRecords);
+    if ((long)updatedRecords == 0)
         throw Exception("Can't append to message not stored in database");
-    }
-    BlobEncoder blob (data);   // Marshall string data to a blob
-    rs->Fields->GetItem("fieldTableBlob")->AppendChunk(blob);
-    rs->Update();
 }
 
 void
@@ -69,55 +114,60 @@ MessageRecordset::remove(const boost::intrusive_ptr<const qpid::broker::Persista
 }
 
 void
-MessageRecordset::loadContent(const boost::intrusive_ptr<const qpid::broker::PersistableMessage>& msg,
-                              std::string& data,
+MessageRecordset::openContent(DatabaseConnection* conn,
+                              const std::string& table,
+                              const boost::intrusive_ptr<const qpid::broker::PersistableMessage>& msg,
                               uint64_t offset,
                               uint32_t length)
 {
-    // Look up the message by its Id
-    std::ostringstream filter;
-    filter << "persistenceId = " << msg->getPersistenceId() << std::ends;
-    rs->PutFilter (VariantHelper<std::string>(filter.str()));
-    if (rs->RecordCount == 0) {
+    init(conn, table);
+    // NOTE! If this code needs to change, please verify the encoding
+    // code in BlobEncoder. The blob starts with the header size in four
+    // bytes, most significant first, which is also how SQL Server converts
+    // binary to int; the content follows the header. SUBSTRING positions
+    // count from 1 and stop short at the end of the blob.
+    std::ostringstream query;
+    query << "SELECT SUBSTRING(fieldTableBlob,"
+          << " CAST(SUBSTRING(fieldTableBlob, 1, 4) AS int) + 5 + " << offset
+          << ", " << length << ") AS content FROM " << tableName
+          << " WHERE persistenceId = " << msg->getPersistenceId() << std::ends;
+    rs->CursorLocation = adUseServer;
+    _ConnectionPtr p = *dbConn;
+    rs->Open(query.str().c_str(),
+             _variant_t((IDispatch *)p, true),
+             adOpenForwardOnly,
+             adLockReadOnly,
+             adCmdText);
+}
+
+void
+MessageRecordset::loadContent(std::string& data)
+{
+    if (rs->EndOfFile) {
         throw Exception("Can't load message not stored in database");
     }
-
-    // NOTE! If this code needs to change, please verify the encoding
-    // code in BlobEncoder.
-    long blobSize = rs->Fields->Item["fieldTableBlob"]->ActualSize;
-    uint32_t headerSize;
-    const size_t headerFieldLength = sizeof(headerSize);
-    BlobAdapter blob(headerFieldLength);
-    blob =
-        rs->Fields->Item["fieldTableBlob"]->GetChunk((long)headerFieldLength);
-    headerSize = ((qpid::framing::Buffer&)blob).getLong();
-
-    // GetChunk always begins reading where the previous GetChunk left off,
-    // so we can't just tell it to ignore the header and read the data.
-    // So, read the header plus the offset, plus the desired data, then
-    // copy the desired data to the supplied string. If this ends up asking
-    // for more than is available in the field, reduce it to what's there.
-    long getSize = headerSize + offset + length;
-    if (getSize + (long)headerFieldLength > blobSize) {
-        size_t reduce = (getSize + headerFieldLength) - blobSize;
-        getSize -= reduce;
-        length -= reduce;
+    FieldPtr content = rs->Fields->Item["content"];
+    long contentSize = content->ActualSize;
+    data.clear();
+    data.reserve(contentSize);
+    // Each GetChunk continues where the last left off; copying a chunk at
+    // a time keeps a second copy of a large range out of memory.
+    for (long loaded = 0; loaded < contentSize; ) {
+        long chunkSize = std::min(contentSize - loaded, ContentChunkSize);
+        BlobAdapter chunk(chunkSize);
+        chunk = content->GetChunk(chunkSize);
+        data.append(((qpid::framing::Buffer&)chunk).getPointer(), chunkSize);
+        loaded += chunkSize;
     }
-    BlobAdapter header_plus(getSize);
-    header_plus = rs->Fields->Item["fieldTableBlob"]->GetChunk(getSize);
-    uint8_t *throw_away = new uint8_t[headerSize + offset];
-    ((qpid::framing::Buffer&)header_plus).getRawData(throw_away, headerSize + offset);
-    delete throw_away;
-    ((qpid::framing::Buffer&)header_plus).getRawData(data, length);
 }
 
 void
 MessageRecordset::recover(qpid::broker::RecoveryManager& recoverer,
                           std::map<uint64_t, broker::RecoverableMessage::shared_ptr>& messageMap)
 {
+    // A freshly opened forward-only cursor is already on the first record.
     if (rs->BOF && rs->EndOfFile)
         return;   // Nothing to do
-    rs->MoveFirst();
     Binding b;
     IADORecordBinding *piAdoRecordBinding;
     rs->QueryInterface(__uuidof(IADORecordBinding), 
@@ -27,6 +27,7 @@
 #include <qpid/broker/PersistableMessage.h>
 #include <qpid/broker/RecoveryManager.h>
 #include <boost/intrusive_ptr.hpp>
+#include <vector>
 
 namespace qpid {
 namespace store {
@@ -58,21 +59,34 @@ public:
     // blob comprising the message.
     void add(const boost::intrusive_ptr<qpid::broker::PersistableMessage>& msg);
 
-    // Append additional content to an existing message.
+    // Store a group of messages in one round trip to the database. The
+    // recordset must have been opened with openBatch().
+    void add(const std::vector<boost::intrusive_ptr<qpid::broker::PersistableMessage> >& msgs);
+
+    // Append additional content to an existing message, writing it to the
+    // end of the blob on the server. The recordset must have been opened
+    // with openCommands().
     void append(const boost::intrusive_ptr<const qpid::broker::PersistableMessage>& msg,
                 const std::string& data);
 
     // Remove an existing message
     void remove(const boost::intrusive_ptr<const qpid::broker::PersistableMessage>& msg);
 
-    // Load all or part of a stored message. This skips the header parts and
-    // loads content.
-    void loadContent(const boost::intrusive_ptr<const qpid::broker::PersistableMessage>& msg,
-                     std::string& data,
+    // Open on all or part of the content of a stored message. The range
+    // is cut from the blob on the server, so neither the headers nor the
+    // content outside it are sent.
+    void openContent(DatabaseConnection* conn,
+                     const std::string& table,
+                     const boost::intrusive_ptr<const qpid::broker::PersistableMessage>& msg,
                      uint64_t offset,
                      uint32_t length);
 
-    // Recover messages and save a map of those recovered.
+    // Read the content selected by openContent() into data, a chunk at
+    // a time.
+    void loadContent(std::string& data);
+
+    // Recover messages and save a map of those recovered. The recordset
+    // should have been opened with openPaged().
     void recover(qpid::broker::RecoveryManager& recoverer,
                  std::map<uint64_t, broker::RecoverableMessage::shared_ptr>& messageMap);
 
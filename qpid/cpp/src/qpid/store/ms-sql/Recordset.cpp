@@ -29,6 +29,9 @@
 
 namespace {
 inline void TESTHR(HRESULT x) {if FAILED(x) _com_issue_error(x);};
+
+// Rows fetched from the server at a time by a paged recordset.
+const long RowsPerPage = 256;
 }
 
 namespace qpid {
@@ -59,6 +62,37 @@ Recordset::openRs()
              adCmdTable);
 }
 
+void
+Recordset::openPagedRs()
+{
+    // Server-side cursor so that only a page of records, blobs included,
+    // is held on the client at any time.
+    rs->CursorLocation = adUseServer;
+    rs->CacheSize = RowsPerPage;
+    _ConnectionPtr p = *dbConn;
+    rs->Open(tableName.c_str(),
+             _variant_t((IDispatch *)p, true),
+             adOpenForwardOnly,
+             adLockReadOnly,
+             adCmdTable);
+}
+
+void
+Recordset::openBatchRs()
+{
+    // Client-side so the identity column of each added record can be read
+    // back after UpdateBatch(); the query matches nothing so none of the
+    // existing records are fetched.
+    rs->CursorLocation = adUseClient;
+    const std::string query = "SELECT * FROM " + tableName + " WHERE 1=0";
+    _ConnectionPtr p = *dbConn;
+    rs->Open(query.c_str(),
+             _variant_t((IDispatch *)p, true),
+             adOpenStatic,
+             adLockBatchOptimistic,
+             adCmdText);
+}
+
 void
 Recordset::open(DatabaseConnection* conn, const std::string& table)
 {
@@ -66,6 +100,26 @@ Recordset::open(DatabaseConnection* conn, const std::string& table)
     openRs();
 }
 
+void
+Recordset::openPaged(DatabaseConnection* conn, const std::string& table)
+{
+    init(conn, table);
+    openPagedRs();
+}
+
+void
+Recordset::openBatch(DatabaseConnection* conn, const std::string& table)
+{
+    init(conn, table);
+    openBatchRs();
+}
+
+void
+Recordset::openCommands(DatabaseConnection* conn, const std::string& table)
+{
+    init(conn, table);
+}
+
 void
 Recordset::close()
 {
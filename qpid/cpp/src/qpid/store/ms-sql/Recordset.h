@@ -53,6 +53,12 @@ protected:
 
     void init(DatabaseConnection* conn, const std::string& table);
     void openRs();
+    // Open a server-side, forward-only, read-only cursor on the table that
+    // fetches a page of rows at a time rather than the whole table at once.
+    void openPagedRs();
+    // Open an empty client-side recordset on the table, for adding a batch
+    // of rows with AddNew() and sending them together with UpdateBatch().
+    void openBatchRs();
 
 public:
     Recordset() : rs(0), dbConn(0) {}
@@ -62,6 +68,20 @@ public:
      * Default open() reads all records into the recordset.
      */
     virtual void open(DatabaseConnection* conn, const std::string& table);
+    /**
+     * Open for a single pass over all records, paging them from the server;
+     * used for recovery.
+     */
+    void openPaged(DatabaseConnection* conn, const std::string& table);
+    /**
+     * Open with no records, ready to add a batch of new ones.
+     */
+    void openBatch(DatabaseConnection* conn, const std::string& table);
+    /**
+     * Open without fetching any records, for subclasses that run
+     * commands against the table.
+     */
+    void openCommands(DatabaseConnection* conn, const std::string& table);
     void close();
     void requery();
     operator _RecordsetPtr () { return rs; }
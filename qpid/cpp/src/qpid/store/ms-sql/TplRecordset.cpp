@@ -95,10 +95,9 @@ TplRecordset::remove(const std::string& xid)
 void
 TplRecordset::recover(std::set<std::string>& xids)
 {
-    openRs();
+    openPagedRs();
     if (rs->BOF && rs->EndOfFile)
         return;   // Nothing to do
-    rs->MoveFirst();
     while (!rs->EndOfFile) {
         _variant_t wxid = rs->Fields->Item["xid"]->Value;
         char *xidBytes;
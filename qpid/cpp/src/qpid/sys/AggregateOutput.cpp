@@ -20,13 +20,22 @@
  */
 
 #include "qpid/sys/AggregateOutput.h"
+#include "qpid/sys/ConnectionOutputHandler.h"
 #include "qpid/log/Statement.h"
 #include <algorithm>
 
 namespace qpid {
 namespace sys {
 
-AggregateOutput::AggregateOutput(OutputControl& c) : busy(false), control(c) {}
+AggregateOutput::AggregateOutput(OutputControl& c) :
+    busy(false), control(c), output(0), quantum(0), maxBuffered(0) {}
+
+void AggregateOutput::setByteBudget(size_t q, size_t max, const ConnectionOutputHandler& out) {
+    Mutex::ScopedLock l(lock);
+    quantum = q;
+    maxBuffered = max;
+    output = &out;
+}
 
 void AggregateOutput::abort() { control.abort(); }
 
@@ -48,33 +57,83 @@ bool AggregateOutput::doOutput() {
     Mutex::ScopedLock l(lock);
     ScopedBusy sb(busy, lock);
 
-    while (!tasks.empty()) {
-        OutputTask* t=tasks.front();
-        tasks.pop_front();
+    if (!lowLatency.empty() && doOutput(lowLatency, l)) return true;
+    return doOutput(tasks, l);
+}
+
+// A task with weight w stays at the front for w calls.
+bool AggregateOutput::doOutput(TaskList& list, const Mutex::ScopedLock& l) {
+    if (output) return doBudgetedOutput(list, l);
+
+    while (!list.empty()) {
+        Task t=list.front();
+        list.pop_front();
+        if (t.deficit <= 0) t.deficit += t.weight;
         bool didOutput;
         {
             // Allow concurrent call to addOutputTask.
             // removeOutputTask will wait till !busy before removing a task.
             Mutex::ScopedUnlock u(lock);
-            didOutput = t->doOutput();
+            didOutput = t.task->doOutput();
+        }
+        if (didOutput) {
+            if (--t.deficit > 0) list.push_front(t);
+            else list.push_back(t);
+            return true;
         }
+    }
+    return false;
+}
+
+// Deficit round robin: the task at the front is credited a quantum per
+// unit of weight and runs until it has used it up or has nothing more
+// to send. Any overdraft is carried into its next turn.
+bool AggregateOutput::doBudgetedOutput(TaskList& list, const Mutex::ScopedLock&) {
+    while (!list.empty()) {
+        // Leave the tasks and their messages where they are until
+        // enough of the output has been written
+        if (maxBuffered && output->getBuffered() >= maxBuffered) return false;
+
+        Task t=list.front();
+        list.pop_front();
+        t.deficit += int64_t(quantum ? quantum : 1) * t.weight;
+        if (t.deficit <= 0) {
+            list.push_back(t);
+            continue;
+        }
+        bool didOutput;
+        bool produced = false;
+        do {
+            Mutex::ScopedUnlock u(lock);
+            size_t before = output->getBuffered();
+            didOutput = t.task->doOutput();
+            produced = produced || didOutput;
+            size_t after = output->getBuffered();
+            // Count at least a byte a call so a turn always ends,
+            // and only calls when there is no byte quantum
+            t.deficit -= quantum && after > before ? after - before : 1;
+        } while (didOutput && t.deficit > 0 && (quantum || t.weight > 1) &&
+                 !(maxBuffered && output->getBuffered() >= maxBuffered));
         if (didOutput) {
-            tasks.push_back(t);
+            list.push_back(t);
             return true;
         }
+        if (produced) return true;
     }
     return false;
 }
   
 void AggregateOutput::addOutputTask(OutputTask* task) {
     Mutex::ScopedLock l(lock);
-    tasks.push_back(task);
+    if (task->isLowLatency()) lowLatency.push_back(task);
+    else tasks.push_back(task);
 }
 
 void AggregateOutput::removeOutputTask(OutputTask* task) {
     Mutex::ScopedLock l(lock);
     while (busy) lock.wait();
     tasks.erase(std::remove(tasks.begin(), tasks.end(), task), tasks.end());
+    lowLatency.erase(std::remove(lowLatency.begin(), lowLatency.end(), task), lowLatency.end());
 }
   
 void AggregateOutput::removeAll()
@@ -82,6 +141,7 @@ void AggregateOutput::removeAll()
     Mutex::ScopedLock l(lock);
     while (busy) lock.wait();
     tasks.clear();
+    lowLatency.clear();
 }
   
 
@@ -32,10 +32,23 @@
 namespace qpid {
 namespace sys {
 
+class ConnectionOutputHandler;
+
 /**
  * Holds a collection of output tasks, doOutput picks the next one to execute.
  * 
  * Tasks are automatically removed if their doOutput() or hasOutput() returns false.
+ *
+ * By default each call to doOutput() gives one task one turn. With a
+ * byte budget (see setByteBudget()) tasks take turns by the bytes they
+ * queue for writing instead, so a task sending large messages does not
+ * crowd out the others, and no task is run while the connection has
+ * too much output waiting to be written.
+ *
+ * A task's weight (OutputTask::getOutputWeight()) multiplies the turn
+ * it is given. Low latency tasks (OutputTask::isLowLatency()) take
+ * turns among themselves, and the other tasks get a turn only when no
+ * low latency task has output.
  * 
  * Thread safe. addOutputTask may be called in one connection thread while
  * doOutput is called in another.
@@ -43,12 +56,26 @@ namespace sys {
 
 class QPID_COMMON_CLASS_EXTERN AggregateOutput : public OutputTask, public OutputControl
 {
-    typedef std::deque<OutputTask*> TaskList;
+    struct Task {
+        OutputTask* task;
+        int64_t deficit;        // bytes, or calls, of its budget the task has left
+        uint32_t weight;        // budgets the task is credited each turn
+        Task(OutputTask* t) : task(t), deficit(0), weight(std::max(t->getOutputWeight(), uint32_t(1))) {}
+        bool operator==(const OutputTask* t) const { return task == t; }
+    };
+    typedef std::deque<Task> TaskList;
 
     Monitor lock;
     TaskList tasks;
+    TaskList lowLatency;        // Served before tasks
     bool busy;
     OutputControl& control;
+    const ConnectionOutputHandler* output;
+    size_t quantum;
+    size_t maxBuffered;
+
+    bool doOutput(TaskList&, const Mutex::ScopedLock&);
+    bool doBudgetedOutput(TaskList&, const Mutex::ScopedLock&);
 
   public:
     QPID_COMMON_EXTERN AggregateOutput(OutputControl& c);
@@ -59,6 +86,16 @@ class QPID_COMMON_CLASS_EXTERN AggregateOutput : public OutputTask, public Outpu
     QPID_COMMON_EXTERN void giveReadCredit(int32_t);
     QPID_COMMON_EXTERN void addOutputTask(OutputTask* t);
 
+    /**
+     * Give each task up to quantum bytes of output per turn, measured
+     * by out.getBuffered(), and run no task while more than
+     * maxBuffered bytes are waiting to be written. A zero quantum
+     * restores one call per turn, a zero maxBuffered removes the cap.
+     * Must be called before output starts.
+     */
+    QPID_COMMON_EXTERN void setByteBudget(size_t quantum, size_t maxBuffered,
+                                          const ConnectionOutputHandler& out);
+
     // These functions must not be called concurrently with each other.
     QPID_COMMON_EXTERN bool doOutput();
     QPID_COMMON_EXTERN void removeOutputTask(OutputTask* t);
@@ -67,7 +104,10 @@ class QPID_COMMON_CLASS_EXTERN AggregateOutput : public OutputTask, public Outpu
     /** Apply f to each OutputTask* in the tasks list */
     template <class F> void eachOutput(F f) {
         Mutex::ScopedLock l(lock);
-        std::for_each(tasks.begin(), tasks.end(), f);
+        for (TaskList::const_iterator i = lowLatency.begin(); i != lowLatency.end(); ++i)
+            f(i->task);
+        for (TaskList::const_iterator i = tasks.begin(); i != tasks.end(); ++i)
+            f(i->task);
     }
 };
 
@@ -0,0 +1,148 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/sys/AllocationCounts.h"
+#include "qpid/sys/AtomicValue.h"
+#include "qpid/sys/Thread.h"
+#include <new>
+#include <stdlib.h>
+
+namespace qpid {
+namespace sys {
+
+namespace {
+QPID_TSS allocation::Site current = allocation::other;
+
+// A diagnostic build can afford atomic counters that threads share
+AtomicValue<uint64_t> allocations[allocation::SITES];
+AtomicValue<uint64_t> bytes[allocation::SITES];
+AtomicValue<uint64_t> messages;
+
+const char* names[] = {
+    "other",
+    "framing",
+    "message",
+    "management",
+    "logging"
+};
+}
+
+bool AllocationCounts::enabled()
+{
+#ifdef QPID_HAS_ALLOCATION_COUNTS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AllocationCounts::allocated(size_t size)
+{
+    allocation::Site site = current;
+    allocations[site].fetchAndAdd(1);
+    bytes[site].fetchAndAdd(size);
+}
+
+void AllocationCounts::messageReceived()
+{
+    messages.fetchAndAdd(1);
+}
+
+allocation::Site AllocationCounts::enter(allocation::Site site)
+{
+    allocation::Site previous = current;
+    current = site;
+    return previous;
+}
+
+void AllocationCounts::leave(allocation::Site previous)
+{
+    current = previous;
+}
+
+void AllocationCounts::snapshot(Snapshot& counts)
+{
+    for (int i = 0; i < allocation::SITES; ++i) {
+        counts.allocations[i] = allocations[i].get();
+        counts.bytes[i] = bytes[i].get();
+    }
+    counts.messages = messages.get();
+}
+
+const char* AllocationCounts::name(allocation::Site site)
+{
+    return names[site];
+}
+
+}} // namespace qpid::sys
+
+#ifdef QPID_HAS_ALLOCATION_COUNTS
+
+// Replacements for the global operator new and delete, found before
+// those of the C++ runtime by anything linked with the common library.
+
+#if __cplusplus >= 201103L
+#  define QPID_THROWS_BAD_ALLOC
+#  define QPID_NO_THROW noexcept
+#else
+#  define QPID_THROWS_BAD_ALLOC throw (std::bad_alloc)
+#  define QPID_NO_THROW throw ()
+#endif
+
+namespace {
+void* allocate(size_t size)
+{
+    if (size == 0) size = 1;
+    qpid::sys::AllocationCounts::allocated(size);
+    void* p;
+    while (!(p = ::malloc(size))) {
+        std::new_handler handler = std::set_new_handler(0);
+        std::set_new_handler(handler);
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+    return p;
+}
+}
+
+void* operator new(size_t size) QPID_THROWS_BAD_ALLOC { return allocate(size); }
+void* operator new[](size_t size) QPID_THROWS_BAD_ALLOC { return allocate(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) QPID_NO_THROW
+{
+    try {
+        return allocate(size);
+    } catch (const std::bad_alloc&) {
+        return 0;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nt) QPID_NO_THROW
+{
+    return operator new(size, nt);
+}
+
+void operator delete(void* p) QPID_NO_THROW { ::free(p); }
+void operator delete[](void* p) QPID_NO_THROW { ::free(p); }
+void operator delete(void* p, const std::nothrow_t&) QPID_NO_THROW { ::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) QPID_NO_THROW { ::free(p); }
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_SYS_ALLOCATIONCOUNTS_H
+#define QPID_SYS_ALLOCATIONCOUNTS_H
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "qpid/sys/IntegerTypes.h"
+#include "qpid/CommonImportExport.h"
+#include <stddef.h>
+
+namespace qpid {
+namespace sys {
+
+/**
+ * Parts of the broker that allocations are counted against. A thread
+ * counts against the innermost site it is in, or other outside all.
+ */
+namespace allocation {
+enum Site {
+    other,
+    framing,            // Encoding and decoding frames
+    message,            // Building broker messages
+    management,         // Management agent processing and methods
+    logging,            // Writing log statements
+    SITES
+};
+}
+
+/**
+ * Counts of the memory allocated in this process, by site. In a build
+ * with allocation counting (ENABLE_ALLOCATION_COUNTS in cmake,
+ * --enable-allocation-counts in configure) the common library replaces
+ * the global operator new to call allocated(), and the marks below are
+ * compiled in. Otherwise nothing calls it and the counts stay at 0.
+ */
+class AllocationCounts
+{
+  public:
+    struct Snapshot {
+        uint64_t allocations[allocation::SITES];
+        uint64_t bytes[allocation::SITES];
+        uint64_t messages;      // Messages received, to count per message
+    };
+
+    QPID_COMMON_EXTERN static bool enabled();
+
+    QPID_COMMON_EXTERN static void allocated(size_t bytes);
+    QPID_COMMON_EXTERN static void messageReceived();
+
+    /** Make @a site the calling thread's site, returning the previous one */
+    QPID_COMMON_EXTERN static allocation::Site enter(allocation::Site site);
+    QPID_COMMON_EXTERN static void leave(allocation::Site previous);
+
+    QPID_COMMON_EXTERN static void snapshot(Snapshot& counts);
+    QPID_COMMON_EXTERN static const char* name(allocation::Site site);
+};
+
+/** Counts the calling thread's allocations against a site while in scope */
+class AllocationSite
+{
+  public:
+    AllocationSite(allocation::Site site) : previous(AllocationCounts::enter(site)) {}
+    ~AllocationSite() { AllocationCounts::leave(previous); }
+
+  private:
+    allocation::Site previous;
+};
+
+}} // namespace qpid::sys
+
+/**
+ * QPID_ALLOCATION_SITE(site) counts the allocations in the rest of the
+ * enclosing scope against the site. QPID_ALLOCATION_MESSAGE() counts a
+ * message received by the broker. Both compile to nothing unless the
+ * build counts allocations.
+ */
+#ifdef QPID_HAS_ALLOCATION_COUNTS
+#  define QPID_ALLOCATION_SITE(site) \
+    ::qpid::sys::AllocationSite qpid_allocation_site_(::qpid::sys::allocation::site)
+#  define QPID_ALLOCATION_MESSAGE() ::qpid::sys::AllocationCounts::messageReceived()
+#else
+#  define QPID_ALLOCATION_SITE(site)
+#  define QPID_ALLOCATION_MESSAGE() do {} while (0)
+#endif
+
+#endif  /*!QPID_SYS_ALLOCATIONCOUNTS_H*/
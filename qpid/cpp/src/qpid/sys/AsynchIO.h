@@ -43,7 +43,15 @@ class AsynchAcceptor {
 public:
     typedef boost::function1<void, const Socket&> Callback;
 
+    /** Accept activity across all acceptors in the process */
+    struct Stats {
+        uint64_t accepted;      // Connections accepted since the process started
+        uint32_t largestBatch;  // Most connections waiting at one wakeup since the last call
+    };
+
     QPID_COMMON_EXTERN static AsynchAcceptor* create(const Socket& s, Callback callback);
+    /** Fill in @a stats, starting a new period for largestBatch */
+    QPID_COMMON_EXTERN static void getStats(Stats& stats);
     virtual ~AsynchAcceptor() {};
     virtual void start(boost::shared_ptr<Poller> poller) = 0;
 };
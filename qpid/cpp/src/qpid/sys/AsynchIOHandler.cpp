@@ -21,26 +21,140 @@
 
 #include "qpid/sys/AsynchIOHandler.h"
 #include "qpid/sys/AsynchIO.h"
+#include "qpid/sys/HugePages.h"
+#include "qpid/sys/NumaNodes.h"
 #include "qpid/sys/Socket.h"
 #include "qpid/sys/SecuritySettings.h"
+#include "qpid/framing/AMQFrame.h"
 #include "qpid/framing/AMQP_HighestVersion.h"
 #include "qpid/framing/ProtocolInitiation.h"
 #include "qpid/log/Statement.h"
 
 #include <boost/bind.hpp>
+#include <boost/scoped_array.hpp>
+#include <string.h>
+#include <vector>
 
 namespace qpid {
 namespace sys {
 
+namespace {
+
+/**
+ * Pool of IO buffers shared by all connections. Connections take
+ * buffers from the pool when there is something to read or write and
+ * hand them back once the data has been decoded or written, so idle
+ * connections hold no buffers. Small buffers are used until a
+ * connection fills one, large ones are needed to hold a whole frame.
+ *
+ * There is a pool for each NUMA node. A thread takes buffers from the
+ * pool of its own node, where they were first written to and so
+ * placed, and they go back to that pool whichever thread releases them.
+ *
+ * Buffers come from huge pages if the broker was configured to use
+ * them, and from the heap otherwise or once there are no more.
+ */
+class BufferPool {
+  public:
+    enum SizeClass { SMALL, LARGE, SIZE_CLASSES };
+
+    BufferPool() : inUse(0), allocated(0), released(0), releasedRemote(0) {}
+    ~BufferPool();
+
+    char* get(SizeClass c);
+    void put(char* bytes, int32_t size, bool remote);
+    void getStats(AsynchIOHandler::BufferPoolStats&);
+
+    static int32_t size(SizeClass c) { return c == SMALL ? 4096 : 65536; }
+
+  private:
+    // Free buffers beyond these are returned to the heap
+    static size_t maxFree(SizeClass c) { return c == SMALL ? 1024 : 256; }
+
+    Mutex lock;
+    std::vector<char*> freeList[SIZE_CLASSES];
+    uint32_t inUse;
+    uint64_t allocated;
+    uint64_t released;
+    uint64_t releasedRemote;
+};
+
+BufferPool::~BufferPool() {
+    for (int c = SMALL; c < SIZE_CLASSES; ++c) {
+        for (std::vector<char*>::iterator i = freeList[c].begin(); i != freeList[c].end(); ++i)
+            if (!HugePages::release(*i, size(SizeClass(c)))) delete [] *i;
+    }
+}
+
+char* BufferPool::get(SizeClass c) {
+    ScopedLock<Mutex> l(lock);
+    ++inUse;
+    if (freeList[c].empty()) {
+        allocated += size(c);
+        char* bytes = static_cast<char*>(HugePages::allocate(size(c)));
+        return bytes ? bytes : new char[size(c)];
+    }
+    char* bytes = freeList[c].back();
+    freeList[c].pop_back();
+    return bytes;
+}
+
+void BufferPool::put(char* bytes, int32_t s, bool remote) {
+    SizeClass c = s == size(SMALL) ? SMALL : LARGE;
+    ScopedLock<Mutex> l(lock);
+    --inUse;
+    ++released;
+    if (remote) ++releasedRemote;
+    if (freeList[c].size() < maxFree(c)) {
+        freeList[c].push_back(bytes);
+    } else {
+        allocated -= s;
+        if (!HugePages::release(bytes, s)) delete [] bytes;
+    }
+}
+
+void BufferPool::getStats(AsynchIOHandler::BufferPoolStats& stats) {
+    ScopedLock<Mutex> l(lock);
+    stats.buffersInUse += inUse;
+    stats.buffersFree += freeList[SMALL].size() + freeList[LARGE].size();
+    stats.bytesAllocated += allocated;
+    stats.buffersReleased += released;
+    stats.buffersReleasedRemote += releasedRemote;
+}
+
+BufferPool& pool(uint32_t node) {
+    static boost::scoped_array<BufferPool> pools(new BufferPool[NumaNodes::count()]);
+    return pools[node % NumaNodes::count()];
+}
+
+}
+
 // Buffer definition
 struct Buff : public AsynchIO::BufferBase {
-    Buff() :
-        AsynchIO::BufferBase(new char[65536], 65536)
+    const uint32_t node;
+
+    Buff(BufferPool::SizeClass c = BufferPool::LARGE) :
+        AsynchIO::BufferBase(pool(NumaNodes::current()).get(c), BufferPool::size(c)),
+        node(NumaNodes::current())
     {}
     ~Buff()
-    { delete [] bytes;}
+    { pool(node).put(bytes, byteCount, node != NumaNodes::current());}
 };
 
+namespace {
+/** True if the frame starting the data in buff is larger than buff */
+bool frameExceeds(AsynchIO::BufferBase& buff) {
+    return buff.dataCount >= framing::AMQFrame::DECODE_SIZE_MIN &&
+        framing::AMQFrame::decodeSize(buff.bytes + buff.dataStart) > buff.byteCount;
+}
+}
+
+void AsynchIOHandler::getBufferPoolStats(BufferPoolStats& stats) {
+    stats = BufferPoolStats();
+    for (uint32_t node = 0; node < NumaNodes::count(); ++node)
+        pool(node).getStats(stats);
+}
+
 AsynchIOHandler::AsynchIOHandler(std::string id, ConnectionCodec::Factory* f) :
     identifier(id),
     aio(0),
@@ -48,7 +162,8 @@ AsynchIOHandler::AsynchIOHandler(std::string id, ConnectionCodec::Factory* f) :
     codec(0),
     readError(false),
     isClient(false),
-    readCredit(InfiniteCredit)
+    readCredit(InfiniteCredit),
+    lastReadFilled(false)
 {}
 
 AsynchIOHandler::~AsynchIOHandler() {
@@ -60,9 +175,10 @@ AsynchIOHandler::~AsynchIOHandler() {
 void AsynchIOHandler::init(AsynchIO* a, int numBuffs) {
     aio = a;
 
-    // Give connection some buffers to use
-    for (int i = 0; i < numBuffs; i++) {
-        aio->queueReadBuffer(new Buff);
+    // Give connection a buffer to start with, further buffers are
+    // taken from the shared pool on demand (see nobuffs())
+    if (numBuffs > 0) {
+        aio->queueReadBuffer(new Buff(BufferPool::SMALL));
     }
 }
 
@@ -106,6 +222,7 @@ void AsynchIOHandler::giveReadCredit(int32_t credit) {
 
 void AsynchIOHandler::readbuff(AsynchIO& , AsynchIO::BufferBase* buff) {
     if (readError) {
+        delete buff;
         return;
     }
 
@@ -129,6 +246,8 @@ void AsynchIOHandler::readbuff(AsynchIO& , AsynchIO::BufferBase* buff) {
         }
     }
 
+    lastReadFilled = buff->dataStart + buff->dataCount == buff->byteCount;
+
     size_t decoded = 0;
     if (codec) {                // Already initiated
         try {
@@ -145,7 +264,7 @@ void AsynchIOHandler::readbuff(AsynchIO& , AsynchIO::BufferBase* buff) {
             decoded = in.getPosition();
             QPID_LOG(debug, "RECV [" << identifier << "] INIT(" << protocolInit << ")");
             try {
-                codec = factory->create(protocolInit.getVersion(), *this, identifier, SecuritySettings());
+                codec = factory->create(protocolInit.getVersion(), *this, identifier, securitySettings);
                 if (!codec) {
                     //TODO: may still want to revise this...
                     //send valid version header & close connection.
@@ -166,10 +285,21 @@ void AsynchIOHandler::readbuff(AsynchIO& , AsynchIO::BufferBase* buff) {
         // Adjust buffer for used bytes and then "unread them"
         buff->dataStart += decoded;
         buff->dataCount -= decoded;
+        if (buff->byteCount < BufferPool::size(BufferPool::LARGE) &&
+            (buff->dataCount == buff->byteCount || (codec && frameExceeds(*buff)))) {
+            // A partial frame that can't fit in a small buffer: move it
+            // to a buffer large enough to hold the whole frame now
+            // rather than after another read has filled this one
+            AsynchIO::BufferBase* large = new Buff(BufferPool::LARGE);
+            ::memcpy(large->bytes, buff->bytes+buff->dataStart, buff->dataCount);
+            large->dataCount = buff->dataCount;
+            delete buff;
+            buff = large;
+        }
         aio->unread(buff);
     } else {
-        // Give whole buffer back to aio subsystem
-        aio->queueReadBuffer(buff);
+        // Give whole buffer back to the pool
+        delete buff;
     }
 }
 
@@ -196,11 +326,13 @@ void AsynchIOHandler::disconnect(AsynchIO&) {
 
 // Notifications
 void AsynchIOHandler::nobuffs(AsynchIO&) {
+    // Only connections that fill their buffers need large ones
+    aio->queueReadBuffer(new Buff(lastReadFilled ? BufferPool::LARGE : BufferPool::SMALL));
 }
 
 void AsynchIOHandler::idle(AsynchIO&){
     if (isClient && codec == 0) {
-        codec = factory->create(*this, identifier, SecuritySettings());
+        codec = factory->create(*this, identifier, securitySettings);
         write(framing::ProtocolInitiation(codec->getVersion()));
         return;
     }
@@ -213,6 +345,11 @@ void AsynchIOHandler::idle(AsynchIO&){
             size_t encoded=codec->encode(buff->bytes, buff->byteCount);
             buff->dataCount = encoded;
             aio->queueWrite(buff);
+        } else {
+            // The writes are complete: the buffers they were made in
+            // were queued for reading, give the spares back to the pool
+            while (AsynchIO::BufferBase* buff = aio->getQueuedBuffer())
+                delete buff;
         }
         if (codec->isClosed()) {
             readError = true;
@@ -23,6 +23,7 @@
 
 #include "qpid/sys/OutputControl.h"
 #include "qpid/sys/ConnectionCodec.h"
+#include "qpid/sys/SecuritySettings.h"
 #include "qpid/sys/AtomicValue.h"
 #include "qpid/sys/Mutex.h"
 #include "qpid/CommonImportExport.h"
@@ -40,6 +41,20 @@ struct AsynchIOBufferBase;
 class Socket;
 
 class AsynchIOHandler : public OutputControl {
+  public:
+    /** Occupancy of the buffer pools shared by all connections */
+    struct BufferPoolStats {
+        uint32_t buffersInUse;
+        uint32_t buffersFree;
+        uint64_t bytesAllocated;
+        uint64_t buffersReleased;
+        uint64_t buffersReleasedRemote; // by a thread on another NUMA node
+
+        BufferPoolStats() : buffersInUse(0), buffersFree(0), bytesAllocated(0),
+                            buffersReleased(0), buffersReleasedRemote(0) {}
+    };
+
+  private:
     std::string identifier;
     AsynchIO* aio;
     ConnectionCodec::Factory* factory;
@@ -49,6 +64,8 @@ class AsynchIOHandler : public OutputControl {
     AtomicValue<int32_t> readCredit;
     static const int32_t InfiniteCredit = -1;
     Mutex creditLock;
+    bool lastReadFilled;
+    SecuritySettings securitySettings;
 
     void write(const framing::ProtocolInitiation&);
 
@@ -58,6 +75,8 @@ class AsynchIOHandler : public OutputControl {
     QPID_COMMON_EXTERN void init(AsynchIO* a, int numBuffs);
 
     QPID_COMMON_INLINE_EXTERN void setClient() { isClient = true; }
+    /** What the transport established about the peer, e.g. who it is */
+    QPID_COMMON_INLINE_EXTERN void setSecuritySettings(const SecuritySettings& s) { securitySettings = s; }
 
     // Output side
     QPID_COMMON_EXTERN void abort();
@@ -73,6 +92,8 @@ class AsynchIOHandler : public OutputControl {
     QPID_COMMON_EXTERN void nobuffs(AsynchIO& aio);
     QPID_COMMON_EXTERN void idle(AsynchIO& aio);
     QPID_COMMON_EXTERN void closedSocket(AsynchIO& aio, const Socket& s);
+
+    QPID_COMMON_EXTERN static void getBufferPoolStats(BufferPoolStats&);
 };
 
 }} // namespace qpid::sys
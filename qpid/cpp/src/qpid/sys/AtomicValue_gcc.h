@@ -30,7 +30,7 @@ namespace qpid {
 namespace sys {
 
 /**
- * Atomic value of type T. T must be an integral type of size 1,2,4 or 8 bytes.
+ * Atomic value of type T. T must be an integral or pointer type of size 1,2,4 or 8 bytes.
  * All operations are atomic and preform a full memory barrier unless otherwise noted.
  */
 template <class T>
@@ -23,6 +23,7 @@
  */
 
 #include "qpid/sys/Waitable.h"
+#include "qpid/sys/AtomicValue.h"
 
 #include <queue>
 
@@ -31,15 +32,33 @@ namespace sys {
 
 /**
  * A simple blocking queue template
+ *
+ * Consumers that find the queue empty may first spin for a short
+ * while, without the lock, before they block. Producers only signal
+ * when a consumer is actually blocked, so a consumer keeping up with
+ * its producer costs neither side a wakeup.
  */
 template <class T>
 class BlockingQueue
 {
     mutable sys::Waitable waitable;
     std::queue<T> queue;
+    AtomicValue<uint32_t> count; // queue.size(), readable without the lock
+    const Duration spin;
+
+    /** Spin without the lock until there is a value or the spin period ends. */
+    void spinWait(Duration timeout) const {
+        if (count.get() || !spin || !timeout) return;
+        AbsTime deadline(now(), timeout == TIME_INFINITE || spin < timeout ? spin : timeout);
+        while (!count.get() && deadline > now()) {}
+    }
 
 public:
-    BlockingQueue() {}
+    /**
+     *@param spinPeriod How long pop() spins before it blocks on an
+     * empty queue. 0, the default, blocks straight away.
+     */
+    BlockingQueue(Duration spinPeriod=0) : spin(spinPeriod) {}
     ~BlockingQueue() { close(); }
 
     /** Pop from the queue, block up to timeout if empty.
@@ -48,6 +67,7 @@ public:
      *@return true if result was set, false if queue empty after timeout.
      */
     bool pop(T& result, Duration timeout=TIME_INFINITE) {
+        spinWait(timeout);
         Mutex::ScopedLock l(waitable);
         {
             Waitable::ScopedWait w(waitable);
@@ -65,7 +85,8 @@ public:
         if (queue.empty()) return false;
         result = queue.front();
         queue.pop();
-        if (!queue.empty())
+        count.fetchAndSub(1);
+        if (!queue.empty() && waitable.hasWaiters())
             waitable.notify();  // Notify another waiter.
         return true;
     }
@@ -84,7 +105,9 @@ public:
     void push(const T& t) {
         Mutex::ScopedLock l(waitable);
         queue.push(t);
-        waitable.notify();      // Notify a waiter.
+        count.fetchAndAdd(1);
+        if (waitable.hasWaiters())
+            waitable.notify();  // Notify a waiter.
     }
 
     /**
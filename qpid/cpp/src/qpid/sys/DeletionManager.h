@@ -22,9 +22,12 @@
  *
  */
 
+#include "qpid/sys/AtomicValue.h"
+#include "qpid/sys/IntegerTypes.h"
+#include "qpid/sys/Mutex.h"
 #include <vector>
+#include <deque>
 #include <algorithm>
-#include <boost/shared_ptr.hpp>
 
 namespace qpid {
 namespace sys {
@@ -38,16 +41,22 @@ struct deleter
 /**
  * DeletionManager keeps track of handles that need to be deleted but may still be
  * in use by one of the threads concurrently.
- * 
- * The mode of operation is like this:
+ *
+ * It counts epochs. The mode of operation is like this:
  * - When we want to delete but we might still be using the handle we
- *   * Transfer ownership of the handle to this class
- *   * Mark the handle as (potentially) in use by every thread
+ *   * Transfer ownership of the handle to this class, tagged with the
+ *     current epoch
+ *   * Start a new epoch
  * - Then subsequently at points where the thread code knows it isn't
- *   using any handles it declares that it is using no handles
- * - When the last thread declares no use of a handle it automatically
- *   gets deleted by the shared_ptr implementation
- * 
+ *   using any handles it declares that it is using no handles, and so
+ *   that it has reached the current epoch
+ * - A handle gets deleted once every thread has reached an epoch later
+ *   than its tag
+ *
+ * Declaring no use when nothing was marked for deletion since the
+ * last time reads one counter and takes no lock. A thread that stops
+ * declaring holds deletions back until it destroys its thread state.
+ *
  * The class only has static members and data and so can only be used once for
  * any particular handle type
  */
@@ -57,10 +66,10 @@ class DeletionManager
     struct ThreadStatus;
 
 public:
-    // Mark every thread as using the handle - it will be deleted
-    // below after every thread marks the handle as unused
+    // Start a new epoch - the handle will be deleted
+    // below after every thread has reached it
     static void markForDeletion(H* handle) {
-        allThreadsStatuses.addHandle(shared_ptr(handle));
+        allThreadsStatuses.addHandle(handle);
     }
     
     // Mark this thread is not using any handle -
@@ -68,18 +77,21 @@ public:
     // is using them either 
     static void markAllUnusedInThisThread() {
         ThreadStatus* threadStatus = getThreadStatus();
-        ScopedLock<Mutex> l(threadStatus->lock);
+        uint64_t epoch = allThreadsStatuses.epoch.get();
+        if (epoch == threadStatus->epoch) return;
 
-        // The actual deletions will happen here when all the shared_ptr
-        // ref counts hit 0 (that is when every thread marks the handle unused)
-        threadStatus->handles.clear();
+        // Only this thread changes its epoch so the swap can't fail
+        threadStatus->reached.boolCompareAndSwap(threadStatus->epoch, epoch);
+        threadStatus->epoch = epoch;
+        allThreadsStatuses.deleteUnused();
     }
 
     static void destroyThreadState() {
-        ThreadStatus* threadStatus = getThreadStatus();
+        ThreadStatus*& threadStatus = getThreadStatus();
         allThreadsStatuses.delThreadStatus(threadStatus);
         delete threadStatus;
         threadStatus = 0;
+        allThreadsStatuses.deleteUnused();
     }
 
 private:
@@ -98,45 +110,37 @@ private:
         return threadStatus;
     }
 
-    typedef boost::shared_ptr<H> shared_ptr;
-
-    // In theory we know that we never need more handles than the number of
-    // threads runnning so we could use a fixed size array. However at this point
-    // in the code we don't have easy access to this information. 
     struct ThreadStatus
     {
-        Mutex lock;
-        std::vector<shared_ptr> handles;
+        AtomicValue<uint64_t> reached;  // Read by other threads
+        uint64_t epoch;                 // This thread's copy of reached
     };
 
     class AllThreadsStatuses
     {
         Mutex lock;
         std::vector<ThreadStatus*> statuses;
-
-        struct handleAdder
-        {
-            shared_ptr handle;
-
-            handleAdder(shared_ptr h): handle(h) {}
-        
-            void operator()(ThreadStatus* ptr) {
-                ScopedLock<Mutex> l(ptr->lock);
-                ptr->handles.push_back(handle);
-            }
-        };
+        std::deque<std::pair<uint64_t, H*> > handles;
 
     public:
+        AtomicValue<uint64_t> epoch;
+
         // Need this to be able to do static initialisation
-        explicit AllThreadsStatuses(int) {}
+        explicit AllThreadsStatuses(int) : epoch(1) {}
 
         ~AllThreadsStatuses() {
             ScopedLock<Mutex> l(lock);
             std::for_each(statuses.begin(), statuses.end(), deleter());
+            for (typename std::deque<std::pair<uint64_t, H*> >::iterator i = handles.begin();
+                 i != handles.end(); ++i) {
+                delete i->second;
+            }
         }
 
         void addThreadStatus(ThreadStatus* t) {
             ScopedLock<Mutex> l(lock);
+            t->epoch = epoch.get();
+            t->reached = t->epoch;
             statuses.push_back(t);
         }
 
@@ -149,9 +153,31 @@ private:
             }
         }
 
-        void addHandle(shared_ptr h) {
-            ScopedLock<Mutex> l(lock);
-            std::for_each(statuses.begin(), statuses.end(), handleAdder(h));
+        void addHandle(H* h) {
+            {
+                ScopedLock<Mutex> l(lock);
+                handles.push_back(std::make_pair(epoch.fetchAndAdd(1), h));
+            }
+            // Deleted at once if there are no threads to wait for
+            deleteUnused();
+        }
+
+        // Delete the handles tagged before the epoch every thread has reached
+        void deleteUnused() {
+            std::vector<H*> unused;
+            {
+                ScopedLock<Mutex> l(lock);
+                uint64_t oldest = epoch.get();
+                for (typename std::vector<ThreadStatus*>::const_iterator i = statuses.begin();
+                     i != statuses.end(); ++i) {
+                    oldest = std::min(oldest, (*i)->reached.get());
+                }
+                while (!handles.empty() && handles.front().first < oldest) {
+                    unused.push_back(handles.front().second);
+                    handles.pop_front();
+                }
+            }
+            std::for_each(unused.begin(), unused.end(), deleter());
         }
     };
     
@@ -0,0 +1,184 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/sys/HugePages.h"
+#include "qpid/sys/Mutex.h"
+#include <algorithm>
+#include <map>
+#include <vector>
+#ifdef __linux__
+#  include <sys/mman.h>
+#endif
+
+namespace qpid {
+namespace sys {
+
+namespace {
+const size_t MB = 1024 * 1024;
+
+// Page sized buffers are page aligned, smaller blocks as malloc would align them
+inline size_t alignment(size_t size) { return size >= 4096 ? 4096 : 16; }
+
+class Pages {
+  public:
+    Pages() : pageSize(0), next(0), end(0), exhausted(false) {}
+
+    bool configure(size_t size);
+    void* allocate(size_t size);
+    bool release(void* block, size_t size);
+    void getStats(HugePages::Stats&);
+
+    // Read without the lock so that the heap paths stay cheap when off
+    size_t pageSize;
+
+  private:
+    typedef std::map<size_t, std::vector<char*> > FreeLists;
+
+    Mutex lock;
+    std::vector<char*> pages;   // Sorted by address
+    FreeLists freeLists;
+    char* next;                 // Unused part of the last page mapped
+    char* end;
+    bool exhausted;             // The system refused to map another page
+    HugePages::Stats stats;
+
+    bool mapPage();
+    bool owns(char* block) const;
+};
+
+bool Pages::configure(size_t size)
+{
+#if defined(__linux__) && defined(MAP_HUGETLB)
+    ScopedLock<Mutex> l(lock);
+    pageSize = size;
+    stats.pageSize = size;
+    return true;
+#else
+    (void) size;
+    return false;
+#endif
+}
+
+bool Pages::mapPage()
+{
+#if defined(__linux__) && defined(MAP_HUGETLB)
+    if (exhausted) return false;
+    // The page size is encoded above MAP_HUGE_SHIFT (26) as its log2
+    int log2 = pageSize == 1024 * MB ? 30 : 21;
+    void* page = ::mmap(0, pageSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (log2 << 26), -1, 0);
+    if (page == MAP_FAILED) {
+        exhausted = true;
+        return false;
+    }
+    next = static_cast<char*>(page);
+    end = next + pageSize;
+    pages.insert(std::upper_bound(pages.begin(), pages.end(), next), next);
+    stats.bytesMapped += pageSize;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Pages::owns(char* block) const
+{
+    std::vector<char*>::const_iterator i = std::upper_bound(pages.begin(), pages.end(), block);
+    return i != pages.begin() && block < *(i - 1) + pageSize;
+}
+
+void* Pages::allocate(size_t size)
+{
+    ScopedLock<Mutex> l(lock);
+    std::vector<char*>& free = freeLists[size];
+    if (!free.empty()) {
+        char* block = free.back();
+        free.pop_back();
+        stats.bytesInUse += size;
+        return block;
+    }
+    size_t align = alignment(size);
+    char* block = next ? next + (align - reinterpret_cast<size_t>(next) % align) % align : 0;
+    if (!block || block + size > end) {
+        if (size > pageSize || !mapPage()) {
+            ++stats.fallbacks;
+            return 0;
+        }
+        block = next;
+    }
+    next = block + size;
+    stats.bytesInUse += size;
+    return block;
+}
+
+bool Pages::release(void* block, size_t size)
+{
+    ScopedLock<Mutex> l(lock);
+    if (!owns(static_cast<char*>(block))) return false;
+    freeLists[size].push_back(static_cast<char*>(block));
+    stats.bytesInUse -= size;
+    return true;
+}
+
+void Pages::getStats(HugePages::Stats& s)
+{
+    ScopedLock<Mutex> l(lock);
+    s = stats;
+}
+
+Pages& pages()
+{
+    static Pages instance;
+    return instance;
+}
+}
+
+bool HugePages::configure(size_t pageSize)
+{
+    if (pageSize != 2 * MB && pageSize != 1024 * MB) return false;
+    return pages().configure(pageSize);
+}
+
+size_t HugePages::parseSize(const std::string& size)
+{
+    if (size == "2M" || size == "2m") return 2 * MB;
+    if (size == "1G" || size == "1g") return 1024 * MB;
+    return 0;
+}
+
+void* HugePages::allocate(size_t size)
+{
+    Pages& p = pages();
+    return p.pageSize ? p.allocate(size) : 0;
+}
+
+bool HugePages::release(void* block, size_t size)
+{
+    Pages& p = pages();
+    return p.pageSize && block ? p.release(block, size) : false;
+}
+
+void HugePages::getStats(Stats& stats)
+{
+    pages().getStats(stats);
+}
+
+}} // namespace qpid::sys
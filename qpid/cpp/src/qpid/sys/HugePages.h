@@ -0,0 +1,75 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_SYS_HUGEPAGES_H
+#define QPID_SYS_HUGEPAGES_H
+
+#include "qpid/sys/IntegerTypes.h"
+#include "qpid/CommonImportExport.h"
+#include <stddef.h>
+#include <string>
+
+namespace qpid {
+namespace sys {
+
+/**
+ * Memory carved from explicit huge pages, for the IO buffer pool and
+ * the pooled message blocks of MemoryPool, to cut TLB misses when a
+ * broker holds a lot of messages.
+ *
+ * Nothing is mapped until configure() chooses a page size. Pages are
+ * then mapped one at a time as blocks are needed and are never
+ * unmapped: released blocks are kept for the next allocation of the
+ * same size. When the system has no more huge pages to give,
+ * allocate() returns 0 and the caller uses the heap instead. Only
+ * Linux supports huge pages; elsewhere configure() fails.
+ */
+class HugePages
+{
+  public:
+    struct Stats {
+        uint64_t pageSize;      // 0 if not in use
+        uint64_t bytesMapped;
+        uint64_t bytesInUse;
+        uint64_t fallbacks;     // Allocations left to the heap
+
+        Stats() : pageSize(0), bytesMapped(0), bytesInUse(0), fallbacks(0) {}
+    };
+
+    /** Use pages of pageSize bytes, which must be 2MB or 1GB.
+     *@return false if this platform cannot map them */
+    QPID_COMMON_EXTERN static bool configure(size_t pageSize);
+
+    /** Parse "2M" or "1G" as a page size, 0 for "no" or anything else */
+    QPID_COMMON_EXTERN static size_t parseSize(const std::string& size);
+
+    /** @return a block of size bytes, or 0 if it must come from the heap */
+    QPID_COMMON_EXTERN static void* allocate(size_t size);
+
+    /** Keep block for reuse if it came from allocate().
+     *@return false if it did not, so the caller must free it */
+    QPID_COMMON_EXTERN static bool release(void* block, size_t size);
+
+    QPID_COMMON_EXTERN static void getStats(Stats&);
+};
+
+}} // namespace qpid::sys
+
+#endif  /*!QPID_SYS_HUGEPAGES_H*/
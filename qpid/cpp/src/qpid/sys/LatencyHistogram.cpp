@@ -0,0 +1,122 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/sys/LatencyHistogram.h"
+#include <sstream>
+
+namespace qpid {
+namespace sys {
+
+namespace {
+const uint32_t SUB_BITS(2);     // log2(SUB_BUCKETS)
+}
+
+LatencyHistogram::LatencyHistogram() {}
+
+uint32_t LatencyHistogram::bucket(uint64_t micros)
+{
+    if (micros < SUB_BUCKETS)
+        return micros;
+#if defined(__GNUC__)
+    uint32_t power = 63 - __builtin_clzll(micros);   // micros >= 2^power
+#else
+    uint32_t power = 0;
+    for (uint64_t m = micros; m > 1; m >>= 1)
+        ++power;
+#endif
+    uint32_t shift = power - SUB_BITS;
+    uint32_t b = (shift + 1) * SUB_BUCKETS + ((micros >> shift) & (SUB_BUCKETS - 1));
+    return b < BUCKETS ? b : BUCKETS - 1;
+}
+
+uint64_t LatencyHistogram::upperBound(uint32_t b)
+{
+    if (b < SUB_BUCKETS)
+        return b;
+    uint32_t shift = b / SUB_BUCKETS - 1;
+    uint64_t low = uint64_t(SUB_BUCKETS + b % SUB_BUCKETS) << shift;
+    return low + (uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(Duration latency)
+{
+    int64_t ns = latency;
+    ++counts[bucket(ns > 0 ? ns / TIME_USEC : 0)];
+}
+
+void LatencyHistogram::snapshot(types::Variant::Map& result) const
+{
+    result.clear();
+    for (uint32_t b = 0; b < BUCKETS; ++b) {
+        uint64_t n = counts[b].get();
+        if (n) {
+            std::ostringstream key;
+            key << upperBound(b);
+            result[key.str()] = n;
+        }
+    }
+}
+
+uint64_t LatencyHistogram::total() const
+{
+    uint64_t n = 0;
+    for (uint32_t b = 0; b < BUCKETS; ++b)
+        n += counts[b].get();
+    return n;
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const
+{
+    uint64_t snapshot[BUCKETS];
+    uint64_t n = 0;
+    for (uint32_t b = 0; b < BUCKETS; ++b)
+        n += snapshot[b] = counts[b].get();
+    if (!n) return 0;
+    // The rank of the value wanted, counting from 1
+    uint64_t rank = uint64_t(fraction * n + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < BUCKETS; ++b) {
+        seen += snapshot[b];
+        if (seen >= rank) return upperBound(b);
+    }
+    return upperBound(BUCKETS - 1);
+}
+
+LatencyHistogramExport::LatencyHistogramExport(const LatencyHistogram& h, Callback c,
+                                               Timer& t, Duration period)
+    : TimerTask(period, "LatencyHistogramExport"), histogram(h), callback(c), timer(t), exported(0)
+{}
+
+void LatencyHistogramExport::fire()
+{
+    uint64_t n = histogram.total();
+    if (n != exported) {
+        types::Variant::Map counts;
+        histogram.snapshot(counts);
+        callback(counts);
+        exported = n;
+    }
+    setupNextFire();
+    timer.add(this);
+}
+
+}} // namespace qpid::sys
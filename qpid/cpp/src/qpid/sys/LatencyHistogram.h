@@ -0,0 +1,100 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_SYS_LATENCYHISTOGRAM_H
+#define QPID_SYS_LATENCYHISTOGRAM_H
+
+#include "qpid/sys/AtomicValue.h"
+#include "qpid/sys/Time.h"
+#include "qpid/sys/Timer.h"
+#include "qpid/types/Variant.h"
+#include "qpid/CommonImportExport.h"
+#include <boost/function.hpp>
+
+namespace qpid {
+namespace sys {
+
+/**
+ * Counts of durations in log-linear buckets of microseconds: each power
+ * of two is split into SUB_BUCKETS equal parts, so a bucket is never
+ * wider than a quarter of its lower bound.  Durations under SUB_BUCKETS
+ * microseconds have a bucket each; those past the last bucket are
+ * counted in it.
+ *
+ * record() takes no lock, and may be called by any number of threads.
+ */
+class LatencyHistogram
+{
+  public:
+    static const uint32_t SUB_BUCKETS = 4;
+    static const uint32_t BUCKETS = 128;      // Up to about two hours
+
+    QPID_COMMON_EXTERN LatencyHistogram();
+
+    QPID_COMMON_EXTERN void record(Duration latency);
+
+    /**
+     * The counts of the buckets that have any, keyed by the bucket's
+     * upper bound in microseconds, as a QMF statistic can carry them.
+     */
+    QPID_COMMON_EXTERN void snapshot(types::Variant::Map& counts) const;
+
+    /** The number of durations recorded */
+    QPID_COMMON_EXTERN uint64_t total() const;
+
+    /**
+     * An upper bound in microseconds on the given fraction of the
+     * durations recorded, e.g. 0.99 for the 99th percentile: that of
+     * the bucket the fraction is reached in. 0 if none are recorded.
+     */
+    QPID_COMMON_EXTERN uint64_t percentile(double fraction) const;
+
+    QPID_COMMON_EXTERN static uint32_t bucket(uint64_t micros);
+    /** The largest number of microseconds counted in bucket @a b */
+    QPID_COMMON_EXTERN static uint64_t upperBound(uint32_t b);
+
+  private:
+    AtomicValue<uint64_t> counts[BUCKETS];
+};
+
+/**
+ * Hands a snapshot of a histogram's counts to a callback each period in
+ * which more have been recorded, e.g. to set a management statistic.
+ * Cancel it before the histogram or the callback's target is destroyed.
+ */
+class LatencyHistogramExport : public TimerTask
+{
+  public:
+    typedef boost::function<void (const types::Variant::Map&)> Callback;
+
+    QPID_COMMON_EXTERN LatencyHistogramExport(const LatencyHistogram& histogram, Callback callback,
+                                              Timer& timer, Duration period = TIME_SEC);
+    QPID_COMMON_EXTERN void fire();
+
+  private:
+    const LatencyHistogram& histogram;
+    Callback callback;
+    Timer& timer;
+    uint64_t exported;
+};
+
+}} // namespace qpid::sys
+
+#endif  /*!QPID_SYS_LATENCYHISTOGRAM_H*/
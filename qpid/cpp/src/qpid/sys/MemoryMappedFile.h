@@ -0,0 +1,57 @@
+#ifndef QPID_SYS_MEMORYMAPPEDFILE_H
+#define QPID_SYS_MEMORYMAPPEDFILE_H
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/CommonImportExport.h"
+#include <boost/noncopyable.hpp>
+#include <string>
+
+namespace qpid {
+namespace sys {
+
+/**
+ * A temporary file of fixed size created in the given directory and
+ * mapped into memory for reading and writing. The file is removed
+ * when the mapping is released; its contents do not survive a
+ * restart.
+ */
+class MemoryMappedFile : private boost::noncopyable
+{
+  public:
+    QPID_COMMON_EXTERN MemoryMappedFile(const std::string& directory, size_t size);
+    QPID_COMMON_EXTERN ~MemoryMappedFile();
+
+    char* getData() { return data; }
+    size_t getSize() const { return size; }
+
+    /** @return the granularity in which the system maps files */
+    QPID_COMMON_EXTERN static size_t getPageSize();
+
+  private:
+    char* data;
+    size_t size;
+};
+
+}} // namespace qpid::sys
+
+#endif  /*!QPID_SYS_MEMORYMAPPEDFILE_H*/
@@ -0,0 +1,101 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/sys/NumaNodes.h"
+#include "qpid/sys/Thread.h"
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+
+namespace qpid {
+namespace sys {
+
+namespace {
+QPID_TSS uint32_t currentNode = 0;
+
+std::vector<std::vector<int> > readNodes()
+{
+    std::vector<std::vector<int> > nodes;
+#ifdef __linux__
+    // Node numbers are dense on the hosts we care about, stop at the first gap
+    for (uint32_t n = 0; ; ++n) {
+        std::ostringstream path;
+        path << "/sys/devices/system/node/node" << n << "/cpulist";
+        std::ifstream in(path.str().c_str());
+        std::string list;
+        if (!in || !std::getline(in, list)) break;
+        nodes.push_back(NumaNodes::parseCpuList(list));
+    }
+#endif
+    if (nodes.empty()) nodes.push_back(std::vector<int>());
+    return nodes;
+}
+
+const std::vector<std::vector<int> >& nodes()
+{
+    static std::vector<std::vector<int> > n = readNodes();
+    return n;
+}
+}
+
+uint32_t NumaNodes::count()
+{
+    return nodes().size();
+}
+
+const std::vector<int>& NumaNodes::cpus(uint32_t node)
+{
+    return nodes()[node % nodes().size()];
+}
+
+uint32_t NumaNodes::current()
+{
+    return currentNode;
+}
+
+void NumaNodes::setCurrent(uint32_t node)
+{
+    currentNode = node;
+}
+
+std::vector<int> NumaNodes::parseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    const char* p = list.c_str();
+    while (*p) {
+        char* end;
+        long first = ::strtol(p, &end, 10);
+        if (end == p) break;
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = ::strtol(p + 1, &end, 10);
+            if (end == p + 1) break;
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        if (*p != ',') break;
+        ++p;
+    }
+    return cpus;
+}
+
+}} // namespace qpid::sys
@@ -0,0 +1,58 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_SYS_NUMANODES_H
+#define QPID_SYS_NUMANODES_H
+
+#include "qpid/sys/IntegerTypes.h"
+#include "qpid/CommonImportExport.h"
+#include <string>
+#include <vector>
+
+namespace qpid {
+namespace sys {
+
+/**
+ * The NUMA nodes of this host and the node the calling thread was
+ * placed on.
+ *
+ * On Linux the nodes are read once from /sys/devices/system/node.
+ * Elsewhere, or if that can't be read, there is a single node with
+ * no CPUs listed.
+ */
+class NumaNodes
+{
+  public:
+    QPID_COMMON_EXTERN static uint32_t count();
+
+    /** The CPUs of node, empty if not known */
+    QPID_COMMON_EXTERN static const std::vector<int>& cpus(uint32_t node);
+
+    /** The node the calling thread was placed on, 0 if none was set */
+    QPID_COMMON_EXTERN static uint32_t current();
+    QPID_COMMON_EXTERN static void setCurrent(uint32_t node);
+
+    /** Parse a Linux cpulist such as "0-3,8-11" */
+    QPID_COMMON_EXTERN static std::vector<int> parseCpuList(const std::string& list);
+};
+
+}} // namespace qpid::sys
+
+#endif  /*!QPID_SYS_NUMANODES_H*/
@@ -21,6 +21,8 @@
 #ifndef _OutputTask_
 #define _OutputTask_
 
+#include "qpid/sys/IntegerTypes.h"
+
 namespace qpid {
 namespace sys {
 
@@ -32,6 +34,10 @@ namespace sys {
          *@return true if output was generated, false if there is no work to do.
          */
         virtual bool doOutput() = 0;
+        /** Turns, relative to the other tasks of an AggregateOutput, this task gets in each round. */
+        virtual uint32_t getOutputWeight() const { return 1; }
+        /** Low latency tasks are offered output before all others. */
+        virtual bool isLowLatency() const { return false; }
     };
 
 }
@@ -23,6 +23,7 @@
  */
 
 #include "qpid/sys/PollableCondition.h"
+#include "qpid/sys/AtomicValue.h"
 #include "qpid/sys/Monitor.h"
 #include "qpid/sys/Thread.h"
 #include <boost/function.hpp>
@@ -41,6 +42,10 @@ class Poller;
  * Any thread can push to the queue; items pushed trigger an event the Poller
  * recognizes. When a Poller I/O thread dispatches the event, a
  * user-specified callback is invoked with all items on the queue.
+ *
+ * Pushing takes no lock: items are linked onto a lock-free stack that
+ * the dispatching thread takes whole and reverses. Only the push that
+ * finds the stack empty sets the condition.
  */
 template <class T>
 class PollableQueue {
@@ -82,8 +87,8 @@ class PollableQueue {
     /** Are we currently stopped?*/
     bool isStopped() const { ScopedLock l(lock); return stopped; }
 
-    size_t size() { ScopedLock l(lock); return queue.size(); }
-    bool empty() { ScopedLock l(lock); return queue.empty(); }
+    size_t size();
+    bool empty() { ScopedLock l(lock); return pending.empty() && !pushed.get(); }
 
     /**
      * Allow any queued events to be processed; intended for calling
@@ -96,13 +101,21 @@ class PollableQueue {
     typedef sys::Monitor::ScopedLock ScopedLock;
     typedef sys::Monitor::ScopedUnlock ScopedUnlock;
 
+    struct Node {
+        T value;
+        Node* next;
+        Node(const T& t) : value(t), next(0) {}
+    };
+
     void dispatch(PollableCondition& cond);
     void process();
+    Node* take();
 
     mutable sys::Monitor lock;
     Callback callback;
     PollableCondition condition;
-    Batch queue, batch;
+    AtomicValue<Node*> pushed;  // Most recently pushed first
+    Batch pending, batch;       // Items put back by the callback, items being processed
     Thread dispatcher;
     bool stopped;
 };
@@ -119,16 +132,45 @@ template <class T> void PollableQueue<T>::start() {
     ScopedLock l(lock);
     if (!stopped) return;
     stopped = false;
-    if (!queue.empty()) condition.set();
+    if (!pending.empty() || pushed.get()) condition.set();
 }
 
 template <class T> PollableQueue<T>::~PollableQueue() {
+    for (Node* n = take(); n;) {
+        Node* next = n->next;
+        delete n;
+        n = next;
+    }
 }
 
 template <class T> void PollableQueue<T>::push(const T& t) {
+    Node* node = new Node(t);
+    Node* head = pushed.get();
+    while (true) {
+        // Link before publishing, the dispatcher may take the node at once
+        node->next = head;
+        Node* old = pushed.valueCompareAndSwap(head, node);
+        if (old == head) break;
+        head = old;
+    }
+    // Only the empty to non-empty transition needs to wake the
+    // poller; the dispatcher clears the condition if stopped.
+    if (!head) condition.set();
+}
+
+template <class T> typename PollableQueue<T>::Node* PollableQueue<T>::take() {
+    Node* head = pushed.get();
+    Node* old;
+    while ((old = pushed.valueCompareAndSwap(head, 0)) != head) head = old;
+    return head;
+}
+
+template <class T> size_t PollableQueue<T>::size() {
     ScopedLock l(lock);
-    if (queue.empty() && !stopped) condition.set();
-    queue.push_back(t);
+    size_t n = pending.size();
+    // Only the dispatcher unlinks nodes, and it holds the lock
+    for (Node* i = pushed.get(); i; i = i->next) ++n;
+    return n;
 }
 
 template <class T> void PollableQueue<T>::dispatch(PollableCondition& cond) {
@@ -137,22 +179,43 @@ template <class T> void PollableQueue<T>::dispatch(PollableCondition& cond) {
     dispatcher = Thread::current();
     process();
     dispatcher = Thread();
-    if (queue.empty()) cond.clear();
+    if (stopped || (pending.empty() && !pushed.get())) {
+        cond.clear();
+        // A push that found the stack empty before the clear has
+        // already set the condition, so set it again.
+        if (!stopped && pushed.get()) cond.set();
+    }
     if (stopped) lock.notifyAll();
 }
 
 template <class T> void PollableQueue<T>::process() {
     // Called with lock held
-    while (!stopped && !queue.empty()) {
+    while (!stopped) {
         assert(batch.empty());
-        batch.swap(queue);
+        batch.swap(pending);
+        // Append pushed items, oldest first.
+        Node* n = take();
+        Node* reversed = 0;
+        while (n) {
+            Node* next = n->next;
+            n->next = reversed;
+            reversed = n;
+            n = next;
+        }
+        while (reversed) {
+            Node* next = reversed->next;
+            batch.push_back(reversed->value);
+            delete reversed;
+            reversed = next;
+        }
+        if (batch.empty()) break;
         typename Batch::const_iterator putBack;
         {
             ScopedUnlock u(lock);   // Allow concurrent push to queue.
             putBack = callback(batch);
         }
         // put back unprocessed items.
-        queue.insert(queue.begin(), putBack, typename Batch::const_iterator(batch.end()));
+        pending.insert(pending.begin(), putBack, typename Batch::const_iterator(batch.end()));
         batch.clear();
     }
 }
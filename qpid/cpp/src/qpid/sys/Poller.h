@@ -81,6 +81,28 @@ public:
     };
     
     QPID_COMMON_EXTERN Poller();
+    /**
+     * Create a poller using several poll sets. Registered handles are
+     * spread over the sets and each thread running the poller serves
+     * one set. A thread that may have left events in its set wakes an
+     * idle thread of another set to take one.
+     * If pinThreads is set each of these threads is bound to a CPU.
+     * If edgeTriggered is set, handles that allow it (see
+     * PollerHandle::setEdgeTriggered()) stay armed between events
+     * rather than being re-armed after each one, and each thread takes
+     * a batch of events from the kernel at a time, sharing it out with
+     * the other threads waiting on its set.
+     * If busyPoll is non zero each thread keeps checking its poll set
+     * without blocking for that long before it goes to sleep.
+     * If numaNodes is set there is a poll set for each NUMA node (see
+     * NumaNodes) instead of pollSets, and each thread is bound to the
+     * CPUs of its set's node rather than to one CPU.
+     * Platforms without support behave as Poller(). On Windows each
+     * poll set is a completion port, a connection keeps to one port and
+     * only the poll set count applies.
+     */
+    QPID_COMMON_EXTERN Poller(int pollSets, bool pinThreads, bool edgeTriggered = false,
+                              Duration busyPoll = 0, bool numaNodes = false);
     QPID_COMMON_EXTERN ~Poller();
     /** Note: this function is async-signal safe */
     QPID_COMMON_EXTERN void shutdown();
@@ -125,6 +147,15 @@ class PollerHandle {
 public:
     QPID_COMMON_EXTERN PollerHandle(const IOHandle& h);
     QPID_COMMON_EXTERN virtual ~PollerHandle();
+
+    /**
+     * Allow an edge triggered poller to keep this handle armed between
+     * events. The callbacks must then read or write until the handle
+     * would block, or call Poller::monitorHandle() again for a
+     * direction they stop short on so that they are called again.
+     * Must be called before the handle is registered.
+     */
+    QPID_COMMON_EXTERN void setEdgeTriggered();
 };
 
 inline void Poller::Event::process() {
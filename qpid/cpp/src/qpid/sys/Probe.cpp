@@ -0,0 +1,92 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/sys/Probe.h"
+#include "qpid/sys/Time.h"
+#include <algorithm>
+
+namespace qpid {
+namespace sys {
+
+namespace {
+struct Slot {
+    AtomicValue<uint64_t> sequence;     // One more than the hit's, 0 while being written
+    int64_t time;
+    probe::Stage stage;
+    uint64_t id;
+    uint64_t arg;
+};
+
+AtomicValue<uint64_t> next;
+Slot slots[ProbeTrace::SLOTS];
+
+bool earlier(const ProbeTrace::Record& a, const ProbeTrace::Record& b) { return a.sequence < b.sequence; }
+
+const char* names[] = {
+    "frame_decoded",
+    "message_received",
+    "message_routed",
+    "message_enqueued",
+    "message_dispatched",
+    "message_delivered",
+    "store_enqueued",
+    "io_written"
+};
+}
+
+void ProbeTrace::record(probe::Stage stage, uint64_t id, uint64_t arg)
+{
+    uint64_t n = next.fetchAndAdd(1);
+    Slot& s = slots[n & (SLOTS - 1)];
+    s.sequence.valueCompareAndSwap(s.sequence.get(), 0);
+    s.time = Duration(EPOCH, AbsTime::now());
+    s.stage = stage;
+    s.id = id;
+    s.arg = arg;
+    // Fails only if a hit SLOTS later claimed the slot meanwhile, leaving it to that one
+    s.sequence.valueCompareAndSwap(0, n + 1);
+}
+
+void ProbeTrace::snapshot(std::vector<Record>& records)
+{
+    records.clear();
+    records.reserve(std::min(next.get(), uint64_t(SLOTS)));
+    for (uint32_t i = 0; i < SLOTS; ++i) {
+        Slot& s = slots[i];
+        uint64_t before = s.sequence.get();
+        if (!before) continue;
+        Record r;
+        r.sequence = before - 1;
+        r.time = s.time;
+        r.stage = s.stage;
+        r.id = s.id;
+        r.arg = s.arg;
+        if (s.sequence.get() == before) records.push_back(r);
+    }
+    std::sort(records.begin(), records.end(), earlier);
+}
+
+const char* ProbeTrace::name(probe::Stage stage)
+{
+    return names[stage];
+}
+
+}} // namespace qpid::sys
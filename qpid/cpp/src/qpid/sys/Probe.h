@@ -0,0 +1,108 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_SYS_PROBE_H
+#define QPID_SYS_PROBE_H
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "qpid/sys/AtomicValue.h"
+#include "qpid/sys/IntegerTypes.h"
+#include "qpid/CommonImportExport.h"
+#include <vector>
+
+namespace qpid {
+namespace sys {
+
+/**
+ * Stages of the message path that carry a probe, in the order a
+ * message passes them. The names are those of the USDT probes.
+ */
+namespace probe {
+enum Stage {
+    frame_decoded,      // FrameDecoder produced a frame
+    message_received,   // MessageBuilder completed a message
+    message_routed,     // An exchange began routing a message
+    message_enqueued,   // Queue::push
+    message_dispatched, // Queue::dispatch handed a message to a consumer
+    message_delivered,  // A session consumer delivered a message
+    store_enqueued,     // The store completed a durable enqueue
+    io_written          // AsynchIO wrote to a socket
+};
+}
+
+/**
+ * Fixed size ring of the most recent probe hits in this process.
+ *
+ * record() takes no lock: it claims a slot with one atomic increment
+ * and overwrites whatever was there. snapshot() skips slots that are
+ * being written while it reads them.
+ */
+class ProbeTrace
+{
+  public:
+    static const uint32_t SLOTS = 1 << 16;
+
+    struct Record {
+        uint64_t sequence;      // Position in the order of all hits
+        int64_t time;           // Nanoseconds since the epoch
+        probe::Stage stage;
+        uint64_t id;            // Correlates hits for one message or connection
+        uint64_t arg;           // Stage specific, e.g. a byte count
+    };
+
+    QPID_COMMON_EXTERN static void record(probe::Stage stage, uint64_t id, uint64_t arg);
+
+    /** Copy the hits still in the ring, oldest first, into @a records */
+    QPID_COMMON_EXTERN static void snapshot(std::vector<Record>& records);
+
+    QPID_COMMON_EXTERN static const char* name(probe::Stage stage);
+};
+
+}} // namespace qpid::sys
+
+/**
+ * QPID_PROBE(stage, id, arg) marks a point on the message path. It
+ * compiles to nothing unless the build enables probes (ENABLE_PROBES
+ * in cmake, --enable-probes in configure). When enabled, every hit is
+ * added to ProbeTrace and, where <sys/sdt.h> is available, also fires
+ * the static probe qpid:<stage> for perf or SystemTap to attach to.
+ */
+#ifdef QPID_HAS_PROBES
+#  ifdef HAVE_SYS_SDT_H
+#    include <sys/sdt.h>
+#    define QPID_SDT_PROBE(stage, id, arg) DTRACE_PROBE2(qpid, stage, id, arg)
+#  else
+#    define QPID_SDT_PROBE(stage, id, arg)
+#  endif
+#  define QPID_PROBE(stage, id, arg) do {                               \
+        uint64_t qpid_probe_id_ = (uint64_t)(id);                       \
+        uint64_t qpid_probe_arg_ = (uint64_t)(arg);                     \
+        ::qpid::sys::ProbeTrace::record(::qpid::sys::probe::stage,      \
+                                        qpid_probe_id_, qpid_probe_arg_); \
+        QPID_SDT_PROBE(stage, qpid_probe_id_, qpid_probe_arg_);         \
+    } while (0)
+#else
+#  define QPID_PROBE(stage, id, arg) do {} while (0)
+#endif
+
+#endif  /*!QPID_SYS_PROBE_H*/
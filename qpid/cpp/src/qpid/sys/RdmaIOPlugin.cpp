@@ -31,6 +31,7 @@
 #include "qpid/sys/SecuritySettings.h"
 
 #include <boost/bind.hpp>
+#include <map>
 #include <memory>
 
 #include <netdb.h>
@@ -243,19 +244,37 @@ void RdmaIOHandler::initProtocolIn(Rdma::Buffer* buff) {
     }
 }
 
+struct RdmaOptions : public qpid::Options {
+    uint32_t sharedRecvBuffers;
+
+    RdmaOptions() : qpid::Options("RDMA Options"), sharedRecvBuffers(0) {
+        addOptions()
+            ("rdma-shared-recv-buffers", optValue(sharedRecvBuffers, "N"),
+             "Receive messages from all RDMA connections on a device into one pool of N "
+             "registered buffers. 0 gives each connection buffers of its own.");
+    }
+};
+
 class RdmaIOProtocolFactory : public ProtocolFactory {
+    typedef std::map<std::pair< ::ibv_context*, uint32_t>, Rdma::SharedRecvQueue::intrusive_ptr> SharedRecvQueues;
+
     auto_ptr<Rdma::Listener> listener;
     const uint16_t listeningPort;
+    const uint32_t sharedRecvBuffers;
+    sys::Mutex lock;
+    SharedRecvQueues sharedRecvQueues;
 
   public:
-    RdmaIOProtocolFactory(int16_t port, int backlog);
+    RdmaIOProtocolFactory(int16_t port, int backlog, uint32_t sharedRecvBuffers);
     void accept(Poller::shared_ptr, ConnectionCodec::Factory*);
     void connect(Poller::shared_ptr, const string& host, const std::string& port, ConnectionCodec::Factory*, ConnectFailedCallback);
 
     uint16_t getPort() const;
 
   private:
+    Rdma::SharedRecvQueue::intrusive_ptr getSharedRecvQueue(Rdma::Connection::intrusive_ptr, const Rdma::ConnectionParams&);
     bool request(Rdma::Connection::intrusive_ptr, const Rdma::ConnectionParams&, ConnectionCodec::Factory*);
+    bool accepted(Rdma::Connection::intrusive_ptr, const Rdma::ConnectionParams&, ConnectionCodec::Factory*);
     void established(Poller::shared_ptr, Rdma::Connection::intrusive_ptr);
     void connected(Poller::shared_ptr, Rdma::Connection::intrusive_ptr, const Rdma::ConnectionParams&, ConnectionCodec::Factory*);
     void connectionError(Rdma::Connection::intrusive_ptr, Rdma::ErrorType);
@@ -265,6 +284,10 @@ class RdmaIOProtocolFactory : public ProtocolFactory {
 
 // Static instance to initialise plugin
 static class RdmaIOPlugin : public Plugin {
+    RdmaOptions options;
+
+    Options* getOptions() { return &options; }
+
     void earlyInitialize(Target&) {
     }
 
@@ -279,22 +302,58 @@ static class RdmaIOPlugin : public Plugin {
         // Only provide to a Broker
         if (broker) {
             const broker::Broker::Options& opts = broker->getOptions();
-            ProtocolFactory::shared_ptr protocol(new RdmaIOProtocolFactory(opts.port, opts.connectionBacklog));
+            ProtocolFactory::shared_ptr protocol(new RdmaIOProtocolFactory(opts.port, opts.connectionBacklog, options.sharedRecvBuffers));
             QPID_LOG(notice, "Rdma: Listening on RDMA port " << protocol->getPort());
             broker->registerProtocolFactory("rdma", protocol);
         }
     }
 } rdmaPlugin;
 
-RdmaIOProtocolFactory::RdmaIOProtocolFactory(int16_t port, int /*backlog*/) :
-    listeningPort(port)
+RdmaIOProtocolFactory::RdmaIOProtocolFactory(int16_t port, int /*backlog*/, uint32_t srb) :
+    listeningPort(port),
+    sharedRecvBuffers(srb)
 {}
 
+// Incoming connections on the same device from peers sending the same
+// size of message share a receive queue, so its buffers are registered once
+// for all of them rather than once per connection.
+Rdma::SharedRecvQueue::intrusive_ptr RdmaIOProtocolFactory::getSharedRecvQueue(
+    Rdma::Connection::intrusive_ptr ci, const Rdma::ConnectionParams& cp)
+{
+    if (sharedRecvBuffers == 0)
+        return 0;
+    sys::Mutex::ScopedLock l(lock);
+    Rdma::SharedRecvQueue::intrusive_ptr& srq =
+        sharedRecvQueues[std::make_pair(ci->getVerbs(), cp.maxRecvBufferSize)];
+    if (!srq) {
+        srq = Rdma::makeSharedRecvQueue(ci->getVerbs(), sharedRecvBuffers, cp.maxRecvBufferSize);
+        QPID_LOG(info, "Rdma: Shared receive queue of " << srq->bufferCount()
+                 << " buffers for messages of " << cp.maxRecvBufferSize << " bytes");
+    }
+    return srq;
+}
+
 void RdmaIOProtocolFactory::established(Poller::shared_ptr poller, Rdma::Connection::intrusive_ptr ci) {
     RdmaIOHandler* async = ci->getContext<RdmaIOHandler>();
     async->start(poller);
 }
 
+bool RdmaIOProtocolFactory::accepted(Rdma::Connection::intrusive_ptr ci, const Rdma::ConnectionParams& cp,
+        ConnectionCodec::Factory* f) {
+    try {
+        // Create the queue pair on the shared receive queue before
+        // request() asks for it
+        ci->getQueuePair(getSharedRecvQueue(ci, cp));
+    } catch (const Rdma::Exception& e) {
+        QPID_LOG(error, "Rdma: Cannot accept new connection (Rdma exception): " << e.what());
+        return false;
+    } catch (const std::exception& e) {
+        QPID_LOG(error, "Rdma: Cannot accept new connection (unknown exception): " << e.what());
+        return false;
+    }
+    return request(ci, cp, f);
+}
+
 bool RdmaIOProtocolFactory::request(Rdma::Connection::intrusive_ptr ci, const Rdma::ConnectionParams& cp,
         ConnectionCodec::Factory* f) {
     try {
@@ -349,7 +408,7 @@ void RdmaIOProtocolFactory::accept(Poller::shared_ptr poller, ConnectionCodec::F
             boost::bind(&RdmaIOProtocolFactory::established, this, poller, _1),
             boost::bind(&RdmaIOProtocolFactory::connectionError, this, _1, _2),
             boost::bind(&RdmaIOProtocolFactory::disconnected, this, _1),
-            boost::bind(&RdmaIOProtocolFactory::request, this, _1, _2, fact)));
+            boost::bind(&RdmaIOProtocolFactory::accepted, this, _1, _2, fact)));
 
     SocketAddress sa("",boost::lexical_cast<std::string>(listeningPort));
     listener->start(poller, sa);
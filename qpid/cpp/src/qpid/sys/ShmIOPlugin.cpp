@@ -0,0 +1,263 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/sys/ProtocolFactory.h"
+
+#include "qpid/Plugin.h"
+#include "qpid/broker/Broker.h"
+#include "qpid/framing/AMQP_HighestVersion.h"
+#include "qpid/framing/ProtocolInitiation.h"
+#include "qpid/log/Statement.h"
+#include "qpid/sys/shm/ShmIO.h"
+#include "qpid/sys/OutputControl.h"
+#include "qpid/sys/SecuritySettings.h"
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <memory>
+
+namespace qpid {
+namespace sys {
+
+class ShmIOHandler : public OutputControl {
+    std::string identifier;
+    ConnectionCodec::Factory* factory;
+    ConnectionCodec* codec;
+    shm::AsynchIO* aio;
+    bool isClient;
+    bool readError;
+    std::auto_ptr<framing::ProtocolInitiation> initiation;   // Still to be written
+
+  public:
+    ShmIOHandler(ConnectionCodec::Factory* f, bool client);
+    ~ShmIOHandler();
+    void init(shm::AsynchIO* a);
+
+    // Output side
+    void abort();
+    void activateOutput();
+    void giveReadCredit(int32_t credit);
+
+    // Callbacks from shm::AsynchIO
+    size_t readable(shm::AsynchIO&, const char* data, size_t size);
+    size_t idle(shm::AsynchIO&, char* space, size_t size);
+    void closed(shm::AsynchIO&);
+};
+
+ShmIOHandler::ShmIOHandler(ConnectionCodec::Factory* f, bool client) :
+    factory(f),
+    codec(0),
+    aio(0),
+    isClient(client),
+    readError(false)
+{}
+
+ShmIOHandler::~ShmIOHandler() {
+    delete codec;
+}
+
+void ShmIOHandler::init(shm::AsynchIO* a) {
+    aio = a;
+    identifier = aio->getIdentifier();
+    if (isClient) {
+        codec = factory->create(*this, identifier, SecuritySettings());
+        initiation.reset(new framing::ProtocolInitiation(codec->getVersion()));
+    }
+}
+
+void ShmIOHandler::abort() {
+    aio->queueWriteClose();
+}
+
+void ShmIOHandler::activateOutput() {
+    aio->notifyPendingWrite();
+}
+
+// Nothing is buffered on our side, so the ring itself bounds what the
+// client can have outstanding
+void ShmIOHandler::giveReadCredit(int32_t) {
+}
+
+size_t ShmIOHandler::readable(shm::AsynchIO&, const char* data, size_t size) {
+    if (readError) return size;
+    try {
+        if (codec) return codec->decode(data, size);
+
+        framing::Buffer in(const_cast<char*>(data), size);
+        framing::ProtocolInitiation protocolInit;
+        if (!protocolInit.decode(in)) return 0;
+        QPID_LOG(debug, "RECV [" << identifier << "] INIT(" << protocolInit << ")");
+        codec = factory->create(protocolInit.getVersion(), *this, identifier, SecuritySettings());
+        if (!codec) {
+            // Send a version we do understand and close
+            initiation.reset(new framing::ProtocolInitiation(framing::highestProtocolVersion));
+            readError = true;
+            aio->queueWriteClose();
+        }
+        return in.getPosition();
+    } catch (const std::exception& e) {
+        QPID_LOG(error, e.what());
+        readError = true;
+        aio->queueWriteClose();
+        return size;
+    }
+}
+
+size_t ShmIOHandler::idle(shm::AsynchIO&, char* space, size_t size) {
+    if (initiation.get()) {
+        framing::Buffer out(space, size);
+        initiation->encode(out);
+        QPID_LOG(debug, "SENT [" << identifier << "] INIT(" << *initiation << ")");
+        initiation.reset();
+        return out.getPosition();
+    }
+    if (codec == 0 || readError) return 0;
+    try {
+        size_t encoded = codec->canEncode() ? codec->encode(space, size) : 0;
+        if (codec->isClosed()) {
+            readError = true;
+            aio->queueWriteClose();
+        }
+        return encoded;
+    } catch (const std::exception& e) {
+        QPID_LOG(error, e.what());
+        readError = true;
+        aio->queueWriteClose();
+        return 0;
+    }
+}
+
+void ShmIOHandler::closed(shm::AsynchIO&) {
+    QPID_LOG(debug, "DISCONNECTED [" << identifier << "]");
+    if (codec) codec->closed();
+    aio->queueForDeletion();
+    delete this;
+}
+
+struct ShmOptions : public qpid::Options {
+    uint32_t ringSize;
+
+    ShmOptions() : qpid::Options("Shared Memory Options"), ringSize(256) {
+        addOptions()
+            ("shm-ring-size", optValue(ringSize, "KiB"),
+             "Let clients on this host connect through shared memory rings of this size in each "
+             "direction, rounded up to a power of two of at least 128. 0 disables the transport.");
+    }
+};
+
+class ShmIOProtocolFactory : public ProtocolFactory {
+    const uint32_t ringSize;
+    shm::Listener listener;
+
+  public:
+    ShmIOProtocolFactory(uint16_t port, int backlog, uint32_t ringSize);
+    void accept(Poller::shared_ptr, ConnectionCodec::Factory*);
+    void connect(Poller::shared_ptr, const std::string& host, const std::string& port,
+                 ConnectionCodec::Factory*, ConnectFailedCallback);
+
+    uint16_t getPort() const;
+
+  private:
+    void established(Poller::shared_ptr, int fd, ConnectionCodec::Factory*);
+    void start(Poller::shared_ptr, ShmIOHandler*, shm::AsynchIO*);
+};
+
+// Static instance to initialise plugin
+static class ShmIOPlugin : public Plugin {
+    ShmOptions options;
+
+    Options* getOptions() { return &options; }
+
+    void earlyInitialize(Target&) {
+    }
+
+    void initialize(Target& target) {
+        broker::Broker* broker = dynamic_cast<broker::Broker*>(&target);
+        // Only provide to a Broker
+        if (broker && options.ringSize) {
+            const broker::Broker::Options& opts = broker->getOptions();
+            uint32_t ringSize = shm::AsynchIO::MIN_RING_SIZE;
+            while (ringSize < options.ringSize * 1024 && ringSize < (1u << 30)) ringSize <<= 1;
+            try {
+                ProtocolFactory::shared_ptr protocol(
+                    new ShmIOProtocolFactory(opts.port, opts.connectionBacklog, ringSize));
+                QPID_LOG(notice, "Listening for shared memory connections on port " << protocol->getPort());
+                broker->registerProtocolFactory("shm", protocol);
+            } catch (const std::exception& e) {
+                QPID_LOG(warning, "Shared memory transport disabled: " << e.what());
+            }
+        }
+    }
+} shmPlugin;
+
+ShmIOProtocolFactory::ShmIOProtocolFactory(uint16_t port, int backlog, uint32_t size) :
+    ringSize(size),
+    listener(port, backlog)
+{}
+
+uint16_t ShmIOProtocolFactory::getPort() const {
+    return listener.getPort(); // Immutable no need for lock.
+}
+
+void ShmIOProtocolFactory::accept(Poller::shared_ptr poller, ConnectionCodec::Factory* fact) {
+    listener.start(poller, boost::bind(&ShmIOProtocolFactory::established, this, poller, _1, fact));
+}
+
+void ShmIOProtocolFactory::start(Poller::shared_ptr poller, ShmIOHandler* async, shm::AsynchIO* aio) {
+    async->init(aio);
+    aio->start(poller);
+}
+
+void ShmIOProtocolFactory::established(Poller::shared_ptr poller, int fd, ConnectionCodec::Factory* f) {
+    std::auto_ptr<ShmIOHandler> async(new ShmIOHandler(f, false));
+    try {
+        shm::AsynchIO* aio = shm::AsynchIO::create(
+            fd, ringSize,
+            boost::bind(&ShmIOHandler::readable, async.get(), _1, _2, _3),
+            boost::bind(&ShmIOHandler::idle, async.get(), _1, _2, _3),
+            boost::bind(&ShmIOHandler::closed, async.get(), _1));
+        start(poller, async.release(), aio);
+    } catch (const std::exception& e) {
+        QPID_LOG(error, "Cannot accept shared memory connection: " << e.what());
+    }
+}
+
+// Only used for outgoing connections (in federation) to a broker on this host
+void ShmIOProtocolFactory::connect(
+    Poller::shared_ptr poller,
+    const std::string& /*host*/, const std::string& port,
+    ConnectionCodec::Factory* f,
+    ConnectFailedCallback failed)
+{
+    std::auto_ptr<ShmIOHandler> async(new ShmIOHandler(f, true));
+    try {
+        shm::AsynchIO* aio = shm::AsynchIO::connect(
+            boost::lexical_cast<uint16_t>(port),
+            boost::bind(&ShmIOHandler::readable, async.get(), _1, _2, _3),
+            boost::bind(&ShmIOHandler::idle, async.get(), _1, _2, _3),
+            boost::bind(&ShmIOHandler::closed, async.get(), _1));
+        start(poller, async.release(), aio);
+    } catch (const std::exception& e) {
+        failed(-1, e.what());
+    }
+}
+
+}} // namespace qpid::sys
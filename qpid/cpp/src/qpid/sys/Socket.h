@@ -27,6 +27,10 @@
 #include "qpid/CommonImportExport.h"
 #include <string>
 
+#ifndef _WIN32
+struct iovec;
+#endif
+
 namespace qpid {
 namespace sys {
 
@@ -47,6 +51,13 @@ public:
 
     QPID_COMMON_EXTERN void setTcpNoDelay() const;
 
+    /** Ask the kernel to spin on the device queue for up to usecs
+     * when this socket is read or polled with no data waiting.
+     *@return false if the platform or the caller's privileges do
+     * not allow it.
+     */
+    QPID_COMMON_EXTERN bool setBusyPoll(int usecs) const;
+
     QPID_COMMON_EXTERN void connect(const std::string& host, const std::string& port) const;
     QPID_COMMON_EXTERN void connect(const SocketAddress&) const;
 
@@ -55,10 +66,13 @@ public:
     /** Bind to a port and start listening.
      *@param port 0 means choose an available port.
      *@param backlog maximum number of pending connections.
+     *@param sharePort let other sockets listen on the same address, the
+     * system spreading new connections between them (SO_REUSEPORT). Throws
+     * if the platform can't.
      *@return The bound port.
      */
     QPID_COMMON_EXTERN int listen(const std::string& host = "", const std::string& port = "0", int backlog = 10) const;
-    QPID_COMMON_EXTERN int listen(const SocketAddress&, int backlog = 10) const;
+    QPID_COMMON_EXTERN int listen(const SocketAddress&, int backlog = 10, bool sharePort = false) const;
 
     /**
      * Returns an address (host and port) for the remote end of the
@@ -82,6 +96,12 @@ public:
      */
     QPID_COMMON_EXTERN int getError() const;
 
+    /** The login name of the user running the process at the other
+     * end of a Unix domain socket.
+     *@return false for other sockets, or if the platform cannot tell.
+     */
+    QPID_COMMON_EXTERN bool getPeerUser(std::string& user) const;
+
     /** Accept a connection from a socket that is already listening
      * and has an incoming connection
      */
@@ -90,6 +110,10 @@ public:
     // TODO The following are raw operations, maybe they need better wrapping?
     QPID_COMMON_EXTERN int read(void *buf, size_t count) const;
     QPID_COMMON_EXTERN int write(const void *buf, size_t count) const;
+#ifndef _WIN32
+    /** Gather write of iovcnt buffers in a single call (posix only) */
+    QPID_COMMON_EXTERN int writev(const struct ::iovec* iov, int iovcnt) const;
+#endif
 
 private:
     /** Create socket */
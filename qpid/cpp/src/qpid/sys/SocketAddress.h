@@ -48,6 +48,12 @@ public:
 
     QPID_COMMON_EXTERN static std::string asString(::sockaddr const * const addr, size_t addrlen);
     QPID_COMMON_EXTERN static uint16_t getPort(::sockaddr const * const addr);
+
+    /** The name of the Unix domain socket that a broker listening on
+     * @a port of this host also listens on. SocketAddresses made with
+     * such a name as host and an empty port refer to that socket.
+     */
+    QPID_COMMON_EXTERN static std::string localName(const std::string& port);
     
 
 private:
@@ -27,11 +27,20 @@
 #include "qpid/sys/ssl/SslHandler.h"
 #include "qpid/sys/ssl/SslIo.h"
 #include "qpid/sys/ssl/SslSocket.h"
+#include "qpid/sys/AtomicValue.h"
+#include "qpid/sys/Monitor.h"
+#include "qpid/sys/Runnable.h"
+#include "qpid/sys/Thread.h"
+#include "qpid/sys/Time.h"
 #include "qpid/broker/Broker.h"
 #include "qpid/log/Statement.h"
 
 #include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <algorithm>
+#include <deque>
 #include <memory>
+#include <vector>
 
 
 namespace qpid {
@@ -42,17 +51,78 @@ struct SslServerOptions : ssl::SslOptions
     uint16_t port;
     bool clientAuth;
     bool nodict;
+    uint32_t handshakeThreads;
+    uint32_t handshakeLimit;
+    uint32_t handshakeTimeout;
 
     SslServerOptions() : port(5671),
                          clientAuth(false),
-                         nodict(false)
+                         nodict(false),
+                         handshakeThreads(0),
+                         handshakeLimit(1000),
+                         handshakeTimeout(10)
     {
         addOptions()
             ("ssl-port", optValue(port, "PORT"), "Port on which to listen for SSL connections")
             ("ssl-require-client-authentication", optValue(clientAuth), 
              "Forces clients to authenticate in order to establish an SSL connection")
             ("ssl-sasl-no-dict", optValue(nodict), 
-             "Disables SASL mechanisms that are vulnerable to passive dictionary-based password attacks");
+             "Disables SASL mechanisms that are vulnerable to passive dictionary-based password attacks")
+            ("ssl-handshake-threads", optValue(handshakeThreads, "N"),
+             "Number of threads performing the SSL handshake for accepted connections. "
+             "0 leaves the handshake to the worker threads that serve established connections")
+            ("ssl-handshake-limit", optValue(handshakeLimit, "N"),
+             "With ssl-handshake-threads, stop accepting SSL connections while N handshakes are waiting or in progress")
+            ("ssl-handshake-timeout", optValue(handshakeTimeout, "SECONDS"),
+             "With ssl-handshake-threads, close an accepted SSL connection whose handshake takes longer than this");
+    }
+};
+
+/**
+ * Fixed set of threads running queued tasks, used for SSL handshakes
+ * so that their cost is kept off the poller's worker threads.
+ */
+class HandshakePool : public Runnable {
+  public:
+    typedef boost::function0<void> Task;
+
+    HandshakePool(uint32_t count) : stopping(false) {
+        for (uint32_t i = 0; i < count; ++i)
+            threads.push_back(Thread(*this));
+    }
+
+    ~HandshakePool() {
+        {
+            Monitor::ScopedLock l(lock);
+            stopping = true;
+            lock.notifyAll();
+        }
+        for (std::vector<Thread>::iterator i = threads.begin(); i != threads.end(); ++i)
+            i->join();
+    }
+
+    void submit(const Task& t) {
+        Monitor::ScopedLock l(lock);
+        tasks.push_back(t);
+        lock.notify();
+    }
+
+  private:
+    Monitor lock;
+    std::deque<Task> tasks;
+    std::vector<Thread> threads;
+    bool stopping;
+
+    void run() {
+        Monitor::ScopedLock l(lock);
+        while (true) {
+            while (tasks.empty() && !stopping) lock.wait();
+            if (stopping) return;
+            Task t = tasks.front();
+            tasks.pop_front();
+            Monitor::ScopedUnlock u(lock);
+            t();
+        }
     }
 };
 
@@ -62,6 +132,10 @@ class SslProtocolFactory : public ProtocolFactory {
     const uint16_t listeningPort;
     std::auto_ptr<qpid::sys::ssl::SslAcceptor> acceptor;
     bool nodict;
+    const uint32_t handshakeLimit;
+    const Duration handshakeTimeout;
+    AtomicValue<uint32_t> handshakesPending;
+    std::auto_ptr<HandshakePool> handshakes; // Destroyed before the acceptor
 
   public:
     SslProtocolFactory(const SslServerOptions&, int backlog, bool nodelay);
@@ -76,6 +150,8 @@ class SslProtocolFactory : public ProtocolFactory {
   private:
     void established(Poller::shared_ptr, const qpid::sys::ssl::SslSocket&, ConnectionCodec::Factory*,
                      bool isClient);
+    void accepted(Poller::shared_ptr, const qpid::sys::ssl::SslSocket&, ConnectionCodec::Factory*);
+    void handshake(Poller::shared_ptr, const qpid::sys::ssl::SslSocket&, ConnectionCodec::Factory*);
 };
 
 // Static instance to initialise plugin
@@ -115,9 +191,39 @@ static struct SslPlugin : public Plugin {
 
 SslProtocolFactory::SslProtocolFactory(const SslServerOptions& options, int backlog, bool nodelay) :
     tcpNoDelay(nodelay), listeningPort(listener.listen(options.port, backlog, options.certName, options.clientAuth)),
-    nodict(options.nodict)
+    nodict(options.nodict),
+    handshakeLimit(std::max(options.handshakeLimit, 1u)),
+    handshakeTimeout(options.handshakeTimeout*TIME_SEC),
+    handshakes(options.handshakeThreads ? new HandshakePool(options.handshakeThreads) : 0)
 {}
 
+void SslProtocolFactory::accepted(Poller::shared_ptr poller, const qpid::sys::ssl::SslSocket& s,
+                                  ConnectionCodec::Factory* f) {
+    if (!handshakes.get()) {
+        established(poller, s, f, false);
+        return;
+    }
+    // Limit the accept rate to what the handshake threads keep up with;
+    // the listen backlog holds the rest.
+    if (handshakesPending.fetchAndAdd(1) + 1 >= handshakeLimit)
+        acceptor->pause();
+    handshakes->submit(boost::bind(&SslProtocolFactory::handshake, this, poller, boost::cref(s), f));
+}
+
+void SslProtocolFactory::handshake(Poller::shared_ptr poller, const qpid::sys::ssl::SslSocket& s,
+                                   ConnectionCodec::Factory* f) {
+    try {
+        s.handshake(handshakeTimeout);
+        established(poller, s, f, false);
+    } catch (const std::exception& e) {
+        QPID_LOG(warning, "SSL handshake failed: " << e.what());
+        s.close();
+        delete &s;
+    }
+    if (handshakesPending.fetchAndSub(1) >= handshakeLimit)
+        acceptor->resume();
+}
+
 void SslProtocolFactory::established(Poller::shared_ptr poller, const qpid::sys::ssl::SslSocket& s,
                                           ConnectionCodec::Factory* f, bool isClient) {
     qpid::sys::ssl::SslHandler* async = new qpid::sys::ssl::SslHandler(s.getFullAddress(), f, nodict);
@@ -149,7 +255,7 @@ void SslProtocolFactory::accept(Poller::shared_ptr poller,
                                      ConnectionCodec::Factory* fact) {
     acceptor.reset(
         new qpid::sys::ssl::SslAcceptor(listener,
-                           boost::bind(&SslProtocolFactory::established, this, poller, _1, fact, false)));
+                           boost::bind(&SslProtocolFactory::accepted, this, poller, _1, fact)));
     acceptor->start(poller);
 }
 
@@ -0,0 +1,51 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_SYS_STRIPEDLOCKS_H
+#define QPID_SYS_STRIPEDLOCKS_H
+
+#include <boost/noncopyable.hpp>
+#include <stddef.h>
+
+namespace qpid {
+namespace sys {
+
+/**
+ * A fixed set of locks shared out between many small objects by their
+ * address, for objects too numerous to carry a lock each. Two objects
+ * may get the same lock, so it must only guard short sections that
+ * take no other lock and call out to nothing that might.
+ */
+template <class Lock, size_t STRIPES = 256>
+class StripedLocks : private boost::noncopyable
+{
+  public:
+    Lock& get(const void* object) {
+        // Objects using stripes are at least this far apart
+        return locks[(reinterpret_cast<size_t>(object) >> 6) % STRIPES];
+    }
+
+  private:
+    Lock locks[STRIPES];
+};
+
+}} // namespace qpid::sys
+
+#endif  /*!QPID_SYS_STRIPEDLOCKS_H*/
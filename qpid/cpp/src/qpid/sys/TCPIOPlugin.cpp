@@ -27,11 +27,13 @@
 #include "qpid/sys/Socket.h"
 #include "qpid/sys/SocketAddress.h"
 #include "qpid/sys/Poller.h"
+#include "qpid/sys/SecuritySettings.h"
 #include "qpid/broker/Broker.h"
 #include "qpid/log/Statement.h"
 
 #include <boost/bind.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
+#include <memory>
 
 namespace qpid {
 namespace sys {
@@ -39,11 +41,16 @@ namespace sys {
 class AsynchIOProtocolFactory : public ProtocolFactory {
     const bool tcpNoDelay;
     boost::ptr_vector<Socket> listeners;
+    boost::ptr_vector<Socket> busyListeners;
     boost::ptr_vector<AsynchAcceptor> acceptors;
     uint16_t listeningPort;
+    Poller::shared_ptr busyPoller;
+    int busyPollUsecs;
 
   public:
-    AsynchIOProtocolFactory(const std::string& host, const std::string& port, int backlog, bool nodelay);
+    AsynchIOProtocolFactory(const std::string& host, const std::string& port, int backlog, uint32_t count,
+                            bool nodelay);
+    uint16_t listenBusyPoll(const std::string& port, int backlog, Poller::shared_ptr, int usecs);
     void accept(Poller::shared_ptr, ConnectionCodec::Factory*);
     void connect(Poller::shared_ptr, const std::string& host, const std::string& port,
                  ConnectionCodec::Factory*,
@@ -52,11 +59,36 @@ class AsynchIOProtocolFactory : public ProtocolFactory {
     uint16_t getPort() const;
 
   private:
+    static uint16_t listen(const std::string& host, const std::string& port, int backlog, uint32_t count,
+                           boost::ptr_vector<Socket>&);
+    static void listenShared(SocketAddress& sa, int backlog, uint32_t count, boost::ptr_vector<Socket>&);
     void established(Poller::shared_ptr, const Socket&, ConnectionCodec::Factory*,
-                     bool isClient);
+                     bool isClient, bool busyPoll);
     void connectFailed(const Socket&, int, const std::string&, ConnectFailedCallback);
 };
 
+// Listens on the Unix domain socket named for the port. Peers are
+// identified by the user their process runs as, which they can then
+// authenticate as with the EXTERNAL mechanism.
+class LocalIOProtocolFactory : public AsynchIOProtocolFactory {
+    const uint16_t port;
+
+  public:
+    LocalIOProtocolFactory(uint16_t p, int backlog) :
+        AsynchIOProtocolFactory(SocketAddress::localName(boost::lexical_cast<std::string>(p)), "",
+                                backlog, 1, false),
+        port(p)
+    {}
+
+    uint16_t getPort() const { return port; }
+
+    void connect(Poller::shared_ptr poller, const std::string&, const std::string& p,
+                 ConnectionCodec::Factory* fact, ConnectFailedCallback failed)
+    {
+        AsynchIOProtocolFactory::connect(poller, SocketAddress::localName(p), "", fact, failed);
+    }
+};
+
 // Static instance to initialise plugin
 static class TCPIOPlugin : public Plugin {
     void earlyInitialize(Target&) {
@@ -71,26 +103,54 @@ static class TCPIOPlugin : public Plugin {
                 new AsynchIOProtocolFactory(
                     "", boost::lexical_cast<std::string>(opts.port),
                     opts.connectionBacklog,
+                    opts.tcpListeners,
                     opts.tcpNoDelay));
             QPID_LOG(notice, "Listening on TCP/TCP6 port " << protocolt->getPort());
+            if (opts.busyPollThreads > 0) {
+                uint16_t busyPort =
+                    static_cast<AsynchIOProtocolFactory&>(*protocolt).listenBusyPoll(
+                        boost::lexical_cast<std::string>(opts.busyPollPort),
+                        opts.connectionBacklog,
+                        broker->getBusyPoller(),
+                        opts.busyPollUsecs);
+                QPID_LOG(notice, "Listening on TCP/TCP6 port " << busyPort << " with "
+                         << opts.busyPollThreads << " busy polling threads");
+            }
             broker->registerProtocolFactory("tcp", protocolt);
+            if (opts.unixSocket) {
+                ProtocolFactory::shared_ptr protocolu(
+                    new LocalIOProtocolFactory(protocolt->getPort(), opts.connectionBacklog));
+                QPID_LOG(notice, "Listening on Unix domain socket "
+                         << SocketAddress::localName(boost::lexical_cast<std::string>(protocolu->getPort())));
+                broker->registerProtocolFactory("unix", protocolu);
+            }
         }
     }
 } tcpPlugin;
 
-AsynchIOProtocolFactory::AsynchIOProtocolFactory(const std::string& host, const std::string& port, int backlog, bool nodelay) :
-    tcpNoDelay(nodelay)
+AsynchIOProtocolFactory::AsynchIOProtocolFactory(const std::string& host, const std::string& port, int backlog,
+                                                 uint32_t count, bool nodelay) :
+    tcpNoDelay(nodelay),
+    busyPollUsecs(0)
+{
+    listeningPort = listen(host, port, backlog, count, listeners);
+}
+
+uint16_t AsynchIOProtocolFactory::listen(const std::string& host, const std::string& port, int backlog,
+                                         uint32_t count, boost::ptr_vector<Socket>& listeners)
 {
     SocketAddress sa(host, port);
 
     // We must have at least one resolved address
     QPID_LOG(info, "Listening to: " << sa.asString())
     Socket* s = new Socket;
-    uint16_t lport = s->listen(sa, backlog);
+    uint16_t lport = s->listen(sa, backlog, count > 1);
     QPID_LOG(debug, "Listened to: " << lport);
     listeners.push_back(s);
 
-    listeningPort = lport;
+    uint16_t listeningPort = lport;
+    sa.setAddrInfoPort(listeningPort);
+    listenShared(sa, backlog, count, listeners);
 
     // Try any other resolved addresses
     while (sa.nextAddress()) {
@@ -98,21 +158,59 @@ AsynchIOProtocolFactory::AsynchIOProtocolFactory(const std::string& host, const
         sa.setAddrInfoPort(listeningPort);
         QPID_LOG(info, "Listening to: " << sa.asString())
         Socket* s = new Socket;
-        uint16_t lport = s->listen(sa, backlog);
+        uint16_t lport = s->listen(sa, backlog, count > 1);
         QPID_LOG(debug, "Listened to: " << lport);
         listeners.push_back(s);
+        listenShared(sa, backlog, count, listeners);
+    }
+    return listeningPort;
+}
+
+// Add sockets sharing the address of the one just listened to, up to
+// count in all, so that several threads can accept from it at once
+void AsynchIOProtocolFactory::listenShared(SocketAddress& sa, int backlog, uint32_t count,
+                                           boost::ptr_vector<Socket>& listeners)
+{
+    for (uint32_t i = 1; i < count; ++i) {
+        std::auto_ptr<Socket> s(new Socket);
+        try {
+            s->listen(sa, backlog, true);
+        } catch (const std::exception& e) {
+            QPID_LOG(warning, "Listening to " << sa.asString() << " with " << i << " sockets: " << e.what());
+            return;
+        }
+        listeners.push_back(s.release());
     }
+}
 
+// Connections accepted on this port are served by busyPoller alone
+uint16_t AsynchIOProtocolFactory::listenBusyPoll(const std::string& port, int backlog,
+                                                 Poller::shared_ptr poller, int usecs)
+{
+    busyPoller = poller;
+    busyPollUsecs = usecs;
+    return listen("", port, backlog, 1, busyListeners);
 }
 
 void AsynchIOProtocolFactory::established(Poller::shared_ptr poller, const Socket& s,
-                                          ConnectionCodec::Factory* f, bool isClient) {
+                                          ConnectionCodec::Factory* f, bool isClient, bool busyPoll) {
     AsynchIOHandler* async = new AsynchIOHandler(s.getFullAddress(), f);
 
     if (tcpNoDelay) {
         s.setTcpNoDelay();
         QPID_LOG(info, "Set TCP_NODELAY on connection to " << s.getPeerAddress());
     }
+    if (busyPoll && !s.setBusyPoll(busyPollUsecs)) {
+        QPID_LOG(debug, "Could not set SO_BUSY_POLL on connection to " << s.getPeerAddress());
+    }
+
+    std::string user;
+    if (s.getPeerUser(user)) {
+        SecuritySettings settings;
+        settings.authid = user;
+        async->setSecuritySettings(settings);
+        QPID_LOG(debug, "Connection " << s.getFullAddress() << " is from local user " << user);
+    }
 
     if (isClient)
         async->setClient();
@@ -138,8 +236,14 @@ void AsynchIOProtocolFactory::accept(Poller::shared_ptr poller,
     for (unsigned i = 0; i<listeners.size(); ++i) {
         acceptors.push_back(
             AsynchAcceptor::create(listeners[i],
-                            boost::bind(&AsynchIOProtocolFactory::established, this, poller, _1, fact, false)));
-        acceptors[i].start(poller);
+                            boost::bind(&AsynchIOProtocolFactory::established, this, poller, _1, fact, false, false)));
+        acceptors.back().start(poller);
+    }
+    for (unsigned i = 0; i<busyListeners.size(); ++i) {
+        acceptors.push_back(
+            AsynchAcceptor::create(busyListeners[i],
+                            boost::bind(&AsynchIOProtocolFactory::established, this, busyPoller, _1, fact, false, true)));
+        acceptors.back().start(busyPoller);
     }
 }
 
@@ -170,7 +274,7 @@ void AsynchIOProtocolFactory::connect(
         host,
         port,
         boost::bind(&AsynchIOProtocolFactory::established,
-                    this, poller, _1, fact, true),
+                    this, poller, _1, fact, true, false),
         boost::bind(&AsynchIOProtocolFactory::connectFailed,
                     this, _1, _2, _3, failed));
     c->start(poller);
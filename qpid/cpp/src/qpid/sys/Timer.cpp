@@ -23,6 +23,7 @@
 #include "qpid/log/Statement.h"
 
 #include <numeric>
+#include <vector>
 
 using boost::intrusive_ptr;
 using std::max;
@@ -81,7 +82,127 @@ void TimerTask::setFired() {
 }
 
 
-Timer::Timer() :
+/**
+ * Two level timing wheel. The inner level has a slot per tick and the
+ * outer level a slot per revolution of the inner one; outer slots are
+ * cascaded into the inner level as it wraps. Tasks further out than the
+ * outer level are kept in an overflow list that is re-hashed each time
+ * the outer level wraps.
+ */
+class Timer::Wheel {
+    static const int64_t InnerSlots = 256;
+    static const int64_t OuterSlots = 64;
+
+    struct Entry {
+        int64_t tick;
+        intrusive_ptr<TimerTask> task;
+    };
+    typedef std::vector<Entry> Slot;
+
+    const AbsTime origin;
+    const Duration tick;
+    int64_t current;            // Last tick expired
+    size_t count;
+    size_t innerCount;
+    std::vector<Slot> inner;
+    std::vector<Slot> outer;
+    Slot overflow;
+    Slot due;
+    AbsTime sleepUntil;
+
+    // Ticks are rounded up so a task never comes off the wheel early
+    int64_t tickAfter(AbsTime t) const {
+        int64_t d = Duration(origin, t);
+        return d <= 0 ? 0 : (d + tick - 1) / tick;
+    }
+
+    AbsTime timeOf(int64_t t) const {
+        return AbsTime(origin, Duration(t * int64_t(tick)));
+    }
+
+    void place(const Entry& e) {
+        if (e.tick <= current) {
+            due.push_back(e);
+        } else if (e.tick - current < InnerSlots) {
+            inner[e.tick % InnerSlots].push_back(e);
+            ++innerCount;
+        } else if (e.tick / InnerSlots - current / InnerSlots < OuterSlots) {
+            outer[(e.tick / InnerSlots) % OuterSlots].push_back(e);
+        } else {
+            overflow.push_back(e);
+        }
+    }
+
+    void cascade(Slot& slot) {
+        Slot moved;
+        moved.swap(slot);
+        for (Slot::const_iterator i = moved.begin(); i != moved.end(); ++i)
+            place(*i);
+    }
+
+  public:
+    Wheel(Duration t) :
+        origin(AbsTime::now()), tick(t), current(0), count(0), innerCount(0),
+        inner(InnerSlots), outer(OuterSlots), sleepUntil(AbsTime::FarFuture())
+    {}
+
+    bool empty() const { return count == 0; }
+
+    /** @return true if the task is due before the timer thread would wake */
+    bool add(const intrusive_ptr<TimerTask>& task, AbsTime when) {
+        Entry e = { tickAfter(when), task };
+        place(e);
+        ++count;
+        return when < sleepUntil;
+    }
+
+    /** Take every task whose tick has passed by now. */
+    void expire(AbsTime now, std::vector<intrusive_ptr<TimerTask> >& fired) {
+        int64_t target = std::max(current, int64_t(Duration(origin, now)) / tick);
+        while (current < target) {
+            if (innerCount == 0) {
+                // Nothing can come due before the next cascade
+                int64_t boundary = (current / InnerSlots + 1) * InnerSlots;
+                current = std::min(target, boundary - 1);
+                if (current == target) break;
+            }
+            ++current;
+            if (current % InnerSlots == 0) {
+                if ((current / InnerSlots) % OuterSlots == 0)
+                    cascade(overflow);
+                cascade(outer[(current / InnerSlots) % OuterSlots]);
+            }
+            Slot& slot = inner[current % InnerSlots];
+            innerCount -= slot.size();
+            due.insert(due.end(), slot.begin(), slot.end());
+            slot.clear();
+        }
+        for (Slot::const_iterator i = due.begin(); i != due.end(); ++i)
+            fired.push_back(i->task);
+        count -= due.size();
+        due.clear();
+    }
+
+    /** @return when the timer thread next has work, noting it for add() */
+    AbsTime sleep() {
+        int64_t next;
+        if (!due.empty()) {
+            next = current;
+        } else if (innerCount) {
+            next = current + 1;
+            while (inner[next % InnerSlots].empty()) ++next;
+        } else {
+            next = (current / InnerSlots + 1) * InnerSlots;
+        }
+        sleepUntil = timeOf(next);
+        return sleepUntil;
+    }
+
+    void wake() { sleepUntil = AbsTime::FarFuture(); }
+};
+
+Timer::Timer(Mode mode, Duration tick) :
+    wheel(mode == WHEEL ? new Wheel(tick) : 0),
     active(false),
     late(50 * TIME_MSEC),
     overran(2 * TIME_MSEC),
@@ -99,6 +220,10 @@ Timer::~Timer()
 // TODO AStitcher 21/08/09 The threshholds for emitting warnings are a little arbitrary
 void Timer::run()
 {
+    if (wheel.get()) {
+        runWheel();
+        return;
+    }
     Monitor::ScopedLock l(monitor);
     while (active) {
         if (tasks.empty()) {
@@ -161,10 +286,66 @@ void Timer::run()
     }
 }
 
+// Everything due in a tick is fired as one batch without retaking the monitor.
+// Overrun warnings are not given as tasks are not ordered within a tick.
+void Timer::runWheel()
+{
+    Monitor::ScopedLock l(monitor);
+    std::vector<intrusive_ptr<TimerTask> > batch;
+    std::vector<intrusive_ptr<TimerTask> > restarted;
+    while (active) {
+        AbsTime start(AbsTime::now());
+        wheel->expire(start, batch);
+        if (!batch.empty()) {
+            Monitor::ScopedUnlock u(monitor);
+            bool warningsEnabled;
+            QPID_LOG_TEST(warning, warningsEnabled);
+            for (std::vector<intrusive_ptr<TimerTask> >::iterator i = batch.begin();
+                 i != batch.end(); ++i) {
+                intrusive_ptr<TimerTask>& t = *i;
+                Duration delay(t->sortTime, start);
+                ScopedLock<Mutex> l(t->callbackLock);
+                if (t->cancelled) {
+                    drop(t);
+                    if (delay > lateCancel) {
+                        QPID_LOG(debug, t->name << " cancelled timer woken up " <<
+                                 delay / TIME_MSEC << "ms late");
+                    }
+                } else if (Duration(t->nextFireTime, AbsTime::now()) >= 0) {
+                    fire(t);
+                    if (warningsEnabled && delay > late)
+                        warn.late(t->name, delay);
+                } else {
+                    restarted.push_back(t);
+                }
+            }
+            batch.clear();
+        }
+        for (std::vector<intrusive_ptr<TimerTask> >::iterator i = restarted.begin();
+             i != restarted.end(); ++i) {
+            (*i)->sortTime = (*i)->nextFireTime;
+            wheel->add(*i, (*i)->sortTime);
+        }
+        restarted.clear();
+        if (!active) break;
+        if (wheel->empty()) {
+            wheel->wake();
+            monitor.wait();
+        } else {
+            monitor.wait(wheel->sleep());
+        }
+        wheel->wake();
+    }
+}
+
 void Timer::add(intrusive_ptr<TimerTask> task)
 {
     Monitor::ScopedLock l(monitor);
     task->sortTime = task->nextFireTime;
+    if (wheel.get()) {
+        if (wheel->add(task, task->sortTime)) monitor.notify();
+        return;
+    }
     tasks.push(task);
     monitor.notify();
 }
@@ -78,16 +78,30 @@ bool operator<(const boost::intrusive_ptr<TimerTask>& a,
                const boost::intrusive_ptr<TimerTask>& b);
 
 class Timer : private Runnable {
+  public:
+    /**
+     * HEAP keeps tasks in a priority queue and fires each one at its
+     * exact time. WHEEL hashes tasks into slots of a fixed tick, so
+     * adding a task is constant time and all tasks due in a tick are
+     * fired together, at the cost of firing up to one tick late.
+     */
+    enum Mode { HEAP, WHEEL };
+
+  private:
+    class Wheel;
+
     qpid::sys::Monitor monitor;
     std::priority_queue<boost::intrusive_ptr<TimerTask> > tasks;
+    std::auto_ptr<Wheel> wheel;
     qpid::sys::Thread runner;
     bool active;
 
     // Runnable interface
     void run();
+    void runWheel();
 
   public:
-    QPID_COMMON_EXTERN Timer();
+    QPID_COMMON_EXTERN Timer(Mode mode=HEAP, Duration tick=10*TIME_MSEC);
     QPID_COMMON_EXTERN virtual ~Timer();
 
     QPID_COMMON_EXTERN virtual void add(boost::intrusive_ptr<TimerTask> task);
@@ -23,6 +23,7 @@
  */
 
 #include "qpid/sys/Time.h"
+#include "qpid/CommonImportExport.h"
 #include <map>
 #include <string>
 
@@ -42,14 +43,14 @@ namespace sys {
 class TimerWarnings
 {
   public:
-    TimerWarnings(Duration reportInterval);
+    QPID_COMMON_EXTERN TimerWarnings(Duration reportInterval);
 
-    void late(const std::string& task, Duration delay);
+    QPID_COMMON_EXTERN void late(const std::string& task, Duration delay);
 
-    void overran(const std::string& task, Duration overrun, Duration time);
+    QPID_COMMON_EXTERN void overran(const std::string& task, Duration overrun, Duration time);
 
-    void lateAndOverran(const std::string& task,
-                        Duration delay, Duration overrun, Duration time);
+    QPID_COMMON_EXTERN void lateAndOverran(const std::string& task,
+                                           Duration delay, Duration overrun, Duration time);
 
   private:
     struct Statistic {
@@ -0,0 +1,106 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/sys/UuidGenerator.h"
+#include "qpid/sys/Thread.h"
+#include "qpid/sys/uuid.h"
+#include "qpid/sys/IntegerTypes.h"
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#  include <unistd.h>
+#endif
+
+namespace qpid {
+namespace sys {
+
+namespace {
+UuidGenerator::Kind initialKind()
+{
+    const char* kind = ::getenv("QPID_UUID_GENERATOR");
+    return kind && ::strcmp(kind, "thread-local") == 0 ? UuidGenerator::THREAD_LOCAL : UuidGenerator::LIBUUID;
+}
+
+volatile UuidGenerator::Kind kind = initialKind();
+
+// xorshift128+ state, seeded from libuuid on first use in each thread
+QPID_TSS uint64_t s0 = 0;
+QPID_TSS uint64_t s1 = 0;
+QPID_TSS long seededBy = 0;
+
+long processId()
+{
+#ifdef _WIN32
+    return 1;
+#else
+    return ::getpid();
+#endif
+}
+
+void seed()
+{
+    unsigned char bytes[16];
+    uuid_generate(bytes);
+    ::memcpy(&s0, bytes, 8);
+    ::memcpy(&s1, bytes + 8, 8);
+    if (!s0 && !s1) s1 = 1;     // All zero state would only ever produce zero
+    seededBy = processId();
+}
+
+uint64_t next()
+{
+    uint64_t x = s0;
+    const uint64_t y = s1;
+    s0 = y;
+    x ^= x << 23;
+    s1 = x ^ y ^ (x >> 17) ^ (y >> 26);
+    return s1 + y;
+}
+
+void generateThreadLocal(unsigned char* out)
+{
+    if (seededBy != processId()) seed();
+    uint64_t a = next();
+    uint64_t b = next();
+    ::memcpy(out, &a, 8);
+    ::memcpy(out + 8, &b, 8);
+    out[6] = (out[6] & 0x0f) | 0x40;    // version 4, random
+    out[8] = (out[8] & 0x3f) | 0x80;    // RFC 4122 variant
+}
+}
+
+void UuidGenerator::generate(unsigned char* out)
+{
+    if (kind == THREAD_LOCAL) generateThreadLocal(out);
+    else uuid_generate(out);
+}
+
+void UuidGenerator::select(Kind k)
+{
+    kind = k;
+}
+
+UuidGenerator::Kind UuidGenerator::selected()
+{
+    return kind;
+}
+
+}} // namespace qpid::sys
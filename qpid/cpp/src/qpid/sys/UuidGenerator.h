@@ -0,0 +1,57 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_SYS_UUIDGENERATOR_H
+#define QPID_SYS_UUIDGENERATOR_H
+
+#include "qpid/types/ImportExport.h"
+
+namespace qpid {
+namespace sys {
+
+/**
+ * Source of new uuids for qpid::types::Uuid and qpid::framing::Uuid.
+ *
+ * LIBUUID calls uuid_generate() every time, which may read
+ * /dev/urandom or take a lock inside libuuid on each call.
+ *
+ * THREAD_LOCAL seeds a generator once per thread from libuuid and then
+ * produces random (version 4) uuids from it with no system calls or
+ * shared state. A child process reseeds after fork.
+ *
+ * The initial choice is LIBUUID unless the environment variable
+ * QPID_UUID_GENERATOR is set to "thread-local".
+ */
+class UuidGenerator
+{
+  public:
+    enum Kind { LIBUUID, THREAD_LOCAL };
+
+    /** Write 16 bytes of new uuid to out */
+    QPID_TYPES_EXTERN static void generate(unsigned char* out);
+
+    /** Should be called before other threads start generating uuids. */
+    QPID_TYPES_EXTERN static void select(Kind kind);
+    QPID_TYPES_EXTERN static Kind selected();
+};
+
+}} // namespace qpid::sys
+
+#endif  /*!QPID_SYS_UUIDGENERATOR_H*/
@@ -23,23 +23,46 @@
 #include "qpid/sys/IOHandle.h"
 #include "qpid/sys/Mutex.h"
 #include "qpid/sys/AtomicCount.h"
+#include "qpid/sys/AtomicValue.h"
 #include "qpid/sys/DeletionManager.h"
+#include "qpid/sys/NumaNodes.h"
 #include "qpid/sys/posix/check.h"
 #include "qpid/sys/posix/PrivatePosix.h"
 #include "qpid/log/Statement.h"
 
+#include <boost/scoped_array.hpp>
+
 #include <sys/epoll.h>
 #include <errno.h>
 #include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 
 #include <assert.h>
+#include <algorithm>
 #include <queue>
 #include <set>
+#include <vector>
 #include <exception>
 
 namespace qpid {
 namespace sys {
 
+namespace {
+// Poll set served by this thread and events it took from other sets
+__thread int threadPollSet = 0;
+__thread uint64_t threadStolenEvents = 0;
+
+// Events this thread took from the kernel in one go and has not yet
+// returned from Poller::wait()
+const int MaxBatchEvents = 32;
+__thread ::epoll_event threadEvents[MaxBatchEvents];
+__thread int threadEventCount = 0;
+__thread int threadEventNext = 0;
+__thread PollerPrivate* threadEventPoller = 0;
+}
+
 // Deletion manager to handle deferring deletion of PollerHandles to when they definitely aren't being used
 DeletionManager<PollerHandlePrivate> PollerHandleDeletionManager;
 
@@ -64,22 +87,38 @@ class PollerHandlePrivate {
     };
 
     ::__uint32_t events;
+    ::__uint32_t armed;         // events last given to epoll_ctl
+    ::__uint32_t rearm;         // edge triggered events to deliver again
+    int epollFd;                // poll set the handle is registered with
     const IOHandlePrivate* ioHandle;
     PollerHandle* pollerHandle;
     FDStat stat;
+    bool allowEdgeTriggered;
+    bool edgeTriggered;
+    bool missed;                // edge seen while the handle was being dispatched
     Mutex lock;
 
     PollerHandlePrivate(const IOHandlePrivate* h, PollerHandle* p) :
       events(0),
+      armed(0),
+      rearm(0),
+      epollFd(-1),
       ioHandle(h),
       pollerHandle(p),
-      stat(ABSENT) {
+      stat(ABSENT),
+      allowEdgeTriggered(false),
+      edgeTriggered(false),
+      missed(false) {
     }
 
     int fd() const {
         return toFd(ioHandle);
     }
 
+    ::__uint32_t armFlags() const {
+        return edgeTriggered ? ::EPOLLET : ::EPOLLONESHOT;
+    }
+
     bool isActive() const {
         return stat == MONITORED || stat == MONITORED_HUNGUP;
     }
@@ -158,6 +197,12 @@ PollerHandle::~PollerHandle() {
     PollerHandleDeletionManager.markForDeletion(impl);
 }
 
+void PollerHandle::setEdgeTriggered() {
+    ScopedLock<Mutex> l(impl->lock);
+    assert(impl->isIdle());
+    impl->allowEdgeTriggered = true;
+}
+
 class HandleSet
 {
     Mutex lock;
@@ -259,7 +304,18 @@ class PollerPrivate {
         }
     };
 
-    const int epollFd;
+    const int epollFd;          // first poll set, also used for interrupts
+    std::vector<int> epollFds;  // all poll sets
+    const int stealFd;          // armed in a poll set to wake a thread there to take events from the others
+    const bool pinThreads;
+    const bool numaNodes;       // a poll set per node
+    const bool edgeTriggered;
+    const int batchEvents;      // events taken by each epoll_wait
+    const Duration busyPoll;    // how long to spin before blocking
+    AtomicValue<uint32_t> nextPollSet;
+    AtomicValue<uint32_t> threadIndex;
+    boost::scoped_array<AtomicValue<uint32_t> > idle; // threads blocked on each poll set
+    AtomicValue<uint32_t> stealing;                   // stealFd is armed in some poll set
     bool isShutdown;
     InterruptHandle interruptHandle;
     HandleSet registeredHandles;
@@ -289,26 +345,52 @@ class PollerPrivate {
         }
     }
 
-    PollerPrivate() :
+    PollerPrivate(int pollSets = 1, bool pin = false, bool edge = false, Duration spin = 0,
+                  bool numa = false) :
         epollFd(::epoll_create(DefaultFds)),
+        stealFd(::dup(alwaysReadableFd)),
+        pinThreads(pin),
+        numaNodes(numa),
+        edgeTriggered(edge),
+        batchEvents(edge ? MaxBatchEvents : 1),
+        busyPoll(spin),
+        idle(new AtomicValue<uint32_t>[pollSets]),
         isShutdown(false) {
         QPID_POSIX_CHECK(epollFd);
-        // Add always readable fd into our set (but not listening to it yet)
-        ::epoll_event epe;
-        epe.events = 0;
-        epe.data.u64 = 1;
-        QPID_POSIX_CHECK(::epoll_ctl(epollFd, EPOLL_CTL_ADD, alwaysReadableFd, &epe));
+        QPID_POSIX_CHECK(stealFd);
+        epollFds.push_back(epollFd);
+        for (int i = 1; i < pollSets; ++i) {
+            int fd = ::epoll_create(DefaultFds);
+            QPID_POSIX_CHECK(fd);
+            epollFds.push_back(fd);
+        }
+        // Add always readable fd into our sets (but not listening to it yet)
+        for (std::vector<int>::const_iterator i = epollFds.begin(); i != epollFds.end(); ++i) {
+            ::epoll_event epe;
+            epe.events = 0;
+            epe.data.u64 = 1;
+            QPID_POSIX_CHECK(::epoll_ctl(*i, EPOLL_CTL_ADD, alwaysReadableFd, &epe));
+            epe.data.ptr = const_cast<int*>(&stealFd);
+            QPID_POSIX_CHECK(::epoll_ctl(*i, EPOLL_CTL_ADD, stealFd, &epe));
+        }
     }
 
     ~PollerPrivate() {
         // It's probably okay to ignore any errors here as there can't be data loss
-        ::close(epollFd);
+        for (std::vector<int>::const_iterator i = epollFds.begin(); i != epollFds.end(); ++i)
+            ::close(*i);
+        ::close(stealFd);
 
         // Need to put the interruptHandle in idle state to delete it
         static_cast<PollerHandle&>(interruptHandle).impl->setIdle();
     }
 
     void resetMode(PollerHandlePrivate& handle);
+    bool queueEvent(PollerHandlePrivate& handle, ::__uint32_t events);
+    int waitPollSets(::epoll_event* events, int maxEvents, int timeoutMs);
+    int spinPollSet(int fd, ::epoll_event* events, int maxEvents);
+    void askForHelp(int pollSet);
+    void startThread();
 
     void interrupt() {
         ::epoll_event epe;
@@ -320,14 +402,127 @@ class PollerPrivate {
     }
 
     void interruptAll() {
-        ::epoll_event epe;
-        // Not EPOLLONESHOT, so we eventually get all threads
-        epe.events = ::EPOLLIN;
-        epe.data.u64 = 2; // Keep valgrind happy
-        QPID_POSIX_CHECK(::epoll_ctl(epollFd, EPOLL_CTL_MOD, alwaysReadableFd, &epe));  
+        for (std::vector<int>::const_iterator i = epollFds.begin(); i != epollFds.end(); ++i) {
+            ::epoll_event epe;
+            // Not EPOLLONESHOT, so we eventually get all threads
+            epe.events = ::EPOLLIN;
+            epe.data.u64 = 2; // Keep valgrind happy
+            QPID_POSIX_CHECK(::epoll_ctl(*i, EPOLL_CTL_MOD, alwaysReadableFd, &epe));
+        }
     }
 };
 
+// Called by each thread entering Poller::run()
+void PollerPrivate::startThread() {
+    uint32_t index = threadIndex.fetchAndAdd(1);
+    threadPollSet = index % epollFds.size();
+    threadStolenEvents = 0;
+    if (numaNodes) {
+        // The thread may run on any CPU of its poll set's node
+        NumaNodes::setCurrent(threadPollSet);
+        const std::vector<int>& cpus = NumaNodes::cpus(threadPollSet);
+        if (!cpus.empty()) {
+            ::cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            for (std::vector<int>::const_iterator i = cpus.begin(); i != cpus.end(); ++i)
+                CPU_SET(*i, &cpuSet);
+            int rc = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpuSet), &cpuSet);
+            if (rc != 0) {
+                QPID_LOG(warning, "Could not bind IO worker thread to NUMA node " << threadPollSet
+                         << ": " << qpid::sys::strError(rc));
+            }
+        }
+    } else if (pinThreads) {
+        long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+        if (cpus > 0) {
+            ::cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            CPU_SET(index % cpus, &cpuSet);
+            int rc = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpuSet), &cpuSet);
+            if (rc != 0) {
+                QPID_LOG(warning, "Could not pin IO worker thread to CPU " << index % cpus
+                         << ": " << qpid::sys::strError(rc));
+            }
+        }
+    }
+}
+
+// Wait on this thread's poll set. A thread that may have left events
+// there wakes an idle thread of another set to take one, so idle
+// threads sleep until there is work rather than looking for it.
+int PollerPrivate::waitPollSets(::epoll_event* events, int maxEvents, int timeoutMs) {
+    int own = threadPollSet % epollFds.size();
+    // Leave some of a batch for the other threads waiting on this set
+    uint32_t waiting = idle[own].get();
+    if (waiting > 0) {
+        maxEvents = std::max(1, maxEvents / int(waiting + 1));
+    }
+    int rc = 0;
+    if (busyPoll > 0 && timeoutMs != 0) {
+        rc = spinPollSet(epollFds[own], events, maxEvents);
+    }
+    if (rc == 0) {
+        ++idle[own];
+        rc = ::epoll_wait(epollFds[own], events, maxEvents, timeoutMs);
+        --idle[own];
+    }
+    if (rc <= 0 || epollFds.size() == 1) {
+        return rc;
+    }
+    bool asked = false;
+    for (int i = 0; i < rc; ++i) {
+        if (events[i].data.ptr == &stealFd) {
+            events[i--] = events[--rc];
+            asked = true;
+        }
+    }
+    if (asked) {
+        stealing.boolCompareAndSwap(1, 0);
+        if (rc == 0) {
+            // Only take one event at a time from a busy set
+            for (size_t i = 1; i < epollFds.size(); ++i) {
+                rc = ::epoll_wait(epollFds[(own + i) % epollFds.size()], events, 1, 0);
+                if (rc != 0) {
+                    if (rc > 0) ++threadStolenEvents;
+                    return rc;
+                }
+            }
+        }
+    } else if (rc == maxEvents) {
+        askForHelp(own);
+    }
+    return rc;
+}
+
+// Wake one idle thread of another poll set to take an event from the
+// busy ones; only one such request is outstanding at a time
+void PollerPrivate::askForHelp(int pollSet) {
+    for (size_t i = 1; i < epollFds.size(); ++i) {
+        int other = (pollSet + i) % epollFds.size();
+        if (idle[other].get() > 0) {
+            if (stealing.boolCompareAndSwap(0, 1)) {
+                ::epoll_event epe;
+                epe.events = ::EPOLLIN | ::EPOLLONESHOT;
+                epe.data.u64 = 0; // Keep valgrind happy
+                epe.data.ptr = const_cast<int*>(&stealFd);
+                QPID_POSIX_CHECK(::epoll_ctl(epollFds[other], EPOLL_CTL_MOD, stealFd, &epe));
+            }
+            return;
+        }
+    }
+}
+
+// Check a poll set without blocking until it has events or the busy
+// poll time is up, trading a spinning CPU for not having to be woken
+int PollerPrivate::spinPollSet(int fd, ::epoll_event* events, int maxEvents) {
+    AbsTime until(now(), busyPoll);
+    int rc;
+    do {
+        rc = ::epoll_wait(fd, events, maxEvents, 0);
+    } while (rc == 0 && !isShutdown && now() < until);
+    return rc;
+}
+
 PollerPrivate::ReadablePipe PollerPrivate::alwaysReadable;
 int PollerPrivate::alwaysReadableFd = alwaysReadable.getFD();
 
@@ -336,13 +531,18 @@ void Poller::registerHandle(PollerHandle& handle) {
     ScopedLock<Mutex> l(eh.lock);
     assert(eh.isIdle());
 
+    eh.edgeTriggered = eh.allowEdgeTriggered && impl->edgeTriggered;
+    eh.armed = 0;
+
     ::epoll_event epe;
-    epe.events = ::EPOLLONESHOT;
+    epe.events = eh.armFlags();
     epe.data.u64 = 0; // Keep valgrind happy
     epe.data.ptr = &eh;
 
+    // Spread handles over the poll sets
+    eh.epollFd = impl->epollFds[impl->nextPollSet.fetchAndAdd(1) % impl->epollFds.size()];
     impl->registeredHandles.add(&handle);
-    QPID_POSIX_CHECK(::epoll_ctl(impl->epollFd, EPOLL_CTL_ADD, eh.fd(), &epe));
+    QPID_POSIX_CHECK(::epoll_ctl(eh.epollFd, EPOLL_CTL_ADD, eh.fd(), &epe));
 
     eh.setActive();
 }
@@ -353,7 +553,7 @@ void Poller::unregisterHandle(PollerHandle& handle) {
     assert(!eh.isIdle());
 
     impl->registeredHandles.remove(&handle);
-    int rc = ::epoll_ctl(impl->epollFd, EPOLL_CTL_DEL, eh.fd(), 0);
+    int rc = ::epoll_ctl(eh.epollFd, EPOLL_CTL_DEL, eh.fd(), 0);
     // Ignore EBADF since deleting a nonexistent fd has the overall required result!
     // And allows the case where a sloppy program closes the fd and then does the delFd()
     if (rc == -1 && errno != EBADF) {
@@ -374,22 +574,40 @@ void PollerPrivate::resetMode(PollerHandlePrivate& eh) {
     }
 
     if (eh.events==0) {
+        eh.rearm = 0;
+        eh.missed = false;
         eh.setActive();
         return;
     }
 
     if (!eh.isInterrupted()) {
+        // An edge triggered handle is still armed as it was; unless an
+        // edge came while it was being dispatched or it has hung up
+        // there is nothing to tell the kernel. Directions the callbacks
+        // asked for again are delivered from this thread's batch.
+        if (eh.edgeTriggered && eh.armed == eh.events && !eh.missed && !eh.isHungup()) {
+            ::__uint32_t again = eh.rearm & eh.events;
+            eh.rearm = 0;
+            eh.setActive();
+            if (!again || queueEvent(eh, again)) {
+                return;
+            }
+        }
+        eh.rearm = 0;
+        eh.missed = false;
+
         ::epoll_event epe;
-        epe.events = eh.events | ::EPOLLONESHOT;
+        epe.events = eh.events | eh.armFlags();
         epe.data.u64 = 0; // Keep valgrind happy
         epe.data.ptr = &eh;
 
-        int rc = ::epoll_ctl(epollFd, EPOLL_CTL_MOD, eh.fd(), &epe);
+        int rc = ::epoll_ctl(eh.epollFd, EPOLL_CTL_MOD, eh.fd(), &epe);
         // If something has closed the fd in the meantime try adding it back
         if (rc ==-1 && errno == ENOENT) {
-            rc = ::epoll_ctl(epollFd, EPOLL_CTL_ADD, eh.fd(), &epe);
+            rc = ::epoll_ctl(eh.epollFd, EPOLL_CTL_ADD, eh.fd(), &epe);
         }
         QPID_POSIX_CHECK(rc);
+        eh.armed = eh.events;
 
         eh.setActive();
         return;
@@ -404,6 +622,29 @@ void PollerPrivate::resetMode(PollerHandlePrivate& eh) {
     interrupt();
 }
 
+// Queue an event for this thread to return after the ones it already has
+bool PollerPrivate::queueEvent(PollerHandlePrivate& eh, ::__uint32_t events) {
+    if (threadEventNext == threadEventCount) {
+        threadEventNext = threadEventCount = 0;
+        threadEventPoller = this;
+    } else if (threadEventPoller != this) {
+        return false;
+    }
+    if (threadEventCount == MaxBatchEvents) {
+        if (threadEventNext == 0) {
+            return false;
+        }
+        std::copy(threadEvents + threadEventNext, threadEvents + threadEventCount, threadEvents);
+        threadEventCount -= threadEventNext;
+        threadEventNext = 0;
+    }
+    ::epoll_event& epe = threadEvents[threadEventCount++];
+    epe.events = events;
+    epe.data.u64 = 0; // Keep valgrind happy
+    epe.data.ptr = &eh;
+    return true;
+}
+
 void Poller::monitorHandle(PollerHandle& handle, Direction dir) {
     PollerHandlePrivate& eh = *handle.impl;
     ScopedLock<Mutex> l(eh.lock);
@@ -412,8 +653,13 @@ void Poller::monitorHandle(PollerHandle& handle, Direction dir) {
     ::__uint32_t oldEvents = eh.events;
     eh.events |= PollerPrivate::directionToEpollEvent(dir);
 
-    // If no change nothing more to do - avoid unnecessary system call
+    // If no change nothing more to do - avoid unnecessary system call.
+    // An edge triggered handle asking again from its callbacks will not
+    // see another edge so it is called again when they return.
     if (oldEvents==eh.events) {
+        if (eh.edgeTriggered && eh.isInactive()) {
+            eh.rearm |= PollerPrivate::directionToEpollEvent(dir);
+        }
         return;
     }
 
@@ -423,11 +669,12 @@ void Poller::monitorHandle(PollerHandle& handle, Direction dir) {
     }
 
     ::epoll_event epe;
-    epe.events = eh.events | ::EPOLLONESHOT;
+    epe.events = eh.events | eh.armFlags();
     epe.data.u64 = 0; // Keep valgrind happy
     epe.data.ptr = &eh;
 
-    QPID_POSIX_CHECK(::epoll_ctl(impl->epollFd, EPOLL_CTL_MOD, eh.fd(), &epe));
+    QPID_POSIX_CHECK(::epoll_ctl(eh.epollFd, EPOLL_CTL_MOD, eh.fd(), &epe));
+    eh.armed = eh.events;
 }
 
 void Poller::unmonitorHandle(PollerHandle& handle, Direction dir) {
@@ -437,6 +684,7 @@ void Poller::unmonitorHandle(PollerHandle& handle, Direction dir) {
 
     ::__uint32_t oldEvents = eh.events;
     eh.events &= ~PollerPrivate::directionToEpollEvent(dir);
+    eh.rearm &= eh.events;
 
     // If no change nothing more to do - avoid unnecessary system call
     if (oldEvents==eh.events) {
@@ -449,11 +697,12 @@ void Poller::unmonitorHandle(PollerHandle& handle, Direction dir) {
     }
 
     ::epoll_event epe;
-    epe.events = eh.events | ::EPOLLONESHOT;
+    epe.events = eh.events | eh.armFlags();
     epe.data.u64 = 0; // Keep valgrind happy
     epe.data.ptr = &eh;
 
-    QPID_POSIX_CHECK(::epoll_ctl(impl->epollFd, EPOLL_CTL_MOD, eh.fd(), &epe));
+    QPID_POSIX_CHECK(::epoll_ctl(eh.epollFd, EPOLL_CTL_MOD, eh.fd(), &epe));
+    eh.armed = eh.events;
 }
 
 void Poller::shutdown() {
@@ -488,7 +737,8 @@ bool Poller::interrupt(PollerHandle& handle) {
         epe.events = 0;
         epe.data.u64 = 0; // Keep valgrind happy
         epe.data.ptr = &eh;
-        QPID_POSIX_CHECK(::epoll_ctl(impl->epollFd, EPOLL_CTL_MOD, eh.fd(), &epe));
+        QPID_POSIX_CHECK(::epoll_ctl(eh.epollFd, EPOLL_CTL_MOD, eh.fd(), &epe));
+        eh.armed = 0;
 
         if (eh.isInactive()) {
             eh.setInterrupted();
@@ -516,16 +766,21 @@ void Poller::run() {
         ::pthread_sigmask(SIG_SETMASK, &ss, 0);
 
         ++(impl->threadCount);
+        impl->startThread();
+        uint64_t events = 0;
         do {
             Event event = wait();
 
             // If can read/write then dispatch appropriate callbacks
             if (event.handle) {
+                ++events;
                 event.process();
             } else {
                 // Handle shutdown
                 switch (event.type) {
                 case SHUTDOWN:
+                    QPID_LOG(debug, "IO worker for poll set " << threadPollSet << " processed "
+                             << events << " events, " << threadStolenEvents << " from other poll sets");
                     PollerHandleDeletionManager.destroyThreadState();
                     //last thread to respond to shutdown cleans up:
                     if (--(impl->threadCount) == 0) impl->registeredHandles.cleanup();
@@ -550,7 +805,7 @@ bool Poller::hasShutdown()
 
 Poller::Event Poller::wait(Duration timeout) {
     static __thread PollerHandlePrivate* lastReturnedHandle = 0;
-    epoll_event epe;
+    static __thread PollerPrivate* lastReturnedPoller = 0;
     int timeoutMs = (timeout == TIME_INFINITE) ? -1 : timeout / TIME_MSEC;
     AbsTime targetTimeout = 
         (timeout == TIME_INFINITE) ?
@@ -558,18 +813,36 @@ Poller::Event Poller::wait(Duration timeout) {
             AbsTime(now(), timeout); 
 
     if (lastReturnedHandle) {
-        impl->resetMode(*lastReturnedHandle);
+        lastReturnedPoller->resetMode(*lastReturnedHandle);
         lastReturnedHandle = 0;
     }
+    lastReturnedPoller = impl;
 
     // Repeat until we weren't interrupted by signal
     do {
-        PollerHandleDeletionManager.markAllUnusedInThisThread();
-        int rc = ::epoll_wait(impl->epollFd, &epe, 1, timeoutMs);
+        ::epoll_event epe;
+        int rc;
+        if (threadEventNext < threadEventCount && threadEventPoller == impl) {
+            // Handles in the batch cannot have been deleted yet as this
+            // thread has not marked them unused since taking it
+            epe = threadEvents[threadEventNext++];
+            rc = 1;
+        } else if (threadEventNext < threadEventCount) {
+            // Another poller's batch is still pending in this thread
+            rc = impl->waitPollSets(&epe, 1, timeoutMs);
+        } else {
+            PollerHandleDeletionManager.markAllUnusedInThisThread();
+            rc = impl->waitPollSets(threadEvents, impl->batchEvents, timeoutMs);
+            if (rc > 0) {
+                threadEventPoller = impl;
+                threadEventCount = rc;
+                threadEventNext = 1;
+                epe = threadEvents[0];
+            }
+        }
         if (rc ==-1 && errno != EINTR) {
             QPID_POSIX_CHECK(rc);
         } else if (rc > 0) {
-            assert(rc == 1);
             void* dataPtr = epe.data.ptr;
 
             // Check if this is an interrupt
@@ -616,15 +889,31 @@ Poller::Event Poller::wait(Duration timeout) {
 
             // Check for shutdown
             if (impl->isShutdown) {
-                PollerHandleDeletionManager.markAllUnusedInThisThread();
+                if (threadEventPoller == impl) {
+                    threadEventNext = threadEventCount = 0;
+                }
+                if (threadEventNext == threadEventCount) {
+                    PollerHandleDeletionManager.markAllUnusedInThisThread();
+                }
                 return Event(0, SHUTDOWN);
             }
 
             PollerHandlePrivate& eh = *static_cast<PollerHandlePrivate*>(dataPtr);
             ScopedLock<Mutex> l(eh.lock);
 
+            // An edge triggered handle stays armed, so it can report
+            // directions no longer watched, or an edge while another
+            // thread is dispatching it which must be looked at again
+            // when that thread is done
+            if (eh.edgeTriggered) {
+                epe.events &= eh.events | ::EPOLLHUP | ::EPOLLERR;
+                if (epe.events && eh.isInactive()) {
+                    eh.missed = true;
+                }
+            }
+
             // the handle could have gone inactive since we left the epoll_wait
-            if (eh.isActive()) {
+            if (eh.isActive() && epe.events) {
                 PollerHandle* handle = eh.pollerHandle;
                 assert(handle);
 
@@ -672,6 +961,12 @@ Poller::Poller() :
     impl(new PollerPrivate())
 {}
 
+Poller::Poller(int pollSets, bool pinThreads, bool edgeTriggered, Duration busyPoll,
+               bool numaNodes) :
+    impl(new PollerPrivate(numaNodes ? NumaNodes::count() : pollSets > 1 ? pollSets : 1,
+                           pinThreads, edgeTriggered, busyPoll, numaNodes))
+{}
+
 Poller::~Poller() {
     delete impl;
 }
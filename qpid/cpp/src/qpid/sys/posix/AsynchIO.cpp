@@ -20,10 +20,12 @@
  */
 
 #include "qpid/sys/AsynchIO.h"
+#include "qpid/sys/AtomicValue.h"
 #include "qpid/sys/Socket.h"
 #include "qpid/sys/SocketAddress.h"
 #include "qpid/sys/Poller.h"
 #include "qpid/sys/DispatchHandle.h"
+#include "qpid/sys/Probe.h"
 #include "qpid/sys/Time.h"
 #include "qpid/log/Statement.h"
 
@@ -33,6 +35,7 @@
 // bit more abstraction could (should) be promoted to be platform portable
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <signal.h>
 #include <errno.h>
 #include <string.h>
@@ -66,6 +69,15 @@ __thread int threadReadCount = 0;
 __thread int threadWriteTotal = 0;
 __thread int threadWriteCount = 0;
 __thread int64_t threadMaxReadTimeNs = 2 * 1000000; // start at 2ms
+
+// Maximum number of queued buffers handed to a single gather write
+const int maxWriteBuffers = 16;
+
+// Maximum number of connections accepted from one socket per wakeup
+const uint32_t maxAcceptBatch = 64;
+
+AtomicValue<uint64_t> acceptedTotal;
+AtomicValue<uint32_t> largestAcceptBatch;
 }
 
 /*
@@ -109,26 +121,30 @@ void AsynchAcceptor::start(Poller::shared_ptr poller) {
 }
 
 /*
- * We keep on accepting as long as there is something to accept
+ * We keep on accepting as long as there is something to accept, up to a
+ * batch, then rewatch so that a flood of connections on this socket doesn't
+ * keep the thread from other listening sockets and connections
  */
 void AsynchAcceptor::readable(DispatchHandle& h) {
-    Socket* s;
-    do {
+    uint32_t count = 0;
+    while (count < maxAcceptBatch) {
         errno = 0;
         // TODO: Currently we ignore the peers address, perhaps we should
         // log it or use it for connection acceptance.
         try {
-            s = socket.accept();
-            if (s) {
-                acceptedCallback(*s);
-            } else {
-                break;
-            }
+            Socket* s = socket.accept();
+            if (!s) break;
+            ++count;
+            acceptedCallback(*s);
         } catch (const std::exception& e) {
             QPID_LOG(error, "Could not accept socket: " << e.what());
             break;
         }
-    } while (true);
+    }
+    acceptedTotal += count;
+    for (uint32_t largest = largestAcceptBatch.get();
+         count > largest && !largestAcceptBatch.boolCompareAndSwap(largest, count);
+         largest = largestAcceptBatch.get());
 
     h.rewatch();
 }
@@ -309,6 +325,9 @@ AsynchIO::AsynchIO(const Socket& s,
     readingStopped(false) {
 
     s.setNonblocking();
+    // readable() and writeable() carry on until the socket would block
+    // or ask to be called again
+    setEdgeTriggered();
 }
 
 struct deleter
@@ -427,7 +446,7 @@ void AsynchIO::readable(DispatchHandle& h) {
         return;
     }
     int readTotal = 0;
-    AbsTime readStartTime = AbsTime::now();
+    AbsTime readStartTime = AbsTime::coarseNow();
     do {
         // (Try to) get a buffer
         if (!bufferQueue.empty()) {
@@ -454,8 +473,10 @@ void AsynchIO::readable(DispatchHandle& h) {
                     break;
                 }
                 
-                // Stop reading if we've overrun our timeslot
-                if (Duration(readStartTime, AbsTime::now()) > threadMaxReadTimeNs) {
+                // Stop reading if we've overrun our timeslot (but
+                // there may be more to read so ask to come back)
+                if (Duration(readStartTime, AbsTime::coarseNow()) > threadMaxReadTimeNs) {
+                    h.rewatchRead();
                     break;
                 }
                 
@@ -501,48 +522,65 @@ void AsynchIO::readable(DispatchHandle& h) {
 }
 
 /*
- * We carry on writing whilst we have data to write and we can write
+ * We carry on writing whilst we have data to write and we can write.
+ * All the buffers queued (up to maxWriteBuffers) are handed to the
+ * socket in a single gather write.
  */
 void AsynchIO::writeable(DispatchHandle& h) {
     int writeTotal = 0;
     do {
         // See if we've got something to write
         if (!writeQueue.empty()) {
-            // Write buffer
-            BufferBase* buff = writeQueue.back();
-            writeQueue.pop_back();
+            // Gather buffers oldest first (the oldest is at the back)
+            struct ::iovec iov[maxWriteBuffers];
+            int count = 0;
+            for (std::deque<BufferBase*>::reverse_iterator i = writeQueue.rbegin();
+                 i != writeQueue.rend() && count < maxWriteBuffers; ++i, ++count) {
+                BufferBase* buff = *i;
+                assert(buff->dataStart+buff->dataCount <= buff->byteCount);
+                iov[count].iov_base = buff->bytes+buff->dataStart;
+                iov[count].iov_len = buff->dataCount;
+            }
             errno = 0;
-            assert(buff->dataStart+buff->dataCount <= buff->byteCount);
-            int rc = socket.write(buff->bytes+buff->dataStart, buff->dataCount);
+            int rc = socket.writev(iov, count);
             if (rc >= 0) {
+                QPID_PROBE(io_written, this, rc);
                 threadWriteTotal += rc;
                 writeTotal += rc;
 
-                // If we didn't write full buffer put rest back
-                if (rc != buff->dataCount) {
-                    buff->dataStart += rc;
-                    buff->dataCount -= rc;
-                    writeQueue.push_back(buff);
-                    break;
+                // Recycle the buffers written completely and if we
+                // didn't write everything leave the rest queued
+                bool partial = false;
+                for (int i = 0; i < count; ++i) {
+                    BufferBase* buff = writeQueue.back();
+                    if (rc < buff->dataCount) {
+                        buff->dataStart += rc;
+                        buff->dataCount -= rc;
+                        partial = true;
+                        break;
+                    }
+                    rc -= buff->dataCount;
+                    writeQueue.pop_back();
+                    queueReadBuffer(buff);
                 }
-                
-                // Recycle the buffer
-                queueReadBuffer(buff);
-                
+                if (partial)
+                    break;
+
                 // If we've already written more than the max for reading then stop
                 // (this is to stop writes dominating reads) 
-                if (writeTotal > threadMaxRead)
+                if (writeTotal > threadMaxRead) {
+                    h.rewatchWrite();
                     break;
+                }
             } else {
-                // Put buffer back
-                writeQueue.push_back(buff);
+                // Buffers are still queued
                 if (errno == ECONNRESET || errno == EPIPE) {
                     // Just stop watching for write here - we'll get a
                     // disconnect callback soon enough
                     h.unwatchWrite();
                     break;
                 } else if (errno == EAGAIN) {
-                    // We have just put a buffer back so we know
+                    // The buffers are still queued so we know
                     // we can carry on watching for writes
                     break;
                 } else {
@@ -606,6 +644,16 @@ AsynchAcceptor* AsynchAcceptor::create(const Socket& s,
     return new posix::AsynchAcceptor(s, callback);
 }
 
+void AsynchAcceptor::getStats(Stats& stats)
+{
+    stats.accepted = acceptedTotal.get();
+    uint32_t largest;
+    do {
+        largest = largestAcceptBatch.get();
+    } while (!largestAcceptBatch.boolCompareAndSwap(largest, 0));
+    stats.largestBatch = largest;
+}
+
 AsynchConnector* AsynchConnector::create(const Socket& s,
                                          const std::string& hostname,
                                          const std::string& port,
@@ -0,0 +1,65 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "qpid/sys/MemoryMappedFile.h"
+#include "qpid/Exception.h"
+
+#include <vector>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+namespace qpid {
+namespace sys {
+
+MemoryMappedFile::MemoryMappedFile(const std::string& directory, size_t s) : data(0), size(s)
+{
+    std::string path = directory + "/qpid-page-XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+    int fd = ::mkstemp(&name[0]);
+    if (fd < 0) throw ErrnoException("Cannot create paging file in " + directory, errno);
+    // The file is only reachable through the mapping from here on
+    ::unlink(&name[0]);
+    if (::ftruncate(fd, size) < 0) {
+        int err = errno;
+        ::close(fd);
+        throw ErrnoException("Cannot size paging file in " + directory, err);
+    }
+    void* region = ::mmap(0, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (region == MAP_FAILED) throw ErrnoException("Cannot map paging file in " + directory, err);
+    data = static_cast<char*>(region);
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    if (data) ::munmap(data, size);
+}
+
+size_t MemoryMappedFile::getPageSize()
+{
+    return ::sysconf(_SC_PAGESIZE);
+}
+
+}} // namespace qpid::sys
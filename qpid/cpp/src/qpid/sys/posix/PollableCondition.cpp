@@ -22,6 +22,10 @@
  *
  */
 
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
 #include "qpid/sys/PollableCondition.h"
 #include "qpid/sys/DispatchHandle.h"
 #include "qpid/sys/IOHandle.h"
@@ -32,6 +36,9 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#ifdef HAVE_SYS_EVENTFD_H
+#  include <sys/eventfd.h>
+#endif
 
 namespace qpid {
 namespace sys {
@@ -63,6 +70,17 @@ PollableConditionPrivate::PollableConditionPrivate(
     const boost::shared_ptr<sys::Poller>& poller
 ) : IOHandle(new sys::IOHandlePrivate), cb(cb), parent(parent)
 {
+    // The condition is whether the poller watches the FD, which is
+    // made readable once here and never read. So set() and clear()
+    // only change the watch, and the poller makes no system call when
+    // that doesn't change.
+#ifdef HAVE_SYS_EVENTFD_H
+    // A non-zero eventfd counter is readable: one FD instead of two
+    impl->fd = ::eventfd(1, EFD_NONBLOCK);
+    if (impl->fd == -1)
+        throw ErrnoException(QPID_MSG("Can't create PollableCondition"));
+    writeFd = -1;
+#else
     int fds[2];
     if (::pipe(fds) == -1)
         throw ErrnoException(QPID_MSG("Can't create PollableCondition"));
@@ -72,6 +90,7 @@ PollableConditionPrivate::PollableConditionPrivate(
         throw ErrnoException(QPID_MSG("Can't create PollableCondition"));
     if (::fcntl(writeFd, F_SETFL, O_NONBLOCK) == -1)
         throw ErrnoException(QPID_MSG("Can't create PollableCondition"));
+#endif
     handle.reset (new DispatchHandleRef(
                       *this,
                       boost::bind(&sys::PollableConditionPrivate::dispatch, this, _1),
@@ -79,16 +98,18 @@ PollableConditionPrivate::PollableConditionPrivate(
     handle->startWatch(poller);
     handle->unwatch();
 
-    // Make the read FD readable
-    static const char dummy=0;
-    ssize_t n = ::write(writeFd, &dummy, 1);
-    if (n == -1 && errno != EAGAIN)
-        throw ErrnoException("Error setting PollableCondition");
+    if (writeFd != -1) {
+        // Make the read FD readable
+        static const char dummy=0;
+        ssize_t n = ::write(writeFd, &dummy, 1);
+        if (n == -1 && errno != EAGAIN)
+            throw ErrnoException("Error setting PollableCondition");
+    }
 }
 
 PollableConditionPrivate::~PollableConditionPrivate() {
     handle->stopWatch();
-    close(writeFd);
+    if (writeFd != -1) close(writeFd);
 }
 
 void PollableConditionPrivate::dispatch(sys::DispatchHandle&) {
@@ -28,10 +28,16 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <sys/errno.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <netdb.h>
+#include <pwd.h>
+#include <stddef.h>
+#include <unistd.h>
 #include <cstdlib>
 #include <string.h>
 
@@ -51,6 +57,13 @@ std::string getName(int fd, bool local)
         QPID_POSIX_CHECK( ::getpeername(fd, name, &namelen) );
     }
 
+    // The client end of a Unix domain socket has no name, so tell
+    // connections apart by the socket's inode instead
+    if (name->sa_family == AF_UNIX && namelen <= offsetof(::sockaddr_un, sun_path)) {
+        struct ::stat st;
+        QPID_POSIX_CHECK( ::fstat(fd, &st) );
+        return QPID_MSG("unix:" << st.st_ino);
+    }
     return SocketAddress::asString(name, namelen);
 }
 
@@ -88,7 +101,7 @@ void Socket::createSocket(const SocketAddress& sa) const
 
     try {
         if (nonblocking) setNonblocking();
-        if (nodelay) setTcpNoDelay();
+        if (nodelay && getAddrInfo(sa).ai_family != AF_UNIX) setTcpNoDelay();
         if (getAddrInfo(sa).ai_family == AF_INET6) {
             int flag = 1;
             int result = ::setsockopt(socket, IPPROTO_IPV6, IPV6_V6ONLY, (char *)&flag, sizeof(flag));
@@ -134,6 +147,16 @@ void Socket::setTcpNoDelay() const
     }
 }
 
+bool Socket::setBusyPoll(int usecs) const
+{
+#ifdef SO_BUSY_POLL
+    return ::setsockopt(impl->fd, SOL_SOCKET, SO_BUSY_POLL, (char *)&usecs, sizeof(usecs)) == 0;
+#else
+    (void) usecs;
+    return false;
+#endif
+}
+
 void Socket::connect(const std::string& host, const std::string& port) const
 {
     SocketAddress sa(host, port);
@@ -193,13 +216,25 @@ int Socket::listen(const std::string& host, const std::string& port, int backlog
     return listen(sa, backlog);
 }
 
-int Socket::listen(const SocketAddress& sa, int backlog) const
+int Socket::listen(const SocketAddress& sa, int backlog, bool sharePort) const
 {
     createSocket(sa);
 
     const int& socket = impl->fd;
     int yes=1;
     QPID_POSIX_CHECK(::setsockopt(socket,SOL_SOCKET,SO_REUSEADDR,&yes,sizeof(yes)));
+    if (sharePort) {
+#ifdef SO_REUSEPORT
+        QPID_POSIX_CHECK(::setsockopt(socket,SOL_SOCKET,SO_REUSEPORT,&yes,sizeof(yes)));
+#else
+        throw Exception(QPID_MSG("Can't share port " << sa.asString() << ": not supported on this platform"));
+#endif
+    }
+
+    // A socket file left by a previous listener would stop the bind
+    const ::sockaddr_un* un = (const ::sockaddr_un*)getAddrInfo(sa).ai_addr;
+    if (getAddrInfo(sa).ai_family == AF_UNIX && un->sun_path[0] == '/')
+        ::unlink(un->sun_path);
 
     if (::bind(socket, getAddrInfo(sa).ai_addr, getAddrInfo(sa).ai_addrlen) < 0)
         throw Exception(QPID_MSG("Can't bind to port " << sa.asString() << ": " << strError(errno)));
@@ -211,13 +246,21 @@ int Socket::listen(const SocketAddress& sa, int backlog) const
 
 Socket* Socket::accept() const
 {
-    int afd = ::accept(impl->fd, 0, 0);
+    int afd;
+    do {
+        // A connection the peer gave up on while it waited is skipped
+#ifdef SOCK_NONBLOCK
+        afd = ::accept4(impl->fd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        afd = ::accept(impl->fd, 0, 0);
+#endif
+    } while (afd < 0 && (errno == ECONNABORTED || errno == EINTR));
     if ( afd >= 0) {
         Socket* s = new Socket(new IOHandlePrivate(afd));
         s->localname = localname;
         return s;
     }
-    else if (errno == EAGAIN)
+    else if (errno == EAGAIN || errno == EWOULDBLOCK)
         return 0;
     else throw QPID_POSIX_ERROR(errno);
 }
@@ -232,6 +275,11 @@ int Socket::write(const void *buf, size_t count) const
     return ::write(impl->fd, buf, count);
 }
 
+int Socket::writev(const struct ::iovec* iov, int iovcnt) const
+{
+    return ::writev(impl->fd, iov, iovcnt);
+}
+
 std::string Socket::getPeerAddress() const
 {
     if (peername.empty()) {
@@ -259,4 +307,28 @@ int Socket::getError() const
     return result;
 }
 
+bool Socket::getPeerUser(std::string& user) const
+{
+#ifdef SO_PEERCRED
+    ::sockaddr_storage name;
+    ::socklen_t namelen = sizeof(name);
+    if (::getsockname(impl->fd, (::sockaddr*)&name, &namelen) < 0 || name.ss_family != AF_UNIX)
+        return false;
+    ::ucred cred;
+    ::socklen_t credlen = sizeof(cred);
+    if (::getsockopt(impl->fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) < 0)
+        return false;
+    ::passwd pw;
+    ::passwd* found = 0;
+    char buffer[1024];
+    if (::getpwuid_r(cred.uid, &pw, buffer, sizeof(buffer), &found) != 0 || !found)
+        return false;
+    user = found->pw_name;
+    return true;
+#else
+    (void) user;
+    return false;
+#endif
+}
+
 }} // namespace qpid::sys
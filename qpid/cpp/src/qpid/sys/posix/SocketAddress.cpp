@@ -25,13 +25,29 @@
 #include "qpid/Msg.h"
 
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <netdb.h>
+#include <stddef.h>
 #include <string.h>
 
 namespace qpid {
 namespace sys {
 
+namespace {
+// A path, or with a leading '@' a name in Linux's abstract namespace
+bool isLocal(const std::string& host) {
+    return !host.empty() && (host[0] == '/' || host[0] == '@');
+}
+
+// getaddrinfo() knows nothing of Unix domain sockets, so their single
+// address is made here and freed with delete, not freeaddrinfo()
+struct LocalAddrInfo {
+    ::addrinfo info;
+    ::sockaddr_un addr;
+};
+}
+
 SocketAddress::SocketAddress(const std::string& host0, const std::string& port0) :
     host(host0),
     port(port0),
@@ -57,12 +73,23 @@ SocketAddress& SocketAddress::operator=(const SocketAddress& sa)
 SocketAddress::~SocketAddress()
 {
     if (addrInfo) {
-        ::freeaddrinfo(addrInfo);
+        if (isLocal(host))
+            delete reinterpret_cast<LocalAddrInfo*>(addrInfo);
+        else
+            ::freeaddrinfo(addrInfo);
     }
 }
 
 std::string SocketAddress::asString(::sockaddr const * const addr, size_t addrlen)
 {
+    if (addr->sa_family == AF_UNIX) {
+        const ::sockaddr_un* un = (const ::sockaddr_un*)addr;
+        size_t offset = offsetof(::sockaddr_un, sun_path);
+        if (addrlen <= offset) return "unix";
+        if (un->sun_path[0] == '\0')
+            return "@" + std::string(un->sun_path + 1, addrlen - offset - 1);
+        return std::string(un->sun_path, ::strnlen(un->sun_path, addrlen - offset));
+    }
     char servName[NI_MAXSERV];
     char dispName[NI_MAXHOST];
     if (int rc=::getnameinfo(addr, addrlen,
@@ -86,12 +113,24 @@ uint16_t SocketAddress::getPort(::sockaddr const * const addr)
     switch (addr->sa_family) {
         case AF_INET: return ntohs(((::sockaddr_in*)addr)->sin_port);
         case AF_INET6: return ntohs(((::sockaddr_in6*)addr)->sin6_port);
+        case AF_UNIX: return 0;
         default:throw Exception(QPID_MSG("Unexpected socket type"));
     }
 }
 
+std::string SocketAddress::localName(const std::string& port)
+{
+#ifdef __linux__
+    return "@qpidd-" + port;
+#else
+    return "/tmp/qpidd-" + port;
+#endif
+}
+
 std::string SocketAddress::asString(bool numeric) const
 {
+    if (isLocal(host))
+        return host;
     if (!numeric)
         return host + ":" + port;
     // Canonicalise into numeric id
@@ -114,12 +153,29 @@ void SocketAddress::setAddrInfoPort(uint16_t port) {
     switch (ai.ai_family) {
     case AF_INET: ((::sockaddr_in*)ai.ai_addr)->sin_port = htons(port); return;
     case AF_INET6:((::sockaddr_in6*)ai.ai_addr)->sin6_port = htons(port); return;
+    case AF_UNIX: return;
     default: throw Exception(QPID_MSG("Unexpected socket type"));
     }
 }
 
 const ::addrinfo& getAddrInfo(const SocketAddress& sa)
 {
+    if (!sa.addrInfo && isLocal(sa.host)) {
+        if (sa.host.size() >= sizeof(::sockaddr_un().sun_path))
+            throw Exception(QPID_MSG("Unix domain socket name too long: " << sa.host));
+        LocalAddrInfo* local = new LocalAddrInfo;
+        ::memset(local, 0, sizeof(*local));
+        local->addr.sun_family = AF_UNIX;
+        ::memcpy(local->addr.sun_path, sa.host.data(), sa.host.size());
+        size_t length = sa.host.size();
+        if (sa.host[0] == '@') local->addr.sun_path[0] = '\0';
+        else ++length;          // Include the terminating null
+        local->info.ai_family = AF_UNIX;
+        local->info.ai_socktype = SOCK_STREAM;
+        local->info.ai_addr = (::sockaddr*)&local->addr;
+        local->info.ai_addrlen = offsetof(::sockaddr_un, sun_path) + length;
+        sa.addrInfo = sa.currentAddrInfo = &local->info;
+    }
     if (!sa.addrInfo) {
         ::addrinfo hints;
         ::memset(&hints, 0, sizeof(hints));
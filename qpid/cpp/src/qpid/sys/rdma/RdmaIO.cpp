@@ -119,11 +119,13 @@ namespace Rdma {
         recvCredit(0),
         xmitCredit(xCredit),
         recvBufferCount(rCount),
+        creditHeld(rCount),
         xmitBufferCount(xCredit),
         outstandingWrites(0),
         draining(false),
         state(IDLE),
         qp(q),
+        srq(qp->getSharedRecvQueue()),
         dataHandle(*qp, boost::bind(&AsynchIO::dataEvent, this), 0, 0),
         readCallback(rc),
         idleCallback(ic),
@@ -137,11 +139,20 @@ namespace Rdma {
         qp->notifyRecv();
         qp->notifySend();
 
-        // Prepost recv buffers before we go any further
-        qp->allocateRecvBuffers(recvBufferCount, bufferSize+FrameHeaderSize);
+        // Prepost recv buffers before we go any further, unless they come
+        // from a shared receive queue
+        if (!srq)
+            qp->allocateRecvBuffers(recvBufferCount, bufferSize+FrameHeaderSize);
+        else if (srq->bufferSize() < bufferSize+int(FrameHeaderSize))
+            throw IOException("Shared receive buffers too small for peer");
 
         // Create xmit buffers, reserve space for frame header.
         qp->createSendBuffers(xmitBufferCount, bufferSize, FrameHeaderSize);
+
+        // The peer's initial credit is counted against the shared receive
+        // queue even if that overcommits it
+        if (srq)
+            srq->holdCredit(creditHeld);
     }
 
     AsynchIO::~AsynchIO() {
@@ -154,6 +165,8 @@ namespace Rdma {
             QPID_LOG(error, "RDMA: qp=" << qp << ": Deleting queue whilst not shutdown");
             dataHandle.stopWatch();
         }
+        if (srq)
+            srq->returnCredit(creditHeld);
         // TODO: It might turn out to be more efficient in high connection loads to reuse the
         // buffers rather than having to reregister them all the time (this would be straightforward if all 
         // connections haver the same buffer size and harder otherwise)
@@ -407,10 +420,10 @@ namespace Rdma {
                 qp->postRecv(b);
 
                 // Received another message
-                ++recvCredit;
+                recvCreditReturned();
 
                 // Send recvCredit if it is large enough (it will have got this large because we've not sent anything recently)
-                if (recvCredit > recvBufferCount/2) {
+                if (recvCredit > creditHeld/2) {
                     // TODO: This should use RDMA write with imm as there might not ever be a buffer to receive this message
                     // but this is a little unlikely, as to get in this state we have to have received messages without sending any
                     // for a while so its likely we've received an credit update from the far side.
@@ -439,6 +452,30 @@ namespace Rdma {
         }
     }
 
+    // A received message has given back a unit of the credit our peer had.
+    // With a shared receive queue that credit belongs to the pool: while the
+    // pool is overcommitted it goes back there, otherwise it is returned to
+    // the peer along with any spare credit the pool has, up to the number of
+    // buffers this connection would have had to itself. So the connections
+    // that are busy end up holding the credit.
+    void AsynchIO::recvCreditReturned() {
+        if (!srq) {
+            ++recvCredit;
+            return;
+        }
+        if (creditHeld > MinSharedCredit && srq->overcommitted()) {
+            srq->returnCredit(1);
+            --creditHeld;
+            return;
+        }
+        ++recvCredit;
+        if (creditHeld < recvBufferCount) {
+            int more = srq->takeCredit(recvBufferCount - creditHeld);
+            creditHeld += more;
+            recvCredit += more;
+        }
+    }
+
     void AsynchIO::doWriteCallback() {
         // TODO: maybe don't call idle unless we're low on write buffers
         // Keep on calling the idle routine as long as we are writable and we got something to write last call
@@ -481,6 +518,10 @@ namespace Rdma {
         nc(*this);
     }
 
+    SharedRecvQueue::intrusive_ptr makeSharedRecvQueue(::ibv_context* verbs, int recvBufferCount, int bufferSize) {
+        return SharedRecvQueue::make(verbs, recvBufferCount, bufferSize+FrameHeaderSize);
+    }
+
     ConnectionManager::ConnectionManager(
         ErrorCallback errc,
         DisconnectedCallback dc
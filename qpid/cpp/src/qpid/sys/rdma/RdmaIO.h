@@ -50,6 +50,7 @@ namespace Rdma {
         int recvCredit;
         int xmitCredit;
         int recvBufferCount;
+        int creditHeld;
         int xmitBufferCount;
         int outstandingWrites;
         bool draining;
@@ -57,6 +58,7 @@ namespace Rdma {
         State state;
         qpid::sys::Mutex stateLock;
         QueuePair::intrusive_ptr qp;
+        SharedRecvQueue::intrusive_ptr srq;
         qpid::sys::DispatchHandleRef dataHandle;
 
         ReadCallback readCallback;
@@ -105,12 +107,16 @@ namespace Rdma {
         const static int FlagsMask = 0xF0000000; // Mask for all flag bits - be sure to update this if you add more command bits
         const static int IgnoreData = 0x10000000; // Message contains no application data
 
+        // Credit a connection on a shared receive queue never gives back to the pool
+        const static int MinSharedCredit = 4;
+
         void dataEvent();
         void writeEvent();
         void processCompletions();
         void doWriteCallback();
         void checkDrained();
         void doStoppedCallback();
+        void recvCreditReturned();
         
         void queueBuffer(Buffer* buff, int credit);
         Buffer* extractBuffer(const QueuePairEvent& e);
@@ -141,6 +147,10 @@ namespace Rdma {
         qp->returnSendBuffer(b);
     }
 
+    // Create a receive queue shared by connections on the device verbs,
+    // with recvBufferCount buffers for peers that send up to bufferSize bytes
+    SharedRecvQueue::intrusive_ptr makeSharedRecvQueue(::ibv_context* verbs, int recvBufferCount, int bufferSize);
+
     // These are the parameters necessary to start the conversation
     // * Each peer HAS to allocate buffers of the size of the maximum receive from its peer
     // * Each peer HAS to know the initial "credit" it has for transmitting to its peer 
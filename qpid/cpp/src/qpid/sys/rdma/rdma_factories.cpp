@@ -58,6 +58,10 @@ namespace Rdma {
         if (qp) (void) ::ibv_destroy_qp(qp);
     }
 
+    void destroySrq(::ibv_srq* srq) throw () {
+        if (srq) (void) ::ibv_destroy_srq(srq);
+    }
+
     boost::shared_ptr< ::rdma_cm_id > mkId(::rdma_cm_id* i) {
         return boost::shared_ptr< ::rdma_cm_id >(i, destroyId);
     }
@@ -102,4 +106,12 @@ namespace Rdma {
         ::ibv_cq* cq = CHECK_NULL(::ibv_create_cq(c, cqe, context, cc, 0));
         return boost::shared_ptr< ::ibv_cq >(cq, destroyCq);
     }
+
+    boost::shared_ptr< ::ibv_srq > mkSrq(::ibv_pd* pd, int maxWr) {
+        ::ibv_srq_init_attr attr = {};
+        attr.attr.max_wr = maxWr;
+        attr.attr.max_sge = 1;
+        ::ibv_srq* srq = CHECK_NULL(::ibv_create_srq(pd, &attr));
+        return boost::shared_ptr< ::ibv_srq >(srq, destroySrq);
+    }
 }
@@ -35,6 +35,7 @@ namespace Rdma {
     boost::shared_ptr< ::ibv_mr > regMr(::ibv_pd* pd, void* addr, size_t length, ::ibv_access_flags access);
     boost::shared_ptr< ::ibv_comp_channel > mkCChannel(::ibv_context* c);
     boost::shared_ptr< ::ibv_cq > mkCq(::ibv_context* c, int cqe, void* context, ::ibv_comp_channel* cc);
+    boost::shared_ptr< ::ibv_srq > mkSrq(::ibv_pd* pd, int maxWr);
 }
 
 #endif // RDMA_FACTORIES_H
@@ -104,12 +104,95 @@ namespace Rdma {
         return b;
     }
 
-    QueuePair::QueuePair(boost::shared_ptr< ::rdma_cm_id > i) :
+    SharedRecvQueue::SharedRecvQueue(::ibv_context* verbs, int recvBufferCount, int bufferSize) :
+        pd(allocPd(verbs)),
+        freeCredit(0)
+    {
+        ::ibv_device_attr dev_attr;
+        CHECK(::ibv_query_device(verbs, &dev_attr));
+        if (recvBufferCount > dev_attr.max_srq_wr)
+            recvBufferCount = dev_attr.max_srq_wr;
+        srq = mkSrq(pd.get(), recvBufferCount);
+
+        // Round up buffersize to cacheline (64 bytes)
+        bufferSize = (bufferSize+63) & (~63);
+
+        // Allocate memory block for all receive buffers
+        char* mem = new char [recvBufferCount * bufferSize];
+        rmr = regMr(pd.get(), mem, recvBufferCount * bufferSize, ::IBV_ACCESS_LOCAL_WRITE);
+        recvBuffers.reserve(recvBufferCount);
+        for (int i = 0; i<recvBufferCount; ++i) {
+            // Allocate recv buffer
+            recvBuffers.push_back(Buffer(rmr->lkey, &mem[i*bufferSize], bufferSize));
+            postRecv(&recvBuffers[i]);
+        }
+        freeCredit = recvBufferCount;
+    }
+
+    SharedRecvQueue::~SharedRecvQueue() {
+        // Dispose of the receive queue before the buffers it holds
+        srq.reset();
+        if (rmr) delete [] static_cast<char*>(rmr->addr);
+    }
+
+    SharedRecvQueue::intrusive_ptr SharedRecvQueue::make(::ibv_context* verbs, int recvBufferCount, int bufferSize) {
+        return new SharedRecvQueue(verbs, recvBufferCount, bufferSize);
+    }
+
+    int SharedRecvQueue::bufferCount() const {
+        return recvBuffers.size();
+    }
+
+    int SharedRecvQueue::bufferSize() const {
+        return recvBuffers.empty() ? 0 : recvBuffers[0].byteCount();
+    }
+
+    void SharedRecvQueue::postRecv(Buffer* buf) {
+        ::ibv_recv_wr rwr = {};
+
+        rwr.wr_id = reinterpret_cast<uint64_t>(buf);
+        // We are given the whole buffer
+        buf->dataCount(buf->byteCount());
+        rwr.sg_list = &buf->sge;
+        rwr.num_sge = 1;
+
+        ::ibv_recv_wr* badrwr = 0;
+        CHECK(::ibv_post_srq_recv(srq.get(), &rwr, &badrwr));
+        if (badrwr)
+            throw std::logic_error("ibv_post_srq_recv(): Bad rwr");
+    }
+
+    void SharedRecvQueue::holdCredit(int n) {
+        qpid::sys::ScopedLock<qpid::sys::Mutex> l(creditLock);
+        freeCredit -= n;
+    }
+
+    int SharedRecvQueue::takeCredit(int n) {
+        qpid::sys::ScopedLock<qpid::sys::Mutex> l(creditLock);
+        if (n > freeCredit)
+            n = freeCredit > 0 ? freeCredit : 0;
+        freeCredit -= n;
+        return n;
+    }
+
+    void SharedRecvQueue::returnCredit(int n) {
+        qpid::sys::ScopedLock<qpid::sys::Mutex> l(creditLock);
+        freeCredit += n;
+    }
+
+    bool SharedRecvQueue::overcommitted() {
+        qpid::sys::ScopedLock<qpid::sys::Mutex> l(creditLock);
+        return freeCredit < 0;
+    }
+
+    QueuePair::QueuePair(boost::shared_ptr< ::rdma_cm_id > i, SharedRecvQueue::intrusive_ptr s) :
         qpid::sys::IOHandle(new qpid::sys::IOHandlePrivate),
-        pd(allocPd(i->verbs)),
+        // Queue pairs using a shared receive queue have to share its protection domain
+        pd(s ? s->pd : allocPd(i->verbs)),
         cchannel(mkCChannel(i->verbs)),
         scq(mkCq(i->verbs, DEFAULT_CQ_ENTRIES, 0, cchannel.get())),
         rcq(mkCq(i->verbs, DEFAULT_CQ_ENTRIES, 0, cchannel.get())),
+        srq(s),
         outstandingSendEvents(0),
         outstandingRecvEvents(0)
     {
@@ -133,6 +216,7 @@ namespace Rdma {
 
         qp_attr.send_cq      = scq.get();
         qp_attr.recv_cq      = rcq.get();
+        qp_attr.srq          = srq ? srq->srq.get() : 0;
         qp_attr.qp_type      = IBV_QPT_RC;
 
         CHECK(::rdma_create_qp(i.get(), pd.get(), &qp_attr));
@@ -206,6 +290,10 @@ namespace Rdma {
     {
         assert(!rmr);
 
+        // The shared receive queue already has its buffers
+        if (srq)
+            return;
+
         // Round up buffersize to cacheline (64 bytes)
         bufferSize = (bufferSize+63) & (~63);
 
@@ -220,6 +308,10 @@ namespace Rdma {
         }
     }
 
+    SharedRecvQueue::intrusive_ptr QueuePair::getSharedRecvQueue() const {
+        return srq;
+    }
+
     // Make channel non-blocking by making
     // associated fd nonblocking
     void QueuePair::nonblocking() {
@@ -272,6 +364,11 @@ namespace Rdma {
     }
 
     void QueuePair::postRecv(Buffer* buf) {
+        if (srq) {
+            srq->postRecv(buf);
+            return;
+        }
+
         ::ibv_recv_wr rwr = {};
 
         rwr.wr_id = reinterpret_cast<uint64_t>(buf);
@@ -385,14 +482,14 @@ namespace Rdma {
         id->context = 0;
     }
 
-    void Connection::ensureQueuePair() {
+    void Connection::ensureQueuePair(SharedRecvQueue::intrusive_ptr srq) {
         assert(id.get());
 
         // Only allocate a queue pair if there isn't one already
         if (qp)
             return;
 
-        qp = new QueuePair(id);
+        qp = new QueuePair(id, srq);
     }
 
     Connection::intrusive_ptr Connection::make() {
@@ -510,6 +607,19 @@ namespace Rdma {
         return qp;
     }
 
+    QueuePair::intrusive_ptr Connection::getQueuePair(SharedRecvQueue::intrusive_ptr srq) {
+        assert(id.get());
+
+        ensureQueuePair(srq);
+
+        return qp;
+    }
+
+    ::ibv_context* Connection::getVerbs() const {
+        assert(id.get());
+        return id->verbs;
+    }
+
     std::string Connection::getLocalName() const {
         ::sockaddr* addr = ::rdma_get_local_addr(id.get());
         char hostName[NI_MAXHOST];
@@ -50,6 +50,7 @@ namespace Rdma {
     struct Buffer {
         friend class QueuePair;
         friend class QueuePairEvent;
+        friend class SharedRecvQueue;
 
         char* bytes() const;
         int32_t byteCount() const;
@@ -113,6 +114,49 @@ namespace Rdma {
         Buffer* getBuffer() const;
     };
 
+    // Wrapper for a shared receive queue - a single set of registered
+    // receive buffers that all the queue pairs created with it take their
+    // incoming messages from. It also keeps count of the credit that the
+    // connections using it have given their peers, so that the total can be
+    // kept close to the number of buffers.
+    class SharedRecvQueue : public qpid::RefCounted {
+        friend class QueuePair;
+
+        boost::shared_ptr< ::ibv_pd > pd;
+        boost::shared_ptr< ::ibv_srq > srq;
+        boost::shared_ptr< ::ibv_mr > rmr;
+        std::vector<Buffer> recvBuffers;
+        qpid::sys::Mutex creditLock;
+        int freeCredit;
+
+        SharedRecvQueue(::ibv_context* verbs, int recvBufferCount, int bufferSize);
+        ~SharedRecvQueue();
+
+    public:
+        typedef boost::intrusive_ptr<SharedRecvQueue> intrusive_ptr;
+
+        // Create and post recvBufferCount buffers of bufferSize bytes for
+        // queue pairs on the device verbs
+        static intrusive_ptr make(::ibv_context* verbs, int recvBufferCount, int bufferSize);
+
+        int bufferCount() const;
+        int bufferSize() const;
+
+        void postRecv(Buffer* buf);
+
+        // Hold n credit whether or not the pool has it spare
+        void holdCredit(int n);
+
+        // Hold up to n credit from what is spare, returning the amount held
+        int takeCredit(int n);
+
+        // Give back n credit
+        void returnCredit(int n);
+
+        // True if more credit is held than there are buffers
+        bool overcommitted();
+    };
+
     // Wrapper for a queue pair - this has the functionality for
     // putting buffers on the receive queue and for sending buffers
     // to the other end of the connection.
@@ -126,6 +170,7 @@ namespace Rdma {
         boost::shared_ptr< ::ibv_cq > scq;
         boost::shared_ptr< ::ibv_cq > rcq;
         boost::shared_ptr< ::ibv_qp > qp;
+        SharedRecvQueue::intrusive_ptr srq;
         int outstandingSendEvents;
         int outstandingRecvEvents;
         std::vector<Buffer> sendBuffers;
@@ -133,7 +178,7 @@ namespace Rdma {
         qpid::sys::Mutex bufferLock;
         std::vector<int> freeBuffers;
 
-        QueuePair(boost::shared_ptr< ::rdma_cm_id > id);
+        QueuePair(boost::shared_ptr< ::rdma_cm_id > id, SharedRecvQueue::intrusive_ptr srq);
         ~QueuePair();
 
     public:
@@ -151,6 +196,9 @@ namespace Rdma {
         // Create and post recv buffers
         void allocateRecvBuffers(int recvBufferCount, int bufferSize);
 
+        // The shared receive queue this takes its messages from, if any
+        SharedRecvQueue::intrusive_ptr getSharedRecvQueue() const;
+
         // Make channel non-blocking by making
         // associated fd nonblocking
         void nonblocking();
@@ -211,7 +259,7 @@ namespace Rdma {
         Connection();
         ~Connection();
 
-        void ensureQueuePair();
+        void ensureQueuePair(SharedRecvQueue::intrusive_ptr srq = 0);
 
     public:
         typedef boost::intrusive_ptr<Connection> intrusive_ptr;
@@ -276,6 +324,13 @@ namespace Rdma {
         }
 
         QueuePair::intrusive_ptr getQueuePair();
+
+        // Get the queue pair, creating it to receive from srq if there
+        // isn't one yet
+        QueuePair::intrusive_ptr getQueuePair(SharedRecvQueue::intrusive_ptr srq);
+
+        // The device this connection uses, once its address is resolved
+        ::ibv_context* getVerbs() const;
         std::string getLocalName() const;
         std::string getPeerName() const;
         std::string getFullName() const { return getLocalName()+"-"+getPeerName(); }
@@ -0,0 +1,477 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "qpid/sys/shm/ShmIO.h"
+#include "qpid/log/Statement.h"
+#include "qpid/Exception.h"
+#include "qpid/Msg.h"
+
+#include <boost/bind.hpp>
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+namespace qpid {
+namespace sys {
+namespace shm {
+
+namespace {
+const uint32_t MAGIC = 0x51534d31;      // "QSM1"
+const int MAX_ROUNDS = 16;              // Passes through the rings before letting another handle run
+
+// Each index on a cache line of its own, as the two ends write different ones
+struct Index {
+    volatile uint32_t value;
+    char pad[64 - sizeof(uint32_t)];
+};
+
+// What the accepting end sends with the shared memory
+struct Hello {
+    uint32_t magic;
+    uint32_t ringSize;
+};
+
+size_t pageSize() {
+    return ::sysconf(_SC_PAGESIZE);
+}
+
+uint32_t load(const Index& i) {
+    uint32_t v = i.value;
+    __sync_synchronize();
+    return v;
+}
+
+void store(Index& i, uint32_t v) {
+    __sync_synchronize();
+    i.value = v;
+}
+
+// The abstract socket name leaves nothing in the filesystem to clean up
+socklen_t address(uint16_t port, ::sockaddr_un& addr) {
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::string name = QPID_MSG("qpidd-shm-" << port);
+    ::memcpy(addr.sun_path + 1, name.data(), name.size());
+    return offsetof(::sockaddr_un, sun_path) + 1 + name.size();
+}
+
+void setNonblocking(int fd) {
+    if (::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK) == -1)
+        throw ErrnoException("Cannot make shared memory connection socket non-blocking");
+}
+
+pid_t peerPid(int fd) {
+    ::ucred cred;
+    socklen_t len = sizeof(cred);
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 ? cred.pid : 0;
+}
+
+bool validRingSize(uint32_t size) {
+    return size >= AsynchIO::MIN_RING_SIZE && (size & (size - 1)) == 0 && size % pageSize() == 0;
+}
+}
+
+// At the start of the shared memory; ring i is written by end i
+struct Control {
+    Index head[2];              // Bytes written to ring i
+    Index tail[2];              // Bytes of ring i read by the other end
+    Index asleep[2];            // End i is waiting for a signal
+};
+
+AsynchIO* AsynchIO::create(int fd, uint32_t ringSize, ReadCallback rCb, IdleCallback iCb, ClosedCallback cCb)
+{
+    if (!validRingSize(ringSize))
+        throw Exception(QPID_MSG("Invalid shared memory ring size " << ringSize));
+    int segment = ::memfd_create("qpid-shm", MFD_CLOEXEC);
+    if (segment == -1) {
+        ::close(fd);
+        throw ErrnoException("Cannot create shared memory");
+    }
+    try {
+        if (::ftruncate(segment, pageSize() + 2 * size_t(ringSize)) == -1)
+            throw ErrnoException("Cannot size shared memory");
+
+        Hello hello = { MAGIC, ringSize };
+        ::iovec iov = { &hello, sizeof(hello) };
+        char buffer[CMSG_SPACE(sizeof(int))];
+        ::msghdr msg;
+        ::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = buffer;
+        msg.msg_controllen = sizeof(buffer);
+        ::cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        ::memcpy(CMSG_DATA(cmsg), &segment, sizeof(int));
+        // Cannot block: the socket is new and its buffer empty
+        if (::sendmsg(fd, &msg, MSG_NOSIGNAL) != ssize_t(sizeof(hello)))
+            throw ErrnoException("Cannot send shared memory");
+        setNonblocking(fd);
+
+        AsynchIO* aio = new AsynchIO(fd, 0, ringSize, segment, rCb, iCb, cCb);
+        ::close(segment);
+        return aio;
+    } catch (...) {
+        ::close(segment);
+        ::close(fd);
+        throw;
+    }
+}
+
+AsynchIO* AsynchIO::connect(uint16_t port, ReadCallback rCb, IdleCallback iCb, ClosedCallback cCb)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        throw ErrnoException("Cannot create shared memory connection socket");
+    int segment = -1;
+    try {
+        ::sockaddr_un addr;
+        socklen_t len = address(port, addr);
+        if (::connect(fd, reinterpret_cast< ::sockaddr*>(&addr), len) == -1)
+            throw ErrnoException(QPID_MSG("Cannot connect to shared memory transport on port " << port));
+
+        Hello hello;
+        ::iovec iov = { &hello, sizeof(hello) };
+        char buffer[CMSG_SPACE(sizeof(int))];
+        ::msghdr msg;
+        ::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = buffer;
+        msg.msg_controllen = sizeof(buffer);
+        ssize_t n;
+        do {
+            n = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+        } while (n == -1 && errno == EINTR);
+        if (n == -1)
+            throw ErrnoException("Cannot receive shared memory");
+        ::cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            ::memcpy(&segment, CMSG_DATA(cmsg), sizeof(int));
+        if (n != sizeof(hello) || segment == -1 || hello.magic != MAGIC)
+            throw Exception("Invalid shared memory handshake");
+        if (!validRingSize(hello.ringSize))
+            throw Exception(QPID_MSG("Invalid shared memory ring size " << hello.ringSize));
+        struct ::stat st;
+        if (::fstat(segment, &st) == -1 || size_t(st.st_size) != pageSize() + 2 * size_t(hello.ringSize))
+            throw Exception("Shared memory is not the size announced");
+        setNonblocking(fd);
+
+        AsynchIO* aio = new AsynchIO(fd, 1, hello.ringSize, segment, rCb, iCb, cCb);
+        ::close(segment);
+        return aio;
+    } catch (...) {
+        if (segment != -1) ::close(segment);
+        ::close(fd);
+        throw;
+    }
+}
+
+// The mapping is the control page followed by each ring's data
+// mapped twice over
+AsynchIO::AsynchIO(int f, int e, uint32_t size, int segment,
+                   ReadCallback rCb, IdleCallback iCb, ClosedCallback cCb) :
+    PosixIOHandle(f),
+    DispatchHandle(*this,
+                   boost::bind(&AsynchIO::readable, this, _1),
+                   0,
+                   boost::bind(&AsynchIO::disconnected, this, _1)),
+    readCallback(rCb),
+    idleCallback(iCb),
+    closedCallback(cCb),
+    fd(f),
+    end(e),
+    ringSize(size),
+    mappingSize(pageSize() + 4 * size_t(size)),
+    inTail(0),
+    outHead(0),
+    copy(size),
+    writeClosing(false),
+    peerGone(false),
+    closed(false)
+{
+    void* base = ::mmap(0, mappingSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        throw ErrnoException("Cannot map shared memory");
+    mapping = static_cast<char*>(base);
+    const size_t page = pageSize();
+    bool mapped = ::mmap(mapping, page, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, segment, 0) != MAP_FAILED;
+    for (int ring = 0; ring < 2 && mapped; ++ring) {
+        char* data = mapping + page + ring * 2 * size_t(size);
+        off_t offset = page + ring * size_t(size);
+        mapped = ::mmap(data, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, segment, offset) != MAP_FAILED &&
+            ::mmap(data + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, segment, offset) != MAP_FAILED;
+    }
+    if (!mapped) {
+        int err = errno;
+        ::munmap(mapping, mappingSize);
+        throw ErrnoException("Cannot map shared memory", err);
+    }
+    control = reinterpret_cast<Control*>(mapping);
+    out = mapping + page + end * 2 * size_t(size);
+    in = mapping + page + (1 - end) * 2 * size_t(size);
+    lastOutTail = 0;
+    identifier = QPID_MSG("shm:" << ::getpid() << "-" << peerPid(fd));
+}
+
+AsynchIO::~AsynchIO()
+{
+    ::munmap(mapping, mappingSize);
+    ::close(fd);
+}
+
+void AsynchIO::start(Poller::shared_ptr poller)
+{
+    startWatch(poller);
+    notifyPendingWrite();
+}
+
+void AsynchIO::notifyPendingWrite()
+{
+    call(boost::bind(&AsynchIO::processCallback, this, _1));
+}
+
+void AsynchIO::queueWriteClose()
+{
+    call(boost::bind(&AsynchIO::closeCallback, this, _1));
+}
+
+void AsynchIO::requestCallback(RequestCallback callback)
+{
+    call(boost::bind(&AsynchIO::requestedCall, this, _1, callback));
+}
+
+void AsynchIO::queueForDeletion()
+{
+    DispatchHandle::doDelete();
+}
+
+void AsynchIO::requestedCall(DispatchHandle&, RequestCallback callback)
+{
+    callback(*this);
+}
+
+void AsynchIO::processCallback(DispatchHandle&)
+{
+    process();
+}
+
+void AsynchIO::closeCallback(DispatchHandle&)
+{
+    writeClosing = true;
+    process();
+}
+
+// Signals carry no data, so just drain them
+void AsynchIO::readable(DispatchHandle&)
+{
+    char buffer[64];
+    for (;;) {
+        ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        if (n > 0) continue;
+        if (n == -1 && errno == EINTR) continue;
+        if (n == 0 || errno != EAGAIN) peerGone = true;
+        break;
+    }
+    process();
+}
+
+void AsynchIO::disconnected(DispatchHandle&)
+{
+    peerGone = true;
+    process();
+}
+
+void AsynchIO::process()
+{
+    if (closed) return;
+    control->asleep[end].value = 0;
+    for (int rounds = 0; ; ++rounds) {
+        bool progress = false;
+
+        uint32_t unread = load(control->head[1 - end]) - inTail;
+        if (unread > ringSize) {
+            corrupted("peer wrote more than the ring holds");
+            return;
+        }
+        if (unread) {
+            ::memcpy(&copy[0], in + (inTail & (ringSize - 1)), unread);
+            size_t n = readCallback(*this, &copy[0], unread);
+            assert(n <= unread);
+            if (n) {
+                inTail += n;
+                store(control->tail[1 - end], inTail);
+                progress = true;
+            }
+        }
+
+        bool wrote = false;
+        if (!peerGone) {
+            lastOutTail = load(control->tail[end]);
+            uint32_t used = outHead - lastOutTail;
+            if (used > ringSize) {
+                corrupted("peer read more than was written");
+                return;
+            }
+            uint32_t space = ringSize - used;
+            if (space) {
+                size_t n = idleCallback(*this, out + (outHead & (ringSize - 1)), space);
+                assert(n <= space);
+                if (n) {
+                    outHead += n;
+                    store(control->head[end], outHead);
+                    progress = wrote = true;
+                }
+            }
+        }
+
+        if (progress) signalPeer();
+        // Close only once the rings are at rest: the peer still reads
+        // what was written before it sees the socket close
+        if ((writeClosing && !wrote) || (peerGone && !progress)) {
+            close();
+            return;
+        }
+        if (!progress) {
+            control->asleep[end].value = 1;
+            __sync_synchronize();
+            if (!pending()) {
+                rewatchRead();
+                return;
+            }
+            control->asleep[end].value = 0;
+        } else if (rounds == MAX_ROUNDS) {
+            notifyPendingWrite();
+            return;
+        }
+    }
+}
+
+// Whether the peer wrote, or freed space, since we last looked
+bool AsynchIO::pending()
+{
+    return control->head[1 - end].value != inTail ||
+        control->tail[end].value != lastOutTail;
+}
+
+void AsynchIO::signalPeer()
+{
+    __sync_synchronize();
+    if (control->asleep[1 - end].value &&
+        __sync_bool_compare_and_swap(&control->asleep[1 - end].value, 1, 0)) {
+        static const char signal = 0;
+        if (::send(fd, &signal, 1, MSG_NOSIGNAL | MSG_DONTWAIT) == -1 && errno != EAGAIN)
+            peerGone = true;
+    }
+}
+
+void AsynchIO::corrupted(const char* reason)
+{
+    QPID_LOG(error, "Shared memory connection " << identifier << " is corrupt: " << reason);
+    close();
+}
+
+void AsynchIO::close()
+{
+    closed = true;
+    ::shutdown(fd, SHUT_RDWR);
+    QPID_LOG(debug, "Shared memory connection " << identifier << " closed");
+    if (closedCallback) closedCallback(*this);
+}
+
+namespace {
+// Port 0 tries ports from one derived from the pid, so that brokers
+// started together on one host do not all try the same ones
+int listenOn(uint16_t& port, int backlog)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        throw ErrnoException("Cannot create shared memory listening socket");
+    const uint16_t first = port ? port : 1024 + ::getpid() % (65536 - 1024);
+    uint16_t candidate = first;
+    for (;;) {
+        ::sockaddr_un addr;
+        socklen_t len = address(candidate, addr);
+        if (::bind(fd, reinterpret_cast< ::sockaddr*>(&addr), len) == 0) break;
+        int err = errno;
+        if (port == 0 && err == EADDRINUSE) {
+            candidate = candidate == 65535 ? 1024 : candidate + 1;
+            if (candidate != first) continue;
+        }
+        ::close(fd);
+        throw ErrnoException(QPID_MSG("Cannot listen for shared memory connections on port " << candidate), err);
+    }
+    if (::listen(fd, backlog) == -1) {
+        int err = errno;
+        ::close(fd);
+        throw ErrnoException(QPID_MSG("Cannot listen for shared memory connections on port " << candidate), err);
+    }
+    port = candidate;
+    return fd;
+}
+}
+
+Listener::Listener(uint16_t p, int backlog) :
+    port(p),
+    handle(listenOn(port, backlog)),
+    fd(IOHandlePrivate::fdOf(handle))
+{}
+
+Listener::~Listener()
+{
+    if (watch.get()) watch->stopWatch();
+    watch.reset();
+    ::close(fd);
+}
+
+void Listener::start(Poller::shared_ptr poller, ConnectedCallback cb)
+{
+    connected = cb;
+    watch.reset(new DispatchHandleRef(handle, boost::bind(&Listener::readable, this, _1), 0, 0));
+    watch->startWatch(poller);
+}
+
+void Listener::readable(DispatchHandle& h)
+{
+    for (;;) {
+        int s = ::accept4(fd, 0, 0, SOCK_CLOEXEC);
+        if (s == -1) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                QPID_LOG(error, "Cannot accept shared memory connection: " << strError(errno));
+            break;
+        }
+        connected(s);
+    }
+    h.rewatch();
+}
+
+}}} // namespace qpid::sys::shm
@@ -0,0 +1,163 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_SYS_SHM_SHMIO_H
+#define QPID_SYS_SHM_SHMIO_H
+
+#include "qpid/sys/DispatchHandle.h"
+#include "qpid/sys/IntegerTypes.h"
+#include "qpid/sys/Poller.h"
+#include "qpid/sys/posix/PrivatePosix.h"
+#include "qpid/CommonImportExport.h"
+
+#include <boost/function.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace qpid {
+namespace sys {
+namespace shm {
+
+struct Control;
+
+/**
+ * Asynchronous IO for a connection between two processes on one host
+ * through a pair of shared memory rings, one for each direction.
+ *
+ * Each ring has a single writer and a single reader. Its data area is
+ * mapped twice, back to back, so that any run of bytes in it is
+ * contiguous: the idle callback encodes straight into the ring. The
+ * read callback is given a private copy of the unread bytes, as the
+ * peer could change them while they were being decoded.
+ *
+ * Each end keeps its own indices to itself and trusts the peer's only
+ * as far as they agree with them: a peer that claims to have written,
+ * or read, more than a ring holds is disconnected.
+ *
+ * The ends signal each other through the Unix domain socket that
+ * carried the shared memory when they connected. An end with nothing
+ * to do marks itself asleep in shared memory and goes back to the
+ * poller; the other end writes a byte to the socket only when it sees
+ * that mark, so while both ends are busy data moves without system
+ * calls. The socket also tells each end when the other goes away.
+ */
+class AsynchIO : private PosixIOHandle, private DispatchHandle {
+  public:
+    /** Called with unread bytes; returns how many it consumed */
+    typedef boost::function3<size_t, AsynchIO&, const char*, size_t> ReadCallback;
+    /** Called with free space in the ring; returns how many bytes it wrote */
+    typedef boost::function3<size_t, AsynchIO&, char*, size_t> IdleCallback;
+    typedef boost::function1<void, AsynchIO&> ClosedCallback;
+    typedef boost::function1<void, AsynchIO&> RequestCallback;
+
+    /**
+     * Create the shared memory for a connection accepted by a Listener
+     * and pass it to the connecting end.
+     *@param ringSize size of each ring, a power of two of at least MIN_RING_SIZE
+     */
+    QPID_COMMON_EXTERN static AsynchIO* create(int fd, uint32_t ringSize,
+                                               ReadCallback rCb, IdleCallback iCb, ClosedCallback cCb);
+
+    /** Connect to a Listener on this host, waiting for its shared memory */
+    QPID_COMMON_EXTERN static AsynchIO* connect(uint16_t port,
+                                                ReadCallback rCb, IdleCallback iCb, ClosedCallback cCb);
+
+    /** Smallest ring that holds a frame of the largest size */
+    static const uint32_t MIN_RING_SIZE = 128 * 1024;
+
+    QPID_COMMON_EXTERN void start(Poller::shared_ptr poller);
+    /** Ask for the idle callback to be made */
+    QPID_COMMON_EXTERN void notifyPendingWrite();
+    /** Close once the idle callback has nothing more to write */
+    QPID_COMMON_EXTERN void queueWriteClose();
+    QPID_COMMON_EXTERN void requestCallback(RequestCallback);
+    /** Delete once no callback is running; only after the closed callback */
+    QPID_COMMON_EXTERN void queueForDeletion();
+
+    const std::string& getIdentifier() const { return identifier; }
+
+  private:
+    ReadCallback readCallback;
+    IdleCallback idleCallback;
+    ClosedCallback closedCallback;
+    const int fd;
+    const int end;              // 0 for the accepting end, 1 for the connecting end
+    const uint32_t ringSize;
+    char* mapping;
+    size_t mappingSize;
+    Control* control;
+    const char* in;
+    char* out;
+    uint32_t inTail;            // Bytes of the peer's ring read
+    uint32_t outHead;           // Bytes written to our ring
+    uint32_t lastOutTail;       // Space freed by the peer as of the last idle callback
+    std::vector<char> copy;     // What is decoded, out of the peer's reach
+    bool writeClosing;
+    bool peerGone;
+    bool closed;
+    std::string identifier;
+
+    AsynchIO(int fd, int end, uint32_t ringSize, int segment,
+             ReadCallback rCb, IdleCallback iCb, ClosedCallback cCb);
+    ~AsynchIO();
+
+    void readable(DispatchHandle&);
+    void disconnected(DispatchHandle&);
+    void processCallback(DispatchHandle&);
+    void closeCallback(DispatchHandle&);
+    void requestedCall(DispatchHandle&, RequestCallback);
+    void process();
+    bool pending();
+    void signalPeer();
+    void corrupted(const char* reason);
+    void close();
+};
+
+/**
+ * Listens for connections from shm::AsynchIO::connect() on an abstract
+ * Unix domain socket named for the given port.
+ */
+class Listener {
+  public:
+    typedef boost::function1<void, int> ConnectedCallback;
+
+    /** Port 0 picks a port no other Listener on this host is using */
+    QPID_COMMON_EXTERN Listener(uint16_t port, int backlog);
+    QPID_COMMON_EXTERN ~Listener();
+
+    uint16_t getPort() const { return port; }
+
+    /** Start accepting; @a connected is given each new socket */
+    QPID_COMMON_EXTERN void start(Poller::shared_ptr poller, ConnectedCallback connected);
+
+  private:
+    uint16_t port;
+    PosixIOHandle handle;
+    const int fd;
+    ConnectedCallback connected;
+    std::auto_ptr<DispatchHandleRef> watch;
+
+    void readable(DispatchHandle&);
+};
+
+}}} // namespace qpid::sys::shm
+
+#endif  /*!QPID_SYS_SHM_SHMIO_H*/
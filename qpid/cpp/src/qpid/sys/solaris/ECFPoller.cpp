@@ -134,6 +134,10 @@ PollerHandle::~PollerHandle() {
     PollerHandleDeletionManager.markForDeletion(impl);
 }
 
+// Handles are always re-associated after each event here
+void PollerHandle::setEdgeTriggered() {
+}
+
 /**
  * Concrete implementation of Poller to use the Solaris Event Completion
  * Framework interface
@@ -437,6 +441,10 @@ Poller::Poller() :
     impl(new PollerPrivate())
 {}
 
+Poller::Poller(int, bool, bool, Duration, bool) :
+    impl(new PollerPrivate())
+{}
+
 Poller::~Poller() {
     delete impl;
 }
@@ -71,7 +71,8 @@ __thread int64_t threadMaxReadTimeNs = 2 * 1000000; // start at 2ms
 SslAcceptor::SslAcceptor(const SslSocket& s, Callback callback) :
     acceptedCallback(callback),
     handle(s, boost::bind(&SslAcceptor::readable, this, _1), 0, 0),
-    socket(s) {
+    socket(s),
+    paused(false) {
 
     s.setNonblocking();
     ignoreSigpipe();
@@ -86,12 +87,28 @@ void SslAcceptor::start(Poller::shared_ptr poller) {
     handle.startWatch(poller);
 }
 
+void SslAcceptor::pause() {
+    paused = true;
+}
+
+void SslAcceptor::resume() {
+    paused = false;
+    handle.rewatch();
+}
+
 /*
  * We keep on accepting as long as there is something to accept
  */
 void SslAcceptor::readable(DispatchHandle& h) {
     SslSocket* s;
     do {
+        if (paused) {
+            h.unwatch();
+            // As for SslIO::writePending: resume() may have run since
+            // the test above and its rewatch been undone by ours.
+            if (!paused) h.rewatch();
+            return;
+        }
         errno = 0;
         // TODO: Currently we ignore the peers address, perhaps we should
         // log it or use it for connection acceptance.
@@ -349,6 +366,7 @@ void SslIO::writeable(DispatchHandle& h) {
             // Write buffer
             BufferBase* buff = writeQueue.back();
             writeQueue.pop_back();
+            coalesce(buff);
             errno = 0;
             assert(buff->dataStart+buff->dataCount <= buff->byteCount);
             int rc = socket.write(buff->bytes+buff->dataStart, buff->dataCount);
@@ -418,6 +436,27 @@ void SslIO::writeable(DispatchHandle& h) {
     return;
 }
         
+/*
+ * Move the data of the buffers queued behind buff into it while it has
+ * room. NSS makes at least one TLS record per write, so this turns a run
+ * of small frames into one write of full sized records.
+ */
+void SslIO::coalesce(BufferBase* buff) {
+    while (!writeQueue.empty()) {
+        BufferBase* next = writeQueue.back();
+        if (next->dataCount > buff->byteCount - buff->dataCount)
+            return;
+        if (buff->dataStart + buff->dataCount + next->dataCount > buff->byteCount) {
+            memmove(buff->bytes, buff->bytes+buff->dataStart, buff->dataCount);
+            buff->dataStart = 0;
+        }
+        memcpy(buff->bytes+buff->dataStart+buff->dataCount, next->bytes+next->dataStart, next->dataCount);
+        buff->dataCount += next->dataCount;
+        writeQueue.pop_back();
+        queueReadBuffer(next);
+    }
+}
+
 void SslIO::disconnected(DispatchHandle& h) {
     // If we've already queued close do it instead of disconnected callback
     if (queuedClose) {
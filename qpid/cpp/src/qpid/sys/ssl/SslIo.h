@@ -45,12 +45,18 @@ private:
     Callback acceptedCallback;
     qpid::sys::DispatchHandle handle;
     const SslSocket& socket;
+    volatile bool paused;
 
 public:
     SslAcceptor(const SslSocket& s, Callback callback);
     ~SslAcceptor();
     void start(qpid::sys::Poller::shared_ptr poller);
 
+    /** Stop accepting, leaving new connections in the listen backlog.
+     * May be called from the accepted callback or any other thread. */
+    void pause();
+    void resume();
+
 private:
     void readable(qpid::sys::DispatchHandle& handle);
 };
@@ -163,6 +169,7 @@ private:
     ~SslIO();
     void readable(qpid::sys::DispatchHandle& handle);
     void writeable(qpid::sys::DispatchHandle& handle);
+    void coalesce(BufferBase* buff);
     void disconnected(qpid::sys::DispatchHandle& handle);
     void close(qpid::sys::DispatchHandle& handle);
 };
@@ -22,6 +22,7 @@
 #include "qpid/sys/ssl/SslSocket.h"
 #include "qpid/sys/ssl/check.h"
 #include "qpid/sys/ssl/util.h"
+#include "qpid/sys/Time.h"
 #include "qpid/Exception.h"
 #include "qpid/sys/posix/check.h"
 #include "qpid/sys/posix/PrivatePosix.h"
@@ -137,6 +138,7 @@ SslSocket::SslSocket() : IOHandle(new IOHandlePrivate()), socket(0), prototype(0
     impl->fd = ::socket (PF_INET, SOCK_STREAM, 0);
     if (impl->fd < 0) throw QPID_POSIX_ERROR(errno);
     socket = SSL_ImportFD(0, PR_ImportTCPSocket(impl->fd));
+    NSS_CHECK(SSL_OptionSet(socket, SSL_NO_CACHE, !SslOptions::global.sessionCache));
 }
 
 /**
@@ -175,6 +177,9 @@ void SslSocket::connect(const std::string& host, const std::string& port) const
     }
     NSS_CHECK(SSL_GetClientAuthDataHook(socket, NSS_GetClientAuthData, arg));
     NSS_CHECK(SSL_SetURL(socket, host.data()));
+    // Sessions are resumed only for the same peer and client certificate
+    std::string peerId = connectname + "/" + (arg ? static_cast<const char*>(arg) : "");
+    NSS_CHECK(SSL_SetSockPeerID(socket, const_cast<char*>(peerId.c_str())));
 
     char hostBuffer[PR_NETDB_BUF_SIZE];
     PRHostEnt hostEntry;
@@ -190,6 +195,11 @@ void SslSocket::connect(const std::string& host, const std::string& port) const
     NSS_CHECK(SSL_ForceHandshake(socket));
 }
 
+void SslSocket::handshake(const Duration& timeout) const
+{
+    NSS_CHECK(SSL_ForceHandshakeWithTimeout(socket, PR_MillisecondsToInterval(timeout/TIME_MSEC)));
+}
+
 void SslSocket::close() const
 {
     if (impl->fd > 0) {
@@ -202,6 +212,7 @@ int SslSocket::listen(uint16_t port, int backlog, const std::string& certName, b
 {
     //configure prototype socket:
     prototype = SSL_ImportFD(0, PR_NewTCPSocket());
+    NSS_CHECK(SSL_OptionSet(prototype, SSL_NO_CACHE, !SslOptions::global.sessionCache));
     if (clientAuth) {
         NSS_CHECK(SSL_OptionSet(prototype, SSL_REQUEST_CERTIFICATE, PR_TRUE));
         NSS_CHECK(SSL_OptionSet(prototype, SSL_REQUIRE_CERTIFICATE, PR_TRUE));
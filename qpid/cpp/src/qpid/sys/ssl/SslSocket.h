@@ -71,6 +71,12 @@ public:
      */
     SslSocket* accept() const;
 
+    /**
+     * Complete the handshake on an accepted (still blocking) socket.
+     *@exception if it fails or takes longer than timeout.
+     */
+    void handshake(const Duration& timeout) const;
+
     // TODO The following are raw operations, maybe they need better wrapping?
     int read(void *buf, size_t count) const;
     int write(const void *buf, size_t count) const;
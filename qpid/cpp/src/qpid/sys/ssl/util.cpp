@@ -52,13 +52,19 @@ std::string defaultCertName()
 
 SslOptions::SslOptions() : qpid::Options("SSL Settings"), 
                            certName(defaultCertName()),
-                           exportPolicy(false)
+                           exportPolicy(false),
+                           sessionCache(true),
+                           sessionCacheSize(0),
+                           sessionTimeout(0)
 {
     addOptions()
         ("ssl-use-export-policy", optValue(exportPolicy), "Use NSS export policy")
         ("ssl-cert-password-file", optValue(certPasswordFile, "PATH"), "File containing password to use for accessing certificate database")
         ("ssl-cert-db", optValue(certDbPath, "PATH"), "Path to directory containing certificate database")
-        ("ssl-cert-name", optValue(certName, "NAME"), "Name of the certificate to use");
+        ("ssl-cert-name", optValue(certName, "NAME"), "Name of the certificate to use")
+        ("ssl-session-cache", optValue(sessionCache, "yes|no"), "Cache SSL sessions so that a reconnecting client can resume one instead of making a full handshake")
+        ("ssl-session-cache-size", optValue(sessionCacheSize, "N"), "Most sessions kept in a server's SSL session cache, 0 for the NSS default")
+        ("ssl-session-timeout", optValue(sessionTimeout, "SECONDS"), "Time for which a cached SSL session can be resumed by a server, 0 for the NSS default");
 }
 
 SslOptions& SslOptions::operator=(const SslOptions& o) 
@@ -67,6 +73,9 @@ SslOptions& SslOptions::operator=(const SslOptions& o)
     certName = o.certName;
     certPasswordFile = o.certPasswordFile;
     exportPolicy = o.exportPolicy;
+    sessionCache = o.sessionCache;
+    sessionCacheSize = o.sessionCacheSize;
+    sessionTimeout = o.sessionTimeout;
     return *this;
 }
 
@@ -106,9 +115,9 @@ void initNSS(const SslOptions& options, bool server)
     } else {
         NSS_CHECK(NSS_SetDomesticPolicy());
     }
-    if (server) {
-        //use defaults for all args, TODO: may want to make this configurable
-        SSL_ConfigServerSessionIDCache(0, 0, 0, 0);
+    if (server && options.sessionCache) {
+        NSS_CHECK(SSL_ConfigServerSessionIDCache(options.sessionCacheSize, options.sessionTimeout,
+                                                 options.sessionTimeout, 0));
     }
 }
 
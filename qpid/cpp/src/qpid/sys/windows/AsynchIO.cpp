@@ -22,6 +22,7 @@
 #include "qpid/sys/windows/AsynchIoResult.h"
 #include "qpid/sys/windows/IoHandlePrivate.h"
 #include "qpid/sys/AsynchIO.h"
+#include "qpid/sys/AtomicValue.h"
 #include "qpid/sys/Mutex.h"
 #include "qpid/sys/Socket.h"
 #include "qpid/sys/Poller.h"
@@ -45,6 +46,9 @@ namespace {
 
     typedef qpid::sys::ScopedLock<qpid::sys::Mutex>  QLock;
 
+qpid::sys::AtomicValue<uint64_t> acceptedTotal;
+qpid::sys::AtomicValue<uint32_t> acceptedSinceStats;
+
 /*
  * The function pointers for AcceptEx and ConnectEx need to be looked up
  * at run time.
@@ -146,6 +150,8 @@ void AsynchAcceptResult::success(size_t /*bytesTransferred*/) {
                   SO_UPDATE_ACCEPT_CONTEXT,
                   (char*)&listener,
                   sizeof (listener));
+    acceptedTotal += 1;
+    acceptedSinceStats.boolCompareAndSwap(0, 1);
     callback(*(newSocket.release()));
     acceptor->restart ();
     delete this;
@@ -212,6 +218,13 @@ AsynchAcceptor* AsynchAcceptor::create(const Socket& s,
     return new windows::AsynchAcceptor(s, callback);
 }
 
+// AcceptEx completes one connection at a time
+void AsynchAcceptor::getStats(Stats& stats)
+{
+    stats.accepted = acceptedTotal.get();
+    stats.largestBatch = acceptedSinceStats.boolCompareAndSwap(1, 0) ? 1 : 0;
+}
+
 AsynchConnector* qpid::sys::AsynchConnector::create(const Socket& s,
                                                     const std::string& hostname,
                                                     const std::string& port,
@@ -289,8 +302,11 @@ private:
 
     // Number of outstanding I/O operations.
     volatile LONG opsInProgress;
-    // Is there a write in progress?
-    volatile bool writeInProgress;
+    // Number of overlapped writes posted to the socket and not yet complete.
+    // Overlapped sends on a stream socket complete in the order posted, so
+    // keeping several in flight keeps the socket busy between completions.
+    volatile LONG writesInProgress;
+    static const LONG MAX_WRITES_IN_PROGRESS = 4;
     // Deletion requested, but there are callbacks in progress.
     volatile bool queuedDelete;
     // Socket close requested, but there are operations in progress.
@@ -350,8 +366,9 @@ private:
 class CallbackHandle : public IOHandle {
 public:
     CallbackHandle(AsynchIoResult::Completer completeCb,
-                   AsynchIO::RequestCallback reqCb = 0) :
-    IOHandle(new IOHandlePrivate (INVALID_SOCKET, completeCb, reqCb))
+                   AsynchIO::RequestCallback reqCb = 0,
+                   SOCKET affinity = INVALID_SOCKET) :
+    IOHandle(new IOHandlePrivate (INVALID_SOCKET, completeCb, reqCb, affinity))
     {}
 };
 
@@ -371,7 +388,7 @@ AsynchIO::AsynchIO(const Socket& s,
     idleCallback(iCb),
     socket(s),
     opsInProgress(0),
-    writeInProgress(false),
+    writesInProgress(0),
     queuedDelete(false),
     queuedClose(false),
     working(false) {
@@ -434,7 +451,7 @@ void AsynchIO::queueWrite(AsynchIO::BufferBase* buff) {
     assert(buff);
     QLock l(bufferQueueLock);
     writeQueue.push_back(buff);
-    if (!writeInProgress)
+    if (writesInProgress < MAX_WRITES_IN_PROGRESS)
         notifyPendingWrite();
 }
 
@@ -446,13 +463,14 @@ void AsynchIO::notifyPendingWrite() {
         return;
 
     InterlockedIncrement(&opsInProgress);
-    PollerHandle ph(CallbackHandle(boost::bind(&AsynchIO::completion, this, _1)));
+    PollerHandle ph(CallbackHandle(boost::bind(&AsynchIO::completion, this, _1),
+                                   0, toSocketHandle(socket)));
     poller->monitorHandle(ph, Poller::OUTPUT);
 }
 
 void AsynchIO::queueWriteClose() {
     queuedClose = true;
-    if (!writeInProgress)
+    if (writesInProgress == 0)
         notifyPendingWrite();
 }
 
@@ -531,7 +549,7 @@ void AsynchIO::requestCallback(RequestCallback callback) {
     InterlockedIncrement(&opsInProgress);
     PollerHandle ph(CallbackHandle(
         boost::bind(&AsynchIO::completion, this, _1),
-        callback));
+        callback, toSocketHandle(socket)));
     poller->monitorHandle(ph, Poller::INPUT);
 }
 
@@ -580,7 +598,7 @@ void AsynchIO::notifyIdle(void) {
  */
 
 void AsynchIO::startWrite(AsynchIO::BufferBase* buff) {
-    writeInProgress = true;
+    InterlockedIncrement(&writesInProgress);
     InterlockedIncrement(&opsInProgress);
     AsynchWriteResult *result =
         new AsynchWriteResult(boost::bind(&AsynchIO::completion, this, _1),
@@ -645,10 +663,13 @@ void AsynchIO::writeComplete(AsynchWriteResult *result) {
     size_t bytes = result->getTransferred();
     AsynchIO::BufferBase *buff = result->getBuff();
     if (buff != 0) {
-        writeInProgress = false;
+        LONG others = InterlockedDecrement(&writesInProgress);
         if (status == 0 && bytes > 0) {
-            if (bytes < result->getRequested()) // Still more to go; resubmit
-                startWrite(buff);
+            // Windows only completes an overlapped send short when the
+            // connection is failing. Resubmitting the rest is safe only if
+            // no later write is already in flight ahead of it.
+            if (bytes < result->getRequested() && others == 0)
+                startWrite(buff);          // Still more to go; resubmit
             else
                 queueReadBuffer(buff);     // All done; back to the pool
         }
@@ -659,14 +680,15 @@ void AsynchIO::writeComplete(AsynchWriteResult *result) {
         }
     }
 
-    // If there are no writes outstanding, check for more writes to initiate
-    // (either queued or via idle). The opsInProgress count is handled in
-    // completion()
-    if (!writeInProgress) {
+    // Fill the free write slots from the queue; if there are no writes
+    // outstanding and nothing queued, ask for more via idle. The
+    // opsInProgress count is handled in completion()
+    if (writesInProgress < MAX_WRITES_IN_PROGRESS) {
         bool writing = false;
         {
             QLock l(bufferQueueLock);
-            if (writeQueue.size() > 0) {
+            while (writeQueue.size() > 0 &&
+                   writesInProgress < MAX_WRITES_IN_PROGRESS) {
                 buff = writeQueue.front();
                 assert(buff);
                 writeQueue.pop_front();
@@ -674,7 +696,7 @@ void AsynchIO::writeComplete(AsynchWriteResult *result) {
                 writing = true;
             }
         }
-        if (!writing && !queuedClose) {
+        if (!writing && writesInProgress == 0 && !queuedClose) {
             notifyIdle();
         }
     }
@@ -38,6 +38,9 @@ namespace sys {
 // completer from an I/O thread. If the callback mechanism is used, there
 // can be a RequestCallback set - this carries the callback object through
 // from AsynchIO::requestCallback() through to the I/O completion processing.
+// A callback handle may name the socket it acts for as its affinity so the
+// poller injects the completion into the same completion port as the
+// socket's own I/O.
 class IOHandlePrivate {
     friend QPID_COMMON_EXTERN SOCKET toSocketHandle(const Socket& s);
     static IOHandlePrivate* getImpl(const IOHandle& h);
@@ -45,13 +48,15 @@ class IOHandlePrivate {
 public:
     IOHandlePrivate(SOCKET f = INVALID_SOCKET,
                     windows::AsynchIoResult::Completer cb = 0,
-                    AsynchIO::RequestCallback reqCallback = 0) :
-    fd(f), event(cb), cbRequest(reqCallback)
+                    AsynchIO::RequestCallback reqCallback = 0,
+                    SOCKET a = INVALID_SOCKET) :
+    fd(f), event(cb), cbRequest(reqCallback), affinity(a)
     {}
     
     SOCKET fd;
     windows::AsynchIoResult::Completer event;
     AsynchIO::RequestCallback cbRequest;
+    SOCKET affinity;
 };
 
 QPID_COMMON_EXTERN SOCKET toSocketHandle(const Socket& s);
@@ -37,6 +37,14 @@
 namespace qpid {
 namespace sys {
 
+namespace {
+// Completion port served by the current thread, set on entry to run()
+__declspec(thread) int threadPortIndex = 0;
+
+// Completions taken from the port by one GetQueuedCompletionStatusEx call
+const ULONG BATCH_COMPLETIONS = 64;
+}
+
 class PollerHandlePrivate {
     friend class Poller;
     friend class PollerHandle;
@@ -44,51 +52,85 @@ class PollerHandlePrivate {
     SOCKET fd;
     windows::AsynchIoResult::Completer cb;
     AsynchIO::RequestCallback cbRequest;
+    SOCKET affinity;
 
     PollerHandlePrivate(SOCKET f,
                         windows::AsynchIoResult::Completer cb0 = 0,
-                        AsynchIO::RequestCallback rcb = 0)
-      : fd(f), cb(cb0), cbRequest(rcb)
+                        AsynchIO::RequestCallback rcb = 0,
+                        SOCKET a = INVALID_SOCKET)
+      : fd(f), cb(cb0), cbRequest(rcb), affinity(a)
     {
     }
     
 };
 
 PollerHandle::PollerHandle(const IOHandle& h) :
-  impl(new PollerHandlePrivate(toSocketHandle(static_cast<const Socket&>(h)), h.impl->event, h.impl->cbRequest))
+  impl(new PollerHandlePrivate(toSocketHandle(static_cast<const Socket&>(h)), h.impl->event,
+                               h.impl->cbRequest, h.impl->affinity))
 {}
 
 PollerHandle::~PollerHandle() {
     delete impl;
 }
 
+// Completion ports have no readiness events to re-arm
+void PollerHandle::setEdgeTriggered() {
+}
+
 /**
  * Concrete implementation of Poller to use the Windows I/O Completion
  * port (IOCP) facility.
+ *
+ * With several poll sets there is one completion port per set. A socket
+ * and the completions injected on its behalf always go to the same port,
+ * chosen from the socket handle, so one connection's work stays with the
+ * threads serving that port.
  */
 class PollerPrivate {
     friend class Poller;
-    
-    const HANDLE iocp;
 
-    // The number of threads running the event loop.
-    volatile LONG threadsRunning;
+    struct Port {
+        HANDLE iocp;
+        // The number of threads running the event loop on this port.
+        volatile LONG threadsRunning;
+
+        Port() :
+            iocp(::CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0)),
+            threadsRunning(0) {
+            QPID_WINDOWS_CHECK_NULL(iocp);
+        }
+    };
+
+    std::vector<Port> ports;
+
+    // Hands each thread entering run() its port.
+    volatile LONG threadIndex;
 
     // Shutdown request is handled by setting isShutdown and injecting a
-    // well-formed completion event into the iocp.
+    // well-formed completion event into each iocp.
     bool isShutdown;
 
-    PollerPrivate() :
-        iocp(::CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0)),
-        threadsRunning(0),
+    PollerPrivate(int portCount = 1) :
+        threadIndex(0),
         isShutdown(false) {
-        QPID_WINDOWS_CHECK_NULL(iocp);
+        for (int i = 0; i < portCount; ++i)
+            ports.push_back(Port());
     }
 
     ~PollerPrivate() {
         // It's probably okay to ignore any errors here as there can't be
         // data loss
-        ::CloseHandle(iocp);
+        for (size_t i = 0; i < ports.size(); ++i)
+            ::CloseHandle(ports[i].iocp);
+    }
+
+    // Socket handles are multiples of 4; drop the low bits before spreading
+    Port& portFor(SOCKET s) {
+        return ports[(static_cast<size_t>(s) >> 2) % ports.size()];
+    }
+
+    Port& threadPort() {
+        return ports[threadPortIndex % ports.size()];
     }
 };
 
@@ -97,7 +139,8 @@ void Poller::shutdown() {
     if (impl->isShutdown)
         return;
     ULONG_PTR key = 1;    // Tell wait() it's a shutdown, not I/O
-    PostQueuedCompletionStatus(impl->iocp, 0, key, 0);
+    for (size_t i = 0; i < impl->ports.size(); ++i)
+        PostQueuedCompletionStatus(impl->ports[i].iocp, 0, key, 0);
 }
 
 bool Poller::hasShutdown()
@@ -110,6 +153,7 @@ bool Poller::interrupt(PollerHandle&) {
 }
 
 void Poller::run() {
+    threadPortIndex = InterlockedIncrement(&impl->threadIndex) - 1;
     do {
         Poller::Event event = this->wait();
 
@@ -130,23 +174,25 @@ void Poller::run() {
 void Poller::monitorHandle(PollerHandle& handle, Direction dir) {
     HANDLE h = (HANDLE)(handle.impl->fd);
     if (h != INVALID_HANDLE_VALUE) {
-        HANDLE iocpHandle = ::CreateIoCompletionPort (h, impl->iocp, 0, 0);
+        HANDLE iocpHandle = ::CreateIoCompletionPort (h, impl->portFor(handle.impl->fd).iocp, 0, 0);
         QPID_WINDOWS_CHECK_NULL(iocpHandle);
     }
     else {
         // INPUT is used to request a callback; OUTPUT to request a write
         assert(dir == Poller::INPUT || dir == Poller::OUTPUT);
+        HANDLE iocp = handle.impl->affinity != INVALID_SOCKET ?
+            impl->portFor(handle.impl->affinity).iocp : impl->threadPort().iocp;
 
         if (dir == Poller::OUTPUT) {
             windows::AsynchWriteWanted *result =
                 new windows::AsynchWriteWanted(handle.impl->cb);
-            PostQueuedCompletionStatus(impl->iocp, 0, 0, result->overlapped());
+            PostQueuedCompletionStatus(iocp, 0, 0, result->overlapped());
         }
         else {
             windows::AsynchCallbackRequest *result =
                 new windows::AsynchCallbackRequest(handle.impl->cb,
                                                    handle.impl->cbRequest);
-            PostQueuedCompletionStatus(impl->iocp, 0, 0, result->overlapped());
+            PostQueuedCompletionStatus(iocp, 0, 0, result->overlapped());
         }
     }
 }
@@ -158,10 +204,10 @@ void Poller::unregisterHandle(PollerHandle& /*handle*/) {}
 
 Poller::Event Poller::wait(Duration timeout) {
     DWORD timeoutMs = 0;
-    DWORD numTransferred = 0;
-    ULONG_PTR completionKey = 0;
-    OVERLAPPED *overlapped = 0;
+    ULONG removed = 0;
+    OVERLAPPED_ENTRY entries[BATCH_COMPLETIONS];
     windows::AsynchResult *result = 0;
+    bool shutdown = false;
 
     // Wait for either an I/O operation to finish (thus signaling the
     // IOCP handle) or a shutdown request to be made (thus signaling the
@@ -171,37 +217,42 @@ Poller::Event Poller::wait(Duration timeout) {
     else
         timeoutMs = static_cast<DWORD>(timeout / TIME_MSEC);
 
-    InterlockedIncrement(&impl->threadsRunning);
-    bool goodOp = ::GetQueuedCompletionStatus (impl->iocp,
-                                               &numTransferred,
-                                               &completionKey,
-                                               &overlapped,
-                                               timeoutMs);
-    LONG remainingThreads = InterlockedDecrement(&impl->threadsRunning);
-    if (goodOp) {
-        // Dequeued a successful completion. If it's a posted packet from
-        // shutdown() the overlapped ptr is 0 and key is 1. Else downcast
-        // the OVERLAPPED pointer to an AsynchIoResult and call the
-        // completion handler.
-        if (overlapped == 0 && completionKey == 1) {
-            // If there are other threads still running this wait, re-post
-            // the completion.
-            if (remainingThreads > 0)
-                PostQueuedCompletionStatus(impl->iocp, 0, completionKey, 0);
-            return Event(0, SHUTDOWN);
+    PollerPrivate::Port& port = impl->threadPort();
+    InterlockedIncrement(&port.threadsRunning);
+    bool goodOp = ::GetQueuedCompletionStatusEx (port.iocp,
+                                                 entries,
+                                                 BATCH_COMPLETIONS,
+                                                 &removed,
+                                                 timeoutMs,
+                                                 FALSE);
+    LONG remainingThreads = InterlockedDecrement(&port.threadsRunning);
+    if (!goodOp)
+        removed = 0;    // Timed out; no completions were dequeued
+    for (ULONG i = 0; i < removed; ++i) {
+        OVERLAPPED *overlapped = entries[i].lpOverlapped;
+        // If it's a posted packet from shutdown() the overlapped ptr is 0
+        // and key is 1. Finish the rest of the batch before returning.
+        if (overlapped == 0) {
+            if (entries[i].lpCompletionKey == 1)
+                shutdown = true;
+            continue;
         }
 
+        // Downcast the OVERLAPPED pointer to an AsynchIoResult and call the
+        // completion handler. A failed operation leaves its NTSTATUS in
+        // Internal; completion handlers only test the status against 0.
         result = windows::AsynchResult::from_overlapped(overlapped);
-        result->success (static_cast<size_t>(numTransferred));
+        if (overlapped->Internal == 0)
+            result->success (static_cast<size_t>(entries[i].dwNumberOfBytesTransferred));
+        else
+            result->failure (static_cast<int>(overlapped->Internal));
     }
-    else {
-      if (overlapped != 0) {
-        // Dequeued a completion for a failed operation. Downcast back
-        // to the result object and inform it that the operation failed.
-        DWORD status = ::GetLastError();
-        result = windows::AsynchResult::from_overlapped(overlapped);
-        result->failure (static_cast<int>(status));
-      }
+    if (shutdown) {
+        // If there are other threads still running this wait, re-post
+        // the completion.
+        if (remainingThreads > 0)
+            PostQueuedCompletionStatus(port.iocp, 0, 1, 0);
+        return Event(0, SHUTDOWN);
     }
     return Event(0, INVALID);   // TODO - this may need to be changed.
 
@@ -212,6 +263,12 @@ Poller::Poller() :
     impl(new PollerPrivate())
 {}
 
+// Only the poll set count applies; completion ports have no readiness to
+// re-arm or spin on.
+Poller::Poller(int pollSets, bool, bool, Duration, bool) :
+    impl(new PollerPrivate(pollSets > 1 ? pollSets : 1))
+{}
+
 Poller::~Poller() {
     delete impl;
 }
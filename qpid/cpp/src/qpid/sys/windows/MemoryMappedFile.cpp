@@ -0,0 +1,57 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "qpid/sys/MemoryMappedFile.h"
+#include "qpid/sys/windows/check.h"
+
+#include <windows.h>
+
+namespace qpid {
+namespace sys {
+
+MemoryMappedFile::MemoryMappedFile(const std::string& directory, size_t s) : data(0), size(s)
+{
+    char name[MAX_PATH];
+    QPID_WINDOWS_CHECK_NOT(::GetTempFileName(directory.c_str(), "qpg", 0, name), 0);
+    HANDLE file = ::CreateFile(name, GENERIC_READ|GENERIC_WRITE, 0, 0, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_TEMPORARY|FILE_FLAG_DELETE_ON_CLOSE, 0);
+    QPID_WINDOWS_CHECK_NOT(file, INVALID_HANDLE_VALUE);
+    HANDLE mapping = ::CreateFileMapping(file, 0, PAGE_READWRITE, 0, (DWORD) size, 0);
+    ::CloseHandle(file);
+    QPID_WINDOWS_CHECK_NULL(mapping);
+    // The view keeps the mapping, and hence the file, alive until unmapped
+    data = static_cast<char*>(::MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+    ::CloseHandle(mapping);
+    QPID_WINDOWS_CHECK_NULL(data);
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    if (data) ::UnmapViewOfFile(data);
+}
+
+size_t MemoryMappedFile::getPageSize()
+{
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+}
+
+}} // namespace qpid::sys
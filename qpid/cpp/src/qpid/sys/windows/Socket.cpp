@@ -217,8 +217,10 @@ int Socket::listen(const std::string& host, const std::string& port, int backlog
     return listen(sa, backlog);
 }
 
-int Socket::listen(const SocketAddress& addr, int backlog) const
+int Socket::listen(const SocketAddress& addr, int backlog, bool sharePort) const
 {
+    if (sharePort)
+        throw Exception(QPID_MSG("Can't share port " << addr.asString() << ": not supported on this platform"));
     createSocket(addr);
 
     const SOCKET& socket = impl->fd;
@@ -280,6 +282,16 @@ void Socket::setTcpNoDelay() const
     nodelay = true;
 }
 
+bool Socket::setBusyPoll(int) const
+{
+    return false;
+}
+
+bool Socket::getPeerUser(std::string&) const
+{
+    return false;
+}
+
 inline IOHandlePrivate* IOHandlePrivate::getImpl(const qpid::sys::IOHandle &h)
 {
     return h.impl;
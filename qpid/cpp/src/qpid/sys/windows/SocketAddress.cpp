@@ -94,6 +94,11 @@ uint16_t SocketAddress::getPort(::sockaddr const * const addr)
     }
 }
 
+std::string SocketAddress::localName(const std::string&)
+{
+    throw Exception(QPID_MSG("Unix domain sockets are not supported on this platform"));
+}
+
 std::string SocketAddress::asString(bool numeric) const
 {
     if (!numeric)
@@ -70,6 +70,10 @@ AbsTime AbsTime::now() {
     return time_now;
 }
 
+AbsTime AbsTime::coarseNow() {
+    return now();
+}
+
 Duration::Duration(const AbsTime& start, const AbsTime& finish) {
     time_duration d = finish.timepoint - start.timepoint;
     nanosecs = d.total_nanoseconds();
@@ -0,0 +1,109 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "qpid/sys/zlib/DeflateLayer.h"
+#include "qpid/framing/reply_exceptions.h"
+#include "qpid/Msg.h"
+#include <string.h>
+
+namespace qpid {
+namespace sys {
+namespace zlib {
+
+DeflateLayer::DeflateLayer(uint16_t maxFrameSize) :
+    codec(0), decodeBuffer(2 * size_t(maxFrameSize)), decoded(0),
+    encodeBuffer(maxFrameSize), encodePosition(0), encoded(0), flushing(false)
+{
+    ::memset(&deflater, 0, sizeof(deflater));
+    ::memset(&inflater, 0, sizeof(inflater));
+    if (deflateInit(&deflater, Z_DEFAULT_COMPRESSION) != Z_OK)
+        throw framing::InternalErrorException(QPID_MSG("Cannot initialise deflate: " << deflater.msg));
+    if (inflateInit(&inflater) != Z_OK) {
+        deflateEnd(&deflater);
+        throw framing::InternalErrorException(QPID_MSG("Cannot initialise inflate: " << inflater.msg));
+    }
+}
+
+DeflateLayer::~DeflateLayer()
+{
+    deflateEnd(&deflater);
+    inflateEnd(&inflater);
+}
+
+size_t DeflateLayer::decode(const char* input, size_t size)
+{
+    inflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+    inflater.avail_in = size;
+    bool more = size;
+    while (more) {
+        inflater.next_out = reinterpret_cast<Bytef*>(&decodeBuffer[decoded]);
+        inflater.avail_out = decodeBuffer.size() - decoded;
+        int result = inflate(&inflater, Z_SYNC_FLUSH);
+        if (result != Z_OK && result != Z_BUF_ERROR) {
+            throw framing::InternalErrorException(QPID_MSG("Inflate error: "
+                                                           << (inflater.msg ? inflater.msg : "corrupt stream")));
+        }
+        decoded = decodeBuffer.size() - inflater.avail_out;
+        // Output that did not fit may still be held in the stream
+        more = inflater.avail_in || !inflater.avail_out;
+        size_t taken = codec->decode(&decodeBuffer[0], decoded);
+        if (taken) {
+            ::memmove(&decodeBuffer[0], &decodeBuffer[taken], decoded - taken);
+            decoded -= taken;
+        } else if (decoded == decodeBuffer.size()) {
+            throw framing::InternalErrorException(QPID_MSG("Inflated frame larger than " << decodeBuffer.size() << " bytes"));
+        }
+    }
+    return size;
+}
+
+size_t DeflateLayer::encode(const char* buffer, size_t size)
+{
+    deflater.next_out = reinterpret_cast<Bytef*>(const_cast<char*>(buffer));
+    deflater.avail_out = size;
+    while (deflater.avail_out) {
+        if (!encoded && !flushing) {
+            encodePosition = 0;
+            encoded = codec->encode(&encodeBuffer[0], encodeBuffer.size());
+            if (!encoded) break;//nothing more to do
+        }
+        deflater.next_in = reinterpret_cast<Bytef*>(&encodeBuffer[encodePosition]);
+        deflater.avail_in = encoded;
+        if (deflate(&deflater, Z_SYNC_FLUSH) == Z_STREAM_ERROR)
+            throw framing::InternalErrorException(QPID_MSG("Deflate error"));
+        encodePosition += encoded - deflater.avail_in;
+        encoded = deflater.avail_in;
+        // A full buffer may have left flushed output behind even with all the input taken
+        flushing = !deflater.avail_out;
+    }
+    return size - deflater.avail_out;
+}
+
+bool DeflateLayer::canEncode()
+{
+    return codec && (encoded || flushing || codec->canEncode());
+}
+
+void DeflateLayer::init(qpid::sys::Codec* c)
+{
+    codec = c;
+}
+
+}}} // namespace qpid::sys::zlib
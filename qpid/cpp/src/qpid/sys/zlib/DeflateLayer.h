@@ -0,0 +1,62 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#ifndef QPID_SYS_ZLIB_DEFLATELAYER_H
+#define QPID_SYS_ZLIB_DEFLATELAYER_H
+
+#include "qpid/sys/IntegerTypes.h"
+#include "qpid/sys/SecurityLayer.h"
+#include <zlib.h>
+#include <vector>
+
+namespace qpid {
+namespace sys {
+namespace zlib {
+
+/**
+ * Deflates everything a connection sends and inflates everything it
+ * receives, as one zlib stream in each direction. Installed in place
+ * of a SASL security layer when both ends asked for compression and
+ * SASL did not negotiate a layer of its own.
+ */
+class DeflateLayer : public qpid::sys::SecurityLayer
+{
+  public:
+    DeflateLayer(uint16_t maxFrameSize);
+    ~DeflateLayer();
+    size_t decode(const char* buffer, size_t size);
+    size_t encode(const char* buffer, size_t size);
+    bool canEncode();
+    void init(qpid::sys::Codec*);
+  private:
+    qpid::sys::Codec* codec;
+    z_stream deflater;
+    z_stream inflater;
+    std::vector<char> decodeBuffer;
+    size_t decoded;             // Inflated bytes in decodeBuffer
+    std::vector<char> encodeBuffer;
+    size_t encodePosition;
+    size_t encoded;             // Bytes from encodePosition not yet deflated
+    bool flushing;              // Deflated output is waiting for room
+};
+
+}}} // namespace qpid::sys::zlib
+
+#endif  /*!QPID_SYS_ZLIB_DEFLATELAYER_H*/
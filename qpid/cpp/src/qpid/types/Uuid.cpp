@@ -20,6 +20,7 @@
  */
 #include "qpid/types/Uuid.h"
 #include "qpid/sys/uuid.h"
+#include "qpid/sys/UuidGenerator.h"
 #include <sstream>
 #include <iostream>
 #include <string.h>
@@ -60,7 +61,7 @@ Uuid& Uuid::operator=(const Uuid& other)
 
 void Uuid::generate()
 {
-    uuid_generate(bytes);
+    qpid::sys::UuidGenerator::generate(bytes);
 }
 
 void Uuid::clear()
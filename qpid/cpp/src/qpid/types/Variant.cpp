@@ -654,7 +654,7 @@ Variant::Variant(const std::string& s) : impl(new VariantImpl(s)) {}
 Variant::Variant(const char* s) : impl(new VariantImpl(std::string(s))) {}
 Variant::Variant(const Map& m) : impl(new VariantImpl(m)) {}
 Variant::Variant(const List& l) : impl(new VariantImpl(l)) {}
-Variant::Variant(const Variant& v) : impl(VariantImpl::create(v)) {}
+Variant::Variant(const Variant& v) : impl(v.impl ? VariantImpl::create(v) : 0) {}
 Variant::Variant(const Uuid& u) : impl(new VariantImpl(u)) {}
 
 Variant::~Variant() { if (impl) delete impl; }
@@ -665,6 +665,11 @@ void Variant::reset()
     impl = 0;
 }
 
+void Variant::swap(Variant& other)
+{
+    std::swap(impl, other.impl);
+}
+
 
 Variant& Variant::operator=(bool b)
 {
@@ -773,8 +778,9 @@ Variant& Variant::operator=(const List& l)
 
 Variant& Variant::operator=(const Variant& v)
 {
+    VariantImpl* copy = v.impl ? VariantImpl::create(v) : 0;
     if (impl) delete impl;
-    impl = VariantImpl::create(v);
+    impl = copy;
     return *this;
 }
 
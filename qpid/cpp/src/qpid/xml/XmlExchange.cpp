@@ -27,6 +27,7 @@
 
 #include "qpid/log/Statement.h"
 #include "qpid/broker/FedOps.h"
+#include "qpid/framing/Buffer.h"
 #include "qpid/framing/FieldTable.h"
 #include "qpid/framing/FieldValue.h"
 #include "qpid/framing/reply_exceptions.h"
@@ -57,6 +58,35 @@ namespace _qmf = qmf::org::apache::qpid::broker;
 
 namespace qpid {
 namespace broker {            
+
+namespace {
+const std::string qpidXmlResultCache("qpid.xml.result_cache");
+// Contents larger than this are evaluated every time
+const size_t MAX_CACHED_KEY(65536);
+const std::string qpidXmlRootElement("qpid.xml.root_element");
+const std::string qpidXmlHeaderPrefix("qpid.xml.header.");
+
+// Name of the first element in the content, skipping any prolog, or
+// empty if there is none
+std::string findRootElement(const std::string& content)
+{
+    std::string::size_type i = 0;
+    while ((i = content.find('<', i)) != std::string::npos && i + 1 < content.size()) {
+        if (content[i + 1] == '?') {
+            i = content.find("?>", i);
+        } else if (content.compare(i, 4, "<!--") == 0) {
+            i = content.find("-->", i);
+        } else if (content[i + 1] == '!') {
+            i = content.find('>', i);
+        } else {
+            std::string::size_type end = content.find_first_of(" \t\r\n/>", i + 1);
+            return content.substr(i + 1, end == std::string::npos ? end : end - i - 1);
+        }
+        if (i == std::string::npos) break;
+    }
+    return std::string();
+}
+}
     
 XQilla XmlBinding::xqilla;
 
@@ -98,10 +128,41 @@ XmlBinding::XmlBinding(const std::string& key, const Queue::shared_ptr queue, co
     catch (...) {
         throw InternalErrorException(QPID_MSG("Unexpected error - Could not parse xquery:"+ queryText));
     }    
+
+    rootElement = _arguments.getAsString(qpidXmlRootElement);
+    for (FieldTable::ValueMap::const_iterator i = _arguments.begin(); i != _arguments.end(); ++i) {
+        if (i->first.compare(0, qpidXmlHeaderPrefix.size(), qpidXmlHeaderPrefix) == 0)
+            headers.set(i->first.substr(qpidXmlHeaderPrefix.size()), i->second);
+    }
+}
+
+bool XmlBinding::prefilter(const std::string& msgContent, const FieldTable* args) const
+{
+    for (FieldTable::ValueMap::const_iterator i = headers.begin(); i != headers.end(); ++i) {
+        FieldTable::ValuePtr value = args ? args->get(i->first) : FieldTable::ValuePtr();
+        if (!value) return false;
+        if (i->second->convertsTo<std::string>()) {
+            // Strings may arrive as any of the string types
+            if (!value->convertsTo<std::string>() || value->get<std::string>() != i->second->get<std::string>())
+                return false;
+        } else if (!(*value == *i->second)) {
+            return false;
+        }
+    }
+    if (!rootElement.empty()) {
+        // Unqualified names match any prefix; an unreadable start is left to the query
+        std::string root = findRootElement(msgContent);
+        std::string::size_type colon = root.find(':');
+        if (!root.empty() && root != rootElement &&
+            (colon == std::string::npos || root.substr(colon + 1) != rootElement))
+            return false;
+    }
+    return true;
 }
 
      
-XmlExchange::XmlExchange(const string& _name, Manageable* _parent, Broker* b) : Exchange(_name, _parent, b)
+XmlExchange::XmlExchange(const string& _name, Manageable* _parent, Broker* b) : Exchange(_name, _parent, b),
+                                                                                   resultCacheSize(0)
 {
     if (mgmtExchange != 0)
         mgmtExchange->set_type (typeName);
@@ -109,7 +170,8 @@ XmlExchange::XmlExchange(const string& _name, Manageable* _parent, Broker* b) :
 
 XmlExchange::XmlExchange(const std::string& _name, bool _durable,
                          const FieldTable& _args, Manageable* _parent, Broker* b) :
-    Exchange(_name, _durable, _args, _parent, b)
+    Exchange(_name, _durable, _args, _parent, b),
+    resultCacheSize(_args.getAsInt(qpidXmlResultCache))
 {
     if (mgmtExchange != 0)
         mgmtExchange->set_type (typeName);
@@ -198,10 +260,8 @@ bool XmlExchange::unbind(Queue::shared_ptr queue, const string& bindingKey, cons
     }
 }
 
-bool XmlExchange::matches(Query& query, Deliverable& msg, const qpid::framing::FieldTable* args, bool parse_message_content) 
+bool XmlExchange::matches(Query& query, const std::string& msgContent, const qpid::framing::FieldTable* args, bool parse_message_content) 
 {
-    string msgContent;
-
     try {
         QPID_LOG(trace, "matches: query is [" << UTF8(query->getQueryText()) << "]");
 
@@ -212,8 +272,6 @@ bool XmlExchange::matches(Query& query, Deliverable& msg, const qpid::framing::F
 
         if (parse_message_content) {
 
-            msg.getMessage().getFrames().getContent(msgContent);
-
             QPID_LOG(trace, "matches: message content is [" << msgContent << "]");
 
             XERCES_CPP_NAMESPACE::MemBufInputSource xml((const XMLByte*) msgContent.c_str(), 
@@ -272,8 +330,27 @@ bool XmlExchange::matches(Query& query, Deliverable& msg, const qpid::framing::F
     return 0;
 }
 
+bool XmlExchange::matches(XmlBinding& binding, const std::string& msgContent, const std::string& cacheKey,
+                          const FieldTable* args)
+{
+    if (cacheKey.empty())
+        return matches(binding.xquery, msgContent, args, binding.parse_message_content);
+    {
+        Mutex::ScopedLock l(binding.resultsLock);
+        XmlBinding::Results::const_iterator i = binding.results.find(cacheKey);
+        if (i != binding.results.end()) return i->second;
+    }
+    bool result = matches(binding.xquery, msgContent, args, binding.parse_message_content);
+    Mutex::ScopedLock l(binding.resultsLock);
+    if (binding.results.size() >= resultCacheSize) binding.results.clear();
+    binding.results[cacheKey] = result;
+    return result;
+}
+
 // Future optimization: If any query in a binding for a given routing key requires
 // message content, parse the message once, and use that parsed form for all bindings.
+// Each query needs a dynamic context of its own, and a document parsed in one
+// context cannot be used from another, so for now only the content is shared.
 //
 // Future optimization: XQilla does not currently do document projection for data
 // accessed via the context item. If there is a single query for a given routing key,
@@ -295,8 +372,32 @@ void XmlExchange::route(Deliverable& msg, const string& routingKey, const FieldT
             if (!p.get()) return;
         }
 
+        // Copy the content out once for all the bindings that need it
+        string msgContent;
+        bool needContent = resultCacheSize;
+        for (std::vector<XmlBinding::shared_ptr>::const_iterator i = p->begin(); i != p->end() && !needContent; i++)
+            needContent = (*i)->parse_message_content || !(*i)->rootElement.empty();
+        if (needContent) {
+            // Content spilled as it was received has to be read back to be parsed
+            msg.getMessage().restoreContent();
+            msg.getMessage().getFrames().getContent(msgContent);
+        }
+
+        // The cache key holds the headers, used as external variables, and the content
+        string cacheKey;
+        if (resultCacheSize && msgContent.size() < MAX_CACHED_KEY) {
+            if (args) {
+                cacheKey.resize(1 + args->encodedSize(), '\1');
+                Buffer buffer(&cacheKey[1], cacheKey.size() - 1);
+                args->encode(buffer);
+            } else {
+                cacheKey.assign(1, '\0');
+            }
+            cacheKey += msgContent;
+        }
+
         for (std::vector<XmlBinding::shared_ptr>::const_iterator i = p->begin(); i != p->end(); i++) {
-            if (matches((*i)->xquery, msg, args, (*i)->parse_message_content)) { 
+            if ((*i)->prefilter(msgContent, args) && matches(**i, msgContent, cacheKey, args)) { 
                 b->push_back(*i);
             }
         }
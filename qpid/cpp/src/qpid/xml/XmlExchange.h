@@ -54,9 +54,23 @@ struct XmlBinding : public Exchange::Binding {
      Query xquery;
      bool parse_message_content;
      const std::string fedOrigin;   // empty for local bindings
+
+     // Cheap checks made before the query is run, from the binding
+     // arguments qpid.xml.root_element and qpid.xml.header.<name>
+     std::string rootElement;
+     qpid::framing::FieldTable headers;
+
+     // Recent results of the query by message content and headers, kept
+     // when the exchange is declared with qpid.xml.result_cache
+     typedef std::map<std::string, bool> Results;
+     qpid::sys::Mutex resultsLock;
+     Results results;
     
      XmlBinding(const std::string& key, const Queue::shared_ptr queue, const std::string& fedOrigin, Exchange* parent, 
                 const ::qpid::framing::FieldTable& _arguments, const std::string& );
+
+     /** False if the message cannot match, without running the query */
+     bool prefilter(const std::string& msgContent, const qpid::framing::FieldTable* args) const;
         
 };
 
@@ -66,8 +80,11 @@ class XmlExchange : public virtual Exchange {
     XmlBindingsMap bindingsMap;
 
     qpid::sys::RWlock lock;
+    uint32_t resultCacheSize;
 
-    bool matches(Query& query, Deliverable& msg, const qpid::framing::FieldTable* args, bool parse_message_content);
+    bool matches(Query& query, const std::string& msgContent, const qpid::framing::FieldTable* args, bool parse_message_content);
+    bool matches(XmlBinding& binding, const std::string& msgContent, const std::string& cacheKey,
+                 const qpid::framing::FieldTable* args);
 
   public:
     static const std::string typeName;
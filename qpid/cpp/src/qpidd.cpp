@@ -57,7 +57,10 @@ int main(int argc, char* argv[])
 
         if (!bootOptions.module.noLoad) {
             bool isDefault = defaultPath == bootOptions.module.loadDir;
-            qpid::loadModuleDir (bootOptions.module.loadDir, isDefault);
+            if (bootOptions.module.onDemand)
+                qpid::deferModuleDir (bootOptions.module.loadDir, isDefault);
+            else
+                qpid::loadModuleDir (bootOptions.module.loadDir, isDefault);
         }
 
         // Parse options
@@ -0,0 +1,167 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "unit_test.h"
+#include "test_tools.h"
+#include "qpid/sys/AggregateOutput.h"
+#include "qpid/sys/ConnectionOutputHandler.h"
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(AggregateOutputTestSuite)
+
+using namespace qpid::sys;
+
+// Counts the bytes the tasks "send" and lets the test drain them
+struct Output : public ConnectionOutputHandler {
+    size_t buffered;
+    Output() : buffered(0) {}
+    void close() {}
+    void abort() {}
+    void activateOutput() {}
+    void giveReadCredit(int32_t) {}
+    void send(framing::AMQFrame&) {}
+    size_t getBuffered() const { return buffered; }
+};
+
+// Sends messages of a fixed size, forever unless limited
+struct Sender : public OutputTask {
+    Output& output;
+    size_t size;
+    int left;
+    int sent;
+    Sender(Output& o, size_t s, int n=-1) : output(o), size(s), left(n), sent(0) {}
+    bool doOutput() {
+        if (left == 0) return false;
+        if (left > 0) --left;
+        output.buffered += size;
+        ++sent;
+        return true;
+    }
+};
+
+QPID_AUTO_TEST_CASE(testTurnsByCall) {
+    Output output;
+    AggregateOutput tasks(output);
+    Sender big(output, 1000), small(output, 10);
+    tasks.addOutputTask(&big);
+    tasks.addOutputTask(&small);
+    for (int i = 0; i < 10; ++i)
+        BOOST_CHECK(tasks.doOutput());
+    BOOST_CHECK_EQUAL(big.sent, 5);
+    BOOST_CHECK_EQUAL(small.sent, 5);
+}
+
+QPID_AUTO_TEST_CASE(testTurnsByBytes) {
+    Output output;
+    AggregateOutput tasks(output);
+    tasks.setByteBudget(1000, 0, output);
+    Sender big(output, 1000), small(output, 10);
+    tasks.addOutputTask(&big);
+    tasks.addOutputTask(&small);
+    for (int i = 0; i < 10; ++i)
+        BOOST_CHECK(tasks.doOutput());
+    BOOST_CHECK_EQUAL(big.sent, 5);
+    BOOST_CHECK_EQUAL(small.sent, 500);
+
+    // A message bigger than the quantum is paid for over later turns
+    Output output2;
+    AggregateOutput tasks2(output2);
+    tasks2.setByteBudget(100, 0, output2);
+    Sender huge(output2, 300), medium(output2, 100);
+    tasks2.addOutputTask(&huge);
+    tasks2.addOutputTask(&medium);
+    for (int i = 0; i < 12; ++i)
+        BOOST_CHECK(tasks2.doOutput());
+    BOOST_CHECK_EQUAL(huge.sent*300, medium.sent*100);
+}
+
+// A Sender with a weight, possibly low latency
+struct WeightedSender : public Sender {
+    uint32_t weight;
+    bool urgent;
+    WeightedSender(Output& o, size_t s, uint32_t w, bool u=false, int n=-1)
+        : Sender(o, s, n), weight(w), urgent(u) {}
+    uint32_t getOutputWeight() const { return weight; }
+    bool isLowLatency() const { return urgent; }
+};
+
+QPID_AUTO_TEST_CASE(testWeights) {
+    Output output;
+    AggregateOutput tasks(output);
+    WeightedSender heavy(output, 10, 3), light(output, 10, 1);
+    tasks.addOutputTask(&heavy);
+    tasks.addOutputTask(&light);
+    for (int i = 0; i < 12; ++i)
+        BOOST_CHECK(tasks.doOutput());
+    BOOST_CHECK_EQUAL(heavy.sent, 9);
+    BOOST_CHECK_EQUAL(light.sent, 3);
+
+    Output output2;
+    AggregateOutput tasks2(output2);
+    tasks2.setByteBudget(100, 0, output2);
+    WeightedSender heavy2(output2, 100, 2), light2(output2, 100, 1);
+    tasks2.addOutputTask(&heavy2);
+    tasks2.addOutputTask(&light2);
+    for (int i = 0; i < 10; ++i)
+        BOOST_CHECK(tasks2.doOutput());
+    BOOST_CHECK_EQUAL(heavy2.sent, 2*light2.sent);
+}
+
+QPID_AUTO_TEST_CASE(testLowLatencyFirst) {
+    Output output;
+    AggregateOutput tasks(output);
+    WeightedSender bulk(output, 1000, 1), urgent(output, 10, 1, true, 3);
+    tasks.addOutputTask(&bulk);
+    tasks.addOutputTask(&urgent);
+    for (int i = 0; i < 3; ++i)
+        BOOST_CHECK(tasks.doOutput());
+    BOOST_CHECK_EQUAL(urgent.sent, 3);
+    BOOST_CHECK_EQUAL(bulk.sent, 0);
+    BOOST_CHECK(tasks.doOutput());
+    BOOST_CHECK_EQUAL(bulk.sent, 1);
+}
+
+QPID_AUTO_TEST_CASE(testBufferedLimit) {
+    Output output;
+    AggregateOutput tasks(output);
+    tasks.setByteBudget(1000, 250, output);
+    Sender sender(output, 100, 4);
+    tasks.addOutputTask(&sender);
+
+    BOOST_CHECK(tasks.doOutput());
+    BOOST_CHECK_EQUAL(sender.sent, 3);
+    BOOST_CHECK(!tasks.doOutput()); // Held back until written
+    BOOST_CHECK_EQUAL(sender.sent, 3);
+
+    output.buffered = 0;
+    BOOST_CHECK(tasks.doOutput());
+    BOOST_CHECK_EQUAL(sender.sent, 4);
+    BOOST_CHECK(!tasks.doOutput()); // Nothing left, task removed
+    output.buffered = 0;
+    BOOST_CHECK(!tasks.doOutput());
+    BOOST_CHECK_EQUAL(sender.sent, 4);
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
@@ -0,0 +1,76 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "unit_test.h"
+#include "qpid/sys/AllocationCounts.h"
+#include <string>
+
+using qpid::sys::AllocationCounts;
+using qpid::sys::AllocationSite;
+namespace allocation = qpid::sys::allocation;
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(AllocationCountsTestSuite)
+
+QPID_AUTO_TEST_CASE(testInnermostSiteCounts) {
+    AllocationCounts::Snapshot before, after;
+    AllocationCounts::snapshot(before);
+    {
+        AllocationSite outer(allocation::management);
+        AllocationCounts::allocated(10);
+        {
+            AllocationSite inner(allocation::logging);
+            AllocationCounts::allocated(20);
+        }
+        AllocationCounts::allocated(30);
+    }
+    AllocationCounts::snapshot(after);
+    // Other threads may allocate meanwhile, but not at these sites
+    BOOST_CHECK_EQUAL(after.allocations[allocation::management] - before.allocations[allocation::management], 2u);
+    BOOST_CHECK_EQUAL(after.bytes[allocation::management] - before.bytes[allocation::management], 40u);
+    BOOST_CHECK_EQUAL(after.allocations[allocation::logging] - before.allocations[allocation::logging], 1u);
+    BOOST_CHECK_EQUAL(after.bytes[allocation::logging] - before.bytes[allocation::logging], 20u);
+}
+
+QPID_AUTO_TEST_CASE(testLeaveRestoresSite) {
+    allocation::Site previous = AllocationCounts::enter(allocation::framing);
+    BOOST_CHECK_EQUAL(AllocationCounts::enter(allocation::message), allocation::framing);
+    AllocationCounts::leave(allocation::framing);
+    BOOST_CHECK_EQUAL(AllocationCounts::enter(previous), allocation::framing);
+}
+
+QPID_AUTO_TEST_CASE(testMessagesReceived) {
+    AllocationCounts::Snapshot before, after;
+    AllocationCounts::snapshot(before);
+    AllocationCounts::messageReceived();
+    AllocationCounts::snapshot(after);
+    BOOST_CHECK_EQUAL(after.messages - before.messages, 1u);
+}
+
+QPID_AUTO_TEST_CASE(testNames) {
+    BOOST_CHECK_EQUAL(std::string(AllocationCounts::name(allocation::other)), "other");
+    BOOST_CHECK_EQUAL(std::string(AllocationCounts::name(allocation::logging)), "logging");
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
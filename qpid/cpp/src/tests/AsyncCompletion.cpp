@@ -26,6 +26,7 @@
 #include "qpid/sys/Time.h"
 #include "qpid/framing/QueueQueryResult.h"
 #include "qpid/client/TypedResult.h"
+#include "qpid/amqp_0_10/Exception.h"
 
 using namespace std;
 using namespace qpid;
@@ -104,6 +105,26 @@ QPID_AUTO_TEST_CASE(testWaitTillComplete) {
     sync.wait();                // Should complete now, all messages are completed.
 }
 
+QPID_AUTO_TEST_CASE(testFailedEnqueue) {
+    SessionFixture fix;
+    AsyncCompletionMessageStore* store = new AsyncCompletionMessageStore;
+    boost::shared_ptr<qpid::broker::MessageStore> p;
+    p.reset(store);
+    fix.broker->setStore(p);
+    AsyncSession s = fix.session;
+
+    s.queueDeclare("q", arg::durable=true);
+    Message msg("a", "q");
+    msg.getDeliveryProperties().setDeliveryMode(PERSISTENT);
+    Completion transfer = s.messageTransfer(arg::content=msg);
+    Completion sync = s.executionSync(arg::sync=true);
+
+    // The store fails the enqueue: the publisher gets an exception
+    // rather than a completion.
+    store->enqueued.pop(TIME_SEC)->enqueueFailed("disk full");
+    BOOST_CHECK_THROW(sync.wait(), SessionException);
+}
+
 QPID_AUTO_TEST_CASE(testGetResult) {
     SessionFixture fix;
     AsyncSession s = fix.session;
@@ -0,0 +1,101 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "unit_test.h"
+#include "qpid/broker/AuthCache.h"
+#include "qpid/sys/Sha256.h"
+#include "qpid/sys/Time.h"
+#include <string>
+
+using namespace qpid::broker;
+using qpid::sys::TIME_MSEC;
+using qpid::sys::TIME_SEC;
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(AuthCacheTestSuite)
+
+namespace {
+std::string hex(const std::string& bytes)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string s;
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        s += digits[(bytes[i] >> 4) & 0xf];
+        s += digits[bytes[i] & 0xf];
+    }
+    return s;
+}
+}
+
+QPID_AUTO_TEST_CASE(testSha256) {
+    BOOST_CHECK_EQUAL(hex(sys::sha256("")),
+                      "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    BOOST_CHECK_EQUAL(hex(sys::sha256("abc")),
+                      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    // Padding spills into a second block
+    BOOST_CHECK_EQUAL(hex(sys::sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")),
+                      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+QPID_AUTO_TEST_CASE(testFindRemembered) {
+    AuthCache cache;
+    std::string uid;
+    BOOST_CHECK(!cache.find("PLAIN guest guest", uid));
+    cache.insert("PLAIN guest guest", "guest@QPID", 10, TIME_SEC);
+    BOOST_CHECK(cache.find("PLAIN guest guest", uid));
+    BOOST_CHECK_EQUAL(uid, "guest@QPID");
+    // Only an identical attempt matches
+    BOOST_CHECK(!cache.find("PLAIN guest wrong", uid));
+}
+
+QPID_AUTO_TEST_CASE(testExpiry) {
+    AuthCache cache;
+    std::string uid;
+    cache.insert("attempt", "guest@QPID", 10, 10*TIME_MSEC);
+    sys::usleep(50*1000);
+    BOOST_CHECK(!cache.find("attempt", uid));
+}
+
+QPID_AUTO_TEST_CASE(testLimit) {
+    AuthCache cache;
+    std::string uid;
+    cache.insert("a", "a@QPID", 2, TIME_SEC);
+    cache.insert("b", "b@QPID", 2, TIME_SEC);
+    cache.insert("c", "c@QPID", 2, TIME_SEC);
+    int found = cache.find("a", uid) + cache.find("b", uid) + cache.find("c", uid);
+    BOOST_CHECK_EQUAL(found, 2);
+    BOOST_CHECK(cache.find("c", uid));
+    // An expired entry goes before a live one
+    cache.insert("d", "d@QPID", 3, 10*TIME_MSEC);
+    sys::usleep(50*1000);
+    cache.insert("e", "e@QPID", 3, TIME_SEC);
+    BOOST_CHECK(cache.find("c", uid));
+    BOOST_CHECK(cache.find("e", uid));
+    // None at all
+    AuthCache none;
+    none.insert("a", "a@QPID", 0, TIME_SEC);
+    BOOST_CHECK(!none.find("a", uid));
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
@@ -0,0 +1,65 @@
+#ifndef TESTS_BENCHOPTIONS_H
+#define TESTS_BENCHOPTIONS_H
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <exception>
+#include <iostream>
+#include <string>
+#include "qpid/Options.h"
+
+namespace qpid {
+namespace tests {
+
+/**
+ * Options common to the benchmark programs. Each adds its own options
+ * in its constructor and calls parse() from main().
+ */
+struct BenchOptions : public qpid::Options
+{
+    bool help;
+
+    BenchOptions(const std::string& name) : qpid::Options(name), help(false)
+    {
+        addOptions()
+            ("help", qpid::optValue(help), "print this usage statement");
+    }
+
+    /** @return false if the program should exit without running */
+    bool parse(int argc, char** argv) {
+        try {
+            qpid::Options::parse(argc, argv);
+            if (help) {
+                std::cerr << *this << std::endl << std::endl;
+            } else {
+                return true;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << *this << std::endl << std::endl << e.what() << std::endl;
+        }
+        return false;
+    }
+};
+
+}} // namespace qpid::tests
+
+#endif  /*!TESTS_BENCHOPTIONS_H*/
@@ -28,6 +28,7 @@
 #include "qpid/log/Options.h"
 
 #include "qmf/org/apache/qpid/broker/mgmt/test/TestObject.h"
+#include "qmf/org/apache/qpid/broker/EventQueueThresholdExceeded.h"
 
 #include <iomanip>
 
@@ -96,6 +97,15 @@ namespace qpid {
                                                         + p + std::string(".") + k
                                                         + std::string("'}]}}"));
                 };
+                Receiver createV2EventRcvr( const std::string package, const std::string event )
+                {
+                    return mFix->session.createReceiver(std::string("equeue; {create: always, delete: always, "
+                                                                    "node: {type: queue, "
+                                                                    "x-bindings: [{exchange: qmf.default.topic, "
+                                                                    "key: 'agent.ind.event.")
+                                                        + package + std::string(".") + event
+                                                        + std::string(".#'}]}}"));
+                };
             };
 
 
@@ -784,6 +794,41 @@ namespace qpid {
             delete save;
         }
 
+        // An event raised again for the same source before the first
+        // is published replaces it.
+        //
+        QPID_AUTO_TEST_CASE(v2EventCoalesce)
+        {
+            qpid::broker::Broker::Options opts;
+            opts.mgmtEventRate = 1;
+            AgentFixture* fix = new AgentFixture(10, true, opts);
+            management::ManagementAgent* agent = fix->getBrokerAgent();
+
+            Receiver r1 = fix->createV2EventRcvr("org_apache_qpid_broker", "queueThresholdExceeded");
+
+            for (uint64_t depth = 1; depth <= 5; ++depth)
+                agent->raiseEvent(qmf::org::apache::qpid::broker::EventQueueThresholdExceeded("q", depth, 0),
+                                  management::ManagementAgent::SEV_DEFAULT, "q");
+
+            // The first may go out before the rest arrive, the rest go
+            // out as one once the rate allows.
+            Message m1;
+            uint64_t last = 0;
+            int received = 0;
+            while (r1.fetch(m1, Duration::SECOND * 3)) {
+                Variant::List vList;
+                ::qpid::amqp_0_10::ListCodec::decode(m1.getContent(), vList);
+                BOOST_REQUIRE_EQUAL(vList.size(), 1u);
+                last = vList.front().asMap()["_values"].asMap()["msgDepth"].asUint64();
+                ++received;
+            }
+            BOOST_CHECK(received >= 1 && received <= 2);
+            BOOST_CHECK_EQUAL(last, 5u);
+
+            r1.close();
+            delete fix;
+        }
+
         QPID_AUTO_TEST_SUITE_END()
     }
 }
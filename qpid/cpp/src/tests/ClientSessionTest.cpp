@@ -25,10 +25,13 @@
 #include "qpid/client/MessageListener.h"
 #include "qpid/client/SubscriptionManager.h"
 #include "qpid/client/AsyncSession.h"
+#include "qpid/client/SessionBase_0_10Access.h"
+#include "qpid/client/SessionImpl.h"
 #include "qpid/sys/Monitor.h"
 #include "qpid/sys/Thread.h"
 #include "qpid/sys/Runnable.h"
 #include "qpid/sys/Time.h"
+#include "qpid/sys/AsynchIOHandler.h"
 #include "qpid/client/Session.h"
 #include "qpid/client/Message.h"
 #include "qpid/framing/reply_exceptions.h"
@@ -231,6 +234,36 @@ QPID_AUTO_TEST_CASE(testGet) {
     t.join();
 }
 
+QPID_AUTO_TEST_CASE(testMixedSizeTransfers) {
+    ClientSessionFixture fix;
+    fix.session.queueDeclare(arg::queue="sizeq", arg::exclusive=true, arg::autoDelete=true);
+    // Large messages need the connection to switch to large IO buffers
+    string big(200000, 'x');
+    fix.session.messageTransfer(arg::content=Message("small0", "sizeq"));
+    fix.session.messageTransfer(arg::content=Message(big, "sizeq"));
+    fix.session.messageTransfer(arg::content=Message("small1", "sizeq"));
+    Message got;
+    BOOST_CHECK(fix.subs.get(got, "sizeq", TIME_SEC));
+    BOOST_CHECK_EQUAL("small0", got.getData());
+    BOOST_CHECK(fix.subs.get(got, "sizeq", TIME_SEC));
+    BOOST_CHECK_EQUAL(big, got.getData());
+    BOOST_CHECK(fix.subs.get(got, "sizeq", TIME_SEC));
+    BOOST_CHECK_EQUAL("small1", got.getData());
+
+    sys::AsynchIOHandler::BufferPoolStats stats;
+    sys::AsynchIOHandler::getBufferPoolStats(stats);
+    BOOST_CHECK(stats.buffersInUse > 0);
+    BOOST_CHECK(stats.bytesAllocated > 0);
+
+    // Once its writes complete the broker's connection gives back the
+    // buffers they used, keeping little more than one to read into
+    for (int i = 0; i < 100 && stats.buffersInUse > 2; ++i) {
+        qpid::sys::usleep(10*1000);
+        sys::AsynchIOHandler::getBufferPoolStats(stats);
+    }
+    BOOST_CHECK(stats.buffersInUse <= 2);
+}
+
 QPID_AUTO_TEST_CASE(testOpenFailure) {
     BrokerFixture b;
     Connection c;
@@ -420,6 +453,61 @@ QPID_AUTO_TEST_CASE(testConcurrentSenders)
     connection.close();
 }
 
+QPID_AUTO_TEST_CASE(testCoalescedOutput)
+{
+    ClientSessionFixture fix;
+    ConnectionSettings settings;
+    settings.port = fix.broker->getPort(qpid::broker::Broker::TCP_TRANSPORT);
+    settings.coalesceOutput = true;
+    settings.flushDelay = 500;
+    Connection connection;
+    connection.open(settings);
+    Message message(string(64, 'X'), "my-queue");
+
+    boost::ptr_vector<Publisher> publishers;
+    for (size_t i = 0; i < 4; i++) {
+        publishers.push_back(new Publisher(connection, message, 250));
+    }
+    std::for_each(publishers.begin(), publishers.end(), boost::bind(&Publisher::start, _1));
+    std::for_each(publishers.begin(), publishers.end(), boost::bind(&Publisher::join, _1));
+
+    // A lone message with nothing to join it is still written
+    Session session = connection.newSession();
+    session.messageTransfer(arg::content=message);
+    session.sync();
+    connection.close();
+
+    BOOST_CHECK_EQUAL(fix.session.queueQuery(string("my-queue")).getMessageCount(), 1001u);
+}
+
+QPID_AUTO_TEST_CASE(testAutoReplenishCredit)
+{
+    ClientSessionFixture fix;
+    const uint count = 3;
+    for (uint i = 0; i < count; i++) {
+        Message m((boost::format("Message_%1%") % (i+1)).str(), "my-queue");
+        fix.session.messageTransfer(arg::content=m);
+    }
+    FieldTable args;
+    args.setInt("qpid.auto_replenish", 1);
+    fix.session.messageSubscribe(arg::queue="my-queue", arg::destination="d", arg::acceptMode=0, arg::arguments=args);
+    fix.session.messageSetFlowMode(arg::destination="d", arg::flowMode=0); // credit
+    fix.session.messageFlow(arg::destination="d", arg::unit=0, arg::value=1);
+    fix.session.messageFlow(arg::destination="d", arg::unit=1, arg::value=0xFFFFFFFF);
+
+    // Unclaimed transfers arrive on the session's default queue
+    client::Demux::QueuePtr incoming = SessionBase_0_10Access(fix.session).get()->getDemux().getDefault();
+    for (uint i = 0; i < count; i++) {
+        FrameSet::shared_ptr transfer;
+        BOOST_REQUIRE(incoming->pop(transfer, TIME_SEC));
+        BOOST_CHECK_EQUAL((boost::format("Message_%1%") % (i+1)).str(), transfer->getContent());
+        // Only one message of credit until this one is accepted
+        FrameSet::shared_ptr early;
+        BOOST_CHECK(!incoming->pop(early, 100*qpid::sys::TIME_MSEC));
+        fix.session.messageAccept(SequenceSet(transfer->getId()));
+    }
+    BOOST_CHECK_EQUAL(fix.session.queueQuery(string("my-queue")).getMessageCount(), 0u);
+}
 
 QPID_AUTO_TEST_CASE(testExclusiveSubscribe)
 {
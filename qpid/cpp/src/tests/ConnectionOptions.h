@@ -53,7 +53,9 @@ struct  ConnectionOptions : public qpid::Options,
             ("tcp-nodelay", optValue(tcpNoDelay), "Turn on tcp-nodelay")
             ("service", optValue(service, "SERVICE-NAME"), "SASL service name.")
             ("min-ssf", optValue(minSsf, "N"), "Minimum acceptable strength for SASL security layer")
-	    ("max-ssf", optValue(maxSsf, "N"), "Maximum acceptable strength for SASL security layer");
+	    ("max-ssf", optValue(maxSsf, "N"), "Maximum acceptable strength for SASL security layer")
+            ("coalesce-output", optValue(coalesceOutput), "Write messages sent during a write together once it is done")
+            ("flush-delay", optValue(flushDelay, "MICROSECS"), "Write messages sent this soon after the last write together, this long after it");
     }
 };
 
@@ -21,7 +21,13 @@
 
 #include "qpid/console/Package.h"
 #include "qpid/console/ClassKey.h"
+#include "qpid/console/Object.h"
+#include "qpid/console/Schema.h"
+#include "qpid/console/Value.h"
+#include "qpid/framing/Buffer.h"
+#include "qpid/framing/FieldTable.h"
 #include "unit_test.h"
+#include <memory>
 
 namespace qpid {
 namespace tests {
@@ -41,6 +47,80 @@ QPID_AUTO_TEST_CASE(testClassKey) {
     BOOST_CHECK_EQUAL(k.str(), "com.redhat.test:class(00010203-04050607-08090a0b-0c0d0e0f)");
 }
 
+namespace {
+// A class with a string property, "name", and a uint64 statistic, "count"
+SchemaClass* makeSchema()
+{
+    char raw[1024];
+    Buffer buffer(raw, sizeof(raw));
+    buffer.putShort(1);         // Properties
+    buffer.putShort(1);         // Statistics
+    buffer.putShort(0);         // Methods
+
+    FieldTable property;
+    property.setString("name", "name");
+    property.setInt("type", 6);
+    property.setInt("access", 1);
+    property.setInt("index", 1);
+    property.setInt("optional", 0);
+    property.setInt("min", 0);
+    property.setInt("max", 0);
+    property.setInt("maxlen", 0);
+    property.encode(buffer);
+
+    FieldTable statistic;
+    statistic.setString("name", "count");
+    statistic.setInt("type", 4);
+    statistic.encode(buffer);
+
+    buffer.reset();
+    uint8_t hash[16] = {0};
+    return new SchemaClass(SchemaClass::KIND_TABLE, ClassKey("test", "thing", hash), buffer);
+}
+
+// An update for object 7 of the class makeSchema gives
+void encodeUpdate(char* raw, uint32_t size, uint64_t current, bool prop, bool stat)
+{
+    Buffer buffer(raw, size);
+    buffer.putLongLong(current);
+    buffer.putLongLong(1);      // Created
+    buffer.putLongLong(0);      // Not deleted
+    buffer.putLongLong(0);
+    buffer.putLongLong(7);
+    if (prop)
+        buffer.putShortString("thing-1");
+    if (stat)
+        buffer.putLongLong(current * 10);
+}
+}
+
+QPID_AUTO_TEST_CASE(testObjectUpdate) {
+    std::auto_ptr<SchemaClass> schema(makeSchema());
+    char raw[256];
+
+    encodeUpdate(raw, sizeof(raw), 1, true, false);
+    Buffer props(raw, sizeof(raw));
+    Object object(0, schema.get(), props, true, false);
+    BOOST_CHECK_EQUAL(object.attrString("name"), "thing-1");
+    BOOST_CHECK(object.getAttributes().find("count") == object.getAttributes().end());
+
+    // A statistics update keeps the properties already held
+    encodeUpdate(raw, sizeof(raw), 2, false, true);
+    Buffer stats(raw, sizeof(raw));
+    object.update(stats, false, true);
+    BOOST_CHECK_EQUAL(object.getCurrentTime(), 2u);
+    BOOST_CHECK_EQUAL(object.attrString("name"), "thing-1");
+    BOOST_CHECK_EQUAL(object.attrUint64("count"), 20u);
+
+    encodeUpdate(raw, sizeof(raw), 3, false, true);
+    Buffer later(raw, sizeof(raw));
+    Object update(0, schema.get(), later, false, true);
+    object.mergeUpdate(update);
+    BOOST_CHECK_EQUAL(object.getCurrentTime(), 3u);
+    BOOST_CHECK_EQUAL(object.attrString("name"), "thing-1");
+    BOOST_CHECK_EQUAL(object.attrUint64("count"), 30u);
+}
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
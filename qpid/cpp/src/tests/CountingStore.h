@@ -0,0 +1,76 @@
+#ifndef _tests_CountingStore_h
+#define _tests_CountingStore_h
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "qpid/broker/NullMessageStore.h"
+
+namespace qpid {
+namespace tests {
+
+/**
+ * Counts the transactions, enqueues and dequeues made on the store, and
+ * how many of the enqueues and dequeues were made in a transaction.
+ */
+class CountingStore : public broker::NullMessageStore
+{
+  public:
+    int begins;
+    int commits;
+    int enqueues;
+    int txnEnqueues;
+    int dequeues;
+    int txnDequeues;
+
+    CountingStore() : begins(0), commits(0), enqueues(0), txnEnqueues(0),
+                      dequeues(0), txnDequeues(0) {}
+
+    std::auto_ptr<broker::TransactionContext> begin()
+    {
+        ++begins;
+        return broker::NullMessageStore::begin();
+    }
+    void commit(broker::TransactionContext& ctxt)
+    {
+        ++commits;
+        broker::NullMessageStore::commit(ctxt);
+    }
+    void enqueue(broker::TransactionContext* ctxt,
+                 const boost::intrusive_ptr<broker::PersistableMessage>& msg,
+                 const broker::PersistableQueue& queue)
+    {
+        ++enqueues;
+        if (ctxt) ++txnEnqueues;
+        broker::NullMessageStore::enqueue(ctxt, msg, queue);
+    }
+    void dequeue(broker::TransactionContext* ctxt,
+                 const boost::intrusive_ptr<broker::PersistableMessage>& msg,
+                 const broker::PersistableQueue& queue)
+    {
+        ++dequeues;
+        if (ctxt) ++txnDequeues;
+        broker::NullMessageStore::dequeue(ctxt, msg, queue);
+    }
+};
+
+}} // namespace qpid::tests
+
+#endif  /*!_tests_CountingStore_h*/
@@ -0,0 +1,109 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "unit_test.h"
+#include "qpid/Exception.h"
+#include "qpid/sys/Codec.h"
+#include "qpid/sys/zlib/DeflateLayer.h"
+#include <string>
+#include <algorithm>
+#include <string.h>
+
+using qpid::sys::zlib::DeflateLayer;
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(DeflateLayerTestSuite)
+
+namespace {
+/** Hands out a fixed payload to encode, collects what is decoded */
+struct StringCodec : public sys::Codec
+{
+    std::string out;
+    size_t position;
+    std::string in;
+
+    StringCodec(const std::string& s) : out(s), position(0) {}
+
+    size_t decode(const char* buffer, size_t size) {
+        in.append(buffer, size);
+        return size;
+    }
+    size_t encode(const char* buffer, size_t size) {
+        size_t n = std::min(size, out.size() - position);
+        ::memcpy(const_cast<char*>(buffer), out.data() + position, n);
+        position += n;
+        return n;
+    }
+    bool canEncode() { return position < out.size(); }
+};
+
+std::string transfer(DeflateLayer& sender, DeflateLayer& receiver, size_t chunk)
+{
+    std::string wire;
+    std::string buffer(chunk, '\0');
+    while (sender.canEncode()) {
+        size_t n = sender.encode(&buffer[0], buffer.size());
+        if (!n) break;
+        wire.append(buffer, 0, n);
+        receiver.decode(&buffer[0], n);
+    }
+    return wire;
+}
+}
+
+QPID_AUTO_TEST_CASE(testRoundTrip) {
+    std::string payload;
+    for (int i = 0; i < 5000; ++i) payload += "{\"symbol\":\"ABC\",\"price\":123.45},";
+    StringCodec source(payload), sink("");
+    DeflateLayer sender(4096), receiver(4096);
+    sender.init(&source);
+    receiver.init(&sink);
+
+    std::string wire = transfer(sender, receiver, 65536);
+    BOOST_CHECK_EQUAL(sink.in, payload);
+    BOOST_CHECK(wire.size() < payload.size() / 8);
+}
+
+QPID_AUTO_TEST_CASE(testSmallOutputBuffers) {
+    // Output buffers smaller than what one flush produces
+    std::string payload;
+    for (int i = 0; i < 20000; ++i) payload += char('a' + (i * 7919) % 26);
+    StringCodec source(payload), sink("");
+    DeflateLayer sender(1024), receiver(1024);
+    sender.init(&source);
+    receiver.init(&sink);
+
+    transfer(sender, receiver, 64);
+    BOOST_CHECK_EQUAL(sink.in, payload);
+}
+
+QPID_AUTO_TEST_CASE(testCorruptInput) {
+    StringCodec sink("");
+    DeflateLayer receiver(1024);
+    receiver.init(&sink);
+    std::string garbage("this is not a deflate stream");
+    BOOST_CHECK_THROW(receiver.decode(garbage.data(), garbage.size()), qpid::Exception);
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
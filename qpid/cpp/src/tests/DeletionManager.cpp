@@ -0,0 +1,139 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "unit_test.h"
+#include "qpid/sys/DeletionManager.h"
+#include "qpid/sys/Monitor.h"
+#include "qpid/sys/Runnable.h"
+#include "qpid/sys/Thread.h"
+
+using namespace qpid::sys;
+
+namespace qpid {
+namespace tests {
+
+struct Tracked
+{
+    static AtomicValue<int> deleted;
+    ~Tracked() { ++deleted; }
+};
+
+AtomicValue<int> Tracked::deleted;
+
+typedef DeletionManager<Tracked> TrackedDeletionManager;
+
+}} // namespace qpid::tests
+
+namespace qpid {
+namespace sys {
+template <>
+DeletionManager<tests::Tracked>::AllThreadsStatuses DeletionManager<tests::Tracked>::allThreadsStatuses(0);
+}}
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(DeletionManagerTestSuite)
+
+// A thread that marks handles unused, or leaves, when told to
+class Worker : public Runnable
+{
+  public:
+    enum Command { NONE, UNUSED, LEAVE };
+
+    Worker() : command(NONE) {}
+
+    void run() {
+        TrackedDeletionManager::markAllUnusedInThisThread();
+        done();
+        while (true) {
+            Command c = next();
+            if (c == LEAVE) {
+                TrackedDeletionManager::destroyThreadState();
+                done();
+                return;
+            }
+            TrackedDeletionManager::markAllUnusedInThisThread();
+            done();
+        }
+    }
+
+    // Wait for the previous command to complete, then send c
+    void send(Command c) {
+        Monitor::ScopedLock l(monitor);
+        while (command != NONE) monitor.wait();
+        command = c;
+        monitor.notifyAll();
+        while (command != NONE) monitor.wait();
+    }
+
+    void started() {
+        Monitor::ScopedLock l(monitor);
+        command = UNUSED;
+        while (command != NONE) monitor.wait();
+    }
+
+  private:
+    Monitor monitor;
+    Command command;
+
+    Command next() {
+        Monitor::ScopedLock l(monitor);
+        while (command == NONE) monitor.wait();
+        return command;
+    }
+
+    void done() {
+        Monitor::ScopedLock l(monitor);
+        command = NONE;
+        monitor.notifyAll();
+    }
+};
+
+QPID_AUTO_TEST_CASE(testDeletedAfterEveryThread) {
+    Worker worker;
+    Thread thread(worker);
+    worker.started();
+    TrackedDeletionManager::markAllUnusedInThisThread();
+    int before = Tracked::deleted.get();
+
+    TrackedDeletionManager::markForDeletion(new Tracked);
+    TrackedDeletionManager::markAllUnusedInThisThread();
+    BOOST_CHECK_EQUAL(Tracked::deleted.get(), before);
+    worker.send(Worker::UNUSED);
+    BOOST_CHECK_EQUAL(Tracked::deleted.get(), before + 1);
+
+    // A thread that leaves no longer holds deletions back
+    TrackedDeletionManager::markForDeletion(new Tracked);
+    worker.send(Worker::LEAVE);
+    thread.join();
+    BOOST_CHECK_EQUAL(Tracked::deleted.get(), before + 1);
+    TrackedDeletionManager::markAllUnusedInThisThread();
+    BOOST_CHECK_EQUAL(Tracked::deleted.get(), before + 2);
+
+    // With no threads at all a handle goes at once
+    TrackedDeletionManager::destroyThreadState();
+    TrackedDeletionManager::markForDeletion(new Tracked);
+    BOOST_CHECK_EQUAL(Tracked::deleted.get(), before + 3);
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
@@ -61,6 +61,29 @@ QPID_AUTO_TEST_CASE(testSort)
     }
 }
 
+QPID_AUTO_TEST_CASE(testFindRange)
+{
+    DeliveryRecords records;
+    DeliveryRecord::Tag tag(new std::string("tag"));
+    for (uint32_t i = 1; i <= 10; ++i) {
+        if (i == 4 || i == 7) continue; // acked out of order
+        DeliveryRecord r(QueuedMessage(0), Queue::shared_ptr(), tag, false, false, false);
+        r.setId(i);
+        records.push_back(r);
+    }
+    AckRange range = DeliveryRecord::findRange(records, 2, 5);
+    BOOST_CHECK_EQUAL(range.start->getId(), SequenceNumber(2));
+    BOOST_CHECK_EQUAL((range.end - 1)->getId(), SequenceNumber(5));
+    BOOST_CHECK_EQUAL(range.end - range.start, 3);
+
+    range = DeliveryRecord::findRange(records, 7, 10);
+    BOOST_CHECK_EQUAL(range.start->getId(), SequenceNumber(8));
+    BOOST_CHECK(range.end == records.end());
+
+    range = DeliveryRecord::findRange(records, 11, 12);
+    BOOST_CHECK(range.start == records.end());
+    BOOST_CHECK_EQUAL(records.front().getTag(), "tag");
+}
 
 QPID_AUTO_TEST_SUITE_END()
 
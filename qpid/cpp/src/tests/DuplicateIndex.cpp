@@ -0,0 +1,86 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "unit_test.h"
+#include "qpid/broker/DuplicateIndex.h"
+#include <sstream>
+
+using qpid::broker::DuplicateIndex;
+using qpid::sys::AbsTime;
+using qpid::sys::TIME_SEC;
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(DuplicateIndexTestSuite)
+
+QPID_AUTO_TEST_CASE(testDuplicateWithinWindow) {
+    AbsTime start = AbsTime::now();
+    DuplicateIndex index(100, 10 * TIME_SEC);
+    BOOST_CHECK_EQUAL(index.check("a", start), DuplicateIndex::UNSEEN);
+    BOOST_CHECK_EQUAL(index.check("b", start), DuplicateIndex::UNSEEN);
+    BOOST_CHECK_EQUAL(index.check("a", AbsTime(start, 5 * TIME_SEC)), DuplicateIndex::DUPLICATE);
+    // Past the window the id is forgotten, though the filter may still match it
+    BOOST_CHECK(index.check("b", AbsTime(start, 11 * TIME_SEC)) != DuplicateIndex::DUPLICATE);
+    BOOST_CHECK_EQUAL(index.size(), 1u);
+}
+
+QPID_AUTO_TEST_CASE(testCapacityBound) {
+    AbsTime now = AbsTime::now();
+    DuplicateIndex index(10, 60 * TIME_SEC);
+    for (int i = 0; i < 100; ++i) {
+        std::ostringstream id;
+        id << "id-" << i;
+        BOOST_CHECK(index.check(id.str(), now) != DuplicateIndex::DUPLICATE);
+    }
+    BOOST_CHECK_EQUAL(index.size(), 10u);
+    BOOST_CHECK_EQUAL(index.check("id-99", now), DuplicateIndex::DUPLICATE);
+    // Evicted, so no longer caught
+    BOOST_CHECK(index.check("id-0", now) != DuplicateIndex::DUPLICATE);
+}
+
+QPID_AUTO_TEST_CASE(testForget) {
+    AbsTime now = AbsTime::now();
+    DuplicateIndex index(100, 10 * TIME_SEC);
+    BOOST_CHECK_EQUAL(index.check("a", now), DuplicateIndex::UNSEEN);
+    index.forget("a");
+    BOOST_CHECK_EQUAL(index.size(), 0u);
+    // Still in the filter, but a resend is accepted
+    BOOST_CHECK_EQUAL(index.check("a", now), DuplicateIndex::FALSE_POSITIVE);
+    BOOST_CHECK_EQUAL(index.check("a", now), DuplicateIndex::DUPLICATE);
+}
+
+QPID_AUTO_TEST_CASE(testFilterAnswersNewIds) {
+    AbsTime now = AbsTime::now();
+    DuplicateIndex index(1000, 60 * TIME_SEC);
+    size_t falsePositives = 0;
+    for (int i = 0; i < 1000; ++i) {
+        std::ostringstream id;
+        id << "message-" << i;
+        DuplicateIndex::Result r = index.check(id.str(), now);
+        BOOST_CHECK(r != DuplicateIndex::DUPLICATE);
+        if (r == DuplicateIndex::FALSE_POSITIVE) ++falsePositives;
+    }
+    BOOST_CHECK(falsePositives < 50);
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
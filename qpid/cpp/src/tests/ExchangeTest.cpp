@@ -27,11 +27,14 @@
 #include "qpid/broker/ExchangeRegistry.h"
 #include "qpid/broker/FanOutExchange.h"
 #include "qpid/broker/HeadersExchange.h"
+#include "qpid/broker/ReplyToExchange.h"
 #include "qpid/broker/TopicExchange.h"
 #include "qpid/framing/reply_exceptions.h"
 #include "unit_test.h"
 #include <iostream>
+#include <boost/lexical_cast.hpp>
 #include "MessageUtils.h"
+#include "CountingStore.h"
 
 using boost::intrusive_ptr;
 using namespace qpid::broker;
@@ -168,6 +171,27 @@ QPID_AUTO_TEST_CASE(testDeleteGetAndRedeclare)
     BOOST_CHECK_EQUAL(string("direct"), response.first->getType());
 }
 
+namespace {
+Exchange::shared_ptr createPlugged(const std::string& name, bool durable, const FieldTable& args,
+                                   qpid::management::Manageable* parent, qpid::broker::Broker* broker)
+{
+    return Exchange::shared_ptr(new FanOutExchange(name, durable, args, parent, broker));
+}
+}
+
+QPID_AUTO_TEST_CASE(testKnownTypes)
+{
+    ExchangeRegistry exchanges;
+    BOOST_CHECK(exchanges.isKnownType("topic"));
+    BOOST_CHECK(exchanges.isKnownType("headers"));
+    BOOST_CHECK(!exchanges.isKnownType("plugged"));
+    BOOST_CHECK_THROW(exchanges.declare("p", "plugged"), UnknownExchangeTypeException);
+
+    exchanges.registerType("plugged", &createPlugged);
+    BOOST_CHECK(exchanges.isKnownType("plugged"));
+    BOOST_CHECK(exchanges.declare("p", "plugged").second);
+}
+
 intrusive_ptr<Message> cmessage(std::string exchange, std::string routingKey) {
     intrusive_ptr<Message> msg(new Message());
     AMQFrame method((MessageTransferBody(ProtocolVersion(), exchange, 0, 0)));
@@ -284,6 +308,162 @@ QPID_AUTO_TEST_CASE(testIVEOption)
 }
 
 
+QPID_AUTO_TEST_CASE(testTopicRouteCacheInvalidation)
+{
+    Queue::shared_ptr a(new Queue("a", true));
+    Queue::shared_ptr b(new Queue("b", true));
+    TopicExchange topic("topic");
+    BOOST_CHECK(topic.bind(a, "x.*", 0));
+
+    intrusive_ptr<Message> msg(MessageUtils::createMessage("topic", "x.y", false, "id"));
+    DeliverableMessage dmsg(msg);
+    topic.route(dmsg, "x.y", 0);
+    BOOST_CHECK_EQUAL(1u, a->getMessageCount());
+
+    // a new matching binding must be seen despite the cached route
+    BOOST_CHECK(topic.bind(b, "#.y", 0));
+    topic.route(dmsg, "x.y", 0);
+    BOOST_CHECK_EQUAL(2u, a->getMessageCount());
+    BOOST_CHECK_EQUAL(1u, b->getMessageCount());
+
+    // and so must removal of a binding
+    BOOST_CHECK(topic.unbind(a, "x.*", 0));
+    topic.route(dmsg, "x.y", 0);
+    BOOST_CHECK_EQUAL(2u, a->getMessageCount());
+    BOOST_CHECK_EQUAL(2u, b->getMessageCount());
+}
+
+QPID_AUTO_TEST_CASE(testDirectRouteSnapshot)
+{
+    Queue::shared_ptr a(new Queue("a", true));
+    Queue::shared_ptr b(new Queue("b", true));
+    DirectExchange direct("direct");
+    string key("abc");
+
+    intrusive_ptr<Message> msg(MessageUtils::createMessage("direct", key, false, "id"));
+    DeliverableMessage dmsg(msg);
+    direct.route(dmsg, "unbound", 0);
+    BOOST_CHECK(!direct.isBound(Queue::shared_ptr(), 0, 0));
+
+    BOOST_CHECK(direct.bind(a, key, 0));
+    BOOST_CHECK(direct.bind(b, key, 0));
+    direct.route(dmsg, key, 0);
+    BOOST_CHECK_EQUAL(1u, a->getMessageCount());
+    BOOST_CHECK_EQUAL(1u, b->getMessageCount());
+
+    BOOST_CHECK(direct.unbind(a, key, 0));
+    direct.route(dmsg, key, 0);
+    BOOST_CHECK_EQUAL(1u, a->getMessageCount());
+    BOOST_CHECK_EQUAL(2u, b->getMessageCount());
+
+    BOOST_CHECK(direct.unbind(b, key, 0));
+    direct.route(dmsg, key, 0);
+    BOOST_CHECK_EQUAL(2u, b->getMessageCount());
+    BOOST_CHECK(!direct.isBound(Queue::shared_ptr(), &key, 0));
+}
+
+QPID_AUTO_TEST_CASE(testDirectRouteManyKeys)
+{
+    // Enough keys for the route table to grow its shards twice
+    const int count = 2000;
+    Queue::shared_ptr a(new Queue("a", true));
+    Queue::shared_ptr b(new Queue("b", true));
+    DirectExchange direct("direct");
+    for (int i = 0; i < count; ++i)
+        BOOST_CHECK(direct.bind(i % 2 ? a : b, boost::lexical_cast<string>(i), 0));
+
+    for (int i = 0; i < count; ++i) {
+        string key(boost::lexical_cast<string>(i));
+        DeliverableMessage dmsg(MessageUtils::createMessage("direct", key, false, "id"));
+        direct.route(dmsg, key, 0);
+    }
+    BOOST_CHECK_EQUAL(uint32_t(count / 2), a->getMessageCount());
+    BOOST_CHECK_EQUAL(uint32_t(count / 2), b->getMessageCount());
+
+    for (int i = 0; i < count; i += 2)
+        BOOST_CHECK(direct.unbind(b, boost::lexical_cast<string>(i), 0));
+    for (int i = 0; i < count; ++i) {
+        string key(boost::lexical_cast<string>(i));
+        DeliverableMessage dmsg(MessageUtils::createMessage("direct", key, false, "id"));
+        direct.route(dmsg, key, 0);
+    }
+    BOOST_CHECK_EQUAL(uint32_t(count), a->getMessageCount());
+    BOOST_CHECK_EQUAL(uint32_t(count / 2), b->getMessageCount());
+}
+
+QPID_AUTO_TEST_CASE(testDirectBindingBatch)
+{
+    Queue::shared_ptr a(new Queue("a", true));
+    Queue::shared_ptr b(new Queue("b", true));
+    DirectExchange direct("direct");
+    BOOST_CHECK(direct.bind(a, "a", 0));
+
+    direct.beginBindingBatch();
+    BOOST_CHECK(direct.bind(b, "b", 0));
+    BOOST_CHECK(direct.unbind(a, "a", 0));
+    BOOST_CHECK(direct.isBound(b, 0, 0));
+    direct.endBindingBatch();
+    direct.endBindingBatch();   // Ending twice does nothing
+
+    intrusive_ptr<Message> msg(MessageUtils::createMessage("direct", "a", false, "id"));
+    DeliverableMessage dmsg(msg);
+    direct.route(dmsg, "a", 0);
+    direct.route(dmsg, "b", 0);
+    BOOST_CHECK_EQUAL(0u, a->getMessageCount());
+    BOOST_CHECK_EQUAL(1u, b->getMessageCount());
+}
+
+QPID_AUTO_TEST_CASE(testFanoutBatchEnqueuesAsUsual)
+{
+    CountingStore store;
+    Queue::shared_ptr a(new Queue("a", false, &store));
+    Queue::shared_ptr b(new Queue("b", false, &store));
+    Queue::shared_ptr c(new Queue("c", false, &store));
+    FanOutExchange fanout("fanout");
+    BOOST_CHECK(fanout.bind(a, "", 0));
+    BOOST_CHECK(fanout.bind(b, "", 0));
+    BOOST_CHECK(fanout.bind(c, "", 0));
+
+    intrusive_ptr<Message> msg(MessageUtils::createMessage("fanout", "", true));
+    DeliverableMessage dmsg(msg);
+    fanout.route(dmsg, "", 0);
+
+    // Each enqueue goes to the store as usual, for it to batch
+    BOOST_CHECK_EQUAL(0, store.begins);
+    BOOST_CHECK_EQUAL(3, store.enqueues);
+    BOOST_CHECK_EQUAL(0, store.txnEnqueues);
+    BOOST_CHECK_EQUAL(1u, a->getMessageCount());
+    BOOST_CHECK_EQUAL(1u, b->getMessageCount());
+    BOOST_CHECK_EQUAL(1u, c->getMessageCount());
+}
+
+QPID_AUTO_TEST_CASE(testReplyToRoutesByKey)
+{
+    Queue::shared_ptr a(new Queue("a", false));
+    Queue::shared_ptr b(new Queue("b", false));
+    ReplyToExchange replyTo(ReplyToExchange::address);
+    replyTo.add("a", a);
+    replyTo.add("b", b);
+    BOOST_CHECK_THROW(replyTo.bind(a, "a", 0), framing::NotAllowedException);
+
+    intrusive_ptr<Message> msg(MessageUtils::createMessage(ReplyToExchange::address, "b"));
+    DeliverableMessage dmsg(msg);
+    replyTo.route(dmsg, "b", 0);
+    BOOST_CHECK(dmsg.delivered);
+    BOOST_CHECK_EQUAL(0u, a->getMessageCount());
+    BOOST_CHECK_EQUAL(1u, b->getMessageCount());
+
+    replyTo.remove("b");
+    DeliverableMessage dropped(msg);
+    replyTo.route(dropped, "b", 0);
+    BOOST_CHECK(!dropped.delivered);
+
+    a.reset();
+    DeliverableMessage gone(msg);
+    replyTo.route(gone, "a", 0);
+    BOOST_CHECK(!gone.delivered);
+}
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
@@ -24,7 +24,9 @@
 #include "qpid/framing/FrameDecoder.h"
 #include "qpid/framing/AMQContentBody.h"
 #include "qpid/framing/Buffer.h"
+#include "qpid/RefCountedBuffer.h"
 #include <string>
+#include <string.h>
 
 
 namespace qpid {
@@ -71,6 +73,48 @@ QPID_AUTO_TEST_CASE(testByteFragments) {
     BOOST_CHECK_EQUAL(data, getData(decoder.getFrame()));
 }
 
+QPID_AUTO_TEST_CASE(testFramesAcrossBuffers) {
+    string encoded;
+    for (int i = 1; i <= 5; ++i)
+        encoded += encodeFrame(makeData(i*100));
+    // Split into reads that don't line up with frame boundaries.
+    FrameDecoder decoder;
+    int frames = 0;
+    for (size_t i = 0; i < encoded.size(); i += 333) {
+        Buffer buf(&encoded[i], std::min(size_t(333), encoded.size()-i));
+        while (decoder.decode(buf))
+            BOOST_CHECK_EQUAL(makeData(++frames*100), getData(decoder.getFrame()));
+        BOOST_CHECK_EQUAL(buf.available(), 0u);
+    }
+    BOOST_CHECK_EQUAL(frames, 5);
+}
+
+QPID_AUTO_TEST_CASE(testSharedContent) {
+    string encoded = encodeFrame(makeData(1000)) + encodeFrame(makeData(10));
+    BufferRef store = RefCountedBuffer::create(encoded.size());
+    ::memcpy(store.begin(), encoded.data(), encoded.size());
+    ConstBufferRef shared(store);
+    Buffer buf(store.begin(), encoded.size());
+    FrameDecoder decoder;
+
+    // The large body refers to the shared buffer
+    BOOST_REQUIRE(decoder.decode(buf, shared));
+    const AMQContentBody* large = dynamic_cast<const AMQContentBody*>(decoder.getFrame().getBody());
+    BOOST_REQUIRE(large);
+    const char* start = large->slice(0, 1000).begin();
+    BOOST_CHECK(start >= store.begin() && start < store.end());
+    BOOST_CHECK_EQUAL(makeData(1000), getData(decoder.getFrame()));
+
+    // The small one is copied
+    BOOST_REQUIRE(decoder.decode(buf, shared));
+    const AMQContentBody* small = dynamic_cast<const AMQContentBody*>(decoder.getFrame().getBody());
+    BOOST_REQUIRE(small);
+    start = small->slice(0, 10).begin();
+    BOOST_CHECK(start < store.begin() || start >= store.end());
+    BOOST_CHECK_EQUAL(makeData(10), getData(decoder.getFrame()));
+    BOOST_CHECK_EQUAL(buf.available(), 0u);
+}
+
 
 
 QPID_AUTO_TEST_SUITE_END()
@@ -0,0 +1,140 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "unit_test.h"
+#include "qpid/amqp_0_10/Connection.h"
+#include "qpid/framing/AMQFrame.h"
+#include "qpid/framing/AMQContentBody.h"
+#include "qpid/framing/AMQHeaderBody.h"
+#include "qpid/framing/Buffer.h"
+#include "qpid/framing/MessageTransferBody.h"
+#include "qpid/framing/SessionAttachedBody.h"
+#include "qpid/framing/SessionCompletedBody.h"
+#include "qpid/sys/ConnectionInputHandler.h"
+#include "qpid/sys/OutputControl.h"
+#include <vector>
+
+using namespace qpid::framing;
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(FrameOutputTestSuite)
+
+namespace {
+struct NullOutput : public sys::OutputControl {
+    void abort() {}
+    void activateOutput() {}
+    void giveReadCredit(int32_t) {}
+};
+
+struct NullInput : public sys::ConnectionInputHandler {
+    void received(AMQFrame&) {}
+    void idleOut() {}
+    void idleIn() {}
+    bool doOutput() { return false; }
+    void closed() {}
+};
+
+struct Fixture {
+    NullOutput output;
+    amqp_0_10::Connection connection;
+
+    Fixture() : connection(output, "test", true) {
+        connection.setInputHandler(std::auto_ptr<sys::ConnectionInputHandler>(new NullInput));
+    }
+
+    void sendTransfer() {
+        AMQFrame method((MessageTransferBody(ProtocolVersion(), "d", 1, 0)));
+        method.setEof(false);
+        connection.send(method);
+        AMQFrame header((AMQHeaderBody()));
+        header.setBof(false);
+        header.setEof(false);
+        connection.send(header);
+        AMQFrame content((AMQContentBody("data")));
+        content.setBof(false);
+        connection.send(content);
+    }
+
+    void send(const AMQBody& body) {
+        AMQFrame frame(body);
+        connection.send(frame);
+    }
+
+    /** Encode everything queued and decode it again */
+    std::vector<AMQFrame> sent() {
+        std::vector<char> buffer(65536);
+        size_t size = connection.encode(&buffer[0], buffer.size());
+        Buffer in(&buffer[0], size);
+        std::vector<AMQFrame> frames;
+        AMQFrame frame;
+        while (frame.decode(in)) frames.push_back(frame);
+        return frames;
+    }
+};
+
+bool isCompleted(const AMQFrame& f) {
+    return f.getMethod() && f.getMethod()->isA<SessionCompletedBody>();
+}
+}
+
+QPID_AUTO_TEST_CASE(testCompletedOvertakesTransfers) {
+    Fixture f;
+    f.sendTransfer();
+    f.sendTransfer();
+    f.send(SessionCompletedBody(ProtocolVersion(), SequenceSet(1), false));
+    std::vector<AMQFrame> frames = f.sent();
+    BOOST_REQUIRE_EQUAL(frames.size(), 7u);
+    BOOST_CHECK(isCompleted(frames[0]));
+    BOOST_CHECK(frames[1].getMethod() && frames[1].getMethod()->isA<MessageTransferBody>());
+}
+
+QPID_AUTO_TEST_CASE(testControlsWaitForFrameset) {
+    Fixture f;
+    // A partly sent frameset is completed before the control goes out
+    AMQFrame method((MessageTransferBody(ProtocolVersion(), "d", 1, 0)));
+    method.setEof(false);
+    f.connection.send(method);
+    BOOST_REQUIRE_EQUAL(f.sent().size(), 1u);
+    AMQFrame header((AMQHeaderBody()));
+    header.setBof(false);
+    f.connection.send(header);
+    f.send(SessionCompletedBody(ProtocolVersion(), SequenceSet(1), false));
+    std::vector<AMQFrame> frames = f.sent();
+    BOOST_REQUIRE_EQUAL(frames.size(), 2u);
+    BOOST_CHECK_EQUAL(frames[0].getBody()->type(), HEADER_BODY);
+    BOOST_CHECK(isCompleted(frames[1]));
+}
+
+QPID_AUTO_TEST_CASE(testControlsKeepOrderWithBarriers) {
+    Fixture f;
+    f.sendTransfer();
+    f.send(SessionAttachedBody(ProtocolVersion(), "s"));
+    f.send(SessionCompletedBody(ProtocolVersion(), SequenceSet(1), false));
+    std::vector<AMQFrame> frames = f.sent();
+    BOOST_REQUIRE_EQUAL(frames.size(), 5u);
+    BOOST_CHECK(frames[3].getMethod() && frames[3].getMethod()->isA<SessionAttachedBody>());
+    BOOST_CHECK(isCompleted(frames[4]));
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
@@ -162,6 +162,36 @@ QPID_AUTO_TEST_CASE(badStrings) {
     b.putMediumString(std::string(65535, 'X'));
 }
 
+QPID_AUTO_TEST_CASE(testContentBodySlice)
+{
+    boost::intrusive_ptr<AMQContentBody> body(new AMQContentBody("abcdefghij"));
+    AMQContentBody slice(body->slice(2, 5));
+    BOOST_CHECK_EQUAL(5u, slice.encodedSize());
+
+    char buffer[16];
+    Buffer wbuff(buffer, sizeof(buffer));
+    slice.encode(wbuff);
+    BOOST_CHECK_EQUAL(std::string("cdefg"), std::string(buffer, wbuff.getPosition()));
+
+    // The slice keeps the original body alive
+    AMQContentBody* original = body.get();
+    BOOST_CHECK_EQUAL(2, original->refCount());
+    body = 0;
+    const AMQContentBody& shared = slice;
+    BOOST_CHECK_EQUAL(std::string("cdefg"), shared.getData());
+
+    // Reading a copy does not stop the slice sharing the content
+    AMQContentBody copy(slice);
+    BOOST_CHECK_EQUAL(std::string("cdefg"), static_cast<const AMQContentBody&>(copy).getData());
+    BOOST_CHECK_EQUAL(2, original->refCount());
+
+    // Asking to modify the content copies it out
+    slice.getData()[0] = 'C';
+    BOOST_CHECK_EQUAL(1, original->refCount());
+    BOOST_CHECK_EQUAL(std::string("Cdefg"), slice.getData());
+    BOOST_CHECK_EQUAL(std::string("cdefg"), copy.getData());
+}
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
@@ -21,9 +21,12 @@
 
 #include "qpid/Exception.h"
 #include "qpid/broker/HeadersExchange.h"
+#include "qpid/broker/DeliverableMessage.h"
+#include "qpid/broker/Queue.h"
 #include "qpid/framing/FieldTable.h"
 #include "qpid/framing/FieldValue.h"
 #include "unit_test.h"
+#include "MessageUtils.h"
 
 using namespace qpid::broker;
 using namespace qpid::framing;
@@ -115,6 +118,57 @@ QPID_AUTO_TEST_CASE(testBindNoXMatch)
     }
 }
 
+QPID_AUTO_TEST_CASE(testRouteThroughIndex)
+{
+    HeadersExchange exchange("test");
+    Queue::shared_ptr all(new Queue("all", true));
+    Queue::shared_ptr any(new Queue("any", true));
+    Queue::shared_ptr present(new Queue("present", true));
+    Queue::shared_ptr other(new Queue("other", true));
+
+    FieldTable allArgs;
+    allArgs.setString("x-match", "all");
+    allArgs.setString("a", "A");
+    allArgs.setInt("n", 1);
+    BOOST_CHECK(exchange.bind(all, "", &allArgs));
+    FieldTable anyArgs;
+    anyArgs.setString("x-match", "any");
+    anyArgs.setString("a", "A");
+    anyArgs.setString("b", "B");
+    BOOST_CHECK(exchange.bind(any, "", &anyArgs));
+    FieldTable presentArgs;
+    presentArgs.setString("x-match", "all");
+    presentArgs.set("a", FieldTable::ValuePtr(new VoidValue()));
+    BOOST_CHECK(exchange.bind(present, "", &presentArgs));
+    FieldTable otherArgs;
+    otherArgs.setString("x-match", "all");
+    otherArgs.setString("a", "X");
+    BOOST_CHECK(exchange.bind(other, "", &otherArgs));
+
+    boost::intrusive_ptr<Message> msg(MessageUtils::createMessage("test", "", false, "id"));
+    DeliverableMessage dmsg(msg);
+    FieldTable headers;
+    headers.setString("a", "A");
+    exchange.route(dmsg, "", &headers);
+    BOOST_CHECK_EQUAL(0u, all->getMessageCount());
+    BOOST_CHECK_EQUAL(1u, any->getMessageCount());
+    BOOST_CHECK_EQUAL(1u, present->getMessageCount());
+    BOOST_CHECK_EQUAL(0u, other->getMessageCount());
+
+    headers.setInt("n", 1);
+    exchange.route(dmsg, "", &headers);
+    BOOST_CHECK_EQUAL(1u, all->getMessageCount());
+    BOOST_CHECK_EQUAL(2u, any->getMessageCount());
+    BOOST_CHECK_EQUAL(2u, present->getMessageCount());
+
+    // unbinding must take effect in the index
+    BOOST_CHECK(exchange.unbind(any, "", 0));
+    FieldTable onlyB;
+    onlyB.setString("b", "B");
+    exchange.route(dmsg, "", &onlyB);
+    BOOST_CHECK_EQUAL(2u, any->getMessageCount());
+}
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
@@ -0,0 +1,63 @@
+#ifndef TESTS_HEAPCOUNTER_H
+#define TESTS_HEAPCOUNTER_H
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+/**
+ * Replaces the global operator new and delete with versions that count
+ * the allocations made and the bytes held, for the benchmarks that
+ * report heap use. Include it from exactly one source file of a program.
+ */
+
+#include <new>
+#include <stdlib.h>
+
+namespace qpid {
+namespace tests {
+namespace heap {
+size_t allocations = 0;
+size_t held = 0;
+// Each block records its size ahead of the caller's memory
+const size_t HEADER = 16;
+}
+}} // namespace qpid::tests::heap
+
+void* operator new(size_t size)
+{
+    using namespace qpid::tests::heap;
+    char* p = static_cast<char*>(::malloc(size + HEADER));
+    if (!p) throw std::bad_alloc();
+    *reinterpret_cast<size_t*>(p) = size;
+    ++allocations;
+    held += size;
+    return p + HEADER;
+}
+
+void operator delete(void* p) throw()
+{
+    using namespace qpid::tests::heap;
+    if (!p) return;
+    char* block = static_cast<char*>(p) - HEADER;
+    held -= *reinterpret_cast<size_t*>(block);
+    ::free(block);
+}
+
+#endif  /*!TESTS_HEAPCOUNTER_H*/
@@ -0,0 +1,61 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "unit_test.h"
+#include "qpid/sys/HugePages.h"
+
+using qpid::sys::HugePages;
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(HugePagesTestSuite)
+
+QPID_AUTO_TEST_CASE(testParseSize) {
+    BOOST_CHECK_EQUAL(HugePages::parseSize("2M"), size_t(2 * 1024 * 1024));
+    BOOST_CHECK_EQUAL(HugePages::parseSize("1G"), size_t(1024 * 1024 * 1024));
+    BOOST_CHECK_EQUAL(HugePages::parseSize("no"), size_t(0));
+    BOOST_CHECK_EQUAL(HugePages::parseSize("4K"), size_t(0));
+    BOOST_CHECK(!HugePages::configure(4096));
+}
+
+QPID_AUTO_TEST_CASE(testHeapBlockNotReleased) {
+    char onStack;
+    BOOST_CHECK(!HugePages::release(&onStack, 1));
+}
+
+QPID_AUTO_TEST_CASE(testReuse) {
+    // Only meaningful where huge pages are supported and some are reserved
+    if (!HugePages::configure(HugePages::parseSize("2M"))) return;
+    void* a = HugePages::allocate(4096);
+    if (!a) return;
+    BOOST_CHECK_EQUAL(reinterpret_cast<size_t>(a) % 4096, size_t(0));
+    HugePages::Stats stats;
+    HugePages::getStats(stats);
+    BOOST_CHECK_EQUAL(stats.pageSize, uint64_t(2 * 1024 * 1024));
+    BOOST_CHECK(stats.bytesInUse >= 4096u);
+    BOOST_CHECK(HugePages::release(a, 4096));
+    BOOST_CHECK_EQUAL(HugePages::allocate(4096), a);
+    BOOST_CHECK(HugePages::release(a, 4096));
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
@@ -0,0 +1,117 @@
+/*
+ *
+ * Copyright (c) 2006 The Apache Software Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "unit_test.h"
+#include "test_tools.h"
+#include "qpid/sys/LatencyHistogram.h"
+#include "qpid/sys/Mutex.h"
+#include "qpid/sys/Time.h"
+#include <boost/bind.hpp>
+
+using qpid::sys::LatencyHistogram;
+using qpid::sys::TIME_USEC;
+using qpid::sys::TIME_MSEC;
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(LatencyHistogramTestSuite)
+
+QPID_AUTO_TEST_CASE(testBuckets) {
+    // Every value falls at or under the upper bound of its bucket and
+    // over that of the bucket before
+    for (uint64_t micros = 0; micros < 100000; ++micros) {
+        uint32_t b = LatencyHistogram::bucket(micros);
+        BOOST_CHECK(micros <= LatencyHistogram::upperBound(b));
+        if (b > 0) BOOST_CHECK(micros > LatencyHistogram::upperBound(b - 1));
+    }
+    BOOST_CHECK_EQUAL(LatencyHistogram::bucket(3), 3u);
+    BOOST_CHECK_EQUAL(LatencyHistogram::upperBound(4), 4u);
+    BOOST_CHECK_EQUAL(LatencyHistogram::upperBound(8), 9u);
+    BOOST_CHECK_EQUAL(LatencyHistogram::bucket(uint64_t(1) << 62), LatencyHistogram::BUCKETS - 1);
+}
+
+QPID_AUTO_TEST_CASE(testSnapshot) {
+    LatencyHistogram h;
+    h.record(2*TIME_USEC);
+    h.record(2*TIME_USEC);
+    h.record(500*TIME_USEC);
+    h.record(-TIME_USEC);
+    types::Variant::Map counts;
+    h.snapshot(counts);
+    BOOST_CHECK_EQUAL(counts.size(), 3u);
+    BOOST_CHECK_EQUAL(counts["0"].asUint64(), 1u);
+    BOOST_CHECK_EQUAL(counts["2"].asUint64(), 2u);
+    BOOST_CHECK_EQUAL(counts["511"].asUint64(), 1u);
+}
+
+QPID_AUTO_TEST_CASE(testPercentile) {
+    LatencyHistogram h;
+    BOOST_CHECK_EQUAL(h.percentile(0.99), 0u);
+    for (int i = 0; i < 990; ++i) h.record(2*TIME_USEC);
+    for (int i = 0; i < 9; ++i) h.record(500*TIME_USEC);
+    h.record(TIME_MSEC * 100);
+    BOOST_CHECK_EQUAL(h.percentile(0.5), 2u);
+    BOOST_CHECK_EQUAL(h.percentile(0.99), 2u);
+    BOOST_CHECK_EQUAL(h.percentile(0.995), 511u);
+    uint64_t max = h.percentile(1.0);
+    BOOST_CHECK(max >= 100000u && max < 125000u);
+}
+
+namespace {
+struct Exported {
+    sys::Mutex lock;
+    int calls;
+    size_t buckets;
+    Exported() : calls(0), buckets(0) {}
+    void set(const types::Variant::Map& counts) {
+        sys::Mutex::ScopedLock l(lock);
+        ++calls;
+        buckets = counts.size();
+    }
+    int getCalls() { sys::Mutex::ScopedLock l(lock); return calls; }
+};
+}
+
+QPID_AUTO_TEST_CASE(testExport) {
+    LatencyHistogram h;
+    Exported exported;
+    sys::Timer timer;
+    boost::intrusive_ptr<sys::TimerTask> task(
+        new sys::LatencyHistogramExport(h, boost::bind(&Exported::set, &exported, _1), timer, 10*TIME_MSEC));
+    timer.add(task);
+
+    sys::usleep(100*1000);      // Nothing recorded, so nothing to export
+    BOOST_CHECK_EQUAL(exported.getCalls(), 0);
+    h.record(TIME_MSEC);
+    h.record(TIME_MSEC);
+    BOOST_CHECK_EQUAL(h.total(), 2u);
+    sys::usleep(100*1000);
+    BOOST_CHECK_EQUAL(exported.getCalls(), 1);
+    sys::usleep(100*1000);      // Unchanged since
+    BOOST_CHECK_EQUAL(exported.getCalls(), 1);
+    h.record(2*TIME_MSEC);
+    sys::usleep(100*1000);
+    BOOST_CHECK_EQUAL(exported.getCalls(), 2);
+    BOOST_CHECK_EQUAL(exported.buckets, 2u);
+    task->cancel();
+    timer.stop();
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
@@ -20,8 +20,13 @@
  */
 
 #include "qpid/management/ManagementObject.h"
+#include "qpid/management/Manageable.h"
+#include "qpid/management/MapEncoder.h"
+#include "qpid/amqp_0_10/Codecs.h"
 #include "qpid/framing/Buffer.h"
 #include "qpid/console/ObjectId.h"
+#include "qmf/org/apache/qpid/broker/System.h"
+#include "qmf/org/apache/qpid/store/Store.h"
 #include "unit_test.h"
 
 namespace qpid {
@@ -31,6 +36,7 @@ QPID_AUTO_TEST_SUITE(ManagementTestSuite)
 
 using namespace qpid::framing;
 using namespace qpid::management;
+namespace _qmf = qmf::org::apache::qpid::store;
 
 QPID_AUTO_TEST_CASE(testObjectIdSerializeStream) {
     std::string text("0-10-4-2500-80000000000()");
@@ -119,6 +125,131 @@ QPID_AUTO_TEST_CASE(testConsoleObjectId) {
     BOOST_CHECK(oid1 == oid2);
 }
 
+QPID_AUTO_TEST_CASE(testMapEncoderMatchesCodecs) {
+    using qpid::types::Variant;
+    using qpid::amqp_0_10::ListCodec;
+
+    // Keys in order, as the codecs write them
+    Variant::Map inner;
+    inner["a"] = uint32_t(7);
+    inner["b"] = "nested";
+    Variant::List items;
+    items.push_back(int16_t(-2));
+    items.push_back("item");
+    Variant utf8("utf8 text");
+    utf8.setEncoding("utf8");
+    qpid::types::Uuid uuid(true);
+
+    Variant::Map map;
+    map["bool"] = true;
+    map["double"] = 2.5;
+    map["float"] = 1.5f;
+    map["i16"] = int16_t(-300);
+    map["i32"] = int32_t(-70000);
+    map["i64"] = int64_t(-5000000000LL);
+    map["i8"] = int8_t(-3);
+    map["list"] = items;
+    map["long"] = std::string(70000, 'x');
+    map["map"] = inner;
+    map["oid"] = ObjectId("agent", "name", 5);
+    map["str"] = "text";
+    map["u16"] = uint16_t(300);
+    map["u32"] = uint32_t(70000);
+    map["u64"] = uint64_t(5000000000ULL);
+    map["u8"] = uint8_t(3);
+    map["utf8"] = utf8;
+    map["uuid"] = uuid;
+    map["void"] = Variant();
+    Variant::List list;
+    list.push_back(map);
+    list.push_back(Variant::Map());
+    list.push_back(uint8_t(1));
+    std::string expected;
+    ListCodec::encode(list, expected);
+
+    std::string encoded;
+    MapEncoder e(encoded);
+    e.beginList();
+    e.beginMap();
+    e.put("bool", true);
+    e.put("double", 2.5);
+    e.put("float", 1.5f);
+    e.put("i16", int16_t(-300));
+    e.put("i32", int32_t(-70000));
+    e.put("i64", int64_t(-5000000000LL));
+    e.put("i8", int8_t(-3));
+    e.beginList("list");
+    e.put(int16_t(-2));
+    e.put("item");
+    e.end();
+    e.put("long", std::string(70000, 'x'));
+    e.put("map", inner);
+    e.put("oid", ObjectId("agent", "name", 5));
+    e.put("str", "text");
+    e.put("u16", uint16_t(300));
+    e.put("u32", uint32_t(70000));
+    e.put("u64", uint64_t(5000000000ULL));
+    e.put("u8", uint8_t(3));
+    e.put("utf8", utf8);
+    e.put("uuid", uuid);
+    e.put("void", Variant());
+    BOOST_CHECK_EQUAL(e.count(), 19u);
+    e.end();
+    e.beginMap();
+    e.end();
+    e.put(uint8_t(1));
+    e.end();
+    BOOST_CHECK_EQUAL(e.depth(), 0u);
+
+    BOOST_CHECK(encoded == expected);
+    BOOST_CHECK_THROW(e.put("key", true), qpid::Exception);
+}
+
+namespace {
+struct TestManageable : public Manageable {
+    ManagementObject* object;
+    TestManageable() : object(0) {}
+    ManagementObject* GetManagementObject() const { return object; }
+};
+
+void update(_qmf::Store& store)
+{
+    store.set_provider("test");
+    store.inc_enqueues(3);
+    store.set_enqueueLatency(1000);
+    store.set_enqueueLatency(3000);
+}
+}
+
+QPID_AUTO_TEST_CASE(testGeneratedMapEncoder) {
+    using qpid::types::Variant;
+
+    TestManageable broker;
+    qmf::org::apache::qpid::broker::System system(0, &broker, qpid::types::Uuid(true));
+    broker.object = &system;
+    TestManageable core;
+    _qmf::Store s1(0, &core, &broker);
+    _qmf::Store s2(0, &core, &broker);
+    update(s1);
+    update(s2);
+
+    Variant::Map expected;
+    s1.mapEncodeValues(expected, true, true);
+
+    std::string encoded;
+    MapEncoder e(encoded);
+    e.beginMap();
+    s2.mapEncodeValues(e, true, true);
+    e.end();
+    Variant::Map values;
+    qpid::amqp_0_10::MapCodec::decode(encoded, values);
+
+    BOOST_CHECK_EQUAL(values.size(), expected.size());
+    BOOST_CHECK_EQUAL(Variant(values), Variant(expected));
+    BOOST_CHECK_EQUAL(values["enqueueLatencyAvg"].asUint64(), 2000u);
+    BOOST_CHECK_EQUAL(values["stageLatencyMin"], Variant(0));
+}
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
@@ -18,6 +18,7 @@
  * under the License.
  *
  */
+#include "qpid/broker/ContentSpill.h"
 #include "qpid/broker/Message.h"
 #include "qpid/broker/MessageBuilder.h"
 #include "qpid/broker/NullMessageStore.h"
@@ -185,6 +186,78 @@ QPID_AUTO_TEST_CASE(test2ContentFrames)
     BOOST_CHECK(builder.getMessage());
     BOOST_CHECK(builder.getMessage()->getFrames().isComplete());
 }
+
+namespace {
+void buildLarge(MessageBuilder& builder, const std::string& data1, const std::string& data2, uint64_t declared)
+{
+    builder.start(SequenceNumber());
+    AMQFrame method((MessageTransferBody(ProtocolVersion(), "builder-exchange", 0, 0)));
+    AMQFrame header((AMQHeaderBody()));
+    AMQFrame content1((AMQContentBody(data1)));
+    AMQFrame content2((AMQContentBody(data2)));
+    method.setEof(false);
+    header.setBof(false);
+    header.setEof(false);
+    content1.setBof(false);
+    content1.setEof(false);
+    content2.setBof(false);
+    header.castBody<AMQHeaderBody>()->get<MessageProperties>(true)->setContentLength(declared);
+    builder.handle(method);
+    builder.handle(header);
+    builder.handle(content1);
+    builder.handle(content2);
+}
+}
+
+QPID_AUTO_TEST_CASE(testSpillReceivedContent)
+{
+    ContentSpill spill(0, "/tmp", 0, 0);
+    MessageBuilder builder(0, &spill, 10);
+    std::string data1("abcdefg");
+    std::string data2("hijklmn");
+    buildLarge(builder, data1, data2, data1.size() + data2.size());
+
+    boost::intrusive_ptr<Message> msg = builder.getMessage();
+    BOOST_CHECK(msg->isContentSpilled());
+    BOOST_CHECK_EQUAL(msg->contentSize(), data1.size() + data2.size());
+    BOOST_CHECK_EQUAL(spill.getSpilledBytes(), data1.size() + data2.size());
+    BOOST_CHECK(msg->getFrames().getContent().empty());
+    builder.end();
+
+    msg->restoreContent();
+    BOOST_CHECK(!msg->isContentSpilled());
+    BOOST_CHECK(msg->getFrames().isComplete());
+    BOOST_CHECK_EQUAL(msg->getFrames().getContent(), data1 + data2);
+    BOOST_CHECK_EQUAL(spill.getSpilledBytes(), 0u);
+}
+
+QPID_AUTO_TEST_CASE(testSpillReceivedContentNeedsDeclaredLength)
+{
+    ContentSpill spill(0, "/tmp", 0, 0);
+    MessageBuilder builder(0, &spill, 10);
+    std::string data1("abcdefg");
+    std::string data2("hijklmn");
+
+    // Below the threshold: held in frames
+    buildLarge(builder, data1, data2, 8);
+    BOOST_CHECK(!builder.getMessage()->isContentSpilled());
+    builder.end();
+
+    // More content than declared: falls back to frames
+    buildLarge(builder, data1, data2, 11);
+    BOOST_CHECK(!builder.getMessage()->isContentSpilled());
+    BOOST_CHECK(builder.getMessage()->getFrames().isComplete());
+    BOOST_CHECK_EQUAL(builder.getMessage()->getFrames().getContent(), data1 + data2);
+    builder.end();
+
+    // Less content than declared: falls back to frames
+    buildLarge(builder, data1, data2, 20);
+    BOOST_CHECK(!builder.getMessage()->isContentSpilled());
+    BOOST_CHECK(builder.getMessage()->getFrames().isComplete());
+    BOOST_CHECK_EQUAL(builder.getMessage()->getFrames().getContent(), data1 + data2);
+    builder.end();
+    BOOST_CHECK_EQUAL(spill.getSpilledBytes(), 0u);
+}
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
@@ -18,11 +18,15 @@
  * under the License.
  *
  */
+#include "qpid/broker/ContentSpill.h"
 #include "qpid/broker/Message.h"
+#include "qpid/broker/NullMessageStore.h"
+#include "qpid/broker/Queue.h"
 #include "qpid/framing/AMQP_HighestVersion.h"
 #include "qpid/framing/AMQFrame.h"
 #include "qpid/framing/MessageTransferBody.h"
 #include "qpid/framing/FieldValue.h"
+#include "qpid/framing/FrameHandler.h"
 #include "qpid/framing/Uuid.h"
 #include "qpid/sys/alloca.h"
 
@@ -87,6 +91,155 @@ QPID_AUTO_TEST_CASE(testEncodeDecode)
     BOOST_CHECK(msg->isPersistent());
 }
 
+struct FrameCollector : FrameHandler {
+    std::vector<AMQFrame> frames;
+    void handle(AMQFrame& f) { frames.push_back(f); }
+};
+
+string encode(const AMQHeaderBody& header) {
+    string encoded(header.encodedSize(), '\0');
+    Buffer buffer(&encoded[0], encoded.size());
+    header.encode(buffer);
+    BOOST_CHECK_EQUAL(buffer.available(), 0u);
+    return encoded;
+}
+
+QPID_AUTO_TEST_CASE(testSendHeaderAfterRedelivery)
+{
+    boost::intrusive_ptr<Message> msg(new Message());
+    AMQFrame method((MessageTransferBody(ProtocolVersion(), "e", 0, 0)));
+    AMQFrame header((AMQHeaderBody()));
+    msg->getFrames().append(method);
+    msg->getFrames().append(header);
+    MessageProperties* mProps = msg->getFrames().getHeaders()->get<MessageProperties>(true);
+    mProps->setMessageId(Uuid(true));
+    mProps->getApplicationHeaders().setString("abc", "xyz");
+    msg->getFrames().getHeaders()->get<DeliveryProperties>(true)->setRoutingKey("k");
+
+    FrameCollector out;
+    msg->sendHeader(out, 0);
+    msg->setRedelivered();
+    msg->sendHeader(out, 0);
+    msg->setRedelivered();//already set, so needs no further copy
+    msg->sendHeader(out, 0);
+    BOOST_REQUIRE_EQUAL(out.frames.size(), 3u);
+    BOOST_CHECK(out.frames[0].getBody() != out.frames[1].getBody());
+    BOOST_CHECK(out.frames[1].getBody() == out.frames[2].getBody());
+
+    const AMQHeaderBody* first = out.frames[0].castBody<AMQHeaderBody>();
+    const AMQHeaderBody* second = out.frames[1].castBody<AMQHeaderBody>();
+    BOOST_CHECK(!first->get<DeliveryProperties>()->getRedelivered());
+    BOOST_CHECK(second->get<DeliveryProperties>()->getRedelivered());
+
+    AMQHeaderBody decoded;
+    string encoded = encode(*second);
+    Buffer buffer(&encoded[0], encoded.size());
+    decoded.decode(buffer, encoded.size());
+    BOOST_CHECK(decoded.get<DeliveryProperties>()->getRedelivered());
+    BOOST_CHECK_EQUAL(string("k"), decoded.get<DeliveryProperties>()->getRoutingKey());
+    BOOST_CHECK_EQUAL(mProps->getMessageId(), decoded.get<MessageProperties>()->getMessageId());
+    BOOST_CHECK_EQUAL(string("xyz"), decoded.get<MessageProperties>()->getApplicationHeaders().getAsString("abc"));
+    BOOST_CHECK_EQUAL(encode(decoded), encoded);
+}
+
+QPID_AUTO_TEST_CASE(testSpillContent)
+{
+    string data(5000, 'x');
+    boost::intrusive_ptr<Message> msg(new Message());
+    AMQFrame method((MessageTransferBody(ProtocolVersion(), "e", 0, 0)));
+    AMQFrame header((AMQHeaderBody()));
+    AMQFrame content((AMQContentBody(data)));
+    msg->getFrames().append(method);
+    msg->getFrames().append(header);
+    msg->getFrames().append(content);
+    string encoded(msg->encodedSize(), '\0');
+    Buffer before(&encoded[0], encoded.size());
+    msg->encode(before);
+
+    ContentSpill spill(0, "/tmp", 1, 8);
+    BOOST_CHECK(msg->spillContent(spill));
+    BOOST_CHECK(msg->isContentSpilled());
+    BOOST_CHECK(!msg->spillContent(spill));
+    BOOST_CHECK_EQUAL(msg->getFrames().getContent(), string());
+    BOOST_CHECK_EQUAL(msg->contentSize(), (uint64_t) data.size());
+    BOOST_CHECK_EQUAL(spill.getSpilledBytes(), (uint64_t) data.size());
+
+    //encoding and delivery read the content from the spill
+    string spilled(msg->encodedSize(), '\0');
+    Buffer after(&spilled[0], spilled.size());
+    msg->encode(after);
+    BOOST_CHECK(spilled == encoded);
+    Queue queue("q");
+    FrameCollector out;
+    msg->sendContent(queue, out, 1024);
+    string sent;
+    for (std::vector<AMQFrame>::iterator i = out.frames.begin(); i != out.frames.end(); ++i)
+        sent += i->castBody<AMQContentBody>()->getData();
+    BOOST_CHECK(sent == data);
+    BOOST_CHECK(out.frames.front().getBof() && out.frames.back().getEof());
+
+    spill.restore(msg);
+    BOOST_CHECK(!msg->isContentSpilled());
+    BOOST_CHECK(msg->getFrames().getContent() == data);
+    BOOST_CHECK_EQUAL(spill.getSpilledBytes(), 0u);
+}
+
+namespace {
+/** Keeps the content of one message, counting the reads */
+struct ContentStore : public NullMessageStore
+{
+    string content;
+    uint32_t reads;
+
+    ContentStore(const string& c) : content(c), reads(0) {}
+    void loadContent(const PersistableQueue&, const boost::intrusive_ptr<const PersistableMessage>&,
+                     string& data, uint64_t offset, uint32_t length)
+    {
+        ++reads;
+        data = content.substr(offset, length);
+    }
+};
+}
+
+QPID_AUTO_TEST_CASE(testPrefetchContent)
+{
+    string data(5000, 'x');
+    boost::intrusive_ptr<Message> msg(new Message());
+    AMQFrame method((MessageTransferBody(ProtocolVersion(), "e", 0, 0)));
+    AMQFrame header((AMQHeaderBody()));
+    header.setEof(false);
+    header.setEos(false);
+    AMQFrame content((AMQContentBody(data)));
+    content.setFirstSegment(false);
+    msg->getFrames().append(method);
+    msg->getFrames().append(header);
+    msg->getFrames().append(content);
+
+    ContentStore store(data);
+    msg->setStore(&store);
+    msg->releaseContent();
+    BOOST_CHECK(msg->isContentInStore());
+    BOOST_CHECK_EQUAL(msg->contentSize(), (uint64_t) data.size());
+
+    //the whole content comes back in one read
+    Queue queue("q");
+    msg->prefetchContent(queue);
+    BOOST_CHECK_EQUAL(store.reads, 1u);
+    BOOST_CHECK(!msg->isContentInStore());
+    msg->prefetchContent(queue);
+    BOOST_CHECK_EQUAL(store.reads, 1u);
+
+    //delivery sends it from memory
+    FrameCollector out;
+    msg->sendContent(queue, out, 1024);
+    BOOST_CHECK_EQUAL(store.reads, 1u);
+    string sent;
+    for (std::vector<AMQFrame>::iterator i = out.frames.begin(); i != out.frames.end(); ++i)
+        sent += i->castBody<AMQContentBody>()->getData();
+    BOOST_CHECK(sent == data);
+    BOOST_CHECK(out.frames.size() > 1);
+}
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
@@ -21,8 +21,10 @@
 
 #include "qpid/broker/Message.h"
 #include "qpid/framing/AMQFrame.h"
+#include "qpid/framing/Buffer.h"
 #include "qpid/framing/MessageTransferBody.h"
 #include "qpid/framing/Uuid.h"
+#include <vector>
 
 using namespace qpid;
 using namespace broker;
@@ -58,6 +60,28 @@ struct MessageUtils
         AMQFrame content((AMQContentBody(data)));
         msg->getFrames().append(content);
     }
+
+    /** Encodes the frames of a transfer to amq.direct with size bytes of content */
+    static std::vector<char> encodeTransfer(uint size, const string& routingKey="key")
+    {
+        std::string data(size, 'x');
+        AMQFrame method((MessageTransferBody(ProtocolVersion(), "amq.direct", 0, 0)));
+        AMQFrame header((AMQHeaderBody()));
+        AMQFrame content((AMQContentBody(data)));
+        method.setEof(false);
+        header.setBof(false);
+        header.setEof(false);
+        content.setBof(false);
+        header.castBody<AMQHeaderBody>()->get<MessageProperties>(true)->setContentLength(size);
+        header.castBody<AMQHeaderBody>()->get<DeliveryProperties>(true)->setRoutingKey(routingKey);
+
+        std::vector<char> encoded(method.encodedSize() + header.encodedSize() + content.encodedSize());
+        Buffer buffer(&encoded[0], encoded.size());
+        method.encode(buffer);
+        header.encode(buffer);
+        content.encode(buffer);
+        return encoded;
+    }
 };
 
 }} // namespace qpid::tests
@@ -24,6 +24,7 @@
 #include "qpid/messaging/Address.h"
 #include "qpid/messaging/Connection.h"
 #include "qpid/messaging/Message.h"
+#include "qpid/messaging/MessageListener.h"
 #include "qpid/messaging/Receiver.h"
 #include "qpid/messaging/Sender.h"
 #include "qpid/messaging/Session.h"
@@ -32,9 +33,11 @@
 #include "qpid/framing/ExchangeQueryResult.h"
 #include "qpid/framing/reply_exceptions.h"
 #include "qpid/framing/Uuid.h"
+#include "qpid/sys/Monitor.h"
 #include "qpid/sys/Time.h"
 #include <boost/assign.hpp>
 #include <boost/format.hpp>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -97,6 +100,76 @@ QPID_AUTO_TEST_CASE(testSendReceiveHeaders)
     }
 }
 
+QPID_AUTO_TEST_CASE(testBatchSendReceive)
+{
+    QueueFixture fix;
+    Sender sender = fix.session.createSender(fix.queue);
+    sender.setCapacity(10);
+    std::vector<Message> out;
+    for (uint i = 0; i < 25; ++i) {
+        out.push_back(Message((boost::format("Message_%1%") % (i+1)).str()));
+    }
+    sender.send(out, true);
+    BOOST_CHECK_EQUAL(sender.getUnsettled(), 0u);
+    Receiver receiver = fix.session.createReceiver(fix.queue);
+    Message in;
+    for (uint i = 0; i < out.size(); ++i) {
+        BOOST_CHECK(receiver.fetch(in, Duration::SECOND * 5));
+        BOOST_CHECK_EQUAL(in.getContent(), out[i].getContent());
+    }
+    fix.session.acknowledge();
+}
+
+QPID_AUTO_TEST_CASE(testSendReceiveSharedContent)
+{
+    QueueFixture fix;
+    Sender sender = fix.session.createSender(fix.queue);
+    std::string big(100000, 'x'); // spans several frames
+    std::string small("small");
+    Message out;
+    out.swapContent(big);
+    BOOST_CHECK(big.empty());
+    sender.send(out);
+    sender.send(out);           // the second send shares the first one's buffer
+    Message copy(out);
+    out.setContent(small);
+    BOOST_CHECK_EQUAL(copy.getContentSize(), 100000u);
+    sender.send(Message(small), true);
+
+    Receiver receiver = fix.session.createReceiver(fix.queue);
+    Message in;
+    for (uint i = 0; i < 2; ++i) {
+        BOOST_CHECK(receiver.fetch(in, Duration::SECOND * 5));
+        BOOST_CHECK_EQUAL(in.getContent(), copy.getContent());
+    }
+    BOOST_CHECK(receiver.fetch(in, Duration::SECOND * 5));
+    BOOST_CHECK_EQUAL(std::string(in.getContentPtr(), in.getContentSize()), small);
+    std::string taken;
+    in.swapContent(taken);
+    BOOST_CHECK_EQUAL(taken, small);
+    BOOST_CHECK_EQUAL(in.getContentSize(), 0u);
+    fix.session.acknowledge();
+}
+
+QPID_AUTO_TEST_CASE(testAdaptiveCredit)
+{
+    QueueFixture fix;
+    Sender sender = fix.session.createSender(fix.queue);
+    Receiver receiver = fix.session.createReceiver(fix.queue + "; {link: {x-credit: {mode: adaptive, max-bytes: 100000}}}");
+    receiver.setCapacity(50);
+    for (uint i = 0; i < 200; ++i) {
+        sender.send(Message((boost::format("Message_%1%") % (i+1)).str()));
+    }
+    Message in;
+    for (uint i = 0; i < 200; ++i) {
+        BOOST_CHECK(receiver.fetch(in, Duration::SECOND * 5));
+        BOOST_CHECK_EQUAL(in.getContent(), (boost::format("Message_%1%") % (i+1)).str());
+    }
+    fix.session.acknowledge();
+    BOOST_CHECK(receiver.getAvailable() <= receiver.getCapacity());
+    BOOST_CHECK(!receiver.fetch(in, Duration::IMMEDIATE));
+}
+
 QPID_AUTO_TEST_CASE(testSenderError)
 {
     MessagingFixture fix;
@@ -150,6 +223,28 @@ QPID_AUTO_TEST_CASE(testSimpleTopic)
     //TODO: check pending messages...
 }
 
+QPID_AUTO_TEST_CASE(testAddressCache)
+{
+    TopicFixture fix;
+    fix.admin.createQueue("cached-queue");
+    fix.connection.setOption("address-cache", true);
+    Session session = fix.connection.createSession();
+    //the second receiver and sender on each node resolve from the cache
+    for (uint i = 0; i < 2; ++i) {
+        Receiver sub = session.createReceiver(fix.topic);
+        Receiver queue = session.createReceiver("cached-queue");
+        session.createSender(fix.topic).send(Message("topic"), true);
+        session.createSender("cached-queue").send(Message("queue"), true);
+        BOOST_CHECK_EQUAL(sub.fetch(Duration::SECOND * 5).getContent(), "topic");
+        BOOST_CHECK_EQUAL(queue.fetch(Duration::SECOND * 5).getContent(), "queue");
+        sub.close();
+        queue.close();
+    }
+    session.acknowledge();
+    session.close();
+    fix.admin.deleteQueue("cached-queue");
+}
+
 QPID_AUTO_TEST_CASE(testNextReceiver)
 {
     MultiQueueFixture fix;
@@ -172,6 +267,93 @@ QPID_AUTO_TEST_CASE(testNextReceiver)
     }
 }
 
+QPID_AUTO_TEST_CASE(testNextReceiverAfterFetch)
+{
+    MultiQueueFixture fix;
+
+    std::vector<Receiver> receivers;
+    for (uint i = 0; i < fix.queues.size(); i++) {
+        receivers.push_back(fix.session.createReceiver(fix.queues[i]));
+        receivers.back().setCapacity(10u);
+    }
+    std::set<std::string> expected;
+    for (uint i = 0; i < fix.queues.size(); i++) {
+        Sender s = fix.session.createSender(fix.queues[i]);
+        std::string content((boost::format("Message_%1%") % (i+1)).str());
+        s.send(Message(content), true);
+        expected.insert(content);
+    }
+    //take the last queue's message directly; nextReceiver() must then
+    //only return the receivers that still have a message waiting
+    Message msg;
+    BOOST_CHECK(receivers.back().fetch(msg, Duration::SECOND * 5));
+    BOOST_CHECK_EQUAL(expected.erase(msg.getContent()), 1u);
+    Receiver next;
+    while (!expected.empty() && fix.session.nextReceiver(next, Duration::SECOND * 5)) {
+        BOOST_CHECK(next.getName() != receivers.back().getName());
+        BOOST_CHECK(next.fetch(msg, Duration::IMMEDIATE));
+        BOOST_CHECK_EQUAL(expected.erase(msg.getContent()), 1u);
+    }
+    BOOST_CHECK(expected.empty());
+    BOOST_CHECK(!fix.session.nextReceiver(next, Duration::IMMEDIATE));
+    fix.session.acknowledge();
+}
+
+struct CollectingListener : MessageListener
+{
+    qpid::sys::Monitor lock;
+    std::vector<std::string> contents;
+
+    void received(Message& message)
+    {
+        qpid::sys::Monitor::ScopedLock l(lock);
+        contents.push_back(message.getContent());
+        lock.notifyAll();
+    }
+
+    bool waitFor(size_t count)
+    {
+        qpid::sys::AbsTime deadline(qpid::sys::AbsTime::now(), 5*qpid::sys::TIME_SEC);
+        qpid::sys::Monitor::ScopedLock l(lock);
+        while (contents.size() < count) {
+            if (!lock.wait(deadline)) break;
+        }
+        return contents.size() >= count;
+    }
+};
+
+QPID_AUTO_TEST_CASE(testMessageListener)
+{
+    MultiQueueFixture fix;
+    CollectingListener listener;
+    Receiver listened = fix.session.createReceiver(fix.queues[0]);
+    Receiver fetched = fix.session.createReceiver(fix.queues[1]);
+    listened.setCapacity(10u);
+    fetched.setCapacity(10u);
+    listened.setListener(&listener);
+    fix.session.startDispatch();
+
+    Sender sender = fix.session.createSender(fix.queues[0]);
+    Sender other = fix.session.createSender(fix.queues[1]);
+    other.send(Message("not for the listener"), true);
+    std::vector<std::string> expected;
+    for (uint i = 0; i < 5; ++i) {
+        expected.push_back((boost::format("Message_%1%") % (i+1)).str());
+        sender.send(Message(expected.back()));
+    }
+    BOOST_CHECK(listener.waitFor(expected.size()));
+    fix.session.stopDispatch();
+    {
+        qpid::sys::Monitor::ScopedLock l(listener.lock);
+        BOOST_CHECK_EQUAL_COLLECTIONS(listener.contents.begin(), listener.contents.end(),
+                                      expected.begin(), expected.end());
+    }
+    //messages for receivers without a listener are left for fetch()
+    BOOST_CHECK_EQUAL(fetched.fetch(Duration::SECOND * 5).getContent(), "not for the listener");
+    listened.setListener(0);
+    fix.session.acknowledge();
+}
+
 QPID_AUTO_TEST_CASE(testMapMessage)
 {
     QueueFixture fix;
@@ -732,7 +914,7 @@ QPID_AUTO_TEST_CASE(testRelease)
 QPID_AUTO_TEST_CASE(testOptionVerification)
 {
     MessagingFixture fix;
-    fix.session.createReceiver("my-queue; {create: always, assert: always, delete: always, node: {type: queue, durable: false, x-declare: {arguments: {a: b}}, x-bindings: [{exchange: amq.fanout}]}, link: {name: abc, durable: false, reliability: exactly-once, x-subscribe: {arguments:{a:b}}, x-bindings:[{exchange: amq.fanout}]}, mode: browse}");
+    fix.session.createReceiver("my-queue; {create: always, assert: always, delete: always, node: {type: queue, durable: false, x-declare: {arguments: {a: b}}, x-bindings: [{exchange: amq.fanout}]}, link: {name: abc, durable: false, reliability: exactly-once, x-subscribe: {arguments:{a:b}}, x-bindings:[{exchange: amq.fanout}], x-credit: {mode: adaptive, max-bytes: 1000}}, mode: browse}");
     BOOST_CHECK_THROW(fix.session.createReceiver("my-queue; {invalid-option:blah}"), qpid::messaging::AddressError);
 }
 
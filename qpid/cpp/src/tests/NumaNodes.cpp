@@ -0,0 +1,51 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "unit_test.h"
+#include "qpid/sys/NumaNodes.h"
+
+using qpid::sys::NumaNodes;
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(NumaNodesTestSuite)
+
+QPID_AUTO_TEST_CASE(testParseCpuList) {
+    std::vector<int> cpus = NumaNodes::parseCpuList("0-2,8,10-11\n");
+    BOOST_REQUIRE_EQUAL(cpus.size(), 6u);
+    BOOST_CHECK_EQUAL(cpus[0], 0);
+    BOOST_CHECK_EQUAL(cpus[2], 2);
+    BOOST_CHECK_EQUAL(cpus[3], 8);
+    BOOST_CHECK_EQUAL(cpus[5], 11);
+    BOOST_CHECK(NumaNodes::parseCpuList("").empty());
+}
+
+QPID_AUTO_TEST_CASE(testCurrent) {
+    BOOST_CHECK(NumaNodes::count() >= 1u);
+    BOOST_CHECK_EQUAL(NumaNodes::current(), 0u);
+    NumaNodes::setCurrent(1);
+    BOOST_CHECK_EQUAL(NumaNodes::current(), 1u);
+    NumaNodes::setCurrent(0);
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
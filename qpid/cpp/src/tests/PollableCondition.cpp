@@ -22,11 +22,20 @@
 #include "test_tools.h"
 #include "unit_test.h"
 #include "qpid/sys/Poller.h"
+#include "qpid/sys/DispatchHandle.h"
+#include "qpid/sys/IOHandle.h"
+#include "qpid/sys/posix/PrivatePosix.h"
 #include "qpid/sys/PollableCondition.h"
+#include "qpid/sys/PollableQueue.h"
 #include "qpid/sys/Monitor.h"
 #include "qpid/sys/Time.h"
 #include "qpid/sys/Thread.h"
 #include <boost/bind.hpp>
+#include <vector>
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace qpid {
 namespace tests {
@@ -104,6 +113,193 @@ QPID_AUTO_TEST_CASE(testPollableCondition) {
     runner.join();
 }
 
+QPID_AUTO_TEST_CASE(testPartitionedPoller) {
+    boost::shared_ptr<Poller> poller(new Poller(2, false));
+    Callback callback1, callback2;
+    // Handles are spread over the poll sets, so these use one each
+    PollableCondition pc1(boost::bind(&Callback::call, &callback1, _1), poller);
+    PollableCondition pc2(boost::bind(&Callback::call, &callback2, _1), poller);
+
+    // A single thread serves one set and has to take events from the other
+    Thread runner = Thread(*poller);
+
+    pc1.set();
+    BOOST_CHECK(callback1.isCalling());
+    callback1.nextCall(Callback::CLEAR);
+    BOOST_CHECK(callback1.isNotCalling());
+
+    pc2.set();
+    BOOST_CHECK(callback2.isCalling());
+    callback2.nextCall(Callback::CLEAR);
+    BOOST_CHECK(callback2.isNotCalling());
+
+    poller->shutdown();
+    runner.join();
+}
+
+// Reads one byte from a socket each time it is called
+class ByteReader : public IOHandle {
+  public:
+    ByteReader(int fd) : IOHandle(new IOHandlePrivate(fd)), count() {}
+
+    void readable(DispatchHandle& h) {
+        char c;
+        if (::read(toFd(impl), &c, 1) == 1) {
+            Mutex::ScopedLock l(lock);
+            ++count;
+            lock.notify();
+            // Stopped before the socket would block so ask to be called again
+            h.rewatchRead();
+        }
+    }
+
+    bool waitFor(int n) {
+        Mutex::ScopedLock l(lock);
+        AbsTime deadline(now(), LONG);
+        while (count < n && lock.wait(deadline))
+            ;
+        return count == n;
+    }
+
+  private:
+    Monitor lock;
+    int count;
+};
+
+QPID_AUTO_TEST_CASE(testEdgeTriggeredPoller) {
+    boost::shared_ptr<Poller> poller(new Poller(1, false, true));
+    int fds[2];
+    BOOST_REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    BOOST_REQUIRE(::fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+    ByteReader reader(fds[0]);
+    DispatchHandle handle(reader, boost::bind(&ByteReader::readable, &reader, _1), 0, 0);
+    handle.setEdgeTriggered();
+    handle.startWatch(poller);
+
+    // Handles that did not ask for edge triggering still see a level
+    Callback callback;
+    PollableCondition pc(boost::bind(&Callback::call, &callback, _1), poller);
+
+    Thread runner = Thread(*poller);
+
+    BOOST_CHECK(::write(fds[1], "abc", 3) == 3);
+    BOOST_CHECK(reader.waitFor(3)); // Called again for the bytes left
+    BOOST_CHECK(::write(fds[1], "de", 2) == 2);
+    BOOST_CHECK(reader.waitFor(5)); // New edge once drained
+
+    pc.set();
+    BOOST_CHECK(callback.isCalling());
+    BOOST_CHECK(callback.isCalling()); // Still set.
+    callback.nextCall(Callback::CLEAR);
+    BOOST_CHECK(callback.isNotCalling());
+
+    handle.stopWatch();
+    poller->shutdown();
+    runner.join();
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+QPID_AUTO_TEST_CASE(testBusyPollPoller) {
+    boost::shared_ptr<Poller> poller(new Poller(2, false, false, 5*TIME_MSEC));
+
+    // Spinning gives way to the normal timeout
+    BOOST_CHECK_EQUAL(poller->wait(20*TIME_MSEC).type, Poller::TIMEOUT);
+
+    Callback callback;
+    PollableCondition pc(boost::bind(&Callback::call, &callback, _1), poller);
+    Thread runner = Thread(*poller);
+    Thread runner2 = Thread(*poller);
+
+    pc.set();
+    BOOST_CHECK(callback.isCalling());
+    callback.nextCall(Callback::CLEAR);
+    BOOST_CHECK(callback.isNotCalling());
+
+    // And threads that went to sleep are still woken
+    qpid::sys::usleep(20*1000);
+    pc.set();
+    BOOST_CHECK(callback.isCalling());
+    callback.nextCall(Callback::CLEAR);
+    BOOST_CHECK(callback.isNotCalling());
+
+    poller->shutdown();
+    runner.join();
+    runner2.join();
+}
+
+class Collector {
+  public:
+    typedef PollableQueue<int> Queue;
+
+    Collector(size_t producers) : last(producers, -1), count(), ordered(true) {}
+
+    Queue::Batch::const_iterator handle(const Queue::Batch& batch) {
+        Mutex::ScopedLock l(lock);
+        for (Queue::Batch::const_iterator i = batch.begin(); i != batch.end(); ++i) {
+            int& previous = last[*i % last.size()];
+            if (*i <= previous) ordered = false;
+            previous = *i;
+            ++count;
+        }
+        lock.notifyAll();
+        return batch.end();
+    }
+
+    bool waitFor(int n) {
+        Mutex::ScopedLock l(lock);
+        AbsTime deadline(now(), 10*TIME_SEC);
+        while (count < n && lock.wait(deadline))
+            ;
+        return count == n;
+    }
+
+    bool isOrdered() { Mutex::ScopedLock l(lock); return ordered; }
+
+  private:
+    Monitor lock;
+    std::vector<int> last;
+    int count;
+    bool ordered;
+};
+
+struct Producer : public Runnable {
+    Collector::Queue& queue;
+    int id, producers, n;
+    Producer(Collector::Queue& q, int i, int p, int count)
+        : queue(q), id(i), producers(p), n(count) {}
+    void run() { for (int i = 0; i < n; ++i) queue.push(i*producers + id); }
+};
+
+QPID_AUTO_TEST_CASE(testPollableQueueProducers) {
+    const int PRODUCERS = 4, COUNT = 10000;
+    boost::shared_ptr<Poller> poller(new Poller());
+    Collector collector(PRODUCERS);
+    Collector::Queue queue(boost::bind(&Collector::handle, &collector, _1), poller);
+    queue.start();
+    Thread runner = Thread(*poller);
+
+    std::vector<Producer*> producers;
+    std::vector<Thread> threads;
+    for (int i = 0; i < PRODUCERS; ++i) {
+        producers.push_back(new Producer(queue, i, PRODUCERS, COUNT));
+        threads.push_back(Thread(*producers.back()));
+    }
+    for (int i = 0; i < PRODUCERS; ++i) {
+        threads[i].join();
+        delete producers[i];
+    }
+
+    // Every item arrives once, in push order for each producer.
+    BOOST_CHECK(collector.waitFor(PRODUCERS*COUNT));
+    BOOST_CHECK(collector.isOrdered());
+    BOOST_CHECK(queue.empty());
+
+    queue.stop();
+    poller->shutdown();
+    runner.join();
+}
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} //namespace qpid::tests
@@ -0,0 +1,66 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "unit_test.h"
+#include "qpid/sys/Probe.h"
+#include <string>
+
+using qpid::sys::ProbeTrace;
+namespace probe = qpid::sys::probe;
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(ProbeTestSuite)
+
+QPID_AUTO_TEST_CASE(testRecordOrder) {
+    ProbeTrace::record(probe::message_enqueued, 7, 1);
+    ProbeTrace::record(probe::message_dispatched, 7, 2);
+    std::vector<ProbeTrace::Record> records;
+    ProbeTrace::snapshot(records);
+    BOOST_REQUIRE(records.size() >= 2u);
+    const ProbeTrace::Record& a = records[records.size() - 2];
+    const ProbeTrace::Record& b = records.back();
+    BOOST_CHECK_EQUAL(a.stage, probe::message_enqueued);
+    BOOST_CHECK_EQUAL(b.stage, probe::message_dispatched);
+    BOOST_CHECK_EQUAL(a.id, 7u);
+    BOOST_CHECK_EQUAL(b.arg, 2u);
+    BOOST_CHECK_EQUAL(b.sequence, a.sequence + 1);
+    BOOST_CHECK(a.time <= b.time);
+}
+
+QPID_AUTO_TEST_CASE(testWrapKeepsLatest) {
+    for (uint64_t i = 0; i < ProbeTrace::SLOTS + 10; ++i)
+        ProbeTrace::record(probe::io_written, i, 0);
+    std::vector<ProbeTrace::Record> records;
+    ProbeTrace::snapshot(records);
+    BOOST_CHECK_EQUAL(records.size(), size_t(ProbeTrace::SLOTS));
+    BOOST_CHECK_EQUAL(records.front().id, 10u);
+    BOOST_CHECK_EQUAL(records.back().id, uint64_t(ProbeTrace::SLOTS + 9));
+}
+
+QPID_AUTO_TEST_CASE(testNames) {
+    BOOST_CHECK_EQUAL(std::string(ProbeTrace::name(probe::frame_decoded)), "frame_decoded");
+    BOOST_CHECK_EQUAL(std::string(ProbeTrace::name(probe::io_written)), "io_written");
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
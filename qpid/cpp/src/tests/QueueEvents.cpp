@@ -97,6 +97,39 @@ QPID_AUTO_TEST_CASE(testBasicEventProcessing)
     events.unregisterListener("dummy");
 }
 
+QPID_AUTO_TEST_CASE(testPartitionedEventFiltering)
+{
+    boost::shared_ptr<Poller> poller(new Poller());
+    sys::Dispatcher dispatcher(poller);
+    Thread dispatchThread(dispatcher);
+    QueueEvents events(poller, false, 4);
+    EventChecker listener;
+    listener.poller = poller;
+    QueueEvents::QueueNames queues;
+    queues.insert("queue2");
+    events.registerListener("dummy", boost::bind(&EventChecker::handle, &listener, _1), queues);
+    Queue queue1("queue1");
+    Queue queue2("queue2");
+    SequenceNumber id;
+    QueuedMessage event1(&queue1, MessageUtils::createMessage(), id);
+    QueuedMessage event2(&queue2, MessageUtils::createMessage(), id);
+    QueuedMessage event3(&queue2, MessageUtils::createMessage(), ++id);
+
+    //only the events for queue2 are expected, in order:
+    listener.expect(QueueEvents::Event(QueueEvents::ENQUEUE, event2));
+    listener.expect(QueueEvents::Event(QueueEvents::ENQUEUE, event3));
+    listener.expect(QueueEvents::Event(QueueEvents::DEQUEUE, event2));
+
+    events.enqueued(event1);
+    events.enqueued(event2);
+    events.dequeued(event1);
+    events.enqueued(event3);
+    events.dequeued(event2);
+
+    dispatchThread.join();
+    events.shutdown();
+    events.unregisterListener("dummy");
+}
 
 struct EventRecorder
 {
@@ -20,11 +20,14 @@
  */
 #include <sstream>
 #include <deque>
+#include <vector>
 #include "unit_test.h"
 #include "test_tools.h"
 
 #include "qpid/broker/QueuePolicy.h"
 #include "qpid/broker/QueueFlowLimit.h"
+#include "qpid/broker/MemoryAccountant.h"
+#include "qpid/broker/Queue.h"
 #include "qpid/sys/Time.h"
 #include "qpid/framing/reply_exceptions.h"
 #include "MessageUtils.h"
@@ -458,6 +461,109 @@ QPID_AUTO_TEST_CASE(testFlowDisable)
 }
 
 
+QPID_AUTO_TEST_CASE(testFlowGradualRelease)
+{
+    FieldTable args;
+    args.setInt(QueueFlowLimit::flowStopSizeKey, 100);
+    args.setInt(QueueFlowLimit::flowResumeSizeKey, 50);
+    std::auto_ptr<TestFlow> flow(TestFlow::createTestFlow(args));
+
+    std::deque<QueuedMessage> msgs;
+    msgs.push_back(createMessage(1000));
+    flow->enqueued(msgs.back());
+    BOOST_CHECK(flow->isFlowControlActive());
+    for (size_t i = 0; i < 20; i++) {
+        msgs.push_back(createMessage(1));
+        flow->enqueued(msgs.back());
+    }
+    BOOST_CHECK_EQUAL((size_t) 21, flow->getHeldCount());
+
+    // Flow resumes, but only the oldest two held msgs are completed
+    flow->dequeued(msgs.front());
+    msgs.pop_front();
+    BOOST_CHECK(!flow->isFlowControlActive());
+    BOOST_CHECK_EQUAL((size_t) 18, flow->getHeldCount());
+    BOOST_CHECK(msgs[1].payload->getIngressCompletion().isDone());
+    BOOST_CHECK(!msgs[2].payload->getIngressCompletion().isDone());
+
+    // More are completed as the queue drains
+    flow->dequeued(msgs.front());
+    msgs.pop_front();
+    BOOST_CHECK_EQUAL((size_t) 16, flow->getHeldCount());
+    while (!msgs.empty()) {
+        flow->dequeued(msgs.front());
+        msgs.pop_front();
+    }
+    BOOST_CHECK_EQUAL((size_t) 0, flow->getHeldCount());
+}
+
+QPID_AUTO_TEST_CASE(testBrokerMemoryFlow)
+{
+    MemoryAccountant accountant(0, 100, 50);
+    std::deque<QueuedMessage> msgs;
+    for (size_t i = 0; i < 3; i++) {
+        msgs.push_back(createMessage(30));
+        accountant.enqueued(msgs.back());
+        BOOST_CHECK(!accountant.isFlowStopped());
+    }
+    msgs.push_back(createMessage(30));
+    accountant.enqueued(msgs.back());
+    BOOST_CHECK(accountant.isFlowStopped());
+    BOOST_CHECK_EQUAL((uint64_t) 120, accountant.getMessageBytes());
+    BOOST_CHECK(!msgs.back().payload->getIngressCompletion().isDone());
+
+    accountant.dequeued(msgs.front());
+    msgs.pop_front();
+    accountant.dequeued(msgs.front());
+    msgs.pop_front();
+    BOOST_CHECK(accountant.isFlowStopped());   // 60 bytes left, above resume
+    accountant.dequeued(msgs.front());
+    msgs.pop_front();
+    BOOST_CHECK(!accountant.isFlowStopped());
+    BOOST_CHECK_EQUAL((uint64_t) 30, accountant.getMessageBytes());
+    BOOST_CHECK(msgs.back().payload->getIngressCompletion().isDone());
+}
+
+QPID_AUTO_TEST_CASE(testBrokerMemoryFanout)
+{
+    MemoryAccountant accountant(0, 0, 0);
+    Queue::shared_ptr q1(new Queue("q1")), q2(new Queue("q2"));
+    QueuedMessage a = createMessage(30);
+    a.queue = q1.get();
+    QueuedMessage b(q2.get(), a.payload, a.position);
+
+    // The content is counted once, until it leaves its last queue
+    accountant.enqueued(a);
+    accountant.enqueued(b);
+    BOOST_CHECK_EQUAL((uint64_t) 30, accountant.getMessageBytes());
+    accountant.dequeued(a);
+    BOOST_CHECK_EQUAL((uint64_t) 30, accountant.getMessageBytes());
+    accountant.dequeued(b);
+    BOOST_CHECK_EQUAL((uint64_t) 0, accountant.getMessageBytes());
+}
+
+QPID_AUTO_TEST_CASE(testBrokerMemoryQueueDeleted)
+{
+    boost::shared_ptr<MemoryAccountant> accountant(new MemoryAccountant(0, 100, 50));
+    Queue::shared_ptr q(new Queue("q"));
+    q->addObserver(accountant);
+    std::vector<QueuedMessage> msgs;
+    for (size_t i = 0; i < 4; i++) {
+        msgs.push_back(createMessage(30));
+        q->deliver(msgs.back().payload);
+    }
+    BOOST_CHECK(accountant->isFlowStopped());
+    BOOST_CHECK(!msgs.back().payload->getIngressCompletion().isDone());
+
+    // Nothing is dequeued from a deleted queue, so its messages are
+    // released all at once
+    accountant->queueDeleted(*q);
+    BOOST_CHECK_EQUAL((uint64_t) 0, accountant->getMessageBytes());
+    BOOST_CHECK(!accountant->isFlowStopped());
+    BOOST_CHECK(msgs.back().payload->getIngressCompletion().isDone());
+}
+
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
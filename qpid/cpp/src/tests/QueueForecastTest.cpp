@@ -0,0 +1,102 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "unit_test.h"
+#include "MessageUtils.h"
+#include "qpid/broker/FanOutExchange.h"
+#include "qpid/broker/Queue.h"
+#include "qpid/broker/QueueForecast.h"
+#include "qpid/broker/QueuePolicy.h"
+#include "qpid/broker/QueueRegistry.h"
+#include "qpid/amqp_0_10/Codecs.h"
+#include "qpid/framing/FieldTable.h"
+#include "qpid/sys/Timer.h"
+#include "qpid/types/Variant.h"
+
+using namespace qpid::broker;
+using qpid::sys::AbsTime;
+using qpid::sys::TIME_SEC;
+using qpid::types::Variant;
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(QueueForecastTestSuite)
+
+QPID_AUTO_TEST_CASE(testRatesAndTimes) {
+    QueueRegistry queues;
+    framing::FieldTable args;
+    args.setInt(QueuePolicy::maxCountKey, 100);
+    Queue::shared_ptr queue = queues.declare("q", false, false, 0, Exchange::shared_ptr(), args).first;
+    queues.declare("idle");
+
+    Exchange::shared_ptr forecasts(new FanOutExchange("forecasts"));
+    Queue::shared_ptr sink(new Queue("sink"));
+    forecasts->bind(sink, std::string(), 0);
+    sys::Timer timer;
+    QueueForecast forecast(queues);
+    forecast.start(timer, 3600*TIME_SEC, forecasts);
+
+    AbsTime start = AbsTime::now();
+    forecast.sample(start);
+    QueueForecast::Estimate e;
+    BOOST_CHECK(!forecast.get("q", e));
+
+    for (int i = 0; i < 10; ++i) queue->deliver(MessageUtils::createMessage());
+    forecast.sample(AbsTime(start, TIME_SEC));
+    BOOST_REQUIRE(forecast.get("q", e));
+    BOOST_CHECK_EQUAL(e.depth, 10u);
+    BOOST_CHECK_CLOSE(e.enqueueRate, 10.0, 0.001);
+    BOOST_CHECK_EQUAL(e.dequeueRate, 0.0);
+    BOOST_CHECK(e.timeToDrain < 0);
+    BOOST_CHECK_CLOSE(e.timeToLimit, 9.0, 0.001);
+
+    // Only the busy queue is published
+    BOOST_REQUIRE_EQUAL(sink->getMessageCount(), 1u);
+    Variant::List reported;
+    amqp_0_10::ListCodec::decode(sink->get().payload->getFrames().getContent(), reported);
+    BOOST_REQUIRE_EQUAL(reported.size(), 1u);
+    Variant::Map entry = reported.front().asMap();
+    BOOST_CHECK_EQUAL(entry["name"].asString(), "q");
+    BOOST_CHECK_EQUAL(entry["depth"].asUint32(), 10u);
+
+    // Drained by the next sample, with little smoothing
+    forecast.setWindow(0.001);
+    for (int i = 0; i < 10; ++i) queue->get();
+    forecast.sample(AbsTime(start, 2*TIME_SEC));
+    BOOST_REQUIRE(forecast.get("q", e));
+    BOOST_CHECK_EQUAL(e.depth, 0u);
+    BOOST_CHECK(e.enqueueRate < 0.01);
+    BOOST_CHECK_CLOSE(e.dequeueRate, 10.0, 0.001);
+    BOOST_CHECK_EQUAL(e.timeToDrain, 0.0);
+    BOOST_CHECK(e.timeToLimit < 0);
+    BOOST_CHECK_EQUAL(sink->getMessageCount(), 1u);
+
+    // Deleted queues are forgotten
+    queues.destroy("q");
+    forecast.sample(AbsTime(start, 3*TIME_SEC));
+    BOOST_CHECK(!forecast.get("q", e));
+    forecast.stop();
+    timer.stop();
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
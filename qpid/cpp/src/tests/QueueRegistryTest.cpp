@@ -63,6 +63,30 @@ QPID_AUTO_TEST_CASE(testDeclareTmp)
     BOOST_CHECK_EQUAL(std::string("tmp_1"), qc.first->getName());
 }
 
+QPID_AUTO_TEST_CASE(testDeclareTmpSkipsTakenName)
+{
+    QueueRegistry reg;
+    reg.declare(std::string("tmp_1"), false, 0, 0);
+    std::pair<Queue::shared_ptr,  bool> qc = reg.declare(std::string(), false, 0, 0);
+    BOOST_CHECK(qc.second);
+    BOOST_CHECK_EQUAL(std::string("tmp_2"), qc.first->getName());
+}
+
+namespace {
+void count(size_t& n, Queue::shared_ptr) { ++n; }
+}
+
+QPID_AUTO_TEST_CASE(testEachQueue)
+{
+    QueueRegistry reg;
+    for (int i = 0; i < 200; ++i)
+        reg.declare(std::string(), false, 0, 0);
+    size_t n = 0;
+    reg.eachQueue(boost::bind(count, boost::ref(n), _1));
+    BOOST_CHECK_EQUAL(n, 200u);
+    BOOST_CHECK(reg.find("tmp_200"));
+}
+
 QPID_AUTO_TEST_CASE(testFind)
 {
     std::string foo("foo");
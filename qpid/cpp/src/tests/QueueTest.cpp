@@ -19,6 +19,7 @@
  *
  */
 #include "MessageUtils.h"
+#include "CountingStore.h"
 #include "unit_test.h"
 #include "test_tools.h"
 #include "qpid/Exception.h"
@@ -30,6 +31,11 @@
 #include "qpid/broker/ExchangeRegistry.h"
 #include "qpid/broker/QueueRegistry.h"
 #include "qpid/broker/NullMessageStore.h"
+#include "qpid/broker/MessageDeque.h"
+#include "qpid/broker/MessageMap.h"
+#include "qpid/broker/PagedQueue.h"
+#include "qpid/broker/PriorityQueue.h"
+#include "qpid/broker/Fairshare.h"
 #include "qpid/broker/ExpiryPolicy.h"
 #include "qpid/framing/MessageTransferBody.h"
 #include "qpid/client/QueueOptions.h"
@@ -41,6 +47,7 @@
 
 #include <iostream>
 #include "boost/format.hpp"
+#include <boost/lexical_cast.hpp>
 
 using boost::intrusive_ptr;
 using namespace qpid;
@@ -167,6 +174,114 @@ QPID_AUTO_TEST_CASE(testConsumers){
     BOOST_CHECK_EQUAL(uint32_t(0), queue->getConsumerCount());
 }
 
+class CreditConsumer : public TestConsumer
+{
+  public:
+    typedef boost::shared_ptr<CreditConsumer> shared_ptr;
+
+    uint credit;
+    uint failAt;    // delivery that throws, counting from 1
+    std::vector<QueuedMessage> delivered;
+    CreditConsumer(uint c) : Consumer("test", true), credit(c), failAt(0) {}
+
+    bool accept(intrusive_ptr<Message>) {
+        if (!credit) return false;
+        --credit;
+        return true;
+    }
+    void unaccept(intrusive_ptr<Message>) { ++credit; }
+    bool deliver(QueuedMessage& msg) {
+        if (delivered.size() + 1 == failAt) throw Exception("delivery failed");
+        delivered.push_back(msg);
+        return TestConsumer::deliver(msg);
+    }
+};
+
+QPID_AUTO_TEST_CASE(testDispatchBatch){
+    Queue::shared_ptr queue(new Queue("my-queue"));
+    for (uint i = 0; i < 5; ++i) {
+        queue->deliver(create_message("e", "A"));
+    }
+    CreditConsumer::shared_ptr c(new CreditConsumer(4));
+    BOOST_CHECK_EQUAL(queue->dispatch(c, 3), 3u);
+    BOOST_CHECK_EQUAL(queue->dispatch(c, 3), 1u);//out of credit
+    BOOST_CHECK_EQUAL(c->delivered.size(), 4u);
+    for (uint i = 0; i < c->delivered.size(); ++i) {
+        BOOST_CHECK_EQUAL(c->delivered[i].position, SequenceNumber(i + 1));
+    }
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 1u);
+    c->credit = 10;
+    BOOST_CHECK_EQUAL(queue->dispatch(c, 3), 1u);
+    BOOST_CHECK_EQUAL(queue->dispatch(c, 3), 0u);
+}
+
+QPID_AUTO_TEST_CASE(testDispatchBatchFailure){
+    Queue::shared_ptr queue(new Queue("my-queue"));
+    for (uint i = 0; i < 5; ++i) {
+        queue->deliver(create_message("e", "A"));
+    }
+    CreditConsumer::shared_ptr c(new CreditConsumer(5));
+    c->failAt = 2;
+    BOOST_CHECK_THROW(queue->dispatch(c, 4), Exception);
+    // the failed message and those after it are back, with their credit
+    BOOST_CHECK_EQUAL(c->delivered.size(), 1u);
+    BOOST_CHECK_EQUAL(c->credit, 4u);
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 4u);
+    c->failAt = 0;
+    BOOST_CHECK_EQUAL(queue->dispatch(c, 4), 4u);
+    for (uint i = 0; i < c->delivered.size(); ++i) {
+        BOOST_CHECK_EQUAL(c->delivered[i].position, SequenceNumber(i + 1));
+    }
+    BOOST_CHECK_EQUAL(c->credit, 0u);
+}
+
+class NotifyConsumer : public TestConsumer
+{
+  public:
+    typedef boost::shared_ptr<NotifyConsumer> shared_ptr;
+
+    uint notified;
+    NotifyConsumer(bool acquire = true) : Consumer("test", acquire), notified(0) {}
+    void notify() { ++notified; }
+};
+
+QPID_AUTO_TEST_CASE(testNotifyOneConsumer){
+    Queue::shared_ptr queue(new Queue("my-queue"));
+    std::vector<NotifyConsumer::shared_ptr> consumers;
+    for (uint i = 0; i < 10; ++i) {
+        consumers.push_back(NotifyConsumer::shared_ptr(new NotifyConsumer()));
+        BOOST_CHECK(!queue->dispatch(consumers.back()));//registers as listener
+    }
+    NotifyConsumer::shared_ptr browser(new NotifyConsumer(false));
+    BOOST_CHECK(!queue->dispatch(browser));
+    queue->getListeners().removeListener(consumers[0]);
+    queue->getListeners().removeListener(consumers[2]);
+
+    //each message wakes the longest waiting consumer still listening, and the browser
+    queue->deliver(create_message("e", "A"));
+    queue->deliver(create_message("e", "B"));
+    BOOST_CHECK_EQUAL(consumers[0]->notified, 0u);
+    BOOST_CHECK_EQUAL(consumers[1]->notified, 1u);
+    BOOST_CHECK_EQUAL(consumers[2]->notified, 0u);
+    BOOST_CHECK_EQUAL(consumers[3]->notified, 1u);
+    for (uint i = 4; i < consumers.size(); ++i) {
+        BOOST_CHECK_EQUAL(consumers[i]->notified, 0u);
+    }
+    BOOST_CHECK_EQUAL(browser->notified, 1u);
+
+    //a consumer re-registered before its stale entry is dropped is only woken once
+    queue->getListeners().removeListener(consumers[5]);
+    BOOST_CHECK(!queue->getListeners().contains(consumers[5]));
+    queue->getListeners().addListener(consumers[5]);
+    BOOST_CHECK(queue->getListeners().contains(consumers[5]));
+    for (uint i = 0; i < 8; ++i) {
+        queue->deliver(create_message("e", "C"));
+    }
+    for (uint i = 4; i < consumers.size(); ++i) {
+        BOOST_CHECK_EQUAL(consumers[i]->notified, 1u);
+    }
+}
+
 QPID_AUTO_TEST_CASE(testRegistry){
     //Test use of queues in registry:
     QueueRegistry registry;
@@ -223,6 +338,77 @@ QPID_AUTO_TEST_CASE(testDequeue){
 
 }
 
+QPID_AUTO_TEST_CASE(testSplitEnqueueLock){
+    Queue::shared_ptr queue(new Queue("my_queue", true));
+    FieldTable args;
+    args.setInt("qpid.split_enqueue_lock", 1);
+    queue->configure(args);
+
+    intrusive_ptr<Message> msg1 = create_message("e", "A");
+    intrusive_ptr<Message> msg2 = create_message("e", "B");
+    intrusive_ptr<Message> msg3 = create_message("e", "C");
+
+    queue->deliver(msg1);
+    queue->deliver(msg2);
+    queue->deliver(msg3);
+    BOOST_CHECK_EQUAL(uint32_t(3), queue->getMessageCount());
+
+    QueuedMessage qm = queue->get();
+    BOOST_CHECK_EQUAL(msg1.get(), qm.payload.get());
+    BOOST_CHECK_EQUAL(SequenceNumber(1), qm.position);
+
+    TestConsumer::shared_ptr consumer(new TestConsumer());
+    queue->consume(consumer);
+    BOOST_CHECK(queue->dispatch(consumer));
+    BOOST_CHECK_EQUAL(msg2.get(), consumer->last.payload.get());
+    BOOST_CHECK(queue->dispatch(consumer));
+    BOOST_CHECK_EQUAL(msg3.get(), consumer->last.payload.get());
+    BOOST_CHECK_EQUAL(SequenceNumber(3), consumer->last.position);
+    BOOST_CHECK(!queue->dispatch(consumer));
+    BOOST_CHECK_EQUAL(uint32_t(0), queue->getMessageCount());
+}
+
+QPID_AUTO_TEST_CASE(testRecoveryBatch){
+    Queue::shared_ptr queue(new Queue("my_queue", true));
+    intrusive_ptr<Message> msg1 = create_message("e", "A");
+    intrusive_ptr<Message> msg2 = create_message("e", "B");
+    intrusive_ptr<Message> msg3 = create_message("e", "C");
+
+    queue->beginRecoveryBatch();
+    queue->recover(msg1);
+    queue->recover(msg2);
+    queue->recover(msg3);
+    BOOST_CHECK_EQUAL(uint32_t(0), queue->getMessageCount());
+    queue->endRecoveryBatch();
+    BOOST_CHECK_EQUAL(uint32_t(3), queue->getMessageCount());
+    BOOST_CHECK_EQUAL(msg1.get(), queue->get().payload.get());
+    QueuedMessage qm = queue->get();
+    BOOST_CHECK_EQUAL(msg2.get(), qm.payload.get());
+    BOOST_CHECK_EQUAL(SequenceNumber(2), qm.position);
+
+    // Later messages go straight onto the queue
+    queue->recover(msg1);
+    BOOST_CHECK_EQUAL(uint32_t(2), queue->getMessageCount());
+
+    // A last value queue keeps only the latest of a batch for each key
+    client::QueueOptions args;
+    args.setOrdering(client::LVQ);
+    Queue::shared_ptr lvq(new Queue("my_lvq", true));
+    lvq->create(args);
+    string key;
+    args.getLVQKey(key);
+    intrusive_ptr<Message> lvq1 = create_message("e", "A");
+    intrusive_ptr<Message> lvq2 = create_message("e", "A");
+    lvq1->insertCustomProperty(key, "a");
+    lvq2->insertCustomProperty(key, "a");
+    lvq->beginRecoveryBatch();
+    lvq->recover(lvq1);
+    lvq->recover(lvq2);
+    lvq->endRecoveryBatch();
+    BOOST_CHECK_EQUAL(uint32_t(1), lvq->getMessageCount());
+    BOOST_CHECK_EQUAL(lvq2.get(), lvq->get().payload.get());
+}
+
 QPID_AUTO_TEST_CASE(testBound){
     //test the recording of bindings, and use of those to allow a queue to be unbound
     string key("my-key");
@@ -487,6 +673,83 @@ QPID_AUTO_TEST_CASE(testLVQOrdering){
 
 }
 
+QPID_AUTO_TEST_CASE(testBrowseCursor){
+    Queue queue("my-queue");
+    MessageDeque messages;
+    QueuedMessage removed;
+    for (uint i = 1; i <= 10; ++i)
+        messages.push(QueuedMessage(&queue, create_message("e", "A"), i), removed);
+
+    QueuedMessage msg;
+    size_t cursor = 0;
+    SequenceNumber position(0);
+    BOOST_CHECK(messages.browse(position, msg, cursor));
+    BOOST_CHECK_EQUAL(msg.position, SequenceNumber(1));
+    position = msg.position;
+    BOOST_CHECK(messages.browse(position, msg, cursor));
+    BOOST_CHECK_EQUAL(msg.position, SequenceNumber(2));
+    position = msg.position;
+
+    // Consuming from the front leaves the cursor valid
+    BOOST_CHECK(messages.pop(msg));
+    BOOST_CHECK(messages.pop(msg));
+    BOOST_CHECK(messages.pop(msg));
+    BOOST_CHECK(messages.browse(position, msg, cursor));
+    BOOST_CHECK_EQUAL(msg.position, SequenceNumber(4));
+    position = msg.position;
+
+    // As does removing the message the browser would see next
+    BOOST_CHECK(messages.remove(5, msg));
+    BOOST_CHECK(messages.browse(position, msg, cursor));
+    BOOST_CHECK_EQUAL(msg.position, SequenceNumber(6));
+
+    // A cursor for another position is not trusted
+    BOOST_CHECK(messages.browse(SequenceNumber(8), msg, cursor));
+    BOOST_CHECK_EQUAL(msg.position, SequenceNumber(9));
+    BOOST_CHECK(messages.browse(SequenceNumber(9), msg, cursor));
+    BOOST_CHECK(!messages.browse(SequenceNumber(10), msg, cursor));
+    messages.push(QueuedMessage(&queue, create_message("e", "A"), 11), removed);
+    BOOST_CHECK(messages.browse(SequenceNumber(10), msg, cursor));
+    BOOST_CHECK_EQUAL(msg.position, SequenceNumber(11));
+}
+
+QPID_AUTO_TEST_CASE(testLVQManyKeys){
+    Queue queue("my-queue");
+    MessageMap messages("key");
+    QueuedMessage removed;
+    const uint keys = 1000;
+    for (uint i = 0; i < 2 * keys; ++i) {
+        intrusive_ptr<Message> msg = create_message("e", "A");
+        msg->insertCustomProperty("key", boost::lexical_cast<std::string>(i % keys));
+        BOOST_CHECK_EQUAL(messages.push(QueuedMessage(&queue, msg, i), removed), i >= keys);
+        if (i >= keys) BOOST_CHECK_EQUAL(removed.position, SequenceNumber(i - keys));
+    }
+    BOOST_CHECK_EQUAL(messages.size(), size_t(keys));
+
+    QueuedMessage msg;
+    BOOST_CHECK(!messages.find(5, msg));
+    BOOST_CHECK(messages.find(keys + 5, msg));
+    BOOST_CHECK(messages.remove(keys + 5, msg));
+    BOOST_CHECK(messages.next(keys + 4, msg));
+    BOOST_CHECK_EQUAL(msg.position, SequenceNumber(keys + 6));
+    BOOST_CHECK(messages.next(0, msg));
+    BOOST_CHECK_EQUAL(msg.position, SequenceNumber(keys));
+
+    messages.reinsert(msg);//still held, so ignored
+    BOOST_CHECK_EQUAL(messages.size(), size_t(keys - 1));
+    intrusive_ptr<Message> released = create_message("e", "A");
+    released->insertCustomProperty("key", "5");
+    messages.reinsert(QueuedMessage(&queue, released, 5));//key 5 was removed
+    BOOST_CHECK_EQUAL(messages.size(), size_t(keys));
+    BOOST_CHECK(messages.pop(msg));
+    BOOST_CHECK_EQUAL(msg.position, SequenceNumber(5));
+    for (uint i = 1; i < keys; ++i) {
+        BOOST_CHECK(messages.pop(msg));
+    }
+    BOOST_CHECK(messages.empty());
+    BOOST_CHECK(!messages.pop(msg));
+}
+
 QPID_AUTO_TEST_CASE(testLVQEmptyKey){
 
     client::QueueOptions args;
@@ -668,6 +931,210 @@ QPID_AUTO_TEST_CASE(testLVQRecover){
     BOOST_CHECK_EQUAL(testStore.deqCnt, 1u);
 }
 
+QPID_AUTO_TEST_CASE(testDequeueBatch) {
+    CountingStore store;
+    Queue::shared_ptr queue(new Queue("my-queue", false, &store));
+    TestConsumer::shared_ptr c(new TestConsumer());
+    std::vector<QueuedMessage> accepted;
+    for (int i = 0; i < 3; ++i) {
+        intrusive_ptr<Message> msg = create_message("exchange", "key");
+        msg->getFrames().getHeaders()->get<DeliveryProperties>(true)->setDeliveryMode(PERSISTENT);
+        queue->deliver(msg);
+        queue->dispatch(c);
+        accepted.push_back(c->last);
+    }
+    queue->dequeueBatch(0, accepted);
+    BOOST_CHECK_EQUAL(store.dequeues, 3);
+    BOOST_CHECK_EQUAL(store.txnDequeues, 0);
+    BOOST_CHECK_EQUAL(store.begins, 0);
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 0u);
+}
+
+QPID_AUTO_TEST_CASE(testRingReplacesAcquired) {
+    Queue::shared_ptr queue(new Queue("my-queue"));
+    std::auto_ptr<QueuePolicy> policy = QueuePolicy::createQueuePolicy("test", 3, 0, QueuePolicy::RING);
+    FieldTable args;
+    policy->update(args);
+    queue->configure(args);
+    TestConsumer::shared_ptr c(new TestConsumer());
+    for (int i = 0; i < 3; ++i) {
+        queue->deliver(create_message("exchange", "key"));
+    }
+    queue->dispatch(c);
+    QueuedMessage acquired = c->last;
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 2u);
+
+    // the acquired message is the oldest, so it makes way for the next
+    queue->deliver(create_message("exchange", "key"));
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 3u);
+    BOOST_CHECK(!queue->dequeue(0, acquired));
+    queue->requeue(acquired);
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 3u);
+
+    // then the oldest still available
+    queue->deliver(create_message("exchange", "key"));
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 3u);
+    queue->dispatch(c);
+    BOOST_CHECK_EQUAL(c->last.position, SequenceNumber(3));
+}
+
+QueuedMessage createPriorityMessage(Queue& queue, uint priority, uint position)
+{
+    intrusive_ptr<Message> msg = MessageUtils::createMessage("exchange", "key");
+    msg->getFrames().getHeaders()->get<DeliveryProperties>(true)->setPriority(priority);
+    return QueuedMessage(&queue, msg, position);
+}
+
+QPID_AUTO_TEST_CASE(testPriorityQueueIndex) {
+    Queue queue("my-queue");
+    PriorityQueue messages(10);
+    QueuedMessage removed;
+    const uint priorities[] = {1, 9, 4, 9, 0, 4};
+    for (uint i = 0; i < 6; ++i) {
+        messages.push(createPriorityMessage(queue, priorities[i], i), removed);
+    }
+    BOOST_CHECK_EQUAL(messages.size(), 6u);
+    BOOST_CHECK_EQUAL(messages.oldest().position, SequenceNumber(4));
+
+    QueuedMessage msg;
+    BOOST_CHECK(messages.find(2, msg));
+    BOOST_CHECK_EQUAL(msg.payload->getPriority(), 4u);
+    BOOST_CHECK(!messages.find(6, msg));
+    BOOST_CHECK(messages.remove(3, msg));
+    BOOST_CHECK(!messages.find(3, msg));
+    // browsing is in position order regardless of level
+    BOOST_CHECK(messages.next(2, msg));
+    BOOST_CHECK_EQUAL(msg.position, SequenceNumber(4));
+
+    const uint order[] = {1, 2, 5, 0, 4};
+    for (uint i = 0; i < 5; ++i) {
+        BOOST_CHECK(messages.pop(msg));
+        BOOST_CHECK_EQUAL(msg.position, SequenceNumber(order[i]));
+    }
+    BOOST_CHECK(messages.empty());
+    BOOST_CHECK(!messages.pop(msg));
+
+    messages.reinsert(createPriorityMessage(queue, 9, 3));
+    messages.reinsert(createPriorityMessage(queue, 0, 0));
+    BOOST_CHECK_EQUAL(messages.front().position, SequenceNumber(3));
+    BOOST_CHECK(messages.find(0, msg));
+}
+
+QPID_AUTO_TEST_CASE(testPriorityQueueIndexWithHoles) {
+    Queue queue("my-queue");
+    PriorityQueue messages(10);
+    QueuedMessage removed;
+    // a low priority message is left behind while many others pass it
+    messages.push(createPriorityMessage(queue, 0, 0), removed);
+    QueuedMessage msg;
+    for (uint i = 1; i <= 10000; ++i) {
+        messages.push(createPriorityMessage(queue, 9, i), removed);
+        BOOST_CHECK(messages.pop(msg));
+        BOOST_CHECK_EQUAL(msg.position, SequenceNumber(i));
+    }
+    messages.push(createPriorityMessage(queue, 4, 1000000), removed);
+    BOOST_CHECK_EQUAL(messages.size(), 2u);
+    BOOST_CHECK(messages.find(0, msg));
+    BOOST_CHECK(!messages.find(500, msg));
+    BOOST_CHECK(messages.next(0, msg));
+    BOOST_CHECK_EQUAL(msg.position, SequenceNumber(1000000));
+    BOOST_CHECK(!messages.next(1000000, msg));
+    BOOST_CHECK(messages.remove(0, msg));
+    BOOST_CHECK(messages.find(1000000, msg));
+}
+
+QPID_AUTO_TEST_CASE(testFairshareSkipsEmptyLevels) {
+    Queue queue("my-queue");
+    Fairshare messages(10, 1);
+    QueuedMessage removed;
+    const uint priorities[] = {9, 9, 1, 1};
+    for (uint i = 0; i < 4; ++i) {
+        messages.push(createPriorityMessage(queue, priorities[i], i), removed);
+    }
+    // one message from each level in turn
+    const uint order[] = {0, 2, 1, 3};
+    QueuedMessage msg;
+    for (uint i = 0; i < 4; ++i) {
+        BOOST_CHECK(messages.pop(msg));
+        BOOST_CHECK_EQUAL(msg.position, SequenceNumber(order[i]));
+    }
+}
+
+QPID_AUTO_TEST_CASE(testPagedQueue) {
+    Queue queue("my-queue");
+    PagedQueue paged("/tmp", 2, 4096, 0);
+    QueuedMessage removed;
+    for (uint i = 0; i < 50; ++i) {
+        intrusive_ptr<Message> msg = MessageUtils::createMessage("exchange", "key");
+        MessageUtils::addContent(msg, (boost::format("%1%:%2%") % i % std::string(1000, 'x')).str());
+        BOOST_CHECK(!paged.push(QueuedMessage(&queue, msg, i), removed));
+        BOOST_CHECK(paged.getLoadedPages() <= 2u);
+    }
+    BOOST_CHECK_EQUAL(paged.size(), 50u);
+    BOOST_CHECK(paged.getPages() > 2u);
+
+    QueuedMessage msg;
+    BOOST_CHECK(paged.find(20, msg));
+    BOOST_CHECK_EQUAL(msg.payload->getFrames().getContent().substr(0, 3), std::string("20:"));
+    BOOST_CHECK(paged.next(20, msg));
+    BOOST_CHECK_EQUAL(msg.position, SequenceNumber(21));
+    BOOST_CHECK(paged.remove(30, msg));
+    BOOST_CHECK(!paged.find(30, msg));
+    BOOST_CHECK(paged.getLoadedPages() <= 2u);
+
+    for (uint i = 0; i < 50; ++i) {
+        if (i == 30) continue;
+        BOOST_CHECK(paged.pop(msg));
+        BOOST_CHECK_EQUAL(msg.position, SequenceNumber(i));
+        BOOST_CHECK_EQUAL(msg.payload->getFrames().getContent(),
+                          (boost::format("%1%:%2%") % i % std::string(1000, 'x')).str());
+        BOOST_CHECK(paged.getLoadedPages() <= 2u);
+    }
+    BOOST_CHECK(paged.empty());
+    paged.reinsert(msg);
+    BOOST_CHECK_EQUAL(paged.front().position, SequenceNumber(49));
+}
+
+QPID_AUTO_TEST_CASE(testPagedQueueWithoutDirectory) {
+    Queue queue("my-queue");
+    PagedQueue paged("/nonexistent-paging-dir", 1, 4096, 0);
+    QueuedMessage removed;
+    for (uint i = 0; i < 10; ++i) {
+        intrusive_ptr<Message> msg = MessageUtils::createMessage("exchange", "key");
+        MessageUtils::addContent(msg, std::string(1000, 'a' + i));
+        BOOST_CHECK(!paged.push(QueuedMessage(&queue, msg, i), removed));
+    }
+    // Nothing could be paged out, so every page stays in memory
+    BOOST_CHECK_EQUAL(paged.getLoadedPages(), paged.getPages());
+    QueuedMessage msg;
+    for (uint i = 0; i < 10; ++i) {
+        BOOST_CHECK(paged.pop(msg));
+        BOOST_CHECK_EQUAL(msg.payload->getFrames().getContent(), std::string(1000, 'a' + i));
+    }
+    BOOST_CHECK(paged.empty());
+}
+
+QPID_AUTO_TEST_CASE(testPagedQueueDelivery) {
+    FieldTable args;
+    args.setInt(PagedQueue::pagingKey, 1);
+    args.setInt(PagedQueue::maxPagesLoadedKey, 1);
+    args.setInt(PagedQueue::pageFactorKey, 1);
+    Queue::shared_ptr queue(new Queue("my-queue"));
+    queue->configure(args);
+    for (uint i = 0; i < 20; ++i) {
+        intrusive_ptr<Message> msg = MessageUtils::createMessage("exchange", "key");
+        MessageUtils::addContent(msg, std::string(1000, 'a' + i));
+        queue->deliver(msg);
+    }
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 20u);
+    TestConsumer::shared_ptr c(new TestConsumer());
+    for (uint i = 0; i < 20; ++i) {
+        BOOST_CHECK(queue->dispatch(c));
+        BOOST_CHECK_EQUAL(c->last.payload->getFrames().getContent(), std::string(1000, 'a' + i));
+    }
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 0u);
+}
+
 void addMessagesToQueue(uint count, Queue& queue, uint oddTtl = 200, uint evenTtl = 0)
 {
     for (uint i = 0; i < count; i++) {
@@ -686,6 +1153,26 @@ QPID_AUTO_TEST_CASE(testPurgeExpired) {
     BOOST_CHECK_EQUAL(queue.getMessageCount(), 5u);
 }
 
+QPID_AUTO_TEST_CASE(testPurgeExpiredRequeued) {
+    Queue::shared_ptr queue(new Queue("my-queue"));
+    addMessagesToQueue(4, *queue, 200, 200);
+    TestConsumer::shared_ptr c(new TestConsumer());
+    queue->dispatch(c);
+    QueuedMessage consumed = c->last;
+    queue->dispatch(c);
+    QueuedMessage released = c->last;
+    queue->dequeue(0, consumed);
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 2u);
+    ::usleep(300*1000);
+    // The acquired message is skipped, then expires once it is back on the queue
+    queue->purgeExpired(0);
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 0u);
+    queue->requeue(released);
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 1u);
+    queue->purgeExpired(0);
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 0u);
+}
+
 QPID_AUTO_TEST_CASE(testQueueCleaner) {
     Timer timer;
     QueueRegistry queues;
@@ -911,6 +1398,48 @@ QPID_AUTO_TEST_CASE(testGroupsMultiConsumer) {
 }
 
 
+QPID_AUTO_TEST_CASE(testGroupsFromConsumerPosition) {
+    //
+    // Verify that a consumer's next grouped message is found from its
+    // position, and that a requeued message behind it is still delivered
+    //
+    FieldTable args;
+    Queue::shared_ptr queue(new Queue("my_queue", true));
+    args.setString("qpid.group_header_key", "GROUP-ID");
+    args.setInt("qpid.shared_msg_group", 1);
+    queue->configure(args);
+
+    std::string groups[] = { std::string("a"), std::string("b"),
+                             std::string("a"), std::string("b") };
+    for (int i = 0; i < 4; ++i) {
+        intrusive_ptr<Message> msg = create_message("e", "A");
+        msg->insertCustomProperty("GROUP-ID", groups[i]);
+        msg->insertCustomProperty("MY-ID", i);
+        queue->deliver(msg);
+    }
+
+    TestConsumer::shared_ptr c1(new TestConsumer("C1"));
+    queue->consume(c1);
+    std::deque<QueuedMessage> dequeMeC1;
+
+    verifyAcquire(queue, c1, dequeMeC1, "a", 0 );
+    verifyAcquire(queue, c1, dequeMeC1, "b", 1 );
+    verifyAcquire(queue, c1, dequeMeC1, "a", 2 );
+
+    // C1 still owns "a" through a-2, so a-0 goes back on its own list
+    queue->requeue( dequeMeC1.front() );
+    dequeMeC1.pop_front();
+
+    // Queue = a-0, a-2, b-1, b-3
+    // Owners= ^C1, ^C1, ^C1, ^C1
+
+    verifyAcquire(queue, c1, dequeMeC1, "b", 3 );   // next after its position
+    verifyAcquire(queue, c1, dequeMeC1, "a", 0 );   // then the requeued one
+    BOOST_CHECK( !queue->dispatch(c1) );
+
+    queue->cancel(c1);
+}
+
 QPID_AUTO_TEST_CASE(testGroupsMultiConsumerDefaults) {
     //
     // Verify that the same default group name is automatically applied to messages that
@@ -1393,6 +1922,248 @@ QPID_AUTO_TEST_CASE(testFlowToDiskBlocking){
     BOOST_CHECK_EQUAL(5u, tq9->getMessageCount());
 }
 
+QPID_AUTO_TEST_CASE(testPartitionedQueue) {
+    Queue::shared_ptr queue(new Queue("my-queue", true));
+    FieldTable args;
+    args.setInt("qpid.partitions", 3);
+    args.setString("qpid.partition_key", "customer");
+    queue->configure(args);
+    BOOST_REQUIRE(queue->isPartitioned());
+
+    // Consumers are spread over the partitions
+    TestConsumer::shared_ptr c1(new TestConsumer("c1"));
+    TestConsumer::shared_ptr c2(new TestConsumer("c2"));
+    Queue::shared_ptr p1 = queue->partitionForConsumer();
+    p1->consume(c1);
+    Queue::shared_ptr p2 = queue->partitionForConsumer();
+    p2->consume(c2);
+    BOOST_CHECK(p1 != p2);
+    BOOST_CHECK_EQUAL(queue, p1->getPartitioned());
+    BOOST_CHECK_EQUAL(2u, queue->getConsumerCount());
+
+    // Messages with the same key stay together
+    intrusive_ptr<Message> keyed = create_message("e", "A");
+    keyed->insertCustomProperty("customer", "acme");
+    Queue::shared_ptr p = queue->partitionFor(*keyed);
+    for (int i = 0; i < 3; ++i) queue->deliver(keyed);
+    BOOST_CHECK_EQUAL(3u, p->getMessageCount());
+
+    // Others skip the partition that has no consumer
+    for (int i = 0; i < 4; ++i) {
+        intrusive_ptr<Message> msg = create_message("e", "B");
+        Queue::shared_ptr target = queue->partitionFor(*msg);
+        BOOST_CHECK(target == p1 || target == p2);
+        queue->deliver(msg);
+    }
+    BOOST_CHECK_EQUAL(7u, queue->getMessageCount());
+
+    BOOST_CHECK_EQUAL(7u, queue->purge());
+    BOOST_CHECK_EQUAL(0u, queue->getMessageCount());
+    p1->cancel(c1);
+    p2->cancel(c2);
+    BOOST_CHECK_EQUAL(0u, queue->getConsumerCount());
+}
+
+QPID_AUTO_TEST_CASE(testScheduledDelivery) {
+    Queue::shared_ptr queue(new Queue("my-queue"));
+    int64_t now = Duration(EPOCH, AbsTime::now()) / TIME_MSEC;
+
+    intrusive_ptr<Message> late = create_message("e", "late");
+    late->insertCustomProperty("qpid.delivery_time", now + 200);
+    queue->deliver(late);
+    intrusive_ptr<Message> later = create_message("e", "later");
+    later->insertCustomProperty("qpid.delivery_time", now + 60*1000);
+    queue->deliver(later);
+    // a delivery time already past doesn't hold the message back
+    intrusive_ptr<Message> past = create_message("e", "past");
+    past->insertCustomProperty("qpid.delivery_time", now - 1000);
+    queue->deliver(past);
+    BOOST_CHECK_EQUAL(1u, queue->getMessageCount());
+    BOOST_CHECK_EQUAL(2u, queue->getScheduledCount());
+
+    queue->releaseScheduled();
+    BOOST_CHECK_EQUAL(1u, queue->getMessageCount());
+    ::usleep(300*1000);
+    queue->releaseScheduled();
+    BOOST_CHECK_EQUAL(2u, queue->getMessageCount());
+    BOOST_CHECK_EQUAL(1u, queue->getScheduledCount());
+
+    TestConsumer::shared_ptr c(new TestConsumer());
+    BOOST_CHECK(queue->dispatch(c));
+    BOOST_CHECK_EQUAL(past, c->last.payload);
+    BOOST_CHECK(queue->dispatch(c));
+    BOOST_CHECK_EQUAL(late, c->last.payload);
+    BOOST_CHECK(!queue->dispatch(c));
+}
+
+QPID_AUTO_TEST_CASE(testPurgeScheduled) {
+    Queue::shared_ptr queue(new Queue("my-queue"));
+    int64_t now = Duration(EPOCH, AbsTime::now()) / TIME_MSEC;
+
+    queue->deliver(create_message("e", "now"));
+    for (int i = 0; i < 3; ++i) {
+        intrusive_ptr<Message> msg = create_message("e", "later");
+        msg->insertCustomProperty("qpid.delivery_time", now + 60*1000);
+        queue->deliver(msg);
+    }
+    BOOST_CHECK_EQUAL(3u, queue->getScheduledCount());
+
+    // Held messages are purged after those already due
+    BOOST_CHECK_EQUAL(2u, queue->purge(2));
+    BOOST_CHECK_EQUAL(0u, queue->getMessageCount());
+    BOOST_CHECK_EQUAL(2u, queue->getScheduledCount());
+    BOOST_CHECK_EQUAL(2u, queue->purge());
+    BOOST_CHECK_EQUAL(0u, queue->getScheduledCount());
+    queue->releaseScheduled(); // nothing left to release
+    BOOST_CHECK_EQUAL(0u, queue->getMessageCount());
+}
+
+class SessionConsumer : public NotifyConsumer
+{
+    const OwnershipToken& session;
+  public:
+    typedef boost::shared_ptr<SessionConsumer> shared_ptr;
+    SessionConsumer(const OwnershipToken& s) : Consumer("test", true), session(s) {}
+    OwnershipToken* getSession() { return const_cast<OwnershipToken*>(&session); }
+};
+
+QPID_AUTO_TEST_CASE(testHandoffToLocalConsumer) {
+    ConnectionToken connection;
+    ConnectionToken other;
+    Queue::shared_ptr queue(new Queue("my-queue", true, 0, &connection));
+    SessionConsumer::shared_ptr c(new SessionConsumer(connection));
+    BOOST_CHECK(!queue->dispatch(c));//registers as listener
+
+    // published on the consumer's own connection: delivered at once
+    intrusive_ptr<Message> local = create_message("e", "A");
+    local->setPublisher(&connection);
+    queue->deliver(local);
+    BOOST_CHECK(c->received);
+    BOOST_CHECK_EQUAL(local, c->last.payload);
+    BOOST_CHECK_EQUAL(0u, c->notified);
+    BOOST_CHECK_EQUAL(0u, queue->getMessageCount());
+
+    // from elsewhere, or with the consumer no longer waiting: queued
+    intrusive_ptr<Message> remote = create_message("e", "B");
+    remote->setPublisher(&other);
+    BOOST_CHECK(!queue->dispatch(c));
+    queue->deliver(remote);
+    BOOST_CHECK_EQUAL(1u, c->notified);
+    BOOST_CHECK_EQUAL(1u, queue->getMessageCount());
+    queue->deliver(local);
+    BOOST_CHECK_EQUAL(2u, queue->getMessageCount());
+    BOOST_CHECK(queue->dispatch(c));
+    BOOST_CHECK_EQUAL(remote, c->last.payload);
+}
+
+class DeferredObserver : public QueueObserver
+{
+  public:
+    Queue* queue;
+    std::vector<std::string> events;
+    bool republish;
+
+    DeferredObserver() : queue(0), republish(false) {}
+    void enqueued(const QueuedMessage& m)
+    {
+        events.push_back("enqueued " + m.payload->getRoutingKey());
+        if (republish) {
+            // raising an event from an observer must not recurse
+            republish = false;
+            queue->deliver(create_message("e", "again"));
+            events.push_back("republished");
+        }
+    }
+    void dequeued(const QueuedMessage& m) { events.push_back("dequeued " + m.payload->getRoutingKey()); }
+    void acquired(const QueuedMessage& m) { events.push_back("acquired " + m.payload->getRoutingKey()); }
+    void requeued(const QueuedMessage& m) { events.push_back("requeued " + m.payload->getRoutingKey()); }
+    bool isDeferred() const { return true; }
+};
+
+QPID_AUTO_TEST_CASE(testDeferredObserver) {
+    Queue::shared_ptr queue(new Queue("my-queue"));
+    boost::shared_ptr<DeferredObserver> observer(new DeferredObserver());
+    observer->queue = queue.get();
+    queue->addObserver(observer);
+
+    queue->deliver(create_message("e", "A"));
+    BOOST_REQUIRE_EQUAL(1u, observer->events.size());
+    BOOST_CHECK_EQUAL(std::string("enqueued A"), observer->events[0]);
+
+    TestConsumer::shared_ptr c(new TestConsumer());
+    BOOST_CHECK(queue->dispatch(c));
+    queue->requeue(c->last);
+    BOOST_CHECK(queue->dispatch(c));
+    queue->dequeue(0, c->last);
+    const char* expected[] = { "enqueued A", "acquired A", "requeued A", "acquired A", "dequeued A" };
+    BOOST_REQUIRE_EQUAL(5u, observer->events.size());
+    for (int i = 0; i < 5; ++i) BOOST_CHECK_EQUAL(std::string(expected[i]), observer->events[i]);
+
+    observer->events.clear();
+    observer->republish = true;
+    queue->deliver(create_message("e", "B"));
+    BOOST_REQUIRE_EQUAL(3u, observer->events.size());
+    BOOST_CHECK_EQUAL(std::string("enqueued B"), observer->events[0]);
+    BOOST_CHECK_EQUAL(std::string("republished"), observer->events[1]);
+    BOOST_CHECK_EQUAL(std::string("enqueued again"), observer->events[2]);
+    BOOST_CHECK_EQUAL(2u, queue->getMessageCount());
+}
+
+QPID_AUTO_TEST_CASE(testMoveAndPurgeFiltered) {
+    Queue::shared_ptr source(new Queue("source"));
+    Queue::shared_ptr target(new Queue("target"));
+    for (int i = 0; i < 10; ++i) {
+        intrusive_ptr<Message> msg = create_message("e", boost::lexical_cast<std::string>(i));
+        msg->insertCustomProperty("colour", i % 2 ? "red" : "blue");
+        source->deliver(msg);
+    }
+    qpid::types::Variant::Map params;
+    params["header_key"] = "colour";
+    params["header_value"] = "red";
+    qpid::types::Variant::Map filter;
+    filter["filter_type"] = "header_match_str";
+    filter["filter_params"] = params;
+
+    BOOST_CHECK_EQUAL(3u, source->move(target, 3, &filter));
+    BOOST_CHECK_EQUAL(7u, source->getMessageCount());
+    BOOST_CHECK_EQUAL(3u, target->getMessageCount());
+    TestConsumer::shared_ptr c(new TestConsumer());
+    const char* moved[] = { "1", "3", "5" };
+    for (int i = 0; i < 3; ++i) {
+        BOOST_CHECK(target->dispatch(c));
+        BOOST_CHECK_EQUAL(std::string(moved[i]), c->last.payload->getRoutingKey());
+    }
+
+    // a run at the front and the rest
+    BOOST_CHECK_EQUAL(2u, source->move(target, 2));
+    BOOST_CHECK_EQUAL(2u, source->purge(0, boost::shared_ptr<Exchange>(), &filter));
+    BOOST_CHECK_EQUAL(3u, source->getMessageCount());
+    const char* left[] = { "4", "6", "8" };
+    for (int i = 0; i < 3; ++i) {
+        BOOST_CHECK(source->dispatch(c));
+        BOOST_CHECK_EQUAL(std::string(left[i]), c->last.payload->getRoutingKey());
+    }
+    BOOST_CHECK_EQUAL(2u, target->getMessageCount());
+}
+
+QPID_AUTO_TEST_CASE(testDropDuplicates) {
+    Queue::shared_ptr queue(new Queue("my-queue"));
+    FieldTable args;
+    args.setInt("qpid.duplicate_window", 60);
+    queue->configure(args);
+
+    Uuid first(true), second(true);
+    queue->deliver(MessageUtils::createMessage("e", "A", false, first));
+    queue->deliver(MessageUtils::createMessage("e", "B", false, second));
+    // Replayed
+    queue->deliver(MessageUtils::createMessage("e", "A", false, first));
+    BOOST_CHECK_EQUAL(2u, queue->getMessageCount());
+
+    // Messages without an id are never dropped
+    queue->deliver(MessageUtils::createMessage("e", "C", false, Uuid()));
+    queue->deliver(MessageUtils::createMessage("e", "C", false, Uuid()));
+    BOOST_CHECK_EQUAL(4u, queue->getMessageCount());
+}
 
 QPID_AUTO_TEST_SUITE_END()
 
@@ -20,6 +20,7 @@
 #include "unit_test.h"
 #include "test_tools.h"
 #include "qpid/RangeSet.h"
+#include <set>
 
 using namespace std;
 using namespace qpid;
@@ -128,6 +129,57 @@ QPID_AUTO_TEST_CASE(testRangeSetRemove) {
                       TestRangeSet(10,11)+TestRange(14,15)+TestRange(20,23));
 }
 
+TestRangeSet fragmented(int seed, int n) {
+    TestRangeSet r;
+    for (int i = 0; i < n; ++i) {
+        int begin = (seed * 7919 + i * 104729) % 1000;
+        r += TestRange(begin, begin + (i % 5) + 1);
+    }
+    return r;
+}
+
+std::set<int> members(const TestRangeSet& r) {
+    return std::set<int>(r.begin(), r.end());
+}
+
+QPID_AUTO_TEST_CASE(testFragmentedSets) {
+    TestRangeSet a = fragmented(1, 200);
+    TestRangeSet b = fragmented(2, 300);
+    std::set<int> expect = members(a);
+    std::set<int> other = members(b);
+
+    TestRangeSet sum = a + b;
+    std::set<int> all(expect);
+    all.insert(other.begin(), other.end());
+    BOOST_CHECK(members(sum) == all);
+    for (TestRangeSet::RangeIterator i = sum.rangesBegin(); i != sum.rangesEnd(); ++i) {
+        TestRangeSet::RangeIterator j = i;
+        if (++j != sum.rangesEnd()) BOOST_CHECK(i->end() < j->begin());
+    }
+
+    TestRangeSet difference = a - b;
+    for (std::set<int>::iterator i = other.begin(); i != other.end(); ++i) expect.erase(*i);
+    BOOST_CHECK(members(difference) == expect);
+    BOOST_CHECK_EQUAL(difference + (a - difference), a);
+    BOOST_CHECK((a - a).empty());
+}
+
+QPID_AUTO_TEST_CASE(testEmptyOperands) {
+    TestRangeSet a = TestRangeSet(1,3) + 7;
+    TestRangeSet empty;
+    BOOST_CHECK_EQUAL(a + empty, a);
+    BOOST_CHECK_EQUAL(a - empty, a);
+    BOOST_CHECK_EQUAL(empty + a, a);
+    BOOST_CHECK((empty - a).empty());
+    BOOST_CHECK((empty + empty).empty());
+
+    TestRangeSet b(a);
+    b += TestRangeSet();
+    BOOST_CHECK_EQUAL(b, a);
+    b -= TestRangeSet();
+    BOOST_CHECK_EQUAL(b, a);
+}
+
 QPID_AUTO_TEST_CASE(testRangeContaining) {
     TestRangeSet r;
     (((r += 1) += TestRange(3,5)) += 7);
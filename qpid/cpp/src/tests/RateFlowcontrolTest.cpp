@@ -22,6 +22,7 @@
 #include "unit_test.h"
 
 #include "qpid/broker/RateFlowcontrol.h"
+#include "qpid/broker/TokenBucket.h"
 #include "qpid/sys/Time.h"
 
 using namespace qpid::broker;
@@ -66,6 +67,35 @@ QPID_AUTO_TEST_CASE(RateFlowcontrolTest)
    BOOST_CHECK_EQUAL( fc.receivedMessage(n, 0), 50U);
 }
 
+QPID_AUTO_TEST_CASE(TokenBucketTest)
+{
+    AbsTime n = AbsTime::now();
+    TokenBucket b(100, n);
+
+    // Starts full with a second's worth
+    BOOST_CHECK_EQUAL(b.take(n, 60), 60U);
+    BOOST_CHECK_EQUAL(b.take(n, 60), 40U);
+    BOOST_CHECK_EQUAL(b.take(n, 1), 0U);
+
+    n = AbsTime(n, 250*TIME_MSEC);
+    BOOST_CHECK_EQUAL(b.take(n, 100), 25U);
+
+    // Returned tokens are available at once
+    b.giveBack(10);
+    BOOST_CHECK_EQUAL(b.take(n, 100), 10U);
+
+    // A charge leaves a debt that refills pay off first
+    b.charge(n, 50);
+    n = AbsTime(n, 250*TIME_MSEC);
+    BOOST_CHECK_EQUAL(b.take(n, 100), 0U);
+    n = AbsTime(n, 500*TIME_MSEC);
+    BOOST_CHECK_EQUAL(b.take(n, 100), 25U);
+
+    // Never holds more than a second's worth
+    n = AbsTime(n, 10*TIME_SEC);
+    BOOST_CHECK_EQUAL(b.take(n, 1000), 100U);
+}
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
@@ -27,7 +27,9 @@
 #include "qpid/broker/Broker.h"
 #include "qpid/client/QueueOptions.h"
 #include "qpid/framing/reply_exceptions.h"
+#include "qpid/framing/Buffer.h"
 #include "qpid/framing/SequenceNumber.h"
+#include "qpid/framing/SequenceSet.h"
 #include "qpid/replication/constants.h"
 #include "qpid/sys/Shlib.h"
 
@@ -138,6 +140,48 @@ QPID_AUTO_TEST_CASE(testReplicationExchange)
     }
 }
 
+QPID_AUTO_TEST_CASE(testBatchedDequeueEvents)
+{
+    qpid::broker::Broker::Options brokerOpts(getBrokerOpts(list_of<string>("qpidd")
+                                                           ("--replication-exchange-name=qpid.replication")
+                                                           ("--replication-dequeue-batch=5")));
+    SessionFixture f(brokerOpts);
+
+    std::string dataQ("queue-1");
+    std::string eventQ("event-queue-1");
+    f.session.queueDeclare(arg::queue=eventQ, arg::exclusive=true, arg::autoDelete=true);
+    f.session.exchangeBind(arg::exchange="qpid.replication", arg::queue=eventQ, arg::bindingKey=dataQ);
+
+    QueueOptions args;
+    args.enableQueueEvents(false);
+    f.session.queueDeclare(arg::queue=dataQ, arg::exclusive=true, arg::autoDelete=true, arg::arguments=args);
+    for (int i = 0; i < 10; i++)
+        f.session.messageTransfer(arg::content=Message((boost::format("%1%_%2%") % "Message" % (i+1)).str(), dataQ));
+    Message msg;
+    LocalQueue incoming;
+    Subscription sub = f.subs.subscribe(incoming, dataQ);
+    for (int i = 0; i < 10; i++)
+        BOOST_CHECK(incoming.get(msg, qpid::sys::TIME_SEC));
+
+    sub.cancel();
+    sub = f.subs.subscribe(incoming, eventQ);
+    for (int i = 0; i < 10; i++) {
+        BOOST_CHECK(incoming.get(msg, qpid::sys::TIME_SEC));
+        BOOST_CHECK_EQUAL(msg.getHeaders().getAsInt(REPLICATION_EVENT_TYPE), ENQUEUE);
+    }
+    //check that the dequeues arrive as two events of five positions each:
+    for (int i = 0; i < 2; i++) {
+        BOOST_CHECK(incoming.get(msg, qpid::sys::TIME_SEC));
+        BOOST_CHECK_EQUAL(msg.getHeaders().getAsString(REPLICATION_TARGET_QUEUE), dataQ);
+        BOOST_CHECK_EQUAL(msg.getHeaders().getAsInt(REPLICATION_EVENT_TYPE), DEQUEUE);
+        BOOST_CHECK_EQUAL(msg.getHeaders().getAsInt(DEQUEUED_MESSAGE_COUNT), 5);
+        std::string data(msg.getData());
+        Buffer buffer(const_cast<char*>(data.data()), data.size());
+        SequenceSet positions;
+        positions.decode(buffer);
+        BOOST_CHECK_EQUAL(positions, SequenceSet(SequenceNumber(i*5+1), SequenceNumber(i*5+5)));
+    }
+}
 
 QPID_AUTO_TEST_SUITE_END()
 
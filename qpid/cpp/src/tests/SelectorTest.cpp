@@ -0,0 +1,144 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "MessageUtils.h"
+#include "unit_test.h"
+#include "qpid/broker/Queue.h"
+#include "qpid/broker/Selector.h"
+#include "qpid/framing/FieldTable.h"
+#include "qpid/framing/MessageProperties.h"
+#include "qpid/framing/reply_exceptions.h"
+
+using boost::intrusive_ptr;
+using namespace qpid::broker;
+using namespace qpid::framing;
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(SelectorTestSuite)
+
+namespace {
+intrusive_ptr<Message> message(const FieldTable& headers, const std::string& key = "key")
+{
+    intrusive_ptr<Message> msg = MessageUtils::createMessage("exchange", key);
+    msg->getFrames().getHeaders()->get<MessageProperties>(true)->setApplicationHeaders(headers);
+    return msg;
+}
+
+bool matches(const std::string& expression, const intrusive_ptr<Message>& msg)
+{
+    return Selector(expression).filter(*msg);
+}
+
+class SelectiveConsumer : public Consumer
+{
+    Selector selector;
+  public:
+    typedef boost::shared_ptr<SelectiveConsumer> shared_ptr;
+
+    std::vector<QueuedMessage> delivered;
+    uint notified;
+
+    SelectiveConsumer(const std::string& expression) : Consumer("test", true), selector(expression), notified(0) {}
+    bool deliver(QueuedMessage& msg) { delivered.push_back(msg); return true; }
+    bool filter(intrusive_ptr<Message> msg) { return selector.filter(*msg); }
+    void notify() { ++notified; }
+    OwnershipToken* getSession() { return 0; }
+};
+}
+
+QPID_AUTO_TEST_CASE(testComparisons) {
+    FieldTable headers;
+    headers.setString("colour", "red");
+    headers.setInt("size", 7);
+    headers.setDouble("weight", 2.5);
+    intrusive_ptr<Message> msg = message(headers);
+
+    BOOST_CHECK(matches("colour = 'red'", msg));
+    BOOST_CHECK(!matches("colour <> 'red'", msg));
+    BOOST_CHECK(matches("size > 5 AND size <= 7", msg));
+    BOOST_CHECK(matches("size = 7.0", msg));
+    BOOST_CHECK(matches("weight < 3", msg));
+    BOOST_CHECK(matches("size BETWEEN 1 AND 10", msg));
+    BOOST_CHECK(matches("size NOT BETWEEN -3 AND 6", msg));
+    BOOST_CHECK(matches("colour IN ('green', 'red')", msg));
+    BOOST_CHECK(!matches("colour NOT IN ('green', 'red')", msg));
+    BOOST_CHECK(matches("routing_key = 'key' and priority = 4", msg));
+    BOOST_CHECK(matches("(colour = 'blue' OR size = 7) AND NOT weight > 10", msg));
+}
+
+QPID_AUTO_TEST_CASE(testMissingHeaders) {
+    intrusive_ptr<Message> msg = message(FieldTable());
+    BOOST_CHECK(matches("colour IS NULL", msg));
+    BOOST_CHECK(!matches("colour IS NOT NULL", msg));
+    // comparisons with a missing header are unknown, and so is their negation
+    BOOST_CHECK(!matches("colour = 'red'", msg));
+    BOOST_CHECK(!matches("NOT colour = 'red'", msg));
+    BOOST_CHECK(matches("colour = 'red' OR TRUE", msg));
+    BOOST_CHECK(!matches("size > 1 OR size <= 1", msg));
+}
+
+QPID_AUTO_TEST_CASE(testLike) {
+    FieldTable headers;
+    headers.setString("name", "order_123");
+    intrusive_ptr<Message> msg = message(headers);
+    BOOST_CHECK(matches("name LIKE 'order%'", msg));
+    BOOST_CHECK(matches("name LIKE '%_1_3'", msg));
+    BOOST_CHECK(matches("name LIKE 'order!_%' ESCAPE '!'", msg));
+    BOOST_CHECK(!matches("name LIKE 'order!__' ESCAPE '!'", msg));
+    BOOST_CHECK(matches("name NOT LIKE '%x%'", msg));
+    BOOST_CHECK(matches("\"name\" like 'ORDER%' or name like '%3'", msg));
+}
+
+QPID_AUTO_TEST_CASE(testInvalid) {
+    BOOST_CHECK_THROW(Selector(""), InvalidArgumentException);
+    BOOST_CHECK_THROW(Selector("colour ="), InvalidArgumentException);
+    BOOST_CHECK_THROW(Selector("colour = 'red"), InvalidArgumentException);
+    BOOST_CHECK_THROW(Selector("(size > 1"), InvalidArgumentException);
+    BOOST_CHECK_THROW(Selector("size > 1 size"), InvalidArgumentException);
+    BOOST_CHECK_THROW(Selector("colour LIKE 5"), InvalidArgumentException);
+    BOOST_CHECK_THROW(Selector("size # 1"), InvalidArgumentException);
+}
+
+QPID_AUTO_TEST_CASE(testConsumerSkipsUnwanted) {
+    Queue::shared_ptr queue(new Queue("my-queue"));
+    for (int i = 0; i < 4; ++i) {
+        FieldTable headers;
+        headers.setInt("n", i);
+        queue->deliver(message(headers));
+    }
+    SelectiveConsumer::shared_ptr odd(new SelectiveConsumer("n IN (1, 3)"));
+    BOOST_CHECK_EQUAL(queue->dispatch(odd, 10), 2u);
+    BOOST_CHECK_EQUAL(odd->delivered[0].position, SequenceNumber(2));
+    BOOST_CHECK_EQUAL(odd->delivered[1].position, SequenceNumber(4));
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 2u);
+
+    // nothing left it wants; it waits for the next arrival
+    SelectiveConsumer::shared_ptr none(new SelectiveConsumer("n > 100"));
+    BOOST_CHECK(!queue->dispatch(none));
+    BOOST_CHECK(queue->getListeners().contains(none));
+    BOOST_CHECK(!queue->dispatch(none));
+    BOOST_CHECK_EQUAL(queue->getMessageCount(), 2u);
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
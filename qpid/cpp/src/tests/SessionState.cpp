@@ -22,6 +22,7 @@
 #include "qpid/Exception.h"
 #include "qpid/framing/MessageTransferBody.h"
 #include "qpid/framing/SessionFlushBody.h"
+#include "qpid/framing/reply_exceptions.h"
 
 #include <boost/bind.hpp>
 #include <algorithm>
@@ -60,7 +61,7 @@ string str(const AMQFrame& f) {
     return "H";                 // Must be a header.
 }
 // Make a string from a range of frames.
-string str(const boost::iterator_range<vector<AMQFrame>::const_iterator>& frames) {
+string str(const qpid::SessionState::ReplayRange& frames) {
     string (*strFrame)(const AMQFrame&) = str;
     return applyAccumulate(frames.begin(), frames.end(), string(), ptr_fun(strFrame));
 }
@@ -194,6 +195,20 @@ QPID_AUTO_TEST_CASE(testPeerConfirmed) {
     BOOST_CHECK(!s.senderNeedFlush());
 }
 
+QPID_AUTO_TEST_CASE(testConfirmedReleasesReplaySpace) {
+    qpid::SessionState::Configuration c;
+    // Room for 3 1-byte transfers
+    c.replayHardLimit = 3*(transferFrameSize()+contentFrameSize());
+    qpid::SessionState s(SessionId(), c);
+    s.setTimeout(1);
+    s.senderGetCommandPoint();
+    transfers(s, "abc");
+    s.senderConfirmed(SessionPoint(2));
+    transfers(s, "de");
+    BOOST_CHECK_EQUAL(str(s.senderExpected(SessionPoint(2,0))), "CcCdCe");
+    BOOST_CHECK_THROW(transfers(s, "f"), qpid::framing::ResourceLimitExceededException);
+}
+
 QPID_AUTO_TEST_CASE(testPeerCompleted) {
     qpid::SessionState s;
     s.setTimeout(1);
@@ -0,0 +1,147 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "unit_test.h"
+#include "test_tools.h"
+#include "BrokerFixture.h"
+#include "qpid/client/ConnectionSettings.h"
+#include "qpid/sys/Time.h"
+
+#include <boost/lexical_cast.hpp>
+#include <string>
+
+#include <poll.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/** @file Tests the shared memory transport between a client and the broker. */
+
+namespace qpid {
+namespace tests {
+
+QPID_AUTO_TEST_SUITE(ShmIOTestSuite)
+
+using namespace qpid::client;
+using std::string;
+
+namespace {
+// Offsets of the connecting end's indices in the control page: ring 1 is
+// the one it writes, each index being on a cache line of its own
+const size_t HEAD_1 = 64;
+const size_t TAIL_0 = 128;
+
+ConnectionSettings shmSettings(BrokerFixture& fix) {
+    ConnectionSettings settings;
+    settings.protocol = "shm";
+    settings.port = fix.broker->getPort("shm");
+    return settings;
+}
+
+/**
+ * Connects to the broker's shared memory as a client would, sets one of
+ * the client's indices to a value and signals the broker. Returns true if
+ * the broker then closes the connection.
+ */
+bool closedAfterSetting(uint16_t port, size_t offset, uint32_t value) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::sockaddr_un addr;
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    string name = "qpidd-shm-" + boost::lexical_cast<string>(port);
+    ::memcpy(addr.sun_path + 1, name.data(), name.size());
+    BOOST_REQUIRE(::connect(fd, reinterpret_cast< ::sockaddr*>(&addr),
+                            offsetof(::sockaddr_un, sun_path) + 1 + name.size()) == 0);
+
+    uint32_t hello[2];
+    ::iovec iov = { hello, sizeof(hello) };
+    char buffer[CMSG_SPACE(sizeof(int))];
+    ::msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = buffer;
+    msg.msg_controllen = sizeof(buffer);
+    BOOST_REQUIRE_EQUAL(::recvmsg(fd, &msg, 0), ssize_t(sizeof(hello)));
+    int segment;
+    ::memcpy(&segment, CMSG_DATA(CMSG_FIRSTHDR(&msg)), sizeof(int));
+    size_t page = ::sysconf(_SC_PAGESIZE);
+    char* control = static_cast<char*>(::mmap(0, page, PROT_READ | PROT_WRITE, MAP_SHARED, segment, 0));
+    BOOST_REQUIRE(control != MAP_FAILED);
+
+    *reinterpret_cast<volatile uint32_t*>(control + offset) = value;
+    __sync_synchronize();
+    const char signal = 0;
+    BOOST_REQUIRE_EQUAL(::send(fd, &signal, 1, MSG_NOSIGNAL), 1);
+
+    // The broker shuts the socket down, so it reads end of file
+    bool closed = false;
+    ::pollfd p = { fd, POLLIN, 0 };
+    char c;
+    while (::poll(&p, 1, 5000) == 1) {
+        if (::read(fd, &c, 1) != 1) {
+            closed = true;
+            break;
+        }
+    }
+    ::munmap(control, page);
+    ::close(segment);
+    ::close(fd);
+    return closed;
+}
+}
+
+QPID_AUTO_TEST_CASE(testRoundTrip) {
+    BrokerFixture fix;
+    Client c(shmSettings(fix));
+    c.session.queueDeclare(arg::queue="q");
+    // Enough to go round the rings several times
+    const int count = 100;
+    const string content(16 * 1024, 'x');
+    for (int i = 0; i < count; ++i)
+        c.session.messageTransfer(arg::content=Message(content, "q"));
+    for (int i = 0; i < count; ++i) {
+        Message m;
+        BOOST_REQUIRE(c.subs.get(m, "q", sys::TIME_SEC));
+        BOOST_CHECK_EQUAL(m.getData(), content);
+    }
+    c.connection.close();
+}
+
+QPID_AUTO_TEST_CASE(testCorruptIndices) {
+    BrokerFixture fix;
+    uint16_t port = fix.broker->getPort("shm");
+    // Claims more unread data than the ring holds
+    BOOST_CHECK(closedAfterSetting(port, HEAD_1, 0x7fffffff));
+    // Claims to have read data the broker never wrote
+    BOOST_CHECK(closedAfterSetting(port, TAIL_0, 1));
+    // The broker still serves well behaved clients
+    Client c(shmSettings(fix));
+    c.session.queueDeclare(arg::queue="q");
+    c.connection.close();
+}
+
+QPID_AUTO_TEST_SUITE_END()
+
+}} // namespace qpid::tests
@@ -22,6 +22,7 @@
 #include <qpid/messaging/Message.h>
 #include <ostream>
 #include <iomanip>
+#include <cmath>
 
 namespace qpid {
 namespace tests {
@@ -66,14 +67,16 @@ void ThroughputAndLatency::message(const messaging::Message& m) {
         int64_t start(i->second.asInt64());
         int64_t end(sys::Duration(sys::EPOCH, sys::now()));
         double latency = double(end - start)/sys::TIME_MSEC;
-        if (latency > 0) {
-            total += latency;
-            if (latency < min) min = latency;
-            if (latency > max) max = latency;
-        }
+        if (latency > 0) sample(latency);
     }
 }
 
+void ThroughputAndLatency::sample(double latency) {
+    total += latency;
+    if (latency < min) min = latency;
+    if (latency > max) max = latency;
+}
+
 void ThroughputAndLatency::header(ostream& o) const {
     Throughput::header(o);
     o << '\t' << "l-min" << '\t' << "l-max" << '\t' << "l-avg";
@@ -87,20 +90,79 @@ void ThroughputAndLatency::report(ostream& o) const {
     }
 }
 
+namespace {
+// Histogram buckets cover 1 microsecond to over two minutes, each 1% wider than the last.
+const double BUCKET_BASE = 0.001;
+const double BUCKET_GROWTH = std::log(1.01);
+const size_t BUCKETS = 1900;
+}
+
+ThroughputAndPercentiles::ThroughputAndPercentiles() : buckets(BUCKETS), count(0) {}
+
+void ThroughputAndPercentiles::sample(double latency) {
+    ThroughputAndLatency::sample(latency);
+    double b = latency > BUCKET_BASE ? std::log(latency/BUCKET_BASE)/BUCKET_GROWTH : 0;
+    ++buckets[b < BUCKETS-1 ? size_t(b) : BUCKETS-1];
+    ++count;
+}
+
+double ThroughputAndPercentiles::percentile(double p) const {
+    if (!count) return 0;
+    uint64_t wanted = uint64_t(std::ceil(p*count));
+    if (wanted == 0) wanted = 1;
+    uint64_t seen = 0;
+    size_t i = 0;
+    for (; i < BUCKETS-1; ++i) {
+        seen += buckets[i];
+        if (seen >= wanted) break;
+    }
+    // Report the upper edge of the bucket
+    return BUCKET_BASE*std::exp((i+1)*BUCKET_GROWTH);
+}
+
+void ThroughputAndPercentiles::header(ostream& o) const {
+    ThroughputAndLatency::header(o);
+    o << '\t' << "l-p50" << '\t' << "l-p90" << '\t' << "l-p99" << '\t' << "l-p99.9";
+}
+
+void ThroughputAndPercentiles::report(ostream& o) const {
+    ThroughputAndLatency::report(o);
+    if (count) {
+        o << fixed << setprecision(2)
+          << '\t' << percentile(0.5) << '\t' << percentile(0.9)
+          << '\t' << percentile(0.99) << '\t' << percentile(0.999);
+    }
+}
+
 ReporterBase::ReporterBase(ostream& o, int batch, bool wantHeader)
-    : batchSize(batch), batchCount(0), headerPrinted(!wantHeader), out(o)
+    : batchSize(batch), batchCount(0), headerPrinted(!wantHeader), out(o),
+      interval(0), nextReport(sys::FAR_FUTURE)
 {}
 
+void ReporterBase::setInterval(sys::Duration i) {
+    interval = i;
+    nextReport = i ? sys::AbsTime(sys::now(), i) : sys::FAR_FUTURE;
+}
+
 ReporterBase::~ReporterBase() {}
 
 /** Count message in the statistics */
 void ReporterBase::message(const messaging::Message& m) {
     if (!overall.get()) overall = create();
     overall->message(m);
-    if (batchSize) {
+    if (batchSize || interval) {
         if (!batch.get()) batch = create();
         batch->message(m);
-        if (++batchCount == batchSize) {
+        ++batchCount;
+        bool due = batchCount == batchSize;
+        if (interval && !due) {
+            sys::AbsTime now = sys::now();
+            if (now > nextReport) {
+                due = true;
+                nextReport = sys::AbsTime(now, interval);
+            }
+        }
+        if (due) {
             header();
             batch->report(out);
             out << endl;
@@ -27,6 +27,7 @@
 #include <limits>
 #include <iosfwd>
 #include <memory>
+#include <vector>
 
 namespace qpid {
 
@@ -66,11 +67,37 @@ class ThroughputAndLatency : public Throughput {
     virtual void report(std::ostream&) const;
     virtual void header(std::ostream&) const;
 
+  protected:
+    /** Called for each positive latency, in milliseconds */
+    virtual void sample(double latency);
+
   private:
     double total, min, max;     // Milliseconds
     int samples;
 };
 
+/**
+ * Adds latency percentiles to ThroughputAndLatency. Latencies are kept
+ * in a histogram of logarithmic buckets 1% wide, so memory does not grow
+ * with the number of messages and percentiles are accurate to about 1%.
+ */
+class ThroughputAndPercentiles : public ThroughputAndLatency {
+  public:
+    ThroughputAndPercentiles();
+    virtual void report(std::ostream&) const;
+    virtual void header(std::ostream&) const;
+
+    /** Latency in milliseconds below which the fraction p of samples fall */
+    double percentile(double p) const;
+
+  protected:
+    virtual void sample(double latency);
+
+  private:
+    std::vector<uint32_t> buckets;
+    uint64_t count;
+};
+
 /** Report batch and overall statistics */
 class ReporterBase {
   public:
@@ -82,6 +109,12 @@ class ReporterBase {
     /** Print overall report. */
     void report();
 
+    /**
+     * Also print a batch report whenever this much time has passed since
+     * the last one, checked as messages are counted.
+     */
+    void setInterval(sys::Duration interval);
+
   protected:
     ReporterBase(std::ostream& o, int batchSize, bool wantHeader);
     virtual std::auto_ptr<Statistic> create() = 0;
@@ -94,6 +127,8 @@ class ReporterBase {
     int batchSize, batchCount;
     bool stopped, headerPrinted;
     std::ostream& out;
+    sys::Duration interval;
+    sys::AbsTime nextReport;
 };
 
 template <class Stats> class Reporter : public ReporterBase {
@@ -125,6 +125,42 @@ QPID_AUTO_TEST_CASE(testGeneral)
     dynamic_pointer_cast<TestTask>(task4)->check(2);
 }
 
+QPID_AUTO_TEST_CASE(testWheel)
+{
+    Counter counter;
+    // A small tick puts these tasks in the inner, outer and overflow levels
+    Timer timer(Timer::WHEEL, 100 * TIME_USEC);
+    intrusive_ptr<TestTask> task1(new TestTask(Duration(10 * TIME_MSEC), counter));
+    intrusive_ptr<TestTask> task2(new TestTask(Duration(500 * TIME_MSEC), counter));
+    intrusive_ptr<TestTask> task3(new TestTask(Duration(1 * TIME_SEC), counter));
+    intrusive_ptr<TestTask> task4(new TestTask(Duration(2 * TIME_SEC), counter));
+    intrusive_ptr<TestTask> cancelled(new TestTask(Duration(200 * TIME_MSEC), counter));
+
+    timer.add(task4);
+    timer.add(task3);
+    timer.add(cancelled);
+    timer.add(task2);
+    timer.add(task1);
+    cancelled->cancel();
+
+    task4->wait(Duration(4 * TIME_SEC));
+
+    task1->check(1, 100 * TIME_MSEC);
+    task2->check(2, 100 * TIME_MSEC);
+    task3->check(3, 100 * TIME_MSEC);
+    task4->check(4, 100 * TIME_MSEC);
+}
+
+QPID_AUTO_TEST_CASE(testCoarseNow)
+{
+    // The coarse clock is the same clock, behind by at most a tick
+    AbsTime before = AbsTime::now();
+    AbsTime coarse = AbsTime::coarseNow();
+    AbsTime after = AbsTime::now();
+    BOOST_CHECK(Duration(before, coarse) > -int64_t(50 * TIME_MSEC));
+    BOOST_CHECK(!(after < coarse));
+}
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
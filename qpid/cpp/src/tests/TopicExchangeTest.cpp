@@ -401,6 +401,22 @@ QPID_AUTO_TEST_CASE(testMultiple)
     }
 }
 
+QPID_AUTO_TEST_CASE(testMatchAgreesWithTree)
+{
+    const char* patterns[] = { "a.b.c", "a.*.c", "a.#", "#.a", "a.#.b.#.c", "*.#", "#", "*", "" };
+    const char* keys[] = { "a", "a.b", "a.b.c", "a.x.b.y.c", "x.y.a", "b.a.c", "", "." };
+    TopicExchange::TopicExchangeTester tt;
+    for (size_t p = 0; p < sizeof(patterns)/sizeof(patterns[0]); p++) {
+        string pattern(TopicExchange::normalize(patterns[p]));
+        BOOST_CHECK(tt.addBindingKey(pattern));
+        for (size_t k = 0; k < sizeof(keys)/sizeof(keys[0]); k++) {
+            BOOST_CHECK_MESSAGE(TopicExchange::match(pattern, keys[k]) == (match(tt, keys[k]) == 1),
+                                "pattern [" << pattern << "] key [" << keys[k] << "]");
+        }
+        BOOST_CHECK(tt.removeBindingKey(pattern));
+    }
+}
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
@@ -93,6 +93,21 @@ QPID_AUTO_TEST_CASE(testCommit)
     BOOST_CHECK_EQUAL(t.msg, t.queue2->get().payload);
 }
 
+QPID_AUTO_TEST_CASE(testQueuesByState)
+{
+    TxPublishTest t;
+
+    BOOST_CHECK_EQUAL((size_t) 2, t.op.getQueues().size());
+    BOOST_CHECK(t.op.getPrepared().empty());
+    t.op.prepare(0);
+    BOOST_CHECK(t.op.getQueues().empty());
+    BOOST_CHECK_EQUAL((size_t) 2, t.op.getPrepared().size());
+    BOOST_CHECK_EQUAL(t.queue1, t.op.getPrepared().front());
+    t.op.rollback();
+    BOOST_CHECK_EQUAL((uint32_t) 0, t.queue1->getMessageCount());
+    BOOST_CHECK_EQUAL((uint32_t) 0, t.queue2->getMessageCount());
+}
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
@@ -20,6 +20,9 @@
 #include "qpid/framing/Buffer.h"
 #include "qpid/types/Uuid.h"
 #include "qpid/sys/alloca.h"
+#include "qpid/sys/Runnable.h"
+#include "qpid/sys/Thread.h"
+#include "qpid/sys/UuidGenerator.h"
 
 #include "unit_test.h"
 
@@ -132,6 +135,31 @@ QPID_AUTO_TEST_CASE(testTypesUuid)
     BOOST_CHECK_EQUAL(a, b);
 }
 
+namespace {
+struct Generate : sys::Runnable {
+    boost::array<Uuid,1000> uuids;
+    void run() { for_each(uuids.begin(), uuids.end(), mem_fun_ref(&Uuid::generate)); }
+};
+}
+
+QPID_AUTO_TEST_CASE(testThreadLocalGenerator) {
+    sys::UuidGenerator::Kind previous = sys::UuidGenerator::selected();
+    sys::UuidGenerator::select(sys::UuidGenerator::THREAD_LOCAL);
+    Generate here, there;
+    sys::Thread thread(there);
+    here.run();
+    thread.join();
+    sys::UuidGenerator::select(previous);
+
+    UniqueSet unique;
+    for_each(here.uuids.begin(), here.uuids.end(), unique);
+    for_each(there.uuids.begin(), there.uuids.end(), unique);
+    for (size_t i = 0; i < here.uuids.size(); ++i) {
+        BOOST_CHECK_EQUAL(here.uuids[i][6] & 0xf0, 0x40);
+        BOOST_CHECK_EQUAL(here.uuids[i][8] & 0xc0, 0x80);
+    }
+}
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
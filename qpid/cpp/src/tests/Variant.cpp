@@ -21,6 +21,9 @@
 #include <iostream>
 #include "qpid/types/Variant.h"
 #include "qpid/amqp_0_10/Codecs.h"
+#include "qpid/amqp_0_10/MapView.h"
+#include "qpid/framing/Buffer.h"
+#include "qpid/framing/FieldTable.h"
 
 #include "unit_test.h"
 
@@ -770,6 +773,149 @@ QPID_AUTO_TEST_CASE(testBufferEncoding)
     BOOST_CHECK_THROW(MapCodec::encode(inMap, buffer), std::exception);
 }
 
+QPID_AUTO_TEST_CASE(testSwap)
+{
+    Variant a("abc");
+    Variant b = Variant::Map();
+    b.asMap()["x"] = 1;
+    a.swap(b);
+    BOOST_CHECK_EQUAL(VAR_MAP, a.getType());
+    BOOST_CHECK_EQUAL(1, a.asMap()["x"].asInt32());
+    BOOST_CHECK_EQUAL(std::string("abc"), b.asString());
+
+    Variant c;
+    a.swap(c);
+    BOOST_CHECK_EQUAL(VAR_VOID, a.getType());
+    BOOST_CHECK_EQUAL(VAR_MAP, c.getType());
+}
+
+QPID_AUTO_TEST_CASE(testNestedCodec)
+{
+    Variant::Map inMap, outMap;
+    Variant::List list;
+    list.push_back(Variant(1));
+    list.push_back(Variant("two"));
+    Variant::Map inner;
+    inner["list"] = list;
+    inner["value"] = 3.5;
+    inMap["inner"] = inner;
+    inMap["name"] = "outer";
+
+    std::string buffer;
+    MapCodec::encode(inMap, buffer);
+    MapCodec::decode(buffer, outMap);
+    BOOST_CHECK_EQUAL(inMap, outMap);
+
+    Variant::List outList;
+    ListCodec::encode(list, buffer);
+    ListCodec::decode(buffer, outList);
+    BOOST_CHECK_EQUAL(list.size(), outList.size());
+    BOOST_CHECK_EQUAL(1, outList.front().asInt32());
+    BOOST_CHECK_EQUAL(std::string("two"), outList.back().asString());
+}
+
+QPID_AUTO_TEST_CASE(testStreamEncodingMatchesFieldTable)
+{
+    Variant::Map inMap;
+    Variant::List list;
+    list.push_back(Variant(1));
+    list.push_back(Variant::Map());
+    inMap["list"] = list;
+    inMap["double"] = 1.25;
+    inMap["float"] = 2.5f;
+    inMap["uint64"] = (uint64_t) 7;
+    inMap["uuid"] = Uuid(true);
+    inMap["void"] = Variant();
+    Variant utf8("text");
+    utf8.setEncoding("utf8");
+    inMap["utf8"] = utf8;
+    inMap["large"] = std::string(70000, 'x');
+
+    std::string streamed;
+    MapCodec::encode(inMap, streamed);
+
+    qpid::framing::FieldTable ft;
+    translate(inMap, ft);
+    std::string expected(ft.encodedSize(), '\0');
+    qpid::framing::Buffer buffer(&expected[0], expected.size());
+    ft.encode(buffer);
+    BOOST_CHECK(streamed == expected);
+    BOOST_CHECK_EQUAL(streamed.size(), MapCodec::encodedSize(inMap));
+}
+
+namespace {
+struct PickKey : MapCodec::Visitor
+{
+    std::string key;
+    std::vector<std::string> seen;
+    Variant value;
+
+    PickKey(const std::string& k) : key(k) {}
+    bool wants(const std::string& k) { seen.push_back(k); return k == key; }
+    bool handle(const std::string&, const Variant& v) { value = v; return false; }
+};
+}
+
+QPID_AUTO_TEST_CASE(testMapVisitor)
+{
+    Variant::Map inMap;
+    inMap["a"] = 1;
+    inMap["b"] = "two";
+    inMap["c"] = 3;
+    std::string buffer;
+    MapCodec::encode(inMap, buffer);
+
+    PickKey visitor("b");
+    MapCodec::decode(buffer, visitor);
+    BOOST_CHECK_EQUAL(std::string("two"), visitor.value.asString());
+    // Decoding stops once the visitor has what it needs
+    BOOST_CHECK_EQUAL(2u, visitor.seen.size());
+
+    PickKey truncated("c");
+    BOOST_CHECK_THROW(MapCodec::decode(buffer.substr(0, buffer.size() - 2), truncated), qpid::Exception);
+}
+
+QPID_AUTO_TEST_CASE(testMapView)
+{
+    Variant::Map inner;
+    inner["x"] = 7;
+    Variant::Map inMap;
+    inMap["count"] = 3;
+    inMap["name"] = "plain";
+    inMap["nested"] = inner;
+    std::string buffer;
+    MapCodec::encode(inMap, buffer);
+
+    MapView map(buffer);
+    BOOST_CHECK_EQUAL(3u, map.count());
+
+    ValueView name;
+    BOOST_REQUIRE(map.find("name", name));
+    BOOST_CHECK(name.isString());
+    BOOST_CHECK_EQUAL(std::string("plain"), std::string(name.data(), name.size()));
+    // The view refers into the encoded map rather than a copy
+    BOOST_CHECK(name.data() > buffer.data() && name.data() < buffer.data() + buffer.size());
+
+    ValueView nested, x;
+    BOOST_REQUIRE(map.find("nested", nested));
+    BOOST_REQUIRE(nested.isMap());
+    BOOST_REQUIRE(nested.asMap().find("x", x));
+    BOOST_CHECK_EQUAL(7, x.toVariant().asInt32());
+    BOOST_CHECK_EQUAL(inner, nested.toVariant().asMap());
+
+    ValueView count;
+    BOOST_REQUIRE(map.find("count", count));
+    BOOST_CHECK(!count.isString());
+    BOOST_CHECK_THROW(count.asString(), qpid::Exception);
+    BOOST_CHECK(!map.find("missing", count));
+
+    size_t entries = 0;
+    for (MapView::Cursor i(map); i.next(); ++entries) {}
+    BOOST_CHECK_EQUAL(3u, entries);
+
+    BOOST_CHECK_THROW(MapView(buffer.substr(0, buffer.size() - 2)), qpid::Exception);
+}
+
 QPID_AUTO_TEST_SUITE_END()
 
 }} // namespace qpid::tests
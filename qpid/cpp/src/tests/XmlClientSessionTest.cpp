@@ -132,6 +132,76 @@ QPID_AUTO_TEST_CASE(testXmlBinding) {
     BOOST_CHECK_EQUAL(m, m2.getData());
 }
 
+QPID_AUTO_TEST_CASE(testXmlBindingResultCache) {
+    ClientSessionFixture f;
+
+    SubscriptionManager subscriptions(f.session);
+    SubscribedLocalQueue localQueue(subscriptions);
+
+    FieldTable args;
+    args.setInt("qpid.xml.result_cache", 2);
+    f.session.exchangeDeclare(qpid::client::arg::exchange="xml", qpid::client::arg::type="xml",
+                              qpid::client::arg::arguments=args);
+    f.session.queueDeclare(qpid::client::arg::queue="odd_blue");
+    subscriptions.subscribe(localQueue, "odd_blue");
+
+    FieldTable binding;
+    binding.setString("xquery", "declare variable $color external;"
+                      "(./message/id mod 2 = 1) and ($color = 'blue')");
+    f.session.exchangeBind(qpid::client::arg::exchange="xml", qpid::client::arg::queue="odd_blue", qpid::client::arg::bindingKey="query_name", qpid::client::arg::arguments=binding);
+
+    // Same content with different headers, and repeats of each, must
+    // give the same results as evaluating every time
+    const char* colors[] = { "blue", "red", "blue", "red", "green", "blue" };
+    for (int i = 0; i < 6; i++) {
+        Message message;
+        message.getDeliveryProperties().setRoutingKey("query_name");
+        message.getHeaders().setString("color", colors[i]);
+        message.setData("<message><id>1</id></message>");
+        f.session.messageTransfer(qpid::client::arg::content=message,  qpid::client::arg::destination="xml");
+    }
+    for (int i = 0; i < 3; i++) {
+        Message m = localQueue.get(1*qpid::sys::TIME_SEC);
+        BOOST_CHECK_EQUAL(m.getHeaders().getAsString("color"), "blue");
+    }
+    Message m;
+    BOOST_CHECK(!static_cast<LocalQueue&>(localQueue).get(m, 0));
+}
+
+QPID_AUTO_TEST_CASE(testXmlBindingPrefilter) {
+    ClientSessionFixture f;
+
+    SubscriptionManager subscriptions(f.session);
+    SubscribedLocalQueue localQueue(subscriptions);
+
+    f.session.exchangeDeclare(qpid::client::arg::exchange="xml", qpid::client::arg::type="xml");
+    f.session.queueDeclare(qpid::client::arg::queue="blue_orders");
+    subscriptions.subscribe(localQueue, "blue_orders");
+
+    FieldTable binding;
+    binding.setString("xquery", "true()");
+    binding.setString("qpid.xml.root_element", "order");
+    binding.setString("qpid.xml.header.color", "blue");
+    f.session.exchangeBind(qpid::client::arg::exchange="xml", qpid::client::arg::queue="blue_orders", qpid::client::arg::bindingKey="query_name", qpid::client::arg::arguments=binding);
+
+    const char* colors[] = { "blue", "blue", "red", "blue" };
+    const char* contents[] = { "<?xml version='1.0'?><!-- first --><order id='1'/>",
+                               "<invoice><order/></invoice>",
+                               "<order id='3'/>",
+                               "<ns:order xmlns:ns='urn:x' id='4'/>" };
+    for (int i = 0; i < 4; i++) {
+        Message message;
+        message.getDeliveryProperties().setRoutingKey("query_name");
+        message.getHeaders().setString("color", colors[i]);
+        message.setData(contents[i]);
+        f.session.messageTransfer(qpid::client::arg::content=message,  qpid::client::arg::destination="xml");
+    }
+    BOOST_CHECK_EQUAL(localQueue.get(1*qpid::sys::TIME_SEC).getData(), contents[0]);
+    BOOST_CHECK_EQUAL(localQueue.get(1*qpid::sys::TIME_SEC).getData(), contents[3]);
+    Message m;
+    BOOST_CHECK(!static_cast<LocalQueue&>(localQueue).get(m, 0));
+}
+
 /**
  * Ensure that multiple queues can be bound using the same routing key
  */
@@ -259,6 +259,8 @@ class Broker(Popen):
         self._port=port
         if BrokerTest.store_lib:
             args = args + ['--load-module', BrokerTest.store_lib]
+            if BrokerTest.store_provider:
+                args = args + ['--storage-provider', BrokerTest.store_provider]
             if BrokerTest.sql_store_lib:
                 args = args + ['--load-module', BrokerTest.sql_store_lib]
                 args = args + ['--catalog', BrokerTest.sql_catalog]
@@ -449,6 +451,7 @@ class BrokerTest(TestCase):
     sql_clfs_store_lib = os.getenv("STORE_SQL_CLFS_LIB")
     sql_catalog = os.getenv("STORE_CATALOG")
     store_lib = os.getenv("STORE_LIB")
+    store_provider = os.getenv("STORE_PROVIDER")
     test_store_lib = os.getenv("TEST_STORE_LIB")
     rootdir = os.getcwd()
 
@@ -0,0 +1,108 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+/**
+ * Measures the rate at which the method frames that make up most
+ * AMQP 0-10 traffic are encoded and decoded, as on a connection's
+ * read and write paths.
+ */
+
+#include <iostream>
+#include <vector>
+#include "qpid/framing/AMQFrame.h"
+#include "qpid/framing/Buffer.h"
+#include "qpid/framing/MessageAcceptBody.h"
+#include "qpid/framing/MessageFlowBody.h"
+#include "qpid/framing/MessageTransferBody.h"
+#include "qpid/framing/SessionCompletedBody.h"
+#include "qpid/sys/Time.h"
+#include "BenchOptions.h"
+
+namespace qpid {
+namespace tests {
+
+using namespace qpid::framing;
+using qpid::sys::AbsTime;
+using qpid::sys::Duration;
+
+struct Args : public BenchOptions
+{
+    uint count;
+
+    Args() : BenchOptions("Frame encode/decode benchmark"), count(1000000)
+    {
+        addOptions()
+            ("count", qpid::optValue(count, "N"), "number of frames to encode and decode for each method");
+    }
+};
+
+double rate(uint count, const AbsTime& start)
+{
+    Duration elapsed(start, AbsTime::now());
+    return double(count) * qpid::sys::TIME_SEC / elapsed;
+}
+
+void measure(const std::string& name, const AMQFrame& frame, uint count)
+{
+    // Encode a batch of frames into one buffer at a time, as a
+    // connection fills its write buffer
+    const uint batch = 64;
+    std::vector<char> bytes(frame.encodedSize() * batch);
+    AbsTime start = AbsTime::now();
+    for (uint i = 0; i < count; i += batch) {
+        Buffer buffer(&bytes[0], bytes.size());
+        for (uint j = 0; j < batch; ++j) frame.encode(buffer);
+    }
+    double encodes = rate(count, start);
+
+    AMQFrame decoded;
+    start = AbsTime::now();
+    for (uint i = 0; i < count; i += batch) {
+        Buffer buffer(&bytes[0], bytes.size());
+        for (uint j = 0; j < batch; ++j) decoded.decode(buffer);
+    }
+    double decodes = rate(count, start);
+    std::cout << name << ": " << uint64_t(encodes) << " encodes/s, "
+              << uint64_t(decodes) << " decodes/s" << std::endl;
+}
+
+}} // namespace qpid::tests
+
+using namespace qpid::tests;
+
+int main(int argc, char** argv)
+{
+    Args opts;
+    if (opts.parse(argc, argv)) {
+        SequenceSet commands;
+        commands.add(SequenceNumber(100), SequenceNumber(163));
+
+        AMQFrame transfer((MessageTransferBody(ProtocolVersion(), "amq.direct", 0, 0)));
+        transfer.setEof(false);
+        measure("message.transfer", transfer, opts.count);
+        measure("message.flow", AMQFrame(MessageFlowBody(ProtocolVersion(), "consumer", 0, 1)), opts.count);
+        measure("message.accept", AMQFrame(MessageAcceptBody(ProtocolVersion(), commands)), opts.count);
+        measure("session.completed", AMQFrame(SessionCompletedBody(ProtocolVersion(), commands, false)), opts.count);
+        return 0;
+    } else {
+        return 1;
+    }
+}
@@ -160,6 +160,27 @@ QPID_AUTO_TEST_CASE(testMacro) {
     BOOST_CHECK_EQUAL(expect, out->msg);
 }
 
+QPID_AUTO_TEST_CASE(testObjectMacro) {
+    Logger& l=Logger::instance();
+    ScopedSuppressLogging ls(l);
+    l.select(Selector(info));
+    l.selectObjects(Selector(debug), list_of<string>("q1"));
+    TestOutput* out=new TestOutput(l);
+    for (int i = 0; i < 2; ++i) {
+        string name = i ? "q2" : "q1";
+        QPID_LOG_FOR(debug, name, "debug " << name);
+        QPID_LOG_FOR(info, name, "info " << name);
+    }
+    vector<string> expect=list_of("debug q1\n")("info q1\n")("info q2\n");
+    BOOST_CHECK_EQUAL(expect, out->msg);
+    BOOST_CHECK(l.isSelected("q1"));
+    BOOST_CHECK(!l.isSelected("q2"));
+
+    // Plain statements are not enabled by object selection.
+    QPID_LOG(debug, "bar");
+    BOOST_CHECK_EQUAL(expect, out->msg);
+}
+
 QPID_AUTO_TEST_CASE(testLoggerFormat) {
     Logger& l = Logger::instance();
     ScopedSuppressLogging ls(l);
@@ -328,6 +349,38 @@ QPID_AUTO_TEST_CASE(testSelectorFromOptions) {
     BOOST_CHECK(s.isEnabled(critical, "foo"));
 }
 
+struct SharedOutput : public Logger::Output {
+    vector<string>& msg;
+    SharedOutput(vector<string>& m) : msg(m) {}
+    void log(const Statement&, const string& m) { msg.push_back(m); }
+};
+
+QPID_AUTO_TEST_CASE(testAsyncOutput) {
+    Logger l;
+    qpid::log::Options opts("test");
+    const char* argv[]={
+        0,
+        "--log-time", "no",
+        "--log-level", "no",
+        "--log-to-stderr", "no",
+        "--log-async", "yes",
+        "--log-async-block", "yes"
+    };
+    opts.parse(ARGC(argv), const_cast<char**>(argv));
+    l.configure(opts);
+    vector<string> written;
+    l.output(std::auto_ptr<Logger::Output>(new SharedOutput(written)));
+    Statement s=QPID_LOG_STATEMENT_INIT(critical);
+    l.log(s, "foo");
+    l.log(s, "bar");
+    // Reconfiguring stops the writer after it has written everything queued.
+    opts.async = false;
+    l.configure(opts);
+    vector<string> expect=list_of("foo\n")("bar\n");
+    BOOST_CHECK_EQUAL(expect, written);
+    BOOST_CHECK_EQUAL(0u, l.getDropped());
+}
+
 QPID_AUTO_TEST_CASE(testLoggerStateure) {
     Logger& l=Logger::instance();
     ScopedSuppressLogging ls(l);
@@ -0,0 +1,88 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+/**
+ * Reports the heap allocations made per message when encoded transfers
+ * are decoded and assembled by a MessageBuilder, as on the broker's
+ * inbound path. Compare builds with and without the message pool.
+ */
+
+#include <iostream>
+#include <vector>
+#include "qpid/broker/Message.h"
+#include "qpid/broker/MessageBuilder.h"
+#include "BenchOptions.h"
+#include "HeapCounter.h"
+#include "MessageUtils.h"
+
+namespace qpid {
+namespace tests {
+
+using namespace qpid::framing;
+
+struct Args : public BenchOptions
+{
+    uint count;
+    uint size;
+
+    Args() : BenchOptions("Message allocation benchmark"), count(100000), size(64)
+    {
+        addOptions()
+            ("count", qpid::optValue(count, "N"), "number of messages to build")
+            ("size", qpid::optValue(size, "N"), "size of message content");
+    }
+};
+
+void build(broker::MessageBuilder& builder, std::vector<char>& encoded, uint count)
+{
+    for (uint i = 0; i < count; ++i) {
+        builder.start(SequenceNumber(i));
+        Buffer buffer(&encoded[0], encoded.size());
+        while (buffer.available()) {
+            AMQFrame frame;
+            frame.decode(buffer);
+            builder.handle(frame);
+        }
+        boost::intrusive_ptr<broker::Message> message = builder.getMessage();
+    }
+}
+
+}} // namespace qpid::tests
+
+using namespace qpid::tests;
+
+int main(int argc, char** argv)
+{
+    Args opts;
+    if (opts.parse(argc, argv)) {
+        std::vector<char> encoded = MessageUtils::encodeTransfer(opts.size);
+        qpid::broker::MessageBuilder builder(0);
+        // Warm up so that any pools have reached a steady state
+        build(builder, encoded, 1000);
+        size_t before = heap::allocations;
+        build(builder, encoded, opts.count);
+        std::cout << double(heap::allocations - before) / opts.count
+                  << " allocations per message" << std::endl;
+        return 0;
+    } else {
+        return 1;
+    }
+}
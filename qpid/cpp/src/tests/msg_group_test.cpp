@@ -61,6 +61,7 @@ struct Options : public qpid::Options
     uint receivers;
     uint groupSize;
     bool printReport;
+    bool printRate;
     std::string groupKey;
     bool durable;
     bool allowDuplicates;
@@ -84,6 +85,7 @@ struct Options : public qpid::Options
           receivers(2),
           groupSize(10),
           printReport(false),
+          printRate(false),
           groupKey("qpid.no_group"),
           durable(false),
           allowDuplicates(false),
@@ -114,6 +116,7 @@ struct Options : public qpid::Options
           ("sticky-consumers", qpid::optValue(stickyConsumer), "If set, verify that all messages in a group are consumed by the same client [TBD].")
           ("timeout", qpid::optValue(timeout, "N"), "Fail with a stall error should all consumers remain idle for timeout seconds.")
           ("print-report", qpid::optValue(printReport), "Dump message group statistics to stdout.")
+          ("print-rate", qpid::optValue(printRate), "Print the overall consume rate to stdout, for use as a benchmark (e.g. with --interleave to keep many groups active).")
           ("help", qpid::optValue(help), "print this usage statement");
         add(log);
         //("check-redelivered", qpid::optValue(checkRedelivered), "Fails with exception if a duplicate is not marked as redelivered (only relevant when ignore-duplicates is selected)")
@@ -128,8 +131,7 @@ struct Options : public qpid::Options
             if (address.empty()) throw qpid::Exception("Address must be specified!");
             qpid::log::Logger::instance().configure(log);
             if (help) {
-                std::ostringstream msg;
-                std::cout << msg << *this << std::endl << std::endl
+                std::cout << *this << std::endl << std::endl
                           << "Verifies the behavior of grouped messages." << std::endl;
                 return false;
             } else {
@@ -536,6 +538,7 @@ int main(int argc, char ** argv)
             GroupChecker state( opts.senders * opts.messages,
                                 opts.allowDuplicates);
             std::vector<Client::shared_ptr> clients;
+            qpid::sys::AbsTime start = qpid::sys::now();
 
             if (opts.randomizeSize) srand((unsigned int)qpid::sys::SystemInfo::getProcessId());
 
@@ -607,6 +610,11 @@ int main(int argc, char ** argv)
             }
 
             if (opts.printReport && !status) state.print(std::cout);
+            if (opts.printRate && !status) {
+                double secs = qpid::sys::Duration(start, qpid::sys::now()) / double(qpid::sys::TIME_SEC);
+                std::cout << state.getConsumedTotal() << " messages consumed in " << secs << " secs ("
+                          << state.getConsumedTotal() / secs << " msgs/sec)" << std::endl;
+            }
         } else status = 4;
     } catch(const std::exception& error) {
         QPID_LOG(error, argv[0] << ": " << error.what());
@@ -0,0 +1,414 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+/**
+ * Benchmark driver for one or more brokers, optionally clustered.
+ *
+ * Starts --brokers brokers with ForkedBroker (or uses the broker
+ * given by the connection options if --brokers=0), runs one load
+ * profile with clients spread over the brokers, and writes a JSON
+ * report of throughput, latency percentiles and broker CPU and
+ * memory use, so runs can be compared between releases.
+ */
+
+#include "TestOptions.h"
+#include "ForkedBroker.h"
+#include "qpid/client/Connection.h"
+#include "qpid/client/Message.h"
+#include "qpid/client/AsyncSession.h"
+#include "qpid/client/SubscriptionManager.h"
+#include "qpid/framing/Uuid.h"
+#include "qpid/sys/Mutex.h"
+#include "qpid/sys/Runnable.h"
+#include "qpid/sys/Thread.h"
+#include "qpid/sys/Time.h"
+
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+
+using namespace qpid;
+using namespace qpid::client;
+using namespace qpid::sys;
+using std::string;
+using std::vector;
+
+namespace qpid {
+namespace tests {
+
+struct Args : public qpid::TestOptions {
+    uint brokers;
+    bool cluster;
+    string profile;
+    uint messages;
+    uint size;
+    uint producers;
+    uint consumers;
+    uint txSize;
+    uint ackFrequency;
+    uint idleSecs;
+    vector<string> brokerArgs;
+    string report;
+
+    Args() : TestOptions(
+        "Profiles:\n"
+        "  fanout: every consumer gets every message, through a fanout exchange.\n"
+        "  shared: consumers compete for messages on one queue.\n"
+        "  durable: shared, with a durable queue and persistent messages.\n"
+        "  tx: shared, with producers publishing in transactions of --tx-size.\n"
+        "  large: shared, with 256KB messages unless --size is given.\n"
+        "\n"
+        "Brokers are started with $QPIDD_EXEC, with $CLUSTER_LIB for --cluster\n"
+        "and with $STORE_LIB for the durable profile."),
+             brokers(1), cluster(false), profile("shared"), messages(10000), size(0),
+             producers(1), consumers(1), txSize(10), ackFrequency(100), idleSecs(10)
+    {
+        addOptions()
+            ("brokers", optValue(brokers, "N"), "Start N brokers. 0 uses the broker given by --host and --port.")
+            ("cluster", optValue(cluster, "yes|no"), "Form the started brokers into a cluster.")
+            ("profile", optValue(profile, "NAME"), "Load profile: fanout, shared, durable, tx or large.")
+            ("messages", optValue(messages, "N"), "Messages sent by each producer.")
+            ("size", optValue(size, "BYTES"), "Message size, at least 8. Default 1024, or 256KB for large.")
+            ("producers", optValue(producers, "N"), "Number of producers.")
+            ("consumers", optValue(consumers, "N"), "Number of consumers.")
+            ("tx-size", optValue(txSize, "N"), "Messages per transaction for the tx profile.")
+            ("ack-frequency", optValue(ackFrequency, "N"), "Consumers accept every N messages.")
+            ("idle", optValue(idleSecs, "SECONDS"), "Give up when no message arrives for this long.")
+            ("broker-arg", optValue(brokerArgs, "ARG"), "Extra argument for started brokers, may be repeated.")
+            ("report", optValue(report, "FILE"), "Write the report to FILE rather than standard output.");
+    }
+
+    bool fanout() const { return profile == "fanout"; }
+    bool durable() const { return profile == "durable"; }
+    bool tx() const { return profile == "tx"; }
+};
+
+Args opts;
+
+const string QUEUE("qpid-cluster-bench");
+const string EXCHANGE("qpid-cluster-bench-fanout");
+
+int64_t nowNs() { return Duration(EPOCH, now()); }
+
+// Received counts and latencies shared by the consumers
+struct Results {
+    Mutex lock;
+    uint64_t received;
+    vector<int64_t> latencies;
+    AbsTime firstSent, lastReceived;
+
+    Results() : received(0), firstSent(FAR_FUTURE), lastReceived(EPOCH) {}
+
+    void add(const vector<int64_t>& l, const AbsTime& last) {
+        Mutex::ScopedLock ll(lock);
+        received += l.size();
+        latencies.insert(latencies.end(), l.begin(), l.end());
+        if (last > lastReceived) lastReceived = last;
+    }
+
+    void sent(const AbsTime& t) {
+        Mutex::ScopedLock l(lock);
+        if (t < firstSent) firstSent = t;
+    }
+};
+
+Results results;
+
+struct Client : public Runnable {
+    Connection connection;
+    AsyncSession session;
+    Thread thread;
+    bool failed;
+
+    Client(uint16_t port) : failed(false) {
+        ConnectionSettings settings(opts.con);
+        if (port) settings.port = port;
+        connection.open(settings);
+        session = connection.newSession();
+    }
+
+    virtual ~Client() {
+        try {
+            session.close();
+            connection.close();
+        } catch (const std::exception&) {}
+    }
+
+    void start() { thread = Thread(*this); }
+    void join() { thread.join(); }
+
+    void run() {
+        try { work(); }
+        catch (const std::exception& e) {
+            std::cerr << "qpid-cluster-bench: client failed: " << e.what() << std::endl;
+            failed = true;
+        }
+    }
+
+    virtual void work() = 0;
+};
+
+struct Producer : public Client {
+    uint count;
+
+    Producer(uint16_t port, uint n) : Client(port), count(n) {}
+
+    void work() {
+        Message msg(string(opts.size, 'X'), opts.fanout() ? string() : QUEUE);
+        if (opts.durable()) msg.getDeliveryProperties().setDeliveryMode(framing::PERSISTENT);
+        string dest = opts.fanout() ? EXCHANGE : string();
+        if (opts.tx()) sync(session).txSelect();
+        results.sent(now());
+        for (uint i = 0; i < count; ++i) {
+            // Stamp the send time into the data, the data is not copied.
+            int64_t t = nowNs();
+            const_cast<std::string&>(msg.getData()).replace(0, sizeof(t),
+                                      reinterpret_cast<const char*>(&t), sizeof(t));
+            session.messageTransfer(arg::destination=dest, arg::content=msg, arg::acceptMode=1);
+            if (opts.tx() && (i+1) % opts.txSize == 0) sync(session).txCommit();
+        }
+        if (opts.tx()) sync(session).txCommit();
+        session.sync();
+    }
+};
+
+struct Consumer : public Client {
+    string queue;
+    uint64_t expected;          // For fanout; shared consumers stop on the total.
+    uint64_t total;
+
+    Consumer(uint16_t port, const string& q, uint64_t e, uint64_t t)
+        : Client(port), queue(q), expected(e), total(t) {}
+
+    bool done(uint64_t n) {
+        if (opts.fanout()) return n >= expected;
+        Mutex::ScopedLock l(results.lock);
+        return results.received + n >= total;
+    }
+
+    void work() {
+        SubscriptionManager subs(session);
+        SubscriptionSettings settings;
+        settings.autoAck = opts.ackFrequency;
+        settings.flowControl = FlowControl::messageWindow(1000);
+        LocalQueue lq;
+        Subscription subscription = subs.subscribe(lq, queue, settings);
+        vector<int64_t> latencies;
+        Message msg;
+        AbsTime last = EPOCH;
+        // Report in batches so the shared total stays cheap to check
+        const size_t BATCH = 100;
+        AbsTime idleSince = now();
+        while (!done(latencies.size())) {
+            if (!lq.get(msg, TIME_SEC)) {
+                if (Duration(idleSince, now()) > int64_t(opts.idleSecs*TIME_SEC)) break;
+                continue;
+            }
+            idleSince = last = now();
+            int64_t sent;
+            ::memcpy(&sent, msg.getData().data(), sizeof(sent));
+            latencies.push_back(Duration(EPOCH, last) - sent);
+            if (!opts.fanout() && latencies.size() >= BATCH) {
+                results.add(latencies, last);
+                latencies.clear();
+            }
+        }
+        subscription.accept(subscription.getUnaccepted());
+        session.sync();
+        results.add(latencies, last);
+    }
+};
+
+// Broker CPU seconds and resident memory, from /proc
+struct ProcessStats {
+    double cpuSecs;
+    long rssKb;
+    ProcessStats(pid_t pid) : cpuSecs(0), rssKb(0) {
+        std::ostringstream path;
+        path << "/proc/" << pid << "/stat";
+        std::ifstream stat(path.str().c_str());
+        string field;
+        unsigned long utime = 0, stime = 0;
+        long rss = 0;
+        // Skip pid, comm and the 11 fields before utime.
+        for (int i = 0; i < 13 && stat >> field; ++i)
+            ;
+        stat >> utime >> stime;
+        for (int i = 0; i < 8 && stat >> field; ++i)
+            ;
+        stat >> rss;
+        cpuSecs = double(utime + stime)/::sysconf(_SC_CLK_TCK);
+        rssKb = rss * (::sysconf(_SC_PAGESIZE)/1024);
+    }
+};
+
+int64_t percentile(const vector<int64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t i = size_t(p * (sorted.size() - 1));
+    return sorted[i];
+}
+
+void writeReport(std::ostream& out, double secs, uint64_t sent,
+                 boost::ptr_vector<ForkedBroker>& brokers)
+{
+    vector<int64_t>& l = results.latencies;
+    std::sort(l.begin(), l.end());
+    out << "{\"profile\": \"" << opts.profile << "\""
+        << ", \"brokers\": " << (brokers.empty() ? 1 : brokers.size())
+        << ", \"cluster\": " << (opts.cluster ? "true" : "false")
+        << ", \"producers\": " << opts.producers
+        << ", \"consumers\": " << opts.consumers
+        << ", \"size\": " << opts.size
+        << ", \"sent\": " << sent
+        << ", \"received\": " << results.received
+        << ", \"seconds\": " << secs
+        << ", \"throughput\": " << (secs > 0 ? results.received/secs : 0)
+        << ", \"latency_us\": {"
+        << "\"p50\": " << percentile(l, 0.5)/TIME_USEC
+        << ", \"p90\": " << percentile(l, 0.9)/TIME_USEC
+        << ", \"p99\": " << percentile(l, 0.99)/TIME_USEC
+        << ", \"max\": " << (l.empty() ? 0 : l.back()/TIME_USEC)
+        << "}";
+    out << ", \"broker_cpu_seconds\": [";
+    for (size_t i = 0; i < brokers.size(); ++i)
+        out << (i ? ", " : "") << ProcessStats(brokers[i].getPID()).cpuSecs;
+    out << "], \"broker_rss_kb\": [";
+    for (size_t i = 0; i < brokers.size(); ++i)
+        out << (i ? ", " : "") << ProcessStats(brokers[i].getPID()).rssKb;
+    out << "]}" << std::endl;
+}
+
+ForkedBroker::Args brokerArgs(const string& clusterName) {
+    ForkedBroker::Args args;
+    args.push_back("--auth=no");
+    args.push_back("--no-module-dir");
+    if (opts.cluster) {
+        const char* lib = std::getenv("CLUSTER_LIB");
+        if (!lib) throw Exception("Set CLUSTER_LIB to use --cluster");
+        args.push_back("--load-module");
+        args.push_back(lib);
+        args.push_back("--cluster-name");
+        args.push_back(clusterName);
+    }
+    if (opts.durable()) {
+        const char* lib = std::getenv("STORE_LIB");
+        if (lib) {
+            args.push_back("--load-module");
+            args.push_back(lib);
+            args.push_back("TMP_DATA_DIR");
+        }
+        else
+            std::cerr << "qpid-cluster-bench: STORE_LIB not set, durable profile has no store" << std::endl;
+    }
+    args.insert(args.end(), opts.brokerArgs.begin(), opts.brokerArgs.end());
+    return args;
+}
+
+}} // namespace qpid::tests
+
+using namespace qpid::tests;
+
+int main(int argc, char** argv) {
+    try {
+        opts.parse(argc, argv);
+        if (opts.profile != "fanout" && opts.profile != "shared" && opts.profile != "durable"
+            && opts.profile != "tx" && opts.profile != "large")
+            throw Exception("Unknown profile: " + opts.profile);
+        if (!opts.size) opts.size = opts.profile == "large" ? 256*1024 : 1024;
+        opts.size = std::max(opts.size, uint(sizeof(int64_t)));
+        if (!opts.txSize) opts.txSize = 1;
+
+        boost::ptr_vector<ForkedBroker> brokers;
+        string clusterName = framing::Uuid(true).str();
+        for (uint i = 0; i < opts.brokers; ++i)
+            brokers.push_back(new ForkedBroker(brokerArgs(clusterName)));
+        vector<uint16_t> ports;
+        for (size_t i = 0; i < brokers.size(); ++i) ports.push_back(brokers[i].getPort());
+        if (ports.empty()) ports.push_back(0);
+
+        // Declare the queues, one per consumer for fanout.
+        uint64_t sent = uint64_t(opts.messages) * opts.producers;
+        boost::ptr_vector<Client> consumers;
+        {
+            Connection c;
+            ConnectionSettings settings(opts.con);
+            if (ports[0]) settings.port = ports[0];
+            c.open(settings);
+            Session s = c.newSession();
+            if (opts.fanout())
+                s.exchangeDeclare(arg::exchange=EXCHANGE, arg::type="fanout");
+            for (uint i = 0; i < opts.consumers; ++i) {
+                std::ostringstream name;
+                name << QUEUE;
+                if (opts.fanout()) name << "-" << i;
+                if (i == 0 || opts.fanout()) {
+                    s.queueDeclare(arg::queue=name.str(), arg::durable=opts.durable(),
+                                   arg::autoDelete=false);
+                    s.queuePurge(arg::queue=name.str());
+                    if (opts.fanout())
+                        s.exchangeBind(arg::exchange=EXCHANGE, arg::queue=name.str());
+                }
+                consumers.push_back(new Consumer(ports[i % ports.size()], name.str(), sent,
+                                                 opts.fanout() ? sent*opts.consumers : sent));
+            }
+            s.close();
+            c.close();
+        }
+        for (size_t i = 0; i < consumers.size(); ++i) consumers[i].start();
+
+        boost::ptr_vector<Client> producers;
+        for (uint i = 0; i < opts.producers; ++i)
+            producers.push_back(new Producer(ports[(i + opts.consumers) % ports.size()], opts.messages));
+        for (size_t i = 0; i < producers.size(); ++i) producers[i].start();
+
+        bool failed = false;
+        for (size_t i = 0; i < producers.size(); ++i) {
+            producers[i].join();
+            failed = failed || producers[i].failed;
+        }
+        for (size_t i = 0; i < consumers.size(); ++i) {
+            consumers[i].join();
+            failed = failed || consumers[i].failed;
+        }
+        double secs = double(Duration(results.firstSent, results.lastReceived))/TIME_SEC;
+        if (opts.fanout()) sent *= opts.consumers;
+
+        if (opts.report.empty())
+            writeReport(std::cout, secs, sent, brokers);
+        else {
+            std::ofstream out(opts.report.c_str());
+            writeReport(out, secs, sent, brokers);
+        }
+        producers.clear();
+        consumers.clear();
+        return (failed || results.received < sent) ? 1 : 0;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "qpid-cluster-bench: " << e.what() << std::endl;
+        return 1;
+    }
+}
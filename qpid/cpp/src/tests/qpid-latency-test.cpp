@@ -28,12 +28,15 @@
 #include <vector>
 
 #include "TestOptions.h"
+#include "qpid/Exception.h"
+#include "qpid/sys/LatencyHistogram.h"
 #include "qpid/sys/Thread.h"
 #include "qpid/client/Connection.h"
 #include "qpid/client/Message.h"
 #include "qpid/client/AsyncSession.h"
 #include "qpid/client/SubscriptionManager.h"
 #include "qpid/sys/Time.h"
+#include <boost/scoped_ptr.hpp>
 
 using namespace qpid;
 using namespace qpid::client;
@@ -57,13 +60,15 @@ struct Args : public qpid::TestOptions {
     uint ack;
     bool cumulative;
     bool csv;
+    bool json;
+    bool openLoop;
     bool durable;
     string base;
     bool singleConnect;
 
     Args() : size(256), count(1000), rate(0), reportFrequency(1000),
 	     timeLimit(0), concurrentConnections(1),
-             prefetch(100), ack(0),
+             prefetch(100), ack(0), json(false), openLoop(false),
              durable(false), base("latency-test"), singleConnect(false)
 
     {
@@ -75,6 +80,9 @@ struct Args : public qpid::TestOptions {
             ("single-connection", optValue(singleConnect, "yes|no"), "Use one connection for multiple sessions.")
             ("count", optValue(count, "N"), "number of messages to send")
             ("rate", optValue(rate, "N"), "target message rate (causes count to be ignored)")
+            ("open-loop", optValue(openLoop),
+             "with --rate, time each message from when it was due to be sent rather than from when it was, "
+             "so that a sender held up by the broker shows as latency")
             ("sync", optValue(sync), "send messages synchronously")
             ("report-frequency", optValue(reportFrequency, "N"),
              "number of milliseconds to wait between reports (ignored unless rate specified)")
@@ -83,7 +91,8 @@ struct Args : public qpid::TestOptions {
             ("prefetch", optValue(prefetch, "N"), "prefetch count (0 implies no flow control, and no acking)")
             ("ack", optValue(ack, "N"), "Ack frequency in messages (defaults to half the prefetch value)")
             ("durable", optValue(durable, "yes|no"), "use durable messages")
-            ("csv", optValue(csv), "print stats in csv format (rate,min,max,avg)")
+            ("csv", optValue(csv), "print stats in csv format (rate,min,max,avg,p50,p99,p99.9,p99.99)")
+            ("json", optValue(json), "print stats as one JSON object per line")
             ("cumulative", optValue(cumulative), "cumulative stats in csv format")
             ("queue-base-name", optValue(base, "<name>"), "base name for queues");
     }
@@ -94,6 +103,22 @@ const std::string chars("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ");
 Args opts;
 double c_min, c_avg, c_max;
 Connection globalConnection;
+sys::LatencyHistogram allStreams;
+
+const double PERCENTILES[] = { 0.5, 0.99, 0.999, 0.9999 };
+const char* PERCENTILE_NAMES[] = { "p50", "p99", "p99.9", "p99.99" };
+const size_t NUM_PERCENTILES = sizeof(PERCENTILES)/sizeof(PERCENTILES[0]);
+
+// Print the percentiles of latencies in h in ms, in the output format chosen
+void printPercentiles(const sys::LatencyHistogram& h)
+{
+    for (size_t i = 0; i < NUM_PERCENTILES; ++i) {
+        double ms = double(h.percentile(PERCENTILES[i])) / 1000;
+        if (opts.json) std::cout << ", \"" << PERCENTILE_NAMES[i] << "\": " << ms;
+        else if (opts.csv) std::cout << "," << ms;
+        else std::cout << ", " << PERCENTILE_NAMES[i] << "=" << ms;
+    }
+}
 
 uint64_t current_time()
 {
@@ -108,9 +133,11 @@ struct Stats
     double minLatency;
     double maxLatency;
     double totalLatency;
+    boost::scoped_ptr<sys::LatencyHistogram> interval;
+    sys::LatencyHistogram overall;
 
     Stats();
-    void update(double l);
+    void update(int64_t latencyNs);
     void print();
     void reset();
 };
@@ -253,23 +280,28 @@ void Receiver::received(Message& msg)
     uint64_t receivedAt = current_time();
     uint64_t sentAt = msg.getDeliveryProperties().getTimestamp();
 
-    stats.update(((double) (receivedAt - sentAt)) / TIME_MSEC);
+    stats.update(int64_t(receivedAt - sentAt));
 
     if (!opts.rate && count >= opts.count) {
         mgr.stop();
     }
 }
 
-void Stats::update(double latency)
+void Stats::update(int64_t latencyNs)
 {
+    double latency = double(latencyNs) / TIME_MSEC;
+    allStreams.record(latencyNs);
     Mutex::ScopedLock l(lock);
+    interval->record(latencyNs);
+    overall.record(latencyNs);
     count++;
     minLatency = std::min(minLatency, latency);
     maxLatency = std::max(maxLatency, latency);
     totalLatency += latency;
 }
 
-Stats::Stats() : count(0), minLatency(std::numeric_limits<double>::max()), maxLatency(0), totalLatency(0) {}
+Stats::Stats() : count(0), minLatency(std::numeric_limits<double>::max()), maxLatency(0), totalLatency(0),
+                 interval(new sys::LatencyHistogram) {}
 
 void Stats::print()
 {
@@ -282,11 +314,26 @@ void Stats::print()
         value = opts.count;
     Mutex::ScopedLock l(lock);
     double aux_avg = (totalLatency / count);
-    if (!opts.cumulative) {
+    if (opts.json) {
+        const sys::LatencyHistogram& h = opts.cumulative ? overall : *interval;
+        std::cout << "{\"" << (opts.rate ? "rate" : "count") << "\": " << value;
+        if (h.total()) {
+            std::cout << ", \"messages\": " << h.total();
+            if (!opts.cumulative) {
+                std::cout << ", \"min\": " << minLatency << ", \"max\": " << maxLatency
+                          << ", \"avg\": " << aux_avg;
+            }
+            printPercentiles(h);
+        } else {
+            std::cout << ", \"stalled\": true";
+        }
+        std::cout << "}";
+    } else if (!opts.cumulative) {
         if (!opts.csv) {
             if (count) {
                 std::cout << "Latency(ms): min=" << minLatency << ", max=" <<
 	                 maxLatency << ", avg=" << aux_avg;
+                printPercentiles(*interval);
             } else {
                 std::cout << "Stalled: no samples for interval";
             }
@@ -294,6 +341,7 @@ void Stats::print()
             if (count) {
           	    std::cout << value << "," << minLatency << "," << maxLatency <<
     				     "," << aux_avg;
+                printPercentiles(*interval);
             } else {
           	    std::cout << value << "," << minLatency << "," << maxLatency <<
     				     ", Stalled";
@@ -313,6 +361,7 @@ void Stats::print()
             }
   	        std::cout << value << "," << c_min << "," << c_max <<
     				     "," << c_avg;
+            printPercentiles(overall);
         } else {
             std::cout << "Stalled: no samples for interval";
         }
@@ -325,6 +374,7 @@ void Stats::reset()
     count = 0;
     totalLatency = maxLatency = 0;
     minLatency = std::numeric_limits<double>::max();
+    interval.reset(new sys::LatencyHistogram);
 }
 
 Sender::Sender(const string& q, Receiver& receiver) : Client(q), receiver(receiver), data(generateData(opts.size)) {}
@@ -363,7 +413,9 @@ void Sender::sendByRate()
     AbsTime start = now();
     while (true) {
         AbsTime sentAt=now();
-        msg.getDeliveryProperties().setTimestamp(Duration(EPOCH, sentAt));
+        // Open loop, a message held up counts from when it was due
+        AbsTime due(start, sent*interval);
+        msg.getDeliveryProperties().setTimestamp(Duration(EPOCH, opts.openLoop ? due : sentAt));
         async(session).messageTransfer(arg::content=msg, arg::acceptMode=1);
         if (opts.sync) session.sync();
         ++sent;
@@ -409,7 +461,7 @@ void Test::join()
     AbsTime end = now();
     Duration time(begin, end);
     double msecs(time / TIME_MSEC);
-    if (!opts.csv) {
+    if (!opts.csv && !opts.json) {
         std::cout << "Sent " << receiver.getCount() << " msgs through " << queue
                   << " in " << msecs << "ms (" << (receiver.getCount() * 1000 / msecs) << " msgs/s) ";
     }
@@ -432,8 +484,10 @@ int main(int argc, char** argv)
 {
     try {
         opts.parse(argc, argv);
-        if (opts.cumulative)
+        if (opts.cumulative && !opts.json)
             opts.csv = true;
+        if (opts.openLoop && !opts.rate)
+            throw qpid::Exception("--open-loop needs a --rate to send at");
 
         Connection localConnection;
         AsyncSession session;
@@ -459,6 +513,17 @@ int main(int argc, char** argv)
             for (boost::ptr_vector<Test>::iterator i = tests.begin(); i != tests.end(); i++) {
                 i->join();
             }
+            if (tests.size() > 1 && !opts.csv) {
+                if (opts.json) {
+                    std::cout << "{\"streams\": " << tests.size() << ", \"messages\": " << allStreams.total();
+                    printPercentiles(allStreams);
+                    std::cout << "}" << std::endl;
+                } else {
+                    std::cout << "All " << tests.size() << " streams: " << allStreams.total() << " msgs";
+                    printPercentiles(allStreams);
+                    std::cout << std::endl;
+                }
+            }
         }
 
         return 0;
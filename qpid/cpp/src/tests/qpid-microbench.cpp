@@ -0,0 +1,454 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+/**
+ * Microbenchmarks of the data structures on the broker's message path,
+ * for tracking their performance from build to build.
+ *
+ * Each benchmark repeats one operation. After a warm up, --runs timed
+ * runs of --count operations each are made and the median and
+ * minimum time per operation reported, with the spread: the median
+ * absolute deviation of the runs as a percentage of their median. A
+ * spread of more than a few percent means the machine was too busy
+ * for the result to be compared with others.
+ *
+ * With --csv there is one line per benchmark,
+ *   name,operations,median_ns,min_ns,spread_pct
+ * to be collected for trend tracking.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "qpid/amqp_0_10/Codecs.h"
+#include "qpid/broker/Deliverable.h"
+#include "qpid/broker/DirectExchange.h"
+#include "qpid/broker/HeadersExchange.h"
+#include "qpid/broker/LegacyLVQ.h"
+#include "qpid/broker/MessageDeque.h"
+#include "qpid/broker/MessageMap.h"
+#include "qpid/broker/PriorityQueue.h"
+#include "qpid/broker/Queue.h"
+#include "qpid/broker/TopicExchange.h"
+#include "qpid/framing/AMQFrame.h"
+#include "qpid/framing/Buffer.h"
+#include "qpid/framing/FieldTable.h"
+#include "qpid/framing/MessageTransferBody.h"
+#include "qpid/framing/SequenceSet.h"
+#include "qpid/sys/Time.h"
+#include "qpid/sys/Timer.h"
+#include "qpid/types/Variant.h"
+#include "BenchOptions.h"
+#include "MessageUtils.h"
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace qpid {
+namespace tests {
+
+using namespace qpid::broker;
+using namespace qpid::framing;
+using qpid::sys::AbsTime;
+using qpid::sys::Duration;
+using boost::lexical_cast;
+
+struct Args : public BenchOptions
+{
+    uint count;
+    uint runs;
+    std::string filter;
+    bool csv;
+
+    Args() : BenchOptions("Microbenchmarks"), count(100000), runs(9), csv(false)
+    {
+        addOptions()
+            ("count", qpid::optValue(count, "N"), "number of operations in each timed run")
+            ("runs", qpid::optValue(runs, "N"), "number of timed runs of each benchmark")
+            ("filter", qpid::optValue(filter, "TEXT"), "only run benchmarks whose names contain TEXT")
+            ("csv", qpid::optValue(csv), "print comma separated results");
+    }
+};
+
+// Results are added in here so that the compiler can't drop the work
+volatile uint64_t sink = 0;
+
+class Benchmark
+{
+  public:
+    Benchmark(const std::string& n) : name(n) {}
+    virtual ~Benchmark() {}
+    /** Perform the operation count times */
+    virtual void run(uint count) = 0;
+
+    const std::string name;
+};
+
+typedef std::vector<boost::shared_ptr<Benchmark> > Benchmarks;
+
+const uint BATCH = 64;
+
+class FrameEncode : public Benchmark
+{
+    AMQFrame frame;
+    std::vector<char> bytes;
+  public:
+    FrameEncode() : Benchmark("frame/encode"),
+                    frame((MessageTransferBody(ProtocolVersion(), "amq.direct", 0, 0))),
+                    bytes(frame.encodedSize() * BATCH) {}
+    void run(uint count) {
+        for (uint i = 0; i < count; i += BATCH) {
+            Buffer buffer(&bytes[0], bytes.size());
+            for (uint j = 0; j < BATCH; ++j) frame.encode(buffer);
+        }
+    }
+};
+
+class FrameDecode : public Benchmark
+{
+    std::vector<char> bytes;
+  public:
+    FrameDecode() : Benchmark("frame/decode") {
+        AMQFrame frame((MessageTransferBody(ProtocolVersion(), "amq.direct", 0, 0)));
+        bytes.resize(frame.encodedSize() * BATCH);
+        Buffer buffer(&bytes[0], bytes.size());
+        for (uint j = 0; j < BATCH; ++j) frame.encode(buffer);
+    }
+    void run(uint count) {
+        AMQFrame decoded;
+        for (uint i = 0; i < count; i += BATCH) {
+            Buffer buffer(&bytes[0], bytes.size());
+            for (uint j = 0; j < BATCH; ++j) decoded.decode(buffer);
+        }
+        sink += decoded.encodedSize();
+    }
+};
+
+// Application headers much like those of a typical message
+FieldTable headers()
+{
+    FieldTable t;
+    t.setString("source", "microbench.producer");
+    t.setString("type", "order");
+    t.setString("region", "emea");
+    t.setInt("priority-class", 3);
+    t.setInt64("sequence", 123456789);
+    t.setString("correlation", "8c5b7d2e-4f1a-4b3c-9d8e-1a2b3c4d5e6f");
+    t.setInt("retries", 0);
+    t.setString("reply-queue", "microbench.replies");
+    return t;
+}
+
+class FieldTableDecode : public Benchmark
+{
+    std::vector<char> bytes;
+  public:
+    FieldTableDecode() : Benchmark("fieldtable/decode") {
+        FieldTable t = headers();
+        bytes.resize(t.encodedSize());
+        Buffer buffer(&bytes[0], bytes.size());
+        t.encode(buffer);
+    }
+    void run(uint count) {
+        for (uint i = 0; i < count; ++i) {
+            FieldTable t;
+            Buffer buffer(&bytes[0], bytes.size());
+            t.decode(buffer);
+            sink += t.getAsInt64("sequence");
+        }
+    }
+};
+
+// Counts the deliveries routing asks for instead of making them
+struct Discard : public Deliverable
+{
+    boost::intrusive_ptr<Message> message;
+
+    Discard() : message(MessageUtils::createMessage()) {}
+    Message& getMessage() { return *message; }
+    void deliverTo(const boost::shared_ptr<Queue>&) { ++sink; }
+};
+
+/**
+ * Routes through an exchange with a number of bindings, each to its own
+ * queue. Each message matches one binding, taking the bindings in turn.
+ */
+class Route : public Benchmark
+{
+  protected:
+    boost::shared_ptr<Exchange> exchange;
+    std::vector<std::string> keys;
+    std::vector<FieldTable> args;
+    Discard msg;
+
+    boost::shared_ptr<Queue> queue(uint i) {
+        return boost::shared_ptr<Queue>(new Queue("microbench.queue." + lexical_cast<std::string>(i)));
+    }
+
+  public:
+    Route(const std::string& type, Exchange* e, uint bindings) :
+        Benchmark("route/" + type + "/" + lexical_cast<std::string>(bindings)), exchange(e) {}
+
+    void run(uint count) {
+        for (uint i = 0; i < count; ++i) {
+            uint b = i % keys.size();
+            exchange->route(msg, keys[b], args.empty() ? 0 : &args[b]);
+        }
+    }
+};
+
+struct DirectRoute : public Route
+{
+    DirectRoute(uint bindings) : Route("direct", new DirectExchange("microbench.direct"), bindings) {
+        for (uint i = 0; i < bindings; ++i) {
+            keys.push_back("microbench.key." + lexical_cast<std::string>(i));
+            exchange->bind(queue(i), keys.back(), 0);
+        }
+    }
+};
+
+struct TopicRoute : public Route
+{
+    TopicRoute(uint bindings) : Route("topic", new TopicExchange("microbench.topic"), bindings) {
+        for (uint i = 0; i < bindings; ++i) {
+            std::string n = lexical_cast<std::string>(i);
+            exchange->bind(queue(i), "microbench." + n + ".*.#", 0);
+            keys.push_back("microbench." + n + ".orders.emea");
+        }
+    }
+};
+
+struct HeadersRoute : public Route
+{
+    HeadersRoute(uint bindings) : Route("headers", new HeadersExchange("microbench.headers"), bindings) {
+        for (uint i = 0; i < bindings; ++i) {
+            FieldTable binding;
+            binding.setString("x-match", "all");
+            binding.setString("type", "order");
+            binding.setString("customer", lexical_cast<std::string>(i));
+            exchange->bind(queue(i), std::string(), &binding);
+            keys.push_back(std::string());
+            args.push_back(headers());
+            args.back().setString("customer", lexical_cast<std::string>(i));
+        }
+    }
+};
+
+/**
+ * Pushes a batch of messages onto a queue's message container and pops
+ * them again, as a queue with a consumer keeping up does.
+ */
+class PushPop : public Benchmark
+{
+    std::auto_ptr<Messages> messages;
+    std::vector<boost::intrusive_ptr<Message> > batch;
+    SequenceNumber position;
+  public:
+    PushPop(const std::string& type, Messages* m) : Benchmark("queue/" + type + "/push-pop"), messages(m) {
+        for (uint i = 0; i < BATCH; ++i) {
+            batch.push_back(MessageUtils::createMessage());
+            FieldTable& t = batch.back()->getFrames().getHeaders()->get<MessageProperties>(true)->getApplicationHeaders();
+            t.setString("key", lexical_cast<std::string>(i));
+            batch.back()->getFrames().getHeaders()->get<DeliveryProperties>(true)->setPriority(i % 10);
+        }
+    }
+    void run(uint count) {
+        QueuedMessage removed;
+        for (uint i = 0; i < count; i += BATCH) {
+            for (uint j = 0; j < BATCH; ++j) {
+                messages->push(QueuedMessage(0, batch[j], ++position), removed);
+            }
+            QueuedMessage popped;
+            while (messages->pop(popped)) ++sink;
+        }
+    }
+};
+
+class SequenceSetAdd : public Benchmark
+{
+  public:
+    SequenceSetAdd() : Benchmark("sequenceset/add-remove") {}
+    void run(uint count) {
+        // A window of outstanding commands, completed in order
+        SequenceSet set;
+        for (uint i = 0; i < count; ++i) {
+            set.add(SequenceNumber(i));
+            if (i >= BATCH) set.remove(SequenceNumber(i - BATCH));
+        }
+        sink += set.size();
+    }
+};
+
+class SequenceSetContains : public Benchmark
+{
+    SequenceSet set;
+  public:
+    SequenceSetContains() : Benchmark("sequenceset/contains") {
+        // Accepts out of order leave many ranges
+        for (uint i = 0; i < 1000; ++i) set.add(SequenceNumber(i * 4), SequenceNumber(i * 4 + 1));
+    }
+    void run(uint count) {
+        for (uint i = 0; i < count; ++i) {
+            if (set.contains(SequenceNumber((i * 7) % 4000))) ++sink;
+        }
+    }
+};
+
+qpid::types::Variant::Map variantMap()
+{
+    qpid::types::Variant::Map map;
+    map["source"] = "microbench.producer";
+    map["type"] = "order";
+    map["region"] = "emea";
+    map["priority-class"] = 3;
+    map["sequence"] = int64_t(123456789);
+    map["price"] = 12.75;
+    map["urgent"] = true;
+    map["reply-queue"] = "microbench.replies";
+    return map;
+}
+
+class VariantMapEncode : public Benchmark
+{
+    qpid::types::Variant::Map map;
+  public:
+    VariantMapEncode() : Benchmark("variant/map-encode"), map(variantMap()) {}
+    void run(uint count) {
+        for (uint i = 0; i < count; ++i) {
+            std::string encoded;
+            qpid::amqp_0_10::MapCodec::encode(map, encoded);
+            sink += encoded.size();
+        }
+    }
+};
+
+class VariantMapDecode : public Benchmark
+{
+    std::string encoded;
+  public:
+    VariantMapDecode() : Benchmark("variant/map-decode") {
+        qpid::amqp_0_10::MapCodec::encode(variantMap(), encoded);
+    }
+    void run(uint count) {
+        for (uint i = 0; i < count; ++i) {
+            qpid::types::Variant::Map map;
+            qpid::amqp_0_10::MapCodec::decode(encoded, map);
+            sink += map.size();
+        }
+    }
+};
+
+struct NoOp : public qpid::sys::TimerTask
+{
+    NoOp() : qpid::sys::TimerTask(Duration(10 * qpid::sys::TIME_MSEC), "microbench") {}
+    void fire() {}
+};
+
+/**
+ * Schedules a task and cancels it, as the broker does for most of its
+ * timeouts. The cancelled tasks fall due soon so that the timer doesn't
+ * accumulate them.
+ */
+class TimerAddCancel : public Benchmark
+{
+    qpid::sys::Timer timer;
+  public:
+    TimerAddCancel(const std::string& type, qpid::sys::Timer::Mode mode) :
+        Benchmark("timer/" + type + "/add-cancel"), timer(mode) {}
+    void run(uint count) {
+        for (uint i = 0; i < count; ++i) {
+            boost::intrusive_ptr<qpid::sys::TimerTask> task(new NoOp);
+            timer.add(task);
+            task->cancel();
+        }
+    }
+};
+
+void benchmarks(Benchmarks& all)
+{
+    all.push_back(boost::shared_ptr<Benchmark>(new FrameEncode));
+    all.push_back(boost::shared_ptr<Benchmark>(new FrameDecode));
+    all.push_back(boost::shared_ptr<Benchmark>(new FieldTableDecode));
+    const uint bindings[] = { 10, 100, 1000 };
+    for (uint i = 0; i < sizeof(bindings)/sizeof(bindings[0]); ++i) {
+        all.push_back(boost::shared_ptr<Benchmark>(new DirectRoute(bindings[i])));
+        all.push_back(boost::shared_ptr<Benchmark>(new TopicRoute(bindings[i])));
+        all.push_back(boost::shared_ptr<Benchmark>(new HeadersRoute(bindings[i])));
+    }
+    all.push_back(boost::shared_ptr<Benchmark>(new PushPop("deque", new MessageDeque)));
+    all.push_back(boost::shared_ptr<Benchmark>(new PushPop("priority", new PriorityQueue(10))));
+    all.push_back(boost::shared_ptr<Benchmark>(new PushPop("lvq", new MessageMap("key"))));
+    all.push_back(boost::shared_ptr<Benchmark>(new PushPop("legacy-lvq", new LegacyLVQ("key"))));
+    all.push_back(boost::shared_ptr<Benchmark>(new SequenceSetAdd));
+    all.push_back(boost::shared_ptr<Benchmark>(new SequenceSetContains));
+    all.push_back(boost::shared_ptr<Benchmark>(new VariantMapEncode));
+    all.push_back(boost::shared_ptr<Benchmark>(new VariantMapDecode));
+    all.push_back(boost::shared_ptr<Benchmark>(new TimerAddCancel("heap", qpid::sys::Timer::HEAP)));
+    all.push_back(boost::shared_ptr<Benchmark>(new TimerAddCancel("wheel", qpid::sys::Timer::WHEEL)));
+}
+
+double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n/2] : (values[n/2 - 1] + values[n/2]) / 2;
+}
+
+void measure(Benchmark& b, const Args& opts)
+{
+    b.run(std::max(opts.count / 10, 1u));
+    std::vector<double> times;
+    for (uint r = 0; r < opts.runs; ++r) {
+        AbsTime start = AbsTime::now();
+        b.run(opts.count);
+        times.push_back(double(int64_t(Duration(start, AbsTime::now()))) / opts.count);
+    }
+    double mid = median(times);
+    std::vector<double> deviations;
+    for (std::vector<double>::const_iterator i = times.begin(); i != times.end(); ++i)
+        deviations.push_back(*i > mid ? *i - mid : mid - *i);
+    double spread = mid > 0 ? 100 * median(deviations) / mid : 0;
+    double least = *std::min_element(times.begin(), times.end());
+    if (opts.csv) {
+        std::cout << b.name << "," << opts.count << "," << mid << "," << least << "," << spread << std::endl;
+    } else {
+        std::cout << b.name << ": " << mid << " ns/op (min " << least << ", spread " << spread << "%)" << std::endl;
+    }
+}
+
+}} // namespace qpid::tests
+
+using namespace qpid::tests;
+
+int main(int argc, char** argv)
+{
+    Args opts;
+    if (opts.parse(argc, argv) && opts.count > 0 && opts.runs > 0) {
+        Benchmarks all;
+        benchmarks(all);
+        if (opts.csv) std::cout << "name,operations,median_ns,min_ns,spread_pct" << std::endl;
+        for (Benchmarks::const_iterator i = all.begin(); i != all.end(); ++i) {
+            if ((*i)->name.find(opts.filter) != std::string::npos) measure(**i, opts);
+        }
+        return 0;
+    } else {
+        return 1;
+    }
+}
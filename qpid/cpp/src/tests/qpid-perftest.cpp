@@ -27,6 +27,14 @@
 #include "qpid/client/Completion.h"
 #include "qpid/client/Message.h"
 #include "qpid/framing/FieldTable.h"
+#include "qpid/messaging/Connection.h"
+#include "qpid/messaging/Message.h"
+#include "qpid/messaging/Receiver.h"
+#include "qpid/messaging/Sender.h"
+#include "qpid/messaging/Session.h"
+#include "qpid/sys/AtomicValue.h"
+#include "qpid/sys/LatencyHistogram.h"
+#include "qpid/sys/Monitor.h"
 #include "qpid/sys/Time.h"
 #include "qpid/sys/Thread.h"
 
@@ -34,6 +42,7 @@
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <iostream>
 #include <sstream>
@@ -41,6 +50,12 @@
 #include <algorithm>
 #include <math.h>
 
+#ifdef __linux__
+#  include <pthread.h>
+#  include <sched.h>
+#  include <unistd.h>
+#endif
+
 
 using namespace std;
 using namespace qpid;
@@ -69,6 +84,22 @@ ostream& operator<<(ostream& out, Mode mode) {
     return out << modeNames[mode];
 }
 
+enum Api { CLIENT, MESSAGING };
+const char* apiNames[] = { "client", "messaging" };
+
+istream& operator>>(istream& in, Api& api) {
+    string s;
+    in >> s;
+    int i = find(apiNames, apiNames+2, s) - apiNames;
+    if (i >= 2)  throw Exception("Invalid api: "+s);
+    api = Api(i);
+    return in;
+}
+
+ostream& operator<<(ostream& out, Api api) {
+    return out << apiNames[api];
+}
+
 
 struct Opts : public TestOptions {
 
@@ -106,6 +137,11 @@ struct Opts : public TestOptions {
     size_t txPub;
     size_t txSub;
     bool commitAsync;
+    Api api;
+    uint32_t capacity;
+    bool pinThreads;
+    uint32_t reportInterval;
+    size_t warmup;
 
     static const std::string helpText;
 
@@ -115,7 +151,8 @@ struct Opts : public TestOptions {
         pubs(1), count(500000), size(1024), confirm(true), durable(false), uniqueData(false), syncPub(false),
         subs(1), ack(0),
         qt(1),singleConnect(false), iterations(1), mode(SHARED), summary(false),
-        intervalSub(0), intervalPub(0), tx(0), txPub(0), txSub(0), commitAsync(false)
+        intervalSub(0), intervalPub(0), tx(0), txPub(0), txSub(0), commitAsync(false),
+        api(CLIENT), capacity(1000), pinThreads(false), reportInterval(0), warmup(0)
     {
         addOptions()
             ("setup", optValue(setup), "Create shared queues.")
@@ -157,7 +194,16 @@ struct Opts : public TestOptions {
             ("tx", optValue(tx, "N"), "if non-zero, the transaction batch size for publishing and consuming")
             ("pub-tx", optValue(txPub, "N"), "if non-zero, the transaction batch size for publishing")
             ("async-commit", optValue(commitAsync, "yes|no"), "Don't wait for completion of commit")
-            ("sub-tx", optValue(txSub, "N"), "if non-zero, the transaction batch size for consuming");
+            ("sub-tx", optValue(txSub, "N"), "if non-zero, the transaction batch size for consuming")
+
+            ("api", optValue(api, "client|messaging"), "API publishers and subscribers send and receive with."
+             " Control messages always use the client API. With messaging each publisher and subscriber"
+             " has its own connection, and transactions are not supported.")
+            ("capacity", optValue(capacity, "N"), "Sender and receiver capacity for --api messaging")
+            ("pin-threads", optValue(pinThreads, "yes|no"), "Bind each publisher and subscriber thread to its own CPU, round robin (Linux only)")
+            ("report-interval", optValue(reportInterval, "SECS"), "If non-zero, print the rates and latencies of this process every SECS seconds while the test runs."
+             " Latencies are only meaningful if publishers and subscribers share a clock.")
+            ("warmup", optValue(warmup, "N"), "Leave the first N messages of each iteration out of each publisher's and subscriber's rate and latencies");
     }
 
     // Computed values
@@ -165,6 +211,7 @@ struct Opts : public TestOptions {
     size_t totalSubs;
     size_t transfers;
     size_t subQuota;
+    bool timestamps;            // Publishers stamp the send time after the sequence number
 
     void parse(int argc, char** argv) {
         TestOptions::parse(argc, argv);
@@ -194,6 +241,9 @@ struct Opts : public TestOptions {
             break;
         }
         transfers=(totalPubs*count) + (totalSubs*subQuota);
+        if (warmup >= count || warmup >= subQuota)
+            throw Exception("--warmup must be less than the messages each publisher sends and each subscriber receives");
+        timestamps = reportInterval > 0;
         if (tx) {
             if (txPub) {
                 cerr << "WARNING: Using overriden tx value for publishers: " << txPub << std::endl;
@@ -206,6 +256,11 @@ struct Opts : public TestOptions {
                 txSub = tx;
             }
         }
+        if (api == MESSAGING && (txPub || txSub))
+            throw Exception("Transactions are not supported with --api messaging");
+#ifndef __linux__
+        if (pinThreads) cerr << "WARNING: --pin-threads is only supported on Linux" << endl;
+#endif
     }
 };
 
@@ -231,12 +286,44 @@ std::string fqn(const std::string& name)
     return fqn.str();
 }
 
+/** Bind the calling thread to the next CPU in turn, for --pin-threads */
+void pinThread() {
+#ifdef __linux__
+    static AtomicValue<uint32_t> next;
+    long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 0) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(next.fetchAndAdd(1) % cpus, &set);
+    if (::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set))
+        cerr << "WARNING: Could not bind thread to a CPU" << endl;
+#endif
+}
+
+/** A messaging API connection to the broker the connection options name */
+messaging::Connection openMessagingConnection() {
+    types::Variant::Map options;
+    if (!opts.con.username.empty()) options["username"] = opts.con.username;
+    if (!opts.con.password.empty()) options["password"] = opts.con.password;
+    if (!opts.con.mechanism.empty()) options["sasl_mechanisms"] = opts.con.mechanism;
+    if (!opts.con.protocol.empty()) options["transport"] = opts.con.protocol;
+    if (opts.con.heartbeat) options["heartbeat"] = opts.con.heartbeat;
+    options["tcp_nodelay"] = opts.con.tcpNoDelay;
+    messaging::Connection connection(opts.con.host + ":" + lexical_cast<string>(opts.con.port), options);
+    connection.open();
+    return connection;
+}
+
 struct Client : public Runnable {
     Connection* connection;
     Connection localConnection;
     AsyncSession session;
     Thread thread;
 
+    // Read by the Reporter for --report-interval
+    AtomicValue<uint64_t> transfers;
+    AtomicValue<uint64_t> latencies[LatencyHistogram::BUCKETS];
+
     Client() {
         if (opts.singleConnect){
             connection = &globalConnection;
@@ -346,6 +433,76 @@ class Stats {
 };
 
 
+/**
+ * Prints the rates and latencies of the publishers and subscribers in
+ * this process every --report-interval, from counts each of them keeps
+ * so that they share no cache lines.
+ */
+class Reporter : public Runnable {
+    const boost::ptr_vector<Client>& pubs;
+    const boost::ptr_vector<Client>& subs;
+    Monitor lock;
+    bool stopped;
+
+    static uint64_t percentile(const vector<uint64_t>& counts, uint64_t total, double fraction) {
+        uint64_t seen = 0;
+        for (uint32_t b = 0; b < counts.size(); ++b) {
+            seen += counts[b];
+            if (seen && seen >= fraction*total) return LatencyHistogram::upperBound(b);
+        }
+        return 0;
+    }
+
+  public:
+    Reporter(const boost::ptr_vector<Client>& p, const boost::ptr_vector<Client>& s)
+        : pubs(p), subs(s), stopped(false) {}
+
+    void run() {
+        uint64_t published = 0, received = 0;
+        vector<uint64_t> latencies(LatencyHistogram::BUCKETS);
+        AbsTime start = now();
+        AbsTime last = start;
+        Monitor::ScopedLock l(lock);
+        while (!stopped) {
+            lock.wait(AbsTime(last, opts.reportInterval*TIME_SEC));
+            if (stopped) break;
+            AbsTime time = now();
+            uint64_t p = 0, r = 0, total = 0;
+            vector<uint64_t> counts(LatencyHistogram::BUCKETS);
+            for (boost::ptr_vector<Client>::const_iterator i = pubs.begin(); i != pubs.end(); ++i)
+                p += i->transfers.get();
+            for (boost::ptr_vector<Client>::const_iterator i = subs.begin(); i != subs.end(); ++i) {
+                r += i->transfers.get();
+                for (uint32_t b = 0; b < counts.size(); ++b) counts[b] += i->latencies[b].get();
+            }
+            for (uint32_t b = 0; b < counts.size(); ++b) {
+                uint64_t c = counts[b];
+                counts[b] -= latencies[b];
+                latencies[b] = c;
+                total += counts[b];
+            }
+            double interval = secs(last, time);
+            cout << secs(start, time) << "s: "
+                 << (p - published)/interval << " published/sec, "
+                 << (r - received)/interval << " received/sec";
+            if (total)
+                cout << ", latency (us) p50 " << percentile(counts, total, 0.5)
+                     << " p99 " << percentile(counts, total, 0.99)
+                     << " p99.9 " << percentile(counts, total, 0.999);
+            cout << endl;
+            published = p;
+            received = r;
+            last = time;
+        }
+    }
+
+    void stop() {
+        Monitor::ScopedLock l(lock);
+        stopped = true;
+        lock.notify();
+    }
+};
+
 // Manage control queues, collect and print reports.
 struct Controller : public Client {
 
@@ -482,12 +639,15 @@ struct PublishThread : public Client {
 
     void run() {                // Publisher
         try {
+            if (opts.pinThreads) pinThread();
             string data;
             size_t offset(0);
+            size_t stampSize = opts.timestamps ? sizeof(int64_t) : 0;
             if (opts.uniqueData) {
                 offset = 5;
                 data += "data:";//marker (requested for latency testing tool scripts)
                 data += string(sizeof(size_t), 'X');//space for seq no
+                data += string(stampSize, 'X');//space for send time
                 data += session.getId().str();
                 if (opts.size > data.size()) {
                     data += string(opts.size - data.size(), 'X');
@@ -496,7 +656,7 @@ struct PublishThread : public Client {
                          << " to honour --unique-data" << endl;
                 }
             } else {
-                size_t msgSize=max(opts.size, sizeof(size_t));
+                size_t msgSize=max(opts.size, sizeof(size_t) + stampSize);
                 data = string(msgSize, 'X');
             }
 
@@ -504,6 +664,21 @@ struct PublishThread : public Client {
             if (opts.durable)
                 msg.getDeliveryProperties().setDeliveryMode(framing::PERSISTENT);
 
+            messaging::Connection messagingConnection;
+            messaging::Session messagingSession;
+            messaging::Sender sender;
+            messaging::Message messagingMsg;
+            if (opts.api == MESSAGING) {
+                messagingConnection = openMessagingConnection();
+                messagingSession = messagingConnection.createSession();
+                sender = messagingSession.createSender(
+                    destination.empty() ? routingKey : destination + "/" + routingKey);
+                sender.setCapacity(opts.capacity);
+                messagingMsg.setDurable(opts.durable);
+            }
+            // The content to stamp, sent from msg itself with the client API
+            string& body = opts.api == MESSAGING ? data : const_cast<std::string&>(msg.getData());
+
 
             if (opts.txPub){
                 session.txSelect();
@@ -518,11 +693,20 @@ struct PublishThread : public Client {
                 expect(lq.pop().getData(), "start");
                 AbsTime start=now();
                 for (size_t i=0; i<opts.count; i++) {
+                    if (opts.warmup && i == opts.warmup) start=now();
                     // Stamp the iteration into the message data, avoid
                     // any heap allocation.
-                    const_cast<std::string&>(msg.getData()).replace(offset, sizeof(size_t),
-                                          reinterpret_cast<const char*>(&i), sizeof(size_t));
-                    if (opts.syncPub) {
+                    body.replace(offset, sizeof(size_t),
+                                 reinterpret_cast<const char*>(&i), sizeof(size_t));
+                    if (opts.timestamps) {
+                        int64_t sent = Duration(EPOCH, now());
+                        body.replace(offset + sizeof(size_t), sizeof(int64_t),
+                                     reinterpret_cast<const char*>(&sent), sizeof(int64_t));
+                    }
+                    if (opts.api == MESSAGING) {
+                        messagingMsg.setContent(body);
+                        sender.send(messagingMsg, opts.syncPub);
+                    } else if (opts.syncPub) {
                         sync(session).messageTransfer(
                             arg::destination=destination,
                             arg::content=msg,
@@ -542,8 +726,12 @@ struct PublishThread : public Client {
                     }
                     if (opts.intervalPub)
                         qpid::sys::usleep(opts.intervalPub*1000);
+                    if (opts.reportInterval) transfers.fetchAndAdd(1);
+                }
+                if (opts.confirm) {
+                    if (opts.api == MESSAGING) messagingSession.sync();
+                    else session.sync();
                 }
-                if (opts.confirm) session.sync();
                 AbsTime end=now();
                 double time=secs(start,end);
 		if (time <= 0.0) {
@@ -551,12 +739,13 @@ struct PublishThread : public Client {
 		}
 
                 // Send result to controller.
-                Message report(lexical_cast<string>(opts.count/time), fqn("pub_done"));
+                Message report(lexical_cast<string>((opts.count - opts.warmup)/time), fqn("pub_done"));
                 session.messageTransfer(arg::content=report, arg::acceptMode=1);
                 if (opts.txPub){
                     sync(session).txCommit();
                 }
             }
+            if (opts.api == MESSAGING) messagingConnection.close();
             session.close();
         }
         catch (const std::exception& e) {
@@ -575,8 +764,9 @@ struct SubscribeThread : public Client {
 
     SubscribeThread(string key, string ex) {
         queue=session.getId().str(); // Unique name.
+        // Another connection's receiver reads it with --api messaging
         session.queueDeclare(arg::queue=queue,
-                             arg::exclusive=true,
+                             arg::exclusive=opts.api == CLIENT,
                              arg::autoDelete=true,
                              arg::durable=opts.durable);
         session.exchangeBind(arg::queue=queue,
@@ -594,8 +784,23 @@ struct SubscribeThread : public Client {
         }
     }
 
+    /** Count a message's latency from the send time its publisher stamped */
+    void recordLatency(const char* data) {
+        size_t offset = opts.uniqueData ? 5 /*marker is 'data:'*/ : 0;
+        int64_t sent = *reinterpret_cast<const int64_t*>(data + offset + sizeof(size_t));
+        int64_t latency = max(int64_t(Duration(EPOCH, now())) - sent, int64_t(0));
+        latencies[LatencyHistogram::bucket(latency/TIME_USEC)].fetchAndAdd(1);
+    }
+
+    messaging::Receiver createReceiver(messaging::Session& messagingSession) {
+        messaging::Receiver receiver = messagingSession.createReceiver(queue);
+        receiver.setCapacity(opts.capacity);
+        return receiver;
+    }
+
     void run() {                // Subscribe
         try {
+            if (opts.pinThreads) pinThread();
             if (opts.txSub) sync(session).txSelect();
             SubscriptionManager subs(session);
             SubscriptionSettings settings;
@@ -603,7 +808,24 @@ struct SubscribeThread : public Client {
             settings.acceptMode = (opts.txSub || opts.ack ? ACCEPT_MODE_EXPLICIT : ACCEPT_MODE_NONE);
             settings.flowControl = FlowControl::messageCredit(opts.subQuota);
             LocalQueue lq;
-            Subscription subscription = subs.subscribe(lq, queue, settings);
+            Subscription subscription;
+            messaging::Connection messagingConnection;
+            messaging::Session messagingSession;
+            messaging::Receiver receiver;
+            if (opts.api == MESSAGING) {
+                messagingConnection = openMessagingConnection();
+                messagingSession = messagingConnection.createSession();
+                receiver = createReceiver(messagingSession);
+            } else {
+                subscription = subs.subscribe(lq, queue, settings);
+            }
+            // The messaging API can't bound what a receiver prefetches
+            // to the quota, so when subscribers share a queue each
+            // iteration has its own receiver, and closing it releases
+            // any surplus to the others. They get it out of order.
+            bool releaseSurplus = opts.api == MESSAGING && opts.mode == SHARED && opts.subs > 1;
+            bool ordered = opts.pubs == 1 && !releaseSurplus;
+            size_t ackBatch = opts.ack ? opts.ack : opts.capacity;
             // Notify controller we are ready.
             session.messageTransfer(arg::content=Message("ready", fqn("sub_ready")), arg::acceptMode=1);
             if (opts.txSub) {
@@ -623,13 +845,24 @@ struct SubscribeThread : public Client {
                     iterationControl.pop();
 
                     //need to allocate some more credit for subscription
-                    session.messageFlow(queue, 0, opts.subQuota);
+                    if (opts.api == CLIENT) session.messageFlow(queue, 0, opts.subQuota);
+                    else if (releaseSurplus) receiver = createReceiver(messagingSession);
                 }
                 Message msg;
+                messaging::Message messagingMsg;
                 AbsTime start=now();
                 size_t expect=0;
                 for (size_t i = 0; i < opts.subQuota; ++i) {
-                    msg=lq.pop();
+                    if (opts.warmup && i == opts.warmup) start=now();
+                    const char* data;
+                    if (opts.api == MESSAGING) {
+                        messagingMsg = receiver.fetch();
+                        data = messagingMsg.getContentPtr();
+                        if ((i+1) % ackBatch == 0) messagingSession.acknowledge();
+                    } else {
+                        msg=lq.pop();
+                        data = msg.getData().data();
+                    }
                     if (opts.txSub && ((i+1) % opts.txSub == 0)) {
                         if (opts.commitAsync) session.txCommit();
                         else sync(session).txCommit();
@@ -644,14 +877,22 @@ struct SubscribeThread : public Client {
                     //
                     // For now verify order only for a single publisher.
                     size_t offset = opts.uniqueData ? 5 /*marker is 'data:'*/ : 0;
-                    size_t n = *reinterpret_cast<const size_t*>(msg.getData().data() + offset);
-                    if (opts.pubs == 1) {
+                    size_t n = *reinterpret_cast<const size_t*>(data + offset);
+                    if (ordered) {
                         if (opts.subs == 1 || opts.mode == FANOUT) verify(n==expect, "==", expect, n);
                         else verify(n>=expect, ">=", expect, n);
                         expect = n+1;
                     }
+                    if (opts.reportInterval) {
+                        transfers.fetchAndAdd(1);
+                        if (i >= opts.warmup) recordLatency(data);
+                    }
                 }
-                if (opts.txSub || opts.ack)
+                if (opts.api == MESSAGING) {
+                    messagingSession.acknowledge();
+                    if (releaseSurplus) receiver.close();
+                }
+                else if (opts.txSub || opts.ack)
                     subscription.accept(subscription.getUnaccepted());
                 if (opts.txSub) {
                     if (opts.commitAsync) session.txCommit();
@@ -660,11 +901,12 @@ struct SubscribeThread : public Client {
                 AbsTime end=now();
 
                 // Report to publisher.
-                Message result(lexical_cast<string>(opts.subQuota/secs(start,end)),
+                Message result(lexical_cast<string>((opts.subQuota - opts.warmup)/secs(start,end)),
                                fqn("sub_done"));
                 session.messageTransfer(arg::content=result, arg::acceptMode=1);
                 if (opts.txSub) sync(session).txCommit();
             }
+            if (opts.api == MESSAGING) messagingConnection.close();
             session.close();
         }
         catch (const std::exception& e) {
@@ -681,6 +923,8 @@ int main(int argc, char** argv) {
     int exitCode = 0;
     boost::ptr_vector<Client> subs(opts.subs);
     boost::ptr_vector<Client> pubs(opts.pubs);
+    boost::scoped_ptr<Reporter> reporter;
+    Thread reporterThread;
 
     try {
         opts.parse(argc, argv);
@@ -722,6 +966,11 @@ int main(int argc, char** argv) {
             }
         }
 
+        if (opts.reportInterval && (opts.publish || opts.subscribe)) {
+            reporter.reset(new Reporter(pubs, subs));
+            reporterThread = Thread(*reporter);
+        }
+
         if (opts.control) Controller().run();
     }
     catch (const std::exception& e) {
@@ -743,5 +992,10 @@ int main(int argc, char** argv) {
              ++i)
             i->thread.join();
     }
+
+    if (reporter) {
+        reporter->stop();
+        reporterThread.join();
+    }
     return exitCode;
 }
@@ -29,10 +29,14 @@
 #include <qpid/Options.h>
 #include <qpid/log/Logger.h>
 #include <qpid/log/Options.h>
+#include "qpid/sys/Mutex.h"
+#include "qpid/sys/Runnable.h"
+#include "qpid/sys/Thread.h"
 #include "qpid/sys/Time.h"
 #include "TestOptions.h"
 #include "Statistics.h"
 
+#include <boost/shared_ptr.hpp>
 #include <iostream>
 #include <memory>
 
@@ -67,6 +71,10 @@ struct Options : public qpid::Options
     bool reportHeader;
     string readyAddress;
     uint receiveRate;
+    uint receivers;
+    uint connections;
+    double reportInterval;
+    bool reportPercentiles;
 
     Options(const std::string& argv0=std::string())
         : qpid::Options("Options"),
@@ -88,7 +96,11 @@ struct Options : public qpid::Options
           reportTotal(false),
           reportEvery(0),
           reportHeader(true),
-          receiveRate(0)
+          receiveRate(0),
+          receivers(1),
+          connections(1),
+          reportInterval(0),
+          reportPercentiles(false)
     {
         addOptions()
             ("broker,b", qpid::optValue(url, "URL"), "url of broker to connect to")
@@ -111,6 +123,10 @@ struct Options : public qpid::Options
             ("report-header", qpid::optValue(reportHeader, "yes|no"), "Headers on report.")
             ("ready-address", qpid::optValue(readyAddress, "ADDRESS"), "send a message to this address when ready to receive")
             ("receive-rate", qpid::optValue(receiveRate,"N"), "Receive at rate of N messages/second. 0 means receive as fast as possible.")
+            ("receivers", qpid::optValue(receivers, "N"), "Receive on N receivers at once, each in its own thread and session. --messages and --receive-rate apply to each receiver, and each stops at the first EOS it gets.")
+            ("connections", qpid::optValue(connections, "N"), "Spread the receivers over N connections")
+            ("report-interval", qpid::optValue(reportInterval, "SECONDS"), "Report throughput and latency statistics every SECONDS seconds")
+            ("report-percentiles", qpid::optValue(reportPercentiles), "Add 50th, 90th, 99th and 99.9th percentile latencies to reports")
             ("help", qpid::optValue(help), "print this usage statement");
         add(log);
     }
@@ -126,6 +142,8 @@ struct Options : public qpid::Options
         try {
             qpid::Options::parse(argc, argv);
             if (address.empty()) throw qpid::Exception("Address must be specified!");
+            if (!receivers) throw qpid::Exception("At least one receiver is needed");
+            if (!connections || connections > receivers) connections = receivers;
             qpid::log::Logger::instance().configure(log);
             if (help) {
                 std::ostringstream msg;
@@ -167,103 +185,170 @@ class SequenceTracker
 
 using namespace qpid::tests;
 
+/**
+ * Receives messages on its own session. Several of these can run at once,
+ * in their own threads, sharing the reporter and standard output under a
+ * lock.
+ */
+class ReceiveWorker : public qpid::sys::Runnable {
+  public:
+    ReceiveWorker(const Options& o, Session s, ReporterBase& r, qpid::sys::Mutex& l)
+        : opts(o), session(s), reporter(r), lock(l) {}
+
+    /** Receive, recording any error rather than throwing it */
+    void run() {
+        try {
+            receive();
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+    }
+
+    void receive();
+    const std::string& getError() const { return error; }
+
+  private:
+    const Options& opts;
+    Session session;
+    ReporterBase& reporter;
+    qpid::sys::Mutex& lock;
+    std::string error;
+};
+
+void ReceiveWorker::receive()
+{
+    Receiver receiver = session.createReceiver(opts.address);
+    receiver.setCapacity(opts.capacity);
+    Message msg;
+    uint count = 0;
+    uint txCount = 0;
+    SequenceTracker sequenceTracker;
+    Duration timeout = opts.getTimeout();
+    bool done = false;
+    if (!opts.readyAddress.empty())
+        session.createSender(opts.readyAddress).send(msg);
+
+    // For receive rate calculation
+    qpid::sys::AbsTime start = qpid::sys::now();
+    int64_t interval = 0;
+    if (opts.receiveRate) interval = qpid::sys::TIME_SEC/opts.receiveRate;
+
+    std::map<std::string,Sender> replyTo;
+
+    while (!done && receiver.fetch(msg, timeout)) {
+        qpid::sys::Mutex::ScopedLock l(lock);
+        reporter.message(msg);
+        if (!opts.ignoreDuplicates || !sequenceTracker.isDuplicate(msg)) {
+            if (msg.getContent() == EOS) {
+                done = true;
+            } else {
+                ++count;
+                if (opts.printHeaders) {
+                    if (msg.getSubject().size()) std::cout << "Subject: " << msg.getSubject() << std::endl;
+                    if (msg.getReplyTo()) std::cout << "ReplyTo: " << msg.getReplyTo() << std::endl;
+                    if (msg.getCorrelationId().size()) std::cout << "CorrelationId: " << msg.getCorrelationId() << std::endl;
+                    if (msg.getUserId().size()) std::cout << "UserId: " << msg.getUserId() << std::endl;
+                    if (msg.getTtl().getMilliseconds()) std::cout << "TTL: " << msg.getTtl().getMilliseconds() << std::endl;
+                    if (msg.getPriority()) std::cout << "Priority: " << msg.getPriority() << std::endl;
+                    if (msg.getDurable()) std::cout << "Durable: true" << std::endl;
+                    if (msg.getRedelivered()) std::cout << "Redelivered: true" << std::endl;
+                    std::cout << "Properties: " << msg.getProperties() << std::endl;
+                    std::cout << std::endl;
+                }
+                if (opts.printContent)
+                    std::cout << msg.getContent() << std::endl;//TODO: handle map or list messages
+                if (opts.messages && count >= opts.messages) done = true;
+            }
+        } else if (opts.checkRedelivered && !msg.getRedelivered()) {
+            throw qpid::Exception("duplicate sequence number received, message not marked as redelivered!");
+        }
+        qpid::sys::Mutex::ScopedUnlock u(lock);
+        if (opts.tx && (count % opts.tx == 0)) {
+            if (opts.rollbackFrequency && (++txCount % opts.rollbackFrequency == 0)) {
+                session.rollback();
+            } else {
+                session.commit();
+            }
+        } else if (opts.ackFrequency && (count % opts.ackFrequency == 0)) {
+            session.acknowledge();
+        }
+        if (msg.getReplyTo()) { // Echo message back to reply-to address.
+            Sender& s = replyTo[msg.getReplyTo().str()];
+            if (s.isNull()) {
+                s = session.createSender(msg.getReplyTo());
+                s.setCapacity(opts.capacity);
+            }
+            s.send(msg);
+        }
+        if (opts.receiveRate) {
+            qpid::sys::AbsTime waitTill(start, count*interval);
+            int64_t delay = qpid::sys::Duration(qpid::sys::now(), waitTill);
+            if (delay > 0) qpid::sys::usleep(delay/qpid::sys::TIME_USEC);
+        }
+        // Clear out message properties & content for next iteration.
+        msg = Message(); // TODO aconway 2010-12-01: should be done by fetch
+    }
+    if (opts.tx) {
+        if (opts.rollbackFrequency && (++txCount % opts.rollbackFrequency == 0)) {
+            session.rollback();
+        } else {
+            session.commit();
+        }
+    } else {
+        session.acknowledge();
+    }
+    session.close();
+}
+
 int main(int argc, char ** argv)
 {
-    Connection connection;
+    std::vector<Connection> connections;
     try {
         Options opts;
         if (opts.parse(argc, argv)) {
-            connection = Connection(opts.url, opts.connectionOptions);
-            connection.open();
-            std::auto_ptr<FailoverUpdates> updates(opts.failoverUpdates ? new FailoverUpdates(connection) : 0);
-            Session session = opts.tx ? connection.createTransactionalSession() : connection.createSession();
-            Receiver receiver = session.createReceiver(opts.address);
-            receiver.setCapacity(opts.capacity);
-            Message msg;
-            uint count = 0;
-            uint txCount = 0;
-            SequenceTracker sequenceTracker;
-            Duration timeout = opts.getTimeout();
-            bool done = false;
-            Reporter<ThroughputAndLatency> reporter(std::cout, opts.reportEvery, opts.reportHeader);
-            if (!opts.readyAddress.empty())
-                session.createSender(opts.readyAddress).send(msg);
-
-            // For receive rate calculation
-            qpid::sys::AbsTime start = qpid::sys::now();
-            int64_t interval = 0;
-            if (opts.receiveRate) interval = qpid::sys::TIME_SEC/opts.receiveRate;
-
-            std::map<std::string,Sender> replyTo;
+            std::vector<boost::shared_ptr<FailoverUpdates> > updates;
+            for (uint i = 0; i < opts.connections; ++i) {
+                connections.push_back(Connection(opts.url, opts.connectionOptions));
+                connections.back().open();
+                if (opts.failoverUpdates)
+                    updates.push_back(boost::shared_ptr<FailoverUpdates>(new FailoverUpdates(connections.back())));
+            }
+            std::auto_ptr<ReporterBase> reporter;
+            if (opts.reportPercentiles)
+                reporter.reset(new Reporter<ThroughputAndPercentiles>(std::cout, opts.reportEvery, opts.reportHeader));
+            else
+                reporter.reset(new Reporter<ThroughputAndLatency>(std::cout, opts.reportEvery, opts.reportHeader));
+            if (opts.reportInterval)
+                reporter->setInterval(qpid::sys::Duration(int64_t(opts.reportInterval*qpid::sys::TIME_SEC)));
+            qpid::sys::Mutex lock;
 
-            while (!done && receiver.fetch(msg, timeout)) {
-                reporter.message(msg);
-                if (!opts.ignoreDuplicates || !sequenceTracker.isDuplicate(msg)) {
-                    if (msg.getContent() == EOS) {
-                        done = true;
-                    } else {
-                        ++count;
-                        if (opts.printHeaders) {
-                            if (msg.getSubject().size()) std::cout << "Subject: " << msg.getSubject() << std::endl;
-                            if (msg.getReplyTo()) std::cout << "ReplyTo: " << msg.getReplyTo() << std::endl;
-                            if (msg.getCorrelationId().size()) std::cout << "CorrelationId: " << msg.getCorrelationId() << std::endl;
-                            if (msg.getUserId().size()) std::cout << "UserId: " << msg.getUserId() << std::endl;
-                            if (msg.getTtl().getMilliseconds()) std::cout << "TTL: " << msg.getTtl().getMilliseconds() << std::endl;
-                            if (msg.getPriority()) std::cout << "Priority: " << msg.getPriority() << std::endl;
-                            if (msg.getDurable()) std::cout << "Durable: true" << std::endl;
-                            if (msg.getRedelivered()) std::cout << "Redelivered: true" << std::endl;
-                            std::cout << "Properties: " << msg.getProperties() << std::endl;
-                            std::cout << std::endl;
-                        }
-                        if (opts.printContent)
-                            std::cout << msg.getContent() << std::endl;//TODO: handle map or list messages
-                        if (opts.messages && count >= opts.messages) done = true;
-                    }
-                } else if (opts.checkRedelivered && !msg.getRedelivered()) {
-                    throw qpid::Exception("duplicate sequence number received, message not marked as redelivered!");
-                }
-                if (opts.tx && (count % opts.tx == 0)) {
-                    if (opts.rollbackFrequency && (++txCount % opts.rollbackFrequency == 0)) {
-                        session.rollback();
-                    } else {
-                        session.commit();
-                    }
-                } else if (opts.ackFrequency && (count % opts.ackFrequency == 0)) {
-                    session.acknowledge();
-                }
-                if (msg.getReplyTo()) { // Echo message back to reply-to address.
-                    Sender& s = replyTo[msg.getReplyTo().str()];
-                    if (s.isNull()) {
-                        s = session.createSender(msg.getReplyTo());
-                        s.setCapacity(opts.capacity);
-                    }
-                    s.send(msg);
-                }
-                if (opts.receiveRate) {
-                    qpid::sys::AbsTime waitTill(start, count*interval);
-                    int64_t delay = qpid::sys::Duration(qpid::sys::now(), waitTill);
-                    if (delay > 0) qpid::sys::usleep(delay/qpid::sys::TIME_USEC);
-                }
-                // Clear out message properties & content for next iteration.
-                msg = Message(); // TODO aconway 2010-12-01: should be done by fetch
+            std::vector<boost::shared_ptr<ReceiveWorker> > workers;
+            for (uint i = 0; i < opts.receivers; ++i) {
+                Connection& c = connections[i % connections.size()];
+                Session session = opts.tx ? c.createTransactionalSession() : c.createSession();
+                workers.push_back(boost::shared_ptr<ReceiveWorker>(new ReceiveWorker(opts, session, *reporter, lock)));
             }
-            if (opts.reportTotal) reporter.report();
-            if (opts.tx) {
-                if (opts.rollbackFrequency && (++txCount % opts.rollbackFrequency == 0)) {
-                    session.rollback();
-                } else {
-                    session.commit();
-                }
+            if (workers.size() == 1) {
+                workers[0]->receive();
             } else {
-                session.acknowledge();
+                std::vector<qpid::sys::Thread> threads;
+                for (size_t i = 0; i < workers.size(); ++i)
+                    threads.push_back(qpid::sys::Thread(*workers[i]));
+                for (size_t i = 0; i < threads.size(); ++i)
+                    threads[i].join();
+                for (size_t i = 0; i < workers.size(); ++i)
+                    if (!workers[i]->getError().empty())
+                        throw qpid::Exception(workers[i]->getError());
             }
-            session.close();
-            connection.close();
+            if (opts.reportTotal) reporter->report();
+            for (size_t i = 0; i < connections.size(); ++i)
+                connections[i].close();
             return 0;
         }
     } catch(const std::exception& error) {
         std::cerr << "qpid-receive: " << error.what() << std::endl;
-        connection.close();
+        for (size_t i = 0; i < connections.size(); ++i)
+            connections[i].close();
         return 1;
     }
 }
@@ -0,0 +1,403 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+/**
+ * Ramps the number of queues, connections or topic bindings on a
+ * broker through a series of steps and, at each step, measures:
+ *
+ *  - the rate at which the step's queues, connections or bindings were
+ *    added
+ *  - the broker's resident memory, if it runs on this host and
+ *    --broker-pid is given
+ *  - the time a management query for all objects of the kind takes
+ *  - the round trip latency of messages through amq.topic to a queue
+ *    while everything stays in place
+ *
+ * and prints a row of the scaling report for each.
+ */
+
+#include "TestOptions.h"
+
+#include "qpid/client/AsyncSession.h"
+#include "qpid/client/Connection.h"
+#include "qpid/client/LocalQueue.h"
+#include "qpid/client/Message.h"
+#include "qpid/client/SubscriptionManager.h"
+#include "qpid/messaging/Address.h"
+#include "qpid/messaging/Connection.h"
+#include "qpid/messaging/Message.h"
+#include "qpid/messaging/Receiver.h"
+#include "qpid/messaging/Sender.h"
+#include "qpid/messaging/Session.h"
+#include "qpid/sys/LatencyHistogram.h"
+#include "qpid/sys/Time.h"
+#include "qpid/types/Uuid.h"
+#include "qpid/types/Variant.h"
+
+#include <boost/lexical_cast.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+using namespace qpid;
+using namespace qpid::client;
+using namespace qpid::sys;
+using boost::lexical_cast;
+
+namespace qpid {
+namespace tests {
+
+enum Dimension { QUEUES, CONNECTIONS, BINDINGS };
+const char* dimensionNames[] = { "queues", "connections", "bindings" };
+// The management class of the objects each dimension adds
+const char* dimensionClasses[] = { "queue", "connection", "binding" };
+
+istream& operator>>(istream& in, Dimension& dimension) {
+    string s;
+    in >> s;
+    int i = find(dimensionNames, dimensionNames+3, s) - dimensionNames;
+    if (i >= 3)  throw Exception("Invalid dimension: "+s);
+    dimension = Dimension(i);
+    return in;
+}
+
+ostream& operator<<(ostream& out, Dimension dimension) {
+    return out << dimensionNames[dimension];
+}
+
+struct Opts : public TestOptions {
+    Dimension dimension;
+    vector<uint32_t> steps;
+    uint32_t batch;
+    uint32_t brokerPid;
+    uint32_t samples;
+    string baseName;
+    bool csv;
+    bool keep;
+
+    Opts() :
+        TestOptions("Ramps the queues, connections or bindings on a broker and reports how it scales."),
+        dimension(QUEUES), batch(1000), brokerPid(0), samples(1000),
+        baseName("qpid-scale-test"), csv(false), keep(false)
+    {
+        addOptions()
+            ("dimension", optValue(dimension, "queues|connections|bindings"), "What to ramp.")
+            ("step", optValue(steps, "N"), "Ramp to N in total, then measure. Repeat for each step, in increasing order."
+             " Default 1000, 10000 and 100000.")
+            ("batch", optValue(batch, "N"), "Wait for the broker to complete each N declares or binds.")
+            ("broker-pid", optValue(brokerPid, "PID"), "Report the resident memory of this broker process, which must run on this host.")
+            ("samples", optValue(samples, "N"), "Round trips to time for the latency at each step.")
+            ("base-name", optValue(baseName, "NAME"), "Base name of the queues the test declares.")
+            ("csv", optValue(csv), "Print the report as comma separated values.")
+            ("keep", optValue(keep), "Leave the queues and bindings in place at the end.");
+    }
+
+    void parse(int argc, char** argv) {
+        TestOptions::parse(argc, argv);
+        if (steps.empty()) {
+            steps.push_back(1000);
+            steps.push_back(10000);
+            steps.push_back(100000);
+        }
+        sort(steps.begin(), steps.end());
+        if (!batch) batch = 1;
+    }
+};
+
+Opts opts;
+
+string name(const string& suffix) { return opts.baseName + "-" + suffix; }
+
+/** Adds queues, connections or bindings to the broker */
+class Ramp {
+  public:
+    virtual ~Ramp() {}
+    /** Add to make @a total in all */
+    virtual void grow(uint32_t total) = 0;
+    virtual void cleanup() {}
+};
+
+class QueueRamp : public Ramp {
+    AsyncSession session;
+    uint32_t count;
+
+  public:
+    QueueRamp(Connection& connection) : session(connection.newSession()), count(0) {}
+
+    void grow(uint32_t total) {
+        for (; count < total; ++count) {
+            session.queueDeclare(arg::queue=name(lexical_cast<string>(count)));
+            if ((count + 1) % opts.batch == 0) session.sync();
+        }
+        session.sync();
+    }
+
+    void cleanup() {
+        for (uint32_t i = 0; i < count; ++i) {
+            session.queueDelete(arg::queue=name(lexical_cast<string>(i)));
+            if ((i + 1) % opts.batch == 0) session.sync();
+        }
+        session.sync();
+    }
+};
+
+/** Binds distinct patterns of amq.topic to one queue */
+class BindingRamp : public Ramp {
+    AsyncSession session;
+    string queue;
+    uint32_t count;
+
+  public:
+    BindingRamp(Connection& connection)
+        : session(connection.newSession()), queue(name("bindings")), count(0)
+    {
+        session.queueDeclare(arg::queue=queue);
+    }
+
+    void grow(uint32_t total) {
+        for (; count < total; ++count) {
+            session.exchangeBind(arg::exchange="amq.topic", arg::queue=queue,
+                                 arg::bindingKey=name(lexical_cast<string>(count)) + ".*.#");
+            if ((count + 1) % opts.batch == 0) session.sync();
+        }
+        session.sync();
+    }
+
+    void cleanup() {
+        session.queueDelete(arg::queue=queue);
+        session.sync();
+    }
+};
+
+class ConnectionRamp : public Ramp {
+    boost::ptr_vector<Connection> connections;
+
+  public:
+    void grow(uint32_t total) {
+        while (connections.size() < total) {
+            connections.push_back(new Connection);
+            opts.open(connections.back());
+        }
+    }
+
+    void cleanup() {
+        for (boost::ptr_vector<Connection>::iterator i = connections.begin(); i != connections.end(); ++i)
+            i->close();
+        connections.clear();
+    }
+};
+
+/** The broker's resident memory in kB, or 0 if it can't be read */
+uint64_t brokerRss() {
+    if (!opts.brokerPid) return 0;
+    ifstream status(("/proc/" + lexical_cast<string>(opts.brokerPid) + "/status").c_str());
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) {
+            istringstream in(line.substr(6));
+            uint64_t kb = 0;
+            in >> kb;
+            return kb;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Times a QMF query for every object of a class, which the broker
+ * answers as it does a management publication: it encodes them all.
+ */
+class ManagementQuery {
+    messaging::Connection connection;
+    messaging::Session session;
+    messaging::Sender sender;
+    messaging::Receiver receiver;
+    messaging::Address replyTo;
+
+  public:
+    ManagementQuery() {
+        types::Variant::Map options;
+        if (!opts.con.username.empty()) options["username"] = opts.con.username;
+        if (!opts.con.password.empty()) options["password"] = opts.con.password;
+        if (!opts.con.mechanism.empty()) options["sasl_mechanisms"] = opts.con.mechanism;
+        connection = messaging::Connection(opts.con.host + ":" + lexical_cast<string>(opts.con.port), options);
+        connection.open();
+        session = connection.createSession();
+        sender = session.createSender("qmf.default.direct/broker");
+        string reply = name("reply-" + types::Uuid(true).str());
+        receiver = session.createReceiver(reply + "; {create:always, delete:always}");
+        replyTo = messaging::Address(reply);
+    }
+
+    ~ManagementQuery() {
+        try {
+            connection.close();
+        } catch (const std::exception& e) {
+            cerr << "Error in shutdown: " << e.what() << endl;
+        }
+    }
+
+    /** The seconds a query for all objects of @a className took, setting @a objects */
+    double run(const string& className, size_t& objects) {
+        types::Variant::Map schemaId, content;
+        schemaId["_class_name"] = className;
+        content["_what"] = "OBJECT";
+        content["_schema_id"] = schemaId;
+        messaging::Message request;
+        messaging::encode(content, request);
+        request.setReplyTo(replyTo);
+        request.getProperties()["x-amqp-0-10.app-id"] = "qmf2";
+        request.getProperties()["qmf.opcode"] = "_query_request";
+        request.getProperties()["method"] = "request";
+
+        AbsTime start = AbsTime::now();
+        sender.send(request);
+        objects = 0;
+        for (bool partial = true; partial; ) {
+            messaging::Message response = receiver.fetch(messaging::Duration::SECOND * 60);
+            session.acknowledge();
+            types::Variant::List results;
+            messaging::decode(response, results);
+            objects += results.size();
+            partial = response.getProperties().count("partial");
+        }
+        return double(Duration(start, AbsTime::now()))/TIME_SEC;
+    }
+};
+
+/** Times round trips through amq.topic to a queue and back */
+class LatencyProbe {
+    Session session;
+    SubscriptionManager subscriptions;
+    LocalQueue local;
+    string key;
+
+  public:
+    LatencyProbe(Connection& connection)
+        : session(connection.newSession()), subscriptions(session), key(name("latency"))
+    {
+        session.queueDeclare(arg::queue=key, arg::exclusive=true, arg::autoDelete=true);
+        session.exchangeBind(arg::exchange="amq.topic", arg::queue=key, arg::bindingKey=key);
+        subscriptions.subscribe(local, key,
+                                SubscriptionSettings(FlowControl::unlimited(), ACCEPT_MODE_NONE));
+    }
+
+    void run(uint32_t samples, LatencyHistogram& histogram) {
+        Message message(string(64, 'X'), key);
+        for (uint32_t i = 0; i < samples; ++i) {
+            AbsTime start = AbsTime::now();
+            session.messageTransfer(arg::destination="amq.topic", arg::content=message,
+                                    arg::acceptMode=1);
+            local.pop();
+            histogram.record(Duration(start, AbsTime::now()));
+        }
+    }
+};
+
+struct Row {
+    uint32_t count;
+    double rate;
+    uint64_t rssKb;
+    double querySecs;
+    size_t objects;
+    uint64_t p50, p99;
+};
+
+void printHeader() {
+    if (opts.csv) {
+        cout << opts.dimension << ",per_sec,rss_kb,query_ms,objects,latency_p50_us,latency_p99_us" << endl;
+    } else {
+        cout << setw(12) << opts.dimension << setw(12) << "per sec" << setw(12) << "rss kB"
+             << setw(12) << "query ms" << setw(12) << "objects"
+             << setw(12) << "p50 us" << setw(12) << "p99 us" << endl;
+    }
+}
+
+void print(const Row& row) {
+    if (opts.csv) {
+        cout << row.count << "," << row.rate << "," << row.rssKb << ","
+             << row.querySecs*1000 << "," << row.objects << ","
+             << row.p50 << "," << row.p99 << endl;
+    } else {
+        cout << setw(12) << row.count << setw(12) << uint64_t(row.rate) << setw(12) << row.rssKb
+             << setw(12) << setprecision(4) << row.querySecs*1000 << setw(12) << row.objects
+             << setw(12) << row.p50 << setw(12) << row.p99 << endl;
+    }
+}
+
+}} // namespace qpid::tests
+
+using namespace qpid::tests;
+
+int main(int argc, char** argv) {
+    try {
+        opts.parse(argc, argv);
+        Connection connection;
+        opts.open(connection);
+        boost::scoped_ptr<Ramp> ramp;
+        switch (opts.dimension) {
+          case QUEUES: ramp.reset(new QueueRamp(connection)); break;
+          case CONNECTIONS: ramp.reset(new ConnectionRamp); break;
+          case BINDINGS: ramp.reset(new BindingRamp(connection)); break;
+        }
+        ManagementQuery query;
+        LatencyProbe probe(connection);
+
+        int exitCode = 0;
+        printHeader();
+        uint32_t count = 0;
+        for (vector<uint32_t>::const_iterator i = opts.steps.begin(); i != opts.steps.end(); ++i) {
+            Row row;
+            AbsTime start = AbsTime::now();
+            try {
+                ramp->grow(*i);
+            } catch (const std::exception& e) {
+                cerr << "Failed ramping from " << count << " to " << *i << " " << opts.dimension
+                     << ": " << e.what() << endl;
+                exitCode = 1;
+                break;
+            }
+            double secs = double(Duration(start, AbsTime::now()))/TIME_SEC;
+            row.count = *i;
+            row.rate = secs > 0 ? (*i - count)/secs : 0;
+            count = *i;
+            row.rssKb = brokerRss();
+            row.querySecs = query.run(dimensionClasses[opts.dimension], row.objects);
+            LatencyHistogram latency;
+            probe.run(opts.samples, latency);
+            row.p50 = latency.percentile(0.5);
+            row.p99 = latency.percentile(0.99);
+            print(row);
+        }
+        if (!opts.keep) ramp->cleanup();
+        connection.close();
+        return exitCode;
+    } catch (const std::exception& e) {
+        cerr << "Failed: " << e.what() << endl;
+        return 1;
+    }
+}
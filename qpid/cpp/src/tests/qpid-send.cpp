@@ -28,10 +28,13 @@
 #include <qpid/messaging/FailoverUpdates.h>
 #include <qpid/sys/Time.h>
 #include <qpid/sys/Monitor.h>
+#include <qpid/sys/Runnable.h>
 #include <qpid/sys/SystemInfo.h>
+#include <qpid/sys/Thread.h>
 #include "TestOptions.h"
 #include "Statistics.h"
 
+#include <boost/shared_ptr.hpp>
 #include <fstream>
 #include <iostream>
 #include <memory>
@@ -82,6 +85,10 @@ struct Options : public qpid::Options
     uint groupSize;
     bool groupRandSize;
     uint groupInterleave;
+    uint senders;
+    uint connections;
+    uint batch;
+    double reportInterval;
 
     Options(const std::string& argv0=std::string())
         : qpid::Options("Options"),
@@ -110,7 +117,11 @@ struct Options : public qpid::Options
           groupPrefix("GROUP-"),
           groupSize(10),
           groupRandSize(false),
-          groupInterleave(1)
+          groupInterleave(1),
+          senders(1),
+          connections(1),
+          batch(0),
+          reportInterval(0)
     {
         addOptions()
             ("broker,b", qpid::optValue(url, "URL"), "url of broker to connect to")
@@ -146,6 +157,10 @@ struct Options : public qpid::Options
             ("group-size", qpid::optValue(groupSize, "N"), "Number of messages per a group (if group-key specified)")
             ("group-randomize-size", qpid::optValue(groupRandSize), "Randomize the number of messages per group to [1...group-size] (if group-key specified)")
             ("group-interleave", qpid::optValue(groupInterleave, "N"), "Simultaineously interleave messages from N different groups (if group-key specified)")
+            ("senders", qpid::optValue(senders, "N"), "Send from N senders at once, each in its own thread and session. --messages, --send-rate, --flow-control and --send-eos apply to each sender.")
+            ("connections", qpid::optValue(connections, "N"), "Spread the senders over N connections")
+            ("batch", qpid::optValue(batch, "N"), "Pass messages to the sender N at a time (0 means one at a time)")
+            ("report-interval", qpid::optValue(reportInterval, "SECONDS"), "Report throughput statistics every SECONDS seconds")
             ("help", qpid::optValue(help), "print this usage statement");
         add(log);
     }
@@ -155,6 +170,10 @@ struct Options : public qpid::Options
         try {
             qpid::Options::parse(argc, argv);
             if (address.empty()) throw qpid::Exception("Address must be specified!");
+            if (!senders) throw qpid::Exception("At least one sender is needed");
+            if (!connections || connections > senders) connections = senders;
+            if (contentStdin && senders > 1)
+                throw qpid::Exception("Can't use content-stdin with more than one sender");
             qpid::log::Logger::instance().configure(log);
             if (help) {
                 std::ostringstream msg;
@@ -329,135 +348,221 @@ public:
     }
 };
 
+std::auto_ptr<ContentGenerator> createContentGenerator(const Options& opts)
+{
+    if (opts.contentStdin)
+        return std::auto_ptr<ContentGenerator>(new GetlineContentGenerator);
+    else if (opts.entries.size() > 0)
+        return std::auto_ptr<ContentGenerator>(new MapContentGenerator(opts));
+    else if (opts.contentSize > 0)
+        return std::auto_ptr<ContentGenerator>(new FixedContentGenerator(string(opts.contentSize, 'X')));
+    else
+        return std::auto_ptr<ContentGenerator>(new FixedContentGenerator(opts.contentString));
+}
+
+/**
+ * Sends messages on its own session. Several of these can run at once,
+ * in their own threads, sharing the reporter under a lock.
+ */
+class SendWorker : public qpid::sys::Runnable {
+  public:
+    SendWorker(const Options& o, Session s, ReporterBase& r, qpid::sys::Mutex& l)
+        : opts(o), session(s), reporter(r), lock(l) {}
+
+    /** Send, recording any error rather than throwing it */
+    void run() {
+        try {
+            send();
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+    }
+
+    void send();
+    const std::string& getError() const { return error; }
+
+  private:
+    const Options& opts;
+    Session session;
+    ReporterBase& reporter;
+    qpid::sys::Mutex& lock;
+    std::vector<Message> pending;
+    std::string error;
+
+    void flush(Sender& sender) {
+        if (!pending.empty()) {
+            sender.send(pending);
+            pending.clear();
+        }
+    }
+};
+
+void SendWorker::send()
+{
+    Sender sender = session.createSender(opts.address);
+    if (opts.capacity) sender.setCapacity(opts.capacity);
+    Message msg;
+    msg.setDurable(opts.durable);
+    if (opts.ttl) {
+        msg.setTtl(Duration(opts.ttl));
+    }
+    if (opts.priority) {
+        msg.setPriority(opts.priority);
+    }
+    if (!opts.replyto.empty()) {
+        if (opts.flowControl)
+            throw Exception("Can't use reply-to and flow-control together");
+        msg.setReplyTo(Address(opts.replyto));
+    }
+    if (!opts.userid.empty()) msg.setUserId(opts.userid);
+    if (!opts.correlationid.empty()) msg.setCorrelationId(opts.correlationid);
+    opts.setProperties(msg);
+    uint sent = 0;
+    uint txCount = 0;
+
+    std::auto_ptr<ContentGenerator> contentGen = createContentGenerator(opts);
+
+    std::auto_ptr<GroupGenerator> groupGen;
+    if (!opts.groupKey.empty())
+        groupGen.reset(new GroupGenerator(opts.groupKey,
+                                          opts.groupPrefix,
+                                          opts.groupSize,
+                                          opts.groupRandSize,
+                                          opts.groupInterleave));
+
+    qpid::sys::AbsTime start = qpid::sys::now();
+    int64_t interval = 0;
+    if (opts.sendRate) interval = qpid::sys::TIME_SEC/opts.sendRate;
+
+    Receiver flowControlReceiver;
+    Address flowControlAddress("flow-"+Uuid(true).str()+";{create:always,delete:always}");
+    uint flowSent = 0;
+    if (opts.flowControl) {
+        flowControlReceiver = session.createReceiver(flowControlAddress);
+        flowControlReceiver.setCapacity(2);
+    }
+    if (opts.batch) pending.reserve(opts.batch);
+
+    while (contentGen->setContent(msg)) {
+        ++sent;
+        if (opts.sequence)
+            msg.getProperties()[SN] = sent;
+        if (opts.flowControl) {
+            if ((sent % opts.flowControl) == 0) {
+                msg.setReplyTo(flowControlAddress);
+                ++flowSent;
+            }
+            else
+                msg.setReplyTo(Address()); // Clear the reply address.
+        }
+        if (groupGen.get())
+            groupGen->setGroupInfo(msg);
+
+        if (opts.timestamp)
+            msg.getProperties()[TS] = int64_t(
+                qpid::sys::Duration(qpid::sys::EPOCH, qpid::sys::now()));
+        if (opts.batch) {
+            pending.push_back(msg);
+            if (pending.size() >= opts.batch) flush(sender);
+        } else {
+            sender.send(msg);
+        }
+        {
+            qpid::sys::Mutex::ScopedLock l(lock);
+            reporter.message(msg);
+        }
+
+        if (opts.tx && (sent % opts.tx == 0)) {
+            flush(sender);
+            if (opts.rollbackFrequency &&
+                (++txCount % opts.rollbackFrequency == 0))
+                session.rollback();
+            else
+                session.commit();
+        }
+        if (opts.messages && sent >= opts.messages) break;
+
+        if (opts.flowControl && flowSent == 2) {
+            flush(sender);
+            flowControlReceiver.get(Duration::SECOND);
+            --flowSent;
+        }
+
+        if (opts.sendRate) {
+            qpid::sys::AbsTime waitTill(start, sent*interval);
+            int64_t delay = qpid::sys::Duration(qpid::sys::now(), waitTill);
+            if (delay > 0) {
+                flush(sender);
+                qpid::sys::usleep(delay/qpid::sys::TIME_USEC);
+            }
+        }
+    }
+    flush(sender);
+    for ( ; flowSent>0; --flowSent)
+        flowControlReceiver.get(Duration::SECOND);
+    for (uint i = opts.sendEos; i > 0; --i) {
+        if (opts.sequence)
+            msg.getProperties()[SN] = ++sent;
+        msg.setContent(EOS); //TODO: add in ability to send digest or similar
+        sender.send(msg);
+    }
+    if (opts.tx) {
+        if (opts.rollbackFrequency && (++txCount % opts.rollbackFrequency == 0)) {
+            session.rollback();
+        } else {
+            session.commit();
+        }
+    }
+    session.sync();
+    session.close();
+}
+
 int main(int argc, char ** argv)
 {
-    Connection connection;
+    std::vector<Connection> connections;
     Options opts;
     try {
         if (opts.parse(argc, argv)) {
-             connection = Connection(opts.url, opts.connectionOptions);
-            connection.open();
-            std::auto_ptr<FailoverUpdates> updates(opts.failoverUpdates ? new FailoverUpdates(connection) : 0);
-            Session session = opts.tx ? connection.createTransactionalSession() : connection.createSession();
-            Sender sender = session.createSender(opts.address);
-            if (opts.capacity) sender.setCapacity(opts.capacity);
-            Message msg;
-            msg.setDurable(opts.durable);
-            if (opts.ttl) {
-                msg.setTtl(Duration(opts.ttl));
+            if (opts.contentStdin) opts.messages = 0; // Don't limit # messages sent.
+            std::vector<boost::shared_ptr<FailoverUpdates> > updates;
+            for (uint i = 0; i < opts.connections; ++i) {
+                connections.push_back(Connection(opts.url, opts.connectionOptions));
+                connections.back().open();
+                if (opts.failoverUpdates)
+                    updates.push_back(boost::shared_ptr<FailoverUpdates>(new FailoverUpdates(connections.back())));
             }
-            if (opts.priority) {
-                msg.setPriority(opts.priority);
-            }
-            if (!opts.replyto.empty()) {
-                if (opts.flowControl)
-                    throw Exception("Can't use reply-to and flow-control together");
-                msg.setReplyTo(Address(opts.replyto));
-            }
-            if (!opts.userid.empty()) msg.setUserId(opts.userid);
-            if (!opts.correlationid.empty()) msg.setCorrelationId(opts.correlationid);
-            opts.setProperties(msg);
-            uint sent = 0;
-            uint txCount = 0;
             Reporter<Throughput> reporter(std::cout, opts.reportEvery, opts.reportHeader);
-
-            std::auto_ptr<ContentGenerator> contentGen;
-            if (opts.contentStdin) {
-                opts.messages = 0; // Don't limit # messages sent.
-                contentGen.reset(new GetlineContentGenerator);
+            if (opts.reportInterval)
+                reporter.setInterval(qpid::sys::Duration(int64_t(opts.reportInterval*qpid::sys::TIME_SEC)));
+            qpid::sys::Mutex lock;
+
+            std::vector<boost::shared_ptr<SendWorker> > workers;
+            for (uint i = 0; i < opts.senders; ++i) {
+                Connection& c = connections[i % connections.size()];
+                Session session = opts.tx ? c.createTransactionalSession() : c.createSession();
+                workers.push_back(boost::shared_ptr<SendWorker>(new SendWorker(opts, session, reporter, lock)));
             }
-            else if (opts.entries.size() > 0)
-                contentGen.reset(new MapContentGenerator(opts));
-            else if (opts.contentSize > 0)
-                contentGen.reset(new FixedContentGenerator(string(opts.contentSize, 'X')));
-            else
-                contentGen.reset(new FixedContentGenerator(opts.contentString));
-
-            std::auto_ptr<GroupGenerator> groupGen;
-            if (!opts.groupKey.empty())
-                groupGen.reset(new GroupGenerator(opts.groupKey,
-                                                  opts.groupPrefix,
-                                                  opts.groupSize,
-                                                  opts.groupRandSize,
-                                                  opts.groupInterleave));
-
-            qpid::sys::AbsTime start = qpid::sys::now();
-            int64_t interval = 0;
-            if (opts.sendRate) interval = qpid::sys::TIME_SEC/opts.sendRate;
-
-            Receiver flowControlReceiver;
-            Address flowControlAddress("flow-"+Uuid(true).str()+";{create:always,delete:always}");
-            uint flowSent = 0;
-            if (opts.flowControl) {
-                flowControlReceiver = session.createReceiver(flowControlAddress);
-                flowControlReceiver.setCapacity(2);
-            }
-
-            while (contentGen->setContent(msg)) {
-                ++sent;
-                if (opts.sequence)
-                    msg.getProperties()[SN] = sent;
-                if (opts.flowControl) {
-                    if ((sent % opts.flowControl) == 0) {
-                        msg.setReplyTo(flowControlAddress);
-                        ++flowSent;
-                    }
-                    else
-                        msg.setReplyTo(Address()); // Clear the reply address.
-                }
-                if (groupGen.get())
-                    groupGen->setGroupInfo(msg);
-
-                if (opts.timestamp)
-                    msg.getProperties()[TS] = int64_t(
-                        qpid::sys::Duration(qpid::sys::EPOCH, qpid::sys::now()));
-                sender.send(msg);
-                reporter.message(msg);
-
-                if (opts.tx && (sent % opts.tx == 0)) {
-                    if (opts.rollbackFrequency &&
-                        (++txCount % opts.rollbackFrequency == 0))
-                        session.rollback();
-                    else
-                        session.commit();
-                }
-                if (opts.messages && sent >= opts.messages) break;
-
-                if (opts.flowControl && flowSent == 2) {
-                    flowControlReceiver.get(Duration::SECOND);
-                    --flowSent;
-                }
-
-                if (opts.sendRate) {
-                    qpid::sys::AbsTime waitTill(start, sent*interval);
-                    int64_t delay = qpid::sys::Duration(qpid::sys::now(), waitTill);
-                    if (delay > 0) qpid::sys::usleep(delay/qpid::sys::TIME_USEC);
-                }
+            if (workers.size() == 1) {
+                workers[0]->send();
+            } else {
+                std::vector<qpid::sys::Thread> threads;
+                for (size_t i = 0; i < workers.size(); ++i)
+                    threads.push_back(qpid::sys::Thread(*workers[i]));
+                for (size_t i = 0; i < threads.size(); ++i)
+                    threads[i].join();
+                for (size_t i = 0; i < workers.size(); ++i)
+                    if (!workers[i]->getError().empty())
+                        throw qpid::Exception(workers[i]->getError());
             }
-            for ( ; flowSent>0; --flowSent)
-                flowControlReceiver.get(Duration::SECOND);
             if (opts.reportTotal) reporter.report();
-            for (uint i = opts.sendEos; i > 0; --i) {
-                if (opts.sequence)
-                    msg.getProperties()[SN] = ++sent;
-                msg.setContent(EOS); //TODO: add in ability to send digest or similar
-                sender.send(msg);
-            }
-            if (opts.tx) {
-                if (opts.rollbackFrequency && (++txCount % opts.rollbackFrequency == 0)) {
-                    session.rollback();
-                } else {
-                    session.commit();
-                }
-            }
-            session.sync();
-            session.close();
-            connection.close();
+            for (size_t i = 0; i < connections.size(); ++i)
+                connections[i].close();
             return 0;
         }
     } catch(const std::exception& error) {
         std::cerr << "qpid-send: " << error.what() << std::endl;
-        connection.close();
+        for (size_t i = 0; i < connections.size(); ++i)
+            connections[i].close();
         return 1;
     }
 }
@@ -35,6 +35,7 @@
 #include "qpid/framing/Buffer.h"
 #include "qpid/framing/Uuid.h"
 #include "qpid/sys/Thread.h"
+#include "qpid/sys/Time.h"
 
 using namespace qpid;
 using namespace qpid::client;
@@ -57,11 +58,12 @@ struct Args : public qpid::TestOptions {
     uint totalMsgCount;
     bool dtx;
     bool quiet;
+    bool latency;
 
     Args() : init(true), transfer(true), check(true),
              size(256), durable(true), queues(2),
              base("tx-test"), msgsPerTx(1), txCount(1), totalMsgCount(10),
-             dtx(false), quiet(false)
+             dtx(false), quiet(false), latency(false)
     {
         addOptions()
 
@@ -76,6 +78,7 @@ struct Args : public qpid::TestOptions {
             ("tx-count", optValue(txCount, "N"), "number of transactions per 'agent'")
             ("total-messages", optValue(totalMsgCount, "N"), "total number of messages in 'circulation'")
             ("dtx", optValue(dtx, "yes|no"), "use distributed transactions")
+            ("report-latency", optValue(latency), "wait for each commit and report commit latency percentiles")
             ("quiet", optValue(quiet), "reduce output from test");
     }
 };
@@ -106,6 +109,12 @@ void generateSet(const std::string& base, uint count, StringSet& collection)
 
 Args opts;
 
+int64_t percentile(const std::vector<int64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t i = size_t(p * (sorted.size() - 1));
+    return sorted[i];
+}
+
 struct Client
 {
     Connection connection;
@@ -134,6 +143,7 @@ struct Transfer : public Client, public Runnable
     std::string dest;
     Thread thread;
     framing::Xid xid;
+    std::vector<int64_t> latencies;
 
     Transfer(const std::string& to, const std::string& from) : src(to), dest(from), xid(0x4c414e47, "", from) {}
 
@@ -171,6 +181,7 @@ struct Transfer : public Client, public Runnable
                     session.messageTransfer(arg::content=out, arg::acceptMode=1);
                 }
                 sub.accept(sub.getUnaccepted());
+                AbsTime start = now();
                 if (opts.dtx) {
                     session.dtxEnd(arg::xid=xid);
                     session.dtxPrepare(arg::xid=xid);
@@ -178,6 +189,10 @@ struct Transfer : public Client, public Runnable
                 } else {
                     session.txCommit();
                 }
+                if (opts.latency) {
+                    session.sync();
+                    latencies.push_back(Duration(start, now()));
+                }
             }
         } catch(const std::exception& e) {
             std::cout << "Transfer interrupted: " << e.what() << std::endl;
@@ -234,8 +249,19 @@ struct Controller : public Client
             agents.back().thread = Thread(agents.back());
         }
 
+        std::vector<int64_t> latencies;
         for (boost::ptr_vector<Transfer>::iterator i = agents.begin(); i != agents.end(); i++) {
             i->thread.join();
+            latencies.insert(latencies.end(), i->latencies.begin(), i->latencies.end());
+        }
+        if (opts.latency) {
+            std::sort(latencies.begin(), latencies.end());
+            std::cout << "Commit latency (us) over " << latencies.size() << " transactions:"
+                      << " p50 " << percentile(latencies, 0.5)/TIME_USEC
+                      << " p90 " << percentile(latencies, 0.9)/TIME_USEC
+                      << " p99 " << percentile(latencies, 0.99)/TIME_USEC
+                      << " max " << (latencies.empty() ? 0 : latencies.back()/TIME_USEC)
+                      << std::endl;
         }
     }
 
@@ -0,0 +1,99 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+/**
+ * Reports the heap allocations made per message by routing through a
+ * direct exchange, leaving out delivery to the queues themselves.
+ */
+
+#include <iostream>
+#include "qpid/broker/Deliverable.h"
+#include "qpid/broker/DirectExchange.h"
+#include "qpid/broker/Queue.h"
+#include "BenchOptions.h"
+#include "HeapCounter.h"
+#include "MessageUtils.h"
+#include <boost/lexical_cast.hpp>
+
+namespace qpid {
+namespace tests {
+
+using namespace qpid::broker;
+
+struct Args : public BenchOptions
+{
+    uint count;
+    uint queues;
+
+    Args() : BenchOptions("Routing allocation benchmark"), count(100000), queues(1)
+    {
+        addOptions()
+            ("count", qpid::optValue(count, "N"), "number of messages to route")
+            ("queues", qpid::optValue(queues, "N"), "number of queues bound with the routing key");
+    }
+};
+
+// Counts the deliveries routing asks for instead of making them
+struct Discard : public Deliverable
+{
+    boost::intrusive_ptr<Message> message;
+    uint deliveries;
+
+    Discard(const boost::intrusive_ptr<Message>& m) : message(m), deliveries(0) {}
+    Message& getMessage() { return *message; }
+    void deliverTo(const boost::shared_ptr<Queue>&) { ++deliveries; }
+};
+
+void route(Exchange& exchange, Discard& msg, const std::string& key, uint count)
+{
+    for (uint i = 0; i < count; ++i) {
+        exchange.route(msg, key, 0);
+    }
+}
+
+}} // namespace qpid::tests
+
+using namespace qpid::tests;
+
+int main(int argc, char** argv)
+{
+    Args opts;
+    if (opts.parse(argc, argv)) {
+        // Names too long for any short string optimisation
+        const std::string key("route.allocation.benchmark.key");
+        qpid::broker::DirectExchange exchange("route.allocation.benchmark.exchange");
+        for (uint i = 0; i < opts.queues; ++i) {
+            qpid::broker::Queue::shared_ptr queue(
+                new qpid::broker::Queue("route.allocation.benchmark.queue." + boost::lexical_cast<std::string>(i)));
+            exchange.bind(queue, key, 0);
+        }
+        Discard msg(MessageUtils::createMessage(exchange.getName(), key));
+        // Warm up so that any pools have reached a steady state
+        route(exchange, msg, key, 1000);
+        size_t before = heap::allocations;
+        route(exchange, msg, key, opts.count);
+        std::cout << double(heap::allocations - before) / opts.count
+                  << " allocations per message routed to " << opts.queues << " queue(s)" << std::endl;
+        return msg.deliveries == (opts.count + 1000) * opts.queues ? 0 : 1;
+    } else {
+        return 1;
+    }
+}
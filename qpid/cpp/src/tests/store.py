@@ -18,7 +18,7 @@
 # under the License.
 #
 
-import errno, os, time
+import errno, glob, os, shutil, time
 from brokertest import *
 from qpid import compat, session
 from qpid.util import connect
@@ -52,19 +52,26 @@ class StoreTests(BrokerTest):
 
   def setUp(self):
     BrokerTest.setUp(self)
-    self._broker = self.broker()
+    # Each broker started by a test shares one data dir, for stores kept there.
+    self._broker = self.broker(name="store")
     self.start_session()
 
-  def cycle_broker(self):
+  def cycle_broker(self, args=[]):
     # tearDown resets working dir; change it back after.
     d = os.getcwd()
     BrokerTest.tearDown(self)
     os.chdir(d)
     self._broker = None
-    self._broker = self.broker()
+    self._broker = self.broker(args, name="store")
     self.conn = self.setup_connection()
     self.ssn = self.setup_session()
 
+  def kill_broker(self):
+    # Stop without warning, leaving the store as it was on disk.
+    self._broker.expect = EXPECT_UNKNOWN
+    self._broker.kill()
+    self._broker.wait()
+
   def xid(self, txid):
     StoreTests.tx_counter += 1
     branchqual = "v%s" % StoreTests.tx_counter
@@ -195,3 +202,65 @@ class StoreTests(BrokerTest):
     self.ssn.exchange_unbind(queue="Dtx_Q", exchange="Dtx_E", binding_key="Dtx")
     self.ssn.exchange_delete(exchange="Dtx_E")
     self.ssn.queue_delete(queue="Dtx_Q")
+
+  def testDurableMessages(self):
+    self._broker.send_messages("DM1", [messaging.Message("m%d" % i, durable=True)
+                                       for i in range(10)])
+    self._broker.send_message("DM1", messaging.Message("transient"))
+
+    # Cycle the broker and make sure only the durable messages recover
+    self.cycle_broker()
+    self.assertEqual(["m%d" % i for i in range(10)],
+                     [m.content for m in self._broker.get_messages("DM1", 10)])
+    try:
+      self._broker.get_message("DM1")
+      assert False, 'Transient message recovered'
+    except messaging.Empty: pass
+
+    # Nothing is recovered again once the messages are consumed
+    self.cycle_broker()
+    try:
+      self._broker.get_message("DM1")
+      assert False, 'Consumed message recovered'
+    except messaging.Empty: pass
+
+  def testInterruptedCompaction(self):
+    if BrokerTest.store_provider != "JOURNAL":
+      raise Skipped("Journal store only")
+    journal = os.path.join(self.dir, "store", "journal")
+
+    # One live message in the oldest segment, behind a few segments of
+    # consumed ones, with compaction off.
+    self.cycle_broker(["--journal-segment-size=1", "--journal-compact-ratio=0"])
+    self._broker.send_message("CQ", messaging.Message("keep", durable=True))
+    filler = "x" * 65536
+    self._broker.send_messages("CF", [messaging.Message(filler, durable=True)
+                                      for i in range(48)])
+    self._broker.get_messages("CF", 48)
+    self.kill_broker()
+    segments = sorted(glob.glob(os.path.join(journal, "jrnl.*")))
+    self.assert_(len(segments) >= 3)
+    saved = os.path.join(self.dir, "saved")
+    os.mkdir(saved)
+    for s in segments: shutil.copy(s, saved)
+
+    # Let compaction copy the message out and remove the old segments
+    self.cycle_broker(["--journal-segment-size=1", "--journal-compact-ratio=1"])
+    assert retry(lambda: not os.path.exists(segments[0])), \
+        'Oldest segment was not compacted'
+    self.kill_broker()
+
+    # Put back what it removed and tear the enqueue that followed the copy,
+    # as if the broker had stopped part way through.
+    for s in segments: shutil.copy(os.path.join(saved, os.path.basename(s)), journal)
+    newest = sorted(glob.glob(os.path.join(journal, "jrnl.*")))[-1]
+    self.assert_(newest not in segments)
+    f = open(newest, "r+b")
+    try:
+      f.seek(0, 2)
+      f.truncate(f.tell() - 1)
+    finally:
+      f.close()
+
+    self.cycle_broker()
+    self.assertEqual("keep", self._broker.get_message("CQ").content)
@@ -477,6 +477,53 @@ class ManagementTest (TestBase010):
 
         conn.close()
 
+    def test_subscribe_where(self):
+        url = "%s://%s:%d" % (self.broker.scheme or "amqp", self.broker.host, self.broker.port)
+        conn = qpid.messaging.Connection(url)
+        conn.open()
+        sess = conn.session()
+        replyTo = "qmf.default.direct/reply_subscribe_where_test;{node:{type:topic}}"
+        agent_sender   = sess.sender("qmf.default.direct/broker")
+        agent_receiver = sess.receiver(replyTo)
+        selected = sess.sender("test-sub-selected;{create:always,delete:always,node:{type:queue,durable:False,x-declare:{auto-delete:True}}}")
+        other = sess.sender("test-sub-other;{create:always,delete:always,node:{type:queue,durable:False,x-declare:{auto-delete:True}}}")
+
+        query = {'_what':'OBJECT',
+                 '_schema_id':{'_package_name':'org.apache.qpid.broker', '_class_name':'queue'},
+                 '_where':['eq', 'name', ['quote', 'test-sub-selected']]}
+        request = qpid.messaging.Message({'_query':query, '_interval':1000, '_duration':60})
+        request.properties['qmf.opcode'] = '_subscribe_request'
+        request.properties['x-amqp-0-10.app-id'] = 'qmf2'
+        request.reply_to = replyTo
+        agent_sender.send(request)
+
+        result = agent_receiver.fetch(3)
+        self.assertEqual(result.properties['qmf.opcode'], '_subscribe_response')
+        self.assertEqual(result.content['_interval'], 1000)
+        self.assertEqual(result.content['_duration'], 60)
+        sub_id = result.content['_subscription_id']
+
+        # The first pass waits for the agent's next periodic cycle
+        indication = agent_receiver.fetch(15)
+        self.assertEqual(indication.properties['qmf.opcode'], '_data_indication')
+        self.assertEqual(indication.properties['qmf.content'], '_data')
+        self.assertEqual(len(indication.content), 1)
+        self.assertEqual(indication.content[0]['_values']['name'], 'test-sub-selected')
+
+        # Only the selected queue's changes are sent on
+        other.send(qpid.messaging.Message("other"))
+        selected.send(qpid.messaging.Message("selected"))
+        indication = agent_receiver.fetch(15)
+        self.assertEqual(indication.properties['qmf.opcode'], '_data_indication')
+        self.assertEqual([o['_values']['name'] for o in indication.content], ['test-sub-selected'])
+        self.assertEqual(indication.content[0]['_values']['msgTotalEnqueues'], 1)
+
+        cancel = qpid.messaging.Message({'_subscription_id':sub_id})
+        cancel.properties['qmf.opcode'] = '_subscribe_cancel_indication'
+        cancel.properties['x-amqp-0-10.app-id'] = 'qmf2'
+        agent_sender.send(cancel)
+        conn.close()
+
     def test_binding_count_on_queue(self):
         self.startQmf()
         conn = self.connect()
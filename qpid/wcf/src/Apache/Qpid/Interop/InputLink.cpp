@@ -79,6 +79,9 @@ InputLink::InputLink(AmqpSession^ session, System::String^ sourceQueue,
     localQueuep(NULL),
     queuePtrp(NULL),
     dequeuedFrameSetpp(NULL),
+    pendingAcceptsp(NULL),
+    pendingAcceptCount(0),
+    acceptBatchSize(1),
     disposed(false),
     finalizing(false)
 {
@@ -103,6 +106,7 @@ InputLink::InputLink(AmqpSession^ session, System::String^ sourceQueue,
 	}
 
 	localQueuep = new LocalQueue;
+	pendingAcceptsp = new SequenceSet;
 	SubscriptionSettings settings;
 	settings.flowControl = FlowControl::messageCredit(0);
 	settings.completionMode = CompletionMode::MANUAL_COMPLETION;
@@ -139,6 +143,19 @@ void InputLink::ReleaseNative()
 {
     // involves talking to the Broker unless the connection is broken
 
+    if ((pendingAcceptsp != NULL) && !finalizing) {
+	// messages already handed out must not come back
+	try {
+	    FlushAccepts();
+	}
+	catch (const std::exception& error) {
+	    std::cout << "shutdown error " << error.what() << std::endl;
+	}
+	catch (System::Exception^) {
+	    // session already closed
+	}
+    }
+
     if ((subscriptionp != NULL) && !finalizing) {
 	// TODO: find boost time error on cleanup when in finalizer thread
         try {
@@ -170,6 +187,10 @@ void InputLink::ReleaseNative()
 	delete dequeuedFrameSetpp;
 	dequeuedFrameSetpp = NULL;
     }
+    if (pendingAcceptsp != NULL) {
+	delete pendingAcceptsp;
+	pendingAcceptsp = NULL;
+    }
 }
 
 void InputLink::Cleanup()
@@ -472,6 +493,8 @@ void InputLink::PrefetchLimit::set(int value)
 	delta = prefetchLimit / 3;
     }
     minWorkingCredit = prefetchLimit - delta;
+    // accept in batches as large as the credit top ups
+    acceptBatchSize = (delta > 0) ? delta : 1;
     AdjustCredit();
 }
 
@@ -582,6 +605,32 @@ void InputLink::SyncCredit(Object ^unused)
 }
 
 
+// call with lock held
+void InputLink::FlushAccepts()
+{
+    if (pendingAcceptCount == 0)
+	return;
+
+    SequenceSet accepts(*pendingAcceptsp);
+    pendingAcceptsp->clear();
+    pendingAcceptCount = 0;
+
+    // only messages received outside a transaction are batched, keep them out of
+    // any transaction that has started since
+    if (Transaction::Current != nullptr) {
+	TransactionScope^ suppress = gcnew TransactionScope(TransactionScopeOption::Suppress);
+	try {
+	    amqpSession->AcceptAndComplete(accepts, browsing);
+	}
+	finally {
+	    delete suppress;
+	}
+	return;
+    }
+    amqpSession->AcceptAndComplete(accepts, browsing);
+}
+
+
 AmqpMessage^ InputLink::createAmqpMessage(IntPtr msgp)
 {
     QpidFrameSetPtr* fspp = (QpidFrameSetPtr*) msgp.ToPointer();
@@ -712,8 +761,21 @@ AmqpMessage^ InputLink::createAmqpMessage(IntPtr msgp)
 	// Tell the broker we got it.
 	
 	// subscriptionp->accept(frameSetID) is a slow sync operation in the native API
-	// so do it within the AsyncSession directly
-	amqpSession->AcceptAndComplete(frameSetID, browsing);
+	// so do it within the AsyncSession directly.  With a prefetch window, accepts
+	// go to the broker a batch at a time, and at once whenever no further message
+	// is waiting locally, so that an idle receiver holds none unaccepted.
+	// Within a transaction the accept is sent at once, as part of it.
+	lock l(linkLock);
+	if ((pendingAcceptsp == NULL) || (Transaction::Current != nullptr)) {
+	    FlushAccepts();
+	    amqpSession->AcceptAndComplete(frameSetID, browsing);
+	}
+	else {
+	    *pendingAcceptsp += frameSetID;
+	    pendingAcceptCount++;
+	    if ((pendingAcceptCount >= acceptBatchSize) || !haveMessage())
+		FlushAccepts();
+	}
 
 	workingCredit--;
 	// check if more messages need to be requested from broker
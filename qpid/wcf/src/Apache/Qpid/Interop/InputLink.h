@@ -58,6 +58,11 @@ private:
     bool creditSyncPending;
     // working credit low water mark
     int minWorkingCredit;
+    // transfers handed to the application but not yet accepted
+    qpid::framing::SequenceSet* pendingAcceptsp;
+    int pendingAcceptCount;
+    // accepts sent to the broker together
+    int acceptBatchSize;
 
     bool browsing;
     QpidAddress^ qpidAddress;
@@ -70,6 +75,7 @@ private:
     AmqpMessage^ createAmqpMessage(IntPtr msgp);
     void AdjustCredit();
     void SyncCredit(Object ^);
+    void FlushAccepts();
 
 internal:
     InputLink(AmqpSession^ session, System::String^ sourceQueue, qpid::client::AsyncSession *qpidSessionp,